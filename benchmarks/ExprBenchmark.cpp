@@ -0,0 +1,135 @@
+//===-- ExprBenchmark.cpp -------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "benchmark/benchmark.h"
+
+#include "klee/ADT/ImmutableMap.h"
+#include "klee/Expr/ArrayCache.h"
+#include "klee/Expr/Constraints.h"
+#include "klee/Expr/Expr.h"
+#include "klee/Expr/ExprHashMap.h"
+
+#include <vector>
+
+using namespace klee;
+
+namespace {
+
+/// Reads of the bytes of a symbolic array, the leaves of the expressions.
+struct Bytes {
+  ArrayCache arrays;
+  std::vector<ref<Expr>> bytes;
+
+  explicit Bytes(unsigned size) {
+    const Array *array = arrays.CreateArray("arr", size);
+    UpdateList ul(array, 0);
+    for (unsigned i = 0; i < size; ++i)
+      bytes.push_back(
+          ReadExpr::create(ul, ConstantExpr::create(i, Expr::Int32)));
+  }
+
+  /// A 32 bit little endian word at offset, as loads build them.
+  ref<Expr> word(unsigned offset) const {
+    return ConcatExpr::create4(bytes[offset + 3], bytes[offset + 2],
+                               bytes[offset + 1], bytes[offset]);
+  }
+};
+
+void BM_ExprCreate(benchmark::State &state) {
+  Bytes b(64);
+  for (auto _ : state) {
+    ref<Expr> sum = b.word(0);
+    for (unsigned i = 4; i < 64; i += 4)
+      sum = AddExpr::create(b.word(i), sum);
+    benchmark::DoNotOptimize(
+        UltExpr::create(sum, ConstantExpr::create(100, Expr::Int32)));
+  }
+}
+BENCHMARK(BM_ExprCreate);
+
+void BM_ExprHashLookup(benchmark::State &state) {
+  Bytes b(256);
+  std::vector<ref<Expr>> words;
+  for (unsigned i = 0; i < 256; i += 4)
+    words.push_back(b.word(i));
+  ExprHashMap<unsigned> map;
+  for (unsigned i = 0; i < words.size(); ++i)
+    map.emplace(words[i], i);
+
+  unsigned i = 0;
+  for (auto _ : state) {
+    // a structurally equal expression, whose hash has to be computed
+    unsigned offset = (i++ % words.size()) * 4;
+    benchmark::DoNotOptimize(map.find(b.word(offset)));
+  }
+}
+BENCHMARK(BM_ExprHashLookup);
+
+void BM_ImmutableMapInsert(benchmark::State &state) {
+  const unsigned size = state.range(0);
+  for (auto _ : state) {
+    ImmutableMap<unsigned, unsigned> map;
+    for (unsigned i = 0; i < size; ++i)
+      map = map.insert({i * 2654435761U, i});
+    benchmark::DoNotOptimize(map.size());
+  }
+  state.SetItemsProcessed(state.iterations() * size);
+}
+BENCHMARK(BM_ImmutableMapInsert)->Arg(64)->Arg(4096);
+
+void BM_ImmutableMapLookup(benchmark::State &state) {
+  const unsigned size = state.range(0);
+  ImmutableMap<unsigned, unsigned> map;
+  for (unsigned i = 0; i < size; ++i)
+    map = map.insert({i * 2654435761U, i});
+
+  unsigned i = 0;
+  for (auto _ : state)
+    benchmark::DoNotOptimize(map.lookup((i++ % size) * 2654435761U));
+}
+BENCHMARK(BM_ImmutableMapLookup)->Arg(64)->Arg(4096);
+
+void BM_ImmutableMapCopyAndReplace(benchmark::State &state) {
+  // the copy-on-fork pattern of the per-state caches
+  ImmutableMap<unsigned, unsigned> map;
+  for (unsigned i = 0; i < 1024; ++i)
+    map = map.insert({i, i});
+
+  unsigned i = 0;
+  for (auto _ : state) {
+    ImmutableMap<unsigned, unsigned> copy = map;
+    benchmark::DoNotOptimize(copy.replace({i % 1024, i}));
+    ++i;
+  }
+}
+BENCHMARK(BM_ImmutableMapCopyAndReplace);
+
+void BM_SimplifyExpr(benchmark::State &state) {
+  Bytes b(64);
+  ConstraintSet constraints;
+  ConstraintManager cm(constraints);
+  // equalities, which simplifyExpr substitutes, and bounds
+  for (unsigned i = 0; i < 16; i += 4)
+    cm.addConstraint(
+        EqExpr::create(ConstantExpr::create(i, Expr::Int32), b.word(i)));
+  for (unsigned i = 16; i < 64; i += 4)
+    cm.addConstraint(
+        UltExpr::create(b.word(i), ConstantExpr::create(1000, Expr::Int32)));
+
+  ref<Expr> sum = b.word(0);
+  for (unsigned i = 4; i < 32; i += 4)
+    sum = AddExpr::create(b.word(i), sum);
+  ref<Expr> e = UltExpr::create(sum, ConstantExpr::create(100, Expr::Int32));
+
+  for (auto _ : state)
+    benchmark::DoNotOptimize(ConstraintManager::simplifyExpr(constraints, e));
+}
+BENCHMARK(BM_SimplifyExpr);
+
+} // namespace
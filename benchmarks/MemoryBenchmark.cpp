@@ -0,0 +1,134 @@
+//===-- MemoryBenchmark.cpp -----------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "benchmark/benchmark.h"
+
+#include "Core/AddressSpace.h"
+#include "Core/Context.h"
+#include "Core/Memory.h"
+#include "klee/Expr/ArrayCache.h"
+#include "klee/Expr/Expr.h"
+
+#include <vector>
+
+using namespace klee;
+
+namespace {
+
+struct Objects {
+  std::vector<ref<MemoryObject>> objects;
+
+  explicit Objects(unsigned count, unsigned size = 64) {
+    static bool initialized = false;
+    if (!initialized) {
+      Context::initialize(/*IsLittleEndian=*/true, Expr::Int64);
+      initialized = true;
+    }
+    for (unsigned i = 0; i < count; ++i)
+      objects.push_back(new MemoryObject(
+          /*segment=*/i + 1, ConstantExpr::create(size, Expr::Int64), size,
+          /*isLocal=*/false, /*isGlobal=*/false, /*isFixed=*/false,
+          /*allocSite=*/nullptr, /*parent=*/nullptr));
+  }
+};
+
+void BM_ObjectStateConcreteReadWrite(benchmark::State &state) {
+  Objects mos(1);
+  ObjectState *os = new ObjectState(mos.objects[0].get());
+  ref<const ObjectState> hold(os);
+  os->initializeToZero();
+
+  unsigned i = 0;
+  for (auto _ : state) {
+    unsigned offset = (i++ % 8) * 8;
+    os->write(offset, KValue(ConstantExpr::create(i, Expr::Int64)));
+    benchmark::DoNotOptimize(os->read(offset, Expr::Int64));
+  }
+}
+BENCHMARK(BM_ObjectStateConcreteReadWrite);
+
+void BM_ObjectStateSymbolicRead(benchmark::State &state) {
+  Objects mos(1);
+  ArrayCache arrays;
+  const Array *array = arrays.CreateArray("arr", 64);
+  ObjectState *os = new ObjectState(mos.objects[0].get(), array);
+  ref<const ObjectState> hold(os);
+
+  unsigned i = 0;
+  for (auto _ : state)
+    benchmark::DoNotOptimize(os->read((i++ % 8) * 8, Expr::Int64));
+}
+BENCHMARK(BM_ObjectStateSymbolicRead);
+
+void BM_ObjectStateSymbolicOffsetWrite(benchmark::State &state) {
+  // writes at a symbolic offset extend the update list of the object (a
+  // symbolic one, as constant arrays are created by the memory manager)
+  Objects mos(1);
+  ArrayCache arrays;
+  const Array *array = arrays.CreateArray("arr", 64);
+  const Array *index = arrays.CreateArray("index", 8);
+  ref<Expr> offset = ZExtExpr::create(
+      ReadExpr::create(UpdateList(index, 0),
+                       ConstantExpr::create(0, Expr::Int32)),
+      Expr::Int64);
+
+  for (auto _ : state) {
+    state.PauseTiming();
+    ObjectState *os = new ObjectState(mos.objects[0].get(), array);
+    ref<const ObjectState> hold(os);
+    state.ResumeTiming();
+    for (unsigned i = 0; i < 16; ++i)
+      os->write(offset, KValue(ConstantExpr::create(i, Expr::Int8)));
+    benchmark::DoNotOptimize(os->read(offset, Expr::Int8));
+  }
+}
+BENCHMARK(BM_ObjectStateSymbolicOffsetWrite);
+
+void BM_AddressSpaceResolveConstantSegment(benchmark::State &state) {
+  const unsigned count = state.range(0);
+  Objects mos(count);
+  AddressSpace as;
+  for (const auto &mo : mos.objects)
+    as.bindObject(mo.get(), new ObjectState(mo.get()));
+
+  unsigned i = 0;
+  for (auto _ : state) {
+    // pointers into the objects in a stride the segment cache cannot hold
+    uint64_t segment = (i++ * 97) % count + 1;
+    ObjectPair op;
+    benchmark::DoNotOptimize(as.resolveOneConstantSegment(
+        KValue(ConstantExpr::create(segment, Expr::Int64),
+               ConstantExpr::create(8, Expr::Int64)),
+        op));
+  }
+}
+BENCHMARK(BM_AddressSpaceResolveConstantSegment)->Arg(16)->Arg(4096);
+
+void BM_AddressSpaceForkAndWrite(benchmark::State &state) {
+  // the copy-on-write pattern of forked states
+  Objects mos(256);
+  AddressSpace as;
+  for (const auto &mo : mos.objects) {
+    ObjectState *os = new ObjectState(mo.get());
+    os->initializeToZero();
+    as.bindObject(mo.get(), os);
+  }
+
+  unsigned i = 0;
+  for (auto _ : state) {
+    AddressSpace copy(as);
+    const MemoryObject *mo = mos.objects[i++ % mos.objects.size()].get();
+    ObjectState *os = copy.getWriteable(mo, copy.findObject(mo));
+    os->write(0, KValue(ConstantExpr::create(i, Expr::Int32)));
+    benchmark::DoNotOptimize(os);
+  }
+}
+BENCHMARK(BM_AddressSpaceForkAndWrite);
+
+} // namespace
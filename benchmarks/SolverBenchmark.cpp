@@ -0,0 +1,125 @@
+//===-- SolverBenchmark.cpp -----------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "benchmark/benchmark.h"
+
+#include "klee/Expr/ArrayCache.h"
+#include "klee/Expr/Constraints.h"
+#include "klee/Expr/Expr.h"
+#include "klee/Solver/Solver.h"
+#include "klee/Solver/SolverCmdLine.h"
+
+#include <memory>
+#include <vector>
+
+using namespace klee;
+
+namespace {
+
+/// Branch queries over a path of bounds on the bytes of a symbolic array,
+/// which the core solver answers once and the caches answer afterwards.
+struct Queries {
+  ArrayCache arrays;
+  ConstraintSet constraints;
+  std::vector<ref<Expr>> conditions;
+
+  Queries() {
+    const Array *array = arrays.CreateArray("arr", 32);
+    UpdateList ul(array, 0);
+    std::vector<ref<Expr>> bytes;
+    for (unsigned i = 0; i < 32; ++i)
+      bytes.push_back(
+          ReadExpr::create(ul, ConstantExpr::create(i, Expr::Int32)));
+
+    ConstraintManager cm(constraints);
+    for (unsigned i = 0; i < 16; ++i)
+      cm.addConstraint(
+          UltExpr::create(bytes[i], ConstantExpr::create(100, Expr::Int8)));
+    for (unsigned i = 0; i < 32; ++i)
+      conditions.push_back(EqExpr::create(
+          AddExpr::create(bytes[i], bytes[(i + 1) % 32]),
+          ConstantExpr::create(i, Expr::Int8)));
+  }
+};
+
+/// Solves the queries with chain, once to fill its caches and then timed.
+template <typename Solve>
+void runCached(benchmark::State &state, Solver *chain, Solve solve) {
+  std::unique_ptr<Solver> solver(chain);
+  Queries queries;
+  for (const auto &condition : queries.conditions)
+    if (!solve(*solver, Query(queries.constraints, condition))) {
+      state.SkipWithError("the core solver failed");
+      return;
+    }
+
+  unsigned i = 0;
+  for (auto _ : state) {
+    const auto &condition = queries.conditions[i++ % queries.conditions.size()];
+    benchmark::DoNotOptimize(
+        solve(*solver, Query(queries.constraints, condition)));
+  }
+}
+
+bool evaluate(Solver &solver, const Query &query) {
+  Solver::Validity validity;
+  return solver.evaluate(query, validity);
+}
+
+bool getValue(Solver &solver, const Query &query) {
+  // the sum compared by the condition
+  ref<ConstantExpr> value;
+  return solver.getValue(query.withExpr(query.expr->getKid(1)), value);
+}
+
+void BM_CachingSolverHit(benchmark::State &state) {
+  Solver *core = createCoreSolver(CoreSolverToUse);
+  if (!core) {
+    state.SkipWithError("no core solver");
+    return;
+  }
+  runCached(state, createCachingSolver(core), evaluate);
+}
+BENCHMARK(BM_CachingSolverHit);
+
+void BM_CexCachingSolverHit(benchmark::State &state) {
+  Solver *core = createCoreSolver(CoreSolverToUse);
+  if (!core) {
+    state.SkipWithError("no core solver");
+    return;
+  }
+  runCached(state, createCexCachingSolver(core), evaluate);
+}
+BENCHMARK(BM_CexCachingSolverHit);
+
+void BM_CexCachingSolverValue(benchmark::State &state) {
+  Solver *core = createCoreSolver(CoreSolverToUse);
+  if (!core) {
+    state.SkipWithError("no core solver");
+    return;
+  }
+  runCached(state, createCexCachingSolver(core), getValue);
+}
+BENCHMARK(BM_CexCachingSolverValue);
+
+void BM_IndependentCachingChain(benchmark::State &state) {
+  // the order of the default chain of klee
+  Solver *core = createCoreSolver(CoreSolverToUse);
+  if (!core) {
+    state.SkipWithError("no core solver");
+    return;
+  }
+  runCached(state,
+            createCachingSolver(
+                createCexCachingSolver(createIndependentSolver(core))),
+            evaluate);
+}
+BENCHMARK(BM_IndependentCachingChain);
+
+} // namespace
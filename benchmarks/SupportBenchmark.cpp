@@ -0,0 +1,87 @@
+//===-- SupportBenchmark.cpp ----------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "benchmark/benchmark.h"
+
+#include "klee/ADT/DiscretePDF.h"
+#include "klee/Statistics/Statistic.h"
+#include "klee/Statistics/Statistics.h"
+#include "klee/Support/Timer.h"
+#include "klee/System/Time.h"
+
+#include <memory>
+#include <random>
+#include <vector>
+
+using namespace klee;
+
+namespace {
+
+Statistic hotStat("BenchmarkHot", "BHot");
+Statistic coldStat("BenchmarkCold", "BCold");
+
+void BM_DiscretePDFInsertRemove(benchmark::State &state) {
+  const unsigned size = state.range(0);
+  std::mt19937 rng(0);
+  std::uniform_real_distribution<double> weight(0.0, 1.0);
+  for (auto _ : state) {
+    DiscretePDF<unsigned> pdf;
+    for (unsigned i = 0; i < size; ++i)
+      pdf.insert(i, weight(rng));
+    for (unsigned i = 0; i < size; ++i)
+      pdf.remove(i);
+  }
+  state.SetItemsProcessed(state.iterations() * size);
+}
+BENCHMARK(BM_DiscretePDFInsertRemove)->Arg(64)->Arg(4096);
+
+void BM_DiscretePDFChooseUpdate(benchmark::State &state) {
+  // the selection loop of the weighted random searchers
+  const unsigned size = state.range(0);
+  std::mt19937 rng(0);
+  std::uniform_real_distribution<double> unit(0.0, 1.0);
+  DiscretePDF<unsigned> pdf;
+  for (unsigned i = 0; i < size; ++i)
+    pdf.insert(i, unit(rng));
+
+  for (auto _ : state) {
+    unsigned item = pdf.choose(unit(rng));
+    pdf.update(item, unit(rng));
+  }
+}
+BENCHMARK(BM_DiscretePDFChooseUpdate)->Arg(64)->Arg(4096);
+
+void BM_TimerGroupInvoke(benchmark::State &state) {
+  // the executor polls its timers once per instruction
+  TimerGroup timers(time::milliseconds(100));
+  unsigned fired = 0;
+  timers.add(std::make_unique<Timer>(time::seconds(1), [&] { ++fired; }));
+
+  for (auto _ : state)
+    timers.invoke();
+  benchmark::DoNotOptimize(fired);
+}
+BENCHMARK(BM_TimerGroupInvoke);
+
+void BM_IndexedStatisticIncrement(benchmark::State &state) {
+  // the per-instruction counters, with the row of one instruction per step
+  const unsigned indices = 1 << 16;
+  theStatisticManager->useIndexedStats(indices, {&hotStat});
+
+  unsigned i = 0;
+  for (auto _ : state) {
+    theStatisticManager->setIndex((i++ * 40503U) % indices);
+    ++hotStat;
+  }
+  benchmark::DoNotOptimize(theStatisticManager->getIndexedValue(hotStat, 0));
+  benchmark::DoNotOptimize(coldStat.getValue());
+}
+BENCHMARK(BM_IndexedStatisticIncrement);
+
+} // namespace
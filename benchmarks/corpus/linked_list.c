@@ -0,0 +1,61 @@
+// Builds a singly linked list of nondeterministic length and data, then
+// sorts and searches it, after the heap-manipulation tasks of SV-COMP.
+#include "sv-comp.h"
+
+#include <stdlib.h>
+
+struct node {
+  int data;
+  struct node *next;
+};
+
+static struct node *push(struct node *head, int data) {
+  struct node *n = malloc(sizeof(*n));
+  if (!n)
+    abort();
+  n->data = data;
+  n->next = head;
+  return n;
+}
+
+static void sort(struct node *head) {
+  for (struct node *i = head; i; i = i->next)
+    for (struct node *j = i->next; j; j = j->next)
+      if (j->data < i->data) {
+        int t = i->data;
+        i->data = j->data;
+        j->data = t;
+      }
+}
+
+int main(void) {
+  unsigned len = __VERIFIER_nondet_uint();
+  __VERIFIER_assume(len > 0 && len <= 6);
+
+  struct node *head = 0;
+  for (unsigned i = 0; i < len; ++i) {
+    int data = __VERIFIER_nondet_int();
+    __VERIFIER_assume(data >= 0 && data < 100);
+    head = push(head, data);
+  }
+
+  sort(head);
+  for (struct node *n = head; n && n->next; n = n->next)
+    if (n->data > n->next->data)
+      reach_error();
+
+  // a use after free on lists that contain the key twice
+  int key = __VERIFIER_nondet_int();
+  struct node *found = 0;
+  while (head) {
+    struct node *next = head->next;
+    if (head->data == key) {
+      if (found && found->data == key)
+        break;
+      found = head;
+    }
+    free(head);
+    head = next;
+  }
+  return found ? 1 : 0;
+}
@@ -0,0 +1,22 @@
+// A counting loop with a nondeterministic bound and step, after the
+// loop-acceleration tasks of SV-COMP. Every iteration forks.
+#include "sv-comp.h"
+
+int main(void) {
+  unsigned n = __VERIFIER_nondet_uint();
+  __VERIFIER_assume(n <= 24);
+
+  unsigned i = 0, even = 0, odd = 0;
+  while (i < n) {
+    if (__VERIFIER_nondet_int() > 0)
+      even += 2;
+    else
+      odd += 1;
+    ++i;
+  }
+
+  // fails on the paths that only ever take the first branch
+  if (n > 20 && even == 2 * n)
+    reach_error();
+  return 0;
+}
@@ -0,0 +1,35 @@
+// Naive substring search over a nondeterministic text and pattern, the
+// string-processing workload of SV-COMP's array category.
+#include "sv-comp.h"
+
+#define TEXT 12
+#define PATTERN 3
+
+static int find(const char *text, const char *pattern) {
+  for (int i = 0; text[i]; ++i) {
+    int j = 0;
+    while (pattern[j] && text[i + j] == pattern[j])
+      ++j;
+    if (!pattern[j])
+      return i;
+  }
+  return -1;
+}
+
+int main(void) {
+  char text[TEXT + 1], pattern[PATTERN + 1];
+  for (int i = 0; i < TEXT; ++i) {
+    text[i] = __VERIFIER_nondet_char();
+    __VERIFIER_assume(text[i] >= 'a' && text[i] <= 'c');
+  }
+  text[TEXT] = 0;
+  for (int i = 0; i < PATTERN; ++i) {
+    pattern[i] = __VERIFIER_nondet_char();
+    __VERIFIER_assume(pattern[i] >= 'a' && pattern[i] <= 'c');
+  }
+  pattern[PATTERN] = 0;
+
+  if (find(text, pattern) == TEXT - PATTERN)
+    reach_error();
+  return 0;
+}
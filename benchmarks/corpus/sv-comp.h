@@ -0,0 +1,43 @@
+//===-- sv-comp.h -----------------------------------------------*- C -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// The SV-COMP verifier interface in terms of klee intrinsics, so that the
+// corpus programs read like the competition tasks they are modelled on.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_BENCHMARK_SV_COMP_H
+#define KLEE_BENCHMARK_SV_COMP_H
+
+#include "klee/klee.h"
+
+#define reach_error()                                                          \
+  klee_report_error(__FILE__, __LINE__, "reach_error", "reach.err")
+
+static inline int __VERIFIER_nondet_int(void) {
+  int x;
+  klee_make_symbolic(&x, sizeof(x), "nondet_int");
+  return x;
+}
+
+static inline unsigned __VERIFIER_nondet_uint(void) {
+  unsigned x;
+  klee_make_symbolic(&x, sizeof(x), "nondet_uint");
+  return x;
+}
+
+static inline char __VERIFIER_nondet_char(void) {
+  char x;
+  klee_make_symbolic(&x, sizeof(x), "nondet_char");
+  return x;
+}
+
+static inline void __VERIFIER_assume(int cond) { klee_assume(cond != 0); }
+
+#endif /* KLEE_BENCHMARK_SV_COMP_H */
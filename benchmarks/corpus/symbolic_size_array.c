@@ -0,0 +1,29 @@
+// Allocates an array of nondeterministic size and accesses it at
+// nondeterministic indices, with an off-by-one in the bounds check.
+#include "sv-comp.h"
+
+#include <stdlib.h>
+
+int main(void) {
+  unsigned size = __VERIFIER_nondet_uint();
+  __VERIFIER_assume(size > 0 && size <= 64);
+
+  int *a = malloc(size * sizeof(*a));
+  if (!a)
+    return 0;
+  for (unsigned i = 0; i < size; ++i)
+    a[i] = i * i;
+
+  unsigned idx = __VERIFIER_nondet_uint();
+  int sum = 0;
+  for (unsigned k = 0; k < 4; ++k) {
+    if (idx <= size) // should be <
+      sum += a[idx];
+    idx = (idx * 7 + k) % (size + 1);
+  }
+
+  if (sum == 1000)
+    reach_error();
+  free(a);
+  return 0;
+}
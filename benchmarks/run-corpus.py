@@ -0,0 +1,166 @@
+#!/usr/bin/env python3
+# -*- encoding: utf-8 -*-
+
+# ===-- run-corpus.py -----------------------------------------------------===##
+#
+#                      The KLEE Symbolic Virtual Machine
+#
+#  This file is distributed under the University of Illinois Open Source
+#  License. See LICENSE.TXT for details.
+#
+# ===----------------------------------------------------------------------===##
+
+"""Run klee over the benchmark corpus and report its throughput.
+
+Every program of the corpus is compiled to bitcode and explored with the same
+fixed set of options (deterministic allocation, a fixed searcher and klee's
+fixed random seed), so that two builds of klee can be compared on equal terms.
+For each program the driver reports, from run.stats and the process itself:
+
+  instructions/s    executed instructions over the wall time
+  states/s          explored paths over the wall time
+  queries/s         solver queries over the wall time
+  peak RSS          maximum resident set size of the klee process
+  first error       wall time until the first error test case was written
+"""
+
+import argparse
+import glob
+import json
+import os
+import re
+import shutil
+import sqlite3
+import subprocess
+import sys
+import time
+
+KLEE_OPTIONS = [
+    '--allocate-determ',
+    '--search=dfs',
+    '--use-forked-solver=false',
+    '--max-memory=4000',
+]
+
+
+def compile_program(cc, include_dir, source, bitcode):
+    subprocess.check_call([cc, '-c', '-emit-llvm', '-g', '-O0',
+                           '-Xclang', '-disable-O0-optnone',
+                           '-I', include_dir, source, '-o', bitcode])
+
+
+def read_run_stats(output_dir):
+    """Returns the final row of run.stats as a dictionary."""
+    connection = sqlite3.connect(os.path.join(output_dir, 'run.stats'))
+    try:
+        cursor = connection.execute(
+            'SELECT * FROM stats ORDER BY rowid DESC LIMIT 1')
+        names = [column[0] for column in cursor.description]
+        row = cursor.fetchone()
+    finally:
+        connection.close()
+    return dict(zip(names, row)) if row else {}
+
+
+def read_explored_paths(output_dir):
+    with open(os.path.join(output_dir, 'info')) as info:
+        match = re.search(r'KLEE: done: explored paths = (\d+)', info.read())
+    return int(match.group(1)) if match else 0
+
+
+def time_to_first_error(output_dir, start):
+    errors = glob.glob(os.path.join(output_dir, 'test*.err'))
+    if not errors:
+        return None
+    return min(os.path.getmtime(error) for error in errors) - start
+
+
+def run_program(klee, bitcode, output_dir, max_time, extra_options):
+    if os.path.exists(output_dir):
+        shutil.rmtree(output_dir)
+    command = ([klee, '--output-dir=' + output_dir,
+                '--max-time=' + max_time] + KLEE_OPTIONS + extra_options +
+               [bitcode])
+    start = time.time()
+    with open(os.devnull, 'w') as devnull:
+        process = subprocess.Popen(command, stdout=devnull, stderr=devnull)
+        _, status, usage = os.wait4(process.pid, 0)
+    if not os.WIFEXITED(status) or os.WEXITSTATUS(status) != 0:
+        raise RuntimeError('klee failed on {}'.format(bitcode))
+
+    stats = read_run_stats(output_dir)
+    states = read_explored_paths(output_dir)
+    wall_time = stats.get('WallTime', 0) / 1e6 or (time.time() - start)
+    return {
+        'wall_time_s': wall_time,
+        'instructions': stats.get('Instructions', 0),
+        'instructions_per_s': stats.get('Instructions', 0) / wall_time,
+        'states': states,
+        'states_per_s': states / wall_time,
+        'queries': stats.get('NumQueries', 0),
+        'queries_per_s': stats.get('NumQueries', 0) / wall_time,
+        # ru_maxrss is in kilobytes on Linux
+        'peak_rss_mb': usage.ru_maxrss / 1024.0,
+        'time_to_first_error_s': time_to_first_error(output_dir, start),
+    }
+
+
+def print_table(results):
+    print('{:<24} {:>10} {:>12} {:>10} {:>10} {:>10} {:>12}'.format(
+        'Program', 'Time(s)', 'Instrs/s', 'States/s', 'Queries/s',
+        'RSS(MB)', 'FirstErr(s)'))
+    for name, r in sorted(results.items()):
+        first_error = r['time_to_first_error_s']
+        print('{:<24} {:>10.2f} {:>12.0f} {:>10.1f} {:>10.1f} {:>10.1f} '
+              '{:>12}'.format(
+                  name, r['wall_time_s'], r['instructions_per_s'],
+                  r['states_per_s'], r['queries_per_s'], r['peak_rss_mb'],
+                  '-' if first_error is None else
+                  '{:.2f}'.format(first_error)))
+
+
+def main():
+    here = os.path.dirname(os.path.abspath(__file__))
+    parser = argparse.ArgumentParser(
+        description=__doc__, formatter_class=argparse.RawTextHelpFormatter)
+    parser.add_argument('--klee', default='klee', help='klee binary')
+    parser.add_argument('--cc', default='clang',
+                        help='C compiler that emits LLVM bitcode')
+    parser.add_argument('--include-dir',
+                        default=os.path.join(here, '..', 'include'),
+                        help='directory holding klee/klee.h')
+    parser.add_argument('--corpus', default=os.path.join(here, 'corpus'),
+                        help='directory of the corpus programs')
+    parser.add_argument('--work-dir', default='corpus-runs',
+                        help='directory for bitcode and klee output')
+    parser.add_argument('--max-time', default='60s',
+                        help='time budget of klee per program')
+    parser.add_argument('--json', help='also write the results to this file')
+    parser.add_argument('programs', nargs='*',
+                        help='names of programs to run (default: all)')
+    args, extra_options = parser.parse_known_args()
+
+    os.makedirs(args.work_dir, exist_ok=True)
+    sources = sorted(glob.glob(os.path.join(args.corpus, '*.c')))
+    results = {}
+    for source in sources:
+        name = os.path.splitext(os.path.basename(source))[0]
+        if args.programs and name not in args.programs:
+            continue
+        bitcode = os.path.join(args.work_dir, name + '.bc')
+        compile_program(args.cc, args.include_dir, source, bitcode)
+        results[name] = run_program(args.klee, bitcode,
+                                    os.path.join(args.work_dir, name + '.out'),
+                                    args.max_time, extra_options)
+
+    print_table(results)
+    if args.json:
+        with open(args.json, 'w') as f:
+            json.dump({'options': KLEE_OPTIONS + extra_options,
+                       'max_time': args.max_time,
+                       'results': results}, f, indent=2, sort_keys=True)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
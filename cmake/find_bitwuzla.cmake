@@ -0,0 +1,37 @@
+#===------------------------------------------------------------------------===#
+#
+#                     The KLEE Symbolic Virtual Machine
+#
+# This file is distributed under the University of Illinois Open Source
+# License. See LICENSE.TXT for details.
+#
+#===------------------------------------------------------------------------===#
+
+find_package(Bitwuzla)
+# Set the default so that if the following is true:
+# * Bitwuzla was found
+# * ENABLE_SOLVER_BITWUZLA is not already set as a cache variable
+#
+# then the default is set to `ON`. Otherwise set the default to `OFF`.
+if (Bitwuzla_FOUND)
+  set(ENABLE_SOLVER_BITWUZLA_DEFAULT ON)
+else()
+  set(ENABLE_SOLVER_BITWUZLA_DEFAULT OFF)
+endif()
+option(ENABLE_SOLVER_BITWUZLA "Enable Bitwuzla solver support"
+  ${ENABLE_SOLVER_BITWUZLA_DEFAULT})
+
+if (ENABLE_SOLVER_BITWUZLA)
+  message(STATUS "Bitwuzla solver support enabled")
+  if (Bitwuzla_FOUND)
+    message(STATUS "Found Bitwuzla")
+    set(ENABLE_BITWUZLA 1) # For config.h
+    list(APPEND KLEE_COMPONENT_EXTRA_INCLUDE_DIRS ${Bitwuzla_INCLUDE_DIRS})
+    list(APPEND KLEE_SOLVER_LIBRARIES ${Bitwuzla_LIBRARIES})
+  else()
+    message(FATAL_ERROR "Bitwuzla not found.")
+  endif()
+else()
+  message(STATUS "Bitwuzla solver support disabled")
+  set(ENABLE_BITWUZLA 0) # For config.h
+endif()
@@ -10,6 +10,10 @@
 #ifndef KLEE_BITARRAY_H
 #define KLEE_BITARRAY_H
 
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
 namespace klee {
 
   // XXX would be nice not to have
@@ -42,10 +46,10 @@ public:
 
   void resize(unsigned newSize, bool value = false) {
     uint32_t *oldBits = bits;
-    if (newSize)
-      bits = new uint32_t[length(newSize)];
+    bits = newSize ? new uint32_t[length(newSize)] : 0;
     if (oldBits) {
-      memcpy(bits, oldBits, sizeof(*bits)*length(std::min(_size, newSize)));
+      if (bits)
+        memcpy(bits, oldBits, sizeof(*bits)*length(std::min(_size, newSize)));
       delete[] oldBits;
     }
     for (unsigned i = _size; i < newSize; i++)
@@ -57,6 +61,58 @@ public:
   void set(unsigned idx) { bits[idx/32] |= 1<<(idx&0x1F); }
   void unset(unsigned idx) { bits[idx/32] &= ~(1<<(idx&0x1F)); }
   void set(unsigned idx, bool value) { if (value) set(idx); else unset(idx); }
+
+  /// Whether all bits in [begin, end) are set.
+  bool allSet(unsigned begin, unsigned end) const {
+    return findFirstUnset(begin, end) == end;
+  }
+  /// Whether any bit in [begin, end) is set.
+  bool anySet(unsigned begin, unsigned end) const {
+    return findFirstSet(begin, end) != end;
+  }
+  /// The index of the first set bit in [begin, end), or end.
+  unsigned findFirstSet(unsigned begin, unsigned end) const {
+    return findFirst(begin, end, 0);
+  }
+  /// The index of the first unset bit in [begin, end), or end.
+  unsigned findFirstUnset(unsigned begin, unsigned end) const {
+    return findFirst(begin, end, ~0u);
+  }
+  /// Set all bits in [begin, end).
+  void setRange(unsigned begin, unsigned end) {
+    while (begin < end) {
+      unsigned n = std::min(32 - (begin & 0x1F), end - begin);
+      bits[begin/32] |= rangeMask(begin, n);
+      begin += n;
+    }
+  }
+  /// Unset all bits in [begin, end).
+  void unsetRange(unsigned begin, unsigned end) {
+    while (begin < end) {
+      unsigned n = std::min(32 - (begin & 0x1F), end - begin);
+      bits[begin/32] &= ~rangeMask(begin, n);
+      begin += n;
+    }
+  }
+
+private:
+  /// The mask of the n bits from idx on, within the word holding idx.
+  static uint32_t rangeMask(unsigned idx, unsigned n) {
+    return (n == 32 ? ~0u : (1u << n) - 1) << (idx & 0x1F);
+  }
+
+  /// The index of the first bit in [begin, end) that differs from the bits
+  /// of skip, or end. Whole words equal to skip are passed over at once.
+  unsigned findFirst(unsigned begin, unsigned end, uint32_t skip) const {
+    while (begin < end) {
+      unsigned n = std::min(32 - (begin & 0x1F), end - begin);
+      uint32_t found = (bits[begin/32] ^ skip) & rangeMask(begin, n);
+      if (found)
+        return (begin & ~0x1Fu) + __builtin_ctz(found);
+      begin += n;
+    }
+    return end;
+  }
 };
 
 } // End klee namespace
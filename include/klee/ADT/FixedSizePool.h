@@ -0,0 +1,127 @@
+//===-- FixedSizePool.h -----------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_FIXEDSIZEPOOL_H
+#define KLEE_FIXEDSIZEPOOL_H
+
+#include "klee/Statistics/MemoryAccount.h"
+
+#include "llvm/Support/ErrorHandling.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdlib>
+#include <vector>
+
+namespace klee {
+
+/// A pool of equally sized memory blocks, carved out of large chunks and
+/// recycled through a free list. Used for the small objects that are
+/// created and destroyed in large numbers when states fork, to avoid the
+/// per-allocation overhead and fragmentation of the general heap.
+class FixedSizePool {
+  struct FreeBlock {
+    FreeBlock *next;
+  };
+
+  size_t blockSize;
+  size_t blocksPerChunk;
+  std::vector<void *> chunks;
+  FreeBlock *freeList = nullptr;
+  size_t liveBlocks = 0;
+  MemoryAccount *account;
+
+  void grow() {
+    char *chunk = static_cast<char *>(std::malloc(blockSize * blocksPerChunk));
+    if (!chunk)
+      llvm::report_bad_alloc_error("out of memory for a FixedSizePool chunk");
+    chunks.push_back(chunk);
+    if (account)
+      account->add(blockSize * blocksPerChunk);
+    for (size_t i = blocksPerChunk; i-- > 0;) {
+      auto *block = reinterpret_cast<FreeBlock *>(chunk + i * blockSize);
+      block->next = freeList;
+      freeList = block;
+    }
+  }
+
+public:
+  /// \param size size of a block in bytes
+  /// \param chunkSize size of the chunks the blocks are taken from
+  /// \param account the account charged with the chunks, if any
+  explicit FixedSizePool(size_t size, size_t chunkSize = 64 * 1024,
+                         MemoryAccount *account = nullptr)
+      : account(account) {
+    constexpr size_t align = alignof(std::max_align_t);
+    blockSize = (std::max(size, sizeof(FreeBlock)) + align - 1) & ~(align - 1);
+    blocksPerChunk = std::max<size_t>(1, chunkSize / blockSize);
+  }
+
+  FixedSizePool(const FixedSizePool &) = delete;
+  FixedSizePool &operator=(const FixedSizePool &) = delete;
+
+  ~FixedSizePool() {
+    // blocks that are still in use must stay valid
+    if (liveBlocks == 0)
+      release();
+  }
+
+  size_t getBlockSize() const { return blockSize; }
+
+  void *allocate() {
+    if (!freeList)
+      grow();
+    FreeBlock *block = freeList;
+    freeList = block->next;
+    ++liveBlocks;
+    return block;
+  }
+
+  void deallocate(void *p) {
+    assert(liveBlocks > 0 && "deallocating from an empty pool");
+    auto *block = static_cast<FreeBlock *>(p);
+    block->next = freeList;
+    freeList = block;
+    --liveBlocks;
+  }
+
+  /// Number of blocks currently handed out.
+  size_t getLiveCount() const { return liveBlocks; }
+
+  /// Number of blocks the pool can hand out without growing.
+  size_t getCapacity() const { return chunks.size() * blocksPerChunk; }
+
+  /// Bytes reserved by the pool.
+  size_t getReservedSize() const {
+    return chunks.size() * blocksPerChunk * blockSize;
+  }
+
+  /// Return all chunks to the system if no block is in use.
+  bool releaseIfUnused() {
+    if (liveBlocks != 0)
+      return false;
+    release();
+    return true;
+  }
+
+private:
+  void release() {
+    if (account)
+      account->remove(getReservedSize());
+    for (void *chunk : chunks)
+      std::free(chunk);
+    chunks.clear();
+    freeList = nullptr;
+  }
+};
+
+} // End klee namespace
+
+#endif /* KLEE_FIXEDSIZEPOOL_H */
@@ -0,0 +1,123 @@
+//===-- FlatDiscretePDF.h ---------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_FLATDISCRETEPDF_H
+#define KLEE_FLATDISCRETEPDF_H
+
+#include <cassert>
+#include <cstddef>
+#include <unordered_map>
+#include <vector>
+
+namespace klee {
+
+/// FlatDiscretePDF - A discrete distribution over items with the interface
+/// of DiscretePDF, kept in arrays instead of a balanced tree of nodes.
+///
+/// The weights are the leaves of a complete binary tree stored in one
+/// vector, in which every inner node holds the sum of its two children.
+/// Updates and choices walk one path of that tree, and removing an item
+/// moves the last one into its slot, so no memory is allocated per item.
+/// Sums are recomputed from the children on each update, so they do not
+/// drift as they would with incremental differences.
+template <class T> class FlatDiscretePDF {
+  typedef double weight_type;
+
+  std::vector<T> items;
+  std::unordered_map<T, std::size_t> positions;
+  /// The tree of sums, the leaf of item i is at capacity + i
+  std::vector<weight_type> sums;
+  std::size_t capacity = 0;
+
+  void setLeaf(std::size_t index, weight_type weight) {
+    std::size_t n = capacity + index;
+    sums[n] = weight;
+    for (n /= 2; n; n /= 2)
+      sums[n] = sums[2 * n] + sums[2 * n + 1];
+  }
+
+  void grow() {
+    std::size_t newCapacity = capacity ? 2 * capacity : 16;
+    std::vector<weight_type> newSums(2 * newCapacity, 0);
+    for (std::size_t i = 0; i < items.size(); ++i)
+      newSums[newCapacity + i] = sums[capacity + i];
+    for (std::size_t n = newCapacity - 1; n; --n)
+      newSums[n] = newSums[2 * n] + newSums[2 * n + 1];
+    sums.swap(newSums);
+    capacity = newCapacity;
+  }
+
+public:
+  bool empty() const { return items.empty(); }
+
+  void insert(T item, weight_type weight) {
+    assert(!positions.count(item) && "insert: argument(item) already in tree");
+    if (items.size() == capacity)
+      grow();
+    positions[item] = items.size();
+    items.push_back(item);
+    setLeaf(items.size() - 1, weight);
+  }
+
+  void update(T item, weight_type newWeight) {
+    auto it = positions.find(item);
+    assert(it != positions.end() && "update: argument(item) not in tree");
+    setLeaf(it->second, newWeight);
+  }
+
+  void remove(T item) {
+    auto it = positions.find(item);
+    assert(it != positions.end() && "remove: argument(item) not in tree");
+    std::size_t index = it->second;
+    positions.erase(it);
+
+    std::size_t last = items.size() - 1;
+    if (index != last) {
+      items[index] = items[last];
+      positions[items[index]] = index;
+      setLeaf(index, sums[capacity + last]);
+    }
+    items.pop_back();
+    setLeaf(last, 0);
+  }
+
+  bool inTree(T item) const { return positions.count(item); }
+
+  weight_type getWeight(T item) const {
+    auto it = positions.find(item);
+    assert(it != positions.end());
+    return sums[capacity + it->second];
+  }
+
+  /// Pick an item according to its weight. p should be in [0,1).
+  T choose(double p) const {
+    assert(!((p < 0.0) || (p >= 1.0)) &&
+           "choose: argument(p) outside valid range");
+    assert(!empty() && "choose: choose() called on empty tree");
+
+    weight_type w = (weight_type)(sums[1] * p);
+    std::size_t n = 1;
+    while (n < capacity) {
+      // the right child may hold no item at all when rounding overshoots
+      if (w < sums[2 * n] || sums[2 * n + 1] == 0) {
+        n = 2 * n;
+      } else {
+        w -= sums[2 * n];
+        n = 2 * n + 1;
+      }
+    }
+
+    std::size_t index = n - capacity;
+    return items[index < items.size() ? index : items.size() - 1];
+  }
+};
+
+} // namespace klee
+
+#endif /* KLEE_FLATDISCRETEPDF_H */
@@ -0,0 +1,463 @@
+//===-- ImmutableBTreeMap.h -------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_IMMUTABLEBTREEMAP_H
+#define KLEE_IMMUTABLEBTREEMAP_H
+
+#include "klee/ADT/Ref.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <functional>
+#include <utility>
+#include <vector>
+
+namespace klee {
+
+/// ImmutableBTreeMap - A persistent map with the interface of ImmutableMap,
+/// implemented as a B+ tree with up to B values per leaf and B children per
+/// inner node. Updates copy the nodes on the path to the changed leaf, which
+/// is a few wide nodes instead of the many single-value nodes of the AVL
+/// tree behind ImmutableMap, and lookups visit as few nodes.
+///
+/// Keys and data must be default constructible.
+template <class K, class D, class CMP = std::less<K>, unsigned B = 16>
+class ImmutableBTreeMap {
+  static_assert(B >= 8, "nodes must be wide enough to bound the depth");
+
+public:
+  typedef K key_type;
+  typedef std::pair<K, D> value_type;
+  class iterator;
+
+private:
+  /// Bounds the depth: every node but the root has at least B / 2 entries.
+  static const unsigned MaxDepth = 16;
+
+  struct Node {
+    class ReferenceCounter _refCount;
+    const bool leaf;
+    /// The number of values of a leaf or children of an inner node.
+    unsigned count = 0;
+    /// The number of values in the subtree.
+    size_t size = 0;
+
+    explicit Node(bool leaf) : leaf(leaf) {}
+    virtual ~Node() = default;
+  };
+
+  struct Leaf : Node {
+    value_type values[B];
+    Leaf() : Node(true) {}
+  };
+
+  struct Inner : Node {
+    /// The smallest key below each child.
+    key_type lows[B]{};
+    ref<Node> children[B];
+    Inner() : Node(false) {}
+  };
+
+  ref<Node> root;
+
+  explicit ImmutableBTreeMap(ref<Node> root) : root(std::move(root)) {}
+
+  static const Leaf *asLeaf(const Node *n) {
+    return static_cast<const Leaf *>(n);
+  }
+  static const Inner *asInner(const Node *n) {
+    return static_cast<const Inner *>(n);
+  }
+
+  static const key_type &lowOf(const Node *n) {
+    return n->leaf ? asLeaf(n)->values[0].first : asInner(n)->lows[0];
+  }
+
+  /// The child of inner whose keys include key, if any do.
+  static unsigned childIndex(const Inner *inner, const key_type &key) {
+    return std::upper_bound(inner->lows + 1, inner->lows + inner->count,
+                            key, CMP()) -
+           inner->lows - 1;
+  }
+
+  static unsigned leafLowerBound(const Leaf *leaf, const key_type &key) {
+    return std::lower_bound(leaf->values, leaf->values + leaf->count, key,
+                            [](const value_type &v, const key_type &k) {
+                              return CMP()(v.first, k);
+                            }) -
+           leaf->values;
+  }
+
+  static unsigned leafUpperBound(const Leaf *leaf, const key_type &key) {
+    return std::upper_bound(leaf->values, leaf->values + leaf->count, key,
+                            [](const key_type &k, const value_type &v) {
+                              return CMP()(k, v.first);
+                            }) -
+           leaf->values;
+  }
+
+  static void updateSize(Inner *inner) {
+    inner->size = 0;
+    for (unsigned i = 0; i < inner->count; ++i)
+      inner->size += inner->children[i]->size;
+  }
+
+  static Node *makeLeaf(const value_type *begin, const value_type *end) {
+    Leaf *leaf = new Leaf();
+    leaf->count = leaf->size = end - begin;
+    std::copy(begin, end, leaf->values);
+    return leaf;
+  }
+
+  static Node *makeInner(const ref<Node> *begin, const ref<Node> *end) {
+    Inner *inner = new Inner();
+    inner->count = end - begin;
+    for (unsigned i = 0; i < inner->count; ++i) {
+      inner->children[i] = begin[i];
+      inner->lows[i] = lowOf(begin[i].get());
+    }
+    updateSize(inner);
+    return inner;
+  }
+
+  /// Inserts value below n, replacing the value with the same key iff
+  /// replace is set. \return the updated copy of n, or null if nothing
+  /// changed. If the copy overflowed, it is split and its upper half is
+  /// returned in split
+  static ref<Node> insert(const Node *n, const value_type &value,
+                          bool replace, ref<Node> &split) {
+    if (n->leaf) {
+      const Leaf *leaf = asLeaf(n);
+      unsigned pos = leafLowerBound(leaf, value.first);
+      if (pos < leaf->count && !CMP()(value.first, leaf->values[pos].first)) {
+        if (!replace)
+          return nullptr;
+        Leaf *copy = new Leaf(*leaf);
+        copy->values[pos] = value;
+        return copy;
+      }
+      if (leaf->count < B) {
+        Leaf *copy = new Leaf(*leaf);
+        std::move_backward(copy->values + pos, copy->values + copy->count,
+                           copy->values + copy->count + 1);
+        copy->values[pos] = value;
+        copy->size = ++copy->count;
+        return copy;
+      }
+      std::vector<value_type> values(leaf->values, leaf->values + B);
+      values.insert(values.begin() + pos, value);
+      unsigned half = values.size() / 2;
+      split = makeLeaf(values.data() + half, values.data() + values.size());
+      return makeLeaf(values.data(), values.data() + half);
+    }
+
+    const Inner *inner = asInner(n);
+    unsigned idx = childIndex(inner, value.first);
+    ref<Node> childSplit;
+    ref<Node> child =
+        insert(inner->children[idx].get(), value, replace, childSplit);
+    if (!child)
+      return nullptr;
+    if (!childSplit || inner->count < B) {
+      Inner *copy = new Inner(*inner);
+      copy->children[idx] = child;
+      copy->lows[idx] = lowOf(child.get());
+      if (childSplit) {
+        std::move_backward(copy->children + idx + 1,
+                           copy->children + copy->count,
+                           copy->children + copy->count + 1);
+        std::move_backward(copy->lows + idx + 1, copy->lows + copy->count,
+                           copy->lows + copy->count + 1);
+        copy->children[idx + 1] = childSplit;
+        copy->lows[idx + 1] = lowOf(childSplit.get());
+        ++copy->count;
+      }
+      updateSize(copy);
+      return copy;
+    }
+    std::vector<ref<Node>> children(inner->children, inner->children + B);
+    children[idx] = child;
+    children.insert(children.begin() + idx + 1, childSplit);
+    unsigned half = children.size() / 2;
+    split = makeInner(children.data() + half,
+                      children.data() + children.size());
+    return makeInner(children.data(), children.data() + half);
+  }
+
+  /// Evens out the underfull child idx of inner with a sibling, merging
+  /// them if they fit into one node.
+  static void rebalance(Inner *inner, unsigned idx) {
+    unsigned l = idx > 0 ? idx - 1 : idx, r = l + 1;
+    const Node *left = inner->children[l].get();
+    const Node *right = inner->children[r].get();
+    ref<Node> merged[2];
+    unsigned total = left->count + right->count;
+    unsigned half = total <= B ? total : total / 2;
+    if (left->leaf) {
+      std::vector<value_type> values(asLeaf(left)->values,
+                                     asLeaf(left)->values + left->count);
+      values.insert(values.end(), asLeaf(right)->values,
+                    asLeaf(right)->values + right->count);
+      merged[0] = makeLeaf(values.data(), values.data() + half);
+      if (half < total)
+        merged[1] = makeLeaf(values.data() + half, values.data() + total);
+    } else {
+      std::vector<ref<Node>> children(asInner(left)->children,
+                                      asInner(left)->children + left->count);
+      children.insert(children.end(), asInner(right)->children,
+                      asInner(right)->children + right->count);
+      merged[0] = makeInner(children.data(), children.data() + half);
+      if (half < total)
+        merged[1] = makeInner(children.data() + half, children.data() + total);
+    }
+    inner->children[l] = merged[0];
+    inner->lows[l] = lowOf(merged[0].get());
+    if (merged[1]) {
+      inner->children[r] = merged[1];
+      inner->lows[r] = lowOf(merged[1].get());
+      return;
+    }
+    std::move(inner->children + r + 1, inner->children + inner->count,
+              inner->children + r);
+    std::move(inner->lows + r + 1, inner->lows + inner->count,
+              inner->lows + r);
+    inner->children[--inner->count] = nullptr;
+  }
+
+  /// Removes key below n. \return the updated copy of n, which may be
+  /// underfull or empty, or null if key is not below n
+  static ref<Node> remove(const Node *n, const key_type &key) {
+    if (n->leaf) {
+      const Leaf *leaf = asLeaf(n);
+      unsigned pos = leafLowerBound(leaf, key);
+      if (pos == leaf->count || CMP()(key, leaf->values[pos].first))
+        return nullptr;
+      Leaf *copy = new Leaf(*leaf);
+      std::move(copy->values + pos + 1, copy->values + copy->count,
+                copy->values + pos);
+      copy->size = --copy->count;
+      copy->values[copy->count] = value_type();
+      return copy;
+    }
+
+    const Inner *inner = asInner(n);
+    unsigned idx = childIndex(inner, key);
+    ref<Node> child = remove(inner->children[idx].get(), key);
+    if (!child)
+      return nullptr;
+    Inner *copy = new Inner(*inner);
+    if (child->count == 0) {
+      std::move(copy->children + idx + 1, copy->children + copy->count,
+                copy->children + idx);
+      std::move(copy->lows + idx + 1, copy->lows + copy->count,
+                copy->lows + idx);
+      copy->children[--copy->count] = nullptr;
+    } else {
+      copy->children[idx] = child;
+      copy->lows[idx] = lowOf(child.get());
+      if (child->count < B / 2 && copy->count > 1)
+        rebalance(copy, idx);
+    }
+    updateSize(copy);
+    return copy;
+  }
+
+  /// The first value not less than (or, if upper is set, greater than) key.
+  iterator seek(const key_type &key, bool upper) const {
+    iterator it(root);
+    if (!root)
+      return it;
+    const Node *n = root.get();
+    for (; !n->leaf; n = asInner(n)->children[it.index[it.depth++]].get()) {
+      it.path[it.depth] = n;
+      it.index[it.depth] = childIndex(asInner(n), key);
+    }
+    const Leaf *leaf = asLeaf(n);
+    unsigned pos =
+        upper ? leafUpperBound(leaf, key) : leafLowerBound(leaf, key);
+    it.path[it.depth] = n;
+    if (pos < leaf->count) {
+      it.index[it.depth++] = pos;
+    } else {
+      // the value is the first of a later leaf, if any
+      it.index[it.depth++] = leaf->count - 1;
+      ++it;
+    }
+    return it;
+  }
+
+public:
+  ImmutableBTreeMap() = default;
+
+  bool empty() const { return !root; }
+  size_t size() const { return root ? root->size : 0; }
+
+  size_t count(const key_type &key) const { return lookup(key) ? 1 : 0; }
+
+  const value_type *lookup(const key_type &key) const {
+    if (!root)
+      return nullptr;
+    const Node *n = root.get();
+    while (!n->leaf)
+      n = asInner(n)->children[childIndex(asInner(n), key)].get();
+    const Leaf *leaf = asLeaf(n);
+    unsigned pos = leafLowerBound(leaf, key);
+    if (pos == leaf->count || CMP()(key, leaf->values[pos].first))
+      return nullptr;
+    return &leaf->values[pos];
+  }
+
+  /// The last value less than or equal to key, or null if there is none.
+  const value_type *lookup_previous(const key_type &key) const {
+    iterator it = upper_bound(key);
+    if (it == begin())
+      return nullptr;
+    --it;
+    return &*it;
+  }
+
+  const value_type &min() const { return *begin(); }
+  const value_type &max() const { return *--end(); }
+
+  ImmutableBTreeMap insert(const value_type &value) const {
+    return update(value, false);
+  }
+  ImmutableBTreeMap replace(const value_type &value) const {
+    return update(value, true);
+  }
+
+  ImmutableBTreeMap remove(const key_type &key) const {
+    if (!root)
+      return *this;
+    ref<Node> newRoot = remove(root.get(), key);
+    if (!newRoot)
+      return *this;
+    while (newRoot->count == 1 && !newRoot->leaf)
+      newRoot = asInner(newRoot.get())->children[0];
+    if (newRoot->count == 0)
+      newRoot = nullptr;
+    return ImmutableBTreeMap(std::move(newRoot));
+  }
+
+  iterator begin() const {
+    iterator it(root);
+    if (root)
+      it.descend(root.get(), true);
+    return it;
+  }
+  iterator end() const { return iterator(root); }
+
+  iterator find(const key_type &key) const {
+    iterator it = lower_bound(key);
+    if (it != end() && CMP()(key, it->first))
+      return end();
+    return it;
+  }
+  iterator lower_bound(const key_type &key) const { return seek(key, false); }
+  iterator upper_bound(const key_type &key) const { return seek(key, true); }
+
+private:
+  ImmutableBTreeMap update(const value_type &value, bool replace) const {
+    if (!root)
+      return ImmutableBTreeMap(makeLeaf(&value, &value + 1));
+    ref<Node> split;
+    ref<Node> newRoot = insert(root.get(), value, replace, split);
+    if (!newRoot)
+      return *this;
+    if (split) {
+      ref<Node> children[2] = {newRoot, split};
+      newRoot = makeInner(children, children + 2);
+    }
+    return ImmutableBTreeMap(std::move(newRoot));
+  }
+};
+
+/// A bidirectional iterator over the values in key order, which keeps the
+/// tree it iterates alive.
+template <class K, class D, class CMP, unsigned B>
+class ImmutableBTreeMap<K, D, CMP, B>::iterator {
+  friend class ImmutableBTreeMap<K, D, CMP, B>;
+
+  ref<Node> root;
+  /// The nodes from the root to the leaf of the current value and the
+  /// position in each, empty at the end.
+  const Node *path[MaxDepth];
+  unsigned index[MaxDepth];
+  unsigned depth = 0;
+
+  explicit iterator(ref<Node> root) : root(std::move(root)) {}
+
+  /// Extends the path down to the first or last value below n.
+  void descend(const Node *n, bool first) {
+    for (;;) {
+      assert(depth < MaxDepth && "tree too deep");
+      path[depth] = n;
+      index[depth] = first ? 0 : n->count - 1;
+      if (n->leaf) {
+        ++depth;
+        return;
+      }
+      n = asInner(n)->children[index[depth++]].get();
+    }
+  }
+
+public:
+  const value_type &operator*() const {
+    assert(depth && "dereferencing end");
+    return asLeaf(path[depth - 1])->values[index[depth - 1]];
+  }
+  const value_type *operator->() const { return &**this; }
+
+  bool operator==(const iterator &b) const {
+    if (depth != b.depth)
+      return false;
+    return !depth || (path[depth - 1] == b.path[depth - 1] &&
+                      index[depth - 1] == b.index[depth - 1]);
+  }
+  bool operator!=(const iterator &b) const { return !(*this == b); }
+
+  iterator &operator++() {
+    assert(depth && "incrementing end");
+    if (++index[depth - 1] < path[depth - 1]->count)
+      return *this;
+    for (unsigned d = depth - 1; d-- > 0;) {
+      if (++index[d] < path[d]->count) {
+        depth = d + 1;
+        descend(asInner(path[d])->children[index[d]].get(), true);
+        return *this;
+      }
+    }
+    depth = 0;
+    return *this;
+  }
+
+  iterator &operator--() {
+    if (!depth) {
+      if (root)
+        descend(root.get(), false);
+      return *this;
+    }
+    for (unsigned d = depth; d-- > 0;) {
+      if (index[d] > 0) {
+        --index[d];
+        depth = d + 1;
+        if (!path[d]->leaf)
+          descend(asInner(path[d])->children[index[d]].get(), false);
+        return *this;
+      }
+    }
+    assert(0 && "decrementing begin");
+    return *this;
+  }
+};
+
+} // namespace klee
+
+#endif /* KLEE_IMMUTABLEBTREEMAP_H */
@@ -0,0 +1,93 @@
+//===-- ImmutableList.h -----------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_IMMUTABLELIST_H
+#define KLEE_IMMUTABLELIST_H
+
+#include "klee/ADT/Ref.h"
+
+#include <cassert>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace klee {
+
+/// An append-only sequence whose elements are shared between copies.
+/// Copying the list and appending to it are O(1); the elements are never
+/// modified once appended, so all copies can keep sharing their common
+/// prefix.
+template <class T> class ImmutableList {
+  struct Node {
+    /// @brief Required by klee::ref-managed objects
+    class ReferenceCounter _refCount;
+    ref<Node> prev;
+    const T value;
+
+    template <class... Args>
+    Node(const ref<Node> &prev, Args &&...args)
+        : prev(prev), value(std::forward<Args>(args)...) {}
+  };
+
+  ref<Node> last;
+  size_t _size = 0;
+
+public:
+  ImmutableList() = default;
+  ImmutableList(const ImmutableList &) = default;
+  ImmutableList &operator=(const ImmutableList &) = default;
+
+  ~ImmutableList() {
+    // release the nodes only we own one by one instead of recursively, the
+    // lists can be very long
+    while (last && last->_refCount.getCount() == 1) {
+      ref<Node> prev = std::move(last->prev);
+      last = std::move(prev);
+    }
+  }
+
+  size_t size() const { return _size; }
+  bool empty() const { return _size == 0; }
+
+  const T &back() const {
+    assert(!empty() && "back() on an empty list");
+    return last->value;
+  }
+
+  template <class... Args> const T &emplace_back(Args &&...args) {
+    last = new Node(last, std::forward<Args>(args)...);
+    ++_size;
+    return last->value;
+  }
+
+  bool operator==(const ImmutableList &b) const {
+    if (_size != b._size)
+      return false;
+    for (const Node *x = last.get(), *y = b.last.get(); x != y;
+         x = x->prev.get(), y = y->prev.get())
+      if (!(x->value == y->value))
+        return false;
+    return true;
+  }
+  bool operator!=(const ImmutableList &b) const { return !(*this == b); }
+
+  /// Calls f on each element, from the first to the last appended one.
+  template <class F> void forEach(F f) const {
+    std::vector<const T *> elements(_size);
+    size_t i = _size;
+    for (const Node *n = last.get(); n; n = n->prev.get())
+      elements[--i] = &n->value;
+    for (const T *e : elements)
+      f(*e);
+  }
+};
+
+} // End klee namespace
+
+#endif /* KLEE_IMMUTABLELIST_H */
@@ -46,6 +46,11 @@ extern "C" {
   /* returns NULL on (unspecified) error */
   KTest* kTest_fromFile(const char *path);
 
+  /* like kTest_fromFile, but the bytes of the objects point into a
+     read-only mapping of the file where possible, which is only read as
+     they are. The mapping is released by kTest_free. */
+  KTest* kTest_mapFile(const char *path);
+
   /* returns 1 on success, 0 on (unspecified) error */
   int   kTest_toFile(KTest *, const char *path);
   
@@ -54,6 +59,38 @@ extern "C" {
 
   void  kTest_free(KTest *);
 
+  /* An archive holds many tests in a single file: the tests are appended
+     as they are added, and an index of them is written when the archive is
+     closed. Archives without an index, of runs that did not finish, are
+     scanned instead. If enabled, identical object bytes are stored only
+     once. */
+  typedef struct KTestArchive KTestArchive;
+
+  /* return true iff file at path matches KTest archive header */
+  int   kTestArchive_isArchive(const char *path);
+
+  /* create an archive for writing, returns NULL on (unspecified) error */
+  KTestArchive *kTestArchive_create(const char *path, int deduplicate);
+
+  /* open an existing archive for appending more tests, returns NULL on
+     (unspecified) error */
+  KTestArchive *kTestArchive_reopen(const char *path, int deduplicate);
+
+  /* returns 1 on success, 0 on (unspecified) error */
+  int   kTestArchive_append(KTestArchive *, KTest *);
+
+  /* open an archive for reading, returns NULL on (unspecified) error */
+  KTestArchive *kTestArchive_open(const char *path);
+
+  unsigned kTestArchive_numTests(KTestArchive *);
+
+  /* returns NULL on (unspecified) error, free the test with kTest_free */
+  KTest* kTestArchive_getTest(KTestArchive *, unsigned index);
+
+  /* writes the index of an archive created for writing, returns 1 on
+     success, 0 on (unspecified) error */
+  int   kTestArchive_close(KTestArchive *);
+
 #ifdef __cplusplus
 }
 #endif
@@ -38,6 +38,9 @@ namespace klee {
 
     void insert(const std::set<K> &set, const V &value);
 
+    /// Removes the entry of set, returns false if there is none.
+    bool erase(const std::set<K> &set);
+
     V *lookup(const std::set<K> &set);
 
     iterator begin();
@@ -58,6 +61,9 @@ namespace klee {
 
     Node root;
 
+    bool erase(Node *n,
+               typename std::set<K>::const_iterator begin,
+               typename std::set<K>::const_iterator end);
     template<class Iterator, class Vector>
     void findSubsets(Node *n, 
                      const std::set<K> &accum,
@@ -194,6 +200,31 @@ namespace klee {
     n->value = value;
   }
 
+  template<class K, class V>
+  bool MapOfSets<K,V>::erase(const std::set<K> &set) {
+    return erase(&root, set.begin(), set.end());
+  }
+
+  template<class K, class V>
+  bool MapOfSets<K,V>::erase(Node *n,
+                             typename std::set<K>::const_iterator begin,
+                             typename std::set<K>::const_iterator end) {
+    if (begin == end) {
+      if (!n->isEndOfSet)
+        return false;
+      n->isEndOfSet = false;
+      n->value = V();
+      return true;
+    }
+    typename Node::children_ty::iterator kit = n->children.find(*begin);
+    if (kit == n->children.end() || !erase(&kit->second, ++begin, end))
+      return false;
+    // drop the nodes that no longer lead to an entry
+    if (!kit->second.isEndOfSet && kit->second.children.empty())
+      n->children.erase(kit);
+    return true;
+  }
+
   template<class K, class V>
   V *MapOfSets<K,V>::lookup(const std::set<K> &set) {
     Node *n = &root;
@@ -0,0 +1,204 @@
+//===-- PagedVector.h -------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_PAGEDVECTOR_H
+#define KLEE_PAGEDVECTOR_H
+
+#include "klee/ADT/Ref.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+namespace klee {
+
+/// A vector of trivially copyable elements kept in fixed-size pages, which
+/// are shared copy-on-write between copies of the vector. Copying the
+/// vector only copies the page table and writing an element copies at most
+/// the page holding it. The pages added by growing the vector share a single
+/// page of the fill value until they are written, so a large vector that is
+/// mostly left at its fill value only holds the pages that were written.
+///
+/// A vector created with page size 0 keeps all elements in a single page,
+/// which behaves like a plain std::vector that is copied lazily.
+template <typename T>
+class PagedVector {
+  struct Page {
+    /// @brief Required by klee::ref-managed objects
+    class ReferenceCounter _refCount;
+    std::vector<T> elements;
+
+    Page(size_t size, const T &fill) : elements(size, fill) {}
+    Page(const Page &other) : elements(other.elements) {}
+  };
+
+  std::vector<ref<Page>> pages;
+  /// log2 of the page size, or 0 for a single unbounded page
+  unsigned pageShift;
+  size_t _size;
+
+  size_t pageIndex(size_t idx) const { return pageShift ? idx >> pageShift : 0; }
+  size_t pageOffset(size_t idx) const {
+    return pageShift ? idx & ((size_t(1) << pageShift) - 1) : idx;
+  }
+  size_t pageSize() const { return size_t(1) << pageShift; }
+
+  Page &getWriteablePage(size_t index) {
+    ref<Page> &page = pages[index];
+    if (page->_refCount.getCount() > 1)
+      page = new Page(*page);
+    return *page;
+  }
+
+public:
+  /// \param pageSize number of elements per page, must be a power of two;
+  ///                 0 disables paging
+  explicit PagedVector(size_t pageSize = 0) : pageShift(0), _size(0) {
+    assert((pageSize & (pageSize - 1)) == 0 && "page size must be a power of 2");
+    while (pageSize > 1) {
+      pageSize >>= 1;
+      ++pageShift;
+    }
+  }
+
+  size_t size() const { return _size; }
+  bool empty() const { return _size == 0; }
+  bool isPaged() const { return pageShift != 0; }
+
+  /// Bytes of the elements of this vector, each page shared with other
+  /// copies counting for its share of them.
+  size_t getProportionalBytes() const {
+    size_t bytes = 0;
+    for (const ref<Page> &p : pages)
+      bytes += p->elements.capacity() * sizeof(T) / p->_refCount.getCount();
+    return bytes;
+  }
+
+  /// Number of pages that are shared with another copy of this vector, or
+  /// not yet written since the vector grew.
+  size_t getSharedPageCount() const {
+    return std::count_if(pages.begin(), pages.end(), [](const ref<Page> &p) {
+      return p->_refCount.getCount() > 1;
+    });
+  }
+
+  const T &operator[](size_t idx) const {
+    assert(idx < _size && "index out of bounds");
+    return pages[pageIndex(idx)]->elements[pageOffset(idx)];
+  }
+
+  void set(size_t idx, const T &value) {
+    assert(idx < _size && "index out of bounds");
+    T &element = getWriteablePage(pageIndex(idx)).elements[pageOffset(idx)];
+    element = value;
+  }
+
+  void resize(size_t newSize, const T &fill = T()) {
+    if (newSize == _size)
+      return;
+
+    if (!isPaged()) {
+      if (pages.empty())
+        pages.emplace_back(new Page(0, fill));
+      getWriteablePage(0).elements.resize(newSize, fill);
+      _size = newSize;
+      return;
+    }
+
+    if (newSize < _size) {
+      pages.resize(pageIndex(newSize - 1 + pageSize()));
+      _size = newSize;
+      return;
+    }
+
+    // the elements behind the end of the last page may be stale
+    if (_size && pageOffset(_size)) {
+      Page &last = getWriteablePage(pageIndex(_size));
+      size_t end = std::min(pageSize(), pageOffset(_size) + (newSize - _size));
+      std::fill(last.elements.begin() + pageOffset(_size),
+                last.elements.begin() + end, fill);
+    }
+    size_t numPages = pageIndex(newSize - 1) + 1;
+    if (pages.size() < numPages) {
+      ref<Page> blank = new Page(pageSize(), fill);
+      pages.resize(numPages, blank);
+    }
+    _size = newSize;
+  }
+
+  void clear() {
+    pages.clear();
+    _size = 0;
+  }
+
+  /// Copy all elements to a contiguous buffer of at least size() elements.
+  void copyTo(T *dst) const {
+    for (size_t i = 0, done = 0; done < _size; ++i) {
+      size_t n = std::min(pages[i]->elements.size(), _size - done);
+      std::copy_n(pages[i]->elements.begin(), n, dst + done);
+      done += n;
+    }
+  }
+
+  /// Overwrite all elements from a contiguous buffer of size() elements.
+  /// Only pages whose contents actually change are copied.
+  void copyFrom(const T *src) {
+    for (size_t i = 0, done = 0; done < _size; ++i) {
+      size_t n = std::min(pages[i]->elements.size(), _size - done);
+      if (!std::equal(src + done, src + done + n, pages[i]->elements.begin()))
+        std::copy_n(src + done, n, getWriteablePage(i).elements.begin());
+      done += n;
+    }
+  }
+
+  /// Copy the n elements starting at idx to dst.
+  void copyTo(size_t idx, size_t n, T *dst) const {
+    assert(idx + n <= _size && "range out of bounds");
+    while (n) {
+      const std::vector<T> &elements = pages[pageIndex(idx)]->elements;
+      size_t k = std::min(n, elements.size() - pageOffset(idx));
+      std::copy_n(elements.begin() + pageOffset(idx), k, dst);
+      idx += k;
+      dst += k;
+      n -= k;
+    }
+  }
+
+  /// Overwrite the n elements starting at idx from src. Only pages whose
+  /// contents actually change are copied.
+  void copyFrom(size_t idx, size_t n, const T *src) {
+    assert(idx + n <= _size && "range out of bounds");
+    while (n) {
+      size_t i = pageIndex(idx), offset = pageOffset(idx);
+      size_t k = std::min(n, pages[i]->elements.size() - offset);
+      if (!std::equal(src, src + k, pages[i]->elements.begin() + offset))
+        std::copy_n(src, k, getWriteablePage(i).elements.begin() + offset);
+      idx += k;
+      src += k;
+      n -= k;
+    }
+  }
+
+  /// Compare all elements with a contiguous buffer of size() elements.
+  bool equals(const T *src) const {
+    for (size_t i = 0, done = 0; done < _size; ++i) {
+      size_t n = std::min(pages[i]->elements.size(), _size - done);
+      if (!std::equal(src + done, src + done + n, pages[i]->elements.begin()))
+        return false;
+      done += n;
+    }
+    return true;
+  }
+};
+
+} // End klee namespace
+
+#endif /* KLEE_PAGEDVECTOR_H */
@@ -32,6 +32,7 @@
 #include "klee/Support/Casting.h"
 
 #include <cassert>
+#include <utility>
 
 namespace llvm {
   class raw_ostream;
@@ -117,8 +118,8 @@ public:
     inc();
   }
 
-  // normal move constructor: invoke the move assignment operator
-  ref(ref<T> &&r) noexcept : ptr(nullptr) { *this = std::move(r); }
+  // normal move constructor: take over the reference of r
+  ref(ref<T> &&r) noexcept : ptr(r.ptr) { r.ptr = nullptr; }
 
   // conversion move constructors: invoke the move assignment operator
   template <class U> ref(ref<U> &&r) noexcept : ptr(nullptr) {
@@ -210,6 +211,13 @@ public:
     return ptr;
   }
 
+  /// Exchanges the referenced objects, leaving the counts untouched.
+  void swap(ref<T> &r) noexcept {
+    T *p = ptr;
+    ptr = r.ptr;
+    r.ptr = p;
+  }
+
   bool isNull() const { return ptr == nullptr; }
   explicit operator bool() const noexcept { return !isNull(); }
 
@@ -25,7 +25,9 @@
   BTYPE(Realloc, 8U)                                                           \
   BTYPE(Free, 9U)                                                              \
   BTYPE(GetVal, 10U)                                                           \
-  MARK(END, 10U)
+  BTYPE(Check, 11U)                                                            \
+  BTYPE(Schedule, 12U)                                                         \
+  MARK(END, 12U)
 /// \endcond
 
 /** @enum BranchType
@@ -44,6 +46,7 @@
  *  | `BranchType::Realloc`           | branch caused by symbolic `realloc`ation size                                                      |
  *  | `BranchType::Free`              | branch caused by `free`ing symbolic pointer                                                        |
  *  | `BranchType::GetVal`            | branch caused by user-invoked concretization while seeding                                         |
+ *  | `BranchType::Schedule`          | branch caused by several threads that may run next                                                 |
  */
 enum class BranchType : std::uint8_t {
 /// \cond DO_NOT_DOCUMENT
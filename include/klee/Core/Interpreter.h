@@ -9,6 +9,8 @@
 #ifndef KLEE_INTERPRETER_H
 #define KLEE_INTERPRETER_H
 
+#include <atomic>
+#include <cstdint>
 #include <map>
 #include <memory>
 #include <set>
@@ -50,6 +52,29 @@ public:
                                const char *suffix) = 0;
 
   virtual std::string dumpPath(const ExecutionState& state) = 0;
+
+  /// The counts of paths and test cases of a worker process in a parallel
+  /// run (see --parallel-workers).
+  struct WorkerCounts {
+    std::uint32_t pathsCompleted = 0;
+    std::uint32_t pathsExplored = 0;
+    std::uint32_t testCases = 0;
+    std::uint32_t totalTests = 0;
+  };
+
+  /// Called in each process of a parallel run once the states are split,
+  /// to keep the names of the test cases of the workers apart.
+  virtual void setWorker(unsigned index, unsigned count) {}
+  virtual WorkerCounts getWorkerCounts() const { return WorkerCounts(); }
+  /// Add the counts of a finished worker to those of this process.
+  virtual void addWorkerCounts(const WorkerCounts &counts) {}
+  /// Number the test cases from a counter shared by several processes
+  /// (see --prefix-workers) instead of those of this process.
+  virtual void setSharedTestCounter(std::atomic<std::uint32_t> *counter) {}
+  /// Finish writing the test cases handed to background threads (see
+  /// --test-writer-threads). Called before forking processes that write
+  /// test cases, and once the exploration is done.
+  virtual void waitForTestCases() {}
 };
 
 class Interpreter {
@@ -63,13 +88,24 @@ public:
     bool Optimize;
     bool CheckDivZero;
     bool CheckOvershift;
+    /// Run the enabled checks in the executor instead of instrumenting the
+    /// module with calls to the runtime.
+    bool NativeChecks;
+    /// Further functions in which execution may start, which are kept and
+    /// prepared like EntryPoint (see --batch-entry-points).
+    std::vector<std::string> ExtraEntryPoints;
+    /// Functions whose calls are errors, besides __assert_fail and
+    /// __INSTR_fail (see --error-fn).
+    std::vector<std::string> ErrorFunctions;
 
     ModuleOptions(const std::string &_LibraryDir,
                   const std::string &_EntryPoint, const std::string &_OptSuffix,
-                  bool _Optimize, bool _CheckDivZero, bool _CheckOvershift)
+                  bool _Optimize, bool _CheckDivZero, bool _CheckOvershift,
+                  bool _NativeChecks = false)
         : LibraryDir(_LibraryDir), EntryPoint(_EntryPoint),
           OptSuffix(_OptSuffix), Optimize(_Optimize),
-          CheckDivZero(_CheckDivZero), CheckOvershift(_CheckOvershift) {}
+          CheckDivZero(_CheckDivZero), CheckOvershift(_CheckOvershift),
+          NativeChecks(_NativeChecks) {}
   };
 
   enum LogType
@@ -133,18 +169,66 @@ public:
   virtual void setReplayPath(const std::vector<bool> *path) = 0;
 
   // supply a test case to replay from. this can be used to drive the
-  // interpretation down a user specified path. use null to reset.
-  virtual void setReplayNondet(const struct KTest *out) = 0;
+  // interpretation down a user specified path. when concrete, the objects
+  // of klee_make_symbolic are replayed too and all other nondeterministic
+  // values are zero, so that nothing is executed symbolically. use null to
+  // reset.
+  virtual void setReplayNondet(const struct KTest *out, bool concrete) = 0;
+
+  // mark the following runs as those of a fuzzer, which replay inputs
+  // concretely (see setReplayNondet): inputs that do not fit the program
+  // are zero-extended or truncated and only states covering new
+  // instructions write tests.
+  virtual void setFuzzing(bool value) = 0;
+
+  // supply a checkpoint written with --checkpoint-interval to continue
+  // the exploration from. use an empty path to reset.
+  virtual void setResumeCheckpoint(const std::string &path) = 0;
 
   // supply a set of symbolic bindings that will be used as "seeds"
   // for the search. use null to reset.
   virtual void useSeeds(const std::vector<struct KTest *> *seeds) = 0;
 
+  /// Explore f to the end, see startFunctionAsMain, step and finishRun.
   virtual void runFunctionAsMain(llvm::Function *f,
                                  int argc,
                                  char **argv,
                                  char **envp) = 0;
 
+  /*** Incremental execution ***/
+
+  /// Set up the exploration of f without executing an instruction, so that
+  /// an embedder can drive it with step and end it with finishRun. Seeding
+  /// (see useSeeds) still runs to completion here.
+  virtual void startFunctionAsMain(llvm::Function *f, int argc, char **argv,
+                                   char **envp) = 0;
+
+  /// Execute at most budget instructions of the exploration started with
+  /// startFunctionAsMain. Test cases are handed to the InterpreterHandler
+  /// as the states terminate.
+  /// \return false once the exploration is complete or was halted
+  virtual bool step(std::uint64_t budget) = 0;
+
+  /// End the exploration started with startFunctionAsMain, terminating the
+  /// remaining states as on a halt if it is not complete.
+  virtual void finishRun() = 0;
+
+  /// Statistics of the exploration, which can be queried between steps.
+  /// They are those of the process, which all interpreters share.
+  struct RunStatistics {
+    std::uint64_t instructions = 0;
+    std::uint64_t coveredInstructions = 0;
+    std::uint64_t uncoveredInstructions = 0;
+    std::uint64_t forks = 0;
+    std::uint64_t queries = 0;
+    /// In microseconds.
+    std::uint64_t solverTime = 0;
+    /// The states that are still to be explored.
+    std::uint64_t states = 0;
+  };
+
+  virtual RunStatistics getRunStatistics() const = 0;
+
   /*** Runtime options ***/
 
   virtual void setHaltExecution(bool value) = 0;
@@ -159,6 +243,11 @@ public:
 
   virtual unsigned getSymbolicPathStreamID(const ExecutionState &state) = 0;
 
+  /// The branch decisions of state, '0' or '1' each, written with
+  /// --write-paths or, if symbolic is set, with --write-sym-paths.
+  virtual void getPathBranches(const ExecutionState &state, bool symbolic,
+                               std::vector<unsigned char> &branches) = 0;
+
   virtual void getConstraintLog(const ExecutionState &state,
                                 std::string &res,
                                 LogType logFormat = STP) = 0;
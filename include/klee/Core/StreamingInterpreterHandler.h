@@ -0,0 +1,89 @@
+//===-- StreamingInterpreterHandler.h ---------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_STREAMINGINTERPRETERHANDLER_H
+#define KLEE_STREAMINGINTERPRETERHANDLER_H
+
+#include "klee/Core/Interpreter.h"
+
+#include "llvm/Support/raw_ostream.h"
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace klee {
+
+/// StreamingInterpreterHandler - An InterpreterHandler for embedding klee,
+/// which hands the test cases to a callback in memory instead of writing
+/// them to files. Together with Interpreter::step, it lets a service drive
+/// an exploration in slices and receive its results as they are found.
+class StreamingInterpreterHandler : public InterpreterHandler {
+public:
+  /// A test case of a terminated state.
+  struct TestCase {
+    /// The names and contents of the symbolic objects, as in a .ktest file.
+    std::vector<std::pair<std::string, std::vector<unsigned char>>> objects;
+    /// The message and the file suffix (e.g. "ptr.err") of an error, empty
+    /// for a path that terminated normally.
+    std::string error, suffix;
+    /// The constraints of the path in the KQuery format, which witness it.
+    std::string constraints;
+  };
+
+  using Callback = std::function<void(const TestCase &)>;
+
+private:
+  Interpreter *interpreter = nullptr;
+  Callback callback;
+  std::string outputDirectory;
+  mutable std::string info;
+  mutable llvm::raw_string_ostream infoStream;
+  std::uint32_t pathsCompleted = 0, pathsExplored = 0, testCases = 0;
+
+public:
+  /// \param outputDirectory The existing directory of the auxiliary files,
+  /// such as the statistics, or empty to write none. The files the
+  /// interpreter asks for are then not opened, so options that need them
+  /// (e.g. --output-stats) should be disabled.
+  explicit StreamingInterpreterHandler(Callback callback,
+                                       std::string outputDirectory = "");
+
+  void setInterpreter(Interpreter *i) { interpreter = i; }
+
+  /// The messages klee would write to the info file.
+  const std::string &getInfo() const { return infoStream.str(); }
+
+  std::uint32_t getPathsCompleted() const { return pathsCompleted; }
+  std::uint32_t getPathsExplored() const { return pathsExplored; }
+  std::uint32_t getNumTestCases() const { return testCases; }
+
+  llvm::raw_ostream &getInfoStream() const override { return infoStream; }
+
+  std::string getOutputFilename(const std::string &filename) override;
+  std::unique_ptr<llvm::raw_fd_ostream>
+  openOutputFile(const std::string &filename) override;
+
+  void incPathsCompleted() override { ++pathsCompleted; }
+  void incPathsExplored(std::uint32_t num = 1) override {
+    pathsExplored += num;
+  }
+
+  void processTestCase(const ExecutionState &state, const char *err,
+                       const char *suffix) override;
+
+  /// Paths are not dumped, see --write-paths.
+  std::string dumpPath(const ExecutionState &state) override { return ""; }
+};
+
+} // namespace klee
+
+#endif /* KLEE_STREAMINGINTERPRETERHANDLER_H */
@@ -20,7 +20,8 @@
   TTYPE(MaxDepth, 3U, "early")                                                 \
   TTYPE(OutOfMemory, 4U, "early")                                              \
   TTYPE(OutOfStackMemory, 5U, "early")                                         \
-  MARK(EARLY, 5U)                                                              \
+  TTYPE(RevisitedLoopHead, 6U, "early")                                        \
+  MARK(EARLY, 6U)                                                              \
   TTYPE(Solver, 8U, "solver.err")                                              \
   MARK(SOLVERERR, 8U)                                                          \
   TTYPE(Abort, 10U, "abort.err")                                               \
@@ -40,7 +41,9 @@
   TTYPE(MissingReturn, 24U, "missing_return.err")                              \
   TTYPE(InvalidLoad, 25U, "invalid_load.err")                                  \
   TTYPE(NullableAttribute, 26U, "nullable_attribute.err")                      \
-  MARK(PROGERR, 26U)                                                           \
+  TTYPE(NonTermination, 27U, "nontermination.err")                             \
+  TTYPE(Deadlock, 28U, "deadlock.err")                                         \
+  MARK(PROGERR, 28U)                                                           \
   TTYPE(User, 33U, "user.err")                                                 \
   MARK(USERERR, 33U)                                                           \
   TTYPE(Execution, 35U, "exec.err")                                            \
@@ -49,7 +52,8 @@
   TTYPE(Replay, 37U, "")                                                       \
   TTYPE(Merge, 38U, "")                                                        \
   TTYPE(SilentExit, 39U, "")                                                   \
-  MARK(END, 39U)
+  TTYPE(SleepSetBlocked, 40U, "")                                              \
+  MARK(END, 40U)
 
 ///@brief Reason an ExecutionState got terminated.
 enum class StateTerminationType : std::uint8_t {
@@ -13,7 +13,9 @@
 #include "klee/Expr/Expr.h"
 #include "klee/Expr/ArrayExprHash.h" // For klee::ArrayHashFn
 
+#include <atomic>
 #include <string>
+#include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
@@ -36,7 +38,11 @@ public:
   //
   /// Symbolic Arrays are cached so that only one instance exists. This
   /// provides a limited form of "alpha-renaming". Constant arrays are not
-  /// cached.
+  /// cached, but constant arrays of bytes with the same values share the
+  /// storage of their values.
+  ///
+  /// Every array that is made gets the next ID of all caches, so the IDs of
+  /// the arrays in use are small and unique.
   ///
   /// This class retains ownership of Array object so that upon destruction
   /// of this object all allocated Array objects are deleted.
@@ -64,8 +70,17 @@ private:
                              klee::EquivArrayCmpFn>
       ArrayHashMap;
   ArrayHashMap cachedSymbolicArrays;
+  /// The ID of the next array, shared by all caches.
+  static std::atomic<unsigned> nextID;
   typedef std::vector<const Array *> ArrayPtrVec;
   ArrayPtrVec concreteArrays;
+  /// The values of the constant arrays of bytes, by their hash.
+  std::unordered_multimap<size_t, std::shared_ptr<const std::vector<uint8_t>>>
+      constantBytes;
+
+  /// The bytes charged to memory::arrays for an array, besides the constant
+  /// bytes it may share.
+  static uint64_t getArrayBytes(const Array *array);
 };
 }
 
@@ -10,7 +10,9 @@
 #ifndef KLEE_ARRAYEXPROPTIMIZER_H
 #define KLEE_ARRAYEXPROPTIMIZER_H
 
+#include <cstddef>
 #include <cstdint>
+#include <list>
 #include <map>
 #include <unordered_map>
 #include <unordered_set>
@@ -30,10 +32,35 @@ using mapIndexOptimizedExpr_ty = std::map<ref<Expr>, std::vector<ref<Expr>>>;
 
 class ExprOptimizer {
 private:
-  ExprHashMap<ref<Expr>> cacheExprOptimized;
-  ExprHashSet cacheExprUnapplicable;
+  /// The arguments of optimizeExpr, compared structurally.
+  struct CacheKey {
+    ref<Expr> e;
+    bool valueOnly;
+
+    bool operator==(const CacheKey &b) const {
+      return valueOnly == b.valueOnly && e == b.e;
+    }
+  };
+  struct CacheKeyHash {
+    std::size_t operator()(const CacheKey &k) const {
+      return k.e->stableHash().low ^ k.valueOnly;
+    }
+  };
+  struct CacheEntry {
+    ref<Expr> result;
+    /// position in cacheLRU
+    std::list<CacheKey>::iterator lruPosition;
+  };
+
+  /// The results of optimizeExpr, which are the expressions themselves
+  /// when they cannot be optimized. Bounded by --optimize-array-cache-size.
+  std::unordered_map<CacheKey, CacheEntry, CacheKeyHash> cache;
+  /// The keys of cache from the most to the least recently used one.
+  std::list<CacheKey> cacheLRU;
   ExprHashMap<ref<Expr>> cacheReadExprOptimized;
 
+  void insert(const CacheKey &key, const ref<Expr> &result);
+
 public:
   /// Returns the optimised version of e.
   /// @param e expression to optimise
@@ -120,7 +120,7 @@ protected:
 public:
   explicit ArrayValueOptReplaceVisitor(ExprHashMap<ref<Expr>> &_optimized,
                                        bool recursive = true)
-      : ExprVisitor(recursive), optimized(_optimized) {}
+      : ExprVisitor(recursive, true), optimized(_optimized) {}
 };
 } // namespace klee
 
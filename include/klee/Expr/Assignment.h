@@ -13,7 +13,9 @@
 #include "klee/Expr/Constraints.h"
 #include "klee/Expr/ExprEvaluator.h"
 
+#include <algorithm>
 #include <map>
+#include <vector>
 
 namespace klee {
   class Array;
@@ -28,6 +30,11 @@ namespace klee {
     std::map<uint32_t, uint8_t> asMap() const;
     std::vector<uint8_t> asVector() const;
     void dump() const;
+
+    /// The bytes held by the model besides itself.
+    size_t getMemoryUsage() const {
+      return skipRanges.capacity() * sizeof(skipRanges[0]) + values.capacity();
+    }
   };
 
   class MapArrayModel {
@@ -105,31 +112,42 @@ namespace klee {
 
   class Assignment {
   public:
-    typedef std::map<const Array*, CompactArrayModel> bindings_ty;
+    /// The bindings, sorted by the IDs of their arrays, so that a lookup is
+    /// a binary search through contiguous memory.
+    typedef std::vector<std::pair<const Array*, CompactArrayModel> > bindings_ty;
     typedef std::map<const Array*, MapArrayModel> map_bindings_ty;
 
     Assignment() = default;
-    Assignment(const bindings_ty bindings) : bindings(bindings) {}
+    Assignment(bindings_ty bindings) : bindings(std::move(bindings)) {
+      sortBindings();
+    }
     Assignment(const map_bindings_ty models) {
+      bindings.reserve(models.size());
       for (const auto &pair : models) {
-        auto &item = bindings[pair.first];
-        pair.second.toCompact(item);
+        bindings.emplace_back(pair.first, CompactArrayModel());
+        pair.second.toCompact(bindings.back().second);
       }
+      sortBindings();
     }
 
+    /// The model of a, added if it has none. The reference is only valid
+    /// until the next model is added.
     CompactArrayModel& getBindings(const Array *a) {
-        return bindings[a];
+      auto it = lowerBound(bindings.begin(), bindings.end(), a);
+      if (it == bindings.end() || it->first != a)
+        it = bindings.emplace(it, a, CompactArrayModel());
+      return it->second;
     }
 
     const CompactArrayModel *getBindingsOrNull(const Array *a) const {
-        auto it = bindings.find(a);
-        if (it == bindings.end())
-            return nullptr;
-        return &it->second;
+      auto it = find(a);
+      if (it == bindings.end())
+        return nullptr;
+      return &it->second;
     }
 
     bool hasBindings(const Array *a) const {
-        return bindings.find(a) != bindings.end();
+      return find(a) != bindings.end();
     }
 
     void addBinding(const Array*, const std::vector<unsigned char>& values);
@@ -143,8 +161,41 @@ namespace klee {
     bool satisfies(InputIterator begin, InputIterator end) const;
     void dump() const;
 
+    /// The bytes held by the assignment and its models.
+    size_t getMemoryUsage() const {
+      size_t bytes = sizeof(*this) + bindings.capacity() * sizeof(bindings[0]);
+      for (const auto &binding : bindings)
+        bytes += binding.second.getMemoryUsage();
+      return bytes;
+    }
+
   private:
     bindings_ty bindings;
+
+    static bool hasLowerID(const bindings_ty::value_type &binding,
+                           const Array *a) {
+      return binding.first->getID() < a->getID();
+    }
+
+    template <typename Iterator>
+    static Iterator lowerBound(Iterator begin, Iterator end, const Array *a) {
+      return std::lower_bound(begin, end, a, hasLowerID);
+    }
+
+    bindings_ty::const_iterator find(const Array *a) const {
+      auto it = lowerBound(bindings.begin(), bindings.end(), a);
+      if (it != bindings.end() && it->first == a)
+        return it;
+      return bindings.end();
+    }
+
+    void sortBindings() {
+      std::sort(bindings.begin(), bindings.end(),
+                [](const bindings_ty::value_type &x,
+                   const bindings_ty::value_type &y) {
+                  return hasLowerID(x, y.first);
+                });
+    }
   };
 
   template <typename T>
@@ -195,7 +246,7 @@ namespace klee {
   }
 
   inline uint8_t Assignment::getValue(const Array* array, unsigned index) const {
-    bindings_ty::const_iterator it = bindings.find(array);
+    bindings_ty::const_iterator it = find(array);
     if (it!=bindings.end()) {
       return it->second.get(index);
     }
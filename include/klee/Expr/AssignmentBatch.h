@@ -0,0 +1,75 @@
+//===-- AssignmentBatch.h ---------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_ASSIGNMENTBATCH_H
+#define KLEE_ASSIGNMENTBATCH_H
+
+#include "klee/Expr/Expr.h"
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace klee {
+class Assignment;
+
+/// Evaluates expressions under several assignments at once. Each node of
+/// an expression is visited once and computed for all assignments, whose
+/// values for the node are stored next to each other.
+///
+/// Nodes of up to 64 bits are evaluated this way. Expressions with wider
+/// nodes, and the assignments for which a division by zero was met, are
+/// evaluated one by one with Assignment::evaluate, so the results are the
+/// same as from Assignment::satisfies.
+class AssignmentBatch {
+public:
+  /// The maximal number of assignments in a batch.
+  static const unsigned MaxLanes = 64;
+
+  /// \param assignments at most MaxLanes assignments, which must outlive
+  /// the batch
+  explicit AssignmentBatch(const std::vector<const Assignment *> &assignments);
+
+  /// \return a mask with bit i set if the i-th assignment satisfies all of
+  /// the expressions in [begin, end)
+  template <typename InputIterator>
+  uint64_t satisfies(InputIterator begin, InputIterator end);
+
+private:
+  std::vector<const Assignment *> assignments;
+  /// The mask of all assignments.
+  uint64_t all;
+  /// The assignments for which a division by zero was evaluated.
+  uint64_t divisionByZero = 0;
+  /// The values of the evaluated nodes, one per assignment.
+  std::vector<uint64_t> values;
+  /// The offsets of the values of the evaluated nodes.
+  std::unordered_map<const Expr *, size_t> offsets;
+
+  /// \return the mask of the assignments for which e is true
+  uint64_t satisfiedBy(const ref<Expr> &e);
+  /// Evaluates e and the nodes it depends on. \return false if one of them
+  /// is wider than 64 bits
+  bool evaluate(const ref<Expr> &e, size_t &offset);
+  /// Computes the values of e from those of the nodes it depends on.
+  void compute(const Expr &e, uint64_t *result);
+  void computeRead(const ReadExpr &re, uint64_t *result);
+};
+
+template <typename InputIterator>
+inline uint64_t AssignmentBatch::satisfies(InputIterator begin,
+                                           InputIterator end) {
+  uint64_t result = all;
+  for (; begin != end && result; ++begin)
+    result &= satisfiedBy(*begin);
+  return result;
+}
+} // namespace klee
+
+#endif /* KLEE_ASSIGNMENTBATCH_H */
@@ -0,0 +1,160 @@
+//===-- BinaryQueryLog.h ----------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_BINARYQUERYLOG_H
+#define KLEE_BINARYQUERYLOG_H
+
+#include "klee/Expr/Expr.h"
+#include "klee/Expr/ExprHashMap.h"
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringRef.h"
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace llvm {
+class MemoryBuffer;
+class raw_ostream;
+} // namespace llvm
+
+namespace klee {
+class ArrayCache;
+class ExprBuilder;
+
+/// A query of a binary query log, with the parts of a query command of a
+/// .kquery file.
+struct LoggedQuery {
+  std::vector<ref<Expr>> constraints;
+  ref<Expr> expr;
+  /// The expressions whose values are requested.
+  std::vector<ref<Expr>> values;
+  /// The arrays whose contents are requested.
+  std::vector<const Array *> objects;
+  /// The comment lines logged with the query.
+  std::string comment;
+};
+
+/// Writes queries to a binary query log. Arrays, update nodes and
+/// expressions are written once, before the first query that refers to
+/// them, and are referred to by number from then on, so sub-expressions
+/// shared within and across queries are stored once. close() ends the log
+/// with an index of the queries and the nodes, with which a query can be
+/// read without reading the queries before it.
+class BinaryQueryLogWriter {
+  llvm::raw_ostream &os;
+  /// The number of bytes written.
+  uint64_t position = 0;
+  bool closed = false;
+
+  ExprHashMap<uint64_t> exprIds;
+  std::unordered_map<const UpdateNode *, uint64_t> updateIds;
+  /// The written update nodes, kept alive so that their addresses are not
+  /// reused.
+  std::vector<ref<UpdateNode>> updates;
+  std::unordered_map<const Array *, uint64_t> arrayIds;
+
+  std::vector<uint64_t> nodeOffsets;
+  std::vector<uint64_t> queryOffsets;
+
+  uint64_t idOf(const ref<Expr> &e);
+  uint64_t idOf(const ref<UpdateNode> &un);
+  uint64_t idOf(const Array *array);
+  /// Writes the nodes e depends on that were not written yet, then e.
+  void writeNodes(const ref<Expr> &e);
+  void writeArray(const Array *array);
+
+  void writeRecord(char tag, llvm::ArrayRef<uint64_t> ints,
+                   llvm::ArrayRef<uint64_t> refs, llvm::StringRef text);
+  void writeBytes(const char *data, size_t size);
+  void writeFixed(uint64_t value);
+  void writeVarint(uint64_t value);
+
+public:
+  /// Writes the header of a log to os, which must be empty.
+  explicit BinaryQueryLogWriter(llvm::raw_ostream &os);
+  /// Closes the log if it was not closed.
+  ~BinaryQueryLogWriter();
+
+  BinaryQueryLogWriter(const BinaryQueryLogWriter &) = delete;
+  BinaryQueryLogWriter &operator=(const BinaryQueryLogWriter &) = delete;
+
+  void writeQuery(const LoggedQuery &query);
+  /// Writes the index and flushes the log. No query can be written after.
+  void close();
+
+  uint64_t getNumQueries() const { return queryOffsets.size(); }
+};
+
+/// Reads the queries of a binary query log in any order. The log is read in
+/// place, so the buffer should be a mapped file, and only the nodes a query
+/// depends on are constructed, once. A log that was not closed, e.g.
+/// because the writer crashed, has no index and is scanned when opened.
+class BinaryQueryLogReader {
+public:
+  /// The raw fields of a record.
+  struct Record {
+    char tag;
+    llvm::SmallVector<uint64_t, 8> ints;
+    /// The numbers of the nodes the record refers to.
+    llvm::SmallVector<uint64_t, 4> refs;
+    llvm::StringRef text;
+  };
+
+private:
+  const llvm::MemoryBuffer &buffer;
+  ArrayCache &arrayCache;
+  ExprBuilder *builder;
+
+  /// The node offsets of the index, or null for a log without one.
+  const char *nodeIndex = nullptr;
+  const char *queryIndex = nullptr;
+  uint64_t numNodes = 0, numQueries = 0;
+  /// The offsets found by scanning a log without an index.
+  std::vector<uint64_t> nodeOffsets, queryOffsets;
+
+  struct Node {
+    ref<Expr> expr;
+    ref<UpdateNode> update;
+    const Array *array = nullptr;
+  };
+  std::unordered_map<uint64_t, Node> nodes;
+
+  uint64_t nodeOffset(uint64_t id) const;
+  uint64_t queryOffset(uint64_t index) const;
+  bool readIndex();
+  bool scan(std::string &error);
+  /// Constructs the node with the given number and those it depends on.
+  bool buildNode(uint64_t id, std::string &error);
+  bool makeNode(const Record &record, Node &node, std::string &error);
+
+public:
+  /// \param builder the builder constructing the expressions
+  BinaryQueryLogReader(const llvm::MemoryBuffer &buffer, ArrayCache &arrayCache,
+                       ExprBuilder *builder);
+
+  /// \return whether data starts with the header of a binary query log
+  static bool isBinaryQueryLog(llvm::StringRef data);
+
+  /// Locates the queries and nodes of the log. \return false if it is not
+  /// a binary query log or is malformed, with a reason in error
+  bool open(std::string &error);
+
+  uint64_t getNumQueries() const { return numQueries; }
+
+  /// Reads the query with the given index, which must be less than
+  /// getNumQueries(). \return false if the log is malformed, with a reason
+  /// in error
+  bool readQuery(uint64_t index, LoggedQuery &query, std::string &error);
+};
+} // namespace klee
+
+#endif /* KLEE_BINARYQUERYLOG_H */
@@ -0,0 +1,54 @@
+//===-- ConstraintRanges.h --------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_CONSTRAINTRANGES_H
+#define KLEE_CONSTRAINTRANGES_H
+
+#include "klee/ADT/ImmutableMap.h"
+#include "klee/Expr/Expr.h"
+#include "klee/Expr/ValueRange.h"
+
+#include "llvm/ADT/Optional.h"
+
+namespace klee {
+
+/// ConstraintRanges - Interval bounds of terms learned from the constraints
+/// of a path, such as x < 10.
+///
+/// The bounds only come from constraints comparing a term against a
+/// constant, so learning one is cheap and they are not propagated between
+/// terms. Copies share their bounds, like the other caches of a state.
+class ConstraintRanges {
+  typedef ImmutableMap<ref<Expr>, ValueRange> Bounds;
+  Bounds bounds;
+
+public:
+  /// learn - Narrow the bounds with a constraint added to the path.
+  void learn(const ref<Expr> &constraint) { learn(constraint, true); }
+
+  /// decide - Return the truth value of the boolean expression e if the
+  /// ranges of its terms under the learned bounds determine it.
+  llvm::Optional<bool> decide(const ref<Expr> &e) const;
+
+  /// lookup - Return the bounds learned for the term e, if any.
+  const ValueRange *lookup(const ref<Expr> &e) const {
+    const auto *res = bounds.lookup(e);
+    return res ? &res->second : nullptr;
+  }
+
+  bool empty() const { return bounds.empty(); }
+
+private:
+  void learn(const ref<Expr> &e, bool holds);
+  void narrow(const ref<Expr> &e, const ValueRange &range);
+};
+
+} // namespace klee
+
+#endif /* KLEE_CONSTRAINTRANGES_H */
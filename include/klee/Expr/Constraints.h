@@ -10,20 +10,94 @@
 #ifndef KLEE_CONSTRAINTS_H
 #define KLEE_CONSTRAINTS_H
 
+#include "klee/ADT/Ref.h"
 #include "klee/Expr/Expr.h"
+#include "klee/Expr/ExprHashMap.h"
+
+#include "llvm/ADT/SmallVector.h"
+
+#include <iterator>
+#include <memory>
+#include <utility>
+#include <vector>
 
 namespace klee {
 
+class Assignment;
+class IndependentPartition;
+
 /// Resembles a set of constraints that can be passed around
 ///
+/// The constraints are kept in a persistent list of chunks, so copies of a
+/// set (e.g. of forked states) share their common prefix and copying or
+/// extending a set does not copy the constraints added before.
 class ConstraintSet {
   friend class ConstraintManager;
 
+  struct Chunk {
+    /// @brief Required by klee::ref-managed objects
+    class ReferenceCounter _refCount;
+    /// the chunk holding the preceding constraints
+    const ref<Chunk> prev;
+    /// number of constraints before this chunk
+    const size_t offset;
+    /// May be extended by any set ending at its last element; other sets
+    /// sharing this chunk only see the elements within their size.
+    std::vector<ref<Expr>> constraints;
+
+    Chunk(const ref<Chunk> &prev, size_t offset)
+        : prev(prev), offset(offset) {}
+  };
+
+  /// maximal number of constraints per chunk
+  static const size_t ChunkSize = 64;
+
 public:
   using constraints_ty = std::vector<ref<Expr>>;
-  using iterator = constraints_ty::iterator;
-  using const_iterator = constraints_ty::const_iterator;
 
+  /// Iterates over the constraints in the order they were added.
+  class const_iterator {
+    friend class ConstraintSet;
+
+    // the chunks from the first one and the number of constraints in each
+    llvm::SmallVector<std::pair<const Chunk *, size_t>, 8> chunks;
+    size_t chunk = 0;
+    size_t pos = 0;
+    size_t index;
+
+    explicit const_iterator(size_t index) : index(index) {}
+
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = ref<Expr>;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const ref<Expr> *;
+    using reference = const ref<Expr> &;
+
+    reference operator*() const {
+      return chunks[chunk].first->constraints[pos];
+    }
+    pointer operator->() const { return &**this; }
+
+    const_iterator &operator++() {
+      ++index;
+      if (++pos == chunks[chunk].second && chunk + 1 < chunks.size()) {
+        ++chunk;
+        pos = 0;
+      }
+      return *this;
+    }
+    const_iterator operator++(int) {
+      const_iterator tmp = *this;
+      ++*this;
+      return tmp;
+    }
+
+    bool operator==(const const_iterator &b) const { return index == b.index; }
+    bool operator!=(const const_iterator &b) const { return index != b.index; }
+  };
+
+  using iterator = const_iterator;
   using constraint_iterator = const_iterator;
 
   bool empty() const;
@@ -31,17 +105,62 @@ public:
   constraint_iterator end() const;
   size_t size() const noexcept;
 
-  explicit ConstraintSet(constraints_ty cs) : constraints(std::move(cs)) {}
+  /// Hash of the constraints, in the order they were added
+  unsigned hash() const { return hashValue; }
+
+  explicit ConstraintSet(const constraints_ty &cs);
   ConstraintSet() = default;
 
   void push_back(const ref<Expr> &e);
 
-  bool operator==(const ConstraintSet &b) const {
-    return constraints == b.constraints;
+  /// The substitutions implied by the constraints, as applied by
+  /// ConstraintManager::simplifyExpr: the constant of each equality with a
+  /// constant, and true for every other constraint. Built on first use and
+  /// extended as constraints are added; copies of the set share it until
+  /// they are extended.
+  const ExprHashMap<ref<Expr>> &getEqualities() const;
+
+  /// An assignment satisfying all constraints, if one is known (arrays it
+  /// does not bind are zero). Shared by the copies of the set and dropped
+  /// by push_back() once a constraint does not hold under it.
+  const std::shared_ptr<const Assignment> &getModel() const { return model; }
+
+  /// Remember a model of the constraints. Like the other derived data of
+  /// the set, it may be set through const references, e.g. by the solvers
+  /// answering a query on the set.
+  void setModel(std::shared_ptr<const Assignment> assignment) const;
+
+  /// Remember a second model of the constraints, e.g. the counterexample of
+  /// a branch the model does not take. push_back() makes it the model once
+  /// a constraint holds under it but not under the model, so the state
+  /// taking that branch starts with a model.
+  void setOtherModel(std::shared_ptr<const Assignment> assignment) const;
+
+  /// Maintain the independent factors of the constraints from now on.
+  /// Copies of the set share them and keep extending them.
+  void trackIndependence();
+  bool tracksIndependence() const { return partition != nullptr; }
+
+  /// The independent factors of the constraints, or null if they are not
+  /// tracked
+  const IndependentPartition *getIndependentPartition() const {
+    return partition.get();
   }
 
+  bool operator==(const ConstraintSet &b) const;
+
 private:
-  constraints_ty constraints;
+  /// Keep only the first n constraints. The chunks are shared with the
+  /// copies of the set, the derived data is rebuilt for the prefix.
+  void truncate(size_t n);
+
+  ref<Chunk> last;
+  size_t numConstraints = 0;
+  unsigned hashValue = 0;
+  std::shared_ptr<const IndependentPartition> partition;
+  mutable std::shared_ptr<ExprHashMap<ref<Expr>>> equalities;
+  mutable std::shared_ptr<const Assignment> model;
+  mutable std::shared_ptr<const Assignment> otherModel;
 };
 
 class ExprVisitor;
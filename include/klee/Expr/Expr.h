@@ -12,6 +12,7 @@
 
 #include "klee/ADT/Bits.h"
 #include "klee/ADT/Ref.h"
+#include "klee/Expr/ExprAllocator.h"
 #include "llvm/ADT/APFloat.h"
 #include "llvm/ADT/APInt.h"
 #include "llvm/ADT/DenseSet.h"
@@ -19,6 +20,7 @@
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/raw_ostream.h"
 
+#include <memory>
 #include <sstream>
 #include <set>
 #include <vector>
@@ -40,6 +42,47 @@ template<class T> class ref;
 
 extern llvm::cl::OptionCategory ExprCat;
 
+/// A 128-bit structural hash which, unlike Expr::hash, does not depend on
+/// the process computing it: the same expression built in another run, or
+/// another process, has the same stable hash. It is meant as a key for
+/// caches and logs shared between runs. Array names are hashed without
+/// the counters that make them unique within a state (see
+/// Array::computeStableHash), so equal hashes still have to be confirmed
+/// by comparing the expressions.
+struct StableHash {
+  uint64_t low = 0, high = 0;
+
+  StableHash() = default;
+  explicit StableHash(uint64_t seed) { combine(seed); }
+
+  void combine(uint64_t v) {
+    low = mix(low ^ v);
+    high = mix((high ^ low) + v * 0x9e3779b97f4a7c15ULL);
+  }
+  void combine(const StableHash &h) {
+    combine(h.low);
+    combine(h.high);
+  }
+
+  bool operator==(const StableHash &b) const {
+    return low == b.low && high == b.high;
+  }
+  bool operator!=(const StableHash &b) const { return !(*this == b); }
+  bool operator<(const StableHash &b) const {
+    return high != b.high ? high < b.high : low < b.low;
+  }
+
+private:
+  /// The finalizer of SplitMix64.
+  static uint64_t mix(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+  }
+};
+
 /// Class representing symbolic expressions.
 /**
 
@@ -93,6 +136,10 @@ public:
   static unsigned count;
   static const unsigned MAGIC_HASH_CONSTANT = 39;
 
+  /// Whether structurally equal expressions share one node (see
+  /// --hash-cons-exprs and hashCons).
+  static bool hashConsing;
+
   /// The type of an expression is simply its width, in bits. 
   typedef unsigned Width; 
 
@@ -169,14 +216,47 @@ public:
     Sgt, ///< Not used in canonical form
     Sge, ///< Not used in canonical form
 
-    LastKind=Sge,
+    // Floating point, on the IEEE 754 bit patterns of the operands and
+    // results, rounding to nearest with ties to even. These follow the
+    // other kinds so that their numbers stay the same.
+
+    // Arithmetic
+    FAdd,
+    FSub,
+    FMul,
+    FDiv,
+
+    // Compare, false if an operand is NaN
+    FOEq,
+    FOLt,
+    FOLe,
+    FUno, ///< Whether an operand is NaN
+
+    // Casting, where the conversions to integers round towards zero and
+    // saturate, with NaN converted to 0
+    FPExt,
+    FPTrunc,
+    FPToUI,
+    FPToSI,
+    UIToFP,
+    SIToFP,
+
+    LastKind=SIToFP,
 
     CastKindFirst=ZExt,
     CastKindLast=SExt,
     BinaryKindFirst=Add,
     BinaryKindLast=Sge,
     CmpKindFirst=Eq,
-    CmpKindLast=Sge
+    CmpKindLast=Sge,
+    FPKindFirst=FAdd,
+    FPKindLast=SIToFP,
+    FPBinaryKindFirst=FAdd,
+    FPBinaryKindLast=FUno,
+    FPCmpKindFirst=FOEq,
+    FPCmpKindLast=FUno,
+    FPCastKindFirst=FPExt,
+    FPCastKindLast=SIToFP
   };
 
   /// @brief Required by klee::ref-managed objects
@@ -184,6 +264,10 @@ public:
 
 protected:  
   unsigned hashValue;
+  StableHash stableHashValue;
+
+  /// Whether this node is in the table of unique expressions.
+  bool isUnique = false;
 
   /// Compares `b` to `this` Expr and determines how they are ordered
   /// (ignoring their kid expressions - i.e. those returned by `getKid()`).
@@ -209,9 +293,27 @@ protected:
   /// `<` and `>` are binary relations that express the partial order.
   virtual int compareContents(const Expr &b) const = 0;
 
+private:
+  static ref<Expr> getUnique(const ref<Expr> &e);
+  void removeUnique();
+  bool isUniqueCopyOf(const Expr &b) const;
+
 public:
   Expr() { Expr::count++; }
-  virtual ~Expr() { Expr::count--; } 
+
+  /// Nodes are allocated from slabs by size, see ExprAllocator.
+  static void *operator new(size_t size) {
+    return ExprAllocator::allocate(size);
+  }
+  static void operator delete(void *p, size_t size) {
+    ExprAllocator::deallocate(p, size);
+  }
+
+  virtual ~Expr() {
+    Expr::count--;
+    if (isUnique)
+      removeUnique();
+  }
 
   virtual Kind getKind() const = 0;
   virtual Width getWidth() const = 0;
@@ -227,9 +329,23 @@ public:
   /// Returns the pre-computed hash of the current expression
   virtual unsigned hash() const { return hashValue; }
 
-  /// (Re)computes the hash of the current expression.
+  /// (Re)computes the hash and the stable hash of the current expression.
   /// Returns the hash value. 
   virtual unsigned computeHash();
+
+  /// Returns the pre-computed stable hash of the current expression
+  const StableHash &stableHash() const { return stableHashValue; }
+
+  /// Returns the node structurally equal to the hashed expression e from
+  /// the table of unique expressions, adding e if there is none, when
+  /// hash-consing is enabled. Otherwise returns e.
+  ///
+  /// The table does not keep nodes alive. As the kids of unique nodes are
+  /// unique themselves, equal expressions built from them are the same
+  /// node, and comparing them for equality is a pointer comparison.
+  static ref<Expr> hashCons(const ref<Expr> &e) {
+    return hashConsing ? getUnique(e) : e;
+  }
   
   /// Compares `b` to `this` Expr for structural equivalence.
   ///
@@ -391,7 +507,8 @@ protected:
 public:
   static bool classof(const Expr *E) {
     Kind k = E->getKind();
-    return Expr::BinaryKindFirst <= k && k <= Expr::BinaryKindLast;
+    return (Expr::BinaryKindFirst <= k && k <= Expr::BinaryKindLast) ||
+           (Expr::FPBinaryKindFirst <= k && k <= Expr::FPBinaryKindLast);
   }
   static bool classof(const BinaryExpr *) { return true; }
 };
@@ -412,6 +529,23 @@ public:
   static bool classof(const CmpExpr *) { return true; }
 };
 
+/// A floating-point comparison. Unlike those of CmpExpr, its operands are
+/// not ordered as integers, so it is not a CmpExpr.
+class FPCmpExpr : public BinaryExpr {
+
+protected:
+  FPCmpExpr(ref<Expr> l, ref<Expr> r) : BinaryExpr(l, r) {}
+
+public:
+  Width getWidth() const { return Bool; }
+
+  static bool classof(const Expr *E) {
+    Kind k = E->getKind();
+    return Expr::FPCmpKindFirst <= k && k <= Expr::FPCmpKindLast;
+  }
+  static bool classof(const FPCmpExpr *) { return true; }
+};
+
 // Special
 
 class NotOptimizedExpr : public NonConstantExpr {
@@ -423,7 +557,7 @@ public:
   static ref<Expr> alloc(const ref<Expr> &src) {
     ref<Expr> r(new NotOptimizedExpr(src));
     r->computeHash();
-    return r;
+    return hashCons(r);
   }
   
   static ref<Expr> create(ref<Expr> src);
@@ -459,6 +593,7 @@ class UpdateNode {
 
   // cache instead of recalc
   unsigned hashValue;
+  StableHash stableHashValue;
 
 public:
   const ref<UpdateNode> next;
@@ -470,6 +605,14 @@ public:
 private:
   /// size of this update sequence, including this update
   unsigned size;
+
+  /// The latest writes at concrete indices in this sequence, down to the
+  /// first write at a symbolic index. Built on demand, from the index of
+  /// the next node, so extensions of a list share most of it.
+  struct WriteIndex;
+  mutable std::unique_ptr<const WriteIndex> writeIndex;
+
+  const WriteIndex &getWriteIndex() const;
   
 public:
   UpdateNode(const ref<UpdateNode> &_next, const ref<Expr> &_index,
@@ -477,11 +620,29 @@ public:
 
   unsigned getSize() const { return size; }
 
+  /// Find the latest write at the concrete index i in this sequence, whose
+  /// own index must be concrete, down to the first write at a symbolic
+  /// index.
+  ///
+  /// \param [out] symbolicWrite the first write at a symbolic index, or
+  /// null if there is none
+  /// \return the write at i, or null if there is none above symbolicWrite
+  const UpdateNode *findConcreteWrite(uint64_t i,
+                                      UpdateNode *&symbolicWrite) const;
+
   int compare(const UpdateNode &b) const;  
   unsigned hash() const { return hashValue; }
+  const StableHash &stableHash() const { return stableHashValue; }
 
   UpdateNode() = delete;
-  ~UpdateNode() = default;
+  ~UpdateNode();
+
+  static void *operator new(size_t size) {
+    return ExprAllocator::allocate(size);
+  }
+  static void operator delete(void *p, size_t size) {
+    ExprAllocator::deallocate(p, size);
+  }
 
   unsigned computeHash();
 };
@@ -497,13 +658,24 @@ public:
   /// Range is the size (in bits) of the number stored there (array of bytes -> 8)
   const Expr::Width domain, range;
 
-  /// constantValues - The constant initial values for this array, or empty for
-  /// a symbolic array. If non-empty, this size of this array is equivalent to
-  /// the array size.
-  const std::vector<ref<ConstantExpr> > constantValues;
-
 private:
+  /// The constant initial values of a constant array of bytes, packed one
+  /// byte each and shared by the arrays with the same values (see
+  /// ArrayCache). Expressions for them are made on demand by
+  /// getConstantValue.
+  std::shared_ptr<const std::vector<uint8_t> > constantBytes;
+
+  /// The constant initial values of a constant array with another range.
+  /// Both vectors are empty for a symbolic array, otherwise the one in use
+  /// has the size of the array.
+  std::vector<ref<ConstantExpr> > constantValues;
+
   unsigned hashValue;
+  StableHash stableHashValue;
+
+  /// Numbers the arrays densely in the order in which they were made (see
+  /// ArrayCache), e.g. to keep them in flat sorted tables.
+  unsigned id = 0;
 
   // FIXME: Make =delete when we switch to C++11
   Array(const Array& array);
@@ -526,9 +698,18 @@ private:
         Expr::Width _domain = Expr::Int32, Expr::Width _range = Expr::Int8);
 
 public:
-  bool isSymbolicArray() const { return constantValues.empty(); }
+  bool isSymbolicArray() const {
+    return !constantBytes && constantValues.empty();
+  }
   bool isConstantArray() const { return !isSymbolicArray(); }
 
+  /// \return the initial value at index of a constant array
+  ref<ConstantExpr> getConstantValue(size_t index) const;
+
+  /// \return the initial values of a constant array, or none for a symbolic
+  /// one. Byte arrays are expanded into a new vector on each call.
+  std::vector<ref<ConstantExpr> > getConstantValues() const;
+
   size_t getConstantSize() const {
       return size;
   }
@@ -542,6 +723,13 @@ public:
   /// ComputeHash must take into account the name, the size, the domain, and the range
   unsigned computeHash();
   unsigned hash() const { return hashValue; }
+
+  /// ComputeStableHash takes the name without a trailing "_<counter>", as
+  /// appended to make array names unique, into account instead of the name
+  void computeStableHash();
+  const StableHash &stableHash() const { return stableHashValue; }
+
+  unsigned getID() const { return id; }
   friend class ArrayCache;
 };
 
@@ -569,6 +757,7 @@ public:
 
   int compare(const UpdateList &b) const;
   unsigned hash() const;
+  StableHash stableHash() const;
 };
 
 /// Class representing a one byte read from an array. 
@@ -585,7 +774,7 @@ public:
   static ref<Expr> alloc(const UpdateList &updates, const ref<Expr> &index) {
     ref<Expr> r(new ReadExpr(updates, index));
     r->computeHash();
-    return r;
+    return hashCons(r);
   }
   
   static ref<Expr> create(const UpdateList &updates, ref<Expr> i);
@@ -630,7 +819,7 @@ public:
                          const ref<Expr> &f) {
     ref<Expr> r(new SelectExpr(c, t, f));
     r->computeHash();
-    return r;
+    return hashCons(r);
   }
   
   static ref<Expr> create(ref<Expr> c, ref<Expr> t, ref<Expr> f);
@@ -693,7 +882,7 @@ public:
   static ref<Expr> alloc(const ref<Expr> &l, const ref<Expr> &r) {
     ref<Expr> c(new ConcatExpr(l, r));
     c->computeHash();
-    return c;
+    return hashCons(c);
   }
   
   static ref<Expr> create(const ref<Expr> &l, const ref<Expr> &r);
@@ -769,7 +958,7 @@ public:
   static ref<Expr> alloc(const ref<Expr> &e, unsigned o, Width w) {
     ref<Expr> r(new ExtractExpr(e, o, w));
     r->computeHash();
-    return r;
+    return hashCons(r);
   }
   
   /// Creates an ExtractExpr with the given bit offset and width
@@ -820,7 +1009,7 @@ public:
   static ref<Expr> alloc(const ref<Expr> &e) {
     ref<Expr> r(new NotExpr(e));
     r->computeHash();
-    return r;
+    return hashCons(r);
   }
   
   static ref<Expr> create(const ref<Expr> &e);
@@ -882,7 +1071,8 @@ public:
 
   static bool classof(const Expr *E) {
     Expr::Kind k = E->getKind();
-    return Expr::CastKindFirst <= k && k <= Expr::CastKindLast;
+    return (Expr::CastKindFirst <= k && k <= Expr::CastKindLast) ||
+           (Expr::FPCastKindFirst <= k && k <= Expr::FPCastKindLast);
   }
   static bool classof(const CastExpr *) { return true; }
 };
@@ -897,7 +1087,7 @@ public:                                                          \
     static ref<Expr> alloc(const ref<Expr> &e, Width w) {        \
       ref<Expr> r(new _class_kind ## Expr(e, w));                \
       r->computeHash();                                          \
-      return r;                                                  \
+      return hashCons(r);                                        \
     }                                                            \
     static ref<Expr> create(const ref<Expr> &e, Width w);        \
     Kind getKind() const { return _class_kind; }                 \
@@ -915,6 +1105,12 @@ public:                                                          \
 
 CAST_EXPR_CLASS(SExt)
 CAST_EXPR_CLASS(ZExt)
+CAST_EXPR_CLASS(FPExt)
+CAST_EXPR_CLASS(FPTrunc)
+CAST_EXPR_CLASS(FPToUI)
+CAST_EXPR_CLASS(FPToSI)
+CAST_EXPR_CLASS(UIToFP)
+CAST_EXPR_CLASS(SIToFP)
 
 // Arithmetic/Bit Exprs
 
@@ -930,7 +1126,7 @@ CAST_EXPR_CLASS(ZExt)
     static ref<Expr> alloc(const ref<Expr> &l, const ref<Expr> &r) {           \
       ref<Expr> res(new _class_kind##Expr(l, r));                              \
       res->computeHash();                                                      \
-      return res;                                                              \
+      return hashCons(res);                                                    \
     }                                                                          \
     static ref<Expr> create(const ref<Expr> &l, const ref<Expr> &r);           \
     Width getWidth() const { return left->getWidth(); }                        \
@@ -964,22 +1160,26 @@ ARITHMETIC_EXPR_CLASS(Xor)
 ARITHMETIC_EXPR_CLASS(Shl)
 ARITHMETIC_EXPR_CLASS(LShr)
 ARITHMETIC_EXPR_CLASS(AShr)
+ARITHMETIC_EXPR_CLASS(FAdd)
+ARITHMETIC_EXPR_CLASS(FSub)
+ARITHMETIC_EXPR_CLASS(FMul)
+ARITHMETIC_EXPR_CLASS(FDiv)
 
 // Comparison Exprs
 
-#define COMPARISON_EXPR_CLASS(_class_kind)                                     \
-  class _class_kind##Expr : public CmpExpr {                                   \
+#define COMPARISON_EXPR_CLASS_WITH_BASE(_class_kind, _base)                    \
+  class _class_kind##Expr : public _base {                                     \
   public:                                                                      \
     static const Kind kind = _class_kind;                                      \
     static const unsigned numKids = 2;                                         \
                                                                                \
   public:                                                                      \
     _class_kind##Expr(const ref<Expr> &l, const ref<Expr> &r)                  \
-        : CmpExpr(l, r) {}                                                     \
+        : _base(l, r) {}                                                       \
     static ref<Expr> alloc(const ref<Expr> &l, const ref<Expr> &r) {           \
       ref<Expr> res(new _class_kind##Expr(l, r));                              \
       res->computeHash();                                                      \
-      return res;                                                              \
+      return hashCons(res);                                                    \
     }                                                                          \
     static ref<Expr> create(const ref<Expr> &l, const ref<Expr> &r);           \
     Kind getKind() const { return _class_kind; }                               \
@@ -999,6 +1199,9 @@ ARITHMETIC_EXPR_CLASS(AShr)
     }                                                                          \
   };
 
+#define COMPARISON_EXPR_CLASS(_class_kind)                                     \
+  COMPARISON_EXPR_CLASS_WITH_BASE(_class_kind, CmpExpr)
+
 COMPARISON_EXPR_CLASS(Eq)
 COMPARISON_EXPR_CLASS(Ne)
 COMPARISON_EXPR_CLASS(Ult)
@@ -1009,6 +1212,10 @@ COMPARISON_EXPR_CLASS(Slt)
 COMPARISON_EXPR_CLASS(Sle)
 COMPARISON_EXPR_CLASS(Sgt)
 COMPARISON_EXPR_CLASS(Sge)
+COMPARISON_EXPR_CLASS_WITH_BASE(FOEq, FPCmpExpr)
+COMPARISON_EXPR_CLASS_WITH_BASE(FOLt, FPCmpExpr)
+COMPARISON_EXPR_CLASS_WITH_BASE(FOLe, FPCmpExpr)
+COMPARISON_EXPR_CLASS_WITH_BASE(FUno, FPCmpExpr)
 
 // Terminal Exprs
 
@@ -1081,10 +1288,17 @@ public:
   static ref<Expr> fromMemory(void *address, Width w);
   void toMemory(void *address);
 
+  /// Returns the preallocated node for small values (-128 to 1024) of
+  /// common widths, or null.
+  static ref<ConstantExpr> getCached(const llvm::APInt &v);
+
   static ref<ConstantExpr> alloc(const llvm::APInt &v) {
+    if (v.getBitWidth() <= 64)
+      if (ref<ConstantExpr> cached = getCached(v))
+        return cached;
     ref<ConstantExpr> r(new ConstantExpr(v));
     r->computeHash();
-    return r;
+    return cast<ConstantExpr>(hashCons(r));
   }
 
   static ref<ConstantExpr> alloc(const llvm::APFloat &f) {
@@ -1162,6 +1376,29 @@ public:
   ref<ConstantExpr> Sgt(const ref<ConstantExpr> &RHS);
   ref<ConstantExpr> Sge(const ref<ConstantExpr> &RHS);
 
+  // Floating point, with the semantics of the floating-point kinds. The
+  // widths of the operands and results must have semantics, see
+  // getFloatSemantics.
+
+  ref<ConstantExpr> FAdd(const ref<ConstantExpr> &RHS);
+  ref<ConstantExpr> FSub(const ref<ConstantExpr> &RHS);
+  ref<ConstantExpr> FMul(const ref<ConstantExpr> &RHS);
+  ref<ConstantExpr> FDiv(const ref<ConstantExpr> &RHS);
+  ref<ConstantExpr> FOEq(const ref<ConstantExpr> &RHS);
+  ref<ConstantExpr> FOLt(const ref<ConstantExpr> &RHS);
+  ref<ConstantExpr> FOLe(const ref<ConstantExpr> &RHS);
+  ref<ConstantExpr> FUno(const ref<ConstantExpr> &RHS);
+  ref<ConstantExpr> FPExt(Width W);
+  ref<ConstantExpr> FPTrunc(Width W);
+  ref<ConstantExpr> FPToUI(Width W);
+  ref<ConstantExpr> FPToSI(Width W);
+  ref<ConstantExpr> UIToFP(Width W);
+  ref<ConstantExpr> SIToFP(Width W);
+
+  /// The semantics of the floating-point values of the given width, or
+  /// null if there are none
+  static const llvm::fltSemantics *getFloatSemantics(Width W);
+
   ref<ConstantExpr> Neg();
   ref<ConstantExpr> Not();
 };
@@ -0,0 +1,43 @@
+//===-- ExprAllocator.h -----------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_EXPRALLOCATOR_H
+#define KLEE_EXPRALLOCATOR_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace klee {
+
+/// ExprAllocator - Allocates expression and update nodes from slabs, one
+/// free list per size class. As the size of a node is fixed by its kind,
+/// each class holds the nodes of a few kinds, and freed nodes are reused
+/// by nodes of the same kinds instead of going back to malloc. Larger
+/// objects are passed through to the global operator new.
+class ExprAllocator {
+public:
+  /// Size classes are multiples of Granularity up to MaxSize bytes.
+  static const size_t Granularity = 8;
+  static const size_t MaxSize = 128;
+
+  static void *allocate(size_t size);
+  static void deallocate(void *p, size_t size);
+
+  /// The number of bytes in slabs, whether used by nodes or free.
+  static uint64_t getSlabBytes();
+
+  /// The number of bytes in slabs that no node uses. Slabs are not given
+  /// back to malloc, so malloc counts these bytes as used although they
+  /// are only held for later nodes.
+  static uint64_t getFreeBytes();
+};
+
+} // namespace klee
+
+#endif /* KLEE_EXPRALLOCATOR_H */
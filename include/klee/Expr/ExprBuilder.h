@@ -11,6 +11,9 @@
 #define KLEE_EXPRBUILDER_H
 
 #include "Expr.h"
+#include "ExprHashMap.h"
+
+#include <memory>
 
 namespace klee {
   /// ExprBuilder - Base expression builder class.
@@ -86,6 +89,35 @@ namespace klee {
   ///
   /// Base - The base builder to use when constructing expressions.
   ExprBuilder *createSimplifyingExprBuilder(ExprBuilder *Base);
+
+  /// createRewritingExprBuilder - Create an expression builder which applies
+  /// a table of rewrite rules: algebraic identities, extraction of bit ranges
+  /// through concatenations and extensions, and canonicalization of
+  /// comparisons.
+  ///
+  /// Base - The base builder to use when constructing expressions.
+  ExprBuilder *createRewritingExprBuilder(ExprBuilder *Base);
+
+  /// ExprRebuilder - Rebuilds expressions bottom-up through a builder, so
+  /// that its simplifications also apply to expressions made with
+  /// Expr::create. The result for every rebuilt node is remembered, so
+  /// shared and repeated sub-expressions are simplified once.
+  class ExprRebuilder {
+    std::unique_ptr<ExprBuilder> Builder;
+    ExprHashMap<ref<Expr>> Cache;
+    /// The cache is emptied when it holds this many results.
+    unsigned MaxCacheSize;
+
+  public:
+    /// Takes ownership of Builder.
+    explicit ExprRebuilder(ExprBuilder *Builder,
+                           unsigned MaxCacheSize = 1u << 16);
+    ~ExprRebuilder();
+
+    /// Returns an expression equivalent to E, which is E itself if the
+    /// builder did not change it.
+    ref<Expr> rebuild(const ref<Expr> &E);
+  };
 }
 
 #endif /* KLEE_EXPRBUILDER_H */
@@ -27,6 +27,7 @@ public:
   bool mayEqual(const uint64_t b);  
   bool mayEqual(const ValueType &b);
 
+  bool isFixed();
   bool isFullRange(unsigned width);
 
   ValueType set_union(ValueType &);
@@ -36,6 +37,8 @@ public:
   ValueType binaryAnd(ValueType &);
   ValueType binaryOr(ValueType &);
   ValueType binaryXor(ValueType &);
+  ValueType binaryShiftLeft(unsigned bits);
+  ValueType binaryShiftRight(unsigned bits);
   ValueType concat(ValueType &, unsigned width);
   ValueType add(ValueType &, unsigned width);
   ValueType sub(ValueType &, unsigned width);
@@ -65,7 +68,10 @@ public:
   ExprRangeEvaluator() {}
   virtual ~ExprRangeEvaluator() {}
 
-  T evaluate(const ref<Expr> &e);
+  /// evaluate - Return a range containing every value of e. Evaluating the
+  /// kids of e goes through this method, so subclasses can override it to
+  /// memoize the ranges or to narrow them with what else they know.
+  virtual T evaluate(const ref<Expr> &e);
 };
 
 template<class T>
@@ -125,10 +131,34 @@ T ExprRangeEvaluator<T>::evaluate(const ref<Expr> &e) {
     const Expr *ep = e.get();
     T res(0);
     for (unsigned i=0; i<ep->getNumKids(); i++)
-      res = res.concat(evaluate(ep->getKid(i)),8);
+      res = res.concat(evaluate(ep->getKid(i)), ep->getKid(i)->getWidth());
     return res;
   }
 
+  case Expr::Extract: {
+    // only the low bits of a value that fits them keep its range
+    const ExtractExpr *ee = cast<ExtractExpr>(e);
+    if (ee->offset == 0) {
+      T src = evaluate(ee->expr);
+      if (src.max() <= bits64::maxValueOfNBits(ee->width))
+        return src;
+    }
+    break;
+  }
+
+    // Casting
+
+  case Expr::ZExt:
+    return evaluate(cast<CastExpr>(e)->src);
+  case Expr::SExt: {
+    // non-negative values are extended with zeros
+    const CastExpr *ce = cast<CastExpr>(e);
+    T src = evaluate(ce->src);
+    if (src.max() <= bits64::maxValueOfNBits(ce->src->getWidth() - 1))
+      return src;
+    break;
+  }
+
     // Arithmetic
 
   case Expr::Add: {
@@ -169,6 +199,12 @@ T ExprRangeEvaluator<T>::evaluate(const ref<Expr> &e) {
 
     // Binary
 
+  case Expr::Not: {
+    // the complement reverses the order of the values
+    uint64_t max = bits64::maxValueOfNBits(e->getWidth());
+    T kid = evaluate(cast<NotExpr>(e)->expr);
+    return T(max - kid.max(), max - kid.min());
+  }
   case Expr::And: {
     const BinaryExpr *be = cast<BinaryExpr>(e);
     return evaluate(be->left).binaryAnd(evaluate(be->right));
@@ -182,15 +218,22 @@ T ExprRangeEvaluator<T>::evaluate(const ref<Expr> &e) {
     return evaluate(be->left).binaryXor(evaluate(be->right));
   }
   case Expr::Shl: {
-    //    BinaryExpr *be = cast<BinaryExpr>(e);
-    //    unsigned width = be->left->getWidth();
-    //    return evaluate(be->left).shl(evaluate(be->right), width);
+    const BinaryExpr *be = cast<BinaryExpr>(e);
+    unsigned width = be->left->getWidth();
+    T shift = evaluate(be->right);
+    if (shift.isFixed() && shift.min() < width) {
+      T left = evaluate(be->left);
+      if (left.max() <= bits64::maxValueOfNBits(width - shift.min()))
+        return left.binaryShiftLeft(shift.min());
+    }
     break;
   }
   case Expr::LShr: {
-    //    BinaryExpr *be = cast<BinaryExpr>(e);
-    //    unsigned width = be->left->getWidth();
-    //    return evaluate(be->left).lshr(evaluate(be->right), width);
+    const BinaryExpr *be = cast<BinaryExpr>(e);
+    unsigned width = be->left->getWidth();
+    T shift = evaluate(be->right);
+    if (shift.isFixed() && shift.min() < width)
+      return evaluate(be->left).binaryShiftRight(shift.min());
     break;
   }
   case Expr::AShr: {
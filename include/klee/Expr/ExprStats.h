@@ -0,0 +1,28 @@
+//===-- ExprStats.h ---------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_EXPRSTATS_H
+#define KLEE_EXPRSTATS_H
+
+#include "klee/Statistics/Statistic.h"
+
+namespace klee {
+namespace stats {
+
+  /// Number of constants returned from the preallocated small constants
+  /// instead of allocating a node, see ConstantExpr::getCached.
+  extern Statistic constantCacheHits;
+  /// Lookups in the results of --optimize-array, see ExprOptimizer.
+  extern Statistic arrayOptimizerCacheHits;
+  extern Statistic arrayOptimizerCacheMisses;
+
+}
+}
+
+#endif /* KLEE_EXPRSTATS_H */
@@ -0,0 +1,65 @@
+//===-- ExprTape.h ----------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_EXPRTAPE_H
+#define KLEE_EXPRTAPE_H
+
+#include "klee/Expr/Expr.h"
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace klee {
+class Assignment;
+
+/// An expression compiled to a flat sequence of instructions, one per node
+/// in post-order, for evaluating it quickly under many assignments. The
+/// value of each instruction is kept in a register of the same index, so
+/// evaluation neither walks the expression nor allocates.
+///
+/// Only expressions whose nodes are at most 64 bits wide can be compiled.
+class ExprTape {
+  struct Instruction {
+    Expr::Kind kind;
+    Expr::Width width;
+    /// The width of the first operand, for casts and comparisons.
+    Expr::Width operandWidth;
+    /// The registers of the operands.
+    unsigned operands[3];
+    /// The value of a constant, the offset of an extract or, for a read,
+    /// the position of its first update in updates.
+    uint64_t immediate;
+    /// The number of updates of a read.
+    unsigned numUpdates;
+    const Array *array;
+  };
+
+  std::vector<Instruction> code;
+  /// The registers of the index and value of each update of the reads,
+  /// from the most recent one.
+  std::vector<std::pair<unsigned, unsigned>> updates;
+  mutable std::vector<uint64_t> registers;
+
+public:
+  /// Compiles e, replacing the previously compiled expression. \return
+  /// false if e cannot be compiled
+  bool compile(const ref<Expr> &e);
+
+  bool isCompiled() const { return !code.empty(); }
+  size_t size() const { return code.size(); }
+
+  /// Evaluates the compiled expression under a, with the same result as
+  /// Assignment::evaluate. \return false if a division by zero is met,
+  /// which Assignment::evaluate does not evaluate to a constant
+  bool evaluate(const Assignment &a, uint64_t &result) const;
+};
+} // namespace klee
+
+#endif /* KLEE_EXPRTAPE_H */
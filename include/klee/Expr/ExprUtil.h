@@ -40,6 +40,18 @@ namespace klee {
                            InputIterator end,
                            std::vector<const Array*> &results);
 
+  /// Add the terms coefficient * expression and the constant to base, as
+  /// one linear form c + c1 * x1 + ... + cn * xn of the width of base. The
+  /// sums and constant multiples in base and the terms are taken apart, like
+  /// terms are merged and the terms are ordered by their expressions, so
+  /// that the offsets of a chain of address computations come out the same
+  /// whichever order they were added in. The terms must be of the width of
+  /// base.
+  ref<Expr> addLinearTerms(
+      ref<Expr> base,
+      const std::vector<std::pair<ref<Expr>, uint64_t>> &terms,
+      uint64_t constant);
+
   class ConstantArrayFinder : public ExprVisitor {
   protected:
     ExprVisitor::Action visitRead(const ReadExpr &re);
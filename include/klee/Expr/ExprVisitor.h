@@ -12,6 +12,9 @@
 
 #include "ExprHashMap.h"
 
+#include <utility>
+#include <vector>
+
 namespace klee {
   class ExprVisitor {
   protected:
@@ -41,8 +44,13 @@ namespace klee {
     };
 
   protected:
+    /// \param _recursive visit the expressions rebuilt from visited
+    /// children again
+    /// \param _iterative visit with an explicit stack instead of recursion,
+    /// for expressions too deep for the call stack
     explicit
-    ExprVisitor(bool _recursive=false) : recursive(_recursive) {}
+    ExprVisitor(bool _recursive=false, bool _iterative=false)
+      : recursive(_recursive), iterative(_iterative) {}
     virtual ~ExprVisitor() {}
 
     virtual Action visitExpr(const Expr&);
@@ -79,13 +87,53 @@ namespace klee {
     virtual Action visitSle(const SleExpr&);
     virtual Action visitSgt(const SgtExpr&);
     virtual Action visitSge(const SgeExpr&);
+    virtual Action visitFAdd(const FAddExpr&);
+    virtual Action visitFSub(const FSubExpr&);
+    virtual Action visitFMul(const FMulExpr&);
+    virtual Action visitFDiv(const FDivExpr&);
+    virtual Action visitFOEq(const FOEqExpr&);
+    virtual Action visitFOLt(const FOLtExpr&);
+    virtual Action visitFOLe(const FOLeExpr&);
+    virtual Action visitFUno(const FUnoExpr&);
+    virtual Action visitFPExt(const FPExtExpr&);
+    virtual Action visitFPTrunc(const FPTruncExpr&);
+    virtual Action visitFPToUI(const FPToUIExpr&);
+    virtual Action visitFPToSI(const FPToSIExpr&);
+    virtual Action visitUIToFP(const UIToFPExpr&);
+    virtual Action visitSIToFP(const SIToFPExpr&);
 
   private:
     typedef ExprHashMap< ref<Expr> > visited_ty;
     visited_ty visited;
     bool recursive;
+    bool iterative;
+
+    /// An open addressing table from expressions, by identity, to the
+    /// results of visiting them, used by the iterative visits.
+    class VisitMemo {
+      std::vector<std::pair<ref<Expr>, ref<Expr>>> slots;
+      size_t used = 0;
+
+      size_t slotOf(const Expr *e) const;
+
+    public:
+      const ref<Expr> *find(const ref<Expr> &e) const;
+      void insert(const ref<Expr> &e, const ref<Expr> &result);
+    };
+    VisitMemo memo;
+
+    /// An expression whose children are being visited iteratively.
+    struct VisitFrame;
 
     ref<Expr> visitActual(const ref<Expr> &e);
+    /// Calls the visit method for the kind of ep.
+    Action visitKind(const Expr &ep);
+    ref<Expr> visitIteratively(const ref<Expr> &e);
+    /// Starts the iterative visit of e. \return true if the result is
+    /// known without visiting the children, false if a frame for them was
+    /// pushed
+    bool enterIteratively(const ref<Expr> &e, std::vector<VisitFrame> &stack,
+                          ref<Expr> &result);
     
   public:
     // apply the visitor to the expression and return a possibly
@@ -0,0 +1,136 @@
+//===-- IndependentSet.h ----------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_INDEPENDENTSET_H
+#define KLEE_INDEPENDENTSET_H
+
+#include "klee/Expr/Expr.h"
+
+#include "llvm/Support/raw_ostream.h"
+
+#include <map>
+#include <memory>
+#include <set>
+#include <vector>
+
+namespace klee {
+
+template <class T> class DenseSet {
+  typedef std::set<T> set_ty;
+  set_ty s;
+
+public:
+  DenseSet() {}
+
+  void add(T x) { s.insert(x); }
+  void add(T start, T end) {
+    for (; start < end; start++)
+      s.insert(start);
+  }
+
+  // returns true iff set is changed by addition
+  bool add(const DenseSet &b) {
+    bool modified = false;
+    for (typename set_ty::const_iterator it = b.s.begin(), ie = b.s.end();
+         it != ie; ++it) {
+      if (modified || !s.count(*it)) {
+        modified = true;
+        s.insert(*it);
+      }
+    }
+    return modified;
+  }
+
+  bool intersects(const DenseSet &b) const {
+    for (typename set_ty::const_iterator it = s.begin(), ie = s.end();
+         it != ie; ++it)
+      if (b.s.count(*it))
+        return true;
+    return false;
+  }
+
+  typename set_ty::const_iterator begin() const { return s.begin(); }
+  typename set_ty::const_iterator end() const { return s.end(); }
+
+  void print(llvm::raw_ostream &os) const {
+    bool first = true;
+    os << "{";
+    for (typename set_ty::const_iterator it = s.begin(), ie = s.end();
+         it != ie; ++it) {
+      if (first) {
+        first = false;
+      } else {
+        os << ",";
+      }
+      os << *it;
+    }
+    os << "}";
+  }
+};
+
+template <class T>
+inline llvm::raw_ostream &operator<<(llvm::raw_ostream &os,
+                                     const DenseSet<T> &dis) {
+  dis.print(os);
+  return os;
+}
+
+/// The array elements read by a set of expressions.
+class IndependentElementSet {
+public:
+  typedef std::map<const Array *, DenseSet<unsigned>> elements_ty;
+  elements_ty elements;                 // Represents individual elements of array accesses (arr[1])
+  std::set<const Array *> wholeObjects; // Represents symbolically accessed arrays (arr[x])
+  std::vector<ref<Expr>> exprs;         // All expressions that are associated with this factor
+                                        // Although order doesn't matter, we use a vector to match
+                                        // the ConstraintManager constructor that will eventually
+                                        // be invoked.
+
+  IndependentElementSet() {}
+  explicit IndependentElementSet(ref<Expr> e);
+
+  void print(llvm::raw_ostream &os) const;
+
+  // more efficient when this is the smaller set
+  bool intersects(const IndependentElementSet &b) const;
+
+  // returns true iff set is changed by addition
+  bool add(const IndependentElementSet &b);
+};
+
+inline llvm::raw_ostream &operator<<(llvm::raw_ostream &os,
+                                     const IndependentElementSet &ies) {
+  ies.print(os);
+  return os;
+}
+
+/// The independent factors of a set of constraints: no two factors read
+/// a common array element. Partitions are immutable, so a constraint set
+/// and all its copies can share one and extend it as constraints are
+/// added, instead of splitting the whole set again for each query.
+class IndependentPartition {
+public:
+  typedef std::shared_ptr<const IndependentElementSet> factor_ty;
+
+private:
+  /// Factors are shared with the partitions this one was extended from.
+  std::vector<factor_ty> factors;
+
+public:
+  /// The partition of the constraints of this one and e: the factors that
+  /// e intersects are merged into one, all others are shared.
+  std::shared_ptr<const IndependentPartition>
+  extend(const ref<Expr> &e) const;
+
+  const std::vector<factor_ty> &getFactors() const { return factors; }
+};
+
+} // End klee namespace
+
+#endif /* KLEE_INDEPENDENTSET_H */
@@ -10,6 +10,8 @@
 #ifndef KLEE_LEXER_H
 #define KLEE_LEXER_H
 
+#include "llvm/ADT/StringRef.h"
+
 #include <string>
 
 namespace llvm {
@@ -60,9 +62,13 @@ namespace expr {
     const char *getKindName() const;
 
     /// getString - The string spanned by this token. This is not
-    /// particularly efficient, use start and length when reasonable.
+    /// particularly efficient, use getText when reasonable.
     std::string getString() const { return std::string(start, length); }
 
+    /// getText - The text spanned by this token, which refers to the
+    /// buffer being lexed.
+    llvm::StringRef getText() const { return llvm::StringRef(start, length); }
+
     /// isKeyword - True if this token is a keyword.
     bool isKeyword() const { 
       return kind >= KWKindFirst && kind <= KWKindLast; 
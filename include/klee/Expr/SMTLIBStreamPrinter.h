@@ -0,0 +1,137 @@
+//===-- SMTLIBStreamPrinter.h -----------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_SMTLIBSTREAMPRINTER_H
+#define KLEE_SMTLIBSTREAMPRINTER_H
+
+#include "klee/Expr/Expr.h"
+#include "klee/Expr/ExprHashMap.h"
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/StringMap.h"
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace llvm {
+class raw_ostream;
+}
+
+namespace klee {
+struct Query;
+
+/// Prints queries as SMT-LIBv2 commands, faster than ExprSMTLIBPrinter: the
+/// sub-expressions used more than once are found with a hash table in one
+/// pass and defined with define-fun, and everything is appended to a single
+/// buffer that is written out with flush(). Equal expressions and updates
+/// are printed once even if they are distinct objects.
+///
+/// In incremental mode the queries form one session: the arrays and the
+/// defined terms, including each constraint, are declared once at the top
+/// level and reused by the later queries, whose assertions are scoped by
+/// (push 1) and (pop 1). The output can then be fed to an SMT solver
+/// process as it is printed. Otherwise every query is a complete script.
+///
+/// As for ExprSMTLIBPrinter, a query is satisfiable if the original query
+/// is invalid.
+class SMTLIBStreamPrinter {
+  enum Sort { SORT_BITVECTOR, SORT_BOOL };
+
+  const bool incremental;
+  std::string buffer;
+  bool headerPrinted = false;
+
+  struct UpdateListHash {
+    unsigned operator()(const UpdateList &ul) const { return ul.hash(); }
+  };
+  struct UpdateListCmp {
+    bool operator()(const UpdateList &a, const UpdateList &b) const {
+      return a.compare(b) == 0;
+    }
+  };
+
+  /// The numbers of the defined terms and array updates, which are named
+  /// ?B<n> and ?U<n>.
+  ExprHashMap<unsigned> termIds;
+  std::unordered_map<UpdateList, unsigned, UpdateListHash, UpdateListCmp>
+      updateIds;
+  /// The SMT-LIB names of the declared arrays. Distinct arrays with the same
+  /// name get a numbered suffix.
+  llvm::DenseMap<const Array *, std::string> arrayNames;
+  llvm::StringMap<unsigned> arrayNameUses;
+  /// The definitions in the order they were printed.
+  std::vector<ref<Expr>> terms;
+  std::vector<UpdateList> updates;
+  std::vector<const Array *> arrays;
+  unsigned nextId = 0;
+
+  /// Where the last printed query starts, for discardQuery().
+  struct Mark {
+    size_t bufferSize, terms, updates, arrays;
+    bool headerPrinted;
+  } last = {};
+
+  /// The number of uses of the expressions of the query being printed that
+  /// are not defined yet, and the update nodes already counted.
+  ExprHashMap<unsigned> uses;
+  llvm::DenseSet<const UpdateNode *> countedUpdates;
+
+  static Sort getSort(const Expr *e);
+
+  void countUses(const ref<Expr> &root);
+  /// Defines the shared sub-expressions of root, and root itself if
+  /// defineRoot, in post-order, declaring the arrays they read.
+  void defineTerms(const ref<Expr> &root, bool defineRoot);
+  void defineTerm(const ref<Expr> &e);
+  void defineUpdates(const UpdateList &ul);
+  void declareArray(const Array *array);
+
+  void printExpr(const Expr *e, Sort sort);
+  void printFullExpr(const Expr *e, Sort sort);
+  void printConstant(const ConstantExpr *ce, Sort sort);
+  void printArgs(const Expr *e, Sort sort);
+  void printArray(const UpdateList &ul);
+  void printSort(const Expr *e);
+
+  void append(const char *s) { buffer += s; }
+  void append(const std::string &s) { buffer += s; }
+  void appendNumber(uint64_t value);
+  void appendIndex(unsigned index, const Array *array);
+
+public:
+  explicit SMTLIBStreamPrinter(bool incremental = false);
+
+  /// Appends the commands of query to the buffer, followed by (check-sat)
+  /// and, if objects is not null, a (get-value) command for the contents
+  /// of the arrays in it.
+  void printQuery(const Query &query,
+                  const std::vector<const Array *> *objects = nullptr);
+
+  /// Forgets the definitions made for the last printed query and removes
+  /// its commands if they were not flushed yet, e.g. when a logged query
+  /// is dropped after all.
+  void discardQuery();
+
+  /// Appends (exit), which ends an incremental session.
+  void printExit();
+
+  /// Forgets all definitions. In incremental mode, the next query starts
+  /// with (reset).
+  void reset();
+
+  const std::string &str() const { return buffer; }
+  /// Writes the buffer to os and empties it.
+  void flush(llvm::raw_ostream &os);
+};
+} // namespace klee
+
+#endif /* KLEE_SMTLIBSTREAMPRINTER_H */
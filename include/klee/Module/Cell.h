@@ -17,8 +17,20 @@ namespace klee {
   public:
     Cell() {}
     Cell(const KValue &other) : KValue(other) {}
+    Cell(KValue &&other) : KValue(std::move(other)) {}
 
     Cell(const Cell &other) = default;
+    Cell(Cell &&other) = default;
+    Cell &operator=(const Cell &other) = default;
+    Cell &operator=(Cell &&other) = default;
+    Cell &operator=(const KValue &other) {
+      KValue::operator=(other);
+      return *this;
+    }
+    Cell &operator=(KValue &&other) {
+      KValue::operator=(std::move(other));
+      return *this;
+    }
   };
 }
 
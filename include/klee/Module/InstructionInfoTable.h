@@ -10,15 +10,19 @@
 #ifndef KLEE_INSTRUCTIONINFOTABLE_H
 #define KLEE_INSTRUCTIONINFOTABLE_H
 
+#include <cstdint>
 #include <memory>
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 namespace llvm {
   class Function;
   class Instruction;
   class Module; 
+  class raw_ostream;
+  class Value;
 }
 
 namespace klee {
@@ -64,19 +68,44 @@ namespace klee {
   };
 
   class InstructionInfoTable {
-    std::unordered_map<const llvm::Instruction *,
-                       std::unique_ptr<InstructionInfo>>
+    /// The id and the assembly line of a function or instruction whose info
+    /// is not built yet.
+    struct Location {
+      unsigned id;
+      uint64_t assemblyLine;
+    };
+
+    mutable std::unordered_map<const llvm::Value *, Location> locations;
+    mutable std::unordered_map<const llvm::Instruction *,
+                               std::unique_ptr<InstructionInfo>>
         infos;
-    std::unordered_map<const llvm::Function *, std::unique_ptr<FunctionInfo>>
+    mutable std::unordered_map<const llvm::Function *,
+                               std::unique_ptr<FunctionInfo>>
         functionInfos;
-    std::vector<std::unique_ptr<std::string>> internedStrings;
+    mutable std::unordered_set<std::string> internedStrings;
+    unsigned maxID = 0;
+
+    /// Build the infos of f and of its instructions.
+    const FunctionInfo &resolve(const llvm::Function &f) const;
 
   public:
-    explicit InstructionInfoTable(const llvm::Module &m);
+    /// \param assembly if not null, the assembly of m is written to it; the
+    /// assembly lines of the infos refer to it
+    /// \param lazy if true, the debug information of a function is only
+    /// extracted once an info of the function is asked for; the ids and the
+    /// assembly lines are always assigned up front
+    explicit InstructionInfoTable(const llvm::Module &m,
+                                  llvm::raw_ostream *assembly = nullptr,
+                                  bool lazy = false);
 
     unsigned getMaxID() const;
     const InstructionInfo &getInfo(const llvm::Instruction &) const;
     const FunctionInfo &getFunctionInfo(const llvm::Function &) const;
+
+    /// The id of the info of an instruction, without building the info.
+    unsigned getID(const llvm::Instruction &) const;
+    /// The id of the info of a function, without building the info.
+    unsigned getFunctionID(const llvm::Function &) const;
   };
 
 }
@@ -41,6 +41,49 @@ namespace klee {
     int *operands;
     /// Destination register index.
     unsigned dest;
+    /// Registers that are dead once the instruction is reached, as no path
+    /// from it reads them before they are written again. The executor clears
+    /// them so their expressions can be released. The formals are never
+    /// dead, since stack traces print them.
+    std::vector<unsigned> deadRegisters;
+
+    /// Pre-decoded class of the instruction, assigned when the function is
+    /// built so the interpreter can dispatch without querying LLVM.
+    enum Kind : uint8_t {
+      /// executed by the generic interpreter only
+      Generic,
+      /// integer binary operator
+      IntBinary,
+      /// integer or pointer comparison
+      IntCompare,
+      /// cast between integers and pointers
+      IntCast,
+    };
+    Kind kind = Generic;
+    /// The LLVM opcode of inst.
+    unsigned opcode = 0;
+    /// The comparison predicate for IntCompare, 0 otherwise.
+    unsigned predicate = 0;
+    /// The width in bits of the result for IntBinary and IntCast, 0 otherwise.
+    unsigned width = 0;
+
+    /// Checks the executor runs before the instruction with --check-mode=native.
+    enum Check : uint8_t {
+      /// the divisor is not zero
+      CheckDivZero = 1,
+      /// the shift amount is smaller than the width
+      CheckOvershift = 2,
+    };
+    /// The Check flags of the instruction.
+    uint8_t checks = 0;
+    /// For loads and stores, whether the access was proven to lie in bounds
+    /// of the fixed-size alloca or global it is based on when the module was
+    /// prepared, see InBoundsAccessesPass.
+    bool inBounds = false;
+    /// For calls of __VERIFIER_nondet functions and the stores of their
+    /// values, whether the values fill the elements of a buffer, see
+    /// NondetFillsPass.
+    bool fillsNondet = false;
 
   public:
     virtual ~KInstruction();
@@ -15,7 +15,9 @@
 #include "klee/Module/KCallable.h"
 
 #include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMap.h"
 
+#include <cstdint>
 #include <map>
 #include <memory>
 #include <set>
@@ -25,7 +27,9 @@ namespace llvm {
   class BasicBlock;
   class Constant;
   class Function;
+  class GlobalVariable;
   class Instruction;
+  class LLVMContext;
   class Module;
   class DataLayout;
 }
@@ -48,8 +52,8 @@ namespace klee {
     unsigned numInstructions;
     KInstruction **instructions;
 
-    std::map<llvm::BasicBlock*, unsigned> basicBlockEntry;
-    std::map<llvm::Instruction*, KInstruction*> instructionsMap;
+    llvm::DenseMap<const llvm::BasicBlock *, unsigned> basicBlockEntry;
+    llvm::DenseMap<const llvm::Instruction *, KInstruction *> instructionsMap;
 
     /// Whether instructions in this function should count as
     /// "coverable" for statistics and search heuristics.
@@ -73,14 +77,68 @@ namespace klee {
       return callable->getKind() == CK_Function;
     }
 
-    KInstruction *getKInstruction(llvm::Instruction *I) const {
+    KInstruction *getKInstruction(const llvm::Instruction *I) const {
         auto it = instructionsMap.find(I);
         assert(it != instructionsMap.end());
         return it->second;
     }
+
+    /// Index into instructions of the first instruction of bb.
+    unsigned getBasicBlockEntry(const llvm::BasicBlock *bb) const {
+        auto it = basicBlockEntry.find(bb);
+        assert(it != basicBlockEntry.end());
+        return it->second;
+    }
   };
 
 
+  /// A counting loop whose iterations the executor replaces by their closed
+  /// form, see --summarize-loops. Every iteration adds a loop-invariant step
+  /// to each phi of the header, the only block of the loop with phis, and
+  /// the loop is left from its only exiting block once the counter fails the
+  /// test against a loop-invariant bound. Nothing else in the loop has an
+  /// effect or is used after it.
+  struct LoopSummary {
+    /// The comparison of the counter with the bound under which the loop
+    /// continues.
+    enum class Test : std::uint8_t {
+      NotEqual,
+      SignedLess,
+      UnsignedLess,
+      SignedGreater,
+      UnsignedGreater
+    };
+
+    /// A phi of the header and the instruction computing its next value,
+    /// the phi plus (or minus) the step operand.
+    struct Recurrence {
+      llvm::Instruction *phi;
+      llvm::Instruction *update;
+      unsigned stepOperand;
+      bool subtract;
+    };
+
+    /// The only block outside the loop branching to its header.
+    llvm::BasicBlock *enteredFrom;
+    llvm::BasicBlock *exiting;
+    llvm::BasicBlock *exit;
+    /// Whether exiting is the latch, so that the next values of the
+    /// recurrences are live after the loop.
+    bool exitsAtLatch;
+
+    std::vector<Recurrence> recurrences;
+    /// The recurrence of the counter, whose step is 1 or -1.
+    unsigned counter;
+    bool counterIncreases;
+    /// The comparison deciding whether to leave the loop, of the phi or (if
+    /// testsNext) of the next value of the counter with its operand
+    /// boundOperand.
+    llvm::Instruction *test;
+    unsigned boundOperand;
+    bool testsNext;
+    Test continueWhile;
+  };
+
   class KConstant {
   public:
     /// Actual LLVM constant this represents.
@@ -104,7 +162,7 @@ namespace klee {
 
     // Our shadow versions of LLVM structures.
     std::vector<std::unique_ptr<KFunction>> functions;
-    std::map<llvm::Function*, KFunction*> functionMap;
+    llvm::DenseMap<const llvm::Function *, KFunction *> functionMap;
 
     // Functions which escape (may be called indirectly)
     // XXX change to KFunction
@@ -121,10 +179,35 @@ namespace klee {
     // Functions which are part of KLEE runtime
     std::set<const llvm::Function*> internalFunctions;
 
+    // Allocas and globals whose memory never holds a pointer
+    std::set<const llvm::Value*> pointerFreeAllocSites;
+
+    // Loads and stores proven in bounds of their allocation site
+    std::set<const llvm::Instruction*> inBoundsAccesses;
+
+    // The functions of --memoize-calls, with the globals they read
+    std::map<const llvm::Function *, std::vector<const llvm::GlobalVariable *>>
+        memoizableFunctions;
+
+    // The nondet calls of --batch-nondet-fills and the stores of their values
+    std::set<const llvm::Instruction*> nondetFills;
+
+    // The loops of --summarize-loops, by header
+    std::map<const llvm::BasicBlock *, LoopSummary> loopSummaries;
+
+    // The KInstruction::Check flags the executor runs natively
+    uint8_t nativeChecks = 0;
+
   private:
     // Mark function with functionName as part of the KLEE runtime
     void addInternalFunction(const char* functionName);
 
+    // Mark the runtime functions enabled by opts as internal
+    void addInternalFunctions(const Interpreter::ModuleOptions &opts);
+
+    // Select the checks of opts the executor runs natively
+    void selectNativeChecks(const Interpreter::ModuleOptions &opts);
+
   public:
     KModule() = default;
 
@@ -158,14 +241,35 @@ namespace klee {
 
     void instrument(const Interpreter::ModuleOptions &opts);
 
+    /// Return the file of the prepared module for the given modules and
+    /// options in --module-cache, or an empty string if it is disabled.
+    std::string
+    getCacheKey(const std::vector<std::unique_ptr<llvm::Module>> &modules,
+                const Interpreter::ModuleOptions &opts) const;
+
+    /// Load the prepared module cached under key instead of linking and
+    /// optimising. \return true iff a module was loaded
+    bool loadFromCache(const std::string &key, llvm::LLVMContext &ctx);
+
+    /// Recompute the state of a module loaded from the cache that
+    /// optimiseAndPrepare keeps outside of the module.
+    void restoreFromCache(const Interpreter::ModuleOptions &opts);
+
+    /// Store the prepared module under key, see getCacheKey.
+    void storeInCache(const std::string &key) const;
+
     /// Return an id for the given constant, creating a new one if necessary.
     unsigned getConstantID(llvm::Constant *c, KInstruction* ki);
 
+    /// Point the instructions of kf to their infos, which
+    /// --lazy-instruction-info leaves to the first execution of kf.
+    void resolveInfos(KFunction *kf) const;
+
     /// Run passes that check if module is valid LLVM IR and if invariants
     /// expected by KLEE's Executor hold.
     void checkModule();
 
-    KInstruction *getKInstruction(llvm::Instruction *I) const;
+    KInstruction *getKInstruction(const llvm::Instruction *I) const;
   };
 } // End klee namespace
 
@@ -30,40 +30,109 @@ namespace klee {
   class KValue {
   public:
     ref<Expr> value;
-    ref<Expr> pointerSegment;
+
+  private:
+    /// Segment expression. It is null when the segment is concrete and has
+    /// not been needed as an expression yet; the concrete value is then kept
+    /// in concreteSegment and the expression is created on demand.
+    mutable ref<Expr> pointerSegment;
+    /// Concrete value of the segment, valid iff hasInlineSegment is set.
+    uint64_t concreteSegment;
+    bool hasInlineSegment;
+
+    void setSegment(ref<Expr> segment) {
+      ConstantExpr *CE = dyn_cast_or_null<ConstantExpr>(segment);
+      hasInlineSegment = CE && CE->getWidth() <= Expr::Int64;
+      concreteSegment = hasInlineSegment ? CE->getZExtValue() : 0;
+      pointerSegment = std::move(segment);
+    }
 
   public:
-    KValue() {}
-    KValue(const KValue &other) : value(other.value), pointerSegment(other.pointerSegment) {}
+    /// Returns a shared ConstantExpr for the given segment of the given
+    /// width. Special segments of the common widths are interned, so the
+    /// values built for ordinary (non-pointer) results do not allocate.
+    static ref<ConstantExpr> getSegmentConstant(uint64_t segment,
+                                                Expr::Width width) {
+      // indexed by SpecialSegment (VALUES, FUNCTIONS, ERRNO) and width
+      static ref<ConstantExpr> interned[3][Expr::Int64 + 1];
+      unsigned idx;
+      switch (segment) {
+      case VALUES_SEGMENT: idx = 0; break;
+      case FUNCTIONS_SEGMENT: idx = 1; break;
+      case ERRNO_SEGMENT: idx = 2; break;
+      default: return ConstantExpr::alloc(segment, width);
+      }
+      if (width > Expr::Int64)
+        return ConstantExpr::alloc(segment, width);
+      ref<ConstantExpr> &entry = interned[idx][width];
+      if (entry.isNull())
+        entry = ConstantExpr::alloc(segment, width);
+      return entry;
+    }
+
+    KValue() : concreteSegment(0), hasInlineSegment(false) {}
+    KValue(const KValue &other) = default;
+    KValue(KValue &&other) = default;
+    // the expressions are taken by value and moved from, so that
+    // temporaries are adopted without touching their reference counts
     KValue(ref<Expr> value)
-      : value(value), pointerSegment(ConstantExpr::alloc(VALUES_SEGMENT, value->getWidth())) {}
+      : value(std::move(value)), concreteSegment(VALUES_SEGMENT),
+        hasInlineSegment(true) {}
     KValue(ref<ConstantExpr> value)
-      : value(value), pointerSegment(ConstantExpr::alloc(VALUES_SEGMENT, value->getWidth())) {}
+      : value(std::move(value)), concreteSegment(VALUES_SEGMENT),
+        hasInlineSegment(true) {}
     KValue(ref<Expr> segment, ref<Expr> offset)
-      : value(offset), pointerSegment(segment) {}
-    KValue(SpecialSegment segment, const ref<Expr> &offset)
-        : value(offset), pointerSegment(ConstantExpr::alloc(segment, value->getWidth())) {}
+      : value(std::move(offset)) {
+      setSegment(std::move(segment));
+    }
+    KValue(SpecialSegment segment, ref<Expr> offset)
+      : value(std::move(offset)), concreteSegment(segment),
+        hasInlineSegment(true) {}
 
     KValue& operator=(const KValue &other) = default;
+    KValue& operator=(KValue &&other) = default;
 
-    ref<Expr> getValue() const { return value; }
-    ref<Expr> getOffset() const { return value; }
-    ref<Expr> getSegment() const { return pointerSegment; }
+    const ref<Expr> &getValue() const { return value; }
+    const ref<Expr> &getOffset() const { return value; }
+    const ref<Expr> &getSegment() const {
+      if (pointerSegment.isNull() && hasInlineSegment)
+        pointerSegment = getSegmentConstant(concreteSegment, getWidth());
+      return pointerSegment;
+    }
+
+    /// Returns true iff the segment is a ConstantExpr of at most 64 bits,
+    /// whose value is then available through getConstantSegment().
+    bool hasConstantSegment() const { return hasInlineSegment; }
+    uint64_t getConstantSegment() const {
+      assert(hasInlineSegment && "segment is not a known constant");
+      return concreteSegment;
+    }
+
+    /// Checks if the segment is a constant zero, without building its
+    /// expression.
+    bool isSegmentZero() const {
+      if (hasInlineSegment)
+        return concreteSegment == 0;
+      ConstantExpr *CE = dyn_cast_or_null<ConstantExpr>(pointerSegment);
+      return CE && CE->isZero();
+    }
 
     ref<Expr> createIsZero() const {
+      if (isSegmentZero())
+        return Expr::createIsZero(getOffset());
       return AndExpr::create(Expr::createIsZero(getSegment()),
                              Expr::createIsZero(getOffset()));
     }
 
     /// Checks if both segment and offset are ConstantExpr and if yes, if they contain zero value
     bool isZero() const {
-      ConstantExpr *segment = dyn_cast<ConstantExpr>(pointerSegment);
       ConstantExpr *offset = dyn_cast<ConstantExpr>(value);
-      return (segment && offset && segment->isZero() && offset->isZero());
+      return (offset && isSegmentZero() && offset->isZero());
     }
 
     bool isConstant() const {
-      return isa<ConstantExpr>(value) && isa<ConstantExpr>(pointerSegment);
+      return isa<ConstantExpr>(value) &&
+             (hasInlineSegment || isa<ConstantExpr>(pointerSegment));
     }
 
     Expr::Width getWidth() const {
@@ -71,32 +140,38 @@ namespace klee {
     }
     
     KValue ZExt(Expr::Width w) const {
-      return KValue(ZExtExpr::create(pointerSegment, w),
+      if (isSegmentZero())
+        return KValue(ZExtExpr::create(value, w));
+      return KValue(ZExtExpr::create(getSegment(), w),
                     ZExtExpr::create(value, w));
     }
 
     KValue SExt(Expr::Width w) const {
-      return KValue(SExtExpr::create(pointerSegment, w),
+      if (isSegmentZero())
+        return KValue(SExtExpr::create(value, w));
+      return KValue(SExtExpr::create(getSegment(), w),
                     SExtExpr::create(value, w));
     }
 
 #define _op_seg_different(op) \
      KValue op(const KValue &other) const { \
-      if (getSegment().get()->isZero() && other.getSegment().get()->isZero()) { \
+      if (isSegmentZero() && other.isSegmentZero()) { \
         return KValue(op##Expr::create(value, other.value)); \
       } else { \
         KValue retval = KValue(op##Expr::create(value, other.value)); \
-        if (getSegment().get()->isZero()) { \
-          retval.pointerSegment = other.getSegment(); \
+        if (isSegmentZero()) { \
+          retval.setSegment(other.getSegment()); \
         } else { \
-          retval.pointerSegment = getSegment(); \
+          retval.setSegment(getSegment()); \
         } \
         return retval; \
       } \
     }
 #define _op_seg_same(op) \
     KValue op(const KValue &other) const { \
-      return KValue(op##Expr::create(pointerSegment, other.pointerSegment), \
+      if (isSegmentZero() && other.isSegmentZero()) \
+        return KValue(op##Expr::create(value, other.value)); \
+      return KValue(op##Expr::create(getSegment(), other.getSegment()), \
                     op##Expr::create(value, other.value)); \
     }
 #define _op_seg_zero(op) \
@@ -110,7 +185,9 @@ namespace klee {
     _op_seg_same(Sub);
     KValue Mul(const KValue &other) const {
       // multiplying pointers doesn't make sense, but we must ensure that identity 1*x==x works
-      return KValue(AddExpr::create(pointerSegment, other.pointerSegment),
+      if (isSegmentZero() && other.isSegmentZero())
+        return KValue(MulExpr::create(value, other.value));
+      return KValue(AddExpr::create(getSegment(), other.getSegment()),
                     MulExpr::create(value, other.value));
     }
 
@@ -129,10 +206,12 @@ namespace klee {
 #define _op_seg_cmp_lexicographic(cmp) \
     KValue cmp(const KValue &other) const { \
       if (isa<ConstantExpr>(value) && isa<ConstantExpr>(other.value)) { \
+        if (isSegmentZero() && other.isSegmentZero()) \
+          return KValue(cmp##Expr::create(value, other.value)); \
         return KValue(SelectExpr::create( \
-              EqExpr::create(pointerSegment, other.pointerSegment), \
+              EqExpr::create(getSegment(), other.getSegment()), \
               cmp##Expr::create(value, other.value), \
-              cmp##Expr::create(pointerSegment, other.pointerSegment))); \
+              cmp##Expr::create(getSegment(), other.getSegment()))); \
       } else { \
         return KValue(cmp##Expr::create(value, other.value)); \
       } \
@@ -152,24 +231,32 @@ namespace klee {
     }
 
     KValue Eq(const KValue &other) const {
+      if (isSegmentZero() && other.isSegmentZero())
+        return KValue(EqExpr::create(value, other.value));
       return KValue(AndExpr::create(
-                      EqExpr::create(pointerSegment, other.pointerSegment),
+                      EqExpr::create(getSegment(), other.getSegment()),
                       EqExpr::create(value, other.value)));
     }
 
     KValue Ne(const KValue &other) const {
+      if (isSegmentZero() && other.isSegmentZero())
+        return KValue(NeExpr::create(value, other.value));
       return KValue(OrExpr::create(
-                      NeExpr::create(pointerSegment, other.pointerSegment),
+                      NeExpr::create(getSegment(), other.getSegment()),
                       NeExpr::create(value, other.value)));
     }
 
     KValue Select(const KValue &b1, const KValue &b2) const {
-      return KValue(SelectExpr::create(value, b1.pointerSegment, b2.pointerSegment),
+      if (b1.isSegmentZero() && b2.isSegmentZero())
+        return KValue(SelectExpr::create(value, b1.value, b2.value));
+      return KValue(SelectExpr::create(value, b1.getSegment(), b2.getSegment()),
                     SelectExpr::create(value, b1.value, b2.value));
     }
 
     KValue Extract(unsigned bitOff, Expr::Width width) const {
-      return KValue(ExtractExpr::create(pointerSegment, bitOff, width),
+      if (isSegmentZero())
+        return KValue(ExtractExpr::create(value, bitOff, width));
+      return KValue(ExtractExpr::create(getSegment(), bitOff, width),
                     ExtractExpr::create(value, bitOff, width));
     }
 
@@ -177,22 +264,23 @@ namespace klee {
     static KValue concatValues(const T &input) {
       std::vector<ref<Expr> > segments;
       std::vector<ref<Expr> > values;
+      bool allSegmentsZero = true;
       for (const KValue& item : input) {
+        allSegmentsZero &= item.isSegmentZero();
         segments.push_back(item.getSegment());
         values.push_back(item.getValue());
       }
+      if (allSegmentsZero)
+        return KValue(ConcatExpr::createN(values.size(), values.data()));
       return KValue(ConcatExpr::createN(segments.size(), segments.data()),
                     ConcatExpr::createN(values.size(), values.data()));
     }
   };
 
   inline llvm::raw_ostream &operator<<(llvm::raw_ostream &os, const KValue &kvalue) {
-    if (ConstantExpr *CE = dyn_cast<ConstantExpr>(kvalue.pointerSegment)) {
-      if (CE->isZero()) {
-        return os << kvalue.value;
-      }
-    }
-    return os << kvalue.pointerSegment << ':' << kvalue.value;
+    if (kvalue.isSegmentZero())
+      return os << kvalue.value;
+    return os << kvalue.getSegment() << ':' << kvalue.value;
   }
 }
 
@@ -15,7 +15,9 @@
 #define KLEE_COMMON_H
 
 #include "klee/Solver/Solver.h"
+#include "klee/Solver/SolverProfile.h"
 
+#include <deque>
 #include <string>
 
 namespace klee {
@@ -23,12 +25,21 @@ namespace klee {
     const char SOLVER_QUERIES_SMT2_FILE_NAME[]="solver-queries.smt2";
     const char ALL_QUERIES_KQUERY_FILE_NAME[]="all-queries.kquery";
     const char SOLVER_QUERIES_KQUERY_FILE_NAME[]="solver-queries.kquery";
+    const char ALL_QUERIES_BINARY_FILE_NAME[]="all-queries.kqbin";
+    const char SOLVER_QUERIES_BINARY_FILE_NAME[]="solver-queries.kqbin";
 
+    /// If profiles is not null, the core solver and each caching or
+    /// simplifying layer get a profiling solver in front of them, whose
+    /// profile is appended to profiles, from the core up.
     Solver *constructSolverChain(Solver *coreSolver,
                                  std::string querySMT2LogPath,
                                  std::string baseSolverQuerySMT2LogPath,
                                  std::string queryKQueryLogPath,
-                                 std::string baseSolverQueryKQueryLogPath);
+                                 std::string baseSolverQueryKQueryLogPath,
+                                 std::string queryBinaryLogPath,
+                                 std::string baseSolverQueryBinaryLogPath,
+                                 std::deque<SolverLayerProfile> *profiles =
+                                     nullptr);
 }
 
 
@@ -21,6 +21,7 @@ namespace klee {
   class ConstraintSet;
   class Expr;
   class SolverImpl;
+  struct SolverLayerProfile;
 
   /// Collection of meta data that a solver can have access to. This is
   /// independent of the actual constraints but can be used as a two-way
@@ -28,6 +29,16 @@ namespace klee {
   struct SolverQueryMetaData {
     /// @brief Costs for all queries issued for this state
     time::Span queryCost;
+    /// @brief Moving average of the costs of the last queries issued for
+    /// this state, each query weighing a quarter
+    time::Span recentQueryCost;
+    /// @brief Whether this state results from merging states
+    bool fromMerge = false;
+
+    void addQueryCost(time::Span cost) {
+      queryCost += cost;
+      recentQueryCost = recentQueryCost * 0.75 + cost * 0.25;
+    }
   };
 
   struct Query {
@@ -223,12 +234,28 @@ namespace klee {
   /// \param s - The underlying solver to use.
   Solver *createAssignmentValidatingSolver(Solver *s);
 
+  /// createCanonicalizingSolver - Create a solver which renames the arrays of
+  /// each query in the order of their first occurrence and orders the
+  /// operands of commutative operations and the constraints, so that
+  /// equivalent queries hit in the caches of the underlying solvers.
+  ///
+  /// \param s - The underlying solver to use.
+  Solver *createCanonicalizingSolver(Solver *s);
+
   /// createCachingSolver - Create a solver which will cache the queries in
   /// memory (without eviction).
   ///
   /// \param s - The underlying solver to use.
   Solver *createCachingSolver(Solver *s);
 
+  /// createPersistentCachingSolver - Create a solver which keeps the answers
+  /// of the underlying solver in a file, where later runs and other
+  /// processes find them again.
+  ///
+  /// \param s - The underlying solver to use.
+  /// \param path - The cache file, created if it does not exist.
+  Solver *createPersistentCachingSolver(Solver *s, const std::string &path);
+
   /// createCexCachingSolver - Create a counterexample caching solver. This is a
   /// more sophisticated cache which records counterexamples for a constraint
   /// set and uses subset/superset relations among constraints to try and
@@ -244,6 +271,20 @@ namespace klee {
   /// \param s - The underlying solver to use.
   Solver *createFastCexSolver(Solver *s);
 
+  /// createSegmentSolver - Create a solver which decides queries over
+  /// constants and selects between them, such as comparisons of pointer
+  /// segments, by propagating the finite sets of values they can take.
+  ///
+  /// \param s - The underlying solver to use.
+  Solver *createSegmentSolver(Solver *s);
+
+  /// createKnownModelSolver - Create a solver which answers queries with
+  /// the known model of their constraints where possible, and stores the
+  /// counterexamples it computes as models of their constraints.
+  ///
+  /// \param s - The underlying solver to use.
+  Solver *createKnownModelSolver(Solver *s);
+
   /// createIndependentSolver - Create a solver which will eliminate any
   /// unnecessary constraints before propogating the query to the underlying
   /// solver.
@@ -263,11 +304,46 @@ namespace klee {
                                     time::Span minQueryTimeToLog,
                                     bool logTimedOut);
 
+  /// createBinaryQueryLoggingSolver - Create a solver which will forward all
+  /// queries after writing them to the given path as a binary query log.
+  Solver *createBinaryQueryLoggingSolver(Solver *s, std::string path,
+                                         time::Span minQueryTimeToLog,
+                                         bool logTimedOut);
+
+  /// createProfilingSolver - Create a solver which records the number, hits
+  /// and latencies of the queries passed to s in profile.
+  ///
+  /// \param below - The profile of the next profiling solver below s, whose
+  /// queries are not hits of s, or null.
+  Solver *createProfilingSolver(Solver *s, SolverLayerProfile &profile,
+                                const SolverLayerProfile *below);
+
+  /// createQueryShapeSolver - Create a solver which records the shapes and
+  /// solve times of the queries passed to s in a new entry of
+  /// getQueryShapeStats() for the given backend.
+  Solver *createQueryShapeSolver(Solver *s, const std::string &backend);
 
   /// createDummySolver - Create a dummy solver implementation which always
   /// fails.
   Solver *createDummySolver();
 
+  /// createPortfolioSolver - Create a solver that runs each query on all
+  /// backends in parallel, each in a forked process, and returns the first
+  /// answer.
+  ///
+  /// \param backends - The solvers to race, which the portfolio owns.
+  Solver *createPortfolioSolver(
+      std::vector<std::pair<CoreSolverType, Solver *>> backends);
+
+  /// createEscalatingSolver - Create a solver that retries the queries
+  /// primary fails on with fallback and then with primary and its timeout
+  /// scaled by timeoutFactor.
+  ///
+  /// \param fallback - The solver of the second stage, or null to skip it.
+  /// \param timeoutFactor - The factor of the last stage, 1 to skip it.
+  Solver *createEscalatingSolver(Solver *primary, Solver *fallback,
+                                 unsigned timeoutFactor);
+
   // Create a solver based on the supplied ``CoreSolverType``.
   Solver *createCoreSolver(CoreSolverType cst);
 }
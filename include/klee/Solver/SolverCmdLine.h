@@ -24,12 +24,22 @@ namespace klee {
 
 extern llvm::cl::opt<bool> UseFastCexSolver;
 
+extern llvm::cl::opt<bool> UseSegmentSolver;
+
 extern llvm::cl::opt<bool> UseCexCache;
 
 extern llvm::cl::opt<bool> UseBranchCache;
 
 extern llvm::cl::opt<bool> UseIndependentSolver;
 
+extern llvm::cl::opt<bool> IncrementalIndependence;
+
+extern llvm::cl::opt<bool> UseKnownModel;
+
+extern llvm::cl::opt<bool> CanonicalizeQueries;
+
+extern llvm::cl::opt<std::string> PersistentQueryCache;
+
 extern llvm::cl::opt<bool> DebugValidateSolver;
 
 extern llvm::cl::opt<std::string> MinQueryTimeToLog;
@@ -40,6 +50,8 @@ extern llvm::cl::opt<std::string> MaxCoreSolverTime;
 
 extern llvm::cl::opt<bool> UseForkedCoreSolver;
 
+extern llvm::cl::opt<bool> QueryShapeStatistics;
+
 extern llvm::cl::opt<bool> CoreSolverOptimizeDivides;
 
 extern llvm::cl::opt<bool> UseAssignmentValidatingSolver;
@@ -49,16 +61,29 @@ enum QueryLoggingSolverType {
   ALL_KQUERY,    ///< Log all queries in .kquery (KQuery) format
   ALL_SMTLIB,    ///< Log all queries .smt2 (SMT-LIBv2) format
   SOLVER_KQUERY, ///< Log queries passed to solver in .kquery (KQuery) format
-  SOLVER_SMTLIB  ///< Log queries passed to solver in .smt2 (SMT-LIBv2) format
+  SOLVER_SMTLIB, ///< Log queries passed to solver in .smt2 (SMT-LIBv2) format
+  ALL_BINARY,    ///< Log all queries as a binary query log
+  SOLVER_BINARY  ///< Log queries passed to solver as a binary query log
 };
 
 extern llvm::cl::bits<QueryLoggingSolverType> QueryLoggingOptions;
 
+/// The printers SMT-LIBv2 queries can be written with
+enum SMTLIBPrinterType {
+  CLASSIC_SMTLIB_PRINTER,    ///< ExprSMTLIBPrinter, a script per query
+  STREAM_SMTLIB_PRINTER,     ///< SMTLIBStreamPrinter, a script per query
+  INCREMENTAL_SMTLIB_PRINTER ///< SMTLIBStreamPrinter, one session
+};
+
+extern llvm::cl::opt<SMTLIBPrinterType> SMTLIBPrinterToUse;
+
 enum CoreSolverType {
   STP_SOLVER,
   METASMT_SOLVER,
   DUMMY_SOLVER,
   Z3_SOLVER,
+  BITWUZLA_SOLVER,
+  PORTFOLIO_SOLVER,
   NO_SOLVER
 };
 
@@ -66,6 +91,14 @@ extern llvm::cl::opt<CoreSolverType> CoreSolverToUse;
 
 extern llvm::cl::opt<CoreSolverType> DebugCrossCheckCoreSolverWith;
 
+extern llvm::cl::list<CoreSolverType> PortfolioBackends;
+
+extern llvm::cl::opt<bool> SolverEscalation;
+
+extern llvm::cl::opt<CoreSolverType> SolverEscalationBackend;
+
+extern llvm::cl::opt<unsigned> SolverEscalationTimeoutFactor;
+
 #ifdef ENABLE_METASMT
 
 enum MetaSMTBackendType {
@@ -0,0 +1,49 @@
+//===-- SolverProfile.h -----------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_SOLVERPROFILE_H
+#define KLEE_SOLVERPROFILE_H
+
+#include "klee/System/Time.h"
+
+#include <array>
+#include <cstdint>
+#include <string>
+
+namespace klee {
+
+/// Statistics of the queries received by a layer of a solver chain, as
+/// recorded by a profiling solver in front of the layer.
+struct SolverLayerProfile {
+  /// The number of buckets of the latency histogram.
+  static const unsigned NumBuckets = 32;
+
+  std::string name;
+  uint64_t queries = 0;
+  /// The queries answered without querying the profiled layer below.
+  uint64_t hits = 0;
+  uint64_t failures = 0;
+  /// The time spent in the layer, including the layers below it.
+  time::Span time;
+  /// Bucket i counts the queries that took [2^(i-1), 2^i) microseconds,
+  /// bucket 0 those that took less than a microsecond.
+  std::array<uint64_t, NumBuckets> latency{};
+
+  explicit SolverLayerProfile(std::string name) : name(std::move(name)) {}
+
+  void record(time::Span elapsed, bool success, bool hit);
+
+  /// \return an upper bound of the given quantile of the latencies, in
+  /// microseconds, from the histogram
+  uint64_t getLatencyQuantile(double q) const;
+};
+
+} // namespace klee
+
+#endif /* KLEE_SOLVERPROFILE_H */
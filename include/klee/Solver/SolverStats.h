@@ -12,6 +12,11 @@
 
 #include "klee/Statistics/Statistic.h"
 
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <string>
+
 namespace klee {
 namespace stats {
 
@@ -23,15 +28,101 @@ namespace stats {
   extern Statistic queryCacheMisses;
   extern Statistic queryCexCacheHits;
   extern Statistic queryCexCacheMisses;
+  /// Time spent looking up the counterexample cache, the cached assignments
+  /// evaluated on the way and the entries evicted, see --cex-cache-size.
+  extern Statistic cexCacheLookupTime;
+  extern Statistic cexCacheCandidates;
+  /// Time spent compiling the queries looked up in the counterexample cache
+  /// to ExprTapes and evaluating the tapes under the candidates.
+  extern Statistic cexCacheCompileTime;
+  extern Statistic cexCacheEvaluationTime;
+  extern Statistic cexCacheEvictions;
+  /// Lookups in the file of --persistent-query-cache.
+  extern Statistic queryDiskCacheHits;
+  extern Statistic queryDiskCacheMisses;
+  /// Queries answered or narrowed down with the model known for their
+  /// constraints, see --use-known-model.
+  extern Statistic knownModelHits;
+  extern Statistic segmentSolverResolved;
+  /// Queries answered by --use-fast-cex-solver, and those of them answered
+  /// with interval bounds alone, versus passed on to the next solver.
+  extern Statistic fastCexDecided;
+  extern Statistic fastCexBoundsDecided;
+  extern Statistic fastCexDeferred;
+  extern Statistic fastCexTime;
   extern Statistic queryConstructs;
   extern Statistic queryCounterexamples;
+  /// Number of constraints that were already asserted in the solver,
+  /// see the --z3-incremental option.
+  extern Statistic queryConstraintsReused;
   extern Statistic queryTime;
+  /// Lookups in the Z3 construct cache, see --z3-construct-cache-size.
+  extern Statistic z3ConstructCacheHits;
+  extern Statistic z3ConstructCacheMisses;
+  extern Statistic z3ConstructCacheEvictions;
+  /// Lookups in the STP construct cache, see --stp-construct-cache-size.
+  extern Statistic stpConstructCacheHits;
+  extern Statistic stpConstructCacheMisses;
+  extern Statistic stpConstructCacheEvictions;
+  /// Number of times the Z3 context was recreated, see
+  /// --z3-recycle-context-after.
+  extern Statistic z3ContextRecycles;
+  /// Number of queries with --z3-incremental that found a solver already
+  /// asserting a prefix of their constraints, and of those that did not.
+  extern Statistic z3IncrementalContextHits;
+  extern Statistic z3IncrementalContextMisses;
+  /// Number of queries given to the QF_BV solver of Z3, see
+  /// --z3-logic-solvers.
+  extern Statistic z3BitVectorQueries;
+  /// Number of times the Bitwuzla term manager was recreated, see
+  /// --bitwuzla-recycle-after.
+  extern Statistic bitwuzlaRecycles;
+  /// Queries answered first by each backend of the solver portfolio.
+  extern Statistic portfolioWinsSTP;
+  extern Statistic portfolioWinsMetaSMT;
+  extern Statistic portfolioWinsZ3;
+  extern Statistic portfolioWinsBitwuzla;
+  /// Queries the first stage of --solver-escalation failed on, and those of
+  /// them answered by the later stages.
+  extern Statistic escalatedQueries;
+  extern Statistic escalationsSolvedByFallback;
+  extern Statistic escalationsSolvedByLongerTimeout;
   
 #ifdef KLEE_ARRAY_DEBUG
   extern Statistic arrayHashTime;
 #endif
 
 }
+
+/// Log-scale histograms of the shape of the queries that reached a core
+/// solver backend and of the time it took to solve them, see
+/// --query-shape-stats.
+struct QueryShapeStats {
+  /// Bucket i counts the values in [2^(i-1), 2^i), bucket 0 the zeros.
+  static const unsigned NumBuckets = 32;
+  typedef std::array<uint64_t, NumBuckets> Histogram;
+
+  std::string backend;
+  uint64_t queries = 0;
+  /// The number of distinct expression nodes of the constraints and the
+  /// query expression.
+  Histogram nodes{};
+  /// The number of distinct arrays read.
+  Histogram arrays{};
+  /// The length of the longest update list read.
+  Histogram updateDepth{};
+  /// The time taken by the backend, in microseconds.
+  Histogram solveTime{};
+
+  explicit QueryShapeStats(std::string backend) : backend(std::move(backend)) {}
+
+  static unsigned getBucket(uint64_t value);
+};
+
+/// getQueryShapeStats - The histograms of the core solvers created with
+/// --query-shape-stats, one per backend.
+std::deque<QueryShapeStats> &getQueryShapeStats();
+
 }
 
 #endif /* KLEE_SOLVERSTATS_H */
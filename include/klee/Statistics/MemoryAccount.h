@@ -0,0 +1,103 @@
+//===-- MemoryAccount.h -----------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_MEMORYACCOUNT_H
+#define KLEE_MEMORYACCOUNT_H
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/StringRef.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+
+namespace klee {
+
+/// MemoryAccount - The bytes held by one subsystem, counted where it
+/// allocates and frees them, with an optional budget. The caches that can
+/// give their memory back register a Releaser on their account.
+///
+/// Accounts are constant-initialized, so they can be charged during static
+/// initialization.
+class MemoryAccount {
+public:
+  /// Registers how a cache empties itself for as long as it lives.
+  class Releaser {
+    friend class MemoryAccount;
+    MemoryAccount &account;
+    std::function<void()> release;
+    Releaser *prev = nullptr;
+    Releaser *next = nullptr;
+
+  public:
+    Releaser(MemoryAccount &account, std::function<void()> release);
+    ~Releaser();
+    Releaser(const Releaser &) = delete;
+    Releaser &operator=(const Releaser &) = delete;
+  };
+
+private:
+  const char *name;
+  const char *column;
+  uint64_t bytes;
+  uint64_t budget;
+  Releaser *releasers;
+
+public:
+  constexpr MemoryAccount(const char *name, const char *column)
+      : name(name), column(column), bytes(0), budget(0), releasers(nullptr) {}
+  MemoryAccount(const MemoryAccount &) = delete;
+  MemoryAccount &operator=(const MemoryAccount &) = delete;
+
+  /// The name of the account in options and metrics.
+  const char *getName() const { return name; }
+  /// The name of its column in run.stats.
+  const char *getColumn() const { return column; }
+
+  uint64_t getBytes() const { return bytes; }
+  void add(uint64_t n) { bytes += n; }
+  void remove(uint64_t n) { bytes -= std::min(bytes, n); }
+
+  /// The budget in bytes, 0 if there is none.
+  uint64_t getBudget() const { return budget; }
+  void setBudget(uint64_t n) { budget = n; }
+  bool isOverBudget() const { return budget && bytes > budget; }
+
+  /// Whether a cache can give the memory of the account back.
+  bool isReleasable() const { return releasers != nullptr; }
+
+  /// Empties the caches registered on the account.
+  /// \return the number of bytes released.
+  uint64_t release();
+
+  /// All accounts, in the order of the run.stats columns.
+  static llvm::ArrayRef<MemoryAccount *> getAccounts();
+
+  /// The account of the given name, or null.
+  static MemoryAccount *find(llvm::StringRef name);
+};
+
+namespace memory {
+/// The slabs of the expression allocator.
+extern MemoryAccount expressions;
+/// The arrays of the array caches.
+extern MemoryAccount arrays;
+/// The pools of memory objects, object states and their planes.
+extern MemoryAccount objectStates;
+/// The nodes of the process tree.
+extern MemoryAccount processTree;
+/// The counterexample caches.
+extern MemoryAccount cexCache;
+/// The expressions built by the Z3 builders.
+extern MemoryAccount constructCache;
+} // namespace memory
+
+} // namespace klee
+
+#endif /* KLEE_MEMORYACCOUNT_H */
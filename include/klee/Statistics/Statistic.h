@@ -30,6 +30,8 @@ namespace klee {
 
   private:
     std::uint32_t id;
+    /// The column of the statistic in the rows of the indexed statistics.
+    std::uint32_t slot;
     const std::string name;
     const std::string shortName;
 
@@ -42,7 +42,12 @@ namespace klee {
     bool enabled;
     std::vector<Statistic*> stats;
     uint64_t *globalStats;
+    /// A row of counters per index, see useIndexedStats.
     uint64_t *indexedStats;
+    /// The row of the current index.
+    uint64_t *indexedRow;
+    /// The number of counters in a row, padded to whole cache lines.
+    unsigned rowSize;
     StatisticRecord *contextStats;
     unsigned index;
 
@@ -50,18 +55,30 @@ namespace klee {
     StatisticManager();
     ~StatisticManager();
 
-    void useIndexedStats(unsigned totalIndices);
+    /// Keep the values of the statistics per index. The rows start on cache
+    /// lines and the statistics in hot come first in them, so that the
+    /// counters updated by every instruction share a line.
+    void useIndexedStats(unsigned totalIndices,
+                         const std::vector<const Statistic *> &hot = {});
 
     StatisticRecord *getContext();
     void setContext(StatisticRecord *sr); /* null to reset */
 
-    void setIndex(unsigned i) { index = i; }
+    void setIndex(unsigned i) {
+      index = i;
+      if (indexedStats)
+        indexedRow = indexedStats + static_cast<size_t>(i) * rowSize;
+    }
     unsigned getIndex() { return index; }
     unsigned getNumStatistics() { return stats.size(); }
     Statistic &getStatistic(unsigned i) { return *stats[i]; }
     
     void registerStatistic(Statistic &s);
     void incrementStatistic(Statistic &s, uint64_t addend);
+    /// Add to the total of s, but not to its value at the current index
+    void incrementGlobalValue(const Statistic &s, uint64_t addend) {
+      globalStats[s.id] += addend;
+    }
     uint64_t getValue(const Statistic &s) const;
     void incrementIndexedValue(const Statistic &s, unsigned index, 
                                uint64_t addend) const;
@@ -77,8 +94,8 @@ namespace klee {
                                                    uint64_t addend) {
     if (enabled) {
       globalStats[s.id] += addend;
-      if (indexedStats) {
-        indexedStats[index*stats.size() + s.id] += addend;
+      if (indexedRow) {
+        indexedRow[s.slot] += addend;
         if (contextStats)
           contextStats->data[s.id] += addend;
       }
@@ -136,18 +153,18 @@ namespace klee {
   inline void StatisticManager::incrementIndexedValue(const Statistic &s, 
                                                       unsigned index,
                                                       uint64_t addend) const {
-    indexedStats[index*stats.size() + s.id] += addend;
+    indexedStats[static_cast<size_t>(index) * rowSize + s.slot] += addend;
   }
 
   inline uint64_t StatisticManager::getIndexedValue(const Statistic &s, 
                                                     unsigned index) const {
-    return indexedStats[index*stats.size() + s.id];
+    return indexedStats[static_cast<size_t>(index) * rowSize + s.slot];
   }
 
   inline void StatisticManager::setIndexedValue(const Statistic &s, 
                                                 unsigned index,
                                                 uint64_t value) {
-    indexedStats[index*stats.size() + s.id] = value;
+    indexedStats[static_cast<size_t>(index) * rowSize + s.slot] = value;
   }
 }
 
@@ -10,9 +10,22 @@
 #ifndef KLEE_COMPRESSIONSTREAM_H
 #define KLEE_COMPRESSIONSTREAM_H
 
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/raw_ostream.h"
 #include "zlib.h"
 
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#ifdef HAVE_ZSTD_H
+struct ZSTD_CCtx_s;
+#endif
+
 namespace klee {
 const size_t BUFSIZE = 128 * 1024;
 
@@ -41,6 +54,60 @@ public:
 
   ~compressed_fd_ostream();
 };
+
+#ifdef HAVE_ZSTD_H
+/// Writes a zstd compressed file without compressing on the writing thread:
+/// the data is queued in chunks of BUFSIZE bytes and compressed by a thread
+/// of the stream, which lets zstd spread the work over further worker
+/// threads. At most MaxQueuedChunks chunks are queued, beyond that a write
+/// waits for the compression to catch up.
+class zstd_fd_ostream : public llvm::raw_ostream {
+  static const size_t MaxQueuedChunks = 16;
+
+  int FD;
+  ZSTD_CCtx_s *ctx = nullptr;
+  uint64_t pos = 0;
+  std::string chunk;
+
+  std::mutex mutex;
+  std::condition_variable queued, taken;
+  std::deque<std::string> chunks;
+  bool closing = false;
+  std::thread thread;
+
+  /// write_impl - See raw_ostream::write_impl.
+  void write_impl(const char *Ptr, size_t Size) override;
+  /// The position in the uncompressed data.
+  uint64_t current_pos() const override { return pos; }
+
+  void queueChunk();
+  void compressChunks();
+  void compress(const std::string &data, bool last);
+  void write_file(const char *Ptr, size_t Size);
+
+public:
+  /// Opens Filename for writing. If an error occurs, it is described in
+  /// ErrorInfo, which is empty otherwise, and the stream should be destroyed
+  /// immediately. Workers is the number of threads zstd compresses with in
+  /// addition to the thread of the stream.
+  zstd_fd_ostream(const std::string &Filename, std::string &ErrorInfo,
+                  unsigned Workers);
+
+  /// Compresses the queued data and closes the file.
+  ~zstd_fd_ostream();
+};
+#endif
+
+/// Returns whether Data starts like a file written by compressed_fd_ostream
+/// or zstd_fd_ostream.
+bool isCompressedData(llvm::StringRef Data);
+
+/// Decompresses the contents of a gzip or zstd file. Returns null and
+/// describes the problem in ErrorInfo if Data is corrupt or compressed with
+/// a format that is not supported by this build.
+std::unique_ptr<llvm::MemoryBuffer>
+decompressData(llvm::StringRef Data, llvm::StringRef BufferName,
+               std::string &ErrorInfo);
 }
 
 #endif /* KLEE_COMPRESSIONSTREAM_H */
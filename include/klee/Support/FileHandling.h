@@ -19,6 +19,10 @@ std::unique_ptr<llvm::raw_fd_ostream>
 klee_open_output_file(const std::string &path, std::string &error);
 
 #ifdef HAVE_ZLIB_H
+/// The extension of the files written by klee_open_compressed_output_file,
+/// ".gz" or ".zst" as selected by -log-compression.
+const char *klee_compressed_file_extension();
+
 std::unique_ptr<llvm::raw_ostream>
 klee_open_compressed_output_file(const std::string &path, std::string &error);
 #endif
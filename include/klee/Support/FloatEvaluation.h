@@ -20,10 +20,19 @@
 #include "llvm/Support/MathExtras.h"
 
 #include <cassert>
+#include <cfloat>
+#include <limits>
 
 namespace klee {
 namespace floats {
 
+/// Whether the host evaluates float and double operations in IEEE 754
+/// single and double precision, so that they round as APFloat does with
+/// rmNearestTiesToEven. Only NaN results may differ in sign and payload.
+constexpr bool hostIsIEEE = std::numeric_limits<float>::is_iec559 &&
+                            std::numeric_limits<double>::is_iec559 &&
+                            FLT_EVAL_METHOD == 0;
+
 // ********************************** //
 // *** Pack uint64_t into FP types ** //
 // ********************************** //
@@ -36,6 +36,11 @@ namespace klee {
     /// Returns point in time using a monotonic steady clock
     Point getWallTime();
 
+    /// Returns point in time of the same clock as getWallTime, but at a
+    /// coarse resolution of a few milliseconds where that is cheaper to read.
+    /// Meant for frequent polls such as those of timers.
+    Point getCoarseWallTime();
+
     struct Point {
       using SteadyTimePoint = std::chrono::steady_clock::time_point;
 
@@ -141,6 +141,14 @@ extern "C" {
      constants and that the range lie within a single object. */
   void klee_check_memory_access(const void *address, size_t size);
 
+  /* Copy count bytes from src to dst natively, for the symbolic files of
+     the POSIX runtime. A symbolic count does not fork: the bytes up to its
+     largest value are copied conditionally.
+
+     Both pointers must be constant and each range must lie within a single
+     object. */
+  void klee_copy_file_bytes(void *dst, const void *src, size_t count);
+
   /* Enable/disable forking. */
   void klee_set_forking(unsigned enable);
 
@@ -9,17 +9,46 @@
 
 #include "klee/ADT/KTest.h"
 
+#include <fcntl.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
-
-#define KTEST_VERSION 3
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#define KTEST_VERSION 4
+// the last version storing all bytes of the objects
+#define KTEST_DENSE_VERSION 3
 #define KTEST_MAGIC_SIZE 5
 #define KTEST_MAGIC "KTEST"
 
 // for compatibility reasons
 #define BOUT_MAGIC "BOUT\n"
 
+// Since version 4 the bytes of an object are stored as runs, the bytes
+// between them are zero. Runs are split at this many zero bytes, which
+// cost more to store than the header of a run. The files of tests that do
+// not gain from runs keep the dense layout.
+#define KTEST_RUN_GAP 16
+
+#define KTEST_ARCHIVE_VERSION 1
+#define KTEST_ARCHIVE_MAGIC "KTARC"
+#define KTEST_INDEX_MAGIC "KTIDX"
+#define KTEST_ARCHIVE_HEADER_SIZE (KTEST_MAGIC_SIZE + 4)
+// the offset of the index and its magic
+#define KTEST_ARCHIVE_TRAILER_SIZE (8 + KTEST_MAGIC_SIZE)
+
+// the tags of the records of an archive
+#define KTEST_BLOB_RECORD 'B'
+#define KTEST_TEST_RECORD 'T'
+#define KTEST_INDEX_RECORD 'I'
+
 /***/
 
 static int read_uint32(FILE *f, unsigned *value_out) {
@@ -39,6 +68,18 @@ static int write_uint32(FILE *f, unsigned value) {
   return fwrite(data, 1, 4, f)==4;
 }
 
+static int read_uint64(FILE *f, unsigned long long *value_out) {
+  unsigned hi, lo;
+  if (!read_uint32(f, &hi) || !read_uint32(f, &lo))
+    return 0;
+  *value_out = ((unsigned long long) hi << 32) | lo;
+  return 1;
+}
+
+static int write_uint64(FILE *f, unsigned long long value) {
+  return write_uint32(f, value >> 32) && write_uint32(f, value);
+}
+
 static int read_string(FILE *f, char **value_out) {
   unsigned len;
   if (!read_uint32(f, &len))
@@ -91,6 +132,77 @@ int kTest_isKTestFile(const char *path) {
   return res;
 }
 
+/* Finds the run of bytes of o starting at the first non-zero byte from
+   *begin, which ends at KTEST_RUN_GAP zero bytes or at the end of o.
+   Returns 0 if there is none. */
+static int kTest_nextRun(const KTestObject *o, unsigned *begin,
+                         unsigned *end) {
+  unsigned i = *begin, zeros = 0;
+  while (i < o->numBytes && !o->bytes[i])
+    i++;
+  if (i == o->numBytes)
+    return 0;
+  *begin = i;
+  for (; i < o->numBytes && zeros < KTEST_RUN_GAP; i++)
+    zeros = o->bytes[i] ? 0 : zeros + 1;
+  *end = i - zeros;
+  return 1;
+}
+
+/* Whether storing the objects as runs makes the file smaller. */
+static int kTest_gainsFromRuns(const KTest *bo) {
+  unsigned long long dense = 0, sparse = 0;
+  unsigned i;
+  for (i=0; i<bo->numObjects; i++) {
+    const KTestObject *o = &bo->objects[i];
+    unsigned begin = 0, end;
+    dense += o->numBytes;
+    sparse += 4;
+    while (kTest_nextRun(o, &begin, &end)) {
+      sparse += 8 + (end - begin);
+      begin = end;
+    }
+  }
+  return sparse < dense;
+}
+
+static int kTest_writeRuns(FILE *f, const KTestObject *o) {
+  unsigned begin = 0, end, numRuns = 0;
+  while (kTest_nextRun(o, &begin, &end)) {
+    numRuns++;
+    begin = end;
+  }
+  if (!write_uint32(f, numRuns))
+    return 0;
+  for (begin = 0; kTest_nextRun(o, &begin, &end); begin = end) {
+    if (!write_uint32(f, begin) || !write_uint32(f, end - begin) ||
+        fwrite(o->bytes + begin, end - begin, 1, f)!=1)
+      return 0;
+  }
+  return 1;
+}
+
+static int kTest_readRuns(FILE *f, KTestObject *o) {
+  unsigned numRuns, i;
+  if (o->numBytes) {
+    o->bytes = (unsigned char*) calloc(o->numBytes, 1);
+    if (!o->bytes)
+      return 0;
+  }
+  if (!read_uint32(f, &numRuns))
+    return 0;
+  for (i=0; i<numRuns; i++) {
+    unsigned offset, length;
+    if (!read_uint32(f, &offset) || !read_uint32(f, &length))
+      return 0;
+    if (offset > o->numBytes || length > o->numBytes - offset)
+      return 0;
+    if (length && fread(o->bytes + offset, length, 1, f)!=1)
+      return 0;
+  }
+  return 1;
+}
+
 KTest *kTest_fromFile(const char *path) {
   FILE *f = fopen(path, "rb");
   KTest *res = 0;
@@ -142,7 +254,10 @@ KTest *kTest_fromFile(const char *path) {
     if (!read_uint32(f, &o->numBytes))
       goto error;
     o->bytes = 0;
-    if (o->numBytes) {
+    if (version >= 4) {
+      if (!kTest_readRuns(f, o))
+        goto error;
+    } else if (o->numBytes) {
       o->bytes = (unsigned char*) malloc(o->numBytes);
       if (fread(o->bytes, o->numBytes, 1, f)!=1)
         goto error;
@@ -181,12 +296,13 @@ KTest *kTest_fromFile(const char *path) {
 int kTest_toFile(KTest *bo, const char *path) {
   FILE *f = fopen(path, "wb");
   unsigned i;
+  int runs = kTest_gainsFromRuns(bo);
 
   if (!f) 
     goto error;
   if (fwrite(KTEST_MAGIC, strlen(KTEST_MAGIC), 1, f)!=1)
     goto error;
-  if (!write_uint32(f, KTEST_VERSION))
+  if (!write_uint32(f, runs ? KTEST_VERSION : KTEST_DENSE_VERSION))
     goto error;
       
   if (!write_uint32(f, bo->numArgs))
@@ -209,8 +325,12 @@ int kTest_toFile(KTest *bo, const char *path) {
       goto error;
     if (!write_uint32(f, o->numBytes))
       goto error;
-    if (o->numBytes && fwrite(o->bytes, o->numBytes, 1, f)!=1)
+    if (runs) {
+      if (!kTest_writeRuns(f, o))
+        goto error;
+    } else if (o->numBytes && fwrite(o->bytes, o->numBytes, 1, f)!=1) {
       goto error;
+    }
   }
 
   fclose(f);
@@ -229,15 +349,565 @@ unsigned kTest_numBytes(KTest *bo) {
   return res;
 }
 
+/***/
+
+/* A mapped file, the dense bytes of the objects of its test point into. */
+struct KTestMapping {
+  const unsigned char *base;
+  size_t size;
+};
+
+/* The mappings of the tests read by kTest_mapFile. */
+static std::mutex kTestMappingsLock;
+static std::unordered_map<const KTest *, KTestMapping> &kTest_getMappings() {
+  static std::unordered_map<const KTest *, KTestMapping> mappings;
+  return mappings;
+}
+
+/* A cursor over the bytes of a mapped file. */
+struct KTestReader {
+  const unsigned char *pos;
+  const unsigned char *end;
+};
+
+static int map_uint32(KTestReader *r, unsigned *value_out) {
+  if (r->end - r->pos < 4)
+    return 0;
+  *value_out = (((((r->pos[0]<<8) + r->pos[1])<<8) + r->pos[2])<<8) + r->pos[3];
+  r->pos += 4;
+  return 1;
+}
+
+static int map_bytes(KTestReader *r, unsigned n, const unsigned char **out) {
+  if ((size_t) (r->end - r->pos) < n)
+    return 0;
+  *out = r->pos;
+  r->pos += n;
+  return 1;
+}
+
+static int map_string(KTestReader *r, char **value_out) {
+  unsigned len;
+  const unsigned char *bytes;
+  if (!map_uint32(r, &len) || !map_bytes(r, len, &bytes))
+    return 0;
+  *value_out = (char*) malloc(len+1);
+  if (!*value_out)
+    return 0;
+  memcpy(*value_out, bytes, len);
+  (*value_out)[len] = 0;
+  return 1;
+}
+
+static int map_runs(KTestReader *r, KTestObject *o) {
+  unsigned numRuns, i;
+  if (o->numBytes) {
+    o->bytes = (unsigned char*) calloc(o->numBytes, 1);
+    if (!o->bytes)
+      return 0;
+  }
+  if (!map_uint32(r, &numRuns))
+    return 0;
+  for (i=0; i<numRuns; i++) {
+    unsigned offset, length;
+    const unsigned char *bytes;
+    if (!map_uint32(r, &offset) || !map_uint32(r, &length))
+      return 0;
+    if (offset > o->numBytes || length > o->numBytes - offset ||
+        !map_bytes(r, length, &bytes))
+      return 0;
+    memcpy(o->bytes + offset, bytes, length);
+  }
+  return 1;
+}
+
+KTest *kTest_mapFile(const char *path) {
+  int fd = open(path, O_RDONLY);
+  struct stat st;
+  void *base;
+  KTest *res = 0;
+  KTestReader r;
+  const unsigned char *magic;
+  unsigned i, version;
+
+  if (fd < 0)
+    return 0;
+  if (fstat(fd, &st) || st.st_size < KTEST_MAGIC_SIZE) {
+    close(fd);
+    return 0;
+  }
+  base = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  // e.g. out of mappings, the bytes are then read
+  if (base == MAP_FAILED)
+    return kTest_fromFile(path);
+
+  r.pos = (const unsigned char*) base;
+  r.end = r.pos + st.st_size;
+  if (!map_bytes(&r, KTEST_MAGIC_SIZE, &magic) ||
+      (memcmp(magic, KTEST_MAGIC, KTEST_MAGIC_SIZE) &&
+       memcmp(magic, BOUT_MAGIC, KTEST_MAGIC_SIZE)))
+    goto error;
+
+  res = (KTest*) calloc(1, sizeof(*res));
+  if (!res)
+    goto error;
+  if (!map_uint32(&r, &version) || version > kTest_getCurrentVersion())
+    goto error;
+  res->version = version;
+
+  if (!map_uint32(&r, &i))
+    goto error;
+  res->args = (char**) calloc(i, sizeof(*res->args));
+  if (!res->args)
+    goto error;
+  res->numArgs = i;
+  for (i=0; i<res->numArgs; i++)
+    if (!map_string(&r, &res->args[i]))
+      goto error;
+
+  if (version >= 2) {
+    if (!map_uint32(&r, &res->symArgvs) || !map_uint32(&r, &res->symArgvLen))
+      goto error;
+  }
+
+  if (!map_uint32(&r, &i))
+    goto error;
+  res->objects = (KTestObject*) calloc(i, sizeof(*res->objects));
+  if (!res->objects)
+    goto error;
+  res->numObjects = i;
+  for (i=0; i<res->numObjects; i++) {
+    KTestObject *o = &res->objects[i];
+    const unsigned char *bytes;
+    if (!map_string(&r, &o->name) || !map_uint32(&r, &o->numBytes))
+      goto error;
+    if (version >= 4) {
+      // runs are expanded, the zero bytes between them are not in the file
+      if (!map_runs(&r, o))
+        goto error;
+    } else if (o->numBytes) {
+      // not touched, the pages are read once the bytes are
+      if (!map_bytes(&r, o->numBytes, &bytes))
+        goto error;
+      o->bytes = const_cast<unsigned char*>(bytes);
+    }
+  }
+
+  {
+    std::lock_guard<std::mutex> guard(kTestMappingsLock);
+    kTest_getMappings()[res] = {(const unsigned char*) base,
+                                (size_t) st.st_size};
+  }
+  return res;
+ error:
+  if (res) {
+    // bytes within the mapping are not freed, it is not registered yet
+    for (i=0; i<res->numObjects; i++) {
+      unsigned char *bytes = res->objects[i].bytes;
+      if (bytes >= (unsigned char*) base &&
+          bytes < (unsigned char*) base + st.st_size)
+        res->objects[i].bytes = 0;
+    }
+    kTest_free(res);
+  }
+  munmap(base, st.st_size);
+  return 0;
+}
+
 void kTest_free(KTest *bo) {
   unsigned i;
+  KTestMapping mapping = {0, 0};
+  {
+    std::lock_guard<std::mutex> guard(kTestMappingsLock);
+    auto &mappings = kTest_getMappings();
+    auto it = mappings.find(bo);
+    if (it != mappings.end()) {
+      mapping = it->second;
+      mappings.erase(it);
+    }
+  }
+
   for (i=0; i<bo->numArgs; i++)
     free(bo->args[i]);
   free(bo->args);
   for (i=0; i<bo->numObjects; i++) {
     free(bo->objects[i].name);
-    free(bo->objects[i].bytes);
+    // the bytes of the mapping are not allocated
+    unsigned char *bytes = bo->objects[i].bytes;
+    if (!mapping.base || bytes < mapping.base ||
+        bytes >= mapping.base + mapping.size)
+      free(bytes);
   }
   free(bo->objects);
   free(bo);
+  if (mapping.base)
+    munmap(const_cast<unsigned char*>(mapping.base), mapping.size);
+}
+
+/***/
+
+struct KTestArchive {
+  FILE *f;
+  int writing;
+  // set once a write failed, the archive then ends before that record
+  int failed;
+  int deduplicate;
+  // the size of the file written so far
+  unsigned long long size;
+  // the offsets of the test records
+  std::vector<unsigned long long> tests;
+  // the offsets of the bytes of the blob records by their hash, to find
+  // identical bytes
+  std::unordered_multimap<unsigned long long,
+                          std::pair<unsigned long long, unsigned>> blobs;
+};
+
+static unsigned long long hash_bytes(const unsigned char *bytes,
+                                     unsigned numBytes) {
+  // FNV-1a
+  unsigned long long h = 14695981039346656037ULL;
+  for (unsigned i = 0; i < numBytes; i++) {
+    h ^= bytes[i];
+    h *= 1099511628211ULL;
+  }
+  return h;
+}
+
+static int kTestArchive_checkHeader(FILE *f) {
+  char header[KTEST_MAGIC_SIZE];
+  unsigned version;
+  if (fread(header, KTEST_MAGIC_SIZE, 1, f)!=1)
+    return 0;
+  if (memcmp(header, KTEST_ARCHIVE_MAGIC, KTEST_MAGIC_SIZE))
+    return 0;
+  if (!read_uint32(f, &version) || version > KTEST_ARCHIVE_VERSION)
+    return 0;
+  return 1;
+}
+
+int kTestArchive_isArchive(const char *path) {
+  FILE *f = fopen(path, "rb");
+  int res;
+
+  if (!f)
+    return 0;
+  res = kTestArchive_checkHeader(f);
+  fclose(f);
+
+  return res;
+}
+
+KTestArchive *kTestArchive_create(const char *path, int deduplicate) {
+  FILE *f = fopen(path, "w+b");
+  if (!f)
+    return 0;
+  if (fwrite(KTEST_ARCHIVE_MAGIC, KTEST_MAGIC_SIZE, 1, f)!=1 ||
+      !write_uint32(f, KTEST_ARCHIVE_VERSION)) {
+    fclose(f);
+    return 0;
+  }
+
+  KTestArchive *a = new KTestArchive();
+  a->f = f;
+  a->writing = 1;
+  a->deduplicate = deduplicate;
+  a->size = KTEST_ARCHIVE_HEADER_SIZE;
+  return a;
+}
+
+/* find bytes identical to those of o in the archive, returns 1 on success */
+static int kTestArchive_findBlob(KTestArchive *a, KTestObject *o,
+                                 unsigned long long hash,
+                                 unsigned long long *offset_out) {
+  auto range = a->blobs.equal_range(hash);
+  if (range.first == range.second)
+    return 0;
+
+  std::vector<unsigned char> stored(o->numBytes);
+  int found = 0;
+  // blobs with the same hash are compared with what was written
+  if (fflush(a->f))
+    return 0;
+  for (auto it = range.first; it != range.second && !found; ++it) {
+    if (it->second.second != o->numBytes)
+      continue;
+    if (fseeko(a->f, it->second.first, SEEK_SET) ||
+        fread(stored.data(), o->numBytes, 1, a->f)!=1)
+      break;
+    if (!memcmp(stored.data(), o->bytes, o->numBytes)) {
+      *offset_out = it->second.first;
+      found = 1;
+    }
+  }
+  if (fseeko(a->f, 0, SEEK_END))
+    return 0;
+  return found;
+}
+
+static int kTestArchive_write(KTestArchive *a, KTest *bo) {
+  unsigned i;
+  std::vector<unsigned long long> offsets(bo->numObjects);
+
+  /* the bytes of the objects go first, so that a test record only refers
+     to what precedes it */
+  for (i=0; i<bo->numObjects; i++) {
+    KTestObject *o = &bo->objects[i];
+    if (!o->numBytes)
+      continue;
+    unsigned long long hash = hash_bytes(o->bytes, o->numBytes);
+    if (a->deduplicate && kTestArchive_findBlob(a, o, hash, &offsets[i]))
+      continue;
+    if (fputc(KTEST_BLOB_RECORD, a->f)==EOF ||
+        !write_uint32(a->f, o->numBytes) ||
+        fwrite(o->bytes, o->numBytes, 1, a->f)!=1)
+      return 0;
+    offsets[i] = a->size + 5;
+    a->size += 5 + o->numBytes;
+    if (a->deduplicate)
+      a->blobs.emplace(hash, std::make_pair(offsets[i], o->numBytes));
+  }
+
+  unsigned long long start = a->size;
+  unsigned long long size = 1 + 4*5;
+  if (fputc(KTEST_TEST_RECORD, a->f)==EOF ||
+      !write_uint32(a->f, KTEST_VERSION) ||
+      !write_uint32(a->f, bo->numArgs))
+    return 0;
+  for (i=0; i<bo->numArgs; i++) {
+    if (!write_string(a->f, bo->args[i]))
+      return 0;
+    size += 4 + strlen(bo->args[i]);
+  }
+  if (!write_uint32(a->f, bo->symArgvs) ||
+      !write_uint32(a->f, bo->symArgvLen) ||
+      !write_uint32(a->f, bo->numObjects))
+    return 0;
+  for (i=0; i<bo->numObjects; i++) {
+    KTestObject *o = &bo->objects[i];
+    if (!write_string(a->f, o->name) ||
+        !write_uint32(a->f, o->numBytes) ||
+        !write_uint64(a->f, offsets[i]))
+      return 0;
+    size += 4 + strlen(o->name) + 4 + 8;
+  }
+
+  a->size += size;
+  a->tests.push_back(start);
+  return 1;
+}
+
+int kTestArchive_append(KTestArchive *a, KTest *bo) {
+  if (!a->writing || a->failed)
+    return 0;
+  if (!kTestArchive_write(a, bo)) {
+    a->failed = 1;
+    return 0;
+  }
+  return 1;
+}
+
+/* read the index at the end of an archive, returns 1 on success */
+static int kTestArchive_readIndex(KTestArchive *a) {
+  char magic[KTEST_MAGIC_SIZE];
+  unsigned long long offset;
+  unsigned numTests, i;
+
+  if (a->size < KTEST_ARCHIVE_HEADER_SIZE + KTEST_ARCHIVE_TRAILER_SIZE ||
+      fseeko(a->f, a->size - KTEST_ARCHIVE_TRAILER_SIZE, SEEK_SET) ||
+      !read_uint64(a->f, &offset) ||
+      fread(magic, KTEST_MAGIC_SIZE, 1, a->f)!=1 ||
+      memcmp(magic, KTEST_INDEX_MAGIC, KTEST_MAGIC_SIZE))
+    return 0;
+  if (offset < KTEST_ARCHIVE_HEADER_SIZE ||
+      fseeko(a->f, offset, SEEK_SET) ||
+      fgetc(a->f)!=KTEST_INDEX_RECORD ||
+      !read_uint32(a->f, &numTests) ||
+      offset + 5 + 8ULL*numTests + KTEST_ARCHIVE_TRAILER_SIZE != a->size)
+    return 0;
+  a->tests.resize(numTests);
+  for (i=0; i<numTests; i++)
+    if (!read_uint64(a->f, &a->tests[i]) || a->tests[i] >= offset)
+      return 0;
+  return 1;
+}
+
+/* skip n bytes of a record, returns 1 if they are within the archive */
+static int kTestArchive_skip(KTestArchive *a, unsigned long long n) {
+  long long pos = ftello(a->f);
+  if (pos < 0 || (unsigned long long) pos + n > a->size)
+    return 0;
+  return !fseeko(a->f, n, SEEK_CUR);
+}
+
+static int kTestArchive_skipString(KTestArchive *a) {
+  unsigned len;
+  return read_uint32(a->f, &len) && kTestArchive_skip(a, len);
+}
+
+/* find the tests by going through the records, up to the first one that
+   was not completely written */
+static void kTestArchive_scan(KTestArchive *a) {
+  unsigned long long offset = KTEST_ARCHIVE_HEADER_SIZE;
+  unsigned n, numArgs, numObjects, i;
+
+  a->tests.clear();
+  if (fseeko(a->f, offset, SEEK_SET))
+    return;
+  for (;;) {
+    int tag = fgetc(a->f);
+    if (tag==KTEST_BLOB_RECORD) {
+      if (!read_uint32(a->f, &n) || !kTestArchive_skip(a, n))
+        return;
+    } else if (tag==KTEST_TEST_RECORD) {
+      if (!kTestArchive_skip(a, 4) || !read_uint32(a->f, &numArgs))
+        return;
+      for (i=0; i<numArgs; i++)
+        if (!kTestArchive_skipString(a))
+          return;
+      if (!kTestArchive_skip(a, 8) || !read_uint32(a->f, &numObjects))
+        return;
+      for (i=0; i<numObjects; i++)
+        if (!kTestArchive_skipString(a) || !kTestArchive_skip(a, 12))
+          return;
+      a->tests.push_back(offset);
+    } else if (tag==KTEST_INDEX_RECORD) {
+      if (!read_uint32(a->f, &n) ||
+          !kTestArchive_skip(a, 8ULL*n + KTEST_ARCHIVE_TRAILER_SIZE))
+        return;
+    } else {
+      return;
+    }
+    long long pos = ftello(a->f);
+    if (pos < 0)
+      return;
+    offset = pos;
+  }
+}
+
+static KTestArchive *kTestArchive_openExisting(const char *path,
+                                               const char *mode) {
+  FILE *f = fopen(path, mode);
+  long long size;
+
+  if (!f)
+    return 0;
+  if (!kTestArchive_checkHeader(f) || fseeko(f, 0, SEEK_END) ||
+      (size = ftello(f)) < 0) {
+    fclose(f);
+    return 0;
+  }
+
+  KTestArchive *a = new KTestArchive();
+  a->f = f;
+  a->size = size;
+  if (!kTestArchive_readIndex(a))
+    kTestArchive_scan(a);
+  return a;
+}
+
+KTestArchive *kTestArchive_open(const char *path) {
+  return kTestArchive_openExisting(path, "rb");
+}
+
+KTestArchive *kTestArchive_reopen(const char *path, int deduplicate) {
+  KTestArchive *a = kTestArchive_openExisting(path, "r+b");
+  if (!a)
+    return 0;
+  // the new records follow the old index, which is skipped when scanning
+  if (fseeko(a->f, 0, SEEK_END)) {
+    fclose(a->f);
+    delete a;
+    return 0;
+  }
+  a->writing = 1;
+  a->deduplicate = deduplicate;
+  return a;
+}
+
+unsigned kTestArchive_numTests(KTestArchive *a) {
+  return a->tests.size();
+}
+
+KTest *kTestArchive_getTest(KTestArchive *a, unsigned index) {
+  KTest *res = 0;
+  unsigned i, n;
+  std::vector<unsigned long long> offsets;
+
+  if (a->writing || index >= a->tests.size())
+    return 0;
+  if (fseeko(a->f, a->tests[index], SEEK_SET) ||
+      fgetc(a->f)!=KTEST_TEST_RECORD)
+    return 0;
+
+  res = (KTest*) calloc(1, sizeof(*res));
+  if (!res)
+    return 0;
+  if (!read_uint32(a->f, &res->version) || res->version > KTEST_VERSION)
+    goto error;
+
+  if (!read_uint32(a->f, &n))
+    goto error;
+  res->args = (char**) calloc(n, sizeof(*res->args));
+  if (!res->args)
+    goto error;
+  res->numArgs = n;
+  for (i=0; i<res->numArgs; i++)
+    if (!read_string(a->f, &res->args[i]))
+      goto error;
+
+  if (!read_uint32(a->f, &res->symArgvs) ||
+      !read_uint32(a->f, &res->symArgvLen) ||
+      !read_uint32(a->f, &n))
+    goto error;
+  res->objects = (KTestObject*) calloc(n, sizeof(*res->objects));
+  if (!res->objects)
+    goto error;
+  res->numObjects = n;
+  offsets.resize(n);
+  for (i=0; i<res->numObjects; i++) {
+    KTestObject *o = &res->objects[i];
+    if (!read_string(a->f, &o->name) ||
+        !read_uint32(a->f, &o->numBytes) ||
+        !read_uint64(a->f, &offsets[i]))
+      goto error;
+  }
+
+  for (i=0; i<res->numObjects; i++) {
+    KTestObject *o = &res->objects[i];
+    if (!o->numBytes)
+      continue;
+    if (offsets[i] + o->numBytes > a->size)
+      goto error;
+    o->bytes = (unsigned char*) malloc(o->numBytes);
+    if (!o->bytes ||
+        fseeko(a->f, offsets[i], SEEK_SET) ||
+        fread(o->bytes, o->numBytes, 1, a->f)!=1)
+      goto error;
+  }
+
+  return res;
+ error:
+  kTest_free(res);
+  return 0;
+}
+
+int kTestArchive_close(KTestArchive *a) {
+  int res = !a->failed;
+  if (a->writing && !a->failed) {
+    unsigned long long offset = a->size;
+    if (fputc(KTEST_INDEX_RECORD, a->f)==EOF ||
+        !write_uint32(a->f, a->tests.size()))
+      res = 0;
+    for (size_t i = 0; res && i < a->tests.size(); i++)
+      if (!write_uint64(a->f, a->tests[i]))
+        res = 0;
+    if (res && (!write_uint64(a->f, offset) ||
+                fwrite(KTEST_INDEX_MAGIC, KTEST_MAGIC_SIZE, 1, a->f)!=1))
+      res = 0;
+  }
+  if (fclose(a->f))
+    res = 0;
+  delete a;
+  return res;
 }
@@ -0,0 +1,62 @@
+//===-- MemoryAccount.cpp -------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Statistics/MemoryAccount.h"
+
+using namespace klee;
+
+MemoryAccount memory::expressions("expressions", "ExpressionMemory");
+MemoryAccount memory::arrays("arrays", "ArrayMemory");
+MemoryAccount memory::objectStates("object-states", "ObjectStateMemory");
+MemoryAccount memory::processTree("process-tree", "ProcessTreeMemory");
+MemoryAccount memory::cexCache("cex-cache", "CexCacheMemory");
+MemoryAccount memory::constructCache("construct-cache",
+                                     "ConstructCacheMemory");
+
+namespace {
+MemoryAccount *const accounts[] = {
+    &memory::expressions, &memory::arrays,   &memory::objectStates,
+    &memory::processTree, &memory::cexCache, &memory::constructCache,
+};
+} // namespace
+
+MemoryAccount::Releaser::Releaser(MemoryAccount &account,
+                                  std::function<void()> release)
+    : account(account), release(std::move(release)), next(account.releasers) {
+  if (next)
+    next->prev = this;
+  account.releasers = this;
+}
+
+MemoryAccount::Releaser::~Releaser() {
+  if (prev)
+    prev->next = next;
+  else
+    account.releasers = next;
+  if (next)
+    next->prev = prev;
+}
+
+uint64_t MemoryAccount::release() {
+  uint64_t before = bytes;
+  for (Releaser *r = releasers; r; r = r->next)
+    r->release();
+  return before - std::min(before, bytes);
+}
+
+llvm::ArrayRef<MemoryAccount *> MemoryAccount::getAccounts() {
+  return accounts;
+}
+
+MemoryAccount *MemoryAccount::find(llvm::StringRef name) {
+  for (MemoryAccount *account : accounts)
+    if (name == account->name)
+      return account;
+  return nullptr;
+}
@@ -9,8 +9,10 @@
 
 #include "klee/Statistics/Statistics.h"
 
-#include <vector>
 #include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <vector>
 
 using namespace klee;
 
@@ -18,24 +20,48 @@ StatisticManager::StatisticManager()
   : enabled(true),
     globalStats(0),
     indexedStats(0),
+    indexedRow(0),
+    rowSize(0),
     contextStats(0),
     index(0) {
 }
 
 StatisticManager::~StatisticManager() {
   delete[] globalStats;
-  delete[] indexedStats;
+  free(indexedStats);
 }
 
-void StatisticManager::useIndexedStats(unsigned totalIndices) {  
-  delete[] indexedStats;
-  indexedStats = new uint64_t[totalIndices * stats.size()];
-  memset(indexedStats, 0, sizeof(*indexedStats) * totalIndices * stats.size());
+void StatisticManager::useIndexedStats(
+    unsigned totalIndices, const std::vector<const Statistic *> &hot) {
+  constexpr unsigned lineSize = 64;
+  constexpr unsigned countersPerLine = lineSize / sizeof(*indexedStats);
+
+  std::vector<bool> placed(stats.size());
+  unsigned slot = 0;
+  for (const Statistic *s : hot) {
+    placed[s->id] = true;
+    stats[s->id]->slot = slot++;
+  }
+  for (Statistic *s : stats)
+    if (!placed[s->id])
+      s->slot = slot++;
+
+  rowSize = (stats.size() + countersPerLine - 1) / countersPerLine *
+            countersPerLine;
+  size_t size = sizeof(*indexedStats) * totalIndices * rowSize;
+  free(indexedStats);
+  void *table;
+  if (posix_memalign(&table, lineSize, size))
+    throw std::bad_alloc();
+  indexedStats = static_cast<uint64_t *>(table);
+  memset(indexedStats, 0, size);
+  setIndex(index);
 }
 
 void StatisticManager::registerStatistic(Statistic &s) {
   delete[] globalStats;
   s.id = stats.size();
+  s.slot = s.id;
   stats.push_back(&s);
   globalStats = new uint64_t[stats.size()];
   memset(globalStats, 0, sizeof(*globalStats)*stats.size());
@@ -11,6 +11,7 @@
 
 #include "ExecutionState.h"
 #include "Memory.h"
+#include "StateFingerprint.h"
 #include "TimingSolver.h"
 
 #include "klee/Expr/Expr.h"
@@ -28,20 +29,58 @@ void AddressSpace::bindObject(const MemoryObject *mo, ObjectState *os) {
   assert(os->copyOnWriteOwner==0 && "object already has owner");
   os->copyOnWriteOwner = cowKey;
   objects = objects.replace(std::make_pair(mo, os));
-  if (mo->segment != 0)
+  if (mo->isHeapObject())
+    heapObjects = heapObjects.insert(mo);
+  if (mo->segment != 0) {
     segmentMap = segmentMap.replace(std::make_pair(mo->segment, mo));
+    getSegmentCacheEntry(mo->segment) = SegmentCacheEntry();
+  }
 }
 
 void AddressSpace::unbindObject(const MemoryObject *mo) {
-  if (mo->segment != 0)
+  if (mo->segment != 0) {
     segmentMap = segmentMap.remove(mo->segment);
+    SegmentCacheEntry &entry = getSegmentCacheEntry(mo->segment);
+    if (entry.segment == mo->segment)
+      entry = SegmentCacheEntry();
+  }
+  if (heapObjects.count(mo))
+    heapObjects = heapObjects.remove(mo);
   objects = objects.remove(mo);
   // NOTE MemoryObjects are reference counted, *mo is deleted at this point
 }
 
+ObjectState *AddressSpace::reallocateObject(const MemoryObject *mo,
+                                           const ObjectState *os) {
+  auto *reallocated =
+      new ObjectState(*os, mo, cowKey == os->copyOnWriteOwner);
+  unbindObject(os->getObject());
+  bindObject(mo, reallocated);
+  return reallocated;
+}
+
+void AddressSpace::shareReadOnlyObject(const MemoryObject *mo) {
+  assert(mo->segment != 0 && "shared object without segment");
+  assert((!readOnlyObjects || readOnlyObjects.use_count() == 1) &&
+         "address space already copied");
+  const auto *res = objects.lookup(mo);
+  assert(res && res->second->readOnly && "not a bound read-only object");
+  if (!readOnlyObjects)
+    readOnlyObjects = std::make_shared<ReadOnlyObjectMap>();
+  // the entry keeps the object state, and with it mo, alive
+  readOnlyObjects->emplace(mo->segment, res->second);
+  unbindObject(mo);
+}
+
 const ObjectState *AddressSpace::findObject(const MemoryObject *mo) const {
-  const auto res = objects.lookup(mo);
-  return res ? res->second.get() : nullptr;
+  if (const auto res = objects.lookup(mo))
+    return res->second.get();
+  if (readOnlyObjects) {
+    auto it = readOnlyObjects->find(mo->segment);
+    if (it != readOnlyObjects->end() && it->second->getObject() == mo)
+      return it->second.get();
+  }
+  return nullptr;
 }
 
 ObjectState *AddressSpace::getWriteable(const MemoryObject *mo,
@@ -56,16 +95,45 @@ ObjectState *AddressSpace::getWriteable(const MemoryObject *mo,
   ref<ObjectState> newObjectState(new ObjectState(*os));
   newObjectState->copyOnWriteOwner = cowKey;
   objects = objects.replace(std::make_pair(mo, newObjectState));
+  SegmentCacheEntry &entry = getSegmentCacheEntry(mo->segment);
+  if (mo->segment != 0 && entry.segment == mo->segment)
+    entry.op.second = newObjectState.get();
   return newObjectState.get();
 }
 
+void AddressSpace::addConcreteAddress(uint64_t address, uint64_t segment) {
+  // the address may have belonged to an object that has been freed
+  concreteAddressMap = concreteAddressMap.replace(std::make_pair(address, segment));
+  segmentAddressMap = segmentAddressMap.insert(std::make_pair(segment, address));
+}
+
+void AddressSpace::addRemovedObject(uint64_t segment,
+                                    const ref<Expr> &symbolicAddress) {
+  removedObjectsMap =
+      removedObjectsMap.insert(std::make_pair(segment, symbolicAddress));
+}
+
 bool AddressSpace::resolveInConcreteMap(const uint64_t& segment, uint64_t &address) const {
-  auto found = std::find_if(concreteAddressMap.begin(),concreteAddressMap.end(),
-                            [segment](std::pair<const uint64_t&, const uint64_t&> value) {
-                              return value.second == segment;
-                            });
-  if (found != concreteAddressMap.end()) {
-    address = found->first;
+  if (const auto *res = segmentAddressMap.lookup(segment)) {
+    address = res->second;
+    return true;
+  }
+  return false;
+}
+
+bool AddressSpace::findSegment(uint64_t segment, ObjectPair &result) const {
+  if (readOnlyObjects) {
+    auto it = readOnlyObjects->find(segment);
+    if (it != readOnlyObjects->end()) {
+      result.first = it->second->getObject();
+      result.second = it->second.get();
+      return true;
+    }
+  }
+  if (const SegmentMap::value_type *res = segmentMap.lookup(segment)) {
+    const auto& objpair = *objects.lookup(res->second);
+    result.first = objpair.first;
+    result.second = objpair.second.get();
     return true;
   }
   return false;
@@ -73,14 +141,21 @@ bool AddressSpace::resolveInConcreteMap(const uint64_t& segment, uint64_t &addre
 
 bool AddressSpace::resolveOneConstantSegment(const KValue &pointer,
                                              ObjectPair &result) const {
-  uint64_t segment = cast<ConstantExpr>(pointer.getSegment())->getZExtValue();
+  uint64_t segment =
+      pointer.hasConstantSegment()
+          ? pointer.getConstantSegment()
+          : cast<ConstantExpr>(pointer.getSegment())->getZExtValue();
 
   if (segment != 0) {
-    if (const SegmentMap::value_type *res = segmentMap.lookup(segment)) {
-      // TODO bounds check?
-      const auto& objpair = *objects.lookup(res->second);
-      result.first = objpair.first;
-      result.second = objpair.second.get();
+    SegmentCacheEntry &entry = getSegmentCacheEntry(segment);
+    if (entry.segment == segment) {
+      result = entry.op;
+      return true;
+    }
+    // TODO bounds check?
+    if (findSegment(segment, result)) {
+      entry.segment = segment;
+      entry.op = result;
       return true;
     }
   }
@@ -207,13 +282,26 @@ bool AddressSpace::resolve(ExecutionState &state,
                                           rl, maxResolutions, timeout))
     return true;
   // TODO inefficient
+  auto mayBeSegment = [&](uint64_t segment) {
+    ref<Expr> segmentExpr = ConstantExpr::create(segment, pointer.getWidth());
+    ref<Expr> expr = EqExpr::create(pointer.getSegment(), segmentExpr);
+    return solver->mayBeTrue(state.constraints, expr, mayBeTrue,
+                             state.queryMetaData);
+  };
+  if (readOnlyObjects) {
+    for (const auto &res : *readOnlyObjects) {
+      if (timeout && timeout < timer.delta())
+        return true;
+      if (!mayBeSegment(res.first))
+        return true;
+      if (mayBeTrue)
+        rl.emplace_back(res.second->getObject(), res.second.get());
+    }
+  }
   for (const SegmentMap::value_type &res : segmentMap) {
     if (timeout && timeout < timer.delta())
       return true;
-    ref<Expr> segmentExpr = ConstantExpr::create(res.first, pointer.getWidth());
-    ref<Expr> expr = EqExpr::create(pointer.getSegment(), segmentExpr);
-    if (!solver->mayBeTrue(state.constraints, expr, mayBeTrue,
-                           state.queryMetaData))
+    if (!mayBeSegment(res.first))
       return true;
     if (mayBeTrue) {
       const auto &pair = *objects.lookup(res.second);
@@ -250,25 +338,37 @@ void AddressSpace::resolveAddressWithOffset(const ExecutionState &state,
   if (!value)
     return;
 
-  for (const auto pair: concreteAddressMap) {
-    const auto& resolvedAddress = pair.first;
-    const auto& resolvedSegment = pair.second;
-    const auto *res = segmentMap.lookup(resolvedSegment);
+  // Concrete addresses come from real allocations which do not overlap, so
+  // the only candidate is the object with the greatest address not above
+  // the one we are looking for.
+  uint64_t concreteAddress = value->getZExtValue();
+  const auto *it = concreteAddressMap.lookup_previous(concreteAddress);
+  if (!it)
+    return;
 
-    if (!res)
-      continue;
+  const auto& resolvedAddress = it->first;
+  const auto& resolvedSegment = it->second;
+  ObjectPair op;
+  if (!findSegment(resolvedSegment, op))
+    return;
 
-    auto op = *objects.lookup(res->second);
+  uint64_t candidateOffset = concreteAddress - resolvedAddress;
+  if (ConstantExpr *size = dyn_cast<ConstantExpr>(op.first->getSizeExpr())) {
+    uint64_t sizeValue = size->getZExtValue();
+    if (sizeValue == 0 ? candidateOffset != 0 : candidateOffset >= sizeValue)
+      return;
+  } else {
+    // the object has a symbolic size, we need to ask the solver
     auto subexpr = SubExpr::alloc(address, ConstantExpr::alloc(resolvedAddress, Context::get().getPointerWidth()));
     auto check = op.first->getBoundsCheckOffset(subexpr);
     bool mayBeTrue = false;
-    if (solver->mayBeTrue(state.constraints, check, mayBeTrue, state.queryMetaData)) {
-      if (mayBeTrue) {
-        rl.emplace_back(op.first, op.second.get());
-        offset = cast<ConstantExpr>(address)->getZExtValue() - resolvedAddress;
-      }
-    }
+    if (!solver->mayBeTrue(state.constraints, check, mayBeTrue, state.queryMetaData) ||
+        !mayBeTrue)
+      return;
   }
+
+  rl.push_back(op);
+  offset = candidateOffset;
 }
 
 // These two are pretty big hack so we can sort of pass memory back
@@ -279,17 +379,20 @@ void AddressSpace::resolveAddressWithOffset(const ExecutionState &state,
 
 void AddressSpace::copyOutConcretes(const SegmentAddressMap &resolved,
                                     bool ignoreReadOnly) {
-  for (MemoryMap::iterator it = objects.begin(), ie = objects.end(); 
-       it != ie; ++it) {
-    const MemoryObject *mo = it->first;
-
-    auto pair = resolved.find(mo->segment);
-    if (pair == resolved.end())
+  // only the objects passed to the external are visited, through the segment
+  // map, so the cost of a call does not grow with the address space. The
+  // shared read-only objects were copied out before they were shared, and
+  // copyInConcrete restores them should an external change them.
+  for (const auto &pair : resolved) {
+    const SegmentMap::value_type *res = segmentMap.lookup(pair.first);
+    if (!res)
       continue;
+    const auto &objpair = *objects.lookup(res->second);
+    const MemoryObject *mo = objpair.first;
 
     if (!mo->isUserSpecified) {
-      const auto &os = it->second;
-      auto address = reinterpret_cast<std::uint8_t*>(pair->second);
+      const auto &os = objpair.second;
+      auto address = reinterpret_cast<std::uint8_t*>(pair.second);
 
       // if the allocated real virtual process' memory
       // is less that the size bound, do not try to write to it...
@@ -302,7 +405,7 @@ void AddressSpace::copyOutConcretes(const SegmentAddressMap &resolved,
           concreteStore.resize(os->offsetPlane->sizeBound,
                                os->offsetPlane->initialValue);
 
-          memcpy(address, concreteStore.data(), concreteStore.size());
+          concreteStore.copyTo(address);
         }
       }
     }
@@ -312,16 +415,15 @@ void AddressSpace::copyOutConcretes(const SegmentAddressMap &resolved,
 bool AddressSpace::copyInConcretes(const SegmentAddressMap &resolved,
                                    ExecutionState &state,
                                    TimingSolver *solver) {
-  for (auto &obj : objects) {
-    const MemoryObject *mo = obj.first;
-    auto pair = resolved.find(mo->segment);
-    if (pair == resolved.end())
+  for (const auto &pair : resolved) {
+    // the shared read-only objects are checked for changes too
+    ObjectPair objpair;
+    if (!findSegment(pair.first, objpair))
       continue;
+    const MemoryObject *mo = objpair.first;
 
     if (!mo->isUserSpecified) {
-      const auto &os = obj.second;
-
-      if (!copyInConcrete(mo, os.get(), pair->second, state, solver))
+      if (!copyInConcrete(mo, objpair.second, pair.second, state, solver))
         return false;
     }
   }
@@ -335,8 +437,10 @@ bool AddressSpace::copyInConcrete(const MemoryObject *mo, const ObjectState *os,
                                   TimingSolver *solver) {
   auto address = reinterpret_cast<uint8_t*>(resolvedAddress);
   auto &concreteStoreR = os->offsetPlane->concreteStore;
-  if (memcmp(address, concreteStoreR.data(), concreteStoreR.size())!=0) {
+  if (!concreteStoreR.equals(address)) {
     if (os->readOnly) {
+      // other states see the same memory
+      concreteStoreR.copyTo(address);
       return false;
     } else {
       ObjectState *wos = getWriteable(mo, os);
@@ -348,8 +452,11 @@ bool AddressSpace::copyInConcrete(const MemoryObject *mo, const ObjectState *os,
 
 void AddressSpace::writeToWOS(ExecutionState &state, TimingSolver *solver,
                               const uint8_t *address, ObjectState *wos) const {
-  auto &concreteStoreW = wos->offsetPlane->concreteStore;
-  memcpy(concreteStoreW.data(), address, concreteStoreW.size());
+  ObjectStatePlane *plane = wos->getWriteablePlane(wos->offsetPlane);
+  auto &concreteStoreW = plane->concreteStore;
+  concreteStoreW.copyFrom(address);
+  if (trackFingerprints())
+    plane->updateFingerprint();
 
   if (concreteStoreW.size() == Context::get().getPointerWidth() / 8) {
     KValue written = wos->read(0, Context::get().getPointerWidth());
@@ -365,6 +472,26 @@ void AddressSpace::writeToWOS(ExecutionState &state, TimingSolver *solver,
   }
 }
 
+uint64_t AddressSpace::getFingerprint() const {
+  // the objects are combined by xor, so their order does not matter
+  uint64_t res = 0;
+  for (const auto &obj : objects)
+    res ^= combineFingerprints(obj.first->id, obj.second->getFingerprint());
+  return res;
+}
+
+size_t AddressSpace::getFootprint() const {
+  size_t res = 0;
+  for (const auto &obj : objects) {
+    const ObjectState *os = obj.second.get();
+    if (os->copyOnWriteOwner == cowKey)
+      res += os->getFootprint();
+    else
+      res += os->getFootprint() / os->_refCount.getCount();
+  }
+  return res;
+}
+
 /***/
 
 bool MemoryObjectLT::operator()(const MemoryObject *a, const MemoryObject *b) const {
@@ -13,12 +13,18 @@
 #include "Memory.h"
 
 #include "klee/Expr/Expr.h"
+#include "klee/ADT/ImmutableBTreeMap.h"
 #include "klee/ADT/ImmutableMap.h"
+#include "klee/ADT/ImmutableSet.h"
 #include "klee/System/Time.h"
 #include "klee/Module/KValue.h"
 
 #include "llvm/ADT/Optional.h"
 
+#include <array>
+#include <map>
+#include <memory>
+
 namespace klee {
   class ExecutionState;
   class MemoryObject;
@@ -35,12 +41,20 @@ namespace klee {
     bool operator()(const MemoryObject *a, const MemoryObject *b) const;
   };
 
-  typedef ImmutableMap<const MemoryObject *, ref<ObjectState>, MemoryObjectLT>
+  /// The objects are kept in a B-tree, whose wide nodes keep lookups and
+  /// the copies made by updates short for large address spaces.
+  typedef ImmutableBTreeMap<const MemoryObject *, ref<ObjectState>,
+                            MemoryObjectLT>
       MemoryMap;
   typedef ImmutableMap<uint64_t, const MemoryObject*> SegmentMap;
-  typedef std::map</*address*/ const uint64_t, /*segment*/ const uint64_t> ConcreteAddressMap;
+  typedef ImmutableMap</*address*/ uint64_t, /*segment*/ uint64_t> ConcreteAddressMap;
+  typedef ImmutableMap</*segment*/ uint64_t, /*address*/ uint64_t> ConcreteSegmentMap;
   typedef std::map</*segment*/ const uint64_t, /*address*/ const uint64_t> SegmentAddressMap;
-  typedef std::map</*segment*/ const uint64_t, /*symbolic array*/ ref<Expr>> RemovedObjectsMap;
+  typedef ImmutableMap</*segment*/ uint64_t, /*symbolic array*/ ref<Expr>> RemovedObjectsMap;
+  typedef ImmutableSet<std::pair</*id*/ unsigned, /*id*/ unsigned>>
+      AddressAxiomSet;
+  typedef ImmutableSet<const MemoryObject *, MemoryObjectLT> HeapObjectSet;
+  typedef std::map</*segment*/ uint64_t, ref<ObjectState>> ReadOnlyObjectMap;
 
   class AddressSpace {
     friend class ExecutionState;
@@ -52,6 +66,26 @@ namespace klee {
     /// Unsupported, use copy constructor
     AddressSpace &operator=(const AddressSpace &);
 
+    struct SegmentCacheEntry {
+      uint64_t segment = 0;
+      ObjectPair op{nullptr, nullptr};
+    };
+    static const unsigned SegmentCacheSize = 64;
+    /// A direct-mapped cache of resolveOneConstantSegment by segment, kept
+    /// in sync with objects by bindObject, unbindObject and getWriteable.
+    mutable std::array<SegmentCacheEntry, SegmentCacheSize> segmentCache;
+
+    SegmentCacheEntry &getSegmentCacheEntry(uint64_t segment) const {
+      return segmentCache[segment % SegmentCacheSize];
+    }
+
+    /// The read-only objects of the initial state, e.g. constant globals,
+    /// which are the same in all address spaces. They are shared by the
+    /// copies of the address space rather than bound in each, so they take
+    /// no part in the ownership of objects and are not in objects or
+    /// segmentMap. Segments are looked up here first.
+    std::shared_ptr<ReadOnlyObjectMap> readOnlyObjects;
+
   public:
     /// The MemoryObject -> ObjectState map that constitutes the
     /// address space.
@@ -64,24 +98,57 @@ namespace klee {
 
     SegmentMap segmentMap;
 
+    /// Concrete addresses assigned to segments (e.g., for external calls),
+    /// in both directions. Use addConcreteAddress() to keep them in sync.
     ConcreteAddressMap concreteAddressMap;
+    ConcreteSegmentMap segmentAddressMap;
 
+    /// Symbolic addresses of freed objects, by segment. Use
+    /// addRemovedObject() to add entries.
     RemovedObjectsMap removedObjectsMap;
 
+    /// The objects (as a pair of the same id) and pairs of objects (ordered
+    /// by id) whose symbolic addresses have been constrained, see
+    /// Executor::addSymbolicAddressAxioms.
+    AddressAxiomSet addressAxioms;
+
+    /// The bound objects that were heap objects when they were bound, so
+    /// that leaks are found without a pass over all objects. Objects marked
+    /// global since are not removed, check isHeapObject().
+    HeapObjectSet heapObjects;
+
     AddressSpace() : cowKey(1) {}
     AddressSpace(const AddressSpace &b)
       : cowKey(++b.cowKey),
+      segmentCache(b.segmentCache),
+      readOnlyObjects(b.readOnlyObjects),
       objects(b.objects),
       segmentMap(b.segmentMap),
-      removedObjectsMap(b.removedObjectsMap) { }
+      concreteAddressMap(b.concreteAddressMap),
+      segmentAddressMap(b.segmentAddressMap),
+      removedObjectsMap(b.removedObjectsMap),
+      addressAxioms(b.addressAxioms),
+      heapObjects(b.heapObjects) { }
     ~AddressSpace() {}
 
+    /// Records that a segment has been given a concrete address.
+    void addConcreteAddress(uint64_t address, uint64_t segment);
+
+    /// Records the symbolic address of a freed object.
+    void addRemovedObject(uint64_t segment, const ref<Expr> &symbolicAddress);
+
     /// Looks up constant segment in concreteAddressMap.
     /// \param segment segment to search for
     /// \param[out] address found address for given segment
     /// \return true iff address was found
     bool resolveInConcreteMap(const uint64_t &segment, uint64_t &address) const;
 
+    /// Looks up a segment in the read-only objects and in segmentMap.
+    /// \param segment non-zero segment to search for
+    /// \param[out] result ObjectPair found for given segment
+    /// \return true iff an ObjectPair was found
+    bool findSegment(uint64_t segment, ObjectPair &result) const;
+
     /// Looks up constant segment in segmentMap
     /// \param pointer KValue containing ConstantExpr non-zero segment
     /// \param[out] result ObjectPair found for given segment
@@ -139,6 +206,17 @@ namespace klee {
     /// Remove a binding from the address space.
     void unbindObject(const MemoryObject *mo);
 
+    /// Unbind the object of os and bind mo, to which it is reallocated, to
+    /// a copy of its contents. The planes of os that no other address space
+    /// shares are moved to mo rather than copied.
+    ObjectState *reallocateObject(const MemoryObject *mo,
+                                  const ObjectState *os);
+
+    /// Moves the binding of a read-only object to the objects shared by
+    /// all copies of this address space. Only valid before the address
+    /// space is first copied.
+    void shareReadOnlyObject(const MemoryObject *mo);
+
     /// Lookup a binding from a MemoryObject.
     const ObjectState *findObject(const MemoryObject *mo) const;
 
@@ -198,6 +276,15 @@ namespace klee {
     /// a pointer we have already seen before.
     void writeToWOS(ExecutionState &state, TimingSolver *solver,
                     const uint8_t *address, ObjectState *wos) const;
+
+    /// A hash of the objects and their contents, see StateFingerprint.h
+    uint64_t getFingerprint() const;
+
+    /// An estimate of the bytes of the objects of this address space. The
+    /// objects it owns (see cowKey) count in full, objects shared with
+    /// other address spaces for their share, so that the footprints of all
+    /// address spaces add up to the memory of the objects.
+    size_t getFootprint() const;
   };
 } // End klee namespace
 
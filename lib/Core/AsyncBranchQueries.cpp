@@ -0,0 +1,145 @@
+//===-- AsyncBranchQueries.cpp --------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "AsyncBranchQueries.h"
+
+#include "ExecutionState.h"
+
+#include "klee/Support/ErrorHandling.h"
+
+#include "llvm/Support/Errno.h"
+
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <poll.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace klee;
+
+namespace {
+/// The answer written by a solver process.
+struct Answer {
+  uint8_t success;
+  int32_t validity;
+};
+} // namespace
+
+AsyncBranchQueries::~AsyncBranchQueries() {
+  for (const auto &p : processes)
+    finish(p, true);
+}
+
+bool AsyncBranchQueries::isPending(const ExecutionState &state) const {
+  for (const auto &p : processes)
+    if (p.state == &state)
+      return true;
+  return false;
+}
+
+bool AsyncBranchQueries::start(
+    ExecutionState &state,
+    const std::function<bool(Solver::Validity &)> &solve) {
+  assert(state.pendingBranch && !isPending(state) && "no branch to solve");
+
+  int fds[2];
+  if (pipe(fds) < 0) {
+    klee_warning("pipe failed (for async branch queries) - %s",
+                 llvm::sys::StrError(errno).c_str());
+    return false;
+  }
+  fflush(stdout);
+  fflush(stderr);
+  pid_t pid = fork();
+  if (pid == -1) {
+    klee_warning("fork failed (for async branch queries) - %s",
+                 llvm::sys::StrError(errno).c_str());
+    close(fds[0]);
+    close(fds[1]);
+    return false;
+  }
+
+  if (pid == 0) {
+    close(fds[0]);
+    Solver::Validity validity = Solver::Unknown;
+    Answer answer;
+    answer.success = solve(validity);
+    answer.validity = validity;
+    ssize_t written;
+    do {
+      written = write(fds[1], &answer, sizeof(answer));
+    } while (written < 0 && errno == EINTR);
+    _exit(0);
+  }
+
+  close(fds[1]);
+  processes.push_back({&state, pid, fds[0]});
+  return true;
+}
+
+void AsyncBranchQueries::finish(const Process &p, bool kill) {
+  if (kill)
+    ::kill(p.pid, SIGKILL);
+  close(p.fd);
+  int status;
+  while (waitpid(p.pid, &status, 0) < 0 && errno == EINTR)
+    ;
+}
+
+void AsyncBranchQueries::collect(bool wait,
+                                 std::vector<ExecutionState *> &answered) {
+  if (processes.empty())
+    return;
+
+  std::vector<pollfd> fds;
+  for (const auto &p : processes)
+    fds.push_back({p.fd, POLLIN, 0});
+  int ready;
+  do {
+    ready = poll(fds.data(), fds.size(), wait ? -1 : 0);
+  } while (ready < 0 && errno == EINTR);
+  if (ready <= 0)
+    return;
+
+  std::vector<Process> running;
+  for (size_t i = 0; i < processes.size(); ++i) {
+    const Process &p = processes[i];
+    if (!fds[i].revents) {
+      running.push_back(p);
+      continue;
+    }
+
+    Answer answer;
+    ssize_t n;
+    do {
+      n = read(p.fd, &answer, sizeof(answer));
+    } while (n < 0 && errno == EINTR);
+    // if the process died, the branch is solved again by the executor
+    if (n == sizeof(answer)) {
+      ExecutionState::PendingBranch &branch = *p.state->pendingBranch;
+      branch.answered = true;
+      branch.success = answer.success;
+      branch.validity = static_cast<Solver::Validity>(answer.validity);
+    }
+    finish(p, false);
+    answered.push_back(p.state);
+  }
+  processes.swap(running);
+}
+
+void AsyncBranchQueries::cancel(ExecutionState &state) {
+  for (auto it = processes.begin(), ie = processes.end(); it != ie; ++it) {
+    if (it->state == &state) {
+      finish(*it, true);
+      processes.erase(it);
+      return;
+    }
+  }
+}
@@ -0,0 +1,65 @@
+//===-- AsyncBranchQueries.h ------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_ASYNCBRANCHQUERIES_H
+#define KLEE_ASYNCBRANCHQUERIES_H
+
+#include "klee/Solver/Solver.h"
+
+#include <functional>
+#include <sys/types.h>
+#include <vector>
+
+namespace klee {
+class ExecutionState;
+
+/// AsyncBranchQueries - Solves the conditions of the branches states are
+/// parked at, each in a process of its own, so that the executor can run
+/// other states in the meantime. The answers are stored in the pending
+/// branches of the states (ExecutionState::pendingBranch).
+class AsyncBranchQueries {
+  struct Process {
+    ExecutionState *state;
+    pid_t pid;
+    int fd;
+  };
+  std::vector<Process> processes;
+  unsigned maxProcesses;
+
+  void finish(const Process &p, bool kill);
+
+public:
+  explicit AsyncBranchQueries(unsigned maxProcesses)
+      : maxProcesses(maxProcesses) {}
+  AsyncBranchQueries(const AsyncBranchQueries &) = delete;
+  AsyncBranchQueries &operator=(const AsyncBranchQueries &) = delete;
+  ~AsyncBranchQueries();
+
+  bool empty() const { return processes.empty(); }
+  bool full() const { return processes.size() >= maxProcesses; }
+  /// The number of queries being solved.
+  size_t size() const { return processes.size(); }
+  bool isPending(const ExecutionState &state) const;
+
+  /// Run solve for the pending branch of state in a new process.
+  /// \return false if no process could be started
+  bool start(ExecutionState &state,
+             const std::function<bool(Solver::Validity &)> &solve);
+
+  /// Store the answers that arrived and append their states to answered.
+  /// \param wait block until at least one answer arrived
+  void collect(bool wait, std::vector<ExecutionState *> &answered);
+
+  /// Stop solving the pending branch of state.
+  void cancel(ExecutionState &state);
+};
+
+} // namespace klee
+
+#endif /* KLEE_ASYNCBRANCHQUERIES_H */
@@ -0,0 +1,229 @@
+//===-- AutoMerger.cpp ----------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "AutoMerger.h"
+
+#include "CoreStats.h"
+#include "ExecutionState.h"
+#include "Executor.h"
+#include "MergeHandler.h"
+
+#include "klee/Module/Cell.h"
+#include "klee/Module/KInstruction.h"
+#include "klee/Module/KModule.h"
+
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/PostDominators.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+
+#include <unordered_map>
+
+using namespace llvm;
+
+namespace klee {
+
+cl::opt<bool> UseAutoMerge(
+    "auto-merge", cl::init(false),
+    cl::desc("Merge states at the joins of the control flow and at loop "
+             "headers, unless they differ in registers most of the later "
+             "queries depend on. Not supported with --use-merge "
+             "(default=false)"),
+    cl::cat(MergeCat));
+
+namespace {
+cl::opt<unsigned> AutoMergeWait(
+    "auto-merge-wait", cl::init(10000),
+    cl::desc("Number of instructions a state waits at a merge point for "
+             "states to merge with, see --auto-merge (default=10000)"),
+    cl::cat(MergeCat));
+
+/// \return the operand of i that is part of a query when i is executed
+/// symbolically, or null
+const Value *getQueryOperand(const Instruction &i) {
+  switch (i.getOpcode()) {
+  case Instruction::Br: {
+    auto &br = cast<BranchInst>(i);
+    return br.isConditional() ? br.getCondition() : nullptr;
+  }
+  case Instruction::Switch:
+    return cast<SwitchInst>(i).getCondition();
+  case Instruction::Load:
+    return cast<LoadInst>(i).getPointerOperand();
+  case Instruction::Store:
+    return cast<StoreInst>(i).getPointerOperand();
+  case Instruction::UDiv:
+  case Instruction::SDiv:
+  case Instruction::URem:
+  case Instruction::SRem:
+    return i.getOperand(1);
+  case Instruction::Call: {
+    const Value *callee = cast<CallInst>(i).getCalledOperand();
+    return isa<Function>(callee) ? nullptr : callee;
+  }
+  default:
+    return nullptr;
+  }
+}
+} // namespace
+
+void AutoMerger::analyze(const KFunction &kf) {
+  analyzed.insert(&kf);
+  Function &f = *kf.function;
+  if (f.isDeclaration())
+    return;
+
+  std::unordered_map<const Value *, unsigned> registers;
+  for (unsigned i = 0; i < kf.numArgs; ++i)
+    registers[f.getArg(i)] = i;
+  for (unsigned i = 0; i < kf.numInstructions; ++i)
+    registers[kf.instructions[i]->inst] = kf.instructions[i]->dest;
+
+  // the registers each query depends on
+  std::unordered_map<const BasicBlock *, std::vector<std::vector<unsigned>>>
+      queries;
+  for (BasicBlock &bb : f) {
+    for (Instruction &i : bb) {
+      const Value *operand = getQueryOperand(i);
+      if (!operand || isa<Constant>(operand))
+        continue;
+      std::vector<unsigned> dependencies;
+      std::unordered_set<const Value *> visited{operand};
+      std::vector<const Value *> worklist{operand};
+      while (!worklist.empty()) {
+        const Value *v = worklist.back();
+        worklist.pop_back();
+        auto it = registers.find(v);
+        if (it == registers.end())
+          continue;
+        dependencies.push_back(it->second);
+        if (auto *inst = dyn_cast<Instruction>(v))
+          for (const Value *op : inst->operands())
+            if (visited.insert(op).second)
+              worklist.push_back(op);
+      }
+      queries[&bb].push_back(std::move(dependencies));
+    }
+  }
+
+  DominatorTree dt(f);
+  LoopInfo li(dt);
+  PostDominatorTree pdt(f);
+  std::vector<BasicBlock *> joins;
+  for (BasicBlock &bb : f) {
+    if (li.isLoopHeader(&bb))
+      joins.push_back(&bb);
+    if (bb.getTerminator()->getNumSuccessors() < 2)
+      continue;
+    if (auto *node = pdt.getNode(&bb))
+      if (auto *idom = node->getIDom())
+        if (BasicBlock *join = idom->getBlock())
+          joins.push_back(join);
+  }
+
+  for (BasicBlock *join : joins) {
+    Instruction *point = join->getFirstNonPHI();
+    if (!point || point->isEHPad() || hot.count(point))
+      continue;
+
+    // count the queries in the blocks reachable from the join
+    std::vector<unsigned> counts(kf.numRegisters);
+    unsigned total = 0;
+    std::unordered_set<const BasicBlock *> reached{join};
+    std::vector<const BasicBlock *> worklist{join};
+    while (!worklist.empty()) {
+      const BasicBlock *bb = worklist.back();
+      worklist.pop_back();
+      for (const auto &dependencies : queries[bb]) {
+        ++total;
+        for (unsigned r : dependencies)
+          ++counts[r];
+      }
+      for (const BasicBlock *succ : successors(bb))
+        if (reached.insert(succ).second)
+          worklist.push_back(succ);
+    }
+
+    std::vector<bool> &hotRegisters = hot[point];
+    hotRegisters.resize(kf.numRegisters);
+    for (unsigned r = 0; r < kf.numRegisters; ++r)
+      hotRegisters[r] = 2 * counts[r] > total;
+  }
+}
+
+bool AutoMerger::agreeOnHot(const std::vector<bool> &hotRegisters,
+                            const ExecutionState &a,
+                            const ExecutionState &b) const {
+  if (a.stack.size() != b.stack.size() ||
+      a.stack.back().kf != b.stack.back().kf)
+    return false;
+  const Cell *x = a.stack.back().locals;
+  const Cell *y = b.stack.back().locals;
+  for (unsigned r = 0; r < hotRegisters.size(); ++r) {
+    if (!hotRegisters[r] || !x[r].value || !y[r].value)
+      continue;
+    if (x[r].value != y[r].value || x[r].getSegment() != y[r].getSegment())
+      return false;
+  }
+  return true;
+}
+
+bool AutoMerger::arrive(ExecutionState &state) {
+  const KFunction *kf = state.stack.back().kf;
+  if (!analyzed.count(kf))
+    analyze(*kf);
+  const Instruction *point = state.pc->inst;
+  auto it = hot.find(point);
+  if (it == hot.end() || released.erase(&state))
+    return false;
+
+  for (const Parked &p : parked) {
+    if (p.state->pc != state.pc)
+      continue;
+    if (!agreeOnHot(it->second, *p.state, state)) {
+      ++stats::autoMergesRejected;
+      continue;
+    }
+    if (p.state->merge(state)) {
+      executor.terminateStateEarly(state, "merged state.",
+                                   StateTerminationType::Merge);
+      return true;
+    }
+  }
+
+  parked.push_back({&state, stats::instructions});
+  executor.parkedStates.push_back(&state);
+  return true;
+}
+
+void AutoMerger::release(bool all, std::vector<ExecutionState *> &states) {
+  std::vector<Parked> waiting;
+  for (const Parked &p : parked) {
+    if (all || stats::instructions - p.since >= AutoMergeWait) {
+      states.push_back(p.state);
+      released.insert(p.state);
+    } else {
+      waiting.push_back(p);
+    }
+  }
+  parked.swap(waiting);
+}
+
+bool AutoMerger::remove(ExecutionState &state) {
+  released.erase(&state);
+  auto it = std::find_if(parked.begin(), parked.end(),
+                         [&](const Parked &p) { return p.state == &state; });
+  if (it == parked.end())
+    return false;
+  parked.erase(it);
+  return true;
+}
+
+} // namespace klee
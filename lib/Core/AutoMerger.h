@@ -0,0 +1,88 @@
+//===-- AutoMerger.h --------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_AUTOMERGER_H
+#define KLEE_AUTOMERGER_H
+
+#include "llvm/Support/CommandLine.h"
+
+#include <cstdint>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace llvm {
+class Instruction;
+}
+
+namespace klee {
+extern llvm::cl::opt<bool> UseAutoMerge;
+
+class Executor;
+class ExecutionState;
+struct KFunction;
+
+/// AutoMerger - Merges states without klee_open_merge and klee_close_merge
+/// calls, at the joins of the control flow: the immediate post-dominators
+/// of the blocks ending in a conditional branch, and the loop headers. The
+/// merge point of a join is its first instruction after the PHI nodes.
+///
+/// A state reaching a merge point is parked until a state reaching the
+/// same point is merged into it, or until it waited for
+/// --auto-merge-wait instructions or no other state is left to run.
+///
+/// Whether to merge is decided in the spirit of the query count estimation
+/// of Kuznetsov et al. (PLDI'12): a register of the current function is hot
+/// at a merge point if most of the queries reachable from there (branch
+/// conditions, addresses of memory accesses, divisors) depend on it.
+/// States that differ in a hot register are not merged, as the select
+/// expressions of the merged state would reach most later queries.
+class AutoMerger {
+  struct Parked {
+    ExecutionState *state;
+    /// The number of executed instructions when it was parked.
+    uint64_t since;
+  };
+
+  Executor &executor;
+  std::unordered_set<const KFunction *> analyzed;
+  /// The hot registers of each merge point.
+  std::unordered_map<const llvm::Instruction *, std::vector<bool>> hot;
+  /// In the order they were parked in.
+  std::vector<Parked> parked;
+  /// Released states that pass their merge point without stopping.
+  std::unordered_set<const ExecutionState *> released;
+
+  void analyze(const KFunction &kf);
+  bool agreeOnHot(const std::vector<bool> &hotRegisters,
+                  const ExecutionState &a, const ExecutionState &b) const;
+
+public:
+  explicit AutoMerger(Executor &executor) : executor(executor) {}
+  AutoMerger(const AutoMerger &) = delete;
+  AutoMerger &operator=(const AutoMerger &) = delete;
+
+  /// Called for a selected state before it executes its next instruction.
+  /// \return true if it was merged into a parked state or parked itself,
+  /// in which case it is not to be executed
+  bool arrive(ExecutionState &state);
+
+  bool hasParked() const { return !parked.empty(); }
+
+  /// Release the parked states that waited long enough, or all of them.
+  void release(bool all, std::vector<ExecutionState *> &states);
+
+  /// Forget a state that is about to be removed. \return true if it was
+  /// parked, and so is not known to the searcher
+  bool remove(ExecutionState &state);
+};
+
+} // namespace klee
+
+#endif /* KLEE_AUTOMERGER_H */
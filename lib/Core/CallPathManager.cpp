@@ -14,9 +14,6 @@
 #include "llvm/IR/Function.h"
 #include "llvm/Support/raw_ostream.h"
 
-#include <map>
-#include <vector>
-
 using namespace klee;
 
 ///
@@ -45,16 +42,16 @@ void CallPathManager::getSummaryStatistics(CallSiteSummaryTable &results) {
   results.clear();
 
   for (auto &path : paths)
-    path->summaryStatistics = path->statistics;
+    path.summaryStatistics = path.statistics;
 
   // compute summary bottom up, while building result table
   for (auto it = paths.rbegin(), ie = paths.rend(); it != ie; ++it) {
-    const auto &cp = (*it);
-    cp->parent->summaryStatistics += cp->summaryStatistics;
+    CallPathNode &cp = *it;
+    cp.parent->summaryStatistics += cp.summaryStatistics;
 
-    CallSiteInfo &csi = results[cp->callSite][cp->function];
-    csi.count += cp->count;
-    csi.statistics += cp->summaryStatistics;
+    CallSiteInfo &csi = results[cp.callSite][cp.function];
+    csi.count += cp.count;
+    csi.statistics += cp.summaryStatistics;
   }
 }
 
@@ -65,10 +62,8 @@ CallPathNode *CallPathManager::computeCallPath(CallPathNode *parent,
     if (cs==p->callSite && f==p->function)
       return p;
 
-  auto cp = std::unique_ptr<CallPathNode>(new CallPathNode(parent, cs, f));
-  auto newCP = cp.get();
-  paths.emplace_back(std::move(cp));
-  return newCP;
+  paths.emplace_back(parent, cs, f);
+  return &paths.back();
 }
 
 CallPathNode *CallPathManager::getCallPath(CallPathNode *parent,
@@ -78,13 +73,9 @@ CallPathNode *CallPathManager::getCallPath(CallPathNode *parent,
   if (!parent)
     parent = &root;
 
-  auto it = parent->children.find(key);
-  if (it==parent->children.end()) {
-    auto cp = computeCallPath(parent, cs, f);
-    parent->children.insert(std::make_pair(key, cp));
-    return cp;
-  } else {
-    return it->second;
-  }
+  CallPathNode *&cp = parent->children[key];
+  if (!cp)
+    cp = computeCallPath(parent, cs, f);
+  return cp;
 }
 
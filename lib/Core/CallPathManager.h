@@ -12,9 +12,9 @@
 
 #include "klee/Statistics/Statistics.h"
 
-#include <map>
-#include <memory>
-#include <vector>
+#include "llvm/ADT/DenseMap.h"
+
+#include <deque>
 
 namespace llvm {
   class Instruction;
@@ -32,15 +32,15 @@ namespace klee {
     CallSiteInfo() : count(0) {}
   };
 
-  typedef std::map<const llvm::Instruction *,
-                   std::map<const llvm::Function *, CallSiteInfo>>
+  typedef llvm::DenseMap<const llvm::Instruction *,
+                         llvm::DenseMap<const llvm::Function *, CallSiteInfo>>
       CallSiteSummaryTable;
 
   class CallPathNode {
     friend class CallPathManager;
 
   public:
-    typedef std::map<
+    typedef llvm::DenseMap<
         std::pair<const llvm::Instruction *, const llvm::Function *>,
         CallPathNode *>
         children_ty;
@@ -64,7 +64,9 @@ namespace klee {
 
   class CallPathManager {
     CallPathNode root;
-    std::vector<std::unique_ptr<CallPathNode>> paths;
+    /// The nodes below root in the order of their creation, allocated in
+    /// chunks.
+    std::deque<CallPathNode> paths;
 
   private:
     CallPathNode *computeCallPath(CallPathNode *parent,
@@ -0,0 +1,129 @@
+//===-- Checkpoint.cpp ----------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "Checkpoint.h"
+
+#include "klee/Support/ErrorHandling.h"
+
+#include "llvm/Support/EndianStream.h"
+#include "llvm/Support/Errc.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <cstdio>
+
+using namespace klee;
+using namespace llvm;
+
+namespace {
+const char Magic[4] = {'K', 'C', 'K', 'P'};
+const std::uint8_t Version = 1;
+} // namespace
+
+bool Checkpoint::write(const std::string &path) const {
+  std::string tmp = path + ".tmp";
+  std::error_code ec;
+  {
+    raw_fd_ostream os(tmp, ec, sys::fs::OF_None);
+    if (ec) {
+      klee_warning("unable to write checkpoint %s - %s", tmp.c_str(),
+                   ec.message().c_str());
+      return false;
+    }
+    using namespace llvm::support;
+    endian::Writer w(os, little);
+    os.write(Magic, sizeof(Magic));
+    w.write<std::uint8_t>(Version);
+    w.write<std::uint32_t>(numInstructions);
+    w.write<std::uint32_t>(counts.pathsCompleted);
+    w.write<std::uint32_t>(counts.pathsExplored);
+    w.write<std::uint32_t>(counts.testCases);
+    w.write<std::uint32_t>(counts.totalTests);
+    w.write<std::uint32_t>(covered.size());
+    for (std::uint32_t id : covered)
+      w.write<std::uint32_t>(id);
+    w.write<std::uint32_t>(states.size());
+    for (const auto &choices : states) {
+      w.write<std::uint32_t>(choices.size());
+      for (std::uint32_t c : choices)
+        w.write<std::uint32_t>(c);
+    }
+    os.close();
+    if (os.has_error()) {
+      klee_warning("unable to write checkpoint %s - %s", tmp.c_str(),
+                   os.error().message().c_str());
+      os.clear_error();
+      return false;
+    }
+  }
+  if ((ec = sys::fs::rename(tmp, path))) {
+    klee_warning("unable to write checkpoint %s - %s", path.c_str(),
+                 ec.message().c_str());
+    return false;
+  }
+  return true;
+}
+
+bool Checkpoint::read(const std::string &path, std::string &error) {
+  auto buffer = MemoryBuffer::getFile(path);
+  if (!buffer) {
+    error = buffer.getError().message();
+    return false;
+  }
+  StringRef data = buffer.get()->getBuffer();
+  if (data.size() < sizeof(Magic) + 1 ||
+      !data.startswith(StringRef(Magic, sizeof(Magic))) ||
+      static_cast<std::uint8_t>(data[sizeof(Magic)]) != Version) {
+    error = "not a checkpoint of this version";
+    return false;
+  }
+
+  const char *p = data.data() + sizeof(Magic) + 1;
+  const char *end = data.data() + data.size();
+  auto read = [&](std::uint32_t &value) {
+    using namespace llvm::support;
+    if (end - p < 4)
+      return false;
+    value = endian::readNext<std::uint32_t, little, unaligned>(p);
+    return true;
+  };
+  // a count is at most the number of words left, so that a corrupted
+  // count does not allocate much
+  auto readCount = [&](std::uint32_t &count) {
+    return read(count) && count <= static_cast<std::size_t>(end - p) / 4;
+  };
+
+  std::uint32_t n;
+  if (!read(numInstructions) || !read(counts.pathsCompleted) ||
+      !read(counts.pathsExplored) || !read(counts.testCases) ||
+      !read(counts.totalTests) || !readCount(n))
+    goto truncated;
+  covered.resize(n);
+  for (auto &id : covered)
+    if (!read(id))
+      goto truncated;
+  if (!readCount(n))
+    goto truncated;
+  states.resize(n);
+  for (auto &choices : states) {
+    if (!readCount(n))
+      goto truncated;
+    choices.resize(n);
+    for (auto &c : choices)
+      if (!read(c))
+        goto truncated;
+  }
+  if (p == end)
+    return true;
+
+truncated:
+  error = "malformed checkpoint";
+  return false;
+}
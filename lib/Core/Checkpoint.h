@@ -0,0 +1,46 @@
+//===-- Checkpoint.h --------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_CHECKPOINT_H
+#define KLEE_CHECKPOINT_H
+
+#include "klee/Core/Interpreter.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace klee {
+
+/// Checkpoint - What a run needs to continue after it was stopped (see
+/// --checkpoint-interval and --resume-from). The states are kept as the
+/// choices they took at their forks (ExecutionState::forkChoices) and are
+/// rebuilt by replaying those from the initial state, which also rebuilds
+/// their part of the process tree and their arrays. The searcher starts
+/// afresh with the rebuilt states.
+struct Checkpoint {
+  /// The number of instruction ids of the module, to tell checkpoints of
+  /// other programs apart.
+  std::uint32_t numInstructions = 0;
+  InterpreterHandler::WorkerCounts counts;
+  /// The ids of the covered instructions.
+  std::vector<std::uint32_t> covered;
+  std::vector<std::vector<std::uint32_t>> states;
+
+  /// Write to path, replacing the file at once so that a run stopped while
+  /// writing keeps the previous checkpoint. \return false on failure
+  bool write(const std::string &path) const;
+
+  /// \return false if the file cannot be read or is malformed
+  bool read(const std::string &path, std::string &error);
+};
+
+} // namespace klee
+
+#endif /* KLEE_CHECKPOINT_H */
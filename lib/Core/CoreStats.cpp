@@ -11,18 +11,58 @@
 
 using namespace klee;
 
+Statistic stats::adaptiveSolverTimeouts("AdaptiveSolverTimeouts", "ASTout");
+Statistic stats::affinitySelections("AffinitySelections", "Saff");
 Statistic stats::allocations("Allocations", "Alloc");
+Statistic stats::asyncBranchQueries("AsyncBranchQueries", "ABqueries");
+Statistic stats::autoMergesRejected("AutoMergesRejected", "AMrej");
+Statistic stats::batchesGrown("BatchesGrown", "Bgrow");
+Statistic stats::batchesShrunk("BatchesShrunk", "Bshrink");
+Statistic stats::batchedNondetValues("BatchedNondetValues", "NDbatch");
+Statistic stats::boundsChecksCached("BoundsChecksCached", "BCcache");
+Statistic stats::boundsChecksFolded("BoundsChecksFolded", "BCfold");
+Statistic stats::boundsChecksQueried("BoundsChecksQueried", "BCquery");
+Statistic stats::boundsChecksStatic("BoundsChecksStatic", "BCstatic");
+Statistic stats::boundsSolverTime("BoundsSolverTime", "SBCtime");
+Statistic stats::branchSolverTime("BranchSolverTime", "SBtime");
+Statistic stats::cachedExternalCalls("CachedExternalCalls", "Ecache");
+Statistic stats::concreteInstructions("ConcreteInstructions", "Iconc");
 Statistic stats::coveredInstructions("CoveredInstructions", "Icov");
+Statistic stats::externalStubTime("ExternalStubTime", "EStime");
 Statistic stats::falseBranches("FalseBranches", "Bf");
 Statistic stats::forkTime("ForkTime", "Ftime");
+Statistic stats::forkModelHits("ForkModelHits", "FMhits");
+Statistic stats::forkModelMisses("ForkModelMisses", "FMmiss");
 Statistic stats::forks("Forks", "Forks");
 Statistic stats::instructionRealTime("InstructionRealTimes", "Ireal");
 Statistic stats::instructionTime("InstructionTimes", "Itime");
 Statistic stats::instructions("Instructions", "I");
+Statistic stats::loadedExternalStubs("LoadedExternalStubs", "ESload");
+Statistic stats::memoizedCallHits("MemoizedCallHits", "MChits");
+Statistic stats::memoizedCallsRecorded("MemoizedCallsRecorded", "MCrec");
+Statistic stats::mergeAttempts("MergeAttempts", "Mtry");
+Statistic stats::mergedQueryTime("MergedQueryTime", "MQtime");
+Statistic stats::mergedResolutions("MergedResolutions", "Rmerged");
+Statistic stats::mergedStates("MergedStates", "Merged");
+Statistic stats::decidedByRanges("DecidedByRanges", "Dranges");
 Statistic stats::minDistToReturn("MinDistToReturn", "Rdist");
 Statistic stats::minDistToUncovered("MinDistToUncovered", "UCdist");
+Statistic stats::releasedCacheBytes("ReleasedCacheBytes", "CMrel");
+Statistic stats::reloadedStates("ReloadedStates", "Sreload");
+Statistic stats::resolutionCacheHits("ResolutionCacheHits", "RChits");
 Statistic stats::resolveTime("ResolveTime", "Rtime");
+Statistic stats::schedulingPoints("SchedulingPoints", "Sched");
+Statistic stats::seededBranches("SeededBranches", "Bseed");
+Statistic stats::sleepingThreads("SleepingThreads", "Tsleep");
 Statistic stats::solverTime("SolverTime", "Stime");
+Statistic stats::solverTimeSaved("SolverTimeSaved", "STsaved");
 Statistic stats::states("States", "States");
+Statistic stats::swappedOutStates("SwappedOutStates", "Sswap");
+Statistic stats::testGenSolverTime("TestGenSolverTime", "STGtime");
 Statistic stats::trueBranches("TrueBranches", "Bt");
 Statistic stats::uncoveredInstructions("UncoveredInstructions", "Iuncov");
+Statistic stats::uniqueValueCacheHits("UniqueValueCacheHits", "UVhits");
+Statistic stats::updateListCompactions("UpdateListCompactions", "ULcomp");
+Statistic stats::impliedValueConcretizations("ImpliedValueConcretizations",
+                                             "Ivc");
+Statistic stats::valueSolverTime("ValueSolverTime", "SVtime");
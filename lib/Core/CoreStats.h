@@ -16,7 +16,37 @@ namespace klee {
 namespace stats {
 
   extern Statistic allocations;
+  /// Number of in-bounds checks of memory operations that were decided
+  /// without (boundsChecksFolded) and with (boundsChecksQueried) the solver,
+  /// or from earlier checks of the same object of symbolic size
+  /// (boundsChecksCached), and of those skipped as the access was proven in
+  /// bounds when the module was prepared (boundsChecksStatic).
+  extern Statistic boundsChecksCached;
+  extern Statistic boundsChecksFolded;
+  extern Statistic boundsChecksQueried;
+  extern Statistic boundsChecksStatic;
+  /// Number of instructions executed on native integers, see
+  /// Executor::executeConcreteInstruction.
+  extern Statistic concreteInstructions;
   extern Statistic resolveTime;
+  /// Number of memory operations through symbolic addresses that were
+  /// found in the per-state resolution cache.
+  extern Statistic resolutionCacheHits;
+  /// Number of calls to Executor::toUnique answered from the per-state
+  /// cache of unique values.
+  extern Statistic uniqueValueCacheHits;
+  /// Number of calls to pure externals answered from the cache, see
+  /// --cache-pure-externals.
+  extern Statistic cachedExternalCalls;
+  /// Number of calls of memoizable functions answered from the results of
+  /// earlier calls (memoizedCallHits) and of results recorded
+  /// (memoizedCallsRecorded), see --memoize-calls.
+  extern Statistic memoizedCallHits;
+  extern Statistic memoizedCallsRecorded;
+  /// The microseconds spent building the stubs for external calls, and the
+  /// number of stubs loaded from --external-stub-cache.
+  extern Statistic externalStubTime;
+  extern Statistic loadedExternalStubs;
   extern Statistic instructions;
   extern Statistic instructionTime;
   extern Statistic instructionRealTime;
@@ -25,11 +55,88 @@ namespace stats {
   extern Statistic trueBranches;
   extern Statistic falseBranches;
   extern Statistic forkTime;
+  /// Number of reads through pointers with several targets that were
+  /// executed as a single read, see --merge-memory-resolutions.
+  extern Statistic mergedResolutions;
+  /// Number of attempts to merge two states (mergeAttempts), of the
+  /// successful ones (mergedStates) and the microseconds spent in the
+  /// queries of merged states and the states forked from them
+  /// (mergedQueryTime).
+  extern Statistic mergeAttempts;
+  extern Statistic mergedStates;
+  extern Statistic mergedQueryTime;
+  /// Number of states not merged at an automatic merge point as they differ
+  /// in a hot register, see --auto-merge.
+  extern Statistic autoMergesRejected;
+  /// Number of selections of a state of the last selected lineage in favor
+  /// of the choice of the searchers, see --solver-affinity.
+  extern Statistic affinitySelections;
+  /// Number of batches after which the adaptive batching searcher grew or
+  /// shrank the instruction budget of the state, see --batch-adaptive.
+  extern Statistic batchesGrown;
+  extern Statistic batchesShrunk;
   extern Statistic solverTime;
+  /// The microseconds of solverTime spent in the queries of branch
+  /// conditions, of bounds checks, of concretizations through getValue and
+  /// of test generation.
+  extern Statistic branchSolverTime;
+  extern Statistic boundsSolverTime;
+  extern Statistic valueSolverTime;
+  extern Statistic testGenSolverTime;
+
+  /// Number of queries that ran out of a timeout shortened by
+  /// --adaptive-solver-timeouts, and the microseconds of the full timeouts
+  /// they did not use.
+  extern Statistic adaptiveSolverTimeouts;
+  extern Statistic solverTimeSaved;
 
   /// The number of process forks.
   extern Statistic forks;
 
+  /// Number of symbolic branch conditions decided with (forkModelHits) and
+  /// without (forkModelMisses) a known model of the state's constraints.
+  extern Statistic forkModelHits;
+  extern Statistic forkModelMisses;
+
+  /// Number of branches decided by the seeds of a state without a query,
+  /// see --fast-forward-seeds.
+  extern Statistic seededBranches;
+
+  /// Number of branch conditions and bounds checks decided by the bounds
+  /// learned from the constraints of a state, without a query.
+  extern Statistic decidedByRanges;
+
+  /// Number of branch conditions solved in a forked process while the
+  /// state was parked, see --async-branch-queries.
+  extern Statistic asyncBranchQueries;
+
+  /// Number of states swapped out over the memory cap and of states
+  /// rebuilt from the swap file, see --state-swap.
+  extern Statistic swappedOutStates;
+  extern Statistic reloadedStates;
+
+  /// Bytes of the caches given back over their budgets or over the memory
+  /// cap, see --memory-budget.
+  extern Statistic releasedCacheBytes;
+
+  /// Number of update lists whose concrete writes were folded into a new
+  /// constant array, see --update-list-compaction-threshold.
+  extern Statistic updateListCompactions;
+
+  /// Number of bytes of memory rewritten with the implied values of their
+  /// reads, see --implied-value-concretization.
+  extern Statistic impliedValueConcretizations;
+
+  /// Number of points where several threads could run next, and number of
+  /// threads not run there as the partial-order reduction found their
+  /// orders explored by another state, see --partial-order-reduction.
+  extern Statistic schedulingPoints;
+  extern Statistic sleepingThreads;
+
+  /// Number of nondet values read from the arrays backing the buffers they
+  /// fill, see --batch-nondet-fills.
+  extern Statistic batchedNondetValues;
+
   /// Number of states, this is a "fake" statistic used by istats, it
   /// isn't normally up-to-date.
   extern Statistic states;
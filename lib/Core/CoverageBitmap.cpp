@@ -0,0 +1,88 @@
+//===-- CoverageBitmap.cpp ------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "CoverageBitmap.h"
+
+#include "klee/Support/ErrorHandling.h"
+
+#include "llvm/Support/Errno.h"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace klee;
+
+namespace {
+const char Magic[8] = {'K', 'L', 'E', 'E', 'C', 'O', 'V', '1'};
+} // namespace
+
+std::unique_ptr<CoverageBitmap> CoverageBitmap::open(const std::string &path,
+                                                     size_t size) {
+  int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    klee_warning("unable to open coverage bitmap %s - %s", path.c_str(),
+                 llvm::sys::StrError(errno).c_str());
+    return nullptr;
+  }
+  auto fail = [&](const char *reason) -> std::unique_ptr<CoverageBitmap> {
+    klee_warning("unable to use coverage bitmap %s - %s", path.c_str(),
+                 reason);
+    close(fd);
+    return nullptr;
+  };
+
+  // the processes starting at once agree on who writes the header
+  while (flock(fd, LOCK_EX) < 0)
+    if (errno != EINTR)
+      return fail(llvm::sys::StrError(errno).c_str());
+  size_t mappingSize = sizeof(Header) + size;
+  struct stat st;
+  if (fstat(fd, &st) < 0)
+    return fail(llvm::sys::StrError(errno).c_str());
+  Header header;
+  if (st.st_size == 0) {
+    std::memcpy(header.magic, Magic, sizeof(Magic));
+    header.size = size;
+    // the bytes after the header are zero, nothing is covered
+    if (ftruncate(fd, mappingSize) < 0 ||
+        pwrite(fd, &header, sizeof(header), 0) !=
+            static_cast<ssize_t>(sizeof(header)))
+      return fail(llvm::sys::StrError(errno).c_str());
+  } else if (pread(fd, &header, sizeof(header), 0) !=
+                 static_cast<ssize_t>(sizeof(header)) ||
+             std::memcmp(header.magic, Magic, sizeof(Magic)) ||
+             header.size != size ||
+             static_cast<size_t>(st.st_size) != mappingSize) {
+    return fail("it is not the bitmap of this module");
+  }
+  flock(fd, LOCK_UN);
+
+  void *mapping =
+      mmap(nullptr, mappingSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    klee_warning("mmap failed (for the coverage bitmap) - %s",
+                 llvm::sys::StrError(errno).c_str());
+    return nullptr;
+  }
+  return std::unique_ptr<CoverageBitmap>(
+      new CoverageBitmap(mapping, mappingSize));
+}
+
+CoverageBitmap::CoverageBitmap(void *mapping, size_t mappingSize)
+    : mapping(mapping), mappingSize(mappingSize),
+      bits(reinterpret_cast<std::atomic<std::uint8_t> *>(
+          static_cast<char *>(mapping) + sizeof(Header))) {}
+
+CoverageBitmap::~CoverageBitmap() { munmap(mapping, mappingSize); }
@@ -0,0 +1,60 @@
+//===-- CoverageBitmap.h ----------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_COVERAGEBITMAP_H
+#define KLEE_COVERAGEBITMAP_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace klee {
+
+/// CoverageBitmap - The covered instructions of a program, a byte per
+/// instruction id that is set once the instruction is covered, in a file
+/// that each process sharing it maps (see --coverage-bitmap). These may be
+/// other runs of KLEE on the same module, or fuzzers that map the file too:
+/// the bytes follow a header of the magic "KLEECOV1" and the number of
+/// bytes as a 64-bit integer in the byte order of the host.
+class CoverageBitmap {
+  void *mapping;
+  size_t mappingSize;
+  std::atomic<std::uint8_t> *bits;
+
+  CoverageBitmap(void *mapping, size_t mappingSize);
+
+public:
+  struct Header {
+    char magic[8];
+    std::uint64_t size;
+  };
+
+  /// Map the bitmap of size bytes at path, which is created if it does not
+  /// exist and otherwise keeps the coverage recorded in it. \return null if
+  /// that fails or the file is of a different size
+  static std::unique_ptr<CoverageBitmap> open(const std::string &path,
+                                              size_t size);
+  ~CoverageBitmap();
+
+  CoverageBitmap(const CoverageBitmap &) = delete;
+  CoverageBitmap &operator=(const CoverageBitmap &) = delete;
+
+  /// Mark the instruction covered. \return whether it was covered already
+  bool mark(unsigned id) { return bits[id].exchange(1); }
+
+  bool isCovered(unsigned id) const {
+    return bits[id].load(std::memory_order_relaxed);
+  }
+};
+
+} // namespace klee
+
+#endif /* KLEE_COVERAGEBITMAP_H */
@@ -0,0 +1,101 @@
+//===-- EventTrace.cpp ----------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "EventTrace.h"
+
+#include "TimingSolver.h"
+
+#include "klee/Core/TerminationTypes.h"
+
+#include "llvm/Support/raw_ostream.h"
+
+#include <string>
+
+using namespace klee;
+
+namespace {
+const char Magic[8] = {'K', 'L', 'E', 'E', 'T', 'R', 'C', '1'};
+const std::uint32_t Version = 1;
+
+void writeInt(llvm::raw_ostream &os, std::uint32_t value) {
+  os.write(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+} // namespace
+
+EventTrace::EventTrace(std::unique_ptr<llvm::raw_fd_ostream> os)
+    : os(std::move(os)), start(std::chrono::steady_clock::now()),
+      events(new Event[NumChunks * ChunkSize]), next(events.get()),
+      chunkEnd(events.get() + ChunkSize) {
+  writeHeader();
+  thread = std::thread([this] { run(); });
+}
+
+EventTrace::~EventTrace() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    lastSize = ChunkSize - (chunkEnd - next);
+    stopping = true;
+  }
+  changed.notify_all();
+  thread.join();
+}
+
+void EventTrace::writeHeader() {
+  std::string names;
+  llvm::raw_string_ostream namesOS(names);
+#define TTYPE(N, I, S) namesOS << "terminate " << (I) << " " #N "\n";
+#define MARK(N, I)
+  TERMINATION_TYPES
+#undef TTYPE
+#undef MARK
+  using QueryKind = TimingSolver::QueryKind;
+  for (auto kind : {std::make_pair(QueryKind::Branch, "Branch"),
+                    std::make_pair(QueryKind::BoundsCheck, "BoundsCheck"),
+                    std::make_pair(QueryKind::TestGeneration, "TestGeneration"),
+                    std::make_pair(QueryKind::Other, "Other")})
+    namesOS << "query " << static_cast<unsigned>(kind.first) << " "
+            << kind.second << "\n";
+  namesOS.flush();
+
+  os->write(Magic, sizeof(Magic));
+  writeInt(*os, Version);
+  writeInt(*os, sizeof(Event));
+  writeInt(*os, names.size());
+  *os << names;
+}
+
+void EventTrace::run() {
+  std::unique_lock<std::mutex> lock(mutex);
+  for (;;) {
+    changed.wait(lock, [&] { return stopping || written < filled; });
+    if (written == filled)
+      break;
+    const Event *chunk = events.get() + (written % NumChunks) * ChunkSize;
+    lock.unlock();
+    os->write(reinterpret_cast<const char *>(chunk), ChunkSize * sizeof(Event));
+    lock.lock();
+    ++written;
+    changed.notify_all();
+  }
+
+  // the interpreter stopped recording
+  const Event *chunk = events.get() + (filled % NumChunks) * ChunkSize;
+  os->write(reinterpret_cast<const char *>(chunk), lastSize * sizeof(Event));
+  os->flush();
+}
+
+void EventTrace::nextChunk() {
+  std::unique_lock<std::mutex> lock(mutex);
+  ++filled;
+  changed.notify_all();
+  // the next chunk of the ring may still be waiting to be written
+  changed.wait(lock, [&] { return filled - written < NumChunks; });
+  next = events.get() + (filled % NumChunks) * ChunkSize;
+  chunkEnd = next + ChunkSize;
+}
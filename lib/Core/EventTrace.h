@@ -0,0 +1,128 @@
+//===-- EventTrace.h --------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_EVENTTRACE_H
+#define KLEE_EVENTTRACE_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace llvm {
+class raw_fd_ostream;
+}
+
+namespace klee {
+
+/// EventTrace - Records the events of an execution in a binary file for
+/// offline analysis (see --event-trace and klee-trace). Events are appended
+/// to a ring of fixed-size chunks; a full chunk is written by a thread of
+/// its own while the interpreter fills the next one, so recording an event
+/// costs a clock read and a store. The interpreter only waits when all
+/// chunks are waiting to be written.
+///
+/// The file starts with the magic "KLEETRC1", the version and the size of
+/// an event as 32 bit integers, and the length of a text block that names
+/// the detail values ("<kind> <value> <name>" lines), followed by the events.
+class EventTrace {
+public:
+  enum Kind : std::uint8_t {
+    /// arg is the new state.
+    Fork = 1,
+    /// The interpreter switched to the state.
+    Select = 2,
+    /// detail is the TimingSolver::QueryKind.
+    QueryStart = 3,
+    /// detail is the TimingSolver::QueryKind, arg whether it succeeded.
+    QueryEnd = 4,
+    /// detail is the StateTerminationType.
+    Terminate = 5,
+    /// The state was merged into another one and terminated.
+    Merge = 6,
+    /// The memory cap was exceeded, arg is the usage in MB.
+    MemoryLimit = 7,
+  };
+
+  struct Event {
+    /// Nanoseconds since the trace was opened.
+    std::uint64_t time;
+    std::uint32_t state;
+    std::uint8_t kind;
+    std::uint8_t detail;
+    std::uint16_t reserved;
+    std::uint64_t arg;
+  };
+  static_assert(sizeof(Event) == 24, "events are written as they are");
+
+private:
+  static constexpr unsigned NumChunks = 8;
+  static constexpr unsigned ChunkSize = 4096;
+
+  std::unique_ptr<llvm::raw_fd_ostream> os;
+  const std::chrono::steady_clock::time_point start;
+  std::unique_ptr<Event[]> events;
+  Event *next;
+  Event *chunkEnd;
+  /// The state of the last Select event.
+  std::uint32_t current = 0;
+
+  std::mutex mutex;
+  std::condition_variable changed;
+  /// The numbers of chunks handed to the writer and written.
+  std::uint64_t filled = 0, written = 0;
+  /// The events of the last chunk, when stopping.
+  unsigned lastSize = 0;
+  bool stopping = false;
+  std::thread thread;
+
+  void writeHeader();
+  void run();
+  /// Hands the current chunk to the writer and starts the next one.
+  void nextChunk();
+
+public:
+  explicit EventTrace(std::unique_ptr<llvm::raw_fd_ostream> os);
+  /// Writes the events recorded so far.
+  ~EventTrace();
+
+  EventTrace(const EventTrace &) = delete;
+  EventTrace &operator=(const EventTrace &) = delete;
+
+  void record(Kind kind, std::uint32_t state, std::uint8_t detail = 0,
+              std::uint64_t arg = 0) {
+    if (next == chunkEnd)
+      nextChunk();
+    auto now = std::chrono::steady_clock::now() - start;
+    *next++ = {static_cast<std::uint64_t>(
+                   std::chrono::duration_cast<std::chrono::nanoseconds>(now)
+                       .count()),
+               state, kind, detail, 0, arg};
+  }
+
+  /// Records the event for the state of the last Select event.
+  void recordCurrent(Kind kind, std::uint8_t detail = 0,
+                     std::uint64_t arg = 0) {
+    record(kind, current, detail, arg);
+  }
+
+  /// Records a Select event if the interpreter switched states.
+  void select(std::uint32_t state) {
+    if (state == current)
+      return;
+    current = state;
+    record(Select, state);
+  }
+};
+
+} // namespace klee
+
+#endif /* KLEE_EVENTTRACE_H */
@@ -9,7 +9,9 @@
 
 #include "ExecutionState.h"
 
+#include "CoreStats.h"
 #include "Memory.h"
+#include "StateFingerprint.h"
 
 #include "klee/Expr/Expr.h"
 #include "klee/Module/Cell.h"
@@ -19,16 +21,20 @@
 #include "klee/Support/Casting.h"
 #include "klee/Support/OptionCategories.h"
 
+#include "llvm/ADT/StringExtras.h"
 #include "llvm/IR/Function.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/raw_ostream.h"
 
 #include <cassert>
 #include <iomanip>
+#include <iterator>
 #include <map>
 #include <set>
 #include <sstream>
 #include <stdarg.h>
+#include <unordered_map>
+#include <unordered_set>
 
 using namespace llvm;
 using namespace klee;
@@ -46,10 +52,45 @@ std::uint32_t ExecutionState::nextID = 1;
 
 /***/
 
+namespace {
+/// The register arrays of destroyed frames by their size, which the frames
+/// created later reuse instead of allocating. The cells are cleared before
+/// an array enters the pool.
+class LocalsPool {
+  static constexpr size_t maxPooledPerSize = 16;
+  std::vector<std::vector<Cell *>> free;
+
+public:
+  Cell *allocate(unsigned numRegisters) {
+    if (numRegisters < free.size() && !free[numRegisters].empty()) {
+      Cell *locals = free[numRegisters].back();
+      free[numRegisters].pop_back();
+      return locals;
+    }
+    return new Cell[numRegisters];
+  }
+
+  void release(Cell *locals, unsigned numRegisters) {
+    if (numRegisters >= free.size())
+      free.resize(numRegisters + 1);
+    if (free[numRegisters].size() >= maxPooledPerSize) {
+      delete[] locals;
+      return;
+    }
+    for (unsigned i = 0; i < numRegisters; ++i)
+      locals[i] = Cell();
+    free[numRegisters].push_back(locals);
+  }
+};
+
+// never destroyed, as frames may outlive the static objects at exit
+LocalsPool &localsPool = *new LocalsPool();
+} // namespace
+
 StackFrame::StackFrame(KInstIterator _caller, KFunction *_kf)
   : caller(_caller), kf(_kf), callPathNode(0), 
     minDistToUncoveredOnReturn(0), varargs(0) {
-  locals = new Cell[kf->numRegisters];
+  locals = localsPool.allocate(kf->numRegisters);
 }
 
 StackFrame::StackFrame(const StackFrame &s) 
@@ -58,20 +99,23 @@ StackFrame::StackFrame(const StackFrame &s)
     callPathNode(s.callPathNode),
     allocas(s.allocas),
     minDistToUncoveredOnReturn(s.minDistToUncoveredOnReturn),
-    varargs(s.varargs) {
-  locals = new Cell[s.kf->numRegisters];
+    varargs(s.varargs),
+    fingerprint(s.fingerprint) {
+  locals = localsPool.allocate(s.kf->numRegisters);
   for (unsigned i=0; i<s.kf->numRegisters; i++)
     locals[i] = s.locals[i];
 }
 
 StackFrame::~StackFrame() { 
-  delete[] locals; 
+  localsPool.release(locals, kf->numRegisters);
 }
 
 /***/
 
 ExecutionState::ExecutionState(KFunction *kf)
     : pc(kf->instructions), prevPC(pc) {
+  // without constraints, all zero is a model
+  constraints.setModel(std::make_shared<Assignment>());
   pushFrame(nullptr, kf);
   setID();
 }
@@ -86,10 +130,12 @@ ExecutionState::~ExecutionState() {
 
 ExecutionState::ExecutionState(const ExecutionState& state):
     nondetValues(state.nondetValues),
+    nondetFills(state.nondetFills),
     lastLoopHead(state.lastLoopHead),
     lastLoopHeadId(state.lastLoopHeadId),
     lastLoopCheck(state.lastLoopCheck),
     lastLoopFail(state.lastLoopFail),
+    loopHeadVisits(state.loopHeadVisits),
     pc(state.pc),
     prevPC(state.prevPC),
     stack(state.stack),
@@ -99,16 +145,31 @@ ExecutionState::ExecutionState(const ExecutionState& state):
     constraints(state.constraints),
     pathOS(state.pathOS),
     symPathOS(state.symPathOS),
+    forkChoices(state.forkChoices),
+    replayedChoices(state.replayedChoices),
     coveredLines(state.coveredLines),
     symbolics(state.symbolics),
+    replayedObjects(state.replayedObjects),
+    arrayReaders(state.arrayReaders),
     cexPreferences(state.cexPreferences),
     arrayNames(state.arrayNames),
+    resolutionCache(state.resolutionCache),
+    sizeBoundsCache(state.sizeBoundsCache),
+    uniqueValueCache(state.uniqueValueCache),
+    constraintRanges(state.constraintRanges),
     openMergeStack(state.openMergeStack),
     steppedInstructions(state.steppedInstructions),
     instsSinceCovNew(state.instsSinceCovNew),
     unwindingInformation(state.unwindingInformation
                              ? state.unwindingInformation->clone()
                              : nullptr),
+    threads(state.threads),
+    currentThread(state.currentThread),
+    sleepingThreads(state.sleepingThreads),
+    heldMutexes(state.heldMutexes),
+    sharedObjects(state.sharedObjects),
+    threadScheduled(state.threadScheduled),
+    inAtomicSection(state.inAtomicSection),
     coveredNew(state.coveredNew),
     forkDisabled(state.forkDisabled) {
   for (const auto &cur_mergehandler: openMergeStack)
@@ -121,13 +182,13 @@ ExecutionState *ExecutionState::branch() {
   auto *falseState = new ExecutionState(*this);
   falseState->setID();
   falseState->coveredNew = false;
-  falseState->coveredLines.clear();
+  falseState->coveredLines.reset();
 
   return falseState;
 }
 
 void ExecutionState::pushFrame(KInstIterator caller, KFunction *kf) {
-  stack.emplace_back(StackFrame(caller, kf));
+  stack.emplace_back(caller, kf);
 }
 
 void ExecutionState::popFrame() {
@@ -138,7 +199,7 @@ void ExecutionState::popFrame() {
 }
 
 void ExecutionState::removeAlloca(const MemoryObject *mo) {
-  StackFrame &sf = stack.back();
+  StackFrame &sf = stack.getWriteableBack();
   unsigned idx = 0;
   for (auto it = sf.allocas.begin(), ie = sf.allocas.end(); it != ie; ++it) {
     if (*it == mo) {
@@ -161,16 +222,218 @@ void ExecutionState::removeAlloca(const MemoryObject *mo) {
   }
 }
 
-ExecutionState::NondetValue&
-ExecutionState::addNondetValue(const KValue &kval, bool isSigned, const std::string& name) {
-    nondetValues.emplace_back(kval, isSigned, name);
-    return nondetValues.back();
+bool ThreadOperation::dependsOn(const ThreadOperation &b) const {
+  if (kind == Kind::Other || b.kind == Kind::Other)
+    return true;
+  if (kind == Kind::Start || b.kind == Kind::Start)
+    return false;
+  if (kind == Kind::Join || kind == Kind::Exit || b.kind == Kind::Join ||
+      b.kind == Kind::Exit)
+    return (kind == Kind::Join && isWrite) ||
+           (b.kind == Kind::Join && b.isWrite) ||
+           (((kind == Kind::Join && b.kind == Kind::Exit) ||
+             (kind == Kind::Exit && b.kind == Kind::Join)) &&
+            thread == b.thread);
+
+  // accesses and locks, where only writes may conflict
+  if (!isWrite && !b.isWrite)
+    return false;
+  const auto *segment = dyn_cast<ConstantExpr>(address.getSegment());
+  const auto *bSegment = dyn_cast<ConstantExpr>(b.address.getSegment());
+  if (!segment || !bSegment)
+    return true;
+  if (segment->getZExtValue() != bSegment->getZExtValue())
+    return false;
+  const auto *offset = dyn_cast<ConstantExpr>(address.getOffset());
+  const auto *bOffset = dyn_cast<ConstantExpr>(b.address.getOffset());
+  if (!offset || !bOffset)
+    return true;
+  uint64_t start = offset->getZExtValue(), bStart = bOffset->getZExtValue();
+  return start < bStart + b.bytes && bStart < start + bytes;
+}
+
+std::uint32_t ExecutionState::createThread(KFunction *kf) {
+  // the main thread gets its record with the first other one
+  if (threads.empty())
+    threads.emplace_back();
+  Thread thread;
+  thread.pc = kf->instructions;
+  thread.prevPC = thread.pc;
+  thread.stack.emplace_back(nullptr, kf);
+  thread.next.kind = ThreadOperation::Kind::Start;
+  threads.push_back(std::move(thread));
+  return threads.size() - 1;
+}
+
+void ExecutionState::switchThread(std::uint32_t id) {
+  if (id == currentThread)
+    return;
+  Thread &from = threads[currentThread];
+  from.pc = pc;
+  from.prevPC = prevPC;
+  from.stack = std::move(stack);
+  from.incomingBBIndex = incomingBBIndex;
+
+  Thread &to = threads[id];
+  pc = to.pc;
+  prevPC = to.prevPC;
+  stack = std::move(to.stack);
+  incomingBBIndex = to.incomingBBIndex;
+  currentThread = id;
+}
+
+bool ExecutionState::hasOtherThreads() const {
+  for (std::uint32_t id = 0; id < threads.size(); ++id)
+    if (id != currentThread && !threads[id].exited)
+      return true;
+  return false;
+}
+
+bool ExecutionState::isThreadEnabled(std::uint32_t id) const {
+  const ThreadOperation &next = threads[id].next;
+  switch (next.kind) {
+  case ThreadOperation::Kind::Lock: {
+    // the address was made unique when the operation was found
+    const auto *segment = dyn_cast<ConstantExpr>(next.address.getSegment());
+    const auto *offset = dyn_cast<ConstantExpr>(next.address.getOffset());
+    return !segment || !offset ||
+           !heldMutexes.count(
+               {segment->getZExtValue(), offset->getZExtValue()});
+  }
+  case ThreadOperation::Kind::Join:
+    // joining an unknown thread fails without blocking
+    return next.thread >= threads.size() || threads[next.thread].exited;
+  default:
+    return true;
+  }
+}
+
+const std::string &
+ExecutionState::NondetValue::internName(const std::string &name) {
+  static std::unordered_set<std::string> names;
+  return *names.insert(name).first;
+}
+
+bool ExecutionState::addArrayName(const std::string &name) {
+  if (arrayNames.count(name))
+    return false;
+  arrayNames = arrayNames.insert({name, 1});
+  return true;
+}
+
+std::string ExecutionState::getUniqueArrayName(const std::string &name) {
+  const auto *used = arrayNames.lookup(name);
+  if (!used) {
+    arrayNames = arrayNames.insert({name, 1});
+    return name;
+  }
+  // a name of this form may have been used as it is
+  unsigned id = used->second;
+  std::string uniqueName = name + "_" + llvm::utostr(id);
+  while (arrayNames.count(uniqueName))
+    uniqueName = name + "_" + llvm::utostr(++id);
+  arrayNames = arrayNames.replace({name, id + 1}).insert({uniqueName, 1});
+  return uniqueName;
+}
+
+ObjectPair ExecutionState::lookupResolution(const KInstruction *ki,
+                                            const KValue &address,
+                                            unsigned bytes) const {
+  const auto *res = resolutionCache.lookup(
+      {ki, bytes, address.getSegment(), address.getOffset()});
+  if (!res)
+    return ObjectPair(nullptr, nullptr);
+  // the segment may have been freed and given to another object since
+  ObjectPair op;
+  if (!addressSpace.findSegment(res->second.first, op) ||
+      op.first->id != res->second.second)
+    return ObjectPair(nullptr, nullptr);
+  return op;
+}
+
+void ExecutionState::cacheResolution(const KInstruction *ki,
+                                     const KValue &address, unsigned bytes,
+                                     const MemoryObject *mo) {
+  resolutionCache = resolutionCache.replace(
+      {{ki, bytes, address.getSegment(), address.getOffset()},
+       {mo->segment, mo->id}});
+}
+
+llvm::Optional<bool> ExecutionState::lookupSizeBounds(const MemoryObject *mo,
+                                                      unsigned bytes,
+                                                      uint64_t offset) const {
+  const auto *res = sizeBoundsCache.lookup({mo->id, bytes});
+  if (!res)
+    return llvm::None;
+  // the check is monotonic in the offset and constraints only grow, but a
+  // check that failed may succeed under additional constraints
+  const SizeBounds &bounds = res->second;
+  if (bounds.hasInBounds && offset <= bounds.inBounds)
+    return true;
+  if (bounds.hasMayBeOut && offset >= bounds.mayBeOut &&
+      bounds.outdatedAt == constraints.size())
+    return false;
+  return llvm::None;
+}
+
+void ExecutionState::cacheSizeBounds(const MemoryObject *mo, unsigned bytes,
+                                     uint64_t offset, bool inBounds) {
+  SizeBounds bounds;
+  if (const auto *res = sizeBoundsCache.lookup({mo->id, bytes}))
+    bounds = res->second;
+  if (inBounds) {
+    if (!bounds.hasInBounds || offset > bounds.inBounds)
+      bounds.inBounds = offset;
+    bounds.hasInBounds = true;
+  } else {
+    if (!bounds.hasMayBeOut || bounds.outdatedAt != constraints.size() ||
+        offset < bounds.mayBeOut)
+      bounds.mayBeOut = offset;
+    bounds.hasMayBeOut = true;
+    bounds.outdatedAt = constraints.size();
+  }
+  sizeBoundsCache = sizeBoundsCache.replace({{mo->id, bytes}, bounds});
+}
+
+llvm::Optional<ref<ConstantExpr>>
+ExecutionState::lookupUniqueValue(const ref<Expr> &e) const {
+  const auto *res = uniqueValueCache.lookup(e);
+  if (!res)
+    return llvm::None;
+  // a unique value stays unique as constraints only grow, but an expression
+  // with several values may be pinned down by additional constraints
+  const UniqueValue &unique = res->second;
+  if (unique.value.isNull() && unique.outdatedAt != constraints.size())
+    return llvm::None;
+  return unique.value;
+}
+
+void ExecutionState::cacheUniqueValue(const ref<Expr> &e,
+                                      const ref<ConstantExpr> &value) const {
+  UniqueValue unique;
+  unique.value = value;
+  unique.outdatedAt = constraints.size();
+  uniqueValueCache = uniqueValueCache.replace({e, unique});
+}
+
+const ExecutionState::NondetValue &
+ExecutionState::addNondetValue(const KValue &kval, bool isSigned,
+                               KInstruction *ki, const std::string &name) {
+  return nondetValues.emplace_back(kval, isSigned, ki, name);
 }
 
 void ExecutionState::addSymbolic(const MemoryObject *mo, const Array *array) {
   symbolics.emplace_back(ref<const MemoryObject>(mo), array);
 }
 
+void ExecutionState::addArrayReader(const Array *array,
+                                    const MemoryObject *mo) {
+  if (arrayReaders.count({array, mo}))
+    return;
+  // the reference keeps the key alive after the object is freed
+  arrayReaders = arrayReaders.insert({{array, mo}, ref<const MemoryObject>(mo)});
+}
+
 /**/
 
 llvm::raw_ostream &klee::operator<<(llvm::raw_ostream &os, const MemoryMap &mm) {
@@ -186,10 +449,43 @@ llvm::raw_ostream &klee::operator<<(llvm::raw_ostream &os, const MemoryMap &mm)
   return os;
 }
 
+namespace {
+/// The selects between the values of the two merged states, built once for
+/// each pair of values. The registers and memory words that hold the same
+/// pair thus share a select, which keeps the merged expressions small.
+class MergeSelects {
+  struct PairHash {
+    size_t operator()(const std::pair<ref<Expr>, ref<Expr>> &p) const {
+      return p.first->hash() * Expr::MAGIC_HASH_CONSTANT + p.second->hash();
+    }
+  };
+  ref<Expr> inA;
+  std::unordered_map<std::pair<ref<Expr>, ref<Expr>>, ref<Expr>, PairHash>
+      cache;
+
+public:
+  explicit MergeSelects(ref<Expr> inA) : inA(std::move(inA)) {}
+
+  ref<Expr> get(const ref<Expr> &a, const ref<Expr> &b) {
+    if (a == b)
+      return a;
+    auto it = cache.emplace(std::make_pair(a, b), ref<Expr>());
+    if (it.second)
+      it.first->second = SelectExpr::create(inA, a, b);
+    return it.first->second;
+  }
+
+  KValue get(const KValue &a, const KValue &b) {
+    return KValue(get(a.getSegment(), b.getSegment()), get(a.value, b.value));
+  }
+};
+} // namespace
+
 bool ExecutionState::merge(const ExecutionState &b) {
   if (DebugLogStateMerge)
     llvm::errs() << "-- attempting merge of A:" << this << " with B:" << &b
                  << "--\n";
+  ++stats::mergeAttempts;
   if (pc != b.pc)
     return false;
 
@@ -199,9 +495,18 @@ bool ExecutionState::merge(const ExecutionState &b) {
   if (symbolics != b.symbolics)
     return false;
 
+  // the scheduling of the threads is not merged
+  if (!threads.empty() || !b.threads.empty())
+    return false;
+
+  // the merged state could only report the nondeterministic values of one
+  // of the paths
+  if (nondetValues != b.nondetValues)
+    return false;
+
   {
-    std::vector<StackFrame>::const_iterator itA = stack.begin();
-    std::vector<StackFrame>::const_iterator itB = b.stack.begin();
+    stack_ty::const_iterator itA = stack.begin();
+    stack_ty::const_iterator itB = b.stack.begin();
     while (itA!=stack.end() && itB!=b.stack.end()) {
       // XXX vaargs?
       if (itA->caller!=itB->caller || itA->kf!=itB->kf)
@@ -213,37 +518,36 @@ bool ExecutionState::merge(const ExecutionState &b) {
       return false;
   }
 
-  std::set< ref<Expr> > aConstraints(constraints.begin(), constraints.end());
-  std::set< ref<Expr> > bConstraints(b.constraints.begin(), 
-                                     b.constraints.end());
-  std::set< ref<Expr> > commonConstraints, aSuffix, bSuffix;
+  // the constraints of the state they forked from are a common prefix, which
+  // is found without comparing them; only the rest is compared as sets
+  std::vector<ref<Expr>> commonConstraints;
+  auto ca = constraints.begin(), cae = constraints.end();
+  auto cb = b.constraints.begin(), cbe = b.constraints.end();
+  for (; ca != cae && cb != cbe && (*ca).get() == (*cb).get(); ++ca, ++cb)
+    commonConstraints.push_back(*ca);
+  std::set<ref<Expr>> aConstraints(ca, cae), bConstraints(cb, cbe);
+  std::set<ref<Expr>> aSuffix, bSuffix;
   std::set_intersection(aConstraints.begin(), aConstraints.end(),
                         bConstraints.begin(), bConstraints.end(),
-                        std::inserter(commonConstraints, commonConstraints.begin()));
+                        std::back_inserter(commonConstraints));
   std::set_difference(aConstraints.begin(), aConstraints.end(),
-                      commonConstraints.begin(), commonConstraints.end(),
+                      bConstraints.begin(), bConstraints.end(),
                       std::inserter(aSuffix, aSuffix.end()));
   std::set_difference(bConstraints.begin(), bConstraints.end(),
-                      commonConstraints.begin(), commonConstraints.end(),
+                      aConstraints.begin(), aConstraints.end(),
                       std::inserter(bSuffix, bSuffix.end()));
   if (DebugLogStateMerge) {
     llvm::errs() << "\tconstraint prefix: [";
-    for (std::set<ref<Expr> >::iterator it = commonConstraints.begin(),
-                                        ie = commonConstraints.end();
-         it != ie; ++it)
-      llvm::errs() << *it << ", ";
+    for (const auto &constraint : commonConstraints)
+      llvm::errs() << constraint << ", ";
     llvm::errs() << "]\n";
     llvm::errs() << "\tA suffix: [";
-    for (std::set<ref<Expr> >::iterator it = aSuffix.begin(),
-                                        ie = aSuffix.end();
-         it != ie; ++it)
-      llvm::errs() << *it << ", ";
+    for (const auto &constraint : aSuffix)
+      llvm::errs() << constraint << ", ";
     llvm::errs() << "]\n";
     llvm::errs() << "\tB suffix: [";
-    for (std::set<ref<Expr> >::iterator it = bSuffix.begin(),
-                                        ie = bSuffix.end();
-         it != ie; ++it)
-      llvm::errs() << *it << ", ";
+    for (const auto &constraint : bSuffix)
+      llvm::errs() << constraint << ", ";
     llvm::errs() << "]\n";
   }
 
@@ -278,7 +582,10 @@ bool ExecutionState::merge(const ExecutionState &b) {
       }
       return false;
     }
-    if (ai->second.get() != bi->second.get()) {
+    // copies that share their planes with a common ancestor hold the same
+    // contents even though they are different object states
+    if (ai->second.get() != bi->second.get() &&
+        !ai->second->sharesContentsWith(*bi->second)) {
       if (DebugLogStateMerge)
         llvm::errs() << "\t\tmutated: " << ai->first->id << "\n";
       mutated.insert(ai->first);
@@ -301,30 +608,31 @@ bool ExecutionState::merge(const ExecutionState &b) {
 
   ref<Expr> inA = ConstantExpr::alloc(1, Expr::Bool);
   ref<Expr> inB = ConstantExpr::alloc(1, Expr::Bool);
-  for (std::set< ref<Expr> >::iterator it = aSuffix.begin(), 
-         ie = aSuffix.end(); it != ie; ++it)
-    inA = AndExpr::create(inA, *it);
-  for (std::set< ref<Expr> >::iterator it = bSuffix.begin(), 
-         ie = bSuffix.end(); it != ie; ++it)
-    inB = AndExpr::create(inB, *it);
+  for (const auto &constraint : aSuffix)
+    inA = AndExpr::create(inA, constraint);
+  for (const auto &constraint : bSuffix)
+    inB = AndExpr::create(inB, constraint);
+  MergeSelects selects(inA);
 
   // XXX should we have a preference as to which predicate to use?
   // it seems like it can make a difference, even though logically
   // they must contradict each other and so inA => !inB
 
-  std::vector<StackFrame>::iterator itA = stack.begin();
-  std::vector<StackFrame>::const_iterator itB = b.stack.begin();
-  for (; itA!=stack.end(); ++itA, ++itB) {
-    StackFrame &af = *itA;
-    const StackFrame &bf = *itB;
+  for (unsigned frame = 0; frame < stack.size(); ++frame) {
+    StackFrame &af = stack.getWriteable(frame);
+    const StackFrame &bf = b.stack[frame];
     for (unsigned i=0; i<af.kf->numRegisters; i++) {
-      ref<Expr> &av = af.locals[i].value;
-      const ref<Expr> &bv = bf.locals[i].value;
-      if (!av || !bv) {
+      Cell &av = af.locals[i];
+      const Cell &bv = bf.locals[i];
+      if (!av.value || !bv.value) {
         // if one is null then by implication (we are at same pc)
         // we cannot reuse this local, so just ignore
       } else {
-        av = SelectExpr::create(inA, av, bv);
+        if (trackFingerprints())
+          af.fingerprint ^= getRegisterFingerprint(i, av);
+        av = selects.get(av, bv);
+        if (trackFingerprints())
+          af.fingerprint ^= getRegisterFingerprint(i, av);
       }
     }
   }
@@ -339,24 +647,84 @@ bool ExecutionState::merge(const ExecutionState &b) {
     assert(otherOS);
 
     ObjectState *wos = addressSpace.getWriteable(mo, os);
-    for (unsigned i = 0; i < cast<ConstantExpr>(mo->size)->getZExtValue(); i++) {
-      KValue av = wos->read8(i);
-      KValue bv = otherOS->read8(i);
-      wos->write(i, KValue(SelectExpr::create(inA, av.getSegment(), bv.getSegment()),
-                           SelectExpr::create(inA, av.getOffset(), bv.getOffset())));
+    // a word at a time, so that a differing word gets one select rather
+    // than one per byte
+    unsigned size = cast<ConstantExpr>(mo->size)->getZExtValue();
+    for (unsigned offset = 0; offset < size;) {
+      Expr::Width width = size - offset >= 8 ? Expr::Int64 : Expr::Int8;
+      KValue av = wos->read(offset, width);
+      KValue bv = otherOS->read(offset, width);
+      if (av.value != bv.value || av.getSegment() != bv.getSegment())
+        wos->write(offset, selects.get(av, bv));
+      offset += width / 8;
     }
   }
 
+  bool tracksIndependence = constraints.tracksIndependence();
+  // a model of this state also satisfies the weaker merged constraints
+  std::shared_ptr<const Assignment> model = constraints.getModel();
   constraints = ConstraintSet();
+  if (tracksIndependence)
+    constraints.trackIndependence();
+  constraints.setModel(std::move(model));
+  // the merged constraints are weaker than those of this state
+  resolutionCache = ResolutionCache();
+  sizeBoundsCache = SizeBoundsCache();
+  uniqueValueCache = UniqueValueCache();
+  constraintRanges = ConstraintRanges();
 
   ConstraintManager m(constraints);
-  for (const auto &constraint : commonConstraints)
+  for (const auto &constraint : commonConstraints) {
     m.addConstraint(constraint);
+    constraintRanges.learn(constraint);
+  }
   m.addConstraint(OrExpr::create(inA, inB));
 
+  ++stats::mergedStates;
+  queryMetaData.fromMerge = true;
   return true;
 }
 
+uint64_t ExecutionState::getFingerprint() const {
+  uint64_t res = combineFingerprints(reinterpret_cast<uintptr_t>(pc->inst),
+                                     incomingBBIndex);
+  for (const StackFrame &sf : stack) {
+    res = combineFingerprints(res, reinterpret_cast<uintptr_t>(sf.kf));
+    if (sf.caller)
+      res = combineFingerprints(res,
+                                reinterpret_cast<uintptr_t>(sf.caller->inst));
+    res = combineFingerprints(res, sf.fingerprint);
+    if (sf.varargs)
+      res = combineFingerprints(res, sf.varargs->id);
+  }
+  for (std::uint32_t id = 0; id < threads.size(); ++id) {
+    const Thread &thread = threads[id];
+    if (id == currentThread || thread.exited)
+      continue;
+    res = combineFingerprints(res,
+                              reinterpret_cast<uintptr_t>(thread.pc->inst));
+    for (const StackFrame &sf : thread.stack)
+      res = combineFingerprints(res, sf.fingerprint);
+  }
+  res = combineFingerprints(res, addressSpace.getFingerprint());
+  return combineFingerprints(
+      res, (uint64_t(constraints.size()) << 32) | constraints.hash());
+}
+
+size_t ExecutionState::getMemoryFootprint() const {
+  size_t res = sizeof(*this) + addressSpace.getFootprint() +
+               constraints.size() * sizeof(ref<Expr>);
+  auto addStack = [&res](const CallStack &stack) {
+    for (const StackFrame &sf : stack)
+      res += sizeof(sf) + sf.kf->numRegisters * sizeof(Cell) +
+             sf.allocas.size() * sizeof(sf.allocas[0]);
+  };
+  addStack(stack);
+  for (const Thread &thread : threads)
+    addStack(thread.stack);
+  return res;
+}
+
 void ExecutionState::dumpStack(llvm::raw_ostream &out) const {
   unsigned idx = 0;
   const KInstruction *target = prevPC;
@@ -398,6 +766,12 @@ void ExecutionState::dumpStack(llvm::raw_ostream &out) const {
 void ExecutionState::addConstraint(ref<Expr> e) {
   ConstraintManager c(constraints);
   c.addConstraint(e);
+  constraintRanges.learn(e);
+  // equalities with a constant are canonicalised to have it on the left
+  if (const auto *eq = dyn_cast<EqExpr>(e))
+    if (auto value = dyn_cast<ConstantExpr>(eq->left))
+      if (!isa<ConstantExpr>(eq->right))
+        cacheUniqueValue(eq->right, value);
 }
 
 void ExecutionState::addCexPreference(const ref<Expr> &cond) {
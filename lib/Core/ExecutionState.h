@@ -13,20 +13,31 @@
 #include "AddressSpace.h"
 #include "MergeHandler.h"
 
+#include "klee/ADT/ImmutableList.h"
+#include "klee/ADT/ImmutableMap.h"
 #include "klee/ADT/ImmutableSet.h"
 #include "klee/ADT/TreeStream.h"
 #include "klee/Core/ConcreteValue.h"
+#include "klee/Expr/Assignment.h"
+#include "klee/Expr/ConstraintRanges.h"
 #include "klee/Expr/Constraints.h"
 #include "klee/Expr/Expr.h"
 #include "klee/Module/KInstIterator.h"
 #include "klee/Solver/Solver.h"
 #include "klee/System/Time.h"
 
+#include "llvm/ADT/Optional.h"
+#include "llvm/ADT/iterator.h"
+
 #include <map>
 #include <memory>
 #include <set>
 #include <vector>
 
+namespace llvm {
+class Function;
+}
+
 namespace klee {
 class Array;
 class CallPathNode;
@@ -39,6 +50,58 @@ struct InstructionInfo;
 
 llvm::raw_ostream &operator<<(llvm::raw_ostream &os, const MemoryMap &mm);
 
+/// A symbolic memory access: the instruction, its size in bytes and the
+/// address it accesses.
+struct ResolutionCacheKey {
+  const KInstruction *ki;
+  unsigned bytes;
+  ref<Expr> segment;
+  ref<Expr> offset;
+
+  bool operator<(const ResolutionCacheKey &b) const {
+    if (ki != b.ki)
+      return ki < b.ki;
+    if (bytes != b.bytes)
+      return bytes < b.bytes;
+    if (int c = segment->compare(*b.segment))
+      return c < 0;
+    return offset->compare(*b.offset) < 0;
+  }
+};
+
+/// Maps accesses to the segment and id of the object they were proven to
+/// be in bounds of.
+typedef ImmutableMap<ResolutionCacheKey, std::pair<uint64_t, unsigned>>
+    ResolutionCache;
+
+/// What is known about the accesses of a given size at constant offsets into
+/// an object of symbolic size.
+struct SizeBounds {
+  /// Accesses at offsets up to inBounds were proven to be in bounds.
+  bool hasInBounds = false;
+  uint64_t inBounds = 0;
+  /// Accesses at offsets from mayBeOut on were not provably in bounds while
+  /// the constraints had outdatedAt elements, later ones may prove them.
+  bool hasMayBeOut = false;
+  uint64_t mayBeOut = 0;
+  size_t outdatedAt = 0;
+};
+
+/// Maps object ids and access sizes to their known bounds.
+typedef ImmutableMap<std::pair<unsigned, unsigned>, SizeBounds>
+    SizeBoundsCache;
+
+/// Whether an expression has a single value under the constraints.
+struct UniqueValue {
+  /// The value of the expression, null if it was found to have several while
+  /// the constraints had outdatedAt elements, later ones may make it unique.
+  ref<ConstantExpr> value;
+  size_t outdatedAt = 0;
+};
+
+/// Maps expressions to what is known about their uniqueness.
+typedef ImmutableMap<ref<Expr>, UniqueValue> UniqueValueCache;
+
 struct StackFrame {
   KInstIterator caller;
   KFunction *kf;
@@ -51,8 +114,8 @@ struct StackFrame {
   /// returns. This is not a good place for this but is used to
   /// quickly compute the context sensitive minimum distance to an
   /// uncovered instruction. This value is updated by the StatsTracker
-  /// periodically.
-  unsigned minDistToUncoveredOnReturn;
+  /// periodically, also in frames shared between states (see CallStack).
+  mutable unsigned minDistToUncoveredOnReturn;
 
   // For vararg functions: arguments not passed via parameter are
   // stored (packed tightly) in a local (alloca) memory object. This
@@ -61,39 +124,135 @@ struct StackFrame {
   // of intrinsic lowering.
   MemoryObject *varargs;
 
+  /// The xor of the fingerprints of the registers, kept up to date while
+  /// fingerprints are tracked (see StateFingerprint.h)
+  uint64_t fingerprint = 0;
+
   StackFrame(KInstIterator caller, KFunction *kf);
   StackFrame(const StackFrame &s);
   ~StackFrame();
 };
 
+/// The stack frames of a state. They are shared between the states forked
+/// from each other and a frame is only copied once one of them modifies it,
+/// so a fork does not copy the registers of every frame.
+class CallStack {
+  using frames_ty = std::vector<std::shared_ptr<StackFrame>>;
+  frames_ty frames;
+
+public:
+  class const_iterator
+      : public llvm::iterator_adaptor_base<
+            const_iterator, frames_ty::const_iterator,
+            std::random_access_iterator_tag, const StackFrame> {
+  public:
+    const_iterator() = default;
+    explicit const_iterator(frames_ty::const_iterator it)
+        : iterator_adaptor_base(it) {}
+    const StackFrame &operator*() const { return **I; }
+    const StackFrame *operator->() const { return I->get(); }
+  };
+  using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+  bool empty() const { return frames.empty(); }
+  size_t size() const { return frames.size(); }
+
+  const_iterator begin() const { return const_iterator(frames.begin()); }
+  const_iterator end() const { return const_iterator(frames.end()); }
+  const_reverse_iterator rbegin() const {
+    return const_reverse_iterator(end());
+  }
+  const_reverse_iterator rend() const {
+    return const_reverse_iterator(begin());
+  }
+
+  const StackFrame &operator[](size_t index) const { return *frames[index]; }
+  const StackFrame &back() const { return *frames.back(); }
+
+  /// The frame at index, copied first if it is shared with another state.
+  StackFrame &getWriteable(size_t index) {
+    std::shared_ptr<StackFrame> &frame = frames[index];
+    if (frame.use_count() > 1)
+      frame = std::make_shared<StackFrame>(*frame);
+    return *frame;
+  }
+  StackFrame &getWriteableBack() { return getWriteable(frames.size() - 1); }
+
+  void emplace_back(KInstIterator caller, KFunction *kf) {
+    frames.push_back(std::make_shared<StackFrame>(caller, kf));
+  }
+  void pop_back() { frames.pop_back(); }
+};
+
+/// The address of a mutex: its segment and offset.
+using MutexAddress = std::pair<std::uint64_t, std::uint64_t>;
+
+/// An operation of a thread that the other threads may observe. Threads are
+/// only switched before these, and of two operations that commute only one
+/// order is explored (see Executor::scheduleThreads).
+struct ThreadOperation {
+  enum class Kind {
+    /// The thread did not run yet, its first instructions are its own
+    Start,
+    /// An access of memory, the mutex functions write their mutex
+    Access,
+    /// Locking the mutex at the address, blocked while it is held
+    Lock,
+    /// Joining a thread, blocked until it exited. Storing its exit value
+    /// (isWrite) does not commute with any operation.
+    Join,
+    /// The exit of a thread, which only matters to the threads joining it
+    Exit,
+    /// Anything else, which does not commute with any operation
+    Other
+  };
+  Kind kind = Kind::Other;
+  /// The address accessed, with the number of bytes
+  KValue address;
+  unsigned bytes = 0;
+  bool isWrite = false;
+  /// The thread joined or exiting
+  std::uint32_t thread = 0;
+
+  /// Whether the order of this operation and b may matter.
+  bool dependsOn(const ThreadOperation &b) const;
+};
+
+/// A thread of a state. The running thread keeps its program counter and
+/// stack in the state, those of its record are only valid while it waits.
+struct Thread {
+  KInstIterator pc;
+  KInstIterator prevPC;
+  CallStack stack;
+  std::uint32_t incomingBBIndex = 0;
+  /// The operation the thread waits to execute
+  ThreadOperation next;
+  bool exited = false;
+  /// The value passed to pthread_exit or returned by the start routine
+  KValue exitValue;
+};
+
 /// Shared pointer with copy-on-write support
 template <typename T>
 class cow_shared_ptr {
   std::shared_ptr<T> ptr{nullptr};
-  // am I the owner of the copy?
-  bool owner{false};
 
 public:
   cow_shared_ptr() = default;
   cow_shared_ptr(T *p) : ptr(p) {}
-  cow_shared_ptr(cow_shared_ptr&&) = delete;
-  cow_shared_ptr(const cow_shared_ptr& rhs)
-      : ptr(rhs.ptr), owner(false) {}
 
   const T *get() const { return ptr.get(); }
 
   T *getWriteable() {
-    if (owner)
-      return ptr.get();
-    // create a copy of the object and claim the ownership
-    if (ptr) {
-      ptr.reset(new T(*get()));
-    } else {
-      ptr.reset(new T());
-    }
-    owner = true;
+    // create a copy of the object unless we are its only user
+    if (!ptr)
+      ptr = std::make_shared<T>();
+    else if (ptr.use_count() > 1)
+      ptr = std::make_shared<T>(*ptr);
     return ptr.get();
   }
+
+  void reset() { ptr.reset(); }
 };
 
 /// Contains information related to unwinding (Itanium ABI/2-Phase unwinding)
@@ -185,37 +344,43 @@ private:
   ExecutionState(const ExecutionState &state);
 
 public:
-  using stack_ty = std::vector<StackFrame>;
+  using stack_ty = CallStack;
 
   // Execution - Control Flow specific
 
   struct NondetValue {
     KValue value;
     // info about name and where the object was created...
-    NondetValue() = default;
-
-    NondetValue(ref<Expr> e, const std::string& n) : value(e), name(n) {}
-    NondetValue(const KValue& val, const std::string& n) : value(val), name(n) {}
+    NondetValue(ref<Expr> e, const std::string& n) : value(e), name(internName(n)) {}
+    NondetValue(const KValue& val, const std::string& n) : value(val), name(internName(n)) {}
 
     NondetValue(const ref<Expr> &e, KInstruction *ki, const std::string& n)
-        : value(e), kinstruction(ki), name(n) {}
+        : value(e), kinstruction(ki), name(internName(n)) {}
     NondetValue(const KValue& val, KInstruction *ki, const std::string& n)
-        : value(val), kinstruction(ki), name(n) {}
+        : value(val), kinstruction(ki), name(internName(n)) {}
 
     NondetValue(const ref<Expr> &e, bool sgned, const std::string& n)
-        : value(e), isSigned(sgned), name(n) {}
+        : value(e), isSigned(sgned), name(internName(n)) {}
     NondetValue(const KValue& val, bool sgned, const std::string& n)
-        : value(val), isSigned(sgned), name(n) {}
+        : value(val), isSigned(sgned), name(internName(n)) {}
 
     NondetValue(const ref<Expr> &e, bool sgned, KInstruction *ki,
                 const std::string& n)
-        : value(e), isSigned(sgned), kinstruction(ki), name(n) {}
+        : value(e), isSigned(sgned), kinstruction(ki), name(internName(n)) {}
     NondetValue(const KValue& val, bool sgned, KInstruction *ki, const std::string& n)
-        : value(val), isSigned(sgned), kinstruction(ki), name(n) {}
+        : value(val), isSigned(sgned), kinstruction(ki), name(internName(n)) {}
 
     bool isSigned{false};
     KInstruction *kinstruction{nullptr};
-    const std::string name{};
+    // interned, the same few names are used by many values
+    const std::string &name;
+
+    bool operator==(const NondetValue &b) const {
+      return value.value == b.value.value &&
+             value.getSegment() == b.value.getSegment() &&
+             isSigned == b.isSigned && kinstruction == b.kinstruction &&
+             &name == &b.name;
+    }
     // when an instruction that creates a nondet value is called
     // several times, we can assign a sequential number to each
     // of the values here
@@ -225,16 +390,40 @@ public:
     //MaybeConcreteValue concreteValue;
     //
     //bool hasConcreteValue() const { return concreteValue.hasValue(); }
+
+  private:
+    static const std::string &internName(const std::string &name);
   };
 
-  // FIXME: wouldn't unique_ptr be more efficient (no ref<> copying)
-  std::vector<NondetValue> nondetValues;
+  // shared with the states forked from this one
+  ImmutableList<NondetValue> nondetValues;
+
+  /// The buffer a nondet call site of --batch-nondet-fills fills, see
+  /// Executor::noteNondetFill.
+  struct NondetFill {
+    /// Where the next value is expected to be stored
+    uint64_t segment = 0;
+    uint64_t offset = 0;
+    /// The elements of the buffer after the one stored last
+    uint64_t left = 0;
+    /// Whether the last value was stored right after the one before it
+    bool sequential = false;
+    /// The array the values of the elements are read from, once sequential
+    const Array *array = nullptr;
+    /// The element of the array read next
+    uint64_t next = 0;
+  };
+  /// The buffers being filled, by nondet call
+  std::map<const llvm::Instruction *, NondetFill> nondetFills;
   // FIXME: this is a hack to be able to generate termination witnesses for SV-COMP
   llvm::Instruction *lastLoopHead{nullptr};
   size_t lastLoopHeadId{0};
   // so that we do not need to unwind the stack
   llvm::Instruction *lastLoopCheck{nullptr};
   llvm::Instruction *lastLoopFail{nullptr};
+  /// The fingerprints of the state at the loop heads it went through, with
+  /// the number of nondet values at the time (see --revisited-loop-heads)
+  ImmutableMap<uint64_t, size_t> loopHeadVisits;
 
   /// @brief Pointer to instruction to be executed after the current
   /// instruction
@@ -274,24 +463,77 @@ public:
   /// taken to reach/create this state
   TreeOStream symPathOS;
 
+  /// @brief The side taken at each fork with several feasible sides, only
+  /// recorded with --prefix-workers to hand the state to another worker,
+  /// and with --state-swap to rebuild the state later
+  std::vector<std::uint32_t> forkChoices;
+
+  /// @brief The sides this state takes at its forks instead of forking,
+  /// until forkChoices caught up with them: the prefix of a worker of
+  /// --prefix-workers, or the choices of a state rebuilt by --state-swap
+  std::shared_ptr<const std::vector<std::uint32_t>> replayedChoices;
+
   /// @brief Set containing which lines in which files are covered by this state
-  std::map<const std::string *, std::set<std::uint32_t>> coveredLines;
+  using covered_lines_ty = std::map<const std::string *, std::set<std::uint32_t>>;
+  cow_shared_ptr<covered_lines_ty> coveredLines;
 
   /// @brief Pointer to the process tree of the current state
   /// Copies of ExecutionState should not copy ptreeNode
   PTreeNode *ptreeNode = nullptr;
 
   /// @brief Ordered list of symbolics: used to generate test cases.
-  //
-  // FIXME: Move to a shared list structure (not critical).
-  std::vector<std::pair<ref<const MemoryObject>, const Array *>> symbolics;
+  ImmutableList<std::pair<ref<const MemoryObject>, const Array *>> symbolics;
+
+  /// @brief The objects of klee_make_symbolic given their values by a
+  /// concrete replay, in order: written to test cases with the symbolics.
+  ImmutableList<std::pair<std::string, std::vector<unsigned char>>>
+      replayedObjects;
+
+  /// The objects that may hold reads of each array, whose reads are
+  /// replaced when their value becomes implied. Only kept with
+  /// --implied-value-concretization.
+  /// The entries of an array are adjacent, those of its objects ordered by
+  /// MemoryObjectLT after a null object.
+  struct ArrayReaderLT {
+    bool operator()(const std::pair<const Array *, const MemoryObject *> &a,
+                    const std::pair<const Array *, const MemoryObject *> &b)
+        const {
+      if (a.first != b.first)
+        return a.first < b.first;
+      if (!a.second || !b.second)
+        return !a.second && b.second;
+      return MemoryObjectLT()(a.second, b.second);
+    }
+  };
+  ImmutableMap<std::pair<const Array *, const MemoryObject *>,
+               ref<const MemoryObject>, ArrayReaderLT>
+      arrayReaders;
 
   /// @brief A set of boolean expressions
   /// the user has requested be true of a counterexample.
   ImmutableSet<ref<Expr>> cexPreferences;
 
-  /// @brief Set of used array names for this state.  Used to avoid collisions.
-  std::set<std::string> arrayNames;
+  /// @brief The array names used in this state, each with the number of
+  /// arrays named after it so far. Used to avoid collisions.
+  ImmutableMap<std::string, unsigned> arrayNames;
+
+  /// @brief Symbolic accesses proven to be in bounds of a single object.
+  /// As constraints only grow, an entry stays valid for as long as the object
+  /// is bound.
+  ResolutionCache resolutionCache;
+
+  /// @brief Bounds checks of objects of symbolic size decided so far, see
+  /// lookupSizeBounds.
+  SizeBoundsCache sizeBoundsCache;
+
+  /// @brief Expressions checked for a unique value so far, see
+  /// lookupUniqueValue. Filled by Executor::toUnique, which only reads the
+  /// state otherwise, and by the equalities added as constraints.
+  mutable UniqueValueCache uniqueValueCache;
+
+  /// @brief Bounds of terms learned from the constraints, which decide some
+  /// conditions without a query.
+  ConstraintRanges constraintRanges;
 
   /// @brief The objects handling the klee_open_merge calls this state ran through
   std::vector<ref<MergeHandler>> openMergeStack;
@@ -299,6 +541,34 @@ public:
   /// @brief The numbers of times this state has run through Executor::stepInstruction
   std::uint64_t steppedInstructions = 0;
 
+  /// @brief A conditional branch whose condition is solved by another
+  /// process while the state is parked, see AsyncBranchQueries
+  struct PendingBranch {
+    KInstruction *ki;
+    ref<Expr> condition;
+    /// Whether the answer arrived, it is stored in the fields below
+    bool answered = false;
+    bool success = false;
+    Solver::Validity validity = Solver::Unknown;
+  };
+  /// Not copied to forked states
+  std::unique_ptr<PendingBranch> pendingBranch;
+
+  /// @brief A call of a memoizable function whose result is recorded once
+  /// it returns, see --memoize-calls
+  struct PendingMemo {
+    /// The size of the stack in the callee
+    std::size_t stackSize;
+    /// The size and hash of the constraints at the call, the result is
+    /// only recorded if the callee did not change them
+    std::size_t constraints;
+    unsigned constraintsHash;
+    const llvm::Function *function;
+    std::vector<std::uint64_t> key;
+  };
+  /// Not copied to forked states, the innermost call last
+  std::vector<PendingMemo> pendingMemos;
+
   /// @brief Counts how many instructions were executed since the last new
   /// instruction was covered.
   std::uint32_t instsSinceCovNew = 0;
@@ -306,6 +576,32 @@ public:
   /// @brief Keep track of unwinding state while unwinding, otherwise empty
   std::unique_ptr<UnwindingInformation> unwindingInformation;
 
+  /// @brief The threads of the state by their ids, empty until the program
+  /// creates one. The main thread has id 0.
+  std::vector<Thread> threads;
+  std::uint32_t currentThread = 0;
+
+  /// @brief The threads not to run at the next scheduling point, as their
+  /// next operation commutes with those run since another state ran it
+  /// first (the sleep set of the partial-order reduction)
+  ImmutableSet<std::uint32_t> sleepingThreads;
+
+  /// @brief The mutexes held, with the threads holding them
+  ImmutableMap<MutexAddress, std::uint32_t> heldMutexes;
+
+  /// @brief The ids of the stack objects handed to another thread or
+  /// reachable from an object other threads may access, whose accesses are
+  /// observable like those of other objects
+  ImmutableSet<unsigned> sharedObjects;
+
+  /// @brief Whether the running thread was chosen to execute the operation
+  /// at pc at the last scheduling point
+  bool threadScheduled = false;
+
+  /// @brief Whether the running thread is between __VERIFIER_atomic_begin
+  /// and __VERIFIER_atomic_end, where the threads are not switched
+  bool inAtomicSection = false;
+
   /// @brief the global state counter
   static std::uint32_t nextID;
 
@@ -336,11 +632,30 @@ public:
 
   ExecutionState *branch();
 
+  /// Whether the state still follows replayedChoices at its forks.
+  bool isReplaying() const {
+    return replayedChoices && forkChoices.size() < replayedChoices->size();
+  }
+  /// The side to take at the next fork while isReplaying().
+  std::uint32_t getReplayedChoice() const {
+    return (*replayedChoices)[forkChoices.size()];
+  }
+
   void pushFrame(KInstIterator caller, KFunction *kf);
   void popFrame();
   void removeAlloca(const MemoryObject *mo);
 
+  /// Creates a thread that starts in kf, returns its id.
+  std::uint32_t createThread(KFunction *kf);
+  /// Makes the thread with the given id the running one.
+  void switchThread(std::uint32_t id);
+  /// Whether a thread other than the running one has not exited.
+  bool hasOtherThreads() const;
+  /// Whether the thread with the given id can execute its next operation.
+  bool isThreadEnabled(std::uint32_t id) const;
+
   void addSymbolic(const MemoryObject *mo, const Array *array);
+  void addArrayReader(const Array *array, const MemoryObject *mo);
 
   void addConstraint(ref<Expr> e);
   void addCexPreference(const ref<Expr> &cond);
@@ -348,11 +663,60 @@ public:
   bool merge(const ExecutionState &b);
   void dumpStack(llvm::raw_ostream &out) const;
 
+  /// A hash of the stack, the registers, the address space and the
+  /// constraints. Only meaningful while fingerprints are tracked (see
+  /// StateFingerprint.h).
+  uint64_t getFingerprint() const;
+
+  /// An estimate of the memory of this state: its objects (see
+  /// AddressSpace::getFootprint), its stack and its list of constraints.
+  /// Expressions are not counted, as states mostly share them. Takes time
+  /// linear in the number of objects.
+  size_t getMemoryFootprint() const;
+
   std::uint32_t getID() const { return id; };
   void setID() { id = nextID++; };
 
-  NondetValue& addNondetValue(const KValue &expr, bool isSigned,
-                              const std::string& name);
+  /// Records that an array name is used, returns false if it already was.
+  bool addArrayName(const std::string &name);
+
+  /// Returns a name for a new array that is not used yet: name itself, or
+  /// name followed by "_" and the number of arrays named after it so far.
+  std::string getUniqueArrayName(const std::string &name);
+
+  /// Returns the object that an access of the given size by ki through
+  /// address was proven to be in bounds of, if that object is still bound.
+  /// Returns a pair of null pointers otherwise.
+  ObjectPair lookupResolution(const KInstruction *ki, const KValue &address,
+                              unsigned bytes) const;
+
+  /// Records that an access of the given size by ki through address is in
+  /// bounds of mo.
+  void cacheResolution(const KInstruction *ki, const KValue &address,
+                       unsigned bytes, const MemoryObject *mo);
+
+  /// Returns whether an access of the given size at offset into mo, an
+  /// object of symbolic size, is known to be in bounds (true) or not provably
+  /// so under the current constraints (false), if either is known.
+  llvm::Optional<bool> lookupSizeBounds(const MemoryObject *mo,
+                                        unsigned bytes, uint64_t offset) const;
+
+  /// Records whether an access of the given size at offset into mo was
+  /// proven to be in bounds.
+  void cacheSizeBounds(const MemoryObject *mo, unsigned bytes, uint64_t offset,
+                       bool inBounds);
+
+  /// Returns the single value of e under the current constraints, a null
+  /// reference if e is known to have several, or None if neither is known.
+  llvm::Optional<ref<ConstantExpr>> lookupUniqueValue(const ref<Expr> &e) const;
+
+  /// Records the single value of e, or that it has several (a null value)
+  /// under the current constraints.
+  void cacheUniqueValue(const ref<Expr> &e,
+                        const ref<ConstantExpr> &value) const;
+
+  const NondetValue &addNondetValue(const KValue &expr, bool isSigned,
+                                    KInstruction *ki, const std::string &name);
 };
 
 struct ExecutionStateIDCompare {
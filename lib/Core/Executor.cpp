@@ -9,18 +9,26 @@
 
 #include "Executor.h"
 
+#include "AsyncBranchQueries.h"
+#include "AutoMerger.h"
+#include "Checkpoint.h"
 #include "Context.h"
 #include "CoreStats.h"
+#include "EventTrace.h"
 #include "ExecutionState.h"
 #include "ExternalDispatcher.h"
 #include "GetElementPtrTypeIterator.h"
 #include "ImpliedValue.h"
 #include "Memory.h"
 #include "MemoryManager.h"
+#include "ParallelWorkers.h"
 #include "PTree.h"
 #include "Searcher.h"
 #include "SeedInfo.h"
+#include "SolutionWorkers.h"
 #include "SpecialFunctionHandler.h"
+#include "StateSwap.h"
+#include "StateFingerprint.h"
 #include "StatsTracker.h"
 #include "TimingSolver.h"
 #include "UserSearcher.h"
@@ -32,6 +40,7 @@
 #include "klee/Expr/ArrayExprOptimizer.h"
 #include "klee/Expr/Assignment.h"
 #include "klee/Expr/Expr.h"
+#include "klee/Expr/ExprAllocator.h"
 #include "klee/Expr/ExprPPrinter.h"
 #include "klee/Expr/ExprSMTLIBPrinter.h"
 #include "klee/Expr/ExprUtil.h"
@@ -43,6 +52,7 @@
 #include "klee/Solver/Common.h"
 #include "klee/Solver/SolverCmdLine.h"
 #include "klee/Solver/SolverStats.h"
+#include "klee/Statistics/MemoryAccount.h"
 #include "klee/Statistics/TimerStatIncrementer.h"
 #include "klee/Support/Casting.h"
 #include "klee/Support/ErrorHandling.h"
@@ -53,6 +63,8 @@
 #include "klee/System/MemoryUsage.h"
 #include "klee/System/Time.h"
 
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/Hashing.h"
 #include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/StringExtras.h"
 #include "llvm/IR/Attributes.h"
@@ -71,6 +83,7 @@
 #include "llvm/Support/FileSystem.h"
 #include "llvm/Support/Path.h"
 #include "llvm/Support/Process.h"
+#include "llvm/Support/SwapByteOrder.h"
 #if LLVM_VERSION_CODE >= LLVM_VERSION(10, 0)
 #include "llvm/Support/TypeSize.h"
 #else
@@ -120,6 +133,22 @@ cl::opt<std::string> MaxTime(
              "Set to 0s to disable (default=0s)"),
     cl::init("0s"),
     cl::cat(TerminationCat));
+
+cl::opt<RevisitedLoopHeadPolicy> RevisitedLoopHeads(
+    "revisited-loop-heads",
+    cl::desc("What to do with a state that reaches a loop head marked by "
+             "__INSTR_check_nontermination_header in the same configuration "
+             "as before, compared by fingerprints of its stack, registers, "
+             "memory and constraints (default=ignore)"),
+    cl::values(
+        clEnumValN(RevisitedLoopHeadPolicy::Ignore, "ignore",
+                   "Do not fingerprint states"),
+        clEnumValN(RevisitedLoopHeadPolicy::Prune, "prune",
+                   "Terminate the state early"),
+        clEnumValN(RevisitedLoopHeadPolicy::Report, "report",
+                   "Report the state as a witness of non-termination")),
+    cl::init(RevisitedLoopHeadPolicy::Ignore),
+    cl::cat(TerminationCat));
 } // namespace klee
 
 namespace {
@@ -132,6 +161,21 @@ cl::opt<bool> DumpStatesOnHalt(
     cl::desc("Dump test cases for all active states on exit (default=true)"),
     cl::cat(TestGenCat));
 
+cl::opt<unsigned> DumpStatesWorkers(
+    "dump-states-workers", cl::init(0),
+    cl::desc("Solve for the test cases of the states dumped on exit with "
+             "this many processes, each with its own copy of the solver "
+             "(default=0 (off))"),
+    cl::cat(TestGenCat));
+
+cl::opt<bool> PathsFromPTree(
+    "paths-from-ptree", cl::init(false),
+    cl::desc("Record the branch decisions of --write-paths and "
+             "--write-sym-paths in the process tree and rebuild the path of a "
+             "state for its test, instead of streaming them to paths.ts and "
+             "symPaths.ts for every state (default=false)"),
+    cl::cat(TestGenCat));
+
 cl::opt<bool> OnlyOutputStatesCoveringNew(
     "only-output-states-covering-new",
     cl::init(false),
@@ -165,6 +209,14 @@ cl::opt<unsigned> MaxSymArraySize(
     cl::init(0),
     cl::cat(SolvingCat));
 
+cl::opt<unsigned> MaxSymArrayConcretizations(
+    "max-sym-array-concretizations",
+    cl::desc("Fork on up to this many feasible offsets of a symbolic address "
+             "concretized by --max-sym-array-size, plus one state for all "
+             "other offsets (default=1)"),
+    cl::init(1),
+    cl::cat(SolvingCat));
+
 cl::opt<bool>
     SimplifySymIndices("simplify-sym-indices",
                        cl::init(false),
@@ -172,12 +224,121 @@ cl::opt<bool>
                                 "from other constraints (default=false)"),
                        cl::cat(SolvingCat));
 
+cl::opt<bool> ImpliedValueConcretization(
+    "implied-value-concretization", cl::init(false),
+    cl::desc("Replace the reads whose value a new constraint implies by the "
+             "value in the memory of the state, so that later accesses are "
+             "concrete (default=false)"),
+    cl::cat(SolvingCat));
+
+cl::opt<bool> MergeMemoryResolutions(
+    "merge-memory-resolutions", cl::init(false),
+    cl::desc("Execute reads through a pointer that may point to several "
+             "objects as a single read of an if-then-else over all targets "
+             "instead of forking a state per target (default=false)"),
+    cl::cat(SolvingCat));
+
 cl::opt<bool>
     EqualitySubstitution("equality-substitution", cl::init(true),
                          cl::desc("Simplify equality expressions before "
                                   "querying the solver (default=true)"),
                          cl::cat(SolvingCat));
 
+cl::opt<bool>
+    RewriteExprs("rewrite-exprs", cl::init(false),
+                 cl::desc("Simplify path constraints and queries with the "
+                          "rewrite rules of the expression builder before "
+                          "they reach the solver (default=false)"),
+                 cl::cat(SolvingCat));
+
+cl::opt<bool> SymbolicFloats(
+    "symbolic-floats", cl::init(false),
+    cl::desc("Keep floating-point operations on symbolic floats and doubles "
+             "symbolic, with rounding to nearest, instead of concretizing "
+             "their operands. Requires the Z3 solver (default=false)"),
+    cl::cat(SolvingCat));
+
+cl::opt<bool> UseConstraintRanges(
+    "use-constraint-ranges", cl::init(true),
+    cl::desc("Decide branch conditions and bounds checks from the bounds that "
+             "the constraints of a state put on its terms, such as x < 10, "
+             "before querying the solver (default=true)"),
+    cl::cat(SolvingCat));
+
+cl::opt<std::string> MaxBranchSolverTime(
+    "max-branch-solver-time",
+    cl::desc("Maximum amount of time for a branch feasibility query "
+             "(default=--max-solver-time)"),
+    cl::cat(SolvingCat));
+
+cl::opt<std::string> MaxBoundsCheckSolverTime(
+    "max-bounds-check-solver-time",
+    cl::desc("Maximum amount of time for a query resolving or bounds "
+             "checking a memory access (default=--max-solver-time)"),
+    cl::cat(SolvingCat));
+
+cl::opt<std::string> MaxTestGenSolverTime(
+    "max-test-gen-solver-time",
+    cl::desc("Maximum amount of time for a query computing a test case "
+             "(default=--max-solver-time)"),
+    cl::cat(SolvingCat));
+
+cl::opt<unsigned> AsyncBranchQueriesOpt(
+    "async-branch-queries", cl::init(0),
+    cl::desc("Solve the conditions of up to this many branches in forked "
+             "processes, parking the states at them and running other "
+             "states in the meantime. Solver caches and statistics do not "
+             "see these queries (default=0 (off))"),
+    cl::cat(SolvingCat));
+
+cl::opt<unsigned> PrefixWorkersOpt(
+    "prefix-workers", cl::init(0),
+    cl::desc("Explore with up to this many worker processes, each on the "
+             "subtree below a prefix of fork choices handed out by a "
+             "coordinator, which asks busy workers for more prefixes when "
+             "a worker is idle. The stats files and query logs only cover "
+             "the coordinator (default=0 (off))"),
+    cl::cat(MiscCat));
+
+cl::opt<unsigned> ParallelWorkersOpt(
+    "parallel-workers", cl::init(0),
+    cl::desc("Explore the states with this many processes: once there are "
+             "four states per process, forked workers each take an equal "
+             "share of them and report their statistics at the end. The "
+             "stats files and query logs only cover the original process "
+             "(default=0 (off))"),
+    cl::cat(MiscCat));
+
+cl::opt<std::string> CheckpointInterval(
+    "checkpoint-interval", cl::init("0s"),
+    cl::desc("Write the states, the coverage and the test counts to "
+             "checkpoint.kcp in the output directory this often, and once "
+             "more at the end of the run, so that a stopped run can be "
+             "continued with --resume-from. Not supported with "
+             "seeds, merging or worker processes (default=0s (off))"),
+    cl::cat(MiscCat));
+
+cl::opt<bool> PartialOrderReduction(
+    "partial-order-reduction", cl::init(true),
+    cl::desc("Explore only one order of the operations of different threads "
+             "that commute, using sleep sets. Otherwise every interleaving "
+             "of the observable operations of the threads is explored "
+             "(default=true)"),
+    cl::cat(MiscCat));
+
+cl::opt<unsigned> MemoizeCallsMaxEntries(
+    "memoize-calls-max-entries", cl::init(100000),
+    cl::desc("Maximum number of call results kept by --memoize-calls, later "
+             "ones are not recorded (default=100000)"),
+    cl::cat(MiscCat));
+
+cl::opt<unsigned> MemoizeCallsMaxBytes(
+    "memoize-calls-max-bytes", cl::init(4096),
+    cl::desc("Maximum number of bytes of memory a call read by "
+             "--memoize-calls may depend on, calls depending on more are "
+             "executed (default=4096)"),
+    cl::cat(MiscCat));
+
 
 /*** External call policy options ***/
 
@@ -223,6 +384,23 @@ cl::opt<bool> AllExternalWarnings(
              "as opposed to once per function (default=false)"),
     cl::cat(ExtCallsCat));
 
+cl::opt<bool> CachePureExternals(
+    "cache-pure-externals",
+    cl::init(false),
+    cl::desc("Answer repeated calls to pure external functions with the same "
+             "concrete arguments from a cache. Functions not accessing "
+             "memory (readnone) and those named by --pure-external are pure "
+             "(default=false)"),
+    cl::cat(ExtCallsCat));
+
+cl::list<std::string> PureExternals(
+    "pure-external",
+    cl::desc("External function whose result only depends on its arguments, "
+             "e.g. sin or pow, see --cache-pure-externals (comma-separated)"),
+    cl::CommaSeparated,
+    cl::value_desc("name"),
+    cl::cat(ExtCallsCat));
+
 
 /*** Seeding options ***/
 
@@ -271,6 +449,17 @@ cl::opt<bool> NamedSeedMatching(
     cl::desc("Use names to match symbolic objects to inputs (default=false)."),
     cl::cat(SeedingCat));
 
+cl::opt<bool> FastForwardSeeds(
+    "fast-forward-seeds",
+    cl::init(false),
+    cl::desc("Follow the seeds of a state without queries at branches all its "
+             "seeds agree on, when no other path would be explored anyway "
+             "(with --only-replay-seeds or klee_set_forking(0)). The solver is "
+             "only asked once the seeds diverge, and a seed that satisfies the "
+             "constraints of a terminated state is its test case "
+             "(default=false)."),
+    cl::cat(SeedingCat));
+
 cl::opt<std::string>
     SeedTime("seed-time",
              cl::desc("Amount of time to dedicate to seeds, before normal "
@@ -325,6 +514,11 @@ cl::list<StateTerminationType> ExitOnErrorType(
                    "values for that type"),
         clEnumValN(StateTerminationType::NullableAttribute, "NullableAttribute",
                    "Violation of nullable attribute detected"),
+        clEnumValN(StateTerminationType::NonTermination, "NonTermination",
+                   "A state came back to a loop head unchanged (see "
+                   "--revisited-loop-heads)"),
+        clEnumValN(StateTerminationType::Deadlock, "Deadlock",
+                   "No thread could run any more"),
         clEnumValN(StateTerminationType::User, "User",
                    "Wrong klee_* functions invocation")),
     cl::ZeroOrMore,
@@ -368,6 +562,36 @@ cl::opt<bool> MaxMemoryInhibit(
     cl::init(true),
     cl::cat(TerminationCat));
 
+cl::list<std::string> MemoryBudgets(
+    "memory-budget",
+    cl::desc("Budget of a subsystem in MB, as <account>=<MB>. A cache over "
+             "its budget is emptied, and all caches are emptied before "
+             "states are terminated over --max-memory. The accounts are "
+             "expressions, arrays, object-states, process-tree, cex-cache "
+             "and construct-cache, only the last two can be emptied "
+             "(comma-separated)"),
+    cl::CommaSeparated,
+    cl::value_desc("account=MB"),
+    cl::cat(TerminationCat));
+
+cl::opt<unsigned> ReclaimStatesPerStep(
+    "reclaim-states-per-step", cl::init(0),
+    cl::desc("Delete at most this many terminated states per instruction "
+             "step, the others before the memory usage is measured or while "
+             "waiting for the solver. Spreads the cost of destroying many "
+             "states over the following steps. Set to 0 to delete them "
+             "immediately (default=0)"),
+    cl::cat(TerminationCat));
+
+cl::opt<bool> StateSwapOpt(
+    "state-swap", cl::init(false),
+    cl::desc("Instead of terminating states over the memory cap, swap them "
+             "out to a file as the choices they took at their forks, and "
+             "rebuild them by replaying those choices once memory is "
+             "available again. Not supported with seeds, merging or worker "
+             "processes (default=false)"),
+    cl::cat(TerminationCat));
+
 cl::opt<unsigned> RuntimeMaxStackFrames(
     "max-stack-frames",
     cl::desc("Terminate a state after this many stack frames.  Set to 0 to "
@@ -458,7 +682,8 @@ llvm::cl::bits<PrintDebugInstructionsType> DebugPrintInstructions(
 cl::opt<bool> DebugCompressInstructions(
     "debug-compress-instructions", cl::init(false),
     cl::desc(
-        "Compress the logged instructions in gzip format (default=false)."),
+        "Compress the logged instructions in gzip or, with "
+        "-log-compression=zstd, zstd format (default=false)."),
     cl::cat(DebugCat));
 #endif
 
@@ -467,6 +692,23 @@ cl::opt<bool> DebugCheckForImpliedValues(
     cl::desc("Debug the implied value optimization"),
     cl::cat(DebugCat));
 
+cl::opt<bool> WritePTreeLog(
+    "write-ptree-log", cl::init(false),
+    cl::desc("Append each change of the process tree to ptree.log as a "
+             "binary record, from which the tree can be rebuilt after the "
+             "run. Not supported with workers or a portfolio "
+             "(default=false)"),
+    cl::cat(DebugCat));
+
+cl::opt<bool> WriteEventTrace(
+    "event-trace", cl::init(false),
+    cl::desc("Write the forks, state selections, solver queries, "
+             "terminations, merges and memory cap events of the run with "
+             "their times to events.trace, which klee-trace converts for "
+             "trace viewers. Worker processes do not record events "
+             "(default=false)"),
+    cl::cat(DebugCat));
+
 } // namespace
 
 // XXX hack
@@ -480,7 +722,7 @@ Executor::Executor(LLVMContext &ctx, const InterpreterOptions &opts,
       pathWriter(0), symPathWriter(0), specialFunctionHandler(0), timers{time::Span(TimerInterval)},
       replayKTest(0), replayPath(0), usingSeeds(0),
       atMemoryLimit(false), inhibitForking(false), haltExecution(false),
-      ivcEnabled(false), debugLogBuffer(debugBufferString) {
+      ivcEnabled(ImpliedValueConcretization), debugLogBuffer(debugBufferString) {
 
 
   const time::Span maxTime{MaxTime};
@@ -491,23 +733,63 @@ Executor::Executor(LLVMContext &ctx, const InterpreterOptions &opts,
       }));
 
   coreSolverTimeout = time::Span{MaxCoreSolverTime};
-  if (coreSolverTimeout) UseForkedCoreSolver = true;
+  auto getSolverTimeout = [this](const std::string &option) {
+    return option.empty() ? coreSolverTimeout : time::Span{option};
+  };
+  branchSolverTimeout = getSolverTimeout(MaxBranchSolverTime);
+  boundsCheckSolverTimeout = getSolverTimeout(MaxBoundsCheckSolverTime);
+  testGenSolverTimeout = getSolverTimeout(MaxTestGenSolverTime);
+  if (coreSolverTimeout || branchSolverTimeout || boundsCheckSolverTimeout ||
+      testGenSolverTimeout)
+    UseForkedCoreSolver = true;
+  if (SymbolicFloats &&
+      (CoreSolverToUse != Z3_SOLVER ||
+       (SolverEscalationBackend != NO_SOLVER &&
+        SolverEscalationBackend != Z3_SOLVER) ||
+       (DebugCrossCheckCoreSolverWith != NO_SOLVER &&
+        DebugCrossCheckCoreSolverWith != Z3_SOLVER)))
+    klee_error("--symbolic-floats is only supported by the Z3 solver");
+  if (SymbolicFloats && (QueryLoggingOptions.isSet(ALL_SMTLIB) ||
+                         QueryLoggingOptions.isSet(SOLVER_SMTLIB)))
+    klee_error("--symbolic-floats queries cannot be logged as SMT-LIBv2");
   Solver *coreSolver = klee::createCoreSolver(CoreSolverToUse);
   if (!coreSolver) {
     klee_error("Failed to create core solver\n");
   }
 
+  // the members of a portfolio share the answers of the core solver
+  if (userSearcherPortfolioSize() > 1 && PersistentQueryCache.empty())
+    PersistentQueryCache =
+        interpreterHandler->getOutputFilename("portfolio-queries.kqc");
+
   Solver *solver = constructSolverChain(
       coreSolver,
       interpreterHandler->getOutputFilename(ALL_QUERIES_SMT2_FILE_NAME),
       interpreterHandler->getOutputFilename(SOLVER_QUERIES_SMT2_FILE_NAME),
       interpreterHandler->getOutputFilename(ALL_QUERIES_KQUERY_FILE_NAME),
-      interpreterHandler->getOutputFilename(SOLVER_QUERIES_KQUERY_FILE_NAME));
+      interpreterHandler->getOutputFilename(SOLVER_QUERIES_KQUERY_FILE_NAME),
+      interpreterHandler->getOutputFilename(ALL_QUERIES_BINARY_FILE_NAME),
+      interpreterHandler->getOutputFilename(SOLVER_QUERIES_BINARY_FILE_NAME));
 
   this->solver = new TimingSolver(solver, EqualitySubstitution);
+  if (RewriteExprs)
+    this->solver->rewriter = std::make_unique<ExprRebuilder>(
+        createRewritingExprBuilder(
+            createConstantFoldingExprBuilder(createDefaultExprBuilder())));
 
   memory = new MemoryManager(&arrayCache);
 
+  for (const auto &budget : MemoryBudgets) {
+    StringRef name, size;
+    std::tie(name, size) = StringRef(budget).split('=');
+    MemoryAccount *account = MemoryAccount::find(name);
+    uint64_t megabytes;
+    if (!account || size.getAsInteger(10, megabytes))
+      klee_error("Invalid --memory-budget '%s', expected <account>=<MB>",
+                 budget.c_str());
+    account->setBudget(megabytes << 20);
+  }
+
   initializeSearchOptions();
 
   if (OnlyOutputStatesCoveringNew && !StatsTracker::useIStats())
@@ -525,7 +807,7 @@ Executor::Executor(LLVMContext &ctx, const InterpreterOptions &opts,
       debugInstFile = klee_open_output_file(debug_file_name, error);
 #ifdef HAVE_ZLIB_H
     } else {
-      debug_file_name.append(".gz");
+      debug_file_name.append(klee_compressed_file_extension());
       debugInstFile = klee_open_compressed_output_file(debug_file_name, error);
     }
 #endif
@@ -538,10 +820,14 @@ Executor::Executor(LLVMContext &ctx, const InterpreterOptions &opts,
 
 llvm::Module *
 Executor::setModule(std::vector<std::unique_ptr<llvm::Module>> &modules,
-                    const ModuleOptions &opts) {
+                    const ModuleOptions &moduleOpts) {
   assert(!kmodule && !modules.empty() &&
          "can only register one module"); // XXX gross
 
+  ModuleOptions opts(moduleOpts);
+  if (!ErrorFun.empty())
+    opts.ErrorFunctions.push_back(ErrorFun);
+
   kmodule = std::unique_ptr<KModule>(new KModule());
 
   // Preparing the final module happens in multiple stages
@@ -556,8 +842,22 @@ Executor::setModule(std::vector<std::unique_ptr<llvm::Module>> &modules,
     klee_error("Could not load KLEE intrinsic file %s", LibPath.c_str());
   }
 
+  // The first module is the program under test, which may define functions
+  // of the names of the libc functions with fast paths
+  std::set<std::string> programFunctions;
+  for (const llvm::Function &f : *modules[0])
+    if (!f.isDeclaration())
+      programFunctions.insert(f.getName().str());
+
+  // A module prepared by an earlier run from the same code replaces
+  // steps 1.) to 3.)
+  std::string cacheKey = kmodule->getCacheKey(modules, opts);
+  bool cached = kmodule->loadFromCache(cacheKey, modules[0]->getContext());
+  if (cached)
+    modules.clear();
+
   // 1.) Link the modules together
-  while (kmodule->link(modules, opts.EntryPoint)) {
+  while (!cached && kmodule->link(modules, opts.EntryPoint)) {
     // 2.) Apply different instrumentation
     kmodule->instrument(opts);
   }
@@ -570,6 +870,8 @@ Executor::setModule(std::vector<std::unique_ptr<llvm::Module>> &modules,
   specialFunctionHandler->prepare(preservedFunctions);
 
   preservedFunctions.push_back(opts.EntryPoint.c_str());
+  for (const auto &entryPoint : opts.ExtraEntryPoints)
+    preservedFunctions.push_back(entryPoint.c_str());
 
   // Preserve the free-standing library calls
   preservedFunctions.push_back("memset");
@@ -577,13 +879,19 @@ Executor::setModule(std::vector<std::unique_ptr<llvm::Module>> &modules,
   preservedFunctions.push_back("memcmp");
   preservedFunctions.push_back("memmove");
 
-  kmodule->optimiseAndPrepare(opts, preservedFunctions);
+  if (cached) {
+    kmodule->restoreFromCache(opts);
+  } else {
+    kmodule->optimiseAndPrepare(opts, preservedFunctions);
+    kmodule->storeInCache(cacheKey);
+  }
   kmodule->checkModule();
 
   // 4.) Manifest the module
   kmodule->manifest(interpreterHandler, StatsTracker::useStatistics());
 
-  specialFunctionHandler->bind();
+  specialFunctionHandler->bind(programFunctions);
+  createsThreads = kmodule->module->getFunction("pthread_create") != nullptr;
 
   if (StatsTracker::useStatistics() || userSearcherRequiresMD2U()) {
     statsTracker = 
@@ -602,11 +910,15 @@ Executor::setModule(std::vector<std::unique_ptr<llvm::Module>> &modules,
 }
 
 Executor::~Executor() {
+  reclaimStates(reclaimedStates.size());
+  // the clauses hold their objects, which tell the memory manager when freed
+  serializedLandingpads.clear();
   delete memory;
   delete externalDispatcher;
   delete specialFunctionHandler;
   delete statsTracker;
   delete solver;
+  eventTrace.reset();
 }
 
 /***/
@@ -615,16 +927,16 @@ void Executor::initializeGlobalObject(ExecutionState &state, ObjectState *os,
                                       const Constant *c, 
                                       unsigned offset) {
   const auto targetData = kmodule->targetData.get();
+  // the object starts out zero and its store is only allocated where it is
+  // written, so zero-initialized parts cost nothing until they are written
+  if (c->isNullValue())
+    return;
   if (const ConstantVector *cp = dyn_cast<ConstantVector>(c)) {
     unsigned elementSize =
       targetData->getTypeStoreSize(cp->getType()->getElementType());
     for (unsigned i=0, e=cp->getNumOperands(); i != e; ++i)
       initializeGlobalObject(state, os, cp->getOperand(i), 
 			     offset + i*elementSize);
-  } else if (isa<ConstantAggregateZero>(c)) {
-    unsigned i, size = targetData->getTypeStoreSize(c->getType());
-    for (i=0; i<size; i++)
-      os->write8(offset+i, (uint8_t)0, (uint8_t)0);
   } else if (const ConstantArray *ca = dyn_cast<ConstantArray>(c)) {
     unsigned elementSize =
       targetData->getTypeStoreSize(ca->getType()->getElementType());
@@ -641,6 +953,13 @@ void Executor::initializeGlobalObject(ExecutionState &state, ObjectState *os,
                dyn_cast<ConstantDataSequential>(c)) {
     unsigned elementSize =
       targetData->getTypeStoreSize(cds->getElementType());
+    // the raw data is laid out as in memory of the host
+    if (targetData->isLittleEndian() == sys::IsLittleEndianHost) {
+      StringRef data = cds->getRawDataValues();
+      os->writeConcrete(offset, data.size(),
+                        reinterpret_cast<const uint8_t *>(data.data()));
+      return;
+    }
     for (unsigned i=0, e=cds->getNumElements(); i != e; ++i)
       initializeGlobalObject(state, os, cds->getElementAsConstant(i),
                              offset + i*elementSize);
@@ -661,13 +980,15 @@ MemoryObject *Executor::addExternalObject(ExecutionState &state, void *addr,
                                           unsigned size, bool isReadOnly,
                                           uint64_t specialSegment) {
   auto mo = memory->allocateFixed(size, nullptr, specialSegment);
-  state.addressSpace.concreteAddressMap.emplace(
-      reinterpret_cast<uint64_t>(addr), mo->segment);
+  state.addressSpace.addConcreteAddress(reinterpret_cast<uint64_t>(addr),
+                                        mo->segment);
   ObjectState *os = bindObjectInState(state, mo, false);
   for(unsigned i = 0; i < size; i++)
     os->write8(i, (uint8_t)mo->segment, ((uint8_t*)addr)[i]);
-  if(isReadOnly)
-    os->setReadOnly(true);  
+  if (isReadOnly) {
+    os->setReadOnly(true);
+    state.addressSpace.shareReadOnlyObject(mo);
+  }
   return mo;
 }
 
@@ -795,6 +1116,7 @@ void Executor::allocateGlobalObjects(ExecutionState &state) {
                                         /*alignment=*/globalObjectAlignment);
     if (!mo)
       klee_error("out of memory");
+    mo->isPointerFree = kmodule->pointerFreeAllocSites.count(&v) > 0;
     globalObjects.emplace(&v, mo);
       globalAddresses.emplace(&v, mo->getPointer());
   }
@@ -868,17 +1190,12 @@ void Executor::initializeGlobalObjects(ExecutionState &state) {
       if (!addr) {
         klee_warning("Making external global %.*s symbolic",
                    static_cast<int>(v.getName().size()), v.getName().data());
-        // Find a unique name for this array.  First try the original name,
-        // or if that fails try adding a unique identifier.
-        unsigned id = 0;
-        auto name = v.getName().str();
-        auto uniqueName = name;
-        while (!state.arrayNames.insert(uniqueName).second) {
-          uniqueName = name + "_" + llvm::utostr(++id);
-        }
-        const Array *array = arrayCache.CreateArray(uniqueName, size);
+        const Array *array = arrayCache.CreateArray(
+            state.getUniqueArrayName(v.getName().str()), size);
         bindObjectInState(state, mo, false, array);
         state.addSymbolic(mo, array);
+        if (ivcEnabled)
+          state.addArrayReader(array, mo);
       } else {
         for (unsigned offset = 0; offset < size; offset++) {
           os->write8(offset, 0, static_cast<unsigned char *>(addr)[offset]);
@@ -886,12 +1203,12 @@ void Executor::initializeGlobalObjects(ExecutionState &state) {
       }
     } else if (v.hasInitializer()) {
       void *address = memory->allocateMemory(
-          mo->allocatedSize, getAllocationAlignment(mo->allocSite));
+          mo, mo->allocatedSize, getAllocationAlignment(mo->allocSite));
       if (!address)
         klee_error("Couldn't allocate memory for external function");
 
       initializedMOs.emplace(mo->segment, reinterpret_cast<uint64_t>(address));
-      state.addressSpace.concreteAddressMap.emplace(
+      state.addressSpace.addConcreteAddress(
           reinterpret_cast<uint64_t>(address), mo->getSegment());
       state.addressSpace.segmentMap.replace({mo->getSegment(), mo});
 
@@ -910,9 +1227,12 @@ void Executor::initializeGlobalObjects(ExecutionState &state) {
     // initialise the actual memory with constant values
     state.addressSpace.copyOutConcretes(initializedMOs);
 
-    // mark constant objects as read-only
-    for (auto obj : constantObjects)
+    // mark constant objects as read-only, they are then shared by all
+    // states instead of being bound in each
+    for (auto obj : constantObjects) {
       obj->setReadOnly(true);
+      state.addressSpace.shareReadOnlyObject(obj->getObject());
+    }
   }
 }
 
@@ -946,8 +1266,18 @@ void Executor::branch(ExecutionState &state,
   unsigned N = conditions.size();
   assert(N);
 
-  if (!branchingPermitted(state)) {
-    unsigned next = theRNG.getInt32() % N;
+  bool replaying = state.isReplaying();
+  if (replaying || !branchingPermitted(state)) {
+    unsigned next;
+    if (replaying) {
+      // follow the prefix this state was given
+      next = state.getReplayedChoice() % N;
+      state.forkChoices.push_back(next);
+    } else {
+      next = theRNG.getInt32() % N;
+      if (recordForkChoices())
+        state.forkChoices.push_back(next);
+    }
     for (unsigned i=0; i<N; ++i) {
       if (i == next) {
         result.push_back(&state);
@@ -964,9 +1294,14 @@ void Executor::branch(ExecutionState &state,
       ExecutionState *es = result[theRNG.getInt32() % i];
       ExecutionState *ns = es->branch();
       addedStates.push_back(ns);
+      if (eventTrace)
+        eventTrace->record(EventTrace::Fork, es->getID(), 0, ns->getID());
       result.push_back(ns);
       processTree->attach(es->ptreeNode, ns, es, reason);
     }
+    if (recordForkChoices())
+      for (unsigned i = 0; i < N; ++i)
+        result[i]->forkChoices.push_back(i);
   }
 
   // If necessary redistribute seeds to match conditions, killing
@@ -1077,6 +1412,52 @@ ref<Expr> Executor::maxStaticPctChecks(ExecutionState &current,
   return condition;
 }
 
+bool Executor::getSeedsValue(const ExecutionState &state, const ref<Expr> &e,
+                             ref<ConstantExpr> &value) {
+  if (!FastForwardSeeds || !(state.forkDisabled || OnlyReplaySeeds) ||
+      isa<ConstantExpr>(e))
+    return false;
+  auto it = seedMap.find(const_cast<ExecutionState *>(&state));
+  if (it == seedMap.end() || it->second.empty())
+    return false;
+  ref<ConstantExpr> result;
+  for (const SeedInfo &si : it->second) {
+    auto CE = dyn_cast<ConstantExpr>(si.assignment.evaluate(e));
+    if (!CE || (result && CE->compare(*result) != 0))
+      return false;
+    result = CE;
+  }
+  value = result;
+  ++stats::seededBranches;
+  return true;
+}
+
+llvm::Optional<bool> Executor::decideByRanges(const ExecutionState &state,
+                                              const ref<Expr> &condition) {
+  if (!UseConstraintRanges || isa<ConstantExpr>(condition))
+    return llvm::None;
+  llvm::Optional<bool> res = state.constraintRanges.decide(condition);
+  if (res)
+    ++stats::decidedByRanges;
+  return res;
+}
+
+bool Executor::solveBranch(ExecutionState &current, const ref<Expr> &condition,
+                           time::Span timeout, Solver::Validity &res) {
+  // with a model, the solver chain needs a single truth query
+  if (!isa<ConstantExpr>(condition)) {
+    if (UseKnownModel && current.constraints.getModel())
+      ++stats::forkModelHits;
+    else
+      ++stats::forkModelMisses;
+  }
+  solver->setTimeout(timeout, TimingSolver::QueryKind::Branch);
+  bool success = solver->evaluate(current.constraints, condition, res,
+                                  current.queryMetaData);
+  solver->setTimeout(time::Span());
+  return success;
+}
+
 Executor::StatePair Executor::fork(ExecutionState &current, ref<Expr> condition,
                                    bool isInternal, BranchType reason) {
   Solver::Validity res;
@@ -1087,13 +1468,30 @@ Executor::StatePair Executor::fork(ExecutionState &current, ref<Expr> condition,
   if (!isSeeding)
     condition = maxStaticPctChecks(current, condition);
 
-  time::Span timeout = coreSolverTimeout;
+  time::Span timeout = branchSolverTimeout;
   if (isSeeding)
     timeout *= static_cast<unsigned>(it->second.size());
-  solver->setTimeout(timeout);
-  bool success = solver->evaluate(current.constraints, condition, res,
-                                  current.queryMetaData);
-  solver->setTimeout(time::Span());
+  bool success;
+  ref<ConstantExpr> seedsValue;
+  if (isSeeding && getSeedsValue(current, condition, seedsValue)) {
+    // the seeds take a single side, which need not be implied
+    success = true;
+    res = seedsValue->isTrue() ? Solver::True : Solver::False;
+    addConstraint(current, seedsValue->isTrue()
+                               ? condition
+                               : Expr::createIsZero(condition));
+  } else if (current.pendingBranch && current.pendingBranch->answered &&
+             current.pendingBranch->condition == condition) {
+    // solved while the state was parked
+    success = current.pendingBranch->success;
+    res = current.pendingBranch->validity;
+  } else if (auto decided = decideByRanges(current, condition)) {
+    success = true;
+    res = *decided ? Solver::True : Solver::False;
+  } else {
+    success = solveBranch(current, condition, timeout, res);
+  }
+  current.pendingBranch.reset();
   if (!success) {
     current.pc = current.prevPC;
     terminateStateOnSolverError(current, "Query timed out (fork).");
@@ -1120,6 +1518,17 @@ Executor::StatePair Executor::fork(ExecutionState &current, ref<Expr> condition,
           addConstraint(current, Expr::createIsZero(condition));
         }
       }
+    } else if (res == Solver::Unknown && current.isReplaying()) {
+      // follow the prefix this state was given
+      bool branch = current.getReplayedChoice();
+      current.forkChoices.push_back(branch);
+      if (branch) {
+        res = Solver::True;
+        addConstraint(current, condition);
+      } else {
+        res = Solver::False;
+        addConstraint(current, Expr::createIsZero(condition));
+      }
     } else if (res==Solver::Unknown) {
       assert(!replayKTest && "in replay mode, only one branch can be true.");
       
@@ -1132,6 +1541,9 @@ Executor::StatePair Executor::fork(ExecutionState &current, ref<Expr> condition,
           addConstraint(current, Expr::createIsZero(condition));
           res = Solver::False;
         }
+        // a prefix has a choice for every fork with both sides feasible
+        if (recordForkChoices())
+          current.forkChoices.push_back(res == Solver::True);
       }
     }
   }
@@ -1176,19 +1588,13 @@ Executor::StatePair Executor::fork(ExecutionState &current, ref<Expr> condition,
   // hint to just use the single constraint instead of all the binary
   // search ones. If that makes sense.
   if (res==Solver::True) {
-    if (!isInternal) {
-      if (pathWriter) {
-        current.pathOS << "1";
-      }
-    }
+    if (!isInternal)
+      recordBranch(current, "1", false);
 
     return StatePair(&current, nullptr);
   } else if (res==Solver::False) {
-    if (!isInternal) {
-      if (pathWriter) {
-        current.pathOS << "0";
-      }
-    }
+    if (!isInternal)
+      recordBranch(current, "0", false);
 
     return StatePair(nullptr, &current);
   } else {
@@ -1199,6 +1605,9 @@ Executor::StatePair Executor::fork(ExecutionState &current, ref<Expr> condition,
 
     falseState = trueState->branch();
     addedStates.push_back(falseState);
+    if (eventTrace)
+      eventTrace->record(EventTrace::Fork, trueState->getID(), 0,
+                         falseState->getID());
 
     if (it != seedMap.end()) {
       std::vector<SeedInfo> seeds = it->second;
@@ -1236,22 +1645,21 @@ Executor::StatePair Executor::fork(ExecutionState &current, ref<Expr> condition,
     }
 
     processTree->attach(current.ptreeNode, falseState, trueState, reason);
+    if (recordForkChoices()) {
+      trueState->forkChoices.push_back(1);
+      falseState->forkChoices.push_back(0);
+    }
 
-    if (pathWriter) {
+    if (pathWriter && !PathsFromPTree) {
       // Need to update the pathOS.id field of falseState, otherwise the same id
       // is used for both falseState and trueState.
       falseState->pathOS = pathWriter->open(current.pathOS);
-      if (!isInternal) {
-        trueState->pathOS << "1";
-        falseState->pathOS << "0";
-      }
     }
-    if (symPathWriter) {
+    if (symPathWriter && !PathsFromPTree)
       falseState->symPathOS = symPathWriter->open(current.symPathOS);
-      if (!isInternal) {
-        trueState->symPathOS << "1";
-        falseState->symPathOS << "0";
-      }
+    if (!isInternal) {
+      recordBranch(*trueState, "1", true);
+      recordBranch(*falseState, "0", true);
     }
 
     addConstraint(*trueState, condition);
@@ -1269,6 +1677,7 @@ Executor::StatePair Executor::fork(ExecutionState &current, ref<Expr> condition,
 }
 
 void Executor::addConstraint(ExecutionState &state, ref<Expr> condition) {
+  condition = solver->rewrite(condition);
   if (ConstantExpr *CE = dyn_cast<ConstantExpr>(condition)) {
     if (!CE->isTrue())
       llvm::report_fatal_error("attempt to add invalid constraint");
@@ -1303,6 +1712,47 @@ void Executor::addConstraint(ExecutionState &state, ref<Expr> condition) {
                                  ConstantExpr::alloc(1, Expr::Bool));
 }
 
+void Executor::addSymbolicAddressAxioms(ExecutionState &state,
+                                        const MemoryObject *a,
+                                        const MemoryObject *b) {
+  AddressAxiomSet &axioms = state.addressSpace.addressAxioms;
+  auto address = [this](const MemoryObject *mo) {
+    return const_cast<MemoryObject *>(mo)->getSymbolicAddress(arrayCache);
+  };
+  auto end = [&](const MemoryObject *mo) {
+    return AddExpr::create(address(mo),
+                           Expr::createZExtToPointerWidth(mo->getSizeExpr()));
+  };
+
+  std::vector<ref<Expr>> conditions;
+  for (const MemoryObject *mo : {a, b}) {
+    if (!mo || axioms.count({mo->id, mo->id}))
+      continue;
+    axioms = axioms.insert({mo->id, mo->id});
+    conditions.push_back(Expr::createIsZero(
+        Expr::createIsZero(address(mo))));
+    conditions.push_back(UleExpr::create(address(mo), end(mo)));
+  }
+  if (a && b && a != b) {
+    std::pair<unsigned, unsigned> pair = std::minmax(a->id, b->id);
+    if (!axioms.count(pair)) {
+      axioms = axioms.insert(pair);
+      conditions.push_back(OrExpr::create(UleExpr::create(end(a), address(b)),
+                                          UleExpr::create(end(b), address(a))));
+    }
+  }
+
+  // Each axiom is added to the constraints once, instead of to every query
+  // comparing the objects. An axiom the path already contradicts is dropped.
+  for (const ref<Expr> &condition : conditions) {
+    bool mayBeTrue;
+    if (solver->mayBeTrue(state.constraints, condition, mayBeTrue,
+                          state.queryMetaData) &&
+        mayBeTrue)
+      addConstraint(state, condition);
+  }
+}
+
 const Cell& Executor::eval(KInstruction *ki, unsigned index, 
                            ExecutionState &state) const {
   assert(index < ki->inst->getNumOperands());
@@ -1317,19 +1767,35 @@ const Cell& Executor::eval(KInstruction *ki, unsigned index,
     return kmodule->constantTable[index];
   } else {
     unsigned index = vnumber;
-    StackFrame &sf = state.stack.back();
+    const StackFrame &sf = state.stack.back();
     return sf.locals[index];
   }
 }
 
 void Executor::bindLocal(KInstruction *target, ExecutionState &state,
                          const KValue &value) {
-  getDestCell(state, target) = value;
+  bindLocal(target, state, KValue(value));
+}
+
+void Executor::bindLocal(KInstruction *target, ExecutionState &state,
+                         KValue &&value) {
+  Cell &cell = getDestCell(state, target);
+  if (trackFingerprints())
+    state.stack.getWriteableBack().fingerprint ^=
+        getRegisterFingerprint(target->dest, cell) ^
+        getRegisterFingerprint(target->dest, value);
+  cell = std::move(value);
 }
 
 void Executor::bindArgument(KFunction *kf, unsigned index,
                             ExecutionState &state, const KValue &value) {
-  getArgumentCell(state, kf, index) = value;
+  Cell &cell = getArgumentCell(state, kf, index);
+  if (trackFingerprints()) {
+    unsigned reg = kf->getArgRegister(index);
+    state.stack.getWriteableBack().fingerprint ^=
+        getRegisterFingerprint(reg, cell) ^ getRegisterFingerprint(reg, value);
+  }
+  cell = value;
 }
 
 ref<Expr> Executor::toUnique(const ExecutionState &state, 
@@ -1337,6 +1803,11 @@ ref<Expr> Executor::toUnique(const ExecutionState &state,
   ref<Expr> result = e;
 
   if (!isa<ConstantExpr>(e)) {
+    if (auto known = state.lookupUniqueValue(e)) {
+      ++stats::uniqueValueCacheHits;
+      return known->isNull() ? e : ref<Expr>(*known);
+    }
+
     ref<ConstantExpr> value;
     bool isTrue = false;
     auto expr = optimizer.optimizeExpr(e, true);
@@ -1345,9 +1816,12 @@ ref<Expr> Executor::toUnique(const ExecutionState &state,
       ref<Expr> cond = EqExpr::create(expr, value);
       cond = optimizer.optimizeExpr(cond, false);
       if (solver->mustBeTrue(state.constraints, cond, isTrue,
-                             state.queryMetaData) &&
-          isTrue)
-        result = value;
+                             state.queryMetaData)) {
+        if (isTrue)
+          result = value;
+        // a failed query proves nothing, so only answers are cached
+        state.cacheUniqueValue(e, isTrue ? value : ref<ConstantExpr>());
+      }
     }
     solver->setTimeout(time::Span());
   }
@@ -1495,11 +1969,30 @@ void Executor::stepInstruction(ExecutionState &state) {
   ++state.steppedInstructions;
   state.prevPC = state.pc;
   ++state.pc;
+  clearDeadRegisters(state, state.prevPC);
 
   if (stats::instructions == MaxInstructions)
     haltExecution = true;
 }
 
+void Executor::clearDeadRegisters(ExecutionState &state,
+                                  const KInstruction *ki) {
+  // a frame shared with another state is only copied if there is something
+  // to clear in it
+  const Cell *locals = state.stack.back().locals;
+  auto isSet = [locals](unsigned reg) { return !locals[reg].value.isNull(); };
+  if (std::none_of(ki->deadRegisters.begin(), ki->deadRegisters.end(), isSet))
+    return;
+
+  StackFrame &sf = state.stack.getWriteableBack();
+  for (unsigned reg : ki->deadRegisters) {
+    Cell &cell = sf.locals[reg];
+    if (trackFingerprints())
+      sf.fingerprint ^= getRegisterFingerprint(reg, cell);
+    cell = KValue();
+  }
+}
+
 void Executor::executeLifetimeIntrinsic(ExecutionState &state,
                                         KInstruction *ki,
                                         const std::vector<Cell> &arguments,
@@ -1564,25 +2057,65 @@ void Executor::executeLifetimeIntrinsic(ExecutionState &state,
 }
 
 static inline const llvm::fltSemantics *fpWidthToSemantics(unsigned width) {
-  switch (width) {
-  case Expr::Int32:
-    return &llvm::APFloat::IEEEsingle();
-  case Expr::Int64:
-    return &llvm::APFloat::IEEEdouble();
-  case Expr::Fl80:
-    return &llvm::APFloat::x87DoubleExtended();
+  return klee::ConstantExpr::getFloatSemantics(width);
+}
+
+/// The fcmp predicate p over the ordered comparisons, which fold to a
+/// constant for constant operands.
+static ref<Expr> createFCmp(FCmpInst::Predicate p, const ref<Expr> &l,
+                            const ref<Expr> &r) {
+  switch (p) {
+  case FCmpInst::FCMP_FALSE:
+    return klee::ConstantExpr::alloc(0, Expr::Bool);
+  case FCmpInst::FCMP_TRUE:
+    return klee::ConstantExpr::alloc(1, Expr::Bool);
+  case FCmpInst::FCMP_ORD:
+    return Expr::createIsZero(FUnoExpr::create(l, r));
+  case FCmpInst::FCMP_UNO:
+    return FUnoExpr::create(l, r);
+  case FCmpInst::FCMP_OEQ:
+    return FOEqExpr::create(l, r);
+  case FCmpInst::FCMP_UEQ:
+    return OrExpr::create(FUnoExpr::create(l, r), FOEqExpr::create(l, r));
+  case FCmpInst::FCMP_OGT:
+    return FOLtExpr::create(r, l);
+  case FCmpInst::FCMP_UGT:
+    return Expr::createIsZero(FOLeExpr::create(l, r));
+  case FCmpInst::FCMP_OGE:
+    return FOLeExpr::create(r, l);
+  case FCmpInst::FCMP_UGE:
+    return Expr::createIsZero(FOLtExpr::create(l, r));
+  case FCmpInst::FCMP_OLT:
+    return FOLtExpr::create(l, r);
+  case FCmpInst::FCMP_ULT:
+    return Expr::createIsZero(FOLeExpr::create(r, l));
+  case FCmpInst::FCMP_OLE:
+    return FOLeExpr::create(l, r);
+  case FCmpInst::FCMP_ULE:
+    return Expr::createIsZero(FOLtExpr::create(r, l));
+  case FCmpInst::FCMP_ONE:
+    return OrExpr::create(FOLtExpr::create(l, r), FOLtExpr::create(r, l));
+  case FCmpInst::FCMP_UNE:
+    return Expr::createIsZero(FOEqExpr::create(l, r));
   default:
-    return 0;
+    assert(0 && "Invalid FCMP predicate!");
+    return klee::ConstantExpr::alloc(0, Expr::Bool);
   }
 }
 
-MemoryObject *Executor::serializeLandingpad(ExecutionState &state,
-                                            const llvm::LandingPadInst &lpi,
-                                            bool &stateTerminated) {
-  stateTerminated = false;
-
-  std::vector<unsigned char> serialized;
+ref<Expr> Executor::toFloatOperand(ExecutionState &state, ref<Expr> e,
+                                   Expr::Width width) {
+  if (SymbolicFloats && (width == Expr::Int32 || width == Expr::Int64))
+    return e;
+  return toConstant(state, e, "floating point");
+}
 
+/// Serialize the clauses of lpi into serialized.
+/// \return the error if a clause cannot be serialized, or an empty string
+static std::string
+serializeClauses(const llvm::LandingPadInst &lpi,
+                 std::map<const llvm::GlobalValue *, KValue> &globalAddresses,
+                 std::vector<unsigned char> &serialized) {
   for (unsigned current_clause_id = 0; current_clause_id < lpi.getNumClauses();
        ++current_clause_id) {
     llvm::Constant *current_clause = lpi.getClause(current_clause_id);
@@ -1598,14 +2131,11 @@ MemoryObject *Executor::serializeLandingpad(ExecutionState &state,
         llvm::GlobalValue *clause_type =
             dyn_cast<GlobalValue>(clause_bitcast->getOperand(0));
 
-        ti_addr = cast<ConstantExpr>(globalAddresses[clause_type].getValue())->getZExtValue();
+        ti_addr = cast<klee::ConstantExpr>(globalAddresses[clause_type].getValue())->getZExtValue();
       } else if (current_clause->isNullValue()) {
         ti_addr = 0;
       } else {
-        terminateStateOnExecError(
-            state, "Internal: Clause is not a bitcast or null (catch-all)");
-        stateTerminated = true;
-        return nullptr;
+        return "Internal: Clause is not a bitcast or null (catch-all)";
       }
       const std::size_t old_size = serialized.size();
       serialized.resize(old_size + 8);
@@ -1627,10 +2157,7 @@ MemoryObject *Executor::serializeLandingpad(ExecutionState &state,
 
         if (num_elements >=
             std::numeric_limits<decltype(serialized_num_elements)>::max()) {
-          terminateStateOnExecError(
-              state, "Internal: too many elements in landingpad filter");
-          stateTerminated = true;
-          return nullptr;
+          return "Internal: too many elements in landingpad filter";
         }
 
         serialized_num_elements = num_elements;
@@ -1641,25 +2168,19 @@ MemoryObject *Executor::serializeLandingpad(ExecutionState &state,
           llvm::BitCastOperator const *bitcast =
               dyn_cast<llvm::BitCastOperator>(v);
           if (!bitcast) {
-            terminateStateOnExecError(state,
-                                      "Internal: expected value inside a "
-                                      "filter-clause to be a bitcast");
-            stateTerminated = true;
-            return nullptr;
+            return "Internal: expected value inside a filter-clause to be a "
+                   "bitcast";
           }
 
           llvm::GlobalValue const *clause_value =
               dyn_cast<GlobalValue>(bitcast->getOperand(0));
           if (!clause_value) {
-            terminateStateOnExecError(state,
-                                      "Internal: expected value inside a "
-                                      "filter-clause bitcast to be a GlobalValue");
-            stateTerminated = true;
-            return nullptr;
+            return "Internal: expected value inside a filter-clause bitcast "
+                   "to be a GlobalValue";
           }
 
           std::uint64_t const ti_addr =
-              cast<ConstantExpr>(globalAddresses[clause_value].getValue())->getZExtValue();
+              cast<klee::ConstantExpr>(globalAddresses[clause_value].getValue())->getZExtValue();
 
           const std::size_t old_size = serialized.size();
           serialized.resize(old_size + 8);
@@ -1669,15 +2190,54 @@ MemoryObject *Executor::serializeLandingpad(ExecutionState &state,
     }
   }
 
-  MemoryObject *mo =
-      memory->allocate(serialized.size(), true, false, nullptr, 1);
-  ObjectState *os = bindObjectInState(state, mo, false);
-  for (unsigned i = 0; i < serialized.size(); i++) {
-    // TODO: segment
-    os->write8(i, 0, serialized[i]);
+  return "";
+}
+
+void Executor::serializeLandingpads() {
+  for (const Function &f : *kmodule->module) {
+    for (const BasicBlock &bb : f) {
+      auto *lpi = dyn_cast<LandingPadInst>(bb.getFirstNonPHI());
+      if (!lpi || lpi->getNumClauses() == 0)
+        continue;
+
+      SerializedLandingpad &entry = serializedLandingpads[lpi];
+      std::vector<unsigned char> serialized;
+      entry.error = serializeClauses(*lpi, globalAddresses, serialized);
+      if (!entry.error.empty())
+        continue;
+
+      entry.object =
+          memory->allocate(serialized.size(), true, false, nullptr, 1);
+      if (!entry.object)
+        klee_error("Could not allocate memory for landingpad clauses");
+      entry.clauses = new ObjectState(entry.object);
+      for (unsigned i = 0; i < serialized.size(); i++) {
+        // TODO: segment
+        entry.clauses->write8(i, 0, serialized[i]);
+      }
+    }
   }
+}
 
-  return mo;
+MemoryObject *Executor::serializeLandingpad(ExecutionState &state,
+                                            const llvm::LandingPadInst &lpi,
+                                            bool &stateTerminated) {
+  stateTerminated = false;
+
+  auto it = serializedLandingpads.find(&lpi);
+  assert(it != serializedLandingpads.end() && "landingpad not serialized");
+  const SerializedLandingpad &entry = it->second;
+  if (!entry.error.empty()) {
+    terminateStateOnExecError(state, entry.error);
+    stateTerminated = true;
+    return nullptr;
+  }
+
+  // the clauses are shared by all states, which only read them
+  auto *os = new ObjectState(*entry.clauses);
+  os->setReadOnly(true);
+  state.addressSpace.bindObject(entry.object, os);
+  return entry.object;
 }
 
 void Executor::unwindToNextLandingpad(ExecutionState &state) {
@@ -1701,7 +2261,7 @@ void Executor::unwindToNextLandingpad(ExecutionState &state) {
   }
 
   for (std::size_t i = startIndex; i > lowestStackIndex; i--) {
-    auto const &sf = state.stack.at(i);
+    auto const &sf = state.stack[i];
 
     Instruction *inst = sf.caller ? sf.caller->inst : nullptr;
 
@@ -1746,6 +2306,7 @@ void Executor::unwindToNextLandingpad(ExecutionState &state) {
         llvm::Function *personality_fn =
             kmodule->module->getFunction("_klee_eh_cxx_personality");
         KFunction *kf = kmodule->functionMap[personality_fn];
+        kmodule->resolveInfos(kf);
 
         state.pushFrame(state.prevPC, kf);
         state.pc = kf->instructions;
@@ -1792,23 +2353,49 @@ void Executor::unwindToNextLandingpad(ExecutionState &state) {
 ref<klee::ConstantExpr> Executor::getEhTypeidFor(ref<Expr> type_info) {
   // FIXME: Handling getEhTypeidFor is non-deterministic and depends on the
   //        order states have been processed and executed.
-  auto eh_type_iterator =
-      std::find(std::begin(eh_typeids), std::end(eh_typeids), type_info);
-  if (eh_type_iterator == std::end(eh_typeids)) {
-    eh_typeids.push_back(type_info);
-    eh_type_iterator = std::prev(std::end(eh_typeids));
-  }
   // +1 because typeids must always be positive, so they can be distinguished
   // from 'no landingpad clause matched' which has value 0
-  auto res = ConstantExpr::create(eh_type_iterator - std::begin(eh_typeids) + 1,
-                                  Expr::Int32);
-  return res;
+  auto inserted = eh_typeids.emplace(type_info, eh_typeids.size() + 1);
+  return ConstantExpr::create(inserted.first->second, Expr::Int32);
 }
 
 static inline bool isErrorCall(const llvm::StringRef& name) {
   return name.equals(ErrorFun);
 }
 
+bool Executor::isErrorFunction(const llvm::Function &f) {
+  llvm::StringRef name = f.getName();
+  return name.equals("__assert_fail") || name.equals("__INSTR_fail") ||
+         (!ErrorFun.empty() && isErrorCall(name));
+}
+
+bool Executor::checkRevisitedLoopHead(ExecutionState &state,
+                                      KInstruction *ki) {
+  uint64_t fingerprint = state.getFingerprint();
+  auto visit = state.loopHeadVisits.lookup(fingerprint);
+  if (!visit) {
+    state.loopHeadVisits =
+        state.loopHeadVisits.insert({fingerprint, state.nondetValues.size()});
+    return false;
+  }
+
+  if (RevisitedLoopHeads == RevisitedLoopHeadPolicy::Prune) {
+    terminateStateEarly(state, "revisited a loop head in the same state.",
+                        StateTerminationType::RevisitedLoopHead);
+    return true;
+  }
+
+  // the cycle of the witness goes back to the first visit
+  state.lastLoopHead = ki->inst;
+  state.lastLoopHeadId = visit->second;
+  state.lastLoopCheck = ki->inst;
+  terminateStateOnError(state,
+                        "non-termination: a loop head is reached again in "
+                        "the same state",
+                        StateTerminationType::NonTermination);
+  return true;
+}
+
 void Executor::executeCall(ExecutionState &state, KInstruction *ki, Function *f,
                            const std::vector<Cell> &arguments) {
   Instruction *i = ki->inst;
@@ -1830,11 +2417,20 @@ void Executor::executeCall(ExecutionState &state, KInstruction *ki, Function *f,
   }
 
   if (f->getName().equals("__INSTR_check_nontermination_header")) {
+    if (RevisitedLoopHeads != RevisitedLoopHeadPolicy::Ignore &&
+        checkRevisitedLoopHead(state, ki))
+      return;
     state.lastLoopHead = ki->inst;
     state.lastLoopHeadId = state.nondetValues.size();
     return;
   }
 
+  if (f && specialFunctionHandler->handleFastPath(state, f, ki, arguments)) {
+    if (InvokeInst *ii = dyn_cast<InvokeInst>(i))
+      transferToBasicBlock(ii->getNormalDest(), i->getParent(), state);
+    return;
+  }
+
   if (f && f->isDeclaration()) {
     switch (f->getIntrinsicID()) {
     case Intrinsic::not_intrinsic: {
@@ -1843,17 +2439,14 @@ void Executor::executeCall(ExecutionState &state, KInstruction *ki, Function *f,
       break;
     }
     case Intrinsic::fabs: {
-      ref<ConstantExpr> arg =
-          toConstant(state, arguments[0].value, "floating point");
+      ref<Expr> arg = arguments[0].value;
       if (!fpWidthToSemantics(arg->getWidth()))
         return terminateStateOnExecError(
             state, "Unsupported intrinsic llvm.fabs call");
 
-      llvm::APFloat Res(*fpWidthToSemantics(arg->getWidth()),
-                        arg->getAPValue());
-      Res = llvm::abs(Res);
-
-      bindLocal(ki, state, ConstantExpr::alloc(Res.bitcastToAPInt()));
+      arg = toFloatOperand(state, arg, arg->getWidth());
+      llvm::APInt mask = ~llvm::APInt::getSignMask(arg->getWidth());
+      bindLocal(ki, state, AndExpr::create(arg, ConstantExpr::alloc(mask)));
       break;
     }
 
@@ -1987,7 +2580,7 @@ void Executor::executeCall(ExecutionState &state, KInstruction *ki, Function *f,
     // va_arg is handled by caller and intrinsic lowering, see comment for
     // ExecutionState::varargs
     case Intrinsic::vastart: {
-      StackFrame &sf = state.stack.back();
+      const StackFrame &sf = state.stack.back();
 
       // varargs can be zero if no varargs were provided
       if (!sf.varargs)
@@ -2065,11 +2658,37 @@ void Executor::executeCall(ExecutionState &state, KInstruction *ki, Function *f,
       return;
     }
 
+    // a call of a memoizable function on concrete inputs is answered from
+    // the earlier calls with the same inputs, or its result recorded once it
+    // returns
+    if (!kmodule->memoizableFunctions.empty() && !state.hasOtherThreads() &&
+        i->getType() == f->getReturnType()) {
+      auto memoizable = kmodule->memoizableFunctions.find(f);
+      auto memoKey = std::make_pair(f, std::vector<uint64_t>());
+      if (memoizable != kmodule->memoizableFunctions.end() &&
+          getMemoKey(state, f, memoizable->second, arguments,
+                     memoKey.second)) {
+        auto memoized = memoizedResults.find(memoKey);
+        if (memoized != memoizedResults.end()) {
+          ++stats::memoizedCallHits;
+          bindLocal(ki, state, memoized->second);
+          if (InvokeInst *ii = dyn_cast<InvokeInst>(i))
+            transferToBasicBlock(ii->getNormalDest(), i->getParent(), state);
+          return;
+        }
+        state.pendingMemos.push_back({state.stack.size() + 1,
+                                      state.constraints.size(),
+                                      state.constraints.hash(), f,
+                                      std::move(memoKey.second)});
+      }
+    }
+
     // FIXME: I'm not really happy about this reliance on prevPC but it is ok, I
     // guess. This just done to avoid having to pass KInstIterator everywhere
     // instead of the actual instruction, since we can't make a KInstIterator
     // from just an instruction (unlike LLVM).
     KFunction *kf = kmodule->functionMap[f];
+    kmodule->resolveInfos(kf);
 
     state.pushFrame(state.prevPC, kf);
     state.pc = kf->instructions;
@@ -2147,10 +2766,13 @@ void Executor::executeCall(ExecutionState &state, KInstruction *ki, Function *f,
         }
       }
 
-      StackFrame &sf = state.stack.back();
+      // without variadic arguments there is no object, as va_start then
+      // leaves the list alone
+      StackFrame &sf = state.stack.getWriteableBack();
       MemoryObject *mo = sf.varargs =
-          memory->allocate(size, true, false, state.prevPC->inst,
-                           (requires16ByteAlignment ? 16 : 8));
+          size ? memory->allocate(size, true, false, state.prevPC->inst,
+                                  (requires16ByteAlignment ? 16 : 8))
+               : nullptr;
       if (!mo && size) {
         terminateStateOnExecError(state, "out of memory (varargs)");
         return;
@@ -2189,6 +2811,58 @@ void Executor::executeCall(ExecutionState &state, KInstruction *ki, Function *f,
   }
 }
 
+bool Executor::getMemoKey(
+    ExecutionState &state, const Function *f,
+    const std::vector<const GlobalVariable *> &globals,
+    const std::vector<Cell> &arguments, std::vector<uint64_t> &key) const {
+  uint64_t bytes = 0;
+  // appends the size and the contents of os, 8 bytes per word
+  auto appendContents = [&](const ObjectState *os) {
+    auto size = dyn_cast<ConstantExpr>(os->getObject()->size);
+    if (!size || size->getZExtValue() > MemoizeCallsMaxBytes - bytes)
+      return false;
+    unsigned n = size->getZExtValue();
+    bytes += n;
+    std::vector<uint8_t> contents(llvm::alignTo(n, 8));
+    if (!os->readConcrete(0, n, contents.data()))
+      return false;
+    key.push_back(n);
+    for (unsigned k = 0; k < contents.size(); k += 8) {
+      uint64_t word;
+      std::memcpy(&word, &contents[k], sizeof(word));
+      key.push_back(word);
+    }
+    return true;
+  };
+
+  for (unsigned k = 0; k < f->arg_size(); ++k) {
+    const Cell &arg = arguments[k];
+    if (!arg.isConstant() || arg.getWidth() > Expr::Int64)
+      return false;
+    uint64_t segment = cast<klee::ConstantExpr>(arg.getSegment())->getZExtValue();
+    uint64_t value = cast<klee::ConstantExpr>(arg.getValue())->getZExtValue();
+    key.push_back(segment);
+    key.push_back(value);
+    if (!f->getArg(k)->getType()->isPointerTy() || (!segment && !value))
+      continue;
+
+    ObjectPair op;
+    if (!segment || !state.addressSpace.resolveOneConstantSegment(arg, op) ||
+        !appendContents(op.second))
+      return false;
+  }
+
+  for (const GlobalVariable *gv : globals) {
+    auto it = globalObjects.find(gv);
+    if (it == globalObjects.end())
+      return false;
+    const ObjectState *os = state.addressSpace.findObject(it->second);
+    if (!os || !appendContents(os))
+      return false;
+  }
+  return true;
+}
+
 void Executor::transferToBasicBlock(BasicBlock *dst, BasicBlock *src, 
                                     ExecutionState &state) {
   // Note that in general phi nodes can reuse phi values from the same
@@ -2203,14 +2877,92 @@ void Executor::transferToBasicBlock(BasicBlock *dst, BasicBlock *src,
   // With that done we simply set an index in the state so that PHI
   // instructions know which argument to eval, set the pc, and continue.
   
-  // XXX this lookup has to go ?
   KFunction *kf = state.stack.back().kf;
-  unsigned entry = kf->basicBlockEntry[dst];
+  unsigned entry = kf->getBasicBlockEntry(dst);
   state.pc = &kf->instructions[entry];
-  if (state.pc->inst->getOpcode() == Instruction::PHI) {
+  if (state.pc->opcode == Instruction::PHI) {
     PHINode *first = static_cast<PHINode*>(state.pc->inst);
     state.incomingBBIndex = first->getBasicBlockIndex(src);
   }
+
+  if (!kmodule->loopSummaries.empty()) {
+    auto it = kmodule->loopSummaries.find(dst);
+    if (it != kmodule->loopSummaries.end() && it->second.enteredFrom == src)
+      summarizeLoop(state, it->second);
+  }
+}
+
+void Executor::summarizeLoop(ExecutionState &state,
+                             const LoopSummary &summary) {
+  KFunction *kf = state.stack.back().kf;
+  // the values entering the loop and the steps, which may not be pointers
+  std::vector<ref<Expr>> initial, steps;
+  for (const auto &r : summary.recurrences) {
+    const Cell &init = eval(kf->getKInstruction(r.phi),
+                            state.incomingBBIndex, state);
+    const Cell &step =
+        eval(kf->getKInstruction(r.update), r.stepOperand, state);
+    if (!init.isSegmentZero() || !step.isSegmentZero())
+      return;
+    initial.push_back(init.value);
+    if (r.subtract)
+      steps.push_back(SubExpr::create(
+          ConstantExpr::create(0, step.value->getWidth()), step.value));
+    else
+      steps.push_back(step.value);
+  }
+  const Cell &boundCell =
+      eval(kf->getKInstruction(summary.test), summary.boundOperand, state);
+  if (!boundCell.isSegmentZero())
+    return;
+  ref<Expr> bound = boundCell.value;
+
+  // the value of the counter in the first test
+  ref<Expr> base = initial[summary.counter];
+  if (summary.testsNext)
+    base = AddExpr::create(base, steps[summary.counter]);
+
+  // the number of tests passed, which the loop only depends on if it
+  // passes the first one
+  ref<Expr> entered;
+  ref<Expr> passed = summary.counterIncreases ? SubExpr::create(bound, base)
+                                              : SubExpr::create(base, bound);
+  switch (summary.continueWhile) {
+  case LoopSummary::Test::NotEqual:
+    break;
+  case LoopSummary::Test::SignedLess:
+    entered = SltExpr::create(base, bound);
+    break;
+  case LoopSummary::Test::UnsignedLess:
+    entered = UltExpr::create(base, bound);
+    break;
+  case LoopSummary::Test::SignedGreater:
+    entered = SgtExpr::create(base, bound);
+    break;
+  case LoopSummary::Test::UnsignedGreater:
+    entered = UgtExpr::create(base, bound);
+    break;
+  }
+
+  ExecutionState *summarized = &state;
+  if (!entered.isNull()) {
+    summarized =
+        fork(state, entered, false, BranchType::ConditionalBranch).first;
+    if (!summarized)
+      return;
+  }
+
+  for (unsigned i = 0; i < summary.recurrences.size(); ++i) {
+    const auto &r = summary.recurrences[i];
+    ref<Expr> count = ZExtExpr::create(passed, initial[i]->getWidth());
+    ref<Expr> last =
+        AddExpr::create(initial[i], MulExpr::create(count, steps[i]));
+    if (summary.exitsAtLatch)
+      bindLocal(kf->getKInstruction(r.update), *summarized,
+                KValue(AddExpr::create(last, steps[i])));
+    bindLocal(kf->getKInstruction(r.phi), *summarized, KValue(last));
+  }
+  transferToBasicBlock(summary.exit, summary.exiting, *summarized);
 }
 
 /// Compute the true target of a function call, resolving LLVM aliases
@@ -2258,56 +3010,323 @@ ref<Expr> Executor::getSizeForAlloca(ExecutionState& state, KInstruction *ki) co
 
 static inline bool segmentIsDeleted(ExecutionState& state,
                                     ref<klee::ConstantExpr> segment) {
-  auto& removedObjs = state.addressSpace.removedObjectsMap;
-  return removedObjs.find(segment->getZExtValue()) != removedObjs.end();
+  return state.addressSpace.removedObjectsMap.count(segment->getZExtValue()) > 0;
 }
 
 
-void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
-  Instruction *i = ki->inst;
-  switch (i->getOpcode()) {
-    // Control flow
-  case Instruction::Ret: {
-    ReturnInst *ri = cast<ReturnInst>(i);
-    KInstIterator kcaller = state.stack.back().caller;
-    Instruction *caller = kcaller ? kcaller->inst : nullptr;
-    bool isVoidReturn = (ri->getNumOperands() == 0);
-    KValue result(ConstantExpr::alloc(0, Expr::Bool));
-    
-    if (!isVoidReturn) {
-      result = eval(ki, 0, state);
-    }
-    
-    if (state.stack.size() <= 1) {
-      assert(!caller && "caller set on initial stack frame");
-      // there is no other instruction to execute
-      state.pc = {0};
-      terminateStateOnExit(state);
-    } else {
-      state.popFrame();
+/// Sign-extends the low width bits of value.
+static int64_t signExtend(uint64_t value, Expr::Width width) {
+  return width == 64 ? (int64_t)value
+                     : (int64_t)(value << (64 - width)) >> (64 - width);
+}
 
-      if (statsTracker)
-        statsTracker->framePopped(state);
+static uint64_t truncateToWidth(uint64_t value, Expr::Width width) {
+  return width == 64 ? value : value & ((UINT64_C(1) << width) - 1);
+}
 
-      if (InvokeInst *ii = dyn_cast<InvokeInst>(caller)) {
-        transferToBasicBlock(ii->getNormalDest(), caller->getParent(), state);
-      } else {
-        state.pc = kcaller;
-        ++state.pc;
-      }
+/// Returns the constant value of cell if it is a concrete non-pointer value
+/// of at most 64 bits.
+static const klee::ConstantExpr *getConcreteValue(const Cell &cell) {
+  auto *CE = dyn_cast_or_null<klee::ConstantExpr>(cell.value);
+  if (!CE || CE->getWidth() > Expr::Int64 || !cell.isSegmentZero())
+    return nullptr;
+  return CE;
+}
 
-#ifdef SUPPORT_KLEE_EH_CXX
-      if (ri->getFunction()->getName() == "_klee_eh_cxx_personality") {
-        assert(dyn_cast<ConstantExpr>(result) &&
-               "result from personality fn must be a concrete value");
+namespace {
+/// A vector taken from a pool, which is cleared and given back to the pool
+/// at the end of the scope.
+template <typename T> class PooledVector {
+  std::vector<std::vector<T>> &pool;
+  std::vector<T> vector;
+
+public:
+  explicit PooledVector(std::vector<std::vector<T>> &pool) : pool(pool) {
+    if (!pool.empty()) {
+      vector = std::move(pool.back());
+      pool.pop_back();
+    }
+  }
+  PooledVector(const PooledVector &) = delete;
+  PooledVector &operator=(const PooledVector &) = delete;
+  ~PooledVector() {
+    vector.clear();
+    pool.push_back(std::move(vector));
+  }
 
-        auto *sui = dyn_cast_or_null<SearchPhaseUnwindingInformation>(
-            state.unwindingInformation.get());
-        assert(sui && "return from personality function outside of "
-                      "search phase unwinding");
+  std::vector<T> &operator*() { return vector; }
+};
+} // namespace
 
-        // unbind the MO we used to pass the serialized landingpad
-        state.addressSpace.unbindObject(sui->serializedLandingpad);
+bool Executor::executeConcreteInstruction(ExecutionState &state,
+                                          KInstruction *ki) {
+  unsigned opcode = ki->opcode;
+
+  switch (ki->kind) {
+  case KInstruction::IntBinary: {
+    const klee::ConstantExpr *left = getConcreteValue(eval(ki, 0, state));
+    if (!left)
+      return false;
+    const klee::ConstantExpr *right = getConcreteValue(eval(ki, 1, state));
+    if (!right)
+      return false;
+    Expr::Width width = ki->width;
+    uint64_t a = left->getZExtValue(), b = right->getZExtValue(), result;
+    switch (opcode) {
+    case Instruction::Add: result = a + b; break;
+    case Instruction::Sub: result = a - b; break;
+    case Instruction::Mul: result = a * b; break;
+    case Instruction::And: result = a & b; break;
+    case Instruction::Or: result = a | b; break;
+    case Instruction::Xor: result = a ^ b; break;
+    // division by zero, signed overflow and overshifts keep the semantics
+    // of the expression builders
+    case Instruction::UDiv:
+      if (b == 0)
+        return false;
+      result = a / b;
+      break;
+    case Instruction::URem:
+      if (b == 0)
+        return false;
+      result = a % b;
+      break;
+    case Instruction::SDiv:
+    case Instruction::SRem: {
+      int64_t sa = signExtend(a, width), sb = signExtend(b, width);
+      if (sb == 0 || (sb == -1 && sa == signExtend(UINT64_C(1) << (width - 1),
+                                                   width)))
+        return false;
+      result = opcode == Instruction::SDiv ? sa / sb : sa % sb;
+      break;
+    }
+    case Instruction::Shl:
+      if (b >= width)
+        return false;
+      result = a << b;
+      break;
+    case Instruction::LShr:
+      if (b >= width)
+        return false;
+      result = a >> b;
+      break;
+    case Instruction::AShr:
+      if (b >= width)
+        return false;
+      result = signExtend(a, width) >> b;
+      break;
+    default:
+      return false;
+    }
+    bindLocal(ki, state,
+              KValue(ConstantExpr::alloc(truncateToWidth(result, width), width)));
+    return true;
+  }
+
+  case KInstruction::IntCompare: {
+    const klee::ConstantExpr *left = getConcreteValue(eval(ki, 0, state));
+    if (!left)
+      return false;
+    const klee::ConstantExpr *right = getConcreteValue(eval(ki, 1, state));
+    if (!right)
+      return false;
+    Expr::Width width = left->getWidth();
+    uint64_t a = left->getZExtValue(), b = right->getZExtValue();
+    int64_t sa = signExtend(a, width), sb = signExtend(b, width);
+    bool result;
+    switch (ki->predicate) {
+    case ICmpInst::ICMP_EQ: result = a == b; break;
+    case ICmpInst::ICMP_NE: result = a != b; break;
+    case ICmpInst::ICMP_UGT: result = a > b; break;
+    case ICmpInst::ICMP_UGE: result = a >= b; break;
+    case ICmpInst::ICMP_ULT: result = a < b; break;
+    case ICmpInst::ICMP_ULE: result = a <= b; break;
+    case ICmpInst::ICMP_SGT: result = sa > sb; break;
+    case ICmpInst::ICMP_SGE: result = sa >= sb; break;
+    case ICmpInst::ICMP_SLT: result = sa < sb; break;
+    case ICmpInst::ICMP_SLE: result = sa <= sb; break;
+    default:
+      return false;
+    }
+    bindLocal(ki, state, KValue(ConstantExpr::alloc(result, Expr::Bool)));
+    return true;
+  }
+
+  case KInstruction::IntCast: {
+    const klee::ConstantExpr *value = getConcreteValue(eval(ki, 0, state));
+    if (!value)
+      return false;
+    Expr::Width width = ki->width;
+    uint64_t result = value->getZExtValue();
+    if (opcode == Instruction::SExt)
+      result = signExtend(result, value->getWidth());
+    bindLocal(ki, state,
+              KValue(ConstantExpr::alloc(truncateToWidth(result, width), width)));
+    return true;
+  }
+  case KInstruction::Generic:
+    return false;
+  }
+  return false;
+}
+
+void Executor::executeBranch(ExecutionState &state, KInstruction *ki,
+                             const ref<Expr> &cond) {
+  BranchInst *bi = cast<BranchInst>(ki->inst);
+  Executor::StatePair branches = fork(state, cond, false, BranchType::ConditionalBranch);
+
+  // NOTE: There is a hidden dependency here, markBranchVisited
+  // requires that we still be in the context of the branch
+  // instruction (it reuses its statistic id). Should be cleaned
+  // up with convenient instruction specific data.
+  if (statsTracker && state.stack.back().kf->trackCoverage)
+    statsTracker->markBranchVisited(branches.first, branches.second);
+
+  if (branches.first)
+    transferToBasicBlock(bi->getSuccessor(0), bi->getParent(), *branches.first);
+  if (branches.second)
+    transferToBasicBlock(bi->getSuccessor(1), bi->getParent(), *branches.second);
+}
+
+bool Executor::parkAtBranch(ExecutionState &state, KInstruction *ki,
+                            const ref<Expr> &cond) {
+  // only worth it if other states can run in the meantime: the states after
+  // this step, less those waiting for an answer and this one
+  if (!asyncBranches || asyncBranches->full() || !searcher ||
+      isa<ConstantExpr>(cond) || seedMap.count(&state) ||
+      states.size() + addedStates.size() - removedStates.size() <=
+          asyncBranches->size() + 1)
+    return false;
+
+  state.pendingBranch = std::make_unique<ExecutionState::PendingBranch>();
+  state.pendingBranch->ki = ki;
+  state.pendingBranch->condition = cond;
+  if (!asyncBranches->start(state, [&](Solver::Validity &res) {
+        return solveBranch(state, cond, branchSolverTimeout, res);
+      })) {
+    state.pendingBranch.reset();
+    return false;
+  }
+  // the state waits at the branch, the searchers weigh it there when it
+  // is resumed
+  state.pc = state.prevPC;
+  parkedStates.push_back(&state);
+  ++stats::asyncBranchQueries;
+  return true;
+}
+
+void Executor::resumeParkedStates(bool wait) {
+  std::vector<ExecutionState *> answered;
+  if (wait)
+    reclaimStates(reclaimedStates.size());
+  asyncBranches->collect(wait, answered);
+  if (!answered.empty())
+    searcher->update(nullptr, answered, std::vector<ExecutionState *>());
+}
+
+bool Executor::executeNativeChecks(ExecutionState &state, KInstruction *ki) {
+  ref<Expr> right = eval(ki, 1, state).value;
+  ref<Expr> passes;
+  const char *message, *suffix;
+  if (ki->checks & KInstruction::CheckDivZero) {
+    passes = NeExpr::create(right, ConstantExpr::create(0, right->getWidth()));
+    message = "divide by zero";
+    suffix = "div.err";
+  } else {
+    passes = UltExpr::create(
+        right, ConstantExpr::create(right->getWidth(), right->getWidth()));
+    message = "overshift error";
+    suffix = "overshift.err";
+  }
+
+  // constant operands need no branch
+  if (ConstantExpr *CE = dyn_cast<ConstantExpr>(passes)) {
+    if (CE->isTrue())
+      return true;
+    terminateStateOnError(state, message, StateTerminationType::ReportError,
+                          "", suffix);
+    return false;
+  }
+
+  // the current state continues on the passing side
+  StatePair branches = fork(state, passes, true, BranchType::Check);
+  if (branches.second)
+    terminateStateOnError(*branches.second, message,
+                          StateTerminationType::ReportError, "", suffix);
+  return branches.first != nullptr;
+}
+
+void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
+  if (executeConcreteInstruction(state, ki)) {
+    ++stats::concreteInstructions;
+    return;
+  }
+
+  Instruction *i = ki->inst;
+  switch (ki->opcode) {
+    // Control flow
+  case Instruction::Ret: {
+    ReturnInst *ri = cast<ReturnInst>(i);
+    KInstIterator kcaller = state.stack.back().caller;
+    Instruction *caller = kcaller ? kcaller->inst : nullptr;
+    bool isVoidReturn = (ri->getNumOperands() == 0);
+    KValue result(ConstantExpr::alloc(0, Expr::Bool));
+    
+    if (!isVoidReturn) {
+      result = eval(ki, 0, state);
+    }
+    
+    if (state.stack.size() <= 1 && state.currentThread != 0) {
+      // the start routine of a thread returned
+      state.pc = state.prevPC;
+      exitThread(state, result);
+    } else if (state.stack.size() <= 1) {
+      assert(!caller && "caller set on initial stack frame");
+      // there is no other instruction to execute
+      state.pc = {0};
+      terminateStateOnExit(state);
+    } else {
+      // record the result of a memoizable call, the calls left by unwinding
+      // are dropped
+      while (!state.pendingMemos.empty() &&
+             state.pendingMemos.back().stackSize >= state.stack.size()) {
+        auto &memo = state.pendingMemos.back();
+        if (memo.stackSize == state.stack.size() && result.isConstant() &&
+            memo.constraints == state.constraints.size() &&
+            memo.constraintsHash == state.constraints.hash() &&
+            memoizedResults.size() < MemoizeCallsMaxEntries &&
+            memoizedResults
+                .emplace(std::make_pair(memo.function, std::move(memo.key)),
+                         result)
+                .second)
+          ++stats::memoizedCallsRecorded;
+        state.pendingMemos.pop_back();
+      }
+
+      state.popFrame();
+
+      if (statsTracker)
+        statsTracker->framePopped(state);
+
+      if (InvokeInst *ii = dyn_cast<InvokeInst>(caller)) {
+        transferToBasicBlock(ii->getNormalDest(), caller->getParent(), state);
+      } else {
+        state.pc = kcaller;
+        ++state.pc;
+      }
+
+#ifdef SUPPORT_KLEE_EH_CXX
+      if (ri->getFunction()->getName() == "_klee_eh_cxx_personality") {
+        assert(dyn_cast<ConstantExpr>(result) &&
+               "result from personality fn must be a concrete value");
+
+        auto *sui = dyn_cast_or_null<SearchPhaseUnwindingInformation>(
+            state.unwindingInformation.get());
+        assert(sui && "return from personality function outside of "
+                      "search phase unwinding");
+
+        // unbind the MO we used to pass the serialized landingpad
+        state.addressSpace.unbindObject(sui->serializedLandingpad);
         sui->serializedLandingpad = nullptr;
 
         if (result->isZero()) {
@@ -2375,19 +3394,8 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
       ref<Expr> cond = eval(ki, 0, state).value;
 
       cond = optimizer.optimizeExpr(cond, false);
-      Executor::StatePair branches = fork(state, cond, false, BranchType::ConditionalBranch);
-
-      // NOTE: There is a hidden dependency here, markBranchVisited
-      // requires that we still be in the context of the branch
-      // instruction (it reuses its statistic id). Should be cleaned
-      // up with convenient instruction specific data.
-      if (statsTracker && state.stack.back().kf->trackCoverage)
-        statsTracker->markBranchVisited(branches.first, branches.second);
-
-      if (branches.first)
-        transferToBasicBlock(bi->getSuccessor(0), bi->getParent(), *branches.first);
-      if (branches.second)
-        transferToBasicBlock(bi->getSuccessor(1), bi->getParent(), *branches.second);
+      if (!parkAtBranch(state, ki, cond))
+        executeBranch(state, ki, cond);
     }
     break;
   }
@@ -2498,67 +3506,94 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
         expressionOrder.insert(std::make_pair(value, caseSuccessor));
       }
 
+      // with --fast-forward-seeds, only the successor of the seeds is taken
+      BasicBlock *seedsSuccessor = nullptr;
+      ref<ConstantExpr> seedsValue;
+      if (getSeedsValue(state, cond, seedsValue)) {
+        llvm::IntegerType *Ty = cast<IntegerType>(si->getCondition()->getType());
+        ConstantInt *ci = ConstantInt::get(Ty, seedsValue->getZExtValue());
+        seedsSuccessor = si->findCaseValue(ci)->getCaseSuccessor();
+      }
+
       // Track default branch values
       ref<Expr> defaultValue = ConstantExpr::alloc(1, Expr::Bool);
 
       // iterate through all non-default cases but in order of the expressions
+      std::vector<BasicBlock *> targets;
       for (std::map<ref<Expr>, BasicBlock *>::iterator
                it = expressionOrder.begin(),
                itE = expressionOrder.end();
            it != itE; ++it) {
-        ref<Expr> match = EqExpr::create(cond, it->first);
-
         // skip if case has same successor basic block as default case
         // (should work even with phi nodes as a switch is a single terminating instruction)
         if (it->second == si->getDefaultDest()) continue;
 
+        ref<Expr> match = EqExpr::create(cond, it->first);
+
         // Make sure that the default value does not contain this target's value
         defaultValue = AndExpr::create(defaultValue, Expr::createIsZero(match));
 
-        // Check if control flow could take this case
-        bool result;
-        match = optimizer.optimizeExpr(match, false);
-        bool success = solver->mayBeTrue(state.constraints, match, result,
-                                         state.queryMetaData);
-        assert(success && "FIXME: Unhandled solver failure");
-        (void) success;
-        if (result) {
-          BasicBlock *caseSuccessor = it->second;
-
-          // Handle the case that a basic block might be the target of multiple
-          // switch cases.
-          // Currently we generate an expression containing all switch-case
-          // values for the same target basic block. We spare us forking too
-          // many times but we generate more complex condition expressions
-          // TODO Add option to allow to choose between those behaviors
-          std::pair<std::map<BasicBlock *, ref<Expr> >::iterator, bool> res =
-              branchTargets.insert(std::make_pair(
-                  caseSuccessor, ConstantExpr::alloc(0, Expr::Bool)));
-
-          res.first->second = OrExpr::create(match, res.first->second);
-
-          // Only add basic blocks which have not been target of a branch yet
-          if (res.second) {
-            bbOrder.push_back(caseSuccessor);
-          }
+        // Handle the case that a basic block might be the target of multiple
+        // switch cases.
+        // Currently we generate an expression containing all switch-case
+        // values for the same target basic block. We spare us forking too
+        // many times but we generate more complex condition expressions
+        // TODO Add option to allow to choose between those behaviors
+        std::pair<std::map<BasicBlock *, ref<Expr> >::iterator, bool> res =
+            branchTargets.insert(std::make_pair(
+                it->second, ConstantExpr::alloc(0, Expr::Bool)));
+
+        res.first->second = OrExpr::create(match, res.first->second);
+
+        // Only add basic blocks which have not been target of a branch yet
+        if (res.second) {
+          targets.push_back(it->second);
         }
       }
-
-      // Check if control could take the default case
-      defaultValue = optimizer.optimizeExpr(defaultValue, false);
-      bool res;
-      bool success = solver->mayBeTrue(state.constraints, defaultValue, res,
-                                       state.queryMetaData);
-      assert(success && "FIXME: Unhandled solver failure");
-      (void) success;
-      if (res) {
-        std::pair<std::map<BasicBlock *, ref<Expr> >::iterator, bool> ret =
-            branchTargets.insert(
-                std::make_pair(si->getDefaultDest(), defaultValue));
-        if (ret.second) {
-          bbOrder.push_back(si->getDefaultDest());
+      branchTargets[si->getDefaultDest()] = defaultValue;
+      targets.push_back(si->getDefaultDest());
+      for (auto &target : branchTargets)
+        target.second = optimizer.optimizeExpr(target.second, false);
+
+      // Every model of the condition takes a feasible target, whose values
+      // are excluded from the next query. This costs a query per feasible
+      // target rather than per case, and each model is usually found in the
+      // counterexample cache of the preceding mayBeTrue query.
+      std::set<BasicBlock *> feasibleTargets;
+      if (seedsSuccessor) {
+        feasibleTargets.insert(seedsSuccessor);
+      } else {
+        llvm::IntegerType *Ty = cast<IntegerType>(si->getCondition()->getType());
+        ConstraintSet unexploredConstraints(state.constraints);
+        ConstraintManager cm(unexploredConstraints);
+        ref<Expr> unexplored = ConstantExpr::alloc(1, Expr::Bool);
+        ref<Expr> excluded;
+        while (feasibleTargets.size() < targets.size()) {
+          if (!feasibleTargets.empty()) {
+            bool result;
+            bool success = solver->mayBeTrue(state.constraints, unexplored,
+                                             result, state.queryMetaData);
+            assert(success && "FIXME: Unhandled solver failure");
+            (void) success;
+            if (!result)
+              break;
+            cm.addConstraint(excluded);
+          }
+          ref<ConstantExpr> value;
+          bool success = solver->getValue(unexploredConstraints, cond, value,
+                                          state.queryMetaData);
+          assert(success && "FIXME: Unhandled solver failure");
+          (void) success;
+          ConstantInt *ci = ConstantInt::get(Ty, value->getZExtValue());
+          BasicBlock *target = si->findCaseValue(ci)->getCaseSuccessor();
+          feasibleTargets.insert(target);
+          excluded = Expr::createIsZero(branchTargets[target]);
+          unexplored = AndExpr::create(unexplored, excluded);
         }
       }
+      for (BasicBlock *target : targets)
+        if (feasibleTargets.count(target))
+          bbOrder.push_back(target);
 
       // Fork the current state with each state having one of the possible
       // successors of this switch
@@ -2602,8 +3637,10 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
     unsigned numArgs = cb.arg_size();
     Function *f = getTargetFunction(fp, state);
 
-    // evaluate arguments
-    std::vector<Cell> arguments;
+    // evaluate arguments into a pooled vector, which handlers calling back
+    // into the executor may take another one from
+    PooledVector<Cell> pooledArguments(argumentPool);
+    std::vector<Cell> &arguments = *pooledArguments;
     arguments.reserve(numArgs);
 
     for (unsigned j=0; j<numArgs; ++j)
@@ -2753,6 +3790,8 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   }
 
   case Instruction::UDiv: {
+    if (ki->checks && !executeNativeChecks(state, ki))
+      break;
     const Cell &left = eval(ki, 0, state);
     const Cell &right = eval(ki, 1, state);
     bindLocal(ki, state, left.UDiv(right));
@@ -2760,6 +3799,8 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   }
 
   case Instruction::SDiv: {
+    if (ki->checks && !executeNativeChecks(state, ki))
+      break;
     const Cell &left = eval(ki, 0, state);
     const Cell &right = eval(ki, 1, state);
     bindLocal(ki, state, left.SDiv(right));
@@ -2767,6 +3808,8 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   }
 
   case Instruction::URem: {
+    if (ki->checks && !executeNativeChecks(state, ki))
+      break;
     const Cell &left = eval(ki, 0, state);
     const Cell &right = eval(ki, 1, state);
     bindLocal(ki, state, left.URem(right));
@@ -2774,6 +3817,8 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   }
 
   case Instruction::SRem: {
+    if (ki->checks && !executeNativeChecks(state, ki))
+      break;
     const Cell &left = eval(ki, 0, state);
     const Cell &right = eval(ki, 1, state);
     bindLocal(ki, state, left.SRem(right));
@@ -2802,6 +3847,8 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   }
 
   case Instruction::Shl: {
+    if (ki->checks && !executeNativeChecks(state, ki))
+      break;
     const Cell &left = eval(ki, 0, state);
     const Cell &right = eval(ki, 1, state);
     bindLocal(ki, state, left.Shl(right));
@@ -2809,6 +3856,8 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   }
 
   case Instruction::LShr: {
+    if (ki->checks && !executeNativeChecks(state, ki))
+      break;
     const Cell &left = eval(ki, 0, state);
     const Cell &right = eval(ki, 1, state);
     bindLocal(ki, state, left.LShr(right));
@@ -2816,6 +3865,8 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   }
 
   case Instruction::AShr: {
+    if (ki->checks && !executeNativeChecks(state, ki))
+      break;
     const Cell &left = eval(ki, 0, state);
     const Cell &right = eval(ki, 1, state);
     bindLocal(ki, state, left.AShr(right));
@@ -2850,6 +3901,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
       }
 
       if (leftSegment && rightSegment) {
+        const MemoryObject *leftObject = nullptr, *rightObject = nullptr;
         bool leftDeleted = segmentIsDeleted(state, leftSegment);
         bool rightDeleted = segmentIsDeleted(state, rightSegment);
         // some of the segments is deleted or
@@ -2864,44 +3916,50 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
           if (!leftSegment->isZero()) {
             bool success = state.addressSpace.resolveOneConstantSegment(left, lookupResult);
             if (!success) {
-              auto& removedObjs = state.addressSpace.removedObjectsMap;
-              auto removedIt = removedObjs.find(leftSegment->getZExtValue());
-              if (removedIt == removedObjs.end()) {
+              const auto *removedIt =
+                  state.addressSpace.removedObjectsMap.lookup(leftSegment->getZExtValue());
+              if (!removedIt) {
                 terminateStateOnExecError(state,
                                           "Failed resolving constant segment");
                 break;
               }
 
-              left = KValue(ConstantExpr::alloc(VALUES_SEGMENT,
-                                                leftSegment->getWidth()),
-                            removedIt->second);
+              left = KValue(KValue::getSegmentConstant(VALUES_SEGMENT,
+                                                         leftSegment->getWidth()),
+                            AddExpr::create(removedIt->second,
+                                            left.getOffset()));
             } else {
-              // FIXME: we should assert that the address does not overlap with any of the
-              // currently allocated objects...
-              left = KValue(ConstantExpr::alloc(VALUES_SEGMENT, leftSegment->getWidth()),
-                            const_cast<MemoryObject*>(lookupResult.first)->getSymbolicAddress(arrayCache));
+              leftObject = lookupResult.first;
+              left = KValue(KValue::getSegmentConstant(VALUES_SEGMENT, leftSegment->getWidth()),
+                            AddExpr::create(const_cast<MemoryObject*>(lookupResult.first)->getSymbolicAddress(arrayCache),
+                                            left.getOffset()));
             }
           }
           // right is a pointer (and left is not a null?)
           if (!rightSegment->isZero()) {
             bool success = state.addressSpace.resolveOneConstantSegment(right, lookupResult);
             if (!success) {
-              auto& removedObjs = state.addressSpace.removedObjectsMap;
-              auto removedIt = removedObjs.find(rightSegment->getZExtValue());
-              if (removedIt == removedObjs.end()) {
+              const auto *removedIt =
+                  state.addressSpace.removedObjectsMap.lookup(rightSegment->getZExtValue());
+              if (!removedIt) {
                 terminateStateOnExecError(state,
                                           "Failed resolving constant segment");
                 break;
               }
-              right = KValue(ConstantExpr::alloc(VALUES_SEGMENT,
-                                                 rightSegment->getWidth()),
-                             removedIt->second);
+              right = KValue(KValue::getSegmentConstant(VALUES_SEGMENT,
+                                                          rightSegment->getWidth()),
+                             AddExpr::create(removedIt->second,
+                                             right.getOffset()));
 
             } else {
-              right = KValue(ConstantExpr::alloc(VALUES_SEGMENT, rightSegment->getWidth()),
-                             const_cast<MemoryObject*>(lookupResult.first)->getSymbolicAddress(arrayCache));
+              rightObject = lookupResult.first;
+              right = KValue(KValue::getSegmentConstant(VALUES_SEGMENT, rightSegment->getWidth()),
+                             AddExpr::create(const_cast<MemoryObject*>(lookupResult.first)->getSymbolicAddress(arrayCache),
+                                             right.getOffset()));
             }
           }
+          if (leftObject || rightObject)
+            addSymbolicAddressAxioms(state, leftObject, rightObject);
         }
       }
     }
@@ -2947,6 +4005,8 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   case Instruction::Store: {
     const Cell &baseCell = eval(ki, 1, state);
     const Cell &valueCell = eval(ki, 0, state);
+    if (ki->fillsNondet)
+      noteNondetFill(state, ki, baseCell);
     executeMemoryWrite(state, baseCell, valueCell);
     break;
   }
@@ -2956,13 +4016,40 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
     KValue base = eval(ki, 0, state);
     Expr::Width pointerWidth = Context::get().getPointerWidth();
 
-    for (std::vector< std::pair<unsigned, uint64_t> >::iterator 
-           it = kgepi->indices.begin(), ie = kgepi->indices.end(); 
-         it != ie; ++it) {
-      uint64_t elementSize = it->second;
-      KValue index = eval(ki, it->first, state);
+    // the offset is added as one linear form of the indices, into which
+    // that of a base computed by another GEP is folded
+    std::vector<std::pair<ref<Expr>, uint64_t>> terms;
+    uint64_t constantOffset = kgepi->offset;
+    bool linear = true;
+    for (const auto &index : kgepi->indices) {
+      const KValue &value = eval(ki, index.first, state);
+      if (!value.isSegmentZero()) {
+        linear = false;
+        break;
+      }
+      ref<Expr> extended = SExtExpr::create(value.value, pointerWidth);
+      if (auto *CE = dyn_cast<ConstantExpr>(extended))
+        constantOffset += CE->getZExtValue() * index.second;
+      else
+        terms.emplace_back(extended, index.second);
+    }
+    if (linear) {
+      if (!terms.empty() || !isa<ConstantExpr>(base.value))
+        base.value = addLinearTerms(base.value, terms, constantOffset);
+      else if (constantOffset)
+        base.value = AddExpr::create(
+            base.value,
+            ConstantExpr::alloc(llvm::APInt(pointerWidth, constantOffset)));
+      bindLocal(ki, state, base);
+      break;
+    }
+
+    // an index that is a pointer adds its segment as well
+    for (const auto &index : kgepi->indices) {
+      uint64_t elementSize = index.second;
+      KValue value = eval(ki, index.first, state);
       base = base.Add(
-          index.SExt(pointerWidth)
+          value.SExt(pointerWidth)
           .Mul(ConstantExpr::create(elementSize, pointerWidth)));
     }
     if (kgepi->offset)
@@ -3004,73 +4091,60 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
 
     // Floating point instructions
   case Instruction::FNeg: {
-    ref<ConstantExpr> arg =
-        toConstant(state, eval(ki, 0, state).value, "floating point");
+    ref<Expr> arg = eval(ki, 0, state).value;
     if (!fpWidthToSemantics(arg->getWidth()))
       return terminateStateOnExecError(state, "Unsupported FNeg operation");
-
-    llvm::APFloat Res(*fpWidthToSemantics(arg->getWidth()), arg->getAPValue());
-    Res = llvm::neg(Res);
-    bindLocal(ki, state, ConstantExpr::alloc(Res.bitcastToAPInt()));
+    arg = toFloatOperand(state, arg, arg->getWidth());
+    llvm::APInt sign = llvm::APInt::getSignMask(arg->getWidth());
+    bindLocal(ki, state, XorExpr::create(arg, ConstantExpr::alloc(sign)));
     break;
   }
 
   case Instruction::FAdd: {
-    ref<ConstantExpr> left = toConstant(state, eval(ki, 0, state).value,
-                                        "floating point");
-    ref<ConstantExpr> right = toConstant(state, eval(ki, 1, state).value,
-                                         "floating point");
+    ref<Expr> left = eval(ki, 0, state).value;
+    ref<Expr> right = eval(ki, 1, state).value;
     if (!fpWidthToSemantics(left->getWidth()) ||
         !fpWidthToSemantics(right->getWidth()))
       return terminateStateOnExecError(state, "Unsupported FAdd operation");
-
-    llvm::APFloat Res(*fpWidthToSemantics(left->getWidth()), left->getAPValue());
-    Res.add(APFloat(*fpWidthToSemantics(right->getWidth()),right->getAPValue()), APFloat::rmNearestTiesToEven);
-    bindLocal(ki, state, ConstantExpr::alloc(Res.bitcastToAPInt()));
+    left = toFloatOperand(state, left, left->getWidth());
+    right = toFloatOperand(state, right, right->getWidth());
+    bindLocal(ki, state, FAddExpr::create(left, right));
     break;
   }
 
   case Instruction::FSub: {
-    ref<ConstantExpr> left = toConstant(state, eval(ki, 0, state).value,
-                                        "floating point");
-    ref<ConstantExpr> right = toConstant(state, eval(ki, 1, state).value,
-                                         "floating point");
+    ref<Expr> left = eval(ki, 0, state).value;
+    ref<Expr> right = eval(ki, 1, state).value;
     if (!fpWidthToSemantics(left->getWidth()) ||
         !fpWidthToSemantics(right->getWidth()))
       return terminateStateOnExecError(state, "Unsupported FSub operation");
-    llvm::APFloat Res(*fpWidthToSemantics(left->getWidth()), left->getAPValue());
-    Res.subtract(APFloat(*fpWidthToSemantics(right->getWidth()), right->getAPValue()), APFloat::rmNearestTiesToEven);
-    bindLocal(ki, state, ConstantExpr::alloc(Res.bitcastToAPInt()));
+    left = toFloatOperand(state, left, left->getWidth());
+    right = toFloatOperand(state, right, right->getWidth());
+    bindLocal(ki, state, FSubExpr::create(left, right));
     break;
   }
 
   case Instruction::FMul: {
-    ref<ConstantExpr> left = toConstant(state, eval(ki, 0, state).value,
-                                        "floating point");
-    ref<ConstantExpr> right = toConstant(state, eval(ki, 1, state).value,
-                                         "floating point");
+    ref<Expr> left = eval(ki, 0, state).value;
+    ref<Expr> right = eval(ki, 1, state).value;
     if (!fpWidthToSemantics(left->getWidth()) ||
         !fpWidthToSemantics(right->getWidth()))
       return terminateStateOnExecError(state, "Unsupported FMul operation");
-
-    llvm::APFloat Res(*fpWidthToSemantics(left->getWidth()), left->getAPValue());
-    Res.multiply(APFloat(*fpWidthToSemantics(right->getWidth()), right->getAPValue()), APFloat::rmNearestTiesToEven);
-    bindLocal(ki, state, ConstantExpr::alloc(Res.bitcastToAPInt()));
+    left = toFloatOperand(state, left, left->getWidth());
+    right = toFloatOperand(state, right, right->getWidth());
+    bindLocal(ki, state, FMulExpr::create(left, right));
     break;
   }
 
   case Instruction::FDiv: {
-    ref<ConstantExpr> left = toConstant(state, eval(ki, 0, state).value,
-                                        "floating point");
-    ref<ConstantExpr> right = toConstant(state, eval(ki, 1, state).value,
-                                         "floating point");
+    ref<Expr> left = eval(ki, 0, state).value;
+    ref<Expr> right = eval(ki, 1, state).value;
     if (!fpWidthToSemantics(left->getWidth()) ||
         !fpWidthToSemantics(right->getWidth()))
       return terminateStateOnExecError(state, "Unsupported FDiv operation");
-
-    llvm::APFloat Res(*fpWidthToSemantics(left->getWidth()), left->getAPValue());
-    Res.divide(APFloat(*fpWidthToSemantics(right->getWidth()), right->getAPValue()), APFloat::rmNearestTiesToEven);
-    bindLocal(ki, state, ConstantExpr::alloc(Res.bitcastToAPInt()));
+    left = toFloatOperand(state, left, left->getWidth());
+    right = toFloatOperand(state, right, right->getWidth());
+    bindLocal(ki, state, FDivExpr::create(left, right));
     break;
   }
 
@@ -3092,185 +4166,77 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   case Instruction::FPTrunc: {
     FPTruncInst *fi = cast<FPTruncInst>(i);
     Expr::Width resultType = getWidthForLLVMType(fi->getType());
-    ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).value,
-                                       "floating point");
+    ref<Expr> arg = eval(ki, 0, state).value;
     if (!fpWidthToSemantics(arg->getWidth()) || resultType > arg->getWidth())
       return terminateStateOnExecError(state, "Unsupported FPTrunc operation");
-
-    llvm::APFloat Res(*fpWidthToSemantics(arg->getWidth()), arg->getAPValue());
-    bool losesInfo = false;
-    Res.convert(*fpWidthToSemantics(resultType),
-                llvm::APFloat::rmNearestTiesToEven,
-                &losesInfo);
-    bindLocal(ki, state, ConstantExpr::alloc(Res));
+    arg = toFloatOperand(state, arg, resultType);
+    bindLocal(ki, state, FPTruncExpr::create(arg, resultType));
     break;
   }
 
   case Instruction::FPExt: {
     FPExtInst *fi = cast<FPExtInst>(i);
     Expr::Width resultType = getWidthForLLVMType(fi->getType());
-    ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).value,
-                                        "floating point");
+    ref<Expr> arg = eval(ki, 0, state).value;
     if (!fpWidthToSemantics(arg->getWidth()) || arg->getWidth() > resultType)
       return terminateStateOnExecError(state, "Unsupported FPExt operation");
-    llvm::APFloat Res(*fpWidthToSemantics(arg->getWidth()), arg->getAPValue());
-    bool losesInfo = false;
-    Res.convert(*fpWidthToSemantics(resultType),
-                llvm::APFloat::rmNearestTiesToEven,
-                &losesInfo);
-    bindLocal(ki, state, ConstantExpr::alloc(Res));
+    arg = toFloatOperand(state, arg, resultType);
+    bindLocal(ki, state, FPExtExpr::create(arg, resultType));
     break;
   }
 
   case Instruction::FPToUI: {
     FPToUIInst *fi = cast<FPToUIInst>(i);
     Expr::Width resultType = getWidthForLLVMType(fi->getType());
-    ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).value,
-                                       "floating point");
-    if (!fpWidthToSemantics(arg->getWidth()) || resultType > 64)
+    ref<Expr> arg = eval(ki, 0, state).value;
+    if (!fpWidthToSemantics(arg->getWidth()))
       return terminateStateOnExecError(state, "Unsupported FPToUI operation");
-
-    llvm::APFloat Arg(*fpWidthToSemantics(arg->getWidth()), arg->getAPValue());
-    uint64_t value = 0;
-    bool isExact = true;
-    auto valueRef = makeMutableArrayRef(value);
-    Arg.convertToInteger(valueRef, resultType, false,
-                         llvm::APFloat::rmTowardZero, &isExact);
-    bindLocal(ki, state, ConstantExpr::alloc(value, resultType));
+    arg = toFloatOperand(state, arg, arg->getWidth());
+    bindLocal(ki, state, FPToUIExpr::create(arg, resultType));
     break;
   }
 
   case Instruction::FPToSI: {
     FPToSIInst *fi = cast<FPToSIInst>(i);
     Expr::Width resultType = getWidthForLLVMType(fi->getType());
-    ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).value,
-                                       "floating point");
-    if (!fpWidthToSemantics(arg->getWidth()) || resultType > 64)
+    ref<Expr> arg = eval(ki, 0, state).value;
+    if (!fpWidthToSemantics(arg->getWidth()))
       return terminateStateOnExecError(state, "Unsupported FPToSI operation");
-    llvm::APFloat Arg(*fpWidthToSemantics(arg->getWidth()), arg->getAPValue());
-
-    uint64_t value = 0;
-    bool isExact = true;
-    auto valueRef = makeMutableArrayRef(value);
-    Arg.convertToInteger(valueRef, resultType, true,
-                         llvm::APFloat::rmTowardZero, &isExact);
-    bindLocal(ki, state, ConstantExpr::alloc(value, resultType));
+    arg = toFloatOperand(state, arg, arg->getWidth());
+    bindLocal(ki, state, FPToSIExpr::create(arg, resultType));
     break;
   }
 
   case Instruction::UIToFP: {
     UIToFPInst *fi = cast<UIToFPInst>(i);
     Expr::Width resultType = getWidthForLLVMType(fi->getType());
-    ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).value,
-                                       "floating point");
-    const llvm::fltSemantics *semantics = fpWidthToSemantics(resultType);
-    if (!semantics)
+    if (!fpWidthToSemantics(resultType))
       return terminateStateOnExecError(state, "Unsupported UIToFP operation");
-    llvm::APFloat f(*semantics, 0);
-    f.convertFromAPInt(arg->getAPValue(), false,
-                       llvm::APFloat::rmNearestTiesToEven);
-
-    bindLocal(ki, state, ConstantExpr::alloc(f));
+    ref<Expr> arg = toFloatOperand(state, eval(ki, 0, state).value, resultType);
+    bindLocal(ki, state, UIToFPExpr::create(arg, resultType));
     break;
   }
 
   case Instruction::SIToFP: {
     SIToFPInst *fi = cast<SIToFPInst>(i);
     Expr::Width resultType = getWidthForLLVMType(fi->getType());
-    ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).value,
-                                       "floating point");
-    const llvm::fltSemantics *semantics = fpWidthToSemantics(resultType);
-    if (!semantics)
+    if (!fpWidthToSemantics(resultType))
       return terminateStateOnExecError(state, "Unsupported SIToFP operation");
-    llvm::APFloat f(*semantics, 0);
-    f.convertFromAPInt(arg->getAPValue(), true,
-                       llvm::APFloat::rmNearestTiesToEven);
-
-    bindLocal(ki, state, ConstantExpr::alloc(f));
+    ref<Expr> arg = toFloatOperand(state, eval(ki, 0, state).value, resultType);
+    bindLocal(ki, state, SIToFPExpr::create(arg, resultType));
     break;
   }
 
   case Instruction::FCmp: {
     FCmpInst *fi = cast<FCmpInst>(i);
-    ref<ConstantExpr> left = toConstant(state, eval(ki, 0, state).value,
-                                        "floating point");
-    ref<ConstantExpr> right = toConstant(state, eval(ki, 1, state).value,
-                                         "floating point");
+    ref<Expr> left = eval(ki, 0, state).value;
+    ref<Expr> right = eval(ki, 1, state).value;
     if (!fpWidthToSemantics(left->getWidth()) ||
         !fpWidthToSemantics(right->getWidth()))
       return terminateStateOnExecError(state, "Unsupported FCmp operation");
-
-    APFloat LHS(*fpWidthToSemantics(left->getWidth()),left->getAPValue());
-    APFloat RHS(*fpWidthToSemantics(right->getWidth()),right->getAPValue());
-    APFloat::cmpResult CmpRes = LHS.compare(RHS);
-
-    bool Result = false;
-    switch( fi->getPredicate() ) {
-      // Predicates which only care about whether or not the operands are NaNs.
-    case FCmpInst::FCMP_ORD:
-      Result = (CmpRes != APFloat::cmpUnordered);
-      break;
-
-    case FCmpInst::FCMP_UNO:
-      Result = (CmpRes == APFloat::cmpUnordered);
-      break;
-
-      // Ordered comparisons return false if either operand is NaN.  Unordered
-      // comparisons return true if either operand is NaN.
-    case FCmpInst::FCMP_UEQ:
-      Result = (CmpRes == APFloat::cmpUnordered || CmpRes == APFloat::cmpEqual);
-      break;
-    case FCmpInst::FCMP_OEQ:
-      Result = (CmpRes != APFloat::cmpUnordered && CmpRes == APFloat::cmpEqual);
-      break;
-
-    case FCmpInst::FCMP_UGT:
-      Result = (CmpRes == APFloat::cmpUnordered || CmpRes == APFloat::cmpGreaterThan);
-      break;
-    case FCmpInst::FCMP_OGT:
-      Result = (CmpRes != APFloat::cmpUnordered && CmpRes == APFloat::cmpGreaterThan);
-      break;
-
-    case FCmpInst::FCMP_UGE:
-      Result = (CmpRes == APFloat::cmpUnordered || (CmpRes == APFloat::cmpGreaterThan || CmpRes == APFloat::cmpEqual));
-      break;
-    case FCmpInst::FCMP_OGE:
-      Result = (CmpRes != APFloat::cmpUnordered && (CmpRes == APFloat::cmpGreaterThan || CmpRes == APFloat::cmpEqual));
-      break;
-
-    case FCmpInst::FCMP_ULT:
-      Result = (CmpRes == APFloat::cmpUnordered || CmpRes == APFloat::cmpLessThan);
-      break;
-    case FCmpInst::FCMP_OLT:
-      Result = (CmpRes != APFloat::cmpUnordered && CmpRes == APFloat::cmpLessThan);
-      break;
-
-    case FCmpInst::FCMP_ULE:
-      Result = (CmpRes == APFloat::cmpUnordered || (CmpRes == APFloat::cmpLessThan || CmpRes == APFloat::cmpEqual));
-      break;
-    case FCmpInst::FCMP_OLE:
-      Result = (CmpRes != APFloat::cmpUnordered && (CmpRes == APFloat::cmpLessThan || CmpRes == APFloat::cmpEqual));
-      break;
-
-    case FCmpInst::FCMP_UNE:
-      Result = (CmpRes == APFloat::cmpUnordered || CmpRes != APFloat::cmpEqual);
-      break;
-    case FCmpInst::FCMP_ONE:
-      Result = (CmpRes != APFloat::cmpUnordered && CmpRes != APFloat::cmpEqual);
-      break;
-
-    default:
-      assert(0 && "Invalid FCMP predicate!");
-      break;
-    case FCmpInst::FCMP_FALSE:
-      Result = false;
-      break;
-    case FCmpInst::FCMP_TRUE:
-      Result = true;
-      break;
-    }
-
-    bindLocal(ki, state, ConstantExpr::alloc(Result, Expr::Bool));
+    left = toFloatOperand(state, left, left->getWidth());
+    right = toFloatOperand(state, right, right->getWidth());
+    bindLocal(ki, state, createFCmp(fi->getPredicate(), left, right));
     break;
   }
   case Instruction::InsertValue: {
@@ -3495,7 +4461,24 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
 
 void Executor::updateStates(ExecutionState *current) {
   if (searcher) {
-    searcher->update(current, addedStates, removedStates);
+    // the states parked in this step leave the searcher, the parked states
+    // removed here have already left it
+    std::vector<ExecutionState *> removed(parkedStates);
+    for (ExecutionState *es : removedStates) {
+      if (autoMerger && autoMerger->remove(*es))
+        continue;
+      if (asyncBranches && asyncBranches->isPending(*es)) {
+        asyncBranches->cancel(*es);
+        continue;
+      }
+      removed.push_back(es);
+    }
+    // a state parked in this step is removed, not reweighted
+    if (current && std::find(parkedStates.begin(), parkedStates.end(),
+                             current) != parkedStates.end())
+      current = nullptr;
+    searcher->update(current, addedStates, removed);
+    parkedStates.clear();
   }
   
   states.insert(addedStates.begin(), addedStates.end());
@@ -3513,9 +4496,22 @@ void Executor::updateStates(ExecutionState *current) {
     if (it3 != seedMap.end())
       seedMap.erase(it3);
     processTree->remove(es->ptreeNode);
-    delete es;
+    // states in open merges are still counted by their merge handlers
+    if (ReclaimStatesPerStep && es->openMergeStack.empty())
+      reclaimedStates.push_back(es);
+    else
+      delete es;
   }
   removedStates.clear();
+  reclaimStates(ReclaimStatesPerStep);
+}
+
+void Executor::reclaimStates(size_t count) {
+  count = std::min(count, reclaimedStates.size());
+  for (size_t i = 0; i < count; ++i) {
+    delete reclaimedStates.back();
+    reclaimedStates.pop_back();
+  }
 }
 
 template <typename TypeIt>
@@ -3591,7 +4587,7 @@ void Executor::bindModuleConstants() {
 }
 
 bool Executor::checkMemoryUsage() {
-  if (!MaxMemory) return true;
+  if (!MaxMemory && MemoryBudgets.empty()) return true;
 
   // We need to avoid calling GetTotalMallocUsage() often because it
   // is O(elts on freelist). This is really bad since we start
@@ -3599,25 +4595,53 @@ bool Executor::checkMemoryUsage() {
   if ((stats::instructions & 0xFFFFU) != 0) // every 65536 instructions
     return true;
 
+  // the caches over their budgets are emptied, between solver queries
+  for (MemoryAccount *account : MemoryAccount::getAccounts())
+    if (account->isOverBudget())
+      stats::releasedCacheBytes += account->release();
+  if (!MaxMemory)
+    return true;
+
   // check memory limit
-  const auto mallocUsage = util::GetTotalMallocUsage() >> 20U;
-  const auto mmapUsage = memory->getUsedDeterministicSize() >> 20U;
-  const auto totalUsage = mallocUsage + mmapUsage;
+  reclaimStates(reclaimedStates.size());
+  // the free nodes of the expression slabs are held for later expressions,
+  // they do not count as used
+  const auto getTotalUsage = [this]() {
+    return ((util::GetTotalMallocUsage() - ExprAllocator::getFreeBytes()) >>
+            20U) +
+           (memory->getUsedDeterministicSize() >> 20U);
+  };
+  auto totalUsage = getTotalUsage();
   atMemoryLimit = totalUsage > MaxMemory; // inhibit forking
-  if (!atMemoryLimit)
+  if (!atMemoryLimit) {
+    // rebuild swapped out states while there is room, a few at a time
+    if (stateSwap && !stateSwap->empty() && totalUsage < MaxMemory * 3 / 4)
+      return !reloadSwappedStates(std::max<size_t>(1, states.size() / 8));
     return true;
+  }
 
   // only terminate states when threshold (+100MB) exceeded
   if (totalUsage <= MaxMemory + 100)
     return true;
 
+  // the caches go before any state does
+  uint64_t released = 0;
+  for (MemoryAccount *account : MemoryAccount::getAccounts())
+    released += account->release();
+  if (released) {
+    stats::releasedCacheBytes += released;
+    totalUsage = getTotalUsage();
+    if (totalUsage <= MaxMemory + 100)
+      return true;
+  }
+
   // just guess at how many to kill
   const auto numStates = states.size();
   auto toKill = std::max(1UL, numStates - numStates * MaxMemory / totalUsage);
-  klee_warning("killing %lu states (over memory cap: %luMB)", toKill, totalUsage);
 
-  // randomly select states for early termination
   std::vector<ExecutionState *> arr(states.begin(), states.end()); // FIXME: expensive
+  std::vector<ExecutionState *> evicted;
+  // randomly select states for early termination
   for (unsigned i = 0, N = arr.size(); N && i < toKill; ++i, --N) {
     unsigned idx = theRNG.getInt32() % N;
     // Make two pulls to try and not hit a state that
@@ -3626,7 +4650,26 @@ bool Executor::checkMemoryUsage() {
       idx = theRNG.getInt32() % N;
 
     std::swap(arr[idx], arr[N - 1]);
-    terminateStateEarly(*arr[N - 1], "Memory limit exceeded.", StateTerminationType::OutOfMemory);
+    evicted.push_back(arr[N - 1]);
+  }
+
+  klee_warning("%s %zu states (over memory cap: %luMB)",
+               stateSwap ? "swapping out" : "killing", evicted.size(),
+               totalUsage);
+  if (eventTrace)
+    eventTrace->record(EventTrace::MemoryLimit, 0, 0, totalUsage);
+
+  for (ExecutionState *state : evicted) {
+    ExecutionState &es = *state;
+    // a state parked at a branch would have to replay into it
+    if (stateSwap && !es.pendingBranch &&
+        stateSwap->swapOut(es.isReplaying() ? *es.replayedChoices
+                                            : es.forkChoices)) {
+      ++stats::swappedOutStates;
+      removedStates.push_back(&es);
+      continue;
+    }
+    terminateStateEarly(es, "Memory limit exceeded.", StateTerminationType::OutOfMemory);
   }
 
   return false;
@@ -3639,16 +4682,48 @@ void Executor::doDumpStates() {
   }
 
   klee_message("halting execution, dumping remaining states");
+  if (DumpStatesWorkers > 1 && states.size() > 1)
+    solveDumpedStates();
   for (const auto &state : states)
     terminateStateEarly(*state, "Execution halting.", StateTerminationType::Interrupted);
   updateStates(nullptr);
+  dumpedSolutions.clear();
+}
+
+void Executor::solveDumpedStates() {
+  // the states that terminateStateEarly will write test cases for
+  std::vector<const ExecutionState *> dumped;
+  if (ExitOnErrorType.empty())
+    for (const ExecutionState *es : states)
+      if (!OnlyOutputStatesCoveringNew || es->coveredNew)
+        dumped.push_back(es);
+
+  auto solutions = solveInWorkers(
+      DumpStatesWorkers, dumped.size(),
+      [&](size_t i, SymbolicSolution &solution) {
+        return computeSymbolicSolution(*dumped[i], solution);
+      });
+  for (size_t i = 0; i < dumped.size(); ++i)
+    if (solutions[i])
+      dumpedSolutions[dumped[i]] = std::move(solutions[i]);
 }
 
 void Executor::run(ExecutionState &initialState) {
+  if (!startExploration(initialState))
+    return;
+  while (stepExploration(std::numeric_limits<std::uint64_t>::max()))
+    ;
+  finishExploration();
+}
+
+bool Executor::startExploration(ExecutionState &initialState) {
   bindModuleConstants();
 
   // Delay init till now so that ticks don't accrue during optimization and such.
-  timers.reset();
+  if (!timersStarted) {
+    timers.reset();
+    timersStarted = true;
+  }
 
   states.insert(&initialState);
 
@@ -3665,7 +4740,7 @@ void Executor::run(ExecutionState &initialState) {
     while (!seedMap.empty()) {
       if (haltExecution) {
         doDumpStates();
-        return;
+        return false;
       }
 
       std::map<ExecutionState*, std::vector<SeedInfo> >::iterator it = 
@@ -3674,10 +4749,12 @@ void Executor::run(ExecutionState &initialState) {
         it = seedMap.begin();
       lastState = it->first;
       ExecutionState &state = *lastState;
-      KInstruction *ki = state.pc;
-      stepInstruction(state);
+      if (state.threads.empty() || !handleThreads(state)) {
+        KInstruction *ki = state.pc;
+        stepInstruction(state);
 
-      executeInstruction(state, ki);
+        executeInstruction(state, ki);
+      }
       timers.invoke();
       if (::dumpStates) dumpStates();
       if (::dumpPTree) dumpPTree();
@@ -3711,22 +4788,107 @@ void Executor::run(ExecutionState &initialState) {
 
     if (OnlySeed) {
       doDumpStates();
-      return;
+      return false;
     }
   }
 
-  searcher = constructUserSearcher(*this);
+  if (PrefixWorkersOpt > 1 && usingSeeds) {
+    klee_warning("--prefix-workers is not supported with seeds, ignoring it");
+  } else if (PrefixWorkersOpt > 1) {
+    prefixWorkers = std::make_unique<PrefixWorkers>(PrefixWorkersOpt);
+    if (!prefixWorkers->coordinate(*interpreterHandler, forkPrefix)) {
+      // the coordinator explores nothing itself
+      prefixWorkers.reset();
+      removedStates.assign(states.begin(), states.end());
+      updateStates(nullptr);
+      return false;
+    }
+    initialState.replayedChoices =
+        std::make_shared<const std::vector<std::uint32_t>>(forkPrefix);
+    if (statsTracker)
+      statsTracker->disableOutput();
+    disableEventTrace();
+    timers.add(std::make_unique<Timer>(time::Span(TimerInterval),
+                                       [&] { givePrefixes(); }));
+  }
+
+  if (userSearcherPortfolioSize() > 1) {
+    if (prefixWorkers || ParallelWorkersOpt > 1)
+      klee_warning("--portfolio is not supported with --prefix-workers or "
+                   "--parallel-workers, ignoring it");
+    else
+      startPortfolio();
+  }
+
+  if (StateSwapOpt)
+    startStateSwap(initialState);
+  if (time::Span(CheckpointInterval) &&
+      replaySupported("--checkpoint-interval")) {
+    checkpointing = true;
+    timers.add(std::make_unique<Timer>(time::Span(CheckpointInterval),
+                                       [&] { writeCheckpoint(); }));
+  }
+  if (!resumeCheckpoint.empty() && !resumeFromCheckpoint(initialState)) {
+    // the checkpointed run had explored everything
+    removedStates.assign(states.begin(), states.end());
+    updateStates(nullptr);
+  }
+
+  searcher = constructUserSearcher(*this, portfolio ? portfolio->getIndex() : 0);
+  if (AsyncBranchQueriesOpt)
+    asyncBranches = std::make_unique<AsyncBranchQueries>(AsyncBranchQueriesOpt);
+  if (ParallelWorkersOpt > 1 && !prefixWorkers)
+    parallelWorkers = std::make_unique<ParallelWorkers>(ParallelWorkersOpt);
+  if (UseAutoMerge && UseMerge)
+    klee_warning("--auto-merge is not supported with --use-merge, ignoring it");
+  else if (UseAutoMerge)
+    autoMerger = std::make_unique<AutoMerger>(*this);
 
   std::vector<ExecutionState *> newStates(states.begin(), states.end());
   searcher->update(0, newStates, std::vector<ExecutionState *>());
+  return true;
+}
 
+bool Executor::stepExploration(std::uint64_t budget) {
   // main interpreter loop
-  while (!states.empty() && !haltExecution) {
-    ExecutionState &state = searcher->selectState();
-    KInstruction *ki = state.pc;
-    stepInstruction(state);
-
-    executeInstruction(state, ki);
+  for (std::uint64_t steps = 0; steps < budget; ++steps) {
+    if ((states.empty() && (!stateSwap || stateSwap->empty())) ||
+        haltExecution)
+      return false;
+    if (states.empty()) {
+      // rebuild a swapped out state, states may be empty if that failed
+      reloadSwappedStates(1);
+      updateStates(nullptr);
+      continue;
+    }
+    if (autoMerger && autoMerger->hasParked()) {
+      std::vector<ExecutionState *> released;
+      autoMerger->release(searcher->empty(), released);
+      if (!released.empty())
+        searcher->update(nullptr, released, std::vector<ExecutionState *>());
+    }
+    if (asyncBranches && !asyncBranches->empty())
+      resumeParkedStates(searcher->empty());
+    ExecutionState &state = searcher->selectState();
+    if (eventTrace)
+      eventTrace->select(state.getID());
+    if (autoMerger && !state.pendingBranch && autoMerger->arrive(state)) {
+      // the state was parked or merged into a parked one
+      updateStates(nullptr);
+      continue;
+    }
+    if (state.pendingBranch) {
+      // the state was parked at a branch, continue within it
+      KInstruction *ki = state.pendingBranch->ki;
+      if (statsTracker)
+        statsTracker->resumeInstruction(state, ki);
+      executeBranch(state, ki, state.pendingBranch->condition);
+    } else if (state.threads.empty() || !handleThreads(state)) {
+      KInstruction *ki = state.pc;
+      stepInstruction(state);
+
+      executeInstruction(state, ki);
+    }
     timers.invoke();
     if (::dumpStates) dumpStates();
     if (::dumpPTree) dumpPTree();
@@ -3734,15 +4896,233 @@ void Executor::run(ExecutionState &initialState) {
     updateStates(&state);
 
     if (!checkMemoryUsage()) {
-      // update searchers when states were terminated early due to memory pressure
+      // update searchers when states were terminated early, swapped out or
+      // reloaded due to memory pressure
       updateStates(nullptr);
     }
+
+    // states waiting for a solver process cannot be moved to a worker
+    if (parallelWorkers && parallelWorkers->shouldSplit(states.size()) &&
+        (!asyncBranches || asyncBranches->empty()))
+      splitStates();
   }
+  return (!states.empty() || (stateSwap && !stateSwap->empty())) &&
+         !haltExecution;
+}
 
+void Executor::finishExploration() {
   delete searcher;
   searcher = nullptr;
+  autoMerger.reset();
+
+  if (checkpointing)
+    writeCheckpoint();
+  else if (stateSwap && !stateSwap->empty())
+    klee_warning("halting execution, %zu swapped out states are lost",
+                 stateSwap->size());
+  stateSwap.reset();
+  if (replayRoot) {
+    processTree->remove(replayRoot->ptreeNode);
+    delete replayRoot;
+    replayRoot = nullptr;
+  }
 
   doDumpStates();
+  reclaimStates(reclaimedStates.size());
+  asyncBranches.reset();
+  interpreterHandler->waitForTestCases();
+
+  if (parallelWorkers) {
+    if (parallelWorkers->isWorker())
+      parallelWorkers->finishWorker(*interpreterHandler);
+    parallelWorkers->collect(*interpreterHandler);
+    parallelWorkers.reset();
+  }
+  if (prefixWorkers)
+    prefixWorkers->finishWorker(*interpreterHandler);
+  if (portfolio) {
+    if (portfolio->isWorker())
+      portfolio->finishWorker(*interpreterHandler);
+    portfolio->collect(*interpreterHandler);
+    if (statsTracker)
+      statsTracker->setSharedCoverage(nullptr);
+    portfolio.reset();
+  }
+}
+
+void Executor::givePrefixes() {
+  if (!prefixWorkers->prefixesRequested())
+    return;
+
+  // give up every other state past the prefix of this worker, the
+  // coordinator hands their prefixes to idle workers
+  std::vector<PrefixWorkers::Prefix> given;
+  unsigned candidates = 0;
+  for (ExecutionState *es : states) {
+    if (es->isReplaying() || es->pendingBranch ||
+        std::find(removedStates.begin(), removedStates.end(), es) !=
+            removedStates.end())
+      continue;
+    if (candidates++ % 2 == 0)
+      continue;
+    given.push_back(es->forkChoices);
+    removedStates.push_back(es);
+  }
+  prefixWorkers->sendPrefixes(given);
+}
+
+bool Executor::replaySupported(const char *option) const {
+  if (usingSeeds || prefixWorkers || ParallelWorkersOpt > 1 || portfolio ||
+      UseMerge || UseAutoMerge) {
+    klee_warning("%s is not supported with seeds, merging or worker "
+                 "processes, ignoring it",
+                 option);
+    return false;
+  }
+  return true;
+}
+
+void Executor::createReplayRoot(ExecutionState &initialState) {
+  if (replayRoot)
+    return;
+  replayRoot = initialState.branch();
+  processTree->attach(initialState.ptreeNode, replayRoot, &initialState,
+                      BranchType::NONE);
+}
+
+void Executor::rebuildState(std::vector<std::uint32_t> choices) {
+  ExecutionState *es = replayRoot->branch();
+  es->replayedChoices =
+      std::make_shared<const std::vector<std::uint32_t>>(std::move(choices));
+  addedStates.push_back(es);
+  processTree->attach(replayRoot->ptreeNode, es, replayRoot, BranchType::NONE);
+  if (pathWriter && !PathsFromPTree)
+    es->pathOS = pathWriter->open(replayRoot->pathOS);
+  if (symPathWriter && !PathsFromPTree)
+    es->symPathOS = symPathWriter->open(replayRoot->symPathOS);
+}
+
+void Executor::startStateSwap(ExecutionState &initialState) {
+  if (!MaxMemory) {
+    klee_warning("--state-swap is not supported without --max-memory, "
+                 "ignoring it");
+    return;
+  }
+  if (!replaySupported("--state-swap"))
+    return;
+  stateSwap =
+      StateSwap::create(interpreterHandler->getOutputFilename("state-swap"));
+  if (stateSwap)
+    createReplayRoot(initialState);
+}
+
+bool Executor::reloadSwappedStates(unsigned count) {
+  unsigned reloaded = 0;
+  while (reloaded < count && !stateSwap->empty()) {
+    std::vector<std::uint32_t> choices;
+    if (!stateSwap->reload(choices))
+      continue;
+    rebuildState(std::move(choices));
+    ++stats::reloadedStates;
+    ++reloaded;
+  }
+  return reloaded;
+}
+
+void Executor::writeCheckpoint() {
+  Checkpoint checkpoint;
+  checkpoint.numInstructions = kmodule->infos->getMaxID();
+  checkpoint.counts = interpreterHandler->getWorkerCounts();
+  if (statsTracker)
+    statsTracker->getCoverage(checkpoint.covered);
+
+  // timers run before the states of the current step are updated
+  auto add = [&](const ExecutionState &es) {
+    checkpoint.states.push_back(es.isReplaying() ? *es.replayedChoices
+                                                 : es.forkChoices);
+  };
+  for (const ExecutionState *es : states)
+    if (std::find(removedStates.begin(), removedStates.end(), es) ==
+        removedStates.end())
+      add(*es);
+  for (const ExecutionState *es : addedStates)
+    add(*es);
+  if (stateSwap)
+    stateSwap->readAll(checkpoint.states);
+
+  checkpoint.write(interpreterHandler->getOutputFilename("checkpoint.kcp"));
+}
+
+bool Executor::resumeFromCheckpoint(ExecutionState &initialState) {
+  if (!replaySupported("--resume-from"))
+    klee_error("cannot resume from %s", resumeCheckpoint.c_str());
+  Checkpoint checkpoint;
+  std::string error;
+  if (!checkpoint.read(resumeCheckpoint, error))
+    klee_error("unable to resume from %s - %s", resumeCheckpoint.c_str(),
+               error.c_str());
+  if (checkpoint.numInstructions != kmodule->infos->getMaxID())
+    klee_error("unable to resume from %s - it was written for another "
+               "program",
+               resumeCheckpoint.c_str());
+
+  klee_message("resuming %zu states from %s", checkpoint.states.size(),
+               resumeCheckpoint.c_str());
+  interpreterHandler->addWorkerCounts(checkpoint.counts);
+  if (statsTracker)
+    statsTracker->restoreCoverage(checkpoint.covered);
+  if (checkpoint.states.empty())
+    return false;
+
+  createReplayRoot(initialState);
+  initialState.replayedChoices =
+      std::make_shared<const std::vector<std::uint32_t>>(
+          std::move(checkpoint.states[0]));
+  for (size_t i = 1; i < checkpoint.states.size(); ++i)
+    rebuildState(std::move(checkpoint.states[i]));
+  updateStates(nullptr);
+  return true;
+}
+
+void Executor::startPortfolio() {
+  portfolio = std::make_unique<PortfolioWorkers>(
+      userSearcherPortfolioSize(), kmodule->infos->getMaxID());
+  portfolio->start(*interpreterHandler);
+  if (statsTracker) {
+    statsTracker->setSharedCoverage(portfolio->getCoverage());
+    if (portfolio->isWorker())
+      statsTracker->disableOutput();
+  }
+  if (portfolio->isWorker())
+    disableEventTrace();
+  // the other members also differ in their random choices
+  if (portfolio->isWorker())
+    theRNG.seed(theRNG.getInt32() + portfolio->getIndex());
+}
+
+void Executor::disableEventTrace() {
+  if (!eventTrace)
+    return;
+  // the file is shared with the original process, which keeps writing it,
+  // and the thread of the trace was not forked along with this process
+  solver->trace = nullptr;
+  (void)eventTrace.release();
+}
+
+void Executor::splitStates() {
+  parallelWorkers->start(*interpreterHandler);
+  if (parallelWorkers->isWorker() && statsTracker)
+    statsTracker->disableOutput();
+  if (parallelWorkers->isWorker())
+    disableEventTrace();
+
+  // the states are ordered by their address, which is the same in all
+  // workers after the fork
+  size_t i = 0;
+  for (ExecutionState *es : states)
+    if (!parallelWorkers->keeps(i++))
+      removedStates.push_back(es);
+  updateStates(nullptr);
 }
 
 std::string Executor::getKValueInfo(ExecutionState &state,
@@ -3815,8 +5195,23 @@ void Executor::terminateState(ExecutionState &state) {
   }
 }
 
-static bool shouldWriteTest(const ExecutionState &state) {
-  return !OnlyOutputStatesCoveringNew || state.coveredNew;
+bool Executor::shouldWriteTest(const ExecutionState &state) {
+  if ((OnlyOutputStatesCoveringNew || fuzzing) && !state.coveredNew)
+    return false;
+  if (!portfolio)
+    return true;
+
+  // the members of a portfolio write one test case per set of lines
+  // covered first
+  llvm::hash_code key = llvm::hash_value(0);
+  if (const auto *lines = state.coveredLines.get()) {
+    for (const auto &file : *lines) {
+      key = llvm::hash_combine(key, *file.first);
+      for (unsigned line : file.second)
+        key = llvm::hash_combine(key, line);
+    }
+  }
+  return portfolio->claimTest(key);
 }
 
 static std::string terminationTypeFileExtension(StateTerminationType type) {
@@ -3832,141 +5227,93 @@ static std::string terminationTypeFileExtension(StateTerminationType type) {
 };
 
 static bool hasMemoryLeaks(ExecutionState &state) {
-  for (auto& object : state.addressSpace.objects) {
-    if (!object.first->isLocal && !object.first->isGlobal
-        && !object.first->isFixed) {
-      // => is heap-allocated
+  for (const MemoryObject *mo : state.addressSpace.heapObjects)
+    if (mo->isHeapObject())
       return true;
-    }
-  }
-
   return false;
 }
 
 static std::vector<const MemoryObject *> getMemoryLeaks(ExecutionState &state) {
-    std::vector<const MemoryObject *> leaks;
-    for (auto& object : state.addressSpace.objects) {
-        if (!object.first->isLocal && !object.first->isGlobal
-            && !object.first->isFixed) {
-            // => is heap-allocated
-            leaks.push_back(object.first);
-        }
-    }
-
-    return leaks;
-}
-
-static void getPointers(const llvm::Type *type,
-                        const llvm::DataLayout& DL,
-                        const ObjectState *os,
-                        std::set<ref<Expr>>& objects,
-                        unsigned off=0) {
-  using namespace llvm;
-
-  const auto ptrWidth = Context::get().getPointerWidth();
-
-  // XXX: we ignore integer types which is wrong since
-  // we can cast pointer to integer... we should actually search
-  // any object that has segment plane set
-  for (auto *Ty : type->subtypes()) {
-      if (Ty->isStructTy()) {
-          getPointers(Ty, DL, os, objects, off);
-      } else if (auto AT = dyn_cast<ArrayType>(Ty)) {
-          if (AT->getElementType()->isIntegerTy())
-              continue; // we cannot find anything here
-
-          // we must search on all indices in the array,
-          // so just artificially shift offsets
-          for (unsigned idx = 0; idx < AT->getNumElements(); ++idx) {
-              getPointers(Ty, DL, os, objects,
-                          off + idx*DL.getTypeAllocSize(AT->getElementType()));
-          }
-      } if (Ty->isPointerTy()) {
-        KValue ptr = os->read(off, ptrWidth);
-       //llvm::errs() << "TY @ " << off << ": " << *Ty << "\n";
-       //llvm::errs() << "  --> POINTER!: " << *Ty << "\n";
-       //llvm::errs() << "  --> " << ptr << "\n";
-        objects.insert(ptr.getSegment());
-      }
-      // FIXME: is this always enough? Does this cover padding
-      // in any structure?
-      off += DL.getTypeAllocSize(Ty);
-  }
+  std::vector<const MemoryObject *> leaks;
+  for (const MemoryObject *mo : state.addressSpace.heapObjects)
+    if (mo->isHeapObject())
+      leaks.push_back(mo);
+  return leaks;
 }
 
 bool
 Executor::getReachableMemoryObjects(ExecutionState &state,
                                     std::set<const MemoryObject *>& reachable) {
-    std::set<ObjectPair> queue;
-
-    DataLayout& DL = *kmodule->targetData;
+    // the objects are found by their segments, each is visited once
+    llvm::BitVector visited(memory->getLastSegment() + 1);
+    std::vector<const ObjectState *> worklist;
 
     for (auto& object : state.addressSpace.objects) {
       // the only objects that are still left are those that
       // are either local to main or global (or heap-allocated,
-      // but we do not care about those while initializing queue)
+      // but we do not care about those while initializing the worklist)
       if (object.first->isLocal || object.first->isGlobal) {
-
         reachable.insert(object.first);
-
-        if (!object.first->allocSite ||
-            (!llvm::isa<llvm::AllocaInst>(object.first->allocSite) &&
-            !llvm::isa<llvm::GlobalValue>(object.first->allocSite))){
-          continue;
-        }
-
-        queue.emplace(object.first, object.second.get());
+        if (object.first->segment < visited.size())
+          visited.set(object.first->segment);
+        worklist.push_back(object.second.get());
       }
     }
 
     bool retval = true;
+    std::vector<uint64_t> segments;
+    std::vector<ref<Expr>> symbolic;
 
     // iterate the search until we searched all the reachable objects
-    while (!queue.empty()) {
-      ObjectPair object = *queue.begin();
-      queue.erase(queue.begin());
+    while (!worklist.empty()) {
+      const ObjectState *os = worklist.back();
+      worklist.pop_back();
 
-      if (!object.first->allocSite ||
-          (!llvm::isa<llvm::AllocaInst>(object.first->allocSite) &&
-          !llvm::isa<llvm::GlobalValue>(object.first->allocSite))){
+      // there is nothing to find in memory that never held a pointer
+      if (!os->hasSegmentPlane())
         continue;
-      }
-
-      std::set<ref<Expr>> segments;
-      getPointers(object.first->allocSite->getType(), DL,
-                  &*object.second, segments);
-
-      for (auto segment : segments) {
-        segment = toUnique(state, segment);
-        if (auto C = dyn_cast<ConstantExpr>(segment)) {
-          auto segval = C->getZExtValue();
-          if (segval < FIRST_ORDINARY_SEGMENT)
-              continue; // ignore functions and special objects
-          if (segval > memory->getLastSegment())
-              continue;  // this cannot be a real pointer
-
-          ObjectPair result;
-          bool success =
-          state.addressSpace.resolveOneConstantSegment(
-              KValue(segment, ConstantExpr::alloc(0, Expr::Int64)), result);
-          if (success) {
-              if (reachable.insert(result.first).second) {
-                  // if we haven't found this memory before,
-                  // add it to queue for processing
-                  queue.insert(result);
-              }
-          } else {
-              if (state.addressSpace.removedObjectsMap.count(segval) > 0)
-                  continue; // this memory object has been freed
 
-              klee_warning("Failed resolving segment in memcleanup check");
-              retval = false;
-          }
+      segments.clear();
+      symbolic.clear();
+      os->getStoredSegments(segments, symbolic);
+      for (const auto &segment : symbolic) {
+        ref<Expr> unique = toUnique(state, segment);
+        if (auto C = dyn_cast<ConstantExpr>(unique)) {
+          segments.push_back(C->getZExtValue());
         } else {
           klee_warning("Cannot resolve non-constant segment in memcleanup check");
           retval = false;
         }
       }
+
+      for (uint64_t segval : segments) {
+        if (segval < FIRST_ORDINARY_SEGMENT)
+            continue; // ignore functions and special objects
+        if (segval >= visited.size())
+            continue;  // this cannot be a real pointer
+        if (visited.test(segval))
+            continue;
+        visited.set(segval);
+
+        ObjectPair result;
+        bool success = state.addressSpace.resolveOneConstantSegment(
+            KValue(ConstantExpr::alloc(segval, Expr::Int64),
+                   ConstantExpr::alloc(0, Expr::Int64)),
+            result);
+        if (success) {
+            if (reachable.insert(result.first).second) {
+                // if we haven't found this memory before,
+                // add it to the worklist for processing
+                worklist.push_back(result.second);
+            }
+        } else {
+            if (state.addressSpace.removedObjectsMap.count(segval) > 0)
+                continue; // this memory object has been freed
+
+            klee_warning("Failed resolving segment in memcleanup check");
+            retval = false;
+        }
+      }
     }
 
     return retval;
@@ -4001,6 +5348,16 @@ void Executor::reportError(const llvm::Twine &message,
   interpreterHandler->processTestCase(state, msg.str().c_str(), file_suffix);
 }
 
+void Executor::traceTermination(const ExecutionState &state,
+                                StateTerminationType terminationType) {
+  if (!eventTrace)
+    return;
+  eventTrace->record(terminationType == StateTerminationType::Merge
+                         ? EventTrace::Merge
+                         : EventTrace::Terminate,
+                     state.getID(), static_cast<std::uint8_t>(terminationType));
+}
+
 void Executor::terminateStateOnExit(ExecutionState &state) {
   if ((CheckLeaks || CheckMemCleanup) && hasMemoryLeaks(state)) {
     if (CheckMemCleanup) {
@@ -4036,6 +5393,7 @@ void Executor::terminateStateOnExit(ExecutionState &state) {
       }
 
       // all good, just terminate the state
+      traceTermination(state, StateTerminationType::Exit);
       terminateState(state);
     }
   } else {
@@ -4047,6 +5405,7 @@ void Executor::terminateStateOnExit(ExecutionState &state) {
           terminationTypeFileExtension(StateTerminationType::Exit).c_str());
 
     interpreterHandler->incPathsCompleted();
+    traceTermination(state, StateTerminationType::Exit);
     terminateState(state);
   }
 }
@@ -4062,6 +5421,7 @@ void Executor::terminateStateEarly(ExecutionState &state, const Twine &message,
         terminationTypeFileExtension(terminationType).c_str());
   }
 
+  traceTermination(state, terminationType);
   terminateState(state);
 }
 
@@ -4169,6 +5529,7 @@ void Executor::terminateStateOnError(ExecutionState &state,
     reportError(messaget, state, info, suffix, terminationType);
   }
 
+  traceTermination(state, terminationType);
   terminateState(state);
 }
 
@@ -4377,14 +5738,23 @@ void Executor::callExternalFunction(ExecutionState &state,
   memset(args, 0, allocatedBytes);
   unsigned wordIndex = 2;
   SegmentAddressMap resolvedMOs;
+  // symbolic bytes of all arguments get their values from one model
+  std::shared_ptr<const Assignment> argumentModel;
   for (std::vector<Cell>::const_iterator ai = arguments.begin(),
        ae = arguments.end(); ai!=ae; ++ai) {
     uint64_t address = 0;
     if (ExternalCalls == ExternalCallPolicy::All) { // don't bother checking uniqueness
       auto value = optimizer.optimizeExpr(ai->getValue(), true);
-      ref<ConstantExpr> ce;
+      ref<ConstantExpr> ce = dyn_cast<ConstantExpr>(value);
+      // symbolic arguments come from the model of the bytes as well
+      if (ce.isNull() && !argumentModel)
+        solver->getInitialValues(state.constraints, argumentModel,
+                                 state.queryMetaData);
+      if (ce.isNull() && argumentModel)
+        ce = dyn_cast<ConstantExpr>(argumentModel->evaluate(value));
       // TODO segment
       bool success =
+          !ce.isNull() ||
           solver->getValue(state.constraints, value, ce, state.queryMetaData);
       assert(success && "FIXME: Unhandled solver failure");
       ce->toMemory(&args[wordIndex]);
@@ -4399,7 +5769,7 @@ void Executor::callExternalFunction(ExecutionState &state,
               op.first->segment, address);
           if (!found) {
             void *addr = memory->allocateMemory(
-                op.first->allocatedSize,
+                op.first, op.first->allocatedSize,
                 getAllocationAlignment(op.first->allocSite));
             if (!addr)
               klee_error("Couldn't allocate memory for external function");
@@ -4415,7 +5785,9 @@ void Executor::callExternalFunction(ExecutionState &state,
                                       callable->getName());
             return;
           }
-          op.second->flushToConcreteStore(solver, state);
+          if (op.second->hasKnownSymbolics())
+            state.addressSpace.getWriteable(op.first, op.second)
+                ->flushToConcreteStore(solver, state, argumentModel);
         }
       }
       wordIndex += (ce->getWidth()+63)/64;
@@ -4440,7 +5812,7 @@ void Executor::callExternalFunction(ExecutionState &state,
               op.first->segment, address);
           if (!found) {
             void *addr = memory->allocateMemory(
-                op.first->allocatedSize,
+                op.first, op.first->allocatedSize,
                 getAllocationAlignment(op.first->allocSite));
             if (!addr)
               klee_error("Couldn't allocate memory for external function");
@@ -4526,7 +5898,7 @@ void Executor::callExternalFunction(ExecutionState &state,
     os << "calling external: " << callable->getName().str() << "(";
     for (unsigned i=0; i<arguments.size(); i++) {
       if (arguments[i].value->isZero()) {
-        os << "segment: " << arguments[i].pointerSegment;
+        os << "segment: " << arguments[i].getSegment();
       } else {
         os << "value/address: " << arguments[i].value;
       }
@@ -4541,17 +5913,48 @@ void Executor::callExternalFunction(ExecutionState &state,
       klee_warning_once(callable->getValue(), "%s", os.str().c_str());
   }
 
-  bool success = externalDispatcher->executeCall(callable, target->inst, args);
-  if (!success) {
-    terminateStateOnError(state, "failed external call: " + callable->getName(),
-                          StateTerminationType::External);
-    return;
-  }
+  // calls to pure externals without pointer arguments are looked up by their
+  // argument words; the result is in the first words of args
+  Type *resultType = target->inst->getType();
+  bool pureCall =
+      CachePureExternals && func && resolvedMOs.empty() &&
+      (cast<CallBase>(target->inst)->doesNotAccessMemory() ||
+       std::find(PureExternals.begin(), PureExternals.end(),
+                 func->function->getName()) != PureExternals.end());
+  auto pureKey = std::make_pair(
+      func ? func->function : nullptr,
+      pureCall ? std::vector<uint64_t>(args + 2, args + wordIndex)
+               : std::vector<uint64_t>());
+  auto cached = pureCall ? pureExternalResults.find(pureKey)
+                         : pureExternalResults.end();
+
+  if (cached != pureExternalResults.end()) {
+    ++stats::cachedExternalCalls;
+    std::copy(cached->second.begin(), cached->second.end(), args);
+  } else {
+    bool success =
+        externalDispatcher->executeCall(callable, target->inst, args);
+    if (!success) {
+      terminateStateOnError(state,
+                            "failed external call: " + callable->getName(),
+                            StateTerminationType::External);
+      return;
+    }
 
-  if (!state.addressSpace.copyInConcretes(resolvedMOs, state, solver)) {
-    terminateStateOnError(state, "external modified read-only object",
-                          StateTerminationType::External);
-    return;
+    if (!state.addressSpace.copyInConcretes(resolvedMOs, state, solver)) {
+      terminateStateOnError(state, "external modified read-only object",
+                            StateTerminationType::External);
+      return;
+    }
+
+    if (pureCall) {
+      unsigned resultWords =
+          resultType->isVoidTy()
+              ? 0
+              : (getWidthForLLVMType(resultType) + 63) / 64;
+      pureExternalResults.emplace(
+          std::move(pureKey), std::vector<uint64_t>(args, args + resultWords));
+    }
   }
 
 //#ifndef WINDOWS
@@ -4561,7 +5964,6 @@ void Executor::callExternalFunction(ExecutionState &state,
 //                                    (uint64_t)&error, state, solver);
 //#endif
 
-  Type *resultType = target->inst->getType();
   if (!resultType->isVoidTy()) {
     KValue value;
     ref<Expr> returnVal =
@@ -4628,7 +6030,7 @@ ObjectState *Executor::bindObjectInState(ExecutionState &state,
   // matter because all we use this list for is to unbind the object
   // on function return.
   if (isLocal)
-    state.stack.back().allocas.push_back(mo);
+    state.stack.getWriteableBack().allocas.push_back(mo);
 
   return os;
 }
@@ -4653,6 +6055,7 @@ Executor::executeAlloc(ExecutionState &state,
     bindLocal(target, state,
               KValue(ConstantExpr::alloc(0, Context::get().getPointerWidth())));
   } else {
+    mo->isPointerFree = kmodule->pointerFreeAllocSites.count(allocSite) > 0;
     bindLocal(target, state, mo->getPointer());
     if (!reallocFrom) {
       ObjectState *os = bindObjectInState(state, mo, isLocal);
@@ -4662,12 +6065,10 @@ Executor::executeAlloc(ExecutionState &state,
         os->initializeToRandom();
       }
     } else {
-      ObjectState *os = new ObjectState(*reallocFrom, mo);
       auto *oldobj = const_cast<MemoryObject*>(reallocFrom->getObject());
-      state.addressSpace.removedObjectsMap.emplace(
+      state.addressSpace.addRemovedObject(
           oldobj->segment, oldobj->getSymbolicAddress(arrayCache));
-      state.addressSpace.unbindObject(oldobj);
-      state.addressSpace.bindObject(mo, os);
+      state.addressSpace.reallocateObject(mo, reallocFrom);
     }
   }
   return mo;
@@ -4700,7 +6101,7 @@ void Executor::executeFree(ExecutionState &state,
                               StateTerminationType::Free,
                               getKValueInfo(*it->second, addressOptim));
       } else {
-        it->second->addressSpace.removedObjectsMap.emplace(
+        it->second->addressSpace.addRemovedObject(
             mo->segment, const_cast<MemoryObject*>(mo)->getSymbolicAddress(arrayCache));
         it->second->addressSpace.unbindObject(mo);
         if (target)
@@ -4753,6 +6154,132 @@ void Executor::executeMemoryWrite(ExecutionState &state,
                                   const KValue &value) {
   executeMemoryOperation(state, true, address, value, 0);
 }
+void Executor::executeInBoundsAccess(ExecutionState &state, bool isWrite,
+                                     const ObjectPair &op,
+                                     const ref<Expr> &offset,
+                                     const KValue &value, Expr::Width type,
+                                     KInstruction *target) {
+  const MemoryObject *mo = op.first;
+  const ObjectState *os = op.second;
+  if (isWrite) {
+    if (os->readOnly) {
+      terminateStateOnError(state, "memory error: object read only",
+                            StateTerminationType::ReadOnly);
+    } else {
+      ObjectState *wos = state.addressSpace.getWriteable(mo, os);
+      wos->write(offset, value);
+      recordArrayReaders(state, mo, value);
+      recordEscape(state, mo, value);
+    }
+  } else {
+    KValue result = os->read(offset, type);
+
+    if (interpreterOpts.MakeConcreteSymbolic) {
+      result = KValue(replaceReadWithSymbolic(state, result.getSegment()),
+                      replaceReadWithSymbolic(state, result.getOffset()));
+    }
+
+    bindLocal(target, state, result);
+  }
+}
+
+bool Executor::executeMergedRead(ExecutionState &state, const KValue &address,
+                                 const ResolutionList &rl, unsigned bytes,
+                                 Expr::Width type, KInstruction *target,
+                                 ExecutionState *&unbound) {
+  const ref<Expr> &offset = address.getOffset();
+  // reads at constant offsets must be known to be in bounds of the object
+  if (isa<ConstantExpr>(offset)) {
+    for (const ObjectPair &op : rl)
+      if (!isa<ConstantExpr>(op.first->getSizeExpr()))
+        return false;
+  }
+
+  // Build the read back to front, the last target is the default value of
+  // the if-then-else chain as one of the targets must be in bounds.
+  ref<Expr> anyInBounds = ConstantExpr::alloc(0, Expr::Bool);
+  llvm::Optional<KValue> result;
+  for (auto it = rl.rbegin(), ie = rl.rend(); it != ie; ++it) {
+    ref<Expr> inBounds = it->first->getBoundsCheckPointer(address, bytes);
+    if (inBounds->isFalse())
+      continue;
+    KValue value = it->second->read(offset, type);
+    if (result) {
+      value = KValue(
+          SelectExpr::create(inBounds, value.getSegment(),
+                             result->getSegment()),
+          SelectExpr::create(inBounds, value.getOffset(), result->getOffset()));
+    }
+    result = value;
+    anyInBounds = OrExpr::create(inBounds, anyInBounds);
+  }
+  ++stats::mergedResolutions;
+
+  StatePair branches = fork(state, anyInBounds, true, BranchType::MemOp);
+  if (branches.first)
+    bindLocal(target, *branches.first, *result);
+  unbound = branches.second;
+  return true;
+}
+
+void Executor::forkOnSymArrayOffsets(ExecutionState &state, bool isWrite,
+                                     const KValue &address,
+                                     const KValue &value,
+                                     KInstruction *target) {
+  ref<Expr> segment =
+      toConstant(state, address.getSegment(), "max-sym-array-size");
+  ref<Expr> offset = address.getOffset();
+
+  // each model of the offset excludes itself from the next query, until
+  // the offsets found are either all there are or the limit
+  ConstraintSet remaining(state.constraints);
+  ConstraintManager cm(remaining);
+  std::vector<ref<Expr>> conditions;
+  std::vector<ref<Expr>> offsets;
+  ref<Expr> others = ConstantExpr::create(1, Expr::Bool);
+  bool exhaustive = false;
+  for (;;) {
+    ref<ConstantExpr> value;
+    bool success =
+        solver->getValue(remaining, offset, value, state.queryMetaData);
+    if (success) {
+      offsets.push_back(value);
+      conditions.push_back(EqExpr::create(offset, value));
+      others = AndExpr::create(others, Expr::createIsZero(conditions.back()));
+      bool mayBeOther;
+      success = solver->mayBeTrue(state.constraints, others, mayBeOther,
+                                  state.queryMetaData);
+      exhaustive = !mayBeOther;
+    }
+    if (!success) {
+      state.pc = state.prevPC;
+      terminateStateOnSolverError(state,
+                                  "Query timed out (max-sym-array-size).");
+      return;
+    }
+    if (exhaustive || offsets.size() == MaxSymArrayConcretizations)
+      break;
+    cm.addConstraint(Expr::createIsZero(conditions.back()));
+  }
+  if (!exhaustive)
+    conditions.push_back(others);
+
+  std::vector<ExecutionState *> branches;
+  branch(state, conditions, branches, BranchType::MemOp);
+  for (unsigned i = 0; i < branches.size(); ++i) {
+    ExecutionState *es = branches[i];
+    if (!es)
+      continue;
+    // the remaining offsets are concretized to a single one as before
+    ref<Expr> esOffset = i < offsets.size()
+                             ? offsets[i]
+                             : ref<Expr>(toConstant(*es, offset,
+                                                    "max-sym-array-size"));
+    executeMemoryOperation(*es, isWrite, KValue(segment, esOffset), value,
+                           target);
+  }
+}
+
 void Executor::executeMemoryOperation(ExecutionState &state,
                                       bool isWrite,
                                       KValue address,
@@ -4771,13 +6298,38 @@ void Executor::executeMemoryOperation(ExecutionState &state,
     }
   }
 
+  // fast path: accesses proven to be in bounds of their alloca or global
+  // when the module was prepared
+  if (state.prevPC->inBounds && address.isConstant()) {
+    ObjectPair op;
+    if (state.addressSpace.resolveOneConstantSegment(address, op)) {
+      ++stats::boundsChecksStatic;
+      executeInBoundsAccess(state, isWrite, op, address.getOffset(), value,
+                            type, target);
+      return;
+    }
+  }
+
   address = KValue(address.getSegment(),
                    optimizer.optimizeExpr(address.getOffset(), true));
 
+  // fast path: symbolic accesses already proven to be in bounds
+  bool cacheable = !address.isConstant() && !MaxSymArraySize;
+  if (cacheable) {
+    ObjectPair op = state.lookupResolution(state.prevPC, address, bytes);
+    if (op.second) {
+      ++stats::resolutionCacheHits;
+      executeInBoundsAccess(state, isWrite, op, address.getOffset(), value,
+                            type, target);
+      return;
+    }
+  }
+
   // fast path: single in-bounds resolution
   ObjectPair op;
   bool success = false;
-  solver->setTimeout(coreSolverTimeout);
+  solver->setTimeout(boundsCheckSolverTimeout,
+                     TimingSolver::QueryKind::BoundsCheck);
   llvm::Optional<uint64_t> offsetVal;
   if (!state.addressSpace.resolveOne(state, solver, address, op, success,
                                      offsetVal)) {
@@ -4785,6 +6337,7 @@ void Executor::executeMemoryOperation(ExecutionState &state,
         KValue(toConstant(state, address.getSegment(), "resolveOne failure"),
                toConstant(state, address.getOffset(), "resolveOne failure"));
     success = state.addressSpace.resolveOneConstantSegment(address, op);
+    cacheable = false;
   }
   solver->setTimeout(time::Span());
 
@@ -4794,6 +6347,11 @@ void Executor::executeMemoryOperation(ExecutionState &state,
     if (MaxSymArraySize &&
         (!isa<ConstantExpr>(mo->size) ||
          cast<ConstantExpr>(mo->size)->getZExtValue() >= MaxSymArraySize)) {
+      if (MaxSymArrayConcretizations > 1 &&
+          !isa<ConstantExpr>(address.getOffset())) {
+        forkOnSymArrayOffsets(state, isWrite, address, value, target);
+        return;
+      }
       address =
           KValue(toConstant(state, address.getSegment(), "max-sym-array-size"),
                  toConstant(state, address.getOffset(), "max-sym-array-size"));
@@ -4809,46 +6367,55 @@ void Executor::executeMemoryOperation(ExecutionState &state,
       offset = address.getOffset();
     }
 
+    // Both checks fold to constants for concrete segments and offsets into
+    // objects of concrete size, otherwise they are decided in a single query.
     ref<Expr> isEqualSegment = EqExpr::create(mo->getSegmentExpr(), segment);
-
     ref<Expr> isOffsetInBounds = mo->getBoundsCheckOffset(offset, bytes);
-    isOffsetInBounds = optimizer.optimizeExpr(isOffsetInBounds, true);
-
-    bool inBoundsOffset;
-    bool inBoundsSegment;
-    solver->setTimeout(coreSolverTimeout);
-    bool successSegment = solver->mustBeTrue(
-        state.constraints, isEqualSegment, inBoundsSegment, state.queryMetaData);
-    bool success = solver->mustBeTrue(
-        state.constraints, isOffsetInBounds, inBoundsOffset, state.queryMetaData);
-    solver->setTimeout(time::Span());
-    if (!success || !successSegment) {
-      state.pc = state.prevPC;
-      terminateStateOnSolverError(state, "Query timed out (bounds check).");
-      return;
-    }
-
-    if (inBoundsSegment && inBoundsOffset) {
-      const ObjectState *os = op.second;
-      if (isWrite) {
-        if (os->readOnly) {
-          terminateStateOnError(state, "memory error: object read only",
-                                StateTerminationType::ReadOnly);
-        } else {
-          ObjectState *wos = state.addressSpace.getWriteable(mo, os);
-          wos->write(offset, value);
-        }          
-      } else {
-        KValue result = os->read(offset, type);
-        
-        if (interpreterOpts.MakeConcreteSymbolic) {
-          result = KValue(replaceReadWithSymbolic(state, result.getSegment()),
-                          replaceReadWithSymbolic(state, result.getOffset()));
-        }
-
-        bindLocal(target, state, result);
+    if (!isa<ConstantExpr>(isOffsetInBounds))
+      isOffsetInBounds = optimizer.optimizeExpr(isOffsetInBounds, true);
+    ref<Expr> check = AndExpr::create(isEqualSegment, isOffsetInBounds);
+
+    // constant offsets into an object of symbolic size are checked against
+    // the bounds proven before
+    auto *constantOffset = dyn_cast<ConstantExpr>(offset);
+    bool sizeBounds = constantOffset && !isa<ConstantExpr>(mo->size) &&
+                      isa<ConstantExpr>(isEqualSegment) &&
+                      cast<ConstantExpr>(isEqualSegment)->isTrue();
+    llvm::Optional<bool> cachedBounds;
+    if (sizeBounds)
+      cachedBounds = state.lookupSizeBounds(mo, bytes,
+                                            constantOffset->getZExtValue());
+
+    bool inBounds;
+    if (auto *CE = dyn_cast<ConstantExpr>(check)) {
+      ++stats::boundsChecksFolded;
+      inBounds = CE->isTrue();
+    } else if (cachedBounds) {
+      ++stats::boundsChecksCached;
+      inBounds = *cachedBounds;
+    } else if (auto decided = decideByRanges(state, check)) {
+      inBounds = *decided;
+    } else {
+      ++stats::boundsChecksQueried;
+      solver->setTimeout(boundsCheckSolverTimeout,
+                         TimingSolver::QueryKind::BoundsCheck);
+      bool success = solver->mustBeTrue(state.constraints, check, inBounds,
+                                        state.queryMetaData);
+      solver->setTimeout(time::Span());
+      if (!success) {
+        state.pc = state.prevPC;
+        terminateStateOnSolverError(state, "Query timed out (bounds check).");
+        return;
       }
+      if (sizeBounds)
+        state.cacheSizeBounds(mo, bytes, constantOffset->getZExtValue(),
+                              inBounds);
+    }
 
+    if (inBounds) {
+      if (cacheable && !offsetVal)
+        state.cacheResolution(state.prevPC, address, bytes, mo);
+      executeInBoundsAccess(state, isWrite, op, offset, value, type, target);
       return;
     }
   } 
@@ -4859,14 +6426,21 @@ void Executor::executeMemoryOperation(ExecutionState &state,
   auto addressOptim = KValue(address.getSegment(),
                              optimizer.optimizeExpr(address.getOffset(), true));
   ResolutionList rl;  
-  solver->setTimeout(coreSolverTimeout);
+  solver->setTimeout(boundsCheckSolverTimeout,
+                     TimingSolver::QueryKind::BoundsCheck);
   bool incomplete = state.addressSpace.resolve(state, solver, addressOptim, rl,
-                                               0, coreSolverTimeout);
+                                               0, boundsCheckSolverTimeout);
   solver->setTimeout(time::Span());
   
   // XXX there is some query wasteage here. who cares?
   ExecutionState *unbound = &state;
-  
+
+  if (!isWrite && MergeMemoryResolutions && rl.size() > 1 &&
+      executeMergedRead(state, addressOptim, rl, bytes, type, target,
+                        unbound)) {
+    rl.clear();
+  }
+
   for (ResolutionList::iterator i = rl.begin(), ie = rl.end(); i != ie; ++i) {
     const MemoryObject *mo = i->first;
     const ObjectState *os = i->second;
@@ -4885,6 +6459,8 @@ void Executor::executeMemoryOperation(ExecutionState &state,
           ObjectState *wos = bound->addressSpace.getWriteable(mo, os);
           // TODO segment
           wos->write(addressOptim.getOffset(), value);
+          recordArrayReaders(*bound, mo, value);
+          recordEscape(*bound, mo, value);
         }
       } else {
         KValue result = os->read(addressOptim.getOffset(), type);
@@ -4915,14 +6491,25 @@ KValue Executor::createNondetValue(ExecutionState &state,
                                    const std::string &name,
                                    bool isPointer) {
   assert(!replayKTest);
-  // Find a unique name for this array.  First try the original name,
-  // or if that fails try adding a unique identifier.
-  unsigned id = 0;
-  std::string uniqueName = name;
-  while (!state.arrayNames.insert(uniqueName).second) {
-    uniqueName = name + "_" + llvm::utostr(++id);
+  if (concreteReplay) {
+    klee_warning_once(kinst, "No value to replay for %s, using 0",
+                      name.c_str());
+    ref<Expr> zero = ConstantExpr::alloc(0, size);
+    KValue kval = isPointer ? KValue(zero, zero) : KValue(zero);
+    state.addNondetValue(kval, isSigned, kinst, name);
+    return kval;
+  }
+
+  if (kinst && kinst->fillsNondet && !isPointer) {
+    ref<Expr> value = readNondetFill(state, size, kinst, name);
+    if (!value.isNull()) {
+      state.addNondetValue(KValue(value), isSigned, kinst, name);
+      return value;
+    }
   }
 
+  std::string uniqueName = state.getUniqueArrayName(name);
+
   KValue kval;
   const Array *array = arrayCache.CreateArray(uniqueName, size);
   auto expr = Expr::createTempRead(array, size);
@@ -4930,7 +6517,7 @@ KValue Executor::createNondetValue(ExecutionState &state,
   if (isPointer) {
     assert(!isSigned && "Got signed pointer");
     std::string offName = uniqueName + "_off";
-    bool had = state.arrayNames.insert(offName).second;
+    bool had = state.addArrayName(offName);
     assert(had && "Already had a unique name");
     (void)had;
 
@@ -4940,27 +6527,136 @@ KValue Executor::createNondetValue(ExecutionState &state,
     kval = {expr, offexpr};
   } else {
     kval = expr;
+
+    // in seed mode the nondet values of the seeds are bound as well, which
+    // a fuzzer's seeds hold
+    auto it = seedMap.find(&state);
+    if (it != seedMap.end()) {
+      for (SeedInfo &si : it->second) {
+        std::vector<unsigned char> &values = si.assignment.bindings[array];
+        values.assign(array->size, 0);
+        if (KTestObject *obj = si.getNondetInput(name))
+          std::copy(obj->bytes,
+                    obj->bytes + std::min<unsigned>(obj->numBytes, array->size),
+                    values.begin());
+      }
+    }
   }
 
-  auto& nv = state.addNondetValue(kval, isSigned, name);
-  nv.kinstruction = kinst;
+  state.addNondetValue(kval, isSigned, kinst, name);
 
   return kval;
 }
 
+ref<Expr> Executor::readNondetFill(ExecutionState &state, unsigned size,
+                                   KInstruction *kinst,
+                                   const std::string &name) {
+  auto it = state.nondetFills.find(kinst->inst);
+  if (it == state.nondetFills.end() || !it->second.sequential ||
+      size % 8 != 0)
+    return nullptr;
+  ExecutionState::NondetFill &fill = it->second;
+  const unsigned bytes = size / 8;
+  // the rest of the buffer is backed by one array, with the name of the
+  // values that fill it
+  if (!fill.array) {
+    if (!fill.left)
+      return nullptr;
+    fill.array = arrayCache.CreateArray(state.getUniqueArrayName(name),
+                                        fill.left * bytes);
+    fill.next = 0;
+  }
+  if (fill.next >= fill.array->size / bytes)
+    return nullptr;
+
+  const uint64_t offset = fill.next++ * bytes;
+  ++stats::batchedNondetValues;
+  UpdateList ul(fill.array, 0);
+  ref<Expr> value =
+      ReadExpr::create(ul, ConstantExpr::alloc(offset, Expr::Int32));
+  for (unsigned i = 1; i < bytes; ++i)
+    value = ConcatExpr::create(
+        ReadExpr::create(ul, ConstantExpr::alloc(offset + i, Expr::Int32)),
+        value);
+
+  // the element is bound to the nondet value of the seed, like an array of
+  // its own
+  auto seeds = seedMap.find(&state);
+  if (seeds != seedMap.end()) {
+    for (SeedInfo &si : seeds->second) {
+      std::vector<unsigned char> &values = si.assignment.bindings[fill.array];
+      values.resize(fill.array->size);
+      if (KTestObject *obj = si.getNondetInput(name))
+        std::copy(obj->bytes, obj->bytes + std::min(obj->numBytes, bytes),
+                  values.begin() + offset);
+    }
+  }
+  return value;
+}
+
+void Executor::noteNondetFill(ExecutionState &state, KInstruction *ki,
+                              const KValue &address) {
+  const auto *call = cast<Instruction>(ki->inst->getOperand(0));
+  const auto *offset = dyn_cast<ConstantExpr>(address.getOffset());
+  ObjectPair op;
+  if (!address.hasConstantSegment() || !offset ||
+      !state.addressSpace.findSegment(address.getConstantSegment(), op) ||
+      !isa<ConstantExpr>(op.first->size)) {
+    state.nondetFills.erase(call);
+    return;
+  }
+
+  const uint64_t bytes =
+      getWidthForLLVMType(ki->inst->getOperand(0)->getType()) / 8;
+  const uint64_t size = cast<ConstantExpr>(op.first->size)->getZExtValue();
+  const uint64_t at = offset->getZExtValue();
+  ExecutionState::NondetFill &fill = state.nondetFills[call];
+  bool sequential = fill.segment == address.getConstantSegment() &&
+                    fill.offset == at;
+  // another buffer, or another order, drops the array
+  if (!sequential)
+    fill = ExecutionState::NondetFill();
+  fill.segment = address.getConstantSegment();
+  fill.offset = at + bytes;
+  fill.left = at < size && bytes <= size - at ? (size - at) / bytes - 1 : 0;
+  fill.sequential = sequential;
+}
+
 
 void Executor::executeMakeSymbolic(ExecutionState &state, 
                                    const MemoryObject *mo,
                                    const std::string &name) {
+  if (concreteReplay) {
+    auto it = replayObjects.find(mo->name);
+    auto *CE = dyn_cast<ConstantExpr>(mo->size);
+    if (!CE) {
+      terminateStateOnUserError(state, "symbolic size object in replay");
+      return;
+    }
+    bool found = it != replayObjects.end();
+    std::vector<unsigned char> data;
+    if (found) {
+      data = std::move(it->second);
+      replayObjects.erase(it);
+    }
+    // a fuzzer's inputs are made to fit the objects
+    if (fuzzing) {
+      data.resize(CE->getZExtValue());
+    } else if (!found) {
+      terminateStateOnUserError(state, "replay count mismatch");
+      return;
+    } else if (data.size() != CE->getZExtValue()) {
+      terminateStateOnUserError(state, "replay size mismatch");
+      return;
+    }
+    executeMakeConcrete(state, mo, data);
+    state.replayedObjects.emplace_back(mo->name, std::move(data));
+    return;
+  }
+
   // Create a new object state for the memory object (instead of a copy).
   if (!replayKTest) {
-    // Find a unique name for this array.  First try the original name,
-    // or if that fails try adding a unique identifier.
-    unsigned id = 0;
-    std::string uniqueName = name;
-    while (!state.arrayNames.insert(uniqueName).second) {
-      uniqueName = name + "_" + llvm::utostr(++id);
-    }
+    std::string uniqueName = state.getUniqueArrayName(name);
     // TODO fix seeding fo symbolic sizes
     unsigned size = 0;
     if (ConstantExpr *CE = dyn_cast<ConstantExpr>(mo->size)) {
@@ -4969,6 +6665,8 @@ void Executor::executeMakeSymbolic(ExecutionState &state,
     const Array *array = arrayCache.CreateArray(uniqueName, size);
     bindObjectInState(state, mo, false, array);
     state.addSymbolic(mo, array);
+    if (ivcEnabled)
+      state.addArrayReader(array, mo);
     
     std::map< ExecutionState*, std::vector<SeedInfo> >::iterator it = 
       seedMap.find(&state);
@@ -5052,8 +6750,28 @@ void Executor::runFunctionAsMain(Function *f,
 				 int argc,
 				 char **argv,
 				 char **envp) {
+  startFunctionAsMain(f, argc, argv, envp);
+  while (step(std::numeric_limits<std::uint64_t>::max()))
+    ;
+  finishRun();
+}
+
+void Executor::startFunctionAsMain(Function *f, int argc, char **argv,
+                                   char **envp) {
+  assert(!processTree && "a run was started already");
   std::vector<KValue> arguments;
 
+  // the files of the first run are opened in the output directory the
+  // handler has now, which a forked batch run changes after setModule
+  if (statsTracker)
+    statsTracker->openOutput();
+  if (WriteEventTrace && !eventTrace) {
+    if (auto os = interpreterHandler->openOutputFile("events.trace")) {
+      eventTrace = std::make_unique<EventTrace>(std::move(os));
+      solver->trace = eventTrace.get();
+    }
+  }
+
   // force deterministic initialization of memory objects
   srand(1);
   srandom(1);
@@ -5095,11 +6813,14 @@ void Executor::runFunctionAsMain(Function *f,
     }
   }
 
+  kmodule->resolveInfos(kmodule->functionMap[f]);
   ExecutionState *state = new ExecutionState(kmodule->functionMap[f]);
+  if (UseIndependentSolver && IncrementalIndependence)
+    state->constraints.trackIndependence();
 
-  if (pathWriter) 
+  if (pathWriter && !PathsFromPTree)
     state->pathOS = pathWriter->open();
-  if (symPathWriter) 
+  if (symPathWriter && !PathsFromPTree)
     state->symPathOS = symPathWriter->open();
 
 
@@ -5137,14 +6858,42 @@ void Executor::runFunctionAsMain(Function *f,
   }
   
   initializeGlobals(*state);
+  serializeLandingpads();
+
+  std::unique_ptr<llvm::raw_ostream> ptreeLog;
+  if (WritePTreeLog) {
+    // forked workers would write into the same file
+    if (PrefixWorkersOpt > 1 || ParallelWorkersOpt > 1 ||
+        userSearcherPortfolioSize() > 1)
+      klee_warning("--write-ptree-log is not supported with workers or a "
+                   "portfolio, ignoring it");
+    else if (!(ptreeLog = interpreterHandler->openOutputFile("ptree.log")))
+      klee_warning("unable to open ptree.log, not logging the process tree");
+  }
+  processTree = std::make_unique<PTree>(state, std::move(ptreeLog));
+  exploring = startExploration(*state);
+}
 
-  processTree = std::make_unique<PTree>(state);
-  run(*state);
+bool Executor::step(std::uint64_t budget) {
+  if (exploring && !stepExploration(budget)) {
+    finishExploration();
+    exploring = false;
+  }
+  return exploring;
+}
+
+void Executor::finishRun() {
+  if (exploring) {
+    // the remaining states are handled as on a halt
+    haltExecution = true;
+    finishExploration();
+    exploring = false;
+  }
   processTree = nullptr;
 
   // hack to clear memory objects
   delete memory;
-  memory = new MemoryManager(nullptr, NumPtrBytes * 8);
+  memory = new MemoryManager(nullptr, Context::get().getPointerWidth());
 
   globalObjects.clear();
   globalAddresses.clear();
@@ -5153,6 +6902,18 @@ void Executor::runFunctionAsMain(Function *f,
     statsTracker->done();
 }
 
+Interpreter::RunStatistics Executor::getRunStatistics() const {
+  RunStatistics result;
+  result.instructions = stats::instructions;
+  result.coveredInstructions = stats::coveredInstructions;
+  result.uncoveredInstructions = stats::uncoveredInstructions;
+  result.forks = stats::forks;
+  result.queries = stats::queries;
+  result.solverTime = stats::solverTime;
+  result.states = states.size() + (stateSwap ? stateSwap->size() : 0);
+  return result;
+}
+
 unsigned Executor::getPathStreamID(const ExecutionState &state) {
   assert(pathWriter);
   return state.pathOS.getID();
@@ -5163,6 +6924,35 @@ unsigned Executor::getSymbolicPathStreamID(const ExecutionState &state) {
   return state.symPathOS.getID();
 }
 
+void Executor::getPathBranches(const ExecutionState &state, bool symbolic,
+                               std::vector<unsigned char> &branches) {
+  if (PathsFromPTree) {
+    std::string path = PTree::getPath(state.ptreeNode, symbolic);
+    branches.assign(path.begin(), path.end());
+    return;
+  }
+  if (symbolic)
+    symPathWriter->readStream(getSymbolicPathStreamID(state), branches);
+  else
+    pathWriter->readStream(getPathStreamID(state), branches);
+}
+
+void Executor::recordBranch(ExecutionState &state, const char *branch,
+                            bool forked) {
+  if (pathWriter) {
+    if (PathsFromPTree)
+      state.ptreeNode->path += branch;
+    else
+      state.pathOS << branch;
+  }
+  if (forked && symPathWriter) {
+    if (PathsFromPTree)
+      state.ptreeNode->symPath += branch;
+    else
+      state.symPathOS << branch;
+  }
+}
+
 void Executor::getConstraintLog(const ExecutionState &state, std::string &res,
                                 Interpreter::LogType logFormat) {
 
@@ -5202,8 +6992,62 @@ bool Executor::getSymbolicSolution(const ExecutionState &state,
                                    std::pair<std::string,
                                    std::vector<unsigned char> > >
                                    &res) {
+  auto it = dumpedSolutions.find(&state);
+  if (it != dumpedSolutions.end()) {
+    res = std::move(*it->second);
+    dumpedSolutions.erase(it);
+    return true;
+  }
+  if (getSeedSolution(state, res))
+    return true;
+  return computeSymbolicSolution(state, res);
+}
 
-  solver->setTimeout(coreSolverTimeout);
+bool Executor::getSeedSolution(
+    const ExecutionState &state,
+    std::vector<std::pair<std::string, std::vector<unsigned char>>> &res) {
+  // preferred and nondeterministic values are left to the solver
+  if (!FastForwardSeeds || !state.cexPreferences.empty() ||
+      !state.nondetValues.empty())
+    return false;
+  auto it = seedMap.find(const_cast<ExecutionState *>(&state));
+  if (it == seedMap.end())
+    return false;
+
+  for (const SeedInfo &si : it->second) {
+    bool satisfies = std::all_of(
+        state.constraints.begin(), state.constraints.end(),
+        [&](const ref<Expr> &c) {
+          auto CE = dyn_cast<ConstantExpr>(si.assignment.evaluate(c));
+          return CE && CE->isTrue();
+        });
+    if (!satisfies)
+      continue;
+
+    std::vector<std::pair<std::string, std::vector<unsigned char>>> solution;
+    bool complete = true;
+    state.symbolics.forEach([&](const auto &symbolic) {
+      auto CE = dyn_cast<ConstantExpr>(symbolic.first->size);
+      auto binding = si.assignment.bindings.find(symbolic.second);
+      if (!CE || binding == si.assignment.bindings.end() ||
+          binding->second.size() != CE->getZExtValue())
+        complete = false;
+      else if (complete)
+        solution.emplace_back(symbolic.first->name, binding->second);
+    });
+    if (complete) {
+      res = std::move(solution);
+      return true;
+    }
+  }
+  return false;
+}
+
+bool Executor::computeSymbolicSolution(
+    const ExecutionState &state,
+    std::vector<std::pair<std::string, std::vector<unsigned char>>> &res) {
+  solver->setTimeout(testGenSolverTimeout,
+                     TimingSolver::QueryKind::TestGeneration);
 
   ConstraintSet extendedConstraints(state.constraints);
   ConstraintManager cm(extendedConstraints);
@@ -5233,7 +7077,7 @@ bool Executor::getSymbolicSolution(const ExecutionState &state,
   // try to minimize sizes of symbolic-size objects
   std::vector<uint64_t> sizes;
   sizes.reserve(state.symbolics.size());
-  for (const auto & symbolic : state.symbolics) {
+  state.symbolics.forEach([&](const auto &symbolic) {
     const auto &mo = symbolic.first;
     if (ConstantExpr *CE = dyn_cast<ConstantExpr>(mo->size)) {
       sizes.push_back(CE->getZExtValue());
@@ -5242,46 +7086,25 @@ bool Executor::getSymbolicSolution(const ExecutionState &state,
       sizes.push_back(pair.first->getZExtValue());
       cm.addConstraint(EqExpr::create(mo->size, pair.first));
     }
-  }
-
-  std::vector< std::vector<unsigned char> > values;
-  std::shared_ptr<const Assignment> assignment(nullptr);
-  if (!state.symbolics.empty()) {
-    bool success = solver->getInitialValues(extendedConstraints, assignment, state.queryMetaData);
-    solver->setTimeout(time::Span());
-    if (!success) {
-      klee_warning("unable to compute initial values (invalid constraints?)!");
-      ExprPPrinter::printQuery(llvm::errs(), state.constraints,
-                               ConstantExpr::alloc(0, Expr::Bool));
-      return false;
-    }
-  }
+  });
 
-  for (size_t i = 0; i < state.symbolics.size(); ++i) {
-    const auto &mo = state.symbolics[i].first;
-    const Array *array = state.symbolics[i].second;
-    std::vector<uint8_t> data;
-    data.reserve(sizes[i]);
-    if (auto vals = assignment->getBindingsOrNull(array)) {
-      data = vals->asVector();
-    }
-    data.resize(sizes[i]);
-    res.push_back(std::make_pair(mo->name, data));
-  }
-
-  // try to minimize the found values
+  // try to minimize the nondet values, before the objects are solved for so
+  // that both agree
   // We cannot use getTestVector(), as the values in .ktest
   // have different endiandness (byte 0 goes first, then byte 1, etc.)
-  for (auto& it : state.nondetValues) {
-    auto pair = solver->getRange(
-        extendedConstraints, it.value.getValue(), state.queryMetaData);
-    auto value = pair.first;
-    cm.addConstraint(EqExpr::create(it.value.getValue(), value));
-
-    pair = solver->getRange(
-        extendedConstraints, it.value.getSegment(), state.queryMetaData);
-    auto segment = pair.first;
-    cm.addConstraint(EqExpr::create(it.value.getSegment(), segment));
+  std::vector<std::pair<std::string, std::vector<unsigned char>>> nondets;
+  auto minimize = [&](const ref<Expr> &e) -> ref<ConstantExpr> {
+    // concrete values, e.g. those of a concrete replay, need no query
+    if (auto CE = dyn_cast<ConstantExpr>(e))
+      return CE;
+    auto min =
+        solver->getRange(extendedConstraints, e, state.queryMetaData).first;
+    cm.addConstraint(EqExpr::create(e, min));
+    return min;
+  };
+  state.nondetValues.forEach([&](const ExecutionState::NondetValue &it) {
+    auto value = minimize(it.value.getValue());
+    auto segment = minimize(it.value.getSegment());
 
     std::string descr = it.name;
     if (it.kinstruction) {
@@ -5301,7 +7124,7 @@ bool Executor::getSymbolicSolution(const ExecutionState &state,
         auto size = static_cast<unsigned>(w)/8;
         data.resize(size);
         memcpy(data.data(), &seg, size);
-        res.emplace_back(descr, data);
+        nondets.emplace_back(descr, data);
         descr += " (offset)";
     }
 
@@ -5313,8 +7136,38 @@ bool Executor::getSymbolicSolution(const ExecutionState &state,
     uint64_t val = value->getZExtValue();
     memcpy(data.data(), &val, size);
 
-    res.push_back(std::make_pair(descr, data));
+    nondets.push_back(std::make_pair(descr, data));
+  });
+
+  std::vector< std::vector<unsigned char> > values;
+  std::shared_ptr<const Assignment> assignment(nullptr);
+  if (!state.symbolics.empty()) {
+    bool success = solver->getInitialValues(extendedConstraints, assignment, state.queryMetaData);
+    solver->setTimeout(time::Span());
+    if (!success) {
+      klee_warning("unable to compute initial values (invalid constraints?)!");
+      ExprPPrinter::printQuery(llvm::errs(), state.constraints,
+                               ConstantExpr::alloc(0, Expr::Bool));
+      return false;
+    }
   }
+
+  state.replayedObjects.forEach(
+      [&](const auto &object) { res.push_back(object); });
+  size_t i = 0;
+  state.symbolics.forEach([&](const auto &symbolic) {
+    const auto &mo = symbolic.first;
+    const Array *array = symbolic.second;
+    std::vector<uint8_t> data;
+    data.reserve(sizes[i]);
+    if (auto vals = assignment->getBindingsOrNull(array)) {
+      data = vals->asVector();
+    }
+    data.resize(sizes[i++]);
+    res.push_back(std::make_pair(mo->name, data));
+  });
+  res.insert(res.end(), std::make_move_iterator(nondets.begin()),
+             std::make_move_iterator(nondets.end()));
   return true;
 }
 
@@ -5324,7 +7177,7 @@ Executor::getTestVector(const ExecutionState &state) {
   std::vector<NamedConcreteValue> res;
   res.reserve(state.nondetValues.size());
 
-  for (auto& it : state.nondetValues) {
+  state.nondetValues.forEach([&](const ExecutionState::NondetValue &it) {
     ref<ConstantExpr> value;
     bool success = solver->getValue(
         state.constraints, it.value.getValue(), value, state.queryMetaData);
@@ -5355,49 +7208,333 @@ Executor::getTestVector(const ExecutionState &state) {
             res.back().col = D.getCol();
         }
     }
-  }
+  });
   return res;
 }
 
 void Executor::getCoveredLines(const ExecutionState &state,
                                std::map<const std::string*, std::set<unsigned> > &res) {
-  res = state.coveredLines;
+  if (const auto *lines = state.coveredLines.get())
+    res = *lines;
+  else
+    res.clear();
+}
+
+void Executor::recordArrayReaders(ExecutionState &state,
+                                  const MemoryObject *mo,
+                                  const KValue &value) {
+  if (!ivcEnabled || isa<ConstantExpr>(value.value))
+    return;
+  std::vector<const Array *> arrays;
+  findSymbolicObjects(value.value, arrays);
+  for (const Array *array : arrays)
+    state.addArrayReader(array, mo);
+}
+
+void Executor::recordEscape(ExecutionState &state, const MemoryObject *mo,
+                            const KValue &value) {
+  if (!createsThreads || (mo->isLocal && !state.sharedObjects.count(mo->id)))
+    return;
+  const auto *segment = dyn_cast<ConstantExpr>(value.getSegment());
+  if (!segment || segment->isZero())
+    return;
+  if (const auto *res =
+          state.addressSpace.segmentMap.lookup(segment->getZExtValue()))
+    shareObject(state, res->second);
+}
+
+void Executor::shareObject(ExecutionState &state, const MemoryObject *mo) {
+  std::vector<const MemoryObject *> worklist{mo};
+  while (!worklist.empty()) {
+    mo = worklist.back();
+    worklist.pop_back();
+    if (!mo->isLocal || state.sharedObjects.count(mo->id))
+      continue;
+    state.sharedObjects = state.sharedObjects.insert(mo->id);
+    // the stack objects it points to become reachable with it
+    const ObjectState *os = state.addressSpace.findObject(mo);
+    if (!os)
+      continue;
+    for (unsigned i = 0, size = os->getSizeBound(); i != size; ++i) {
+      const auto *segment = dyn_cast<ConstantExpr>(os->read8(i).getSegment());
+      if (!segment || segment->isZero())
+        continue;
+      if (const auto *res =
+              state.addressSpace.segmentMap.lookup(segment->getZExtValue()))
+        worklist.push_back(res->second);
+    }
+  }
 }
 
 void Executor::doImpliedValueConcretization(ExecutionState &state,
                                             ref<Expr> e,
                                             ref<ConstantExpr> value) {
-  abort(); // FIXME: Broken until we sort out how to do the write back.
-
   if (DebugCheckForImpliedValues)
     ImpliedValue::checkForImpliedValues(solver->solver.get(), e, value);
 
+  // only the new constraint is analyzed, the earlier ones were when they
+  // were added
   ImpliedValueList results;
   ImpliedValue::getImpliedValues(e, value, results);
-  for (ImpliedValueList::iterator it = results.begin(), ie = results.end();
-       it != ie; ++it) {
-    ReadExpr *re = it->first.get();
-    
-    if (ConstantExpr *CE = dyn_cast<ConstantExpr>(re->index)) {
-      // FIXME: This is the sole remaining usage of the Array object
-      // variable. Kill me.
-      const MemoryObject *mo = 0; //re->updates.root->object;
-      const ObjectState *os = state.addressSpace.findObject(mo);
-
-      if (!os) {
-        // object has been free'd, no need to concretize (although as
-        // in other cases we would like to concretize the outstanding
-        // reads, but we have no facility for that yet)
-      } else {
-        assert(!os->readOnly && 
-               "not possible? read only object with static read?");
-        ObjectState *wos = state.addressSpace.getWriteable(mo, os);
-        wos->write(CE, KValue(it->second));
+  if (results.empty())
+    return;
+
+  ExprHashMap<ref<Expr>> values;
+  std::set<const MemoryObject *, MemoryObjectLT> objects;
+  for (const auto &result : results) {
+    values[result.first] = result.second;
+    const Array *array = result.first->updates.root;
+    for (auto it = state.arrayReaders.lower_bound({array, nullptr}),
+              ie = state.arrayReaders.end();
+         it != ie && it->first.first == array; ++it)
+      objects.insert(it->first.second);
+  }
+
+  // all reads are replaced at once, in one pass over each object that may
+  // hold them
+  for (const MemoryObject *mo : objects) {
+    const ObjectState *os = state.addressSpace.findObject(mo);
+    // freed, or holding no reads that could change
+    if (!os || os->readOnly)
+      continue;
+    ObjectState *wos = nullptr;
+    for (unsigned i = 0, size = os->getSizeBound(); i != size; ++i) {
+      KValue byte = os->read8(i);
+      if (isa<ConstantExpr>(byte.value))
+        continue;
+      ref<Expr> replaced = ImpliedValue::applyImpliedValues(byte.value, values);
+      if (replaced == byte.value)
+        continue;
+      if (!wos)
+        wos = state.addressSpace.getWriteable(mo, os);
+      wos->write(i, KValue(byte.getSegment(), replaced));
+      ++stats::impliedValueConcretizations;
+    }
+  }
+}
+
+bool Executor::handleThreads(ExecutionState &state) {
+  if (state.threads[state.currentThread].exited) {
+    // the frames are only popped now, the caller of exitThread may still
+    // have used them
+    while (!state.stack.empty())
+      state.popFrame();
+    ThreadOperation exit;
+    exit.kind = ThreadOperation::Kind::Exit;
+    exit.thread = state.currentThread;
+    wakeThreads(state, exit);
+    scheduleThreads(state);
+    return true;
+  }
+
+  ThreadOperation op;
+  if (!getThreadOperation(state, state.pc, op))
+    return false;
+  if (!state.threadScheduled && !state.inAtomicSection &&
+      state.hasOtherThreads()) {
+    state.threads[state.currentThread].next = op;
+    scheduleThreads(state);
+    return true;
+  }
+  // the operation is executed now
+  state.threadScheduled = false;
+  wakeThreads(state, op);
+  return false;
+}
+
+bool Executor::getThreadOperation(ExecutionState &state, KInstruction *ki,
+                                  ThreadOperation &op) {
+  switch (ki->opcode) {
+  case Instruction::Load:
+  case Instruction::Store: {
+    bool isWrite = ki->opcode == Instruction::Store;
+    const KValue &address = eval(ki, isWrite ? 1 : 0, state);
+    // the stack objects of a thread are its own unless it handed them over
+    if (const auto *segment = dyn_cast<ConstantExpr>(address.getSegment()))
+      if (const auto *res =
+              state.addressSpace.segmentMap.lookup(segment->getZExtValue()))
+        if (res->second->isLocal &&
+            !state.sharedObjects.count(res->second->id))
+          return false;
+    Type *type =
+        isWrite ? ki->inst->getOperand(0)->getType() : ki->inst->getType();
+    op.kind = ThreadOperation::Kind::Access;
+    op.address = address;
+    op.bytes = (getWidthForLLVMType(type) + 7) / 8;
+    op.isWrite = isWrite;
+    return true;
+  }
+  case Instruction::Call:
+  case Instruction::Invoke: {
+    const CallBase &cb = cast<CallBase>(*ki->inst);
+    Function *f = getTargetFunction(cb.getCalledOperand(), state);
+    if (!f || !f->isDeclaration())
+      return false;
+    StringRef name = f->getName();
+    if (name == "pthread_mutex_lock" || name == "pthread_mutex_trylock" ||
+        name == "pthread_mutex_unlock" || name == "pthread_mutex_init" ||
+        name == "pthread_mutex_destroy") {
+      // the argument registers are the operands after the callee
+      const KValue &mutex = eval(ki, 1, state);
+      op.kind = name == "pthread_mutex_lock" ? ThreadOperation::Kind::Lock
+                                             : ThreadOperation::Kind::Access;
+      op.address = KValue(toUnique(state, mutex.getSegment()),
+                          toUnique(state, mutex.getOffset()));
+      op.bytes = 1;
+      op.isWrite = true;
+      return true;
+    }
+    if (name == "pthread_join") {
+      ref<Expr> thread = toUnique(state, eval(ki, 1, state).value);
+      if (const auto *id = dyn_cast<ConstantExpr>(thread)) {
+        op.kind = ThreadOperation::Kind::Join;
+        op.thread = id->getZExtValue();
+        op.isWrite = !eval(ki, 2, state).isZero();
       }
+      return true;
     }
+    return name == "pthread_create" || name == "pthread_exit" ||
+           name == "__VERIFIER_atomic_begin";
+  }
+  default:
+    return false;
   }
 }
 
+void Executor::scheduleThreads(ExecutionState &state) {
+  ++stats::schedulingPoints;
+  std::vector<std::uint32_t> candidates;
+  bool blocked = true;
+  for (std::uint32_t id = 0; id < state.threads.size(); ++id) {
+    if (state.threads[id].exited || !state.isThreadEnabled(id))
+      continue;
+    blocked = false;
+    if (state.sleepingThreads.count(id)) {
+      ++stats::sleepingThreads;
+      continue;
+    }
+    candidates.push_back(id);
+  }
+  if (blocked) {
+    terminateStateOnError(state, "deadlock: no thread can run",
+                          StateTerminationType::Deadlock);
+    return;
+  }
+  if (candidates.empty()) {
+    // each order of the remaining operations is explored by another state
+    terminateStateEarly(state, "all threads are asleep",
+                        StateTerminationType::SleepSetBlocked);
+    return;
+  }
+
+  bool replaying = state.isReplaying();
+  std::vector<ExecutionState *> branches;
+  if (candidates.size() == 1)
+    branches.push_back(&state);
+  else
+    branch(state,
+           std::vector<ref<Expr>>(candidates.size(),
+                                  ConstantExpr::alloc(1, Expr::Bool)),
+           branches, BranchType::Schedule);
+  // without forking only the thread chosen is explored from here
+  bool forked = replaying || std::find(branches.begin(), branches.end(),
+                                       nullptr) == branches.end();
+
+  // a thread sleeps in the states of the threads after it if their next
+  // operations commute, as the state running it first covers both orders,
+  // and it keeps sleeping until an operation that does not commute
+  std::vector<ImmutableSet<std::uint32_t>> sleeping(candidates.size());
+  if (PartialOrderReduction) {
+    std::vector<std::uint32_t> asleep;
+    for (std::uint32_t id : state.sleepingThreads)
+      asleep.push_back(id);
+    for (unsigned i = 0; i < candidates.size(); ++i) {
+      const ThreadOperation &next = state.threads[candidates[i]].next;
+      for (std::uint32_t id : asleep)
+        if (!state.threads[id].next.dependsOn(next))
+          sleeping[i] = sleeping[i].insert(id);
+      if (forked)
+        asleep.push_back(candidates[i]);
+    }
+  }
+
+  for (unsigned i = 0; i < candidates.size(); ++i) {
+    ExecutionState *es = branches[i];
+    if (!es)
+      continue;
+    es->switchThread(candidates[i]);
+    es->sleepingThreads = sleeping[i];
+    // a new thread runs up to its first operation before it is scheduled
+    es->threadScheduled = es->threads[candidates[i]].next.kind !=
+                          ThreadOperation::Kind::Start;
+  }
+}
+
+void Executor::wakeThreads(ExecutionState &state, const ThreadOperation &op) {
+  ImmutableSet<std::uint32_t> sleeping = state.sleepingThreads;
+  for (std::uint32_t id : sleeping)
+    if (state.threads[id].next.dependsOn(op))
+      state.sleepingThreads = state.sleepingThreads.remove(id);
+}
+
+bool Executor::createThread(ExecutionState &state, const KValue &startRoutine,
+                            const KValue &argument, std::uint32_t &id) {
+  ref<Expr> segment = toUnique(state, startRoutine.getSegment());
+  ref<Expr> address = toUnique(state, startRoutine.getOffset());
+  Function *f = nullptr;
+  if (isa<ConstantExpr>(segment) && isa<ConstantExpr>(address) &&
+      cast<ConstantExpr>(segment)->getZExtValue() == FUNCTIONS_SEGMENT) {
+    auto it = legalFunctions.find(cast<ConstantExpr>(address)->getZExtValue());
+    if (it != legalFunctions.end())
+      f = it->second;
+  }
+  if (!f || f->isDeclaration()) {
+    terminateStateOnUserError(state, "pthread_create: invalid start routine");
+    return false;
+  }
+
+  KFunction *kf = kmodule->functionMap[f];
+  kmodule->resolveInfos(kf);
+  std::uint32_t creator = state.currentThread;
+  id = state.createThread(kf);
+  state.switchThread(id);
+  if (statsTracker)
+    statsTracker->framePushed(state, nullptr);
+  if (f->arg_size())
+    bindArgument(kf, 0, state, argument);
+  state.switchThread(creator);
+
+  // a stack object handed to the thread is shared from now on
+  if (const auto *CE = dyn_cast<ConstantExpr>(argument.getSegment()))
+    if (const auto *res =
+            state.addressSpace.segmentMap.lookup(CE->getZExtValue()))
+      shareObject(state, res->second);
+  return true;
+}
+
+void Executor::exitThread(ExecutionState &state, const KValue &value) {
+  if (state.threads.empty() || !state.hasOtherThreads()) {
+    terminateStateOnExit(state);
+    return;
+  }
+  Thread &thread = state.threads[state.currentThread];
+  thread.exited = true;
+  thread.exitValue = value;
+}
+
+bool Executor::getMutexAddress(ExecutionState &state, const KValue &address,
+                               MutexAddress &result) {
+  ref<Expr> segment = toUnique(state, address.getSegment());
+  ref<Expr> offset = toUnique(state, address.getOffset());
+  if (!isa<ConstantExpr>(segment) || !isa<ConstantExpr>(offset)) {
+    terminateStateOnExecError(state, "symbolic mutex address");
+    return false;
+  }
+  result = {cast<ConstantExpr>(segment)->getZExtValue(),
+            cast<ConstantExpr>(offset)->getZExtValue()};
+  return true;
+}
+
 Expr::Width Executor::getWidthForLLVMType(llvm::Type *type) const {
   return kmodule->targetData->getTypeSizeInBits(type);
 }
@@ -5532,7 +7669,7 @@ void Executor::dumpStates() {
       }
       *os << "], ";
 
-      StackFrame &sf = es->stack.back();
+      const StackFrame &sf = es->stack.back();
       uint64_t md2u = computeMinDistToUncovered(es->pc,
                                                 sf.minDistToUncoveredOnReturn);
       uint64_t icnt = theStatisticManager->getIndexedValue(stats::instructions,
@@ -5626,14 +7763,30 @@ static ConcreteValue getConcreteValue(unsigned bytesNum,
 
 ///
 // FIXME: we completely ignore pointers here
-void Executor::setReplayNondet(const struct KTest *out) {
-  assert(out && "No ktest file given");
+void Executor::setReplayNondet(const struct KTest *out, bool concrete) {
   assert(!replayPath && !replayKTest && "cannot replay both nondets and path");
 
+  replayNondet.clear();
+  replayObjects.clear();
+  replayNondetPosition = 0;
+  concreteReplay = out && concrete;
+  if (!out)
+    return;
   replayNondet.reserve(out->numObjects);
 
   for (unsigned i = 0; i < out->numObjects; ++i) {
       std::string name = out->objects[i].name;
+      // the nondets are named after their location, the objects of
+      // klee_make_symbolic as they were made
+      if (concrete && name.find(':') == std::string::npos) {
+        const unsigned char *bytes = out->objects[i].bytes;
+        replayObjects.emplace(
+            std::move(name),
+            std::vector<unsigned char>(bytes,
+                                       bytes + out->objects[i].numBytes));
+        continue;
+      }
+
       std::string fun;
       unsigned line, col;
       std::tie(fun, line, col) = parseNondetName(name);
@@ -5653,6 +7806,10 @@ void Executor::setReplayNondet(const struct KTest *out) {
       }
   }
 
+  // a fuzzer replays too many inputs to list them
+  if (fuzzing)
+    return;
+
   for (auto& nv : replayNondet) {
     auto& val = std::get<3>(nv);
     if (val.isPointer()) {
@@ -5675,6 +7832,14 @@ void Executor::setReplayNondet(const struct KTest *out) {
   }
 }
 
+void Executor::setFuzzing(bool value) {
+  // the inputs a fuzzer keeps are those that cover new instructions
+  if (value && !statsTracker)
+    klee_error("fuzzing needs the coverage of the statistics, do not "
+               "disable --output-stats and --output-istats both");
+  fuzzing = value;
+}
+
 ///
 
 Interpreter *Interpreter::create(LLVMContext &ctx, const InterpreterOptions &opts,
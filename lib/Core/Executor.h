@@ -59,6 +59,13 @@ namespace llvm {
 
 namespace klee {  
   class Array;
+  class AsyncBranchQueries;
+  class AutoMerger;
+  class EventTrace;
+  class ParallelWorkers;
+  class PortfolioWorkers;
+  class PrefixWorkers;
+  class StateSwap;
   struct Cell;
   class ExecutionState;
   class ExternalDispatcher;
@@ -69,6 +76,7 @@ namespace klee {
   struct KInstruction;
   class KInstIterator;
   class KModule;
+  struct LoopSummary;
   class MemoryManager;
   class MemoryObject;
   class ObjectState;
@@ -96,7 +104,9 @@ class Executor : public Interpreter {
   friend class SpecialFunctionHandler;
   friend class StatsTracker;
   friend class MergeHandler;
-  friend klee::Searcher *klee::constructUserSearcher(Executor &executor);
+  friend class AutoMerger;
+  friend klee::Searcher *klee::constructUserSearcher(Executor &executor,
+                                                    unsigned portfolioIndex);
 
 public:
   typedef std::pair<ExecutionState*,ExecutionState*> StatePair;
@@ -117,6 +127,9 @@ private:
   TreeStreamWriter *pathWriter, *symPathWriter;
   SpecialFunctionHandler *specialFunctionHandler;
   TimerGroup timers;
+  /// Whether the timers were started by a run, the later runs of which,
+  /// e.g. of a fuzzer, do not restart them.
+  bool timersStarted = false;
   std::unique_ptr<PTree> processTree;
 
   /// Used to track states that have been added during the current
@@ -130,6 +143,62 @@ private:
   /// \invariant \ref addedStates and \ref removedStates are disjoint.
   std::vector<ExecutionState *> removedStates;
 
+  /// States removed from the execution but not deleted yet, see
+  /// --reclaim-states-per-step.
+  std::vector<ExecutionState *> reclaimedStates;
+
+  /// Solves branch conditions while the states waiting for them are
+  /// parked, if enabled by --async-branch-queries.
+  std::unique_ptr<AsyncBranchQueries> asyncBranches;
+
+  /// Parks and merges states at the joins of the control flow, if enabled
+  /// by --auto-merge.
+  std::unique_ptr<AutoMerger> autoMerger;
+
+  /// Splits the states among forked worker processes, if enabled by
+  /// --parallel-workers.
+  std::unique_ptr<ParallelWorkers> parallelWorkers;
+
+  /// Coordinates the exploration of subtrees by worker processes, if
+  /// enabled by --prefix-workers. In a worker, forkPrefix holds the fork
+  /// choices leading to its subtree.
+  std::unique_ptr<PrefixWorkers> prefixWorkers;
+  std::vector<std::uint32_t> forkPrefix;
+
+  /// The spill file of the states swapped out over the memory cap, if
+  /// enabled by --state-swap.
+  std::unique_ptr<StateSwap> stateSwap;
+
+  /// The checkpoint to continue from (--resume-from), and whether
+  /// checkpoints are written (--checkpoint-interval).
+  std::string resumeCheckpoint;
+  bool checkpointing = false;
+
+  /// A copy of the initial state that swapped out and resumed states are
+  /// rebuilt from. The copy is a leaf of the process tree, but is never
+  /// given to a searcher.
+  ExecutionState *replayRoot = nullptr;
+
+  /// The processes of the independent explorations of a portfolio run, if
+  /// enabled by --portfolio.
+  std::unique_ptr<PortfolioWorkers> portfolio;
+
+  /// The binary trace of forks, selections, queries and terminations, if
+  /// enabled by --event-trace.
+  std::unique_ptr<EventTrace> eventTrace;
+
+  /// The solutions of the states dumped on halt that were computed ahead
+  /// by --dump-states-workers, taken by getSymbolicSolution.
+  std::unordered_map<const ExecutionState *,
+                     std::unique_ptr<std::vector<
+                         std::pair<std::string, std::vector<unsigned char>>>>>
+      dumpedSolutions;
+
+  /// Used to track states that have been parked during the current
+  /// instructions step, they are removed from the searcher until the
+  /// condition of their pending branch is solved.
+  std::vector<ExecutionState *> parkedStates;
+
   /// When non-empty the Executor is running in "seed" mode. The
   /// states in this map will be executed in an arbitrary order
   /// (outside the normal search interface) until they terminate. When
@@ -146,6 +215,21 @@ private:
   /// globals that have no representative object (i.e. functions).
   std::map<const llvm::GlobalValue*, KValue> globalAddresses;
 
+  /// Results of calls to pure externals by callee and argument words, see
+  /// --cache-pure-externals.
+  std::map<std::pair<const llvm::Function *, std::vector<uint64_t>>,
+           std::vector<uint64_t>>
+      pureExternalResults;
+
+  /// Results of calls to memoizable functions by callee and key, see
+  /// --memoize-calls and getMemoKey.
+  std::map<std::pair<const llvm::Function *, std::vector<uint64_t>>, KValue>
+      memoizedResults;
+
+  /// The argument vectors of finished calls, reused by the later ones so a
+  /// call does not allocate one.
+  std::vector<std::vector<Cell>> argumentPool;
+
   /// Map of legal function addresses to the corresponding Function.
   /// Used to validate and dereference function pointers.
   std::unordered_map<std::uint64_t, llvm::Function*> legalFunctions;
@@ -161,6 +245,19 @@ private:
   std::vector<std::tuple<std::string, unsigned, unsigned,
                          ConcreteValue>> replayNondet;
 
+  /// Whether the nondet values are replayed concretely, see setReplayNondet.
+  bool concreteReplay = false;
+
+  /// The objects of klee_make_symbolic left to replay concretely, by name
+  /// and in the order of the test.
+  std::multimap<std::string, std::vector<unsigned char>> replayObjects;
+
+  /// The index into \ref replayNondet of the next nondet value to replay.
+  unsigned replayNondetPosition = 0;
+
+  /// Whether the runs are those of a fuzzer, see setFuzzing.
+  bool fuzzing = false;
+
   /// When non-null a list of branch decisions to be used for replay.
   const std::vector<bool> *replayPath;
 
@@ -187,10 +284,20 @@ private:
   /// false, it is buggy (it needs to validate its writes).
   bool ivcEnabled;
 
+  /// Whether the program may create threads, so that the stack objects
+  /// whose addresses escape are tracked.
+  bool createsThreads = false;
+
   /// The maximum time to allow for a single core solver query.
   /// (e.g. for a single STP query)
   time::Span coreSolverTimeout;
 
+  /// The maximum times for branch feasibility, memory access resolution
+  /// and test generation queries, coreSolverTimeout unless set.
+  time::Span branchSolverTimeout;
+  time::Span boundsCheckSolverTimeout;
+  time::Span testGenSolverTimeout;
+
   /// Maximum time to allow for a single instruction.
   time::Span maxInstructionTime;
 
@@ -213,8 +320,21 @@ private:
   /// `nullptr` if merging is disabled
   MergingSearcher *mergingSearcher = nullptr;
 
-  /// Typeids used during exception handling
-  std::vector<ref<Expr>> eh_typeids;
+  /// Typeids used during exception handling, by their type_info. The
+  /// typeids count from one in the order the type_infos were seen.
+  std::map<ref<Expr>, unsigned> eh_typeids;
+
+  /// The clauses of a landingpad serialized for the personality function,
+  /// which states bind read-only copies of. A landingpad whose clauses
+  /// cannot be serialized has the error instead.
+  struct SerializedLandingpad {
+    MemoryObject *object = nullptr;
+    ref<ObjectState> clauses;
+    std::string error;
+  };
+  /// The serialized landingpads of the module, see serializeLandingpads.
+  std::unordered_map<const llvm::LandingPadInst *, SerializedLandingpad>
+      serializedLandingpads;
 
   /// Return the typeid corresponding to a certain `type_info`
   ref<ConstantExpr> getEhTypeidFor(ref<Expr> type_info);
@@ -224,8 +344,30 @@ private:
 
   void executeInstruction(ExecutionState &state, KInstruction *ki);
 
+  /// Executes a binary operation, integer comparison or integer cast on
+  /// concrete non-pointer operands natively. Returns false if ki has to be
+  /// executed by executeInstruction.
+  bool executeConcreteInstruction(ExecutionState &state, KInstruction *ki);
+
+  /// Runs the checks of ki under --check-mode=native, terminating the states
+  /// on which they fail. Returns false if state was terminated, otherwise
+  /// state is constrained to pass them.
+  bool executeNativeChecks(ExecutionState &state, KInstruction *ki);
+
   void run(ExecutionState &initialState);
 
+  /// Set up the exploration from initialState, running the seeds.
+  /// \return false if the run is complete already
+  bool startExploration(ExecutionState &initialState);
+  /// Execute at most budget instructions of the exploration.
+  /// \return false once it is complete or halted
+  bool stepExploration(std::uint64_t budget);
+  /// Tear down the exploration, dumping the remaining states.
+  void finishExploration();
+
+  /// Whether an exploration was started and not finished yet.
+  bool exploring = false;
+
   // Given a concrete object in our [klee's] address space, add it to 
   // objects checked code can reference.
   MemoryObject *addExternalObject(ExecutionState &state, void *addr, 
@@ -242,10 +384,32 @@ private:
   void initializeGlobalObjects(ExecutionState &state);
 
   void stepInstruction(ExecutionState &state);
+  /// Record a branch decision of state for --write-paths and, if it forked,
+  /// for --write-sym-paths.
+  void recordBranch(ExecutionState &state, const char *branch, bool forked);
+  /// Release the registers that are dead once ki is reached.
+  void clearDeadRegisters(ExecutionState &state, const KInstruction *ki);
   void updateStates(ExecutionState *current);
+  /// Delete up to count of the reclaimed states.
+  void reclaimStates(size_t count);
   void transferToBasicBlock(llvm::BasicBlock *dst, 
 			    llvm::BasicBlock *src,
 			    ExecutionState &state);
+  /// Moves the state entering the loop of the summary to its exit, with the
+  /// values of the recurrences after the last iteration, after forking on
+  /// whether the loop is entered at all. The state that is not moved
+  /// executes the loop.
+  void summarizeLoop(ExecutionState &state, const LoopSummary &summary);
+
+  /// Appends to key the arguments of a call of the memoizable function f
+  /// and the contents of the objects they point to and of the globals f
+  /// reads, which determine its result.
+  /// \return false if any of them is symbolic, holds a pointer or the
+  /// contents exceed --memoize-calls-max-bytes
+  bool getMemoKey(ExecutionState &state, const llvm::Function *f,
+                  const std::vector<const llvm::GlobalVariable *> &globals,
+                  const std::vector<Cell> &arguments,
+                  std::vector<uint64_t> &key) const;
 
   void callExternalFunction(ExecutionState &state,
                             KInstruction *target,
@@ -319,8 +483,12 @@ private:
                    const KValue &address,
                    KInstruction *target = 0);
 
-  /// Serialize a landingpad instruction so it can be handled by the
-  /// libcxxabi-runtime
+  /// Serialize the clauses of the landingpads of the module so they can be
+  /// handled by the libcxxabi-runtime. Needs the addresses of the globals.
+  void serializeLandingpads();
+
+  /// Bind the serialized clauses of a landingpad instruction in state, or
+  /// terminate it if they could not be serialized.
   MemoryObject *serializeLandingpad(ExecutionState &state,
                                     const llvm::LandingPadInst &lpi,
                                     bool &stateTerminated);
@@ -329,6 +497,11 @@ private:
   /// for exception handling.
   void unwindToNextLandingpad(ExecutionState &state);
 
+  /// Records the fingerprint of a state at a loop head, or terminates it
+  /// if it was there with the same fingerprint before, as selected by
+  /// --revisited-loop-heads. \return true if the state was terminated
+  bool checkRevisitedLoopHead(ExecutionState &state, KInstruction *ki);
+
   void executeCall(ExecutionState &state, 
                    KInstruction *ki,
                    llvm::Function *f,
@@ -348,6 +521,31 @@ private:
                               KValue value, /* undef if read */
                               KInstruction *target /* undef if write */);
 
+  /// Fork state on up to --max-sym-array-concretizations feasible values of
+  /// the symbolic offset of address into an object of at least
+  /// --max-sym-array-size bytes, plus one state for all other values, and
+  /// perform the memory operation at a constant address in each.
+  void forkOnSymArrayOffsets(ExecutionState &state, bool isWrite,
+                             const KValue &address, const KValue &value,
+                             KInstruction *target);
+
+  /// Perform a memory operation at offset into op, which is known to be in
+  /// bounds.
+  void executeInBoundsAccess(ExecutionState &state, bool isWrite,
+                             const ObjectPair &op, const ref<Expr> &offset,
+                             const KValue &value, Expr::Width type,
+                             KInstruction *target);
+
+  /// Read through address, which may point to any object in rl, with a
+  /// single read of an if-then-else over all targets instead of forking a
+  /// state per target. Sets unbound to the state in which address is out
+  /// of bounds of all targets, if any. Returns false if the read cannot be
+  /// merged, in which case state is left untouched.
+  bool executeMergedRead(ExecutionState &state, const KValue &address,
+                         const ResolutionList &rl, unsigned bytes,
+                         Expr::Width type, KInstruction *target,
+                         ExecutionState *&unbound);
+
   void executeMakeSymbolic(ExecutionState &state, const MemoryObject *mo,
                            const std::string &name);
 
@@ -368,6 +566,84 @@ private:
   StatePair fork(ExecutionState &current, ref<Expr> condition, bool isInternal,
                  BranchType reason);
 
+  /// Solve the condition fork() branches on.
+  bool solveBranch(ExecutionState &current, const ref<Expr> &condition,
+                   time::Span timeout, Solver::Validity &res);
+
+  /// Fork at the conditional branch ki and transfer the states to the
+  /// successors.
+  void executeBranch(ExecutionState &state, KInstruction *ki,
+                     const ref<Expr> &cond);
+
+  /// Park state at the conditional branch ki while its condition is
+  /// solved by another process.
+  /// \return false if the branch is to be executed right away
+  bool parkAtBranch(ExecutionState &state, KInstruction *ki,
+                    const ref<Expr> &cond);
+
+  /// Return the parked states whose branch conditions are solved to the
+  /// searcher.
+  /// \param wait block until at least one condition is solved
+  void resumeParkedStates(bool wait);
+
+  /// Fork the parallel workers and keep the share of the states of this
+  /// process.
+  void splitStates();
+
+  /// Stop recording events in a forked worker process.
+  void disableEventTrace();
+
+  /// Give up states to the coordinator of the prefix workers, if it asked
+  /// for them.
+  void givePrefixes();
+
+  /// Whether the states record their fork choices (forkChoices).
+  bool recordForkChoices() const {
+    return prefixWorkers || stateSwap || checkpointing;
+  }
+
+  /// Whether states can be rebuilt from their fork choices with the other
+  /// options, warns about option otherwise.
+  bool replaySupported(const char *option) const;
+
+  void createReplayRoot(ExecutionState &initialState);
+
+  /// Add a state rebuilt by replaying choices from replayRoot.
+  void rebuildState(std::vector<std::uint32_t> choices);
+
+  /// Start --state-swap, if it is supported with the other options.
+  void startStateSwap(ExecutionState &initialState);
+
+  /// Rebuild up to count swapped out states. \return true if a state was
+  /// added
+  bool reloadSwappedStates(unsigned count);
+
+  /// Write checkpoint.kcp, see --checkpoint-interval.
+  void writeCheckpoint();
+
+  /// Restore the states, coverage and test counts of resumeCheckpoint, the
+  /// initial state takes the first of the states. \return false if no
+  /// states are left to explore
+  bool resumeFromCheckpoint(ExecutionState &initialState);
+
+  /// Fork the other members of the portfolio, each of which continues with
+  /// its own searcher.
+  void startPortfolio();
+
+  /// \return true if a test case of a state that terminated without an
+  /// error is to be written
+  bool shouldWriteTest(const ExecutionState &state);
+
+  /// \return true if state follows its seeds with --fast-forward-seeds and
+  /// e evaluates to the same constant value under all of them
+  bool getSeedsValue(const ExecutionState &state, const ref<Expr> &e,
+                     ref<ConstantExpr> &value);
+
+  /// \return the truth value of condition if the bounds learned from the
+  /// constraints of state determine it, see --use-constraint-ranges
+  llvm::Optional<bool> decideByRanges(const ExecutionState &state,
+                                      const ref<Expr> &condition);
+
   // If the MaxStatic*Pct limits have been reached, concretize the condition and
   // return it. Otherwise, return the unmodified condition.
   ref<Expr> maxStaticPctChecks(ExecutionState &current, ref<Expr> condition);
@@ -378,6 +654,12 @@ private:
   /// validity checks, and seed patching.
   void addConstraint(ExecutionState &state, ref<Expr> condition);
 
+  /// Constrain the symbolic addresses of the live objects a and b, either of
+  /// which may be null, to be nonzero, not to wrap around and not to
+  /// overlap. Each object and pair is constrained once per address space.
+  void addSymbolicAddressAxioms(ExecutionState &state, const MemoryObject *a,
+                                const MemoryObject *b);
+
   // Called on [for now] concrete reads, replaces constant with a symbolic
   // Used for testing.
   ref<Expr> replaceReadWithSymbolic(ExecutionState &state, ref<Expr> e);
@@ -388,23 +670,39 @@ private:
                            const std::string &name,
                            bool isPointer = false);
 
+  /// The value of the next element of the buffer the nondet call kinst
+  /// fills, read from the array backing the buffer, or null if the call
+  /// does not fill a buffer element by element (see --batch-nondet-fills).
+  ref<Expr> readNondetFill(ExecutionState &state, unsigned size,
+                           KInstruction *kinst, const std::string &name);
+
+  /// Notes where the store ki of a nondet value stores it, so that the
+  /// following values of its call are read from one array while they fill
+  /// consecutive elements of the buffer.
+  void noteNondetFill(ExecutionState &state, KInstruction *ki,
+                      const KValue &address);
+
   const Cell& eval(KInstruction *ki, unsigned index, 
                    ExecutionState &state) const;
 
   Cell& getArgumentCell(ExecutionState &state,
                         KFunction *kf,
                         unsigned index) {
-    return state.stack.back().locals[kf->getArgRegister(index)];
+    return state.stack.getWriteableBack().locals[kf->getArgRegister(index)];
   }
 
   Cell& getDestCell(ExecutionState &state,
                     KInstruction *target) {
-    return state.stack.back().locals[target->dest];
+    return state.stack.getWriteableBack().locals[target->dest];
   }
 
   void bindLocal(KInstruction *target,
                  ExecutionState &state,
                  const KValue &value);
+  /// Moves value into the register, for results computed for it.
+  void bindLocal(KInstruction *target,
+                 ExecutionState &state,
+                 KValue &&value);
   void bindArgument(KFunction *kf,
                     unsigned index,
                     ExecutionState &state,
@@ -436,6 +734,12 @@ private:
   ref<klee::ConstantExpr> toConstant(ExecutionState &state, ref<Expr> e, 
                                      const char *purpose);
 
+  /// The operand e of a floating-point operation on values of the given
+  /// width, kept symbolic with --symbolic-floats if the solver can reason
+  /// about such values and concretized otherwise.
+  ref<Expr> toFloatOperand(ExecutionState &state, ref<Expr> e,
+                           Expr::Width width);
+
   /// Bind a constant value for e to the given target. NOTE: This
   /// function may fork state if the state has multiple seeds.
   void executeGetValue(ExecutionState &state, const KValue& e, KInstruction *target);
@@ -448,6 +752,10 @@ private:
   const InstructionInfo & getLastNonKleeInternalInstruction(const ExecutionState &state,
       llvm::Instruction** lastInstruction);
 
+  /// Record the termination of state in the event trace, if enabled.
+  void traceTermination(const ExecutionState &state,
+                        StateTerminationType terminationType);
+
   /// Remove state from queue and delete state
   void terminateState(ExecutionState &state);
 
@@ -499,10 +807,60 @@ private:
   /// constant values.
   void bindInstructionConstants(KInstruction *KI);
 
+  /// Index mo as holding the reads of the arrays in a value written to it,
+  /// for doImpliedValueConcretization.
+  void recordArrayReaders(ExecutionState &state, const MemoryObject *mo,
+                          const KValue &value);
+
+  /// Mark the stack object that value points to as shared if it is
+  /// stored into mo, which other threads may access.
+  void recordEscape(ExecutionState &state, const MemoryObject *mo,
+                    const KValue &value);
+
+  /// Mark the stack object mo as shared with the other threads, and the
+  /// stack objects it points to, transitively.
+  void shareObject(ExecutionState &state, const MemoryObject *mo);
+
+  /// Replace the reads whose values are implied by e having value in the
+  /// objects that may hold them.
   void doImpliedValueConcretization(ExecutionState &state,
                                     ref<Expr> e,
                                     ref<ConstantExpr> value);
 
+  /// Handle the threads of a state that created some before it executes
+  /// the instruction at its pc: it reached a scheduling point if its
+  /// running thread exited or is about to execute an operation the others
+  /// may observe. Returns whether the state was scheduled instead of
+  /// executing the instruction.
+  bool handleThreads(ExecutionState &state);
+
+  /// Find the operation of ki that the other threads may observe. Returns
+  /// false if it has none.
+  bool getThreadOperation(ExecutionState &state, KInstruction *ki,
+                          ThreadOperation &op);
+
+  /// Fork state for each thread that may run next, but for the sleeping
+  /// ones, and switch each of the states to its thread.
+  void scheduleThreads(ExecutionState &state);
+
+  /// Wake the sleeping threads whose next operation does not commute with
+  /// op, which the running thread executes.
+  void wakeThreads(ExecutionState &state, const ThreadOperation &op);
+
+  /// Create a thread running startRoutine(argument) and return its id.
+  /// Terminates the state and returns false if startRoutine is invalid.
+  bool createThread(ExecutionState &state, const KValue &startRoutine,
+                    const KValue &argument, std::uint32_t &id);
+
+  /// Exit the running thread with value. The state terminates with its
+  /// last thread, otherwise another one is scheduled before its next step.
+  void exitThread(ExecutionState &state, const KValue &value);
+
+  /// Make the address of a mutex concrete. Terminates the state and returns
+  /// false if it has several values.
+  bool getMutexAddress(ExecutionState &state, const KValue &address,
+                       MutexAddress &result);
+
   bool getReachableMemoryObjects(ExecutionState &state,
                                  std::set<const MemoryObject *>&);
 
@@ -510,8 +868,10 @@ private:
                    const llvm::Twine &info, const char *suffix,
                    enum StateTerminationType terminationType);
 
-  /// check memory usage and terminate states when over threshold of -max-memory + 100MB
-  /// \return true if below threshold, false otherwise (states were terminated)
+  /// check memory usage and terminate (or swap out, see --state-swap)
+  /// states when over threshold of -max-memory + 100MB, or reload swapped
+  /// out states when well below -max-memory
+  /// \return true if no states were changed, false otherwise
   bool checkMemoryUsage();
 
   /// check if branching/forking is allowed
@@ -520,6 +880,20 @@ private:
   void printDebugInstructions(ExecutionState &state);
   void doDumpStates();
 
+  /// Compute the solutions of the states about to be dumped with the
+  /// processes of --dump-states-workers.
+  void solveDumpedStates();
+
+  bool computeSymbolicSolution(
+      const ExecutionState &state,
+      std::vector<std::pair<std::string, std::vector<unsigned char>>> &res);
+
+  /// With --fast-forward-seeds, take a seed of state that satisfies its
+  /// constraints as its solution. \return false if there is none
+  bool getSeedSolution(
+      const ExecutionState &state,
+      std::vector<std::pair<std::string, std::vector<unsigned char>>> &res);
+
   /// Only for debug purposes; enable via debugger or klee-control
   void dumpStates();
   void dumpPTree();
@@ -551,7 +925,13 @@ public:
     replayPosition = 0;
   }
 
-  void setReplayNondet(const struct KTest *out) override;
+  void setReplayNondet(const struct KTest *out, bool concrete) override;
+
+  void setFuzzing(bool value) override;
+
+  void setResumeCheckpoint(const std::string &path) override {
+    resumeCheckpoint = path;
+  }
 
   llvm::Module *setModule(std::vector<std::unique_ptr<llvm::Module>> &modules,
                           const ModuleOptions &opts) override;
@@ -563,6 +943,15 @@ public:
   void runFunctionAsMain(llvm::Function *f, int argc, char **argv,
                          char **envp) override;
 
+  void startFunctionAsMain(llvm::Function *f, int argc, char **argv,
+                           char **envp) override;
+
+  bool step(std::uint64_t budget) override;
+
+  void finishRun() override;
+
+  RunStatistics getRunStatistics() const override;
+
   /*** Runtime options ***/
 
   void setHaltExecution(bool value) override { haltExecution = value; }
@@ -577,6 +966,9 @@ public:
 
   unsigned getSymbolicPathStreamID(const ExecutionState &state) override;
 
+  void getPathBranches(const ExecutionState &state, bool symbolic,
+                       std::vector<unsigned char> &branches) override;
+
   void getConstraintLog(const ExecutionState &state, std::string &res,
                         Interpreter::LogType logFormat =
                             Interpreter::STP) override;
@@ -600,6 +992,10 @@ public:
   /// Returns the errno location in memory of the state
   int *getErrnoLocation(const ExecutionState &state) const;
 
+  /// \return true if calls to the function are errors or failures that
+  /// directed search aims at (__assert_fail, __INSTR_fail or --error-fn)
+  static bool isErrorFunction(const llvm::Function &f);
+
   MergingSearcher *getMergingSearcher() const { return mergingSearcher; };
   void setMergingSearcher(MergingSearcher *ms) { mergingSearcher = ms; };
 };
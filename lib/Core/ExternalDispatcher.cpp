@@ -8,9 +8,15 @@
 //===----------------------------------------------------------------------===//
 
 #include "ExternalDispatcher.h"
+
+#include "CoreStats.h"
+
 #include "klee/Config/Version.h"
 #include "klee/Module/KCallable.h"
 #include "klee/Module/KModule.h"
+#include "klee/Statistics/TimerStatIncrementer.h"
+#include "klee/Support/ErrorHandling.h"
+#include "klee/Support/OptionCategories.h"
 
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/DerivedTypes.h"
@@ -21,7 +27,13 @@
 #include "llvm/IR/Module.h"
 #include "llvm/ExecutionEngine/GenericValue.h"
 #include "llvm/ExecutionEngine/MCJIT.h"
+#include "llvm/ExecutionEngine/ObjectCache.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/DynamicLibrary.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Support/TargetSelect.h"
 
@@ -31,10 +43,27 @@
 using namespace llvm;
 using namespace klee;
 
+namespace {
+cl::opt<std::string> ExternalStubCache(
+    "external-stub-cache",
+    cl::desc("Keep the compiled stubs through which external functions are "
+             "called in this directory, so that later runs load them instead "
+             "of compiling them again (default=off)"),
+    cl::value_desc("dir"),
+    cl::cat(klee::ExtCallsCat));
+
+/// The stubs load their arguments through this symbol, see
+/// ExternalDispatcherImpl::createDispatcher.
+const char ArgsSymbol[] = "klee_external_call_args";
+} // namespace
+
 /***/
 
 static sigjmp_buf escapeCallJmpBuf;
 
+// FIXME: This is not reentrant.
+static uint64_t *gTheArgsP;
+
 extern "C" {
 
 static void sigsegv_handler(int signal, siginfo_t *info, void *context) {
@@ -44,10 +73,66 @@ static void sigsegv_handler(int signal, siginfo_t *info, void *context) {
 
 namespace klee {
 
+/// Keeps the objects of the dispatcher modules in a directory. A module is
+/// named after a hash of its code, so its object can be used by every run
+/// that builds the same stub.
+class StubObjectCache : public llvm::ObjectCache {
+  std::string directory;
+
+  static bool isStub(const llvm::Module *m) {
+    return StringRef(m->getModuleIdentifier()).startswith("klee_dispatcher_");
+  }
+
+  std::string getPath(const llvm::Module *m) const {
+    SmallString<128> path(directory);
+    sys::path::append(path, m->getModuleIdentifier() + ".o");
+    return path.str().str();
+  }
+
+public:
+  explicit StubObjectCache(std::string directory)
+      : directory(std::move(directory)) {}
+
+  void notifyObjectCompiled(const llvm::Module *m,
+                            llvm::MemoryBufferRef object) override {
+    if (!isStub(m))
+      return;
+    // written under a temporary name first, so that concurrent runs never
+    // load a partial object
+    std::string path = getPath(m);
+    SmallString<128> temporary;
+    int fd;
+    if (sys::fs::createUniqueFile(path + ".%%%%%%", fd, temporary))
+      return;
+    raw_fd_ostream os(fd, /*shouldClose=*/true);
+    os << object.getBuffer();
+    os.close();
+    if (os.has_error() || sys::fs::rename(temporary, path)) {
+      os.clear_error();
+      sys::fs::remove(temporary);
+    }
+  }
+
+  std::unique_ptr<llvm::MemoryBuffer>
+  getObject(const llvm::Module *m) override {
+    if (!isStub(m))
+      return nullptr;
+    auto buffer = MemoryBuffer::getFile(getPath(m));
+    if (!buffer)
+      return nullptr;
+    ++stats::loadedExternalStubs;
+    return std::move(*buffer);
+  }
+};
+
 class ExternalDispatcherImpl {
 private:
   typedef std::map<const llvm::Instruction *, llvm::Function *> dispatchers_ty;
   dispatchers_ty dispatchers;
+  /// Dispatchers by the hash of their code, shared by equal call sites.
+  std::map<std::string, llvm::Function *> stubs;
+  std::unique_ptr<StubObjectCache> objectCache;
+  std::string getStubKey(const llvm::Module &module);
   llvm::Function *createDispatcher(KCallable *target, llvm::Instruction *i,
                                    llvm::Module *module);
   llvm::ExecutionEngine *executionEngine;
@@ -69,6 +154,18 @@ public:
   void setLastErrno(int newErrno);
 };
 
+std::string ExternalDispatcherImpl::getStubKey(const llvm::Module &module) {
+  std::string code;
+  llvm::raw_string_ostream os(code);
+  // objects of a different LLVM are not reused
+  os << LLVM_VERSION_STRING << '\n' << module;
+  MD5 hash;
+  hash.update(os.str());
+  MD5::MD5Result result;
+  hash.final(result);
+  return result.digest().str().str();
+}
+
 std::string &ExternalDispatcherImpl::getFreshModuleID() {
   // We store the module IDs because `llvm::Module` constructor takes the
   // module ID as a StringRef so it doesn't own the ID.  Therefore we need to
@@ -128,6 +225,20 @@ ExternalDispatcherImpl::ExternalDispatcherImpl(LLVMContext &ctx)
     abort();
   }
 
+  if (!ExternalStubCache.empty()) {
+    if (auto ec = sys::fs::create_directories(ExternalStubCache)) {
+      klee_warning("unable to create external stub cache %s - %s",
+                   ExternalStubCache.c_str(), ec.message().c_str());
+    } else {
+      objectCache.reset(new StubObjectCache(ExternalStubCache));
+      executionEngine->setObjectCache(objectCache.get());
+    }
+  }
+
+  // The stubs refer to gTheArgsP by name rather than by address, which
+  // differs between runs, so that their objects can be cached.
+  sys::DynamicLibrary::AddSymbol(ArgsSymbol, (void *)&gTheArgsP);
+
   // If we have a native target, initialize it to ensure it is linked in and
   // usable by the JIT.
   llvm::InitializeNativeTarget();
@@ -181,36 +292,48 @@ bool ExternalDispatcherImpl::executeCall(KCallable *callable, Instruction *i,
 
   Module *dispatchModule = NULL;
   // The MCJIT generates whole modules at a time so for every call that we
-  // haven't made before we need to create a new Module.
-  dispatchModule = new Module(getFreshModuleID(), ctx);
+  // haven't made before we need to create a new Module. Call sites that need
+  // the same stub share it.
+  dispatchModule = new Module("klee_dispatcher", ctx);
   dispatcher = createDispatcher(callable, i, dispatchModule);
-  dispatchers.insert(std::make_pair(i, dispatcher));
 
   // Force the JIT execution engine to go ahead and build the function. This
   // ensures that any errors or assertions in the compilation process will
   // trigger crashes instead of being caught as aborts in the external
   // function.
   if (dispatcher) {
-    // The dispatchModule is now ready so tell MCJIT to generate the code for
-    // it.
-    auto dispatchModuleUniq = std::unique_ptr<Module>(dispatchModule);
-    executionEngine->addModule(
-        std::move(dispatchModuleUniq)); // MCJIT takes ownership
-    // Force code generation
-    uint64_t fnAddr =
-        executionEngine->getFunctionAddress(dispatcher->getName().str());
-    executionEngine->finalizeObject();
-    assert(fnAddr && "failed to get function address");
-    (void)fnAddr;
+    std::string key = getStubKey(*dispatchModule);
+    auto known = stubs.find(key);
+    if (known != stubs.end()) {
+      delete dispatchModule;
+      dispatcher = known->second;
+    } else {
+      // MCJIT functions need unique names, or wrong function can be called.
+      dispatcher->setName("dispatcher_" + key);
+      dispatchModule->setModuleIdentifier("klee_dispatcher_" + key);
+      stubs.emplace(key, dispatcher);
+
+      TimerStatIncrementer timer(stats::externalStubTime);
+      // The dispatchModule is now ready so tell MCJIT to generate the code
+      // for it (or to load it from the object cache).
+      auto dispatchModuleUniq = std::unique_ptr<Module>(dispatchModule);
+      executionEngine->addModule(
+          std::move(dispatchModuleUniq)); // MCJIT takes ownership
+      // Force code generation
+      uint64_t fnAddr =
+          executionEngine->getFunctionAddress(dispatcher->getName().str());
+      executionEngine->finalizeObject();
+      assert(fnAddr && "failed to get function address");
+      (void)fnAddr;
+    }
   } else {
     // MCJIT didn't take ownership of the module so delete it.
     delete dispatchModule;
   }
+  dispatchers.insert(std::make_pair(i, dispatcher));
   return runProtectedCall(dispatcher, args);
 }
 
-// FIXME: This is not reentrant.
-static uint64_t *gTheArgsP;
 bool ExternalDispatcherImpl::runProtectedCall(Function *f, uint64_t *args) {
   struct sigaction segvAction, segvActionOld;
   bool res;
@@ -263,23 +386,18 @@ Function *ExternalDispatcherImpl::createDispatcher(KCallable *target,
 
   std::vector<Type *> nullary;
 
-  // MCJIT functions need unique names, or wrong function can be called.
-  // The module identifier is included because for the MCJIT we need
-  // unique function names across all `llvm::Modules`s.
-  std::string fnName =
-      "dispatcher_" + target->getName().str() + module->getModuleIdentifier();
+  // The dispatcher is given its unique name in executeCall, after the code
+  // it is named after has been generated.
   Function *dispatcher =
       Function::Create(FunctionType::get(Type::getVoidTy(ctx), nullary, false),
-                       GlobalVariable::ExternalLinkage, fnName, module);
+                       GlobalVariable::ExternalLinkage, "dispatcher", module);
 
   BasicBlock *dBB = BasicBlock::Create(ctx, "entry", dispatcher);
 
   llvm::IRBuilder<> Builder(dBB);
   // Get a Value* for &gTheArgsP, as an i64**.
-  auto argI64sp = Builder.CreateIntToPtr(
-      ConstantInt::get(Type::getInt64Ty(ctx), (uintptr_t)(void *)&gTheArgsP),
-      PointerType::getUnqual(PointerType::getUnqual(Type::getInt64Ty(ctx))),
-      "argsp");
+  auto argI64sp = module->getOrInsertGlobal(
+      ArgsSymbol, PointerType::getUnqual(Type::getInt64Ty(ctx)));
   auto argI64s = Builder.CreateLoad(
       argI64sp->getType()->getPointerElementType(), argI64sp, "args");
 
@@ -14,6 +14,7 @@
 #include "klee/Expr/Constraints.h"
 #include "klee/Expr/Expr.h"
 #include "klee/Expr/ExprUtil.h"
+#include "klee/Expr/ExprVisitor.h"
 #include "klee/Solver/Solver.h"
 #include "klee/Support/IntEvaluation.h" // FIXME: Use APInt
 
@@ -237,3 +238,25 @@ void ImpliedValue::checkForImpliedValues(Solver *S, ref<Expr> e,
 
   assert(found.empty());
 }
+
+namespace {
+class ImpliedValueReplacer : public ExprVisitor {
+  const ExprHashMap<ref<Expr> > &values;
+
+public:
+  explicit ImpliedValueReplacer(const ExprHashMap<ref<Expr> > &values)
+      : values(values) {}
+
+  Action visitRead(const ReadExpr &re) override {
+    auto it = values.find(ref<Expr>(const_cast<ReadExpr *>(&re)));
+    if (it != values.end())
+      return Action::changeTo(it->second);
+    return Action::doChildren();
+  }
+};
+} // namespace
+
+ref<Expr> ImpliedValue::applyImpliedValues(
+    ref<Expr> e, const ExprHashMap<ref<Expr> > &values) {
+  return ImpliedValueReplacer(values).visit(e);
+}
@@ -11,6 +11,7 @@
 #define KLEE_IMPLIEDVALUE_H
 
 #include "klee/Expr/Expr.h"
+#include "klee/Expr/ExprHashMap.h"
 
 #include <vector>
 
@@ -34,6 +35,10 @@ namespace klee {
                           ImpliedValueList &result);
     void checkForImpliedValues(Solver *S, ref<Expr> e, 
                                ref<ConstantExpr> cvalue);    
+
+    /// Replace the reads in e that have an implied value by the value.
+    ref<Expr> applyImpliedValues(ref<Expr> e,
+                                 const ExprHashMap<ref<Expr> > &values);
   }
 
 }
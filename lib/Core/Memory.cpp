@@ -10,10 +10,13 @@
 #include "Memory.h"
 
 #include "Context.h"
+#include "CoreStats.h"
 #include "ExecutionState.h"
 #include "MemoryManager.h"
+#include "StateFingerprint.h"
 
 #include "klee/Expr/ArrayCache.h"
+#include "klee/Expr/Assignment.h"
 #include "klee/Expr/Expr.h"
 #include "klee/Support/OptionCategories.h"
 #include "klee/Solver/Solver.h"
@@ -26,6 +29,7 @@
 #include "llvm/Support/raw_ostream.h"
 
 #include <cassert>
+#include <cstring>
 #include <sstream>
 
 using namespace llvm;
@@ -37,6 +41,31 @@ namespace {
                     cl::desc("Use constant arrays instead of updates when possible (default=true)\n"),
                     cl::init(true),
                     cl::cat(SolvingCat));
+
+  cl::opt<unsigned> PagedObjectThreshold(
+      "paged-object-threshold",
+      cl::desc("Keep the concrete contents of objects larger than this many "
+               "bytes in 4 KiB pages that are copied on write separately, "
+               "0 disables paging (default=65536)"),
+      cl::init(65536),
+      cl::cat(MiscCat));
+
+  cl::opt<unsigned> UpdateListCompactionThreshold(
+      "update-list-compaction-threshold",
+      cl::desc("Fold the concrete writes of an update list on a constant "
+               "array into a new constant array once this many writes were "
+               "added since the last attempt, 0 disables folding "
+               "(default=256)"),
+      cl::init(256),
+      cl::cat(SolvingCat));
+
+  const size_t ObjectPageSize = 4096;
+
+  size_t getStorePageSize(unsigned sizeBound) {
+    if (PagedObjectThreshold && sizeBound > PagedObjectThreshold)
+      return ObjectPageSize;
+    return 0;
+  }
 }
 
 /***/
@@ -48,6 +77,15 @@ MemoryObject::~MemoryObject() {
     parent->markFreed(this);
 }
 
+void *MemoryObject::operator new(size_t size) {
+  assert(size == sizeof(MemoryObject) && "unexpected size for pooled object");
+  return MemoryManager::getPool(MemoryManager::MemoryObjectPool).allocate();
+}
+
+void MemoryObject::operator delete(void *p, size_t) {
+  MemoryManager::getPool(MemoryManager::MemoryObjectPool).deallocate(p);
+}
+
 void MemoryObject::getAllocInfo(std::string &result) const {
   llvm::raw_string_ostream info(result);
 
@@ -89,8 +127,17 @@ ref<Expr> MemoryObject::getSymbolicAddress(klee::ArrayCache &array) {
 
 /***/
 
-ObjectStatePlane::ObjectStatePlane(const ObjectState *parent)
-  : parent(parent),
+void *ObjectStatePlane::operator new(size_t size) {
+  assert(size == sizeof(ObjectStatePlane) && "unexpected size for pooled object");
+  return MemoryManager::getPool(MemoryManager::ObjectStatePlanePool).allocate();
+}
+
+void ObjectStatePlane::operator delete(void *p, size_t) {
+  MemoryManager::getPool(MemoryManager::ObjectStatePlanePool).deallocate(p);
+}
+
+ObjectStatePlane::ObjectStatePlane(const MemoryObject *mo)
+  : object(mo),
     updates(nullptr, nullptr),
     sizeBound(0),
     initialized(true),
@@ -99,135 +146,201 @@ ObjectStatePlane::ObjectStatePlane(const ObjectState *parent)
   if (!UseConstantArrays) {
     static unsigned id = 0;
     const Array *array =
-        parent->getArrayCache()->CreateArray("tmp_arr" + llvm::utostr(++id), sizeBound);
+        getArrayCache()->CreateArray("tmp_arr" + llvm::utostr(++id), sizeBound);
     updates = UpdateList(array, 0);
   }
-  if (ConstantExpr *CE = dyn_cast<ConstantExpr>(parent->getObject()->size)) {
+  if (ConstantExpr *CE = dyn_cast<ConstantExpr>(object->size)) {
     sizeBound = CE->getZExtValue();
   }
+  concreteStore = PagedVector<uint8_t>(getStorePageSize(sizeBound));
 }
 
 
-ObjectStatePlane::ObjectStatePlane(const ObjectState *parent, const Array *array)
-  : parent(parent),
+ObjectStatePlane::ObjectStatePlane(const MemoryObject *mo, const Array *array)
+  : object(mo),
     updates(array, nullptr),
     sizeBound(0),
     initialized(false),
     symbolic(true),
     initialValue(0) {
-  if (ConstantExpr *CE = dyn_cast<ConstantExpr>(parent->getObject()->size)) {
+  if (ConstantExpr *CE = dyn_cast<ConstantExpr>(object->size)) {
     sizeBound = CE->getZExtValue();
   }
+  concreteStore = PagedVector<uint8_t>(getStorePageSize(sizeBound));
 }
 
-ObjectStatePlane::ObjectStatePlane(const ObjectState *parent, const ObjectStatePlane &os)
-  : parent(parent),
+ObjectStatePlane::ObjectStatePlane(const MemoryObject *mo, const ObjectStatePlane &os)
+  : object(mo),
     concreteStore(os.concreteStore),
     concreteMask(os.concreteMask),
     knownSymbolics(os.knownSymbolics),
     unflushedMask(os.unflushedMask),
+    unflushedBegin(os.unflushedBegin),
+    unflushedEnd(os.unflushedEnd),
     updates(os.updates),
     sizeBound(os.sizeBound),
     initialized(os.initialized),
     symbolic(os.symbolic),
-    initialValue(os.initialValue) {
-  assert(!os.parent->readOnly && "no need to copy read only object?");
+    initialValue(os.initialValue),
+    compactedSize(os.compactedSize),
+    bytesFingerprint(os.bytesFingerprint) {
 }
 
 /***/
 
+ArrayCache *ObjectStatePlane::getArrayCache() const {
+  assert(object && "object was NULL");
+  return object->parent->getArrayCache();
+}
+
+void ObjectStatePlane::pageConcreteStore() {
+  auto *size = dyn_cast<ConstantExpr>(object->size);
+  if (concreteStore.isPaged() || !size)
+    return;
+  size_t pageSize = getStorePageSize(size->getZExtValue());
+  if (!pageSize)
+    return;
+  std::vector<uint8_t> bytes(concreteStore.size());
+  concreteStore.copyTo(bytes.data());
+  // the pages holding only the initial value stay shared
+  PagedVector<uint8_t> paged(pageSize);
+  paged.resize(bytes.size(), initialValue);
+  paged.copyFrom(bytes.data());
+  concreteStore = std::move(paged);
+}
+
 const UpdateList &ObjectStatePlane::getUpdates() const {
   // Constant arrays are created lazily.
   if (!updates.root) {
-    // Collect the list of writes, with the oldest writes first.
-    
-    // FIXME: We should be able to do this more efficiently, we just need to be
-    // careful to get the interaction with the cache right. In particular we
-    // should avoid creating UpdateNode instances we never use.
-    unsigned NumWrites = updates.head ? updates.head->getSize() : 0;
-    std::vector< std::pair< ref<Expr>, ref<Expr> > > Writes(NumWrites);
-    const auto *un = updates.head.get();
-    for (unsigned i = NumWrites; i != 0; un = un->next.get()) {
-      --i;
-      Writes[i] = std::make_pair(un->index, un->value);
+    foldConcreteWrites();
+  } else if (UpdateListCompactionThreshold && updates.root->isConstantArray()) {
+    // Long chains of concrete writes over a constant array are folded into
+    // a fresh one, so that solvers see the contents instead of the chain.
+    unsigned size = updates.getSize();
+    if (size < compactedSize)
+      compactedSize = 0;
+    if (size >= compactedSize + UpdateListCompactionThreshold) {
+      if (foldConcreteWrites())
+        ++stats::updateListCompactions;
+      compactedSize = updates.getSize();
     }
+  }
+
+  return updates;
+}
+
+const Array *ObjectStatePlane::createConstantArray(
+    const std::vector<ref<ConstantExpr>> &contents) const {
+  static unsigned id = 0;
+  if (contents.empty())
+    return getArrayCache()->CreateArray("const_arr" + llvm::utostr(++id),
+                                        sizeBound);
+  return getArrayCache()->CreateArray("const_arr" + llvm::utostr(++id),
+                                      contents.size(), &contents[0],
+                                      &contents[0] + contents.size());
+}
 
-    std::vector< ref<ConstantExpr> > Contents(sizeBound);
+unsigned ObjectStatePlane::foldConcreteWrites() const {
+  // Collect the list of writes, with the oldest writes first.
+
+  // FIXME: We should be able to do this more efficiently, we just need to be
+  // careful to get the interaction with the cache right. In particular we
+  // should avoid creating UpdateNode instances we never use.
+  unsigned NumWrites = updates.head ? updates.head->getSize() : 0;
+  std::vector< std::pair< ref<Expr>, ref<Expr> > > Writes(NumWrites);
+  const auto *un = updates.head.get();
+  for (unsigned i = NumWrites; i != 0; un = un->next.get()) {
+    --i;
+    Writes[i] = std::make_pair(un->index, un->value);
+  }
 
+  std::vector< ref<ConstantExpr> > Contents;
+  if (updates.root) {
+    Contents = updates.root->getConstantValues();
+  } else {
     // Initialize to zeros.
+    Contents.resize(sizeBound);
     for (unsigned i = 0, e = sizeBound; i != e; ++i)
       Contents[i] = ConstantExpr::create(0, Expr::Int8);
+  }
 
-    // Pull off as many concrete writes as we can.
-    unsigned Begin = 0, End = Writes.size();
-    for (; Begin != End; ++Begin) {
-      // Push concrete writes into the constant array.
-      ConstantExpr *Index = dyn_cast<ConstantExpr>(Writes[Begin].first);
-      if (!Index)
-        break;
+  // Pull off as many concrete writes as we can.
+  unsigned Begin = 0, End = Writes.size();
+  for (; Begin != End; ++Begin) {
+    // Push concrete writes into the constant array.
+    ConstantExpr *Index = dyn_cast<ConstantExpr>(Writes[Begin].first);
+    if (!Index)
+      break;
 
-      ConstantExpr *Value = dyn_cast<ConstantExpr>(Writes[Begin].second);
-      if (!Value)
-        break;
+    ConstantExpr *Value = dyn_cast<ConstantExpr>(Writes[Begin].second);
+    if (!Value)
+      break;
 
-      Contents[Index->getZExtValue()] = Value;
-    }
+    Contents[Index->getZExtValue()] = Value;
+  }
 
-    static unsigned id = 0;
-    const Array *array;
-    if (sizeBound == 0) {
-       array = parent->getArrayCache()->CreateArray(
-          "const_arr" + llvm::utostr(++id), sizeBound);
-    } else {
-      array = parent->getArrayCache()->CreateArray(
-          "const_arr" + llvm::utostr(++id), sizeBound, &Contents[0],
-          &Contents[0] + Contents.size());
-    }
-    updates = UpdateList(array, 0);
+  // An existing array only gets replaced if some writes were folded.
+  unsigned Folded = Begin;
+  if (updates.root && Folded == 0)
+    return 0;
 
-    // Apply the remaining (non-constant) writes.
-    for (; Begin != End; ++Begin)
-      updates.extend(Writes[Begin].first, Writes[Begin].second);
-  }
+  updates = UpdateList(createConstantArray(Contents), 0);
 
-  return updates;
+  // Apply the remaining (non-constant) writes.
+  for (; Begin != End; ++Begin)
+    updates.extend(Writes[Begin].first, Writes[Begin].second);
+  return Folded;
 }
 
-void ObjectStatePlane::flushToConcreteStore(TimingSolver *solver,
-                                       const ExecutionState &state) {
-  for (unsigned i = 0; i < concreteStore.size(); i++) {
-    if (isByteKnownSymbolic(i)) {
-      ref<ConstantExpr> ce;
-      bool success = solver->getValue(state.constraints, read8(i), ce,
-                                      state.queryMetaData);
-      if (!success) {
-        klee_warning("Solver timed out when getting a value for external call, "
-                     "segment + offset %lu+%u will have random value",
-                     parent->getObject()->segment, i);
-      } else {
-        uint8_t value;
-        ce->toMemory(&value);
-        concreteStore[i] = value;
-      }
+void ObjectStatePlane::flushToConcreteStore(
+    TimingSolver *solver, const ExecutionState &state,
+    std::shared_ptr<const Assignment> &model) {
+  bool modelFailed = false;
+  knownSymbolics.forEach([&](size_t i, const ref<Expr> &byte) {
+    if (i >= concreteStore.size())
+      return;
+    // all bytes are taken from one model of the constraints, so the values
+    // passed to the external are consistent with each other; without it,
+    // each byte is asked for on its own
+    if (!model && !modelFailed)
+      modelFailed = !solver->getInitialValues(state.constraints, model,
+                                              state.queryMetaData);
+    ref<ConstantExpr> ce;
+    if (model)
+      ce = dyn_cast<ConstantExpr>(model->evaluate(byte));
+    if (ce.isNull() &&
+        !solver->getValue(state.constraints, byte, ce, state.queryMetaData)) {
+      klee_warning("Solver timed out when getting a value for external call, "
+                   "segment + offset %lu+%zu will have random value",
+                   object->segment, i);
+    } else {
+      uint8_t value;
+      ce->toMemory(&value);
+      concreteStore.set(i, value);
     }
-  }
+  });
 }
 
 void ObjectStatePlane::makeConcrete() {
   concreteMask.resize(0);
   unflushedMask.resize(0);
+  unflushedBegin = unflushedEnd = 0;
   knownSymbolics.clear();
 }
 
 void ObjectStatePlane::initializeToZero() {
   makeConcrete();
   initialValue = 0;
+  if (trackFingerprints())
+    updateFingerprint();
 }
 
 void ObjectStatePlane::initializeToRandom() {
   makeConcrete();
   // randomly selected by 256 sided die
   initialValue = 0xAB;
+  if (trackFingerprints())
+    updateFingerprint();
 }
 
 /*
@@ -238,49 +351,63 @@ isByteConcrete(i) => !isByteKnownSymbolic(i)
 isByteUnflushed(i) => (isByteConcrete(i) || isByteKnownSymbolic(i))
  */
 
+void ObjectStatePlane::flushByte(unsigned offset) const {
+  if (isByteConcrete(offset)) {
+    updates.extend(ConstantExpr::create(offset, Expr::Int32),
+                   ConstantExpr::create(getConcreteValue(offset), Expr::Int8));
+  } else {
+    assert(isByteKnownSymbolic(offset) && "invalid bit set in unflushedMask");
+    updates.extend(ConstantExpr::create(offset, Expr::Int32),
+                   knownSymbolics[offset]);
+  }
+}
+
 void ObjectStatePlane::flushForRead() const {
-  // TODO: iterate only over the offsets for which we have information
-  // (SparseVector may be, well, sparse...)
-  for (unsigned offset = 0; offset < sizeBound; offset++) {
-    if (isByteUnflushed(offset)) {
-      if (isByteConcrete(offset)) {
-        updates.extend(ConstantExpr::create(offset, Expr::Int32),
-                       ConstantExpr::create(getConcreteValue(offset), Expr::Int8));
-      } else {
-        assert(isByteKnownSymbolic(offset) &&
-               "invalid bit set in unflushedMask");
-        updates.extend(ConstantExpr::create(offset, Expr::Int32),
-                       knownSymbolics[offset]);
-      }
+  // Nothing was flushed yet: the concrete bytes become the constant array
+  // that getUpdates would fold them into anyway.
+  if (!updates.root && !updates.head && initialized && sizeBound) {
+    std::vector<ref<ConstantExpr>> contents(sizeBound);
+    for (unsigned offset = 0; offset != sizeBound; ++offset)
+      contents[offset] = ConstantExpr::create(
+          isByteConcrete(offset) ? getConcreteValue(offset) : 0, Expr::Int8);
+    updates = UpdateList(createConstantArray(contents), 0);
+    knownSymbolics.forEach([&](size_t offset, const ref<Expr> &value) {
+      updates.extend(ConstantExpr::create(offset, Expr::Int32), value);
+    });
+    unflushedMask.resize(0);
+    unflushedMask.resize(sizeBound, false);
+    unflushedBegin = unflushedEnd = 0;
+    return;
+  }
 
-      markByteFlushed(offset);
-    }
+  // Only the bytes marked since the last flush are visited.
+  unsigned maskSize = unflushedMask.size();
+  unsigned end = std::min(unflushedEnd, maskSize);
+  for (unsigned offset = unflushedMask.findFirstSet(unflushedBegin, end);
+       offset < end; offset = unflushedMask.findFirstSet(offset + 1, end))
+    flushByte(offset);
+  if (unflushedBegin < end)
+    unflushedMask.unsetRange(unflushedBegin, end);
+  unflushedBegin = unflushedEnd = 0;
+
+  // bytes past the mask are unflushed if the plane is initialized
+  if (initialized && maskSize < sizeBound) {
+    for (unsigned offset = maskSize; offset != sizeBound; ++offset)
+      flushByte(offset);
+    unflushedMask.resize(sizeBound, false);
   }
 }
 
 void ObjectStatePlane::flushForWrite() {
-  for (unsigned offset = 0; offset < sizeBound; offset++) {
-    if (isByteUnflushed(offset)) {
-      if (isByteConcrete(offset)) {
-        updates.extend(ConstantExpr::create(offset, Expr::Int32),
-                       ConstantExpr::create(getConcreteValue(offset), Expr::Int8));
-        markByteSymbolic(offset);
-      } else {
-        assert(isByteKnownSymbolic(offset) &&
-               "invalid bit set in unflushedMask");
-        updates.extend(ConstantExpr::create(offset, Expr::Int32),
-                       knownSymbolics[offset]);
-        setKnownSymbolic(offset, 0);
-      }
-
-      markByteFlushed(offset);
-    } else {
-      // flushed bytes that are written over still need to be marked out
-      markByteSymbolic(offset);
-      setKnownSymbolic(offset, 0);
-    }
-  }
+  flushForRead();
+  // all bytes are in updates now, also the ones written over since they were
+  // flushed
+  concreteMask.resize(0);
+  unflushedMask.resize(0);
+  unflushedBegin = unflushedEnd = 0;
+  knownSymbolics.clear();
   initialized = false;
+  bytesFingerprint = 0;
 }
 
 bool ObjectStatePlane::isByteConcrete(unsigned offset) const {
@@ -289,6 +416,24 @@ bool ObjectStatePlane::isByteConcrete(unsigned offset) const {
   return initialized;
 }
 
+bool ObjectStatePlane::isRangeConcrete(unsigned offset, unsigned size) const {
+  return findFirstNonConcrete(offset, offset + size) == offset + size;
+}
+
+unsigned ObjectStatePlane::findFirstNonConcrete(unsigned offset,
+                                                unsigned end) const {
+  // bytes past the mask are concrete if the plane is initialized
+  unsigned maskEnd = std::min(end, concreteMask.size());
+  if (offset < maskEnd) {
+    unsigned found = concreteMask.findFirstUnset(offset, maskEnd);
+    if (found != maskEnd)
+      return found;
+  }
+  if (end <= concreteMask.size() || initialized)
+    return end;
+  return std::max(offset, concreteMask.size());
+}
+
 bool ObjectStatePlane::isByteUnflushed(unsigned offset) const {
   if (offset < unflushedMask.size())
     return unflushedMask.get(offset);
@@ -308,6 +453,42 @@ void ObjectStatePlane::markByteConcrete(unsigned offset) {
   concreteMask.set(offset);
 }
 
+/// Set the bits of the size bytes at offset in mask, which like the masks of
+/// ObjectStatePlane is only allocated once a byte deviates from initialized.
+static void markRange(BitArray &mask, unsigned offset, unsigned size,
+                      bool initialized, unsigned sizeBound) {
+  unsigned end = offset + size;
+  if (end > mask.size()) {
+    if (initialized)
+      end = std::max(offset, mask.size());
+    else
+      mask.resize(sizeBound, initialized);
+  }
+  mask.setRange(offset, end);
+}
+
+void ObjectStatePlane::markRangeConcrete(unsigned offset, unsigned size) {
+  markRange(concreteMask, offset, size, initialized, sizeBound);
+}
+
+void ObjectStatePlane::markRangeUnflushed(unsigned offset,
+                                          unsigned size) const {
+  markRange(unflushedMask, offset, size, initialized, sizeBound);
+  noteUnflushed(offset, std::min(offset + size, unflushedMask.size()));
+}
+
+void ObjectStatePlane::noteUnflushed(unsigned begin, unsigned end) const {
+  if (begin >= end)
+    return;
+  if (unflushedBegin >= unflushedEnd) {
+    unflushedBegin = begin;
+    unflushedEnd = end;
+  } else {
+    unflushedBegin = std::min(unflushedBegin, begin);
+    unflushedEnd = std::max(unflushedEnd, end);
+  }
+}
+
 void ObjectStatePlane::markByteSymbolic(unsigned offset) {
   if (offset >= concreteMask.size()) {
     if (!initialized)
@@ -324,15 +505,7 @@ void ObjectStatePlane::markByteUnflushed(unsigned offset) const {
     unflushedMask.resize(sizeBound, initialized);
   }
   unflushedMask.set(offset);
-}
-
-void ObjectStatePlane::markByteFlushed(unsigned offset) const {
-  if (offset >= unflushedMask.size()) {
-    if (!initialized)
-      return;
-    unflushedMask.resize(sizeBound, initialized);
-  }
-  unflushedMask.unset(offset);
+  noteUnflushed(offset, offset + 1);
 }
 
 void ObjectStatePlane::setKnownSymbolic(unsigned offset,
@@ -346,6 +519,53 @@ uint8_t ObjectStatePlane::getConcreteValue(unsigned offset) const {
   return initialValue;
 }
 
+uint64_t ObjectStatePlane::getByteFingerprint(unsigned offset) const {
+  if (isByteConcrete(offset)) {
+    uint8_t value = getConcreteValue(offset);
+    // every byte of an initialized plane is concrete or known symbolic, so
+    // its untouched bytes need not be hashed
+    if (initialized && value == initialValue)
+      return 0;
+    return mixFingerprint((uint64_t(offset) << 9) | 0x100 | value);
+  }
+  if (isByteKnownSymbolic(offset))
+    return combineFingerprints(uint64_t(offset) << 9,
+                               klee::getFingerprint(knownSymbolics[offset]));
+  return 0;
+}
+
+void ObjectStatePlane::updateFingerprint() {
+  bytesFingerprint = 0;
+  for (unsigned offset = 0, e = concreteStore.size(); offset < e; ++offset)
+    if (isByteConcrete(offset))
+      bytesFingerprint ^= getByteFingerprint(offset);
+  knownSymbolics.forEach([&](size_t offset, const ref<Expr> &) {
+    bytesFingerprint ^= getByteFingerprint(offset);
+  });
+}
+
+uint64_t ObjectStatePlane::getFingerprint() const {
+  uint64_t res = combineFingerprints(
+      bytesFingerprint,
+      (uint64_t(sizeBound) << 16) | (initialValue << 1) | initialized);
+  if (updates.root)
+    res = combineFingerprints(res, updates.root->hash());
+  if (updates.head)
+    res = combineFingerprints(
+        res, combineFingerprints(updates.head->stableHash().low,
+                                 updates.head->hash()));
+  return res;
+}
+
+size_t ObjectStatePlane::getFootprint() const {
+  auto maskBytes = [](const BitArray &mask) {
+    return (mask.size() + 31) / 32 * sizeof(uint32_t);
+  };
+  return sizeof(*this) + concreteStore.getProportionalBytes() +
+         maskBytes(concreteMask) + maskBytes(unflushedMask) +
+         knownSymbolics.getAllocatedBytes();
+}
+
 /***/
 
 ref<Expr> ObjectStatePlane::read8(unsigned offset) const {
@@ -365,7 +585,7 @@ ref<Expr> ObjectStatePlane::read8(ref<Expr> offset) const {
 
   if (sizeBound > 4096) {
     std::string allocInfo;
-    parent->getObject()->getAllocInfo(allocInfo);
+    object->getAllocInfo(allocInfo);
     klee_warning_once(
         nullptr,
         "Symbolic memory access will send the following array of %d bytes to "
@@ -376,12 +596,12 @@ ref<Expr> ObjectStatePlane::read8(ref<Expr> offset) const {
 
   const UpdateList &updates = getUpdates();
 
-  if (symbolic || isa<ConstantExpr>(parent->getObject()->size)) {
+  if (symbolic || isa<ConstantExpr>(object->size)) {
     return ReadExpr::create(updates, ZExtExpr::create(offset, Expr::Int32));
   }
 
   ref<Expr> cond = UltExpr::create(offset,
-                                   ConstantExpr::alloc(updates.root->constantValues.size(), Expr::Int32));
+                                   ConstantExpr::alloc(updates.root->isConstantArray() ? updates.root->size : 0, Expr::Int32));
 
   for (const UpdateNode* node = updates.head.get(); node != nullptr; node = node->next.get()) {
     cond = OrExpr::create(EqExpr::create(offset, node->index), cond);
@@ -395,15 +615,20 @@ ref<Expr> ObjectStatePlane::read8(ref<Expr> offset) const {
 
 void ObjectStatePlane::write8(unsigned offset, uint8_t value) {
   //assert(read_only == false && "writing to read-only object!");
+  bool track = trackFingerprints();
+  if (track)
+    bytesFingerprint ^= getByteFingerprint(offset);
   if (offset >= sizeBound)
     sizeBound = offset + 1;
   if (concreteStore.size() <= offset)
     concreteStore.resize(sizeBound, initialValue);
-  concreteStore[offset] = value;
+  concreteStore.set(offset, value);
   setKnownSymbolic(offset, 0);
 
   markByteConcrete(offset);
   markByteUnflushed(offset);
+  if (track)
+    bytesFingerprint ^= getByteFingerprint(offset);
 }
 
 void ObjectStatePlane::write8(unsigned offset, ref<Expr> value) {
@@ -411,12 +636,17 @@ void ObjectStatePlane::write8(unsigned offset, ref<Expr> value) {
   if (ConstantExpr *CE = dyn_cast<ConstantExpr>(value)) {
     write8(offset, (uint8_t) CE->getZExtValue(8));
   } else {
+    bool track = trackFingerprints();
+    if (track)
+      bytesFingerprint ^= getByteFingerprint(offset);
     if (offset >= sizeBound)
       sizeBound = offset + 1;
     setKnownSymbolic(offset, value.get());
       
     markByteSymbolic(offset);
     markByteUnflushed(offset);
+    if (track)
+      bytesFingerprint ^= getByteFingerprint(offset);
   }
 }
 
@@ -427,7 +657,7 @@ void ObjectStatePlane::write8(ref<Expr> offset, ref<Expr> value) {
 
   if (sizeBound > 4096) {
     std::string allocInfo;
-    parent->getObject()->getAllocInfo(allocInfo);
+    object->getAllocInfo(allocInfo);
     klee_warning_once(
         nullptr,
         "Symbolic memory access will send the following array of %d bytes to "
@@ -473,9 +703,27 @@ ref<Expr> ObjectStatePlane::read(unsigned offset, Expr::Width width) const {
   if (width == Expr::Bool)
     return ExtractExpr::create(read8(offset), 0, Expr::Bool);
 
-  // Otherwise, follow the slow general case.
   unsigned NumBytes = width / 8;
   assert(width == NumBytes * 8 && "Invalid width for read size!");
+
+  // Concrete values are loaded from the store at once.
+  if (width <= Expr::Int64 && isRangeConcrete(offset, NumBytes)) {
+    uint8_t bytes[8];
+    unsigned stored = 0;
+    if (offset < concreteStore.size())
+      stored = std::min<size_t>(NumBytes, concreteStore.size() - offset);
+    if (stored)
+      concreteStore.copyTo(offset, stored, bytes);
+    std::fill(bytes + stored, bytes + NumBytes, initialValue);
+    uint64_t value = 0;
+    for (unsigned i = 0; i != NumBytes; ++i) {
+      unsigned idx = Context::get().isLittleEndian() ? i : (NumBytes - i - 1);
+      value |= uint64_t(bytes[idx]) << (8 * i);
+    }
+    return ConstantExpr::create(value, width);
+  }
+
+  // Otherwise, follow the slow general case.
   ref<Expr> Res(0);
   for (unsigned i = 0; i != NumBytes; ++i) {
     unsigned idx = Context::get().isLittleEndian() ? i : (NumBytes - i - 1);
@@ -546,34 +794,135 @@ void ObjectStatePlane::write(unsigned offset, ref<Expr> value) {
   }
 } 
 
-void ObjectStatePlane::write16(unsigned offset, uint16_t value) {
-  unsigned NumBytes = 2;
+void ObjectStatePlane::writeConcreteValue(unsigned offset, uint64_t value,
+                                          unsigned NumBytes) {
+  uint8_t bytes[8];
   for (unsigned i = 0; i != NumBytes; ++i) {
     unsigned idx = Context::get().isLittleEndian() ? i : (NumBytes - i - 1);
-    write8(offset + idx, (uint8_t) (value >> (8 * i)));
+    bytes[idx] = (uint8_t)(value >> (8 * i));
   }
+  writeConcrete(offset, NumBytes, bytes);
+}
+
+void ObjectStatePlane::write16(unsigned offset, uint16_t value) {
+  writeConcreteValue(offset, value, 2);
 }
 
 void ObjectStatePlane::write32(unsigned offset, uint32_t value) {
-  unsigned NumBytes = 4;
-  for (unsigned i = 0; i != NumBytes; ++i) {
-    unsigned idx = Context::get().isLittleEndian() ? i : (NumBytes - i - 1);
-    write8(offset + idx, (uint8_t) (value >> (8 * i)));
-  }
+  writeConcreteValue(offset, value, 4);
 }
 
 void ObjectStatePlane::write64(unsigned offset, uint64_t value) {
-  unsigned NumBytes = 8;
-  for (unsigned i = 0; i != NumBytes; ++i) {
-    unsigned idx = Context::get().isLittleEndian() ? i : (NumBytes - i - 1);
-    write8(offset + idx, (uint8_t) (value >> (8 * i)));
+  writeConcreteValue(offset, value, 8);
+}
+
+void ObjectStatePlane::writeConcrete(unsigned offset, unsigned size,
+                                     const uint8_t *bytes) {
+  bool track = trackFingerprints();
+  if (track)
+    for (unsigned i = 0; i < size; ++i)
+      bytesFingerprint ^= getByteFingerprint(offset + i);
+  if (offset + size > sizeBound)
+    sizeBound = offset + size;
+  if (concreteStore.size() < offset + size)
+    concreteStore.resize(sizeBound, initialValue);
+  concreteStore.copyFrom(offset, size, bytes);
+  if (!knownSymbolics.empty())
+    for (unsigned i = 0; i < size; ++i)
+      setKnownSymbolic(offset + i, 0);
+  markRangeConcrete(offset, size);
+  markRangeUnflushed(offset, size);
+  if (track)
+    for (unsigned i = 0; i < size; ++i)
+      bytesFingerprint ^= getByteFingerprint(offset + i);
+}
+
+bool ObjectStatePlane::readConcrete(unsigned offset, unsigned size,
+                                    uint8_t *bytes) const {
+  return readConcretePrefix(offset, size, bytes) == size;
+}
+
+unsigned ObjectStatePlane::readConcretePrefix(unsigned offset, unsigned size,
+                                              uint8_t *bytes) const {
+  unsigned concrete = findFirstNonConcrete(offset, offset + size) - offset;
+  unsigned stored = 0;
+  if (offset < concreteStore.size())
+    stored = std::min<size_t>(concrete, concreteStore.size() - offset);
+  if (stored)
+    concreteStore.copyTo(offset, stored, bytes);
+  std::fill(bytes + stored, bytes + concrete, initialValue);
+  return concrete;
+}
+
+/// Whether the size bytes are all zero, or-ing whole words at a time so
+/// that the loop is vectorized.
+static bool isZero(const uint8_t *bytes, unsigned size) {
+  uint64_t any = 0;
+  unsigned i = 0;
+  for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+    uint64_t word;
+    std::memcpy(&word, bytes + i, sizeof(word));
+    any |= word;
+  }
+  for (; i < size; ++i)
+    any |= bytes[i];
+  return !any;
+}
+
+void ObjectStatePlane::findNonZeroWords(unsigned wordSize,
+                                        std::vector<unsigned> &offsets) const {
+  // a multiple of any word size up to it
+  const unsigned ChunkSize = 4096;
+  assert(wordSize && ChunkSize % wordSize == 0 && "unsupported word size");
+  uint8_t bytes[ChunkSize];
+  unsigned end = sizeBound - sizeBound % wordSize;
+  for (unsigned chunk = 0; chunk < end;) {
+    unsigned size = std::min(ChunkSize, end - chunk);
+    unsigned concrete = readConcretePrefix(chunk, size, bytes);
+    concrete -= concrete % wordSize;
+    if (!isZero(bytes, concrete))
+      for (unsigned i = 0; i < concrete; i += wordSize)
+        if (!isZero(bytes + i, wordSize))
+          offsets.push_back(chunk + i);
+    chunk += concrete;
+    // a word with a symbolic byte may hold anything
+    if (concrete < size) {
+      offsets.push_back(chunk);
+      chunk += wordSize;
+    }
+  }
+}
+
+void ObjectStatePlane::copy(unsigned offset, const ObjectStatePlane &src,
+                            unsigned srcOffset, unsigned size) {
+  // all bytes are read before any is written, src may be this plane
+  std::vector<uint8_t> values(size);
+  std::vector<ref<Expr>> symbolics;
+  if (!src.readConcrete(srcOffset, size, values.data())) {
+    symbolics.resize(size);
+    for (unsigned i = 0; i < size; ++i) {
+      if (src.isByteConcrete(srcOffset + i))
+        values[i] = src.getConcreteValue(srcOffset + i);
+      else
+        symbolics[i] = src.read8(srcOffset + i);
+    }
   }
+
+  writeConcrete(offset, size, values.data());
+  for (unsigned i = 0; i < symbolics.size(); ++i)
+    if (!symbolics[i].isNull())
+      write8(offset + i, symbolics[i]);
+}
+
+void ObjectStatePlane::fill(unsigned offset, unsigned size, uint8_t value) {
+  std::vector<uint8_t> values(size, value);
+  writeConcrete(offset, size, values.data());
 }
 
 void ObjectStatePlane::print() const {
   llvm::errs() << "-- ObjectState --\n";
-  if (parent)
-    llvm::errs() << "\tMemoryObject ID: " << parent->getObject()->id << "\n";
+  if (object)
+    llvm::errs() << "\tMemoryObject ID: " << object->id << "\n";
   llvm::errs() << "\tRoot Object: " << updates.root << "\n";
   llvm::errs() << "\tSize: " << sizeBound << "\n";
 
@@ -593,14 +942,184 @@ void ObjectStatePlane::print() const {
   }
 }
 
+/***/
+
+uint8_t ConcreteSegmentPlane::getByte(const Run &run,
+                                      unsigned byteInRun) const {
+  unsigned byteInWord = byteInRun % run.wordSize;
+  if (!Context::get().isLittleEndian())
+    byteInWord = run.wordSize - byteInWord - 1;
+  return (uint8_t)(run.segment >> (8 * byteInWord));
+}
+
+uint8_t ConcreteSegmentPlane::read8(unsigned offset) const {
+  auto it = runs.upper_bound(offset);
+  if (it == runs.begin())
+    return 0;
+  --it;
+  if (offset - it->first >= it->second.size())
+    return 0;
+  return getByte(it->second, offset - it->first);
+}
+
+ref<Expr> ConcreteSegmentPlane::read(unsigned offset, Expr::Width width) const {
+  if (width == Expr::Bool)
+    return ConstantExpr::alloc(read8(offset) & 1, Expr::Bool);
+
+  unsigned NumBytes = width / 8;
+  assert(width == NumBytes * 8 && "Invalid width for read size!");
+
+  // fast path: the read matches a word of a run
+  auto it = runs.upper_bound(offset);
+  if (it != runs.begin()) {
+    --it;
+    const Run &run = it->second;
+    unsigned inRun = offset - it->first;
+    if (inRun < run.size() && run.wordSize == NumBytes &&
+        inRun % run.wordSize == 0)
+      return ConstantExpr::alloc(run.segment, width);
+  }
+
+  if (width <= Expr::Int64) {
+    uint64_t segment = 0;
+    for (unsigned i = 0; i != NumBytes; ++i) {
+      unsigned idx = Context::get().isLittleEndian() ? i : (NumBytes - i - 1);
+      segment |= (uint64_t)read8(offset + idx) << (8 * i);
+    }
+    return ConstantExpr::alloc(segment, width);
+  }
+
+  ref<Expr> Res(0);
+  for (unsigned i = 0; i != NumBytes; ++i) {
+    unsigned idx = Context::get().isLittleEndian() ? i : (NumBytes - i - 1);
+    ref<Expr> Byte = ConstantExpr::alloc(read8(offset + idx), Expr::Int8);
+    Res = i ? ConcatExpr::create(Byte, Res) : Byte;
+  }
+  return Res;
+}
+
+void ConcreteSegmentPlane::clearRange(unsigned begin, unsigned end) {
+  auto it = runs.upper_bound(begin);
+  if (it != runs.begin())
+    --it;
+
+  std::vector<std::pair<unsigned, Run>> kept;
+  while (it != runs.end() && it->first < end) {
+    unsigned start = it->first;
+    Run run = it->second;
+    unsigned runEnd = start + run.size();
+    if (runEnd <= begin) {
+      ++it;
+      continue;
+    }
+    it = runs.erase(it);
+
+    // words before begin and after end stay whole, bytes of the words
+    // that are only partially overwritten become single byte runs
+    if (start < begin) {
+      unsigned words = (begin - start) / run.wordSize;
+      if (words)
+        kept.push_back({start, Run{run.wordSize, words, run.segment}});
+      for (unsigned b = start + words * run.wordSize; b < begin; ++b)
+        kept.push_back({b, Run{1, 1, getByte(run, b - start)}});
+    }
+    if (runEnd > end) {
+      unsigned firstWord = (end - start + run.wordSize - 1) / run.wordSize;
+      unsigned wordStart = start + firstWord * run.wordSize;
+      for (unsigned b = end; b < wordStart; ++b)
+        kept.push_back({b, Run{1, 1, getByte(run, b - start)}});
+      if (firstWord < run.count)
+        kept.push_back({wordStart, Run{run.wordSize, run.count - firstWord,
+                                       run.segment}});
+    }
+  }
+
+  for (const auto &k : kept)
+    if (k.second.segment != 0)
+      runs.emplace(k.first, k.second);
+}
+
+void ConcreteSegmentPlane::insertRun(unsigned offset, const Run &run) {
+  auto it = runs.emplace(offset, run).first;
+
+  // merge with the following run
+  auto next = std::next(it);
+  if (next != runs.end() && next->first == offset + it->second.size() &&
+      next->second.wordSize == run.wordSize &&
+      next->second.segment == run.segment) {
+    it->second.count += next->second.count;
+    runs.erase(next);
+  }
+
+  // merge with the preceding run
+  if (it != runs.begin()) {
+    auto prev = std::prev(it);
+    if (prev->first + prev->second.size() == offset &&
+        prev->second.wordSize == run.wordSize &&
+        prev->second.segment == run.segment) {
+      prev->second.count += it->second.count;
+      runs.erase(it);
+    }
+  }
+}
+
+void ConcreteSegmentPlane::write(unsigned offset, uint64_t segment,
+                                 Expr::Width width) {
+  assert(width <= Expr::Int64 && "Invalid write size!");
+  unsigned NumBytes = width == Expr::Bool ? 1 : width / 8;
+  if (width == Expr::Bool)
+    segment &= 1;
+  else if (width < Expr::Int64)
+    segment &= (UINT64_C(1) << width) - 1;
+
+  clearRange(offset, offset + NumBytes);
+  if (segment != 0)
+    insertRun(offset, Run{NumBytes, 1, segment});
+}
+
+void ConcreteSegmentPlane::getSegments(std::vector<uint64_t> &segments) const {
+  for (const auto &r : runs)
+    if (r.second.segment)
+      segments.push_back(r.second.segment);
+}
+
+void ConcreteSegmentPlane::copyTo(ObjectStatePlane &plane) const {
+  for (const auto &r : runs)
+    for (unsigned i = 0; i < r.second.size(); ++i)
+      plane.write8(r.first + i, getByte(r.second, i));
+}
+
+uint64_t ConcreteSegmentPlane::getFingerprint() const {
+  uint64_t res = 0;
+  for (const auto &r : runs)
+    res = combineFingerprints(
+        combineFingerprints(res, (uint64_t(r.first) << 32) | r.second.count),
+        combineFingerprints(r.second.wordSize, r.second.segment));
+  return res;
+}
+
+size_t ConcreteSegmentPlane::getFootprint() const {
+  // a node of the map holds its links and color next to the run
+  return sizeof(*this) + runs.size() * (sizeof(*runs.begin()) + 4 * sizeof(void *));
+}
+
 /****/
 
+void *ObjectState::operator new(size_t size) {
+  assert(size == sizeof(ObjectState) && "unexpected size for pooled object");
+  return MemoryManager::getPool(MemoryManager::ObjectStatePool).allocate();
+}
+
+void ObjectState::operator delete(void *p, size_t) {
+  MemoryManager::getPool(MemoryManager::ObjectStatePool).deallocate(p);
+}
+
 ObjectState::ObjectState(const MemoryObject *mo)
   : copyOnWriteOwner(0),
     object(mo),
     readOnly(false),
     segmentPlane(nullptr),
-    offsetPlane(new ObjectStatePlane(this)) {
+    offsetPlane(new ObjectStatePlane(mo)) {
 }
 
 
@@ -609,122 +1128,320 @@ ObjectState::ObjectState(const MemoryObject *mo, const Array *array)
     object(mo),
     readOnly(false),
     segmentPlane(nullptr),
-    offsetPlane(new ObjectStatePlane(this, array)) {
+    offsetPlane(new ObjectStatePlane(mo, array)) {
 }
 
 ObjectState::ObjectState(const ObjectState &os)
   : copyOnWriteOwner(0),
     object(os.object),
     readOnly(false),
-    segmentPlane(nullptr),
-    offsetPlane(new ObjectStatePlane(this, *os.offsetPlane)) {
-  if (os.segmentPlane)
-    segmentPlane = new ObjectStatePlane(this, *os.segmentPlane);
+    segmentPlane(os.segmentPlane),
+    offsetPlane(os.offsetPlane),
+    concreteSegmentPlane(os.concreteSegmentPlane) {
+  assert(!os.readOnly && "no need to copy read only object?");
 }
 
-ObjectState::ObjectState(const ObjectState &os, const MemoryObject *mo)
-  : ObjectState(os) {
-    object = mo;
+ObjectState::ObjectState(const ObjectState &os, const MemoryObject *mo,
+                         bool exclusive)
+  : copyOnWriteOwner(0),
+    object(mo),
+    readOnly(false),
+    segmentPlane(reallocatePlane(os.segmentPlane, mo, exclusive)),
+    offsetPlane(reallocatePlane(os.offsetPlane, mo, exclusive)),
+    concreteSegmentPlane(os.concreteSegmentPlane) {
 }
 
-ObjectState::~ObjectState() {
-  if (segmentPlane)
-    delete segmentPlane;
-  delete offsetPlane;
+ref<ObjectStatePlane>
+ObjectState::reallocatePlane(const ref<ObjectStatePlane> &plane,
+                             const MemoryObject *mo, bool exclusive) {
+  if (!plane)
+    return plane;
+  // The planes of a reallocated object refer to the new object, so they
+  // are not shared with the original (the compact segment plane does not
+  // refer to any object). A plane nothing else refers to is taken over, its
+  // bytes past the old size are added when they are written.
+  ref<ObjectStatePlane> result = plane;
+  if (exclusive && plane->_refCount.getCount() == 1)
+    result->object = mo;
+  else
+    result = new ObjectStatePlane(mo, *plane);
+  result->pageConcreteStore();
+  return result;
+}
+
+ObjectStatePlane *ObjectState::getWriteablePlane(ref<ObjectStatePlane> &plane) {
+  if (plane->_refCount.getCount() > 1)
+    plane = new ObjectStatePlane(object.get(), *plane);
+  return plane.get();
 }
 
 KValue ObjectState::read8(unsigned offset) const {
-  ref<Expr> segment;
-  if (segmentPlane) {
-    segment = segmentPlane->read8(offset);
-  } else {
-    segment = ConstantExpr::alloc(0, Expr::Int8);
-  }
   ref<Expr> value = offsetPlane->read8(offset);
-  return KValue(segment, value);
+  if (segmentPlane)
+    return KValue(segmentPlane->read8(offset), value);
+  if (concreteSegmentPlane)
+    return KValue(ConstantExpr::alloc(concreteSegmentPlane->read8(offset),
+                                      Expr::Int8),
+                  value);
+  return KValue(value);
 }
 
 KValue ObjectState::read(unsigned offset, Expr::Width width) const {
-  ref<Expr> segment;
-  if (segmentPlane) {
-    segment = segmentPlane->read(offset, width);
-  } else {
-    segment = ConstantExpr::alloc(0, width);
-  }
   ref<Expr> value = offsetPlane->read(offset, width);
-  return KValue(segment, value);
+  if (segmentPlane)
+    return KValue(segmentPlane->read(offset, width), value);
+  if (concreteSegmentPlane)
+    return KValue(concreteSegmentPlane->read(offset, width), value);
+  return KValue(value);
 }
 
 KValue ObjectState::read(ref<Expr> offset, Expr::Width width) const {
-  ref<Expr> segment;
-  if (segmentPlane) {
-    segment = segmentPlane->read(offset, width);
-  } else {
-    segment = ConstantExpr::alloc(0, width);
-  }
   ref<Expr> value = offsetPlane->read(offset, width);
-  return KValue(segment, value);
+  if (concreteSegmentPlane) {
+    ref<Expr> truncated = ZExtExpr::create(offset, Expr::Int32);
+    if (ConstantExpr *CE = dyn_cast<ConstantExpr>(truncated))
+      return KValue(concreteSegmentPlane->read(CE->getZExtValue(32), width),
+                    value);
+    if (!segmentReadPlane) {
+      segmentReadPlane = new ObjectStatePlane(object.get());
+      concreteSegmentPlane->copyTo(*segmentReadPlane);
+    }
+    return KValue(segmentReadPlane->read(offset, width), value);
+  }
+  if (segmentPlane)
+    return KValue(segmentPlane->read(offset, width), value);
+  return KValue(value);
 }
 
-bool ObjectState::prepareSegmentPlane(bool nonzero) {
+ObjectStatePlane *ObjectState::getFullSegmentPlane() {
   if (!segmentPlane) {
-    if (nonzero) {
-      segmentPlane = new ObjectStatePlane(this);
-      return true;
+    if (segmentReadPlane) {
+      segmentPlane = segmentReadPlane;
+    } else {
+      segmentPlane = new ObjectStatePlane(object.get());
+      if (concreteSegmentPlane)
+        concreteSegmentPlane->copyTo(*segmentPlane);
     }
+    concreteSegmentPlane = nullptr;
+    segmentReadPlane = nullptr;
+  }
+  return getWriteablePlane(segmentPlane);
+}
+
+bool ObjectState::writeConcreteSegment(unsigned offset, uint64_t segment,
+                                       Expr::Width width) {
+  if (segmentPlane)
     return false;
+  if (!concreteSegmentPlane) {
+    // segment 0 is the default, no need for a plane to store it
+    if (segment == 0)
+      return true;
+    concreteSegmentPlane = new ConcreteSegmentPlane();
+  } else if (concreteSegmentPlane->_refCount.getCount() > 1) {
+    concreteSegmentPlane = new ConcreteSegmentPlane(*concreteSegmentPlane);
   }
+  concreteSegmentPlane->write(offset, segment, width);
+  segmentReadPlane = nullptr;
   return true;
 }
 
-bool ObjectState::prepareSegmentPlane(ref<Expr> segment) {
-  if (ConstantExpr *CE = dyn_cast<ConstantExpr>(segment))
-    return prepareSegmentPlane(!CE->isZero());
-  return prepareSegmentPlane(true);
+void ObjectState::writeSegment(unsigned offset, const KValue &value) {
+  if (object->isPointerFree && !segmentPlane && !concreteSegmentPlane) {
+    if (value.isSegmentZero())
+      return;
+    klee_warning_once(object->allocSite,
+                      "Storing a pointer into memory of %s that was assumed "
+                      "to be pointer-free",
+                      object->name.c_str());
+  }
+  if (value.hasConstantSegment() &&
+      writeConcreteSegment(offset, value.getConstantSegment(),
+                           value.getWidth()))
+    return;
+  getFullSegmentPlane()->write(offset, value.getSegment());
 }
 
 void ObjectState::write8(unsigned offset, uint8_t segment, uint8_t value) {
-  if (prepareSegmentPlane(segment))
-    segmentPlane->write8(offset, segment);
-  offsetPlane->write8(offset, value);
+  if (!writeConcreteSegment(offset, segment, Expr::Int8))
+    getFullSegmentPlane()->write8(offset, segment);
+  getWriteablePlane(offsetPlane)->write8(offset, value);
 }
 
 void ObjectState::write16(unsigned offset, uint16_t segment, uint16_t value) {
-  if (prepareSegmentPlane(segment))
-    segmentPlane->write16(offset, segment);
-  offsetPlane->write16(offset, value);
+  if (!writeConcreteSegment(offset, segment, Expr::Int16))
+    getFullSegmentPlane()->write16(offset, segment);
+  getWriteablePlane(offsetPlane)->write16(offset, value);
 }
 
 void ObjectState::write32(unsigned offset, uint32_t segment, uint32_t value) {
-  if (prepareSegmentPlane(segment))
-    segmentPlane->write32(offset, segment);
-  offsetPlane->write32(offset, value);
+  if (!writeConcreteSegment(offset, segment, Expr::Int32))
+    getFullSegmentPlane()->write32(offset, segment);
+  getWriteablePlane(offsetPlane)->write32(offset, value);
 }
 
 void ObjectState::write64(unsigned offset, uint64_t segment, uint64_t value) {
-  if (prepareSegmentPlane(segment))
-    segmentPlane->write64(offset, segment);
-  offsetPlane->write64(offset, value);
+  if (!writeConcreteSegment(offset, segment, Expr::Int64))
+    getFullSegmentPlane()->write64(offset, segment);
+  getWriteablePlane(offsetPlane)->write64(offset, value);
+}
+
+void ObjectState::copy(unsigned offset, const ObjectState &src,
+                       unsigned srcOffset, unsigned size) {
+  // the planes of src stay alive even if src is this object and its planes
+  // are replaced by writeable copies
+  ref<ObjectStatePlane> srcOffsets = src.offsetPlane;
+  if (src.segmentPlane) {
+    ref<ObjectStatePlane> srcSegments = src.segmentPlane;
+    getFullSegmentPlane()->copy(offset, *srcSegments, srcOffset, size);
+  } else if (src.concreteSegmentPlane || hasSegmentPlane()) {
+    std::vector<uint8_t> segments(size);
+    if (src.concreteSegmentPlane)
+      for (unsigned i = 0; i < size; ++i)
+        segments[i] = src.concreteSegmentPlane->read8(srcOffset + i);
+    // whole words keep the runs of the compact segment plane
+    for (unsigned i = 0; i < size;) {
+      unsigned NumBytes = size - i >= 8 ? 8 : 1;
+      uint64_t segment = 0;
+      for (unsigned b = 0; b != NumBytes; ++b) {
+        unsigned idx =
+            Context::get().isLittleEndian() ? b : (NumBytes - b - 1);
+        segment |= (uint64_t)segments[i + b] << (8 * idx);
+      }
+      if (!writeConcreteSegment(offset + i, segment, NumBytes * 8)) {
+        if (NumBytes == 8)
+          getFullSegmentPlane()->write64(offset + i, segment);
+        else
+          getFullSegmentPlane()->write8(offset + i, (uint8_t)segment);
+      }
+      i += NumBytes;
+    }
+  }
+  getWriteablePlane(offsetPlane)->copy(offset, *srcOffsets, srcOffset, size);
+}
+
+void ObjectState::clearSegments(unsigned offset, unsigned size) {
+  if (segmentPlane) {
+    getFullSegmentPlane()->fill(offset, size, 0);
+  } else if (concreteSegmentPlane) {
+    if (concreteSegmentPlane->_refCount.getCount() > 1)
+      concreteSegmentPlane = new ConcreteSegmentPlane(*concreteSegmentPlane);
+    concreteSegmentPlane->clearRange(offset, offset + size);
+    segmentReadPlane = nullptr;
+  }
+}
+
+void ObjectState::fill(unsigned offset, unsigned size, ref<Expr> value) {
+  clearSegments(offset, size);
+
+  ObjectStatePlane *plane = getWriteablePlane(offsetPlane);
+  if (ConstantExpr *CE = dyn_cast<ConstantExpr>(value)) {
+    plane->fill(offset, size, (uint8_t)CE->getZExtValue(8));
+  } else {
+    for (unsigned i = 0; i < size; ++i)
+      plane->write8(offset + i, value);
+  }
+}
+
+void ObjectState::writeConcrete(unsigned offset, unsigned size,
+                                const uint8_t *bytes) {
+  clearSegments(offset, size);
+  getWriteablePlane(offsetPlane)->writeConcrete(offset, size, bytes);
+}
+
+bool ObjectState::readConcrete(unsigned offset, unsigned size,
+                               uint8_t *bytes) const {
+  if (hasSegmentPlane())
+    return false;
+  return offsetPlane->readConcrete(offset, size, bytes);
+}
+
+unsigned ObjectState::readConcretePrefix(unsigned offset, unsigned size,
+                                         uint8_t *bytes) const {
+  unsigned n = offsetPlane->readConcretePrefix(offset, size, bytes);
+  if (concreteSegmentPlane) {
+    for (unsigned i = 0; i < n; ++i)
+      if (concreteSegmentPlane->read8(offset + i))
+        return i;
+  } else if (segmentPlane) {
+    std::vector<uint8_t> segments(n);
+    unsigned m = segmentPlane->readConcretePrefix(offset, n, segments.data());
+    for (unsigned i = 0; i < m; ++i)
+      if (segments[i])
+        return i;
+    return m;
+  }
+  return n;
+}
+
+void ObjectState::getStoredSegments(std::vector<uint64_t> &segments,
+                                    std::vector<ref<Expr>> &symbolic) const {
+  if (concreteSegmentPlane) {
+    concreteSegmentPlane->getSegments(segments);
+    return;
+  }
+  if (!segmentPlane)
+    return;
+
+  Expr::Width width = Context::get().getPointerWidth();
+  std::vector<unsigned> offsets;
+  segmentPlane->findNonZeroWords(width / 8, offsets);
+  for (unsigned offset : offsets) {
+    ref<Expr> segment = segmentPlane->read(offset, width);
+    if (auto *CE = dyn_cast<ConstantExpr>(segment)) {
+      if (!CE->isZero())
+        segments.push_back(CE->getZExtValue());
+    } else {
+      symbolic.push_back(segment);
+    }
+  }
 }
 
 void ObjectState::write(unsigned offset, const KValue& value) {
-  if (prepareSegmentPlane(value.getSegment()))
-    segmentPlane->write(offset, value.getSegment());
-  offsetPlane->write(offset, value.getOffset());
+  writeSegment(offset, value);
+  getWriteablePlane(offsetPlane)->write(offset, value.getOffset());
 }
 
 void ObjectState::write(ref<Expr> offset, const KValue& value) {
-  if (prepareSegmentPlane(value.getSegment()))
-    segmentPlane->write(offset, value.getSegment());
-  offsetPlane->write(offset, value.getOffset());
+  ref<Expr> truncated = ZExtExpr::create(offset, Expr::Int32);
+  if (ConstantExpr *CE = dyn_cast<ConstantExpr>(truncated)) {
+    write(CE->getZExtValue(32), value);
+    return;
+  }
+  // a write at a symbolic offset may overwrite any byte of the plane
+  if (segmentPlane || concreteSegmentPlane || !value.isSegmentZero())
+    getFullSegmentPlane()->write(offset, value.getSegment());
+  getWriteablePlane(offsetPlane)->write(offset, value.getOffset());
 }
 
 void ObjectState::initializeToZero() {
-  offsetPlane->initializeToZero();
+  getWriteablePlane(offsetPlane)->initializeToZero();
 }
 
 void ObjectState::initializeToRandom() {
-  offsetPlane->initializeToRandom();
+  getWriteablePlane(offsetPlane)->initializeToRandom();
+}
+
+uint64_t ObjectState::getFingerprint() const {
+  uint64_t res = combineFingerprints(offsetPlane->getFingerprint(), readOnly);
+  if (segmentPlane)
+    res = combineFingerprints(res, segmentPlane->getFingerprint());
+  else if (concreteSegmentPlane)
+    res = combineFingerprints(res, ~concreteSegmentPlane->getFingerprint());
+  return res;
+}
+
+size_t ObjectState::getFootprint() const {
+  // planes also held by other copies of this object count for their share
+  size_t res = sizeof(*this) +
+               offsetPlane->getFootprint() / offsetPlane->_refCount.getCount();
+  if (segmentPlane)
+    res += segmentPlane->getFootprint() / segmentPlane->_refCount.getCount();
+  else if (concreteSegmentPlane)
+    res += concreteSegmentPlane->getFootprint() /
+           concreteSegmentPlane->_refCount.getCount();
+  if (segmentReadPlane)
+    res += segmentReadPlane->getFootprint();
+  return res;
 }
 
 ArrayCache* ObjectState::getArrayCache() const {
@@ -14,11 +14,14 @@
 #include "TimingSolver.h"
 
 #include "klee/ADT/BitArray.h"
+#include "klee/ADT/PagedVector.h"
 #include "klee/Module/KValue.h"
 
 #include "llvm/ADT/Optional.h"
 #include "llvm/ADT/StringExtras.h"
 
+#include <map>
+#include <memory>
 #include <vector>
 #include <unordered_map>
 #include <string>
@@ -36,6 +39,7 @@ class MemoryManager;
 class Solver;
 
 class MemoryObject {
+  friend class MemoryManager;
   friend class STPBuilder;
   friend class ObjectState;
   friend class ExecutionState;
@@ -47,6 +51,10 @@ private:
   /// @brief Required by klee::ref-managed objects
   mutable class ReferenceCounter _refCount;
 
+  /// Neighbours in the list of live objects of the MemoryManager
+  MemoryObject *prevObject = nullptr;
+  MemoryObject *nextObject = nullptr;
+
 public:
   unsigned id;
   uint64_t segment;
@@ -64,6 +72,10 @@ public:
 
   bool isUserSpecified;
 
+  /// The allocation site was found to never hold a pointer, so the memory
+  /// of this object does not need a segment plane.
+  bool isPointerFree = false;
+
   MemoryManager *parent;
 
   /// "Location" for which this memory object was allocated. This
@@ -126,6 +138,10 @@ public:
 
   ~MemoryObject();
 
+  /// Allocated from a pool of the MemoryManager, see MemoryManager::getPool
+  static void *operator new(size_t size);
+  static void operator delete(void *p, size_t size);
+
   /// Get an identifying string for this allocation.
   void getAllocInfo(std::string &result) const;
 
@@ -143,6 +159,10 @@ public:
     this->name = name;
   }
 
+  /// Whether the object was allocated on the heap, which changes once it is
+  /// marked global with klee_mark_global.
+  bool isHeapObject() const { return !isLocal && !isGlobal && !isFixed; }
+
   uint64_t getSegment() const {
     return segment;
   }
@@ -223,77 +243,164 @@ private:
   }
 };
 
-// up to some offset this container is implemented
-// as a vector and from some offset as a map
-// (leveraging the assumption that large offsets will
-// be sparse). Threshold is the maximal number of elements
-// in the vector.
-// This class is specialized for our needs, it is not generic...
-template <typename T, const size_t Threshold = (1 << 18)>
+// Two-level radix array: the index space is split into fixed-size leaf
+// blocks that are allocated only when an element in them is set, so the
+// memory (and the cost of copying) grows with the number of stored
+// elements rather than with the highest index. Leaves for small indices are
+// found through a vector, leaves above Threshold through a hash map
+// (leveraging the assumption that large offsets will be sparse).
+// This class is specialized for our needs (T is a ref<>), it is not generic...
+template <typename T, const size_t Threshold = (1 << 22),
+          const unsigned LeafBits = 8>
 class SparseVector {
-    std::vector<T> _vector;
-    std::unordered_map<size_t, T> _map;
+    static const size_t LeafSize = size_t(1) << LeafBits;
+    static const size_t MaxDirectLeaves = Threshold >> LeafBits;
+
+    struct Leaf {
+        T slots[LeafSize];
+        unsigned count = 0;
+    };
+
+    // leaves for indices below Threshold, indexed by n >> LeafBits
+    std::vector<std::unique_ptr<Leaf>> _leaves;
+    // leaves for indices above Threshold
+    std::unordered_map<size_t, std::unique_ptr<Leaf>> _farLeaves;
+    size_t _count = 0;
+
+    const Leaf *findLeaf(size_t leaf) const {
+        if (leaf < MaxDirectLeaves)
+            return leaf < _leaves.size() ? _leaves[leaf].get() : nullptr;
+        auto it = _farLeaves.find(leaf);
+        return it == _farLeaves.end() ? nullptr : it->second.get();
+    }
+
+    std::unique_ptr<Leaf> &getLeafSlot(size_t leaf) {
+        if (leaf < MaxDirectLeaves) {
+            if (_leaves.size() <= leaf)
+                _leaves.resize(leaf + 1);
+            return _leaves[leaf];
+        }
+        return _farLeaves[leaf];
+    }
+
+    static std::unique_ptr<Leaf> copyLeaf(const std::unique_ptr<Leaf> &l) {
+        return l ? std::unique_ptr<Leaf>(new Leaf(*l)) : nullptr;
+    }
 
 public:
-    const T& operator[](size_t n) const {
-        if (n < Threshold) {
-            assert(n < _vector.size());
-            assert(_vector[n].get() != nullptr && "Use has() before");
-            return _vector[n];
-        } else {
-            auto it = _map.find(n);
-            if (it == _map.end()) {
-                assert(false && "Cannot happen, must use has() before");
-                abort();
-            }
-            assert(it->second.get() != nullptr);
-            return it->second;
+    SparseVector() = default;
+    SparseVector(const SparseVector &other) : _count(other._count) {
+        _leaves.reserve(other._leaves.size());
+        for (const auto &l : other._leaves)
+            _leaves.push_back(copyLeaf(l));
+        for (const auto &l : other._farLeaves)
+            _farLeaves.emplace(l.first, copyLeaf(l.second));
+    }
+    SparseVector &operator=(const SparseVector &other) {
+        if (this != &other) {
+            SparseVector tmp(other);
+            std::swap(_leaves, tmp._leaves);
+            std::swap(_farLeaves, tmp._farLeaves);
+            _count = other._count;
         }
+        return *this;
+    }
+
+    const T& operator[](size_t n) const {
+        const Leaf *leaf = findLeaf(n >> LeafBits);
+        assert(leaf && "Cannot happen, must use has() before");
+        const T &val = leaf->slots[n & (LeafSize - 1)];
+        assert(val.get() != nullptr && "Use has() before");
+        return val;
     }
 
     void set(size_t n, const T& val) {
-        if (n < Threshold) {
-            if (_vector.size() <= n) {
-              if (val.get() == nullptr) {
+        size_t leafIdx = n >> LeafBits;
+        if (val.get() == nullptr) {
+            const Leaf *found = findLeaf(leafIdx);
+            if (!found || found->slots[n & (LeafSize - 1)].get() == nullptr)
                 return;
-              }
-              // make sure the access will be valid
-              _vector.resize(n + 1);
+            std::unique_ptr<Leaf> &leaf = getLeafSlot(leafIdx);
+            leaf->slots[n & (LeafSize - 1)] = val;
+            --_count;
+            if (--leaf->count == 0) {
+                if (leafIdx < MaxDirectLeaves)
+                    leaf.reset();
+                else
+                    _farLeaves.erase(leafIdx);
             }
+            return;
+        }
 
-            assert(_vector.size() > n);
-            _vector[n] = val;
-        } else {
-            if (val.get() == nullptr) {
-                _map.erase(n);
-            } else
-                _map[n] = val;
+        std::unique_ptr<Leaf> &leaf = getLeafSlot(leafIdx);
+        if (!leaf)
+            leaf.reset(new Leaf());
+        T &slot = leaf->slots[n & (LeafSize - 1)];
+        if (slot.get() == nullptr) {
+            ++leaf->count;
+            ++_count;
         }
+        slot = val;
     }
 
     void clear() {
-        _vector.clear();
-        _map.clear();
+        _leaves.clear();
+        _farLeaves.clear();
+        _count = 0;
     }
 
     bool has(size_t n) const {
-        return (_vector.size() > n && _vector[n].get())
-               || (_map.find(n) != _map.end());
+        const Leaf *leaf = findLeaf(n >> LeafBits);
+        return leaf && leaf->slots[n & (LeafSize - 1)].get() != nullptr;
+    }
+
+    /// Number of stored elements
+    size_t size() const { return _count; }
+    /// Bytes of the leaves holding the elements, not counting what the
+    /// elements point to.
+    size_t getAllocatedBytes() const {
+        size_t leaves = _farLeaves.size();
+        for (const auto &l : _leaves)
+            leaves += l != nullptr;
+        return leaves * sizeof(Leaf) + _leaves.capacity() * sizeof(_leaves[0]);
+    }
+    bool empty() const { return _count == 0; }
+
+    /// Call f(index, value) for every stored element. Elements below
+    /// Threshold are visited in ascending order of their index.
+    template <typename F>
+    void forEach(F f) const {
+        for (size_t l = 0; l < _leaves.size(); ++l) {
+            if (!_leaves[l])
+                continue;
+            for (size_t i = 0; i < LeafSize; ++i)
+                if (_leaves[l]->slots[i].get() != nullptr)
+                    f((l << LeafBits) + i, _leaves[l]->slots[i]);
+        }
+        for (const auto &l : _farLeaves)
+            for (size_t i = 0; i < LeafSize; ++i)
+                if (l.second->slots[i].get() != nullptr)
+                    f((l.first << LeafBits) + i, l.second->slots[i]);
     }
 };
 
 class ObjectStatePlane {
 private:
   friend class AddressSpace;
-  friend class ref<ObjectState>;
+  friend class ObjectState;
+  friend class ref<ObjectStatePlane>;
+  friend class ref<const ObjectStatePlane>;
 
   /// @brief Required by klee::ref-managed objects
-  class ReferenceCounter _refCount;
+  mutable class ReferenceCounter _refCount;
 
-  ref<const ObjectState> parent;
+  /// The object this plane belongs to. A plane may be shared by several
+  /// ObjectStates, all of which are bound to this object and keep it alive.
+  const MemoryObject *object;
 
-  /// @brief Holds all known concrete bytes
-  std::vector<uint8_t> concreteStore;
+  /// @brief Holds all known concrete bytes. Large objects keep them in
+  /// pages shared copy-on-write with copies of this plane.
+  PagedVector<uint8_t> concreteStore;
 
   /// @brief concreteMask[byte] is set if byte is known to be concrete
   BitArray concreteMask;
@@ -306,6 +413,11 @@ private:
   /// mutable because may need flushed during read of const
   mutable BitArray unflushedMask;
 
+  /// The bits of unflushedMask set since the last flush lie in
+  /// [unflushedBegin, unflushedEnd), empty if unflushedBegin >= unflushedEnd.
+  /// The bytes past unflushedMask are not included.
+  mutable unsigned unflushedBegin = 0, unflushedEnd = 0;
+
   // mutable because we may need flush during read of const
   mutable UpdateList updates;
 
@@ -317,19 +429,32 @@ public:
 
   uint8_t initialValue;
 
+private:
+  /// The size of updates after the last attempt to fold its concrete
+  /// writes, see getUpdates.
+  mutable unsigned compactedSize = 0;
+
+  /// The xor of the fingerprints of the concrete and known symbolic bytes,
+  /// kept up to date while fingerprints are tracked (see StateFingerprint.h)
+  uint64_t bytesFingerprint = 0;
+
 public:
   /// Create a new object state for the given memory object with concrete
   /// contents. The initial contents are undefined, it is the callers
   /// responsibility to initialize the object contents appropriately.
-  ObjectStatePlane(const ObjectState *parent);
+  ObjectStatePlane(const MemoryObject *mo);
 
   /// Create a new object state for the given memory object with symbolic
   /// contents.
-  ObjectStatePlane(const ObjectState *parent, const Array *array);
+  ObjectStatePlane(const MemoryObject *mo, const Array *array);
 
-  ObjectStatePlane(const ObjectState *parent, const ObjectStatePlane &os);
+  ObjectStatePlane(const MemoryObject *mo, const ObjectStatePlane &os);
   ~ObjectStatePlane() = default;
 
+  /// Allocated from a pool of the MemoryManager, see MemoryManager::getPool
+  static void *operator new(size_t size);
+  static void operator delete(void *p, size_t size);
+
   /// Make contents all concrete and zero
   void initializeToZero();
 
@@ -347,30 +472,95 @@ public:
   void write16(unsigned offset, uint16_t value);
   void write32(unsigned offset, uint32_t value);
   void write64(unsigned offset, uint64_t value);
+
+  /// Copy the size bytes at srcOffset of src to offset. Concrete bytes are
+  /// copied in bulk and symbolic ones by reference. src may be this plane,
+  /// the ranges may overlap.
+  void copy(unsigned offset, const ObjectStatePlane &src, unsigned srcOffset,
+            unsigned size);
+  /// Set the size bytes at offset to value.
+  void fill(unsigned offset, unsigned size, uint8_t value);
+  /// Read the size bytes at offset into bytes.
+  /// \return false if any of them is not concrete
+  bool readConcrete(unsigned offset, unsigned size, uint8_t *bytes) const;
+  /// Read the bytes at offset into bytes, at most size of them and up to
+  /// the first that is not concrete. \return the number of bytes read
+  unsigned readConcretePrefix(unsigned offset, unsigned size,
+                              uint8_t *bytes) const;
+  /// Append to offsets the offsets of the words of wordSize bytes, aligned
+  /// to it, that are not known to be zero.
+  void findNonZeroWords(unsigned wordSize,
+                        std::vector<unsigned> &offsets) const;
+
   void print() const;
 
+  /// A hash of the contents, which does not change across reads of
+  /// concrete bytes but may change across other reads.
+  uint64_t getFingerprint() const;
+
+  /// An estimate of the bytes of this plane, not counting expressions, with
+  /// pages shared with copies of it counting for their share.
+  size_t getFootprint() const;
+
+  /// Recompute the fingerprint after changes to the concrete store that did
+  /// not go through the write methods.
+  void updateFingerprint();
+
   /*
     Looks at all the symbolic bytes of this object, gets a value for them
-    from the solver and puts them in the concreteStore.
+    from the solver and puts them in the concreteStore. The values are
+    taken from model, which is computed on first use and can be shared by
+    the objects passed to the same external call.
   */
   void flushToConcreteStore(TimingSolver *solver,
-                            const ExecutionState &state);
+                            const ExecutionState &state,
+                            std::shared_ptr<const Assignment> &model);
+
+  /// Whether any byte is known to be symbolic, see flushToConcreteStore
+  bool hasKnownSymbolics() const { return !knownSymbolics.empty(); }
 
 private:
+  ArrayCache *getArrayCache() const;
+
+  /// Move the concrete store into pages if the object is larger than
+  /// --paged-object-threshold but the store is not paged, as happens to
+  /// buffers grown by realloc.
+  void pageConcreteStore();
+
   const UpdateList &getUpdates() const;
 
+  /// Replace updates by a new constant array holding the contents of its
+  /// root, or zeros if it has none, with the oldest concrete writes applied,
+  /// followed by the remaining writes.
+  /// \return the number of writes folded into the array
+  unsigned foldConcreteWrites() const;
+  /// A new constant array with the given contents, sizeBound bytes of
+  /// unspecified contents if there are none.
+  const Array *
+  createConstantArray(const std::vector<ref<ConstantExpr>> &contents) const;
+
   void makeConcrete();
 
   ref<Expr> read8(ref<Expr> offset) const;
   void write8(unsigned offset, ref<Expr> value);
   void write8(ref<Expr> offset, ref<Expr> value);
 
+  /// Write the size concrete bytes to offset.
+  void writeConcrete(unsigned offset, unsigned size, const uint8_t *bytes);
+  /// Write the NumBytes low bytes of value to offset, in target byte order.
+  void writeConcreteValue(unsigned offset, uint64_t value, unsigned NumBytes);
+
   void flushForRead() const;
   void flushForWrite();
 
   /// isByteConcrete ==> !isByteKnownSymbolic
   bool isByteConcrete(unsigned offset) const;
 
+  /// Whether the size bytes at offset are all concrete.
+  bool isRangeConcrete(unsigned offset, unsigned size) const;
+  /// The first byte in [offset, end) that is not concrete, or end.
+  unsigned findFirstNonConcrete(unsigned offset, unsigned end) const;
+
   /// isByteKnownSymbolic ==> !isByteConcrete
   bool isByteKnownSymbolic(unsigned offset) const;
 
@@ -379,10 +569,73 @@ private:
 
   void markByteConcrete(unsigned offset);
   void markByteSymbolic(unsigned offset);
-  void markByteFlushed(unsigned offset) const;
   void markByteUnflushed(unsigned offset) const;
+  void markRangeConcrete(unsigned offset, unsigned size);
+  void markRangeUnflushed(unsigned offset, unsigned size) const;
+  /// Record that the bits of unflushedMask in [begin, end) have been set.
+  void noteUnflushed(unsigned begin, unsigned end) const;
+  /// Append the unflushed byte at offset to updates.
+  void flushByte(unsigned offset) const;
   void setKnownSymbolic(unsigned offset, Expr *value);
   uint8_t getConcreteValue(unsigned offset) const;
+
+  /// The term of a byte in bytesFingerprint. Bytes that are neither concrete
+  /// nor known symbolic are part of the fingerprint of updates instead.
+  uint64_t getByteFingerprint(unsigned offset) const;
+};
+
+/// Segment plane of an object whose segments are all concrete and have been
+/// written at constant offsets, which holds for most objects that store
+/// pointers. Instead of a byte store it keeps runs of consecutive words of
+/// the same size that hold the same segment; all other bytes hold segment
+/// 0. ObjectState replaces it with a full ObjectStatePlane once a symbolic
+/// segment or a write at a symbolic offset shows up.
+class ConcreteSegmentPlane {
+private:
+  friend class ObjectState;
+  friend class ref<ConcreteSegmentPlane>;
+  friend class ref<const ConcreteSegmentPlane>;
+
+  /// @brief Required by klee::ref-managed objects
+  mutable class ReferenceCounter _refCount;
+
+  struct Run {
+    /// size of a single word in bytes
+    unsigned wordSize;
+    /// number of consecutive words
+    unsigned count;
+    uint64_t segment;
+
+    unsigned size() const { return wordSize * count; }
+  };
+
+  /// Runs keyed by their first byte, they never overlap
+  std::map<unsigned, Run> runs;
+
+  uint8_t getByte(const Run &run, unsigned byteInRun) const;
+  /// Drops all information about bytes in [begin, end), keeping bytes of
+  /// partially covered words as single-byte runs.
+  void clearRange(unsigned begin, unsigned end);
+  void insertRun(unsigned offset, const Run &run);
+
+public:
+  uint8_t read8(unsigned offset) const;
+  ref<Expr> read(unsigned offset, Expr::Width width) const;
+
+  /// Append the nonzero segments of the runs to segments.
+  void getSegments(std::vector<uint64_t> &segments) const;
+
+  /// Writes a concrete segment of at most 64 bits.
+  void write(unsigned offset, uint64_t segment, Expr::Width width);
+
+  bool empty() const { return runs.empty(); }
+
+  uint64_t getFingerprint() const;
+
+  size_t getFootprint() const;
+
+  /// Stores the contents of this plane into a (fresh, all zero) full plane.
+  void copyTo(ObjectStatePlane &plane) const;
 };
 
 class ObjectState {
@@ -404,8 +657,20 @@ public:
   bool readOnly;
 
 private:
-  ObjectStatePlane *segmentPlane;
-  ObjectStatePlane *offsetPlane;
+  /// The planes are copy-on-write: copies of an ObjectState share them
+  /// until one of the copies writes into a plane (see getWriteablePlane()).
+  ref<ObjectStatePlane> segmentPlane;
+  ref<ObjectStatePlane> offsetPlane;
+
+  /// Compact representation of the segment plane, used as long as all
+  /// segments are concrete; at most one of segmentPlane and
+  /// concreteSegmentPlane is set.
+  ref<ConcreteSegmentPlane> concreteSegmentPlane;
+
+  /// The contents of concreteSegmentPlane as a full plane, built for reads
+  /// at symbolic offsets. It is only read, and dropped whenever
+  /// concreteSegmentPlane changes.
+  mutable ref<ObjectStatePlane> segmentReadPlane;
 
 public:
   /// Create a new object state for the given memory object with concrete
@@ -418,12 +683,29 @@ public:
   ObjectState(const MemoryObject *mo, const Array *array);
 
   ObjectState(const ObjectState &os);
-  // Copy for realloc
-  ObjectState(const ObjectState &os, const MemoryObject *mo);
-  ~ObjectState();
+  /// Copy for realloc. If exclusive, no other address space shares os,
+  /// which is unbound afterwards, and the planes only os holds are moved to
+  /// mo instead of being copied.
+  ObjectState(const ObjectState &os, const MemoryObject *mo, bool exclusive);
+  ~ObjectState() = default;
+
+  /// Allocated from a pool of the MemoryManager, see MemoryManager::getPool
+  static void *operator new(size_t size);
+  static void operator delete(void *p, size_t size);
 
   const MemoryObject *getObject() const { return object.get(); }
 
+  /// Whether any byte of the object may hold a nonzero segment
+  bool hasSegmentPlane() const { return segmentPlane || concreteSegmentPlane; }
+
+  /// Whether the object holds the contents of other because the two share
+  /// their planes, as copies of an object do until they are written
+  bool sharesContentsWith(const ObjectState &other) const {
+    return offsetPlane.get() == other.offsetPlane.get() &&
+           segmentPlane.get() == other.segmentPlane.get() &&
+           concreteSegmentPlane.get() == other.concreteSegmentPlane.get();
+  }
+
   void setReadOnly(bool ro) {
     readOnly = ro;
   }
@@ -438,9 +720,15 @@ public:
   // make contents all concrete and random
   void initializeToRandom();
 
+  /// Whether flushToConcreteStore has any symbolic bytes to concretize
+  bool hasKnownSymbolics() const { return offsetPlane->hasKnownSymbolics(); }
+
+  /// The concrete values are those of state, so the offset plane is made
+  /// this object's own first.
   void flushToConcreteStore(TimingSolver *solver,
-                            const ExecutionState &state) const {
-    offsetPlane->flushToConcreteStore(solver, state);
+                            const ExecutionState &state,
+                            std::shared_ptr<const Assignment> &model) {
+    getWriteablePlane(offsetPlane)->flushToConcreteStore(solver, state, model);
   }
 
   KValue read(ref<Expr> offset, Expr::Width width) const;
@@ -456,11 +744,62 @@ public:
   void write32(unsigned offset, uint32_t segment, uint32_t value);
   void write64(unsigned offset, uint64_t segment, uint64_t value);
 
+  /// Copy the size bytes at srcOffset of src to offset, as memmove does. src
+  /// may be this object.
+  void copy(unsigned offset, const ObjectState &src, unsigned srcOffset,
+            unsigned size);
+  /// Set the size bytes at offset to the 8-bit value, as memset does.
+  void fill(unsigned offset, unsigned size, ref<Expr> value);
+  /// Set the size bytes at offset to the given concrete non-pointer bytes.
+  void writeConcrete(unsigned offset, unsigned size, const uint8_t *bytes);
+  /// Read the size bytes at offset into bytes.
+  /// \return false if any of them is symbolic or may be part of a pointer
+  bool readConcrete(unsigned offset, unsigned size, uint8_t *bytes) const;
+  /// Read the bytes at offset into bytes, at most size of them and up to
+  /// the first that is symbolic or may be part of a pointer.
+  /// \return the number of bytes read
+  unsigned readConcretePrefix(unsigned offset, unsigned size,
+                              uint8_t *bytes) const;
+
+  /// Collect the segments of the pointers the object may hold, from its
+  /// segment plane alone: the concrete nonzero ones into segments, the
+  /// symbolic ones into symbolic. Pointers are read at offsets aligned to
+  /// their size, wherever they were stored as pointers or integers.
+  void getStoredSegments(std::vector<uint64_t> &segments,
+                         std::vector<ref<Expr>> &symbolic) const;
+
   ArrayCache *getArrayCache() const;
 
+  /// A hash of the contents of the object, see --revisited-loop-heads
+  uint64_t getFingerprint() const;
+
+  /// An estimate of the bytes of this object state, with the planes it
+  /// shares with copies of it counting for their share.
+  size_t getFootprint() const;
+
 private:
-  bool prepareSegmentPlane(bool nonzero);
-  bool prepareSegmentPlane(ref<Expr> value);
+  /// The plane of the object reallocated to mo for the given plane of the
+  /// original, see ObjectState(const ObjectState &, const MemoryObject *,
+  /// bool).
+  static ref<ObjectStatePlane>
+  reallocatePlane(const ref<ObjectStatePlane> &plane, const MemoryObject *mo,
+                  bool exclusive);
+
+  /// Returns a plane that is owned only by this ObjectState, copying the
+  /// given (possibly shared) plane first if necessary.
+  ObjectStatePlane *getWriteablePlane(ref<ObjectStatePlane> &plane);
+
+  /// Returns a writeable full segment plane, converting the compact one
+  /// if necessary.
+  ObjectStatePlane *getFullSegmentPlane();
+
+  /// Writes a concrete segment without a full segment plane. Returns false
+  /// if the segment plane has to be written through getFullSegmentPlane().
+  bool writeConcreteSegment(unsigned offset, uint64_t segment,
+                            Expr::Width width);
+  /// Clears the segments of the size bytes at offset.
+  void clearSegments(unsigned offset, unsigned size);
+  void writeSegment(unsigned offset, const KValue &value);
 };
   
 } // End klee namespace
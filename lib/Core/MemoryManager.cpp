@@ -56,6 +56,13 @@ llvm::cl::opt<unsigned long long> DeterministicStartAddress(
     llvm::cl::desc("Start address for deterministic allocation. Has to be page "
                    "aligned (default=0x7ff30000000)"),
     llvm::cl::init(0x7ff30000000), llvm::cl::cat(MemoryCat));
+
+llvm::cl::opt<unsigned> QuarantineSize(
+    "allocate-quarantine-size",
+    llvm::cl::desc("Amount of freed concrete memory in KiB that is not reused, "
+                   "so that uses after free keep pointing to unused memory "
+                   "(default=1024)"),
+    llvm::cl::init(1024), llvm::cl::cat(MemoryCat));
 } // namespace
 
 MmapAllocation::MmapAllocation(size_t spacesize, void *expectedAddr, int flgs)
@@ -147,8 +154,10 @@ void *AllocatorMap::allocate(size_t size, size_t alignment) {
 MemoryAllocator::MemoryAllocator(bool determ,
                                  bool lowmem,
                                  size_t determ_size,
-                                 void *expectedAddr)
-  : deterministic(determ), lowmemAllocator(MAP_32BIT) {
+                                 void *expectedAddr,
+                                 size_t quarantineLimit)
+  : deterministic(determ), lowmemAllocator(MAP_32BIT),
+    quarantineLimit(quarantineLimit) {
   if (deterministic) {
       klee_message("Allocating memory deterministically");
       deterministicMem.initialize(determ_size, expectedAddr);
@@ -159,9 +168,36 @@ MemoryAllocator::MemoryAllocator(bool determ,
   }
 }
 
+MemoryAllocator::~MemoryAllocator() {
+  for (const auto &allocation : quarantine)
+    release(allocation.first, allocation.second);
+}
+
+void *MemoryAllocator::allocateFromFreeList(size_t size, size_t alignment) {
+  auto it = freeLists.find(size);
+  if (it == freeLists.end())
+    return nullptr;
+  auto &blocks = it->second;
+  // take the most recently released block to stay deterministic
+  for (auto b = blocks.rbegin(); b != blocks.rend(); ++b) {
+    if ((uint64_t)*b % alignment)
+      continue;
+    void *address = *b;
+    blocks.erase(std::next(b).base());
+    if (blocks.empty())
+      freeLists.erase(it);
+    return address;
+  }
+  return nullptr;
+}
+
 void *MemoryAllocator::allocate(size_t size, size_t alignment) {
   if (deterministic) {
-    auto address = deterministicMem.allocate(size + RedzoneSize, alignment);
+    if (void *address = allocateFromFreeList(size + RedzoneSize, alignment))
+      return address;
+    void *address = nullptr;
+    if (deterministicMem.hasSpace(size + RedzoneSize, alignment))
+      address = deterministicMem.allocate(size + RedzoneSize, alignment);
     if (!address) {
       klee_warning_once(0, "Couldn't allocate %" PRIu64
                            " bytes. Not enough deterministic space left.",
@@ -169,6 +205,8 @@ void *MemoryAllocator::allocate(size_t size, size_t alignment) {
     }
     return address;
   } else if (lowmem) {
+    if (void *address = allocateFromFreeList(size, alignment))
+      return address;
     return lowmemAllocator.allocate(size, alignment);
   } else {
     // Use malloc for the standard case
@@ -187,9 +225,25 @@ void *MemoryAllocator::allocate(size_t size, size_t alignment) {
   }
 }
 
-void MemoryAllocator::deallocate(void *mem) {
-  // deterministic memory will be munmap'ed
-  if (!deterministic && !lowmem)
+void MemoryAllocator::deallocate(void *mem, size_t size) {
+  if (deterministic)
+    size += RedzoneSize;
+  quarantine.emplace_back(mem, size);
+  quarantinedSize += size;
+  while (quarantinedSize > quarantineLimit) {
+    auto oldest = quarantine.front();
+    quarantine.pop_front();
+    quarantinedSize -= oldest.second;
+    release(oldest.first, oldest.second);
+  }
+}
+
+void MemoryAllocator::release(void *mem, size_t size) {
+  // deterministic and low memory will be munmap'ed, but can be reused
+  // until then
+  if (deterministic || lowmem)
+    freeLists[size].push_back(mem);
+  else
     free(mem);
 }
 
@@ -224,15 +278,44 @@ MemoryManager::MemoryManager(ArrayCache *_arrayCache, unsigned pointerWidth)
       allocator(DeterministicAllocation,
                 pointerWidth == 32,
                 DeterministicAllocationSize.getValue() * 1024 * 1024,
-                (void *)DeterministicStartAddress.getValue()),
+                (void *)DeterministicStartAddress.getValue(),
+                QuarantineSize.getValue() * 1024),
       lastSegment(FIRST_ORDINARY_SEGMENT) {}
 
 MemoryManager::~MemoryManager() {
-  while (!objects.empty()) {
-    MemoryObject *mo = *objects.begin();
-    objects.erase(mo);
+  while (objects) {
+    MemoryObject *mo = objects;
+    unregisterObject(mo);
     delete mo;
   }
+  getPool(MemoryObjectPool).releaseIfUnused();
+  getPool(ObjectStatePool).releaseIfUnused();
+  getPool(ObjectStatePlanePool).releaseIfUnused();
+}
+
+FixedSizePool &MemoryManager::getPool(PoolKind kind) {
+  // never destroyed, pooled objects may still be freed during shutdown
+  static FixedSizePool *const pools[] = {
+      new FixedSizePool(sizeof(MemoryObject), 64 * 1024,
+                        &memory::objectStates),
+      new FixedSizePool(sizeof(ObjectState), 64 * 1024,
+                        &memory::objectStates),
+      new FixedSizePool(sizeof(ObjectStatePlane), 64 * 1024,
+                        &memory::objectStates),
+  };
+  return *pools[kind];
+}
+
+size_t MemoryManager::getPooledObjectCount() {
+  return getPool(MemoryObjectPool).getLiveCount() +
+         getPool(ObjectStatePool).getLiveCount() +
+         getPool(ObjectStatePlanePool).getLiveCount();
+}
+
+size_t MemoryManager::getPoolReservedSize() {
+  return getPool(MemoryObjectPool).getReservedSize() +
+         getPool(ObjectStatePool).getReservedSize() +
+         getPool(ObjectStatePlanePool).getReservedSize();
 }
 
 MemoryObject *MemoryManager::allocate(uint64_t size, bool isLocal,
@@ -283,7 +366,7 @@ MemoryObject *MemoryManager::allocate(ref<Expr> size, bool isLocal,
   MemoryObject *res = new MemoryObject(++lastSegment,
                                        size, concreteSize,
                                        isLocal, isGlobal, false, allocSite, this);
-  objects.insert(res);
+  registerObject(res);
   return res;
 }
 
@@ -303,14 +386,48 @@ MemoryObject *MemoryManager::allocateFixed(uint64_t size,
         new MemoryObject(specialSegment, sizeExpr, size,
                          false, true, true, allocSite, this);
   }
-  objects.insert(res);
+  registerObject(res);
   return res;
 }
 
 void MemoryManager::deallocate(const MemoryObject *mo) { assert(0); }
 
+void MemoryManager::registerObject(MemoryObject *mo) {
+  mo->prevObject = nullptr;
+  mo->nextObject = objects;
+  if (objects)
+    objects->prevObject = mo;
+  objects = mo;
+}
+
+void MemoryManager::unregisterObject(MemoryObject *mo) {
+  if (mo->prevObject)
+    mo->prevObject->nextObject = mo->nextObject;
+  else if (objects == mo)
+    objects = mo->nextObject;
+  else
+    return; // not registered
+  if (mo->nextObject)
+    mo->nextObject->prevObject = mo->prevObject;
+  mo->prevObject = mo->nextObject = nullptr;
+}
+
 void MemoryManager::markFreed(MemoryObject *mo) {
-  objects.erase(mo);
+  unregisterObject(mo);
+  auto it = concreteMemory.find(mo);
+  if (it != concreteMemory.end()) {
+    for (const auto &allocation : it->second)
+      allocator.deallocate(allocation.first, allocation.second);
+    concreteMemory.erase(it);
+  }
+}
+
+void *MemoryManager::allocateMemory(const MemoryObject *mo, size_t size,
+                                    size_t alignment) {
+  void *address = allocator.allocate(size, alignment);
+  if (address)
+    concreteMemory[mo].emplace_back(address, size);
+  return address;
 }
 
 size_t MemoryManager::getUsedDeterministicSize() const {
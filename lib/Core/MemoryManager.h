@@ -10,10 +10,12 @@
 #ifndef KLEE_MEMORYMANAGER_H
 #define KLEE_MEMORYMANAGER_H
 
+#include "klee/ADT/FixedSizePool.h"
 #include "klee/Expr/Expr.h"
 
 #include <cstddef>
-#include <set>
+#include <deque>
+#include <map>
 #include <unordered_map>
 #include <vector>
 #include <cstdint>
@@ -84,11 +86,25 @@ class MemoryAllocator {
 
     MmapAllocation deterministicMem{};
     AllocatorMap lowmemAllocator;
+
+    // freed memory and its size, which is not reused before it leaves the
+    // quarantine, to keep detecting uses after free
+    std::deque<std::pair<void *, size_t>> quarantine;
+    size_t quarantinedSize{0};
+    size_t quarantineLimit{0};
+
+    // freed deterministic or low memory, by size
+    std::map<size_t, std::vector<void *>> freeLists;
+
+    void *allocateFromFreeList(size_t size, size_t alignment);
+    void release(void *mem, size_t size);
 public:
-    MemoryAllocator(bool determ, bool lowmem, size_t determ_size, void *expectedAddr);
+    MemoryAllocator(bool determ, bool lowmem, size_t determ_size,
+                    void *expectedAddr, size_t quarantineLimit = 0);
+    ~MemoryAllocator();
 
     void *allocate(size_t size, size_t alignment);
-    void deallocate(void *);
+    void deallocate(void *mem, size_t size);
     void useLowMemory(bool lm);
 
     size_t getUsedDeterministicSize() const {
@@ -98,12 +114,20 @@ public:
 
 class MemoryManager {
 private:
-  typedef std::set<MemoryObject *> objects_ty;
-  objects_ty objects;
+  // intrusive list of all live memory objects
+  MemoryObject *objects{nullptr};
   ArrayCache *const arrayCache;
 
   MemoryAllocator allocator;
   uint64_t lastSegment;
+
+  void registerObject(MemoryObject *mo);
+  void unregisterObject(MemoryObject *mo);
+
+  // memory allocated for the concrete representation of memory objects
+  std::unordered_map<const MemoryObject *,
+                     std::vector<std::pair<void *, size_t>>>
+      concreteMemory;
 public:
   MemoryManager(ArrayCache *arrayCache,
                 unsigned pointerWidth = 64);
@@ -133,9 +157,21 @@ public:
    */
   size_t getUsedDeterministicSize() const;
 
-  void *allocateMemory(size_t size, size_t alignment) {
-    return allocator.allocate(size, alignment);
-  }
+  /// Allocates memory for the concrete representation of mo, which is
+  /// released once mo is freed.
+  void *allocateMemory(const MemoryObject *mo, size_t size, size_t alignment);
+
+  /// Pools for the objects allocated in large numbers while states fork.
+  /// They are shared by all memory managers, as object states may outlive
+  /// the manager of their memory objects.
+  enum PoolKind { MemoryObjectPool, ObjectStatePool, ObjectStatePlanePool };
+  static FixedSizePool &getPool(PoolKind kind);
+
+  /// Returns the number of pooled objects that are in use
+  static size_t getPooledObjectCount();
+
+  /// Returns the size reserved by the pools in bytes
+  static size_t getPoolReservedSize();
 };
 
 } // End klee namespace
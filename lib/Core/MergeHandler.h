@@ -82,6 +82,8 @@ class Instruction;
 }
 
 namespace klee {
+extern llvm::cl::OptionCategory MergeCat;
+
 extern llvm::cl::opt<bool> UseMerge;
 
 extern llvm::cl::opt<bool> DebugLogMerge;
@@ -0,0 +1,143 @@
+//===-- MetricsServer.cpp -------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "MetricsServer.h"
+
+#include "klee/Support/ErrorHandling.h"
+
+#include "llvm/Support/Errno.h"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace klee;
+
+namespace {
+/// How long a client may take to send its request, in milliseconds.
+const int RequestTimeout = 1000;
+} // namespace
+
+std::unique_ptr<MetricsServer> MetricsServer::create(const std::string &path) {
+  sockaddr_un addr;
+  std::memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(addr.sun_path)) {
+    klee_warning("metrics socket path too long: %s", path.c_str());
+    return nullptr;
+  }
+  std::strcpy(addr.sun_path, path.c_str());
+
+  // a socket left behind by an earlier run, but nothing else, is replaced
+  struct stat st;
+  if (lstat(path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode))
+    unlink(path.c_str());
+
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0 || bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) ||
+      listen(fd, 16)) {
+    klee_warning("unable to listen on metrics socket %s - %s", path.c_str(),
+                 llvm::sys::StrError(errno).c_str());
+    if (fd >= 0)
+      close(fd);
+    return nullptr;
+  }
+
+  int stopFds[2];
+  if (pipe2(stopFds, O_CLOEXEC) < 0) {
+    klee_warning("pipe failed (for the metrics socket) - %s",
+                 llvm::sys::StrError(errno).c_str());
+    close(fd);
+    unlink(path.c_str());
+    return nullptr;
+  }
+  return std::unique_ptr<MetricsServer>(new MetricsServer(path, fd, stopFds));
+}
+
+MetricsServer::MetricsServer(std::string path, int listenFd,
+                             const int stopFds[2])
+    : path(std::move(path)), listenFd(listenFd),
+      stopFds{stopFds[0], stopFds[1]}, thread([this] { run(); }) {}
+
+MetricsServer::~MetricsServer() {
+  char c = 0;
+  while (write(stopFds[1], &c, 1) < 0 && errno == EINTR)
+    ;
+  thread.join();
+  close(stopFds[0]);
+  close(stopFds[1]);
+  close(listenFd);
+  unlink(path.c_str());
+}
+
+void MetricsServer::update(std::string newMetrics) {
+  std::lock_guard<std::mutex> lock(mutex);
+  metrics.swap(newMetrics);
+}
+
+void MetricsServer::run() {
+  pollfd fds[2] = {{listenFd, POLLIN, 0}, {stopFds[0], POLLIN, 0}};
+  for (;;) {
+    if (poll(fds, 2, -1) < 0) {
+      if (errno == EINTR)
+        continue;
+      return;
+    }
+    if (fds[1].revents)
+      return;
+    if (!(fds[0].revents & POLLIN))
+      continue;
+    int fd = accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+    if (fd < 0)
+      continue;
+    answer(fd);
+    close(fd);
+  }
+}
+
+void MetricsServer::answer(int fd) {
+  // the request is read up to its empty line, its contents do not matter
+  std::string request;
+  char buffer[512];
+  while (request.find("\r\n\r\n") == std::string::npos &&
+         request.find("\n\n") == std::string::npos && request.size() < 8192) {
+    pollfd pfd = {fd, POLLIN, 0};
+    if (poll(&pfd, 1, RequestTimeout) <= 0)
+      break;
+    ssize_t n = read(fd, buffer, sizeof(buffer));
+    if (n <= 0)
+      break;
+    request.append(buffer, n);
+  }
+
+  std::string response;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    response = "HTTP/1.0 200 OK\r\n"
+               "Content-Type: text/plain; version=0.0.4\r\n"
+               "Content-Length: " +
+               std::to_string(metrics.size()) + "\r\n\r\n" + metrics;
+  }
+  const char *p = response.data();
+  size_t left = response.size();
+  while (left) {
+    ssize_t n = send(fd, p, left, MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return;
+    p += n;
+    left -= n;
+  }
+}
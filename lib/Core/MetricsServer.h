@@ -0,0 +1,50 @@
+//===-- MetricsServer.h -----------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_METRICSSERVER_H
+#define KLEE_METRICSSERVER_H
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace klee {
+
+/// MetricsServer - Answers HTTP requests on a Unix socket with the latest
+/// metrics, in the text format of Prometheus, from a thread of its own (see
+/// --metrics-socket). The metrics are formatted by the interpreter thread,
+/// which owns the statistics, and handed over with update.
+class MetricsServer {
+  std::string path;
+  int listenFd;
+  /// Written to stop the thread.
+  int stopFds[2];
+  std::mutex mutex;
+  std::string metrics;
+  std::thread thread;
+
+  MetricsServer(std::string path, int listenFd, const int stopFds[2]);
+  void run();
+  void answer(int fd);
+
+public:
+  /// Listen on a new socket at path. \return null if that fails
+  static std::unique_ptr<MetricsServer> create(const std::string &path);
+  ~MetricsServer();
+
+  MetricsServer(const MetricsServer &) = delete;
+  MetricsServer &operator=(const MetricsServer &) = delete;
+
+  void update(std::string newMetrics);
+};
+
+} // namespace klee
+
+#endif /* KLEE_METRICSSERVER_H */
@@ -15,6 +15,10 @@
 #include "klee/Expr/ExprPPrinter.h"
 #include "klee/Support/OptionCategories.h"
 
+#include "llvm/Support/Endian.h"
+#include "llvm/Support/EndianStream.h"
+
+#include <algorithm>
 #include <bitset>
 #include <vector>
 
@@ -29,11 +33,109 @@ cl::opt<bool>
                                  "tree whenever possible (default=false)"),
                         cl::init(false), cl::cat(MiscCat));
 
+/// Starts a log, followed by a format version byte.
+const char LogMagic[4] = {'K', 'P', 'T', 'L'};
+const std::uint8_t LogVersion = 1;
+
+std::uint64_t getLogId(const PTreeNode *node) {
+  return reinterpret_cast<std::uintptr_t>(node);
+}
+
 } // namespace
 
-PTree::PTree(ExecutionState *initialState)
-    : root(PTreeNodePtr(new PTreeNode(nullptr, initialState))) {
+PTree::PTree(ExecutionState *initialState,
+             std::unique_ptr<llvm::raw_ostream> log)
+    : log(std::move(log)),
+      root(PTreeNodePtr(createNode(nullptr, initialState))) {
   initialState->ptreeNode = root.getPointer();
+  if (this->log) {
+    this->log->write(LogMagic, sizeof(LogMagic));
+    *this->log << static_cast<char>(LogVersion);
+    PTreeLogRecord record;
+    record.kind = PTreeLogRecord::Root;
+    record.node = getLogId(root.getPointer());
+    record.leftState = initialState->getID();
+    writeRecord(record);
+  }
+}
+
+PTreeNode *PTree::createNode(PTreeNode *parent, ExecutionState *state) {
+  return new (nodePool.allocate()) PTreeNode(parent, state);
+}
+
+void PTree::destroyNode(PTreeNode *node) {
+  node->~PTreeNode();
+  nodePool.deallocate(node);
+}
+
+void PTree::writeRecord(const PTreeLogRecord &record) {
+  using namespace llvm::support;
+  endian::Writer w(*log, little);
+  w.write<std::uint8_t>(record.kind);
+  w.write<std::uint64_t>(record.node);
+  switch (record.kind) {
+  case PTreeLogRecord::Root:
+    w.write<std::uint32_t>(record.leftState);
+    break;
+  case PTreeLogRecord::Attach:
+    w.write<std::uint64_t>(record.left);
+    w.write<std::uint64_t>(record.right);
+    w.write<std::uint32_t>(record.leftState);
+    w.write<std::uint32_t>(record.rightState);
+    w.write<std::uint8_t>(static_cast<std::uint8_t>(record.reason));
+    break;
+  case PTreeLogRecord::Remove:
+  case PTreeLogRecord::Compress:
+    break;
+  }
+}
+
+bool PTree::readLog(StringRef data,
+                    const std::function<void(const PTreeLogRecord &)> &f) {
+  using namespace llvm::support;
+  if (data.size() < sizeof(LogMagic) + 1 ||
+      !data.startswith(StringRef(LogMagic, sizeof(LogMagic))) ||
+      static_cast<std::uint8_t>(data[sizeof(LogMagic)]) != LogVersion)
+    return false;
+
+  const char *p = data.data() + sizeof(LogMagic) + 1;
+  const char *end = data.data() + data.size();
+  auto read = [&](auto &value) {
+    using T = typename std::remove_reference<decltype(value)>::type;
+    if (static_cast<std::size_t>(end - p) < sizeof(T))
+      return false;
+    value = endian::readNext<T, little, unaligned>(p);
+    return true;
+  };
+
+  while (p != end) {
+    PTreeLogRecord record;
+    std::uint8_t kind;
+    if (!read(kind) || !read(record.node))
+      return false;
+    record.kind = static_cast<PTreeLogRecord::Kind>(kind);
+    switch (record.kind) {
+    case PTreeLogRecord::Root:
+      if (!read(record.leftState))
+        return false;
+      break;
+    case PTreeLogRecord::Attach: {
+      std::uint8_t reason;
+      if (!read(record.left) || !read(record.right) ||
+          !read(record.leftState) || !read(record.rightState) || !read(reason))
+        return false;
+      record.reason = static_cast<BranchType>(reason);
+      break;
+    }
+    case PTreeLogRecord::Remove:
+    case PTreeLogRecord::Compress:
+      break;
+    default:
+      return false;
+    }
+    f(record);
+  }
+  return true;
 }
 
 void PTree::attach(PTreeNode *node, ExecutionState *leftState,
@@ -42,14 +144,26 @@ void PTree::attach(PTreeNode *node, ExecutionState *leftState,
   assert(node == rightState->ptreeNode &&
          "Attach assumes the right state is the current state");
   node->state = nullptr;
-  node->left = PTreeNodePtr(new PTreeNode(node, leftState));
+  node->left = PTreeNodePtr(createNode(node, leftState));
   // The current node inherits the tag
-  uint8_t currentNodeTag = root.getInt();
+  std::uint64_t currentNodeTag = root.getInt();
   if (node->parent)
     currentNodeTag = node->parent->left.getPointer() == node
                          ? node->parent->left.getInt()
                          : node->parent->right.getInt();
-  node->right = PTreeNodePtr(new PTreeNode(node, rightState), currentNodeTag);
+  node->right = PTreeNodePtr(createNode(node, rightState), currentNodeTag);
+
+  if (log) {
+    PTreeLogRecord record;
+    record.kind = PTreeLogRecord::Attach;
+    record.node = getLogId(node);
+    record.left = getLogId(node->left.getPointer());
+    record.right = getLogId(node->right.getPointer());
+    record.leftState = leftState->getID();
+    record.rightState = rightState->getID();
+    record.reason = reason;
+    writeRecord(record);
+  }
 }
 
 void PTree::remove(PTreeNode *n) {
@@ -64,7 +178,13 @@ void PTree::remove(PTreeNode *n) {
         p->right = PTreeNodePtr(nullptr);
       }
     }
-    delete n;
+    if (log) {
+      PTreeLogRecord record;
+      record.kind = PTreeLogRecord::Remove;
+      record.node = getLogId(n);
+      writeRecord(record);
+    }
+    destroyNode(n);
     n = p;
   } while (n && !n->left.getPointer() && !n->right.getPointer());
 
@@ -76,6 +196,9 @@ void PTree::remove(PTreeNode *n) {
     PTreeNode *parent = n->parent;
 
     child.getPointer()->parent = parent;
+    // the child takes the branch decisions of the edge it replaces
+    child.getPointer()->path.insert(0, n->path);
+    child.getPointer()->symPath.insert(0, n->symPath);
     if (!parent) {
       // We're at the root.
       root = child;
@@ -88,10 +211,26 @@ void PTree::remove(PTreeNode *n) {
       }
     }
 
-    delete n;
+    if (log) {
+      PTreeLogRecord record;
+      record.kind = PTreeLogRecord::Compress;
+      record.node = getLogId(n);
+      writeRecord(record);
+    }
+    destroyNode(n);
   }
 }
 
+std::string PTree::getPath(const PTreeNode *node, bool symbolic) {
+  std::vector<const PTreeNode *> nodes;
+  for (; node; node = node->parent)
+    nodes.push_back(node);
+  std::string path;
+  for (auto it = nodes.rbegin(), ie = nodes.rend(); it != ie; ++it)
+    path += symbolic ? (*it)->symPath : (*it)->path;
+  return path;
+}
+
 void PTree::dump(llvm::raw_ostream &os) {
   ExprPPrinter *pp = ExprPPrinter::create(os);
   pp->setNewline("\\l");
@@ -102,6 +241,12 @@ void PTree::dump(llvm::raw_ostream &os) {
   os << "\tcenter = \"true\";\n";
   os << "\tnode [style=\"filled\",width=.1,height=.1,fontname=\"Terminus\"]\n";
   os << "\tedge [arrowsize=.3]\n";
+  // label edges with the tags of the registered searchers, at least three
+  auto label = [&](const PTreeNodePtr &p) {
+    return std::bitset<MaxRandomPathSearchers>(p.getInt())
+        .to_string()
+        .substr(MaxRandomPathSearchers - std::max(registeredIds, 3));
+  };
   std::vector<const PTreeNode*> stack;
   stack.push_back(root.getPointer());
   while (!stack.empty()) {
@@ -113,14 +258,12 @@ void PTree::dump(llvm::raw_ostream &os) {
     os << "];\n";
     if (n->left.getPointer()) {
       os << "\tn" << n << " -> n" << n->left.getPointer();
-      os << " [label=0b"
-         << std::bitset<PtrBitCount>(n->left.getInt()).to_string() << "];\n";
+      os << " [label=0b" << label(n->left) << "];\n";
       stack.push_back(n->left.getPointer());
     }
     if (n->right.getPointer()) {
       os << "\tn" << n << " -> n" << n->right.getPointer();
-      os << " [label=0b"
-         << std::bitset<PtrBitCount>(n->right.getInt()).to_string() << "];\n";
+      os << " [label=0b" << label(n->right) << "];\n";
       stack.push_back(n->right.getPointer());
     }
   }
@@ -10,10 +10,17 @@
 #ifndef KLEE_PTREE_H
 #define KLEE_PTREE_H
 
+#include "klee/ADT/FixedSizePool.h"
 #include "klee/Core/BranchTypes.h"
 #include "klee/Expr/Expr.h"
 #include "klee/Support/ErrorHandling.h"
-#include "llvm/ADT/PointerIntPair.h"
+
+#include "llvm/ADT/StringRef.h"
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
 
 namespace klee {
   class ExecutionState;
@@ -23,8 +30,19 @@ namespace klee {
   captures all  states, whereas a Random Path Searcher might only care about
   a subset. The integer part of PTreeNodePtr is a bitmask (a "tag") of which
   Random Path Searchers PTreeNode belongs to. */
-  constexpr int PtrBitCount = 3;
-  using PTreeNodePtr = llvm::PointerIntPair<PTreeNode *, PtrBitCount, uint8_t>;
+  constexpr int MaxRandomPathSearchers = 64;
+  class PTreeNodePtr {
+    PTreeNode *pointer;
+    std::uint64_t tag;
+
+  public:
+    PTreeNodePtr(PTreeNode *pointer = nullptr, std::uint64_t tag = 0)
+        : pointer(pointer), tag(tag) {}
+
+    PTreeNode *getPointer() const { return pointer; }
+    std::uint64_t getInt() const { return tag; }
+    void setInt(std::uint64_t value) { tag = value; }
+  };
 
   class PTreeNode {
   public:
@@ -34,31 +52,87 @@ namespace klee {
     PTreeNodePtr right;
     ExecutionState *state = nullptr;
 
+    /// With --paths-from-ptree, the branch decisions taken on the edge from
+    /// the parent and, while this is a leaf, by its state: all of them in
+    /// path and those that forked in symPath.
+    std::string path;
+    std::string symPath;
+
     PTreeNode(const PTreeNode&) = delete;
     PTreeNode(PTreeNode *parent, ExecutionState *state);
     ~PTreeNode() = default;
   };
 
+  /// A record of the log of a PTree, see PTree::PTree. Nodes are
+  /// identified by their addresses, which are reused once a node has been
+  /// removed; as the records are in order, an id always refers to the last
+  /// node created with it.
+  struct PTreeLogRecord {
+    enum Kind : std::uint8_t {
+      /// The root node, holding the initial state.
+      Root,
+      /// Node was split into left and right, with the states of the given
+      /// IDs, for the given reason.
+      Attach,
+      /// Node was a leaf and has been removed from its parent.
+      Remove,
+      /// Node had one child left, which has been connected to the parent of
+      /// the node in its place (see --compress-process-tree).
+      Compress,
+    };
+
+    Kind kind;
+    std::uint64_t node = 0;
+    std::uint64_t left = 0;
+    std::uint64_t right = 0;
+    /// For Root, the ID of the initial state is in leftState.
+    std::uint32_t leftState = 0;
+    std::uint32_t rightState = 0;
+    BranchType reason = BranchType::NONE;
+  };
+
   class PTree {
     // Number of registered ID
     int registeredIds = 0;
 
+    FixedSizePool nodePool{sizeof(PTreeNode), 64 * 1024,
+                           &memory::processTree};
+    std::unique_ptr<llvm::raw_ostream> log;
+
+    PTreeNode *createNode(PTreeNode *parent, ExecutionState *state);
+    void destroyNode(PTreeNode *node);
+    void writeRecord(const PTreeLogRecord &record);
+
   public:
     PTreeNodePtr root;
-    explicit PTree(ExecutionState *initialState);
+
+    /// If log is set, every change of the tree is appended to it as a
+    /// binary record, so that the tree can be rebuilt after the run (see
+    /// readLog) without keeping or dumping it whole.
+    explicit PTree(ExecutionState *initialState,
+                   std::unique_ptr<llvm::raw_ostream> log = nullptr);
     ~PTree() = default;
 
     void attach(PTreeNode *node, ExecutionState *leftState,
                 ExecutionState *rightState, BranchType reason);
     void remove(PTreeNode *node);
     void dump(llvm::raw_ostream &os);
-    std::uint8_t getNextId() {
-      std::uint8_t id = 1 << registeredIds++;
-      if (registeredIds > PtrBitCount) {
+
+    /// The branch decisions on the path from the root to node, from path
+    /// or, if symbolic is set, from symPath of the nodes.
+    static std::string getPath(const PTreeNode *node, bool symbolic);
+
+    /// Calls f for each record of a log, in order.
+    /// \return false if the log is malformed or truncated
+    static bool readLog(llvm::StringRef data,
+                        const std::function<void(const PTreeLogRecord &)> &f);
+
+    std::uint64_t getNextId() {
+      if (registeredIds == MaxRandomPathSearchers) {
         klee_error("PTree cannot support more than %d RandomPathSearchers",
-                   PtrBitCount);
+                   MaxRandomPathSearchers);
       }
-      return id;
+      return std::uint64_t(1) << registeredIds++;
     }
   };
 }
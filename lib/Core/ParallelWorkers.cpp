@@ -0,0 +1,448 @@
+//===-- ParallelWorkers.cpp -----------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "ParallelWorkers.h"
+
+#include "CoreStats.h"
+
+#include "klee/Statistics/Statistics.h"
+#include "klee/Support/ErrorHandling.h"
+
+#include "llvm/Support/Errno.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <new>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace klee;
+
+namespace {
+bool writeAll(int fd, const void *data, size_t size) {
+  auto p = static_cast<const char *>(data);
+  while (size) {
+    ssize_t n = write(fd, p, size);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    p += n;
+    size -= n;
+  }
+  return true;
+}
+
+bool readAll(int fd, void *data, size_t size) {
+  auto p = static_cast<char *>(data);
+  while (size) {
+    ssize_t n = read(fd, p, size);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    p += n;
+    size -= n;
+  }
+  return true;
+}
+
+std::vector<uint64_t> getStatisticValues() {
+  std::vector<uint64_t> values;
+  for (unsigned i = 0, e = theStatisticManager->getNumStatistics(); i != e;
+       ++i)
+    values.push_back(
+        theStatisticManager->getValue(theStatisticManager->getStatistic(i)));
+  return values;
+}
+
+/// Write the statistics and counts of this process since start.
+void writeStatistics(int fd, const std::vector<uint64_t> &startValues,
+                     const InterpreterHandler::WorkerCounts &startCounts,
+                     InterpreterHandler &handler) {
+  std::vector<uint64_t> values = getStatisticValues();
+  for (unsigned i = 0, e = values.size(); i != e; ++i)
+    values[i] -= startValues[i];
+  InterpreterHandler::WorkerCounts counts = handler.getWorkerCounts();
+  counts.pathsCompleted -= startCounts.pathsCompleted;
+  counts.pathsExplored -= startCounts.pathsExplored;
+  counts.testCases -= startCounts.testCases;
+  counts.totalTests -= startCounts.totalTests;
+
+  writeAll(fd, values.data(), values.size() * sizeof(values[0]));
+  writeAll(fd, &counts, sizeof(counts));
+}
+
+/// Add the statistics and counts written by a worker to those of this
+/// process. \return false if they could not be read
+bool readStatistics(int fd, InterpreterHandler &handler) {
+  std::vector<uint64_t> values(theStatisticManager->getNumStatistics());
+  InterpreterHandler::WorkerCounts counts;
+  if (!readAll(fd, values.data(), values.size() * sizeof(values[0])) ||
+      !readAll(fd, &counts, sizeof(counts)))
+    return false;
+  for (unsigned i = 0, e = values.size(); i != e; ++i)
+    theStatisticManager->incrementGlobalValue(
+        theStatisticManager->getStatistic(i), values[i]);
+  handler.addWorkerCounts(counts);
+  return true;
+}
+
+void waitFor(pid_t pid) {
+  int status;
+  while (waitpid(pid, &status, 0) < 0 && errno == EINTR)
+    ;
+}
+} // namespace
+
+void ParallelWorkers::start(InterpreterHandler &handler) {
+  assert(!split && "states were split already");
+  split = true;
+  handler.waitForTestCases();
+  startValues = getStatisticValues();
+  startCounts = handler.getWorkerCounts();
+
+  fflush(nullptr);
+  for (unsigned i = 1; i < count; ++i) {
+    int fds[2];
+    if (pipe(fds) < 0) {
+      klee_warning("pipe failed (for parallel workers) - %s",
+                   llvm::sys::StrError(errno).c_str());
+      failed[i] = true;
+      continue;
+    }
+    pid_t pid = fork();
+    if (pid == -1) {
+      klee_warning("fork failed (for parallel workers) - %s",
+                   llvm::sys::StrError(errno).c_str());
+      close(fds[0]);
+      close(fds[1]);
+      failed[i] = true;
+      continue;
+    }
+
+    if (pid == 0) {
+      close(fds[0]);
+      for (const auto &w : workers)
+        close(w.fd);
+      workers.clear();
+      index = i;
+      fd = fds[1];
+      break;
+    }
+
+    close(fds[1]);
+    workers.push_back({pid, fds[0]});
+  }
+  handler.setWorker(index, count);
+}
+
+void ParallelWorkers::finishWorker(InterpreterHandler &handler) {
+  assert(isWorker() && "not a worker");
+  writeStatistics(fd, startValues, startCounts, handler);
+  close(fd);
+  fflush(nullptr);
+  _exit(0);
+}
+
+void ParallelWorkers::collect(InterpreterHandler &handler) {
+  for (const auto &w : workers) {
+    if (!readStatistics(w.fd, handler))
+      klee_warning("parallel worker %d did not report its statistics", w.pid);
+    close(w.fd);
+    waitFor(w.pid);
+  }
+  workers.clear();
+}
+
+/***/
+
+namespace {
+enum MessageKind : uint32_t { PrefixesMessage, DoneMessage };
+
+struct MessageHeader {
+  uint32_t kind;
+  /// The number of prefixes of a PrefixesMessage.
+  uint32_t count;
+};
+} // namespace
+
+bool PrefixWorkers::startWorker(InterpreterHandler &handler) {
+  int requests[2], messages[2];
+  if (pipe(requests) < 0) {
+    klee_warning("pipe failed (for prefix workers) - %s",
+                 llvm::sys::StrError(errno).c_str());
+    return false;
+  }
+  if (pipe(messages) < 0) {
+    klee_warning("pipe failed (for prefix workers) - %s",
+                 llvm::sys::StrError(errno).c_str());
+    close(requests[0]);
+    close(requests[1]);
+    return false;
+  }
+  handler.waitForTestCases();
+  fflush(nullptr);
+  pid_t pid = fork();
+  if (pid == -1) {
+    klee_warning("fork failed (for prefix workers) - %s",
+                 llvm::sys::StrError(errno).c_str());
+    for (int fd : {requests[0], requests[1], messages[0], messages[1]})
+      close(fd);
+    return false;
+  }
+
+  if (pid == 0) {
+    close(requests[1]);
+    close(messages[0]);
+    for (const auto &w : workers) {
+      close(w.requestFd);
+      close(w.messageFd);
+    }
+    workers.clear();
+    prefixes.clear();
+    worker = true;
+    requestFd = requests[0];
+    messageFd = messages[1];
+    startValues = getStatisticValues();
+    startCounts = handler.getWorkerCounts();
+    return true;
+  }
+
+  close(requests[0]);
+  close(messages[1]);
+  workers.push_back({pid, requests[1], messages[0], false});
+  return true;
+}
+
+bool PrefixWorkers::coordinate(InterpreterHandler &handler, Prefix &prefix) {
+  // shared by all workers, which are forked from here
+  void *shared = mmap(nullptr, sizeof(std::atomic<std::uint32_t>),
+                      PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1,
+                      0);
+  if (shared == MAP_FAILED)
+    klee_error("mmap failed (for prefix workers) - %s",
+               llvm::sys::StrError(errno).c_str());
+  testCounter = new (shared)
+      std::atomic<std::uint32_t>(handler.getWorkerCounts().totalTests);
+  handler.setSharedTestCounter(testCounter);
+
+  prefixes.push_back(Prefix());
+  while (!prefixes.empty() || !workers.empty()) {
+    while (!prefixes.empty() && workers.size() < maxWorkers) {
+      Prefix next = std::move(prefixes.front());
+      prefixes.pop_front();
+      if (startWorker(handler)) {
+        if (worker) {
+          prefix = std::move(next);
+          return true;
+        }
+        continue;
+      }
+      if (workers.empty())
+        klee_error("could not start a prefix worker");
+      // try again once a worker is done
+      prefixes.push_front(std::move(next));
+      break;
+    }
+
+    // ask one busy worker at a time to give up some of its states
+    if (prefixes.empty() && workers.size() < maxWorkers &&
+        std::none_of(workers.begin(), workers.end(),
+                     [](const Worker &w) { return w.asked; })) {
+      Worker &w = workers[nextAsked++ % workers.size()];
+      char request = 0;
+      if (write(w.requestFd, &request, 1) == 1)
+        w.asked = true;
+    }
+
+    std::vector<pollfd> fds;
+    for (const auto &w : workers)
+      fds.push_back({w.messageFd, POLLIN, 0});
+    int ready = poll(fds.data(), fds.size(), 100);
+    if (ready <= 0)
+      continue;
+
+    std::vector<Worker> running;
+    for (size_t i = 0; i < workers.size(); ++i) {
+      if (!fds[i].revents || receive(workers[i], handler))
+        running.push_back(workers[i]);
+    }
+    workers.swap(running);
+  }
+
+  handler.setSharedTestCounter(nullptr);
+  munmap(shared, sizeof(std::atomic<std::uint32_t>));
+  testCounter = nullptr;
+  return false;
+}
+
+bool PrefixWorkers::receive(Worker &w, InterpreterHandler &handler) {
+  MessageHeader header;
+  bool done = !readAll(w.messageFd, &header, sizeof(header));
+  if (!done && header.kind == PrefixesMessage) {
+    w.asked = false;
+    for (uint32_t i = 0; i < header.count; ++i) {
+      uint32_t length;
+      Prefix prefix;
+      if (!readAll(w.messageFd, &length, sizeof(length)))
+        break;
+      prefix.resize(length);
+      if (!readAll(w.messageFd, prefix.data(), length * sizeof(prefix[0])))
+        break;
+      prefixes.push_back(std::move(prefix));
+    }
+    return true;
+  }
+
+  if (done || !readStatistics(w.messageFd, handler))
+    klee_warning("prefix worker %d did not report its statistics", w.pid);
+  close(w.requestFd);
+  close(w.messageFd);
+  waitFor(w.pid);
+  return false;
+}
+
+bool PrefixWorkers::prefixesRequested() {
+  pollfd fd = {requestFd, POLLIN, 0};
+  if (poll(&fd, 1, 0) <= 0)
+    return false;
+  char request;
+  return read(requestFd, &request, 1) == 1;
+}
+
+void PrefixWorkers::sendPrefixes(const std::vector<Prefix> &given) {
+  MessageHeader header = {PrefixesMessage, uint32_t(given.size())};
+  writeAll(messageFd, &header, sizeof(header));
+  for (const auto &prefix : given) {
+    uint32_t length = prefix.size();
+    writeAll(messageFd, &length, sizeof(length));
+    writeAll(messageFd, prefix.data(), length * sizeof(prefix[0]));
+  }
+}
+
+void PrefixWorkers::finishWorker(InterpreterHandler &handler) {
+  assert(isWorker() && "not a worker");
+  MessageHeader header = {DoneMessage, 0};
+  writeAll(messageFd, &header, sizeof(header));
+  writeStatistics(messageFd, startValues, startCounts, handler);
+  close(messageFd);
+  fflush(nullptr);
+  _exit(0);
+}
+
+/***/
+
+PortfolioWorkers::~PortfolioWorkers() {
+  if (mapping)
+    munmap(mapping, mappingSize);
+}
+
+void PortfolioWorkers::start(InterpreterHandler &handler) {
+  assert(!mapping && "the portfolio was started already");
+  handler.waitForTestCases();
+  // the test keys come first for their alignment
+  size_t keysSize = MaxTestKeys * sizeof(std::atomic<std::uint64_t>);
+  mappingSize =
+      keysSize + sizeof(std::atomic<std::uint32_t>) + numInstructions;
+  mapping = mmap(nullptr, mappingSize, PROT_READ | PROT_WRITE,
+                 MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (mapping == MAP_FAILED)
+    klee_error("mmap failed (for the portfolio) - %s",
+               llvm::sys::StrError(errno).c_str());
+  // the anonymous mapping is zero-filled, which is the initial value of
+  // each of the atomics
+  auto p = static_cast<char *>(mapping);
+  testKeys = reinterpret_cast<std::atomic<std::uint64_t> *>(p);
+  testCounter = new (p + keysSize)
+      std::atomic<std::uint32_t>(handler.getWorkerCounts().totalTests);
+  coverage = reinterpret_cast<std::atomic<std::uint8_t> *>(
+      p + keysSize + sizeof(std::atomic<std::uint32_t>));
+  handler.setSharedTestCounter(testCounter);
+
+  startValues = getStatisticValues();
+  startCounts = handler.getWorkerCounts();
+
+  fflush(nullptr);
+  for (unsigned i = 1; i < count; ++i) {
+    int fds[2];
+    if (pipe(fds) < 0) {
+      klee_warning("pipe failed (for the portfolio) - %s",
+                   llvm::sys::StrError(errno).c_str());
+      continue;
+    }
+    pid_t pid = fork();
+    if (pid == -1) {
+      klee_warning("fork failed (for the portfolio) - %s",
+                   llvm::sys::StrError(errno).c_str());
+      close(fds[0]);
+      close(fds[1]);
+      continue;
+    }
+
+    if (pid == 0) {
+      close(fds[0]);
+      for (const auto &w : workers)
+        close(w.fd);
+      workers.clear();
+      index = i;
+      fd = fds[1];
+      break;
+    }
+
+    close(fds[1]);
+    workers.push_back({pid, fds[0]});
+  }
+}
+
+bool PortfolioWorkers::claimTest(std::uint64_t key) {
+  if (!key)
+    key = 1;
+  for (size_t i = 0; i < MaxTestKeys; ++i) {
+    std::atomic<std::uint64_t> &slot = testKeys[(key + i) % MaxTestKeys];
+    std::uint64_t current = slot.load();
+    if (!current && slot.compare_exchange_strong(current, key))
+      return true;
+    if (current == key)
+      return false;
+  }
+  // the table is full, keep every test case from now on
+  return true;
+}
+
+void PortfolioWorkers::finishWorker(InterpreterHandler &handler) {
+  assert(isWorker() && "not a worker");
+  writeStatistics(fd, startValues, startCounts, handler);
+  close(fd);
+  fflush(nullptr);
+  _exit(0);
+}
+
+void PortfolioWorkers::collect(InterpreterHandler &handler) {
+  for (const auto &w : workers) {
+    if (!readStatistics(w.fd, handler))
+      klee_warning("portfolio member %d did not report its statistics",
+                   w.pid);
+    close(w.fd);
+    waitFor(w.pid);
+  }
+  workers.clear();
+
+  uint64_t covered = 0;
+  for (size_t i = 0; i < numInstructions; ++i)
+    covered += coverage[i].load() != 0;
+  uint64_t delta = covered - stats::coveredInstructions.getValue();
+  theStatisticManager->incrementGlobalValue(stats::coveredInstructions, delta);
+  theStatisticManager->incrementGlobalValue(stats::uncoveredInstructions,
+                                            -delta);
+  handler.setSharedTestCounter(nullptr);
+}
@@ -0,0 +1,211 @@
+//===-- ParallelWorkers.h ---------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_PARALLELWORKERS_H
+#define KLEE_PARALLELWORKERS_H
+
+#include "klee/Core/Interpreter.h"
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <sys/types.h>
+#include <vector>
+
+namespace klee {
+
+/// ParallelWorkers - Splits the exploration among forked worker processes.
+/// Once there are enough states, the executor forks the other workers and
+/// each worker, the original process included, keeps every count-th state
+/// and explores it with its own searcher, solver chain and caches. When a
+/// worker is done, it sends the statistics it gathered since the split to
+/// the original process, which adds them to its own.
+class ParallelWorkers {
+  struct Worker {
+    pid_t pid;
+    int fd;
+  };
+  std::vector<Worker> workers;
+  unsigned count;
+  /// The index of this process among the workers, 0 in the original one.
+  unsigned index = 0;
+  bool split = false;
+  /// The shares of the workers that could not be started, taken over by
+  /// the original process.
+  std::vector<bool> failed;
+  /// The statistics and counts when the states were split.
+  std::vector<uint64_t> startValues;
+  InterpreterHandler::WorkerCounts startCounts;
+  /// The pipe to the original process, in a worker.
+  int fd = -1;
+
+public:
+  /// The number of states per worker at which states are split.
+  static const unsigned StatesPerWorker = 4;
+
+  explicit ParallelWorkers(unsigned count) : count(count), failed(count) {}
+  ParallelWorkers(const ParallelWorkers &) = delete;
+  ParallelWorkers &operator=(const ParallelWorkers &) = delete;
+
+  bool shouldSplit(size_t numStates) const {
+    return !split && numStates >= count * StatesPerWorker;
+  }
+  bool isWorker() const { return index != 0; }
+
+  /// Fork the other workers, each of which returns from here too.
+  void start(InterpreterHandler &handler);
+
+  /// \return true if the i-th state (in an order shared by all workers)
+  /// is explored by this process
+  bool keeps(size_t i) const {
+    unsigned share = i % count;
+    return share == index || (!isWorker() && failed[share]);
+  }
+
+  /// In a worker, send the statistics to the original process and exit.
+  [[noreturn]] void finishWorker(InterpreterHandler &handler);
+
+  /// In the original process, wait for the workers and add their
+  /// statistics to its own.
+  void collect(InterpreterHandler &handler);
+};
+
+/// PrefixWorkers - Spreads the exploration over worker processes that
+/// explore disjoint subtrees of the execution tree, each identified by the
+/// choices taken at the forks on the path to it (a prefix, see
+/// ExecutionState::forkChoices). The original process becomes the
+/// coordinator: it forks a worker for each prefix, starting with the empty
+/// one, from the initial state. A worker replays its prefix without
+/// forking and then explores as usual. When a worker slot is free and no
+/// prefix is left, the coordinator asks a busy worker to give up some of
+/// its states, which are sent back as their prefixes. Workers report their
+/// statistics to the coordinator when they are done, and share the
+/// numbering of the test cases.
+class PrefixWorkers {
+public:
+  typedef std::vector<std::uint32_t> Prefix;
+
+private:
+  struct Worker {
+    pid_t pid;
+    /// Written by the coordinator to ask for prefixes.
+    int requestFd;
+    /// Read by the coordinator, for prefixes and statistics.
+    int messageFd;
+    bool asked;
+  };
+  std::vector<Worker> workers;
+  std::deque<Prefix> prefixes;
+  unsigned maxWorkers;
+  /// The worker asked next for prefixes.
+  unsigned nextAsked = 0;
+  bool worker = false;
+  /// The ends of the pipes to the coordinator, in a worker.
+  int requestFd = -1;
+  int messageFd = -1;
+  /// The statistics and counts when the worker was started.
+  std::vector<uint64_t> startValues;
+  InterpreterHandler::WorkerCounts startCounts;
+  std::atomic<std::uint32_t> *testCounter = nullptr;
+
+  /// Fork a worker, which is marked by isWorker(). \return false if that
+  /// failed
+  bool startWorker(InterpreterHandler &handler);
+  /// Read the message of a worker. \return false if it is done
+  bool receive(Worker &w, InterpreterHandler &handler);
+
+public:
+  explicit PrefixWorkers(unsigned maxWorkers) : maxWorkers(maxWorkers) {}
+  PrefixWorkers(const PrefixWorkers &) = delete;
+  PrefixWorkers &operator=(const PrefixWorkers &) = delete;
+
+  bool isWorker() const { return worker; }
+
+  /// Coordinate the workers until the whole tree is explored.
+  /// \return true in a worker, with the prefix it has to explore, and
+  /// false in the coordinator once all workers are done
+  bool coordinate(InterpreterHandler &handler, Prefix &prefix);
+
+  /// In a worker, \return true if the coordinator asked for prefixes and
+  /// is waiting for sendPrefixes
+  bool prefixesRequested();
+  void sendPrefixes(const std::vector<Prefix> &given);
+
+  /// In a worker, send the statistics to the coordinator and exit.
+  [[noreturn]] void finishWorker(InterpreterHandler &handler);
+};
+
+/// PortfolioWorkers - Runs several independent explorations of the whole
+/// program, each in a forked process with its own searcher and seed (see
+/// --portfolio). Through shared memory, the members number their test
+/// cases from one counter, mark the instructions they cover in one bitmap
+/// and record the sets of covered lines of the test cases they write, so
+/// that a set of lines only gets one test case. The original process is
+/// the first member, and adds the statistics of the others to its own when
+/// they are done.
+class PortfolioWorkers {
+  struct Worker {
+    pid_t pid;
+    int fd;
+  };
+  std::vector<Worker> workers;
+  unsigned count;
+  /// The index of this process among the members, 0 in the original one.
+  unsigned index = 0;
+  size_t numInstructions;
+  void *mapping = nullptr;
+  size_t mappingSize = 0;
+  std::atomic<std::uint32_t> *testCounter = nullptr;
+  std::atomic<std::uint8_t> *coverage = nullptr;
+  /// An open addressing table of the keys of the written test cases, 0
+  /// marking a free slot.
+  std::atomic<std::uint64_t> *testKeys = nullptr;
+  /// The statistics and counts when the members were forked.
+  std::vector<uint64_t> startValues;
+  InterpreterHandler::WorkerCounts startCounts;
+  /// The pipe to the original process, in a worker.
+  int fd = -1;
+
+public:
+  /// The number of slots of the table of test case keys.
+  static const size_t MaxTestKeys = 1 << 16;
+
+  /// \param numInstructions The number of instruction ids to track the
+  /// coverage of.
+  PortfolioWorkers(unsigned count, size_t numInstructions)
+      : count(count), numInstructions(numInstructions) {}
+  ~PortfolioWorkers();
+  PortfolioWorkers(const PortfolioWorkers &) = delete;
+  PortfolioWorkers &operator=(const PortfolioWorkers &) = delete;
+
+  unsigned getIndex() const { return index; }
+  bool isWorker() const { return index != 0; }
+
+  /// Fork the other members, each of which returns from here too.
+  void start(InterpreterHandler &handler);
+
+  /// The coverage bitmap shared by the members, indexed by instruction id.
+  std::atomic<std::uint8_t> *getCoverage() const { return coverage; }
+
+  /// Record the key of the covered lines of a test case. \return false if
+  /// a member already wrote a test case with that key
+  bool claimTest(std::uint64_t key);
+
+  /// In a worker, send the statistics to the original process and exit.
+  [[noreturn]] void finishWorker(InterpreterHandler &handler);
+
+  /// In the original process, wait for the other members and add their
+  /// statistics to its own. The instruction coverage is taken from the
+  /// shared bitmap, as the members cover many instructions alike.
+  void collect(InterpreterHandler &handler);
+};
+
+} // namespace klee
+
+#endif /* KLEE_PARALLELWORKERS_H */
@@ -16,22 +16,27 @@
 #include "PTree.h"
 #include "StatsTracker.h"
 
-#include "klee/ADT/DiscretePDF.h"
+#include "klee/ADT/FlatDiscretePDF.h"
 #include "klee/ADT/RNG.h"
 #include "klee/Statistics/Statistics.h"
 #include "klee/Module/InstructionInfoTable.h"
 #include "klee/Module/KInstruction.h"
 #include "klee/Module/KModule.h"
 #include "klee/Support/ErrorHandling.h"
+#include "klee/Support/ModuleUtil.h"
 #include "klee/System/Time.h"
 
+#include "llvm/IR/CFG.h"
 #include "llvm/IR/Constants.h"
+#include "llvm/IR/InlineAsm.h"
+#include "llvm/IR/InstIterator.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/Module.h"
 #include "llvm/Support/CommandLine.h"
 
 #include <cassert>
 #include <cmath>
+#include <limits>
 
 using namespace klee;
 using namespace llvm;
@@ -147,10 +152,12 @@ void RandomSearcher::printName(llvm::raw_ostream &os) {
 
 ///
 
-WeightedRandomSearcher::WeightedRandomSearcher(WeightType type, RNG &rng)
-  : states(std::make_unique<DiscretePDF<ExecutionState*, ExecutionStateIDCompare>>()),
+WeightedRandomSearcher::WeightedRandomSearcher(WeightType type, RNG &rng,
+                                               unsigned updateInterval)
+  : states(std::make_unique<FlatDiscretePDF<ExecutionState*>>()),
     theRNG{rng},
-    type(type) {
+    type(type),
+    updateInterval(std::max(updateInterval, 1u)) {
 
   switch(type) {
   case Depth:
@@ -162,6 +169,7 @@ WeightedRandomSearcher::WeightedRandomSearcher(WeightType type, RNG &rng)
   case QueryCost:
   case MinDistToUncovered:
   case CoveringNew:
+  case SolverCost:
     updateWeights = true;
     break;
   default:
@@ -187,7 +195,7 @@ double WeightedRandomSearcher::getWeight(ExecutionState *es) {
       return inv * inv;
     }
     case CPInstCount: {
-      StackFrame &sf = es->stack.back();
+      const StackFrame &sf = es->stack.back();
       uint64_t count = sf.callPathNode->statistics.getValue(stats::instructions);
       double inv = 1. / std::max((uint64_t) 1, count);
       return inv;
@@ -197,19 +205,28 @@ double WeightedRandomSearcher::getWeight(ExecutionState *es) {
                  ? 1.
                  : 1. / es->queryMetaData.queryCost.toSeconds();
     case CoveringNew:
-    case MinDistToUncovered: {
+    case MinDistToUncovered:
+    case SolverCost: {
       uint64_t md2u = computeMinDistToUncovered(es->pc,
                                                 es->stack.back().minDistToUncoveredOnReturn);
 
       double invMD2U = 1. / (md2u ? md2u : 10000);
-      if (type == CoveringNew) {
-        double invCovNew = 0.;
-        if (es->instsSinceCovNew)
-          invCovNew = 1. / std::max(1, (int) es->instsSinceCovNew - 1000);
-        return (invCovNew * invCovNew + invMD2U * invMD2U);
-      } else {
+      if (type == MinDistToUncovered)
         return invMD2U * invMD2U;
-      }
+
+      double invCovNew = 0.;
+      if (es->instsSinceCovNew)
+        invCovNew = 1. / std::max(1, (int) es->instsSinceCovNew - 1000);
+      double weight = invCovNew * invCovNew + invMD2U * invMD2U;
+      if (type == CoveringNew)
+        return weight;
+
+      // the next query of a state is predicted to cost as much as its last
+      // ones, growing with its path condition; states predicted to take
+      // less than .1s are not penalized
+      double predicted = es->queryMetaData.recentQueryCost.toSeconds() *
+                         (1. + es->constraints.size() / 64.);
+      return weight / std::max(1., predicted / .1);
     }
   }
 }
@@ -218,18 +235,37 @@ void WeightedRandomSearcher::update(ExecutionState *current,
                                     const std::vector<ExecutionState *> &addedStates,
                                     const std::vector<ExecutionState *> &removedStates) {
 
+  // remove states first, they are not weighed again
+  for (const auto state : removedStates) {
+    if (state == stale) {
+      stale = nullptr;
+      staleSteps = 0;
+    }
+    states->remove(state);
+  }
+
   // update current
   if (current && updateWeights &&
-      std::find(removedStates.begin(), removedStates.end(), current) == removedStates.end())
-    states->update(current, getWeight(current));
+      std::find(removedStates.begin(), removedStates.end(), current) == removedStates.end()) {
+    if (current != stale) {
+      updateStale();
+      stale = current;
+    }
+    // a state running on is only reweighted every updateInterval steps
+    if (++staleSteps >= updateInterval)
+      updateStale();
+  }
 
   // insert states
   for (const auto state : addedStates)
     states->insert(state, getWeight(state));
+}
 
-  // remove states
-  for (const auto state : removedStates)
-    states->remove(state);
+void WeightedRandomSearcher::updateStale() {
+  if (stale)
+    states->update(stale, getWeight(stale));
+  stale = nullptr;
+  staleSteps = 0;
 }
 
 bool WeightedRandomSearcher::empty() {
@@ -246,11 +282,240 @@ void WeightedRandomSearcher::printName(llvm::raw_ostream &os) {
     case CPInstCount        : os << "CPInstCount\n"; return;
     case MinDistToUncovered : os << "MinDistToUncovered\n"; return;
     case CoveringNew        : os << "CoveringNew\n"; return;
+    case SolverCost         : os << "SolverCost\n"; return;
     default                 : os << "<unknown type>\n"; return;
   }
 }
 
 
+///
+
+const uint64_t ErrorDistances::Unreachable =
+    std::numeric_limits<uint64_t>::max();
+
+namespace {
+const uint64_t Unreachable = ErrorDistances::Unreachable;
+
+inline uint64_t addDistance(uint64_t a, uint64_t b) {
+  return a == Unreachable || b == Unreachable ? Unreachable : a + b;
+}
+
+std::vector<const Instruction *> getSuccessors(const Instruction *i) {
+  std::vector<const Instruction *> res;
+  if (i->isTerminator()) {
+    for (const BasicBlock *succ : successors(i->getParent()))
+      res.push_back(&succ->front());
+  } else {
+    res.push_back(i->getNextNode());
+  }
+  return res;
+}
+} // namespace
+
+ErrorDistances::ErrorDistances(const KModule &kmodule) : kmodule(kmodule) {
+  const InstructionInfoTable &infos = *kmodule.infos;
+  errorDistance.assign(infos.getMaxID(), Unreachable);
+  returnDistance.assign(infos.getMaxID(), Unreachable);
+
+  // indirect calls are assumed to reach all escaping functions
+  std::map<const Instruction *, std::vector<const Function *>> callTargets;
+  std::vector<const Instruction *> order;
+  for (const Function &f : *kmodule.module) {
+    for (const Instruction &i : instructions(f)) {
+      order.push_back(&i);
+      const auto *cb = dyn_cast<CallBase>(&i);
+      if (!cb || isa<InlineAsm>(cb->getCalledOperand()))
+        continue;
+      if (const Function *target =
+              getDirectCallTarget(*cb, /*moduleIsFullyLinked=*/true))
+        callTargets[&i].push_back(target);
+      else
+        callTargets[&i].assign(kmodule.escapingFunctions.begin(),
+                               kmodule.escapingFunctions.end());
+    }
+  }
+
+  // from the entry of a function, to an error call and through its return
+  std::map<const Function *, uint64_t> functionError, functionReturn;
+  for (const Function &f : *kmodule.module) {
+    functionError[&f] = Unreachable;
+    if (f.isDeclaration())
+      functionReturn[&f] = f.doesNotReturn() ? Unreachable : 0;
+    else
+      functionReturn[&f] = Unreachable;
+  }
+
+  // distances only decrease, iterate until they are stable
+  std::reverse(order.begin(), order.end());
+  bool changed;
+  do {
+    changed = false;
+    for (const Instruction *i : order) {
+      unsigned id = infos.getID(*i);
+      uint64_t error = errorDistance[id];
+      uint64_t ret = isa<ReturnInst>(i) ? 0 : returnDistance[id];
+      uint64_t through = 1;
+
+      auto it = callTargets.find(i);
+      if (it != callTargets.end()) {
+        through = Unreachable;
+        for (const Function *target : it->second) {
+          if (Executor::isErrorFunction(*target))
+            error = 0;
+          error = std::min(error, addDistance(1, functionError[target]));
+          through = std::min(through, addDistance(1, functionReturn[target]));
+        }
+      }
+
+      if (!isa<ReturnInst>(i)) {
+        for (const Instruction *succ : getSuccessors(i)) {
+          unsigned succId = infos.getID(*succ);
+          error = std::min(error, addDistance(through, errorDistance[succId]));
+          ret = std::min(ret, addDistance(through, returnDistance[succId]));
+        }
+      }
+
+      if (error != errorDistance[id] || ret != returnDistance[id]) {
+        errorDistance[id] = error;
+        returnDistance[id] = ret;
+        changed = true;
+      }
+
+      const Function *f = i->getFunction();
+      if (i == &f->getEntryBlock().front()) {
+        uint64_t fnReturn = addDistance(ret, 1);
+        if (functionError[f] != error || functionReturn[f] != fnReturn) {
+          functionError[f] = error;
+          functionReturn[f] = fnReturn;
+          changed = true;
+        }
+      }
+    }
+  } while (changed);
+}
+
+uint64_t ErrorDistances::get(const ExecutionState &state) const {
+  const InstructionInfoTable &infos = *kmodule.infos;
+  unsigned id = state.pc->info->id;
+  uint64_t best = errorDistance[id];
+  // continue in the callers once the frames above return
+  uint64_t offset = returnDistance[id];
+  for (auto it = state.stack.rbegin(), ie = state.stack.rend();
+       it != ie && offset != Unreachable && it->caller; ++it) {
+    uint64_t callerError = Unreachable, callerReturn = Unreachable;
+    for (const Instruction *succ : getSuccessors(it->caller->inst)) {
+      unsigned succId = infos.getID(*succ);
+      callerError = std::min(callerError, errorDistance[succId]);
+      callerReturn = std::min(callerReturn, returnDistance[succId]);
+    }
+    offset = addDistance(offset, 1);
+    best = std::min(best, addDistance(offset, callerError));
+    offset = addDistance(offset, callerReturn);
+  }
+  return best;
+}
+
+DistanceToErrorSearcher::DistanceToErrorSearcher(const KModule &kmodule)
+    : distances(kmodule) {}
+
+ExecutionState &DistanceToErrorSearcher::selectState() {
+  return states.top();
+}
+
+void DistanceToErrorSearcher::update(
+    ExecutionState *current, const std::vector<ExecutionState *> &addedStates,
+    const std::vector<ExecutionState *> &removedStates) {
+  // only the executed state moved
+  if (current && std::find(removedStates.begin(), removedStates.end(),
+                           current) == removedStates.end())
+    states.update(current, distances.get(*current));
+
+  for (const auto state : addedStates)
+    states.insert(state, distances.get(*state));
+
+  for (const auto state : removedStates)
+    states.remove(state);
+}
+
+bool DistanceToErrorSearcher::empty() { return states.empty(); }
+
+void DistanceToErrorSearcher::printName(llvm::raw_ostream &os) {
+  os << "DistanceToErrorSearcher\n";
+}
+
+
+///
+
+FeatureSearcher::FeatureSearcher(std::unique_ptr<ScoringModel> model,
+                                 const KModule &kmodule)
+    : model(std::move(model)) {
+  for (unsigned i = 0; i < StateFeatures::NumFeatures; ++i)
+    used[i] = this->model->uses(static_cast<StateFeatures::Kind>(i));
+  if (used[StateFeatures::ErrorDistance])
+    errorDistances = std::make_unique<ErrorDistances>(kmodule);
+}
+
+double FeatureSearcher::computeScore(const ExecutionState &state) {
+  StateFeatures &f = features[&state];
+  if (used[StateFeatures::Depth])
+    f[StateFeatures::Depth] = state.depth;
+  if (used[StateFeatures::InstsSinceCovNew])
+    f[StateFeatures::InstsSinceCovNew] = state.instsSinceCovNew;
+  if (used[StateFeatures::QueryCost])
+    f[StateFeatures::QueryCost] = state.queryMetaData.queryCost.toSeconds();
+  if (used[StateFeatures::Constraints])
+    f[StateFeatures::Constraints] = state.constraints.size();
+  if (used[StateFeatures::MinDistToUncovered]) {
+    uint64_t md2u = computeMinDistToUncovered(
+        state.pc, state.stack.back().minDistToUncoveredOnReturn);
+    f[StateFeatures::MinDistToUncovered] =
+        md2u ? md2u : StateFeatures::Unreachable;
+  }
+  if (used[StateFeatures::StackDepth])
+    f[StateFeatures::StackDepth] = state.stack.size();
+  if (used[StateFeatures::ErrorDistance]) {
+    uint64_t distance = errorDistances->get(state);
+    f[StateFeatures::ErrorDistance] =
+        distance == ErrorDistances::Unreachable ? StateFeatures::Unreachable
+                                                : distance;
+  }
+  return -model->score(f);
+}
+
+const StateFeatures &
+FeatureSearcher::getFeatures(const ExecutionState &state) const {
+  auto it = features.find(&state);
+  assert(it != features.end() && "unknown state");
+  return it->second;
+}
+
+ExecutionState &FeatureSearcher::selectState() { return states.top(); }
+
+void FeatureSearcher::update(
+    ExecutionState *current, const std::vector<ExecutionState *> &addedStates,
+    const std::vector<ExecutionState *> &removedStates) {
+  if (current && std::find(removedStates.begin(), removedStates.end(),
+                           current) == removedStates.end())
+    states.update(current, computeScore(*current));
+
+  for (const auto state : addedStates)
+    states.insert(state, computeScore(*state));
+
+  for (const auto state : removedStates) {
+    states.remove(state);
+    features.erase(state);
+  }
+}
+
+bool FeatureSearcher::empty() { return states.empty(); }
+
+void FeatureSearcher::printName(llvm::raw_ostream &os) {
+  os << "FeatureSearcher: ";
+  model->print(os);
+  os << "\n";
+}
+
+
 ///
 
 // Check if n is a valid pointer and a node belonging to us
@@ -265,70 +530,138 @@ RandomPathSearcher::RandomPathSearcher(PTree &processTree, RNG &rng)
 ExecutionState &RandomPathSearcher::selectState() {
   unsigned flips=0, bits=0;
   assert(processTree.root.getInt() & idBitMask && "Root should belong to the searcher");
-  PTreeNode *n = processTree.root.getPointer();
-  while (!n->state) {
-    if (!IS_OUR_NODE_VALID(n->left)) {
-      assert(IS_OUR_NODE_VALID(n->right) && "Both left and right nodes invalid");
-      assert(n != n->right.getPointer());
-      n = n->right.getPointer();
-    } else if (!IS_OUR_NODE_VALID(n->right)) {
-      assert(IS_OUR_NODE_VALID(n->left) && "Both right and left nodes invalid");
-      assert(n != n->left.getPointer());
-      n = n->left.getPointer();
-    } else {
-      if (bits==0) {
-        flips = theRNG.getInt32();
-        bits = 32;
-      }
-      --bits;
-      n = ((flips & (1U << bits)) ? n->left : n->right).getPointer();
+  Target t = top;
+  while (auto n = t.dyn_cast<PTreeNode *>()) {
+    auto it = branches.find(n);
+    assert(it != branches.end() && "Target is not a branch");
+    if (bits==0) {
+      flips = theRNG.getInt32();
+      bits = 32;
+    }
+    --bits;
+    t = (flips & (1U << bits)) ? it->second.left : it->second.right;
+  }
+
+  return *t.get<ExecutionState *>();
+}
+
+RandomPathSearcher::Target RandomPathSearcher::getTarget(PTreeNode *n) const {
+  // follow a chain of nodes with a single child of ours
+  for (;;) {
+    if (n->state)
+      return n->state;
+    if (branches.count(n))
+      return n;
+    assert((IS_OUR_NODE_VALID(n->left) || IS_OUR_NODE_VALID(n->right)) &&
+           "Both left and right nodes invalid");
+    n = (IS_OUR_NODE_VALID(n->left) ? n->left : n->right).getPointer();
+  }
+}
+
+RandomPathSearcher::Link &RandomPathSearcher::getLink(Target target) {
+  if (auto n = target.dyn_cast<PTreeNode *>())
+    return branches[n].up;
+  return leaves[target.get<ExecutionState *>()];
+}
+
+void RandomPathSearcher::setTarget(const Link &link, Target target) {
+  if (!link.branch)
+    top = target;
+  else if (link.left)
+    branches[link.branch].left = target;
+  else
+    branches[link.branch].right = target;
+}
+
+void RandomPathSearcher::insert(ExecutionState *es) {
+  PTreeNode *pnode = es->ptreeNode, *child = nullptr;
+  assert(!leaves.count(es) && "State already inserted");
+
+  // mark the path up to the first node that already is ours
+  for (;;) {
+    PTreeNode *parent = pnode->parent;
+    PTreeNodePtr *childPtr =
+        parent ? ((parent->left.getPointer() == pnode) ? &parent->left
+                                                       : &parent->right)
+               : &processTree.root;
+    if (IS_OUR_NODE_VALID(*childPtr)) {
+      assert(child && "Inserted state is ours already");
+      break;
+    }
+    childPtr->setInt(childPtr->getInt() | idBitMask);
+    if (!parent) {
+      // the first state of the searcher
+      top = es;
+      leaves[es] = Link();
+      return;
     }
+    child = pnode;
+    pnode = parent;
+  }
+
+  // pnode now branches, between the new state and the next target on the
+  // other side
+  bool left = pnode->left.getPointer() == child;
+  Target other = getTarget((left ? pnode->right : pnode->left).getPointer());
+  Link &otherLink = getLink(other);
+  Link up = otherLink;
+  otherLink = {pnode, !left};
+  leaves[es] = {pnode, left};
+
+  Branch &branch = branches[pnode];
+  branch.left = left ? Target(es) : other;
+  branch.right = left ? other : Target(es);
+  branch.up = up;
+  setTarget(up, pnode);
+}
+
+void RandomPathSearcher::remove(ExecutionState *es) {
+  PTreeNode *pnode = es->ptreeNode, *parent = pnode->parent, *child = nullptr;
+
+  while (pnode && !IS_OUR_NODE_VALID(pnode->left) &&
+         !IS_OUR_NODE_VALID(pnode->right)) {
+    auto childPtr =
+        parent ? ((parent->left.getPointer() == pnode) ? &parent->left
+                                                       : &parent->right)
+               : &processTree.root;
+    assert(IS_OUR_NODE_VALID(*childPtr) && "Removing pTree child not ours");
+    childPtr->setInt(childPtr->getInt() & ~idBitMask);
+    child = pnode;
+    pnode = parent;
+    if (pnode)
+      parent = pnode->parent;
   }
+  leaves.erase(es);
 
-  return *n->state;
+  if (!pnode) {
+    // the last state of the searcher
+    assert(leaves.empty() && branches.empty());
+    top = Target();
+    return;
+  }
+
+  // pnode no longer branches, link the target on the other side to the
+  // branch above
+  auto it = branches.find(pnode);
+  assert(it != branches.end() && "Node with two children is not a branch");
+  Target other = pnode->left.getPointer() == child ? it->second.right
+                                                   : it->second.left;
+  Link up = it->second.up;
+  branches.erase(it);
+  getLink(other) = up;
+  setTarget(up, other);
 }
 
 void RandomPathSearcher::update(ExecutionState *current,
                                 const std::vector<ExecutionState *> &addedStates,
                                 const std::vector<ExecutionState *> &removedStates) {
   // insert states
-  for (auto es : addedStates) {
-    PTreeNode *pnode = es->ptreeNode, *parent = pnode->parent;
-    PTreeNodePtr *childPtr;
-
-    childPtr = parent ? ((parent->left.getPointer() == pnode) ? &parent->left
-                                                              : &parent->right)
-                      : &processTree.root;
-    while (pnode && !IS_OUR_NODE_VALID(*childPtr)) {
-      childPtr->setInt(childPtr->getInt() | idBitMask);
-      pnode = parent;
-      if (pnode)
-        parent = pnode->parent;
-
-      childPtr = parent
-                     ? ((parent->left.getPointer() == pnode) ? &parent->left
-                                                             : &parent->right)
-                     : &processTree.root;
-    }
-  }
+  for (auto es : addedStates)
+    insert(es);
 
   // remove states
-  for (auto es : removedStates) {
-    PTreeNode *pnode = es->ptreeNode, *parent = pnode->parent;
-
-    while (pnode && !IS_OUR_NODE_VALID(pnode->left) &&
-           !IS_OUR_NODE_VALID(pnode->right)) {
-      auto childPtr =
-          parent ? ((parent->left.getPointer() == pnode) ? &parent->left
-                                                         : &parent->right)
-                 : &processTree.root;
-      assert(IS_OUR_NODE_VALID(*childPtr) && "Removing pTree child not ours");
-      childPtr->setInt(childPtr->getInt() & ~idBitMask);
-      pnode = parent;
-      if (pnode)
-        parent = pnode->parent;
-    }
-  }
+  for (auto es : removedStates)
+    remove(es);
 }
 
 bool RandomPathSearcher::empty() {
@@ -408,18 +741,62 @@ void MergingSearcher::printName(llvm::raw_ostream &os) {
 
 ///
 
-BatchingSearcher::BatchingSearcher(Searcher *baseSearcher, time::Span timeBudget, unsigned instructionBudget)
+BatchingSearcher::BatchingSearcher(Searcher *baseSearcher, time::Span timeBudget,
+                                   unsigned instructionBudget, bool adaptive)
   : baseSearcher{baseSearcher},
     timeBudget{timeBudget},
-    instructionBudget{instructionBudget} {};
+    instructionBudget{instructionBudget},
+    adaptive{adaptive && instructionBudget > 0} {};
+
+unsigned BatchingSearcher::getBudget(const ExecutionState *state) const {
+  if (!adaptive)
+    return instructionBudget;
+  auto it = budgets.find(state);
+  return it == budgets.end() ? instructionBudget : it->second;
+}
+
+void BatchingSearcher::adaptBudget() {
+  // the budget stays within a factor of 16 of the configured one
+  const unsigned minBudget = std::max(1u, instructionBudget / 16);
+  const unsigned maxBudget =
+      instructionBudget > std::numeric_limits<unsigned>::max() / 16
+          ? std::numeric_limits<unsigned>::max()
+          : instructionBudget * 16;
+  unsigned budget = getBudget(lastState);
+
+  time::Span batchTime = time::getWallTime() - lastStartTime;
+  std::uint64_t batchSolverTime = stats::solverTime - lastStartSolverTime;
+  bool coveredNew = stats::coveredInstructions > lastStartCovered;
+
+  unsigned adapted = budget;
+  if (coveredNew) {
+    // stay on states that make progress
+    adapted = budget > maxBudget / 2 ? maxBudget : budget * 2;
+  } else if (batchSolverTime * 2 > batchTime.toMicroseconds()) {
+    // switch away from states stuck in expensive queries sooner
+    adapted = std::max(minBudget, budget / 2);
+  } else if (selectionTime.toMicroseconds() * 20 > batchTime.toMicroseconds()) {
+    // amortize an expensive underlying searcher over longer batches
+    adapted = budget > maxBudget / 2 ? maxBudget : budget * 2;
+  }
+
+  if (adapted > budget)
+    ++stats::batchesGrown;
+  else if (adapted < budget)
+    ++stats::batchesShrunk;
+  budgets[lastState] = adapted;
+}
 
 ExecutionState &BatchingSearcher::selectState() {
+  unsigned budget = getBudget(lastState);
   if (!lastState ||
       (((timeBudget.toSeconds() > 0) &&
         (time::getWallTime() - lastStartTime) > timeBudget)) ||
-      ((instructionBudget > 0) &&
-       (stats::instructions - lastStartInstructions) > instructionBudget)) {
+      ((budget > 0) &&
+       (stats::instructions - lastStartInstructions) > budget)) {
     if (lastState) {
+      if (adaptive)
+        adaptBudget();
       time::Span delta = time::getWallTime() - lastStartTime;
       auto t = timeBudget;
       t *= 1.1;
@@ -428,7 +805,18 @@ ExecutionState &BatchingSearcher::selectState() {
         timeBudget = delta;
       }
     }
-    lastState = &baseSearcher->selectState();
+    if (adaptive) {
+      time::Point start = time::getWallTime();
+      lastState = &baseSearcher->selectState();
+      // exponential moving average over the selections
+      auto elapsed = (time::getWallTime() - start).toMicroseconds();
+      selectionTime = time::microseconds(
+          (selectionTime.toMicroseconds() * 7 + elapsed) / 8);
+      lastStartSolverTime = stats::solverTime;
+      lastStartCovered = stats::coveredInstructions;
+    } else {
+      lastState = &baseSearcher->selectState();
+    }
     lastStartTime = time::getWallTime();
     lastStartInstructions = stats::instructions;
     return *lastState;
@@ -443,6 +831,8 @@ void BatchingSearcher::update(ExecutionState *current,
   // drop memoized state if it is marked for deletion
   if (std::find(removedStates.begin(), removedStates.end(), lastState) != removedStates.end())
     lastState = nullptr;
+  for (const auto state : removedStates)
+    budgets.erase(state);
   // update underlying searcher
   baseSearcher->update(current, addedStates, removedStates);
 }
@@ -454,12 +844,76 @@ bool BatchingSearcher::empty() {
 void BatchingSearcher::printName(llvm::raw_ostream &os) {
   os << "<BatchingSearcher> timeBudget: " << timeBudget
      << ", instructionBudget: " << instructionBudget
+     << (adaptive ? " (adaptive)" : "")
      << ", baseSearcher:\n";
   baseSearcher->printName(os);
   os << "</BatchingSearcher>\n";
 }
 
 
+///
+
+SolverAffinitySearcher::SolverAffinitySearcher(Searcher *baseSearcher,
+                                               unsigned fairnessBound)
+  : baseSearcher{baseSearcher}, fairnessBound{fairnessBound} {}
+
+bool SolverAffinitySearcher::inLineage(const ExecutionState *state) const {
+  return lineageStates.count(state) > 0;
+}
+
+ExecutionState &SolverAffinitySearcher::selectState() {
+  ExecutionState &candidate = baseSearcher->selectState();
+  if (&candidate == lastState)
+    return candidate;
+
+  bool related = inLineage(&candidate);
+  if (!related && !lineage.empty() && overrides < fairnessBound) {
+    ++overrides;
+    ++stats::affinitySelections;
+    // continue the last selected state, or else the most recently forked
+    if (!lastState)
+      lastState = lineage.back();
+    return *lastState;
+  }
+
+  // the lineage narrows to the selected state and the states forked from
+  // it, the fairness bound only restarts with another lineage
+  if (!related)
+    overrides = 0;
+  lineage.assign(1, &candidate);
+  lineageStates = {&candidate};
+  return *(lastState = &candidate);
+}
+
+void SolverAffinitySearcher::update(
+    ExecutionState *current, const std::vector<ExecutionState *> &addedStates,
+    const std::vector<ExecutionState *> &removedStates) {
+  // the states forked from the lineage join it
+  if (current && inLineage(current)) {
+    lineage.insert(lineage.end(), addedStates.begin(), addedStates.end());
+    lineageStates.insert(addedStates.begin(), addedStates.end());
+  }
+  for (const auto state : removedStates) {
+    if (lineageStates.erase(state))
+      lineage.erase(std::find(lineage.begin(), lineage.end(), state));
+    if (state == lastState)
+      lastState = nullptr;
+  }
+  baseSearcher->update(current, addedStates, removedStates);
+}
+
+bool SolverAffinitySearcher::empty() {
+  return baseSearcher->empty();
+}
+
+void SolverAffinitySearcher::printName(llvm::raw_ostream &os) {
+  os << "<SolverAffinitySearcher> fairnessBound: " << fairnessBound
+     << ", baseSearcher:\n";
+  baseSearcher->printName(os);
+  os << "</SolverAffinitySearcher>\n";
+}
+
+
 ///
 
 IterativeDeepeningTimeSearcher::IterativeDeepeningTimeSearcher(Searcher *baseSearcher)
@@ -12,15 +12,22 @@
 
 #include "ExecutionState.h"
 #include "PTree.h"
+#include "StateScoring.h"
 #include "klee/ADT/RNG.h"
 #include "klee/System/Time.h"
 
+#include "llvm/ADT/PointerUnion.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/raw_ostream.h"
 
+#include <array>
+#include <cassert>
 #include <map>
+#include <memory>
 #include <queue>
 #include <set>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 namespace llvm {
@@ -31,9 +38,10 @@ namespace llvm {
 }
 
 namespace klee {
-  template<class T, class Comparator> class DiscretePDF;
+  template<class T> class FlatDiscretePDF;
   class ExecutionState;
   class Executor;
+  class KModule;
 
   /// A Searcher implements an exploration strategy for the Executor by selecting
   /// states for further exploration using different strategies or heuristics.
@@ -71,7 +79,10 @@ namespace klee {
       NURS_RP,
       NURS_ICnt,
       NURS_CPICnt,
-      NURS_QC
+      NURS_QC,
+      NURS_SC,
+      ErrorDistance,
+      FeatureScore
     };
   };
 
@@ -120,8 +131,8 @@ namespace klee {
     void printName(llvm::raw_ostream &os) override;
   };
 
-  /// The base class for all weighted searchers. Uses DiscretePDF as underlying
-  /// data structure.
+  /// The base class for all weighted searchers. Uses FlatDiscretePDF as
+  /// underlying data structure.
   class WeightedRandomSearcher final : public Searcher {
   public:
     enum WeightType : std::uint8_t {
@@ -131,21 +142,33 @@ namespace klee {
       InstCount,
       CPInstCount,
       MinDistToUncovered,
-      CoveringNew
+      CoveringNew,
+      /// CoveringNew divided by the solver cost predicted for the state
+      SolverCost
     };
 
   private:
-    std::unique_ptr<DiscretePDF<ExecutionState*, ExecutionStateIDCompare>> states;
+    std::unique_ptr<FlatDiscretePDF<ExecutionState*>> states;
     RNG &theRNG;
     WeightType type;
     bool updateWeights;
-    
+    /// The number of steps of a state between updates of its weight.
+    unsigned updateInterval;
+    /// The state whose weight is out of date, if any.
+    ExecutionState *stale = nullptr;
+    unsigned staleSteps = 0;
+
     double getWeight(ExecutionState*);
+    void updateStale();
 
   public:
     /// \param type The WeightType that determines the underlying heuristic.
     /// \param RNG A random number generator.
-    WeightedRandomSearcher(WeightType type, RNG &rng);
+    /// \param updateInterval The number of consecutive steps of a state
+    /// after which its weight is recomputed. The weight is also recomputed
+    /// once another state is stepped.
+    WeightedRandomSearcher(WeightType type, RNG &rng,
+                           unsigned updateInterval = 1);
     ~WeightedRandomSearcher() override = default;
 
     ExecutionState &selectState() override;
@@ -156,27 +179,208 @@ namespace klee {
     void printName(llvm::raw_ostream &os) override;
   };
 
+  /// StateHeap - A binary min-heap of states ordered by a key and then by
+  /// their ids. It indexes the positions of the states, so that inserting,
+  /// removing and rekeying a state is logarithmic in the number of states.
+  template <typename Key> class StateHeap {
+    struct Entry {
+      ExecutionState *state;
+      Key key;
+    };
+
+    std::vector<Entry> heap;
+    std::unordered_map<const ExecutionState *, std::size_t> positions;
+
+    static bool before(const Entry &a, const Entry &b) {
+      if (a.key != b.key)
+        return a.key < b.key;
+      return a.state->getID() < b.state->getID();
+    }
+
+    void place(std::size_t index, const Entry &entry) {
+      heap[index] = entry;
+      positions[entry.state] = index;
+    }
+
+    void siftUp(std::size_t index) {
+      Entry entry = heap[index];
+      while (index > 0) {
+        std::size_t parent = (index - 1) / 2;
+        if (!before(entry, heap[parent]))
+          break;
+        place(index, heap[parent]);
+        index = parent;
+      }
+      place(index, entry);
+    }
+
+    void siftDown(std::size_t index) {
+      Entry entry = heap[index];
+      for (;;) {
+        std::size_t child = 2 * index + 1;
+        if (child >= heap.size())
+          break;
+        if (child + 1 < heap.size() && before(heap[child + 1], heap[child]))
+          ++child;
+        if (!before(heap[child], entry))
+          break;
+        place(index, heap[child]);
+        index = child;
+      }
+      place(index, entry);
+    }
+
+  public:
+    bool empty() const { return heap.empty(); }
+
+    /// \return The state with the least key.
+    ExecutionState &top() const { return *heap.front().state; }
+
+    void insert(ExecutionState *state, Key key) {
+      heap.push_back({state, key});
+      siftUp(heap.size() - 1);
+    }
+
+    void update(ExecutionState *state, Key key) {
+      std::size_t index = positions[state];
+      heap[index].key = key;
+      siftUp(index);
+      siftDown(positions[state]);
+    }
+
+    void remove(ExecutionState *state) {
+      auto it = positions.find(state);
+      assert(it != positions.end() && "invalid state removed");
+      std::size_t index = it->second;
+      positions.erase(it);
+
+      Entry last = heap.back();
+      heap.pop_back();
+      if (index == heap.size())
+        return;
+      place(index, last);
+      siftUp(index);
+      siftDown(positions[last.state]);
+    }
+  };
+
+  /// ErrorDistances - The distances of states to a call of an error function
+  /// (see Executor::isErrorFunction). Distances in instructions on the
+  /// interprocedural control flow graph are computed once for the module.
+  /// The distance of a state is the minimum over its stack frames of
+  /// reaching a target in that frame, after returning from the frames above.
+  class ErrorDistances {
+    /// Distances to an error call and to a return of the function, indexed
+    /// by instruction id
+    std::vector<std::uint64_t> errorDistance;
+    std::vector<std::uint64_t> returnDistance;
+    const KModule &kmodule;
+
+  public:
+    static const std::uint64_t Unreachable;
+
+    explicit ErrorDistances(const KModule &kmodule);
+
+    std::uint64_t get(const ExecutionState &state) const;
+  };
+
+  /// DistanceToErrorSearcher selects the state closest to a call of an error
+  /// function, see ErrorDistances.
+  class DistanceToErrorSearcher final : public Searcher {
+    ErrorDistances distances;
+    StateHeap<std::uint64_t> states;
+
+  public:
+    explicit DistanceToErrorSearcher(const KModule &kmodule);
+    ~DistanceToErrorSearcher() override = default;
+
+    ExecutionState &selectState() override;
+    void update(ExecutionState *current,
+                const std::vector<ExecutionState *> &addedStates,
+                const std::vector<ExecutionState *> &removedStates) override;
+    bool empty() override;
+    void printName(llvm::raw_ostream &os) override;
+  };
+
+  /// FeatureSearcher selects the state that a ScoringModel scores highest.
+  /// It keeps the StateFeatures of each state and recomputes those of the
+  /// executed state after each step, skipping the features the model does
+  /// not use. The states are kept in a StateHeap by their scores.
+  class FeatureSearcher final : public Searcher {
+    std::unique_ptr<ScoringModel> model;
+    /// Only computed if the model uses the error distance
+    std::unique_ptr<ErrorDistances> errorDistances;
+    std::array<bool, StateFeatures::NumFeatures> used;
+    std::unordered_map<const ExecutionState *, StateFeatures> features;
+    /// Keyed by the negated scores
+    StateHeap<double> states;
+
+    double computeScore(const ExecutionState &state);
+
+  public:
+    /// \param model The scoring model (takes ownership).
+    FeatureSearcher(std::unique_ptr<ScoringModel> model,
+                    const KModule &kmodule);
+    ~FeatureSearcher() override = default;
+
+    /// \return The features of a state, as of its last update.
+    const StateFeatures &getFeatures(const ExecutionState &state) const;
+
+    ExecutionState &selectState() override;
+    void update(ExecutionState *current,
+                const std::vector<ExecutionState *> &addedStates,
+                const std::vector<ExecutionState *> &removedStates) override;
+    bool empty() override;
+    void printName(llvm::raw_ostream &os) override;
+  };
+
   /// RandomPathSearcher performs a random walk of the PTree to select a state.
   /// PTree is a global data structure, however, a searcher can sometimes only
   /// select from a subset of all states (depending on the update calls).
   ///
   /// To support this, RandomPathSearcher has a subgraph view of PTree, in that it
   /// only walks the PTreeNodes that it "owns". Ownership is stored in the
-  /// getInt method of the PTreeNodePtr class (which hides it in the pointer itself).
+  /// tag of the PTreeNodePtr class, which has a bit for each of up to
+  /// MaxRandomPathSearchers instances of the RandomPathSearcher.
   ///
-  /// The current implementation of PTreeNodePtr supports only 3 instances of the
-  /// RandomPathSearcher. This is because the current PTreeNodePtr implementation
-  /// conforms to C++ and only steals the last 3 alignment bits. This restriction
-  /// could be relaxed slightly by an architecture-specific implementation of
-  /// PTreeNodePtr that also steals the top bits of the pointer.
+  /// The walk only flips a coin at nodes where the subgraph branches, so the
+  /// searcher keeps an index of those nodes: for each one the next branch
+  /// node or state on either side, and the branch node above. Selection
+  /// then skips the chains of nodes with a single owned child, which make up
+  /// most of the depth of a deep tree, and costs one step per branch.
   ///
-  /// The ownership bits are maintained in the update method.
+  /// The ownership bits and the index are maintained in the update method.
   class RandomPathSearcher final : public Searcher {
+    /// A branch node or a state, where the walk continues
+    using Target = llvm::PointerUnion<PTreeNode *, ExecutionState *>;
+
+    /// The branch node above a target and the side the target is on
+    struct Link {
+      PTreeNode *branch = nullptr;
+      bool left = false;
+    };
+
+    struct Branch {
+      Target left;
+      Target right;
+      Link up;
+    };
+
     PTree &processTree;
     RNG &theRNG;
 
     // Unique bitmask of this searcher
-    const uint8_t idBitMask;
+    const std::uint64_t idBitMask;
+
+    Target top;
+    std::unordered_map<const PTreeNode *, Branch> branches;
+    std::unordered_map<const ExecutionState *, Link> leaves;
+
+    Target getTarget(PTreeNode *n) const;
+    Link &getLink(Target target);
+    void setTarget(const Link &link, Target target);
+    void insert(ExecutionState *es);
+    void remove(ExecutionState *es);
 
   public:
     /// \param processTree The process tree.
@@ -241,20 +445,39 @@ namespace klee {
   /// BatchingSearcher selects a state from an underlying searcher and returns
   /// that state for further exploration for a given time or a given number
   /// of instructions.
+  ///
+  /// With an adaptive instruction budget, each state keeps its own budget,
+  /// which is adjusted at the end of each of its batches: it grows when the
+  /// batch covered new instructions or was short compared to the cost of
+  /// selecting a state, and it shrinks when the batch was spent mostly in
+  /// the solver.
   class BatchingSearcher final : public Searcher {
     std::unique_ptr<Searcher> baseSearcher;
     time::Span timeBudget;
     unsigned instructionBudget;
+    bool adaptive;
 
     ExecutionState *lastState {nullptr};
     time::Point lastStartTime;
     unsigned lastStartInstructions;
+    std::uint64_t lastStartSolverTime {0};
+    std::uint64_t lastStartCovered {0};
+
+    /// The adaptive instruction budgets of the states, and a moving average
+    /// of the time spent in the underlying searcher per selection.
+    std::unordered_map<const ExecutionState *, unsigned> budgets;
+    time::Span selectionTime;
+
+    unsigned getBudget(const ExecutionState *state) const;
+    void adaptBudget();
 
   public:
     /// \param baseSearcher The underlying searcher (takes ownership).
     /// \param timeBudget Time span a state gets selected before choosing a different one.
     /// \param instructionBudget Number of instructions to re-select a state for.
-    BatchingSearcher(Searcher *baseSearcher, time::Span timeBudget, unsigned instructionBudget);
+    /// \param adaptive Whether the instruction budget is adjusted per state.
+    BatchingSearcher(Searcher *baseSearcher, time::Span timeBudget,
+                     unsigned instructionBudget, bool adaptive = false);
     ~BatchingSearcher() override = default;
 
     ExecutionState &selectState() override;
@@ -265,6 +488,41 @@ namespace klee {
     void printName(llvm::raw_ostream &os) override;
   };
 
+  /// SolverAffinitySearcher keeps selecting states of the lineage of the
+  /// last selected state: that state and the states forked from it since it
+  /// was selected. These share a prefix of their constraints, which an
+  /// incremental solver (see --z3-incremental-contexts) keeps asserted
+  /// between their queries. The choice of the underlying searcher is taken
+  /// once it chose states of other lineages a given number of times.
+  class SolverAffinitySearcher final : public Searcher {
+    std::unique_ptr<Searcher> baseSearcher;
+    unsigned fairnessBound;
+
+    ExecutionState *lastState {nullptr};
+    /// The states of the current lineage, the most recently forked last
+    std::vector<ExecutionState *> lineage;
+    std::unordered_set<const ExecutionState *> lineageStates;
+    /// Selections of the lineage in favor of the underlying searcher since
+    /// it last chose a state of another lineage
+    unsigned overrides {0};
+
+    bool inLineage(const ExecutionState *state) const;
+
+  public:
+    /// \param baseSearcher The underlying searcher (takes ownership).
+    /// \param fairnessBound Number of selections of the underlying searcher
+    /// a lineage may override.
+    SolverAffinitySearcher(Searcher *baseSearcher, unsigned fairnessBound);
+    ~SolverAffinitySearcher() override = default;
+
+    ExecutionState &selectState() override;
+    void update(ExecutionState *current,
+                const std::vector<ExecutionState *> &addedStates,
+                const std::vector<ExecutionState *> &removedStates) override;
+    bool empty() override;
+    void printName(llvm::raw_ostream &os) override;
+  };
+
   /// IterativeDeepeningTimeSearcher implements time-based deepening. States
   /// are selected from an underlying searcher. When a state reaches its time
   /// limit it is paused (removed from underlying searcher). When the underlying
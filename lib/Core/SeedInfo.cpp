@@ -61,6 +61,20 @@ KTestObject *SeedInfo::getNextInput(const MemoryObject *mo,
   }
 }
 
+KTestObject *SeedInfo::getNondetInput(const std::string &name) {
+  for (unsigned i = 0; i < input->numObjects; ++i) {
+    KTestObject *obj = &input->objects[i];
+    llvm::StringRef objName(obj->name);
+    // the offsets of nondet pointers are not seeded
+    if (objName.endswith("(offset)"))
+      continue;
+    if ((objName == name || objName.startswith(name + ":")) &&
+        used.insert(obj).second)
+      return obj;
+  }
+  return nullptr;
+}
+
 void SeedInfo::patchSeed(const ExecutionState &state, 
                          ref<Expr> condition,
                          TimingSolver *solver) {
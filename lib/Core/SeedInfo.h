@@ -25,6 +25,8 @@ namespace klee {
   class SeedInfo {
   public:
     VectorAssignment assignment;
+    /// The seed, the bytes of its objects may point into a mapping of its
+    /// file and are only read once they are used, see kTest_mapFile.
     KTest *input;
     unsigned inputPosition;
     std::set<struct KTestObject*> used;
@@ -37,6 +39,10 @@ namespace klee {
     
     KTestObject *getNextInput(const MemoryObject *mo,
                              bool byName);
+
+    /// The first unused input of the nondet value of the given name, whose
+    /// inputs are named after the location the value is made at.
+    KTestObject *getNondetInput(const std::string &name);
     
     /// Patch the seed so that condition is satisfied while retaining as
     /// many of the seed values as possible.
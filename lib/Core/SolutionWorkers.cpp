@@ -0,0 +1,168 @@
+//===-- SolutionWorkers.cpp -----------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "SolutionWorkers.h"
+
+#include "klee/Support/ErrorHandling.h"
+
+#include "llvm/Support/Endian.h"
+#include "llvm/Support/Errno.h"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace klee;
+
+namespace {
+struct Worker {
+  pid_t pid;
+  /// the unnamed file the worker writes its solutions to
+  FILE *file;
+};
+
+void append32(std::string &buffer, uint32_t value) {
+  char bytes[4];
+  llvm::support::endian::write32le(bytes, value);
+  buffer.append(bytes, 4);
+}
+
+/// Write a record per solved problem: its index, the number of objects,
+/// and for each object the length and bytes of its name and value.
+void writeSolutions(int fd, unsigned index, unsigned numProcesses,
+                    size_t count,
+                    const std::function<bool(size_t, SymbolicSolution &)> &solve) {
+  for (size_t i = index; i < count; i += numProcesses) {
+    SymbolicSolution solution;
+    if (!solve(i, solution))
+      continue;
+    std::string record;
+    append32(record, i);
+    append32(record, solution.size());
+    for (const auto &object : solution) {
+      append32(record, object.first.size());
+      record += object.first;
+      append32(record, object.second.size());
+      record.append(object.second.begin(), object.second.end());
+    }
+    const char *p = record.data();
+    size_t left = record.size();
+    while (left) {
+      ssize_t n = write(fd, p, left);
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n <= 0)
+        return;
+      p += n;
+      left -= n;
+    }
+  }
+}
+
+/// Parse the records of a worker, up to the first incomplete one.
+void readSolutions(const std::string &data, size_t count,
+                   std::vector<std::unique_ptr<SymbolicSolution>> &solutions) {
+  const char *p = data.data();
+  const char *end = p + data.size();
+  auto read32 = [&](uint32_t &value) {
+    if (end - p < 4)
+      return false;
+    value = llvm::support::endian::read32le(p);
+    p += 4;
+    return true;
+  };
+  auto readBytes = [&](uint32_t size, const char *&bytes) {
+    if (static_cast<size_t>(end - p) < size)
+      return false;
+    bytes = p;
+    p += size;
+    return true;
+  };
+
+  uint32_t index, numObjects;
+  while (read32(index) && read32(numObjects)) {
+    auto solution = std::make_unique<SymbolicSolution>();
+    for (uint32_t i = 0; i < numObjects; ++i) {
+      uint32_t nameSize, valueSize;
+      const char *name, *value;
+      if (!read32(nameSize) || !readBytes(nameSize, name) ||
+          !read32(valueSize) || !readBytes(valueSize, value))
+        return;
+      solution->emplace_back(std::string(name, nameSize),
+                             std::vector<unsigned char>(value, value + valueSize));
+    }
+    if (index < count)
+      solutions[index] = std::move(solution);
+  }
+}
+} // namespace
+
+std::vector<std::unique_ptr<SymbolicSolution>> klee::solveInWorkers(
+    unsigned numProcesses, size_t count,
+    const std::function<bool(size_t, SymbolicSolution &)> &solve) {
+  std::vector<std::unique_ptr<SymbolicSolution>> solutions(count);
+  if (!numProcesses)
+    numProcesses = 1;
+
+  // the problems of the workers that could not be started are solved here
+  std::vector<Worker> workers;
+  std::vector<size_t> local;
+  fflush(nullptr);
+  for (unsigned w = 1; w < numProcesses; ++w) {
+    // a file instead of a pipe, so the workers never wait for this process
+    FILE *file = std::tmpfile();
+    pid_t pid = -1;
+    if (!file) {
+      klee_warning("tmpfile failed (for solution workers) - %s",
+                   llvm::sys::StrError(errno).c_str());
+    } else if ((pid = fork()) < 0) {
+      klee_warning("fork failed (for solution workers) - %s",
+                   llvm::sys::StrError(errno).c_str());
+      fclose(file);
+    }
+    if (pid < 0) {
+      for (size_t i = w; i < count; i += numProcesses)
+        local.push_back(i);
+      continue;
+    }
+    if (pid == 0) {
+      writeSolutions(fileno(file), w, numProcesses, count, solve);
+      fflush(nullptr);
+      _exit(0);
+    }
+    workers.push_back({pid, file});
+  }
+
+  for (size_t i = 0; i < count; i += numProcesses)
+    local.push_back(i);
+  for (size_t i : local) {
+    auto solution = std::make_unique<SymbolicSolution>();
+    if (solve(i, *solution))
+      solutions[i] = std::move(solution);
+  }
+
+  for (const Worker &worker : workers) {
+    int status;
+    while (waitpid(worker.pid, &status, 0) < 0 && errno == EINTR)
+      ;
+    // the worker shared the file offset, so read from the start
+    std::string data;
+    char buffer[4096];
+    if (fseek(worker.file, 0, SEEK_SET) == 0) {
+      size_t n;
+      while ((n = fread(buffer, 1, sizeof(buffer), worker.file)) > 0)
+        data.append(buffer, n);
+    }
+    fclose(worker.file);
+    readSolutions(data, count, solutions);
+  }
+  return solutions;
+}
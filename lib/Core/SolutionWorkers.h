@@ -0,0 +1,36 @@
+//===-- SolutionWorkers.h ---------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_SOLUTIONWORKERS_H
+#define KLEE_SOLUTIONWORKERS_H
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace klee {
+
+/// The inputs of a test case, as computed by Executor::getSymbolicSolution.
+using SymbolicSolution =
+    std::vector<std::pair<std::string, std::vector<unsigned char>>>;
+
+/// Solve count problems with up to numProcesses processes: this one and
+/// forked workers, each with its own copy of the solver and its caches
+/// (see --dump-states-workers). Problem i is solved by solve(i, solution)
+/// in process i % numProcesses. \return the solutions, null for the
+/// problems that could not be solved or whose worker failed
+std::vector<std::unique_ptr<SymbolicSolution>>
+solveInWorkers(unsigned numProcesses, size_t count,
+               const std::function<bool(size_t, SymbolicSolution &)> &solve);
+
+} // namespace klee
+
+#endif /* KLEE_SOLUTIONWORKERS_H */
@@ -33,7 +33,9 @@
 #include "llvm/IR/Module.h"
 #include "llvm/IR/Instructions.h"
 
+#include <algorithm>
 #include <cerrno>
+#include <cstring>
 #include <sstream>
 
 using namespace llvm;
@@ -60,8 +62,40 @@ cl::opt<bool>
                      cl::desc("Make malloc'ed memory symbolic "
                               "(default=false)"));
 
+cl::opt<bool> NativeMemoryFunctions(
+    "native-memory-functions", cl::init(true),
+    cl::desc("Execute memcpy, memmove, memset and memcmp on constant "
+             "pointers and sizes, and strlen, strcmp, strchr and strncpy on "
+             "concrete strings, directly on the memory objects instead of "
+             "running their definitions (default=true)"),
+    cl::cat(MiscCat));
+
+cl::opt<bool> LazyInitNondetPointers(
+    "lazy-init-nondet-pointers", cl::init(false),
+    cl::desc("Let __VERIFIER_nondet_pointer and __VERIFIER_nondet_pchar "
+             "return null, a fresh symbolic object or an object they "
+             "returned before at the same call site, instead of an "
+             "unconstrained pointer (default=false)"),
+    cl::cat(MiscCat));
+
+cl::opt<unsigned> LazyInitFanout(
+    "lazy-init-fanout", cl::init(2),
+    cl::desc("Maximum number of earlier objects a lazily initialized "
+             "nondet pointer may point to (default=2)"),
+    cl::cat(MiscCat));
+
+cl::opt<unsigned> LazyInitObjectSize(
+    "lazy-init-object-size", cl::init(64),
+    cl::desc("Size in bytes of the fresh objects of lazily initialized "
+             "nondet pointers whose pointee type is unknown (default=64)"),
+    cl::cat(MiscCat));
+
 } // namespace
 
+static bool resolveConstantRange(const ExecutionState &state,
+                                 const Cell &pointer, uint64_t size,
+                                 ObjectPair &op, unsigned &offset);
+
 /// \todo Almost all of the demands in this file should be replaced
 /// with terminateState calls.
 
@@ -94,6 +128,7 @@ static SpecialFunctionHandler::HandlerInfo handlerInfo[] = {
   add("free", handleFree, false),
   add("klee_assume", handleAssume, false),
   add("klee_check_memory_access", handleCheckMemoryAccess, false),
+  add("klee_copy_file_bytes", handleCopyFileBytes, false),
   add("klee_get_valuef", handleGetValue, true),
   add("klee_get_valued", handleGetValue, true),
   add("klee_get_valuel", handleGetValue, true),
@@ -176,21 +211,44 @@ static SpecialFunctionHandler::HandlerInfo handlerInfo[] = {
 
   add("pthread_create", handlePthreadCreate, true),
   add("pthread_join", handlePthreadJoin, true),
+  addDNR("pthread_exit", handlePthreadExit),
+  add("pthread_self", handlePthreadSelf, true),
+  add("pthread_mutex_init", handlePthreadMutexInit, true),
+  add("pthread_mutex_destroy", handlePthreadMutexDestroy, true),
+  add("pthread_mutex_lock", handlePthreadMutexLock, true),
+  add("pthread_mutex_trylock", handlePthreadMutexTrylock, true),
+  add("pthread_mutex_unlock", handlePthreadMutexUnlock, true),
+  add("__VERIFIER_atomic_begin", handleAtomicBegin, false),
+  add("__VERIFIER_atomic_end", handleAtomicEnd, false),
   add("pthread_key_create", handleUnsupportedPthread, true),
   add("pthread_setspecific", handleUnsupportedPthread, true),
   add("pthread_getspecific", handleUnsupportedPthread, true),
   add("scanf", handleScanf, true),
   add("__isoc99_scanf", handleScanf, true),
-  add("__isoc99_wscanf", handleScanf, true),
+  add("__isoc99_wscanf", handleWideScanf, true),
   add("fscanf", handleFscanf, true),
   add("__isoc99_fscanf", handleFscanf, true),
   add("__isoc99_sscanf", handleFscanf, true),
-  add("__isoc99_swscanf", handleFscanf, true),
+  add("__isoc99_swscanf", handleWideFscanf, true),
 
 #undef addDNR
 #undef add
 };
 
+static const struct {
+  const char *name;
+  SpecialFunctionHandler::FastPath handler;
+} fastPathInfo[] = {
+    {"memcmp", &SpecialFunctionHandler::handleMemcmp},
+    {"memcpy", &SpecialFunctionHandler::handleMemcpy},
+    {"memmove", &SpecialFunctionHandler::handleMemmove},
+    {"memset", &SpecialFunctionHandler::handleMemset},
+    {"strchr", &SpecialFunctionHandler::handleStrchr},
+    {"strcmp", &SpecialFunctionHandler::handleStrcmp},
+    {"strlen", &SpecialFunctionHandler::handleStrlen},
+    {"strncpy", &SpecialFunctionHandler::handleStrncpy},
+};
+
 SpecialFunctionHandler::const_iterator SpecialFunctionHandler::begin() {
   return SpecialFunctionHandler::const_iterator(handlerInfo);
 }
@@ -244,7 +302,8 @@ void SpecialFunctionHandler::prepare(
   }
 }
 
-void SpecialFunctionHandler::bind() {
+void SpecialFunctionHandler::bind(
+    const std::set<std::string> &programFunctions) {
   unsigned N = size();
 
   for (unsigned i=0; i<N; ++i) {
@@ -254,6 +313,15 @@ void SpecialFunctionHandler::bind() {
     if (f && (!hi.doNotOverride || f->isDeclaration()))
       handlers[f] = std::make_pair(hi.handler, hi.hasReturnValue);
   }
+
+  // only the libc functions are replaced, the program's own functions of
+  // the same names run as they are
+  if (NativeMemoryFunctions) {
+    for (const auto &fp : fastPathInfo)
+      if (Function *f = executor.kmodule->module->getFunction(fp.name))
+        if (!programFunctions.count(fp.name))
+          fastPaths[f] = fp.handler;
+  }
 }
 
 
@@ -278,6 +346,16 @@ bool SpecialFunctionHandler::handle(ExecutionState &state,
   }
 }
 
+bool SpecialFunctionHandler::handleFastPath(
+    ExecutionState &state, Function *f, KInstruction *target,
+    const std::vector<Cell> &arguments) {
+  fast_paths_ty::iterator it = fastPaths.find(f);
+  // the reads of the definition are made symbolic
+  if (it == fastPaths.end() || executor.interpreterOpts.MakeConcreteSymbolic)
+    return false;
+  return (this->*(it->second))(state, target, arguments);
+}
+
 /****/
 
 // reads a concrete string from memory
@@ -895,6 +973,64 @@ void SpecialFunctionHandler::handleCheckMemoryAccess(ExecutionState &state,
   }
 }
 
+void SpecialFunctionHandler::handleCopyFileBytes(ExecutionState &state,
+                                                 KInstruction *target,
+                                                 const std::vector<Cell>
+                                                   &arguments) {
+  assert(arguments.size()==3 &&
+         "invalid number of arguments to klee_copy_file_bytes");
+
+  // a symbolic count copies up to its largest value, keeping the bytes past
+  // the count
+  ref<Expr> count = executor.toUnique(state, arguments[2].getValue());
+  uint64_t maxCount;
+  if (auto *CE = dyn_cast<ConstantExpr>(count))
+    maxCount = CE->getZExtValue();
+  else
+    maxCount = executor.solver
+                   ->getRange(state.constraints, count, state.queryMetaData)
+                   .second->getZExtValue();
+  if (!maxCount)
+    return;
+
+  ObjectPair dst, src;
+  unsigned dstOffset, srcOffset;
+  for (unsigned i = 0; i < 2; ++i) {
+    ObjectPair &op = i ? src : dst;
+    if (!resolveConstantRange(state, arguments[i], maxCount, op,
+                              i ? srcOffset : dstOffset) ||
+        (!i && op.second->readOnly)) {
+      executor.terminateStateOnError(state,
+                                     "klee_copy_file_bytes: memory error",
+                                     StateTerminationType::Ptr,
+                                     executor.getKValueInfo(state,
+                                                            arguments[i]));
+      return;
+    }
+  }
+
+  ObjectState *wos = state.addressSpace.getWriteable(dst.first, dst.second);
+  const ObjectState &ros = dst.first == src.first ? *wos : *src.second;
+  if (isa<ConstantExpr>(count)) {
+    wos->copy(dstOffset, ros, srcOffset, maxCount);
+    return;
+  }
+
+  // all bytes are read before any is written, the ranges may overlap
+  std::vector<KValue> bytes;
+  bytes.reserve(maxCount);
+  for (unsigned i = 0; i < maxCount; ++i) {
+    ref<Expr> copied = UltExpr::create(ConstantExpr::alloc(i, count->getWidth()),
+                                       count);
+    KValue from = ros.read8(srcOffset + i), to = wos->read8(dstOffset + i);
+    bytes.emplace_back(
+        SelectExpr::create(copied, from.getSegment(), to.getSegment()),
+        SelectExpr::create(copied, from.getValue(), to.getValue()));
+  }
+  for (unsigned i = 0; i < maxCount; ++i)
+    wos->write(dstOffset + i, bytes[i]);
+}
+
 void SpecialFunctionHandler::handleGetValue(ExecutionState &state,
                                             KInstruction *target,
                                             const std::vector<Cell> &arguments) {
@@ -931,7 +1067,7 @@ void SpecialFunctionHandler::handleDefineFixedObject(ExecutionState &state,
 
   MemoryObject *mo = executor.memory->allocateFixed(size, state.prevPC->inst);
   executor.bindObjectInState(state, mo, false);
-  state.addressSpace.concreteAddressMap.emplace(address, mo->segment);
+  state.addressSpace.addConcreteAddress(address, mo->segment);
   state.addressSpace.segmentMap.insert(std::make_pair(mo->segment, mo));
   mo->isUserSpecified = true; // XXX hack;
 }
@@ -990,7 +1126,7 @@ void SpecialFunctionHandler::handleMakeSymbolic(ExecutionState &state,
         "Incorrect number of arguments to klee_make_symbolic(void*, size_t, char*)");
     return;
   }
-  bool isZero = arguments[2].pointerSegment->isZero() && arguments[2].value->isZero();
+  bool isZero = arguments[2].isZero();
   name = isZero ? "" : readStringAtAddress(state, arguments[2]);
 
   if (name.length() == 0) {
@@ -1041,8 +1177,7 @@ void SpecialFunctionHandler::putConcreteValue(ExecutionState& state,
   // bind the new concrete value
   executor.bindLocal(target, state, expr);
   // store it in the vector of nondets, so that we have them in the test output
-  auto& nnv = state.addNondetValue(KValue(expr), isSigned, name);
-  nnv.kinstruction = target;
+  state.addNondetValue(KValue(expr), isSigned, target, name);
 }
 
 void SpecialFunctionHandler::handleVerifierNondetType(ExecutionState &state,
@@ -1052,7 +1187,7 @@ void SpecialFunctionHandler::handleVerifierNondetType(ExecutionState &state,
                                                       const std::string& name,
                                                       bool isPointer) {
   // create nondet value if we are not replaying
-  if (executor.replayNondet.empty()) {
+  if (executor.replayNondet.empty() && !executor.concreteReplay) {
     executor.bindLocal(target, state,
                        executor.createNondetValue(state, size,
                                                   isSigned, target,
@@ -1073,7 +1208,7 @@ void SpecialFunctionHandler::handleVerifierNondetType(ExecutionState &state,
   }
 
   // position in the nondet vector we're in
-  static unsigned position = 0;
+  unsigned &position = executor.replayNondetPosition;
 
   if (position >= executor.replayNondet.size()) {
    //klee_warning("Got out of nondet values while replaying, using nondet");
@@ -1081,7 +1216,9 @@ void SpecialFunctionHandler::handleVerifierNondetType(ExecutionState &state,
    //                   executor.createNondetValue(state, size,
    //                                              isSigned, target, name));
 
-    klee_warning("Got out of nondet values while replaying, using 0");
+    // a fuzzer's inputs are zero-extended
+    if (!executor.fuzzing)
+      klee_warning("Got out of nondet values while replaying, using 0");
     putConcreteValue(state, name, isSigned,
                      target, ConstantExpr::alloc(0, size));
     return;
@@ -1090,9 +1227,12 @@ void SpecialFunctionHandler::handleVerifierNondetType(ExecutionState &state,
   auto& nondet = executor.replayNondet[position];
   //klee_warning("Matching %s:%u:%u", name.c_str(), info->line, info->column);
 
-  if (std::get<0>(nondet) == name &&
-      std::get<1>(nondet) == info->line &&
-      std::get<2>(nondet) == info->column) {
+  // a fuzzer's inputs are taken in order wherever they were made, as its
+  // mutations change the path
+  if (executor.fuzzing ||
+      (std::get<0>(nondet) == name &&
+       std::get<1>(nondet) == info->line &&
+       std::get<2>(nondet) == info->column)) {
       auto& val = std::get<3>(nondet);
 
      //klee_warning("Matched nondet value for: %s:%u:%u to %lu",
@@ -1221,6 +1361,12 @@ void SpecialFunctionHandler::handleVerifierNondetPointer(ExecutionState &state,
                                                          const std::vector<Cell> &arguments) {
   assert(arguments.empty() && "Wrong number of arguments");
 
+  if (LazyInitNondetPointers && executor.replayNondet.empty() &&
+      !executor.concreteReplay) {
+    lazyInitializePointer(state, target, "__VERIFIER_nondet_pointer");
+    return;
+  }
+
   handleVerifierNondetType(state, target, Expr::Int64, // XXX: fixme
                            /* isSigned = */ false, "__VERIFIER_nondet_pointer",
                            /* isPointer = */ true);
@@ -1231,11 +1377,86 @@ void SpecialFunctionHandler::handleVerifierNondetPChar(ExecutionState &state,
                                                        const std::vector<Cell> &arguments) {
   assert(arguments.empty() && "Wrong number of arguments");
 
+  if (LazyInitNondetPointers && executor.replayNondet.empty() &&
+      !executor.concreteReplay) {
+    lazyInitializePointer(state, target, "__VERIFIER_nondet_pchar");
+    return;
+  }
+
   handleVerifierNondetType(state, target, Expr::Int64, // XXX: fixme
                            /* isSigned = */ false, "__VERIFIER_nondet_pchar",
                            /* isPointer = */ true);
 }
 
+/// The size of the objects a nondet pointer returned by inst points to: the
+/// pointee type it is cast to, if any.
+static uint64_t getLazyObjectSize(const llvm::Instruction *inst,
+                                  const llvm::DataLayout &dataLayout) {
+  for (const llvm::User *user : inst->users()) {
+    auto *cast = dyn_cast<llvm::BitCastInst>(user);
+    if (!cast || !cast->getType()->isPointerTy())
+      continue;
+    llvm::Type *pointee = cast->getType()->getPointerElementType();
+    if (pointee->isSized())
+      return dataLayout.getTypeAllocSize(pointee);
+  }
+  return LazyInitObjectSize;
+}
+
+void SpecialFunctionHandler::lazyInitializePointer(ExecutionState &state,
+                                                   KInstruction *target,
+                                                   const std::string &name) {
+  // the nondet value itself stays symbolic for the test cases, each choice
+  // constrains it to one object
+  KValue pointer = executor.createNondetValue(state, Expr::Int64, false,
+                                              target, name, true);
+  ref<Expr> isZeroOffset = Expr::createIsZero(pointer.getOffset());
+  auto pointsTo = [&](const MemoryObject *mo) {
+    return AndExpr::create(
+        EqExpr::create(pointer.getSegment(),
+                       ConstantExpr::create(mo->segment,
+                                            pointer.getSegment()->getWidth())),
+        isZeroOffset);
+  };
+
+  std::vector<ref<Expr>> conditions{pointer.createIsZero()};
+  std::vector<const MemoryObject *> objects{nullptr};
+  for (const auto &binding : state.addressSpace.objects) {
+    if (objects.size() > LazyInitFanout)
+      break;
+    if (binding.first->allocSite == target->inst) {
+      conditions.push_back(pointsTo(binding.first));
+      objects.push_back(binding.first);
+    }
+  }
+
+  uint64_t size =
+      getLazyObjectSize(target->inst, *executor.kmodule->targetData);
+  ref<MemoryObject> fresh = executor.memory->allocate(
+      size, /*isLocal=*/false, /*isGlobal=*/false, target->inst,
+      executor.getAllocationAlignment(target->inst));
+  if (fresh) {
+    conditions.push_back(pointsTo(fresh.get()));
+    objects.push_back(fresh.get());
+  }
+
+  std::vector<ExecutionState *> branches;
+  executor.branch(state, conditions, branches, BranchType::ResolvePointer);
+  for (unsigned i = 0; i < branches.size(); ++i) {
+    ExecutionState *es = branches[i];
+    if (!es)
+      continue;
+    if (!objects[i]) {
+      executor.bindLocal(target, *es, KValue(Expr::createPointer(0)));
+      continue;
+    }
+    if (objects[i] == fresh.get())
+      executor.executeMakeSymbolic(*es, fresh.get(),
+                                   name + "_obj" + std::to_string(fresh->id));
+    executor.bindLocal(target, *es, objects[i]->getPointer());
+  }
+}
+
 void SpecialFunctionHandler::handleVerifierNondetPthreadT(ExecutionState &state,
                                                           KInstruction *target,
                                                           const std::vector<Cell> &arguments) {
@@ -1319,15 +1540,164 @@ void SpecialFunctionHandler::handleMarkGlobal(ExecutionState &state,
 void SpecialFunctionHandler::handlePthreadCreate(ExecutionState &state,
                                                  KInstruction *target,
                                                  const std::vector<Cell> &arguments) {
-  executor.terminateStateOnExecError(state,
-        "Call to pthread_create.");
+  assert(arguments.size() == 4 &&
+         "invalid number of arguments to pthread_create");
+  std::uint32_t id;
+  if (!executor.createThread(state, arguments[2], arguments[3], id))
+    return;
+  executor.bindLocal(target, state, ConstantExpr::create(0, Expr::Int32));
+  // pthread_t is an unsigned long
+  executor.executeMemoryOperation(
+      state, true, arguments[0],
+      ConstantExpr::create(id, Context::get().getPointerWidth()), nullptr);
 }
 
 void SpecialFunctionHandler::handlePthreadJoin(ExecutionState &state,
                                                KInstruction *target,
                                                const std::vector<Cell> &arguments) {
-  executor.terminateStateOnExecError(state,
-        "Call to pthread_join.");
+  assert(arguments.size() == 2 &&
+         "invalid number of arguments to pthread_join");
+  ref<Expr> thread = executor.toUnique(state, arguments[0].value);
+  if (!isa<ConstantExpr>(thread)) {
+    executor.terminateStateOnExecError(state,
+                                       "pthread_join of a symbolic thread");
+    return;
+  }
+  uint64_t id = cast<ConstantExpr>(thread)->getZExtValue();
+  if (id >= state.threads.size() || id == state.currentThread) {
+    // ESRCH or EDEADLK
+    executor.bindLocal(
+        target, state,
+        ConstantExpr::create(id == state.currentThread ? 35 : 3, Expr::Int32));
+    return;
+  }
+  // the thread was only scheduled with the joined one exited, unless it
+  // could not be switched
+  if (!state.threads[id].exited) {
+    executor.terminateStateOnError(state,
+                                   "deadlock: joined thread cannot exit",
+                                   StateTerminationType::Deadlock);
+    return;
+  }
+  executor.bindLocal(target, state, ConstantExpr::create(0, Expr::Int32));
+  if (!arguments[1].isZero())
+    executor.executeMemoryOperation(state, true, arguments[1],
+                                    state.threads[id].exitValue, nullptr);
+}
+
+void SpecialFunctionHandler::handlePthreadExit(ExecutionState &state,
+                                               KInstruction *target,
+                                               const std::vector<Cell> &arguments) {
+  assert(arguments.size() == 1 &&
+         "invalid number of arguments to pthread_exit");
+  executor.exitThread(state, arguments[0]);
+}
+
+void SpecialFunctionHandler::handlePthreadSelf(ExecutionState &state,
+                                               KInstruction *target,
+                                               const std::vector<Cell> &arguments) {
+  assert(arguments.empty() && "invalid number of arguments to pthread_self");
+  executor.bindLocal(target, state,
+                     ConstantExpr::create(state.currentThread,
+                                          Context::get().getPointerWidth()));
+}
+
+void SpecialFunctionHandler::handlePthreadMutexInit(ExecutionState &state,
+                                                    KInstruction *target,
+                                                    const std::vector<Cell> &arguments) {
+  assert(arguments.size() == 2 &&
+         "invalid number of arguments to pthread_mutex_init");
+  MutexAddress mutex;
+  if (!executor.getMutexAddress(state, arguments[0], mutex))
+    return;
+  state.heldMutexes = state.heldMutexes.remove(mutex);
+  executor.bindLocal(target, state, ConstantExpr::create(0, Expr::Int32));
+}
+
+void SpecialFunctionHandler::handlePthreadMutexDestroy(ExecutionState &state,
+                                                       KInstruction *target,
+                                                       const std::vector<Cell> &arguments) {
+  assert(arguments.size() == 1 &&
+         "invalid number of arguments to pthread_mutex_destroy");
+  MutexAddress mutex;
+  if (!executor.getMutexAddress(state, arguments[0], mutex))
+    return;
+  // EBUSY
+  executor.bindLocal(
+      target, state,
+      ConstantExpr::create(state.heldMutexes.count(mutex) ? 16 : 0,
+                           Expr::Int32));
+}
+
+void SpecialFunctionHandler::handlePthreadMutexLock(ExecutionState &state,
+                                                    KInstruction *target,
+                                                    const std::vector<Cell> &arguments) {
+  assert(arguments.size() == 1 &&
+         "invalid number of arguments to pthread_mutex_lock");
+  MutexAddress mutex;
+  if (!executor.getMutexAddress(state, arguments[0], mutex))
+    return;
+  // the thread was only scheduled with the mutex free, unless it could not
+  // be switched
+  if (state.heldMutexes.count(mutex)) {
+    executor.terminateStateOnError(state,
+                                   "deadlock: locking a mutex that is held",
+                                   StateTerminationType::Deadlock);
+    return;
+  }
+  state.heldMutexes = state.heldMutexes.insert({mutex, state.currentThread});
+  executor.bindLocal(target, state, ConstantExpr::create(0, Expr::Int32));
+}
+
+void SpecialFunctionHandler::handlePthreadMutexTrylock(ExecutionState &state,
+                                                       KInstruction *target,
+                                                       const std::vector<Cell> &arguments) {
+  assert(arguments.size() == 1 &&
+         "invalid number of arguments to pthread_mutex_trylock");
+  MutexAddress mutex;
+  if (!executor.getMutexAddress(state, arguments[0], mutex))
+    return;
+  if (state.heldMutexes.count(mutex)) {
+    // EBUSY
+    executor.bindLocal(target, state, ConstantExpr::create(16, Expr::Int32));
+    return;
+  }
+  state.heldMutexes = state.heldMutexes.insert({mutex, state.currentThread});
+  executor.bindLocal(target, state, ConstantExpr::create(0, Expr::Int32));
+}
+
+void SpecialFunctionHandler::handlePthreadMutexUnlock(ExecutionState &state,
+                                                      KInstruction *target,
+                                                      const std::vector<Cell> &arguments) {
+  assert(arguments.size() == 1 &&
+         "invalid number of arguments to pthread_mutex_unlock");
+  MutexAddress mutex;
+  if (!executor.getMutexAddress(state, arguments[0], mutex))
+    return;
+  const auto *owner = state.heldMutexes.lookup(mutex);
+  if (!owner || owner->second != state.currentThread) {
+    // EPERM
+    executor.bindLocal(target, state, ConstantExpr::create(1, Expr::Int32));
+    return;
+  }
+  state.heldMutexes = state.heldMutexes.remove(mutex);
+  executor.bindLocal(target, state, ConstantExpr::create(0, Expr::Int32));
+}
+
+void SpecialFunctionHandler::handleAtomicBegin(ExecutionState &state,
+                                               KInstruction *target,
+                                               const std::vector<Cell> &arguments) {
+  assert(arguments.empty() &&
+         "invalid number of arguments to __VERIFIER_atomic_begin");
+  state.inAtomicSection = true;
+}
+
+void SpecialFunctionHandler::handleAtomicEnd(ExecutionState &state,
+                                             KInstruction *target,
+                                             const std::vector<Cell> &arguments) {
+  assert(arguments.empty() &&
+         "invalid number of arguments to __VERIFIER_atomic_end");
+  state.inAtomicSection = false;
 }
 
 void SpecialFunctionHandler::handleUnsupportedPthread(ExecutionState &state,
@@ -1337,18 +1707,120 @@ void SpecialFunctionHandler::handleUnsupportedPthread(ExecutionState &state,
         "unsupported pthread API.");
 }
 
-void SpecialFunctionHandler::handleScanf(ExecutionState &state,
-                                         KInstruction *target,
-                                         const std::vector<Cell> &arguments) {
-  size_t size = arguments.size();
-  if (size < 2) {
-    executor.terminateStateOnExecError(state, "unsupported function model");
-    return;
+namespace {
+
+/// What a conversion of a scanf format stores through its argument.
+struct ScanfStore {
+  /// The bits of the value stored, 0 if the whole object becomes symbolic
+  /// (strings and values of other widths).
+  unsigned width;
+  bool isSigned;
+  /// The conversion counts in the return value, i.e. it is not %n.
+  bool isCounted;
+};
+
+/// The bits of an integer with the given length modifier, 0 if unknown.
+unsigned getScanfIntegerWidth(const std::string &length) {
+  if (length.empty())
+    return Expr::Int32;
+  if (length == "hh")
+    return Expr::Int8;
+  if (length == "h")
+    return Expr::Int16;
+  if (length == "l" || length == "z" || length == "t")
+    return Context::get().getPointerWidth();
+  if (length == "ll" || length == "q" || length == "L" || length == "j")
+    return Expr::Int64;
+  return 0;
+}
+
+/// Collect the stores of the conversions in a scanf format, in the order of
+/// their arguments.
+/// \return false if the format uses something that is not modelled
+bool parseScanfFormat(const std::string &format,
+                      std::vector<ScanfStore> &stores) {
+  size_t size = format.size();
+  for (size_t i = 0; i < size; ++i) {
+    if (format[i] != '%')
+      continue;
+    if (++i == size)
+      return false;
+    if (format[i] == '%')
+      continue;
+    bool suppressed = format[i] == '*';
+    if (suppressed)
+      ++i;
+    bool hasFieldWidth = false;
+    for (; i < size && isdigit(format[i]); ++i)
+      hasFieldWidth = true;
+    std::string length;
+    for (; i < size && strchr("hljztLqm", format[i]); ++i)
+      length += format[i];
+    // positional and allocating conversions
+    if (i == size || format[i] == '$' || length.find('m') != std::string::npos)
+      return false;
+
+    char conversion = format[i];
+    if (conversion == '[') {
+      // a ']' right at the start is part of the set
+      size_t first = i + 1 < size && format[i + 1] == '^' ? i + 2 : i + 1;
+      i = format.find(']', first + 1);
+      if (i == std::string::npos)
+        return false;
+    }
+    if (suppressed)
+      continue;
+
+    ScanfStore store{0, false, conversion != 'n'};
+    switch (conversion) {
+    case 'd':
+    case 'i':
+      store.isSigned = true;
+      LLVM_FALLTHROUGH;
+    case 'u':
+    case 'o':
+    case 'x':
+    case 'X':
+    case 'n':
+      store.width = getScanfIntegerWidth(length);
+      if (!store.width)
+        return false;
+      break;
+    case 'a':
+    case 'e':
+    case 'f':
+    case 'g':
+    case 'A':
+    case 'E':
+    case 'F':
+    case 'G':
+      // long double is left to the symbolic object
+      store.width = length.empty() ? Expr::Int32
+                    : length == "l" ? Expr::Int64 : 0;
+      break;
+    case 'p':
+      store.width = Context::get().getPointerWidth();
+      break;
+    case 'c':
+      store.width = hasFieldWidth ? 0 : Expr::Int8;
+      break;
+    case 's':
+    case '[':
+      break;
+    default:
+      return false;
+    }
+    stores.push_back(store);
   }
+  return true;
+}
 
-  /* FIXME: we should check the format too -- if the format is "%d" and arguments are &a, &b,
-   * then we should not make 'b' symbolic */
-  for (unsigned i = 1; i < size; ++i) { /* first two arguments are file and format */
+} // namespace
+
+void SpecialFunctionHandler::makeScanfArgumentsSymbolic(
+    ExecutionState &state, KInstruction *target,
+    const std::vector<Cell> &arguments, unsigned firstArgument) {
+  for (unsigned i = firstArgument; i < arguments.size(); ++i) {
     Executor::ExactResolutionList rl;
     executor.resolveExact(state, arguments[i], rl, "_fscanf");
 
@@ -1358,39 +1830,406 @@ void SpecialFunctionHandler::handleScanf(ExecutionState &state,
     }
   }
 
-  /* FIXME: we unnecesarily over-approximate here */
   executor.bindLocal(target, state,
                    executor.createNondetValue(state, Expr::Int32,
                                               true, target,
                                               "fscanf_ret", false));
 }
 
+void SpecialFunctionHandler::modelScanf(ExecutionState &state,
+                                        KInstruction *target,
+                                        const std::vector<Cell> &arguments,
+                                        unsigned formatIndex) {
+  if (arguments.size() <= formatIndex) {
+    executor.terminateStateOnExecError(state, "unsupported function model");
+    return;
+  }
+
+  // Each conversion stores a nondet value of its width, if the format and
+  // the places it stores to are known. Otherwise, the objects of all
+  // arguments become symbolic.
+  std::vector<ScanfStore> stores;
+  unsigned firstArgument = formatIndex + 1;
+  std::string format = readStringAtAddress(state, arguments[formatIndex]);
+  if (!parseScanfFormat(format, stores) ||
+      stores.size() > arguments.size() - firstArgument) {
+    makeScanfArgumentsSymbolic(state, target, arguments, firstArgument);
+    return;
+  }
+  std::vector<std::pair<ObjectPair, unsigned>> places(stores.size());
+  for (unsigned i = 0; i < stores.size(); ++i) {
+    const ScanfStore &store = stores[i];
+    if (!store.width)
+      continue;
+    if (!resolveConstantRange(state, arguments[firstArgument + i],
+                              store.width / 8,
+                              places[i].first, places[i].second) ||
+        places[i].first.second->readOnly) {
+      makeScanfArgumentsSymbolic(state, target, arguments, firstArgument);
+      return;
+    }
+  }
+
+  unsigned counted = 0;
+  for (unsigned i = 0; i < stores.size(); ++i) {
+    const ScanfStore &store = stores[i];
+    counted += store.isCounted;
+    if (!store.width) {
+      Executor::ExactResolutionList rl;
+      executor.resolveExact(state, arguments[firstArgument + i], rl,
+                            "_fscanf");
+      for (auto &res : rl)
+        executor.executeMakeSymbolic(
+            state, res.first.first,
+            "_fscanf_" + std::to_string(res.first.first->id));
+      continue;
+    }
+    KValue value = executor.createNondetValue(state, store.width,
+                                              store.isSigned, target,
+                                              "fscanf_value");
+    const ObjectPair &op = places[i].first;
+    ObjectState *wos = state.addressSpace.getWriteable(op.first, op.second);
+    wos->write(places[i].second, value);
+  }
 
+  // the number of values stored, or EOF before the first one
+  KValue result = executor.createNondetValue(state, Expr::Int32, true,
+                                             target, "fscanf_ret");
+  ref<Expr> ret = result.getValue();
+  executor.addConstraint(
+      state, AndExpr::create(
+                 SleExpr::create(ConstantExpr::alloc(-1, Expr::Int32), ret),
+                 SleExpr::create(ret,
+                                 ConstantExpr::alloc(counted, Expr::Int32))));
+  executor.bindLocal(target, state, result);
+}
+
+void SpecialFunctionHandler::handleScanf(ExecutionState &state,
+                                         KInstruction *target,
+                                         const std::vector<Cell> &arguments) {
+  modelScanf(state, target, arguments, 0);
+}
+
+/* We also handle sscanf with this handler, which loses the connection
+   between the string and the values. */
 void SpecialFunctionHandler::handleFscanf(ExecutionState &state,
                                          KInstruction *target,
                                          const std::vector<Cell> &arguments) {
-  size_t size = arguments.size();
-  if (size < 3) {
+  modelScanf(state, target, arguments, 1);
+}
+
+/* Wide formats are not parsed, so every argument becomes symbolic */
+void SpecialFunctionHandler::handleWideScanf(ExecutionState &state,
+                                             KInstruction *target,
+                                             const std::vector<Cell> &arguments) {
+  if (arguments.size() < 2) {
     executor.terminateStateOnExecError(state, "unsupported function model");
     return;
   }
+  makeScanfArgumentsSymbolic(state, target, arguments, 1);
+}
 
-  /* FIXME: we should check the format too -- if the format is "%d" and arguments are &a, &b,
-   * then we should not make 'b' symbolic. We also handle sscanf with this handler,
-     which is even more dangereous as we loose the connection between string and data. */
-  for (unsigned i = 2; i < size; ++i) { /* first two arguments are file and format */
-    Executor::ExactResolutionList rl;
-    executor.resolveExact(state, arguments[i], rl, "_fscanf");
+void SpecialFunctionHandler::handleWideFscanf(ExecutionState &state,
+                                              KInstruction *target,
+                                              const std::vector<Cell> &arguments) {
+  if (arguments.size() < 3) {
+    executor.terminateStateOnExecError(state, "unsupported function model");
+    return;
+  }
+  makeScanfArgumentsSymbolic(state, target, arguments, 2);
+}
 
-    for (auto it = rl.begin(), ie = rl.end(); it != ie; ++it) {
-      const MemoryObject *mo = it->first.first;
-      executor.executeMakeSymbolic(state, mo, "_fscanf_"+std::to_string(mo->id));
+/* Fast paths */
+
+/// Find the object holding the size bytes at pointer.
+/// \return false unless pointer is constant and the bytes are in bounds
+static bool resolveConstantRange(const ExecutionState &state,
+                                 const Cell &pointer, uint64_t size,
+                                 ObjectPair &op, unsigned &offset) {
+  if (!pointer.isConstant() ||
+      !state.addressSpace.resolveOneConstantSegment(pointer, op))
+    return false;
+  auto objectSize = dyn_cast<klee::ConstantExpr>(op.first->getSizeExpr());
+  if (!objectSize)
+    return false;
+  uint64_t start = cast<klee::ConstantExpr>(pointer.getOffset())->getZExtValue();
+  if (start > objectSize->getZExtValue() ||
+      size > objectSize->getZExtValue() - start)
+    return false;
+  offset = start;
+  return true;
+}
+
+/// The constant size argument of a memory function, if it is one.
+static bool getConstantSize(const Cell &size, uint64_t &result) {
+  if (!size.isConstant() || !size.isSegmentZero())
+    return false;
+  result = cast<klee::ConstantExpr>(size.getOffset())->getZExtValue();
+  return true;
+}
+
+/// Read the string at pointer into bytes, up to and including its
+/// terminating NUL but at most limit bytes. Reading stops early at the first
+/// byte that is symbolic or out of bounds, so bytes ends in a NUL only if the
+/// whole string is concrete.
+/// \return false unless pointer is constant
+static bool readConcreteString(const ExecutionState &state,
+                               const Cell &pointer, uint64_t limit,
+                               std::vector<uint8_t> &bytes, ObjectPair &op,
+                               unsigned &offset) {
+  bytes.clear();
+  if (!resolveConstantRange(state, pointer, 0, op, offset))
+    return false;
+  uint64_t available =
+      cast<klee::ConstantExpr>(op.first->getSizeExpr())->getZExtValue() -
+      offset;
+  limit = std::min(limit, available);
+  // strings are usually short, so they are read in small chunks
+  const unsigned Chunk = 64;
+  while (bytes.size() < limit) {
+    unsigned start = bytes.size();
+    unsigned size = std::min<uint64_t>(Chunk, limit - start);
+    bytes.resize(start + size);
+    unsigned read =
+        op.second->readConcretePrefix(offset + start, size, &bytes[start]);
+    if (const void *nul = std::memchr(&bytes[start], 0, read)) {
+      bytes.resize(static_cast<const uint8_t *>(nul) - bytes.data() + 1);
+      break;
     }
+    bytes.resize(start + read);
+    if (read != size)
+      break;
+  }
+  return true;
+}
+
+/// Whether bytes holds a whole string, i.e. ends in its NUL.
+static bool isTerminated(const std::vector<uint8_t> &bytes) {
+  return !bytes.empty() && bytes.back() == 0;
+}
+
+bool SpecialFunctionHandler::copyMemory(ExecutionState &state,
+                                        KInstruction *target,
+                                        const std::vector<Cell> &arguments,
+                                        bool allowOverlap) {
+  uint64_t size;
+  if (arguments.size() != 3 || !getConstantSize(arguments[2], size))
+    return false;
+
+  if (size) {
+    ObjectPair dst, src;
+    unsigned dstOffset, srcOffset;
+    if (!resolveConstantRange(state, arguments[0], size, dst, dstOffset) ||
+        !resolveConstantRange(state, arguments[1], size, src, srcOffset) ||
+        dst.second->readOnly)
+      return false;
+    // pointers stored into pointer-free memory are reported by the
+    // definition
+    if (dst.first->isPointerFree && src.second->hasSegmentPlane())
+      return false;
+    if (dst.first == src.first && !allowOverlap &&
+        dstOffset < srcOffset + size && srcOffset < dstOffset + size)
+      return false;
+
+    ObjectState *wos = state.addressSpace.getWriteable(dst.first, dst.second);
+    if (dst.first != src.first)
+      wos->copy(dstOffset, *src.second, srcOffset, size);
+    else if (dstOffset != srcOffset)
+      wos->copy(dstOffset, *wos, srcOffset, size);
+  }
+
+  if (!target->inst->getType()->isVoidTy())
+    executor.bindLocal(target, state, arguments[0]);
+  return true;
+}
+
+bool SpecialFunctionHandler::handleMemcpy(ExecutionState &state,
+                                          KInstruction *target,
+                                          const std::vector<Cell> &arguments) {
+  return copyMemory(state, target, arguments, false);
+}
+
+bool SpecialFunctionHandler::handleMemmove(ExecutionState &state,
+                                           KInstruction *target,
+                                           const std::vector<Cell> &arguments) {
+  return copyMemory(state, target, arguments, true);
+}
+
+bool SpecialFunctionHandler::handleMemset(ExecutionState &state,
+                                          KInstruction *target,
+                                          const std::vector<Cell> &arguments) {
+  uint64_t size;
+  if (arguments.size() != 3 || !getConstantSize(arguments[2], size) ||
+      !arguments[1].isSegmentZero())
+    return false;
+
+  if (size) {
+    ObjectPair dst;
+    unsigned offset;
+    if (!resolveConstantRange(state, arguments[0], size, dst, offset) ||
+        dst.second->readOnly)
+      return false;
+    ObjectState *wos = state.addressSpace.getWriteable(dst.first, dst.second);
+    wos->fill(offset, size,
+              ExtractExpr::create(arguments[1].getOffset(), 0, Expr::Int8));
   }
 
-  /* FIXME: we unnecesarily over-approximate here */
+  if (!target->inst->getType()->isVoidTy())
+    executor.bindLocal(target, state, arguments[0]);
+  return true;
+}
+
+bool SpecialFunctionHandler::handleMemcmp(ExecutionState &state,
+                                          KInstruction *target,
+                                          const std::vector<Cell> &arguments) {
+  uint64_t size;
+  if (arguments.size() != 3 || !getConstantSize(arguments[2], size))
+    return false;
+
+  // symbolic bytes are compared by the definition, which forks on them
+  int result = 0;
+  if (size) {
+    ObjectPair a, b;
+    unsigned aOffset, bOffset;
+    if (!resolveConstantRange(state, arguments[0], size, a, aOffset) ||
+        !resolveConstantRange(state, arguments[1], size, b, bOffset))
+      return false;
+    std::vector<uint8_t> aBytes(size), bBytes(size);
+    if (!a.second->readConcrete(aOffset, size, aBytes.data()) ||
+        !b.second->readConcrete(bOffset, size, bBytes.data()))
+      return false;
+    auto mismatch = std::mismatch(aBytes.begin(), aBytes.end(), bBytes.begin());
+    if (mismatch.first != aBytes.end())
+      result = int(*mismatch.first) - int(*mismatch.second);
+  }
+
+  Expr::Width width = executor.getWidthForLLVMType(target->inst->getType());
   executor.bindLocal(target, state,
-                   executor.createNondetValue(state, Expr::Int32,
-                                              true, target,
-                                              "fscanf_ret", false));
+                     KValue(ConstantExpr::alloc(llvm::APInt(width, result,
+                                                            true))));
+  return true;
+}
+
+// The string functions only run on strings that are concrete up to the byte
+// deciding the result. Otherwise the definition runs from the start, as it
+// cannot be resumed at the first symbolic byte, and forks there.
+
+bool SpecialFunctionHandler::handleStrlen(ExecutionState &state,
+                                          KInstruction *target,
+                                          const std::vector<Cell> &arguments) {
+  std::vector<uint8_t> bytes;
+  ObjectPair op;
+  unsigned offset;
+  if (arguments.size() != 1 ||
+      !readConcreteString(state, arguments[0], UINT64_MAX, bytes, op,
+                          offset) ||
+      !isTerminated(bytes))
+    return false;
+
+  Expr::Width width = executor.getWidthForLLVMType(target->inst->getType());
+  executor.bindLocal(target, state,
+                     KValue(ConstantExpr::create(bytes.size() - 1, width)));
+  return true;
+}
+
+bool SpecialFunctionHandler::handleStrcmp(ExecutionState &state,
+                                          KInstruction *target,
+                                          const std::vector<Cell> &arguments) {
+  std::vector<uint8_t> a, b;
+  ObjectPair aOp, bOp;
+  unsigned aOffset, bOffset;
+  if (arguments.size() != 2 ||
+      !readConcreteString(state, arguments[0], UINT64_MAX, a, aOp, aOffset) ||
+      !readConcreteString(state, arguments[1], UINT64_MAX, b, bOp, bOffset))
+    return false;
+
+  // the strings are compared up to the first difference or their end
+  size_t i = 0;
+  while (i < a.size() && i < b.size() && a[i] && a[i] == b[i])
+    ++i;
+  if (i == a.size() || i == b.size())
+    return false;
+  // the difference of chars depends on their signedness, which is left to
+  // the definition
+  if ((a[i] | b[i]) & 0x80)
+    return false;
+
+  Expr::Width width = executor.getWidthForLLVMType(target->inst->getType());
+  executor.bindLocal(
+      target, state,
+      KValue(ConstantExpr::alloc(
+          llvm::APInt(width, int(a[i]) - int(b[i]), true))));
+  return true;
+}
+
+bool SpecialFunctionHandler::handleStrchr(ExecutionState &state,
+                                          KInstruction *target,
+                                          const std::vector<Cell> &arguments) {
+  if (arguments.size() != 2 || !arguments[1].isConstant() ||
+      !arguments[1].isSegmentZero())
+    return false;
+  uint8_t c = cast<klee::ConstantExpr>(arguments[1].getOffset())
+                  ->Extract(0, Expr::Int8)
+                  ->getZExtValue();
+
+  std::vector<uint8_t> bytes;
+  ObjectPair op;
+  unsigned offset;
+  if (!readConcreteString(state, arguments[0], UINT64_MAX, bytes, op, offset))
+    return false;
+  auto found = std::find(bytes.begin(), bytes.end(), c);
+  if (found == bytes.end() && !isTerminated(bytes))
+    return false;
+
+  if (found == bytes.end()) {
+    executor.bindLocal(target, state, KValue(Expr::createPointer(0)));
+  } else {
+    const KValue &s = arguments[0];
+    executor.bindLocal(
+        target, state,
+        KValue(s.getSegment(),
+               AddExpr::create(s.getOffset(),
+                               ConstantExpr::create(found - bytes.begin(),
+                                                    s.getWidth()))));
+  }
+  return true;
+}
+
+bool SpecialFunctionHandler::handleStrncpy(ExecutionState &state,
+                                           KInstruction *target,
+                                           const std::vector<Cell> &arguments) {
+  uint64_t size;
+  if (arguments.size() != 3 || !getConstantSize(arguments[2], size))
+    return false;
+
+  if (size) {
+    ObjectPair dst, src;
+    unsigned dstOffset, srcOffset;
+    std::vector<uint8_t> bytes;
+    if (!resolveConstantRange(state, arguments[0], size, dst, dstOffset) ||
+        dst.second->readOnly ||
+        !readConcreteString(state, arguments[1], size, bytes, src,
+                            srcOffset))
+      return false;
+    if (bytes.size() != size && !isTerminated(bytes))
+      return false;
+    // the NUL is written by the padding
+    unsigned length = isTerminated(bytes) ? bytes.size() - 1 : bytes.size();
+    if (dst.first->isPointerFree && src.second->hasSegmentPlane())
+      return false;
+    if (dst.first == src.first && dstOffset < srcOffset + bytes.size() &&
+        srcOffset < dstOffset + size)
+      return false;
+
+    ObjectState *wos = state.addressSpace.getWriteable(dst.first, dst.second);
+    if (length)
+      wos->copy(dstOffset, *src.second, srcOffset, length);
+    if (length != size)
+      wos->fill(dstOffset + length, size - length,
+                ConstantExpr::create(0, Expr::Int8));
+  }
+
+  if (!target->inst->getType()->isVoidTy())
+    executor.bindLocal(target, state, arguments[0]);
+  return true;
 }
@@ -15,6 +15,7 @@
 
 #include <iterator>
 #include <map>
+#include <set>
 #include <vector>
 #include <string>
 
@@ -38,7 +39,16 @@ namespace klee {
     typedef std::map<const llvm::Function*,
                      std::pair<Handler,bool> > handlers_ty;
 
+    /// A handler for a call it may decline, leaving it to the definition
+    /// of the function or to the external call. \return true iff the call
+    /// was handled
+    typedef bool (SpecialFunctionHandler::*FastPath)(
+        ExecutionState &state, KInstruction *target,
+        const std::vector<Cell> &arguments);
+    typedef std::map<const llvm::Function *, FastPath> fast_paths_ty;
+
     handlers_ty handlers;
+    fast_paths_ty fastPaths;
     class Executor &executor;
 
     struct HandlerInfo {
@@ -87,13 +97,22 @@ namespace klee {
 
     /// Initialize the internal handler map after the module has been
     /// prepared for execution.
-    void bind();
+    ///
+    /// @param programFunctions contains the names of the functions the
+    /// program under test defines, which are never replaced by fast paths
+    void bind(const std::set<std::string> &programFunctions);
 
     bool handle(ExecutionState &state, 
                 llvm::Function *f,
                 KInstruction *target,
                 const std::vector<Cell> &arguments);
 
+    /// Execute the call natively if f has a fast path that accepts it.
+    /// \return true iff the call was handled
+    bool handleFastPath(ExecutionState &state, llvm::Function *f,
+                        KInstruction *target,
+                        const std::vector<Cell> &arguments);
+
     /* Convenience routines */
 
     std::string readStringAtAddress(ExecutionState &state, const Cell &address);
@@ -105,6 +124,32 @@ namespace klee {
                                   const std::string& name,
                                   bool isPointer = false);
 
+    /// Bind target to a nondet pointer that is null, a fresh symbolic object
+    /// or one of the objects returned before at the same call site, forking
+    /// over these choices (see --lazy-init-nondet-pointers).
+    void lazyInitializePointer(ExecutionState &state, KInstruction *target,
+                               const std::string &name);
+
+    /// Copy the bytes of a memcpy or memmove call natively, or memcpy only
+    /// if the ranges do not overlap. \return false if the call is left to
+    /// the definition
+    bool copyMemory(ExecutionState &state, KInstruction *target,
+                    const std::vector<Cell> &arguments, bool allowOverlap);
+
+    /// Model a call of a scanf-like function: the conversions of the format
+    /// store nondet values of their width through their arguments, and the
+    /// result is a nondet count of them. \param formatIndex is the index of
+    /// the format among the arguments
+    void modelScanf(ExecutionState &state, KInstruction *target,
+                    const std::vector<Cell> &arguments, unsigned formatIndex);
+
+    /// Make the objects of the arguments from firstArgument on symbolic and
+    /// bind target to a nondet result, for formats that are not understood.
+    void makeScanfArgumentsSymbolic(ExecutionState &state,
+                                    KInstruction *target,
+                                    const std::vector<Cell> &arguments,
+                                    unsigned firstArgument);
+
     void putConcreteValue(ExecutionState& state,
                           const std::string& name, bool isSigned,
                           KInstruction *target,
@@ -121,6 +166,7 @@ namespace klee {
     HANDLER(handleAssume);
     HANDLER(handleCalloc);
     HANDLER(handleCheckMemoryAccess);
+    HANDLER(handleCopyFileBytes);
     HANDLER(handleDefineFixedObject);
     HANDLER(handleDelete);    
     HANDLER(handleDeleteArray);
@@ -181,10 +227,36 @@ namespace klee {
     HANDLER(handleVerifierNondetSectorT);
     HANDLER(handlePthreadCreate);
     HANDLER(handlePthreadJoin);
+    HANDLER(handlePthreadExit);
+    HANDLER(handlePthreadSelf);
+    HANDLER(handlePthreadMutexInit);
+    HANDLER(handlePthreadMutexDestroy);
+    HANDLER(handlePthreadMutexLock);
+    HANDLER(handlePthreadMutexTrylock);
+    HANDLER(handlePthreadMutexUnlock);
+    HANDLER(handleAtomicBegin);
+    HANDLER(handleAtomicEnd);
     HANDLER(handleUnsupportedPthread);
     HANDLER(handleScanf);
     HANDLER(handleFscanf);
+    HANDLER(handleWideScanf);
+    HANDLER(handleWideFscanf);
 #undef HANDLER
+
+    /* Fast paths */
+
+#define FAST_PATH(name) bool name(ExecutionState &state, \
+                                  KInstruction *target, \
+                                  const std::vector<Cell> &arguments)
+    FAST_PATH(handleMemcmp);
+    FAST_PATH(handleMemcpy);
+    FAST_PATH(handleMemmove);
+    FAST_PATH(handleMemset);
+    FAST_PATH(handleStrchr);
+    FAST_PATH(handleStrcmp);
+    FAST_PATH(handleStrlen);
+    FAST_PATH(handleStrncpy);
+#undef FAST_PATH
   };
 } // End klee namespace
 
@@ -0,0 +1,86 @@
+//===-- StateFingerprint.h --------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Hashes of the parts of an ExecutionState, used to notice that a state
+// comes back to a loop head in the configuration it was in before (see
+// --revisited-loop-heads). The registers of a frame and the bytes of an
+// object are combined by xor, so that a write only replaces the term of the
+// register or byte it overwrites instead of rehashing the whole state.
+//
+// As with the bitstate hashing of explicit-state model checkers, two states
+// with equal fingerprints are taken to be equal without comparing them.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_STATEFINGERPRINT_H
+#define KLEE_STATEFINGERPRINT_H
+
+#include "klee/Expr/Expr.h"
+#include "klee/Module/KValue.h"
+
+#include "llvm/Support/CommandLine.h"
+
+#include <cstdint>
+
+namespace klee {
+
+enum class RevisitedLoopHeadPolicy {
+  Ignore,
+  /// Terminate the state early.
+  Prune,
+  /// Terminate the state with a non-termination error.
+  Report,
+};
+
+extern llvm::cl::opt<RevisitedLoopHeadPolicy> RevisitedLoopHeads;
+
+/// Whether fingerprints have to be kept up to date on writes.
+inline bool trackFingerprints() {
+  return RevisitedLoopHeads != RevisitedLoopHeadPolicy::Ignore;
+}
+
+/// The finalizer of SplitMix64.
+inline uint64_t mixFingerprint(uint64_t x) {
+  x += 0x9e3779b97f4a7c15ULL;
+  x ^= x >> 30;
+  x *= 0xbf58476d1ce4e5b9ULL;
+  x ^= x >> 27;
+  x *= 0x94d049bb133111ebULL;
+  return x ^ (x >> 31);
+}
+
+inline uint64_t combineFingerprints(uint64_t a, uint64_t b) {
+  return mixFingerprint(a ^ mixFingerprint(b));
+}
+
+/// Combines the structural hash, which tells apart arrays of the same name,
+/// with the stable hash, which is wider.
+inline uint64_t getFingerprint(const ref<Expr> &e) {
+  if (e.isNull())
+    return 0;
+  const StableHash &h = e->stableHash();
+  return combineFingerprints(h.low ^ (h.high << 1),
+                             (uint64_t(e->hash()) << 32) | e->getWidth());
+}
+
+/// The term of register reg holding value in the fingerprint of a frame.
+inline uint64_t getRegisterFingerprint(unsigned reg, const KValue &value) {
+  if (value.getValue().isNull())
+    return 0;
+  // concrete segments are not turned into expressions just to hash them
+  uint64_t segment = value.hasConstantSegment()
+                         ? mixFingerprint(value.getConstantSegment())
+                         : getFingerprint(value.getSegment());
+  return combineFingerprints(combineFingerprints(reg, segment),
+                             getFingerprint(value.getValue()));
+}
+
+} // namespace klee
+
+#endif /* KLEE_STATEFINGERPRINT_H */
@@ -0,0 +1,186 @@
+//===-- StateScoring.cpp --------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "StateScoring.h"
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <vector>
+
+using namespace klee;
+using namespace llvm;
+
+constexpr double StateFeatures::Unreachable;
+
+const char *const StateFeatures::names[StateFeatures::NumFeatures] = {
+    "depth", "insts-since-covnew", "query-cost",    "constraints",
+    "md2u",  "stack-depth",        "error-distance"};
+
+namespace {
+
+bool parseFeature(StringRef name, StateFeatures::Kind &kind) {
+  for (unsigned i = 0; i < StateFeatures::NumFeatures; ++i) {
+    if (name == StateFeatures::names[i]) {
+      kind = static_cast<StateFeatures::Kind>(i);
+      return true;
+    }
+  }
+  return false;
+}
+
+class LinearModel final : public ScoringModel {
+public:
+  double bias = 0.;
+  std::array<double, StateFeatures::NumFeatures> weights{};
+
+  double score(const StateFeatures &features) const override {
+    double sum = bias;
+    for (unsigned i = 0; i < StateFeatures::NumFeatures; ++i)
+      sum += weights[i] * features.values[i];
+    return sum;
+  }
+
+  bool uses(StateFeatures::Kind kind) const override {
+    return weights[kind] != 0.;
+  }
+
+  void print(raw_ostream &os) const override {
+    os << "linear";
+    for (unsigned i = 0; i < StateFeatures::NumFeatures; ++i)
+      if (weights[i] != 0.)
+        os << ' ' << StateFeatures::names[i] << ':' << weights[i];
+    os << " bias:" << bias;
+  }
+};
+
+class DecisionTreeModel final : public ScoringModel {
+public:
+  struct Node {
+    bool leaf;
+    StateFeatures::Kind feature;
+    /// The score of a leaf, the threshold of a split
+    double value;
+    unsigned below, above;
+  };
+  std::vector<Node> nodes;
+
+  double score(const StateFeatures &features) const override {
+    const Node *node = &nodes.front();
+    while (!node->leaf)
+      node = &nodes[features[node->feature] < node->value ? node->below
+                                                          : node->above];
+    return node->value;
+  }
+
+  bool uses(StateFeatures::Kind kind) const override {
+    for (const Node &node : nodes)
+      if (!node.leaf && node.feature == kind)
+        return true;
+    return false;
+  }
+
+  void print(raw_ostream &os) const override {
+    os << "tree of " << nodes.size() << " nodes";
+  }
+};
+
+} // namespace
+
+std::unique_ptr<ScoringModel> ScoringModel::parse(StringRef text,
+                                                  std::string &error) {
+  // the words of the lines that are not blank or comments
+  std::vector<std::pair<unsigned, SmallVector<StringRef, 5>>> lines;
+  SmallVector<StringRef, 16> rawLines;
+  text.split(rawLines, '\n');
+  for (unsigned i = 0; i < rawLines.size(); ++i) {
+    StringRef line = rawLines[i].trim();
+    if (line.empty() || line.startswith("#"))
+      continue;
+    lines.emplace_back(i + 1, SmallVector<StringRef, 5>());
+    line.split(lines.back().second, ' ', -1, /*KeepEmpty=*/false);
+  }
+
+  unsigned lineNo = 0;
+  auto fail = [&](const Twine &reason) {
+    error = ("line " + Twine(lineNo) + ": " + reason).str();
+    return nullptr;
+  };
+  if (lines.empty()) {
+    error = "empty model";
+    return nullptr;
+  }
+  lineNo = lines.front().first;
+  const auto &header = lines.front().second;
+  if (header.size() != 1 || (header[0] != "linear" && header[0] != "tree"))
+    return fail("expected 'linear' or 'tree'");
+
+  if (header[0] == "linear") {
+    auto model = std::make_unique<LinearModel>();
+    for (unsigned i = 1; i < lines.size(); ++i) {
+      lineNo = lines[i].first;
+      const auto &words = lines[i].second;
+      double weight;
+      StateFeatures::Kind kind;
+      if (words.size() != 2 || words[1].getAsDouble(weight))
+        return fail("expected '<feature> <weight>'");
+      if (words[0] == "bias")
+        model->bias = weight;
+      else if (parseFeature(words[0], kind))
+        model->weights[kind] = weight;
+      else
+        return fail("unknown feature '" + words[0] + "'");
+    }
+    return model;
+  }
+
+  auto model = std::make_unique<DecisionTreeModel>();
+  unsigned count = lines.size() - 1;
+  for (unsigned i = 1; i < lines.size(); ++i) {
+    lineNo = lines[i].first;
+    const auto &words = lines[i].second;
+    unsigned index = i - 1;
+    DecisionTreeModel::Node node{};
+    if (words.size() == 2 && words[0] == "leaf") {
+      node.leaf = true;
+      if (words[1].getAsDouble(node.value))
+        return fail("expected 'leaf <score>'");
+    } else if (words.size() == 5 && words[0] == "split") {
+      if (!parseFeature(words[1], node.feature))
+        return fail("unknown feature '" + words[1] + "'");
+      if (words[2].getAsDouble(node.value) ||
+          words[3].getAsInteger(10, node.below) ||
+          words[4].getAsInteger(10, node.above))
+        return fail("expected 'split <feature> <threshold> <below> <above>'");
+      // children come later, so that the tree has no cycles
+      if (node.below <= index || node.above <= index || node.below >= count ||
+          node.above >= count)
+        return fail("child out of range");
+    } else {
+      return fail("expected 'split' or 'leaf'");
+    }
+    model->nodes.push_back(node);
+  }
+  if (model->nodes.empty()) {
+    error = "tree without nodes";
+    return nullptr;
+  }
+  return model;
+}
+
+std::unique_ptr<ScoringModel> ScoringModel::load(const std::string &path,
+                                                 std::string &error) {
+  auto buffer = MemoryBuffer::getFile(path, /*IsText=*/true);
+  if (!buffer) {
+    error = buffer.getError().message();
+    return nullptr;
+  }
+  return parse(buffer.get()->getBuffer(), error);
+}
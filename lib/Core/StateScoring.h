@@ -0,0 +1,98 @@
+//===-- StateScoring.h ------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_STATESCORING_H
+#define KLEE_STATESCORING_H
+
+#include "llvm/ADT/StringRef.h"
+
+#include <array>
+#include <memory>
+#include <string>
+
+namespace llvm {
+class raw_ostream;
+}
+
+namespace klee {
+
+/// StateFeatures - The features of a state that FeatureSearcher scores.
+struct StateFeatures {
+  /// The distance given for targets that cannot be reached, so that a
+  /// negative weight on a distance ranks those states last
+  static constexpr double Unreachable = 1e6;
+
+  enum Kind : unsigned {
+    Depth,
+    InstsSinceCovNew,
+    /// The seconds spent in the queries of the state
+    QueryCost,
+    Constraints,
+    MinDistToUncovered,
+    StackDepth,
+    /// See ErrorDistances
+    ErrorDistance,
+    NumFeatures
+  };
+
+  /// The names of the features in model files, indexed by Kind
+  static const char *const names[NumFeatures];
+
+  std::array<double, NumFeatures> values{};
+
+  double operator[](Kind kind) const { return values[kind]; }
+  double &operator[](Kind kind) { return values[kind]; }
+};
+
+/// ScoringModel - Scores the features of a state for FeatureSearcher, which
+/// selects the state with the highest score. Models trained offline are
+/// loaded from a text file, other ones can be passed to FeatureSearcher
+/// directly.
+class ScoringModel {
+public:
+  virtual ~ScoringModel() = default;
+
+  virtual double score(const StateFeatures &features) const = 0;
+
+  /// \return false if the model ignores the feature, which then need not
+  /// be computed
+  virtual bool uses(StateFeatures::Kind kind) const = 0;
+
+  virtual void print(llvm::raw_ostream &os) const = 0;
+
+  /// Parse a model. Lines starting with '#' are comments. A linear model
+  ///
+  ///   linear
+  ///   bias <weight>
+  ///   <feature> <weight>
+  ///   ...
+  ///
+  /// scores the sum of the weighted features and the bias. A decision tree
+  ///
+  ///   tree
+  ///   split <feature> <threshold> <below> <above>
+  ///   leaf <score>
+  ///   ...
+  ///
+  /// lists its nodes from the root, a split continuing with the node of
+  /// index below or above (counting from 0) as the feature is less than the
+  /// threshold or not. Children come after their parents.
+  ///
+  /// \return nullptr if the model is malformed, with the reason in error
+  static std::unique_ptr<ScoringModel> parse(llvm::StringRef text,
+                                             std::string &error);
+
+  /// Read and parse a model file.
+  static std::unique_ptr<ScoringModel> load(const std::string &path,
+                                            std::string &error);
+};
+
+} // namespace klee
+
+#endif /* KLEE_STATESCORING_H */
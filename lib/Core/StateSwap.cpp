@@ -0,0 +1,115 @@
+//===-- StateSwap.cpp -----------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "StateSwap.h"
+
+#include "klee/Support/ErrorHandling.h"
+
+#include "llvm/Support/Endian.h"
+#include "llvm/Support/Errno.h"
+
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace klee;
+
+namespace {
+/// Write or read size bytes at offset, retrying after short transfers.
+template <typename F>
+bool transfer(F f, char *buffer, size_t size, std::uint64_t offset) {
+  while (size) {
+    ssize_t n = f(buffer, size, offset);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    buffer += n;
+    size -= n;
+    offset += n;
+  }
+  return true;
+}
+} // namespace
+
+std::unique_ptr<StateSwap> StateSwap::create(const std::string &path) {
+  int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+  if (fd < 0) {
+    klee_warning("unable to create state swap file %s - %s", path.c_str(),
+                 llvm::sys::StrError(errno).c_str());
+    return nullptr;
+  }
+  return std::unique_ptr<StateSwap>(new StateSwap(path, fd));
+}
+
+StateSwap::~StateSwap() {
+  close(fd);
+  unlink(path.c_str());
+}
+
+bool StateSwap::swapOut(const std::vector<std::uint32_t> &choices) {
+  std::vector<char> record(4 * choices.size());
+  for (size_t i = 0; i < choices.size(); ++i)
+    llvm::support::endian::write32le(&record[4 * i], choices[i]);
+  if (!transfer(
+          [&](char *b, size_t n, std::uint64_t o) {
+            return pwrite(fd, b, n, o);
+          },
+          record.data(), record.size(), fileSize)) {
+    klee_warning("write to state swap file failed - %s",
+                 llvm::sys::StrError(errno).c_str());
+    return false;
+  }
+  swapped.push_back({fileSize, static_cast<std::uint32_t>(choices.size())});
+  fileSize += record.size();
+  return true;
+}
+
+bool StateSwap::read(const Handle &h,
+                     std::vector<std::uint32_t> &choices) const {
+  std::vector<char> record(4 * size_t(h.count));
+  if (!transfer(
+          [&](char *b, size_t n, std::uint64_t o) {
+            return pread(fd, b, n, o);
+          },
+          record.data(), record.size(), h.offset)) {
+    klee_warning("read from state swap file failed - %s",
+                 llvm::sys::StrError(errno).c_str());
+    return false;
+  }
+  choices.resize(h.count);
+  for (size_t i = 0; i < h.count; ++i)
+    choices[i] = llvm::support::endian::read32le(&record[4 * i]);
+  return true;
+}
+
+bool StateSwap::reload(std::vector<std::uint32_t> &choices) {
+  Handle h = swapped.front();
+  swapped.pop_front();
+  bool ok = read(h, choices);
+  // the space of the records is reused once all were reloaded
+  if (swapped.empty()) {
+    fileSize = 0;
+    if (ftruncate(fd, 0) < 0)
+      klee_warning_once(0, "unable to truncate state swap file");
+  }
+  return ok;
+}
+
+bool StateSwap::readAll(std::vector<std::vector<std::uint32_t>> &all) const {
+  bool ok = true;
+  for (const Handle &h : swapped) {
+    std::vector<std::uint32_t> choices;
+    if (read(h, choices))
+      all.push_back(std::move(choices));
+    else
+      ok = false;
+  }
+  return ok;
+}
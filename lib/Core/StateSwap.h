@@ -0,0 +1,66 @@
+//===-- StateSwap.h ---------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_STATESWAP_H
+#define KLEE_STATESWAP_H
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace klee {
+
+/// StateSwap - The spill file of --state-swap. A state swapped out over the
+/// memory cap is kept as the choices it took at its forks
+/// (ExecutionState::forkChoices), which rebuild it when replayed from the
+/// initial state. Only the position of each record stays in memory.
+class StateSwap {
+  struct Handle {
+    std::uint64_t offset;
+    std::uint32_t count;
+  };
+
+  std::string path;
+  int fd;
+  std::uint64_t fileSize = 0;
+  /// In the order the states were swapped out.
+  std::deque<Handle> swapped;
+
+  StateSwap(std::string path, int fd) : path(std::move(path)), fd(fd) {}
+  bool read(const Handle &h, std::vector<std::uint32_t> &choices) const;
+
+public:
+  /// Create the spill file at path. \return null if that fails
+  static std::unique_ptr<StateSwap> create(const std::string &path);
+  /// Removes the spill file.
+  ~StateSwap();
+
+  StateSwap(const StateSwap &) = delete;
+  StateSwap &operator=(const StateSwap &) = delete;
+
+  bool empty() const { return swapped.empty(); }
+  std::size_t size() const { return swapped.size(); }
+
+  /// Append the fork choices of a state. \return false if the write failed
+  bool swapOut(const std::vector<std::uint32_t> &choices);
+
+  /// Take the fork choices of the state swapped out first.
+  /// \return false if the read failed, the state is lost then
+  bool reload(std::vector<std::uint32_t> &choices);
+
+  /// Append the fork choices of all swapped out states, which stay swapped
+  /// out. \return false if a read failed, the state is left out then
+  bool readAll(std::vector<std::vector<std::uint32_t>> &all) const;
+};
+
+} // namespace klee
+
+#endif /* KLEE_STATESWAP_H */
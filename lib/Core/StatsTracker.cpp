@@ -9,13 +9,16 @@
 
 #include "StatsTracker.h"
 
+#include "AsyncBranchQueries.h"
 #include "ExecutionState.h"
 
 #include "klee/Config/Version.h"
+#include "klee/Expr/ExprAllocator.h"
 #include "klee/Module/InstructionInfoTable.h"
 #include "klee/Module/KInstruction.h"
 #include "klee/Module/KModule.h"
 #include "klee/Solver/SolverStats.h"
+#include "klee/Statistics/MemoryAccount.h"
 #include "klee/Statistics/Statistics.h"
 #include "klee/Support/ErrorHandling.h"
 #include "klee/Support/ModuleUtil.h"
@@ -23,8 +26,11 @@
 
 #include "CallPathManager.h"
 #include "CoreStats.h"
+#include "CoverageBitmap.h"
 #include "Executor.h"
 #include "MemoryManager.h"
+#include "MetricsServer.h"
+#include "Searcher.h"
 #include "UserSearcher.h"
 
 #include "llvm/ADT/SmallBitVector.h"
@@ -41,7 +47,12 @@
 #include "llvm/Support/Path.h"
 #include "llvm/Support/Process.h"
 
+#include <condition_variable>
+#include <deque>
 #include <fstream>
+#include <functional>
+#include <queue>
+#include <thread>
 #include <unistd.h>
 
 using namespace klee;
@@ -60,6 +71,16 @@ cl::opt<bool> TrackInstructionTime(
         "Enable tracking of time for individual instructions (default=false)"),
     cl::cat(StatsCat));
 
+cl::opt<unsigned> InstructionTimeSampleInterval(
+    "instruction-time-sample-interval", cl::init(1),
+    cl::desc("With --track-instruction-time, read the clocks only every n "
+             "instructions and charge the time since the last reading to the "
+             "instruction and call path executing then. Over many samples "
+             "this approximates the per-instruction times at a fraction of "
+             "the cost of timing each instruction, 1 to time each one "
+             "(default=1)"),
+    cl::cat(StatsCat));
+
 cl::opt<bool>
     OutputStats("output-stats", cl::init(true),
                 cl::desc("Write running stats trace file (default=true)"),
@@ -75,6 +96,12 @@ cl::opt<std::string> StatsWriteInterval(
     cl::desc("Approximate time between stats writes (default=1s)"),
     cl::cat(StatsCat));
 
+cl::opt<bool> StatsBackgroundWriter(
+    "stats-background-writer", cl::init(true),
+    cl::desc("Write run.stats and run.istats on a thread of its own, so that "
+             "slow file systems do not stall the execution (default=true)"),
+    cl::cat(StatsCat));
+
 cl::opt<unsigned> StatsWriteAfterInstructions(
     "stats-write-after-instructions", cl::init(0),
     cl::desc(
@@ -100,6 +127,37 @@ cl::opt<unsigned> IStatsWriteAfterInstructions(
         "Write istats after each n instructions, 0 to disable (default=0)"),
     cl::cat(StatsCat));
 
+cl::opt<bool> WriteQuerySites(
+    "write-query-sites", cl::init(false),
+    cl::desc("Write the solver time of each instruction that issued queries, "
+             "by kind of query, to query-sites.txt at the end of the run. "
+             "Requires --output-istats (default=false)"),
+    cl::cat(StatsCat));
+
+cl::opt<std::string> MetricsSocket(
+    "metrics-socket",
+    cl::desc("Answer HTTP requests on a Unix socket at this path with the "
+             "current statistics in the text format of Prometheus, e.g. for "
+             "curl --unix-socket (default=off)"),
+    cl::cat(StatsCat));
+
+cl::opt<std::string> MetricsUpdateInterval(
+    "metrics-update-interval", cl::init("1s"),
+    cl::desc("Time between updates of the metrics served on "
+             "--metrics-socket (default=1s)"),
+    cl::cat(StatsCat));
+
+cl::opt<std::string> CoverageBitmapPath(
+    "coverage-bitmap",
+    cl::desc("Share the covered instructions with other processes in a file "
+             "at this path, a byte per instruction id after a header, which "
+             "is created if it does not exist. States only cover new code "
+             "with instructions no process covered, and the searchers that "
+             "prefer new coverage avoid the code covered elsewhere. The "
+             "other processes may be KLEE runs on the same module or tools "
+             "that map the file too (default=off)"),
+    cl::cat(StatsCat));
+
 // XXX I really would like to have dynamic rate control for something like this.
 cl::opt<std::string> UncoveredUpdateInterval(
     "uncovered-update-interval", cl::init("30s"),
@@ -147,6 +205,54 @@ static bool instructionIsCoverable(Instruction *i) {
   return true;
 }
 
+/// StatsWriter - Runs the writes of the statistics files on a thread of its
+/// own, in the order they were posted. The values to write are collected on
+/// the interpreter thread, which owns the statistics, so they need no locks.
+class klee::StatsWriter {
+  std::mutex mutex;
+  std::condition_variable posted;
+  std::deque<std::function<void()>> jobs;
+  bool stopping = false;
+  std::thread thread;
+
+  void run() {
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;) {
+      posted.wait(lock, [&] { return stopping || !jobs.empty(); });
+      if (jobs.empty())
+        return;
+      std::function<void()> job = std::move(jobs.front());
+      jobs.pop_front();
+      lock.unlock();
+      job();
+      lock.lock();
+    }
+  }
+
+public:
+  StatsWriter() : thread([this] { run(); }) {}
+  StatsWriter(const StatsWriter &) = delete;
+  StatsWriter &operator=(const StatsWriter &) = delete;
+
+  /// Runs the jobs still queued before returning.
+  ~StatsWriter() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+    }
+    posted.notify_one();
+    thread.join();
+  }
+
+  void post(std::function<void()> job) {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      jobs.push_back(std::move(job));
+    }
+    posted.notify_one();
+  }
+};
+
 std::string sqlite3ErrToStringAndFree(const std::string& prefix , char* sqlite3ErrMsg) {
   std::ostringstream sstream;
   sstream << prefix << sqlite3ErrMsg;
@@ -194,8 +300,15 @@ StatsTracker::StatsTracker(Executor &_executor, std::string _objectFilename,
     }
   }
 
-  if (useStatistics() || userSearcherRequiresMD2U())
-    theStatisticManager->useIndexedStats(km->infos->getMaxID());
+  if (useStatistics() || userSearcherRequiresMD2U()) {
+    // the statistics updated or read by every instruction
+    theStatisticManager->useIndexedStats(
+        km->infos->getMaxID(),
+        {&stats::instructions, &stats::concreteInstructions,
+         &stats::coveredInstructions, &stats::uncoveredInstructions,
+         &stats::instructionTime, &stats::instructionRealTime,
+         &stats::trueBranches, &stats::falseBranches});
+  }
 
   for (auto &kfp : km->functions) {
     KFunction *kf = kfp.get();
@@ -205,7 +318,7 @@ StatsTracker::StatsTracker(Executor &_executor, std::string _objectFilename,
       KInstruction *ki = kf->instructions[i];
 
       if (OutputIStats) {
-        unsigned id = ki->info->id;
+        unsigned id = km->infos->getID(*ki->inst);
         theStatisticManager->setIndex(id);
         if (kf->trackCoverage && instructionIsCoverable(ki->inst))
           ++stats::uncoveredInstructions;
@@ -219,8 +332,34 @@ StatsTracker::StatsTracker(Executor &_executor, std::string _objectFilename,
     }
   }
 
+  if (!CoverageBitmapPath.empty())
+    coverageBitmap =
+        CoverageBitmap::open(CoverageBitmapPath, km->infos->getMaxID());
+
+  // Add timer to calculate uncovered instructions if needed by the solver
+  if (updateMinDistToUncovered) {
+    computeReachableUncovered();
+    executor.timers.add(std::make_unique<Timer>(time::Span{UncoveredUpdateInterval}, [&]{
+      computeReachableUncovered();
+    }));
+  }
+}
+
+void StatsTracker::openOutput() {
+  if (outputOpened)
+    return;
+  outputOpened = true;
+  startWallTime = time::getWallTime();
+  const time::Span statsWriteInterval(StatsWriteInterval);
+  const time::Span iStatsWriteInterval(IStatsWriteInterval);
+
+  if (StatsBackgroundWriter && (OutputStats || OutputIStats))
+    writer = std::make_unique<StatsWriter>();
+
   if (OutputStats) {
-    sqlite3_config(SQLITE_CONFIG_SINGLETHREAD);
+    // the connection is only used by one thread at a time
+    sqlite3_config(writer ? SQLITE_CONFIG_MULTITHREAD
+                          : SQLITE_CONFIG_SINGLETHREAD);
 
     // open database
     auto db_filename = executor.interpreterHandler->getOutputFilename("run.stats");
@@ -269,14 +408,6 @@ StatsTracker::StatsTracker(Executor &_executor, std::string _objectFilename,
       }));
   }
 
-  // Add timer to calculate uncovered instructions if needed by the solver
-  if (updateMinDistToUncovered) {
-    computeReachableUncovered();
-    executor.timers.add(std::make_unique<Timer>(time::Span{UncoveredUpdateInterval}, [&]{
-      computeReachableUncovered();
-    }));
-  }
-
   if (OutputIStats) {
     istatsFile = executor.interpreterHandler->openOutputFile("run.istats");
     if (istatsFile) {
@@ -288,9 +419,21 @@ StatsTracker::StatsTracker(Executor &_executor, std::string _objectFilename,
       klee_error("Unable to open instruction level stats file (run.istats).");
     }
   }
+
+  if (!MetricsSocket.empty()) {
+    metricsServer = MetricsServer::create(MetricsSocket);
+    if (metricsServer) {
+      updateMetrics();
+      executor.timers.add(std::make_unique<Timer>(
+          time::Span{MetricsUpdateInterval}, [&] { updateMetrics(); }));
+    }
+  }
 }
 
 StatsTracker::~StatsTracker() {  
+  metricsServer.reset();
+  // finish the writes in the background first
+  writer.reset();
   if (statsFile) {
     auto rc = sqlite3_step(transactionEndStmt);
     if (rc != SQLITE_DONE) {
@@ -305,20 +448,74 @@ StatsTracker::~StatsTracker() {
 }
 
 void StatsTracker::done() {
-  if (statsFile)
+  if (statsFile) {
     writeStatsLine();
+    if (!getQueryShapeStats().empty()) {
+      std::deque<QueryShapeStats> stats = getQueryShapeStats();
+      if (writer)
+        writer->post([this, stats] { writeSolverStats(stats); });
+      else
+        writeSolverStats(stats);
+    }
+  }
 
   if (OutputIStats) {
     if (updateMinDistToUncovered)
       computeReachableUncovered();
     if (istatsFile)
       writeIStats();
+    if (istatsFile && WriteQuerySites)
+      writeQuerySites();
+  }
+}
+
+void StatsTracker::disableOutput() {
+  // both are shared with the original process, which keeps writing them
+  statsFile = nullptr;
+  (void)istatsFile.release();
+  // the threads of the writer and the metrics server were not forked along
+  // with this process
+  (void)writer.release();
+  (void)metricsServer.release();
+}
+
+void StatsTracker::setSharedCoverage(std::atomic<std::uint8_t> *coverage) {
+  sharedCoverage = coverage;
+  if (!coverage)
+    return;
+  // what was covered before the members were forked is covered by all
+  for (unsigned id = 0, e = executor.kmodule->infos->getMaxID(); id != e; ++id)
+    if (theStatisticManager->getIndexedValue(stats::coveredInstructions, id))
+      coverage[id].store(1);
+}
+
+void StatsTracker::getCoverage(std::vector<std::uint32_t> &covered) const {
+  for (unsigned id = 0, e = executor.kmodule->infos->getMaxID(); id != e; ++id)
+    if (theStatisticManager->getIndexedValue(stats::coveredInstructions, id))
+      covered.push_back(id);
+}
+
+void StatsTracker::restoreCoverage(const std::vector<std::uint32_t> &covered) {
+  unsigned maxID = executor.kmodule->infos->getMaxID();
+  for (std::uint32_t id : covered) {
+    if (id >= maxID ||
+        theStatisticManager->getIndexedValue(stats::coveredInstructions, id))
+      continue;
+    theStatisticManager->setIndex(id);
+    ++stats::coveredInstructions;
+    stats::uncoveredInstructions += (uint64_t)-1;
   }
+  if (updateMinDistToUncovered)
+    computeAllReachableUncovered();
 }
 
 void StatsTracker::stepInstruction(ExecutionState &es) {
   if (OutputIStats) {
-    if (TrackInstructionTime) {
+    // the index and context are still those of the instruction executed last,
+    // so a sample is charged to the instruction it ends in
+    if (TrackInstructionTime &&
+        (InstructionTimeSampleInterval <= 1 ||
+         stats::instructions % InstructionTimeSampleInterval == 0)) {
       static time::Point lastNowTime(time::getWallTime());
       static time::Span lastUserTime;
 
@@ -338,7 +535,7 @@ void StatsTracker::stepInstruction(ExecutionState &es) {
 
     Instruction *inst = es.pc->inst;
     const InstructionInfo &ii = *es.pc->info;
-    StackFrame &sf = es.stack.back();
+    const StackFrame &sf = es.stack.back();
     theStatisticManager->setIndex(ii.id);
     if (UseCallPaths)
       theStatisticManager->setContext(&sf.callPathNode->statistics);
@@ -353,11 +550,19 @@ void StatsTracker::stepInstruction(ExecutionState &es) {
         //
         // FIXME: This trick no longer works, we should fix this in the line
         // number propogation.
-          es.coveredLines[&ii.file].insert(ii.line);
-	es.coveredNew = true;
-        es.instsSinceCovNew = 1;
+        bool coveredElsewhere =
+            sharedCoverage && sharedCoverage[ii.id].exchange(1);
+        if (coverageBitmap && coverageBitmap->mark(ii.id))
+          coveredElsewhere = true;
+        if (!coveredElsewhere) {
+          (*es.coveredLines.getWriteable())[&ii.file].insert(ii.line);
+          es.coveredNew = true;
+          es.instsSinceCovNew = 1;
+        }
 	++stats::coveredInstructions;
 	stats::uncoveredInstructions += (uint64_t)-1;
+        if (updateMinDistToUncovered)
+          newlyCovered.push_back(inst);
       }
     }
   }
@@ -371,12 +576,21 @@ void StatsTracker::stepInstruction(ExecutionState &es) {
     writeIStats();
 }
 
+void StatsTracker::resumeInstruction(ExecutionState &es, KInstruction *ki) {
+  if (OutputIStats) {
+    theStatisticManager->setIndex(ki->info->id);
+    if (UseCallPaths)
+      theStatisticManager->setContext(&es.stack.back().callPathNode->statistics);
+  }
+}
+
 ///
 
 /* Should be called _after_ the es->pushFrame() */
-void StatsTracker::framePushed(ExecutionState &es, StackFrame *parentFrame) {
+void StatsTracker::framePushed(ExecutionState &es,
+                               const StackFrame *parentFrame) {
   if (OutputIStats) {
-    StackFrame &sf = es.stack.back();
+    StackFrame &sf = es.stack.getWriteableBack();
 
     if (UseCallPaths) {
       CallPathNode *parent = parentFrame ? parentFrame->callPathNode : 0;
@@ -389,7 +603,7 @@ void StatsTracker::framePushed(ExecutionState &es, StackFrame *parentFrame) {
   }
 
   if (updateMinDistToUncovered) {
-    StackFrame &sf = es.stack.back();
+    const StackFrame &sf = es.stack.back();
 
     uint64_t minDistAtRA = 0;
     if (parentFrame)
@@ -411,17 +625,24 @@ void StatsTracker::markBranchVisited(ExecutionState *visitedTrue,
     unsigned id = theStatisticManager->getIndex();
     uint64_t hasTrue = theStatisticManager->getIndexedValue(stats::trueBranches, id);
     uint64_t hasFalse = theStatisticManager->getIndexedValue(stats::falseBranches, id);
+    // the branches of the other processes of --coverage-bitmap are not
+    // known, only the instructions they lead to
+    bool newBranches = !coverageBitmap;
     if (visitedTrue && !hasTrue) {
-      visitedTrue->coveredNew = true;
-      visitedTrue->instsSinceCovNew = 1;
+      if (newBranches) {
+        visitedTrue->coveredNew = true;
+        visitedTrue->instsSinceCovNew = 1;
+      }
       ++stats::trueBranches;
       if (hasFalse) { ++fullBranches; --partialBranches; }
       else ++partialBranches;
       hasTrue = 1;
     }
     if (visitedFalse && !hasFalse) {
-      visitedFalse->coveredNew = true;
-      visitedFalse->instsSinceCovNew = 1;
+      if (newBranches) {
+        visitedFalse->coveredNew = true;
+        visitedFalse->instsSinceCovNew = 1;
+      }
       ++stats::falseBranches;
       if (hasTrue) { ++fullBranches; --partialBranches; }
       else ++partialBranches;
@@ -451,8 +672,15 @@ void StatsTracker::writeStatsHeader() {
              << "ResolveTime INTEGER,"
              << "QueryCexCacheMisses INTEGER,"
              << "QueryCexCacheHits INTEGER,"
-             << "ArrayHashTime INTEGER"
-         << ')';
+             << "ArrayHashTime INTEGER,"
+             << "PooledObjects INTEGER,"
+             << "PoolUsage INTEGER,"
+             << "QueryDiskCacheMisses INTEGER,"
+             << "QueryDiskCacheHits INTEGER";
+  // the bytes held by each subsystem
+  for (const MemoryAccount *account : MemoryAccount::getAccounts())
+    create << ',' << account->getColumn() << " INTEGER";
+  create << ')';
   char *zErrMsg = nullptr;
   if(sqlite3_exec(statsFile, create.str().c_str(), nullptr, nullptr, &zErrMsg)) {
     klee_error("%s", sqlite3ErrToStringAndFree("ERROR creating table: ", zErrMsg).c_str());
@@ -484,8 +712,17 @@ void StatsTracker::writeStatsHeader() {
              << "ResolveTime,"
              << "QueryCexCacheMisses,"
              << "QueryCexCacheHits,"
-             << "ArrayHashTime"
-         << ") VALUES ("
+             << "ArrayHashTime,"
+             << "PooledObjects,"
+             << "PoolUsage,"
+             << "QueryDiskCacheMisses,"
+             << "QueryDiskCacheHits";
+  for (const MemoryAccount *account : MemoryAccount::getAccounts())
+    insert << ',' << account->getColumn();
+  insert << ") VALUES ("
+             << "?,"
+             << "?,"
+             << "?,"
              << "?,"
              << "?,"
              << "?,"
@@ -505,8 +742,11 @@ void StatsTracker::writeStatsHeader() {
              << "?,"
              << "?,"
              << "?,"
-             << "? "
-         << ')';
+             << "?,"
+             << "? ";
+  for (std::size_t i = 0; i < MemoryAccount::getAccounts().size(); ++i)
+    insert << ",?";
+  insert << ')';
 
   if(sqlite3_prepare_v2(statsFile, insert.str().c_str(), -1, &insertStmt, nullptr) != SQLITE_OK) {
     klee_error("Cannot create prepared statement: %s", sqlite3_errmsg(statsFile));
@@ -518,30 +758,51 @@ time::Span StatsTracker::elapsed() {
 }
 
 void StatsTracker::writeStatsLine() {
-  sqlite3_bind_int64(insertStmt, 1, stats::instructions);
-  sqlite3_bind_int64(insertStmt, 2, fullBranches);
-  sqlite3_bind_int64(insertStmt, 3, partialBranches);
-  sqlite3_bind_int64(insertStmt, 4, numBranches);
-  sqlite3_bind_int64(insertStmt, 5, time::getUserTime().toMicroseconds());
-  sqlite3_bind_int64(insertStmt, 6, executor.states.size());
-  sqlite3_bind_int64(insertStmt, 7, util::GetTotalMallocUsage() + executor.memory->getUsedDeterministicSize());
-  sqlite3_bind_int64(insertStmt, 8, stats::queries);
-  sqlite3_bind_int64(insertStmt, 9, stats::queryConstructs);
-  sqlite3_bind_int64(insertStmt, 10, elapsed().toMicroseconds());
-  sqlite3_bind_int64(insertStmt, 11, stats::coveredInstructions);
-  sqlite3_bind_int64(insertStmt, 12, stats::uncoveredInstructions);
-  sqlite3_bind_int64(insertStmt, 13, stats::queryTime);
-  sqlite3_bind_int64(insertStmt, 14, stats::solverTime);
-  sqlite3_bind_int64(insertStmt, 15, stats::cexCacheTime);
-  sqlite3_bind_int64(insertStmt, 16, stats::forkTime);
-  sqlite3_bind_int64(insertStmt, 17, stats::resolveTime);
-  sqlite3_bind_int64(insertStmt, 18, stats::queryCexCacheMisses);
-  sqlite3_bind_int64(insertStmt, 19, stats::queryCexCacheHits);
+  if (!statsFile)
+    return;
+  // collected here, where the statistics are updated
+  std::vector<sqlite3_int64> row;
+  row.reserve(24 + MemoryAccount::getAccounts().size());
+  row.push_back(stats::instructions);
+  row.push_back(fullBranches);
+  row.push_back(partialBranches);
+  row.push_back(numBranches);
+  row.push_back(time::getUserTime().toMicroseconds());
+  row.push_back(executor.states.size());
+  row.push_back(util::GetTotalMallocUsage() +
+                executor.memory->getUsedDeterministicSize());
+  row.push_back(stats::queries);
+  row.push_back(stats::queryConstructs);
+  row.push_back(elapsed().toMicroseconds());
+  row.push_back(stats::coveredInstructions);
+  row.push_back(stats::uncoveredInstructions);
+  row.push_back(stats::queryTime);
+  row.push_back(stats::solverTime);
+  row.push_back(stats::cexCacheTime);
+  row.push_back(stats::forkTime);
+  row.push_back(stats::resolveTime);
+  row.push_back(stats::queryCexCacheMisses);
+  row.push_back(stats::queryCexCacheHits);
 #ifdef KLEE_ARRAY_DEBUG
-  sqlite3_bind_int64(insertStmt, 20, stats::arrayHashTime);
+  row.push_back(stats::arrayHashTime);
 #else
-  sqlite3_bind_int64(insertStmt, 20, -1LL);
+  row.push_back(-1LL);
 #endif
+  row.push_back(MemoryManager::getPooledObjectCount());
+  row.push_back(MemoryManager::getPoolReservedSize());
+  row.push_back(stats::queryDiskCacheMisses);
+  row.push_back(stats::queryDiskCacheHits);
+  for (const MemoryAccount *account : MemoryAccount::getAccounts())
+    row.push_back(account->getBytes());
+  if (writer)
+    writer->post([this, row] { insertStatsLine(row); });
+  else
+    insertStatsLine(row);
+}
+
+void StatsTracker::insertStatsLine(const std::vector<sqlite3_int64> &row) {
+  for (unsigned i = 0; i < row.size(); ++i)
+    sqlite3_bind_int64(insertStmt, i + 1, row[i]);
   int errCode = sqlite3_step(insertStmt);
   if(errCode != SQLITE_DONE) klee_error("Error writing stats data: %s", sqlite3_errmsg(statsFile));
   sqlite3_reset(insertStmt);
@@ -559,6 +820,51 @@ void StatsTracker::writeStatsLine() {
   }
 }
 
+void StatsTracker::writeSolverStats(const std::deque<QueryShapeStats> &stats) {
+  char *zErrMsg = nullptr;
+  if (sqlite3_exec(statsFile,
+                   "CREATE TABLE solver_stats (Backend TEXT, Metric TEXT, "
+                   "Bucket INTEGER, Count INTEGER)",
+                   nullptr, nullptr, &zErrMsg)) {
+    klee_warning("%s", sqlite3ErrToStringAndFree("Can't create solver_stats: ",
+                                                  zErrMsg)
+                           .c_str());
+    return;
+  }
+  sqlite3_stmt *insert;
+  if (sqlite3_prepare_v2(statsFile,
+                         "INSERT INTO solver_stats VALUES (?, ?, ?, ?)", -1,
+                         &insert, nullptr) != SQLITE_OK) {
+    klee_warning("Cannot create prepared statement: %s",
+                 sqlite3_errmsg(statsFile));
+    return;
+  }
+
+  // a row per non-empty bucket, given by its exclusive upper bound
+  for (const QueryShapeStats &s : stats) {
+    const std::pair<const char *, const QueryShapeStats::Histogram *>
+        metrics[] = {{"Nodes", &s.nodes},
+                     {"Arrays", &s.arrays},
+                     {"UpdateDepth", &s.updateDepth},
+                     {"SolveTime", &s.solveTime}};
+    for (const auto &metric : metrics) {
+      for (unsigned i = 0; i != QueryShapeStats::NumBuckets; ++i) {
+        if (!(*metric.second)[i])
+          continue;
+        sqlite3_bind_text(insert, 1, s.backend.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_text(insert, 2, metric.first, -1, SQLITE_STATIC);
+        sqlite3_bind_int64(insert, 3, sqlite3_int64(1) << i);
+        sqlite3_bind_int64(insert, 4, (*metric.second)[i]);
+        if (sqlite3_step(insert) != SQLITE_DONE)
+          klee_warning("Error writing solver stats: %s",
+                       sqlite3_errmsg(statsFile));
+        sqlite3_reset(insert);
+      }
+    }
+  }
+  sqlite3_finalize(insert);
+}
+
 void StatsTracker::updateStateStatistics(uint64_t addend) {
   for (std::set<ExecutionState*>::iterator it = executor.states.begin(),
          ie = executor.states.end(); it != ie; ++it) {
@@ -573,13 +879,12 @@ void StatsTracker::updateStateStatistics(uint64_t addend) {
 }
 
 void StatsTracker::writeIStats() {
+  if (!istatsFile)
+    return;
   const auto m = executor.kmodule->module.get();
-  llvm::raw_fd_ostream &of = *istatsFile;
-  
-  // We assume that we didn't move the file pointer
-  unsigned istatsSize = of.tell();
-
-  of.seek(0);
+  // formatted here, where the statistics are updated
+  std::string contents;
+  llvm::raw_string_ostream of(contents);
 
   of << "version: 1\n";
   of << "creator: klee\n";
@@ -604,6 +909,11 @@ void StatsTracker::writeIStats() {
   istatsMask.set(sm.getStatisticID("UncoveredInstructions"));
   istatsMask.set(sm.getStatisticID("States"));
   istatsMask.set(sm.getStatisticID("MinDistToUncovered"));
+  istatsMask.set(sm.getStatisticID("SolverTime"));
+  istatsMask.set(sm.getStatisticID("BranchSolverTime"));
+  istatsMask.set(sm.getStatisticID("BoundsSolverTime"));
+  istatsMask.set(sm.getStatisticID("ValueSolverTime"));
+  istatsMask.set(sm.getStatisticID("TestGenSolverTime"));
 
   of << "positions: instr line\n";
 
@@ -714,7 +1024,146 @@ void StatsTracker::writeIStats() {
 
   if (istatsMask.test(stats::states.getID()))
     updateStateStatistics((uint64_t)-1);
-  
+
+  of.flush();
+  if (!writer) {
+    writeIStatsFile(contents);
+    return;
+  }
+
+  // a write that is still queued writes the new contents instead
+  std::lock_guard<std::mutex> lock(istatsMutex);
+  istatsPending.swap(contents);
+  if (istatsQueued)
+    return;
+  istatsQueued = true;
+  writer->post([this] {
+    std::string contents;
+    {
+      std::lock_guard<std::mutex> lock(istatsMutex);
+      contents.swap(istatsPending);
+      istatsQueued = false;
+    }
+    writeIStatsFile(contents);
+  });
+}
+
+void StatsTracker::writeQuerySites() {
+  auto file = executor.interpreterHandler->openOutputFile("query-sites.txt");
+  if (!file)
+    return;
+
+  const StatisticManager &sm = *theStatisticManager;
+  std::vector<const KInstruction *> sites;
+  for (auto &kf : executor.kmodule->functions)
+    for (unsigned i = 0; i < kf->numInstructions; ++i)
+      if (sm.getIndexedValue(stats::solverTime,
+                             executor.kmodule->infos->getID(
+                                 *kf->instructions[i]->inst)))
+        sites.push_back(kf->instructions[i]);
+  std::stable_sort(sites.begin(), sites.end(),
+                   [&](const KInstruction *a, const KInstruction *b) {
+                     return sm.getIndexedValue(stats::solverTime,
+                                               a->info->id) >
+                            sm.getIndexedValue(stats::solverTime,
+                                               b->info->id);
+                   });
+
+  // times in microseconds, the most expensive sites first
+  *file << "Queries Stime SBtime SBCtime SVtime STGtime Location Function\n";
+  for (const KInstruction *ki : sites) {
+    unsigned id = ki->info->id;
+    for (const Statistic *s :
+         {&stats::queries, &stats::solverTime, &stats::branchSolverTime,
+          &stats::boundsSolverTime, &stats::valueSolverTime,
+          &stats::testGenSolverTime})
+      *file << sm.getIndexedValue(*s, id) << " ";
+    // sites without debug information by their line in assembly.ll
+    const InstructionInfo &ii = *ki->info;
+    if (ii.file.empty())
+      *file << "assembly.ll:" << ii.assemblyLine;
+    else
+      *file << ii.file << ":" << ii.line;
+    *file << " " << ki->inst->getFunction()->getName() << "\n";
+  }
+}
+
+void StatsTracker::updateMetrics() {
+  std::string contents;
+  llvm::raw_string_ostream os(contents);
+
+  StatisticManager &sm = *theStatisticManager;
+  os << "# TYPE klee_statistic untyped\n";
+  for (unsigned i = 0; i < sm.getNumStatistics(); ++i) {
+    const Statistic &s = sm.getStatistic(i);
+    os << "klee_statistic{name=\"" << s.getName() << "\"} " << sm.getValue(s)
+       << "\n";
+  }
+
+  os << "# TYPE klee_states gauge\n"
+     << "klee_states " << executor.states.size() << "\n"
+     << "# TYPE klee_parked_states gauge\n"
+     << "klee_parked_states " << executor.parkedStates.size() << "\n"
+     << "# TYPE klee_pending_solver_queries gauge\n"
+     << "klee_pending_solver_queries "
+     << (executor.asyncBranches ? executor.asyncBranches->size() : 0) << "\n"
+     << "# TYPE klee_memory_bytes gauge\n"
+     << "klee_memory_bytes{kind=\"malloc\"} " << util::GetTotalMallocUsage()
+     << "\n"
+     << "klee_memory_bytes{kind=\"deterministic\"} "
+     << executor.memory->getUsedDeterministicSize() << "\n"
+     << "klee_memory_bytes{kind=\"pool_reserved\"} "
+     << MemoryManager::getPoolReservedSize() << "\n"
+     << "klee_memory_bytes{kind=\"expression_slabs\"} "
+     << ExprAllocator::getSlabBytes() << "\n"
+     << "klee_memory_bytes{kind=\"expression_free\"} "
+     << ExprAllocator::getFreeBytes() << "\n"
+     << "# TYPE klee_wall_time_seconds gauge\n"
+     << "klee_wall_time_seconds " << elapsed().toSeconds() << "\n";
+
+  os << "# TYPE klee_subsystem_memory_bytes gauge\n";
+  for (const MemoryAccount *account : MemoryAccount::getAccounts())
+    os << "klee_subsystem_memory_bytes{subsystem=\"" << account->getName()
+       << "\"} " << account->getBytes() << "\n";
+  os << "# TYPE klee_subsystem_memory_budget_bytes gauge\n";
+  for (const MemoryAccount *account : MemoryAccount::getAccounts())
+    if (account->getBudget())
+      os << "klee_subsystem_memory_budget_bytes{subsystem=\""
+         << account->getName() << "\"} " << account->getBudget() << "\n";
+
+  if (executor.searcher) {
+    std::string name;
+    llvm::raw_string_ostream ns(name);
+    executor.searcher->printName(ns);
+    ns.flush();
+    os << "# TYPE klee_searcher_info gauge\n"
+       << "klee_searcher_info{name=\"";
+    // label values are on one line, with quotes and backslashes escaped
+    StringRef trimmed = StringRef(name).trim();
+    for (char c : trimmed) {
+      if (c == '\n')
+        os << ' ';
+      else if (c == '"' || c == '\\')
+        os << '\\' << c;
+      else
+        os << c;
+    }
+    os << "\"} 1\n";
+  }
+
+  os.flush();
+  metricsServer->update(std::move(contents));
+}
+
+void StatsTracker::writeIStatsFile(const std::string &contents) {
+  llvm::raw_fd_ostream &of = *istatsFile;
+
+  // We assume that we didn't move the file pointer
+  unsigned istatsSize = of.tell();
+
+  of.seek(0);
+  of << contents;
+
   // Clear then end of the file if necessary (no truncate op?).
   unsigned pos = of.tell();
   for (unsigned i=pos; i<istatsSize; ++i)
@@ -745,6 +1194,52 @@ static std::vector<Instruction*> getSuccs(Instruction *i) {
   return res;
 }
 
+/// Lower best to the distance to uncovered code through the functions
+/// inst calls. \return the distance from inst to its successors, 0 if they
+/// are unreachable
+static unsigned getMinDistThrough(const InstructionInfoTable &infos,
+                                  Instruction *inst, uint64_t &best) {
+  StatisticManager &sm = *theStatisticManager;
+  unsigned bestThrough = 0;
+
+  if (isa<CallInst>(inst) || isa<InvokeInst>(inst)) {
+    std::vector<Function*> &targets = callTargets[inst];
+    for (std::vector<Function*>::iterator fnIt = targets.begin(),
+           ie = targets.end(); fnIt != ie; ++fnIt) {
+      uint64_t dist = functionShortestPath[*fnIt];
+      if (dist) {
+        dist = 1+dist; // count instruction itself
+        if (bestThrough==0 || dist<bestThrough)
+          bestThrough = dist;
+      }
+
+      if (!(*fnIt)->isDeclaration()) {
+        uint64_t calleeDist = sm.getIndexedValue(
+            stats::minDistToUncovered, infos.getFunctionID(*(*fnIt)));
+        if (calleeDist) {
+          calleeDist = 1+calleeDist; // count instruction itself
+          if (best==0 || calleeDist<best)
+            best = calleeDist;
+        }
+      }
+    }
+  } else {
+    bestThrough = 1;
+  }
+  return bestThrough;
+}
+
+static std::vector<Instruction*> getPreds(Instruction *i) {
+  std::vector<Instruction*> res;
+  if (Instruction *prev = i->getPrevNode()) {
+    res.push_back(prev);
+  } else {
+    for (BasicBlock *pred : predecessors(i->getParent()))
+      res.push_back(pred->getTerminator());
+  }
+  return res;
+}
+
 uint64_t klee::computeMinDistToUncovered(const KInstruction *ki,
                                          uint64_t minDistAtRA) {
   StatisticManager &sm = *theStatisticManager;
@@ -837,7 +1332,7 @@ void StatsTracker::computeReachableUncovered() {
              it != ie; ++it) {
           Instruction *inst = &*it;
           instructions.push_back(inst);
-          unsigned id = infos.getInfo(*inst).id;
+          unsigned id = infos.getID(*inst);
           sm.setIndexedValue(stats::minDistToReturn, 
                              id, 
                              isa<ReturnInst>(inst)
@@ -873,13 +1368,13 @@ void StatsTracker::computeReachableUncovered() {
         }
        
         if (bestThrough) {
-          unsigned id = infos.getInfo(*(*it)).id;
+          unsigned id = infos.getID(*(*it));
           uint64_t best, cur = best = sm.getIndexedValue(stats::minDistToReturn, id);
           std::vector<Instruction*> succs = getSuccs(*it);
           for (std::vector<Instruction*>::iterator it2 = succs.begin(),
                  ie = succs.end(); it2 != ie; ++it2) {
             uint64_t dist = sm.getIndexedValue(stats::minDistToReturn,
-                                               infos.getInfo(*(*it2)).id);
+                                               infos.getID(*(*it2)));
             if (dist) {
               uint64_t val = bestThrough + dist;
               if (best==0 || val<best)
@@ -905,6 +1400,47 @@ void StatsTracker::computeReachableUncovered() {
     } while (changed);
   }
 
+  updateCoveredElsewhere();
+  if (minDistComputed) {
+    updateReachableUncovered();
+  } else {
+    computeAllReachableUncovered();
+    minDistComputed = true;
+  }
+
+  for (std::set<ExecutionState*>::iterator it = executor.states.begin(),
+         ie = executor.states.end(); it != ie; ++it) {
+    ExecutionState *es = *it;
+    uint64_t currentFrameMinDist = 0;
+    for (ExecutionState::stack_ty::const_iterator sfIt = es->stack.begin(),
+           sf_ie = es->stack.end(); sfIt != sf_ie; ++sfIt) {
+      ExecutionState::stack_ty::const_iterator next = sfIt + 1;
+      KInstIterator kii;
+
+      if (next==es->stack.end()) {
+        kii = es->pc;
+        // no other instruction to execute
+        if (!kii)
+            break;
+      } else {
+        kii = next->caller;
+        ++kii;
+      }
+      
+      sfIt->minDistToUncoveredOnReturn = currentFrameMinDist;
+      
+      currentFrameMinDist = computeMinDistToUncovered(kii, currentFrameMinDist);
+    }
+  }
+}
+
+void StatsTracker::computeAllReachableUncovered() {
+  KModule *km = executor.kmodule.get();
+  const auto m = km->module.get();
+  const InstructionInfoTable &infos = *km->infos;
+  StatisticManager &sm = *theStatisticManager;
+  newlyCovered.clear();
+
   // compute minDistToUncovered, 0 is unreachable
   std::vector<Instruction *> instructions;
   for (Module::iterator fnIt = m->begin(), fn_ie = m->end(); 
@@ -915,11 +1451,9 @@ void StatsTracker::computeReachableUncovered() {
       for (BasicBlock::iterator it = bbIt->begin(), ie = bbIt->end(); 
            it != ie; ++it) {
         Instruction *inst = &*it;
-        unsigned id = infos.getInfo(*inst).id;
+        unsigned id = infos.getID(*inst);
         instructions.push_back(inst);
-        sm.setIndexedValue(stats::minDistToUncovered, 
-                           id, 
-                           sm.getIndexedValue(stats::uncoveredInstructions, id));
+        sm.setIndexedValue(stats::minDistToUncovered, id, getUncovered(id));
       }
     }
   }
@@ -934,40 +1468,15 @@ void StatsTracker::computeReachableUncovered() {
            ie = instructions.end(); it != ie; ++it) {
       Instruction *inst = *it;
       uint64_t best, cur = best = sm.getIndexedValue(stats::minDistToUncovered,
-                                                     infos.getInfo(*inst).id);
-      unsigned bestThrough = 0;
-      
-      if (isa<CallInst>(inst) || isa<InvokeInst>(inst)) {
-        std::vector<Function*> &targets = callTargets[inst];
-        for (std::vector<Function*>::iterator fnIt = targets.begin(),
-               ie = targets.end(); fnIt != ie; ++fnIt) {
-          uint64_t dist = functionShortestPath[*fnIt];
-          if (dist) {
-            dist = 1+dist; // count instruction itself
-            if (bestThrough==0 || dist<bestThrough)
-              bestThrough = dist;
-          }
-
-          if (!(*fnIt)->isDeclaration()) {
-            uint64_t calleeDist = sm.getIndexedValue(
-                stats::minDistToUncovered, infos.getFunctionInfo(*(*fnIt)).id);
-            if (calleeDist) {
-              calleeDist = 1+calleeDist; // count instruction itself
-              if (best==0 || calleeDist<best)
-                best = calleeDist;
-            }
-          }
-        }
-      } else {
-        bestThrough = 1;
-      }
+                                                     infos.getID(*inst));
+      unsigned bestThrough = getMinDistThrough(infos, inst, best);
       
       if (bestThrough) {
         std::vector<Instruction*> succs = getSuccs(inst);
         for (std::vector<Instruction*>::iterator it2 = succs.begin(),
                ie = succs.end(); it2 != ie; ++it2) {
           uint64_t dist = sm.getIndexedValue(stats::minDistToUncovered,
-                                             infos.getInfo(*(*it2)).id);
+                                             infos.getID(*(*it2)));
           if (dist) {
             uint64_t val = bestThrough + dist;
             if (best==0 || val<best)
@@ -977,35 +1486,112 @@ void StatsTracker::computeReachableUncovered() {
       }
 
       if (best != cur) {
-        sm.setIndexedValue(stats::minDistToUncovered, infos.getInfo(*inst).id,
+        sm.setIndexedValue(stats::minDistToUncovered, infos.getID(*inst),
                            best);
         changed = true;
       }
     }
   } while (changed);
+}
 
-  for (std::set<ExecutionState*>::iterator it = executor.states.begin(),
-         ie = executor.states.end(); it != ie; ++it) {
-    ExecutionState *es = *it;
-    uint64_t currentFrameMinDist = 0;
-    for (ExecutionState::stack_ty::iterator sfIt = es->stack.begin(),
-           sf_ie = es->stack.end(); sfIt != sf_ie; ++sfIt) {
-      ExecutionState::stack_ty::iterator next = sfIt + 1;
-      KInstIterator kii;
+void StatsTracker::updateCoveredElsewhere() {
+  if (!sharedCoverage && !coverageBitmap)
+    return;
+  KModule *km = executor.kmodule.get();
+  coveredElsewhere.resize(km->infos->getMaxID());
+  for (auto &kf : km->functions) {
+    for (unsigned i = 0; i < kf->numInstructions; ++i) {
+      KInstruction *ki = kf->instructions[i];
+      unsigned id = ki->info->id;
+      if (coveredElsewhere[id] ||
+          !((sharedCoverage && sharedCoverage[id].load()) ||
+            (coverageBitmap && coverageBitmap->isCovered(id))))
+        continue;
+      coveredElsewhere[id] = true;
+      if (theStatisticManager->getIndexedValue(stats::uncoveredInstructions,
+                                               id))
+        newlyCovered.push_back(ki->inst);
+    }
+  }
+}
 
-      if (next==es->stack.end()) {
-        kii = es->pc;
-        // no other instruction to execute
-        if (!kii)
-            break;
-      } else {
-        kii = next->caller;
-        ++kii;
+uint64_t StatsTracker::getUncovered(unsigned id) const {
+  if (id < coveredElsewhere.size() && coveredElsewhere[id])
+    return 0;
+  return theStatisticManager->getIndexedValue(stats::uncoveredInstructions,
+                                              id);
+}
+
+void StatsTracker::updateReachableUncovered() {
+  const InstructionInfoTable &infos = *executor.kmodule->infos;
+  StatisticManager &sm = *theStatisticManager;
+  auto getDist = [&](Instruction *inst) {
+    return sm.getIndexedValue(stats::minDistToUncovered,
+                              infos.getID(*inst));
+  };
+  auto setDist = [&](Instruction *inst, uint64_t dist) {
+    sm.setIndexedValue(stats::minDistToUncovered, infos.getID(*inst),
+                       dist);
+  };
+
+  // Coverage only grows, so distances only increase. Those that may have
+  // been reached through a newly covered instruction are recomputed: the
+  // predecessors whose distance is exactly one step more, transitively.
+  std::set<Instruction*> affected(newlyCovered.begin(), newlyCovered.end());
+  std::vector<Instruction*> worklist(affected.begin(), affected.end());
+  newlyCovered.clear();
+  while (!worklist.empty()) {
+    Instruction *inst = worklist.back();
+    worklist.pop_back();
+    uint64_t dist = getDist(inst);
+    if (!dist)
+      continue;
+    for (Instruction *pred : getPreds(inst)) {
+      if (affected.count(pred))
+        continue;
+      uint64_t predDist = getDist(pred), ignored = 0;
+      unsigned through = getMinDistThrough(infos, pred, ignored);
+      if (through && predDist == through + dist) {
+        affected.insert(pred);
+        worklist.push_back(pred);
+      }
+    }
+  }
+
+  // start from the distances through unaffected instructions, then settle
+  // the affected ones in order of distance
+  typedef std::pair<uint64_t, Instruction*> entry_ty;
+  std::priority_queue<entry_ty, std::vector<entry_ty>, std::greater<entry_ty>>
+      queue;
+  for (Instruction *inst : affected) {
+    uint64_t best = getUncovered(infos.getID(*inst));
+    if (unsigned through = getMinDistThrough(infos, inst, best)) {
+      for (Instruction *succ : getSuccs(inst)) {
+        uint64_t dist = getDist(succ);
+        if (dist && !affected.count(succ) &&
+            (best == 0 || through + dist < best))
+          best = through + dist;
+      }
+    }
+    setDist(inst, best);
+    if (best)
+      queue.push({best, inst});
+  }
+
+  while (!queue.empty()) {
+    entry_ty top = queue.top();
+    queue.pop();
+    if (top.first != getDist(top.second))
+      continue;
+    for (Instruction *pred : getPreds(top.second)) {
+      if (!affected.count(pred))
+        continue;
+      uint64_t best = getDist(pred), ignored = 0;
+      unsigned through = getMinDistThrough(infos, pred, ignored);
+      if (through && (best == 0 || through + top.first < best)) {
+        setDist(pred, through + top.first);
+        queue.push({through + top.first, pred});
       }
-      
-      sfIt->minDistToUncoveredOnReturn = currentFrameMinDist;
-      
-      currentFrameMinDist = computeMinDistToUncovered(kii, currentFrameMinDist);
     }
   }
 }
@@ -13,9 +13,15 @@
 #include "CallPathManager.h"
 #include "klee/System/Time.h"
 
+#include <atomic>
+#include <cstdint>
+#include <deque>
 #include <memory>
+#include <mutex>
 #include <set>
 #include <sqlite3.h>
+#include <string>
+#include <vector>
 
 namespace llvm {
   class BranchInst;
@@ -25,12 +31,16 @@ namespace llvm {
 }
 
 namespace klee {
+  class CoverageBitmap;
   class ExecutionState;
   class Executor;
   class InstructionInfoTable;
   class InterpreterHandler;
+  class MetricsServer;
+  struct QueryShapeStats;
   struct KInstruction;
   struct StackFrame;
+  class StatsWriter;
 
   class StatsTracker {
     friend class WriteStatsTimer;
@@ -47,6 +57,18 @@ namespace klee {
     std::uint32_t statsCommitEvery;
     std::uint32_t statsWriteCount = 0;
     time::Point startWallTime;
+    bool outputOpened = false;
+
+    /// Writes the files in the background, see --stats-background-writer
+    std::unique_ptr<StatsWriter> writer;
+    /// The latest contents of istatsFile not written yet, only one write of
+    /// it is queued at a time
+    std::mutex istatsMutex;
+    std::string istatsPending;
+    bool istatsQueued = false;
+
+    /// Serves the metrics of --metrics-socket
+    std::unique_ptr<MetricsServer> metricsServer;
 
     unsigned numBranches;
     unsigned fullBranches, partialBranches;
@@ -54,6 +76,20 @@ namespace klee {
     CallPathManager callPathManager;
 
     bool updateMinDistToUncovered;
+    /// Whether minDistToUncovered was computed for all instructions, later
+    /// updates only propagate from the instructions covered since.
+    bool minDistComputed = false;
+    std::vector<llvm::Instruction *> newlyCovered;
+    /// The coverage shared by the members of a portfolio, which only count
+    /// an instruction as covering new code for the first member covering it.
+    std::atomic<std::uint8_t> *sharedCoverage = nullptr;
+    /// The coverage of --coverage-bitmap, which counts like that of a
+    /// portfolio.
+    std::unique_ptr<CoverageBitmap> coverageBitmap;
+    /// The instructions that minDistToUncovered takes as covered by other
+    /// processes, indexed by instruction id: those of sharedCoverage and
+    /// coverageBitmap when it was last updated.
+    std::vector<bool> coveredElsewhere;
 
   public:
     static bool useStatistics();
@@ -63,7 +99,24 @@ namespace klee {
     void updateStateStatistics(uint64_t addend);
     void writeStatsHeader();
     void writeStatsLine();
+    /// Inserts a row of the values collected by writeStatsLine
+    void insertStatsLine(const std::vector<sqlite3_int64> &row);
+    /// Writes the histograms of --query-shape-stats to the solver_stats
+    /// table
+    void writeSolverStats(const std::deque<QueryShapeStats> &stats);
     void writeIStats();
+    void writeIStatsFile(const std::string &contents);
+    /// Writes the summary of --write-query-sites
+    void writeQuerySites();
+    /// Hands the current metrics to metricsServer
+    void updateMetrics();
+    void computeAllReachableUncovered();
+    void updateReachableUncovered();
+    /// Adds the instructions covered by other processes since the last call
+    /// to coveredElsewhere and newlyCovered.
+    void updateCoveredElsewhere();
+    /// Whether the instruction is uncovered, to minDistToUncovered.
+    uint64_t getUncovered(unsigned id) const;
 
   public:
     StatsTracker(Executor &_executor, std::string _objectFilename,
@@ -76,7 +129,7 @@ namespace klee {
     StatsTracker &operator=(StatsTracker &&other) noexcept = delete;
 
     // called after a new StackFrame has been pushed (for callpath tracing)
-    void framePushed(ExecutionState &es, StackFrame *parentFrame);
+    void framePushed(ExecutionState &es, const StackFrame *parentFrame);
 
     // called after a StackFrame has been popped
     void framePopped(ExecutionState &es);
@@ -87,13 +140,34 @@ namespace klee {
     void markBranchVisited(ExecutionState *visitedTrue,
                            ExecutionState *visitedFalse);
 
+    // called when the first run starts, opens the stats files in the output
+    // directory of the handler at that time
+    void openOutput();
+
     // called when execution is done and stats files should be flushed
     void done();
 
+    // called in the worker processes of a parallel run, which leave the
+    // stats files to the original process
+    void disableOutput();
+
+    // called in the members of a portfolio with the coverage bitmap they
+    // share, indexed by instruction id, or null once they are done
+    void setSharedCoverage(std::atomic<std::uint8_t> *coverage);
+
+    // the ids of the covered instructions, for checkpoints
+    void getCoverage(std::vector<std::uint32_t> &covered) const;
+    // mark instructions covered by the run a checkpoint was written in
+    void restoreCoverage(const std::vector<std::uint32_t> &covered);
+
     // process stats for a single instruction step, es is the state
     // about to be stepped
     void stepInstruction(ExecutionState &es);
 
+    // return to the statistics index of instruction ki, which es is
+    // resuming after it was parked within it
+    void resumeInstruction(ExecutionState &es, KInstruction *ki);
+
     /// Return duration since execution start.
     time::Span elapsed();
 
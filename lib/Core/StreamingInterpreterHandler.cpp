@@ -0,0 +1,66 @@
+//===-- StreamingInterpreterHandler.cpp -----------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Core/StreamingInterpreterHandler.h"
+
+#include "klee/Support/ErrorHandling.h"
+#include "klee/Support/FileHandling.h"
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/Path.h"
+
+#include <cassert>
+
+using namespace klee;
+
+StreamingInterpreterHandler::StreamingInterpreterHandler(
+    Callback callback, std::string outputDirectory)
+    : callback(std::move(callback)),
+      outputDirectory(std::move(outputDirectory)), infoStream(info) {}
+
+std::string
+StreamingInterpreterHandler::getOutputFilename(const std::string &filename) {
+  if (outputDirectory.empty())
+    return "";
+  llvm::SmallString<128> path(outputDirectory);
+  llvm::sys::path::append(path, filename);
+  return path.c_str();
+}
+
+std::unique_ptr<llvm::raw_fd_ostream>
+StreamingInterpreterHandler::openOutputFile(const std::string &filename) {
+  if (outputDirectory.empty())
+    return nullptr;
+  std::string error;
+  std::string path = getOutputFilename(filename);
+  auto f = klee_open_output_file(path, error);
+  if (!f)
+    klee_warning("error opening file \"%s\" (%s)", path.c_str(),
+                 error.c_str());
+  return f;
+}
+
+void StreamingInterpreterHandler::processTestCase(const ExecutionState &state,
+                                                  const char *err,
+                                                  const char *suffix) {
+  assert(interpreter && "setInterpreter was not called");
+  TestCase testCase;
+  if (!interpreter->getSymbolicSolution(state, testCase.objects)) {
+    klee_warning("unable to get symbolic solution, losing test case");
+    return;
+  }
+  if (err) {
+    testCase.error = err;
+    testCase.suffix = suffix;
+  }
+  interpreter->getConstraintLog(state, testCase.constraints,
+                                Interpreter::KQUERY);
+  ++testCases;
+  callback(testCase);
+}
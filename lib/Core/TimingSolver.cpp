@@ -9,6 +9,7 @@
 
 #include "TimingSolver.h"
 
+#include "EventTrace.h"
 #include "ExecutionState.h"
 
 #include "klee/Config/Version.h"
@@ -17,14 +18,140 @@
 #include "klee/Statistics/Statistics.h"
 #include "klee/Statistics/TimerStatIncrementer.h"
 #include "klee/Solver/Solver.h"
+#include "klee/Support/ErrorHandling.h"
+#include "klee/Support/OptionCategories.h"
+#include "klee/Support/Timer.h"
 
 #include "CoreStats.h"
 
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/MathExtras.h"
+
+#include <algorithm>
+#include <set>
+
 using namespace klee;
 using namespace llvm;
 
+namespace {
+cl::opt<bool> AdaptiveSolverTimeouts(
+    "adaptive-solver-timeouts", cl::init(false),
+    cl::desc("Shorten the timeouts of branch and bounds check queries to a "
+             "multiple of the longest solve time of similar queries. Test "
+             "generation always gets the full timeout (default=false)"),
+    cl::cat(SolvingCat));
+
+cl::opt<unsigned> AdaptiveSolverTimeoutFactor(
+    "adaptive-solver-timeout-factor", cl::init(10),
+    cl::desc("Multiple of the longest solve time of similar queries "
+             "allowed with --adaptive-solver-timeouts (default=10)"),
+    cl::cat(SolvingCat));
+
+/// The number of solved queries of a feature class before its timeout
+/// is shortened.
+const unsigned MinSamples = 16;
+
+/// The shortest adaptive timeout.
+const time::Span MinTimeout = time::milliseconds(100);
+} // namespace
+
 /***/
 
+TimingSolver::~TimingSolver() {
+  if (uint64_t stopped = stats::adaptiveSolverTimeouts)
+    klee_message("adaptive solver timeouts stopped %lu queries, saving %.2fs",
+                 stopped, stats::solverTimeSaved / 1e6);
+}
+
+void TimingSolver::addQueryCost(SolverQueryMetaData &metaData,
+                                time::Span cost, bool valueQuery) {
+  metaData.addQueryCost(cost);
+  uint64_t us = cost.toMicroseconds();
+  if (metaData.fromMerge)
+    stats::mergedQueryTime += us;
+  // charged to the instruction and call path that issued the query, like
+  // solverTime
+  switch (queryKind) {
+  case QueryKind::Branch:
+    stats::branchSolverTime += us;
+    break;
+  case QueryKind::BoundsCheck:
+    stats::boundsSolverTime += us;
+    break;
+  case QueryKind::TestGeneration:
+    stats::testGenSolverTime += us;
+    break;
+  case QueryKind::Other:
+    if (valueQuery)
+      stats::valueSolverTime += us;
+    break;
+  }
+}
+
+uint32_t TimingSolver::getFeatureKey(const Query &query, QueryKind kind) {
+  std::vector<ref<ReadExpr>> reads;
+  findReads(query.expr, /* visitUpdates= */ false, reads);
+  std::set<const Array *> arrays;
+  unsigned depth = 0;
+  for (const auto &re : reads) {
+    arrays.insert(re->updates.root);
+    depth = std::max(depth, re->updates.getSize());
+  }
+
+  // logarithmic buckets of the query size and update list depth
+  auto bucket = [](uint64_t n) { return std::min(Log2_64(n + 1), 15u); };
+  uint32_t key = static_cast<uint32_t>(kind);
+  key = (key << 4) | bucket(query.constraints.size());
+  key = (key << 4) | bucket(reads.size());
+  key = (key << 4) | std::min<uint32_t>(arrays.size(), 15);
+  key = (key << 4) | bucket(depth);
+  return key;
+}
+
+bool TimingSolver::solve(const Query &query,
+                         const std::function<bool()> &run) {
+  if (!trace)
+    return solveWithTimeout(query, run);
+  const auto kind = static_cast<std::uint8_t>(queryKind);
+  trace->recordCurrent(EventTrace::QueryStart, kind);
+  bool success = solveWithTimeout(query, run);
+  trace->recordCurrent(EventTrace::QueryEnd, kind, success);
+  return success;
+}
+
+bool TimingSolver::solveWithTimeout(const Query &query,
+                                    const std::function<bool()> &run) {
+  if (!AdaptiveSolverTimeouts || !timeout ||
+      queryKind == QueryKind::TestGeneration)
+    return run();
+
+  QueryHistory &similar = history[getFeatureKey(query, queryKind)];
+  time::Span queryTimeout = timeout;
+  if (similar.samples >= MinSamples)
+    queryTimeout = std::min(
+        timeout, std::max(MinTimeout, similar.longest *
+                                          AdaptiveSolverTimeoutFactor.getValue()));
+  if (queryTimeout < timeout)
+    solver->setCoreSolverTimeout(queryTimeout);
+
+  WallTimer timer;
+  bool success = run();
+  time::Span elapsed = timer.delta();
+
+  if (queryTimeout < timeout) {
+    solver->setCoreSolverTimeout(timeout);
+    if (!success) {
+      ++stats::adaptiveSolverTimeouts;
+      stats::solverTimeSaved += (timeout - queryTimeout).toMicroseconds();
+    }
+  }
+  if (success) {
+    ++similar.samples;
+    similar.longest = std::max(similar.longest, elapsed);
+  }
+  return success;
+}
+
 bool TimingSolver::evaluate(const ConstraintSet &constraints, ref<Expr> expr,
                             Solver::Validity &result,
                             SolverQueryMetaData &metaData) {
@@ -38,10 +165,12 @@ bool TimingSolver::evaluate(const ConstraintSet &constraints, ref<Expr> expr,
 
   if (simplifyExprs)
     expr = ConstraintManager::simplifyExpr(constraints, expr);
+  expr = rewrite(expr);
 
-  bool success = solver->evaluate(Query(constraints, expr), result);
+  Query query(constraints, expr);
+  bool success = solve(query, [&] { return solver->evaluate(query, result); });
 
-  metaData.queryCost += timer.delta();
+  addQueryCost(metaData, timer.delta());
 
   return success;
 }
@@ -58,10 +187,13 @@ bool TimingSolver::mustBeTrue(const ConstraintSet &constraints, ref<Expr> expr,
 
   if (simplifyExprs)
     expr = ConstraintManager::simplifyExpr(constraints, expr);
+  expr = rewrite(expr);
 
-  bool success = solver->mustBeTrue(Query(constraints, expr), result);
+  Query query(constraints, expr);
+  bool success =
+      solve(query, [&] { return solver->mustBeTrue(query, result); });
 
-  metaData.queryCost += timer.delta();
+  addQueryCost(metaData, timer.delta());
 
   return success;
 }
@@ -102,10 +234,12 @@ bool TimingSolver::getValue(const ConstraintSet &constraints, ref<Expr> expr,
 
   if (simplifyExprs)
     expr = ConstraintManager::simplifyExpr(constraints, expr);
+  expr = rewrite(expr);
 
-  bool success = solver->getValue(Query(constraints, expr), result);
+  Query query(constraints, expr);
+  bool success = solve(query, [&] { return solver->getValue(query, result); });
 
-  metaData.queryCost += timer.delta();
+  addQueryCost(metaData, timer.delta(), /*valueQuery=*/true);
 
   return success;
 }
@@ -131,16 +265,19 @@ bool TimingSolver::getValue(const ConstraintSet& constraints, KValue value,
     segment = ConstraintManager::simplifyExpr(constraints, segment);
     offset = ConstraintManager::simplifyExpr(constraints, offset);
   }
+  segment = rewrite(segment);
+  offset = rewrite(offset);
 
   Query query(constraints, ConstantExpr::alloc(0, Expr::Bool));
   std::shared_ptr<const Assignment> assignment;
-  bool success = solver->getInitialValues(query, assignment);
+  bool success = solve(
+      query, [&] { return solver->getInitialValues(query, assignment); });
   if (success) {
     segmentResult = cast<ConstantExpr>(assignment->evaluate(segment));
     offsetResult = cast<ConstantExpr>(assignment->evaluate(offset));
   }
 
-  metaData.queryCost += timer.delta() / 1e6;
+  addQueryCost(metaData, timer.delta(), /*valueQuery=*/true);
 
   return success;
 }
@@ -150,12 +287,11 @@ bool TimingSolver::getInitialValues(
     SolverQueryMetaData &metaData) {
   TimerStatIncrementer timer(stats::solverTime);
 
-  bool success = solver->getInitialValues(
-      Query(constraints,
-                                                ConstantExpr::alloc(0, Expr::Bool)),
-                                          result);
+  Query query(constraints, ConstantExpr::alloc(0, Expr::Bool));
+  bool success =
+      solve(query, [&] { return solver->getInitialValues(query, result); });
 
-  metaData.queryCost += timer.delta();
+  addQueryCost(metaData, timer.delta());
   return success;
 }
 
@@ -163,7 +299,12 @@ std::pair<ref<ConstantExpr>, ref<ConstantExpr>>
 TimingSolver::getRange(const ConstraintSet &constraints, ref<Expr> expr,
                        SolverQueryMetaData &metaData) {
   TimerStatIncrementer timer(stats::solverTime);
+  const auto kind = static_cast<std::uint8_t>(queryKind);
+  if (trace)
+    trace->recordCurrent(EventTrace::QueryStart, kind);
   auto result = solver->getRange(Query(constraints, expr));
-  metaData.queryCost += timer.delta();
+  if (trace)
+    trace->recordCurrent(EventTrace::QueryEnd, kind, true);
+  addQueryCost(metaData, timer.delta(), /*valueQuery=*/true);
   return result;
 }
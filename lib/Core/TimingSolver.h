@@ -13,23 +13,59 @@
 #include "klee/Expr/Assignment.h"
 #include "klee/Expr/Constraints.h"
 #include "klee/Expr/Expr.h"
+#include "klee/Expr/ExprBuilder.h"
 #include "klee/Module/KValue.h"
 #include "klee/Solver/Solver.h"
 #include "klee/System/Time.h"
 
+#include <functional>
 #include <memory>
+#include <unordered_map>
 #include <vector>
 
 namespace klee {
 class ConstraintSet;
+class EventTrace;
 class Solver;
 
 /// TimingSolver - A simple class which wraps a solver and handles
 /// tracking the statistics that we care about.
 class TimingSolver {
 public:
+  /// The kinds of queries timeouts are set for.
+  enum class QueryKind { Branch, BoundsCheck, TestGeneration, Other };
+
   std::unique_ptr<Solver> solver;
   bool simplifyExprs;
+  /// If set, rebuilds the expressions of the queries, after their
+  /// simplification, to shrink them before they reach the solver.
+  std::unique_ptr<ExprRebuilder> rewriter;
+  /// Records the start and end of each query, if --event-trace is enabled.
+  EventTrace *trace = nullptr;
+
+private:
+  /// The solve times of the queries of one feature class.
+  struct QueryHistory {
+    unsigned samples = 0;
+    time::Span longest;
+  };
+
+  time::Span timeout;
+  QueryKind queryKind = QueryKind::Other;
+  /// Indexed by the feature key of the queries (see getFeatureKey).
+  std::unordered_map<uint32_t, QueryHistory> history;
+
+  /// Record the cost of a query of a state, also by the kind of the query.
+  /// valueQuery tells concretizations apart from other queries of no kind.
+  void addQueryCost(SolverQueryMetaData &metaData, time::Span cost,
+                    bool valueQuery = false);
+
+  static uint32_t getFeatureKey(const Query &query, QueryKind kind);
+
+  /// Call run to solve query. With adaptive timeouts, the timeout is
+  /// shortened to a multiple of the longest solve time of similar queries.
+  bool solve(const Query &query, const std::function<bool()> &run);
+  bool solveWithTimeout(const Query &query, const std::function<bool()> &run);
 
 public:
   /// TimingSolver - Construct a new timing solver.
@@ -39,8 +75,20 @@ public:
   /// querying.
   TimingSolver(Solver *_solver, bool _simplifyExprs = true)
       : solver(_solver), simplifyExprs(_simplifyExprs) {}
+  ~TimingSolver();
+
+  /// Set the timeout for the following queries, which are of the given
+  /// kind. An empty span disables the timeout.
+  void setTimeout(time::Span t, QueryKind kind = QueryKind::Other) {
+    timeout = t;
+    queryKind = kind;
+    solver->setCoreSolverTimeout(t);
+  }
 
-  void setTimeout(time::Span t) { solver->setCoreSolverTimeout(t); }
+  /// Returns expr rebuilt by the rewriter, if there is one.
+  ref<Expr> rewrite(const ref<Expr> &expr) {
+    return rewriter ? rewriter->rebuild(expr) : expr;
+  }
 
   char *getConstraintLog(const Query &query) {
     return solver->getConstraintLog(query);
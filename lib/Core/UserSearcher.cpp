@@ -15,6 +15,7 @@
 
 #include "klee/Support/ErrorHandling.h"
 
+#include "llvm/ADT/STLExtras.h"
 #include "llvm/Support/CommandLine.h"
 
 using namespace llvm;
@@ -47,7 +48,31 @@ cl::list<Searcher::CoreSearchType> CoreSearch(
                    "use NURS with Instr-Count"),
         clEnumValN(Searcher::NURS_CPICnt, "nurs:cpicnt",
                    "use NURS with CallPath-Instr-Count"),
-        clEnumValN(Searcher::NURS_QC, "nurs:qc", "use NURS with Query-Cost")),
+        clEnumValN(Searcher::NURS_QC, "nurs:qc", "use NURS with Query-Cost"),
+        clEnumValN(Searcher::NURS_SC, "nurs:sc",
+                   "use NURS with Coverage-New divided by the solver cost "
+                   "predicted from the recent queries of a state"),
+        clEnumValN(Searcher::ErrorDistance, "error-dist",
+                   "select the state closest to a call of an error function "
+                   "(__assert_fail, __INSTR_fail or --error-fn)"),
+        clEnumValN(Searcher::FeatureScore, "feature-score",
+                   "select the state scored highest by the model of "
+                   "--feature-model")),
+    cl::cat(SearchCat));
+
+cl::opt<std::string> FeatureModel(
+    "feature-model",
+    cl::desc("Scoring model of --search=feature-score: a linear model or a "
+             "decision tree over the features of a state, see "
+             "StateScoring.h for the format"),
+    cl::cat(SearchCat));
+
+cl::opt<unsigned> WeightUpdateInterval(
+    "weight-update-interval",
+    cl::desc("Number of consecutive steps of a state between updates of its "
+             "weight in the NURS searchers. The weight is always updated "
+             "when another state is stepped (default=1)"),
+    cl::init(1),
     cl::cat(SearchCat));
 
 cl::opt<bool> UseIterativeDeepeningTimeSearch(
@@ -79,6 +104,52 @@ cl::opt<std::string> BatchTime(
     cl::init("5s"),
     cl::cat(SearchCat));
 
+cl::opt<bool> BatchAdaptive(
+    "batch-adaptive",
+    cl::desc("Adjust the instruction budget of each state when using "
+             "--use-batching-search: it grows for states covering new "
+             "instructions or when selecting states is expensive, and "
+             "shrinks for states spending their batches in the solver "
+             "(default=false)"),
+    cl::init(false),
+    cl::cat(SearchCat));
+
+cl::opt<unsigned> SolverAffinity(
+    "solver-affinity",
+    cl::desc("Keep selecting the last selected state and the states forked "
+             "from it, which share most of their constraints in an "
+             "incremental solver (see --z3-incremental-contexts), over up to "
+             "this many choices of other states by the searchers "
+             "(default=0 (off))"),
+    cl::init(0),
+    cl::cat(SearchCat));
+
+cl::opt<unsigned> Portfolio(
+    "portfolio",
+    cl::desc("Run this many independent explorations of the program in "
+             "forked processes, the first with the searchers given by "
+             "--search and the others with a rotation of searchers and "
+             "their own seeds. They share the coverage, the numbering of "
+             "the test cases and, unless --persistent-query-cache is given, "
+             "a query cache file in the output directory. Only one test "
+             "case is written per set of newly covered lines, errors "
+             "aside. The stats files only cover the first exploration "
+             "(default=0 (off))"),
+    cl::init(0),
+    cl::cat(SearchCat));
+
+/// The searchers of the members of a portfolio but the first.
+const std::vector<Searcher::CoreSearchType> PortfolioSearchers[] = {
+    {Searcher::NURS_CovNew},
+    {Searcher::RandomPath},
+    {Searcher::DFS},
+    {Searcher::NURS_MD2U},
+    {Searcher::RandomState},
+    {Searcher::NURS_Depth},
+    {Searcher::BFS},
+    {Searcher::NURS_ICnt},
+};
+
 } // namespace
 
 void klee::initializeSearchOptions() {
@@ -95,50 +166,83 @@ void klee::initializeSearchOptions() {
 }
 
 bool klee::userSearcherRequiresMD2U() {
-  return (std::find(CoreSearch.begin(), CoreSearch.end(), Searcher::NURS_MD2U) != CoreSearch.end() ||
+  return (userSearcherPortfolioSize() > 1 ||
+          std::find(CoreSearch.begin(), CoreSearch.end(), Searcher::NURS_MD2U) != CoreSearch.end() ||
           std::find(CoreSearch.begin(), CoreSearch.end(), Searcher::NURS_CovNew) != CoreSearch.end() ||
           std::find(CoreSearch.begin(), CoreSearch.end(), Searcher::NURS_ICnt) != CoreSearch.end() ||
           std::find(CoreSearch.begin(), CoreSearch.end(), Searcher::NURS_CPICnt) != CoreSearch.end() ||
-          std::find(CoreSearch.begin(), CoreSearch.end(), Searcher::NURS_QC) != CoreSearch.end());
+          std::find(CoreSearch.begin(), CoreSearch.end(), Searcher::NURS_QC) != CoreSearch.end() ||
+          std::find(CoreSearch.begin(), CoreSearch.end(), Searcher::NURS_SC) != CoreSearch.end() ||
+          std::find(CoreSearch.begin(), CoreSearch.end(), Searcher::FeatureScore) != CoreSearch.end());
 }
 
 
-Searcher *getNewSearcher(Searcher::CoreSearchType type, RNG &rng, PTree &processTree) {
+Searcher *getNewSearcher(Searcher::CoreSearchType type, RNG &rng,
+                         PTree &processTree, const KModule &kmodule) {
   Searcher *searcher = nullptr;
   switch (type) {
     case Searcher::DFS: searcher = new DFSSearcher(); break;
     case Searcher::BFS: searcher = new BFSSearcher(); break;
     case Searcher::RandomState: searcher = new RandomSearcher(rng); break;
     case Searcher::RandomPath: searcher = new RandomPathSearcher(processTree, rng); break;
-    case Searcher::NURS_CovNew: searcher = new WeightedRandomSearcher(WeightedRandomSearcher::CoveringNew, rng); break;
-    case Searcher::NURS_MD2U: searcher = new WeightedRandomSearcher(WeightedRandomSearcher::MinDistToUncovered, rng); break;
-    case Searcher::NURS_Depth: searcher = new WeightedRandomSearcher(WeightedRandomSearcher::Depth, rng); break;
-    case Searcher::NURS_RP: searcher = new WeightedRandomSearcher(WeightedRandomSearcher::RP, rng); break;
-    case Searcher::NURS_ICnt: searcher = new WeightedRandomSearcher(WeightedRandomSearcher::InstCount, rng); break;
-    case Searcher::NURS_CPICnt: searcher = new WeightedRandomSearcher(WeightedRandomSearcher::CPInstCount, rng); break;
-    case Searcher::NURS_QC: searcher = new WeightedRandomSearcher(WeightedRandomSearcher::QueryCost, rng); break;
+    case Searcher::NURS_CovNew: searcher = new WeightedRandomSearcher(WeightedRandomSearcher::CoveringNew, rng, WeightUpdateInterval); break;
+    case Searcher::NURS_MD2U: searcher = new WeightedRandomSearcher(WeightedRandomSearcher::MinDistToUncovered, rng, WeightUpdateInterval); break;
+    case Searcher::NURS_Depth: searcher = new WeightedRandomSearcher(WeightedRandomSearcher::Depth, rng, WeightUpdateInterval); break;
+    case Searcher::NURS_RP: searcher = new WeightedRandomSearcher(WeightedRandomSearcher::RP, rng, WeightUpdateInterval); break;
+    case Searcher::NURS_ICnt: searcher = new WeightedRandomSearcher(WeightedRandomSearcher::InstCount, rng, WeightUpdateInterval); break;
+    case Searcher::NURS_CPICnt: searcher = new WeightedRandomSearcher(WeightedRandomSearcher::CPInstCount, rng, WeightUpdateInterval); break;
+    case Searcher::NURS_QC: searcher = new WeightedRandomSearcher(WeightedRandomSearcher::QueryCost, rng, WeightUpdateInterval); break;
+    case Searcher::NURS_SC: searcher = new WeightedRandomSearcher(WeightedRandomSearcher::SolverCost, rng, WeightUpdateInterval); break;
+    case Searcher::ErrorDistance: searcher = new DistanceToErrorSearcher(kmodule); break;
+    case Searcher::FeatureScore: {
+      if (FeatureModel.empty())
+        klee_error("--search=feature-score requires --feature-model");
+      std::string error;
+      auto model = ScoringModel::load(FeatureModel, error);
+      if (!model)
+        klee_error("unable to load feature model %s: %s",
+                   FeatureModel.c_str(), error.c_str());
+      searcher = new FeatureSearcher(std::move(model), kmodule);
+      break;
+    }
   }
 
   return searcher;
 }
 
-Searcher *klee::constructUserSearcher(Executor &executor) {
+unsigned klee::userSearcherPortfolioSize() {
+  return std::max(1u, Portfolio.getValue());
+}
+
+Searcher *klee::constructUserSearcher(Executor &executor,
+                                      unsigned portfolioIndex) {
+  std::vector<Searcher::CoreSearchType> coreSearch(CoreSearch.begin(),
+                                                   CoreSearch.end());
+  if (portfolioIndex)
+    coreSearch = PortfolioSearchers[(portfolioIndex - 1) %
+                                    llvm::array_lengthof(PortfolioSearchers)];
 
-  Searcher *searcher = getNewSearcher(CoreSearch[0], executor.theRNG, *executor.processTree);
+  Searcher *searcher = getNewSearcher(coreSearch[0], executor.theRNG,
+                                      *executor.processTree, *executor.kmodule);
 
-  if (CoreSearch.size() > 1) {
+  if (coreSearch.size() > 1) {
     std::vector<Searcher *> s;
     s.push_back(searcher);
 
-    for (unsigned i = 1; i < CoreSearch.size(); i++)
-      s.push_back(getNewSearcher(CoreSearch[i], executor.theRNG, *executor.processTree));
+    for (unsigned i = 1; i < coreSearch.size(); i++)
+      s.push_back(getNewSearcher(coreSearch[i], executor.theRNG,
+                                 *executor.processTree, *executor.kmodule));
 
     searcher = new InterleavedSearcher(s);
   }
 
   if (UseBatchingSearch) {
     searcher = new BatchingSearcher(searcher, time::Span(BatchTime),
-                                    BatchInstructions);
+                                    BatchInstructions, BatchAdaptive);
+  }
+
+  if (SolverAffinity) {
+    searcher = new SolverAffinitySearcher(searcher, SolverAffinity);
   }
 
   if (UseIterativeDeepeningTimeSearch) {
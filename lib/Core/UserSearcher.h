@@ -19,7 +19,14 @@ namespace klee {
 
   void initializeSearchOptions();
 
-  Searcher *constructUserSearcher(Executor &executor);
+  /// The number of explorations of a portfolio run (see --portfolio), or 1.
+  unsigned userSearcherPortfolioSize();
+
+  /// \param portfolioIndex The index of the member of a portfolio run
+  /// the searcher is for; the first one uses the searchers given by
+  /// --search, the others a fixed rotation of searchers.
+  Searcher *constructUserSearcher(Executor &executor,
+                                  unsigned portfolioIndex = 0);
 }
 
 #endif /* KLEE_USERSEARCHER_H */
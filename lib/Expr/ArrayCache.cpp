@@ -1,19 +1,34 @@
 #include "klee/Expr/ArrayCache.h"
 
+#include "klee/Statistics/MemoryAccount.h"
+
+#include "llvm/ADT/Hashing.h"
+
 namespace klee {
 
+uint64_t ArrayCache::getArrayBytes(const Array *array) {
+  return sizeof(Array) + array->name.capacity() +
+         array->constantValues.capacity() * sizeof(ref<ConstantExpr>);
+}
+
+std::atomic<unsigned> ArrayCache::nextID(1);
+
 ArrayCache::~ArrayCache() {
   // Free Allocated Array objects
   for (ArrayHashMap::iterator ai = cachedSymbolicArrays.begin(),
                               e = cachedSymbolicArrays.end();
        ai != e; ++ai) {
+    memory::arrays.remove(getArrayBytes(*ai));
     delete *ai;
   }
   for (ArrayPtrVec::iterator ai = concreteArrays.begin(),
                              e = concreteArrays.end();
        ai != e; ++ai) {
+    memory::arrays.remove(getArrayBytes(*ai));
     delete *ai;
   }
+  for (const auto &bytes : constantBytes)
+    memory::arrays.remove(bytes.second->capacity());
 }
 
 const Array *
@@ -22,25 +37,43 @@ ArrayCache::CreateArray(const std::string &_name, uint64_t _size,
                         const ref<ConstantExpr> *constantValuesEnd,
                         Expr::Width _domain, Expr::Width _range) {
 
-  const Array *array = new Array(_name, _size, constantValuesBegin,
-                                 constantValuesEnd, _domain, _range);
+  Array *array = new Array(_name, _size, constantValuesBegin,
+                           constantValuesEnd, _domain, _range);
   if (array->isSymbolicArray()) {
     std::pair<ArrayHashMap::const_iterator, bool> success =
         cachedSymbolicArrays.insert(array);
     if (success.second) {
       // Cache miss
+      array->id = nextID++;
+      memory::arrays.add(getArrayBytes(array));
       return array;
     }
     // Cache hit
     delete array;
-    array = *(success.first);
-    assert(array->isSymbolicArray() &&
+    const Array *cached = *(success.first);
+    assert(cached->isSymbolicArray() &&
            "Cached symbolic array is no longer symbolic");
-    return array;
+    return cached;
   } else {
     // Treat every constant array as distinct so we never cache them
     assert(array->isConstantArray());
     concreteArrays.push_back(array); // For deletion later
+    array->id = nextID++;
+    memory::arrays.add(getArrayBytes(array));
+    if (array->constantBytes) {
+      // but share the values of byte arrays
+      const auto &bytes = *array->constantBytes;
+      size_t hash = llvm::hash_combine_range(bytes.begin(), bytes.end());
+      auto range = constantBytes.equal_range(hash);
+      for (auto it = range.first; it != range.second; ++it) {
+        if (*it->second == bytes) {
+          array->constantBytes = it->second;
+          return array;
+        }
+      }
+      constantBytes.emplace(hash, array->constantBytes);
+      memory::arrays.add(bytes.capacity());
+    }
     return array;
   }
 }
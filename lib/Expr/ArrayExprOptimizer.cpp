@@ -16,6 +16,7 @@
 #include "klee/Expr/Assignment.h"
 #include "klee/Expr/AssignmentGenerator.h"
 #include "klee/Expr/ExprBuilder.h"
+#include "klee/Expr/ExprStats.h"
 #include "klee/Support/Casting.h"
 #include "klee/Support/ErrorHandling.h"
 #include "klee/Support/OptionCategories.h"
@@ -57,6 +58,13 @@ llvm::cl::opt<double> ArrayValueSymbRatio(
                    "the mixed value-based transformations are applied."),
     llvm::cl::init(1.0), llvm::cl::value_desc("Symbolic Values / Array Size"),
     llvm::cl::cat(klee::SolvingCat));
+
+llvm::cl::opt<unsigned> OptimizeArrayCacheSize(
+    "optimize-array-cache-size",
+    llvm::cl::desc("Keep up to this many results of --optimize-array, "
+                   "evicting the least recently used ones (default=4096, "
+                   "0=unbounded)"),
+    llvm::cl::init(4096), llvm::cl::cat(klee::SolvingCat));
 }; // namespace klee
 
 ref<Expr> extendRead(const UpdateList &ul, const ref<Expr> index,
@@ -109,13 +117,17 @@ ref<Expr> ExprOptimizer::optimizeExpr(const ref<Expr> &e, bool valueOnly) {
   if (OptimizeArray == NONE)
     return e;
 
-  if (cacheExprUnapplicable.count(e) > 0)
-    return e;
-
   // Find cached expressions
-  auto cached = cacheExprOptimized.find(e);
-  if (cached != cacheExprOptimized.end())
-    return cached->second;
+  CacheKey key{e, valueOnly};
+  auto cached = cache.find(key);
+  if (cached != cache.end()) {
+    ++stats::arrayOptimizerCacheHits;
+    if (OptimizeArrayCacheSize)
+      cacheLRU.splice(cacheLRU.begin(), cacheLRU,
+                      cached->second.lruPosition);
+    return cached->second.result;
+  }
+  ++stats::arrayOptimizerCacheMisses;
 
   ref<Expr> result;
   // ----------------------- INDEX-BASED OPTIMIZATION -------------------------
@@ -130,7 +142,7 @@ ref<Expr> ExprOptimizer::optimizeExpr(const ref<Expr> &e, bool valueOnly) {
       // If we cannot optimize the expression, we return a failure only
       // when we are not combining the optimizations
       if (OptimizeArray == INDEX) {
-        cacheExprUnapplicable.insert(e);
+        insert(key, e);
         return e;
       }
     } else {
@@ -148,13 +160,13 @@ ref<Expr> ExprOptimizer::optimizeExpr(const ref<Expr> &e, bool valueOnly) {
         // Add new expression to cache
         if (result) {
           klee_warning("OPT_I: successful");
-          cacheExprOptimized[e] = result;
+          insert(key, result);
         } else {
           klee_warning("OPT_I: unsuccessful");
         }
       } else {
         klee_warning("OPT_I: unsuccessful");
-        cacheExprUnapplicable.insert(e);
+        insert(key, e);
       }
     }
   }
@@ -168,7 +180,7 @@ ref<Expr> ExprOptimizer::optimizeExpr(const ref<Expr> &e, bool valueOnly) {
     std::reverse(reads.begin(), reads.end());
 
     if (reads.empty() || are.isIncompatible()) {
-      cacheExprUnapplicable.insert(e);
+      insert(key, e);
       return e;
     }
 
@@ -177,10 +189,10 @@ ref<Expr> ExprOptimizer::optimizeExpr(const ref<Expr> &e, bool valueOnly) {
     if (selectOpt) {
       klee_warning("OPT_V: successful");
       result = selectOpt;
-      cacheExprOptimized[e] = result;
+      insert(key, result);
     } else {
       klee_warning("OPT_V: unsuccessful");
-      cacheExprUnapplicable.insert(e);
+      insert(key, e);
     }
   }
   if (!result)
@@ -188,6 +200,27 @@ ref<Expr> ExprOptimizer::optimizeExpr(const ref<Expr> &e, bool valueOnly) {
   return result;
 }
 
+void ExprOptimizer::insert(const CacheKey &key, const ref<Expr> &result) {
+  auto inserted = cache.emplace(key, CacheEntry{result, {}});
+  CacheEntry &entry = inserted.first->second;
+  if (!inserted.second) {
+    // the value-based optimization overrides a failed index-based one
+    entry.result = result;
+    if (OptimizeArrayCacheSize)
+      cacheLRU.splice(cacheLRU.begin(), cacheLRU, entry.lruPosition);
+    return;
+  }
+  if (!OptimizeArrayCacheSize)
+    return;
+  cacheLRU.push_front(key);
+  entry.lruPosition = cacheLRU.begin();
+  if (cache.size() > OptimizeArrayCacheSize) {
+    // the least recently used key is never the one just added
+    cache.erase(cacheLRU.back());
+    cacheLRU.pop_back();
+  }
+}
+
 bool ExprOptimizer::computeIndexes(array2idx_ty &arrays, const ref<Expr> &e,
                                    mapIndexOptimizedExpr_ty &idx_valIdx) const {
   bool success = false;
@@ -218,7 +251,7 @@ bool ExprOptimizer::computeIndexes(array2idx_ty &arrays, const ref<Expr> &e,
     }
 
     // For each concrete value 'i' stored in the array
-    for (size_t aIdx = 0; aIdx < arr->constantValues.size(); aIdx += width) {
+    for (size_t aIdx = 0; aIdx < arr->size; aIdx += width) {
       Assignment::map_bindings_ty values;
       auto *a = new Assignment(values);
 
@@ -287,7 +320,7 @@ ref<Expr> ExprOptimizer::getSelectOptExpr(
            un = un->next.get())
         us.push_back(un);
 
-      auto arrayConstValues = read->updates.root->constantValues;
+      auto arrayConstValues = read->updates.root->getConstantValues();
       for (auto it = us.rbegin(); it != us.rend(); it++) {
         const UpdateNode *un = *it;
         auto ce = dyn_cast<ConstantExpr>(un->index);
@@ -354,7 +387,7 @@ ref<Expr> ExprOptimizer::getSelectOptExpr(
       // Note: we already filtered the ReadExpr, so here we can safely
       // assume that the UpdateNodes contain ConstantExpr indexes, but in
       // this case we *cannot* assume anything on the values
-      auto arrayConstValues = read->updates.root->constantValues;
+      auto arrayConstValues = read->updates.root->getConstantValues();
       if (arrayConstValues.size() < size) {
         // We need to "force" initialization of the values
         for (size_t i = arrayConstValues.size(); i < size; i++) {
@@ -122,7 +122,7 @@ void Assignment::addBinding(const Array*array,
     assert(!hasBindings(array));
 
     MapArrayModel mapModel(values);
-    auto &binding = bindings[array];
+    auto &binding = getBindings(array);
     mapModel.toCompact(binding);
 }
 
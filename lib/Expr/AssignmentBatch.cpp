@@ -0,0 +1,334 @@
+//===-- AssignmentBatch.cpp -----------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Expr/AssignmentBatch.h"
+
+#include "klee/Expr/Assignment.h"
+
+#include <cassert>
+
+using namespace klee;
+
+namespace {
+
+inline uint64_t widthMask(Expr::Width w) {
+  return w >= 64 ? ~UINT64_C(0) : (UINT64_C(1) << w) - 1;
+}
+
+inline int64_t signExtend(uint64_t v, Expr::Width w) {
+  return w >= 64 ? static_cast<int64_t>(v)
+                 : static_cast<int64_t>(v << (64 - w)) >> (64 - w);
+}
+
+} // namespace
+
+AssignmentBatch::AssignmentBatch(
+    const std::vector<const Assignment *> &assignments)
+    : assignments(assignments) {
+  assert(!assignments.empty() && assignments.size() <= MaxLanes &&
+         "invalid number of assignments");
+  all = widthMask(assignments.size());
+}
+
+uint64_t AssignmentBatch::satisfiedBy(const ref<Expr> &e) {
+  size_t offset;
+  uint64_t result = 0, fallback = all;
+  if (evaluate(e, offset)) {
+    const uint64_t *v = &values[offset];
+    for (unsigned i = 0, n = assignments.size(); i != n; ++i)
+      result |= (v[i] & 1) << i;
+    result &= ~divisionByZero;
+    fallback = divisionByZero;
+  }
+
+  // division by zero leaves the expression symbolic in
+  // Assignment::evaluate, which is not always false
+  for (unsigned i = 0, n = assignments.size(); i != n; ++i)
+    if (fallback & (UINT64_C(1) << i))
+      if (assignments[i]->satisfies(&e, &e + 1))
+        result |= UINT64_C(1) << i;
+  return result;
+}
+
+bool AssignmentBatch::evaluate(const ref<Expr> &root, size_t &offset) {
+  // expressions with whether the nodes they depend on were pushed
+  std::vector<std::pair<const Expr *, bool>> stack;
+  stack.emplace_back(root.get(), false);
+  auto push = [this, &stack](const ref<Expr> &e) {
+    if (!offsets.count(e.get()))
+      stack.emplace_back(e.get(), false);
+  };
+
+  while (!stack.empty()) {
+    const Expr *e = stack.back().first;
+    if (offsets.count(e)) {
+      stack.pop_back();
+      continue;
+    }
+
+    if (!stack.back().second) {
+      // floating-point operations are left to the ExprEvaluator
+      if (e->getWidth() > 64 || (Expr::FPKindFirst <= e->getKind() &&
+                                 e->getKind() <= Expr::FPKindLast))
+        return false;
+      stack.back().second = true;
+      for (unsigned i = 0, n = e->getNumKids(); i != n; ++i)
+        push(e->getKid(i));
+      if (const ReadExpr *re = dyn_cast<ReadExpr>(e)) {
+        for (const UpdateNode *un = re->updates.head.get(); un;
+             un = un->next.get()) {
+          push(un->index);
+          push(un->value);
+        }
+      }
+      continue;
+    }
+
+    stack.pop_back();
+    size_t at = values.size();
+    values.resize(at + assignments.size());
+    compute(*e, &values[at]);
+    offsets.emplace(e, at);
+  }
+
+  offset = offsets.find(root.get())->second;
+  return true;
+}
+
+void AssignmentBatch::computeRead(const ReadExpr &re, uint64_t *result) {
+  const unsigned n = assignments.size();
+  const uint64_t *index = &values[offsets.find(re.index.get())->second];
+
+  // the assignments whose index was not written yet
+  uint64_t pending = all;
+  for (const UpdateNode *un = re.updates.head.get(); un && pending;
+       un = un->next.get()) {
+    const uint64_t *ui = &values[offsets.find(un->index.get())->second];
+    const uint64_t *uv = &values[offsets.find(un->value.get())->second];
+    for (unsigned i = 0; i != n; ++i) {
+      if ((pending & (UINT64_C(1) << i)) && ui[i] == index[i]) {
+        result[i] = uv[i];
+        pending &= ~(UINT64_C(1) << i);
+      }
+    }
+  }
+
+  const Array *root = re.updates.root;
+  uint64_t mask = widthMask(root->getRange());
+  for (unsigned i = 0; i != n; ++i) {
+    if (!(pending & (UINT64_C(1) << i)))
+      continue;
+    // as in ExprEvaluator::evalRead
+    unsigned at = index[i];
+    if (root->isConstantArray() && at < root->size)
+      result[i] = root->getConstantValue(at)->getZExtValue();
+    else
+      result[i] = assignments[i]->getValue(root, at) & mask;
+  }
+}
+
+void AssignmentBatch::compute(const Expr &e, uint64_t *result) {
+  const unsigned n = assignments.size();
+  const Expr::Width w = e.getWidth();
+  const uint64_t mask = widthMask(w);
+
+  if (const ConstantExpr *ce = dyn_cast<ConstantExpr>(&e)) {
+    uint64_t v = ce->getZExtValue();
+    for (unsigned i = 0; i != n; ++i)
+      result[i] = v;
+    return;
+  }
+  if (const ReadExpr *re = dyn_cast<ReadExpr>(&e)) {
+    computeRead(*re, result);
+    return;
+  }
+
+  const uint64_t *kids[3] = {};
+  for (unsigned k = 0, nk = e.getNumKids(); k != nk; ++k)
+    kids[k] = &values[offsets.find(e.getKid(k).get())->second];
+  const uint64_t *a = kids[0], *b = kids[1];
+  // the width of the operands of comparisons and casts
+  const Expr::Width kw = e.getKid(0)->getWidth();
+
+  switch (e.getKind()) {
+  case Expr::NotOptimized:
+  case Expr::ZExt:
+    for (unsigned i = 0; i != n; ++i)
+      result[i] = a[i];
+    break;
+  case Expr::Select:
+    for (unsigned i = 0; i != n; ++i)
+      result[i] = a[i] ? b[i] : kids[2][i];
+    break;
+  case Expr::Concat: {
+    Expr::Width rw = e.getKid(1)->getWidth();
+    for (unsigned i = 0; i != n; ++i)
+      result[i] = (a[i] << rw) | b[i];
+    break;
+  }
+  case Expr::Extract: {
+    unsigned offset = static_cast<const ExtractExpr &>(e).offset;
+    for (unsigned i = 0; i != n; ++i)
+      result[i] = (a[i] >> offset) & mask;
+    break;
+  }
+  case Expr::SExt:
+    for (unsigned i = 0; i != n; ++i)
+      result[i] = static_cast<uint64_t>(signExtend(a[i], kw)) & mask;
+    break;
+
+  case Expr::Add:
+    for (unsigned i = 0; i != n; ++i)
+      result[i] = (a[i] + b[i]) & mask;
+    break;
+  case Expr::Sub:
+    for (unsigned i = 0; i != n; ++i)
+      result[i] = (a[i] - b[i]) & mask;
+    break;
+  case Expr::Mul:
+    for (unsigned i = 0; i != n; ++i)
+      result[i] = (a[i] * b[i]) & mask;
+    break;
+
+  // boolean divisions are folded to the dividend or false by their
+  // create methods, even when the divisor is symbolic
+  case Expr::UDiv:
+    for (unsigned i = 0; i != n; ++i) {
+      if (w == Expr::Bool) {
+        result[i] = a[i];
+      } else if (!b[i]) {
+        divisionByZero |= UINT64_C(1) << i;
+        result[i] = 0;
+      } else {
+        result[i] = a[i] / b[i];
+      }
+    }
+    break;
+  case Expr::URem:
+    for (unsigned i = 0; i != n; ++i) {
+      if (w == Expr::Bool) {
+        result[i] = 0;
+      } else if (!b[i]) {
+        divisionByZero |= UINT64_C(1) << i;
+        result[i] = 0;
+      } else {
+        result[i] = a[i] % b[i];
+      }
+    }
+    break;
+  case Expr::SDiv:
+    for (unsigned i = 0; i != n; ++i) {
+      int64_t l = signExtend(a[i], w), r = signExtend(b[i], w);
+      if (w == Expr::Bool) {
+        result[i] = a[i];
+      } else if (!r) {
+        divisionByZero |= UINT64_C(1) << i;
+        result[i] = 0;
+      } else if (r == -1) {
+        // the minimum divided by -1 overflows to itself
+        result[i] = (0 - a[i]) & mask;
+      } else {
+        result[i] = static_cast<uint64_t>(l / r) & mask;
+      }
+    }
+    break;
+  case Expr::SRem:
+    for (unsigned i = 0; i != n; ++i) {
+      int64_t l = signExtend(a[i], w), r = signExtend(b[i], w);
+      if (w == Expr::Bool) {
+        result[i] = 0;
+      } else if (!r) {
+        divisionByZero |= UINT64_C(1) << i;
+        result[i] = 0;
+      } else if (r == -1) {
+        result[i] = 0;
+      } else {
+        result[i] = static_cast<uint64_t>(l % r) & mask;
+      }
+    }
+    break;
+
+  case Expr::Not:
+    for (unsigned i = 0; i != n; ++i)
+      result[i] = ~a[i] & mask;
+    break;
+  case Expr::And:
+    for (unsigned i = 0; i != n; ++i)
+      result[i] = a[i] & b[i];
+    break;
+  case Expr::Or:
+    for (unsigned i = 0; i != n; ++i)
+      result[i] = a[i] | b[i];
+    break;
+  case Expr::Xor:
+    for (unsigned i = 0; i != n; ++i)
+      result[i] = a[i] ^ b[i];
+    break;
+
+  // shifts by at least the width shift out all bits, as APInt does
+  case Expr::Shl:
+    for (unsigned i = 0; i != n; ++i)
+      result[i] = b[i] >= w ? 0 : (a[i] << b[i]) & mask;
+    break;
+  case Expr::LShr:
+    for (unsigned i = 0; i != n; ++i)
+      result[i] = b[i] >= w ? 0 : a[i] >> b[i];
+    break;
+  case Expr::AShr:
+    for (unsigned i = 0; i != n; ++i) {
+      int64_t l = signExtend(a[i], w);
+      result[i] = static_cast<uint64_t>(l >> (b[i] >= w ? w - 1 : b[i])) & mask;
+    }
+    break;
+
+  case Expr::Eq:
+    for (unsigned i = 0; i != n; ++i)
+      result[i] = a[i] == b[i];
+    break;
+  case Expr::Ne:
+    for (unsigned i = 0; i != n; ++i)
+      result[i] = a[i] != b[i];
+    break;
+  case Expr::Ult:
+    for (unsigned i = 0; i != n; ++i)
+      result[i] = a[i] < b[i];
+    break;
+  case Expr::Ule:
+    for (unsigned i = 0; i != n; ++i)
+      result[i] = a[i] <= b[i];
+    break;
+  case Expr::Ugt:
+    for (unsigned i = 0; i != n; ++i)
+      result[i] = a[i] > b[i];
+    break;
+  case Expr::Uge:
+    for (unsigned i = 0; i != n; ++i)
+      result[i] = a[i] >= b[i];
+    break;
+  case Expr::Slt:
+    for (unsigned i = 0; i != n; ++i)
+      result[i] = signExtend(a[i], kw) < signExtend(b[i], kw);
+    break;
+  case Expr::Sle:
+    for (unsigned i = 0; i != n; ++i)
+      result[i] = signExtend(a[i], kw) <= signExtend(b[i], kw);
+    break;
+  case Expr::Sgt:
+    for (unsigned i = 0; i != n; ++i)
+      result[i] = signExtend(a[i], kw) > signExtend(b[i], kw);
+    break;
+  case Expr::Sge:
+    for (unsigned i = 0; i != n; ++i)
+      result[i] = signExtend(a[i], kw) >= signExtend(b[i], kw);
+    break;
+
+  default:
+    assert(0 && "invalid expression kind");
+  }
+}
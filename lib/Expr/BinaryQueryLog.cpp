@@ -0,0 +1,735 @@
+//===-- BinaryQueryLog.cpp ------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Expr/BinaryQueryLog.h"
+
+#include "klee/Expr/ArrayCache.h"
+#include "klee/Expr/ExprBuilder.h"
+
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <cassert>
+#include <cstring>
+
+using namespace klee;
+
+// A log is a header, a sequence of records and, once closed, an index:
+//
+//   log     := magic record* [index trailer]
+//   record  := tag varint(#ints) varint* varint(#refs) varint*
+//              varint(#text) byte*
+//   index   := 'x' u64(#nodes) u64(#queries) u64(node offset)*
+//              u64(query offset)*
+//   trailer := u64(index offset) trailerMagic
+//
+// Arrays ('a'), update nodes ('u') and expressions ('e') are the nodes and
+// are numbered in the order they are written. A node refers to the nodes
+// it depends on, which precede it, by the difference of their numbers; a
+// query ('q') does the same relative to the number of nodes written before
+// it, which it records as its first int. Fixed-size integers are little
+// endian.
+//
+// Nodes are laid out as follows:
+//   'a' ints: size domain range #values (words of each value)*, text: name
+//   'u' refs: index value [next]
+//   'e' ints: kind width [extract offset | words of a constant],
+//       refs: kids, or array index [head update] for a read
+//   'q' ints: base #constraints #values, refs: constraints expr values
+//       objects, text: comment
+
+namespace {
+
+const char Magic[8] = {'\x7f', 'K', 'Q', 'B', 'L', 'O', 'G', '1'};
+const char TrailerMagic[8] = {'K', 'Q', 'B', 'I', 'N', 'D', 'E', 'X'};
+const size_t TrailerSize = 16;
+
+const char ArrayTag = 'a';
+const char UpdateTag = 'u';
+const char ExprTag = 'e';
+const char QueryTag = 'q';
+const char IndexTag = 'x';
+
+inline unsigned numWords(Expr::Width w) { return (w + 63) / 64; }
+
+uint64_t readFixed(const char *p) {
+  uint64_t value = 0;
+  for (unsigned i = 0; i != 8; ++i)
+    value |= static_cast<uint64_t>(static_cast<unsigned char>(p[i])) << 8 * i;
+  return value;
+}
+
+/// Reads the fields of records, checking that they lie in the buffer.
+class Cursor {
+  const char *pos, *end;
+
+public:
+  Cursor(const char *pos, const char *end) : pos(pos), end(end) {}
+
+  bool varint(uint64_t &value) {
+    value = 0;
+    for (unsigned shift = 0; shift < 64 && pos != end; shift += 7) {
+      unsigned char byte = *pos++;
+      value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+      if (!(byte & 0x80))
+        return true;
+    }
+    return false;
+  }
+
+  /// Reads a count of items of at least one byte each.
+  bool count(uint64_t &n) {
+    return varint(n) && n <= static_cast<uint64_t>(end - pos);
+  }
+
+  bool byte(char &c) {
+    if (pos == end)
+      return false;
+    c = *pos++;
+    return true;
+  }
+
+  bool bytes(uint64_t n, llvm::StringRef &s) {
+    if (n > static_cast<uint64_t>(end - pos))
+      return false;
+    s = llvm::StringRef(pos, n);
+    pos += n;
+    return true;
+  }
+
+  const char *position() const { return pos; }
+};
+
+/// Decodes the record at data + offset, whose references are relative to
+/// base unless it is a query. \return false if it does not fit the buffer
+bool decodeRecord(llvm::StringRef data, uint64_t offset, uint64_t base,
+                  BinaryQueryLogReader::Record &record,
+                  const char **next = nullptr) {
+  if (offset >= data.size())
+    return false;
+  Cursor c(data.data() + offset, data.data() + data.size());
+  uint64_t n;
+  if (!c.byte(record.tag) || !c.count(n))
+    return false;
+  record.ints.resize(n);
+  for (uint64_t &i : record.ints)
+    if (!c.varint(i))
+      return false;
+
+  if (record.tag == QueryTag) {
+    if (record.ints.empty())
+      return false;
+    base = record.ints[0];
+  }
+  if (!c.count(n))
+    return false;
+  record.refs.resize(n);
+  for (uint64_t &r : record.refs) {
+    uint64_t delta;
+    if (!c.varint(delta) || delta == 0 || delta > base)
+      return false;
+    r = base - delta;
+  }
+
+  if (!c.count(n) || !c.bytes(n, record.text))
+    return false;
+  if (next)
+    *next = c.position();
+  return true;
+}
+
+} // namespace
+
+/***/
+
+BinaryQueryLogWriter::BinaryQueryLogWriter(llvm::raw_ostream &os) : os(os) {
+  writeBytes(Magic, sizeof(Magic));
+}
+
+BinaryQueryLogWriter::~BinaryQueryLogWriter() {
+  if (!closed)
+    close();
+}
+
+void BinaryQueryLogWriter::writeBytes(const char *data, size_t size) {
+  os.write(data, size);
+  position += size;
+}
+
+void BinaryQueryLogWriter::writeFixed(uint64_t value) {
+  char bytes[8];
+  for (unsigned i = 0; i != 8; ++i)
+    bytes[i] = static_cast<char>(value >> 8 * i);
+  writeBytes(bytes, sizeof(bytes));
+}
+
+void BinaryQueryLogWriter::writeVarint(uint64_t value) {
+  char bytes[10];
+  size_t n = 0;
+  do {
+    char byte = value & 0x7f;
+    value >>= 7;
+    bytes[n++] = value ? byte | 0x80 : byte;
+  } while (value);
+  writeBytes(bytes, n);
+}
+
+void BinaryQueryLogWriter::writeRecord(char tag, llvm::ArrayRef<uint64_t> ints,
+                                       llvm::ArrayRef<uint64_t> refs,
+                                       llvm::StringRef text) {
+  // nodes refer relative to their own number, queries to their first int
+  uint64_t base = tag == QueryTag ? ints[0] : nodeOffsets.size();
+  if (tag == QueryTag)
+    queryOffsets.push_back(position);
+  else
+    nodeOffsets.push_back(position);
+
+  writeBytes(&tag, 1);
+  writeVarint(ints.size());
+  for (uint64_t i : ints)
+    writeVarint(i);
+  writeVarint(refs.size());
+  for (uint64_t r : refs) {
+    assert(r < base && "reference to a node that was not written");
+    writeVarint(base - r);
+  }
+  writeVarint(text.size());
+  writeBytes(text.data(), text.size());
+}
+
+uint64_t BinaryQueryLogWriter::idOf(const ref<Expr> &e) {
+  auto it = exprIds.find(e);
+  assert(it != exprIds.end() && "expression was not written");
+  return it->second;
+}
+
+uint64_t BinaryQueryLogWriter::idOf(const ref<UpdateNode> &un) {
+  auto it = updateIds.find(un.get());
+  assert(it != updateIds.end() && "update node was not written");
+  return it->second;
+}
+
+uint64_t BinaryQueryLogWriter::idOf(const Array *array) {
+  auto it = arrayIds.find(array);
+  assert(it != arrayIds.end() && "array was not written");
+  return it->second;
+}
+
+void BinaryQueryLogWriter::writeArray(const Array *array) {
+  if (arrayIds.count(array))
+    return;
+
+  llvm::SmallVector<uint64_t, 8> ints = {array->size, array->domain,
+                                         array->range, 0};
+  if (array->isConstantArray()) {
+    std::vector<ref<ConstantExpr>> values = array->getConstantValues();
+    ints[3] = values.size();
+    for (const ref<ConstantExpr> &value : values) {
+      const llvm::APInt &v = value->getAPValue();
+      ints.append(v.getRawData(), v.getRawData() + v.getNumWords());
+    }
+  }
+  arrayIds.emplace(array, nodeOffsets.size());
+  writeRecord(ArrayTag, ints, {}, array->name);
+}
+
+void BinaryQueryLogWriter::writeNodes(const ref<Expr> &root) {
+  // expressions and update nodes, with whether the nodes they depend on
+  // were pushed
+  struct Pending {
+    ref<Expr> expr;
+    ref<UpdateNode> update;
+    bool expanded;
+  };
+  std::vector<Pending> stack;
+  auto push = [this, &stack](const ref<Expr> &e) {
+    if (!exprIds.count(e))
+      stack.push_back({e, nullptr, false});
+  };
+  auto pushUpdate = [this, &stack](const ref<UpdateNode> &un) {
+    if (un && !updateIds.count(un.get()))
+      stack.push_back({nullptr, un, false});
+  };
+  push(root);
+
+  while (!stack.empty()) {
+    Pending p = stack.back();
+    if (p.expr ? exprIds.count(p.expr) : updateIds.count(p.update.get())) {
+      stack.pop_back();
+      continue;
+    }
+
+    if (!p.expanded) {
+      stack.back().expanded = true;
+      if (p.update) {
+        push(p.update->index);
+        push(p.update->value);
+        pushUpdate(p.update->next);
+        continue;
+      }
+      for (unsigned i = 0, n = p.expr->getNumKids(); i != n; ++i)
+        push(p.expr->getKid(i));
+      if (const ReadExpr *re = dyn_cast<ReadExpr>(p.expr)) {
+        writeArray(re->updates.root);
+        pushUpdate(re->updates.head);
+      }
+      continue;
+    }
+
+    stack.pop_back();
+    if (p.update) {
+      llvm::SmallVector<uint64_t, 3> refs = {idOf(p.update->index),
+                                             idOf(p.update->value)};
+      if (p.update->next)
+        refs.push_back(idOf(p.update->next));
+      updateIds.emplace(p.update.get(), nodeOffsets.size());
+      updates.push_back(p.update);
+      writeRecord(UpdateTag, {}, refs, "");
+      continue;
+    }
+
+    const Expr *e = p.expr.get();
+    llvm::SmallVector<uint64_t, 4> ints = {
+        static_cast<uint64_t>(e->getKind()), e->getWidth()};
+    llvm::SmallVector<uint64_t, 3> refs;
+    if (const ConstantExpr *ce = dyn_cast<ConstantExpr>(e)) {
+      const llvm::APInt &v = ce->getAPValue();
+      ints.append(v.getRawData(), v.getRawData() + v.getNumWords());
+    } else if (const ReadExpr *re = dyn_cast<ReadExpr>(e)) {
+      refs.push_back(idOf(re->updates.root));
+      refs.push_back(idOf(re->index));
+      if (re->updates.head)
+        refs.push_back(idOf(re->updates.head));
+    } else {
+      if (const ExtractExpr *ee = dyn_cast<ExtractExpr>(e))
+        ints.push_back(ee->offset);
+      for (unsigned i = 0, n = e->getNumKids(); i != n; ++i)
+        refs.push_back(idOf(e->getKid(i)));
+    }
+    exprIds.emplace(p.expr, nodeOffsets.size());
+    writeRecord(ExprTag, ints, refs, "");
+  }
+}
+
+void BinaryQueryLogWriter::writeQuery(const LoggedQuery &query) {
+  assert(!closed && "writing to a closed query log");
+  for (const ref<Expr> &e : query.constraints)
+    writeNodes(e);
+  writeNodes(query.expr);
+  for (const ref<Expr> &e : query.values)
+    writeNodes(e);
+  for (const Array *array : query.objects)
+    writeArray(array);
+
+  llvm::SmallVector<uint64_t, 3> ints = {nodeOffsets.size(),
+                                         query.constraints.size(),
+                                         query.values.size()};
+  std::vector<uint64_t> refs;
+  refs.reserve(query.constraints.size() + 1 + query.values.size() +
+               query.objects.size());
+  for (const ref<Expr> &e : query.constraints)
+    refs.push_back(idOf(e));
+  refs.push_back(idOf(query.expr));
+  for (const ref<Expr> &e : query.values)
+    refs.push_back(idOf(e));
+  for (const Array *array : query.objects)
+    refs.push_back(idOf(array));
+  writeRecord(QueryTag, ints, refs, query.comment);
+}
+
+void BinaryQueryLogWriter::close() {
+  assert(!closed && "closing a query log twice");
+  closed = true;
+  uint64_t indexOffset = position;
+  writeBytes(&IndexTag, 1);
+  writeFixed(nodeOffsets.size());
+  writeFixed(queryOffsets.size());
+  for (uint64_t offset : nodeOffsets)
+    writeFixed(offset);
+  for (uint64_t offset : queryOffsets)
+    writeFixed(offset);
+  writeFixed(indexOffset);
+  writeBytes(TrailerMagic, sizeof(TrailerMagic));
+  os.flush();
+}
+
+/***/
+
+BinaryQueryLogReader::BinaryQueryLogReader(const llvm::MemoryBuffer &buffer,
+                                           ArrayCache &arrayCache,
+                                           ExprBuilder *builder)
+    : buffer(buffer), arrayCache(arrayCache), builder(builder) {}
+
+bool BinaryQueryLogReader::isBinaryQueryLog(llvm::StringRef data) {
+  return data.startswith(llvm::StringRef(Magic, sizeof(Magic)));
+}
+
+bool BinaryQueryLogReader::open(std::string &error) {
+  if (!isBinaryQueryLog(buffer.getBuffer())) {
+    error = "not a binary query log";
+    return false;
+  }
+  return readIndex() || scan(error);
+}
+
+bool BinaryQueryLogReader::readIndex() {
+  const char *begin = buffer.getBufferStart();
+  uint64_t size = buffer.getBufferSize();
+  if (size < sizeof(Magic) + 1 + 16 + TrailerSize)
+    return false;
+  const char *trailer = begin + size - TrailerSize;
+  if (std::memcmp(trailer + 8, TrailerMagic, sizeof(TrailerMagic)))
+    return false;
+
+  uint64_t offset = readFixed(trailer);
+  uint64_t available = size - TrailerSize;
+  if (offset < sizeof(Magic) || offset > available - 17 ||
+      begin[offset] != IndexTag)
+    return false;
+  uint64_t nodes = readFixed(begin + offset + 1);
+  uint64_t queries = readFixed(begin + offset + 9);
+  uint64_t entries = (available - offset - 17) / 8;
+  if (nodes > entries || queries != entries - nodes ||
+      (available - offset - 17) % 8)
+    return false;
+
+  numNodes = nodes;
+  numQueries = queries;
+  nodeIndex = begin + offset + 17;
+  queryIndex = nodeIndex + 8 * nodes;
+  return true;
+}
+
+bool BinaryQueryLogReader::scan(std::string &error) {
+  llvm::StringRef data = buffer.getBuffer();
+  uint64_t offset = sizeof(Magic);
+  Record record;
+  // a log that was not closed may end with a partly written record
+  while (offset < data.size() && data[offset] != IndexTag) {
+    const char *next;
+    if (!decodeRecord(data, offset, nodeOffsets.size(), record, &next))
+      break;
+    switch (record.tag) {
+    case ArrayTag:
+    case UpdateTag:
+    case ExprTag:
+      nodeOffsets.push_back(offset);
+      break;
+    case QueryTag:
+      queryOffsets.push_back(offset);
+      break;
+    default:
+      error = "unknown record at offset " + std::to_string(offset);
+      return false;
+    }
+    offset = next - data.data();
+  }
+  numNodes = nodeOffsets.size();
+  numQueries = queryOffsets.size();
+  return true;
+}
+
+uint64_t BinaryQueryLogReader::nodeOffset(uint64_t id) const {
+  return nodeIndex ? readFixed(nodeIndex + 8 * id) : nodeOffsets[id];
+}
+
+uint64_t BinaryQueryLogReader::queryOffset(uint64_t index) const {
+  return queryIndex ? readFixed(queryIndex + 8 * index) : queryOffsets[index];
+}
+
+bool BinaryQueryLogReader::buildNode(uint64_t root, std::string &error) {
+  std::vector<uint64_t> stack = {root};
+  Record record;
+  while (!stack.empty()) {
+    uint64_t id = stack.back();
+    if (nodes.count(id)) {
+      stack.pop_back();
+      continue;
+    }
+
+    if (id >= numNodes ||
+        !decodeRecord(buffer.getBuffer(), nodeOffset(id), id, record)) {
+      error = "malformed node " + std::to_string(id);
+      return false;
+    }
+    // references precede the node, so this terminates
+    bool ready = true;
+    for (uint64_t r : record.refs) {
+      if (!nodes.count(r)) {
+        stack.push_back(r);
+        ready = false;
+      }
+    }
+    if (!ready)
+      continue;
+
+    stack.pop_back();
+    Node node;
+    if (!makeNode(record, node, error)) {
+      error = "node " + std::to_string(id) + ": " + error;
+      return false;
+    }
+    nodes.emplace(id, std::move(node));
+  }
+  return true;
+}
+
+bool BinaryQueryLogReader::makeNode(const Record &record, Node &node,
+                                    std::string &error) {
+  const auto &ints = record.ints;
+  std::vector<ref<Expr>> kids;
+  const Array *array = nullptr;
+  ref<UpdateNode> update;
+  for (unsigned i = 0, n = record.refs.size(); i != n; ++i) {
+    const Node &target = nodes.find(record.refs[i])->second;
+    if (target.expr) {
+      kids.push_back(target.expr);
+    } else if (target.array && i == 0) {
+      array = target.array;
+    } else if (target.update && i == n - 1) {
+      update = target.update;
+    } else {
+      error = "unexpected reference";
+      return false;
+    }
+  }
+
+  switch (record.tag) {
+  case ArrayTag: {
+    if (ints.size() < 4 || !record.refs.empty() || !ints[2] ||
+        (ints[3] && ints[3] != ints[0])) {
+      error = "malformed array";
+      return false;
+    }
+    Expr::Width range = ints[2];
+    unsigned words = numWords(range);
+    if (ints.size() != 4 + ints[3] * words) {
+      error = "malformed array values";
+      return false;
+    }
+    std::vector<ref<ConstantExpr>> values;
+    values.reserve(ints[3]);
+    for (uint64_t i = 0; i != ints[3]; ++i)
+      values.push_back(ConstantExpr::alloc(llvm::APInt(
+          range, llvm::makeArrayRef(&ints[4 + i * words], words))));
+    node.array = arrayCache.CreateArray(
+        record.text.str(), ints[0], values.data(),
+        values.data() + values.size(), ints[1], range);
+    return true;
+  }
+
+  case UpdateTag:
+    if (kids.size() != 2 || array) {
+      error = "malformed update";
+      return false;
+    }
+    node.update = new UpdateNode(update, kids[0], kids[1]);
+    return true;
+
+  case ExprTag:
+    break;
+
+  default:
+    error = "unexpected record";
+    return false;
+  }
+
+  if (ints.size() < 2 || !ints[1] || ints[0] > Expr::LastKind) {
+    error = "malformed expression";
+    return false;
+  }
+  Expr::Kind kind = static_cast<Expr::Kind>(ints[0]);
+  Expr::Width width = ints[1];
+  unsigned numKids = 2;
+  switch (kind) {
+  case Expr::Constant:
+    numKids = 0;
+    break;
+  case Expr::Read:
+  case Expr::NotOptimized:
+  case Expr::Extract:
+  case Expr::ZExt:
+  case Expr::SExt:
+  case Expr::Not:
+  case Expr::FPExt:
+  case Expr::FPTrunc:
+  case Expr::FPToUI:
+  case Expr::FPToSI:
+  case Expr::UIToFP:
+  case Expr::SIToFP:
+    numKids = 1;
+    break;
+  case Expr::Select:
+    numKids = 3;
+    break;
+  default:
+    break;
+  }
+  unsigned numInts = kind == Expr::Constant  ? 2 + numWords(width)
+                     : kind == Expr::Extract ? 3
+                                             : 2;
+  if (kids.size() != numKids || ints.size() != numInts ||
+      (kind == Expr::Read) != (array != nullptr) ||
+      (update && kind != Expr::Read)) {
+    error = "malformed expression";
+    return false;
+  }
+
+  ref<Expr> e;
+  switch (kind) {
+  case Expr::Constant:
+    e = builder->Constant(
+        llvm::APInt(width, llvm::makeArrayRef(&ints[2], numWords(width))));
+    break;
+  case Expr::Read:
+    e = builder->Read(UpdateList(array, update), kids[0]);
+    break;
+  case Expr::NotOptimized:
+    e = builder->NotOptimized(kids[0]);
+    break;
+  case Expr::Extract:
+    if (ints[2] + width > kids[0]->getWidth()) {
+      error = "malformed extract";
+      return false;
+    }
+    e = builder->Extract(kids[0], ints[2], width);
+    break;
+  case Expr::ZExt:
+    e = builder->ZExt(kids[0], width);
+    break;
+  case Expr::SExt:
+    e = builder->SExt(kids[0], width);
+    break;
+  case Expr::Not:
+    e = builder->Not(kids[0]);
+    break;
+  case Expr::Select:
+    e = builder->Select(kids[0], kids[1], kids[2]);
+    break;
+  case Expr::Concat:
+    e = builder->Concat(kids[0], kids[1]);
+    break;
+
+#define BINARY_EXPR_CASE(kind)                                                 \
+  case Expr::kind:                                                             \
+    e = builder->kind(kids[0], kids[1]);                                       \
+    break;
+    BINARY_EXPR_CASE(Add)
+    BINARY_EXPR_CASE(Sub)
+    BINARY_EXPR_CASE(Mul)
+    BINARY_EXPR_CASE(UDiv)
+    BINARY_EXPR_CASE(SDiv)
+    BINARY_EXPR_CASE(URem)
+    BINARY_EXPR_CASE(SRem)
+    BINARY_EXPR_CASE(And)
+    BINARY_EXPR_CASE(Or)
+    BINARY_EXPR_CASE(Xor)
+    BINARY_EXPR_CASE(Shl)
+    BINARY_EXPR_CASE(LShr)
+    BINARY_EXPR_CASE(AShr)
+    BINARY_EXPR_CASE(Eq)
+    BINARY_EXPR_CASE(Ne)
+    BINARY_EXPR_CASE(Ult)
+    BINARY_EXPR_CASE(Ule)
+    BINARY_EXPR_CASE(Ugt)
+    BINARY_EXPR_CASE(Uge)
+    BINARY_EXPR_CASE(Slt)
+    BINARY_EXPR_CASE(Sle)
+    BINARY_EXPR_CASE(Sgt)
+    BINARY_EXPR_CASE(Sge)
+#undef BINARY_EXPR_CASE
+
+    // the builders have no floating-point operations
+#define FP_BINARY_EXPR_CASE(kind)                                              \
+  case Expr::kind:                                                             \
+    if (kids[0]->getWidth() != kids[1]->getWidth() ||                          \
+        !ConstantExpr::getFloatSemantics(kids[0]->getWidth())) {               \
+      error = "malformed floating-point expression";                           \
+      return false;                                                            \
+    }                                                                          \
+    e = kind##Expr::create(kids[0], kids[1]);                                  \
+    break;
+    FP_BINARY_EXPR_CASE(FAdd)
+    FP_BINARY_EXPR_CASE(FSub)
+    FP_BINARY_EXPR_CASE(FMul)
+    FP_BINARY_EXPR_CASE(FDiv)
+    FP_BINARY_EXPR_CASE(FOEq)
+    FP_BINARY_EXPR_CASE(FOLt)
+    FP_BINARY_EXPR_CASE(FOLe)
+    FP_BINARY_EXPR_CASE(FUno)
+#undef FP_BINARY_EXPR_CASE
+
+#define FP_CAST_EXPR_CASE(kind, fromFloat, toFloat)                            \
+  case Expr::kind:                                                             \
+    if ((fromFloat &&                                                          \
+         !ConstantExpr::getFloatSemantics(kids[0]->getWidth())) ||             \
+        (toFloat && !ConstantExpr::getFloatSemantics(width))) {                \
+      error = "malformed floating-point expression";                           \
+      return false;                                                            \
+    }                                                                          \
+    e = kind##Expr::create(kids[0], width);                                    \
+    break;
+    FP_CAST_EXPR_CASE(FPExt, true, true)
+    FP_CAST_EXPR_CASE(FPTrunc, true, true)
+    FP_CAST_EXPR_CASE(FPToUI, true, false)
+    FP_CAST_EXPR_CASE(FPToSI, true, false)
+    FP_CAST_EXPR_CASE(UIToFP, false, true)
+    FP_CAST_EXPR_CASE(SIToFP, false, true)
+#undef FP_CAST_EXPR_CASE
+
+  default:
+    error = "unsupported expression kind " + std::to_string(kind);
+    return false;
+  }
+
+  if (e->getWidth() != width) {
+    error = "expression width mismatch";
+    return false;
+  }
+  node.expr = e;
+  return true;
+}
+
+bool BinaryQueryLogReader::readQuery(uint64_t index, LoggedQuery &query,
+                                     std::string &error) {
+  assert(index < numQueries && "invalid query index");
+  Record record;
+  if (!decodeRecord(buffer.getBuffer(), queryOffset(index), 0, record) ||
+      record.tag != QueryTag || record.ints.size() != 3 ||
+      record.ints[0] > numNodes ||
+      record.refs.size() < record.ints[1] + 1 + record.ints[2]) {
+    error = "malformed query " + std::to_string(index);
+    return false;
+  }
+
+  for (uint64_t id : record.refs)
+    if (!buildNode(id, error))
+      return false;
+
+  query = LoggedQuery();
+  query.comment = record.text.str();
+  uint64_t numConstraints = record.ints[1], numValues = record.ints[2];
+  for (uint64_t i = 0, n = record.refs.size(); i != n; ++i) {
+    const Node &node = nodes.find(record.refs[i])->second;
+    bool isObject = i > numConstraints + numValues;
+    if (isObject ? !node.array : !node.expr) {
+      error = "malformed query " + std::to_string(index);
+      return false;
+    }
+    if (i < numConstraints)
+      query.constraints.push_back(node.expr);
+    else if (i == numConstraints)
+      query.expr = node.expr;
+    else if (!isObject)
+      query.values.push_back(node.expr);
+    else
+      query.objects.push_back(node.array);
+  }
+  return true;
+}
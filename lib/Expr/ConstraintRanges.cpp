@@ -0,0 +1,173 @@
+//===-- ConstraintRanges.cpp ----------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Expr/ConstraintRanges.h"
+
+#include "klee/ADT/Bits.h"
+#include "klee/Expr/ExprHashMap.h"
+#include "klee/Expr/ExprRangeEvaluator.h"
+
+using namespace klee;
+
+namespace {
+
+/// Evaluates ranges as the ExprRangeEvaluator does, narrowed by the bounds
+/// learned for the terms.
+class BoundedRangeEvaluator : public ExprRangeEvaluator<ValueRange> {
+  const ConstraintRanges &ranges;
+  /// Shared subexpressions are evaluated once.
+  ExprHashMap<ValueRange> cache;
+  bool unsupported = false;
+
+public:
+  explicit BoundedRangeEvaluator(const ConstraintRanges &ranges)
+      : ranges(ranges) {}
+
+  /// isUnsupported - Whether an expression wider than 64 bits was met, for
+  /// which the ranges are meaningless.
+  bool isUnsupported() const { return unsupported; }
+
+  ValueRange evaluate(const ref<Expr> &e) override {
+    if (e->getWidth() > 64) {
+      unsupported = true;
+      return ValueRange(0, UINT64_MAX);
+    }
+    if (isa<ConstantExpr>(e))
+      return ExprRangeEvaluator<ValueRange>::evaluate(e);
+
+    auto cached = cache.find(e);
+    if (cached != cache.end())
+      return cached->second;
+
+    ValueRange range = ExprRangeEvaluator<ValueRange>::evaluate(e);
+    if (const ValueRange *bounds = ranges.lookup(e)) {
+      ValueRange narrowed = range.set_intersection(*bounds);
+      if (!narrowed.isEmpty())
+        range = narrowed;
+    }
+    cache.emplace(e, range);
+    return range;
+  }
+
+protected:
+  ValueRange getInitialReadRange(const Array &array,
+                                 ValueRange index) override {
+    return ValueRange(0, bits64::maxValueOfNBits(array.getRange()));
+  }
+};
+
+} // namespace
+
+void ConstraintRanges::learn(const ref<Expr> &e, bool holds) {
+  switch (e->getKind()) {
+  case Expr::Constant:
+    return;
+
+  case Expr::And:
+    if (holds) {
+      learn(e->getKid(0), true);
+      learn(e->getKid(1), true);
+    }
+    return;
+  case Expr::Or:
+    if (!holds) {
+      learn(e->getKid(0), false);
+      learn(e->getKid(1), false);
+    }
+    return;
+  case Expr::Not:
+    learn(e->getKid(0), !holds);
+    return;
+
+  case Expr::Eq: {
+    const EqExpr *ee = cast<EqExpr>(e);
+    const ConstantExpr *CE = dyn_cast<ConstantExpr>(ee->left);
+    if (!CE || CE->getWidth() > 64)
+      return;
+    // negations are (Eq false X)
+    if (CE->getWidth() == Expr::Bool) {
+      learn(ee->right, holds == CE->isTrue());
+      return;
+    }
+    uint64_t value = CE->getZExtValue();
+    uint64_t max = bits64::maxValueOfNBits(CE->getWidth());
+    if (holds)
+      narrow(ee->right, ValueRange(value));
+    else if (value == 0)
+      narrow(ee->right, ValueRange(1, max));
+    else if (value == max)
+      narrow(ee->right, ValueRange(0, max - 1));
+    return;
+  }
+
+  case Expr::Ult:
+  case Expr::Ule: {
+    const BinaryExpr *be = cast<BinaryExpr>(e);
+    if (be->left->getWidth() > 64)
+      return;
+    // X < C bounds X from above, C < X from below, and their negations
+    // the other way round
+    ref<Expr> term;
+    const ConstantExpr *CE;
+    bool upper;
+    if ((CE = dyn_cast<ConstantExpr>(be->right))) {
+      term = be->left;
+      upper = holds;
+    } else if ((CE = dyn_cast<ConstantExpr>(be->left))) {
+      term = be->right;
+      upper = !holds;
+    } else {
+      return;
+    }
+    // the negation of a strict comparison is not strict and vice versa
+    bool strict = (e->getKind() == Expr::Ult) == holds;
+    uint64_t value = CE->getZExtValue();
+    uint64_t max = bits64::maxValueOfNBits(CE->getWidth());
+    if (upper) {
+      if (!strict || value != 0)
+        narrow(term, ValueRange(0, strict ? value - 1 : value));
+    } else {
+      if (!strict || value != max)
+        narrow(term, ValueRange(strict ? value + 1 : value, max));
+    }
+    return;
+  }
+
+  default:
+    // any other boolean term takes the given value
+    if (e->getWidth() == Expr::Bool)
+      narrow(e, ValueRange(holds ? 1 : 0));
+    return;
+  }
+}
+
+void ConstraintRanges::narrow(const ref<Expr> &e, const ValueRange &range) {
+  ValueRange narrowed = range;
+  if (const ValueRange *current = lookup(e)) {
+    narrowed = current->set_intersection(range);
+    // the path is infeasible, which the solver will find
+    if (narrowed.isEmpty() || narrowed == *current)
+      return;
+  }
+  bounds = bounds.replace({e, narrowed});
+}
+
+llvm::Optional<bool> ConstraintRanges::decide(const ref<Expr> &e) const {
+  assert(e->getWidth() == Expr::Bool && "non-boolean condition");
+  if (const ConstantExpr *CE = dyn_cast<ConstantExpr>(e))
+    return CE->isTrue();
+  if (bounds.empty())
+    return llvm::None;
+
+  BoundedRangeEvaluator evaluator(*this);
+  ValueRange range = evaluator.evaluate(e);
+  if (evaluator.isUnsupported() || !range.isFixed())
+    return llvm::None;
+  return range.min() != 0;
+}
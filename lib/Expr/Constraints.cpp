@@ -9,14 +9,16 @@
 
 #include "klee/Expr/Constraints.h"
 
+#include "klee/Expr/Assignment.h"
 #include "klee/Expr/ExprVisitor.h"
+#include "klee/Expr/IndependentSet.h"
 #include "klee/Module/KModule.h"
 #include "klee/Support/OptionCategories.h"
 
 #include "llvm/IR/Function.h"
 #include "llvm/Support/CommandLine.h"
 
-#include <map>
+#include <algorithm>
 
 using namespace klee;
 
@@ -35,7 +37,7 @@ private:
 
 public:
   ExprReplaceVisitor(const ref<Expr> &_src, const ref<Expr> &_dst)
-      : src(_src), dst(_dst) {}
+      : ExprVisitor(false, true), src(_src), dst(_dst) {}
 
   Action visitExpr(const Expr &e) override {
     if (e == *src) {
@@ -54,12 +56,11 @@ public:
 
 class ExprReplaceVisitor2 : public ExprVisitor {
 private:
-  const std::map< ref<Expr>, ref<Expr> > &replacements;
+  const ExprHashMap<ref<Expr>> &replacements;
 
 public:
-  explicit ExprReplaceVisitor2(
-      const std::map<ref<Expr>, ref<Expr>> &_replacements)
-      : ExprVisitor(true), replacements(_replacements) {}
+  explicit ExprReplaceVisitor2(const ExprHashMap<ref<Expr>> &_replacements)
+      : ExprVisitor(true, true), replacements(_replacements) {}
 
   Action visitExprPost(const Expr &e) override {
     auto it = replacements.find(ref<Expr>(const_cast<Expr *>(&e)));
@@ -71,22 +72,34 @@ public:
 };
 
 bool ConstraintManager::rewriteConstraints(ExprVisitor &visitor) {
-  ConstraintSet old;
-  bool changed = false;
-
-  std::swap(constraints, old);
-  for (auto &ce : old) {
+  // the constraints before the first one the visitor changes are kept
+  size_t unchanged = 0;
+  ref<Expr> rewritten;
+  auto it = constraints.begin(), ie = constraints.end();
+  for (; it != ie; ++it, ++unchanged) {
+    rewritten = visitor.visit(*it);
+    if (rewritten != *it)
+      break;
+  }
+  if (it == ie)
+    return false;
+
+  ConstraintSet::constraints_ty rest(std::next(it), ie);
+  // push_back checks whether the rewritten constraints still hold under the
+  // model, which holds for the prefix
+  constraints.truncate(unchanged);
+  addConstraintInternal(rewritten); // enable further reductions
+  for (auto &ce : rest) {
     ref<Expr> e = visitor.visit(ce);
 
     if (e!=ce) {
       addConstraintInternal(e); // enable further reductions
-      changed = true;
     } else {
       constraints.push_back(ce);
     }
   }
 
-  return changed;
+  return true;
 }
 
 ref<Expr> ConstraintManager::simplifyExpr(const ConstraintSet &constraints,
@@ -95,23 +108,9 @@ ref<Expr> ConstraintManager::simplifyExpr(const ConstraintSet &constraints,
   if (isa<ConstantExpr>(e))
     return e;
 
-  std::map< ref<Expr>, ref<Expr> > equalities;
-
-  for (auto &constraint : constraints) {
-    if (const EqExpr *ee = dyn_cast<EqExpr>(constraint)) {
-      if (isa<ConstantExpr>(ee->left)) {
-        equalities.insert(std::make_pair(ee->right,
-                                         ee->left));
-      } else {
-        equalities.insert(
-            std::make_pair(constraint, ConstantExpr::alloc(1, Expr::Bool)));
-      }
-    } else {
-      equalities.insert(
-          std::make_pair(constraint, ConstantExpr::alloc(1, Expr::Bool)));
-    }
-  }
-
+  const ExprHashMap<ref<Expr>> &equalities = constraints.getEqualities();
+  if (equalities.empty())
+    return e;
   return ExprReplaceVisitor2(equalities).visit(e);
 }
 
@@ -163,16 +162,132 @@ void ConstraintManager::addConstraint(const ref<Expr> &e) {
 ConstraintManager::ConstraintManager(ConstraintSet &_constraints)
     : constraints(_constraints) {}
 
-bool ConstraintSet::empty() const { return constraints.empty(); }
+/// Record the substitution of constraint, earlier ones take precedence.
+static void addEquality(ExprHashMap<ref<Expr>> &equalities,
+                        const ref<Expr> &constraint) {
+  if (const EqExpr *ee = dyn_cast<EqExpr>(constraint)) {
+    if (isa<ConstantExpr>(ee->left)) {
+      equalities.insert(std::make_pair(ee->right, ee->left));
+      return;
+    }
+  }
+  equalities.insert(
+      std::make_pair(constraint, ConstantExpr::alloc(1, Expr::Bool)));
+}
+
+bool ConstraintSet::empty() const { return numConstraints == 0; }
 
 klee::ConstraintSet::constraint_iterator ConstraintSet::begin() const {
-  return constraints.begin();
+  constraint_iterator it(0);
+  if (empty())
+    return it;
+  size_t end = numConstraints;
+  for (const Chunk *c = last.get(); c; c = c->prev.get()) {
+    it.chunks.emplace_back(c, end - c->offset);
+    end = c->offset;
+  }
+  std::reverse(it.chunks.begin(), it.chunks.end());
+  return it;
 }
 
 klee::ConstraintSet::constraint_iterator ConstraintSet::end() const {
-  return constraints.end();
+  return constraint_iterator(numConstraints);
 }
 
-size_t ConstraintSet::size() const noexcept { return constraints.size(); }
+size_t ConstraintSet::size() const noexcept { return numConstraints; }
+
+ConstraintSet::ConstraintSet(const constraints_ty &cs) {
+  for (const auto &e : cs)
+    push_back(e);
+}
 
-void ConstraintSet::push_back(const ref<Expr> &e) { constraints.push_back(e); }
+void ConstraintSet::push_back(const ref<Expr> &e) {
+  hashValue = hashValue * Expr::MAGIC_HASH_CONSTANT + e->hash();
+  if (partition)
+    partition = partition->extend(e);
+  if (otherModel && !otherModel->evaluate(e)->isTrue())
+    otherModel.reset();
+  if (model && !model->evaluate(e)->isTrue())
+    model = std::move(otherModel);
+  if (equalities) {
+    // the substitutions are shared with the copies of this set
+    if (equalities.use_count() > 1)
+      equalities = std::make_shared<ExprHashMap<ref<Expr>>>(*equalities);
+    addEquality(*equalities, e);
+  }
+
+  // e may refer to a constraint of the last chunk, so it is appended last:
+  // start a new chunk, unless we can extend the last one because no other
+  // set has extended it already
+  if (!last || last->offset + last->constraints.size() != numConstraints ||
+      last->constraints.size() == ChunkSize)
+    last = new Chunk(last, numConstraints);
+  last->constraints.push_back(e);
+  ++numConstraints;
+}
+
+void ConstraintSet::truncate(size_t n) {
+  assert(n <= numConstraints && "truncating to a larger set");
+  if (n == numConstraints)
+    return;
+  while (last && last->offset >= n)
+    last = last->prev;
+  numConstraints = n;
+
+  hashValue = 0;
+  for (const auto &e : *this)
+    hashValue = hashValue * Expr::MAGIC_HASH_CONSTANT + e->hash();
+  if (partition) {
+    partition = std::make_shared<IndependentPartition>();
+    for (const auto &e : *this)
+      partition = partition->extend(e);
+  }
+  equalities.reset();
+  // a model of the constraints is also one of the prefix, so both are kept
+}
+
+void ConstraintSet::setModel(std::shared_ptr<const Assignment> assignment) const {
+  assert((!assignment ||
+          std::all_of(begin(), end(),
+                      [&](const ref<Expr> &e) {
+                        return assignment->evaluate(e)->isTrue();
+                      })) &&
+         "not a model of the constraints");
+  model = std::move(assignment);
+}
+
+void ConstraintSet::setOtherModel(
+    std::shared_ptr<const Assignment> assignment) const {
+  assert((!assignment ||
+          std::all_of(begin(), end(),
+                      [&](const ref<Expr> &e) {
+                        return assignment->evaluate(e)->isTrue();
+                      })) &&
+         "not a model of the constraints");
+  otherModel = std::move(assignment);
+}
+
+const ExprHashMap<ref<Expr>> &ConstraintSet::getEqualities() const {
+  if (!equalities) {
+    equalities = std::make_shared<ExprHashMap<ref<Expr>>>();
+    for (const auto &constraint : *this)
+      addEquality(*equalities, constraint);
+  }
+  return *equalities;
+}
+
+void ConstraintSet::trackIndependence() {
+  if (partition)
+    return;
+  partition = std::make_shared<IndependentPartition>();
+  for (const auto &e : *this)
+    partition = partition->extend(e);
+}
+
+bool ConstraintSet::operator==(const ConstraintSet &b) const {
+  if (numConstraints != b.numConstraints || hashValue != b.hashValue)
+    return false;
+  if (last.get() == b.last.get())
+    return true;
+  return std::equal(begin(), end(), b.begin());
+}
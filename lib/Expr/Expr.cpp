@@ -11,11 +11,14 @@
 
 #include "klee/Config/Version.h"
 #include "klee/Expr/ExprPPrinter.h"
+#include "klee/Expr/ExprStats.h"
 #include "klee/Support/OptionCategories.h"
 // FIXME: We shouldn't need this once fast constant support moves into
 // Core. If we need to do arithmetic, we probably want to use APInt.
+#include "klee/Support/FloatEvaluation.h"
 #include "klee/Support/IntEvaluation.h"
 
+#include "llvm/ADT/APSInt.h"
 #include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/Hashing.h"
 #if LLVM_VERSION_CODE >= LLVM_VERSION(13, 0)
@@ -25,6 +28,7 @@
 #include "llvm/Support/raw_ostream.h"
 
 #include <sstream>
+#include <unordered_map>
 
 using namespace klee;
 using namespace llvm;
@@ -41,11 +45,65 @@ cl::opt<bool> ConstArrayOpt(
     cl::desc(
         "Enable an optimization involving all-constant arrays (default=false)"),
     cl::cat(klee::ExprCat));
+
+cl::opt<bool, true> HashConsExprs(
+    "hash-cons-exprs", cl::location(Expr::hashConsing),
+    cl::desc("Share one node between structurally equal expressions "
+             "(default=false)"),
+    cl::cat(klee::ExprCat));
+
+/// The length from which update lists are searched with their index of
+/// concrete writes (see UpdateNode::findConcreteWrite) instead of walking
+/// them, for reads at concrete indices.
+const unsigned MinIndexedUpdates = 16;
+
+/// The table of unique expressions, indexed by their hashes. Nodes remove
+/// themselves when they are deleted; the table is never destroyed, as
+/// expressions may outlive static destructors.
+std::unordered_multimap<unsigned, Expr *> &getUniqueTable() {
+  static auto *table = new std::unordered_multimap<unsigned, Expr *>();
+  return *table;
+}
 }
 
 /***/
 
 unsigned Expr::count = 0;
+bool Expr::hashConsing = false;
+
+bool Expr::isUniqueCopyOf(const Expr &b) const {
+  if (getKind() != b.getKind() || hashValue != b.hashValue ||
+      getWidth() != b.getWidth() || compareContents(b))
+    return false;
+  // the kids of unique nodes are unique
+  for (unsigned i = 0, n = getNumKids(); i != n; ++i)
+    if (getKid(i).get() != b.getKid(i).get())
+      return false;
+  return true;
+}
+
+ref<Expr> Expr::getUnique(const ref<Expr> &e) {
+  auto &table = getUniqueTable();
+  auto range = table.equal_range(e->hashValue);
+  for (auto it = range.first; it != range.second; ++it)
+    if (it->second->isUniqueCopyOf(*e))
+      return it->second;
+  table.emplace(e->hashValue, e.get());
+  e->isUnique = true;
+  return e;
+}
+
+void Expr::removeUnique() {
+  // called from the destructor, so only the pointer may be compared
+  auto &table = getUniqueTable();
+  auto range = table.equal_range(hashValue);
+  for (auto it = range.first; it != range.second; ++it) {
+    if (it->second == this) {
+      table.erase(it);
+      return;
+    }
+  }
+}
 
 ref<Expr> Expr::createTempRead(const Array *array, Expr::Width w) {
   UpdateList ul(array, 0);
@@ -201,6 +259,20 @@ void Expr::printKind(llvm::raw_ostream &os, Kind k) {
     X(Sle);
     X(Sgt);
     X(Sge);
+    X(FAdd);
+    X(FSub);
+    X(FMul);
+    X(FDiv);
+    X(FOEq);
+    X(FOLt);
+    X(FOLe);
+    X(FUno);
+    X(FPExt);
+    X(FPTrunc);
+    X(FPToUI);
+    X(FPToSI);
+    X(UIToFP);
+    X(SIToFP);
 #undef X
   default:
     assert(0 && "invalid kind");
@@ -216,13 +288,18 @@ void Expr::printKind(llvm::raw_ostream &os, Kind k) {
 unsigned Expr::computeHash() {
   unsigned res = getKind() * Expr::MAGIC_HASH_CONSTANT;
 
+  StableHash stable(getKind());
+  stable.combine(getWidth());
+
   int n = getNumKids();
   for (int i = 0; i < n; i++) {
     res <<= 1;
     res ^= getKid(i)->hash() * Expr::MAGIC_HASH_CONSTANT;
+    stable.combine(getKid(i)->stableHash());
   }
   
   hashValue = res;
+  stableHashValue = stable;
   return hashValue;
 }
 
@@ -233,12 +310,23 @@ unsigned ConstantExpr::computeHash() {
   else
     hashValue = hash_value(value) ^ (w * MAGIC_HASH_CONSTANT);
 
+  StableHash stable(Constant);
+  stable.combine(w);
+  for (unsigned i = 0, e = value.getNumWords(); i != e; ++i)
+    stable.combine(value.getRawData()[i]);
+  stableHashValue = stable;
+
   return hashValue;
 }
 
 unsigned CastExpr::computeHash() {
   unsigned res = getWidth() * Expr::MAGIC_HASH_CONSTANT;
   hashValue = res ^ src->hash() * Expr::MAGIC_HASH_CONSTANT;
+
+  StableHash stable(getKind());
+  stable.combine(getWidth());
+  stable.combine(src->stableHash());
+  stableHashValue = stable;
   return hashValue;
 }
 
@@ -246,6 +334,12 @@ unsigned ExtractExpr::computeHash() {
   unsigned res = offset * Expr::MAGIC_HASH_CONSTANT;
   res ^= getWidth() * Expr::MAGIC_HASH_CONSTANT;
   hashValue = res ^ expr->hash() * Expr::MAGIC_HASH_CONSTANT;
+
+  StableHash stable(Extract);
+  stable.combine(offset);
+  stable.combine(getWidth());
+  stable.combine(expr->stableHash());
+  stableHashValue = stable;
   return hashValue;
 }
 
@@ -253,11 +347,20 @@ unsigned ReadExpr::computeHash() {
   unsigned res = index->hash() * Expr::MAGIC_HASH_CONSTANT;
   res ^= updates.hash();
   hashValue = res;
+
+  StableHash stable(Read);
+  stable.combine(index->stableHash());
+  stable.combine(updates.stableHash());
+  stableHashValue = stable;
   return hashValue;
 }
 
 unsigned NotExpr::computeHash() {
   hashValue = expr->hash() * Expr::MAGIC_HASH_CONSTANT * Expr::Not;
+
+  StableHash stable(Not);
+  stable.combine(expr->stableHash());
+  stableHashValue = stable;
   return hashValue;
 }
 
@@ -308,6 +411,12 @@ ref<Expr> Expr::createFromKind(Kind k, std::vector<CreateArg> args) {
 
       CAST_EXPR_CASE(ZExt);
       CAST_EXPR_CASE(SExt);
+      CAST_EXPR_CASE(FPExt);
+      CAST_EXPR_CASE(FPTrunc);
+      CAST_EXPR_CASE(FPToUI);
+      CAST_EXPR_CASE(FPToSI);
+      CAST_EXPR_CASE(UIToFP);
+      CAST_EXPR_CASE(SIToFP);
       
       BINARY_EXPR_CASE(Add);
       BINARY_EXPR_CASE(Sub);
@@ -333,6 +442,15 @@ ref<Expr> Expr::createFromKind(Kind k, std::vector<CreateArg> args) {
       BINARY_EXPR_CASE(Sle);
       BINARY_EXPR_CASE(Sgt);
       BINARY_EXPR_CASE(Sge);
+
+      BINARY_EXPR_CASE(FAdd);
+      BINARY_EXPR_CASE(FSub);
+      BINARY_EXPR_CASE(FMul);
+      BINARY_EXPR_CASE(FDiv);
+      BINARY_EXPR_CASE(FOEq);
+      BINARY_EXPR_CASE(FOLt);
+      BINARY_EXPR_CASE(FOLe);
+      BINARY_EXPR_CASE(FUno);
   }
 }
 
@@ -371,6 +489,34 @@ void Expr::dump() const {
 
 /***/
 
+ref<ConstantExpr> ConstantExpr::getCached(const llvm::APInt &v) {
+  const int64_t min = -128, max = 1024;
+  unsigned table;
+  switch (v.getBitWidth()) {
+  case Expr::Bool: table = 0; break;
+  case Expr::Int8: table = 1; break;
+  case Expr::Int16: table = 2; break;
+  case Expr::Int32: table = 3; break;
+  case Expr::Int64: table = 4; break;
+  default: return nullptr;
+  }
+  int64_t value = v.getSExtValue();
+  if (value < min || value > max)
+    return nullptr;
+
+  // the nodes are never freed, they are created on first use
+  static auto *cache = new ref<ConstantExpr>[5 * (max - min + 1)];
+  ref<ConstantExpr> &cached = cache[table * (max - min + 1) + (value - min)];
+  if (cached.isNull()) {
+    ref<ConstantExpr> r(new ConstantExpr(v));
+    r->computeHash();
+    cached = cast<ConstantExpr>(hashCons(r));
+  } else {
+    ++stats::constantCacheHits;
+  }
+  return cached;
+}
+
 ref<Expr> ConstantExpr::fromMemory(void *address, Width width) {
   switch (width) {
   default: assert(0 && "invalid width");
@@ -546,6 +692,161 @@ ref<ConstantExpr> ConstantExpr::Sge(const ref<ConstantExpr> &RHS) {
   return ConstantExpr::alloc(value.sge(RHS->value), Expr::Bool);
 }
 
+const llvm::fltSemantics *ConstantExpr::getFloatSemantics(Width W) {
+  switch (W) {
+  case Expr::Int32:
+    return &llvm::APFloat::IEEEsingle();
+  case Expr::Int64:
+    return &llvm::APFloat::IEEEdouble();
+  case Expr::Fl80:
+    return &llvm::APFloat::x87DoubleExtended();
+  default:
+    return nullptr;
+  }
+}
+
+static llvm::APFloat toAPFloat(const llvm::APInt &value) {
+  const llvm::fltSemantics *semantics =
+      ConstantExpr::getFloatSemantics(value.getBitWidth());
+  assert(semantics && "not a floating-point width");
+  return llvm::APFloat(*semantics, value);
+}
+
+/// All NaN results are the positive quiet NaN without payload, as the NaNs
+/// the solvers produce cannot be told apart.
+static ref<ConstantExpr> fromAPFloat(const llvm::APFloat &f) {
+  if (f.isNaN())
+    return ConstantExpr::alloc(llvm::APFloat::getQNaN(f.getSemantics()));
+  return ConstantExpr::alloc(f);
+}
+
+/// Evaluate op on the host for floats and doubles, which is much faster than
+/// APFloat. Return false if the result has to come from APFloat instead.
+template <typename Op>
+static bool evaluateOnHost(const APInt &l, const APInt &r, APInt &result,
+                           Op op) {
+  if (!floats::hostIsIEEE)
+    return false;
+  uint64_t bits;
+  switch (l.getBitWidth()) {
+  case floats::FLT_BITS:
+    bits = floats::FloatAsUInt64(op(floats::UInt64AsFloat(l.getZExtValue()),
+                                    floats::UInt64AsFloat(r.getZExtValue())));
+    break;
+  case floats::DBL_BITS:
+    bits = floats::DoubleAsUInt64(op(floats::UInt64AsDouble(l.getZExtValue()),
+                                     floats::UInt64AsDouble(r.getZExtValue())));
+    break;
+  default:
+    return false;
+  }
+  // leave NaNs to be made canonical
+  if (floats::isNaN(bits, l.getBitWidth()))
+    return false;
+  result = APInt(l.getBitWidth(), bits);
+  return true;
+}
+
+ref<ConstantExpr> ConstantExpr::FAdd(const ref<ConstantExpr> &RHS) {
+  APInt bits;
+  if (evaluateOnHost(value, RHS->value, bits,
+                     [](auto l, auto r) { return l + r; }))
+    return ConstantExpr::alloc(bits);
+  APFloat result = toAPFloat(value);
+  result.add(toAPFloat(RHS->value), APFloat::rmNearestTiesToEven);
+  return fromAPFloat(result);
+}
+
+ref<ConstantExpr> ConstantExpr::FSub(const ref<ConstantExpr> &RHS) {
+  APInt bits;
+  if (evaluateOnHost(value, RHS->value, bits,
+                     [](auto l, auto r) { return l - r; }))
+    return ConstantExpr::alloc(bits);
+  APFloat result = toAPFloat(value);
+  result.subtract(toAPFloat(RHS->value), APFloat::rmNearestTiesToEven);
+  return fromAPFloat(result);
+}
+
+ref<ConstantExpr> ConstantExpr::FMul(const ref<ConstantExpr> &RHS) {
+  APInt bits;
+  if (evaluateOnHost(value, RHS->value, bits,
+                     [](auto l, auto r) { return l * r; }))
+    return ConstantExpr::alloc(bits);
+  APFloat result = toAPFloat(value);
+  result.multiply(toAPFloat(RHS->value), APFloat::rmNearestTiesToEven);
+  return fromAPFloat(result);
+}
+
+ref<ConstantExpr> ConstantExpr::FDiv(const ref<ConstantExpr> &RHS) {
+  APInt bits;
+  if (evaluateOnHost(value, RHS->value, bits,
+                     [](auto l, auto r) { return l / r; }))
+    return ConstantExpr::alloc(bits);
+  APFloat result = toAPFloat(value);
+  result.divide(toAPFloat(RHS->value), APFloat::rmNearestTiesToEven);
+  return fromAPFloat(result);
+}
+
+ref<ConstantExpr> ConstantExpr::FOEq(const ref<ConstantExpr> &RHS) {
+  APFloat::cmpResult cmp = toAPFloat(value).compare(toAPFloat(RHS->value));
+  return ConstantExpr::alloc(cmp == APFloat::cmpEqual, Expr::Bool);
+}
+
+ref<ConstantExpr> ConstantExpr::FOLt(const ref<ConstantExpr> &RHS) {
+  APFloat::cmpResult cmp = toAPFloat(value).compare(toAPFloat(RHS->value));
+  return ConstantExpr::alloc(cmp == APFloat::cmpLessThan, Expr::Bool);
+}
+
+ref<ConstantExpr> ConstantExpr::FOLe(const ref<ConstantExpr> &RHS) {
+  APFloat::cmpResult cmp = toAPFloat(value).compare(toAPFloat(RHS->value));
+  return ConstantExpr::alloc(
+      cmp == APFloat::cmpLessThan || cmp == APFloat::cmpEqual, Expr::Bool);
+}
+
+ref<ConstantExpr> ConstantExpr::FUno(const ref<ConstantExpr> &RHS) {
+  APFloat::cmpResult cmp = toAPFloat(value).compare(toAPFloat(RHS->value));
+  return ConstantExpr::alloc(cmp == APFloat::cmpUnordered, Expr::Bool);
+}
+
+ref<ConstantExpr> ConstantExpr::FPExt(Width W) {
+  APFloat result = toAPFloat(value);
+  bool losesInfo;
+  result.convert(*getFloatSemantics(W), APFloat::rmNearestTiesToEven,
+                 &losesInfo);
+  return fromAPFloat(result);
+}
+
+ref<ConstantExpr> ConstantExpr::FPTrunc(Width W) { return FPExt(W); }
+
+ref<ConstantExpr> ConstantExpr::FPToUI(Width W) {
+  // APFloat saturates and converts NaN to 0
+  llvm::APSInt result(W, /*isUnsigned=*/true);
+  bool isExact;
+  toAPFloat(value).convertToInteger(result, APFloat::rmTowardZero, &isExact);
+  return ConstantExpr::alloc(result);
+}
+
+ref<ConstantExpr> ConstantExpr::FPToSI(Width W) {
+  llvm::APSInt result(W, /*isUnsigned=*/false);
+  bool isExact;
+  toAPFloat(value).convertToInteger(result, APFloat::rmTowardZero, &isExact);
+  return ConstantExpr::alloc(result);
+}
+
+ref<ConstantExpr> ConstantExpr::UIToFP(Width W) {
+  APFloat result(*getFloatSemantics(W), 0);
+  result.convertFromAPInt(value, /*isSigned=*/false,
+                          APFloat::rmNearestTiesToEven);
+  return fromAPFloat(result);
+}
+
+ref<ConstantExpr> ConstantExpr::SIToFP(Width W) {
+  APFloat result(*getFloatSemantics(W), 0);
+  result.convertFromAPInt(value, /*isSigned=*/true,
+                          APFloat::rmNearestTiesToEven);
+  return fromAPFloat(result);
+}
+
 /***/
 
 ref<Expr>  NotOptimizedExpr::create(ref<Expr> src) {
@@ -558,18 +859,28 @@ Array::Array(const std::string &_name, uint64_t _size,
              const ref<ConstantExpr> *constantValuesBegin,
              const ref<ConstantExpr> *constantValuesEnd, Expr::Width _domain,
              Expr::Width _range)
-    : name(_name), size(_size), domain(_domain), range(_range),
-      constantValues(constantValuesBegin, constantValuesEnd) {
-
-  assert((isSymbolicArray() || constantValues.size() == size) &&
+    : name(_name), size(_size), domain(_domain), range(_range) {
+  assert((constantValuesBegin == constantValuesEnd ||
+          size_t(constantValuesEnd - constantValuesBegin) == size) &&
          "Invalid size for constant array!");
-  computeHash();
 #ifndef NDEBUG
   for (const ref<ConstantExpr> *it = constantValuesBegin;
        it != constantValuesEnd; ++it)
     assert((*it)->getWidth() == getRange() &&
            "Invalid initial constant value!");
 #endif // NDEBUG
+  if (range == Expr::Int8 && constantValuesBegin != constantValuesEnd) {
+    auto bytes = std::make_shared<std::vector<uint8_t> >();
+    bytes->reserve(size);
+    for (const ref<ConstantExpr> *it = constantValuesBegin;
+         it != constantValuesEnd; ++it)
+      bytes->push_back((*it)->getZExtValue(8));
+    constantBytes = std::move(bytes);
+  } else {
+    constantValues.assign(constantValuesBegin, constantValuesEnd);
+  }
+  computeHash();
+  computeStableHash();
 }
 
 Array::~Array() {
@@ -583,6 +894,43 @@ unsigned Array::computeHash() {
   hashValue = res;
   return hashValue; 
 }
+
+void Array::computeStableHash() {
+  llvm::StringRef stableName = name;
+  bool isOffset = stableName.consume_back("_off");
+  size_t counter = stableName.find_last_not_of("0123456789");
+  if (counter != llvm::StringRef::npos && counter + 1 < stableName.size() &&
+      stableName[counter] == '_')
+    stableName = stableName.take_front(counter);
+
+  StableHash stable(stableName.size());
+  for (char c : stableName)
+    stable.combine(static_cast<unsigned char>(c));
+  stable.combine(isOffset);
+  stable.combine(size);
+  stable.combine(domain);
+  stable.combine(range);
+  for (size_t i = 0, e = isConstantArray() ? size : 0; i != e; ++i)
+    stable.combine(getConstantValue(i)->stableHash());
+  stableHashValue = stable;
+}
+
+ref<ConstantExpr> Array::getConstantValue(size_t index) const {
+  assert(isConstantArray() && index < size && "Invalid constant array read");
+  if (constantBytes)
+    return ConstantExpr::create((*constantBytes)[index], Expr::Int8);
+  return constantValues[index];
+}
+
+std::vector<ref<ConstantExpr> > Array::getConstantValues() const {
+  if (!constantBytes)
+    return constantValues;
+  std::vector<ref<ConstantExpr> > values;
+  values.reserve(size);
+  for (uint8_t byte : *constantBytes)
+    values.push_back(ConstantExpr::create(byte, Expr::Int8));
+  return values;
+}
 /***/
 
 ref<Expr> ReadExpr::create(const UpdateList &ul, ref<Expr> index) {
@@ -594,7 +942,23 @@ ref<Expr> ReadExpr::create(const UpdateList &ul, ref<Expr> index) {
   // array element has been updated
   auto un = ul.head.get();
   bool updateListHasSymbolicWrites = false;
+  auto constantIndex = dyn_cast<ConstantExpr>(index);
+  if (constantIndex && constantIndex->getWidth() > 64)
+    constantIndex = nullptr;
   for (; un; un = un->next.get()) {
+    // skip over long runs of writes at concrete indices with the index of
+    // the update list
+    if (constantIndex && un->getSize() >= MinIndexedUpdates &&
+        isa<ConstantExpr>(un->index) && un->index->getWidth() <= 64) {
+      UpdateNode *symbolicWrite;
+      if (auto write = un->findConcreteWrite(constantIndex->getZExtValue(),
+                                             symbolicWrite))
+        return write->value;
+      un = symbolicWrite;
+      if (!un)
+        break;
+    }
+
     ref<Expr> cond = EqExpr::create(index, un->index);
     if (ConstantExpr *CE = dyn_cast<ConstantExpr>(cond)) {
       if (CE->isTrue())
@@ -612,8 +976,8 @@ ref<Expr> ReadExpr::create(const UpdateList &ul, ref<Expr> index) {
     if (ConstantExpr *CE = dyn_cast<ConstantExpr>(index)) {
       assert(CE->getWidth() <= 64 && "Index too large");
       uint64_t concreteIndex = CE->getZExtValue();
-      if (concreteIndex < ul.root->constantValues.size()) {
-        return ul.root->constantValues[concreteIndex];
+      if (concreteIndex < ul.root->size) {
+        return ul.root->getConstantValue(concreteIndex);
       }
     }
   }
@@ -1125,7 +1489,7 @@ static ref<Expr> TryConstArrayOpt(const ref<ConstantExpr> &cl,
   // where the concrete array has one update for each index, in order
   ref<Expr> res = ConstantExpr::alloc(0, Expr::Bool);
   for (unsigned i = 0, e = rd->updates.root->size; i != e; ++i) {
-    if (cl == rd->updates.root->constantValues[i]) {
+    if (cl == rd->updates.root->getConstantValue(i)) {
       // Arbitrary maximum on the size of disjunction.
       if (++numMatches > 100)
         return EqExpr_create(cl, rd);
@@ -1278,3 +1642,39 @@ CMPCREATE(UltExpr, Ult)
 CMPCREATE(UleExpr, Ule)
 CMPCREATE(SltExpr, Slt)
 CMPCREATE(SleExpr, Sle)
+
+/***/
+
+#define FPCREATE(_e_op, _op)                                                   \
+  ref<Expr> _e_op ::create(const ref<Expr> &l, const ref<Expr> &r) {           \
+    assert(l->getWidth() == r->getWidth() && "type mismatch");                 \
+    assert(ConstantExpr::getFloatSemantics(l->getWidth()) &&                   \
+           "not a floating-point width");                                      \
+    if (ConstantExpr *cl = dyn_cast<ConstantExpr>(l))                          \
+      if (ConstantExpr *cr = dyn_cast<ConstantExpr>(r))                        \
+        return cl->_op(cr);                                                    \
+    return _e_op ::alloc(l, r);                                                \
+  }
+
+FPCREATE(FAddExpr, FAdd)
+FPCREATE(FSubExpr, FSub)
+FPCREATE(FMulExpr, FMul)
+FPCREATE(FDivExpr, FDiv)
+FPCREATE(FOEqExpr, FOEq)
+FPCREATE(FOLtExpr, FOLt)
+FPCREATE(FOLeExpr, FOLe)
+FPCREATE(FUnoExpr, FUno)
+
+#define FPCASTCREATE(_e_op, _op)                                               \
+  ref<Expr> _e_op ::create(const ref<Expr> &e, Width w) {                      \
+    if (ConstantExpr *CE = dyn_cast<ConstantExpr>(e))                          \
+      return CE->_op(w);                                                       \
+    return _e_op ::alloc(e, w);                                                \
+  }
+
+FPCASTCREATE(FPExtExpr, FPExt)
+FPCASTCREATE(FPTruncExpr, FPTrunc)
+FPCASTCREATE(FPToUIExpr, FPToUI)
+FPCASTCREATE(FPToSIExpr, FPToSI)
+FPCASTCREATE(UIToFPExpr, UIToFP)
+FPCASTCREATE(SIToFPExpr, SIToFP)
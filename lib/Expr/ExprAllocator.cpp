@@ -0,0 +1,102 @@
+//===-- ExprAllocator.cpp -------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Expr/ExprAllocator.h"
+
+#include "klee/Statistics/MemoryAccount.h"
+
+#include "llvm/Support/ErrorHandling.h"
+
+#include <cstdlib>
+#include <new>
+
+using namespace klee;
+
+namespace {
+
+const size_t NumClasses = ExprAllocator::MaxSize / ExprAllocator::Granularity;
+
+/// The number of bytes allocated at once for a size class.
+const size_t SlabSize = 64 * 1024;
+
+struct FreeNode {
+  FreeNode *next;
+};
+
+/// The state of one size class: the free list and the unused end of its
+/// current slab. Slabs are never returned, they live until exit.
+struct SizeClass {
+  FreeNode *freeList = nullptr;
+  char *next = nullptr;
+  char *end = nullptr;
+};
+
+/// Zero-initialized before any constructor runs, so nodes can be
+/// allocated during static initialization.
+SizeClass classes[NumClasses];
+
+/// The bytes of the nodes handed out and not freed.
+uint64_t usedBytes;
+
+inline size_t getClass(size_t size) {
+  return (size + ExprAllocator::Granularity - 1) /
+             ExprAllocator::Granularity -
+         1;
+}
+
+} // namespace
+
+void *ExprAllocator::allocate(size_t size) {
+  if (size == 0 || size > MaxSize)
+    return ::operator new(size);
+
+  size_t index = getClass(size);
+  SizeClass &c = classes[index];
+  size_t nodeSize = (index + 1) * Granularity;
+  usedBytes += nodeSize;
+  if (FreeNode *node = c.freeList) {
+    c.freeList = node->next;
+    return node;
+  }
+
+  if (static_cast<size_t>(c.end - c.next) < nodeSize) {
+    c.next = static_cast<char *>(std::malloc(SlabSize));
+    if (!c.next)
+      llvm::report_bad_alloc_error("Allocation of an expression slab failed");
+    c.end = c.next + SlabSize - SlabSize % nodeSize;
+    memory::expressions.add(SlabSize);
+  }
+  void *p = c.next;
+  c.next += nodeSize;
+  return p;
+}
+
+void ExprAllocator::deallocate(void *p, size_t size) {
+  if (!p)
+    return;
+  if (size == 0 || size > MaxSize) {
+    ::operator delete(p);
+    return;
+  }
+
+  size_t index = getClass(size);
+  SizeClass &c = classes[index];
+  usedBytes -= (index + 1) * Granularity;
+  auto node = static_cast<FreeNode *>(p);
+  node->next = c.freeList;
+  c.freeList = node;
+}
+
+uint64_t ExprAllocator::getSlabBytes() {
+  return memory::expressions.getBytes();
+}
+
+uint64_t ExprAllocator::getFreeBytes() {
+  return memory::expressions.getBytes() - usedBytes;
+}
@@ -30,8 +30,8 @@ ExprVisitor::Action ExprEvaluator::evalRead(const UpdateList &ul,
     }
   }
   
-  if (ul.root->isConstantArray() && index < ul.root->constantValues.size())
-    return Action::changeTo(ul.root->constantValues[index]);
+  if (ul.root->isConstantArray() && index < ul.root->size)
+    return Action::changeTo(ul.root->getConstantValue(index));
 
   return Action::changeTo(getInitialValue(*ul.root, index));
 }
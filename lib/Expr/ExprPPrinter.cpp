@@ -524,7 +524,7 @@ void ExprPPrinter::printQuery(llvm::raw_ostream &os,
         for (unsigned i = 0, e = A->size; i != e; ++i) {
           if (i)
             PC << " ";
-          PC << A->constantValues[i];
+          PC << A->getConstantValue(i);
         }
         PC << "]";
       }
@@ -587,14 +587,11 @@ void ExprSMTLIBPrinter::printArrayDeclarations() {
     for (std::vector<const Array *>::iterator it = sortedArrays.begin();
          it != sortedArrays.end(); it++) {
       array = *it;
-      int byteIndex = 0;
       if (array->isConstantArray()) {
         /*loop over elements in the array and generate an assert statement
           for each one
          */
-        for (std::vector<ref<ConstantExpr> >::const_iterator
-                 ce = array->constantValues.begin();
-             ce != array->constantValues.end(); ce++, byteIndex++) {
+        for (unsigned byteIndex = 0; byteIndex != array->size; ++byteIndex) {
           *p << "(assert (";
           p->pushIndent();
           *p << "= ";
@@ -604,7 +601,7 @@ void ExprSMTLIBPrinter::printArrayDeclarations() {
           *p << "(select " << array->name << " (_ bv" << byteIndex << " "
              << array->getDomain() << ") )";
           printSeperator();
-          printConstant((*ce));
+          printConstant(array->getConstantValue(byteIndex));
 
           p->popIndent();
           printSeperator();
@@ -654,8 +651,7 @@ void ExprSMTLIBPrinter::printQueryInSingleAssert() {
   ref<Expr> queryAssert = Expr::createIsZero(query->expr);
 
   // Print constraints inside the main query to reuse the Expr bindings
-  for (std::vector<ref<Expr> >::const_iterator i = query->constraints.begin(),
-                                               e = query->constraints.end();
+  for (auto i = query->constraints.begin(), e = query->constraints.end();
        i != e; ++i) {
     queryAssert = AndExpr::create(queryAssert, *i);
   }
@@ -0,0 +1,270 @@
+//===-- ExprTape.cpp ------------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Expr/ExprTape.h"
+
+#include "klee/Expr/Assignment.h"
+
+#include <cassert>
+#include <unordered_map>
+
+using namespace klee;
+
+namespace {
+
+inline uint64_t widthMask(Expr::Width w) {
+  return w >= 64 ? ~UINT64_C(0) : (UINT64_C(1) << w) - 1;
+}
+
+inline int64_t signExtend(uint64_t v, Expr::Width w) {
+  return w >= 64 ? static_cast<int64_t>(v)
+                 : static_cast<int64_t>(v << (64 - w)) >> (64 - w);
+}
+
+} // namespace
+
+bool ExprTape::compile(const ref<Expr> &root) {
+  code.clear();
+  updates.clear();
+
+  std::unordered_map<const Expr *, unsigned> registerOf;
+  // expressions with whether the nodes they depend on were pushed
+  std::vector<std::pair<const Expr *, bool>> stack;
+  stack.emplace_back(root.get(), false);
+  auto push = [&registerOf, &stack](const ref<Expr> &e) {
+    if (!registerOf.count(e.get()))
+      stack.emplace_back(e.get(), false);
+  };
+
+  while (!stack.empty()) {
+    const Expr *e = stack.back().first;
+    if (registerOf.count(e)) {
+      stack.pop_back();
+      continue;
+    }
+
+    if (!stack.back().second) {
+      // floating-point operations are left to the ExprEvaluator
+      if (e->getWidth() > 64 || (Expr::FPKindFirst <= e->getKind() &&
+                                 e->getKind() <= Expr::FPKindLast)) {
+        code.clear();
+        updates.clear();
+        return false;
+      }
+      stack.back().second = true;
+      for (unsigned i = 0, n = e->getNumKids(); i != n; ++i)
+        push(e->getKid(i));
+      if (const ReadExpr *re = dyn_cast<ReadExpr>(e)) {
+        for (const UpdateNode *un = re->updates.head.get(); un;
+             un = un->next.get()) {
+          push(un->index);
+          push(un->value);
+        }
+      }
+      continue;
+    }
+
+    stack.pop_back();
+    Instruction inst = {};
+    inst.kind = e->getKind();
+    inst.width = e->getWidth();
+    for (unsigned i = 0, n = e->getNumKids(); i != n; ++i)
+      inst.operands[i] = registerOf.find(e->getKid(i).get())->second;
+    if (e->getNumKids())
+      inst.operandWidth = e->getKid(0)->getWidth();
+
+    if (const ConstantExpr *ce = dyn_cast<ConstantExpr>(e)) {
+      inst.immediate = ce->getZExtValue();
+    } else if (const ExtractExpr *ee = dyn_cast<ExtractExpr>(e)) {
+      inst.immediate = ee->offset;
+    } else if (const ReadExpr *re = dyn_cast<ReadExpr>(e)) {
+      inst.array = re->updates.root;
+      inst.immediate = updates.size();
+      for (const UpdateNode *un = re->updates.head.get(); un;
+           un = un->next.get()) {
+        updates.emplace_back(registerOf.find(un->index.get())->second,
+                             registerOf.find(un->value.get())->second);
+        ++inst.numUpdates;
+      }
+    }
+
+    registerOf.emplace(e, code.size());
+    code.push_back(inst);
+  }
+
+  registers.resize(code.size());
+  return true;
+}
+
+bool ExprTape::evaluate(const Assignment &assignment, uint64_t &result) const {
+  assert(isCompiled() && "evaluating an expression that was not compiled");
+  uint64_t *r = registers.data();
+
+  for (unsigned pc = 0, n = code.size(); pc != n; ++pc) {
+    const Instruction &inst = code[pc];
+    const Expr::Width w = inst.width;
+    const uint64_t mask = widthMask(w);
+    const uint64_t a = r[inst.operands[0]], b = r[inst.operands[1]];
+    uint64_t &v = r[pc];
+
+    switch (inst.kind) {
+    case Expr::Constant:
+      v = inst.immediate;
+      break;
+    case Expr::Read: {
+      // as in ExprEvaluator::evalRead
+      const auto *un = &updates[inst.immediate];
+      const auto *end = un + inst.numUpdates;
+      for (; un != end; ++un)
+        if (r[un->first] == a)
+          break;
+      unsigned index = a;
+      if (un != end)
+        v = r[un->second];
+      else if (inst.array->isConstantArray() && index < inst.array->size)
+        v = inst.array->getConstantValue(index)->getZExtValue();
+      else
+        v = assignment.getValue(inst.array, index) & mask;
+      break;
+    }
+    case Expr::NotOptimized:
+    case Expr::ZExt:
+      v = a;
+      break;
+    case Expr::Select:
+      v = a ? b : r[inst.operands[2]];
+      break;
+    case Expr::Concat:
+      v = (a << (w - inst.operandWidth)) | b;
+      break;
+    case Expr::Extract:
+      v = (a >> inst.immediate) & mask;
+      break;
+    case Expr::SExt:
+      v = static_cast<uint64_t>(signExtend(a, inst.operandWidth)) & mask;
+      break;
+
+    case Expr::Add:
+      v = (a + b) & mask;
+      break;
+    case Expr::Sub:
+      v = (a - b) & mask;
+      break;
+    case Expr::Mul:
+      v = (a * b) & mask;
+      break;
+
+    // boolean divisions are folded to the dividend or false by their
+    // create methods, even when the divisor is symbolic
+    case Expr::UDiv:
+      if (w == Expr::Bool) {
+        v = a;
+        break;
+      }
+      if (!b)
+        return false;
+      v = a / b;
+      break;
+    case Expr::URem:
+      if (w == Expr::Bool) {
+        v = 0;
+        break;
+      }
+      if (!b)
+        return false;
+      v = a % b;
+      break;
+    case Expr::SDiv: {
+      if (w == Expr::Bool) {
+        v = a;
+        break;
+      }
+      int64_t l = signExtend(a, w), d = signExtend(b, w);
+      if (!d)
+        return false;
+      // the minimum divided by -1 overflows to itself
+      v = (d == -1 ? 0 - a : static_cast<uint64_t>(l / d)) & mask;
+      break;
+    }
+    case Expr::SRem: {
+      if (w == Expr::Bool) {
+        v = 0;
+        break;
+      }
+      int64_t l = signExtend(a, w), d = signExtend(b, w);
+      if (!d)
+        return false;
+      v = d == -1 ? 0 : static_cast<uint64_t>(l % d) & mask;
+      break;
+    }
+
+    case Expr::Not:
+      v = ~a & mask;
+      break;
+    case Expr::And:
+      v = a & b;
+      break;
+    case Expr::Or:
+      v = a | b;
+      break;
+    case Expr::Xor:
+      v = a ^ b;
+      break;
+
+    // shifts by at least the width shift out all bits, as APInt does
+    case Expr::Shl:
+      v = b >= w ? 0 : (a << b) & mask;
+      break;
+    case Expr::LShr:
+      v = b >= w ? 0 : a >> b;
+      break;
+    case Expr::AShr:
+      v = static_cast<uint64_t>(signExtend(a, w) >> (b >= w ? w - 1 : b)) &
+          mask;
+      break;
+
+    case Expr::Eq:
+      v = a == b;
+      break;
+    case Expr::Ne:
+      v = a != b;
+      break;
+    case Expr::Ult:
+      v = a < b;
+      break;
+    case Expr::Ule:
+      v = a <= b;
+      break;
+    case Expr::Ugt:
+      v = a > b;
+      break;
+    case Expr::Uge:
+      v = a >= b;
+      break;
+    case Expr::Slt:
+      v = signExtend(a, inst.operandWidth) < signExtend(b, inst.operandWidth);
+      break;
+    case Expr::Sle:
+      v = signExtend(a, inst.operandWidth) <= signExtend(b, inst.operandWidth);
+      break;
+    case Expr::Sgt:
+      v = signExtend(a, inst.operandWidth) > signExtend(b, inst.operandWidth);
+      break;
+    case Expr::Sge:
+      v = signExtend(a, inst.operandWidth) >= signExtend(b, inst.operandWidth);
+      break;
+
+    default:
+      assert(0 && "invalid expression kind");
+    }
+  }
+
+  result = r[code.size() - 1];
+  return true;
+}
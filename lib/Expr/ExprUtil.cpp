@@ -8,10 +8,12 @@
 //===----------------------------------------------------------------------===//
 
 #include "klee/Expr/ExprUtil.h"
+#include "klee/Expr/Constraints.h"
 #include "klee/Expr/Expr.h"
 #include "klee/Expr/ExprHashMap.h"
 #include "klee/Expr/ExprVisitor.h"
 
+#include <map>
 #include <set>
 
 using namespace klee;
@@ -134,6 +136,80 @@ void klee::findSymbolicObjects(ref<Expr> e,
   findSymbolicObjects(&e, &e+1, results);
 }
 
+namespace {
+/// The terms of a linear form by their expressions, which orders them.
+typedef std::map<ref<Expr>, llvm::APInt> LinearTerms;
+
+/// The number of terms a linear form is taken apart into at most, a larger
+/// one is kept as a single term.
+const unsigned MaxLinearTerms = 16;
+
+/// Add coefficient * e to terms and constant, taking e apart. \return false
+/// if there were too many terms
+bool addLinearTerm(const ref<Expr> &e, const llvm::APInt &coefficient,
+                   LinearTerms &terms, llvm::APInt &constant) {
+  if (auto *CE = dyn_cast<ConstantExpr>(e)) {
+    constant += coefficient * CE->getAPValue();
+    return true;
+  }
+  if (auto *add = dyn_cast<AddExpr>(e))
+    return addLinearTerm(add->left, coefficient, terms, constant) &&
+           addLinearTerm(add->right, coefficient, terms, constant);
+  if (auto *mul = dyn_cast<MulExpr>(e)) {
+    if (auto *CE = dyn_cast<ConstantExpr>(mul->left))
+      return addLinearTerm(mul->right, coefficient * CE->getAPValue(), terms,
+                           constant);
+  }
+  auto it = terms.find(e);
+  if (it != terms.end()) {
+    it->second += coefficient;
+    return true;
+  }
+  if (terms.size() == MaxLinearTerms)
+    return false;
+  terms.emplace(e, coefficient);
+  return true;
+}
+} // namespace
+
+ref<Expr> klee::addLinearTerms(
+    ref<Expr> base, const std::vector<std::pair<ref<Expr>, uint64_t>> &terms,
+    uint64_t constant) {
+  Expr::Width width = base->getWidth();
+  llvm::APInt sum(width, constant);
+  LinearTerms linear;
+  bool fits = addLinearTerm(base, llvm::APInt(width, 1), linear, sum);
+  for (const auto &term : terms) {
+    assert(term.first->getWidth() == width && "terms of different widths");
+    if (fits)
+      fits = addLinearTerm(term.first, llvm::APInt(width, term.second),
+                           linear, sum);
+  }
+  if (!fits) {
+    // the terms are added as they are
+    ref<Expr> result = base;
+    for (const auto &term : terms)
+      result = AddExpr::create(
+          result, MulExpr::create(ConstantExpr::alloc(term.second, width),
+                                  term.first));
+    return AddExpr::create(ConstantExpr::alloc(constant, width), result);
+  }
+
+  ref<Expr> result;
+  for (const auto &term : linear) {
+    if (term.second.isNullValue())
+      continue;
+    ref<Expr> scaled =
+        term.second.isOneValue()
+            ? term.first
+            : MulExpr::create(ConstantExpr::alloc(term.second), term.first);
+    result = result.isNull() ? scaled : AddExpr::create(result, scaled);
+  }
+  if (result.isNull())
+    return ConstantExpr::alloc(sum);
+  return AddExpr::create(ConstantExpr::alloc(sum), result);
+}
+
 typedef std::vector< ref<Expr> >::iterator A;
 template void klee::findSymbolicObjects<A>(A, A, std::vector<const Array*> &);
 typedef std::vector< ref<Expr> >::const_iterator CA;
@@ -141,3 +217,6 @@ template void klee::findSymbolicObjects<CA>(CA, CA, std::vector<const Array*> &)
 
 typedef std::set< ref<Expr> >::iterator B;
 template void klee::findSymbolicObjects<B>(B, B, std::vector<const Array*> &);
+
+typedef ConstraintSet::const_iterator C;
+template void klee::findSymbolicObjects<C>(C, C, std::vector<const Array*> &);
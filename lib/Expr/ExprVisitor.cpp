@@ -13,6 +13,9 @@
 
 #include "llvm/Support/CommandLine.h"
 
+#include <algorithm>
+#include <cstdint>
+
 namespace {
 llvm::cl::opt<bool> UseVisitorHash(
     "use-visitor-hash",
@@ -24,6 +27,8 @@ llvm::cl::opt<bool> UseVisitorHash(
 using namespace klee;
 
 ref<Expr> ExprVisitor::visit(const ref<Expr> &e) {
+  if (iterative)
+    return visitIteratively(e);
   if (!UseVisitorHash || isa<ConstantExpr>(e)) {
     return visitActual(e);
   } else {
@@ -39,6 +44,60 @@ ref<Expr> ExprVisitor::visit(const ref<Expr> &e) {
   }
 }
 
+ExprVisitor::Action ExprVisitor::visitKind(const Expr &ep) {
+  switch(ep.getKind()) {
+  case Expr::NotOptimized: return visitNotOptimized(static_cast<const NotOptimizedExpr&>(ep));
+  case Expr::Read: return visitRead(static_cast<const ReadExpr&>(ep));
+  case Expr::Select: return visitSelect(static_cast<const SelectExpr&>(ep));
+  case Expr::Concat: return visitConcat(static_cast<const ConcatExpr&>(ep));
+  case Expr::Extract: return visitExtract(static_cast<const ExtractExpr&>(ep));
+  case Expr::ZExt: return visitZExt(static_cast<const ZExtExpr&>(ep));
+  case Expr::SExt: return visitSExt(static_cast<const SExtExpr&>(ep));
+  case Expr::Add: return visitAdd(static_cast<const AddExpr&>(ep));
+  case Expr::Sub: return visitSub(static_cast<const SubExpr&>(ep));
+  case Expr::Mul: return visitMul(static_cast<const MulExpr&>(ep));
+  case Expr::UDiv: return visitUDiv(static_cast<const UDivExpr&>(ep));
+  case Expr::SDiv: return visitSDiv(static_cast<const SDivExpr&>(ep));
+  case Expr::URem: return visitURem(static_cast<const URemExpr&>(ep));
+  case Expr::SRem: return visitSRem(static_cast<const SRemExpr&>(ep));
+  case Expr::Not: return visitNot(static_cast<const NotExpr&>(ep));
+  case Expr::And: return visitAnd(static_cast<const AndExpr&>(ep));
+  case Expr::Or: return visitOr(static_cast<const OrExpr&>(ep));
+  case Expr::Xor: return visitXor(static_cast<const XorExpr&>(ep));
+  case Expr::Shl: return visitShl(static_cast<const ShlExpr&>(ep));
+  case Expr::LShr: return visitLShr(static_cast<const LShrExpr&>(ep));
+  case Expr::AShr: return visitAShr(static_cast<const AShrExpr&>(ep));
+  case Expr::Eq: return visitEq(static_cast<const EqExpr&>(ep));
+  case Expr::Ne: return visitNe(static_cast<const NeExpr&>(ep));
+  case Expr::Ult: return visitUlt(static_cast<const UltExpr&>(ep));
+  case Expr::Ule: return visitUle(static_cast<const UleExpr&>(ep));
+  case Expr::Ugt: return visitUgt(static_cast<const UgtExpr&>(ep));
+  case Expr::Uge: return visitUge(static_cast<const UgeExpr&>(ep));
+  case Expr::Slt: return visitSlt(static_cast<const SltExpr&>(ep));
+  case Expr::Sle: return visitSle(static_cast<const SleExpr&>(ep));
+  case Expr::Sgt: return visitSgt(static_cast<const SgtExpr&>(ep));
+  case Expr::Sge: return visitSge(static_cast<const SgeExpr&>(ep));
+  case Expr::FAdd: return visitFAdd(static_cast<const FAddExpr&>(ep));
+  case Expr::FSub: return visitFSub(static_cast<const FSubExpr&>(ep));
+  case Expr::FMul: return visitFMul(static_cast<const FMulExpr&>(ep));
+  case Expr::FDiv: return visitFDiv(static_cast<const FDivExpr&>(ep));
+  case Expr::FOEq: return visitFOEq(static_cast<const FOEqExpr&>(ep));
+  case Expr::FOLt: return visitFOLt(static_cast<const FOLtExpr&>(ep));
+  case Expr::FOLe: return visitFOLe(static_cast<const FOLeExpr&>(ep));
+  case Expr::FUno: return visitFUno(static_cast<const FUnoExpr&>(ep));
+  case Expr::FPExt: return visitFPExt(static_cast<const FPExtExpr&>(ep));
+  case Expr::FPTrunc: return visitFPTrunc(static_cast<const FPTruncExpr&>(ep));
+  case Expr::FPToUI: return visitFPToUI(static_cast<const FPToUIExpr&>(ep));
+  case Expr::FPToSI: return visitFPToSI(static_cast<const FPToSIExpr&>(ep));
+  case Expr::UIToFP: return visitUIToFP(static_cast<const UIToFPExpr&>(ep));
+  case Expr::SIToFP: return visitSIToFP(static_cast<const SIToFPExpr&>(ep));
+  case Expr::Constant:
+  default:
+    assert(0 && "invalid expression kind");
+    return Action::doChildren();
+  }
+}
+
 ref<Expr> ExprVisitor::visitActual(const ref<Expr> &e) {
   if (isa<ConstantExpr>(e)) {    
     return e;
@@ -56,42 +115,7 @@ ref<Expr> ExprVisitor::visitActual(const ref<Expr> &e) {
       return res.argument;
     }
 
-    switch(ep.getKind()) {
-    case Expr::NotOptimized: res = visitNotOptimized(static_cast<NotOptimizedExpr&>(ep)); break;
-    case Expr::Read: res = visitRead(static_cast<ReadExpr&>(ep)); break;
-    case Expr::Select: res = visitSelect(static_cast<SelectExpr&>(ep)); break;
-    case Expr::Concat: res = visitConcat(static_cast<ConcatExpr&>(ep)); break;
-    case Expr::Extract: res = visitExtract(static_cast<ExtractExpr&>(ep)); break;
-    case Expr::ZExt: res = visitZExt(static_cast<ZExtExpr&>(ep)); break;
-    case Expr::SExt: res = visitSExt(static_cast<SExtExpr&>(ep)); break;
-    case Expr::Add: res = visitAdd(static_cast<AddExpr&>(ep)); break;
-    case Expr::Sub: res = visitSub(static_cast<SubExpr&>(ep)); break;
-    case Expr::Mul: res = visitMul(static_cast<MulExpr&>(ep)); break;
-    case Expr::UDiv: res = visitUDiv(static_cast<UDivExpr&>(ep)); break;
-    case Expr::SDiv: res = visitSDiv(static_cast<SDivExpr&>(ep)); break;
-    case Expr::URem: res = visitURem(static_cast<URemExpr&>(ep)); break;
-    case Expr::SRem: res = visitSRem(static_cast<SRemExpr&>(ep)); break;
-    case Expr::Not: res = visitNot(static_cast<NotExpr&>(ep)); break;
-    case Expr::And: res = visitAnd(static_cast<AndExpr&>(ep)); break;
-    case Expr::Or: res = visitOr(static_cast<OrExpr&>(ep)); break;
-    case Expr::Xor: res = visitXor(static_cast<XorExpr&>(ep)); break;
-    case Expr::Shl: res = visitShl(static_cast<ShlExpr&>(ep)); break;
-    case Expr::LShr: res = visitLShr(static_cast<LShrExpr&>(ep)); break;
-    case Expr::AShr: res = visitAShr(static_cast<AShrExpr&>(ep)); break;
-    case Expr::Eq: res = visitEq(static_cast<EqExpr&>(ep)); break;
-    case Expr::Ne: res = visitNe(static_cast<NeExpr&>(ep)); break;
-    case Expr::Ult: res = visitUlt(static_cast<UltExpr&>(ep)); break;
-    case Expr::Ule: res = visitUle(static_cast<UleExpr&>(ep)); break;
-    case Expr::Ugt: res = visitUgt(static_cast<UgtExpr&>(ep)); break;
-    case Expr::Uge: res = visitUge(static_cast<UgeExpr&>(ep)); break;
-    case Expr::Slt: res = visitSlt(static_cast<SltExpr&>(ep)); break;
-    case Expr::Sle: res = visitSle(static_cast<SleExpr&>(ep)); break;
-    case Expr::Sgt: res = visitSgt(static_cast<SgtExpr&>(ep)); break;
-    case Expr::Sge: res = visitSge(static_cast<SgeExpr&>(ep)); break;
-    case Expr::Constant:
-    default:
-      assert(0 && "invalid expression kind");
-    }
+    res = visitKind(ep);
 
     switch(res.kind) {
     default:
@@ -126,6 +150,151 @@ ref<Expr> ExprVisitor::visitActual(const ref<Expr> &e) {
   }
 }
 
+/***/
+
+size_t ExprVisitor::VisitMemo::slotOf(const Expr *e) const {
+  uint64_t h = reinterpret_cast<uintptr_t>(e) * 0x9E3779B97F4A7C15ULL;
+  return (h >> 32) & (slots.size() - 1);
+}
+
+const ref<Expr> *ExprVisitor::VisitMemo::find(const ref<Expr> &e) const {
+  if (slots.empty())
+    return nullptr;
+  for (size_t i = slotOf(e.get());; i = (i + 1) & (slots.size() - 1)) {
+    if (slots[i].first.isNull())
+      return nullptr;
+    if (slots[i].first.get() == e.get())
+      return &slots[i].second;
+  }
+}
+
+void ExprVisitor::VisitMemo::insert(const ref<Expr> &e,
+                                    const ref<Expr> &result) {
+  // at most half of the slots are used, so probes stay short
+  if (2 * (used + 1) > slots.size()) {
+    std::vector<std::pair<ref<Expr>, ref<Expr>>> old(
+        std::max<size_t>(64, 2 * slots.size()));
+    old.swap(slots);
+    used = 0;
+    for (auto &slot : old)
+      if (!slot.first.isNull())
+        insert(slot.first, slot.second);
+  }
+  size_t i = slotOf(e.get());
+  while (!slots[i].first.isNull()) {
+    if (slots[i].first.get() == e.get())
+      return;
+    i = (i + 1) & (slots.size() - 1);
+  }
+  slots[i] = std::make_pair(e, result);
+  ++used;
+}
+
+struct ExprVisitor::VisitFrame {
+  enum Phase { Kids, Revisit, Post };
+
+  /// The expression the result is memoized for.
+  ref<Expr> key;
+  /// The expression being rebuilt from the visited children.
+  ref<Expr> e;
+  ref<Expr> kids[8];
+  unsigned next = 0;
+  bool rebuild = false;
+  Phase phase = Kids;
+
+  explicit VisitFrame(const ref<Expr> &e) : key(e), e(e) {}
+};
+
+bool ExprVisitor::enterIteratively(const ref<Expr> &e,
+                                   std::vector<VisitFrame> &stack,
+                                   ref<Expr> &result) {
+  if (isa<ConstantExpr>(e)) {
+    result = e;
+    return true;
+  }
+  if (UseVisitorHash) {
+    if (const ref<Expr> *known = memo.find(e)) {
+      result = *known;
+      return true;
+    }
+  }
+
+  Action res = visitExpr(*e);
+  if (res.kind == Action::DoChildren)
+    res = visitKind(*e);
+  switch (res.kind) {
+  case Action::DoChildren:
+    stack.emplace_back(e);
+    return false;
+  case Action::SkipChildren:
+    result = e;
+    break;
+  case Action::ChangeTo:
+    result = res.argument;
+    break;
+  }
+  if (UseVisitorHash)
+    memo.insert(e, result);
+  return true;
+}
+
+ref<Expr> ExprVisitor::visitIteratively(const ref<Expr> &root) {
+  std::vector<VisitFrame> stack;
+  ref<Expr> result;
+  if (enterIteratively(root, stack, result))
+    return result;
+
+  // hands a result to the frame waiting for it
+  auto deliver = [&stack](const ref<Expr> &result) {
+    VisitFrame &f = stack.back();
+    if (f.phase == VisitFrame::Revisit) {
+      f.e = result;
+      f.phase = VisitFrame::Post;
+      return;
+    }
+    if (result != f.e->getKid(f.next))
+      f.rebuild = true;
+    f.kids[f.next++] = result;
+  };
+
+  for (;;) {
+    VisitFrame &f = stack.back();
+    if (f.phase == VisitFrame::Kids) {
+      if (f.next < f.e->getNumKids()) {
+        ref<Expr> kid = f.e->getKid(f.next);
+        if (enterIteratively(kid, stack, result))
+          deliver(result);
+        continue;
+      }
+      f.phase = VisitFrame::Post;
+      if (f.rebuild) {
+        f.e = f.e->rebuild(f.kids);
+        if (recursive) {
+          f.phase = VisitFrame::Revisit;
+          ref<Expr> e = f.e;
+          if (enterIteratively(e, stack, result))
+            deliver(result);
+        }
+      }
+      continue;
+    }
+
+    assert(f.phase == VisitFrame::Post && "frame still waiting for a result");
+    result = f.e;
+    if (!isa<ConstantExpr>(result)) {
+      Action res = visitExprPost(*result);
+      if (res.kind == Action::ChangeTo)
+        result = res.argument;
+    }
+    if (UseVisitorHash)
+      memo.insert(f.key, result);
+    stack.pop_back();
+    if (stack.empty())
+      return result;
+    deliver(result);
+  }
+}
+
 ExprVisitor::Action ExprVisitor::visitExpr(const Expr&) {
   return Action::doChildren();
 }
@@ -258,3 +427,59 @@ ExprVisitor::Action ExprVisitor::visitSge(const SgeExpr&) {
   return Action::doChildren(); 
 }
 
+ExprVisitor::Action ExprVisitor::visitFAdd(const FAddExpr &) {
+  return Action::doChildren();
+}
+
+ExprVisitor::Action ExprVisitor::visitFSub(const FSubExpr &) {
+  return Action::doChildren();
+}
+
+ExprVisitor::Action ExprVisitor::visitFMul(const FMulExpr &) {
+  return Action::doChildren();
+}
+
+ExprVisitor::Action ExprVisitor::visitFDiv(const FDivExpr &) {
+  return Action::doChildren();
+}
+
+ExprVisitor::Action ExprVisitor::visitFOEq(const FOEqExpr &) {
+  return Action::doChildren();
+}
+
+ExprVisitor::Action ExprVisitor::visitFOLt(const FOLtExpr &) {
+  return Action::doChildren();
+}
+
+ExprVisitor::Action ExprVisitor::visitFOLe(const FOLeExpr &) {
+  return Action::doChildren();
+}
+
+ExprVisitor::Action ExprVisitor::visitFUno(const FUnoExpr &) {
+  return Action::doChildren();
+}
+
+ExprVisitor::Action ExprVisitor::visitFPExt(const FPExtExpr &) {
+  return Action::doChildren();
+}
+
+ExprVisitor::Action ExprVisitor::visitFPTrunc(const FPTruncExpr &) {
+  return Action::doChildren();
+}
+
+ExprVisitor::Action ExprVisitor::visitFPToUI(const FPToUIExpr &) {
+  return Action::doChildren();
+}
+
+ExprVisitor::Action ExprVisitor::visitFPToSI(const FPToSIExpr &) {
+  return Action::doChildren();
+}
+
+ExprVisitor::Action ExprVisitor::visitUIToFP(const UIToFPExpr &) {
+  return Action::doChildren();
+}
+
+ExprVisitor::Action ExprVisitor::visitSIToFP(const SIToFPExpr &) {
+  return Action::doChildren();
+}
+
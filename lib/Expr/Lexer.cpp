@@ -186,11 +186,14 @@ Token &Lexer::SetIdentifierTokenKind(Token &Result) {
 }
 
 void Lexer::SkipToEndOfLine() {
-  for (;;) {
-    int Char = GetNextChar();
-    if (Char == -1 || Char =='\n')
-      break;
-  }
+  // Comments take up most of some query logs, so skip to the newline
+  // without going through GetNextChar for every character.
+  const char *End = BufferPos;
+  while (End != BufferEnd && *End != '\n' && *End != '\r')
+    ++End;
+  ColumnNumber += End - BufferPos;
+  BufferPos = End;
+  GetNextChar();
 }
 
 Token &Lexer::LexNumber(Token &Result) {
@@ -17,11 +17,12 @@
 #include "klee/Solver/Solver.h"
 
 #include "llvm/ADT/APInt.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/StringMap.h"
 #include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/raw_ostream.h"
 
 #include <cassert>
-#include <map>
 #include <cstring>
 
 using namespace llvm;
@@ -101,9 +102,12 @@ namespace {
 
   /// ParserImpl - Parser implementation.
   class ParserImpl : public Parser {
-    typedef std::map<const std::string, const Identifier*> IdentifierTabTy;
-    typedef std::map<const Identifier*, ExprHandle> ExprSymTabTy;
-    typedef std::map<const Identifier*, VersionHandle> VersionSymTabTy;
+    /// Identifiers are interned, so the symbol tables are keyed by their
+    /// addresses and a lookup by name copies no strings.
+    typedef llvm::StringMap<const Identifier*> IdentifierTabTy;
+    typedef llvm::DenseMap<const Identifier*, const ArrayDecl*> ArraySymTabTy;
+    typedef llvm::DenseMap<const Identifier*, ExprHandle> ExprSymTabTy;
+    typedef llvm::DenseMap<const Identifier*, VersionHandle> VersionSymTabTy;
 
     const std::string Filename;
     const MemoryBuffer *TheMemoryBuffer;
@@ -115,10 +119,9 @@ namespace {
     unsigned MaxErrors;
     unsigned NumErrors;
 
-    // FIXME: Use LLVM symbol tables?
     IdentifierTabTy IdentifierTab;
 
-    std::map<const Identifier*, const ArrayDecl*> ArraySymTab;
+    ArraySymTabTy ArraySymTab;
     ExprSymTabTy ExprSymTab;
     VersionSymTabTy VersionSymTab;
 
@@ -352,16 +355,10 @@ namespace {
 }
 
 const Identifier *ParserImpl::GetOrCreateIdentifier(const Token &Tok) {
-  // FIXME: Make not horribly inefficient please.
   assert(Tok.kind == Token::Identifier && "Expected only identifier tokens.");
-  std::string Name(Tok.start, Tok.length);
-  IdentifierTabTy::iterator it = IdentifierTab.find(Name);
-  if (it != IdentifierTab.end())
-    return it->second;
-
-  Identifier *I = new Identifier(Name);
-  IdentifierTab.insert(std::make_pair(Name, I));
-
+  const Identifier *&I = IdentifierTab[Tok.getText()];
+  if (!I)
+    I = new Identifier(Tok.getString());
   return I;
 }
 
@@ -577,7 +574,7 @@ DeclResult ParserImpl::ParseQueryCommand() {
 
   // Reinsert initial array versions.
   // FIXME: Remove this!
-  for (std::map<const Identifier*, const ArrayDecl*>::iterator
+  for (ArraySymTabTy::iterator
          it = ArraySymTab.begin(), ie = ArraySymTab.end(); it != ie; ++it) {
     VersionSymTab.insert(std::make_pair(it->second->Name,
                                         UpdateList(it->second->Root, NULL)));
@@ -664,8 +661,7 @@ DeclResult ParserImpl::ParseQueryCommand() {
     ConsumeToken();
 
     // Lookup array.
-    std::map<const Identifier*, const ArrayDecl*>::iterator
-      it = ArraySymTab.find(Label);
+    ArraySymTabTy::iterator it = ArraySymTab.find(Label);
 
     if (it == ArraySymTab.end()) {
       Error("unknown array", LTok);
@@ -1471,10 +1467,13 @@ ExprResult ParserImpl::ParseNumberToken(Expr::Width Type, const Token &Tok) {
     }
   }
 
-  // This is a simple but slow way to handle overflow.
+  // This is a simple but slow way to handle overflow. The digits of most
+  // numbers fit a word, which needs no allocations.
   APInt Val(RadixBits * N, 0);
   APInt RadixVal(Val.getBitWidth(), Radix);
   APInt DigitVal(Val.getBitWidth(), 0);
+  bool Small = Val.getBitWidth() <= 64;
+  uint64_t SmallVal = 0;
   for (unsigned i=0; i<N; ++i) {
     unsigned Digit, Char = S[i];
     
@@ -1497,9 +1496,15 @@ ExprResult ParserImpl::ParseNumberToken(Expr::Width Type, const Token &Tok) {
       return Builder->Constant(0, Type);
     }
 
+    if (Small) {
+      SmallVal = SmallVal * Radix + Digit;
+      continue;
+    }
     DigitVal = Digit;
     Val = Val * RadixVal + DigitVal;
   }
+  if (Small)
+    Val = APInt(Val.getBitWidth(), SmallVal);
 
   // FIXME: Actually do the check for overflow.
   if (HasMinus)
@@ -1520,7 +1525,8 @@ TypeResult ParserImpl::ParseTypeSpecifier() {
   assert(Tok.kind == Token::KWWidth && "Unexpected token.");
 
   // FIXME: Need APInt technically.
-  int width = atoi(std::string(Tok.start+1,Tok.length-1).c_str());
+  int width = 0;
+  Tok.getText().drop_front().getAsInteger(10, width);
   ConsumeToken();
 
   // FIXME: We should impose some sort of maximum just for sanity?
@@ -1569,33 +1575,12 @@ void ParserImpl::Error(const char *Message, const Token &At) {
 }
 
 ParserImpl::~ParserImpl() {
-  // Free identifiers
-  //
-  // Note the Identifiers are not disjoint across the symbol
-  // tables so we need to keep track of what has freed to
-  // avoid doing a double free.
-  std::set<const Identifier*> freedNodes;
+  // Free identifiers, which are all created by GetOrCreateIdentifier and
+  // only referred to by the symbol tables.
   for (IdentifierTabTy::iterator pi = IdentifierTab.begin(),
                                  pe = IdentifierTab.end();
-       pi != pe; ++pi) {
-    const Identifier* id = pi->second;
-    if (freedNodes.insert(id).second)
-      delete id;
-  }
-  for (ExprSymTabTy::iterator pi = ExprSymTab.begin(),
-                              pe = ExprSymTab.end();
-       pi != pe; ++pi) {
-    const Identifier* id = pi->first;
-    if (freedNodes.insert(id).second)
-      delete id;
-  }
-  for (VersionSymTabTy::iterator pi = VersionSymTab.begin(),
-                                 pe = VersionSymTab.end();
-       pi != pe; ++pi) {
-    const Identifier* id = pi->first;
-    if (freedNodes.insert(id).second)
-      delete id;
-  }
+       pi != pe; ++pi)
+    delete pi->second;
 }
 
 // AST API
@@ -1615,7 +1600,7 @@ void ArrayDecl::dump() {
     for (unsigned i = 0, e = Root->size; i != e; ++i) {
       if (i)
         llvm::outs() << " ";
-      llvm::outs() << Root->constantValues[i];
+      llvm::outs() << Root->getConstantValue(i);
     }
     llvm::outs() << "]\n";
   }
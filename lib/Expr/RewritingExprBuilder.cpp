@@ -0,0 +1,620 @@
+//===-- RewritingExprBuilder.cpp ------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Expr/ExprBuilder.h"
+
+#include <vector>
+
+using namespace klee;
+
+namespace {
+  /// Operands - The arguments of an expression construction call.
+  struct Operands {
+    Expr::Kind Kind;
+    ref<Expr> Kids[3];
+    /// The offset of an Extract.
+    unsigned Offset;
+    /// The width of an Extract, ZExt or SExt.
+    Expr::Width Width;
+
+    Operands(Expr::Kind _Kind, const ref<Expr> &A,
+             const ref<Expr> &B = ref<Expr>(),
+             const ref<Expr> &C = ref<Expr>())
+      : Kind(_Kind), Kids{A, B, C}, Offset(0), Width(0) {}
+  };
+
+  /// RewriteRule - A rewrite of the expressions of one kind. Apply returns
+  /// null if the rule does not match, and builds the rewritten expression
+  /// with the builder passed to it otherwise, so that further rules apply
+  /// to it.
+  struct RewriteRule {
+    Expr::Kind Kind;
+    const char *Name;
+    ref<Expr> (*Apply)(ExprBuilder &B, const Operands &Ops);
+  };
+
+  bool isZero(const ref<Expr> &E) {
+    const ConstantExpr *CE = dyn_cast<ConstantExpr>(E);
+    return CE && CE->isZero();
+  }
+
+  bool isOne(const ref<Expr> &E) {
+    const ConstantExpr *CE = dyn_cast<ConstantExpr>(E);
+    return CE && CE->getAPValue().isOneValue();
+  }
+
+  bool isAllOnes(const ref<Expr> &E) {
+    const ConstantExpr *CE = dyn_cast<ConstantExpr>(E);
+    return CE && CE->isAllOnes();
+  }
+
+  ref<Expr> zero(ExprBuilder &B, Expr::Width W) {
+    return B.Constant(0, W);
+  }
+
+  // Algebraic identities
+
+  ref<Expr> addZero(ExprBuilder &, const Operands &Ops) {
+    // 0 + X ==> X, X + 0 ==> X
+    if (isZero(Ops.Kids[0]))
+      return Ops.Kids[1];
+    if (isZero(Ops.Kids[1]))
+      return Ops.Kids[0];
+    return nullptr;
+  }
+
+  ref<Expr> subZero(ExprBuilder &, const Operands &Ops) {
+    // X - 0 ==> X
+    return isZero(Ops.Kids[1]) ? Ops.Kids[0] : nullptr;
+  }
+
+  ref<Expr> subSelf(ExprBuilder &B, const Operands &Ops) {
+    // X - X ==> 0
+    if (Ops.Kids[0] == Ops.Kids[1])
+      return zero(B, Ops.Kids[0]->getWidth());
+    return nullptr;
+  }
+
+  ref<Expr> mulZero(ExprBuilder &B, const Operands &Ops) {
+    // 0 * X ==> 0, X * 0 ==> 0
+    if (isZero(Ops.Kids[0]) || isZero(Ops.Kids[1]))
+      return zero(B, Ops.Kids[0]->getWidth());
+    return nullptr;
+  }
+
+  ref<Expr> mulOne(ExprBuilder &, const Operands &Ops) {
+    // 1 * X ==> X, X * 1 ==> X
+    if (isOne(Ops.Kids[0]))
+      return Ops.Kids[1];
+    if (isOne(Ops.Kids[1]))
+      return Ops.Kids[0];
+    return nullptr;
+  }
+
+  ref<Expr> divOne(ExprBuilder &, const Operands &Ops) {
+    // X / 1 ==> X
+    return isOne(Ops.Kids[1]) ? Ops.Kids[0] : nullptr;
+  }
+
+  ref<Expr> remOne(ExprBuilder &B, const Operands &Ops) {
+    // X % 1 ==> 0
+    if (isOne(Ops.Kids[1]))
+      return zero(B, Ops.Kids[0]->getWidth());
+    return nullptr;
+  }
+
+  ref<Expr> andConstant(ExprBuilder &, const Operands &Ops) {
+    // 0 & X ==> 0, ~0 & X ==> X, and the same with the operands swapped
+    for (unsigned i = 0; i != 2; ++i) {
+      if (isZero(Ops.Kids[i]))
+        return Ops.Kids[i];
+      if (isAllOnes(Ops.Kids[i]))
+        return Ops.Kids[1 - i];
+    }
+    return nullptr;
+  }
+
+  ref<Expr> orConstant(ExprBuilder &, const Operands &Ops) {
+    // 0 | X ==> X, ~0 | X ==> ~0, and the same with the operands swapped
+    for (unsigned i = 0; i != 2; ++i) {
+      if (isZero(Ops.Kids[i]))
+        return Ops.Kids[1 - i];
+      if (isAllOnes(Ops.Kids[i]))
+        return Ops.Kids[i];
+    }
+    return nullptr;
+  }
+
+  ref<Expr> idempotent(ExprBuilder &, const Operands &Ops) {
+    // X & X ==> X, X | X ==> X
+    return Ops.Kids[0] == Ops.Kids[1] ? Ops.Kids[0] : nullptr;
+  }
+
+  ref<Expr> xorZero(ExprBuilder &, const Operands &Ops) {
+    // 0 ^ X ==> X, X ^ 0 ==> X
+    if (isZero(Ops.Kids[0]))
+      return Ops.Kids[1];
+    if (isZero(Ops.Kids[1]))
+      return Ops.Kids[0];
+    return nullptr;
+  }
+
+  ref<Expr> xorSelf(ExprBuilder &B, const Operands &Ops) {
+    // X ^ X ==> 0
+    if (Ops.Kids[0] == Ops.Kids[1])
+      return zero(B, Ops.Kids[0]->getWidth());
+    return nullptr;
+  }
+
+  ref<Expr> shiftZero(ExprBuilder &, const Operands &Ops) {
+    // X << 0 ==> X, 0 << Y ==> 0, and the same for the right shifts
+    if (isZero(Ops.Kids[1]) || isZero(Ops.Kids[0]))
+      return Ops.Kids[0];
+    return nullptr;
+  }
+
+  ref<Expr> notNot(ExprBuilder &, const Operands &Ops) {
+    // ~~X ==> X
+    if (const NotExpr *NE = dyn_cast<NotExpr>(Ops.Kids[0]))
+      return NE->expr;
+    return nullptr;
+  }
+
+  ref<Expr> selectConstant(ExprBuilder &, const Operands &Ops) {
+    // (Select true X Y) ==> X, (Select false X Y) ==> Y
+    if (const ConstantExpr *CE = dyn_cast<ConstantExpr>(Ops.Kids[0]))
+      return CE->isTrue() ? Ops.Kids[1] : Ops.Kids[2];
+    return nullptr;
+  }
+
+  ref<Expr> selectSame(ExprBuilder &, const Operands &Ops) {
+    // (Select C X X) ==> X
+    return Ops.Kids[1] == Ops.Kids[2] ? Ops.Kids[1] : nullptr;
+  }
+
+  ref<Expr> selectBool(ExprBuilder &, const Operands &Ops) {
+    // (Select C true false) ==> C
+    if (Ops.Kids[1]->getWidth() == Expr::Bool && Ops.Kids[1]->isTrue() &&
+        Ops.Kids[2]->isFalse())
+      return Ops.Kids[0];
+    return nullptr;
+  }
+
+  ref<Expr> extendSameWidth(ExprBuilder &, const Operands &Ops) {
+    // (ZExt w X) ==> X and (SExt w X) ==> X if X has width w
+    return Ops.Kids[0]->getWidth() == Ops.Width ? Ops.Kids[0] : nullptr;
+  }
+
+  ref<Expr> extendExtend(ExprBuilder &B, const Operands &Ops) {
+    // (ZExt w (ZExt X)) ==> (ZExt w X), the same for SExt
+    const Expr *E = Ops.Kids[0].get();
+    if (E->getKind() != Ops.Kind)
+      return nullptr;
+    if (Ops.Kind == Expr::ZExt)
+      return B.ZExt(E->getKid(0), Ops.Width);
+    return B.SExt(E->getKid(0), Ops.Width);
+  }
+
+  // Bit ranges
+
+  ref<Expr> extractAll(ExprBuilder &, const Operands &Ops) {
+    // (Extract 0 w X) ==> X if X has width w
+    if (Ops.Offset == 0 && Ops.Kids[0]->getWidth() == Ops.Width)
+      return Ops.Kids[0];
+    return nullptr;
+  }
+
+  ref<Expr> extractExtract(ExprBuilder &B, const Operands &Ops) {
+    // (Extract o w (Extract p v X)) ==> (Extract o+p w X)
+    if (const ExtractExpr *EE = dyn_cast<ExtractExpr>(Ops.Kids[0]))
+      return B.Extract(EE->expr, EE->offset + Ops.Offset, Ops.Width);
+    return nullptr;
+  }
+
+  ref<Expr> extractConcat(ExprBuilder &B, const Operands &Ops) {
+    // take the bits from the side of the concatenation they are in
+    const ConcatExpr *CE = dyn_cast<ConcatExpr>(Ops.Kids[0]);
+    if (!CE)
+      return nullptr;
+    const ref<Expr> &High = CE->getLeft(), &Low = CE->getRight();
+    Expr::Width LowWidth = Low->getWidth();
+    if (Ops.Offset + Ops.Width <= LowWidth)
+      return B.Extract(Low, Ops.Offset, Ops.Width);
+    if (Ops.Offset >= LowWidth)
+      return B.Extract(High, Ops.Offset - LowWidth, Ops.Width);
+    return B.Concat(B.Extract(High, 0, Ops.Offset + Ops.Width - LowWidth),
+                    B.Extract(Low, Ops.Offset, LowWidth - Ops.Offset));
+  }
+
+  ref<Expr> extractZExt(ExprBuilder &B, const Operands &Ops) {
+    // the bits above the extended expression are zero
+    const ZExtExpr *ZE = dyn_cast<ZExtExpr>(Ops.Kids[0]);
+    if (!ZE)
+      return nullptr;
+    Expr::Width Width = ZE->src->getWidth();
+    if (Ops.Offset + Ops.Width <= Width)
+      return B.Extract(ZE->src, Ops.Offset, Ops.Width);
+    if (Ops.Offset >= Width)
+      return zero(B, Ops.Width);
+    return B.ZExt(B.Extract(ZE->src, Ops.Offset, Width - Ops.Offset),
+                  Ops.Width);
+  }
+
+  ref<Expr> concatExtracts(ExprBuilder &B, const Operands &Ops) {
+    // (Concat (Extract o+v w X) (Extract o v X)) ==> (Extract o w+v X)
+    const ExtractExpr *High = dyn_cast<ExtractExpr>(Ops.Kids[0]);
+    const ExtractExpr *Low = dyn_cast<ExtractExpr>(Ops.Kids[1]);
+    if (!High || !Low || High->offset != Low->offset + Low->width ||
+        High->expr != Low->expr)
+      return nullptr;
+    return B.Extract(Low->expr, Low->offset, High->width + Low->width);
+  }
+
+  // Comparisons
+
+  ref<Expr> neToEq(ExprBuilder &B, const Operands &Ops) {
+    // X != Y ==> false == (X == Y)
+    return B.Eq(B.False(), B.Eq(Ops.Kids[0], Ops.Kids[1]));
+  }
+
+  ref<Expr> swapGreater(ExprBuilder &B, const Operands &Ops) {
+    // X > Y ==> Y < X and X >= Y ==> Y <= X
+    const ref<Expr> &L = Ops.Kids[0], &R = Ops.Kids[1];
+    switch (Ops.Kind) {
+    case Expr::Ugt: return B.Ult(R, L);
+    case Expr::Uge: return B.Ule(R, L);
+    case Expr::Sgt: return B.Slt(R, L);
+    case Expr::Sge: return B.Sle(R, L);
+    default: return nullptr;
+    }
+  }
+
+  ref<Expr> compareSelf(ExprBuilder &B, const Operands &Ops) {
+    // X == X, X <= X ==> true and X < X ==> false
+    if (Ops.Kids[0] != Ops.Kids[1])
+      return nullptr;
+    return Ops.Kind == Expr::Ult || Ops.Kind == Expr::Slt ? B.False()
+                                                          : B.True();
+  }
+
+  ref<Expr> eqConstantLeft(ExprBuilder &B, const Operands &Ops) {
+    // X == C ==> C == X, the canonical form
+    if (isa<ConstantExpr>(Ops.Kids[1]) && !isa<ConstantExpr>(Ops.Kids[0]))
+      return B.Eq(Ops.Kids[1], Ops.Kids[0]);
+    return nullptr;
+  }
+
+  ref<Expr> eqTrue(ExprBuilder &, const Operands &Ops) {
+    // true == X ==> X
+    if (Ops.Kids[0]->getWidth() == Expr::Bool && Ops.Kids[0]->isTrue())
+      return Ops.Kids[1];
+    return nullptr;
+  }
+
+  ref<Expr> eqZExt(ExprBuilder &B, const Operands &Ops) {
+    // C == (ZExt X) ==> trunc(C) == X if C fits X, false otherwise
+    const ConstantExpr *CE = dyn_cast<ConstantExpr>(Ops.Kids[0]);
+    const ZExtExpr *ZE = dyn_cast<ZExtExpr>(Ops.Kids[1]);
+    if (!CE || !ZE)
+      return nullptr;
+    Expr::Width Width = ZE->src->getWidth();
+    if (CE->getAPValue().getActiveBits() > Width)
+      return B.False();
+    return B.Eq(B.Constant(CE->getAPValue().trunc(Width)), ZE->src);
+  }
+
+  ref<Expr> eqAddConstant(ExprBuilder &B, const Operands &Ops) {
+    // C == (C' + X) ==> C - C' == X
+    const ConstantExpr *CE = dyn_cast<ConstantExpr>(Ops.Kids[0]);
+    const AddExpr *AE = dyn_cast<AddExpr>(Ops.Kids[1]);
+    if (!CE || !AE)
+      return nullptr;
+    const ConstantExpr *Addend = dyn_cast<ConstantExpr>(AE->left);
+    if (!Addend)
+      return nullptr;
+    return B.Eq(B.Constant(CE->getAPValue() - Addend->getAPValue()),
+                AE->right);
+  }
+
+  ref<Expr> unsignedBound(ExprBuilder &B, const Operands &Ops) {
+    // X u< 0 ==> false, 0 u<= X ==> true
+    if (Ops.Kind == Expr::Ult && isZero(Ops.Kids[1]))
+      return B.False();
+    if (Ops.Kind == Expr::Ule && isZero(Ops.Kids[0]))
+      return B.True();
+    return nullptr;
+  }
+
+  const RewriteRule Rules[] = {
+    {Expr::Add, "add-zero", addZero},
+    {Expr::Sub, "sub-zero", subZero},
+    {Expr::Sub, "sub-self", subSelf},
+    {Expr::Mul, "mul-zero", mulZero},
+    {Expr::Mul, "mul-one", mulOne},
+    {Expr::UDiv, "div-one", divOne},
+    {Expr::SDiv, "div-one", divOne},
+    {Expr::URem, "rem-one", remOne},
+    {Expr::SRem, "rem-one", remOne},
+    {Expr::And, "and-constant", andConstant},
+    {Expr::And, "and-self", idempotent},
+    {Expr::Or, "or-constant", orConstant},
+    {Expr::Or, "or-self", idempotent},
+    {Expr::Xor, "xor-zero", xorZero},
+    {Expr::Xor, "xor-self", xorSelf},
+    {Expr::Shl, "shift-zero", shiftZero},
+    {Expr::LShr, "shift-zero", shiftZero},
+    {Expr::AShr, "shift-zero", shiftZero},
+    {Expr::Not, "not-not", notNot},
+    {Expr::Select, "select-constant", selectConstant},
+    {Expr::Select, "select-same", selectSame},
+    {Expr::Select, "select-bool", selectBool},
+    {Expr::ZExt, "extend-same-width", extendSameWidth},
+    {Expr::ZExt, "extend-extend", extendExtend},
+    {Expr::SExt, "extend-same-width", extendSameWidth},
+    {Expr::SExt, "extend-extend", extendExtend},
+
+    {Expr::Extract, "extract-all", extractAll},
+    {Expr::Extract, "extract-extract", extractExtract},
+    {Expr::Extract, "extract-concat", extractConcat},
+    {Expr::Extract, "extract-zext", extractZExt},
+    {Expr::Concat, "concat-extracts", concatExtracts},
+
+    {Expr::Ne, "ne-to-eq", neToEq},
+    {Expr::Ugt, "swap-greater", swapGreater},
+    {Expr::Uge, "swap-greater", swapGreater},
+    {Expr::Sgt, "swap-greater", swapGreater},
+    {Expr::Sge, "swap-greater", swapGreater},
+    {Expr::Eq, "compare-self", compareSelf},
+    {Expr::Ult, "compare-self", compareSelf},
+    {Expr::Ule, "compare-self", compareSelf},
+    {Expr::Slt, "compare-self", compareSelf},
+    {Expr::Sle, "compare-self", compareSelf},
+    {Expr::Eq, "eq-constant-left", eqConstantLeft},
+    {Expr::Eq, "eq-true", eqTrue},
+    {Expr::Eq, "eq-zext", eqZExt},
+    {Expr::Eq, "eq-add-constant", eqAddConstant},
+    {Expr::Ult, "unsigned-bound", unsignedBound},
+    {Expr::Ule, "unsigned-bound", unsignedBound},
+  };
+
+  /// RewritingExprBuilder - Applies the first matching rule of Rules to
+  /// every expression built, and builds it with the base builder if none
+  /// matches.
+  class RewritingExprBuilder : public ExprBuilder {
+    ExprBuilder *Base;
+    std::vector<const RewriteRule *> RulesByKind[Expr::LastKind + 1];
+
+    ref<Expr> rewrite(const Operands &Ops) {
+      for (const RewriteRule *Rule : RulesByKind[Ops.Kind])
+        if (ref<Expr> Result = Rule->Apply(*this, Ops))
+          return Result;
+      return build(Ops);
+    }
+
+    ref<Expr> build(const Operands &Ops) {
+      const ref<Expr> &L = Ops.Kids[0], &R = Ops.Kids[1];
+      switch (Ops.Kind) {
+      case Expr::Select: return Base->Select(L, R, Ops.Kids[2]);
+      case Expr::Concat: return Base->Concat(L, R);
+      case Expr::Extract: return Base->Extract(L, Ops.Offset, Ops.Width);
+      case Expr::ZExt: return Base->ZExt(L, Ops.Width);
+      case Expr::SExt: return Base->SExt(L, Ops.Width);
+      case Expr::Not: return Base->Not(L);
+      case Expr::Add: return Base->Add(L, R);
+      case Expr::Sub: return Base->Sub(L, R);
+      case Expr::Mul: return Base->Mul(L, R);
+      case Expr::UDiv: return Base->UDiv(L, R);
+      case Expr::SDiv: return Base->SDiv(L, R);
+      case Expr::URem: return Base->URem(L, R);
+      case Expr::SRem: return Base->SRem(L, R);
+      case Expr::And: return Base->And(L, R);
+      case Expr::Or: return Base->Or(L, R);
+      case Expr::Xor: return Base->Xor(L, R);
+      case Expr::Shl: return Base->Shl(L, R);
+      case Expr::LShr: return Base->LShr(L, R);
+      case Expr::AShr: return Base->AShr(L, R);
+      case Expr::Eq: return Base->Eq(L, R);
+      case Expr::Ne: return Base->Ne(L, R);
+      case Expr::Ult: return Base->Ult(L, R);
+      case Expr::Ule: return Base->Ule(L, R);
+      case Expr::Ugt: return Base->Ugt(L, R);
+      case Expr::Uge: return Base->Uge(L, R);
+      case Expr::Slt: return Base->Slt(L, R);
+      case Expr::Sle: return Base->Sle(L, R);
+      case Expr::Sgt: return Base->Sgt(L, R);
+      case Expr::Sge: return Base->Sge(L, R);
+      default:
+        assert(0 && "Unexpected expression kind.");
+        return nullptr;
+      }
+    }
+
+    ref<Expr> rewrite(Expr::Kind Kind, const ref<Expr> &LHS,
+                      const ref<Expr> &RHS) {
+      return rewrite(Operands(Kind, LHS, RHS));
+    }
+
+    ref<Expr> rewrite(Expr::Kind Kind, const ref<Expr> &LHS, unsigned Offset,
+                      Expr::Width W) {
+      Operands Ops(Kind, LHS);
+      Ops.Offset = Offset;
+      Ops.Width = W;
+      return rewrite(Ops);
+    }
+
+  public:
+    RewritingExprBuilder(ExprBuilder *_Base) : Base(_Base) {
+      for (const RewriteRule &Rule : Rules)
+        RulesByKind[Rule.Kind].push_back(&Rule);
+    }
+    ~RewritingExprBuilder() { delete Base; }
+
+    virtual ref<Expr> Constant(const llvm::APInt &Value) {
+      return Base->Constant(Value);
+    }
+
+    virtual ref<Expr> NotOptimized(const ref<Expr> &Index) {
+      return Base->NotOptimized(Index);
+    }
+
+    virtual ref<Expr> Read(const UpdateList &Updates,
+                           const ref<Expr> &Index) {
+      return Base->Read(Updates, Index);
+    }
+
+    virtual ref<Expr> Select(const ref<Expr> &Cond,
+                             const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      return rewrite(Operands(Expr::Select, Cond, LHS, RHS));
+    }
+
+    virtual ref<Expr> Concat(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      return rewrite(Expr::Concat, LHS, RHS);
+    }
+
+    virtual ref<Expr> Extract(const ref<Expr> &LHS,
+                              unsigned Offset, Expr::Width W) {
+      return rewrite(Expr::Extract, LHS, Offset, W);
+    }
+
+    virtual ref<Expr> ZExt(const ref<Expr> &LHS, Expr::Width W) {
+      return rewrite(Expr::ZExt, LHS, 0, W);
+    }
+
+    virtual ref<Expr> SExt(const ref<Expr> &LHS, Expr::Width W) {
+      return rewrite(Expr::SExt, LHS, 0, W);
+    }
+
+    virtual ref<Expr> Not(const ref<Expr> &LHS) {
+      return rewrite(Operands(Expr::Not, LHS));
+    }
+
+#define REWRITE_BINARY(Kind)                                                 \
+    virtual ref<Expr> Kind(const ref<Expr> &LHS, const ref<Expr> &RHS) {     \
+      return rewrite(Expr::Kind, LHS, RHS);                                  \
+    }
+    REWRITE_BINARY(Add)
+    REWRITE_BINARY(Sub)
+    REWRITE_BINARY(Mul)
+    REWRITE_BINARY(UDiv)
+    REWRITE_BINARY(SDiv)
+    REWRITE_BINARY(URem)
+    REWRITE_BINARY(SRem)
+    REWRITE_BINARY(And)
+    REWRITE_BINARY(Or)
+    REWRITE_BINARY(Xor)
+    REWRITE_BINARY(Shl)
+    REWRITE_BINARY(LShr)
+    REWRITE_BINARY(AShr)
+    REWRITE_BINARY(Eq)
+    REWRITE_BINARY(Ne)
+    REWRITE_BINARY(Ult)
+    REWRITE_BINARY(Ule)
+    REWRITE_BINARY(Ugt)
+    REWRITE_BINARY(Uge)
+    REWRITE_BINARY(Slt)
+    REWRITE_BINARY(Sle)
+    REWRITE_BINARY(Sgt)
+    REWRITE_BINARY(Sge)
+#undef REWRITE_BINARY
+  };
+}
+
+ExprBuilder *klee::createRewritingExprBuilder(ExprBuilder *Base) {
+  return new RewritingExprBuilder(Base);
+}
+
+ExprRebuilder::ExprRebuilder(ExprBuilder *_Builder, unsigned _MaxCacheSize)
+  : Builder(_Builder), MaxCacheSize(_MaxCacheSize) {}
+
+ExprRebuilder::~ExprRebuilder() {}
+
+ref<Expr> ExprRebuilder::rebuild(const ref<Expr> &E) {
+  if (isa<ConstantExpr>(E))
+    return E;
+  ExprHashMap<ref<Expr>>::iterator It = Cache.find(E);
+  if (It != Cache.end())
+    return It->second;
+
+  ref<Expr> Kids[3];
+  for (unsigned i = 0, e = E->getNumKids(); i != e; ++i)
+    Kids[i] = rebuild(E->getKid(i));
+
+  ref<Expr> Result;
+  switch (E->getKind()) {
+  case Expr::NotOptimized:
+    Result = Builder->NotOptimized(Kids[0]);
+    break;
+  case Expr::Read:
+    Result = Builder->Read(cast<ReadExpr>(E)->updates, Kids[0]);
+    break;
+  case Expr::Select:
+    Result = Builder->Select(Kids[0], Kids[1], Kids[2]);
+    break;
+  case Expr::Concat:
+    Result = Builder->Concat(Kids[0], Kids[1]);
+    break;
+  case Expr::Extract:
+    Result = Builder->Extract(Kids[0], cast<ExtractExpr>(E)->offset,
+                              E->getWidth());
+    break;
+  case Expr::ZExt:
+    Result = Builder->ZExt(Kids[0], E->getWidth());
+    break;
+  case Expr::SExt:
+    Result = Builder->SExt(Kids[0], E->getWidth());
+    break;
+  case Expr::Not:
+    Result = Builder->Not(Kids[0]);
+    break;
+#define REBUILD_BINARY(Kind)                                                 \
+  case Expr::Kind:                                                           \
+    Result = Builder->Kind(Kids[0], Kids[1]);                                \
+    break;
+  REBUILD_BINARY(Add)
+  REBUILD_BINARY(Sub)
+  REBUILD_BINARY(Mul)
+  REBUILD_BINARY(UDiv)
+  REBUILD_BINARY(SDiv)
+  REBUILD_BINARY(URem)
+  REBUILD_BINARY(SRem)
+  REBUILD_BINARY(And)
+  REBUILD_BINARY(Or)
+  REBUILD_BINARY(Xor)
+  REBUILD_BINARY(Shl)
+  REBUILD_BINARY(LShr)
+  REBUILD_BINARY(AShr)
+  REBUILD_BINARY(Eq)
+  REBUILD_BINARY(Ne)
+  REBUILD_BINARY(Ult)
+  REBUILD_BINARY(Ule)
+  REBUILD_BINARY(Ugt)
+  REBUILD_BINARY(Uge)
+  REBUILD_BINARY(Slt)
+  REBUILD_BINARY(Sle)
+  REBUILD_BINARY(Sgt)
+  REBUILD_BINARY(Sge)
+#undef REBUILD_BINARY
+  default:
+    // the builders have no floating-point operations
+    if (Expr::FPKindFirst <= E->getKind() && E->getKind() <= Expr::FPKindLast) {
+      Result = E->rebuild(Kids);
+      break;
+    }
+    assert(0 && "Unexpected expression kind.");
+    return E;
+  }
+
+  // keep sharing the original nodes where nothing was rewritten
+  if (Result == E)
+    Result = E;
+  if (Cache.size() >= MaxCacheSize)
+    Cache.clear();
+  Cache.insert(std::make_pair(E, Result));
+  return Result;
+}
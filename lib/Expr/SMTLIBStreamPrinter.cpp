@@ -0,0 +1,521 @@
+//===-- SMTLIBStreamPrinter.cpp -------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Expr/SMTLIBStreamPrinter.h"
+
+#include "klee/Solver/Solver.h"
+#include "klee/Support/Casting.h"
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <limits>
+
+using namespace klee;
+
+SMTLIBStreamPrinter::SMTLIBStreamPrinter(bool incremental)
+    : incremental(incremental) {
+  buffer.reserve(1 << 16);
+}
+
+void SMTLIBStreamPrinter::appendNumber(uint64_t value) {
+  char digits[20];
+  char *end = digits + sizeof(digits), *p = end;
+  do {
+    *--p = '0' + value % 10;
+    value /= 10;
+  } while (value);
+  buffer.append(p, end);
+}
+
+void SMTLIBStreamPrinter::appendIndex(unsigned index, const Array *array) {
+  append("(_ bv");
+  appendNumber(index);
+  buffer += ' ';
+  appendNumber(array->getDomain());
+  buffer += ')';
+}
+
+SMTLIBStreamPrinter::Sort SMTLIBStreamPrinter::getSort(const Expr *e) {
+  switch (e->getKind()) {
+  case Expr::NotOptimized:
+    return getSort(e->getKid(0).get());
+
+  case Expr::Eq:
+  case Expr::Ne:
+  case Expr::Slt:
+  case Expr::Sle:
+  case Expr::Sgt:
+  case Expr::Sge:
+  case Expr::Ult:
+  case Expr::Ule:
+  case Expr::Ugt:
+  case Expr::Uge:
+    return SORT_BOOL;
+
+  // as for ExprSMTLIBPrinter, these are bools if they are one bit wide
+  case Expr::Constant:
+  case Expr::And:
+  case Expr::Not:
+  case Expr::Or:
+  case Expr::Xor:
+    return e->getWidth() == Expr::Bool ? SORT_BOOL : SORT_BITVECTOR;
+
+  default:
+    return SORT_BITVECTOR;
+  }
+}
+
+void SMTLIBStreamPrinter::printSort(const Expr *e) {
+  if (getSort(e) == SORT_BOOL) {
+    append("Bool");
+    return;
+  }
+  append("(_ BitVec ");
+  appendNumber(e->getWidth());
+  buffer += ')';
+}
+
+void SMTLIBStreamPrinter::countUses(const ref<Expr> &root) {
+  std::vector<ref<Expr>> stack(1, root);
+  while (!stack.empty()) {
+    ref<Expr> e = stack.back();
+    stack.pop_back();
+    if (isa<ConstantExpr>(e) || termIds.count(e) || ++uses[e] > 1)
+      continue;
+
+    for (unsigned i = 0, n = e->getNumKids(); i != n; ++i)
+      stack.push_back(e->getKid(i));
+    // the updates are defined once, so their expressions are used once
+    if (const ReadExpr *re = dyn_cast<ReadExpr>(e)) {
+      for (UpdateList ul = re->updates;
+           ul.head && countedUpdates.insert(ul.head.get()).second &&
+           !updateIds.count(ul);
+           ul.head = ul.head->next) {
+        stack.push_back(ul.head->index);
+        stack.push_back(ul.head->value);
+      }
+    }
+  }
+}
+
+void SMTLIBStreamPrinter::defineTerms(const ref<Expr> &root, bool defineRoot) {
+  // expressions with whether the nodes they depend on were pushed
+  std::vector<std::pair<ref<Expr>, bool>> stack;
+  stack.emplace_back(root, false);
+  while (!stack.empty()) {
+    ref<Expr> e = stack.back().first;
+    auto it = uses.find(e);
+    // constants, defined terms and expressions already printed
+    if (it == uses.end()) {
+      stack.pop_back();
+      continue;
+    }
+
+    if (!stack.back().second) {
+      stack.back().second = true;
+      for (unsigned i = 0, n = e->getNumKids(); i != n; ++i)
+        stack.emplace_back(e->getKid(i), false);
+      if (const ReadExpr *re = dyn_cast<ReadExpr>(e)) {
+        for (UpdateList ul = re->updates; ul.head && !updateIds.count(ul);
+             ul.head = ul.head->next) {
+          stack.emplace_back(ul.head->index, false);
+          stack.emplace_back(ul.head->value, false);
+        }
+      }
+      continue;
+    }
+
+    stack.pop_back();
+    bool shared = it->second > 1;
+    uses.erase(it);
+    if (const ReadExpr *re = dyn_cast<ReadExpr>(e))
+      defineUpdates(re->updates);
+    if (shared || (defineRoot && e.get() == root.get()))
+      defineTerm(e);
+  }
+}
+
+void SMTLIBStreamPrinter::defineTerm(const ref<Expr> &e) {
+  unsigned id = nextId++;
+  append("(define-fun ?B");
+  appendNumber(id);
+  append(" () ");
+  printSort(e.get());
+  buffer += ' ';
+  printFullExpr(e.get(), getSort(e.get()));
+  append(")\n");
+  termIds.emplace(e, id);
+  terms.push_back(e);
+}
+
+void SMTLIBStreamPrinter::defineUpdates(const UpdateList &ul) {
+  declareArray(ul.root);
+
+  std::vector<UpdateList> pending;
+  for (UpdateList un = ul; un.head && !updateIds.count(un);
+       un.head = un.head->next)
+    pending.push_back(un);
+
+  // from the oldest update, which the others store into
+  for (auto it = pending.rbegin(), ie = pending.rend(); it != ie; ++it) {
+    const UpdateNode *un = it->head.get();
+    unsigned id = nextId++;
+    append("(define-fun ?U");
+    appendNumber(id);
+    append(" () (Array (_ BitVec ");
+    appendNumber(ul.root->getDomain());
+    append(") (_ BitVec ");
+    appendNumber(ul.root->getRange());
+    append(")) (store ");
+    printArray(UpdateList(ul.root, un->next));
+    buffer += ' ';
+    printExpr(un->index.get(), SORT_BITVECTOR);
+    buffer += ' ';
+    printExpr(un->value.get(), SORT_BITVECTOR);
+    append("))\n");
+    updateIds.emplace(*it, id);
+    updates.push_back(*it);
+  }
+}
+
+void SMTLIBStreamPrinter::declareArray(const Array *array) {
+  if (arrayNames.count(array))
+    return;
+
+  std::string name = array->name;
+  unsigned &sameName = arrayNameUses[name];
+  if (sameName++)
+    name += "." + std::to_string(sameName - 1);
+  arrays.push_back(array);
+
+  append("(declare-fun ");
+  append(name);
+  append(" () (Array (_ BitVec ");
+  appendNumber(array->getDomain());
+  append(") (_ BitVec ");
+  appendNumber(array->getRange());
+  append(")))\n");
+
+  // the contents of a constant array hold in all later queries
+  if (array->isConstantArray()) {
+    for (unsigned i = 0; i != array->size; ++i) {
+      append("(assert (= (select ");
+      append(name);
+      buffer += ' ';
+      appendIndex(i, array);
+      append(") ");
+      printConstant(array->getConstantValue(i).get(), SORT_BITVECTOR);
+      append("))\n");
+    }
+  }
+  arrayNames[array] = std::move(name);
+}
+
+void SMTLIBStreamPrinter::printArray(const UpdateList &ul) {
+  if (!ul.head) {
+    append(arrayNames.find(ul.root)->second);
+    return;
+  }
+  append("?U");
+  appendNumber(updateIds.find(ul)->second);
+}
+
+void SMTLIBStreamPrinter::printConstant(const ConstantExpr *ce, Sort sort) {
+  if (sort == SORT_BOOL) {
+    append(ce->isZero() ? "false" : "true");
+    return;
+  }
+
+  append("(_ bv");
+  if (ce->getWidth() <= 64) {
+    appendNumber(ce->getZExtValue());
+  } else {
+    llvm::SmallString<64> digits;
+    ce->getAPValue().toString(digits, 10, false);
+    buffer.append(digits.begin(), digits.end());
+  }
+  buffer += ' ';
+  appendNumber(ce->getWidth());
+  buffer += ')';
+}
+
+void SMTLIBStreamPrinter::printExpr(const Expr *e, Sort sort) {
+  if (const ConstantExpr *ce = dyn_cast<ConstantExpr>(e)) {
+    printConstant(ce, sort);
+    return;
+  }
+
+  // the casts of ExprSMTLIBPrinter
+  Sort natural = getSort(e);
+  if (natural != sort) {
+    if (sort == SORT_BITVECTOR) {
+      append("(ite ");
+      printExpr(e, SORT_BOOL);
+      append(" (_ bv1 1) (_ bv0 1))");
+    } else {
+      append("(bvugt ");
+      printExpr(e, SORT_BITVECTOR);
+      append(" (_ bv0 ");
+      appendNumber(e->getWidth());
+      append("))");
+    }
+    return;
+  }
+
+  auto it = termIds.find(ref<Expr>(const_cast<Expr *>(e)));
+  if (it != termIds.end()) {
+    append("?B");
+    appendNumber(it->second);
+    return;
+  }
+  printFullExpr(e, sort);
+}
+
+void SMTLIBStreamPrinter::printArgs(const Expr *e, Sort sort) {
+  for (unsigned i = 0, n = e->getNumKids(); i != n; ++i) {
+    buffer += ' ';
+    printExpr(e->getKid(i).get(), sort);
+  }
+  buffer += ')';
+}
+
+void SMTLIBStreamPrinter::printFullExpr(const Expr *e, Sort sort) {
+  bool bv = sort == SORT_BITVECTOR;
+  switch (e->getKind()) {
+  case Expr::Constant:
+    printConstant(cast<ConstantExpr>(e), sort);
+    return;
+
+  case Expr::NotOptimized:
+    printExpr(e->getKid(0).get(), sort);
+    return;
+
+  case Expr::Read: {
+    const ReadExpr *re = cast<ReadExpr>(e);
+    append("(select ");
+    printArray(re->updates);
+    buffer += ' ';
+    printExpr(re->index.get(), SORT_BITVECTOR);
+    buffer += ')';
+    return;
+  }
+
+  case Expr::Extract: {
+    const ExtractExpr *ee = cast<ExtractExpr>(e);
+    append("((_ extract ");
+    appendNumber(ee->offset + ee->width - 1);
+    buffer += ' ';
+    appendNumber(ee->offset);
+    buffer += ')';
+    printArgs(e, SORT_BITVECTOR);
+    return;
+  }
+
+  case Expr::ZExt:
+  case Expr::SExt: {
+    const CastExpr *ce = cast<CastExpr>(e);
+    append(isa<ZExtExpr>(e) ? "((_ zero_extend " : "((_ sign_extend ");
+    appendNumber(ce->width - ce->src->getWidth());
+    buffer += ')';
+    printArgs(e, SORT_BITVECTOR);
+    return;
+  }
+
+  case Expr::Select:
+    append("(ite ");
+    printExpr(e->getKid(0).get(), SORT_BOOL);
+    buffer += ' ';
+    printExpr(e->getKid(1).get(), sort);
+    buffer += ' ';
+    printExpr(e->getKid(2).get(), sort);
+    buffer += ')';
+    return;
+
+  case Expr::AShr: {
+    // bvashr does not shift in zeros when the shift amount is at least the
+    // width, see ExprSMTLIBPrinter::printAShrExpr
+    const Expr *value = e->getKid(0).get(), *shift = e->getKid(1).get();
+    Expr::Width width = value->getWidth();
+    append("(ite (bvuge ");
+    printExpr(shift, SORT_BITVECTOR);
+    append(" (_ bv");
+    appendNumber(width);
+    buffer += ' ';
+    appendNumber(width);
+    append(")) (_ bv0 ");
+    appendNumber(width);
+    append(") (bvashr ");
+    printExpr(value, SORT_BITVECTOR);
+    buffer += ' ';
+    printExpr(shift, SORT_BITVECTOR);
+    append("))");
+    return;
+  }
+
+  // both arguments have the sort of the first
+  case Expr::Eq:
+  case Expr::Ne:
+    append(isa<EqExpr>(e) ? "(=" : "(distinct");
+    printArgs(e, getSort(e->getKid(0).get()));
+    return;
+
+  case Expr::And:
+    append(bv ? "(bvand" : "(and");
+    printArgs(e, sort);
+    return;
+  case Expr::Or:
+    append(bv ? "(bvor" : "(or");
+    printArgs(e, sort);
+    return;
+  case Expr::Xor:
+    append(bv ? "(bvxor" : "(xor");
+    printArgs(e, sort);
+    return;
+  case Expr::Not:
+    append(bv ? "(bvnot" : "(not");
+    printArgs(e, sort);
+    return;
+
+  default:
+    break;
+  }
+
+  const char *keyword;
+  switch (e->getKind()) {
+  case Expr::Concat: keyword = "(concat"; break;
+  case Expr::Add: keyword = "(bvadd"; break;
+  case Expr::Sub: keyword = "(bvsub"; break;
+  case Expr::Mul: keyword = "(bvmul"; break;
+  case Expr::UDiv: keyword = "(bvudiv"; break;
+  case Expr::SDiv: keyword = "(bvsdiv"; break;
+  case Expr::URem: keyword = "(bvurem"; break;
+  case Expr::SRem: keyword = "(bvsrem"; break;
+  case Expr::Shl: keyword = "(bvshl"; break;
+  case Expr::LShr: keyword = "(bvlshr"; break;
+  case Expr::Ult: keyword = "(bvult"; break;
+  case Expr::Ule: keyword = "(bvule"; break;
+  case Expr::Ugt: keyword = "(bvugt"; break;
+  case Expr::Uge: keyword = "(bvuge"; break;
+  case Expr::Slt: keyword = "(bvslt"; break;
+  case Expr::Sle: keyword = "(bvsle"; break;
+  case Expr::Sgt: keyword = "(bvsgt"; break;
+  case Expr::Sge: keyword = "(bvsge"; break;
+  default:
+    llvm_unreachable("Conversion from Expr to SMTLIB keyword failed");
+  }
+  append(keyword);
+  printArgs(e, SORT_BITVECTOR);
+}
+
+void SMTLIBStreamPrinter::printQuery(const Query &query,
+                                     const std::vector<const Array *> *objects) {
+  if (!incremental)
+    reset();
+  last = {buffer.size(), terms.size(), updates.size(), arrays.size(),
+          headerPrinted};
+
+  if (!headerPrinted) {
+    // incremental sessions may always ask for models
+    if (incremental || (objects && !objects->empty()))
+      append("(set-option :produce-models true)\n");
+    append("(set-logic QF_AUFBV)\n");
+    headerPrinted = true;
+  }
+
+  // in incremental mode the constraints are defined, to be reused by the
+  // next queries
+  for (const auto &constraint : query.constraints)
+    countUses(constraint);
+  countUses(query.expr);
+  for (const auto &constraint : query.constraints)
+    defineTerms(constraint, incremental);
+  defineTerms(query.expr, false);
+  countedUpdates.clear();
+  if (objects)
+    for (const Array *array : *objects)
+      declareArray(array);
+
+  if (incremental)
+    append("(push 1)\n");
+  for (const auto &constraint : query.constraints) {
+    append("(assert ");
+    printExpr(constraint.get(), SORT_BOOL);
+    append(")\n");
+  }
+  // the negation of the query is satisfiable iff the query is invalid
+  if (!query.expr->isFalse()) {
+    append("(assert (not ");
+    printExpr(query.expr.get(), SORT_BOOL);
+    append("))\n");
+  }
+  append("(check-sat)\n");
+
+  if (objects && !objects->empty()) {
+    append("(get-value (");
+    for (const Array *array : *objects) {
+      for (unsigned i = 0; i != array->size; ++i) {
+        append("(select ");
+        append(arrayNames.find(array)->second);
+        buffer += ' ';
+        appendIndex(i, array);
+        buffer += ')';
+      }
+    }
+    append("))\n");
+  }
+
+  if (incremental)
+    append("(pop 1)\n");
+  else
+    printExit();
+}
+
+void SMTLIBStreamPrinter::discardQuery() {
+  if (buffer.size() > last.bufferSize)
+    buffer.resize(last.bufferSize);
+
+  for (size_t i = last.terms; i != terms.size(); ++i)
+    termIds.erase(terms[i]);
+  terms.erase(terms.begin() + last.terms, terms.end());
+  for (size_t i = last.updates; i != updates.size(); ++i)
+    updateIds.erase(updates[i]);
+  updates.erase(updates.begin() + last.updates, updates.end());
+  for (size_t i = last.arrays; i != arrays.size(); ++i) {
+    --arrayNameUses[arrays[i]->name];
+    arrayNames.erase(arrays[i]);
+  }
+  arrays.resize(last.arrays);
+  headerPrinted = last.headerPrinted;
+}
+
+void SMTLIBStreamPrinter::printExit() { append("(exit)\n"); }
+
+void SMTLIBStreamPrinter::reset() {
+  if (incremental && headerPrinted)
+    append("(reset)\n");
+  headerPrinted = false;
+  termIds.clear();
+  updateIds.clear();
+  arrayNames.clear();
+  arrayNameUses.clear();
+  terms.clear();
+  updates.clear();
+  arrays.clear();
+  nextId = 0;
+  last = {buffer.size(), 0, 0, 0, false};
+}
+
+void SMTLIBStreamPrinter::flush(llvm::raw_ostream &os) {
+  os << buffer;
+  buffer.clear();
+  // the last query cannot be removed any more
+  last.bufferSize = std::numeric_limits<size_t>::max();
+}
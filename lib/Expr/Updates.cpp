@@ -9,6 +9,8 @@
 
 #include "klee/Expr/Expr.h"
 
+#include "klee/ADT/ImmutableMap.h"
+
 #include <cassert>
 
 using namespace klee;
@@ -28,6 +30,56 @@ UpdateNode::UpdateNode(const ref<UpdateNode> &_next, const ref<Expr> &_index,
   size = next ? next->size + 1 : 1;
 }
 
+struct UpdateNode::WriteIndex {
+  ImmutableMap<uint64_t, const UpdateNode *> latest;
+  UpdateNode *symbolicWrite = nullptr;
+};
+
+UpdateNode::~UpdateNode() = default;
+
+/// Whether the index of un is a concrete one the write index can hold.
+static bool hasConcreteIndex(const UpdateNode *un) {
+  auto CE = dyn_cast<ConstantExpr>(un->index);
+  return CE && CE->getWidth() <= 64;
+}
+
+const UpdateNode::WriteIndex &UpdateNode::getWriteIndex() const {
+  if (writeIndex)
+    return *writeIndex;
+
+  // build the missing indices from the bottom up, without recursing as
+  // update lists can be long
+  assert(hasConcreteIndex(this) && "write at a symbolic index");
+  std::vector<const UpdateNode *> pending{this};
+  UpdateNode *un = next.get();
+  for (; un && !un->writeIndex && hasConcreteIndex(un); un = un->next.get())
+    pending.push_back(un);
+
+  WriteIndex base;
+  if (un) {
+    if (un->writeIndex)
+      base = *un->writeIndex;
+    else
+      base.symbolicWrite = un;
+  }
+  for (auto it = pending.rbegin(), ie = pending.rend(); it != ie; ++it) {
+    const UpdateNode *node = *it;
+    base.latest = base.latest.replace(
+        {cast<ConstantExpr>(node->index)->getZExtValue(), node});
+    node->writeIndex = std::make_unique<const WriteIndex>(base);
+  }
+  return *writeIndex;
+}
+
+const UpdateNode *
+UpdateNode::findConcreteWrite(uint64_t i, UpdateNode *&symbolicWrite) const {
+  const WriteIndex &wi = getWriteIndex();
+  symbolicWrite = wi.symbolicWrite;
+  if (auto entry = wi.latest.lookup(i))
+    return entry->second;
+  return nullptr;
+}
+
 extern "C" void vc_DeleteExpr(void*);
 
 int UpdateNode::compare(const UpdateNode &b) const {
@@ -40,6 +92,11 @@ unsigned UpdateNode::computeHash() {
   hashValue = index->hash() ^ value->hash();
   if (next)
     hashValue ^= next->hash();
+
+  stableHashValue = index->stableHash();
+  stableHashValue.combine(value->stableHash());
+  if (next)
+    stableHashValue.combine(next->stableHash());
   return hashValue;
 }
 
@@ -92,3 +149,10 @@ unsigned UpdateList::hash() const {
     res ^= head->hash();
   return res;
 }
+
+StableHash UpdateList::stableHash() const {
+  StableHash res = root->stableHash();
+  if (head)
+    res.combine(head->stableHash());
+  return res;
+}
@@ -32,6 +32,44 @@
 using namespace llvm;
 using namespace klee;
 
+bool klee::needsDivZeroCheck(const llvm::BinaryOperator &binOp) {
+  // find all [s|u][div|rem] instructions
+  auto opcode = binOp.getOpcode();
+  if (opcode != Instruction::SDiv && opcode != Instruction::UDiv &&
+      opcode != Instruction::SRem && opcode != Instruction::URem)
+    return false;
+
+  // Check if the operand is constant and not zero, skip in that case.
+  const auto &operand = binOp.getOperand(1);
+  if (const auto &coOp = dyn_cast<llvm::Constant>(operand)) {
+    if (!coOp->isZeroValue())
+      return false;
+  }
+
+  // Check if the operand is already checked by "klee_div_zero_check"
+  return !KleeIRMetaData::hasAnnotation(binOp, "klee.check.div", "True");
+}
+
+bool klee::needsOvershiftCheck(const llvm::BinaryOperator &binOp) {
+  // find all shift instructions
+  auto opcode = binOp.getOpcode();
+  if (opcode != Instruction::Shl && opcode != Instruction::LShr &&
+      opcode != Instruction::AShr)
+    return false;
+
+  // Check if the operand is constant and not zero, skip in that case
+  auto operand = binOp.getOperand(1);
+  if (auto coOp = dyn_cast<llvm::ConstantInt>(operand)) {
+    auto typeWidth = binOp.getOperand(0)->getType()->getScalarSizeInBits();
+    // If the constant shift is positive and smaller,equal the type width,
+    // we can ignore this instruction
+    if (!coOp->isNegative() && coOp->getZExtValue() < typeWidth)
+      return false;
+  }
+
+  return !KleeIRMetaData::hasAnnotation(binOp, "klee.check.shift", "True");
+}
+
 char DivCheckPass::ID;
 
 bool DivCheckPass::runOnModule(Module &M) {
@@ -41,26 +79,8 @@ bool DivCheckPass::runOnModule(Module &M) {
     for (auto &BB : F) {
       for (auto &I : BB) {
         auto binOp = dyn_cast<BinaryOperator>(&I);
-        if (!binOp)
-          continue;
-
-        // find all [s|u][div|rem] instructions
-        auto opcode = binOp->getOpcode();
-        if (opcode != Instruction::SDiv && opcode != Instruction::UDiv &&
-            opcode != Instruction::SRem && opcode != Instruction::URem)
-          continue;
-
-        // Check if the operand is constant and not zero, skip in that case.
-        const auto &operand = binOp->getOperand(1);
-        if (const auto &coOp = dyn_cast<llvm::Constant>(operand)) {
-          if (!coOp->isZeroValue())
-            continue;
-        }
-
-        // Check if the operand is already checked by "klee_div_zero_check"
-        if (KleeIRMetaData::hasAnnotation(I, "klee.check.div", "True"))
-          continue;
-        divInstruction.push_back(binOp);
+        if (binOp && needsDivZeroCheck(*binOp))
+          divInstruction.push_back(binOp);
       }
     }
   }
@@ -96,30 +116,8 @@ bool OvershiftCheckPass::runOnModule(Module &M) {
     for (auto &BB : F) {
       for (auto &I : BB) {
         auto binOp = dyn_cast<BinaryOperator>(&I);
-        if (!binOp)
-          continue;
-
-        // find all shift instructions
-        auto opcode = binOp->getOpcode();
-        if (opcode != Instruction::Shl && opcode != Instruction::LShr &&
-            opcode != Instruction::AShr)
-          continue;
-
-        // Check if the operand is constant and not zero, skip in that case
-        auto operand = binOp->getOperand(1);
-        if (auto coOp = dyn_cast<llvm::ConstantInt>(operand)) {
-          auto typeWidth =
-              binOp->getOperand(0)->getType()->getScalarSizeInBits();
-          // If the constant shift is positive and smaller,equal the type width,
-          // we can ignore this instruction
-          if (!coOp->isNegative() && coOp->getZExtValue() < typeWidth)
-            continue;
-        }
-
-        if (KleeIRMetaData::hasAnnotation(I, "klee.check.shift", "True"))
-          continue;
-
-        shiftInstructions.push_back(binOp);
+        if (binOp && needsOvershiftCheck(*binOp))
+          shiftInstructions.push_back(binOp);
       }
     }
   }
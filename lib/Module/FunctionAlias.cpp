@@ -33,6 +33,10 @@ cl::list<std::string>
 
 namespace klee {
 
+const std::vector<std::string> &FunctionAliasPass::getAliases() {
+  return FunctionAlias;
+}
+
 bool FunctionAliasPass::runOnModule(Module &M) {
   bool modified = false;
 
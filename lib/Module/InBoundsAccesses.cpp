@@ -0,0 +1,100 @@
+//===-- InBoundsAccesses.cpp ----------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "Passes.h"
+
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/DataLayout.h"
+#include "llvm/IR/GlobalVariable.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Operator.h"
+
+using namespace llvm;
+using namespace klee;
+
+char InBoundsAccessesPass::ID;
+
+namespace {
+
+/// Returns the size of the allocation site (alloca or defined global) the
+/// stripped address is, as the executor allocates it, or 0 if the site is
+/// not one of fixed size.
+uint64_t getSiteSize(const Value *site, const DataLayout &DL) {
+  if (const auto *ai = dyn_cast<AllocaInst>(site)) {
+    if (!ai->getAllocatedType()->isSized())
+      return 0;
+    uint64_t size = DL.getTypeStoreSize(ai->getAllocatedType());
+    if (!ai->isArrayAllocation())
+      return size;
+    const auto *count = dyn_cast<ConstantInt>(ai->getArraySize());
+    if (!count || count->getValue().getActiveBits() > 32)
+      return 0;
+    return size * count->getZExtValue();
+  }
+  // the size of declarations is only a guess, see Executor::allocateGlobals
+  if (const auto *gv = dyn_cast<GlobalVariable>(site))
+    if (!gv->isDeclaration() && gv->getValueType()->isSized())
+      return DL.getTypeStoreSize(gv->getValueType());
+  return 0;
+}
+
+/// Whether an access of the given size through address lies within the
+/// allocation site the address is a constant offset into.
+bool isInBounds(const Value *address, uint64_t bytes, const DataLayout &DL) {
+  APInt offset(DL.getIndexTypeSizeInBits(address->getType()), 0);
+  while (true) {
+    if (const auto *gep = dyn_cast<GEPOperator>(address)) {
+      // the offset wraps around like the one the executor computes
+      if (!gep->accumulateConstantOffset(DL, offset))
+        return false;
+      address = gep->getPointerOperand();
+    } else if (const auto *bc = dyn_cast<BitCastOperator>(address)) {
+      address = bc->getOperand(0);
+    } else {
+      break;
+    }
+  }
+
+  uint64_t size = getSiteSize(address, DL);
+  if (offset.isNegative() || offset.uge(size))
+    return false;
+  return bytes <= size - offset.getZExtValue();
+}
+
+} // namespace
+
+bool InBoundsAccessesPass::runOnModule(Module &M) {
+  inBoundsAccesses.clear();
+  const DataLayout &DL = M.getDataLayout();
+
+  for (const auto &f : M) {
+    for (const auto &i : instructions(f)) {
+      const Value *address;
+      Type *type;
+      if (const auto *load = dyn_cast<LoadInst>(&i)) {
+        address = load->getPointerOperand();
+        type = load->getType();
+      } else if (const auto *store = dyn_cast<StoreInst>(&i)) {
+        address = store->getPointerOperand();
+        type = store->getValueOperand()->getType();
+      } else {
+        continue;
+      }
+      if (!type->isSized())
+        continue;
+      if (isInBounds(address, DL.getTypeStoreSize(type), DL))
+        inBoundsAccesses.insert(&i);
+    }
+  }
+
+  // this is an analysis, the module is not modified
+  return false;
+}
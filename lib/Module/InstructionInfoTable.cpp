@@ -27,108 +27,72 @@
 #include "llvm/Support/raw_ostream.h"
 
 #include <cstdint>
-#include <map>
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
 
 using namespace klee;
 
+/// Records the line of the assembly on which each function and instruction
+/// is printed.
 class InstructionToLineAnnotator : public llvm::AssemblyAnnotationWriter {
+  std::unordered_map<const llvm::Value *, uint64_t> &lines;
+
 public:
+  explicit InstructionToLineAnnotator(
+      std::unordered_map<const llvm::Value *, uint64_t> &lines)
+      : lines(lines) {}
+
   void emitInstructionAnnot(const llvm::Instruction *i,
-                            llvm::formatted_raw_ostream &os) {
-    os << "%%%";
-    os << reinterpret_cast<std::uintptr_t>(i);
+                            llvm::formatted_raw_ostream &os) override {
+    lines.emplace(i, os.getLine() + 1);
   }
 
   void emitFunctionAnnot(const llvm::Function *f,
-                         llvm::formatted_raw_ostream &os) {
-    os << "%%%";
-    os << reinterpret_cast<std::uintptr_t>(f);
+                         llvm::formatted_raw_ostream &os) override {
+    lines.emplace(f, os.getLine() + 1);
   }
 };
 
-static std::map<uintptr_t, uint64_t>
-buildInstructionToLineMap(const llvm::Module &m) {
-
-  std::map<uintptr_t, uint64_t> mapping;
-  InstructionToLineAnnotator a;
-  std::string str;
-
-  llvm::raw_string_ostream os(str);
-  m.print(os, &a);
-  os.flush();
-
-  const char *s;
-
-  unsigned line = 1;
-  for (s=str.c_str(); *s; s++) {
-    if (*s != '\n')
-      continue;
-
-    line++;
-    if (s[1] != '%' || s[2] != '%' || s[3] != '%')
-      continue;
-
-    s += 4;
-    char *end;
-    uint64_t value = strtoull(s, &end, 10);
-    if (end != s) {
-      mapping.insert(std::make_pair(value, line));
-    }
-    s = end;
-  }
-
+static std::unordered_map<const llvm::Value *, uint64_t>
+buildInstructionToLineMap(const llvm::Module &m, llvm::raw_ostream *assembly) {
+  std::unordered_map<const llvm::Value *, uint64_t> mapping;
+  InstructionToLineAnnotator a(mapping);
+  // the lines are those of the assembly, so it is printed only once
+  llvm::raw_null_ostream discard;
+  m.print(assembly ? *assembly : discard, &a);
   return mapping;
 }
 
 class DebugInfoExtractor {
-  std::vector<std::unique_ptr<std::string>> &internedStrings;
-  std::map<uintptr_t, uint64_t> lineTable;
-
-  const llvm::Module &module;
+  std::unordered_set<std::string> &internedStrings;
 
 public:
-  DebugInfoExtractor(
-      std::vector<std::unique_ptr<std::string>> &_internedStrings,
-      const llvm::Module &_module)
-      : internedStrings(_internedStrings), module(_module) {
-    lineTable = buildInstructionToLineMap(module);
-  }
-
-  std::string &getInternedString(const std::string &s) {
-    auto found = std::find_if(internedStrings.begin(), internedStrings.end(),
-                              [&s](const std::unique_ptr<std::string> &item) {
-                                return *item.get() == s;
-                              });
-    if (found != internedStrings.end())
-      return *found->get();
-
-    auto newItem = std::unique_ptr<std::string>(new std::string(s));
-    auto result = newItem.get();
+  explicit DebugInfoExtractor(std::unordered_set<std::string> &_internedStrings)
+      : internedStrings(_internedStrings) {}
 
-    internedStrings.emplace_back(std::move(newItem));
-    return *result;
+  const std::string &getInternedString(const std::string &s) {
+    return *internedStrings.insert(s).first;
   }
 
-  std::unique_ptr<FunctionInfo> getFunctionInfo(const llvm::Function &Func) {
-    auto asmLine = lineTable.at(reinterpret_cast<std::uintptr_t>(&Func));
+  std::unique_ptr<FunctionInfo> getFunctionInfo(const llvm::Function &Func,
+                                                unsigned id, uint64_t asmLine) {
     auto dsub = Func.getSubprogram();
 
     if (dsub != nullptr) {
       auto path = dsub->getFilename();
       return std::make_unique<FunctionInfo>(FunctionInfo(
-          0, getInternedString(path.str()), dsub->getLine(), asmLine));
+          id, getInternedString(path.str()), dsub->getLine(), asmLine));
     }
 
     // Fallback: Mark as unknown
     return std::make_unique<FunctionInfo>(
-        FunctionInfo(0, getInternedString(""), 0, asmLine));
+        FunctionInfo(id, getInternedString(""), 0, asmLine));
   }
 
   std::unique_ptr<InstructionInfo>
-  getInstructionInfo(const llvm::Instruction &Inst, const FunctionInfo *f) {
-    auto asmLine = lineTable.at(reinterpret_cast<std::uintptr_t>(&Inst));
-
+  getInstructionInfo(const llvm::Instruction &Inst, const FunctionInfo *f,
+                     unsigned id, uint64_t asmLine) {
     // Retrieve debug information associated with instruction
     auto dl = Inst.getDebugLoc();
 
@@ -148,61 +112,94 @@ public:
         }
       }
       return std::make_unique<InstructionInfo>(InstructionInfo(
-          0, getInternedString(full_path.str()), line, column, asmLine));
+          id, getInternedString(full_path.str()), line, column, asmLine));
     }
 
     if (f != nullptr)
       // If nothing found, use the surrounding function
       return std::make_unique<InstructionInfo>(
-          InstructionInfo(0, f->file, f->line, 0, asmLine));
+          InstructionInfo(id, f->file, f->line, 0, asmLine));
     // If nothing found, use the surrounding function
     return std::make_unique<InstructionInfo>(
-        InstructionInfo(0, getInternedString(""), 0, 0, asmLine));
+        InstructionInfo(id, getInternedString(""), 0, 0, asmLine));
   }
 };
 
-InstructionInfoTable::InstructionInfoTable(const llvm::Module &m) {
-  // Generate all debug instruction information
-  DebugInfoExtractor DI(internedStrings, m);
-  for (const auto &Func : m) {
-    auto F = DI.getFunctionInfo(Func);
-    auto FR = F.get();
-    functionInfos.insert(std::make_pair(&Func, std::move(F)));
-
-    for (auto it = llvm::inst_begin(Func), ie = llvm::inst_end(Func); it != ie;
-         ++it) {
-      auto instr = &*it;
-      infos.insert(std::make_pair(instr, DI.getInstructionInfo(*instr, FR)));
-    }
+InstructionInfoTable::InstructionInfoTable(const llvm::Module &m,
+                                           llvm::raw_ostream *assembly,
+                                           bool lazy) {
+  auto lines = buildInstructionToLineMap(m, assembly);
+
+  // Make sure that every item has a unique ID, the instructions come first
+  for (const auto &Func : m)
+    for (const auto &instr : llvm::instructions(Func))
+      locations.emplace(&instr, Location{maxID++, lines.at(&instr)});
+  for (const auto &Func : m)
+    locations.emplace(&Func, Location{maxID++, lines.at(&Func)});
+
+  if (!lazy) {
+    // Generate all debug instruction information
+    for (const auto &Func : m)
+      resolve(Func);
   }
-
-  // Make sure that every item has a unique ID
-  size_t idCounter = 0;
-  for (auto &item : infos)
-    item.second->id = idCounter++;
-  for (auto &item : functionInfos)
-    item.second->id = idCounter++;
 }
 
-unsigned InstructionInfoTable::getMaxID() const {
-  return infos.size() + functionInfos.size();
+const FunctionInfo &
+InstructionInfoTable::resolve(const llvm::Function &f) const {
+  // the locations of built infos are dropped, so each one is only kept once
+  DebugInfoExtractor DI(internedStrings);
+  auto location = locations.find(&f);
+  const Location &fl = location->second;
+  auto F = DI.getFunctionInfo(f, fl.id, fl.assemblyLine);
+  auto FR = F.get();
+  functionInfos.emplace(&f, std::move(F));
+  locations.erase(location);
+
+  for (const auto &instr : llvm::instructions(f)) {
+    auto it = locations.find(&instr);
+    const Location &l = it->second;
+    infos.emplace(&instr, DI.getInstructionInfo(instr, FR, l.id,
+                                                l.assemblyLine));
+    locations.erase(it);
+  }
+  return *FR;
 }
 
+unsigned InstructionInfoTable::getMaxID() const { return maxID; }
+
 const InstructionInfo &
 InstructionInfoTable::getInfo(const llvm::Instruction &inst) const {
   auto it = infos.find(&inst);
-  if (it == infos.end())
+  if (it != infos.end())
+    return *it->second.get();
+  if (!locations.count(&inst))
     llvm::report_fatal_error("invalid instruction, not present in "
                              "initial module!");
-  return *it->second.get();
+  resolve(*inst.getFunction());
+  return *infos.at(&inst).get();
 }
 
 const FunctionInfo &
 InstructionInfoTable::getFunctionInfo(const llvm::Function &f) const {
   auto found = functionInfos.find(&f);
-  if (found == functionInfos.end())
+  if (found != functionInfos.end())
+    return *found->second.get();
+  if (!locations.count(&f))
     llvm::report_fatal_error("invalid instruction, not present in "
                              "initial module!");
+  return resolve(f);
+}
+
+unsigned InstructionInfoTable::getID(const llvm::Instruction &inst) const {
+  auto it = locations.find(&inst);
+  if (it != locations.end())
+    return it->second.id;
+  return getInfo(inst).id;
+}
 
-  return *found->second.get();
+unsigned InstructionInfoTable::getFunctionID(const llvm::Function &f) const {
+  auto it = locations.find(&f);
+  if (it != locations.end())
+    return it->second.id;
+  return getFunctionInfo(f).id;
 }
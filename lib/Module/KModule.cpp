@@ -11,7 +11,9 @@
 
 #include "Passes.h"
 
+#include "klee/Config/CompileTimeInfo.h"
 #include "klee/Config/Version.h"
+#include "klee/Config/config.h"
 #include "klee/Core/Interpreter.h"
 #include "klee/Support/OptionCategories.h"
 #include "klee/Module/Cell.h"
@@ -22,7 +24,11 @@
 #include "klee/Support/ErrorHandling.h"
 #include "klee/Support/ModuleUtil.h"
 
+#include "llvm/ADT/SparseBitVector.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Bitcode/BitcodeReader.h"
 #include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/IR/CFG.h"
 #include "llvm/IR/DataLayout.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/Instructions.h"
@@ -33,12 +39,16 @@
 #include "llvm/IR/Verifier.h"
 #include "llvm/Linker/Linker.h"
 #include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/Path.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Support/raw_os_ostream.h"
 #include "llvm/Transforms/Scalar.h"
 #include "llvm/Transforms/Scalar/Scalarizer.h"
 #include "llvm/Transforms/Utils/Cloning.h"
+#include "llvm/Transforms/Utils/UnifyFunctionExitNodes.h"
 #include "llvm/Transforms/Utils.h"
 
 #include <sstream>
@@ -98,12 +108,78 @@ namespace {
                              cl::desc("Allow optimization of functions that "
                                       "contain KLEE calls (default=true)"),
                              cl::init(true), cl::cat(ModuleCat));
+
+  cl::opt<bool>
+  PointerFreeAnalysis("pointer-free-analysis",
+                      cl::desc("Do not track segments for allocas and globals "
+                               "that never hold a pointer (default=true)"),
+                      cl::init(true), cl::cat(ModuleCat));
+
+  cl::opt<bool>
+  StaticBoundsChecks("static-bounds-checks",
+                     cl::desc("Prove the loads and stores at constant offsets "
+                              "into allocas and globals of fixed size in "
+                              "bounds when the module is prepared, and skip "
+                              "their bounds checks (default=true)"),
+                     cl::init(true), cl::cat(ModuleCat));
+
+  cl::opt<bool>
+  SummarizeLoops("summarize-loops",
+                 cl::desc("Replace the iterations of loops that only count "
+                          "by their closed form, forking once on whether the "
+                          "loop is entered. The instructions of the loop are "
+                          "then not covered (default=false)"),
+                 cl::init(false), cl::cat(ModuleCat));
+
+  cl::opt<bool>
+  MemoizeCalls("memoize-calls",
+               cl::desc("Answer the calls of functions that only read the "
+                        "memory of their arguments and globals, and only "
+                        "write their own locals, from the results of earlier "
+                        "calls with the same concrete arguments and memory "
+                        "contents, without executing their body "
+                        "(default=false)"),
+               cl::init(false), cl::cat(ModuleCat));
+
+  cl::opt<bool>
+  BatchNondetFills("batch-nondet-fills",
+                   cl::desc("Read the nondet integers that a call site "
+                            "stores into consecutive elements of a buffer, "
+                            "as in a loop filling it, from one array instead "
+                            "of an array per value. Each value keeps its "
+                            "name in the tests (default=false)"),
+                   cl::init(false), cl::cat(ModuleCat));
+
+  cl::opt<bool>
+  SliceModule("slice-module",
+              cl::desc("Remove the instructions that cannot influence whether "
+                       "an error function or a check is reached before "
+                       "execution. Memory errors are only found in the "
+                       "remaining accesses (default=false)"),
+              cl::init(false), cl::cat(ModuleCat));
+
+  cl::opt<std::string>
+  ModuleCache("module-cache",
+              cl::desc("Keep the prepared modules in this directory, keyed by "
+                       "the linked code and the module options, so that later "
+                       "runs on the same program skip linking and "
+                       "optimisation (default=off)"),
+              cl::value_desc("dir"), cl::cat(ModuleCat));
+
+  cl::opt<bool>
+  LazyInstructionInfo("lazy-instruction-info",
+                      cl::desc("Extract the debug information of a function "
+                               "only once it is first executed; writing "
+                               "run.istats still needs all of it "
+                               "(default=false)"),
+                      cl::init(false), cl::cat(ModuleCat));
 }
 
 /***/
 
 namespace llvm {
 extern void Optimize(Module *, llvm::ArrayRef<const char *> preservedFunctions);
+extern std::string OptimizeOptions();
 }
 
 // what a hack
@@ -229,8 +305,10 @@ void KModule::instrument(const Interpreter::ModuleOptions &opts) {
 
   // This pass will replace atomic instructions with non-atomic operations
   pm.add(createLowerAtomicPass());
-  if (opts.CheckDivZero) pm.add(new DivCheckPass());
-  if (opts.CheckOvershift) pm.add(new OvershiftCheckPass());
+  if (!opts.NativeChecks) {
+    if (opts.CheckDivZero) pm.add(new DivCheckPass());
+    if (opts.CheckOvershift) pm.add(new OvershiftCheckPass());
+  }
 
   pm.add(new IntrinsicCleanerPass(*targetData));
   pm.run(*module);
@@ -250,16 +328,27 @@ void KModule::optimiseAndPrepare(
   if (opts.Optimize)
     Optimize(module.get(), preservedFunctions);
 
-  // Add internal functions which are not used to check if instructions
-  // have been already visited
-  if (opts.CheckDivZero)
-    addInternalFunction("klee_div_zero_check");
-  if (opts.CheckOvershift)
-    addInternalFunction("klee_overshift_check");
+  addInternalFunctions(opts);
+  selectNativeChecks(opts);
 
   // Needs to happen after linking (since ctors/dtors can be modified)
   // and optimization (since global optimization can rewrite lists).
   injectStaticConstructorsAndDestructors(module.get(), opts.EntryPoint);
+  for (const auto &entryPoint : opts.ExtraEntryPoints)
+    injectStaticConstructorsAndDestructors(module.get(), entryPoint);
+
+  if (SliceModule) {
+    std::set<std::string> errorFunctions(opts.ErrorFunctions.begin(),
+                                         opts.ErrorFunctions.end());
+    errorFunctions.insert({"__assert_fail", "__INSTR_fail",
+                           "klee_div_zero_check", "klee_overshift_check"});
+    legacy::PassManager pm;
+    // branches to different returns have a common post-dominator once
+    // they return from a single block
+    pm.add(createUnifyFunctionExitNodesPass());
+    pm.add(new SlicingPass(std::move(errorFunctions), nativeChecks));
+    pm.run(*module);
+  }
 
   // Finally, run the passes that maintain invariants we expect during
   // interpretation. We run the intrinsic cleaner just in case we
@@ -278,14 +367,157 @@ void KModule::optimiseAndPrepare(
   pm3.add(createScalarizerPass());
   pm3.add(new PhiCleanerPass());
   pm3.add(new FunctionAliasPass());
+  if (PointerFreeAnalysis)
+    pm3.add(new PointerFreeAllocationsPass(pointerFreeAllocSites));
+  if (StaticBoundsChecks)
+    pm3.add(new InBoundsAccessesPass(inBoundsAccesses));
+  if (SummarizeLoops)
+    pm3.add(new LoopSummaryPass(loopSummaries));
+  if (MemoizeCalls)
+    pm3.add(new MemoizableFunctionsPass(memoizableFunctions));
+  if (BatchNondetFills)
+    pm3.add(new NondetFillsPass(nondetFills));
   pm3.run(*module);
 }
 
+void KModule::addInternalFunctions(const Interpreter::ModuleOptions &opts) {
+  // Add internal functions which are not used to check if instructions
+  // have been already visited
+  if (opts.NativeChecks)
+    return;
+  if (opts.CheckDivZero)
+    addInternalFunction("klee_div_zero_check");
+  if (opts.CheckOvershift)
+    addInternalFunction("klee_overshift_check");
+}
+
+void KModule::selectNativeChecks(const Interpreter::ModuleOptions &opts) {
+  nativeChecks = 0;
+  if (!opts.NativeChecks)
+    return;
+  if (opts.CheckDivZero)
+    nativeChecks |= KInstruction::CheckDivZero;
+  if (opts.CheckOvershift)
+    nativeChecks |= KInstruction::CheckOvershift;
+}
+
+std::string
+KModule::getCacheKey(const std::vector<std::unique_ptr<llvm::Module>> &modules,
+                     const Interpreter::ModuleOptions &opts) const {
+  if (ModuleCache.empty())
+    return "";
+
+  MD5 hash;
+  std::string options;
+  raw_string_ostream os(options);
+  os << PACKAGE_STRING << ' ' << KLEE_BUILD_REVISION << ' '
+     << LLVM_VERSION_STRING << '\n'
+     << opts.EntryPoint << ' ' << llvm::join(opts.ExtraEntryPoints, ",")
+     << ' ' << opts.Optimize << opts.CheckDivZero
+     << opts.CheckOvershift << opts.NativeChecks << ' ' << OptimizeOptions()
+     << '\n'
+     << "switch-type=" << SwitchType << " klee-call-optimisation="
+     << OptimiseKLEECall << " pointer-free-analysis=" << PointerFreeAnalysis
+     << " slice-module=" << SliceModule << ' '
+     << llvm::join(opts.ErrorFunctions, ",") << '\n';
+  for (const auto &alias : FunctionAliasPass::getAliases())
+    os << "function-alias=" << alias << '\n';
+  hash.update(os.str());
+
+  SmallVector<char, 0> bitcode;
+  for (const auto &m : modules) {
+    bitcode.clear();
+    raw_svector_ostream bos(bitcode);
+    WriteBitcodeToFile(*m, bos);
+    hash.update(ArrayRef<uint8_t>(
+        reinterpret_cast<const uint8_t *>(bitcode.data()), bitcode.size()));
+  }
+
+  MD5::MD5Result result;
+  hash.final(result);
+  SmallString<128> path(ModuleCache);
+  sys::path::append(path, result.digest().str() + ".bc");
+  return path.str().str();
+}
+
+bool KModule::loadFromCache(const std::string &key, LLVMContext &ctx) {
+  if (key.empty())
+    return false;
+  auto buffer = MemoryBuffer::getFile(key);
+  if (!buffer)
+    return false;
+  auto m = parseBitcodeFile(buffer.get()->getMemBufferRef(), ctx);
+  if (!m) {
+    klee_warning("unable to load cached module %s - %s", key.c_str(),
+                 toString(m.takeError()).c_str());
+    return false;
+  }
+  module = std::move(m.get());
+  targetData = std::unique_ptr<llvm::DataLayout>(new DataLayout(module.get()));
+  klee_message("Using cached module %s", key.c_str());
+  return true;
+}
+
+void KModule::restoreFromCache(const Interpreter::ModuleOptions &opts) {
+  addInternalFunctions(opts);
+  selectNativeChecks(opts);
+  if (PointerFreeAnalysis) {
+    legacy::PassManager pm;
+    pm.add(new PointerFreeAllocationsPass(pointerFreeAllocSites));
+    pm.run(*module);
+  }
+  if (StaticBoundsChecks) {
+    legacy::PassManager pm;
+    pm.add(new InBoundsAccessesPass(inBoundsAccesses));
+    pm.run(*module);
+  }
+  if (SummarizeLoops) {
+    legacy::PassManager pm;
+    pm.add(new LoopSummaryPass(loopSummaries));
+    pm.run(*module);
+  }
+  if (MemoizeCalls) {
+    legacy::PassManager pm;
+    pm.add(new MemoizableFunctionsPass(memoizableFunctions));
+    pm.run(*module);
+  }
+  if (BatchNondetFills) {
+    legacy::PassManager pm;
+    pm.add(new NondetFillsPass(nondetFills));
+    pm.run(*module);
+  }
+}
+
+void KModule::storeInCache(const std::string &key) const {
+  if (key.empty())
+    return;
+  if (auto ec = sys::fs::create_directories(ModuleCache)) {
+    klee_warning("unable to create module cache %s - %s", ModuleCache.c_str(),
+                 ec.message().c_str());
+    return;
+  }
+  // written under a temporary name first, so that concurrent runs never
+  // load a partial module
+  SmallString<128> temporary;
+  int fd;
+  if (sys::fs::createUniqueFile(key + ".%%%%%%", fd, temporary))
+    return;
+  raw_fd_ostream os(fd, /*shouldClose=*/true);
+  WriteBitcodeToFile(*module, os);
+  os.close();
+  if (os.has_error() || sys::fs::rename(temporary, key)) {
+    os.clear_error();
+    sys::fs::remove(temporary);
+    klee_warning("unable to write cached module %s", key.c_str());
+  }
+}
+
 void KModule::manifest(InterpreterHandler *ih, bool forceSourceOutput) {
+  std::unique_ptr<llvm::raw_fd_ostream> assembly;
   if (OutputSource || forceSourceOutput) {
-    std::unique_ptr<llvm::raw_fd_ostream> os(ih->openOutputFile("assembly.ll"));
-    assert(os && !os->has_error() && "unable to open source output");
-    *os << *module;
+    assembly = ih->openOutputFile("assembly.ll");
+    assert(assembly && !assembly->has_error() &&
+           "unable to open source output");
   }
 
   if (OutputModule) {
@@ -295,8 +527,11 @@ void KModule::manifest(InterpreterHandler *ih, bool forceSourceOutput) {
 
   /* Build shadow structures */
 
+  // the assembly is written while its lines are recorded
   infos = std::unique_ptr<InstructionInfoTable>(
-      new InstructionInfoTable(*module.get()));
+      new InstructionInfoTable(*module.get(), assembly.get(),
+                               LazyInstructionInfo));
+  assembly.reset();
 
   std::vector<Function *> declarations;
 
@@ -309,7 +544,7 @@ void KModule::manifest(InterpreterHandler *ih, bool forceSourceOutput) {
 
     for (unsigned i=0; i<kf->numInstructions; ++i) {
       KInstruction *ki = kf->instructions[i];
-      ki->info = &infos->getInfo(*ki->inst);
+      ki->info = LazyInstructionInfo ? nullptr : &infos->getInfo(*ki->inst);
     }
 
     functionMap.insert(std::make_pair(&Function, kf.get()));
@@ -339,6 +574,15 @@ void KModule::manifest(InterpreterHandler *ih, bool forceSourceOutput) {
   }
 }
 
+void KModule::resolveInfos(KFunction *kf) const {
+  if (kf->numInstructions == 0 || kf->instructions[0]->info)
+    return;
+  for (unsigned i = 0; i < kf->numInstructions; ++i) {
+    KInstruction *ki = kf->instructions[i];
+    ki->info = &infos->getInfo(*ki->inst);
+  }
+}
+
 void KModule::checkModule() {
   InstructionOperandTypeCheckPass *operandTypeCheckPass =
       new InstructionOperandTypeCheckPass();
@@ -403,6 +647,140 @@ static int getOperandNum(Value *v,
   }
 }
 
+/// Fill in the deadRegisters of the instructions of kf by a liveness analysis
+/// of its registers. The operands of a phi are read when the phi executes,
+/// so they count as used by it rather than at the end of the predecessors.
+static void computeDeadRegisters(KFunction &kf,
+                                 std::map<Instruction *, unsigned> &registerMap) {
+  using Registers = SparseBitVector<>;
+  auto getRegister = [&](const Value *v, unsigned &reg) {
+    if (auto *a = dyn_cast<Argument>(v)) {
+      reg = kf.getArgRegister(a->getArgNo());
+      return true;
+    }
+    if (auto *inst = dyn_cast<Instruction>(v)) {
+      reg = registerMap[const_cast<Instruction *>(inst)];
+      return true;
+    }
+    return false;
+  };
+  auto getUses = [&](const KInstruction &ki) {
+    Registers uses;
+    unsigned reg;
+    for (const Value *v : ki.inst->operands())
+      if (getRegister(v, reg))
+        uses.set(reg);
+    return uses;
+  };
+  // the registers that may hold a value right after ki was executed
+  auto getTouched = [&](const KInstruction &ki) {
+    Registers touched = getUses(ki);
+    if (!ki.inst->getType()->isVoidTy())
+      touched.set(ki.dest);
+    return touched;
+  };
+  auto setDead = [&](KInstruction &ki, Registers dead) {
+    for (unsigned reg : dead)
+      if (reg >= kf.numArgs)
+        ki.deadRegisters.push_back(reg);
+  };
+
+  // the registers live at the start of each block
+  std::map<const BasicBlock *, Registers> liveIn;
+  auto getLiveOut = [&](const BasicBlock &bb) {
+    Registers out;
+    for (const BasicBlock *succ : successors(&bb))
+      out |= liveIn[succ];
+    return out;
+  };
+  // turns the registers live after ki into those live before it
+  auto stepBack = [&](const KInstruction &ki, Registers &live) {
+    if (!ki.inst->getType()->isVoidTy())
+      live.reset(ki.dest);
+    live |= getUses(ki);
+  };
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (const BasicBlock &bb : reverse(kf.function->getBasicBlockList())) {
+      unsigned entry = kf.getBasicBlockEntry(&bb);
+      Registers live = getLiveOut(bb);
+      for (unsigned i = entry + bb.size(); i > entry; --i)
+        stepBack(*kf.instructions[i - 1], live);
+      Registers &in = liveIn[&bb];
+      if (in != live) {
+        in = std::move(live);
+        changed = true;
+      }
+    }
+  }
+
+  for (const BasicBlock &bb : *kf.function) {
+    unsigned entry = kf.getBasicBlockEntry(&bb);
+    unsigned last = entry + bb.size() - 1;
+    Registers live = getLiveOut(bb);
+    for (unsigned i = last; i > entry; --i) {
+      KInstruction &ki = *kf.instructions[i];
+      stepBack(ki, live);
+      Registers dead = getTouched(*kf.instructions[i - 1]);
+      dead.intersectWithComplement(live);
+      setDead(ki, std::move(dead));
+    }
+
+    Registers dead;
+    for (const BasicBlock *pred : predecessors(&bb)) {
+      const KInstruction &terminator =
+          *kf.instructions[kf.getBasicBlockEntry(pred) + pred->size() - 1];
+      Registers live = getLiveOut(*pred);
+      stepBack(terminator, live);
+      dead |= live;
+      dead |= getTouched(terminator);
+    }
+    dead.intersectWithComplement(liveIn[&bb]);
+    setDead(*kf.instructions[entry], std::move(dead));
+  }
+}
+
+/// Fill in the pre-decoded fields of ki.
+static void decodeInstruction(KInstruction *ki, KModule *km) {
+  Instruction *inst = ki->inst;
+  Type *type = inst->getType();
+  ki->opcode = inst->getOpcode();
+
+  // the native fast path works on at most 64 bit scalars
+  if (isa<BinaryOperator>(inst) && type->isIntegerTy() &&
+      type->getIntegerBitWidth() <= 64) {
+    ki->kind = KInstruction::IntBinary;
+    ki->width = type->getIntegerBitWidth();
+  } else if (auto *ci = dyn_cast<ICmpInst>(inst)) {
+    if (!ci->getOperand(0)->getType()->isVectorTy()) {
+      ki->kind = KInstruction::IntCompare;
+      ki->predicate = ci->getPredicate();
+    }
+  } else if (isa<TruncInst>(inst) || isa<ZExtInst>(inst) ||
+             isa<SExtInst>(inst) || isa<IntToPtrInst>(inst) ||
+             isa<PtrToIntInst>(inst)) {
+    unsigned width = km->targetData->getTypeSizeInBits(type);
+    if (!type->isVectorTy() && width <= 64) {
+      ki->kind = KInstruction::IntCast;
+      ki->width = width;
+    }
+  }
+
+  ki->inBounds = km->inBoundsAccesses.count(inst) > 0;
+  ki->fillsNondet = km->nondetFills.count(inst) > 0;
+
+  // the same instructions the check passes instrument
+  if (auto *binOp = dyn_cast<BinaryOperator>(inst)) {
+    if ((km->nativeChecks & KInstruction::CheckDivZero) &&
+        needsDivZeroCheck(*binOp))
+      ki->checks |= KInstruction::CheckDivZero;
+    if ((km->nativeChecks & KInstruction::CheckOvershift) &&
+        needsOvershiftCheck(*binOp))
+      ki->checks |= KInstruction::CheckOvershift;
+  }
+}
+
 KFunction::KFunction(llvm::Function *_function,
                      KModule *km) 
   : KCallable(CK_Function),
@@ -450,6 +828,7 @@ KFunction::KFunction(llvm::Function *_function,
       ki->inst = inst;
       ki->dest = registerMap[inst];
       instructionsMap[inst] = ki;
+      decodeInstruction(ki, km);
 
       if (isa<CallInst>(it) || isa<InvokeInst>(it)) {
         const CallBase &cb = cast<CallBase>(*inst);
@@ -473,6 +852,8 @@ KFunction::KFunction(llvm::Function *_function,
       instructions[i++] = ki;
     }
   }
+
+  computeDeadRegisters(*this, registerMap);
 }
 
 KFunction::~KFunction() {
@@ -481,7 +862,7 @@ KFunction::~KFunction() {
   delete[] instructions;
 }
 
-KInstruction *KModule::getKInstruction(llvm::Instruction *I) const {
+KInstruction *KModule::getKInstruction(const llvm::Instruction *I) const {
     auto it = functionMap.find(I->getParent()->getParent());
     assert(it != functionMap.end());
     return it->second->getKInstruction(I);
@@ -0,0 +1,208 @@
+//===-- LoopSummary.cpp ---------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "Passes.h"
+
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/Module.h"
+
+using namespace llvm;
+using namespace klee;
+
+char LoopSummaryPass::ID;
+
+namespace {
+
+/// Instructions that cannot fail and have no effect but their result.
+bool isPure(const Instruction &i) {
+  if (isa<DbgInfoIntrinsic>(i))
+    return true;
+  if (const auto *bo = dyn_cast<BinaryOperator>(&i)) {
+    switch (bo->getOpcode()) {
+    // division by zero and overshifts are errors
+    case Instruction::UDiv:
+    case Instruction::SDiv:
+    case Instruction::URem:
+    case Instruction::SRem:
+    case Instruction::Shl:
+    case Instruction::LShr:
+    case Instruction::AShr:
+      return false;
+    default:
+      return true;
+    }
+  }
+  if (const auto *cast = dyn_cast<CastInst>(&i))
+    return cast->getOpcode() != Instruction::IntToPtr &&
+           cast->getOpcode() != Instruction::PtrToInt;
+  return isa<CmpInst>(i) || isa<SelectInst>(i) || isa<BranchInst>(i) ||
+         isa<FreezeInst>(i);
+}
+
+/// Matches the next value of a header phi, the phi plus or minus a value
+/// that is invariant in the loop.
+bool matchRecurrence(const Loop &loop, PHINode *phi, BasicBlock *latch,
+                     LoopSummary::Recurrence &r) {
+  if (!phi->getType()->isIntegerTy() || phi->getNumIncomingValues() != 2)
+    return false;
+  auto *update = dyn_cast<BinaryOperator>(phi->getIncomingValueForBlock(latch));
+  if (!update || !loop.contains(update))
+    return false;
+  r.phi = phi;
+  r.update = update;
+  switch (update->getOpcode()) {
+  case Instruction::Add:
+    r.subtract = false;
+    if (update->getOperand(0) == phi)
+      r.stepOperand = 1;
+    else if (update->getOperand(1) == phi)
+      r.stepOperand = 0;
+    else
+      return false;
+    break;
+  case Instruction::Sub:
+    r.subtract = true;
+    if (update->getOperand(0) != phi)
+      return false;
+    r.stepOperand = 1;
+    break;
+  default:
+    return false;
+  }
+  return loop.isLoopInvariant(update->getOperand(r.stepOperand));
+}
+
+/// The step of the recurrence if it is 1 or -1, 0 otherwise.
+int getUnitStep(const LoopSummary::Recurrence &r) {
+  const auto *c = dyn_cast<ConstantInt>(r.update->getOperand(r.stepOperand));
+  if (!c)
+    return 0;
+  int step = c->isOne() ? 1 : c->isMinusOne() ? -1 : 0;
+  return r.subtract ? -step : step;
+}
+
+bool summarize(const Loop &loop, LoopSummary &summary) {
+  BasicBlock *header = loop.getHeader();
+  BasicBlock *latch = loop.getLoopLatch();
+  summary.enteredFrom = loop.getLoopPredecessor();
+  summary.exiting = loop.getExitingBlock();
+  summary.exit = loop.getExitBlock();
+  if (!latch || !summary.enteredFrom || !summary.exiting || !summary.exit)
+    return false;
+  if (summary.exiting != header && summary.exiting != latch)
+    return false;
+  summary.exitsAtLatch = summary.exiting == latch;
+
+  for (PHINode &phi : header->phis()) {
+    LoopSummary::Recurrence r;
+    if (!matchRecurrence(loop, &phi, latch, r))
+      return false;
+    summary.recurrences.push_back(r);
+  }
+
+  for (BasicBlock *bb : loop.blocks()) {
+    for (Instruction &i : *bb) {
+      if (isa<PHINode>(i) ? bb != header : !isPure(i))
+        return false;
+      // only the recurrences have a value after the loop
+      for (const User *user : i.users()) {
+        if (loop.contains(cast<Instruction>(user)))
+          continue;
+        bool isRecurrence = false;
+        for (const auto &r : summary.recurrences)
+          isRecurrence |=
+              &i == r.phi || (summary.exitsAtLatch && &i == r.update);
+        if (!isRecurrence)
+          return false;
+      }
+    }
+  }
+
+  // the test of the exiting branch, normalised to "counter op bound" under
+  // which the loop continues
+  auto *br = dyn_cast<BranchInst>(summary.exiting->getTerminator());
+  if (!br || !br->isConditional())
+    return false;
+  auto *test = dyn_cast<ICmpInst>(br->getCondition());
+  if (!test || !loop.contains(test))
+    return false;
+  summary.test = test;
+  CmpInst::Predicate predicate = test->getPredicate();
+  if (!loop.contains(br->getSuccessor(0)))
+    predicate = CmpInst::getInversePredicate(predicate);
+
+  bool found = false;
+  for (unsigned operand = 0; operand < 2 && !found; ++operand) {
+    Value *v = test->getOperand(operand);
+    for (unsigned i = 0; i < summary.recurrences.size() && !found; ++i) {
+      const auto &r = summary.recurrences[i];
+      if (v != r.phi && v != r.update)
+        continue;
+      summary.counter = i;
+      summary.testsNext = v == r.update;
+      summary.boundOperand = 1 - operand;
+      if (operand == 1)
+        predicate = CmpInst::getSwappedPredicate(predicate);
+      found = true;
+    }
+  }
+  if (!found || !loop.isLoopInvariant(test->getOperand(summary.boundOperand)))
+    return false;
+  // the next value is only computed in the latch
+  if (summary.testsNext && summary.exiting != latch)
+    return false;
+
+  int step = getUnitStep(summary.recurrences[summary.counter]);
+  summary.counterIncreases = step > 0;
+  switch (predicate) {
+  case CmpInst::ICMP_NE:
+    summary.continueWhile = LoopSummary::Test::NotEqual;
+    return step != 0;
+  case CmpInst::ICMP_SLT:
+    summary.continueWhile = LoopSummary::Test::SignedLess;
+    return step > 0;
+  case CmpInst::ICMP_ULT:
+    summary.continueWhile = LoopSummary::Test::UnsignedLess;
+    return step > 0;
+  case CmpInst::ICMP_SGT:
+    summary.continueWhile = LoopSummary::Test::SignedGreater;
+    return step < 0;
+  case CmpInst::ICMP_UGT:
+    summary.continueWhile = LoopSummary::Test::UnsignedGreater;
+    return step < 0;
+  default:
+    return false;
+  }
+}
+
+} // namespace
+
+bool LoopSummaryPass::runOnModule(Module &M) {
+  summaries.clear();
+  for (Function &f : M) {
+    if (f.isDeclaration())
+      continue;
+    DominatorTree dt(f);
+    LoopInfo loops(dt);
+    for (Loop *loop : loops.getLoopsInPreorder()) {
+      if (!loop->isInnermost())
+        continue;
+      LoopSummary summary;
+      if (summarize(*loop, summary))
+        summaries.emplace(loop->getHeader(), std::move(summary));
+    }
+  }
+
+  // this is an analysis, the module is not modified
+  return false;
+}
@@ -0,0 +1,217 @@
+//===-- MemoizableFunctions.cpp -------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "Passes.h"
+
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/GlobalVariable.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Operator.h"
+
+#include <set>
+
+using namespace llvm;
+using namespace klee;
+
+char MemoizableFunctionsPass::ID;
+
+namespace {
+
+/// Strips the constant and variable offsets and the casts off an address.
+const Value *getBase(const Value *address) {
+  while (true) {
+    if (const auto *gep = dyn_cast<GEPOperator>(address))
+      address = gep->getPointerOperand();
+    else if (const auto *bc = dyn_cast<BitCastOperator>(address))
+      address = bc->getOperand(0);
+    else
+      return address;
+  }
+}
+
+bool isOwnAlloca(const Value *v, const Function &f) {
+  const auto *ai = dyn_cast<AllocaInst>(v);
+  return ai && ai->getFunction() == &f;
+}
+
+/// Decides which pointers of a function only reach memory that is a
+/// function of the arguments and of the globals, i.e. the objects of its
+/// pointer arguments, globals and its own allocas.
+class InputPointers {
+  const Function &f;
+  std::map<const Value *, bool> known;
+  std::map<const AllocaInst *, std::vector<const StoreInst *>> stores;
+  std::set<const AllocaInst *> clobbered;
+
+public:
+  /// The non-constant globals the pointers may reach.
+  std::set<const GlobalVariable *> globals;
+
+  explicit InputPointers(const Function &f) : f(f) {
+    for (const auto &i : instructions(f)) {
+      if (const auto *si = dyn_cast<StoreInst>(&i)) {
+        if (const auto *ai = dyn_cast<AllocaInst>(getBase(si->getPointerOperand())))
+          stores[ai].push_back(si);
+      } else if (const auto *mi = dyn_cast<MemIntrinsic>(&i)) {
+        // bytes copied into an alloca may be those of any pointer
+        if (const auto *ai = dyn_cast<AllocaInst>(getBase(mi->getDest())))
+          clobbered.insert(ai);
+      }
+    }
+  }
+
+  bool isInput(const Value *pointer) {
+    const Value *base = getBase(pointer);
+    auto it = known.find(base);
+    if (it != known.end())
+      return it->second;
+    // optimistic on cycles through phis and allocas
+    known[base] = true;
+    bool result = compute(base);
+    known[base] = result;
+    return result;
+  }
+
+private:
+  bool compute(const Value *base) {
+    if (isa<ConstantPointerNull>(base))
+      return true;
+    if (const auto *arg = dyn_cast<Argument>(base))
+      return arg->getParent() == &f;
+    if (const auto *gv = dyn_cast<GlobalVariable>(base)) {
+      if (!gv->isConstant())
+        globals.insert(gv);
+      return true;
+    }
+    if (isOwnAlloca(base, f))
+      return true;
+    if (const auto *phi = dyn_cast<PHINode>(base)) {
+      for (const auto &v : phi->incoming_values())
+        if (!isInput(v))
+          return false;
+      return true;
+    }
+    if (const auto *si = dyn_cast<SelectInst>(base))
+      return isInput(si->getTrueValue()) && isInput(si->getFalseValue());
+    // a pointer kept in an alloca, as at -O0, if all stored ones are inputs
+    if (const auto *li = dyn_cast<LoadInst>(base)) {
+      const auto *ai = dyn_cast<AllocaInst>(getBase(li->getPointerOperand()));
+      if (!ai || !isOwnAlloca(ai, f) || clobbered.count(ai))
+        return false;
+      for (const auto *si : stores[ai]) {
+        if (!si->getValueOperand()->getType()->isPointerTy() ||
+            !isInput(si->getValueOperand()))
+          return false;
+      }
+      return true;
+    }
+    return false;
+  }
+};
+
+bool hasMemoizableResult(const Function &f) {
+  Type *t = f.getReturnType();
+  return t->isIntegerTy() ? t->getIntegerBitWidth() <= 64
+                          : t->isPointerTy() || t->isFloatTy() ||
+                                t->isDoubleTy();
+}
+
+/// Checks the instructions of f, assuming the defined functions in
+/// candidates are memoizable. The globals read are added to globals.
+bool isMemoizable(const Function &f,
+                  const std::map<const Function *,
+                                 std::set<const GlobalVariable *>> &candidates,
+                  std::set<const GlobalVariable *> &globals) {
+  InputPointers inputs(f);
+  for (const auto &i : instructions(f)) {
+    if (const auto *li = dyn_cast<LoadInst>(&i)) {
+      if (li->isVolatile() || !li->isUnordered() ||
+          !inputs.isInput(li->getPointerOperand()))
+        return false;
+    } else if (const auto *si = dyn_cast<StoreInst>(&i)) {
+      if (si->isVolatile() || !si->isUnordered() ||
+          !isOwnAlloca(getBase(si->getPointerOperand()), f))
+        return false;
+    } else if (const auto *cb = dyn_cast<CallBase>(&i)) {
+      if (isa<DbgInfoIntrinsic>(cb) || cb->isLifetimeStartOrEnd())
+        continue;
+      if (const auto *mi = dyn_cast<MemIntrinsic>(cb)) {
+        if (mi->isVolatile() || !isOwnAlloca(getBase(mi->getDest()), f))
+          return false;
+        if (const auto *mt = dyn_cast<MemTransferInst>(mi))
+          if (!inputs.isInput(mt->getSource()))
+            return false;
+        continue;
+      }
+      const Function *callee = cb->getCalledFunction();
+      if (!callee || isa<InvokeInst>(cb))
+        return false;
+      if (callee->isIntrinsic()) {
+        if (!cb->doesNotAccessMemory())
+          return false;
+        continue;
+      }
+      auto it = candidates.find(callee);
+      if (it == candidates.end())
+        return false;
+      // the callee reads through its pointer arguments
+      for (const auto &arg : cb->args())
+        if (arg->getType()->isPointerTy() && !inputs.isInput(arg))
+          return false;
+      globals.insert(it->second.begin(), it->second.end());
+    } else if (i.mayReadOrWriteMemory() || isa<VAArgInst>(&i)) {
+      // atomics, fences and the like
+      return false;
+    }
+  }
+  globals.insert(inputs.globals.begin(), inputs.globals.end());
+  return true;
+}
+
+} // namespace
+
+bool MemoizableFunctionsPass::runOnModule(Module &M) {
+  memoizableFunctions.clear();
+
+  std::map<const Function *, std::set<const GlobalVariable *>> candidates;
+  for (const auto &f : M)
+    if (!f.isDeclaration() && !f.isVarArg() && hasMemoizableResult(f))
+      candidates[&f];
+
+  // drop the functions calling others that are not memoizable until none
+  // is dropped, the globals read grow with those of the callees
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (auto it = candidates.begin(); it != candidates.end();) {
+      std::set<const GlobalVariable *> globals;
+      if (!isMemoizable(*it->first, candidates, globals)) {
+        it = candidates.erase(it);
+        changed = true;
+        continue;
+      }
+      if (globals.size() != it->second.size()) {
+        it->second = std::move(globals);
+        changed = true;
+      }
+      ++it;
+    }
+  }
+
+  for (const auto &c : candidates)
+    memoizableFunctions.emplace(
+        c.first,
+        std::vector<const GlobalVariable *>(c.second.begin(), c.second.end()));
+
+  // this is an analysis, the module is not modified
+  return false;
+}
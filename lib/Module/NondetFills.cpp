@@ -0,0 +1,70 @@
+//===-- NondetFills.cpp ---------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "Passes.h"
+
+#include "llvm/IR/DataLayout.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Operator.h"
+
+using namespace llvm;
+using namespace klee;
+
+char NondetFillsPass::ID;
+
+namespace {
+
+/// Whether the function makes a nondet integer of whole bytes.
+bool isNondetScalar(const Function *f, const DataLayout &DL) {
+  if (!f || !f->getName().startswith("__VERIFIER_nondet_"))
+    return false;
+  Type *t = f->getReturnType();
+  return t->isIntegerTy() && DL.getTypeSizeInBits(t) % 8 == 0 &&
+         DL.getTypeSizeInBits(t) <= 64;
+}
+
+/// Whether the address is that of an element of a buffer at a variable
+/// index, as in a loop over the buffer.
+bool isVariableElement(const Value *address) {
+  const auto *gep = dyn_cast<GEPOperator>(address);
+  if (!gep)
+    return false;
+  for (const auto &index : gep->indices())
+    if (!isa<Constant>(index))
+      return true;
+  return false;
+}
+
+} // namespace
+
+bool NondetFillsPass::runOnModule(Module &M) {
+  nondetFills.clear();
+  const DataLayout &DL = M.getDataLayout();
+
+  for (const auto &f : M) {
+    for (const auto &i : instructions(f)) {
+      const auto *call = dyn_cast<CallInst>(&i);
+      if (!call || !isNondetScalar(call->getCalledFunction(), DL) ||
+          !call->hasOneUse())
+        continue;
+      // the value is stored as it is, into the element of a buffer
+      const auto *store = dyn_cast<StoreInst>(*call->user_begin());
+      if (!store || store->getValueOperand() != call || store->isVolatile() ||
+          !isVariableElement(store->getPointerOperand()))
+        continue;
+      nondetFills.insert(call);
+      nondetFills.insert(store);
+    }
+  }
+
+  // this is an analysis, the module is not modified
+  return false;
+}
@@ -272,4 +272,13 @@ void Optimize(Module *M, llvm::ArrayRef<const char *> preservedFunctions) {
   // Run our queue of passes all at once now, efficiently.
   Passes.run(*M);
 }
+
+/// Describes the options of Optimize, for the key of --module-cache.
+std::string OptimizeOptions() {
+  std::string options;
+  raw_string_ostream os(options);
+  os << "inline=" << !DisableInline << " internalize=" << !DisableInternalize
+     << " strip=" << Strip << " strip-debug=" << StripDebug;
+  return os.str();
+}
 }
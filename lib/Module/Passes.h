@@ -11,6 +11,7 @@
 #define KLEE_PASSES_H
 
 #include "klee/Config/Version.h"
+#include "klee/Module/KModule.h"
 
 #include "llvm/ADT/Triple.h"
 #include "llvm/CodeGen/IntrinsicLowering.h"
@@ -19,6 +20,11 @@
 #include "llvm/IR/Module.h"
 #include "llvm/Pass.h"
 
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
 namespace llvm {
 class Function;
 class Instruction;
@@ -92,6 +98,14 @@ public:
   bool runOnFunction(llvm::Function &f) override;
 };
 
+/// Whether binOp is a division or remainder by a divisor that may be zero and
+/// was not checked before.
+bool needsDivZeroCheck(const llvm::BinaryOperator &binOp);
+
+/// Whether binOp is a shift by an amount that may reach the width of the
+/// shifted value and was not checked before.
+bool needsOvershiftCheck(const llvm::BinaryOperator &binOp);
+
 class DivCheckPass : public llvm::ModulePass {
   static char ID;
 
@@ -177,6 +191,9 @@ public:
   FunctionAliasPass() : llvm::ModulePass(ID) {}
   bool runOnModule(llvm::Module &M) override;
 
+  /// The aliases given by --function-alias.
+  static const std::vector<std::string> &getAliases();
+
 private:
   static const llvm::FunctionType *getFunctionType(const llvm::GlobalValue *gv);
   static bool checkType(const llvm::GlobalValue *match, const llvm::GlobalValue *replacement);
@@ -192,6 +209,98 @@ public:
   OptNonePass() : llvm::ModulePass(ID) {}
   bool runOnModule(llvm::Module &M) override;
 };
+
+/// PointerFreeAllocationsPass - Collects the allocas and globals whose
+/// address does not escape and into which only values that cannot hold a
+/// pointer are ever stored. The memory of these allocation sites never
+/// needs a segment plane. The module is not modified.
+class PointerFreeAllocationsPass : public llvm::ModulePass {
+  std::set<const llvm::Value *> &pointerFreeSites;
+
+public:
+  static char ID;
+  PointerFreeAllocationsPass(std::set<const llvm::Value *> &pointerFreeSites)
+      : llvm::ModulePass(ID), pointerFreeSites(pointerFreeSites) {}
+  bool runOnModule(llvm::Module &M) override;
+};
+
+/// InBoundsAccessesPass - Collects the loads and stores whose address is a
+/// constant offset into an alloca or a defined global of fixed size, at
+/// which the whole access lies in bounds. The executor skips their bounds
+/// checks. The module is not modified.
+class InBoundsAccessesPass : public llvm::ModulePass {
+  std::set<const llvm::Instruction *> &inBoundsAccesses;
+
+public:
+  static char ID;
+  InBoundsAccessesPass(std::set<const llvm::Instruction *> &inBoundsAccesses)
+      : llvm::ModulePass(ID), inBoundsAccesses(inBoundsAccesses) {}
+  bool runOnModule(llvm::Module &M) override;
+};
+
+/// MemoizableFunctionsPass - Collects the defined functions whose result
+/// only depends on their arguments and on the memory they read: the objects
+/// of their pointer arguments and the non-constant globals listed with them.
+/// They store only into their own allocas and call only each other. The
+/// module is not modified.
+class MemoizableFunctionsPass : public llvm::ModulePass {
+  std::map<const llvm::Function *, std::vector<const llvm::GlobalVariable *>>
+      &memoizableFunctions;
+
+public:
+  static char ID;
+  MemoizableFunctionsPass(
+      std::map<const llvm::Function *,
+               std::vector<const llvm::GlobalVariable *>> &memoizableFunctions)
+      : llvm::ModulePass(ID), memoizableFunctions(memoizableFunctions) {}
+  bool runOnModule(llvm::Module &M) override;
+};
+
+/// NondetFillsPass - Collects the calls of __VERIFIER_nondet functions
+/// making integers, whose value is stored into the element of a buffer at a
+/// variable index, together with these stores. The executor reads the
+/// values of such a call site that fill a buffer element by element from
+/// one array. The module is not modified.
+class NondetFillsPass : public llvm::ModulePass {
+  std::set<const llvm::Instruction *> &nondetFills;
+
+public:
+  static char ID;
+  NondetFillsPass(std::set<const llvm::Instruction *> &nondetFills)
+      : llvm::ModulePass(ID), nondetFills(nondetFills) {}
+  bool runOnModule(llvm::Module &M) override;
+};
+
+/// SlicingPass - Removes the instructions that cannot influence whether a
+/// call of an error function or of a check of the runtime is reached, or the
+/// checks of the executor with --check-mode=native, nor the arguments of
+/// these. The calls of external functions that may write into memory or end
+/// the path and the exits of loops stay, memory errors of the removed
+/// accesses are not found.
+class SlicingPass : public llvm::ModulePass {
+  std::set<std::string> errorFunctions;
+  uint8_t nativeChecks;
+
+public:
+  static char ID;
+  SlicingPass(std::set<std::string> errorFunctions, uint8_t nativeChecks)
+      : llvm::ModulePass(ID), errorFunctions(std::move(errorFunctions)),
+        nativeChecks(nativeChecks) {}
+  bool runOnModule(llvm::Module &M) override;
+};
+
+/// LoopSummaryPass - Collects the innermost loops that only count, whose
+/// iterations the executor can replace by their closed form (see
+/// LoopSummary). The module is not modified.
+class LoopSummaryPass : public llvm::ModulePass {
+  std::map<const llvm::BasicBlock *, LoopSummary> &summaries;
+
+public:
+  static char ID;
+  LoopSummaryPass(std::map<const llvm::BasicBlock *, LoopSummary> &summaries)
+      : llvm::ModulePass(ID), summaries(summaries) {}
+  bool runOnModule(llvm::Module &M) override;
+};
 } // namespace klee
 
 #endif /* KLEE_PASSES_H */
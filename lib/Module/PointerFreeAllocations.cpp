@@ -0,0 +1,223 @@
+//===-- PointerFreeAllocations.cpp ----------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "Passes.h"
+
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/GlobalVariable.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Operator.h"
+
+#include <map>
+#include <vector>
+
+using namespace llvm;
+using namespace klee;
+
+char PointerFreeAllocationsPass::ID;
+
+namespace {
+
+/// The loads from an allocation site (alloca or global) whose address is
+/// only used to load from and store into it.
+typedef std::vector<const LoadInst *> SiteLoads;
+
+/// Collects the loads through the (casted or offset) address of an
+/// allocation site. Returns false if the address escapes.
+bool collectSiteUses(const Value *address, SiteLoads &loads) {
+  for (const User *user : address->users()) {
+    if (const auto *load = dyn_cast<LoadInst>(user)) {
+      loads.push_back(load);
+    } else if (const auto *store = dyn_cast<StoreInst>(user)) {
+      // storing the address itself makes it escape
+      if (store->getValueOperand() == address)
+        return false;
+    } else if (isa<GetElementPtrInst>(user) || isa<BitCastInst>(user)) {
+      if (!collectSiteUses(user, loads))
+        return false;
+    } else if (const auto *ce = dyn_cast<ConstantExpr>(user)) {
+      if (ce->getOpcode() != Instruction::GetElementPtr &&
+          ce->getOpcode() != Instruction::BitCast)
+        return false;
+      if (!collectSiteUses(ce, loads))
+        return false;
+    } else if (const auto *ii = dyn_cast<IntrinsicInst>(user)) {
+      switch (ii->getIntrinsicID()) {
+      case Intrinsic::lifetime_start:
+      case Intrinsic::lifetime_end:
+      case Intrinsic::dbg_declare:
+      case Intrinsic::dbg_value:
+        break;
+      default:
+        return false;
+      }
+    } else if (!isa<ICmpInst>(user)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/// Strips the casts and offsets from an address computed from an
+/// allocation site.
+const Value *getSite(const Value *address) {
+  while (true) {
+    if (const auto *gep = dyn_cast<GEPOperator>(address))
+      address = gep->getPointerOperand();
+    else if (const auto *bc = dyn_cast<BitCastOperator>(address))
+      address = bc->getOperand(0);
+    else
+      return address;
+  }
+}
+
+/// Constants that cannot carry a (nonzero) segment.
+bool isPointerFreeConstant(const Constant *c) {
+  if (isa<ConstantInt>(c) || isa<ConstantFP>(c) || isa<UndefValue>(c) ||
+      isa<ConstantAggregateZero>(c) || isa<ConstantPointerNull>(c) ||
+      isa<ConstantDataSequential>(c))
+    return true;
+  if (isa<ConstantAggregate>(c)) {
+    for (const Use &op : c->operands())
+      if (!isPointerFreeConstant(cast<Constant>(op)))
+        return false;
+    return true;
+  }
+  return false;
+}
+
+/// Instructions whose result may only carry a segment if an operand does.
+bool propagatesSegments(const Instruction &i) {
+  if (isa<BinaryOperator>(i) || isa<UnaryOperator>(i) || isa<SelectInst>(i) ||
+      isa<PHINode>(i) || isa<ExtractElementInst>(i) ||
+      isa<InsertElementInst>(i) || isa<ShuffleVectorInst>(i) ||
+      isa<ExtractValueInst>(i) || isa<InsertValueInst>(i) ||
+      isa<FreezeInst>(i))
+    return true;
+  if (const auto *cast = dyn_cast<CastInst>(&i))
+    return cast->getOpcode() != Instruction::PtrToInt &&
+           cast->getOpcode() != Instruction::IntToPtr &&
+           !cast->getSrcTy()->isPtrOrPtrVectorTy();
+  return false;
+}
+
+/// Non-pointer results of the nondeterministic value generators have
+/// segment 0.
+bool isNondetCall(const Instruction &i) {
+  const auto *call = dyn_cast<CallInst>(&i);
+  if (!call || call->getType()->isPtrOrPtrVectorTy())
+    return false;
+  const Function *f = call->getCalledFunction();
+  return f && f->getName().startswith("__VERIFIER_nondet_");
+}
+
+} // namespace
+
+bool PointerFreeAllocationsPass::runOnModule(Module &M) {
+  pointerFreeSites.clear();
+
+  // candidate sites whose address does not escape
+  std::map<const Value *, SiteLoads> sites;
+  for (const auto &gv : M.globals()) {
+    if (!gv.hasInitializer() || !isPointerFreeConstant(gv.getInitializer()))
+      continue;
+    SiteLoads loads;
+    if (collectSiteUses(&gv, loads))
+      sites.emplace(&gv, std::move(loads));
+  }
+  for (const auto &f : M) {
+    for (const auto &i : instructions(f)) {
+      const auto *ai = dyn_cast<AllocaInst>(&i);
+      if (!ai)
+        continue;
+      SiteLoads loads;
+      if (collectSiteUses(ai, loads))
+        sites.emplace(ai, std::move(loads));
+    }
+  }
+
+  // Compute the set of values that may carry a segment. Seed it with the
+  // results of all instructions that do not just propagate segments, except
+  // for loads from candidate sites which we decide on below.
+  std::set<const Value *> mayHoldPointer;
+  std::vector<const Value *> worklist;
+  auto markValue = [&](const Value *v) {
+    if (mayHoldPointer.insert(v).second)
+      worklist.push_back(v);
+  };
+  auto removeSite = [&](const Value *site) {
+    auto it = sites.find(site);
+    if (it == sites.end())
+      return;
+    for (const LoadInst *load : it->second)
+      markValue(load);
+    sites.erase(it);
+  };
+
+  for (const auto &f : M) {
+    for (const auto &i : instructions(f)) {
+      if (i.getType()->isVoidTy() || isNondetCall(i) || isa<CmpInst>(i))
+        continue;
+      if (const auto *load = dyn_cast<LoadInst>(&i)) {
+        if (!sites.count(getSite(load->getPointerOperand())))
+          markValue(load);
+        continue;
+      }
+      if (!propagatesSegments(i)) {
+        markValue(&i);
+        continue;
+      }
+      for (const Use &op : i.operands()) {
+        const Value *v = op.get();
+        if (isa<Argument>(v) ||
+            (isa<Constant>(v) && !isPointerFreeConstant(cast<Constant>(v)))) {
+          markValue(&i);
+          break;
+        }
+      }
+    }
+  }
+
+  // stores of values that may carry a segment disqualify their site
+  for (const auto &f : M) {
+    for (const auto &i : instructions(f)) {
+      const auto *store = dyn_cast<StoreInst>(&i);
+      if (!store)
+        continue;
+      const Value *v = store->getValueOperand();
+      if (isa<Argument>(v) ||
+          (isa<Constant>(v) && !isPointerFreeConstant(cast<Constant>(v))))
+        removeSite(getSite(store->getPointerOperand()));
+    }
+  }
+
+  while (!worklist.empty()) {
+    const Value *v = worklist.back();
+    worklist.pop_back();
+    for (const User *user : v->users()) {
+      if (const auto *store = dyn_cast<StoreInst>(user)) {
+        if (store->getValueOperand() == v)
+          removeSite(getSite(store->getPointerOperand()));
+      } else if (const auto *i = dyn_cast<Instruction>(user)) {
+        if (propagatesSegments(*i))
+          markValue(i);
+      }
+    }
+  }
+
+  for (const auto &site : sites)
+    pointerFreeSites.insert(site.first);
+
+  // this is an analysis, the module is not modified
+  return false;
+}
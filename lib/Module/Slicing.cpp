@@ -0,0 +1,350 @@
+//===-- Slicing.cpp -------------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "Passes.h"
+
+#include "klee/Module/KInstruction.h"
+#include "klee/Support/ErrorHandling.h"
+
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/PostDominators.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/GlobalVariable.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Operator.h"
+#include "llvm/Transforms/Utils/Local.h"
+
+#include <map>
+#include <vector>
+
+using namespace llvm;
+using namespace klee;
+
+char SlicingPass::ID;
+
+namespace {
+
+/// Functions that only print, whose calls are removed unless their results
+/// are needed.
+const char *const OutputFunctions[] = {
+    "printf",  "puts",   "putchar",      "fprintf",          "fputs",
+    "fputc",   "fflush", "klee_warning", "klee_warning_once", "klee_print_expr",
+};
+
+/// External functions that write into the memory they are pointed to
+/// without reading it.
+const char *const WriteOnlyFunctions[] = {"klee_make_symbolic"};
+
+/// Strips the casts and constant or variable offsets from an address. In
+/// the memory model of the executor an address cannot be offset from one
+/// object into another, so an access through the result reaches the same
+/// object as one through the address.
+const Value *getSite(const Value *address) {
+  while (true) {
+    if (const auto *gep = dyn_cast<GEPOperator>(address))
+      address = gep->getPointerOperand();
+    else if (const auto *bc = dyn_cast<BitCastOperator>(address))
+      address = bc->getOperand(0);
+    else
+      return address;
+  }
+}
+
+/// Whether the (casted or offset) address of an allocation site is only
+/// used to load from and store into it. Converting it to an integer makes
+/// it escape, as the executor keeps its segment in the integer.
+bool isLocalSite(const Value *address) {
+  for (const User *user : address->users()) {
+    if (isa<LoadInst>(user) || isa<ICmpInst>(user))
+      continue;
+    if (const auto *store = dyn_cast<StoreInst>(user)) {
+      if (store->getValueOperand() == address)
+        return false;
+    } else if (isa<GEPOperator>(user) || isa<BitCastOperator>(user)) {
+      if (!isLocalSite(user))
+        return false;
+    } else if (const auto *ii = dyn_cast<IntrinsicInst>(user)) {
+      if (!ii->isLifetimeStartOrEnd() && !isa<DbgInfoIntrinsic>(ii))
+        return false;
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+class Slicer {
+  Module &module;
+  const std::set<std::string> &errorFunctions;
+  uint8_t nativeChecks;
+
+  /// The memory classes: the allocation sites whose address does not
+  /// escape, and nullptr for all other memory.
+  std::map<const Value *, bool> localSites;
+  /// The instructions that may write into each memory class.
+  std::map<const Value *, std::vector<const Instruction *>> writers;
+
+  std::map<const Function *, std::vector<const CallBase *>> callSites;
+  std::map<const Function *, std::vector<const ReturnInst *>> returns;
+  /// The terminators each block is control dependent on.
+  std::map<const BasicBlock *, std::vector<const Instruction *>> controlDeps;
+  /// The block the terminator of a block is replaced by a branch to when
+  /// the terminator is not in the slice, its immediate post-dominator.
+  std::map<const BasicBlock *, BasicBlock *> bypasses;
+
+  std::set<const Instruction *> slice;
+  std::set<const Function *> sliceFunctions;
+  std::vector<const Instruction *> worklist;
+
+public:
+  Slicer(Module &module, const std::set<std::string> &errorFunctions,
+         uint8_t nativeChecks)
+      : module(module), errorFunctions(errorFunctions),
+        nativeChecks(nativeChecks) {}
+
+  /// Returns the number of removed instructions.
+  unsigned run();
+
+private:
+  const Value *getMemoryClass(const Value *address);
+  void analyzeFunction(Function &f);
+  bool isCriterion(const Instruction &i) const;
+  void add(const Value *v);
+  void addReaders(const Value *address);
+  void visit(const Instruction &i);
+  unsigned removeUnsliced(Function &f);
+};
+
+const Value *Slicer::getMemoryClass(const Value *address) {
+  const Value *site = getSite(address);
+  if (!isa<AllocaInst>(site) &&
+      !(isa<GlobalVariable>(site) &&
+        cast<GlobalVariable>(site)->hasDefinitiveInitializer()))
+    return nullptr;
+  auto it = localSites.find(site);
+  if (it == localSites.end())
+    it = localSites.emplace(site, isLocalSite(site)).first;
+  return it->second ? site : nullptr;
+}
+
+void Slicer::analyzeFunction(Function &f) {
+  PostDominatorTree pdt(f);
+  DominatorTree dt(f);
+  LoopInfo loops(dt);
+
+  for (BasicBlock &bb : f) {
+    const Instruction *term = bb.getTerminator();
+    if (isa<ReturnInst>(term))
+      returns[&f].push_back(cast<ReturnInst>(term));
+    if (term->getNumSuccessors() < 2)
+      continue;
+
+    // The blocks on the paths from a successor up to the immediate
+    // post-dominator of bb are control dependent on its terminator.
+    DomTreeNode *node = pdt.getNode(&bb);
+    DomTreeNode *ipdom = node ? node->getIDom() : nullptr;
+    for (const BasicBlock *succ : successors(&bb)) {
+      for (DomTreeNode *n = pdt.getNode(succ); n && n != ipdom && n->getBlock();
+           n = n->getIDom())
+        controlDeps[n->getBlock()].push_back(term);
+    }
+
+    // Exits from loops stay, so that the slice does not end loops that do
+    // not terminate. Terminators that cannot be replaced by a branch to
+    // their post-dominator stay as well.
+    const Loop *loop = loops.getLoopFor(&bb);
+    if (!isa<BranchInst>(term) && !isa<SwitchInst>(term))
+      worklist.push_back(term);
+    else if ((loop && loop->isLoopExiting(&bb)) || !ipdom || !ipdom->getBlock())
+      worklist.push_back(term);
+    else
+      bypasses[&bb] = ipdom->getBlock();
+  }
+}
+
+bool Slicer::isCriterion(const Instruction &i) const {
+  if (const auto *binOp = dyn_cast<BinaryOperator>(&i))
+    return ((nativeChecks & KInstruction::CheckDivZero) &&
+            needsDivZeroCheck(*binOp)) ||
+           ((nativeChecks & KInstruction::CheckOvershift) &&
+            needsOvershiftCheck(*binOp));
+
+  if (isa<LandingPadInst>(i) || isa<ResumeInst>(i) || isa<VAArgInst>(i) ||
+      isa<FenceInst>(i) || isa<AtomicRMWInst>(i) || isa<AtomicCmpXchgInst>(i))
+    return true;
+
+  const auto *call = dyn_cast<CallBase>(&i);
+  if (!call)
+    return false;
+  const Function *f = call->getCalledFunction();
+  if (!f || isa<InvokeInst>(call) || call->isInlineAsm())
+    return true;
+  if (errorFunctions.count(f->getName().str()))
+    return true;
+  if (!f->isDeclaration())
+    return false;
+
+  // external calls may write into memory or end the path, unless they only
+  // print or compute their result
+  if (isa<DbgInfoIntrinsic>(call) || call->isLifetimeStartOrEnd())
+    return false;
+  for (const char *name : OutputFunctions)
+    if (f->getName() == name)
+      return false;
+  return !(f->onlyReadsMemory() && f->willReturn());
+}
+
+void Slicer::add(const Value *v) {
+  if (const auto *arg = dyn_cast<Argument>(v)) {
+    // the argument is passed by the call sites, which stay
+    for (const CallBase *call : callSites[arg->getParent()]) {
+      add(call);
+      add(call->getArgOperand(arg->getArgNo()));
+    }
+    return;
+  }
+  const auto *i = dyn_cast<Instruction>(v);
+  if (i && slice.insert(i).second)
+    worklist.push_back(i);
+}
+
+void Slicer::addReaders(const Value *address) {
+  // constants are never written
+  if (const auto *gv = dyn_cast<GlobalVariable>(getSite(address)))
+    if (gv->isConstant())
+      return;
+  const Value *memoryClass = getMemoryClass(address);
+  for (const Instruction *writer : writers[memoryClass])
+    add(writer);
+}
+
+void Slicer::visit(const Instruction &i) {
+  const Function *f = i.getFunction();
+  if (sliceFunctions.insert(f).second) {
+    // the function has to be called for i to execute
+    for (const CallBase *call : callSites[f])
+      add(call);
+  }
+
+  // the arguments of a defined function are added with its formals
+  const auto *call = dyn_cast<CallBase>(&i);
+  const Function *callee = call ? call->getCalledFunction() : nullptr;
+  if (callee && !callee->isDeclaration()) {
+    for (const ReturnInst *ret : returns[callee])
+      add(ret);
+  } else {
+    for (const Use &op : i.operands())
+      add(op.get());
+  }
+  for (const Instruction *term : controlDeps[i.getParent()])
+    add(term);
+
+  if (const auto *phi = dyn_cast<PHINode>(&i)) {
+    // the edge the block was entered by selects the value
+    for (const BasicBlock *pred : phi->blocks())
+      add(pred->getTerminator());
+  } else if (const auto *load = dyn_cast<LoadInst>(&i)) {
+    addReaders(load->getPointerOperand());
+  } else if (const auto *transfer = dyn_cast<MemTransferInst>(&i)) {
+    addReaders(transfer->getRawSource());
+  } else if (call && !isa<MemIntrinsic>(call) &&
+             !(callee && !callee->isDeclaration())) {
+    // external and indirect calls may read what they are pointed to
+    if (callee && (callee->doesNotAccessMemory() ||
+                   llvm::is_contained(WriteOnlyFunctions, callee->getName())))
+      return;
+    for (const Use &arg : call->args())
+      if (arg->getType()->isPointerTy())
+        addReaders(arg.get());
+  }
+}
+
+unsigned Slicer::removeUnsliced(Function &f) {
+  std::vector<Instruction *> removed;
+  for (Instruction &i : instructions(f))
+    if (!i.isTerminator() && !slice.count(&i))
+      removed.push_back(&i);
+  for (Instruction *i : removed)
+    if (!i->use_empty())
+      i->replaceAllUsesWith(UndefValue::get(i->getType()));
+  unsigned count = removed.size();
+  for (Instruction *i : removed)
+    i->eraseFromParent();
+
+  // Branches not in the slice go to their post-dominator directly. The
+  // blocks in between do not hold any instruction of the slice and the phi
+  // nodes of the post-dominator are not in it either.
+  for (BasicBlock &bb : f) {
+    Instruction *term = bb.getTerminator();
+    auto it = bypasses.find(&bb);
+    if (slice.count(term) || it == bypasses.end())
+      continue;
+    for (BasicBlock *succ : successors(&bb))
+      if (succ != it->second)
+        succ->removePredecessor(&bb);
+    BranchInst::Create(it->second, term);
+    term->eraseFromParent();
+    ++count;
+  }
+  removeUnreachableBlocks(f);
+  return count;
+}
+
+unsigned Slicer::run() {
+  for (Function &f : module) {
+    if (f.isDeclaration())
+      continue;
+    analyzeFunction(f);
+    for (Instruction &i : instructions(f)) {
+      if (auto *call = dyn_cast<CallBase>(&i))
+        if (const Function *callee = call->getCalledFunction())
+          callSites[callee].push_back(call);
+      if (const auto *store = dyn_cast<StoreInst>(&i))
+        writers[getMemoryClass(store->getPointerOperand())].push_back(store);
+      else if (const auto *mem = dyn_cast<MemIntrinsic>(&i))
+        writers[getMemoryClass(mem->getRawDest())].push_back(mem);
+      if (isCriterion(i))
+        worklist.push_back(&i);
+    }
+  }
+
+  // the values returned to unknown callers stay
+  for (const Function &f : module)
+    if (f.hasAddressTaken())
+      for (const ReturnInst *ret : returns[&f])
+        worklist.push_back(ret);
+
+  for (const Instruction *i : worklist)
+    slice.insert(i);
+  while (!worklist.empty()) {
+    const Instruction *i = worklist.back();
+    worklist.pop_back();
+    visit(*i);
+  }
+
+  unsigned removed = 0;
+  for (Function &f : module)
+    if (!f.isDeclaration())
+      removed += removeUnsliced(f);
+  return removed;
+}
+
+} // namespace
+
+bool SlicingPass::runOnModule(Module &M) {
+  unsigned total = M.getInstructionCount();
+  unsigned removed = Slicer(M, errorFunctions, nativeChecks).run();
+  klee_message("Slicing removed %u of %u instructions", removed, total);
+  return removed != 0;
+}
@@ -0,0 +1,67 @@
+//===-- BinaryQueryLoggingSolver.cpp --------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "QueryLoggingSolver.h"
+
+#include "klee/Expr/BinaryQueryLog.h"
+#include "klee/Expr/Expr.h"
+#include "klee/System/Time.h"
+
+using namespace klee;
+
+/// Logs queries in the binary query log format, which kleaver reads like
+/// .kquery files. The comment lines the other logging solvers write are
+/// kept with each query. When queries are logged before calling the
+/// solver, only the lines preceding the query are kept.
+class BinaryQueryLoggingSolver : public QueryLoggingSolver {
+  BinaryQueryLogWriter writer;
+  /// The query being logged, which is written with its comment.
+  LoggedQuery pending;
+  bool hasPending = false;
+
+  void printQuery(const Query &query, const Query *falseQuery = 0,
+                  const std::vector<const Array *> *objects = 0) override {
+    const Query *q = falseQuery ? falseQuery : &query;
+    pending = LoggedQuery();
+    pending.constraints.assign(q->constraints.begin(), q->constraints.end());
+    pending.expr = q->expr;
+    if (falseQuery)
+      pending.values.push_back(query.expr);
+    if (objects)
+      pending.objects = *objects;
+    hasPending = true;
+  }
+
+  void flushBufferConditionally(bool writeToFile) override {
+    logBuffer.flush();
+    if (writeToFile && hasPending) {
+      pending.comment = BufferString;
+      writer.writeQuery(pending);
+      os->flush();
+    }
+    hasPending = false;
+    pending = LoggedQuery();
+    BufferString = "";
+  }
+
+public:
+  BinaryQueryLoggingSolver(Solver *_solver, std::string path,
+                           time::Span queryTimeToLog, bool logTimedOut)
+      : QueryLoggingSolver(_solver, path, "#", queryTimeToLog, logTimedOut),
+        writer(*os) {}
+};
+
+///
+
+Solver *klee::createBinaryQueryLoggingSolver(Solver *_solver, std::string path,
+                                             time::Span minQueryTimeToLog,
+                                             bool logTimedOut) {
+  return new Solver(new BinaryQueryLoggingSolver(_solver, path,
+                                                 minQueryTimeToLog, logTimedOut));
+}
@@ -0,0 +1,413 @@
+//===-- BitwuzlaBuilder.cpp ------------------------------------*- C++ -*-====//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+#include "klee/Config/config.h"
+#ifdef ENABLE_BITWUZLA
+#include "BitwuzlaBuilder.h"
+
+#include "klee/ADT/Bits.h"
+#include "klee/Expr/Expr.h"
+#include "klee/Solver/SolverStats.h"
+
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/ADT/iterator_range.h"
+
+using namespace klee;
+
+BitwuzlaBuilder::BitwuzlaBuilder() : tm(bitwuzla_term_manager_new()) {}
+
+BitwuzlaBuilder::~BitwuzlaBuilder() {
+  // all terms and sorts are released with their manager
+  clearConstructCache();
+  arrayHash._array_hash.clear();
+  bitwuzla_term_manager_delete(tm);
+}
+
+void BitwuzlaBuilder::clearConstructCache() {
+  constructed.clear();
+  arrayHash._update_node_hash.clear();
+}
+
+BitwuzlaSort BitwuzlaBuilder::getBvSort(unsigned width) {
+  return bitwuzla_mk_bv_sort(tm, width);
+}
+
+BitwuzlaTerm BitwuzlaBuilder::getTrue() { return bitwuzla_mk_true(tm); }
+
+BitwuzlaTerm BitwuzlaBuilder::getFalse() { return bitwuzla_mk_false(tm); }
+
+BitwuzlaTerm BitwuzlaBuilder::bvConst64(unsigned width, uint64_t value) {
+  assert(width <= 64 && "constant too wide");
+  return bitwuzla_mk_bv_value_uint64(tm, getBvSort(width),
+                                     value & bits64::maxValueOfNBits(width));
+}
+
+BitwuzlaTerm BitwuzlaBuilder::bvZero(unsigned width) {
+  return bitwuzla_mk_bv_zero(tm, getBvSort(width));
+}
+
+BitwuzlaTerm BitwuzlaBuilder::bvOne(unsigned width) {
+  return bitwuzla_mk_bv_one(tm, getBvSort(width));
+}
+
+BitwuzlaTerm BitwuzlaBuilder::bvMinusOne(unsigned width) {
+  return bitwuzla_mk_bv_ones(tm, getBvSort(width));
+}
+
+BitwuzlaTerm BitwuzlaBuilder::bvExtract(BitwuzlaTerm expr, unsigned top,
+                                        unsigned bottom) {
+  return bitwuzla_mk_term1_indexed2(tm, BITWUZLA_KIND_BV_EXTRACT, expr, top,
+                                    bottom);
+}
+
+BitwuzlaTerm BitwuzlaBuilder::bvBoolExtract(BitwuzlaTerm expr, unsigned bit) {
+  return term(BITWUZLA_KIND_EQUAL, bvExtract(expr, bit, bit), bvOne(1));
+}
+
+BitwuzlaTerm BitwuzlaBuilder::ite(BitwuzlaTerm condition,
+                                  BitwuzlaTerm whenTrue,
+                                  BitwuzlaTerm whenFalse) {
+  return bitwuzla_mk_term3(tm, BITWUZLA_KIND_ITE, condition, whenTrue,
+                           whenFalse);
+}
+
+BitwuzlaTerm BitwuzlaBuilder::term(BitwuzlaKind kind, BitwuzlaTerm arg) {
+  return bitwuzla_mk_term1(tm, kind, arg);
+}
+
+BitwuzlaTerm BitwuzlaBuilder::term(BitwuzlaKind kind, BitwuzlaTerm lhs,
+                                   BitwuzlaTerm rhs) {
+  return bitwuzla_mk_term2(tm, kind, lhs, rhs);
+}
+
+BitwuzlaTerm BitwuzlaBuilder::varShift(BitwuzlaKind kind, BitwuzlaTerm expr,
+                                       BitwuzlaTerm shift, unsigned width) {
+  // bvshl and bvlshr are zero on overshifts already, bvashr is not
+  BitwuzlaTerm res = term(kind, expr, shift);
+  if (kind != BITWUZLA_KIND_BV_ASHR)
+    return res;
+  BitwuzlaTerm inRange = term(BITWUZLA_KIND_BV_ULT, shift,
+                              width <= 64 ? bvConst64(width, width)
+                                          : construct(ConstantExpr::create(
+                                                width, width)));
+  return ite(inRange, res, bvZero(width));
+}
+
+BitwuzlaTerm BitwuzlaBuilder::getInitialArray(const Array *root) {
+  assert(root);
+  BitwuzlaTerm array;
+  if (arrayHash.lookupArrayExpr(root, array))
+    return array;
+
+  BitwuzlaSort sort = bitwuzla_mk_array_sort(
+      tm, getBvSort(root->getDomain()), getBvSort(root->getRange()));
+  if (root->isConstantArray()) {
+    // stores of the bytes that are not zero on an array of zeros, so that
+    // no constraints on the contents are needed
+    array = bitwuzla_mk_const_array(tm, sort, bvZero(root->getRange()));
+    for (unsigned i = 0, e = root->size; i != e; ++i) {
+      ref<ConstantExpr> value = root->getConstantValue(i);
+      if (value->isZero())
+        continue;
+      array = bitwuzla_mk_term3(tm, BITWUZLA_KIND_ARRAY_STORE, array,
+                                bvConst64(root->getDomain(), i),
+                                construct(value));
+    }
+  } else {
+    // Unique arrays by name, so we make sure the name is unique by
+    // using the size of the array hash as a counter.
+    std::string name =
+        root->name + llvm::utostr(arrayHash._array_hash.size());
+    array = bitwuzla_mk_const(tm, sort, name.c_str());
+  }
+  arrayHash.hashArrayExpr(root, array);
+  return array;
+}
+
+BitwuzlaTerm BitwuzlaBuilder::getInitialRead(const Array *root,
+                                             unsigned index) {
+  return term(BITWUZLA_KIND_ARRAY_SELECT, getInitialArray(root),
+              bvConst64(root->getDomain(), index));
+}
+
+BitwuzlaTerm BitwuzlaBuilder::getArrayForUpdate(const Array *root,
+                                                const UpdateNode *un) {
+  // Iterate over the update nodes, until we find a cached version of the node,
+  // or no more update nodes remain
+  BitwuzlaTerm array;
+  std::vector<const UpdateNode *> updateNodes;
+  for (; un && !arrayHash.lookupUpdateNodeExpr(un, array);
+       un = un->next.get())
+    updateNodes.push_back(un);
+  if (!un)
+    array = getInitialArray(root);
+
+  // Create and cache solver expressions based on the update nodes starting from
+  // the oldest
+  for (const auto &un :
+       llvm::make_range(updateNodes.crbegin(), updateNodes.crend())) {
+    array = bitwuzla_mk_term3(tm, BITWUZLA_KIND_ARRAY_STORE, array,
+                              construct(un->index, nullptr),
+                              construct(un->value, nullptr));
+    arrayHash.hashUpdateNodeExpr(un, array);
+  }
+  return array;
+}
+
+/** if *width_out!=1 then result is a bitvector,
+    otherwise it is a bool */
+BitwuzlaTerm BitwuzlaBuilder::construct(ref<Expr> e, int *width_out) {
+  if (isa<ConstantExpr>(e))
+    return constructActual(e, width_out);
+
+  auto it = constructed.find(e);
+  if (it != constructed.end()) {
+    if (width_out)
+      *width_out = it->second.width;
+    return it->second.term;
+  }
+
+  int width;
+  if (!width_out)
+    width_out = &width;
+  BitwuzlaTerm res = constructActual(e, width_out);
+  constructed[e] = {res, static_cast<unsigned>(*width_out)};
+  return res;
+}
+
+/** if *width_out!=1 then result is a bitvector,
+    otherwise it is a bool */
+BitwuzlaTerm BitwuzlaBuilder::constructActual(ref<Expr> e, int *width_out) {
+  int width;
+  if (!width_out)
+    width_out = &width;
+
+  ++stats::queryConstructs;
+
+  switch (e->getKind()) {
+  case Expr::Constant: {
+    ConstantExpr *CE = cast<ConstantExpr>(e);
+    *width_out = CE->getWidth();
+
+    // Coerce to bool if necessary.
+    if (*width_out == 1)
+      return CE->isTrue() ? getTrue() : getFalse();
+
+    // Fast path.
+    if (*width_out <= 64)
+      return bvConst64(*width_out, CE->getZExtValue());
+
+    ref<ConstantExpr> Tmp = CE;
+    BitwuzlaTerm Res = bvConst64(64, Tmp->Extract(0, 64)->getZExtValue());
+    while (Tmp->getWidth() > 64) {
+      Tmp = Tmp->Extract(64, Tmp->getWidth() - 64);
+      unsigned Width = std::min(64U, Tmp->getWidth());
+      Res = term(BITWUZLA_KIND_BV_CONCAT,
+                 bvConst64(Width, Tmp->Extract(0, Width)->getZExtValue()), Res);
+    }
+    return Res;
+  }
+
+  // Special
+  case Expr::NotOptimized: {
+    NotOptimizedExpr *noe = cast<NotOptimizedExpr>(e);
+    return construct(noe->src, width_out);
+  }
+
+  case Expr::Read: {
+    ReadExpr *re = cast<ReadExpr>(e);
+    assert(re && re->updates.root);
+    *width_out = re->updates.root->getRange();
+    BitwuzlaTerm index = construct(re->index, nullptr);
+    return term(BITWUZLA_KIND_ARRAY_SELECT,
+                getArrayForUpdate(re->updates.root, re->updates.head.get()),
+                index);
+  }
+
+  case Expr::Select: {
+    SelectExpr *se = cast<SelectExpr>(e);
+    BitwuzlaTerm cond = construct(se->cond, nullptr);
+    BitwuzlaTerm tExpr = construct(se->trueExpr, width_out);
+    BitwuzlaTerm fExpr = construct(se->falseExpr, width_out);
+    return ite(cond, tExpr, fExpr);
+  }
+
+  case Expr::Concat: {
+    ConcatExpr *ce = cast<ConcatExpr>(e);
+    unsigned numKids = ce->getNumKids();
+    BitwuzlaTerm res = construct(ce->getKid(numKids - 1), nullptr);
+    for (int i = numKids - 2; i >= 0; i--)
+      res = term(BITWUZLA_KIND_BV_CONCAT, construct(ce->getKid(i), nullptr),
+                 res);
+    *width_out = ce->getWidth();
+    return res;
+  }
+
+  case Expr::Extract: {
+    ExtractExpr *ee = cast<ExtractExpr>(e);
+    BitwuzlaTerm src = construct(ee->expr, width_out);
+    *width_out = ee->getWidth();
+    if (*width_out == 1)
+      return bvBoolExtract(src, ee->offset);
+    return bvExtract(src, ee->offset + *width_out - 1, ee->offset);
+  }
+
+  // Casting
+
+  case Expr::ZExt: {
+    int srcWidth;
+    CastExpr *ce = cast<CastExpr>(e);
+    BitwuzlaTerm src = construct(ce->src, &srcWidth);
+    *width_out = ce->getWidth();
+    if (srcWidth == 1)
+      return ite(src, bvOne(*width_out), bvZero(*width_out));
+    assert(*width_out > srcWidth && "Invalid width_out");
+    return bitwuzla_mk_term1_indexed1(tm, BITWUZLA_KIND_BV_ZERO_EXTEND, src,
+                                      *width_out - srcWidth);
+  }
+
+  case Expr::SExt: {
+    int srcWidth;
+    CastExpr *ce = cast<CastExpr>(e);
+    BitwuzlaTerm src = construct(ce->src, &srcWidth);
+    *width_out = ce->getWidth();
+    if (srcWidth == 1)
+      return ite(src, bvMinusOne(*width_out), bvZero(*width_out));
+    assert(*width_out > srcWidth && "Invalid width_out");
+    return bitwuzla_mk_term1_indexed1(tm, BITWUZLA_KIND_BV_SIGN_EXTEND, src,
+                                      *width_out - srcWidth);
+  }
+
+  // Arithmetic
+  case Expr::Add:
+  case Expr::Sub:
+  case Expr::Mul:
+  case Expr::UDiv:
+  case Expr::SDiv:
+  case Expr::URem:
+  case Expr::SRem: {
+    BinaryExpr *be = cast<BinaryExpr>(e);
+    BitwuzlaTerm left = construct(be->left, width_out);
+    BitwuzlaTerm right = construct(be->right, width_out);
+    assert(*width_out != 1 && "uncanonicalized arithmetic");
+    BitwuzlaKind kind;
+    switch (e->getKind()) {
+    case Expr::Add: kind = BITWUZLA_KIND_BV_ADD; break;
+    case Expr::Sub: kind = BITWUZLA_KIND_BV_SUB; break;
+    case Expr::Mul: kind = BITWUZLA_KIND_BV_MUL; break;
+    case Expr::UDiv: kind = BITWUZLA_KIND_BV_UDIV; break;
+    case Expr::SDiv: kind = BITWUZLA_KIND_BV_SDIV; break;
+    case Expr::URem: kind = BITWUZLA_KIND_BV_UREM; break;
+    // the sign of the remainder follows the dividend, as for LLVM's srem
+    default: kind = BITWUZLA_KIND_BV_SREM; break;
+    }
+    return term(kind, left, right);
+  }
+
+  // Bitwise
+  case Expr::Not: {
+    NotExpr *ne = cast<NotExpr>(e);
+    BitwuzlaTerm expr = construct(ne->expr, width_out);
+    return term(*width_out == 1 ? BITWUZLA_KIND_NOT : BITWUZLA_KIND_BV_NOT,
+                expr);
+  }
+
+  case Expr::And: {
+    AndExpr *ae = cast<AndExpr>(e);
+    BitwuzlaTerm left = construct(ae->left, width_out);
+    BitwuzlaTerm right = construct(ae->right, width_out);
+    return term(*width_out == 1 ? BITWUZLA_KIND_AND : BITWUZLA_KIND_BV_AND,
+                left, right);
+  }
+
+  case Expr::Or: {
+    OrExpr *oe = cast<OrExpr>(e);
+    BitwuzlaTerm left = construct(oe->left, width_out);
+    BitwuzlaTerm right = construct(oe->right, width_out);
+    return term(*width_out == 1 ? BITWUZLA_KIND_OR : BITWUZLA_KIND_BV_OR,
+                left, right);
+  }
+
+  case Expr::Xor: {
+    XorExpr *xe = cast<XorExpr>(e);
+    BitwuzlaTerm left = construct(xe->left, width_out);
+    BitwuzlaTerm right = construct(xe->right, width_out);
+    return term(*width_out == 1 ? BITWUZLA_KIND_XOR : BITWUZLA_KIND_BV_XOR,
+                left, right);
+  }
+
+  case Expr::Shl:
+  case Expr::LShr:
+  case Expr::AShr: {
+    BinaryExpr *be = cast<BinaryExpr>(e);
+    BitwuzlaTerm left = construct(be->left, width_out);
+    assert(*width_out != 1 && "uncanonicalized shift");
+    BitwuzlaKind kind = e->getKind() == Expr::Shl    ? BITWUZLA_KIND_BV_SHL
+                        : e->getKind() == Expr::LShr ? BITWUZLA_KIND_BV_SHR
+                                                     : BITWUZLA_KIND_BV_ASHR;
+
+    if (ConstantExpr *CE = dyn_cast<ConstantExpr>(be->right)) {
+      uint64_t shift = CE->getLimitedValue();
+      if (shift == 0)
+        return left;
+      if (shift >= static_cast<uint64_t>(*width_out))
+        return bvZero(*width_out); // Overshift to zero
+      return term(kind, left, construct(be->right, nullptr));
+    }
+    return varShift(kind, left, construct(be->right, nullptr), *width_out);
+  }
+
+  // Comparison
+
+  case Expr::Eq: {
+    EqExpr *ee = cast<EqExpr>(e);
+    BitwuzlaTerm left = construct(ee->left, width_out);
+    BitwuzlaTerm right = construct(ee->right, width_out);
+    if (*width_out == 1) {
+      if (ConstantExpr *CE = dyn_cast<ConstantExpr>(ee->left)) {
+        if (CE->isTrue())
+          return right;
+        return term(BITWUZLA_KIND_NOT, right);
+      }
+      return term(BITWUZLA_KIND_IFF, left, right);
+    }
+    *width_out = 1;
+    return term(BITWUZLA_KIND_EQUAL, left, right);
+  }
+
+  case Expr::Ult:
+  case Expr::Ule:
+  case Expr::Slt:
+  case Expr::Sle: {
+    CmpExpr *ce = cast<CmpExpr>(e);
+    BitwuzlaTerm left = construct(ce->left, width_out);
+    BitwuzlaTerm right = construct(ce->right, width_out);
+    assert(*width_out != 1 && "uncanonicalized comparison");
+    *width_out = 1;
+    BitwuzlaKind kind = e->getKind() == Expr::Ult   ? BITWUZLA_KIND_BV_ULT
+                        : e->getKind() == Expr::Ule ? BITWUZLA_KIND_BV_ULE
+                        : e->getKind() == Expr::Slt ? BITWUZLA_KIND_BV_SLT
+                                                    : BITWUZLA_KIND_BV_SLE;
+    return term(kind, left, right);
+  }
+
+// unused due to canonicalization
+#if 0
+  case Expr::Ne:
+  case Expr::Ugt:
+  case Expr::Uge:
+  case Expr::Sgt:
+  case Expr::Sge:
+#endif
+
+  default:
+    assert(0 && "unhandled Expr type");
+    return getTrue();
+  }
+}
+#endif // ENABLE_BITWUZLA
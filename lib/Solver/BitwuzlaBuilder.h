@@ -0,0 +1,86 @@
+//===-- BitwuzlaBuilder.h --------------------------------------*- C++ -*-====//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_BITWUZLABUILDER_H
+#define KLEE_BITWUZLABUILDER_H
+
+#include "klee/Config/config.h"
+#include "klee/Expr/ArrayExprHash.h"
+#include "klee/Expr/ExprHashMap.h"
+
+#include <bitwuzla/c/bitwuzla.h>
+
+#include <cstdint>
+
+namespace klee {
+
+class BitwuzlaArrayExprHash : public ArrayExprHash<BitwuzlaTerm> {
+  friend class BitwuzlaBuilder;
+
+public:
+  BitwuzlaArrayExprHash() = default;
+  ~BitwuzlaArrayExprHash() override = default;
+};
+
+/// BitwuzlaBuilder - Constructs Bitwuzla terms from expressions. The terms
+/// belong to the term manager of the builder and are released with it, so
+/// that the same array is the same constant for all queries built with one
+/// builder.
+class BitwuzlaBuilder {
+  struct ConstructedExpr {
+    BitwuzlaTerm term;
+    unsigned width;
+  };
+  ExprHashMap<ConstructedExpr> constructed;
+  BitwuzlaArrayExprHash arrayHash;
+
+  BitwuzlaTerm bvConst64(unsigned width, uint64_t value);
+  BitwuzlaTerm bvZero(unsigned width);
+  BitwuzlaTerm bvOne(unsigned width);
+  BitwuzlaTerm bvMinusOne(unsigned width);
+  BitwuzlaTerm bvBoolExtract(BitwuzlaTerm expr, unsigned bit);
+  BitwuzlaTerm bvExtract(BitwuzlaTerm expr, unsigned top, unsigned bottom);
+  BitwuzlaTerm ite(BitwuzlaTerm condition, BitwuzlaTerm whenTrue,
+                   BitwuzlaTerm whenFalse);
+  BitwuzlaTerm term(BitwuzlaKind kind, BitwuzlaTerm arg);
+  BitwuzlaTerm term(BitwuzlaKind kind, BitwuzlaTerm lhs, BitwuzlaTerm rhs);
+
+  /// A shift by a variable amount, which is zero on overshifts like the
+  /// shifts by constants
+  BitwuzlaTerm varShift(BitwuzlaKind kind, BitwuzlaTerm expr,
+                        BitwuzlaTerm shift, unsigned width);
+
+  BitwuzlaSort getBvSort(unsigned width);
+  BitwuzlaTerm getInitialArray(const Array *root);
+  BitwuzlaTerm getArrayForUpdate(const Array *root, const UpdateNode *un);
+
+  BitwuzlaTerm constructActual(ref<Expr> e, int *width_out);
+  BitwuzlaTerm construct(ref<Expr> e, int *width_out);
+
+public:
+  BitwuzlaTermManager *const tm;
+
+  BitwuzlaBuilder();
+  ~BitwuzlaBuilder();
+
+  BitwuzlaTerm getTrue();
+  BitwuzlaTerm getFalse();
+  BitwuzlaTerm getInitialRead(const Array *root, unsigned index);
+
+  /// \return A Boolean term for a Boolean expression, a bit-vector term
+  /// otherwise.
+  BitwuzlaTerm construct(ref<Expr> e) { return construct(e, nullptr); }
+
+  /// Drop the cached terms of the expressions and update lists, which keep
+  /// those alive. The terms of the arrays are kept.
+  void clearConstructCache();
+};
+} // namespace klee
+
+#endif /* KLEE_BITWUZLABUILDER_H */
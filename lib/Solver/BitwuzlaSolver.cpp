@@ -0,0 +1,302 @@
+//===-- BitwuzlaSolver.cpp -------------------------------------*- C++ -*-====//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Config/config.h"
+#include "klee/Support/OptionCategories.h"
+
+#ifdef ENABLE_BITWUZLA
+
+#include "BitwuzlaBuilder.h"
+#include "BitwuzlaSolver.h"
+
+#include "klee/Expr/Assignment.h"
+#include "klee/Expr/Constraints.h"
+#include "klee/Expr/ExprSMTLIBPrinter.h"
+#include "klee/Expr/ExprUtil.h"
+#include "klee/Solver/SolverImpl.h"
+#include "klee/Solver/SolverStats.h"
+#include "klee/Statistics/TimerStatIncrementer.h"
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <cstring>
+#include <memory>
+
+namespace {
+llvm::cl::opt<bool> BitwuzlaIncremental(
+    "bitwuzla-incremental", llvm::cl::init(false),
+    llvm::cl::desc("Keep a single Bitwuzla instance between queries and only "
+                   "assert the constraints that differ from the previous "
+                   "query, using push/pop (default=false)"),
+    llvm::cl::cat(klee::SolvingCat));
+
+llvm::cl::opt<unsigned> BitwuzlaRecycleAfter(
+    "bitwuzla-recycle-after", llvm::cl::init(1000),
+    llvm::cl::desc("Recreate the Bitwuzla term manager after this many "
+                   "queries to release the terms built for the earlier ones "
+                   "(default=1000, 0=never)"),
+    llvm::cl::cat(klee::SolvingCat));
+} // namespace
+
+namespace klee {
+
+class BitwuzlaSolverImpl : public SolverImpl {
+  std::unique_ptr<BitwuzlaBuilder> builder;
+  time::Span timeout;
+  SolverRunStatus runStatusCode = SOLVER_RUN_STATUS_FAILURE;
+  /// Queries run with the current builder, see --bitwuzla-recycle-after.
+  unsigned queriesWithBuilder = 0;
+
+  /// The instance kept between queries with --bitwuzla-incremental, the
+  /// timeout it was created with and the constraints asserted in it, each
+  /// in a scope of its own.
+  Bitwuzla *session = nullptr;
+  time::Span sessionTimeout;
+  std::vector<ref<Expr>> assertedConstraints;
+
+  /// A new instance, which takes its time limit from the timeout.
+  Bitwuzla *createInstance();
+
+  /// Bring the session in sync with constraints, keeping the longest
+  /// prefix of them that is already asserted.
+  Bitwuzla *syncSession(const ConstraintSet &constraints);
+  void releaseSession();
+
+  bool internalRunSolver(const Query &query,
+                         std::shared_ptr<const Assignment> &result,
+                         bool &hasSolution, bool needsModel);
+  std::shared_ptr<const Assignment> getModel(Bitwuzla *instance,
+                                             const Query &query);
+
+public:
+  BitwuzlaSolverImpl() : builder(std::make_unique<BitwuzlaBuilder>()) {}
+  ~BitwuzlaSolverImpl() override { releaseSession(); }
+
+  char *getConstraintLog(const Query &) override;
+  void setCoreSolverTimeout(time::Span _timeout) override {
+    timeout = _timeout;
+  }
+
+  bool computeTruth(const Query &, bool &isValid) override;
+  bool computeValue(const Query &, ref<Expr> &result) override;
+  bool computeInitialValues(const Query &,
+                            std::shared_ptr<const Assignment> &result,
+                            bool &hasSolution) override;
+  SolverRunStatus getOperationStatusCode() override { return runStatusCode; }
+};
+
+BitwuzlaSolver::BitwuzlaSolver() : Solver(new BitwuzlaSolverImpl()) {}
+
+char *BitwuzlaSolver::getConstraintLog(const Query &query) {
+  return impl->getConstraintLog(query);
+}
+
+void BitwuzlaSolver::setCoreSolverTimeout(time::Span timeout) {
+  impl->setCoreSolverTimeout(timeout);
+}
+
+char *BitwuzlaSolverImpl::getConstraintLog(const Query &query) {
+  // the printer does not depend on the backend, and Bitwuzla only prints
+  // the formulas of an instance to a FILE
+  std::string log;
+  llvm::raw_string_ostream os(log);
+  ExprSMTLIBPrinter printer;
+  printer.setOutput(os);
+  printer.setQuery(query);
+  printer.generateOutput();
+  os.flush();
+  return strdup(log.c_str());
+}
+
+Bitwuzla *BitwuzlaSolverImpl::createInstance() {
+  BitwuzlaOptions *options = bitwuzla_options_new();
+  bitwuzla_set_option(options, BITWUZLA_OPT_PRODUCE_MODELS, 1);
+  if (timeout) {
+    // in milliseconds, where 0 is no limit
+    uint64_t limit = std::max<uint64_t>(1, timeout.toMicroseconds() / 1000);
+    bitwuzla_set_option(options, BITWUZLA_OPT_TIME_LIMIT_PER, limit);
+  }
+  Bitwuzla *instance = bitwuzla_new(builder->tm, options);
+  bitwuzla_options_delete(options);
+  return instance;
+}
+
+void BitwuzlaSolverImpl::releaseSession() {
+  if (!session)
+    return;
+  bitwuzla_delete(session);
+  session = nullptr;
+  assertedConstraints.clear();
+}
+
+Bitwuzla *BitwuzlaSolverImpl::syncSession(const ConstraintSet &constraints) {
+  // the time limit of an instance is fixed when it is created
+  if (session && !(sessionTimeout == timeout))
+    releaseSession();
+  if (!session) {
+    session = createInstance();
+    sessionTimeout = timeout;
+  }
+
+  auto it = constraints.begin(), ie = constraints.end();
+  size_t common = 0;
+  for (; it != ie && common < assertedConstraints.size() &&
+         assertedConstraints[common].get() == (*it).get();
+       ++it)
+    ++common;
+  stats::queryConstraintsReused += common;
+
+  if (common < assertedConstraints.size()) {
+    bitwuzla_pop(session, assertedConstraints.size() - common);
+    assertedConstraints.resize(common);
+  }
+  for (; it != ie; ++it) {
+    bitwuzla_push(session, 1);
+    bitwuzla_assert(session, builder->construct(*it));
+    assertedConstraints.push_back(*it);
+  }
+  return session;
+}
+
+bool BitwuzlaSolverImpl::computeTruth(const Query &query, bool &isValid) {
+  std::shared_ptr<const Assignment> result;
+  bool hasSolution = false;
+  bool status = internalRunSolver(query, result, hasSolution, false);
+  isValid = !hasSolution;
+  return status;
+}
+
+bool BitwuzlaSolverImpl::computeValue(const Query &query, ref<Expr> &result) {
+  std::shared_ptr<const Assignment> assignment;
+  bool hasSolution;
+
+  if (!computeInitialValues(query.withFalse(), assignment, hasSolution))
+    return false;
+  assert(hasSolution && "state has invalid constraint set");
+
+  // Evaluate the expression with the computed assignment.
+  result = assignment->evaluate(query.expr);
+  return true;
+}
+
+bool BitwuzlaSolverImpl::computeInitialValues(
+    const Query &query, std::shared_ptr<const Assignment> &result,
+    bool &hasSolution) {
+  return internalRunSolver(query, result, hasSolution, true);
+}
+
+bool BitwuzlaSolverImpl::internalRunSolver(
+    const Query &query, std::shared_ptr<const Assignment> &result,
+    bool &hasSolution, bool needsModel) {
+  TimerStatIncrementer t(stats::queryTime);
+  // the terms of earlier queries are only released with their manager,
+  // which no instance outlives
+  if (BitwuzlaRecycleAfter && queriesWithBuilder >= BitwuzlaRecycleAfter) {
+    releaseSession();
+    builder = std::make_unique<BitwuzlaBuilder>();
+    queriesWithBuilder = 0;
+    ++stats::bitwuzlaRecycles;
+  }
+  ++queriesWithBuilder;
+
+  Bitwuzla *instance;
+  if (BitwuzlaIncremental) {
+    instance = syncSession(query.constraints);
+    // the query itself is retracted again below
+    bitwuzla_push(instance, 1);
+  } else {
+    instance = createInstance();
+    for (auto const &constraint : query.constraints)
+      bitwuzla_assert(instance, builder->construct(constraint));
+  }
+
+  runStatusCode = SOLVER_RUN_STATUS_FAILURE;
+  ++stats::queries;
+  if (needsModel)
+    ++stats::queryCounterexamples;
+
+  // KLEE Queries are validity queries i.e.
+  // ∀ X Constraints(X) → query(X)
+  // but Bitwuzla works in terms of satisfiability so instead we ask the
+  // negation of the equivalent i.e.
+  // ∃ X Constraints(X) ∧ ¬ query(X)
+  bitwuzla_assert(instance, bitwuzla_mk_term1(builder->tm, BITWUZLA_KIND_NOT,
+                                              builder->construct(query.expr)));
+
+  switch (bitwuzla_check_sat(instance)) {
+  case BITWUZLA_SAT:
+    hasSolution = true;
+    if (needsModel)
+      result = getModel(instance, query);
+    runStatusCode = SOLVER_RUN_STATUS_SUCCESS_SOLVABLE;
+    break;
+  case BITWUZLA_UNSAT:
+    hasSolution = false;
+    runStatusCode = SOLVER_RUN_STATUS_SUCCESS_UNSOLVABLE;
+    break;
+  default:
+    // only the time limit makes a quantifier-free query unknown
+    runStatusCode =
+        timeout ? SOLVER_RUN_STATUS_TIMEOUT : SOLVER_RUN_STATUS_FAILURE;
+    break;
+  }
+
+  if (BitwuzlaIncremental)
+    bitwuzla_pop(instance, 1);
+  else
+    bitwuzla_delete(instance);
+  // the cached terms keep the expressions of the query alive
+  builder->clearConstructCache();
+
+  if (runStatusCode == SOLVER_RUN_STATUS_SUCCESS_SOLVABLE ||
+      runStatusCode == SOLVER_RUN_STATUS_SUCCESS_UNSOLVABLE) {
+    if (hasSolution)
+      ++stats::queriesInvalid;
+    else
+      ++stats::queriesValid;
+    return true;
+  }
+  return false;
+}
+
+namespace {
+/// \return The value of a bit-vector value term of at most 64 bits.
+uint64_t getBvValue(BitwuzlaTerm value) {
+  uint64_t result = 0;
+  __attribute__((unused)) bool failed =
+      llvm::StringRef(bitwuzla_term_value_get_str_fmt(value, 2))
+          .getAsInteger(2, result);
+  assert(!failed && "failed to get value back");
+  return result;
+}
+} // namespace
+
+std::shared_ptr<const Assignment>
+BitwuzlaSolverImpl::getModel(Bitwuzla *instance, const Query &query) {
+  std::vector<ref<ReadExpr>> reads;
+  findReads(query.expr, true, reads);
+  for (const auto &constraint : query.constraints)
+    findReads(constraint, true, reads);
+
+  // the models of Bitwuzla are complete, so each index has a value
+  Assignment::map_bindings_ty bindings;
+  for (const ref<ReadExpr> &read : reads) {
+    uint64_t index = getBvValue(
+        bitwuzla_get_value(instance, builder->construct(read->index)));
+    uint64_t value = getBvValue(bitwuzla_get_value(
+        instance, builder->getInitialRead(read->updates.root, index)));
+    assert(value <= 255 && "Integer from model is out of range");
+    bindings[read->updates.root].add(index, value);
+  }
+  return std::make_shared<Assignment>(bindings);
+}
+} // namespace klee
+#endif // ENABLE_BITWUZLA
@@ -0,0 +1,243 @@
+//===-- CanonicalizingSolver.cpp ------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Solver/Solver.h"
+
+#include "klee/Expr/ArrayCache.h"
+#include "klee/Expr/Assignment.h"
+#include "klee/Expr/Constraints.h"
+#include "klee/Expr/Expr.h"
+#include "klee/Expr/ExprHashMap.h"
+#include "klee/Solver/SolverImpl.h"
+
+#include "llvm/ADT/DenseMap.h"
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+using namespace klee;
+
+namespace {
+
+/// Rewrites the expressions of a query into a canonical form: symbolic
+/// arrays are renamed in the order of their first occurrence and the
+/// operands of commutative operations are ordered. Queries that only
+/// differ in the names of their arrays or the operand order thus become
+/// equal and share the entries of the caches below.
+class QueryCanonicalizer {
+  ArrayCache &arrayCache;
+  ExprHashMap<ref<Expr>> rewritten;
+  llvm::DenseMap<const UpdateNode *, ref<UpdateNode>> rewrittenUpdates;
+  std::map<const Array *, const Array *> renamed;
+
+  const Array *rename(const Array *array);
+  UpdateList rewrite(const UpdateList &updates);
+
+public:
+  explicit QueryCanonicalizer(ArrayCache &arrayCache)
+      : arrayCache(arrayCache) {}
+
+  ref<Expr> rewrite(const ref<Expr> &e);
+
+  /// The original array of each canonical one.
+  std::map<const Array *, const Array *> getOriginalArrays() const {
+    std::map<const Array *, const Array *> original;
+    for (const auto &r : renamed)
+      original.emplace(r.second, r.first);
+    return original;
+  }
+};
+
+const Array *QueryCanonicalizer::rename(const Array *array) {
+  // constant arrays are identified by their contents, keep them
+  if (array->isConstantArray())
+    return array;
+  auto it = renamed.find(array);
+  if (it != renamed.end())
+    return it->second;
+
+  std::string name = "canon" + std::to_string(renamed.size()) + "_" +
+                     std::to_string(array->size);
+  if (array->domain != Expr::Int32 || array->range != Expr::Int8)
+    name += "_w" + std::to_string(array->domain) + "_w" +
+            std::to_string(array->range);
+  const Array *canonical = arrayCache.CreateArray(
+      name, array->size, nullptr, nullptr, array->domain, array->range);
+  renamed.emplace(array, canonical);
+  return canonical;
+}
+
+UpdateList QueryCanonicalizer::rewrite(const UpdateList &updates) {
+  const Array *root = rename(updates.root);
+
+  // rebuild the updates from the oldest one, reusing the longest suffix
+  // of them that was already rewritten for another read
+  std::vector<const UpdateNode *> pending;
+  ref<UpdateNode> head;
+  for (const UpdateNode *un = updates.head.get(); un; un = un->next.get()) {
+    auto it = rewrittenUpdates.find(un);
+    if (it != rewrittenUpdates.end()) {
+      head = it->second;
+      break;
+    }
+    pending.push_back(un);
+  }
+
+  UpdateList result(root, head);
+  for (auto it = pending.rbegin(), ie = pending.rend(); it != ie; ++it) {
+    result.extend(rewrite((*it)->index), rewrite((*it)->value));
+    rewrittenUpdates[*it] = result.head;
+  }
+  return result;
+}
+
+ref<Expr> QueryCanonicalizer::rewrite(const ref<Expr> &e) {
+  if (isa<ConstantExpr>(e))
+    return e;
+  auto it = rewritten.find(e);
+  if (it != rewritten.end())
+    return it->second;
+
+  ref<Expr> result;
+  if (const auto *re = dyn_cast<ReadExpr>(e)) {
+    UpdateList updates = rewrite(re->updates);
+    result = ReadExpr::create(updates, rewrite(re->index));
+  } else {
+    ref<Expr> kids[8];
+    unsigned count = e->getNumKids();
+    for (unsigned i = 0; i < count; ++i)
+      kids[i] = rewrite(e->getKid(i));
+
+    switch (e->getKind()) {
+    case Expr::Add:
+    case Expr::Mul:
+    case Expr::And:
+    case Expr::Or:
+    case Expr::Xor:
+    case Expr::Eq:
+      // constants stay on the left where the builders expect them
+      if (!isa<ConstantExpr>(kids[0]) && kids[1].compare(kids[0]) < 0)
+        std::swap(kids[0], kids[1]);
+      break;
+    default:
+      break;
+    }
+    result = e->rebuild(kids);
+  }
+
+  rewritten.insert(std::make_pair(e, result));
+  return result;
+}
+
+} // namespace
+
+/// Solves the canonical form of each query with the underlying solver and
+/// maps the computed assignments back to the original arrays.
+class CanonicalizingSolver : public SolverImpl {
+  Solver *solver;
+  /// Owns the canonical arrays, which are shared by all queries.
+  ArrayCache arrayCache;
+
+public:
+  explicit CanonicalizingSolver(Solver *s) : solver(s) {}
+  ~CanonicalizingSolver() { delete solver; }
+
+  bool computeValidity(const Query &, Solver::Validity &result);
+  bool computeTruth(const Query &, bool &isValid);
+  bool computeValue(const Query &, ref<Expr> &result);
+  bool computeInitialValues(const Query &,
+                            std::shared_ptr<const Assignment> &result,
+                            bool &hasSolution);
+  SolverRunStatus getOperationStatusCode();
+  char *getConstraintLog(const Query &);
+  void setCoreSolverTimeout(time::Span timeout);
+
+private:
+  /// Rewrite query into canonical, whose constraints are sorted.
+  ConstraintSet canonicalize(QueryCanonicalizer &canonicalizer,
+                             const Query &query, ref<Expr> &expr);
+};
+
+ConstraintSet CanonicalizingSolver::canonicalize(
+    QueryCanonicalizer &canonicalizer, const Query &query, ref<Expr> &expr) {
+  std::vector<ref<Expr>> constraints;
+  for (const auto &constraint : query.constraints)
+    constraints.push_back(canonicalizer.rewrite(constraint));
+  expr = canonicalizer.rewrite(query.expr);
+  std::sort(constraints.begin(), constraints.end(),
+            [](const ref<Expr> &a, const ref<Expr> &b) {
+              return a.compare(b) < 0;
+            });
+  return ConstraintSet(std::move(constraints));
+}
+
+bool CanonicalizingSolver::computeValidity(const Query &query,
+                                           Solver::Validity &result) {
+  QueryCanonicalizer canonicalizer(arrayCache);
+  ref<Expr> expr;
+  ConstraintSet constraints = canonicalize(canonicalizer, query, expr);
+  return solver->impl->computeValidity(Query(constraints, expr), result);
+}
+
+bool CanonicalizingSolver::computeTruth(const Query &query, bool &isValid) {
+  QueryCanonicalizer canonicalizer(arrayCache);
+  ref<Expr> expr;
+  ConstraintSet constraints = canonicalize(canonicalizer, query, expr);
+  return solver->impl->computeTruth(Query(constraints, expr), isValid);
+}
+
+bool CanonicalizingSolver::computeValue(const Query &query,
+                                        ref<Expr> &result) {
+  QueryCanonicalizer canonicalizer(arrayCache);
+  ref<Expr> expr;
+  ConstraintSet constraints = canonicalize(canonicalizer, query, expr);
+  return solver->impl->computeValue(Query(constraints, expr), result);
+}
+
+bool CanonicalizingSolver::computeInitialValues(
+    const Query &query, std::shared_ptr<const Assignment> &result,
+    bool &hasSolution) {
+  QueryCanonicalizer canonicalizer(arrayCache);
+  ref<Expr> expr;
+  ConstraintSet constraints = canonicalize(canonicalizer, query, expr);
+  std::shared_ptr<const Assignment> canonicalResult;
+  if (!solver->impl->computeInitialValues(Query(constraints, expr),
+                                          canonicalResult, hasSolution))
+    return false;
+  if (!hasSolution || !canonicalResult)
+    return true;
+
+  auto assignment = std::make_shared<Assignment>();
+  for (const auto &arrays : canonicalizer.getOriginalArrays())
+    if (const CompactArrayModel *model =
+            canonicalResult->getBindingsOrNull(arrays.first))
+      assignment->addBinding(arrays.second, model->asVector());
+  result = std::move(assignment);
+  return true;
+}
+
+SolverImpl::SolverRunStatus CanonicalizingSolver::getOperationStatusCode() {
+  return solver->impl->getOperationStatusCode();
+}
+
+char *CanonicalizingSolver::getConstraintLog(const Query &query) {
+  return solver->impl->getConstraintLog(query);
+}
+
+void CanonicalizingSolver::setCoreSolverTimeout(time::Span timeout) {
+  solver->impl->setCoreSolverTimeout(timeout);
+}
+
+///
+
+Solver *klee::createCanonicalizingSolver(Solver *s) {
+  return new Solver(new CanonicalizingSolver(s));
+}
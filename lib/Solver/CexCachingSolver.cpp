@@ -11,17 +11,23 @@
 
 #include "klee/ADT/MapOfSets.h"
 #include "klee/Expr/Assignment.h"
+#include "klee/Expr/AssignmentBatch.h"
 #include "klee/Expr/Constraints.h"
 #include "klee/Expr/Expr.h"
+#include "klee/Expr/ExprTape.h"
 #include "klee/Expr/ExprUtil.h"
 #include "klee/Expr/ExprVisitor.h"
 #include "klee/Support/OptionCategories.h"
+#include "klee/Statistics/MemoryAccount.h"
 #include "klee/Statistics/TimerStatIncrementer.h"
 #include "klee/Solver/SolverImpl.h"
 #include "klee/Solver/SolverStats.h"
 #include "klee/Support/ErrorHandling.h"
 
 #include "llvm/Support/CommandLine.h"
+#include "llvm/Support/MathExtras.h"
+
+#include <list>
 
 using namespace klee;
 using namespace llvm;
@@ -50,21 +56,56 @@ cl::opt<bool> CexCacheExperimental(
     cl::desc("Optimization for validity queries (default=false)"),
     cl::cat(SolvingCat));
 
+cl::opt<unsigned> CexCacheSize(
+    "cex-cache-size", cl::init(0),
+    cl::desc("Maximum number of entries in the counterexample cache, the "
+             "least recently used ones are evicted (default=0 (unbounded))"),
+    cl::cat(SolvingCat));
+
 } // namespace
 
 ///
 
 typedef std::set< ref<Expr> > KeyType;
 
+/// A cached result together with its position in the LRU order, which is
+/// only maintained with --cex-cache-size.
+struct CexCacheEntry {
+  std::shared_ptr<const Assignment> assignment;
+  std::list<KeyType>::iterator lruPosition;
+};
+
 class CexCachingSolver : public SolverImpl {
   typedef std::set<std::shared_ptr<const Assignment> >
           assignmentsTable_ty;
 
   Solver *solver;
   
-  MapOfSets<ref<Expr>, std::shared_ptr<const Assignment>> cache;
+  MapOfSets<ref<Expr>, CexCacheEntry> cache;
   // memo table
   assignmentsTable_ty assignmentsTable;
+  /// The keys of the cache from the most to the least recently used one.
+  std::list<KeyType> lru;
+  /// The estimated bytes of the cache charged to memory::cexCache.
+  uint64_t accountedBytes = 0;
+  MemoryAccount::Releaser releaser{memory::cexCache, [this] { clear(); }};
+
+  void charge(uint64_t bytes) {
+    accountedBytes += bytes;
+    memory::cexCache.add(bytes);
+  }
+  void discharge(uint64_t bytes) {
+    accountedBytes -= std::min(accountedBytes, bytes);
+    memory::cexCache.remove(bytes);
+  }
+  void clear();
+
+  void touch(CexCacheEntry &entry) {
+    if (CexCacheSize)
+      lru.splice(lru.begin(), lru, entry.lruPosition);
+  }
+  void insert(const KeyType &key,
+              const std::shared_ptr<const Assignment> &assignment);
 
   bool searchForAssignment(KeyType &key, 
                            std::shared_ptr<const Assignment> &result);
@@ -99,20 +140,64 @@ public:
 ///
 
 struct NullAssignment {
-  bool operator()(const std::shared_ptr<const Assignment>& a) const { return !a; }
+  bool operator()(const CexCacheEntry &e) const { return !e.assignment; }
 };
 
 struct NonNullAssignment {
-  bool operator()(const std::shared_ptr<const Assignment>& a) const { return a!=0; }
+  bool operator()(const CexCacheEntry &e) const { return e.assignment != 0; }
+};
+
+/// Evaluates the expressions of a key under the candidate assignments. Once
+/// the key is evaluated a second time, it is compiled to ExprTapes for the
+/// remaining candidates.
+class KeyEvaluator {
+  const KeyType &key;
+  unsigned evaluations = 0;
+  /// The tapes of the expressions of the key, in its order, once compiled.
+  /// Those that cannot be compiled are left empty.
+  std::vector<ExprTape> tapes;
+
+public:
+  explicit KeyEvaluator(const KeyType &_key) : key(_key) {}
+
+  bool satisfiedBy(const Assignment &a) {
+    if (++evaluations == 1)
+      return a.satisfies(key.begin(), key.end());
+
+    if (tapes.empty()) {
+      TimerStatIncrementer t(stats::cexCacheCompileTime);
+      tapes.resize(key.size());
+      auto tape = tapes.begin();
+      for (const ref<Expr> &e : key)
+        (tape++)->compile(e);
+    }
+
+    TimerStatIncrementer t(stats::cexCacheEvaluationTime);
+    auto tape = tapes.begin();
+    for (auto it = key.begin(), ie = key.end(); it != ie; ++it, ++tape) {
+      uint64_t value;
+      if (!tape->isCompiled()) {
+        if (!a.satisfies(it, std::next(it)))
+          return false;
+      } else if (!tape->evaluate(a, value) || !value) {
+        return false;
+      }
+    }
+    return true;
+  }
 };
 
 struct NullOrSatisfyingAssignment {
-  KeyType &key;
+  KeyEvaluator &evaluator;
   
-  NullOrSatisfyingAssignment(KeyType &_key) : key(_key) {}
+  NullOrSatisfyingAssignment(KeyEvaluator &_evaluator)
+      : evaluator(_evaluator) {}
 
-  bool operator()(const std::shared_ptr<const Assignment>& a) const {
-    return !a || a->satisfies(key.begin(), key.end()); 
+  bool operator()(const CexCacheEntry &e) const {
+    if (!e.assignment)
+      return true;
+    ++stats::cexCacheCandidates;
+    return evaluator.satisfiedBy(*e.assignment);
   }
 };
 
@@ -125,16 +210,18 @@ struct NullOrSatisfyingAssignment {
 /// \return - True if a cached result was found.
 bool CexCachingSolver::searchForAssignment(KeyType &key,
                                            std::shared_ptr<const Assignment> &result) {
-  std::shared_ptr<const Assignment> *lookup = cache.lookup(key);
+  TimerStatIncrementer t(stats::cexCacheLookupTime);
+  CexCacheEntry *lookup = cache.lookup(key);
   if (lookup) {
-    result = *lookup;
+    touch(*lookup);
+    result = lookup->assignment;
     return true;
   }
 
   if (CexCacheTryAll) {
     // Look for a satisfying assignment for a superset, which is trivially an
     // assignment for any subset.
-    std::shared_ptr<const Assignment> *lookup = 0;
+    CexCacheEntry *lookup = 0;
     if (CexCacheSuperSet)
       lookup = cache.findSuperset(key, NonNullAssignment());
 
@@ -144,26 +231,40 @@ bool CexCachingSolver::searchForAssignment(KeyType &key,
 
     // If either lookup succeeded, then we have a cached solution.
     if (lookup) {
-      result = *lookup;
+      touch(*lookup);
+      result = lookup->assignment;
       return true;
     }
 
     // Otherwise, iterate through the set of current assignments to see if one
-    // of them satisfies the query.
-    for (assignmentsTable_ty::iterator it = assignmentsTable.begin(), 
-           ie = assignmentsTable.end(); it != ie; ++it) {
-      std::shared_ptr<const Assignment> a = *it;
-      if (a->satisfies(key.begin(), key.end())) {
-        result = a;
+    // of them satisfies the query. They are evaluated in batches, which walk
+    // the query once for all of their assignments.
+    std::vector<assignmentsTable_ty::iterator> candidates;
+    std::vector<const Assignment *> batch;
+    for (assignmentsTable_ty::iterator it = assignmentsTable.begin(),
+           ie = assignmentsTable.end(); it != ie;) {
+      candidates.push_back(it);
+      batch.push_back(it->get());
+      ++stats::cexCacheCandidates;
+      if (++it != ie && batch.size() < AssignmentBatch::MaxLanes)
+        continue;
+
+      uint64_t satisfying =
+          AssignmentBatch(batch).satisfies(key.begin(), key.end());
+      if (satisfying) {
+        // the first one, as if they were tried one by one
+        result = *candidates[llvm::countTrailingZeros(satisfying)];
         return true;
       }
+      candidates.clear();
+      batch.clear();
     }
   } else {
     // FIXME: Which order? one is sure to be better.
 
     // Look for a satisfying assignment for a superset, which is trivially an
     // assignment for any subset.
-    std::shared_ptr<const Assignment> *lookup = 0;
+    CexCacheEntry *lookup = 0;
     if (CexCacheSuperSet)
       lookup = cache.findSuperset(key, NonNullAssignment());
 
@@ -172,12 +273,15 @@ bool CexCachingSolver::searchForAssignment(KeyType &key,
     // assignment. While searching subsets, we also explicitly the solutions for
     // satisfiable subsets to see if they solve the current query and return
     // them if so. This is cheap and frequently succeeds.
-    if (!lookup) 
-      lookup = cache.findSubset(key, NullOrSatisfyingAssignment(key));
+    if (!lookup) {
+      KeyEvaluator evaluator(key);
+      lookup = cache.findSubset(key, NullOrSatisfyingAssignment(evaluator));
+    }
 
     // If either lookup succeeded, then we have a cached solution.
     if (lookup) {
-      result = *lookup;
+      touch(*lookup);
+      result = lookup->assignment;
       return true;
     }
   }
@@ -228,21 +332,60 @@ bool CexCachingSolver::getAssignment(const Query& query,
     return false;
 
     
-  if (hasSolution) {
-    // Memoize the result.
-    assignmentsTable.insert(result);
-  } else {
+  if (!hasSolution)
     result = 0;
-  }
-  
-  cache.insert(key, result);
+  insert(key, result);
 
   return true;
 }
 
+/// The estimated bytes of a key in the trie of the cache and in the LRU
+/// list, which hold a node per expression.
+static uint64_t getKeyBytes(const KeyType &key) {
+  return sizeof(CexCacheEntry) + sizeof(KeyType) +
+         key.size() * (sizeof(ref<Expr>) + 4 * sizeof(void *)) *
+             (CexCacheSize ? 2 : 1);
+}
+
+void CexCachingSolver::insert(const KeyType &key,
+                              const std::shared_ptr<const Assignment> &assignment) {
+  // Memoize the result.
+  if (assignment && assignmentsTable.insert(assignment).second)
+    charge(assignment->getMemoryUsage());
+  charge(getKeyBytes(key));
+
+  CexCacheEntry entry{assignment, {}};
+  if (CexCacheSize) {
+    lru.push_front(key);
+    entry.lruPosition = lru.begin();
+  }
+  cache.insert(key, entry);
+
+  if (CexCacheSize && lru.size() > CexCacheSize) {
+    const KeyType &victim = lru.back();
+    CexCacheEntry *e = cache.lookup(victim);
+    assert(e && "evicting an entry that is not cached");
+    // an assignment is cached for the key it was computed for only
+    if (e->assignment && assignmentsTable.erase(e->assignment))
+      discharge(e->assignment->getMemoryUsage());
+    discharge(getKeyBytes(victim));
+    cache.erase(victim);
+    lru.pop_back();
+    ++stats::cexCacheEvictions;
+  }
+}
+
+void CexCachingSolver::clear() {
+  cache.clear();
+  assignmentsTable.clear();
+  lru.clear();
+  discharge(accountedBytes);
+}
+
 ///
 
 CexCachingSolver::~CexCachingSolver() {
+  discharge(accountedBytes);
   delete solver;
 }
 
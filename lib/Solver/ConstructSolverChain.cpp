@@ -24,10 +24,24 @@ Solver *constructSolverChain(Solver *coreSolver,
                              std::string querySMT2LogPath,
                              std::string baseSolverQuerySMT2LogPath,
                              std::string queryKQueryLogPath,
-                             std::string baseSolverQueryKQueryLogPath) {
+                             std::string baseSolverQueryKQueryLogPath,
+                             std::string queryBinaryLogPath,
+                             std::string baseSolverQueryBinaryLogPath,
+                             std::deque<SolverLayerProfile> *profiles) {
   Solver *solver = coreSolver;
   const time::Span minQueryTimeToLog(MinQueryTimeToLog);
 
+  // puts a profiling solver in front of the layer just added
+  auto profile = [profiles](Solver *layer, const char *name) {
+    if (!profiles)
+      return layer;
+    const SolverLayerProfile *below =
+        profiles->empty() ? nullptr : &profiles->back();
+    profiles->emplace_back(name);
+    return createProfilingSolver(layer, profiles->back(), below);
+  };
+  solver = profile(solver, "core");
+
   if (QueryLoggingOptions.isSet(SOLVER_KQUERY)) {
     solver = createKQueryLoggingSolver(solver, baseSolverQueryKQueryLogPath, minQueryTimeToLog, LogTimedOutQueries);
     klee_message("Logging queries that reach solver in .kquery format to %s\n",
@@ -40,20 +54,45 @@ Solver *constructSolverChain(Solver *coreSolver,
                  baseSolverQuerySMT2LogPath.c_str());
   }
 
+  if (QueryLoggingOptions.isSet(SOLVER_BINARY)) {
+    solver = createBinaryQueryLoggingSolver(solver, baseSolverQueryBinaryLogPath,
+                                            minQueryTimeToLog,
+                                            LogTimedOutQueries);
+    klee_message("Logging queries that reach solver in binary format to %s\n",
+                 baseSolverQueryBinaryLogPath.c_str());
+  }
+
+  if (!PersistentQueryCache.empty()) {
+    solver = profile(createPersistentCachingSolver(solver, PersistentQueryCache),
+                     "persistent-cache");
+    klee_message("Caching solver answers in %s", PersistentQueryCache.c_str());
+  }
+
   if (UseAssignmentValidatingSolver)
     solver = createAssignmentValidatingSolver(solver);
 
   if (UseFastCexSolver)
-    solver = createFastCexSolver(solver);
+    solver = profile(createFastCexSolver(solver), "fast-cex");
 
   if (UseCexCache)
-    solver = createCexCachingSolver(solver);
+    solver = profile(createCexCachingSolver(solver), "cex-cache");
 
   if (UseBranchCache)
-    solver = createCachingSolver(solver);
+    solver = profile(createCachingSolver(solver), "branch-cache");
+
+  if (CanonicalizeQueries)
+    solver = profile(createCanonicalizingSolver(solver), "canonicalize");
 
   if (UseIndependentSolver)
-    solver = createIndependentSolver(solver);
+    solver = profile(createIndependentSolver(solver), "independent");
+
+  if (UseKnownModel)
+    solver = profile(createKnownModelSolver(solver), "known-model");
+
+  // ahead of the caches, which turn truth queries into requests for
+  // counterexamples
+  if (UseSegmentSolver)
+    solver = profile(createSegmentSolver(solver), "segment");
 
   if (DebugValidateSolver)
     solver = createValidatingSolver(solver, coreSolver);
@@ -69,6 +108,14 @@ Solver *constructSolverChain(Solver *coreSolver,
     klee_message("Logging all queries in .smt2 format to %s\n",
                  querySMT2LogPath.c_str());
   }
+
+  if (QueryLoggingOptions.isSet(ALL_BINARY)) {
+    solver = createBinaryQueryLoggingSolver(solver, queryBinaryLogPath,
+                                            minQueryTimeToLog,
+                                            LogTimedOutQueries);
+    klee_message("Logging all queries in binary format to %s\n",
+                 queryBinaryLogPath.c_str());
+  }
   if (DebugCrossCheckCoreSolverWith != NO_SOLVER) {
     Solver *oracleSolver = createCoreSolver(DebugCrossCheckCoreSolverWith);
     solver = createValidatingSolver(solver, oracleSolver, true);
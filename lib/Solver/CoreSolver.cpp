@@ -7,6 +7,7 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include "BitwuzlaSolver.h"
 #include "STPSolver.h"
 #include "Z3Solver.h"
 #include "MetaSMTSolver.h"
@@ -14,6 +15,7 @@
 #include "klee/Solver/SolverCmdLine.h"
 #include "klee/Support/ErrorHandling.h"
 #include "klee/Solver/Solver.h"
+#include "klee/Solver/SolverStats.h"
 
 #include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/raw_ostream.h"
@@ -22,7 +24,7 @@
 
 namespace klee {
 
-Solver *createCoreSolver(CoreSolverType cst) {
+static Solver *createBackend(CoreSolverType cst) {
   switch (cst) {
   case STP_SOLVER:
 #ifdef ENABLE_STP
@@ -50,6 +52,40 @@ Solver *createCoreSolver(CoreSolverType cst) {
     klee_message("Not compiled with Z3 support");
     return NULL;
 #endif
+  case BITWUZLA_SOLVER:
+#ifdef ENABLE_BITWUZLA
+    klee_message("Using Bitwuzla solver backend");
+    return new BitwuzlaSolver();
+#else
+    klee_message("Not compiled with Bitwuzla support");
+    return NULL;
+#endif
+  case PORTFOLIO_SOLVER: {
+    std::vector<CoreSolverType> types(PortfolioBackends.begin(),
+                                      PortfolioBackends.end());
+    if (types.empty()) {
+#ifdef ENABLE_STP
+      types.push_back(STP_SOLVER);
+#endif
+#ifdef ENABLE_METASMT
+      types.push_back(METASMT_SOLVER);
+#endif
+#ifdef ENABLE_Z3
+      types.push_back(Z3_SOLVER);
+#endif
+#ifdef ENABLE_BITWUZLA
+      types.push_back(BITWUZLA_SOLVER);
+#endif
+    }
+    std::vector<std::pair<CoreSolverType, Solver *>> backends;
+    for (CoreSolverType type : types)
+      if (Solver *s = createBackend(type))
+        backends.emplace_back(type, s);
+    if (backends.empty())
+      return NULL;
+    klee_message("Using a portfolio of %zu solver backends", backends.size());
+    return createPortfolioSolver(std::move(backends));
+  }
   case NO_SOLVER:
     klee_message("Invalid solver");
     return NULL;
@@ -57,4 +93,51 @@ Solver *createCoreSolver(CoreSolverType cst) {
     llvm_unreachable("Unsupported CoreSolverType");
   }
 }
+
+static const char *getBackendName(CoreSolverType cst) {
+  switch (cst) {
+  case STP_SOLVER:
+    return "stp";
+  case METASMT_SOLVER:
+    return "metasmt";
+  case DUMMY_SOLVER:
+    return "dummy";
+  case Z3_SOLVER:
+    return "z3";
+  case BITWUZLA_SOLVER:
+    return "bitwuzla";
+  case PORTFOLIO_SOLVER:
+    return "portfolio";
+  default:
+    return "none";
+  }
+}
+
+/// The solver of the second stage of --solver-escalation.
+static Solver *createEscalationFallback(CoreSolverType cst) {
+  if (SolverEscalationBackend != NO_SOLVER)
+    return createBackend(SolverEscalationBackend);
+  // a backend of its own, as the independent solver owns it
+  if (Solver *solver = createBackend(cst))
+    return createIndependentSolver(solver);
+  return NULL;
+}
+
+Solver *createCoreSolver(CoreSolverType cst) {
+  Solver *solver = createBackend(cst);
+  if (solver && SolverEscalation) {
+    solver = createEscalatingSolver(solver, createEscalationFallback(cst),
+                                    SolverEscalationTimeoutFactor);
+    klee_message("Escalating failed queries to %s and a timeout scaled by %u",
+                 SolverEscalationBackend == NO_SOLVER
+                     ? "the independent parts of the query"
+                     : getBackendName(SolverEscalationBackend),
+                 unsigned(SolverEscalationTimeoutFactor));
+  }
+  // the backends of a portfolio solve in forked processes, so the portfolio
+  // is recorded as a whole
+  if (solver && QueryShapeStatistics)
+    solver = createQueryShapeSolver(solver, getBackendName(cst));
+  return solver;
+}
 }
@@ -0,0 +1,117 @@
+//===-- EscalatingSolver.cpp ----------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Solver/Solver.h"
+#include "klee/Solver/SolverImpl.h"
+#include "klee/Solver/SolverStats.h"
+
+#include <memory>
+#include <vector>
+
+namespace klee {
+
+/// Retries the queries a solver fails on with other solvers and timeouts.
+/// A stage runs a solver with the timeout scaled by a factor, and only the
+/// queries that no earlier stage answered reach it.
+class EscalatingSolver : public SolverImpl {
+  struct Stage {
+    Solver *solver;
+    unsigned timeoutFactor;
+    /// Queries answered by this stage after the earlier ones failed
+    Statistic *solved;
+  };
+  std::vector<Stage> stages;
+  /// The solvers of the stages, each owned once
+  std::vector<std::unique_ptr<Solver>> solvers;
+  time::Span timeout;
+  SolverRunStatus runStatusCode = SOLVER_RUN_STATUS_FAILURE;
+
+  template <typename Run> bool escalate(Run run);
+
+public:
+  EscalatingSolver(Solver *primary, Solver *fallback, unsigned timeoutFactor);
+
+  bool computeValidity(const Query &query, Solver::Validity &result) override {
+    return escalate([&](Solver *solver) {
+      return solver->impl->computeValidity(query, result);
+    });
+  }
+  bool computeTruth(const Query &query, bool &isValid) override {
+    return escalate([&](Solver *solver) {
+      return solver->impl->computeTruth(query, isValid);
+    });
+  }
+  bool computeValue(const Query &query, ref<Expr> &result) override {
+    return escalate([&](Solver *solver) {
+      return solver->impl->computeValue(query, result);
+    });
+  }
+  bool computeInitialValues(const Query &query,
+                            std::shared_ptr<const Assignment> &result,
+                            bool &hasSolution) override {
+    return escalate([&](Solver *solver) {
+      return solver->impl->computeInitialValues(query, result, hasSolution);
+    });
+  }
+  SolverRunStatus getOperationStatusCode() override { return runStatusCode; }
+  char *getConstraintLog(const Query &query) override {
+    return stages.front().solver->impl->getConstraintLog(query);
+  }
+  void setCoreSolverTimeout(time::Span _timeout) override {
+    timeout = _timeout;
+    for (auto &solver : solvers)
+      solver->impl->setCoreSolverTimeout(timeout);
+  }
+};
+
+EscalatingSolver::EscalatingSolver(Solver *primary, Solver *fallback,
+                                   unsigned timeoutFactor) {
+  solvers.emplace_back(primary);
+  stages.push_back({primary, 1, nullptr});
+  if (fallback) {
+    solvers.emplace_back(fallback);
+    stages.push_back({fallback, 1, &stats::escalationsSolvedByFallback});
+  }
+  if (timeoutFactor > 1)
+    stages.push_back(
+        {primary, timeoutFactor, &stats::escalationsSolvedByLongerTimeout});
+}
+
+template <typename Run> bool EscalatingSolver::escalate(Run run) {
+  for (unsigned i = 0; i < stages.size(); ++i) {
+    const Stage &stage = stages[i];
+    if (i == 1)
+      ++stats::escalatedQueries;
+    // without a timeout a longer one is no different
+    if (stage.timeoutFactor > 1 && !timeout)
+      break;
+    if (stage.timeoutFactor > 1)
+      stage.solver->impl->setCoreSolverTimeout(timeout * stage.timeoutFactor);
+    bool success = run(stage.solver);
+    runStatusCode = stage.solver->impl->getOperationStatusCode();
+    if (stage.timeoutFactor > 1)
+      stage.solver->impl->setCoreSolverTimeout(timeout);
+
+    if (success) {
+      if (stage.solved)
+        ++*stage.solved;
+      return true;
+    }
+    // the user asked to stop
+    if (runStatusCode == SOLVER_RUN_STATUS_INTERRUPTED)
+      return false;
+  }
+  return false;
+}
+
+Solver *createEscalatingSolver(Solver *primary, Solver *fallback,
+                               unsigned timeoutFactor) {
+  return new Solver(new EscalatingSolver(primary, fallback, timeoutFactor));
+}
+} // namespace klee
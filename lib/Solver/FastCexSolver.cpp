@@ -13,10 +13,14 @@
 #include "klee/Expr/Constraints.h"
 #include "klee/Expr/Expr.h"
 #include "klee/Expr/ExprEvaluator.h"
+#include "klee/Expr/ExprHashMap.h"
 #include "klee/Expr/ExprRangeEvaluator.h"
 #include "klee/Expr/ExprUtil.h"
 #include "klee/Expr/ExprVisitor.h"
+#include "klee/Expr/ValueRange.h"
 #include "klee/Solver/IncompleteSolver.h"
+#include "klee/Solver/SolverStats.h"
+#include "klee/Statistics/TimerStatIncrementer.h"
 
 #include "klee/Support/Debug.h"
 #include "klee/Support/IntEvaluation.h" // FIXME: Use APInt
@@ -30,277 +34,6 @@
 
 using namespace klee;
 
-// Hacker's Delight, pgs 58-63
-static uint64_t minOR(uint64_t a, uint64_t b,
-                      uint64_t c, uint64_t d) {
-  uint64_t temp, m = ((uint64_t) 1)<<63;
-  while (m) {
-    if (~a & c & m) {
-      temp = (a | m) & -m;
-      if (temp <= b) { a = temp; break; }
-    } else if (a & ~c & m) {
-      temp = (c | m) & -m;
-      if (temp <= d) { c = temp; break; }
-    }
-    m >>= 1;
-  }
-  
-  return a | c;
-}
-static uint64_t maxOR(uint64_t a, uint64_t b,
-                      uint64_t c, uint64_t d) {
-  uint64_t temp, m = ((uint64_t) 1)<<63;
-
-  while (m) {
-    if (b & d & m) {
-      temp = (b - m) | (m - 1);
-      if (temp >= a) { b = temp; break; }
-      temp = (d - m) | (m -1);
-      if (temp >= c) { d = temp; break; }
-    }
-    m >>= 1;
-  }
-
-  return b | d;
-}
-static uint64_t minAND(uint64_t a, uint64_t b,
-                       uint64_t c, uint64_t d) {
-  uint64_t temp, m = ((uint64_t) 1)<<63;
-  while (m) {
-    if (~a & ~c & m) {
-      temp = (a | m) & -m;
-      if (temp <= b) { a = temp; break; }
-      temp = (c | m) & -m;
-      if (temp <= d) { c = temp; break; }
-    }
-    m >>= 1;
-  }
-  
-  return a & c;
-}
-static uint64_t maxAND(uint64_t a, uint64_t b,
-                       uint64_t c, uint64_t d) {
-  uint64_t temp, m = ((uint64_t) 1)<<63;
-  while (m) {
-    if (b & ~d & m) {
-      temp = (b & ~m) | (m - 1);
-      if (temp >= a) { b = temp; break; }
-    } else if (~b & d & m) {
-      temp = (d & ~m) | (m - 1);
-      if (temp >= c) { d = temp; break; }
-    }
-    m >>= 1;
-  }
-  
-  return b & d;
-}
-
-///
-
-class ValueRange {
-private:
-  std::uint64_t m_min = 1, m_max = 0;
-
-public:
-  ValueRange() noexcept = default;
-  ValueRange(const ref<ConstantExpr> &ce) {
-    // FIXME: Support large widths.
-    m_min = m_max = ce->getLimitedValue();
-  }
-  explicit ValueRange(std::uint64_t value) noexcept
-      : m_min(value), m_max(value) {}
-  ValueRange(std::uint64_t _min, std::uint64_t _max) noexcept
-      : m_min(_min), m_max(_max) {}
-  ValueRange(const ValueRange &other) noexcept = default;
-  ValueRange &operator=(const ValueRange &other) noexcept = default;
-  ValueRange(ValueRange &&other) noexcept = default;
-  ValueRange &operator=(ValueRange &&other) noexcept = default;
-
-  void print(llvm::raw_ostream &os) const {
-    if (isFixed()) {
-      os << m_min;
-    } else {
-      os << "[" << m_min << "," << m_max << "]";
-    }
-  }
-
-  bool isEmpty() const noexcept { return m_min > m_max; }
-  bool contains(std::uint64_t value) const {
-    return this->intersects(ValueRange(value)); 
-  }
-  bool intersects(const ValueRange &b) const { 
-    return !this->set_intersection(b).isEmpty(); 
-  }
-
-  bool isFullRange(unsigned bits) const noexcept {
-    return m_min == 0 && m_max == bits64::maxValueOfNBits(bits);
-  }
-
-  ValueRange set_intersection(const ValueRange &b) const {
-    return ValueRange(std::max(m_min, b.m_min), std::min(m_max, b.m_max));
-  }
-  ValueRange set_union(const ValueRange &b) const {
-    return ValueRange(std::min(m_min, b.m_min), std::max(m_max, b.m_max));
-  }
-  ValueRange set_difference(const ValueRange &b) const {
-    if (b.isEmpty() || b.m_min > m_max || b.m_max < m_min) { // no intersection
-      return *this;
-    } else if (b.m_min <= m_min && b.m_max >= m_max) { // empty
-      return ValueRange(1, 0);
-    } else if (b.m_min <= m_min) { // one range out
-      // cannot overflow because b.m_max < m_max
-      return ValueRange(b.m_max + 1, m_max);
-    } else if (b.m_max >= m_max) {
-      // cannot overflow because b.min > m_min
-      return ValueRange(m_min, b.m_min - 1);
-    } else {
-      // two ranges, take bottom
-      return ValueRange(m_min, b.m_min - 1);
-    }
-  }
-  ValueRange binaryAnd(const ValueRange &b) const {
-    // XXX
-    assert(!isEmpty() && !b.isEmpty() && "XXX");
-    if (isFixed() && b.isFixed()) {
-      return ValueRange(m_min & b.m_min);
-    } else {
-      return ValueRange(minAND(m_min, m_max, b.m_min, b.m_max),
-                        maxAND(m_min, m_max, b.m_min, b.m_max));
-    }
-  }
-  ValueRange binaryAnd(std::uint64_t b) const {
-    return binaryAnd(ValueRange(b));
-  }
-  ValueRange binaryOr(ValueRange b) const {
-    // XXX
-    assert(!isEmpty() && !b.isEmpty() && "XXX");
-    if (isFixed() && b.isFixed()) {
-      return ValueRange(m_min | b.m_min);
-    } else {
-      return ValueRange(minOR(m_min, m_max, b.m_min, b.m_max),
-                        maxOR(m_min, m_max, b.m_min, b.m_max));
-    }
-  }
-  ValueRange binaryOr(std::uint64_t b) const { return binaryOr(ValueRange(b)); }
-  ValueRange binaryXor(ValueRange b) const {
-    if (isFixed() && b.isFixed()) {
-      return ValueRange(m_min ^ b.m_min);
-    } else {
-      std::uint64_t t = m_max | b.m_max;
-      while (!bits64::isPowerOfTwo(t))
-        t = bits64::withoutRightmostBit(t);
-      return ValueRange(0, (t << 1) - 1);
-    }
-  }
-
-  ValueRange binaryShiftLeft(unsigned bits) const {
-    return ValueRange(m_min << bits, m_max << bits);
-  }
-  ValueRange binaryShiftRight(unsigned bits) const {
-    return ValueRange(m_min >> bits, m_max >> bits);
-  }
-
-  ValueRange concat(const ValueRange &b, unsigned bits) const {
-    return binaryShiftLeft(bits).binaryOr(b);
-  }
-  ValueRange extract(std::uint64_t lowBit, std::uint64_t maxBit) const {
-    return binaryShiftRight(lowBit).binaryAnd(
-        bits64::maxValueOfNBits(maxBit - lowBit));
-  }
-
-  ValueRange add(const ValueRange &b, unsigned width) const {
-    return ValueRange(0, bits64::maxValueOfNBits(width));
-  }
-  ValueRange sub(const ValueRange &b, unsigned width) const {
-    return ValueRange(0, bits64::maxValueOfNBits(width));
-  }
-  ValueRange mul(const ValueRange &b, unsigned width) const {
-    return ValueRange(0, bits64::maxValueOfNBits(width));
-  }
-  ValueRange udiv(const ValueRange &b, unsigned width) const {
-    return ValueRange(0, bits64::maxValueOfNBits(width));
-  }
-  ValueRange sdiv(const ValueRange &b, unsigned width) const {
-    return ValueRange(0, bits64::maxValueOfNBits(width));
-  }
-  ValueRange urem(const ValueRange &b, unsigned width) const {
-    return ValueRange(0, bits64::maxValueOfNBits(width));
-  }
-  ValueRange srem(const ValueRange &b, unsigned width) const {
-    return ValueRange(0, bits64::maxValueOfNBits(width));
-  }
-
-  // use min() to get value if true (XXX should we add a method to
-  // make code clearer?)
-  bool isFixed() const noexcept { return m_min == m_max; }
-
-  bool operator==(const ValueRange &b) const noexcept {
-    return m_min == b.m_min && m_max == b.m_max;
-  }
-  bool operator!=(const ValueRange &b) const noexcept { return !(*this == b); }
-
-  bool mustEqual(const std::uint64_t b) const noexcept {
-    return m_min == m_max && m_min == b;
-  }
-  bool mayEqual(const std::uint64_t b) const noexcept {
-    return m_min <= b && m_max >= b;
-  }
-  
-  bool mustEqual(const ValueRange &b) const noexcept {
-    return isFixed() && b.isFixed() && m_min == b.m_min;
-  }
-  bool mayEqual(const ValueRange &b) const { return this->intersects(b); }
-
-  std::uint64_t min() const noexcept {
-    assert(!isEmpty() && "cannot get minimum of empty range");
-    return m_min; 
-  }
-
-  std::uint64_t max() const noexcept {
-    assert(!isEmpty() && "cannot get maximum of empty range");
-    return m_max; 
-  }
-  
-  std::int64_t minSigned(unsigned bits) const {
-    assert((m_min >> bits) == 0 && (m_max >> bits) == 0 &&
-           "range is outside given number of bits");
-
-    // if max allows sign bit to be set then it can be smallest value,
-    // otherwise since the range is not empty, min cannot have a sign
-    // bit
-
-    std::uint64_t smallest = (static_cast<std::uint64_t>(1) << (bits - 1));
-    if (m_max >= smallest) {
-      return ints::sext(smallest, 64, bits);
-    } else {
-      return m_min;
-    }
-  }
-
-  std::int64_t maxSigned(unsigned bits) const {
-    assert((m_min >> bits) == 0 && (m_max >> bits) == 0 &&
-           "range is outside given number of bits");
-
-    std::uint64_t smallest = (static_cast<std::uint64_t>(1) << (bits - 1));
-
-    // if max and min have sign bit then max is max, otherwise if only
-    // max has sign bit then max is largest signed integer, otherwise
-    // max is max
-
-    if (m_min < smallest && m_max >= smallest) {
-      return smallest - 1;
-    } else {
-      return ints::sext(m_max, 64, bits);
-    }
-  }
-};
-
-inline llvm::raw_ostream &operator<<(llvm::raw_ostream &os,
-                                     const ValueRange &vr) {
-  vr.print(os);
-  return os;
-}
-
 // XXX waste of space, rather have ByteValueRange
 typedef ValueRange CexValueData;
 
@@ -377,8 +110,8 @@ public:
     // Check for a concrete read of a constant array.
     if (array.isConstantArray() && 
         index.isFixed() && 
-        index.min() < array.constantValues.size())
-      return ValueRange(array.constantValues[index.min()]->getZExtValue(8));
+        index.min() < array.size)
+      return ValueRange(array.getConstantValue(index.min())->getZExtValue(8));
 
     return ValueRange(0, 255);
   }
@@ -456,6 +189,10 @@ public:
   void propagatePossibleValues(ref<Expr> e, CexValueData range) {
     KLEE_DEBUG(llvm::errs() << "propagate: " << range << " for\n" << e << "\n");
 
+    // an empty range, from conflicting guesses, has nothing to propagate
+    if (range.isEmpty())
+      return;
+
     switch (e->getKind()) {
     case Expr::Constant:
       // rather a pity if the constant isn't in the range, but how can
@@ -581,6 +318,8 @@ public:
         range.set_difference(ValueRange(1<<(inBits-1),
                                         (bits64::maxValueOfNBits(outBits) -
                                          bits64::maxValueOfNBits(inBits-1)-1)));
+      if (output.isEmpty())
+        break;
       ValueRange input = output.binaryAnd(bits64::maxValueOfNBits(inBits));
       propagatePossibleValues(ce->src, input);
       break;
@@ -828,7 +567,7 @@ public:
       if (index.isFixed()) {
         if (array->isConstantArray()) {
           // Verify the range.
-          propagateExactValues(array->constantValues[index.min()], range);
+          propagateExactValues(array->getConstantValue(index.min()), range);
         } else {
           CexValueData cvd = cod.getExactValues(index.min());
           if (range.min() > cvd.min()) {
@@ -976,15 +715,422 @@ public:
   }
 };
 
+/// CexBoundsData - Sound interval bounds for the values expressions take
+/// under the constraints of a query.
+///
+/// Unlike the possible and exact values above, which are guesses checked
+/// by evaluation, every range here contains all values of its expression in
+/// every model of the constraints. Assuming a constraint narrows the bounds
+/// of its subterms, from which the ranges of other expressions are
+/// evaluated, so the query may be decided without a model: if the query
+/// evaluates to a single value, or assuming it false leaves an expression
+/// without any value.
+class CexBoundsData : public ExprRangeEvaluator<ValueRange> {
+  /// The number of passes over the assumptions before giving up on a
+  /// fixpoint.
+  static const unsigned MaxRounds = 4;
+  /// The number of narrowing steps before giving up, as shared
+  /// subexpressions are visited once per use.
+  static const unsigned MaxSteps = 1u << 14;
+  /// The number of elements of a constant array scanned for a read.
+  static const unsigned MaxScannedElements = 4096;
+
+  /// The ranges learned for terms from the assumptions.
+  ExprHashMap<ValueRange> bounds;
+  /// The ranges evaluated since the bounds were last narrowed.
+  ExprHashMap<ValueRange> cache;
+  std::vector<std::pair<ref<Expr>, bool>> assumptions;
+  unsigned steps = 0;
+  bool changed = false;
+  bool infeasible = false;
+  bool unsupported = false;
+
+public:
+  /// assume - Add the assumption that e has the given truth value.
+  void assume(const ref<Expr> &e, bool value) {
+    assumptions.emplace_back(e, value);
+  }
+
+  /// propagate - Narrow the bounds so that all assumptions hold, until a
+  /// fixpoint is reached or too many passes were made.
+  void propagate() {
+    for (unsigned round = 0; round != MaxRounds; ++round) {
+      changed = false;
+      for (const auto &assumption : assumptions) {
+        narrow(assumption.first, ValueRange(assumption.second));
+        if (infeasible || unsupported)
+          return;
+      }
+      if (!changed)
+        return;
+    }
+  }
+
+  /// isInfeasible - Whether the assumptions cannot all hold.
+  bool isInfeasible() const { return infeasible; }
+
+  /// isUnsupported - Whether an expression wider than 64 bits was met, for
+  /// which the bounds are meaningless.
+  bool isUnsupported() const { return unsupported; }
+
+  ValueRange evaluate(const ref<Expr> &e) override {
+    if (e->getWidth() > 64) {
+      unsupported = true;
+      return ValueRange(0, UINT64_MAX);
+    }
+    if (isa<ConstantExpr>(e))
+      return ExprRangeEvaluator<ValueRange>::evaluate(e);
+
+    auto cached = cache.find(e);
+    if (cached != cache.end())
+      return cached->second;
+
+    ValueRange range = ExprRangeEvaluator<ValueRange>::evaluate(e);
+    auto it = bounds.find(e);
+    if (it != bounds.end()) {
+      ValueRange narrowed = range.set_intersection(it->second);
+      if (narrowed.isEmpty())
+        infeasible = true;
+      else
+        range = narrowed;
+    }
+    cache.emplace(e, range);
+    return range;
+  }
+
+protected:
+  ValueRange getInitialReadRange(const Array &array,
+                                 ValueRange index) override {
+    ValueRange full(0, bits64::maxValueOfNBits(array.getRange()));
+    if (!array.isConstantArray() || index.max() >= array.size ||
+        index.max() - index.min() >= MaxScannedElements)
+      return full;
+
+    ValueRange range;
+    for (uint64_t i = index.min(); i <= index.max(); ++i)
+      range = range.set_union(
+          ValueRange(array.getConstantValue(i)->getZExtValue()));
+    return range;
+  }
+
+private:
+  /// narrow - Narrow the bounds so that e only takes values in range, and
+  /// propagate this into its kids where the operation can be inverted.
+  void narrow(const ref<Expr> &e, ValueRange range) {
+    if (infeasible || unsupported || ++steps > MaxSteps)
+      return;
+
+    ValueRange current = evaluate(e);
+    if (unsupported)
+      return;
+    range = current.set_intersection(range);
+    if (range.isEmpty()) {
+      infeasible = true;
+      return;
+    }
+    if (isa<ConstantExpr>(e))
+      return;
+    if (range != current) {
+      bounds[e] = range;
+      cache.clear();
+      changed = true;
+    }
+
+    uint64_t max = bits64::maxValueOfNBits(e->getWidth());
+    switch (e->getKind()) {
+    case Expr::Read:
+      narrowReadIndex(cast<ReadExpr>(e), range);
+      break;
+
+    case Expr::Select: {
+      SelectExpr *se = cast<SelectExpr>(e);
+      ValueRange cond = evaluate(se->cond);
+      if (cond.isFixed()) {
+        narrow(cond.min() ? se->trueExpr : se->falseExpr, range);
+      } else if (!evaluate(se->trueExpr).intersects(range)) {
+        narrow(se->cond, ValueRange(0));
+        narrow(se->falseExpr, range);
+      } else if (!evaluate(se->falseExpr).intersects(range)) {
+        narrow(se->cond, ValueRange(1));
+        narrow(se->trueExpr, range);
+      }
+      break;
+    }
+
+    case Expr::Concat: {
+      ConcatExpr *ce = cast<ConcatExpr>(e);
+      Expr::Width lsbWidth = ce->getKid(1)->getWidth();
+      uint64_t msbMin = range.min() >> lsbWidth, msbMax = range.max() >> lsbWidth;
+      narrow(ce->getKid(0), ValueRange(msbMin, msbMax));
+      if (msbMin == msbMax) {
+        uint64_t lsbMask = bits64::maxValueOfNBits(lsbWidth);
+        narrow(ce->getKid(1),
+               ValueRange(range.min() & lsbMask, range.max() & lsbMask));
+      }
+      break;
+    }
+
+    case Expr::Extract: {
+      ExtractExpr *ee = cast<ExtractExpr>(e);
+      if (ee->offset == 0 && evaluate(ee->expr).max() <= max)
+        narrow(ee->expr, range);
+      break;
+    }
+
+      // Casting
+
+    case Expr::ZExt:
+      narrow(cast<CastExpr>(e)->src, range);
+      break;
+
+    case Expr::SExt: {
+      // the kid keeps its value if it is non-negative, and is offset by the
+      // extended sign bits otherwise
+      CastExpr *ce = cast<CastExpr>(e);
+      Expr::Width inBits = ce->src->getWidth();
+      uint64_t signMax = bits64::maxValueOfNBits(inBits - 1);
+      uint64_t inMax = bits64::maxValueOfNBits(inBits);
+      if (range.max() <= signMax)
+        narrow(ce->src, range);
+      else if (range.min() >= max - signMax)
+        narrow(ce->src, ValueRange(range.min() & inMax, range.max() & inMax));
+      break;
+    }
+
+      // Arithmetic
+
+    case Expr::Add: {
+      BinaryExpr *be = cast<BinaryExpr>(e);
+      ValueRange left = evaluate(be->left), right = evaluate(be->right);
+      if (right.max() <= max - left.max()) {
+        // no sum wraps around: X + Y \in [MIN, MAX] ==> X \in [MIN - Y, MAX - Y]
+        narrow(be->left, differences(range, right));
+        narrow(be->right, differences(range, left));
+      } else if (left.isFixed()) {
+        // C + X \in [MIN, MAX] ==> X \in [MIN - C, MAX - C] modulo the width,
+        // unless that wraps around
+        uint64_t low = (range.min() - left.min()) & max;
+        uint64_t high = (range.max() - left.min()) & max;
+        if (low <= high)
+          narrow(be->right, ValueRange(low, high));
+      }
+      break;
+    }
+
+    case Expr::Sub: {
+      BinaryExpr *be = cast<BinaryExpr>(e);
+      ValueRange left = evaluate(be->left), right = evaluate(be->right);
+      if (left.min() >= right.max()) {
+        // no difference wraps around: X - Y \in [MIN, MAX] ==>
+        // X \in [MIN + Y, MAX + Y] and Y \in [X - MAX, X - MIN]
+        uint64_t leftMax = right.max() <= max - range.max()
+                               ? range.max() + right.max()
+                               : max;
+        narrow(be->left, ValueRange(range.min() + right.min(), leftMax));
+        narrow(be->right, differences(left, range));
+      }
+      break;
+    }
+
+    case Expr::Mul: {
+      BinaryExpr *be = cast<BinaryExpr>(e);
+      ValueRange left = evaluate(be->left), right = evaluate(be->right);
+      if (left.isFixed() && left.min() && right.max() <= max / left.min()) {
+        // C * X \in [MIN, MAX] ==> X \in [ceil(MIN / C), floor(MAX / C)]
+        uint64_t c = left.min();
+        narrow(be->right,
+               ValueRange(range.min() / c + (range.min() % c != 0),
+                          range.max() / c));
+      }
+      break;
+    }
+
+      // Binary
+
+    case Expr::Not:
+      narrow(cast<NotExpr>(e)->expr,
+             ValueRange(max - range.max(), max - range.min()));
+      break;
+
+    case Expr::And: {
+      BinaryExpr *be = cast<BinaryExpr>(e);
+      if (be->getWidth() == Expr::Bool) {
+        if (range.mustEqual(1)) {
+          narrow(be->left, ValueRange(1));
+          narrow(be->right, ValueRange(1));
+        } else if (range.mustEqual(0)) {
+          if (evaluate(be->left).mustEqual(1))
+            narrow(be->right, ValueRange(0));
+          else if (evaluate(be->right).mustEqual(1))
+            narrow(be->left, ValueRange(0));
+        }
+      } else {
+        // X & Y is at most either of X and Y
+        narrow(be->left, ValueRange(range.min(), max));
+        narrow(be->right, ValueRange(range.min(), max));
+      }
+      break;
+    }
+
+    case Expr::Or: {
+      BinaryExpr *be = cast<BinaryExpr>(e);
+      if (be->getWidth() == Expr::Bool) {
+        if (range.mustEqual(0)) {
+          narrow(be->left, ValueRange(0));
+          narrow(be->right, ValueRange(0));
+        } else if (range.mustEqual(1)) {
+          if (evaluate(be->left).mustEqual(0))
+            narrow(be->right, ValueRange(1));
+          else if (evaluate(be->right).mustEqual(0))
+            narrow(be->left, ValueRange(1));
+        }
+      } else {
+        // X | Y is at least either of X and Y
+        narrow(be->left, ValueRange(0, range.max()));
+        narrow(be->right, ValueRange(0, range.max()));
+      }
+      break;
+    }
+
+      // Comparison
+
+    case Expr::Eq: {
+      BinaryExpr *be = cast<BinaryExpr>(e);
+      ValueRange left = evaluate(be->left), right = evaluate(be->right);
+      if (range.mustEqual(1)) {
+        narrow(be->left, right);
+        narrow(be->right, left);
+      } else if (range.mustEqual(0)) {
+        if (right.isFixed())
+          narrow(be->left, without(left, right.min()));
+        if (left.isFixed())
+          narrow(be->right, without(right, left.min()));
+      }
+      break;
+    }
+
+    case Expr::Ult:
+    case Expr::Ule:
+      if (range.isFixed())
+        narrowComparison(cast<BinaryExpr>(e), range.min());
+      break;
+
+    case Expr::Slt:
+    case Expr::Sle: {
+      // signed comparisons of non-negative values are unsigned ones
+      BinaryExpr *be = cast<BinaryExpr>(e);
+      uint64_t signMax = bits64::maxValueOfNBits(be->left->getWidth() - 1);
+      if (range.isFixed() && evaluate(be->left).max() <= signMax &&
+          evaluate(be->right).max() <= signMax)
+        narrowComparison(be, range.min());
+      break;
+    }
+
+    case Expr::Ne:
+    case Expr::Ugt:
+    case Expr::Uge:
+    case Expr::Sgt:
+    case Expr::Sge:
+      assert(0 && "invalid expressions (uncanonicalized)");
+
+    default:
+      break;
+    }
+  }
+
+  /// narrowComparison - Narrow the kids of an (unsigned) less than or less
+  /// or equal comparison with the given outcome.
+  void narrowComparison(BinaryExpr *be, bool holds) {
+    ValueRange left = evaluate(be->left), right = evaluate(be->right);
+    uint64_t max = bits64::maxValueOfNBits(be->left->getWidth());
+    // X < Y is X <= Y - 1, and !(X <= Y) is Y <= X - 1
+    bool strict = (be->getKind() == Expr::Ult || be->getKind() == Expr::Slt);
+    if (holds) {
+      if (strict && (!right.max() || left.min() == max)) {
+        infeasible = true;
+        return;
+      }
+      narrow(be->left, ValueRange(0, right.max() - strict));
+      narrow(be->right, ValueRange(left.min() + strict, max));
+    } else {
+      if (!strict && (!left.max() || right.min() == max)) {
+        infeasible = true;
+        return;
+      }
+      narrow(be->left, ValueRange(right.min() + !strict, max));
+      narrow(be->right, ValueRange(0, left.max() - !strict));
+    }
+  }
+
+  /// narrowReadIndex - Narrow the index of a read from a constant array to
+  /// the elements with a value in range.
+  void narrowReadIndex(ReadExpr *re, const ValueRange &range) {
+    const Array *array = re->updates.root;
+    if (re->updates.head || !array->isConstantArray())
+      return;
+
+    ValueRange index = evaluate(re->index);
+    if (index.min() >= array->size ||
+        index.max() - index.min() >= MaxScannedElements)
+      return;
+
+    // reads past the end are unconstrained
+    uint64_t last = std::min<uint64_t>(index.max(), array->size - 1);
+    uint64_t low = UINT64_MAX, high = 0;
+    for (uint64_t i = index.min(); i <= last; ++i) {
+      if (range.contains(array->getConstantValue(i)->getZExtValue())) {
+        low = std::min(low, i);
+        high = i;
+      }
+    }
+    if (index.max() > last) {
+      low = std::min(low, last + 1);
+      high = index.max();
+    }
+    narrow(re->index, ValueRange(low, high));
+  }
+
+  /// differences - Return the range of X - Y for X in a and Y in b, clamped
+  /// at zero.
+  static ValueRange differences(const ValueRange &a, const ValueRange &b) {
+    return ValueRange(a.min() > b.max() ? a.min() - b.max() : 0,
+                      a.max() > b.min() ? a.max() - b.min() : 0);
+  }
+
+  /// without - Return the range of a without the given value, which is only
+  /// smaller if the value is at one of its ends.
+  static ValueRange without(const ValueRange &a, uint64_t value) {
+    if (a.mustEqual(value))
+      return ValueRange();
+    if (a.min() == value)
+      return ValueRange(value + 1, a.max());
+    if (a.max() == value)
+      return ValueRange(a.min(), value - 1);
+    return a;
+  }
+};
+
 /* *** */
 
 
 class FastCexSolver : public IncompleteSolver {
+  /// computeBoundedValidity - Decide the query with the interval bounds of
+  /// CexBoundsData alone. \return MustBeTrue, MustBeFalse or None
+  IncompleteSolver::PartialValidity computeBoundedValidity(const Query&);
+  /// computePropagatedTruth - Decide the truth of the query with the
+  /// possible and exact values of CexData.
+  IncompleteSolver::PartialValidity computePropagatedTruth(const Query&);
+  bool computePropagatedValue(const Query&, ref<Expr> &result);
+  bool computePropagatedInitialValues(const Query&,
+                                      std::shared_ptr<const Assignment> &result,
+                                      bool &hasSolution);
+
 public:
   FastCexSolver();
   ~FastCexSolver();
 
-  IncompleteSolver::PartialValidity computeTruth(const Query&);  
+  IncompleteSolver::PartialValidity computeValidity(const Query&);
+  IncompleteSolver::PartialValidity computeTruth(const Query&);
   bool computeValue(const Query&, ref<Expr> &result);
   bool computeInitialValues(const Query&,
                             std::shared_ptr<const Assignment> &result,
@@ -1055,8 +1201,36 @@ static bool propagateValues(const Query &query, CexData &cd, bool checkExpr,
   return false;
 }
 
-IncompleteSolver::PartialValidity 
-FastCexSolver::computeTruth(const Query& query) {
+IncompleteSolver::PartialValidity
+FastCexSolver::computeBoundedValidity(const Query &query) {
+  CexBoundsData bd;
+  for (const auto &constraint : query.constraints)
+    bd.assume(constraint, true);
+  bd.propagate();
+  if (bd.isUnsupported())
+    return IncompleteSolver::None;
+  // If the constraints cannot hold, then anything follows from them.
+  if (bd.isInfeasible())
+    return IncompleteSolver::MustBeTrue;
+
+  ValueRange result = bd.evaluate(query.expr);
+  if (bd.isUnsupported())
+    return IncompleteSolver::None;
+  if (result.mustEqual(1))
+    return IncompleteSolver::MustBeTrue;
+  if (result.mustEqual(0))
+    return IncompleteSolver::MustBeFalse;
+
+  // Otherwise the query is valid if the constraints cannot hold without it.
+  bd.assume(query.expr, false);
+  bd.propagate();
+  if (!bd.isUnsupported() && bd.isInfeasible())
+    return IncompleteSolver::MustBeTrue;
+  return IncompleteSolver::None;
+}
+
+IncompleteSolver::PartialValidity
+FastCexSolver::computePropagatedTruth(const Query &query) {
   CexData cd;
 
   bool isValid;
@@ -1068,7 +1242,86 @@ FastCexSolver::computeTruth(const Query& query) {
   return isValid ? IncompleteSolver::MustBeTrue : IncompleteSolver::MayBeFalse;
 }
 
-bool FastCexSolver::computeValue(const Query& query, ref<Expr> &result) {
+IncompleteSolver::PartialValidity
+FastCexSolver::computeValidity(const Query &query) {
+  TimerStatIncrementer t(stats::fastCexTime);
+  IncompleteSolver::PartialValidity result = computeBoundedValidity(query);
+  if (result != IncompleteSolver::None) {
+    ++stats::fastCexBoundsDecided;
+    ++stats::fastCexDecided;
+    return result;
+  }
+
+  // As IncompleteSolver::computeValidity, without deciding the bounds again.
+  IncompleteSolver::PartialValidity trueResult = computePropagatedTruth(query);
+  if (trueResult == IncompleteSolver::MustBeTrue) {
+    result = IncompleteSolver::MustBeTrue;
+  } else {
+    IncompleteSolver::PartialValidity falseResult =
+        computePropagatedTruth(query.negateExpr());
+    bool trueCorrect = trueResult != IncompleteSolver::None,
+         falseCorrect = falseResult != IncompleteSolver::None;
+    if (falseResult == IncompleteSolver::MustBeTrue)
+      result = IncompleteSolver::MustBeFalse;
+    else if (trueCorrect && falseCorrect)
+      result = IncompleteSolver::TrueOrFalse;
+    else if (trueCorrect)
+      result = IncompleteSolver::MayBeFalse;
+    else if (falseCorrect)
+      result = IncompleteSolver::MayBeTrue;
+  }
+
+  // Partial results still leave a truth query to the next solver.
+  if (result == IncompleteSolver::MustBeTrue ||
+      result == IncompleteSolver::MustBeFalse ||
+      result == IncompleteSolver::TrueOrFalse)
+    ++stats::fastCexDecided;
+  else
+    ++stats::fastCexDeferred;
+  return result;
+}
+
+IncompleteSolver::PartialValidity
+FastCexSolver::computeTruth(const Query &query) {
+  TimerStatIncrementer t(stats::fastCexTime);
+  IncompleteSolver::PartialValidity result = computeBoundedValidity(query);
+  if (result != IncompleteSolver::None) {
+    ++stats::fastCexBoundsDecided;
+  } else {
+    result = computePropagatedTruth(query);
+  }
+
+  if (result != IncompleteSolver::None)
+    ++stats::fastCexDecided;
+  else
+    ++stats::fastCexDeferred;
+  return result;
+}
+
+bool FastCexSolver::computeValue(const Query &query, ref<Expr> &result) {
+  TimerStatIncrementer t(stats::fastCexTime);
+  CexBoundsData bd;
+  for (const auto &constraint : query.constraints)
+    bd.assume(constraint, true);
+  bd.propagate();
+  ValueRange range = bd.evaluate(query.expr);
+  if (!bd.isUnsupported() && !bd.isInfeasible() && range.isFixed()) {
+    ++stats::fastCexBoundsDecided;
+    ++stats::fastCexDecided;
+    result = ConstantExpr::alloc(range.min(), query.expr->getWidth());
+    return true;
+  }
+
+  if (!computePropagatedValue(query, result)) {
+    ++stats::fastCexDeferred;
+    return false;
+  }
+  ++stats::fastCexDecided;
+  return true;
+}
+
+bool FastCexSolver::computePropagatedValue(const Query &query,
+                                           ref<Expr> &result) {
   CexData cd;
 
   bool isValid;
@@ -1099,6 +1352,18 @@ FastCexSolver::computeInitialValues(const Query& query,
                                     std::shared_ptr<const Assignment>
                                       &result,
                                     bool &hasSolution) {
+  TimerStatIncrementer t(stats::fastCexTime);
+  if (!computePropagatedInitialValues(query, result, hasSolution)) {
+    ++stats::fastCexDeferred;
+    return false;
+  }
+  ++stats::fastCexDecided;
+  return true;
+}
+
+bool FastCexSolver::computePropagatedInitialValues(
+    const Query &query, std::shared_ptr<const Assignment> &result,
+    bool &hasSolution) {
   CexData cd;
 
   bool isValid;
@@ -8,252 +8,43 @@
 //===----------------------------------------------------------------------===//
 
 #define DEBUG_TYPE "independent-solver"
+#include "SolverMessage.h"
+
 #include "klee/Solver/Solver.h"
 
 #include "klee/Expr/Assignment.h"
 #include "klee/Expr/Constraints.h"
 #include "klee/Expr/Expr.h"
 #include "klee/Expr/ExprUtil.h"
+#include "klee/Expr/IndependentSet.h"
 #include "klee/Support/Debug.h"
+#include "klee/Support/ErrorHandling.h"
+#include "klee/Support/OptionCategories.h"
 #include "klee/Solver/SolverImpl.h"
 
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Errno.h"
 #include "llvm/Support/raw_ostream.h"
 
+#include <csignal>
 #include <list>
 #include <map>
 #include <ostream>
+#include <sys/wait.h>
+#include <unistd.h>
 #include <vector>
 
 using namespace klee;
 using namespace llvm;
 
-template<class T>
-class DenseSet {
-  typedef std::set<T> set_ty;
-  set_ty s;
-
-public:
-  DenseSet() {}
-
-  void add(T x) {
-    s.insert(x);
-  }
-  void add(T start, T end) {
-    for (; start<end; start++)
-      s.insert(start);
-  }
-
-  // returns true iff set is changed by addition
-  bool add(const DenseSet &b) {
-    bool modified = false;
-    for (typename set_ty::const_iterator it = b.s.begin(), ie = b.s.end(); 
-         it != ie; ++it) {
-      if (modified || !s.count(*it)) {
-        modified = true;
-        s.insert(*it);
-      }
-    }
-    return modified;
-  }
-
-  bool intersects(const DenseSet &b) {
-    for (typename set_ty::iterator it = s.begin(), ie = s.end(); 
-         it != ie; ++it)
-      if (b.s.count(*it))
-        return true;
-    return false;
-  }
-
-  std::set<unsigned>::iterator begin(){
-    return s.begin();
-  }
-
-  std::set<unsigned>::iterator end(){
-    return s.end();
-  }
-
-  void print(llvm::raw_ostream &os) const {
-    bool first = true;
-    os << "{";
-    for (typename set_ty::iterator it = s.begin(), ie = s.end(); 
-         it != ie; ++it) {
-      if (first) {
-        first = false;
-      } else {
-        os << ",";
-      }
-      os << *it;
-    }
-    os << "}";
-  }
-};
-
-template <class T>
-inline llvm::raw_ostream &operator<<(llvm::raw_ostream &os,
-                                     const ::DenseSet<T> &dis) {
-  dis.print(os);
-  return os;
-}
-
-class IndependentElementSet {
-public:
-  typedef std::map<const Array*, ::DenseSet<unsigned> > elements_ty;
-  elements_ty elements;                 // Represents individual elements of array accesses (arr[1])
-  std::set<const Array*> wholeObjects;  // Represents symbolically accessed arrays (arr[x])
-  std::vector<ref<Expr> > exprs;        // All expressions that are associated with this factor
-                                        // Although order doesn't matter, we use a vector to match
-                                        // the ConstraintManager constructor that will eventually
-                                        // be invoked.
-
-  IndependentElementSet() {}
-  IndependentElementSet(ref<Expr> e) {
-    exprs.push_back(e);
-    // Track all reads in the program.  Determines whether reads are
-    // concrete or symbolic.  If they are symbolic, "collapses" array
-    // by adding it to wholeObjects.  Otherwise, creates a mapping of
-    // the form Map<array, set<index>> which tracks which parts of the
-    // array are being accessed.
-    std::vector< ref<ReadExpr> > reads;
-    findReads(e, /* visitUpdates= */ true, reads);
-    for (unsigned i = 0; i != reads.size(); ++i) {
-      ReadExpr *re = reads[i].get();
-      const Array *array = re->updates.root;
-      
-      // Reads of a constant array don't alias.
-      if (re->updates.root->isConstantArray() && !re->updates.head)
-        continue;
-
-      if (!wholeObjects.count(array)) {
-        if (ConstantExpr *CE = dyn_cast<ConstantExpr>(re->index)) {
-          // if index constant, then add to set of constraints operating
-          // on that array (actually, don't add constraint, just set index)
-          ::DenseSet<unsigned> &dis = elements[array];
-          dis.add((unsigned) CE->getZExtValue(32));
-        } else {
-          elements_ty::iterator it2 = elements.find(array);
-          if (it2!=elements.end())
-            elements.erase(it2);
-          wholeObjects.insert(array);
-        }
-      }
-    }
-  }
-  IndependentElementSet(const IndependentElementSet &ies) : 
-    elements(ies.elements),
-    wholeObjects(ies.wholeObjects),
-    exprs(ies.exprs) {}
-
-  IndependentElementSet &operator=(const IndependentElementSet &ies) {
-    elements = ies.elements;
-    wholeObjects = ies.wholeObjects;
-    exprs = ies.exprs;
-    return *this;
-  }
-
-  void print(llvm::raw_ostream &os) const {
-    os << "{";
-    bool first = true;
-    for (std::set<const Array*>::iterator it = wholeObjects.begin(), 
-           ie = wholeObjects.end(); it != ie; ++it) {
-      const Array *array = *it;
-
-      if (first) {
-        first = false;
-      } else {
-        os << ", ";
-      }
-
-      os << "MO" << array->name;
-    }
-    for (elements_ty::const_iterator it = elements.begin(), ie = elements.end();
-         it != ie; ++it) {
-      const Array *array = it->first;
-      const ::DenseSet<unsigned> &dis = it->second;
-
-      if (first) {
-        first = false;
-      } else {
-        os << ", ";
-      }
-
-      os << "MO" << array->name << " : " << dis;
-    }
-    os << "}";
-  }
-
-  // more efficient when this is the smaller set
-  bool intersects(const IndependentElementSet &b) {
-    // If there are any symbolic arrays in our query that b accesses
-    for (std::set<const Array*>::iterator it = wholeObjects.begin(), 
-           ie = wholeObjects.end(); it != ie; ++it) {
-      const Array *array = *it;
-      if (b.wholeObjects.count(array) || 
-          b.elements.find(array) != b.elements.end())
-        return true;
-    }
-    for (elements_ty::iterator it = elements.begin(), ie = elements.end();
-         it != ie; ++it) {
-      const Array *array = it->first;
-      // if the array we access is symbolic in b
-      if (b.wholeObjects.count(array))
-        return true;
-      elements_ty::const_iterator it2 = b.elements.find(array);
-      // if any of the elements we access are also accessed by b
-      if (it2 != b.elements.end()) {
-        if (it->second.intersects(it2->second))
-          return true;
-      }
-    }
-    return false;
-  }
-
-  // returns true iff set is changed by addition
-  bool add(const IndependentElementSet &b) {
-    for(unsigned i = 0; i < b.exprs.size(); i ++){
-      ref<Expr> expr = b.exprs[i];
-      exprs.push_back(expr);
-    }
-
-    bool modified = false;
-    for (std::set<const Array*>::const_iterator it = b.wholeObjects.begin(), 
-           ie = b.wholeObjects.end(); it != ie; ++it) {
-      const Array *array = *it;
-      elements_ty::iterator it2 = elements.find(array);
-      if (it2!=elements.end()) {
-        modified = true;
-        elements.erase(it2);
-        wholeObjects.insert(array);
-      } else {
-        if (!wholeObjects.count(array)) {
-          modified = true;
-          wholeObjects.insert(array);
-        }
-      }
-    }
-    for (elements_ty::const_iterator it = b.elements.begin(), 
-           ie = b.elements.end(); it != ie; ++it) {
-      const Array *array = it->first;
-      if (!wholeObjects.count(array)) {
-        elements_ty::iterator it2 = elements.find(array);
-        if (it2==elements.end()) {
-          modified = true;
-          elements.insert(*it);
-        } else {
-          // Now need to see if there are any (z=?)'s
-          if (it2->second.add(it->second))
-            modified = true;
-        }
-      }
-    }
-    return modified;
-  }
-};
-
-inline llvm::raw_ostream &operator<<(llvm::raw_ostream &os,
-                                     const IndependentElementSet &ies) {
-  ies.print(os);
-  return os;
-}
+namespace {
+cl::opt<unsigned> IndependentSolverJobs(
+    "independent-solver-jobs", cl::init(1),
+    cl::desc("Solve the independent factors of a query for a counterexample "
+             "in up to this many processes at once. Counterexamples found "
+             "by forked processes are not cached (default=1)"),
+    cl::cat(SolvingCat));
+} // namespace
 
 // Breaks down a constraint into all of it's individual pieces, returning a
 // list of IndependentElementSets or the independent factors.
@@ -262,6 +53,19 @@ inline llvm::raw_ostream &operator<<(llvm::raw_ostream &os,
 static std::list<IndependentElementSet>*
 getAllIndependentConstraintsSets(const Query &query) {
   std::list<IndependentElementSet> *factors = new std::list<IndependentElementSet>();
+  if (const IndependentPartition *partition =
+          query.constraints.getIndependentPartition()) {
+    // the constraints are split already, only the expression is added
+    std::shared_ptr<const IndependentPartition> extended;
+    if (!isa<ConstantExpr>(query.expr)) {
+      extended = partition->extend(Expr::createIsZero(query.expr));
+      partition = extended.get();
+    }
+    for (const auto &factor : partition->getFactors())
+      factors->push_back(*factor);
+    return factors;
+  }
+
   ConstantExpr *CE = dyn_cast<ConstantExpr>(query.expr);
   if (CE) {
     assert(CE && CE->isFalse() && "the expr should always be false and "
@@ -321,6 +125,21 @@ static
 IndependentElementSet getIndependentConstraints(const Query& query,
                                                 std::vector< ref<Expr> > &result) {
   IndependentElementSet eltsClosure(query.expr);
+  if (const IndependentPartition *partition =
+          query.constraints.getIndependentPartition()) {
+    // The factors are independent of each other, so those that intersect
+    // the expression are all that is required.
+    IndependentElementSet exprElements = eltsClosure;
+    for (const auto &factor : partition->getFactors()) {
+      if (exprElements.intersects(*factor)) {
+        eltsClosure.add(*factor);
+        result.insert(result.end(), factor->exprs.begin(),
+                      factor->exprs.end());
+      }
+    }
+    return eltsClosure;
+  }
+
   std::vector< std::pair<ref<Expr>, IndependentElementSet> > worklist;
 
   for (const auto &constraint : query.constraints)
@@ -372,7 +191,7 @@ static
 void calculateArrayReferences(const IndependentElementSet & ie,
                               std::vector<const Array *> &returnVector){
   std::set<const Array*> thisSeen;
-  for(std::map<const Array*, ::DenseSet<unsigned> >::const_iterator it = ie.elements.begin();
+  for(IndependentElementSet::elements_ty::const_iterator it = ie.elements.begin();
       it != ie.elements.end(); it ++){
     thisSeen.insert(it->first);
   }
@@ -389,6 +208,13 @@ void calculateArrayReferences(const IndependentElementSet & ie,
 class IndependentSolver : public SolverImpl {
 private:
   Solver *solver;
+  /// Set if a forked process failed to solve a factor of the last query.
+  bool forkedFailure = false;
+  SolverRunStatus forkedRunStatus = SOLVER_RUN_STATUS_FAILURE;
+
+  bool solveFactors(const std::vector<const IndependentElementSet *> &factors,
+                    std::vector<std::shared_ptr<const Assignment>> &assignments,
+                    bool &hasSolution);
 
 public:
   IndependentSolver(Solver *_solver) 
@@ -408,6 +234,7 @@ public:
   
 bool IndependentSolver::computeValidity(const Query& query,
                                         Solver::Validity &result) {
+  forkedFailure = false;
   std::vector< ref<Expr> > required;
   IndependentElementSet eltsClosure =
     getIndependentConstraints(query, required);
@@ -417,6 +244,7 @@ bool IndependentSolver::computeValidity(const Query& query,
 }
 
 bool IndependentSolver::computeTruth(const Query& query, bool &isValid) {
+  forkedFailure = false;
   std::vector< ref<Expr> > required;
   IndependentElementSet eltsClosure = 
     getIndependentConstraints(query, required);
@@ -426,6 +254,7 @@ bool IndependentSolver::computeTruth(const Query& query, bool &isValid) {
 }
 
 bool IndependentSolver::computeValue(const Query& query, ref<Expr> &result) {
+  forkedFailure = false;
   std::vector< ref<Expr> > required;
   IndependentElementSet eltsClosure = 
     getIndependentConstraints(query, required);
@@ -454,9 +283,142 @@ bool assertCreatedPointEvaluatesToTrue(const Query &query,
   return cast<ConstantExpr>(q)->isTrue();
 }
 
+/// Body of a process solving every jobs-th factor, starting with the first.
+/// The answers are written to fd until a factor is not solved.
+[[noreturn]] static void
+runFactorJob(Solver *solver,
+             const std::vector<const IndependentElementSet *> &factors,
+             size_t first, size_t jobs, int fd) {
+  SolverMessage message;
+  for (size_t i = first; i < factors.size(); i += jobs) {
+    ConstraintSet tmp(factors[i]->exprs);
+    std::shared_ptr<const Assignment> assignment;
+    bool hasSolution;
+    if (!solver->impl->computeInitialValues(
+            Query(tmp, ConstantExpr::alloc(0, Expr::Bool)), assignment,
+            hasSolution)) {
+      message.put<uint8_t>(0);
+      message.put<int32_t>(solver->impl->getOperationStatusCode());
+      break;
+    }
+    message.put<uint8_t>(hasSolution ? 2 : 1);
+    if (!hasSolution)
+      break;
+    std::vector<const Array *> arrays;
+    calculateArrayReferences(*factors[i], arrays);
+    for (const Array *array : arrays) {
+      const CompactArrayModel *model = assignment->getBindingsOrNull(array);
+      message.put<uint8_t>(model != nullptr);
+      if (model)
+        message.put(model->asVector());
+    }
+  }
+  message.send(fd);
+  _exit(0);
+}
+
+/// Solves the factors in up to IndependentSolverJobs processes, this one
+/// included, and stores the assignment of factor i in assignments[i].
+bool IndependentSolver::solveFactors(
+    const std::vector<const IndependentElementSet *> &factors,
+    std::vector<std::shared_ptr<const Assignment>> &assignments,
+    bool &hasSolution) {
+  size_t jobs = std::min<size_t>(IndependentSolverJobs, factors.size());
+  assignments.assign(factors.size(), nullptr);
+  hasSolution = true;
+
+  fflush(stdout);
+  fflush(stderr);
+
+  struct Process {
+    pid_t pid;
+    int fd;
+    size_t first;
+  };
+  std::vector<Process> processes;
+  // jobs that could not be forked are solved here, with the first one
+  std::vector<size_t> localJobs{0};
+  for (size_t job = 1; job < jobs; ++job) {
+    int fds[2];
+    if (pipe(fds) < 0) {
+      klee_warning("pipe failed (for independent solver) - %s",
+                   llvm::sys::StrError(errno).c_str());
+      localJobs.push_back(job);
+      continue;
+    }
+    pid_t pid = fork();
+    if (pid == -1) {
+      klee_warning("fork failed (for independent solver) - %s",
+                   llvm::sys::StrError(errno).c_str());
+      close(fds[0]);
+      close(fds[1]);
+      localJobs.push_back(job);
+      continue;
+    }
+    if (pid == 0) {
+      close(fds[0]);
+      runFactorJob(solver, factors, job, jobs, fds[1]);
+    }
+    close(fds[1]);
+    processes.push_back({pid, fds[0], job});
+  }
+
+  bool success = true;
+  for (size_t job : localJobs) {
+    for (size_t i = job; success && hasSolution && i < factors.size();
+         i += jobs) {
+      ConstraintSet tmp(factors[i]->exprs);
+      success = solver->impl->computeInitialValues(
+          Query(tmp, ConstantExpr::alloc(0, Expr::Bool)), assignments[i],
+          hasSolution);
+    }
+  }
+
+  for (const Process &p : processes) {
+    SolverMessage message;
+    // the answers of the others do not matter once a factor is unsolved
+    if (!success || !hasSolution) {
+      kill(p.pid, SIGKILL);
+    } else if (!message.receive(p.fd)) {
+      klee_warning("independent solver process died");
+      success = false;
+      forkedFailure = true;
+      forkedRunStatus = SOLVER_RUN_STATUS_UNEXPECTED_EXIT_CODE;
+    } else {
+      for (size_t i = p.first; i < factors.size(); i += jobs) {
+        uint8_t status = message.get<uint8_t>();
+        if (status == 0) {
+          success = false;
+          forkedFailure = true;
+          forkedRunStatus =
+              static_cast<SolverRunStatus>(message.get<int32_t>());
+          break;
+        }
+        if (status == 1) {
+          hasSolution = false;
+          break;
+        }
+        std::vector<const Array *> arrays;
+        calculateArrayReferences(*factors[i], arrays);
+        auto assignment = std::make_shared<Assignment>();
+        for (const Array *array : arrays)
+          if (message.get<uint8_t>())
+            assignment->addBinding(array, message.getBytes());
+        assignments[i] = std::move(assignment);
+      }
+    }
+    close(p.fd);
+    int status;
+    while (waitpid(p.pid, &status, 0) < 0 && errno == EINTR)
+      ;
+  }
+  return success;
+}
+
 bool IndependentSolver::computeInitialValues(const Query& query,
                                              std::shared_ptr<const Assignment> &result,
                                              bool &hasSolution){
+  forkedFailure = false;
   // We assume the query has a solution except proven differently
   // This is important in case we don't have any constraints but
   // we need initial values for requested array objects.
@@ -465,42 +427,63 @@ bool IndependentSolver::computeInitialValues(const Query& query,
   // to remember to manually call delete
   std::list<IndependentElementSet> *factors = getAllIndependentConstraintsSets(query);
 
-  // Used to build the result
-  Assignment::map_bindings_ty retMap;
-  for (std::list<IndependentElementSet>::iterator it = factors->begin();
-       it != factors->end(); ++it) {
-    std::vector<const Array*> arraysInFactor;
-    calculateArrayReferences(*it, arraysInFactor);
-    // Going to use this as the "fresh" expression for the Query() invocation below
-    assert(it->exprs.size() >= 1 && "No null/empty factors");
-    if (arraysInFactor.size() == 0){
-      continue;
-    }
-    ConstraintSet tmp(it->exprs);
-    std::shared_ptr<const Assignment> tempAssignment;
-    if (!solver->impl->computeInitialValues(Query(tmp, ConstantExpr::alloc(0, Expr::Bool)),
-                                            tempAssignment, hasSolution)){
+  // the factors that reference arrays, only those need to be solved
+  std::vector<const IndependentElementSet *> solvable;
+  for (const auto &factor : *factors) {
+    assert(factor.exprs.size() >= 1 && "No null/empty factors");
+    if (!factor.elements.empty() || !factor.wholeObjects.empty())
+      solvable.push_back(&factor);
+  }
+
+  std::vector<std::shared_ptr<const Assignment>> assignments;
+  if (IndependentSolverJobs > 1 && solvable.size() > 1) {
+    if (!solveFactors(solvable, assignments, hasSolution)) {
       delete factors;
       return false;
-    } else if (!hasSolution){
+    } else if (!hasSolution) {
       delete factors;
       return true;
+    }
+  }
+
+  // Used to build the result
+  Assignment::map_bindings_ty retMap;
+  for (size_t i = 0; i < solvable.size(); ++i) {
+    const IndependentElementSet &factor = *solvable[i];
+    std::vector<const Array*> arraysInFactor;
+    calculateArrayReferences(factor, arraysInFactor);
+    std::shared_ptr<const Assignment> tempAssignment;
+    if (!assignments.empty()) {
+      tempAssignment = assignments[i];
     } else {
-      for (const Array *array : arraysInFactor){
-        if (retMap.count(array)){
-          // We already have an array with some partially correct answers,
-          // so we need to place the answers to the new query into the right
-          // spot while avoiding the undetermined values also in the array
-          for (unsigned index : it->elements[array]){
-            unsigned char value = tempAssignment->getValue(array, index);
-            retMap[array].add(index, value);
-          }
-        } else {
-          auto &tempPtr = retMap[array];
-          // Dump all the new values into the array
-          if (auto val = tempAssignment->getBindingsOrNull(array))
-            tempPtr = MapArrayModel(*val);
+      // Going to use this as the "fresh" expression for the Query() invocation below
+      ConstraintSet tmp(factor.exprs);
+      if (!solver->impl->computeInitialValues(Query(tmp, ConstantExpr::alloc(0, Expr::Bool)),
+                                              tempAssignment, hasSolution)){
+        delete factors;
+        return false;
+      } else if (!hasSolution){
+        delete factors;
+        return true;
+      }
+    }
+    for (const Array *array : arraysInFactor){
+      if (retMap.count(array)){
+        // We already have an array with some partially correct answers,
+        // so we need to place the answers to the new query into the right
+        // spot while avoiding the undetermined values also in the array
+        auto elements = factor.elements.find(array);
+        if (elements == factor.elements.end())
+          continue;
+        for (unsigned index : elements->second){
+          unsigned char value = tempAssignment->getValue(array, index);
+          retMap[array].add(index, value);
         }
+      } else {
+        auto &tempPtr = retMap[array];
+        // Dump all the new values into the array
+        if (auto val = tempAssignment->getBindingsOrNull(array))
+          tempPtr = MapArrayModel(*val);
       }
     }
   }
@@ -512,6 +495,8 @@ bool IndependentSolver::computeInitialValues(const Query& query,
 }
 
 SolverImpl::SolverRunStatus IndependentSolver::getOperationStatusCode() {
+  if (forkedFailure)
+    return forkedRunStatus;
   return solver->impl->getOperationStatusCode();      
 }
 
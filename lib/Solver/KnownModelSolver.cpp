@@ -0,0 +1,112 @@
+//===-- KnownModelSolver.cpp ----------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Solver/Solver.h"
+
+#include "klee/Expr/Assignment.h"
+#include "klee/Expr/Constraints.h"
+#include "klee/Expr/Expr.h"
+#include "klee/Solver/SolverImpl.h"
+#include "klee/Solver/SolverStats.h"
+
+using namespace klee;
+
+/// Answers queries from the model known for their constraints
+/// (ConstraintSet::getModel) where it can, and remembers each computed
+/// counterexample as a model of the constraints of its query.
+class KnownModelSolver : public SolverImpl {
+  Solver *solver;
+
+public:
+  explicit KnownModelSolver(Solver *s) : solver(s) {}
+  ~KnownModelSolver() { delete solver; }
+
+  bool computeValidity(const Query &, Solver::Validity &result);
+  bool computeTruth(const Query &, bool &isValid);
+  bool computeValue(const Query &, ref<Expr> &result);
+  bool computeInitialValues(const Query &,
+                            std::shared_ptr<const Assignment> &result,
+                            bool &hasSolution);
+  SolverRunStatus getOperationStatusCode();
+  char *getConstraintLog(const Query &);
+  void setCoreSolverTimeout(time::Span timeout);
+};
+
+bool KnownModelSolver::computeValidity(const Query &query,
+                                       Solver::Validity &result) {
+  const auto &model = query.constraints.getModel();
+  if (!model)
+    return solver->impl->computeValidity(query, result);
+
+  // the model already shows one side to be feasible, a query on the other
+  // one is enough. Its counterexample is kept for the state taking that side.
+  ++stats::knownModelHits;
+  bool modelValue = model->evaluate(query.expr)->isTrue();
+  std::shared_ptr<const Assignment> other;
+  bool otherFeasible;
+  if (!solver->impl->computeInitialValues(
+          modelValue ? query : query.negateExpr(), other, otherFeasible))
+    return false;
+  if (otherFeasible) {
+    result = Solver::Unknown;
+    if (other)
+      query.constraints.setOtherModel(std::move(other));
+  } else {
+    result = modelValue ? Solver::True : Solver::False;
+  }
+  return true;
+}
+
+bool KnownModelSolver::computeTruth(const Query &query, bool &isValid) {
+  const auto &model = query.constraints.getModel();
+  if (model && !model->evaluate(query.expr)->isTrue()) {
+    ++stats::knownModelHits;
+    isValid = false;
+    return true;
+  }
+  return solver->impl->computeTruth(query, isValid);
+}
+
+bool KnownModelSolver::computeValue(const Query &query, ref<Expr> &result) {
+  if (const auto &model = query.constraints.getModel()) {
+    ++stats::knownModelHits;
+    result = model->evaluate(query.expr);
+    return true;
+  }
+  return solver->impl->computeValue(query, result);
+}
+
+bool KnownModelSolver::computeInitialValues(
+    const Query &query, std::shared_ptr<const Assignment> &result,
+    bool &hasSolution) {
+  if (!solver->impl->computeInitialValues(query, result, hasSolution))
+    return false;
+  // a counterexample also satisfies the constraints on their own
+  if (hasSolution && result && !query.constraints.getModel())
+    query.constraints.setModel(result);
+  return true;
+}
+
+SolverImpl::SolverRunStatus KnownModelSolver::getOperationStatusCode() {
+  return solver->impl->getOperationStatusCode();
+}
+
+char *KnownModelSolver::getConstraintLog(const Query &query) {
+  return solver->impl->getConstraintLog(query);
+}
+
+void KnownModelSolver::setCoreSolverTimeout(time::Span timeout) {
+  solver->impl->setCoreSolverTimeout(timeout);
+}
+
+///
+
+Solver *klee::createKnownModelSolver(Solver *s) {
+  return new Solver(new KnownModelSolver(s));
+}
@@ -220,7 +220,7 @@ MetaSMTBuilder<SolverContext>::getInitialArray(const Array *root) {
             metaSMT::logic::Array::store(
                 array_expr,
                 construct(ConstantExpr::alloc(i, root->getDomain()), 0),
-                construct(root->constantValues[i], 0)));
+                construct(root->getConstantValue(i), 0)));
         array_expr = tmp;
       }
     }
@@ -0,0 +1,452 @@
+//===-- PersistentCachingSolver.cpp - On-disk query cache -----------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Solver/Solver.h"
+
+#include "klee/Expr/Assignment.h"
+#include "klee/Expr/Constraints.h"
+#include "klee/Expr/ExprPPrinter.h"
+#include "klee/Expr/ExprUtil.h"
+#include "klee/Solver/SolverImpl.h"
+#include "klee/Solver/SolverStats.h"
+#include "klee/Support/ErrorHandling.h"
+
+#include "llvm/Support/Errno.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/xxhash.h"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+
+using namespace klee;
+
+namespace {
+
+/// An append-only file of (query, answer) records that several processes
+/// can share. Records are appended under an exclusive flock and read
+/// through a shared mapping of the file; the records appended by other
+/// processes are picked up on the next lookup that misses.
+///
+/// Each record starts with a header holding the hash of its key and a
+/// checksum of its contents, so a record left incomplete by a crashed
+/// process ends the readable part of the file.
+///
+/// A flock belongs to the open file, which a forked process shares with
+/// its parent, so each process opens the file again for itself before
+/// using it.
+class QueryCacheFile {
+  struct RecordHeader {
+    uint32_t magic;
+    uint32_t keySize;
+    uint32_t valueSize;
+    uint32_t checksum;
+    uint64_t hash;
+  };
+  static constexpr uint32_t recordMagic = 0x4b514331; // "KQC1"
+
+  std::string path;
+  int fd = -1;
+  /// the process that opened fd
+  pid_t owner = -1;
+  const char *mapping = nullptr;
+  size_t mappedSize = 0;
+  /// end of the records indexed so far
+  size_t indexedEnd = 0;
+  /// set once an invalid record was found, nothing after it is read
+  bool corrupted = false;
+  std::unordered_multimap<uint64_t, size_t> index;
+
+  static uint32_t checksum(const std::string &key, const std::string &value) {
+    return static_cast<uint32_t>(llvm::xxHash64(key + value));
+  }
+
+  void open();
+  bool remap(size_t size);
+  void catchUp();
+  const char *findRecord(const std::string &key, uint64_t hash,
+                         uint32_t &valueSize) const;
+
+public:
+  explicit QueryCacheFile(const std::string &path);
+  ~QueryCacheFile();
+
+  bool isOpen() const { return fd >= 0; }
+  bool lookup(const std::string &key, std::string &value);
+  void insert(const std::string &key, const std::string &value);
+};
+
+QueryCacheFile::QueryCacheFile(const std::string &path) : path(path) {
+  open();
+  if (fd >= 0)
+    catchUp();
+}
+
+void QueryCacheFile::open() {
+  if (fd >= 0)
+    close(fd);
+  owner = getpid();
+  fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+  if (fd < 0)
+    klee_warning("unable to open query cache file \"%s\": %s", path.c_str(),
+                 llvm::sys::StrError(errno).c_str());
+}
+
+QueryCacheFile::~QueryCacheFile() {
+  if (mapping)
+    munmap(const_cast<char *>(mapping), mappedSize);
+  if (fd >= 0)
+    close(fd);
+}
+
+bool QueryCacheFile::remap(size_t size) {
+  if (mapping)
+    munmap(const_cast<char *>(mapping), mappedSize);
+  mapping = nullptr;
+  mappedSize = 0;
+  if (!size)
+    return true;
+  void *m = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+  if (m == MAP_FAILED) {
+    klee_warning("unable to map the query cache file: %s",
+                 llvm::sys::StrError(errno).c_str());
+    return false;
+  }
+  mapping = static_cast<const char *>(m);
+  mappedSize = size;
+  return true;
+}
+
+void QueryCacheFile::catchUp() {
+  if (corrupted)
+    return;
+  struct stat st;
+  if (fstat(fd, &st) < 0 || static_cast<size_t>(st.st_size) <= indexedEnd)
+    return;
+
+  flock(fd, LOCK_SH);
+  if (fstat(fd, &st) < 0 || !remap(st.st_size)) {
+    flock(fd, LOCK_UN);
+    return;
+  }
+  flock(fd, LOCK_UN);
+
+  while (indexedEnd + sizeof(RecordHeader) <= mappedSize) {
+    RecordHeader header;
+    std::memcpy(&header, mapping + indexedEnd, sizeof(header));
+    size_t end = indexedEnd + sizeof(header) + header.keySize +
+                 static_cast<size_t>(header.valueSize);
+    if (header.magic != recordMagic || end > mappedSize) {
+      corrupted = true;
+      break;
+    }
+    const char *key = mapping + indexedEnd + sizeof(header);
+    std::string k(key, header.keySize);
+    std::string v(key + header.keySize, header.valueSize);
+    if (checksum(k, v) != header.checksum) {
+      corrupted = true;
+      break;
+    }
+    index.emplace(header.hash, indexedEnd);
+    indexedEnd = end;
+  }
+  if (corrupted)
+    klee_warning("ignoring the query cache file from offset %zu on, it is "
+                 "corrupted", indexedEnd);
+}
+
+const char *QueryCacheFile::findRecord(const std::string &key, uint64_t hash,
+                                       uint32_t &valueSize) const {
+  auto range = index.equal_range(hash);
+  for (auto it = range.first; it != range.second; ++it) {
+    RecordHeader header;
+    std::memcpy(&header, mapping + it->second, sizeof(header));
+    const char *k = mapping + it->second + sizeof(header);
+    if (header.keySize == key.size() &&
+        std::memcmp(k, key.data(), key.size()) == 0) {
+      valueSize = header.valueSize;
+      return k + header.keySize;
+    }
+  }
+  return nullptr;
+}
+
+bool QueryCacheFile::lookup(const std::string &key, std::string &value) {
+  // the records indexed before a fork stay valid, only the file is reopened
+  if (owner != getpid())
+    open();
+  if (fd < 0)
+    return false;
+  uint64_t hash = llvm::xxHash64(key);
+  uint32_t valueSize;
+  const char *v = findRecord(key, hash, valueSize);
+  if (!v) {
+    catchUp();
+    v = findRecord(key, hash, valueSize);
+  }
+  if (!v)
+    return false;
+  value.assign(v, valueSize);
+  return true;
+}
+
+void QueryCacheFile::insert(const std::string &key, const std::string &value) {
+  if (owner != getpid())
+    open();
+  if (fd < 0)
+    return;
+  RecordHeader header = {recordMagic, static_cast<uint32_t>(key.size()),
+                         static_cast<uint32_t>(value.size()),
+                         checksum(key, value), llvm::xxHash64(key)};
+  std::string record(reinterpret_cast<const char *>(&header), sizeof(header));
+  record += key;
+  record += value;
+
+  flock(fd, LOCK_EX);
+  const char *pos = record.data();
+  size_t size = record.size();
+  while (size) {
+    ssize_t n = write(fd, pos, size);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0) {
+      klee_warning("unable to write to the query cache file: %s",
+                   llvm::sys::StrError(errno).c_str());
+      break;
+    }
+    pos += n;
+    size -= n;
+  }
+  flock(fd, LOCK_UN);
+}
+
+/// The kinds of answers kept in the cache, part of the key.
+enum class CachedOperation : char {
+  Validity = 'V',
+  Truth = 'T',
+  Value = 'E',
+  InitialValues = 'I'
+};
+
+template <typename T> void putValue(std::string &s, const T &value) {
+  s.append(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+template <typename T> bool getValue(const std::string &s, size_t &pos,
+                                    T &value) {
+  if (pos + sizeof(T) > s.size())
+    return false;
+  std::memcpy(&value, s.data() + pos, sizeof(T));
+  pos += sizeof(T);
+  return true;
+}
+
+} // namespace
+
+/// Keeps the answers of the underlying solver in a file that outlives the
+/// run, keyed by the KQuery text of the query. The text is canonical for
+/// the structure of the query, so the same query asked by a later run of
+/// the same program hits in the cache.
+class PersistentCachingSolver : public SolverImpl {
+  Solver *solver;
+  QueryCacheFile cache;
+
+  static std::string getKey(const Query &query, CachedOperation op);
+  static std::vector<const Array *> getArrays(const Query &query);
+  bool lookup(const std::string &key, std::string &value);
+
+public:
+  PersistentCachingSolver(Solver *s, const std::string &path)
+      : solver(s), cache(path) {}
+  ~PersistentCachingSolver() { delete solver; }
+
+  bool computeValidity(const Query &, Solver::Validity &result);
+  bool computeTruth(const Query &, bool &isValid);
+  bool computeValue(const Query &, ref<Expr> &result);
+  bool computeInitialValues(const Query &,
+                            std::shared_ptr<const Assignment> &result,
+                            bool &hasSolution);
+  SolverRunStatus getOperationStatusCode();
+  char *getConstraintLog(const Query &);
+  void setCoreSolverTimeout(time::Span timeout);
+};
+
+std::string PersistentCachingSolver::getKey(const Query &query,
+                                            CachedOperation op) {
+  std::string key(1, static_cast<char>(op));
+  llvm::raw_string_ostream os(key);
+  ExprPPrinter::printQuery(os, query.constraints, query.expr);
+  os.flush();
+  return key;
+}
+
+std::vector<const Array *>
+PersistentCachingSolver::getArrays(const Query &query) {
+  std::vector<ref<Expr>> exprs(query.constraints.begin(),
+                               query.constraints.end());
+  exprs.push_back(query.expr);
+  std::vector<const Array *> arrays;
+  findSymbolicObjects(exprs.begin(), exprs.end(), arrays);
+  return arrays;
+}
+
+bool PersistentCachingSolver::lookup(const std::string &key,
+                                     std::string &value) {
+  if (!cache.isOpen())
+    return false;
+  if (cache.lookup(key, value)) {
+    ++stats::queryDiskCacheHits;
+    return true;
+  }
+  ++stats::queryDiskCacheMisses;
+  return false;
+}
+
+bool PersistentCachingSolver::computeValidity(const Query &query,
+                                              Solver::Validity &result) {
+  std::string key = getKey(query, CachedOperation::Validity), value;
+  size_t pos = 0;
+  int8_t v;
+  if (lookup(key, value) && getValue(value, pos, v)) {
+    result = static_cast<Solver::Validity>(v);
+    return true;
+  }
+
+  if (!solver->impl->computeValidity(query, result))
+    return false;
+  value.clear();
+  putValue<int8_t>(value, result);
+  if (cache.isOpen())
+    cache.insert(key, value);
+  return true;
+}
+
+bool PersistentCachingSolver::computeTruth(const Query &query,
+                                           bool &isValid) {
+  std::string key = getKey(query, CachedOperation::Truth), value;
+  size_t pos = 0;
+  uint8_t v;
+  if (lookup(key, value) && getValue(value, pos, v)) {
+    isValid = v;
+    return true;
+  }
+
+  if (!solver->impl->computeTruth(query, isValid))
+    return false;
+  value.clear();
+  putValue<uint8_t>(value, isValid);
+  if (cache.isOpen())
+    cache.insert(key, value);
+  return true;
+}
+
+bool PersistentCachingSolver::computeValue(const Query &query,
+                                           ref<Expr> &result) {
+  std::string key = getKey(query, CachedOperation::Value), value;
+  if (lookup(key, value)) {
+    size_t pos = 0;
+    uint32_t width;
+    if (getValue(value, pos, width)) {
+      std::vector<uint64_t> words((width + 63) / 64);
+      bool complete = true;
+      for (auto &word : words)
+        complete = complete && getValue(value, pos, word);
+      if (complete) {
+        result = ConstantExpr::alloc(llvm::APInt(width, words));
+        return true;
+      }
+    }
+  }
+
+  if (!solver->impl->computeValue(query, result))
+    return false;
+  const llvm::APInt &v = cast<ConstantExpr>(result)->getAPValue();
+  value.clear();
+  putValue<uint32_t>(value, v.getBitWidth());
+  for (unsigned i = 0; i < v.getNumWords(); ++i)
+    putValue<uint64_t>(value, v.getRawData()[i]);
+  if (cache.isOpen())
+    cache.insert(key, value);
+  return true;
+}
+
+bool PersistentCachingSolver::computeInitialValues(
+    const Query &query, std::shared_ptr<const Assignment> &result,
+    bool &hasSolution) {
+  std::string key = getKey(query, CachedOperation::InitialValues), value;
+  // the values of the arrays are stored in the order of their first
+  // occurrence in the query, which is part of the key
+  std::vector<const Array *> arrays = getArrays(query);
+
+  if (lookup(key, value)) {
+    size_t pos = 0;
+    uint8_t solvable = 0;
+    bool complete = getValue(value, pos, solvable);
+    auto assignment = std::make_shared<Assignment>();
+    for (size_t i = 0; complete && solvable && i < arrays.size(); ++i) {
+      uint32_t size;
+      complete = getValue(value, pos, size) && pos + size <= value.size();
+      if (complete && size) {
+        assignment->addBinding(arrays[i], std::vector<unsigned char>(
+                                              value.begin() + pos,
+                                              value.begin() + pos + size));
+        pos += size;
+      }
+    }
+    if (complete) {
+      hasSolution = solvable;
+      if (hasSolution)
+        result = std::move(assignment);
+      return true;
+    }
+  }
+
+  if (!solver->impl->computeInitialValues(query, result, hasSolution))
+    return false;
+  value.clear();
+  putValue<uint8_t>(value, hasSolution);
+  if (hasSolution) {
+    for (const Array *array : arrays) {
+      const CompactArrayModel *model =
+          result ? result->getBindingsOrNull(array) : nullptr;
+      std::vector<uint8_t> bytes;
+      if (model)
+        bytes = model->asVector();
+      putValue<uint32_t>(value, bytes.size());
+      value.append(bytes.begin(), bytes.end());
+    }
+  }
+  if (cache.isOpen())
+    cache.insert(key, value);
+  return true;
+}
+
+SolverImpl::SolverRunStatus PersistentCachingSolver::getOperationStatusCode() {
+  return solver->impl->getOperationStatusCode();
+}
+
+char *PersistentCachingSolver::getConstraintLog(const Query &query) {
+  return solver->impl->getConstraintLog(query);
+}
+
+void PersistentCachingSolver::setCoreSolverTimeout(time::Span timeout) {
+  solver->impl->setCoreSolverTimeout(timeout);
+}
+
+///
+
+Solver *klee::createPersistentCachingSolver(Solver *s,
+                                           const std::string &path) {
+  return new Solver(new PersistentCachingSolver(s, path));
+}
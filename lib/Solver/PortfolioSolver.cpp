@@ -0,0 +1,325 @@
+//===-- PortfolioSolver.cpp -----------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "SolverMessage.h"
+
+#include "klee/Expr/Assignment.h"
+#include "klee/Expr/Constraints.h"
+#include "klee/Expr/ExprUtil.h"
+#include "klee/Solver/Solver.h"
+#include "klee/Solver/SolverImpl.h"
+#include "klee/Solver/SolverStats.h"
+#include "klee/Statistics/TimerStatIncrementer.h"
+#include "klee/Support/ErrorHandling.h"
+
+#include "llvm/Support/Errno.h"
+
+#include <cerrno>
+#include <csignal>
+#include <poll.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+namespace klee {
+
+namespace {
+
+enum class Operation { Truth, Validity, Value, InitialValues };
+
+/// The result of an operation, only the fields of the operation are set.
+struct Answer {
+  bool isValid = false;
+  Solver::Validity validity = Solver::Unknown;
+  ref<Expr> value;
+  std::shared_ptr<const Assignment> assignment;
+  bool hasSolution = false;
+};
+
+Statistic &getWinStatistic(CoreSolverType type) {
+  switch (type) {
+  case STP_SOLVER:
+    return stats::portfolioWinsSTP;
+  case METASMT_SOLVER:
+    return stats::portfolioWinsMetaSMT;
+  case BITWUZLA_SOLVER:
+    return stats::portfolioWinsBitwuzla;
+  default:
+    return stats::portfolioWinsZ3;
+  }
+}
+
+} // namespace
+
+/// Runs each query on all backends at once, each in a process of its own,
+/// and takes the answer of the first one that succeeds. The other
+/// processes are killed.
+class PortfolioSolver : public SolverImpl {
+  std::vector<std::pair<CoreSolverType, Solver *>> backends;
+  SolverRunStatus runStatusCode = SOLVER_RUN_STATUS_FAILURE;
+
+  bool race(const Query &query, Operation op, Answer &answer);
+
+public:
+  explicit PortfolioSolver(
+      std::vector<std::pair<CoreSolverType, Solver *>> backends)
+      : backends(std::move(backends)) {}
+  ~PortfolioSolver() override {
+    for (auto &backend : backends)
+      delete backend.second;
+  }
+
+  bool computeValidity(const Query &query, Solver::Validity &result) override {
+    Answer answer;
+    if (!race(query, Operation::Validity, answer))
+      return false;
+    result = answer.validity;
+    return true;
+  }
+  bool computeTruth(const Query &query, bool &isValid) override {
+    Answer answer;
+    if (!race(query, Operation::Truth, answer))
+      return false;
+    isValid = answer.isValid;
+    return true;
+  }
+  bool computeValue(const Query &query, ref<Expr> &result) override {
+    Answer answer;
+    if (!race(query, Operation::Value, answer))
+      return false;
+    result = answer.value;
+    return true;
+  }
+  bool computeInitialValues(const Query &query,
+                            std::shared_ptr<const Assignment> &result,
+                            bool &hasSolution) override {
+    Answer answer;
+    if (!race(query, Operation::InitialValues, answer))
+      return false;
+    result = answer.assignment;
+    hasSolution = answer.hasSolution;
+    return true;
+  }
+  SolverRunStatus getOperationStatusCode() override { return runStatusCode; }
+  char *getConstraintLog(const Query &query) override {
+    return backends.front().second->impl->getConstraintLog(query);
+  }
+  void setCoreSolverTimeout(time::Span timeout) override {
+    for (auto &backend : backends)
+      backend.second->impl->setCoreSolverTimeout(timeout);
+  }
+};
+
+/// The arrays whose values are exchanged for an InitialValues operation.
+static std::vector<const Array *> getQueryArrays(const Query &query) {
+  std::vector<ref<Expr>> exprs(query.constraints.begin(),
+                               query.constraints.end());
+  exprs.push_back(query.expr);
+  std::vector<const Array *> arrays;
+  findSymbolicObjects(exprs.begin(), exprs.end(), arrays);
+  return arrays;
+}
+
+/// Body of a backend process.
+[[noreturn]] static void runBackend(Solver *solver, const Query &query,
+                                    Operation op, int fd) {
+  SolverMessage message;
+  Answer answer;
+  bool success = false;
+  switch (op) {
+  case Operation::Truth:
+    success = solver->impl->computeTruth(query, answer.isValid);
+    break;
+  case Operation::Validity:
+    success = solver->impl->computeValidity(query, answer.validity);
+    break;
+  case Operation::Value:
+    success = solver->impl->computeValue(query, answer.value);
+    break;
+  case Operation::InitialValues:
+    success = solver->impl->computeInitialValues(query, answer.assignment,
+                                                 answer.hasSolution);
+    break;
+  }
+  message.put<uint8_t>(success);
+  message.put<int32_t>(solver->impl->getOperationStatusCode());
+
+  if (success) {
+    switch (op) {
+    case Operation::Truth:
+      message.put<uint8_t>(answer.isValid);
+      break;
+    case Operation::Validity:
+      message.put<int32_t>(answer.validity);
+      break;
+    case Operation::Value: {
+      const llvm::APInt &v = cast<ConstantExpr>(answer.value)->getAPValue();
+      message.put<uint32_t>(v.getBitWidth());
+      for (unsigned i = 0; i < v.getNumWords(); ++i)
+        message.put<uint64_t>(v.getRawData()[i]);
+      break;
+    }
+    case Operation::InitialValues:
+      message.put<uint8_t>(answer.hasSolution);
+      if (!answer.hasSolution)
+        break;
+      for (const Array *array : getQueryArrays(query)) {
+        const CompactArrayModel *model =
+            answer.assignment->getBindingsOrNull(array);
+        message.put<uint8_t>(model != nullptr);
+        if (model)
+          message.put(model->asVector());
+      }
+      break;
+    }
+  }
+  message.send(fd);
+  _exit(0);
+}
+
+bool PortfolioSolver::race(const Query &query, Operation op, Answer &answer) {
+  TimerStatIncrementer t(stats::queryTime);
+  runStatusCode = SOLVER_RUN_STATUS_FAILURE;
+
+  fflush(stdout);
+  fflush(stderr);
+
+  struct Process {
+    pid_t pid;
+    int fd;
+    CoreSolverType type;
+  };
+  std::vector<Process> processes;
+  for (auto &backend : backends) {
+    int fds[2];
+    if (pipe(fds) < 0) {
+      klee_warning("pipe failed (for solver portfolio) - %s",
+                   llvm::sys::StrError(errno).c_str());
+      continue;
+    }
+    pid_t pid = fork();
+    if (pid == -1) {
+      klee_warning("fork failed (for solver portfolio) - %s",
+                   llvm::sys::StrError(errno).c_str());
+      close(fds[0]);
+      close(fds[1]);
+      continue;
+    }
+    if (pid == 0) {
+      close(fds[0]);
+      runBackend(backend.second, query, op, fds[1]);
+    }
+    close(fds[1]);
+    processes.push_back({pid, fds[0], backend.first});
+  }
+  if (processes.empty()) {
+    runStatusCode = SOLVER_RUN_STATUS_FORK_FAILED;
+    return false;
+  }
+
+  bool success = false;
+  std::vector<const Array *> arrays;
+  if (op == Operation::InitialValues)
+    arrays = getQueryArrays(query);
+
+  std::vector<pollfd> fds;
+  for (const auto &p : processes)
+    fds.push_back({p.fd, POLLIN, 0});
+  size_t running = processes.size();
+  while (running && !success) {
+    if (poll(fds.data(), fds.size(), -1) < 0) {
+      if (errno == EINTR)
+        continue;
+      klee_warning("poll failed (for solver portfolio) - %s",
+                   llvm::sys::StrError(errno).c_str());
+      break;
+    }
+    for (size_t i = 0; i < fds.size() && !success; ++i) {
+      if (fds[i].fd < 0 || !fds[i].revents)
+        continue;
+
+      SolverMessage message;
+      bool received = message.receive(fds[i].fd);
+      close(fds[i].fd);
+      fds[i].fd = -1;
+      --running;
+      // a backend that crashed or failed is just out of the race
+      if (!received)
+        continue;
+      bool backendSuccess = message.get<uint8_t>();
+      runStatusCode = static_cast<SolverRunStatus>(message.get<int32_t>());
+      if (!backendSuccess)
+        continue;
+
+      switch (op) {
+      case Operation::Truth:
+        answer.isValid = message.get<uint8_t>();
+        break;
+      case Operation::Validity:
+        answer.validity =
+            static_cast<Solver::Validity>(message.get<int32_t>());
+        break;
+      case Operation::Value: {
+        unsigned width = message.get<uint32_t>();
+        std::vector<uint64_t> words((width + 63) / 64);
+        for (auto &word : words)
+          word = message.get<uint64_t>();
+        answer.value = ConstantExpr::alloc(llvm::APInt(width, words));
+        break;
+      }
+      case Operation::InitialValues: {
+        answer.hasSolution = message.get<uint8_t>();
+        if (!answer.hasSolution)
+          break;
+        auto assignment = std::make_shared<Assignment>();
+        for (const Array *array : arrays)
+          if (message.get<uint8_t>())
+            assignment->addBinding(array, message.getBytes());
+        answer.assignment = std::move(assignment);
+        break;
+      }
+      }
+      ++getWinStatistic(processes[i].type);
+      success = true;
+    }
+  }
+
+  for (size_t i = 0; i < processes.size(); ++i) {
+    if (fds[i].fd >= 0) {
+      kill(processes[i].pid, SIGKILL);
+      close(fds[i].fd);
+    }
+    int status;
+    while (waitpid(processes[i].pid, &status, 0) < 0 && errno == EINTR)
+      ;
+  }
+
+  ++stats::queries;
+  if (success && op == Operation::Truth) {
+    if (answer.isValid)
+      ++stats::queriesValid;
+    else
+      ++stats::queriesInvalid;
+  } else if (success && op == Operation::InitialValues) {
+    ++stats::queryCounterexamples;
+    if (answer.hasSolution)
+      ++stats::queriesInvalid;
+    else
+      ++stats::queriesValid;
+  }
+  return success;
+}
+
+Solver *createPortfolioSolver(
+    std::vector<std::pair<CoreSolverType, Solver *>> backends) {
+  assert(!backends.empty() && "portfolio without backends");
+  return new Solver(new PortfolioSolver(std::move(backends)));
+}
+
+} // namespace klee
@@ -0,0 +1,97 @@
+//===-- ProfilingSolver.cpp -----------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Solver/Solver.h"
+#include "klee/Solver/SolverImpl.h"
+#include "klee/Solver/SolverProfile.h"
+
+#include "llvm/Support/MathExtras.h"
+
+using namespace klee;
+
+void SolverLayerProfile::record(time::Span elapsed, bool success, bool hit) {
+  ++queries;
+  if (hit)
+    ++hits;
+  if (!success)
+    ++failures;
+  time += elapsed;
+  unsigned bucket = 64 - llvm::countLeadingZeros(elapsed.toMicroseconds());
+  ++latency[std::min(bucket, NumBuckets - 1)];
+}
+
+uint64_t SolverLayerProfile::getLatencyQuantile(double q) const {
+  uint64_t seen = 0;
+  for (unsigned i = 0; i != NumBuckets; ++i) {
+    seen += latency[i];
+    if (seen && seen >= q * queries)
+      return UINT64_C(1) << i;
+  }
+  return 0;
+}
+
+namespace {
+
+/// Records the queries passed to a solver in a profile. The queries that
+/// do not reach the profiling solver of the layer below are its hits, so
+/// a layer without one below has none.
+class ProfilingSolver : public SolverImpl {
+  Solver *solver;
+  SolverLayerProfile &profile;
+  const SolverLayerProfile *below;
+
+  template <typename Compute> bool profiled(Compute compute) {
+    uint64_t forwarded = below ? below->queries : 0;
+    time::Point start = time::getWallTime();
+    bool success = compute();
+    profile.record(time::getWallTime() - start, success,
+                   below && below->queries == forwarded);
+    return success;
+  }
+
+public:
+  ProfilingSolver(Solver *solver, SolverLayerProfile &profile,
+                  const SolverLayerProfile *below)
+      : solver(solver), profile(profile), below(below) {}
+  ~ProfilingSolver() { delete solver; }
+
+  bool computeValidity(const Query &query, Solver::Validity &result) {
+    return profiled(
+        [&] { return solver->impl->computeValidity(query, result); });
+  }
+  bool computeTruth(const Query &query, bool &isValid) {
+    return profiled([&] { return solver->impl->computeTruth(query, isValid); });
+  }
+  bool computeValue(const Query &query, ref<Expr> &result) {
+    return profiled([&] { return solver->impl->computeValue(query, result); });
+  }
+  bool computeInitialValues(const Query &query,
+                            std::shared_ptr<const Assignment> &result,
+                            bool &hasSolution) {
+    return profiled([&] {
+      return solver->impl->computeInitialValues(query, result, hasSolution);
+    });
+  }
+  SolverRunStatus getOperationStatusCode() {
+    return solver->impl->getOperationStatusCode();
+  }
+  char *getConstraintLog(const Query &query) {
+    return solver->impl->getConstraintLog(query);
+  }
+  void setCoreSolverTimeout(time::Span timeout) {
+    solver->impl->setCoreSolverTimeout(timeout);
+  }
+};
+
+} // namespace
+
+Solver *klee::createProfilingSolver(Solver *s, SolverLayerProfile &profile,
+                                    const SolverLayerProfile *below) {
+  return new Solver(new ProfilingSolver(s, profile, below));
+}
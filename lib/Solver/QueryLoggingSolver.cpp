@@ -36,7 +36,7 @@ QueryLoggingSolver::QueryLoggingSolver(Solver *_solver, std::string path,
                                        bool logTimedOut)
     : solver(_solver), BufferString(""), logBuffer(BufferString), queryCount(0),
       minQueryTimeToLog(queryTimeToLog), logTimedOutQueries(logTimedOut),
-      queryCommentSign(commentSign) {
+      queryCommentSign(commentSign), owner(getpid()) {
   std::string error;
 #ifdef HAVE_ZLIB_H
   if (!CreateCompressedQueryLog) {
@@ -44,7 +44,7 @@ QueryLoggingSolver::QueryLoggingSolver(Solver *_solver, std::string path,
     os = klee_open_output_file(path, error);
 #ifdef HAVE_ZLIB_H
   } else {
-    path.append(".gz");
+    path.append(klee_compressed_file_extension());
     os = klee_open_compressed_output_file(path, error);
   }
 #endif
@@ -81,7 +81,7 @@ void QueryLoggingSolver::startQuery(const Query &query, const char *typeName,
   printQuery(query, falseQuery, objects);
 
   if (DumpPartialQueryiesEarly) {
-    flushBufferConditionally(true);
+    flushBufferConditionally(owner == getpid());
   }
   startTime = time::getWallTime();
 }
@@ -107,7 +107,7 @@ void QueryLoggingSolver::flushBuffer() {
       || (logTimedOutQueries &&
          (SOLVER_RUN_STATUS_TIMEOUT == solver->impl->getOperationStatusCode()));
 
-  flushBufferConditionally(writeToFile);
+  flushBufferConditionally(writeToFile && owner == getpid());
 }
 
 bool QueryLoggingSolver::computeTruth(const Query &query, bool &isValid) {
@@ -17,6 +17,8 @@
 
 #include "llvm/Support/raw_ostream.h"
 
+#include <unistd.h>
+
 using namespace klee;
 
 /// This abstract class represents a solver that is capable of logging
@@ -39,6 +41,9 @@ protected:
   time::Span lastQueryDuration;
   const std::string queryCommentSign; // sign representing commented lines
                                       // in given a query format
+  /// The process that opened the log. A process forked from it inherits the
+  /// stream but logs nothing, so the file is not written twice.
+  const pid_t owner;
 
   virtual void startQuery(const Query &query, const char *typeName,
                           const Query *falseQuery = 0,
@@ -53,7 +58,7 @@ protected:
 
   virtual void printQuery(const Query &query, const Query *falseQuery = 0,
                           const std::vector<const Array *> *objects = 0) = 0;
-  void flushBufferConditionally(bool writeToFile);
+  virtual void flushBufferConditionally(bool writeToFile);
 
 public:
   QueryLoggingSolver(Solver *_solver, std::string path, const std::string &commentSign,
@@ -0,0 +1,132 @@
+//===-- QueryShapeSolver.cpp ----------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Expr/Constraints.h"
+#include "klee/Expr/Expr.h"
+#include "klee/Solver/Solver.h"
+#include "klee/Solver/SolverImpl.h"
+#include "klee/Solver/SolverStats.h"
+#include "klee/System/Time.h"
+
+#include <unordered_set>
+#include <vector>
+
+using namespace klee;
+
+namespace {
+
+/// The shape of a query, as recorded in the histograms.
+struct QueryShape {
+  uint64_t nodes = 0;
+  uint64_t arrays = 0;
+  uint64_t updateDepth = 0;
+};
+
+QueryShape computeShape(const Query &query) {
+  QueryShape shape;
+  std::unordered_set<const Expr *> visited;
+  std::unordered_set<const UpdateNode *> visitedUpdates;
+  std::unordered_set<const Array *> arrays;
+  std::vector<const Expr *> stack;
+
+  auto push = [&](const ref<Expr> &e) {
+    if (visited.insert(e.get()).second)
+      stack.push_back(e.get());
+  };
+  for (const auto &constraint : query.constraints)
+    push(constraint);
+  push(query.expr);
+
+  while (!stack.empty()) {
+    const Expr *e = stack.back();
+    stack.pop_back();
+    ++shape.nodes;
+    if (const ReadExpr *re = dyn_cast<ReadExpr>(e)) {
+      arrays.insert(re->updates.root);
+      shape.updateDepth = std::max<uint64_t>(shape.updateDepth,
+                                             re->updates.getSize());
+      // the update lists of reads share their tails
+      for (const UpdateNode *un = re->updates.head.get();
+           un && visitedUpdates.insert(un).second; un = un->next.get()) {
+        push(un->index);
+        push(un->value);
+      }
+    }
+    for (unsigned i = 0, n = e->getNumKids(); i != n; ++i)
+      push(e->getKid(i));
+  }
+  shape.arrays = arrays.size();
+  return shape;
+}
+
+/// Records the shapes and solve times of the queries passed to a core
+/// solver.
+class QueryShapeSolver : public SolverImpl {
+  Solver *solver;
+  QueryShapeStats &stats;
+
+  template <typename Compute>
+  bool recorded(const Query &query, Compute compute) {
+    QueryShape shape = computeShape(query);
+    time::Point start = time::getWallTime();
+    bool success = compute();
+    uint64_t elapsed = (time::getWallTime() - start).toMicroseconds();
+
+    ++stats.queries;
+    ++stats.nodes[QueryShapeStats::getBucket(shape.nodes)];
+    ++stats.arrays[QueryShapeStats::getBucket(shape.arrays)];
+    ++stats.updateDepth[QueryShapeStats::getBucket(shape.updateDepth)];
+    ++stats.solveTime[QueryShapeStats::getBucket(elapsed)];
+    return success;
+  }
+
+public:
+  QueryShapeSolver(Solver *solver, QueryShapeStats &stats)
+      : solver(solver), stats(stats) {}
+  ~QueryShapeSolver() { delete solver; }
+
+  bool computeValidity(const Query &query, Solver::Validity &result) {
+    return recorded(query, [&] {
+      return solver->impl->computeValidity(query, result);
+    });
+  }
+  bool computeTruth(const Query &query, bool &isValid) {
+    return recorded(query, [&] {
+      return solver->impl->computeTruth(query, isValid);
+    });
+  }
+  bool computeValue(const Query &query, ref<Expr> &result) {
+    return recorded(query, [&] {
+      return solver->impl->computeValue(query, result);
+    });
+  }
+  bool computeInitialValues(const Query &query,
+                            std::shared_ptr<const Assignment> &result,
+                            bool &hasSolution) {
+    return recorded(query, [&] {
+      return solver->impl->computeInitialValues(query, result, hasSolution);
+    });
+  }
+  SolverRunStatus getOperationStatusCode() {
+    return solver->impl->getOperationStatusCode();
+  }
+  char *getConstraintLog(const Query &query) {
+    return solver->impl->getConstraintLog(query);
+  }
+  void setCoreSolverTimeout(time::Span timeout) {
+    solver->impl->setCoreSolverTimeout(timeout);
+  }
+};
+
+} // namespace
+
+Solver *klee::createQueryShapeSolver(Solver *s, const std::string &backend) {
+  getQueryShapeStats().emplace_back(backend);
+  return new Solver(new QueryShapeSolver(s, getQueryShapeStats().back()));
+}
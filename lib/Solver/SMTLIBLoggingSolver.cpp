@@ -10,6 +10,8 @@
 #include "QueryLoggingSolver.h"
 
 #include "klee/Expr/ExprSMTLIBPrinter.h"
+#include "klee/Expr/SMTLIBStreamPrinter.h"
+#include "klee/Solver/SolverCmdLine.h"
 
 using namespace klee;
 
@@ -18,14 +20,27 @@ using namespace klee;
 class SMTLIBLoggingSolver : public QueryLoggingSolver
 {
         private:
-    
+
                 ExprSMTLIBPrinter printer;
+                /// The printer used unless -smtlib-printer=classic
+                std::unique_ptr<SMTLIBStreamPrinter> streamPrinter;
+                /// Whether the last query was written to the file
+                bool queryWritten = false;
 
                 virtual void printQuery(const Query& query,
                                         const Query* falseQuery = 0,
-                                        const std::vector<const Array*>* objects = 0) 
+                                        const std::vector<const Array*>* objects = 0)
                 {
-                        if (0 == falseQuery) 
+                        if (streamPrinter)
+                        {
+                                queryWritten = false;
+                                streamPrinter->printQuery(
+                                    falseQuery ? *falseQuery : query, objects);
+                                streamPrinter->flush(logBuffer);
+                                return;
+                        }
+
+                        if (0 == falseQuery)
                         {
                                 printer.setQuery(query);
                         }
@@ -40,8 +55,19 @@ class SMTLIBLoggingSolver : public QueryLoggingSolver
                         }
 
                         printer.generateOutput();
-                }    
-        
+                }
+
+                void flushBufferConditionally(bool writeToFile) override
+                {
+                        // later queries of an incremental session must not
+                        // refer to the definitions of a query not logged
+                        if (writeToFile)
+                                queryWritten = true;
+                        else if (streamPrinter && !queryWritten)
+                                streamPrinter->discardQuery();
+                        QueryLoggingSolver::flushBufferConditionally(writeToFile);
+                }
+
 	public:
 		SMTLIBLoggingSolver(Solver *_solver,
                         std::string path,
@@ -51,6 +77,18 @@ class SMTLIBLoggingSolver : public QueryLoggingSolver
 		{
 		  //Setup the printer
 		  printer.setOutput(logBuffer);
+		  if (SMTLIBPrinterToUse != CLASSIC_SMTLIB_PRINTER)
+		    streamPrinter.reset(new SMTLIBStreamPrinter(
+		        SMTLIBPrinterToUse == INCREMENTAL_SMTLIB_PRINTER));
+		}
+
+		~SMTLIBLoggingSolver()
+		{
+		  if (SMTLIBPrinterToUse == INCREMENTAL_SMTLIB_PRINTER)
+		  {
+		    streamPrinter->printExit();
+		    streamPrinter->flush(*os);
+		  }
 		}
 };
 
@@ -49,6 +49,13 @@ namespace {
                    llvm::cl::desc("Use hash-consing during STP query construction (default=true)"),
                    llvm::cl::init(true),
                    llvm::cl::cat(klee::ExprCat));
+
+  llvm::cl::opt<unsigned> STPConstructCacheSize(
+      "stp-construct-cache-size",
+      llvm::cl::desc("Keep up to this many constructed STP expressions "
+                     "between queries, evicting the least recently used "
+                     "ones. 0 clears the cache after every query (default=0)"),
+      llvm::cl::init(0), llvm::cl::cat(klee::ExprCat));
 }
 
 ///
@@ -451,7 +458,7 @@ ExprHandle STPBuilder::constructSDivByConstant(ExprHandle expr_n, unsigned width
 	::VCExpr prev = array_expr;
 	array_expr = vc_writeExpr(vc, prev,
                        construct(ConstantExpr::alloc(i, root->getDomain()), 0),
-                       construct(root->constantValues[i], 0));
+                       construct(root->getConstantValue(i), 0));
 	vc_DeleteExpr(prev);
       }
     }
@@ -498,25 +505,44 @@ ExprHandle STPBuilder::getInitialRead(const Array *root, unsigned index) {
 /** if *width_out!=1 then result is a bitvector,
     otherwise it is a bool */
 ExprHandle STPBuilder::construct(ref<Expr> e, int *width_out) {
-  if (!UseConstructHash || isa<ConstantExpr>(e)) {
+  if (!UseConstructHash || isa<ConstantExpr>(e))
     return constructActual(e, width_out);
-  } else {
-    ExprHashMap< std::pair<ExprHandle, unsigned> >::iterator it = 
-      constructed.find(e);
-    if (it!=constructed.end()) {
-      if (width_out)
-        *width_out = it->second.second;
-      return it->second.first;
-    } else {
-      int width;
-      if (!width_out) width_out = &width;
-      ExprHandle res = constructActual(e, width_out);
-      constructed.insert(std::make_pair(e, std::make_pair(res, *width_out)));
-      return res;
+
+  auto it = constructed.find(e);
+  if (it != constructed.end()) {
+    ++stats::stpConstructCacheHits;
+    if (STPConstructCacheSize)
+      constructedLRU.splice(constructedLRU.begin(), constructedLRU,
+                            it->second.lruPosition);
+    if (width_out)
+      *width_out = it->second.width;
+    return it->second.expr;
+  }
+
+  ++stats::stpConstructCacheMisses;
+  int width;
+  if (!width_out)
+    width_out = &width;
+  ExprHandle res = constructActual(e, width_out);
+  ConstructedExpr &entry = constructed[e];
+  entry.expr = res;
+  entry.width = *width_out;
+  if (STPConstructCacheSize) {
+    constructedLRU.push_front(e);
+    entry.lruPosition = constructedLRU.begin();
+    if (constructed.size() > STPConstructCacheSize) {
+      // the least recently used expression is never the one just added
+      constructed.erase(constructedLRU.back());
+      constructedLRU.pop_back();
+      ++stats::stpConstructCacheEvictions;
     }
   }
+  return res;
 }
 
+bool STPBuilder::hasBoundedConstructCache() {
+  return STPConstructCacheSize != 0;
+}
 
 /** if *width_out!=1 then result is a bitvector,
     otherwise it is a bool */
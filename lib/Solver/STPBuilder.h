@@ -14,6 +14,7 @@
 #include "klee/Expr/ArrayExprHash.h"
 #include "klee/Expr/ExprHashMap.h"
 
+#include <list>
 #include <vector>
 
 #define Expr VCExpr
@@ -64,7 +65,16 @@ namespace klee {
 
 class STPBuilder {
   ::VC vc;
-  ExprHashMap< std::pair<ExprHandle, unsigned> > constructed;
+  struct ConstructedExpr {
+    ExprHandle expr;
+    unsigned width;
+    /// position in constructedLRU
+    std::list<ref<Expr> >::iterator lruPosition;
+  };
+  ExprHashMap<ConstructedExpr> constructed;
+  /// The constructed expressions from the most to the least recently used
+  /// one, only maintained if the cache is bounded.
+  std::list<ref<Expr> > constructedLRU;
 
   /// optimizeDivides - Rewrite division and reminders by constants
   /// into multiplies and shifts. STP should probably handle this for
@@ -119,11 +129,16 @@ public:
   ExprHandle getFalse();
   ExprHandle getInitialRead(const Array *os, unsigned index);
 
-  ExprHandle construct(ref<Expr> e) { 
-    ExprHandle res = construct(e, 0);
+  ExprHandle construct(ref<Expr> e) { return construct(e, 0); }
+
+  void clearConstructCache() {
     constructed.clear();
-    return res;
+    constructedLRU.clear();
   }
+
+  /// Whether the construct cache is bounded in size and may be kept
+  /// between queries, see --stp-construct-cache-size.
+  static bool hasBoundedConstructCache();
 };
 
 }
@@ -15,17 +15,23 @@
 
 #include "klee/Expr/Assignment.h"
 #include "klee/Expr/Constraints.h"
+#include "klee/Expr/ExprBuilder.h"
+#include "klee/Expr/ExprPPrinter.h"
 #include "klee/Expr/ExprUtil.h"
+#include "klee/Expr/Parser/Parser.h"
 #include "klee/Support/OptionCategories.h"
 #include "klee/Solver/SolverImpl.h"
 #include "klee/Support/ErrorHandling.h"
 
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Errno.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
 
 #include <csignal>
 #include <sys/ipc.h>
 #include <sys/shm.h>
+#include <sys/socket.h>
 #include <sys/wait.h>
 #include <unistd.h>
 
@@ -40,6 +46,13 @@ llvm::cl::opt<bool> IgnoreSolverFailures(
     "ignore-solver-failures", llvm::cl::init(false),
     llvm::cl::desc("Ignore any STP solver failures (default=false)"),
     llvm::cl::cat(klee::SolvingCat));
+
+llvm::cl::opt<bool> STPPersistentWorker(
+    "stp-persistent-worker", llvm::cl::init(false),
+    llvm::cl::desc("With --use-forked-solver, send the queries to a solver "
+                   "process that is forked once and kept running, instead of "
+                   "forking for every query (default=false)"),
+    llvm::cl::cat(klee::SolvingCat));
 }
 
 #define vc_bvBoolExtract IAMTHESPAWNOFSATAN
@@ -62,6 +75,250 @@ static void stp_error_handler(const char *err_msg) {
   abort();
 }
 
+static void stpTimeoutHandler(int x) { _exit(52); }
+
+static bool writeAll(int fd, const void *buf, size_t size) {
+  const char *pos = static_cast<const char *>(buf);
+  while (size) {
+    ssize_t n = send(fd, pos, size, MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    pos += n;
+    size -= n;
+  }
+  return true;
+}
+
+static bool readAll(int fd, void *buf, size_t size) {
+  char *pos = static_cast<char *>(buf);
+  while (size) {
+    ssize_t n = read(fd, pos, size);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    pos += n;
+    size -= n;
+  }
+  return true;
+}
+
+namespace klee {
+
+/// A solver process that is forked once and then solves the queries it
+/// receives over a socket, see --stp-persistent-worker. The queries are
+/// sent in the KQuery format, the worker replies with whether the query is
+/// valid and the counterexample. A worker that crashed or timed out is
+/// replaced on the next query, and so is one inherited over a fork: a forked
+/// KLEE process gets a worker of its own instead of sharing the socket.
+class STPWorker {
+  pid_t pid = -1;
+  int fd = -1;
+  /// The process that spawned the worker.
+  pid_t owner = -1;
+
+  void spawn();
+  [[noreturn]] static void serve(int fd);
+  SolverImpl::SolverRunStatus reap();
+
+public:
+  STPWorker() { spawn(); }
+  ~STPWorker();
+
+  SolverImpl::SolverRunStatus
+  solve(const Query &query, const std::vector<const Array *> &objects,
+        std::vector<std::vector<unsigned char>> &values, bool &hasSolution,
+        time::Span timeout);
+};
+
+void STPWorker::spawn() {
+  int fds[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+    klee_warning("socketpair failed (for STP) - %s",
+                 llvm::sys::StrError(errno).c_str());
+    return;
+  }
+
+  fflush(stdout);
+  fflush(stderr);
+
+  pid = fork();
+  if (pid == -1) {
+    klee_warning("fork failed (for STP) - %s",
+                 llvm::sys::StrError(errno).c_str());
+    close(fds[0]);
+    close(fds[1]);
+    return;
+  }
+  if (pid == 0) {
+    close(fds[0]);
+    serve(fds[1]);
+  }
+  close(fds[1]);
+  fd = fds[0];
+  owner = getpid();
+}
+
+void STPWorker::serve(int fd) {
+  std::unique_ptr<ExprBuilder> exprBuilder(createDefaultExprBuilder());
+  ::signal(SIGALRM, stpTimeoutHandler);
+
+  while (true) {
+    // timeout in seconds (0 for none) and length of the query
+    uint32_t header[2];
+    if (!readAll(fd, header, sizeof(header)))
+      _exit(0);
+    std::string text(header[1], '\0');
+    if (!readAll(fd, &text[0], text.size()))
+      _exit(0);
+
+    std::unique_ptr<llvm::MemoryBuffer> mb =
+        llvm::MemoryBuffer::getMemBuffer(text, "query", false);
+    std::unique_ptr<expr::Parser> parser(
+        expr::Parser::Create("query", mb.get(), exprBuilder.get(), false));
+    std::vector<std::unique_ptr<expr::Decl>> decls;
+    expr::QueryCommand *qc = nullptr;
+    while (expr::Decl *d = parser->ParseTopLevelDecl()) {
+      decls.emplace_back(d);
+      if (auto *q = dyn_cast<expr::QueryCommand>(d))
+        qc = q;
+    }
+    if (parser->GetNumErrors() || !qc)
+      _exit(53);
+
+    // a fresh validity checker per query keeps the worker from growing
+    VC vc = vc_createValidityChecker();
+    vc_setInterfaceFlags(vc, EXPRDELETE, 0);
+    make_division_total(vc);
+    vc_registerErrorHandler(::stp_error_handler);
+    auto builder = std::make_unique<STPBuilder>(vc);
+
+    for (const auto &constraint : qc->Constraints)
+      vc_assertFormula(vc, builder->construct(constraint));
+    ExprHandle q = builder->construct(qc->Query);
+
+    ::alarm(header[0]);
+    int res = vc_query(vc, q);
+    ::alarm(0);
+
+    std::vector<unsigned char> reply(1, res ? 1 : 0);
+    if (!res) {
+      for (const auto object : qc->Objects) {
+        for (unsigned offset = 0; offset < object->size; offset++) {
+          ExprHandle counter =
+              vc_getCounterExample(vc, builder->getInitialRead(object, offset));
+          reply.push_back(static_cast<unsigned char>(getBVUnsigned(counter)));
+        }
+      }
+    }
+
+    builder.reset();
+    vc_Destroy(vc);
+
+    if (!writeAll(fd, reply.data(), reply.size()))
+      _exit(0);
+  }
+}
+
+SolverImpl::SolverRunStatus STPWorker::reap() {
+  close(fd);
+  fd = -1;
+
+  int status;
+  pid_t res;
+  do {
+    res = waitpid(pid, &status, 0);
+  } while (res < 0 && errno == EINTR);
+  pid = -1;
+
+  if (res < 0) {
+    klee_warning("waitpid() for STP failed");
+    if (!IgnoreSolverFailures)
+      exit(1);
+    return SolverImpl::SOLVER_RUN_STATUS_WAITPID_FAILED;
+  }
+
+  if (WIFSIGNALED(status) || !WIFEXITED(status)) {
+    klee_warning("STP did not return successfully.  Most likely you forgot "
+                 "to run 'ulimit -s unlimited'");
+    if (!IgnoreSolverFailures)
+      exit(1);
+    return SolverImpl::SOLVER_RUN_STATUS_INTERRUPTED;
+  }
+
+  if (WEXITSTATUS(status) == 52) {
+    klee_warning("STP timed out");
+    return SolverImpl::SOLVER_RUN_STATUS_TIMEOUT;
+  }
+
+  klee_warning("STP did not return a recognized code");
+  if (!IgnoreSolverFailures)
+    exit(1);
+  return SolverImpl::SOLVER_RUN_STATUS_UNEXPECTED_EXIT_CODE;
+}
+
+STPWorker::~STPWorker() {
+  if (pid == -1)
+    return;
+  // the worker exits once it reads the end of the stream
+  close(fd);
+  if (owner != getpid())
+    return;
+  int status;
+  while (waitpid(pid, &status, 0) < 0 && errno == EINTR)
+    ;
+}
+
+SolverImpl::SolverRunStatus
+STPWorker::solve(const Query &query, const std::vector<const Array *> &objects,
+                 std::vector<std::vector<unsigned char>> &values,
+                 bool &hasSolution, time::Span timeout) {
+  if (pid != -1 && owner != getpid()) {
+    // the worker belongs to the process we were forked from
+    close(fd);
+    fd = -1;
+    pid = -1;
+  }
+  if (pid == -1)
+    spawn();
+  if (pid == -1) {
+    if (!IgnoreSolverFailures)
+      exit(1);
+    return SolverImpl::SOLVER_RUN_STATUS_FORK_FAILED;
+  }
+
+  std::string text;
+  llvm::raw_string_ostream os(text);
+  ExprPPrinter::printQuery(os, query.constraints, query.expr, nullptr, nullptr,
+                           objects.data(), objects.data() + objects.size());
+  os.flush();
+
+  uint32_t header[2] = {
+      timeout ? std::max(1u, static_cast<unsigned>(timeout.toSeconds())) : 0u,
+      static_cast<uint32_t>(text.size())};
+  unsigned char valid;
+  if (!writeAll(fd, header, sizeof(header)) ||
+      !writeAll(fd, text.data(), text.size()) ||
+      !readAll(fd, &valid, sizeof(valid)))
+    return reap();
+
+  hasSolution = !valid;
+  if (valid)
+    return SolverImpl::SOLVER_RUN_STATUS_SUCCESS_UNSOLVABLE;
+
+  values.reserve(objects.size());
+  for (const auto object : objects) {
+    values.emplace_back(object->size);
+    if (!readAll(fd, values.back().data(), object->size))
+      return reap();
+  }
+  return SolverImpl::SOLVER_RUN_STATUS_SUCCESS_SOLVABLE;
+}
+
+} // namespace klee
+
 namespace klee {
 
 class STPSolverImpl : public SolverImpl {
@@ -71,6 +328,8 @@ private:
   time::Span timeout;
   bool useForkedSTP;
   SolverRunStatus runStatusCode;
+  /// Solves the queries instead of forking for each, if enabled.
+  std::unique_ptr<STPWorker> worker;
 
 public:
   explicit STPSolverImpl(bool useForkedSTP, bool optimizeDivides = true);
@@ -107,7 +366,9 @@ STPSolverImpl::STPSolverImpl(bool useForkedSTP, bool optimizeDivides)
 
   vc_registerErrorHandler(::stp_error_handler);
 
-  if (useForkedSTP) {
+  if (useForkedSTP && STPPersistentWorker) {
+    worker = std::make_unique<STPWorker>();
+  } else if (useForkedSTP) {
     assert(shared_memory_id == 0 && "shared memory id already allocated");
     shared_memory_id =
         shmget(IPC_PRIVATE, shared_memory_size, IPC_CREAT | 0700);
@@ -122,7 +383,8 @@ STPSolverImpl::STPSolverImpl(bool useForkedSTP, bool optimizeDivides)
 
 STPSolverImpl::~STPSolverImpl() {
   // Detach the memory region.
-  shmdt(shared_memory_ptr);
+  if (shared_memory_ptr)
+    shmdt(shared_memory_ptr);
   shared_memory_ptr = nullptr;
   shared_memory_id = 0;
 
@@ -145,6 +407,8 @@ char *STPSolverImpl::getConstraintLog(const Query &query) {
   unsigned long length;
   vc_printQueryStateToBuffer(vc, builder->getFalse(), &buffer, &length, false);
   vc_pop(vc);
+  if (!STPBuilder::hasBoundedConstructCache())
+    builder->clearConstructCache();
 
   return buffer;
 }
@@ -207,8 +471,6 @@ runAndGetCex(::VC vc, STPBuilder *builder, ::VCExpr q,
   return SolverImpl::SOLVER_RUN_STATUS_SUCCESS_SOLVABLE;
 }
 
-static void stpTimeoutHandler(int x) { _exit(52); }
-
 static SolverImpl::SolverRunStatus
 runAndGetCexForked(::VC vc, STPBuilder *builder, ::VCExpr q,
                    const std::vector<const Array *> &objects,
@@ -321,6 +583,21 @@ bool STPSolverImpl::computeInitialValues(
   runStatusCode = SOLVER_RUN_STATUS_FAILURE;
   TimerStatIncrementer t(stats::queryTime);
 
+  if (worker) {
+    ++stats::queries;
+    ++stats::queryCounterexamples;
+    runStatusCode = worker->solve(query, objects, values, hasSolution, timeout);
+    bool success = ((SOLVER_RUN_STATUS_SUCCESS_SOLVABLE == runStatusCode) ||
+                    (SOLVER_RUN_STATUS_SUCCESS_UNSOLVABLE == runStatusCode));
+    if (success) {
+      if (hasSolution)
+        ++stats::queriesInvalid;
+      else
+        ++stats::queriesValid;
+    }
+    return success;
+  }
+
   vc_push(vc);
 
   for (const auto &constraint : query.constraints)
@@ -359,6 +636,10 @@ bool STPSolverImpl::computeInitialValues(
   }
 
   vc_pop(vc);
+  // The constructed expressions are shared by the whole query, and by later
+  // queries as well if the cache is bounded.
+  if (!STPBuilder::hasBoundedConstructCache())
+    builder->clearConstructCache();
 
   return success;
 }
@@ -0,0 +1,216 @@
+//===-- SegmentSolver.cpp -------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Solver/Solver.h"
+
+#include "klee/Expr/Constraints.h"
+#include "klee/Expr/Expr.h"
+#include "klee/Expr/ExprHashMap.h"
+#include "klee/Solver/IncompleteSolver.h"
+#include "klee/Solver/SolverStats.h"
+
+#include <memory>
+#include <vector>
+
+using namespace klee;
+
+namespace {
+
+/// The number of values beyond which an expression is not tracked.
+const unsigned MaxValues = 8;
+
+typedef std::vector<ref<ConstantExpr>> ValueSet;
+
+/// Computes the finite sets of values that expressions built from
+/// constants, selects between them (such as the segment of a pointer into
+/// one of several objects) and comparisons of those can take, whatever the
+/// values of the symbolic conditions of the selects.
+class ValueSetEvaluator {
+  ExprHashMap<std::unique_ptr<ValueSet>> cache;
+
+  static void insert(ValueSet &values, const ref<ConstantExpr> &value) {
+    for (const auto &v : values)
+      if (v == value)
+        return;
+    values.push_back(value);
+  }
+
+  static ref<ConstantExpr> apply(Expr::Kind kind, const ref<ConstantExpr> &l,
+                                 const ref<ConstantExpr> &r) {
+    switch (kind) {
+    case Expr::Eq: return l->Eq(r);
+    case Expr::Ne: return l->Ne(r);
+    case Expr::Ult: return l->Ult(r);
+    case Expr::Ule: return l->Ule(r);
+    case Expr::Ugt: return l->Ugt(r);
+    case Expr::Uge: return l->Uge(r);
+    case Expr::Slt: return l->Slt(r);
+    case Expr::Sle: return l->Sle(r);
+    case Expr::Sgt: return l->Sgt(r);
+    case Expr::Sge: return l->Sge(r);
+    case Expr::And: return l->And(r);
+    case Expr::Or: return l->Or(r);
+    case Expr::Xor: return l->Xor(r);
+    default: assert(0 && "invalid kind"); return nullptr;
+    }
+  }
+
+  /// \return the values of e, or null if there are too many or they
+  /// depend on anything but select conditions
+  ValueSet *compute(const ref<Expr> &e) {
+    if (auto CE = dyn_cast<ConstantExpr>(e))
+      return CE->getWidth() <= 64 ? new ValueSet{CE} : nullptr;
+
+    switch (e->getKind()) {
+    case Expr::Select: {
+      const ValueSet *c = evaluate(e->getKid(0));
+      if (c && c->size() == 1)
+        return copy(evaluate(c->front()->isTrue() ? e->getKid(1)
+                                                  : e->getKid(2)));
+      const ValueSet *t = evaluate(e->getKid(1));
+      const ValueSet *f = evaluate(e->getKid(2));
+      if (!t || !f)
+        return nullptr;
+      auto values = new ValueSet(*t);
+      for (const auto &v : *f)
+        insert(*values, v);
+      return values;
+    }
+
+    case Expr::Not: {
+      const ValueSet *kid = evaluate(e->getKid(0));
+      if (!kid)
+        return nullptr;
+      auto values = new ValueSet();
+      for (const auto &v : *kid)
+        insert(*values, v->Not());
+      return values;
+    }
+
+    case Expr::ZExt:
+    case Expr::SExt: {
+      const ValueSet *kid = evaluate(e->getKid(0));
+      if (!kid)
+        return nullptr;
+      auto values = new ValueSet();
+      for (const auto &v : *kid)
+        insert(*values, e->getKind() == Expr::ZExt ? v->ZExt(e->getWidth())
+                                                   : v->SExt(e->getWidth()));
+      return values;
+    }
+
+    case Expr::And:
+    case Expr::Or:
+    case Expr::Xor:
+    case Expr::Eq:
+    case Expr::Ne:
+    case Expr::Ult:
+    case Expr::Ule:
+    case Expr::Ugt:
+    case Expr::Uge:
+    case Expr::Slt:
+    case Expr::Sle:
+    case Expr::Sgt:
+    case Expr::Sge: {
+      const ValueSet *l = evaluate(e->getKid(0));
+      if (!l)
+        return nullptr;
+      const ValueSet *r = evaluate(e->getKid(1));
+      if (!r)
+        return nullptr;
+      auto values = new ValueSet();
+      for (const auto &lv : *l) {
+        for (const auto &rv : *r) {
+          insert(*values, apply(e->getKind(), lv, rv));
+        }
+      }
+      return values;
+    }
+
+    default:
+      return nullptr;
+    }
+  }
+
+  static ValueSet *copy(const ValueSet *values) {
+    return values ? new ValueSet(*values) : nullptr;
+  }
+
+public:
+  const ValueSet *evaluate(const ref<Expr> &e) {
+    auto it = cache.find(e);
+    if (it != cache.end())
+      return it->second.get();
+
+    std::unique_ptr<ValueSet> values(compute(e));
+    if (values && values->size() > MaxValues)
+      values.reset();
+    return (cache[e] = std::move(values)).get();
+  }
+};
+
+/// Decides queries whose expression takes a single value for every choice
+/// of the select conditions in it, without looking at the constraints.
+class SegmentSolver : public IncompleteSolver {
+  /// \return the only value of the expression of query, or null
+  static ref<ConstantExpr> getValue(const Query &query) {
+    // segment comparisons are rooted at a comparison or its negation
+    if (!isa<CmpExpr>(query.expr) && !isa<NotExpr>(query.expr) &&
+        !isa<SelectExpr>(query.expr))
+      return nullptr;
+
+    ValueSetEvaluator evaluator;
+    const ValueSet *values = evaluator.evaluate(query.expr);
+    if (!values || values->size() != 1)
+      return nullptr;
+    return values->front();
+  }
+
+public:
+  IncompleteSolver::PartialValidity computeValidity(const Query &query) {
+    return computeTruth(query);
+  }
+
+  IncompleteSolver::PartialValidity computeTruth(const Query &query) {
+    // the constraints are satisfiable, so an expression that is false for
+    // all their solutions is not valid
+    if (ref<ConstantExpr> value = getValue(query)) {
+      ++stats::segmentSolverResolved;
+      return value->isTrue() ? MustBeTrue : MustBeFalse;
+    }
+    return None;
+  }
+
+  bool computeValue(const Query &query, ref<Expr> &result) {
+    if (ref<ConstantExpr> value = getValue(query)) {
+      ++stats::segmentSolverResolved;
+      result = value;
+      return true;
+    }
+    return false;
+  }
+
+  bool computeInitialValues(const Query &query,
+                            std::shared_ptr<const Assignment> &,
+                            bool &hasSolution) {
+    // a valid expression has no counterexample, others need one computed
+    ref<ConstantExpr> value = getValue(query);
+    if (!value || !value->isTrue())
+      return false;
+    ++stats::segmentSolverResolved;
+    hasSolution = false;
+    return true;
+  }
+};
+
+} // namespace
+
+Solver *klee::createSegmentSolver(Solver *s) {
+  return new Solver(new StagedSolverImpl(new SegmentSolver(), s));
+}
@@ -9,6 +9,7 @@
 
 #include "klee/Solver/Solver.h"
 
+#include "klee/Expr/Assignment.h"
 #include "klee/Expr/Constraints.h"
 #include "klee/Solver/SolverImpl.h"
 
@@ -127,92 +128,83 @@ std::pair< ref<ConstantExpr>, ref<ConstantExpr> > Solver::getRange(const Query&
   } else if (ConstantExpr *CE = dyn_cast<ConstantExpr>(e)) {
     min = max = CE->getZExtValue();
   } else {
-    // binary search for # of useful bits
-    uint64_t lo=0, hi=width, mid, bits=0;
-    while (lo<hi) {
-      mid = lo + (hi - lo)/2;
-      bool res;
-      bool success = 
-        mustBeTrue(query.withExpr(
-                     EqExpr::create(LShrExpr::create(e,
-                                                     ConstantExpr::create(mid, 
-                                                                          width)),
-                                    ConstantExpr::create(0, width))),
-                   res);
-
+    // Whether e may lie in [lower, upper]. If so, value is that of e in the
+    // model of the query, which narrows the search beyond the bisection, or
+    // fallback if the model does not give one in the interval.
+    auto mayBeIn = [&](uint64_t lower, uint64_t upper, uint64_t fallback,
+                       uint64_t &value) {
+      ref<Expr> in = AndExpr::create(
+          UgeExpr::create(e, ConstantExpr::create(lower, width)),
+          UleExpr::create(e, ConstantExpr::create(upper, width)));
+      if (ConstantExpr *CE = dyn_cast<ConstantExpr>(in)) {
+        value = fallback;
+        return CE->isTrue();
+      }
+      std::shared_ptr<const Assignment> model;
+      bool hasSolution;
+      bool success = impl->computeInitialValues(
+          query.withExpr(Expr::createIsZero(in)), model, hasSolution);
       assert(success && "FIXME: Unhandled solver failure");
       (void) success;
-
-      if (res) {
-        hi = mid;
-      } else {
-        lo = mid+1;
+      if (!hasSolution)
+        return false;
+
+      value = fallback;
+      if (model) {
+        ref<Expr> result = model->evaluate(e);
+        auto ce = dyn_cast<ConstantExpr>(result);
+        if (ce && ce->getZExtValue() >= lower && ce->getZExtValue() <= upper)
+          value = ce->getZExtValue();
       }
+      return true;
+    };
 
-      bits = lo;
-    }
-    
-    // could binary search for training zeros and offset
-    // min max but unlikely to be very useful
-
-    // check common case
-    bool res = false;
-    bool success = 
-      mayBeTrue(query.withExpr(EqExpr::create(e, ConstantExpr::create(0, 
-                                                                      width))), 
-                res);
-
-    assert(success && "FIXME: Unhandled solver failure");      
+    // any value lies between the bounds
+    ref<ConstantExpr> initial;
+    bool success = getValue(query, initial);
+    assert(success && "FIXME: Unhandled solver failure");
     (void) success;
-
-    if (res) {
-      min = 0;
-    } else {
-      // binary search for min
-      lo=0, hi=bits64::maxValueOfNBits(bits);
-      while (lo<hi) {
-        mid = lo + (hi - lo)/2;
-        bool res = false;
-        bool success = 
-          mayBeTrue(query.withExpr(UleExpr::create(e, 
-                                                   ConstantExpr::create(mid, 
-                                                                        width))),
-                    res);
-
-        assert(success && "FIXME: Unhandled solver failure");      
-        (void) success;
-
-        if (res) {
-          hi = mid;
-        } else {
-          lo = mid+1;
-        }
-      }
-
-      min = lo;
+    uint64_t v = initial->getZExtValue();
+
+    // Most bounds are tight, so whether the value found is a bound and
+    // whether the minimum is 0 are asked first. The bisections then move
+    // past the values of the models.
+    uint64_t lo = 0, hi = v, value;
+    if (hi > 0) {
+      if (mayBeIn(0, hi - 1, hi - 1, value))
+        hi = value;
+      else
+        lo = hi;
     }
-
-    // binary search for max
-    lo=min, hi=bits64::maxValueOfNBits(bits);
-    while (lo<hi) {
-      mid = lo + (hi - lo)/2;
-      bool res;
-      bool success = 
-        mustBeTrue(query.withExpr(UleExpr::create(e, 
-                                                  ConstantExpr::create(mid, 
-                                                                       width))),
-                   res);
-
-      assert(success && "FIXME: Unhandled solver failure");      
-      (void) success;
-
-      if (res) {
-        hi = mid;
-      } else {
-        lo = mid+1;
-      }
+    if (lo < hi) {
+      if (mayBeIn(0, 0, 0, value))
+        hi = 0;
+      else
+        lo = 1;
+    }
+    while (lo < hi) {
+      uint64_t mid = lo + (hi - lo) / 2;
+      if (mayBeIn(lo, mid, mid, value))
+        hi = value;
+      else
+        lo = mid + 1;
+    }
+    min = lo;
+
+    lo = v, hi = bits64::maxValueOfNBits(width);
+    if (lo < hi) {
+      if (mayBeIn(lo + 1, hi, lo + 1, value))
+        lo = value;
+      else
+        hi = lo;
+    }
+    while (lo < hi) {
+      uint64_t mid = lo + (hi - lo) / 2 + 1;
+      if (mayBeIn(mid, hi, mid, value))
+        lo = value;
+      else
+        hi = mid - 1;
     }
-
     max = lo;
   }
 
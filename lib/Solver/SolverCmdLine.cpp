@@ -40,7 +40,15 @@ cl::OptionCategory SolvingCat("Constraint solving options",
 
 cl::opt<bool> UseFastCexSolver(
     "use-fast-cex-solver", cl::init(false),
-    cl::desc("Enable an experimental range-based solver (default=false)"),
+    cl::desc("Decide queries with interval bounds and value ranges before "
+             "calling the core solver (default=false)"),
+    cl::cat(SolvingCat));
+
+cl::opt<bool> UseSegmentSolver(
+    "use-segment-solver", cl::init(true),
+    cl::desc("Decide queries over constants and selects between them, such "
+             "as pointer segment comparisons, without calling the solver "
+             "(default=true)"),
     cl::cat(SolvingCat));
 
 cl::opt<bool> UseCexCache("use-cex-cache", cl::init(true),
@@ -56,6 +64,33 @@ cl::opt<bool>
                          cl::desc("Use constraint independence (default=true)"),
                          cl::cat(SolvingCat));
 
+cl::opt<bool> UseKnownModel(
+    "use-known-model", cl::init(true),
+    cl::desc("Answer queries with a known model of the state's constraints "
+             "where possible, and remember counterexamples as such models "
+             "(default=true)"),
+    cl::cat(SolvingCat));
+
+cl::opt<bool> IncrementalIndependence(
+    "incremental-independence", cl::init(true),
+    cl::desc("Maintain the independent factors of the constraints of each "
+             "state as constraints are added, instead of computing them for "
+             "each query (default=true)"),
+    cl::cat(SolvingCat));
+
+cl::opt<bool> CanonicalizeQueries(
+    "canonicalize-queries", cl::init(false),
+    cl::desc("Rename the arrays and order the operands of queries before the "
+             "solver caches, so that equivalent queries share their entries "
+             "(default=false)"),
+    cl::cat(SolvingCat));
+
+cl::opt<std::string> PersistentQueryCache(
+    "persistent-query-cache",
+    cl::desc("Keep the answers of the core solver in this file, shared "
+             "between runs and concurrent processes (default=off)"),
+    cl::cat(SolvingCat));
+
 cl::opt<bool> DebugValidateSolver(
     "debug-validate-solver", cl::init(false),
     cl::desc("Crosscheck the results of the solver chain above the core solver "
@@ -84,6 +119,14 @@ cl::opt<bool> UseForkedCoreSolver(
     cl::desc("Run the core SMT solver in a forked process (default=true)"),
     cl::init(true), cl::cat(SolvingCat));
 
+cl::opt<bool> QueryShapeStatistics(
+    "query-shape-stats",
+    cl::desc("Record log-scale histograms of the number of nodes, arrays and "
+             "update list depth of the queries reaching the core solver and "
+             "of their solve times, written to the solver_stats table of "
+             "run.stats (default=false)"),
+    cl::init(false), cl::cat(SolvingCat));
+
 cl::opt<bool> CoreSolverOptimizeDivides(
     "solver-optimize-divides",
     cl::desc("Optimize constant divides into add/shift/multiplies before "
@@ -104,9 +147,30 @@ cl::bits<QueryLoggingSolverType> QueryLoggingOptions(
             "All queries reaching the solver in .kquery (KQuery) format"),
         clEnumValN(
             SOLVER_SMTLIB, "solver:smt2",
-            "All queries reaching the solver in .smt2 (SMT-LIBv2) format")),
+            "All queries reaching the solver in .smt2 (SMT-LIBv2) format"),
+        clEnumValN(ALL_BINARY, "all:binary",
+                   "All queries as a binary query log (.kqbin), which "
+                   "kleaver reads and converts to .kquery"),
+        clEnumValN(SOLVER_BINARY, "solver:binary",
+                   "All queries reaching the solver as a binary query log")),
     cl::CommaSeparated, cl::cat(SolvingCat));
 
+cl::opt<SMTLIBPrinterType> SMTLIBPrinterToUse(
+    "smtlib-printer",
+    cl::desc("The printer of SMT-LIBv2 query logs and of kleaver "
+             "-print-smtlib:"),
+    cl::values(
+        clEnumValN(CLASSIC_SMTLIB_PRINTER, "classic",
+                   "A script per query, following the -smtlib-* options "
+                   "(default)"),
+        clEnumValN(STREAM_SMTLIB_PRINTER, "stream",
+                   "A script per query, printed in one pass with shared "
+                   "terms defined with define-fun"),
+        clEnumValN(INCREMENTAL_SMTLIB_PRINTER, "incremental",
+                   "As stream, but one incremental session reusing the "
+                   "declarations and constraints of the previous queries")),
+    cl::init(CLASSIC_SMTLIB_PRINTER), cl::cat(SolvingCat));
+
 cl::opt<bool> UseAssignmentValidatingSolver(
     "debug-assignment-validating-solver", cl::init(false),
     cl::desc("Debug the correctness of generated assignments (default=false)"),
@@ -166,18 +230,26 @@ MetaSMTBackend("metasmt-backend",
 #define STP_IS_DEFAULT_STR " (default)"
 #define METASMT_IS_DEFAULT_STR ""
 #define Z3_IS_DEFAULT_STR ""
+#define BITWUZLA_IS_DEFAULT_STR ""
 #define DEFAULT_CORE_SOLVER STP_SOLVER
 #elif ENABLE_Z3
 #define STP_IS_DEFAULT_STR ""
 #define METASMT_IS_DEFAULT_STR ""
 #define Z3_IS_DEFAULT_STR " (default)"
+#define BITWUZLA_IS_DEFAULT_STR ""
 #define DEFAULT_CORE_SOLVER Z3_SOLVER
 #elif ENABLE_METASMT
 #define STP_IS_DEFAULT_STR ""
 #define METASMT_IS_DEFAULT_STR " (default)"
 #define Z3_IS_DEFAULT_STR ""
+#define BITWUZLA_IS_DEFAULT_STR ""
 #define DEFAULT_CORE_SOLVER METASMT_SOLVER
+#elif ENABLE_BITWUZLA
+#define STP_IS_DEFAULT_STR ""
+#define METASMT_IS_DEFAULT_STR ""
 #define Z3_IS_DEFAULT_STR ""
+#define BITWUZLA_IS_DEFAULT_STR " (default)"
+#define DEFAULT_CORE_SOLVER BITWUZLA_SOLVER
 #else
 #error "Unsupported solver configuration"
 #endif
@@ -188,7 +260,11 @@ cl::opt<CoreSolverType> CoreSolverToUse(
                clEnumValN(METASMT_SOLVER, "metasmt",
                           "metaSMT" METASMT_IS_DEFAULT_STR),
                clEnumValN(DUMMY_SOLVER, "dummy", "Dummy solver"),
-               clEnumValN(Z3_SOLVER, "z3", "Z3" Z3_IS_DEFAULT_STR)),
+               clEnumValN(Z3_SOLVER, "z3", "Z3" Z3_IS_DEFAULT_STR),
+               clEnumValN(BITWUZLA_SOLVER, "bitwuzla",
+                          "Bitwuzla" BITWUZLA_IS_DEFAULT_STR),
+               clEnumValN(PORTFOLIO_SOLVER, "portfolio",
+                          "Race the backends of --portfolio-backends")),
     cl::init(DEFAULT_CORE_SOLVER), cl::cat(SolvingCat));
 
 cl::opt<CoreSolverType> DebugCrossCheckCoreSolverWith(
@@ -199,11 +275,49 @@ cl::opt<CoreSolverType> DebugCrossCheckCoreSolverWith(
                clEnumValN(METASMT_SOLVER, "metasmt", "metaSMT"),
                clEnumValN(DUMMY_SOLVER, "dummy", "Dummy solver"),
                clEnumValN(Z3_SOLVER, "z3", "Z3"),
+               clEnumValN(BITWUZLA_SOLVER, "bitwuzla", "Bitwuzla"),
                clEnumValN(NO_SOLVER, "none", "Do not crosscheck (default)")),
     cl::init(NO_SOLVER), cl::cat(SolvingCat));
+
+cl::list<CoreSolverType> PortfolioBackends(
+    "portfolio-backends",
+    cl::desc("The core solvers that --solver-backend=portfolio runs in "
+             "parallel on each query (default=all available)"),
+    cl::values(clEnumValN(STP_SOLVER, "stp", "STP"),
+               clEnumValN(METASMT_SOLVER, "metasmt", "metaSMT"),
+               clEnumValN(Z3_SOLVER, "z3", "Z3"),
+               clEnumValN(BITWUZLA_SOLVER, "bitwuzla", "Bitwuzla")),
+    cl::CommaSeparated, cl::cat(SolvingCat));
+
+cl::opt<bool> SolverEscalation(
+    "solver-escalation", cl::init(false),
+    cl::desc("Retry the queries the core solver fails on, first with the "
+             "solver of --solver-escalation-backend and then with the timeout "
+             "scaled by --solver-escalation-timeout-factor, instead of giving "
+             "up on them (default=false)"),
+    cl::cat(SolvingCat));
+
+cl::opt<CoreSolverType> SolverEscalationBackend(
+    "solver-escalation-backend",
+    cl::desc("The solver of the second stage of --solver-escalation"),
+    cl::values(clEnumValN(STP_SOLVER, "stp", "STP"),
+               clEnumValN(METASMT_SOLVER, "metasmt", "metaSMT"),
+               clEnumValN(Z3_SOLVER, "z3", "Z3"),
+               clEnumValN(BITWUZLA_SOLVER, "bitwuzla", "Bitwuzla"),
+               clEnumValN(NO_SOLVER, "independent",
+                          "The core solver on each independent part of the "
+                          "query (default)")),
+    cl::init(NO_SOLVER), cl::cat(SolvingCat));
+
+cl::opt<unsigned> SolverEscalationTimeoutFactor(
+    "solver-escalation-timeout-factor", cl::init(4),
+    cl::desc("The factor the last stage of --solver-escalation scales the "
+             "core solver timeout by, 1 skips the stage (default=4)"),
+    cl::cat(SolvingCat));
 } // namespace klee
 
 #undef STP_IS_DEFAULT_STR
 #undef METASMT_IS_DEFAULT_STR
 #undef Z3_IS_DEFAULT_STR
+#undef BITWUZLA_IS_DEFAULT_STR
 #undef DEFAULT_CORE_SOLVER
@@ -0,0 +1,99 @@
+//===-- SolverMessage.h -----------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_SOLVERMESSAGE_H
+#define KLEE_SOLVERMESSAGE_H
+
+#include <cassert>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <unistd.h>
+#include <vector>
+
+namespace klee {
+
+/// A message between a solver process and its parent, written to a pipe.
+class SolverMessage {
+  std::vector<char> data;
+  size_t readPos = 0;
+
+public:
+  template <typename T> void put(const T &value) {
+    const char *p = reinterpret_cast<const char *>(&value);
+    data.insert(data.end(), p, p + sizeof(T));
+  }
+  void put(const std::vector<unsigned char> &bytes) {
+    put<uint64_t>(bytes.size());
+    data.insert(data.end(), bytes.begin(), bytes.end());
+  }
+
+  template <typename T> T get() {
+    T value;
+    assert(readPos + sizeof(T) <= data.size() && "truncated message");
+    std::memcpy(&value, &data[readPos], sizeof(T));
+    readPos += sizeof(T);
+    return value;
+  }
+  std::vector<unsigned char> getBytes() {
+    uint64_t size = get<uint64_t>();
+    assert(readPos + size <= data.size() && "truncated message");
+    std::vector<unsigned char> bytes(data.begin() + readPos,
+                                     data.begin() + readPos + size);
+    readPos += size;
+    return bytes;
+  }
+
+  /// Writes the message prefixed by its size.
+  bool send(int fd) const {
+    uint64_t size = data.size();
+    return writeAll(fd, &size, sizeof(size)) &&
+           writeAll(fd, data.data(), data.size());
+  }
+  bool receive(int fd) {
+    uint64_t size;
+    if (!readAll(fd, &size, sizeof(size)))
+      return false;
+    data.resize(size);
+    readPos = 0;
+    return readAll(fd, data.data(), size);
+  }
+
+private:
+  static bool writeAll(int fd, const void *buf, size_t size) {
+    const char *pos = static_cast<const char *>(buf);
+    while (size) {
+      ssize_t n = write(fd, pos, size);
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n <= 0)
+        return false;
+      pos += n;
+      size -= n;
+    }
+    return true;
+  }
+  static bool readAll(int fd, void *buf, size_t size) {
+    char *pos = static_cast<char *>(buf);
+    while (size) {
+      ssize_t n = read(fd, pos, size);
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n <= 0)
+        return false;
+      pos += n;
+      size -= n;
+    }
+    return true;
+  }
+};
+
+} // namespace klee
+
+#endif /* KLEE_SOLVERMESSAGE_H */
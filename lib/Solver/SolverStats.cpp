@@ -9,6 +9,10 @@
 
 #include "klee/Solver/SolverStats.h"
 
+#include "llvm/Support/MathExtras.h"
+
+#include <algorithm>
+
 using namespace klee;
 
 Statistic stats::cexCacheTime("CexCacheTime", "CCtime");
@@ -19,10 +23,61 @@ Statistic stats::queryCacheHits("QueryCacheHits", "QChits") ;
 Statistic stats::queryCacheMisses("QueryCacheMisses", "QCmisses");
 Statistic stats::queryCexCacheHits("QueryCexCacheHits", "QCexHits") ;
 Statistic stats::queryCexCacheMisses("QueryCexCacheMisses", "QCexMisses");
+Statistic stats::cexCacheLookupTime("CexCacheLookupTime", "CCLtime");
+Statistic stats::cexCacheCandidates("CexCacheCandidates", "CCcands");
+Statistic stats::cexCacheCompileTime("CexCacheCompileTime", "CCCtime");
+Statistic stats::cexCacheEvaluationTime("CexCacheEvaluationTime", "CCEtime");
+Statistic stats::cexCacheEvictions("CexCacheEvictions", "CCevict");
+Statistic stats::queryDiskCacheHits("QueryDiskCacheHits", "QDChits");
+Statistic stats::queryDiskCacheMisses("QueryDiskCacheMisses", "QDCmisses");
+Statistic stats::knownModelHits("KnownModelHits", "KMhits");
+Statistic stats::segmentSolverResolved("SegmentSolverResolved", "SSres");
+Statistic stats::fastCexDecided("FastCexDecided", "FCdecided");
+Statistic stats::fastCexBoundsDecided("FastCexBoundsDecided", "FCbounds");
+Statistic stats::fastCexDeferred("FastCexDeferred", "FCdeferred");
+Statistic stats::fastCexTime("FastCexTime", "FCtime");
 Statistic stats::queryConstructs("QueryConstructs", "QB");
 Statistic stats::queryCounterexamples("QueriesCEX", "Qcex");
+Statistic stats::queryConstraintsReused("QueryConstraintsReused", "QCreused");
 Statistic stats::queryTime("QueryTime", "Qtime");
+Statistic stats::z3ConstructCacheHits("Z3ConstructCacheHits", "Z3CChits");
+Statistic stats::z3ConstructCacheMisses("Z3ConstructCacheMisses",
+                                        "Z3CCmisses");
+Statistic stats::z3ConstructCacheEvictions("Z3ConstructCacheEvictions",
+                                           "Z3CCevict");
+Statistic stats::stpConstructCacheHits("STPConstructCacheHits", "STPCChits");
+Statistic stats::stpConstructCacheMisses("STPConstructCacheMisses",
+                                         "STPCCmisses");
+Statistic stats::stpConstructCacheEvictions("STPConstructCacheEvictions",
+                                            "STPCCevict");
+Statistic stats::z3ContextRecycles("Z3ContextRecycles", "Z3recycles");
+Statistic stats::z3BitVectorQueries("Z3BitVectorQueries", "Z3qfbv");
+Statistic stats::z3IncrementalContextHits("Z3IncrementalContextHits",
+                                          "Z3IChits");
+Statistic stats::z3IncrementalContextMisses("Z3IncrementalContextMisses",
+                                            "Z3ICmisses");
+Statistic stats::bitwuzlaRecycles("BitwuzlaRecycles", "BZLArecycles");
+Statistic stats::portfolioWinsSTP("PortfolioWinsSTP", "PWstp");
+Statistic stats::portfolioWinsMetaSMT("PortfolioWinsMetaSMT", "PWmetasmt");
+Statistic stats::portfolioWinsZ3("PortfolioWinsZ3", "PWz3");
+Statistic stats::portfolioWinsBitwuzla("PortfolioWinsBitwuzla", "PWbzla");
+Statistic stats::escalatedQueries("EscalatedQueries", "Qesc");
+Statistic stats::escalationsSolvedByFallback("EscalationsSolvedByFallback",
+                                             "Qescfb");
+Statistic
+    stats::escalationsSolvedByLongerTimeout("EscalationsSolvedByLongerTimeout",
+                                            "Qesclong");
 
 #ifdef KLEE_ARRAY_DEBUG
 Statistic stats::arrayHashTime("ArrayHashTime", "AHtime");
 #endif
+
+unsigned QueryShapeStats::getBucket(uint64_t value) {
+  unsigned bucket = 64 - llvm::countLeadingZeros(value);
+  return std::min(bucket, NumBuckets - 1);
+}
+
+std::deque<QueryShapeStats> &klee::getQueryShapeStats() {
+  static std::deque<QueryShapeStats> stats;
+  return stats;
+}
@@ -20,6 +20,8 @@
 #include "llvm/ADT/iterator_range.h"
 #include "llvm/Support/CommandLine.h"
 
+#include <cmath>
+
 using namespace klee;
 
 namespace {
@@ -29,6 +31,21 @@ llvm::cl::opt<bool> UseConstructHashZ3(
     llvm::cl::init(true),
     llvm::cl::cat(klee::ExprCat));
 
+llvm::cl::opt<unsigned> Z3ConstructCacheSize(
+    "z3-construct-cache-size",
+    llvm::cl::desc("Keep up to this many constructed Z3 expressions between "
+                   "queries, evicting the least recently used ones. 0 clears "
+                   "the cache after every query (default=0)"),
+    llvm::cl::init(0), llvm::cl::cat(klee::ExprCat));
+
+llvm::cl::opt<unsigned> Z3ArrayEliminationSize(
+    "z3-array-elimination-size",
+    llvm::cl::desc("Expand the reads from arrays of at most this many bytes "
+                   "into if-then-else terms over their bytes, so that queries "
+                   "over small arrays stay in the theory of bit-vectors. 0 "
+                   "never expands them (default=0)"),
+    llvm::cl::init(0), llvm::cl::cat(klee::ExprCat));
+
 // FIXME: This should be std::atomic<bool>. Need C++11 for that.
 bool Z3InterationLogOpen = false;
 }
@@ -104,6 +121,7 @@ Z3Builder::~Z3Builder() {
   clearConstructCache();
   _arr_hash.clear();
   constant_array_assertions.clear();
+  eliminatedArrays.clear();
   Z3_del_context(ctx);
   if (z3LogInteractionFile.length() > 0) {
     Z3_close_log();
@@ -384,6 +402,68 @@ Z3ASTHandle Z3Builder::constructAShrByConstant(Z3ASTHandle expr, unsigned shift,
   }
 }
 
+Z3SortHandle Z3Builder::getFloatSort(unsigned width) {
+  switch (width) {
+  case Expr::Int32:
+    return Z3SortHandle(Z3_mk_fpa_sort_32(ctx), ctx);
+  case Expr::Int64:
+    return Z3SortHandle(Z3_mk_fpa_sort_64(ctx), ctx);
+  default:
+    llvm_unreachable("unsupported floating-point width");
+  }
+}
+
+Z3ASTHandle Z3Builder::fpRoundingMode() {
+  return Z3ASTHandle(Z3_mk_fpa_round_nearest_ties_to_even(ctx), ctx);
+}
+
+Z3ASTHandle Z3Builder::bvToFloat(Z3ASTHandle bits, unsigned width) {
+  return Z3ASTHandle(Z3_mk_fpa_to_fp_bv(ctx, bits, getFloatSort(width)), ctx);
+}
+
+Z3ASTHandle Z3Builder::floatToBv(Z3ASTHandle fp, unsigned width) {
+  // the bits of a NaN are left unspecified by Z3
+  Z3ASTHandle nan = width == Expr::Int32
+                        ? bvConst32(width, 0x7FC00000)
+                        : bvConst64(width, 0x7FF8000000000000);
+  return iteExpr(Z3ASTHandle(Z3_mk_fpa_is_nan(ctx, fp), ctx), nan,
+                 Z3ASTHandle(Z3_mk_fpa_to_ieee_bv(ctx, fp), ctx));
+}
+
+Z3ASTHandle Z3Builder::fpToInteger(Z3ASTHandle fp, unsigned fpWidth,
+                                   unsigned width, bool isSigned) {
+  // Saturate as APFloat does, with NaN converted to 0.
+  Z3ASTHandle rtz(Z3_mk_fpa_round_toward_zero(ctx), ctx);
+  Z3ASTHandle integral(Z3_mk_fpa_round_to_integral(ctx, rtz, fp), ctx);
+  Z3SortHandle sort = getFloatSort(fpWidth);
+  double bound = std::ldexp(1.0, isSigned ? width - 1 : width);
+  Z3ASTHandle lower(
+      Z3_mk_fpa_numeral_double(ctx, isSigned ? -bound : 0.0, sort), ctx);
+  Z3ASTHandle upper(Z3_mk_fpa_numeral_double(ctx, bound, sort), ctx);
+
+  Z3ASTHandle min = bvZero(width), max = bvMinusOne(width), converted;
+  if (isSigned) {
+    min = width == 1 ? bvOne(1)
+                     : Z3ASTHandle(Z3_mk_concat(ctx, bvOne(1),
+                                                bvZero(width - 1)),
+                                   ctx);
+    max = bvNotExpr(min);
+    converted =
+        Z3ASTHandle(Z3_mk_fpa_to_sbv(ctx, rtz, integral, width), ctx);
+  } else {
+    converted =
+        Z3ASTHandle(Z3_mk_fpa_to_ubv(ctx, rtz, integral, width), ctx);
+  }
+  Z3ASTHandle result = iteExpr(
+      Z3ASTHandle(Z3_mk_fpa_is_nan(ctx, fp), ctx), bvZero(width),
+      iteExpr(Z3ASTHandle(Z3_mk_fpa_lt(ctx, integral, lower), ctx), min,
+              iteExpr(Z3ASTHandle(Z3_mk_fpa_geq(ctx, integral, upper), ctx),
+                      max, converted)));
+  if (width == 1)
+    return eqExpr(result, bvOne(1));
+  return result;
+}
+
 Z3ASTHandle Z3Builder::getInitialArray(const Array *root) {
 
   assert(root);
@@ -401,12 +481,12 @@ Z3ASTHandle Z3Builder::getInitialArray(const Array *root) {
 
     if (root->isConstantArray() && constant_array_assertions.count(root) == 0) {
       std::vector<Z3ASTHandle> array_assertions;
-      for (unsigned i = 0, e = root->constantValues.size(); i != e; ++i) {
+      for (unsigned i = 0, e = root->size; i != e; ++i) {
         // construct(= (select i root) root->value[i]) to be asserted in
         // Z3Solver.cpp
         int width_out;
         Z3ASTHandle array_value =
-            construct(root->constantValues[i], &width_out);
+            construct(root->getConstantValue(i), &width_out);
         assert(width_out == (int)root->getRange() &&
                "Value doesn't match root range");
         array_assertions.push_back(
@@ -422,7 +502,82 @@ Z3ASTHandle Z3Builder::getInitialArray(const Array *root) {
   return (array_expr);
 }
 
+bool Z3Builder::eliminatesArray(const Array *root) {
+  return Z3ArrayEliminationSize && root->size <= Z3ArrayEliminationSize;
+}
+
+const std::vector<Z3ASTHandle> &
+Z3Builder::getEliminatedArray(const Array *root) {
+  auto it = eliminatedArrays.find(root);
+  if (it != eliminatedArrays.end())
+    return it->second;
+
+  // Unique bytes by name as for the arrays in getInitialArray
+  std::string unique_name =
+      root->name + llvm::utostr(eliminatedArrays.size()) + "_";
+  Z3SortHandle byteSort = getBvSort(root->getRange());
+  std::vector<Z3ASTHandle> bytes;
+  for (unsigned i = 0, e = root->size; i != e; ++i) {
+    if (root->isConstantArray()) {
+      bytes.push_back(construct(root->getConstantValue(i), 0));
+      continue;
+    }
+    std::string name = unique_name + llvm::utostr(i);
+    bytes.push_back(Z3ASTHandle(
+        Z3_mk_const(ctx, Z3_mk_string_symbol(ctx, name.c_str()), byteSort),
+        ctx));
+  }
+  // The reads out of range are unconstrained, but read the same byte. KLEE
+  // checks the bounds of an access before reading, so only infeasible
+  // paths read out of range.
+  std::string name = unique_name + "oob";
+  bytes.push_back(Z3ASTHandle(
+      Z3_mk_const(ctx, Z3_mk_string_symbol(ctx, name.c_str()), byteSort),
+      ctx));
+  return eliminatedArrays[root] = std::move(bytes);
+}
+
+Z3ASTHandle Z3Builder::constructEliminatedRead(const UpdateList &updates,
+                                               ref<Expr> index) {
+  const std::vector<Z3ASTHandle> &bytes = getEliminatedArray(updates.root);
+  Z3ASTHandle indexExpr = construct(index, 0);
+  // reads and updates at constant indices are resolved here
+  const ConstantExpr *constantIndex = dyn_cast<ConstantExpr>(index);
+  Z3ASTHandle result;
+  if (constantIndex) {
+    uint64_t i = constantIndex->getZExtValue();
+    result = i < updates.root->size ? bytes[i] : bytes.back();
+  } else {
+    result = bytes.back();
+    for (unsigned i = updates.root->size; i != 0; --i)
+      result = iteExpr(
+          eqExpr(indexExpr, bvConst32(updates.root->getDomain(), i - 1)),
+          bytes[i - 1], result);
+  }
+
+  // the most recent update ends up outermost
+  std::vector<const UpdateNode *> update_nodes;
+  for (const UpdateNode *un = updates.head.get(); un; un = un->next.get())
+    update_nodes.push_back(un);
+  for (const auto &un :
+       llvm::make_range(update_nodes.crbegin(), update_nodes.crend())) {
+    const ConstantExpr *constantUpdate = dyn_cast<ConstantExpr>(un->index);
+    if (constantIndex && constantUpdate) {
+      if (constantIndex->getZExtValue() == constantUpdate->getZExtValue())
+        result = construct(un->value, 0);
+      continue;
+    }
+    result = iteExpr(eqExpr(indexExpr, construct(un->index, 0)),
+                     construct(un->value, 0), result);
+  }
+  return result;
+}
+
 Z3ASTHandle Z3Builder::getInitialRead(const Array *root, unsigned index) {
+  if (eliminatesArray(root)) {
+    const std::vector<Z3ASTHandle> &bytes = getEliminatedArray(root);
+    return index < root->size ? bytes[index] : bytes.back();
+  }
   Z3ASTHandle indexExpr = bvConst32(32, index);
   return readExpr(getInitialArray(root), indexExpr);
 }
@@ -461,26 +616,45 @@ Z3ASTHandle Z3Builder::getArrayForUpdate(const Array *root,
 Z3ASTHandle Z3Builder::construct(ref<Expr> e, int *width_out) {
   // TODO: We could potentially use Z3_simplify() here
   // to store simpler expressions.
-  if (!UseConstructHashZ3 || isa<ConstantExpr>(e)) {
+  if (!UseConstructHashZ3 || isa<ConstantExpr>(e))
     return constructActual(e, width_out);
-  } else {
-    ExprHashMap<std::pair<Z3ASTHandle, unsigned> >::iterator it =
-        constructed.find(e);
-    if (it != constructed.end()) {
-      if (width_out)
-        *width_out = it->second.second;
-      return it->second.first;
-    } else {
-      int width;
-      if (!width_out)
-        width_out = &width;
-      Z3ASTHandle res = constructActual(e, width_out);
-      constructed.insert(std::make_pair(e, std::make_pair(res, *width_out)));
-      return res;
+
+  auto it = constructed.find(e);
+  if (it != constructed.end()) {
+    ++stats::z3ConstructCacheHits;
+    if (Z3ConstructCacheSize)
+      constructedLRU.splice(constructedLRU.begin(), constructedLRU,
+                            it->second.lruPosition);
+    if (width_out)
+      *width_out = it->second.width;
+    return it->second.ast;
+  }
+
+  ++stats::z3ConstructCacheMisses;
+  int width;
+  if (!width_out)
+    width_out = &width;
+  Z3ASTHandle res = constructActual(e, width_out);
+  ConstructedExpr &entry = constructed[e];
+  entry.ast = res;
+  entry.width = *width_out;
+  memory::constructCache.add(constructedEntryBytes);
+  if (Z3ConstructCacheSize) {
+    constructedLRU.push_front(e);
+    entry.lruPosition = constructedLRU.begin();
+    if (constructed.size() > Z3ConstructCacheSize) {
+      // the least recently used expression is never the one just added
+      constructed.erase(constructedLRU.back());
+      constructedLRU.pop_back();
+      memory::constructCache.remove(constructedEntryBytes);
+      ++stats::z3ConstructCacheEvictions;
     }
   }
+  return res;
 }
 
+bool Z3Builder::hasBoundedConstructCache() { return Z3ConstructCacheSize != 0; }
+
 /** if *width_out!=1 then result is a bitvector,
     otherwise it is a bool */
 Z3ASTHandle Z3Builder::constructActual(ref<Expr> e, int *width_out) {
@@ -529,6 +703,8 @@ Z3ASTHandle Z3Builder::constructActual(ref<Expr> e, int *width_out) {
     ReadExpr *re = cast<ReadExpr>(e);
     assert(re && re->updates.root);
     *width_out = re->updates.root->getRange();
+    if (eliminatesArray(re->updates.root))
+      return constructEliminatedRead(re->updates, re->index);
     Z3ASTHandle indexExpr = construct(re->index, 0);
     return readExpr(getArrayForUpdate(re->updates.root, re->updates.head.get()),
                     indexExpr);
@@ -852,6 +1028,99 @@ Z3ASTHandle Z3Builder::constructActual(ref<Expr> e, int *width_out) {
     return sbvLeExpr(left, right);
   }
 
+  // Floating point
+
+  case Expr::FAdd:
+  case Expr::FSub:
+  case Expr::FMul:
+  case Expr::FDiv: {
+    BinaryExpr *be = cast<BinaryExpr>(e);
+    unsigned fpWidth = be->getWidth();
+    Z3ASTHandle left = bvToFloat(construct(be->left, 0), fpWidth);
+    Z3ASTHandle right = bvToFloat(construct(be->right, 0), fpWidth);
+    Z3ASTHandle rm = fpRoundingMode();
+    Z3_ast result;
+    switch (e->getKind()) {
+    case Expr::FAdd:
+      result = Z3_mk_fpa_add(ctx, rm, left, right);
+      break;
+    case Expr::FSub:
+      result = Z3_mk_fpa_sub(ctx, rm, left, right);
+      break;
+    case Expr::FMul:
+      result = Z3_mk_fpa_mul(ctx, rm, left, right);
+      break;
+    default:
+      result = Z3_mk_fpa_div(ctx, rm, left, right);
+      break;
+    }
+    *width_out = fpWidth;
+    return floatToBv(Z3ASTHandle(result, ctx), fpWidth);
+  }
+
+  case Expr::FOEq:
+  case Expr::FOLt:
+  case Expr::FOLe:
+  case Expr::FUno: {
+    BinaryExpr *be = cast<BinaryExpr>(e);
+    unsigned fpWidth = be->left->getWidth();
+    Z3ASTHandle left = bvToFloat(construct(be->left, 0), fpWidth);
+    Z3ASTHandle right = bvToFloat(construct(be->right, 0), fpWidth);
+    *width_out = 1;
+    switch (e->getKind()) {
+    case Expr::FOEq:
+      return Z3ASTHandle(Z3_mk_fpa_eq(ctx, left, right), ctx);
+    case Expr::FOLt:
+      return Z3ASTHandle(Z3_mk_fpa_lt(ctx, left, right), ctx);
+    case Expr::FOLe:
+      return Z3ASTHandle(Z3_mk_fpa_leq(ctx, left, right), ctx);
+    default:
+      return orExpr(Z3ASTHandle(Z3_mk_fpa_is_nan(ctx, left), ctx),
+                    Z3ASTHandle(Z3_mk_fpa_is_nan(ctx, right), ctx));
+    }
+  }
+
+  case Expr::FPExt:
+  case Expr::FPTrunc: {
+    CastExpr *ce = cast<CastExpr>(e);
+    Z3ASTHandle src =
+        bvToFloat(construct(ce->src, 0), ce->src->getWidth());
+    *width_out = ce->getWidth();
+    return floatToBv(Z3ASTHandle(Z3_mk_fpa_to_fp_float(
+                                     ctx, fpRoundingMode(), src,
+                                     getFloatSort(*width_out)),
+                                 ctx),
+                     *width_out);
+  }
+
+  case Expr::FPToUI:
+  case Expr::FPToSI: {
+    CastExpr *ce = cast<CastExpr>(e);
+    unsigned fpWidth = ce->src->getWidth();
+    Z3ASTHandle src = bvToFloat(construct(ce->src, 0), fpWidth);
+    *width_out = ce->getWidth();
+    return fpToInteger(src, fpWidth, *width_out,
+                       e->getKind() == Expr::FPToSI);
+  }
+
+  case Expr::UIToFP:
+  case Expr::SIToFP: {
+    int srcWidth;
+    CastExpr *ce = cast<CastExpr>(e);
+    Z3ASTHandle src = construct(ce->src, &srcWidth);
+    if (srcWidth == 1)
+      src = e->getKind() == Expr::SIToFP
+                ? iteExpr(src, bvMinusOne(1), bvZero(1))
+                : iteExpr(src, bvOne(1), bvZero(1));
+    *width_out = ce->getWidth();
+    Z3SortHandle sort = getFloatSort(*width_out);
+    Z3_ast result =
+        e->getKind() == Expr::SIToFP
+            ? Z3_mk_fpa_to_fp_signed(ctx, fpRoundingMode(), src, sort)
+            : Z3_mk_fpa_to_fp_unsigned(ctx, fpRoundingMode(), src, sort);
+    return floatToBv(Z3ASTHandle(result, ctx), *width_out);
+  }
+
 // unused due to canonicalization
 #if 0
   case Expr::Ne:
@@ -13,7 +13,9 @@
 #include "klee/Config/config.h"
 #include "klee/Expr/ArrayExprHash.h"
 #include "klee/Expr/ExprHashMap.h"
+#include "klee/Statistics/MemoryAccount.h"
 
+#include <list>
 #include <unordered_map>
 #include <z3.h>
 #include <vector>
@@ -104,7 +106,19 @@ public:
 };
 
 class Z3Builder {
-  ExprHashMap<std::pair<Z3ASTHandle, unsigned> > constructed;
+  struct ConstructedExpr {
+    Z3ASTHandle ast;
+    unsigned width;
+    /// position in constructedLRU
+    std::list<ref<Expr> >::iterator lruPosition;
+  };
+  ExprHashMap<ConstructedExpr> constructed;
+  /// The constructed expressions from the most to the least recently used
+  /// one, only maintained if the cache is bounded.
+  std::list<ref<Expr> > constructedLRU;
+  /// Empties the construct cache, only ever called between queries.
+  MemoryAccount::Releaser releaser{memory::constructCache,
+                                   [this] { clearConstructCache(); }};
   Z3ArrayExprHash _arr_hash;
 
 private:
@@ -157,9 +171,29 @@ private:
   Z3ASTHandle constructAShrByConstant(Z3ASTHandle expr, unsigned shift,
                                       Z3ASTHandle isSigned);
 
+  // Floating point, over the IEEE bits of floats and doubles. All rounding
+  // is to nearest, ties to even, and NaNs are made canonical as in
+  // ConstantExpr.
+  Z3SortHandle getFloatSort(unsigned width);
+  Z3ASTHandle fpRoundingMode();
+  Z3ASTHandle bvToFloat(Z3ASTHandle bits, unsigned width);
+  Z3ASTHandle floatToBv(Z3ASTHandle fp, unsigned width);
+  Z3ASTHandle fpToInteger(Z3ASTHandle fp, unsigned fpWidth, unsigned width,
+                          bool isSigned);
+
   Z3ASTHandle getInitialArray(const Array *os);
   Z3ASTHandle getArrayForUpdate(const Array *root, const UpdateNode *un);
 
+  /// The bytes of the arrays that are eliminated, followed by the byte that
+  /// all reads out of range share.
+  std::unordered_map<const Array *, std::vector<Z3ASTHandle> >
+      eliminatedArrays;
+  const std::vector<Z3ASTHandle> &getEliminatedArray(const Array *root);
+  /// A read from an eliminated array as a chain of if-then-else terms over
+  /// the updates and the bytes of the array.
+  Z3ASTHandle constructEliminatedRead(const UpdateList &updates,
+                                      ref<Expr> index);
+
   Z3ASTHandle constructActual(ref<Expr> e, int *width_out);
   Z3ASTHandle construct(ref<Expr> e, int *width_out);
 
@@ -182,6 +216,12 @@ public:
   Z3ASTHandle getFalse();
   Z3ASTHandle getInitialRead(const Array *os, unsigned index);
 
+  /// Whether reads from an array are expanded into if-then-else terms
+  /// instead of using the theory of arrays, see
+  /// --z3-array-elimination-size. Such arrays have no constant array
+  /// assertions.
+  static bool eliminatesArray(const Array *root);
+
   Z3ASTHandle construct(ref<Expr> e) {
     Z3ASTHandle res = construct(e, 0);
     if (autoClearConstructCache)
@@ -189,7 +229,20 @@ public:
     return res;
   }
 
-  void clearConstructCache() { constructed.clear(); }
+  /// The estimated bytes of an entry of the construct cache charged to
+  /// memory::constructCache, the Z3 terms are owned by Z3.
+  static constexpr uint64_t constructedEntryBytes =
+      sizeof(std::pair<ref<Expr>, ConstructedExpr>) + 4 * sizeof(void *);
+
+  void clearConstructCache() {
+    memory::constructCache.remove(constructed.size() * constructedEntryBytes);
+    constructed.clear();
+    constructedLRU.clear();
+  }
+
+  /// Whether the construct cache is bounded in size and may be kept
+  /// between queries, see --z3-construct-cache-size.
+  static bool hasBoundedConstructCache();
 };
 }
 
@@ -12,6 +12,7 @@
 #include "klee/Support/FileHandling.h"
 #include "klee/Support/OptionCategories.h"
 
+#include <algorithm>
 #include <csignal>
 
 #ifdef ENABLE_Z3
@@ -46,6 +47,37 @@ llvm::cl::opt<bool> Z3ValidateModels(
     llvm::cl::desc("When generating Z3 models validate these against the query"),
     llvm::cl::cat(klee::SolvingCat));
 
+llvm::cl::opt<bool> Z3Incremental(
+    "z3-incremental", llvm::cl::init(false),
+    llvm::cl::desc("Keep a single Z3 solver between queries and only assert "
+                   "the constraints that differ from the previous query, "
+                   "using push/pop (default=false)"),
+    llvm::cl::cat(klee::SolvingCat));
+
+llvm::cl::opt<unsigned> Z3IncrementalContexts(
+    "z3-incremental-contexts", llvm::cl::init(1),
+    llvm::cl::desc("Number of solvers kept with --z3-incremental. A query "
+                   "goes to the one sharing the longest prefix of its "
+                   "constraints, so that states of different lineages of "
+                   "the process tree do not retract each others constraints "
+                   "(default=1)"),
+    llvm::cl::cat(klee::SolvingCat));
+
+llvm::cl::opt<bool> Z3LogicSolvers(
+    "z3-logic-solvers", llvm::cl::init(false),
+    llvm::cl::desc("Solve the queries that need no arrays, after "
+                   "--z3-array-elimination-size, with the QF_BV solver of Z3, "
+                   "which bit-blasts them to SAT. Ignored with "
+                   "--z3-incremental (default=false)"),
+    llvm::cl::cat(klee::SolvingCat));
+
+llvm::cl::opt<unsigned> Z3RecycleContextAfter(
+    "z3-recycle-context-after", llvm::cl::init(0),
+    llvm::cl::desc("Recreate the Z3 context after this many queries to "
+                   "release the memory held by its caches. Ignored with "
+                   "--debug-z3-log-api-interaction (default=0 (never))"),
+    llvm::cl::cat(klee::SolvingCat));
+
 llvm::cl::opt<unsigned>
     Z3VerbosityLevel("debug-z3-verbosity", llvm::cl::init(0),
                      llvm::cl::desc("Z3 verbosity level (default=0)"),
@@ -66,6 +98,33 @@ private:
   // Parameter symbols
   ::Z3_symbol timeoutParamStrSymbol;
 
+  /// A solver kept between queries with --z3-incremental, the constraints
+  /// asserted in it, each in a scope of its own, and the query that last
+  /// used it.
+  struct IncrementalContext {
+    ::Z3_solver solver;
+    std::vector<ref<Expr>> assertedConstraints;
+    std::uint64_t lastUse;
+  };
+  /// At most --z3-incremental-contexts of them
+  std::vector<IncrementalContext> incrementalContexts;
+  std::uint64_t incrementalQueries = 0;
+
+  /// Bring the incremental solver sharing the longest prefix with
+  /// constraints, or else the least recently used one, in sync with them,
+  /// keeping the prefix that is already asserted.
+  ::Z3_solver syncIncrementalSolver(const ConstraintSet &constraints);
+
+  /// Queries run in the current context, see --z3-recycle-context-after.
+  unsigned queriesInContext = 0;
+
+  void initContext();
+  void releaseContext();
+
+  /// Whether a query only needs the theory of bit-vectors, i.e. all arrays
+  /// it reads are eliminated by the builder.
+  static bool isBitVectorQuery(const Query &query);
+
   bool internalRunSolver(const Query &,
                          std::shared_ptr<const Assignment> &result,
                          bool &hasSolution,
@@ -100,18 +159,8 @@ public:
   SolverRunStatus getOperationStatusCode();
 };
 
-Z3SolverImpl::Z3SolverImpl()
-    : builder(new Z3Builder(
-          /*autoClearConstructCache=*/false,
-          /*z3LogInteractionFileArg=*/Z3LogInteractionFile.size() > 0
-              ? Z3LogInteractionFile.c_str()
-              : NULL)),
-      runStatusCode(SOLVER_RUN_STATUS_FAILURE) {
-  assert(builder && "unable to create Z3Builder");
-  solverParameters = Z3_mk_params(builder->ctx);
-  Z3_params_inc_ref(builder->ctx, solverParameters);
-  timeoutParamStrSymbol = Z3_mk_string_symbol(builder->ctx, "timeout");
-  setCoreSolverTimeout(timeout);
+Z3SolverImpl::Z3SolverImpl() : runStatusCode(SOLVER_RUN_STATUS_FAILURE) {
+  initContext();
 
   if (!Z3QueryDumpFile.empty()) {
     std::string error;
@@ -133,9 +182,29 @@ Z3SolverImpl::Z3SolverImpl()
   }
 }
 
-Z3SolverImpl::~Z3SolverImpl() {
+Z3SolverImpl::~Z3SolverImpl() { releaseContext(); }
+
+void Z3SolverImpl::initContext() {
+  builder = new Z3Builder(
+      /*autoClearConstructCache=*/false,
+      /*z3LogInteractionFileArg=*/Z3LogInteractionFile.size() > 0
+          ? Z3LogInteractionFile.c_str()
+          : NULL);
+  assert(builder && "unable to create Z3Builder");
+  solverParameters = Z3_mk_params(builder->ctx);
+  Z3_params_inc_ref(builder->ctx, solverParameters);
+  timeoutParamStrSymbol = Z3_mk_string_symbol(builder->ctx, "timeout");
+  setCoreSolverTimeout(timeout);
+  queriesInContext = 0;
+}
+
+void Z3SolverImpl::releaseContext() {
+  for (auto &context : incrementalContexts)
+    Z3_solver_dec_ref(builder->ctx, context.solver);
+  incrementalContexts.clear();
   Z3_params_dec_ref(builder->ctx, solverParameters);
   delete builder;
+  builder = nullptr;
 }
 
 Z3Solver::Z3Solver() : Solver(new Z3SolverImpl()) {}
@@ -174,6 +243,8 @@ char *Z3SolverImpl::getConstraintLog(const Query &query) {
   constant_arrays_in_query.visit(query.expr);
 
   for (auto const &constant_array : constant_arrays_in_query.results) {
+    if (Z3Builder::eliminatesArray(constant_array))
+      continue;
     assert(temp_builder.constant_array_assertions.count(constant_array) == 1 &&
            "Constant array found in query, but not handled by Z3Builder");
     for (auto const &arrayIndexValueExpr :
@@ -250,23 +321,46 @@ bool Z3SolverImpl::internalRunSolver(
     bool needsModel) {
 
   TimerStatIncrementer t(stats::queryTime);
+  // The array caches of the builder are only released with its context,
+  // which no Z3 handle outlives between queries.
+  if (Z3RecycleContextAfter && Z3LogInteractionFile.empty() &&
+      queriesInContext >= Z3RecycleContextAfter) {
+    releaseContext();
+    initContext();
+    ++stats::z3ContextRecycles;
+  }
+  ++queriesInContext;
+
   // NOTE: Z3 will switch to using a slower solver internally if push/pop are
   // used so for now it is likely that creating a new solver each time is the
   // right way to go until Z3 changes its behaviour.
   //
   // TODO: Investigate using a custom tactic as described in
   // https://github.com/klee/klee/issues/653
-  Z3_solver theSolver = Z3_mk_solver(builder->ctx);
-  Z3_solver_inc_ref(builder->ctx, theSolver);
-  Z3_solver_set_params(builder->ctx, theSolver, solverParameters);
-
-  runStatusCode = SOLVER_RUN_STATUS_FAILURE;
-
+  Z3_solver theSolver;
   ConstantArrayFinder constant_arrays_in_query;
-  for (auto const &constraint : query.constraints) {
-    Z3_solver_assert(builder->ctx, theSolver, builder->construct(constraint));
-    constant_arrays_in_query.visit(constraint);
+  if (Z3Incremental) {
+    theSolver = syncIncrementalSolver(query.constraints);
+    // the query itself is retracted again below
+    Z3_solver_push(builder->ctx, theSolver);
+  } else {
+    if (Z3LogicSolvers && isBitVectorQuery(query)) {
+      theSolver = Z3_mk_solver_for_logic(
+          builder->ctx, Z3_mk_string_symbol(builder->ctx, "QF_BV"));
+      ++stats::z3BitVectorQueries;
+    } else {
+      theSolver = Z3_mk_solver(builder->ctx);
+    }
+    Z3_solver_inc_ref(builder->ctx, theSolver);
+    Z3_solver_set_params(builder->ctx, theSolver, solverParameters);
+
+    for (auto const &constraint : query.constraints) {
+      Z3_solver_assert(builder->ctx, theSolver, builder->construct(constraint));
+      constant_arrays_in_query.visit(constraint);
+    }
   }
+
+  runStatusCode = SOLVER_RUN_STATUS_FAILURE;
   ++stats::queries;
   if (needsModel)
     ++stats::queryCounterexamples;
@@ -276,6 +370,8 @@ bool Z3SolverImpl::internalRunSolver(
   constant_arrays_in_query.visit(query.expr);
 
   for (auto const &constant_array : constant_arrays_in_query.results) {
+    if (Z3Builder::eliminatesArray(constant_array))
+      continue;
     assert(builder->constant_array_assertions.count(constant_array) == 1 &&
            "Constant array found in query, but not handled by Z3Builder");
     for (auto const &arrayIndexValueExpr :
@@ -306,13 +402,18 @@ bool Z3SolverImpl::internalRunSolver(
   runStatusCode = handleSolverResponse(query, theSolver, satisfiable, result,
                                        hasSolution, needsModel);
 
-  Z3_solver_dec_ref(builder->ctx, theSolver);
+  if (Z3Incremental)
+    Z3_solver_pop(builder->ctx, theSolver, 1);
+  else
+    Z3_solver_dec_ref(builder->ctx, theSolver);
   // Clear the builder's cache to prevent memory usage exploding.
   // By using ``autoClearConstructCache=false`` and clearning now
   // we allow Z3_ast expressions to be shared from an entire
   // ``Query`` rather than only sharing within a single call to
-  // ``builder->construct()``.
-  builder->clearConstructCache();
+  // ``builder->construct()``. A bounded cache limits its size itself and
+  // is kept to share expressions between queries as well.
+  if (!Z3Builder::hasBoundedConstructCache())
+    builder->clearConstructCache();
 
   if (runStatusCode == SolverImpl::SOLVER_RUN_STATUS_SUCCESS_SOLVABLE ||
       runStatusCode == SolverImpl::SOLVER_RUN_STATUS_SUCCESS_UNSOLVABLE) {
@@ -329,6 +430,80 @@ bool Z3SolverImpl::internalRunSolver(
   return false; // failed
 }
 
+bool Z3SolverImpl::isBitVectorQuery(const Query &query) {
+  std::vector<ref<ReadExpr> > reads;
+  findReads(query.expr, /*visitUpdates=*/true, reads);
+  for (const auto &constraint : query.constraints)
+    findReads(constraint, /*visitUpdates=*/true, reads);
+  for (const auto &read : reads)
+    if (!Z3Builder::eliminatesArray(read->updates.root))
+      return false;
+  return true;
+}
+
+::Z3_solver
+Z3SolverImpl::syncIncrementalSolver(const ConstraintSet &constraints) {
+  // the context sharing the longest prefix, as the states forked from each
+  // other share theirs, or else the least recently used one
+  IncrementalContext *context = nullptr;
+  size_t common = 0;
+  for (auto &candidate : incrementalContexts) {
+    const auto &asserted = candidate.assertedConstraints;
+    size_t n = 0;
+    for (auto it = constraints.begin(), ie = constraints.end();
+         it != ie && n < asserted.size() && asserted[n].get() == (*it).get();
+         ++it)
+      ++n;
+    if (!context || n > common ||
+        (n == common && !common && candidate.lastUse < context->lastUse)) {
+      context = &candidate;
+      common = n;
+    }
+  }
+  unsigned maxContexts = std::max(1u, Z3IncrementalContexts.getValue());
+  if (!common && incrementalContexts.size() < maxContexts) {
+    ::Z3_solver solver = Z3_mk_solver(builder->ctx);
+    Z3_solver_inc_ref(builder->ctx, solver);
+    incrementalContexts.push_back({solver, {}, 0});
+    context = &incrementalContexts.back();
+  }
+  if (common)
+    ++stats::z3IncrementalContextHits;
+  else
+    ++stats::z3IncrementalContextMisses;
+  context->lastUse = ++incrementalQueries;
+
+  ::Z3_solver incrementalSolver = context->solver;
+  auto &assertedConstraints = context->assertedConstraints;
+  // the timeout may have changed since the last query
+  Z3_solver_set_params(builder->ctx, incrementalSolver, solverParameters);
+
+  auto it = constraints.begin(), ie = constraints.end();
+  std::advance(it, common);
+  stats::queryConstraintsReused += common;
+
+  if (common < assertedConstraints.size()) {
+    Z3_solver_pop(builder->ctx, incrementalSolver,
+                  assertedConstraints.size() - common);
+    assertedConstraints.resize(common);
+  }
+  for (; it != ie; ++it) {
+    Z3_solver_push(builder->ctx, incrementalSolver);
+    Z3_solver_assert(builder->ctx, incrementalSolver, builder->construct(*it));
+    ConstantArrayFinder constant_arrays;
+    constant_arrays.visit(*it);
+    for (auto const &constant_array : constant_arrays.results) {
+      if (Z3Builder::eliminatesArray(constant_array))
+        continue;
+      for (auto const &arrayIndexValueExpr :
+           builder->constant_array_assertions[constant_array])
+        Z3_solver_assert(builder->ctx, incrementalSolver, arrayIndexValueExpr);
+    }
+    assertedConstraints.push_back(*it);
+  }
+  return incrementalSolver;
+}
+
 class ModelVisitor : public ExprVisitor {
 private:
   Z3Builder *builder;
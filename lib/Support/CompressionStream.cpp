@@ -13,6 +13,10 @@
 
 #include "llvm/Support/FileSystem.h"
 
+#ifdef HAVE_ZSTD_H
+#include <zstd.h>
+#endif
+
 #include <fcntl.h>
 #include <errno.h>
 #include <sys/types.h>
@@ -112,5 +116,190 @@ void compressed_fd_ostream::write_file(const char *Ptr, size_t Size) {
     Size -= ret;
   } while (Size > 0);
 }
+
+#ifdef HAVE_ZSTD_H
+zstd_fd_ostream::zstd_fd_ostream(const std::string &Filename,
+                                 std::string &ErrorInfo, unsigned Workers)
+    : llvm::raw_ostream() {
+  ErrorInfo = "";
+  std::error_code EC = llvm::sys::fs::openFileForWrite(Filename, FD);
+  if (EC) {
+    ErrorInfo = EC.message();
+    FD = -1;
+    return;
+  }
+  ctx = ZSTD_createCCtx();
+  if (!ctx) {
+    ErrorInfo = "Could not create a zstd compression context";
+    return;
+  }
+  ZSTD_CCtx_setParameter(ctx, ZSTD_c_compressionLevel, ZSTD_CLEVEL_DEFAULT);
+  // fails if zstd was built without multithreading, it then compresses on
+  // the thread of the stream only
+  if (Workers)
+    ZSTD_CCtx_setParameter(ctx, ZSTD_c_nbWorkers, Workers);
+  chunk.reserve(BUFSIZE);
+  thread = std::thread([this] { compressChunks(); });
+}
+
+zstd_fd_ostream::~zstd_fd_ostream() {
+  if (thread.joinable()) {
+    flush();
+    queueChunk();
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      closing = true;
+    }
+    queued.notify_one();
+    thread.join();
+  }
+  if (FD >= 0)
+    close(FD);
+  ZSTD_freeCCtx(ctx);
+}
+
+void zstd_fd_ostream::write_impl(const char *Ptr, size_t Size) {
+  pos += Size;
+  while (Size) {
+    size_t n = std::min(Size, BUFSIZE - chunk.size());
+    chunk.append(Ptr, n);
+    Ptr += n;
+    Size -= n;
+    if (chunk.size() == BUFSIZE)
+      queueChunk();
+  }
+}
+
+void zstd_fd_ostream::queueChunk() {
+  if (chunk.empty())
+    return;
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    taken.wait(lock, [this] { return chunks.size() < MaxQueuedChunks; });
+    chunks.push_back(std::move(chunk));
+  }
+  queued.notify_one();
+  chunk.clear();
+  chunk.reserve(BUFSIZE);
+}
+
+void zstd_fd_ostream::compressChunks() {
+  std::unique_lock<std::mutex> lock(mutex);
+  for (;;) {
+    queued.wait(lock, [this] { return closing || !chunks.empty(); });
+    if (chunks.empty())
+      break;
+    std::string data = std::move(chunks.front());
+    chunks.pop_front();
+    lock.unlock();
+    taken.notify_one();
+    compress(data, false);
+    lock.lock();
+  }
+  lock.unlock();
+  compress(std::string(), true);
+}
+
+void zstd_fd_ostream::compress(const std::string &data, bool last) {
+  uint8_t buffer[BUFSIZE];
+  ZSTD_inBuffer in = {data.data(), data.size(), 0};
+  ZSTD_EndDirective mode = last ? ZSTD_e_end : ZSTD_e_continue;
+  for (;;) {
+    ZSTD_outBuffer out = {buffer, BUFSIZE, 0};
+    size_t remaining = ZSTD_compressStream2(ctx, &out, &in, mode);
+    assert(!ZSTD_isError(remaining) && "zstd compression failed");
+    write_file(reinterpret_cast<const char *>(buffer), out.pos);
+    // without ZSTD_e_end, zstd returns once it took all of the input
+    if (ZSTD_isError(remaining) || (last ? remaining == 0 : in.pos == in.size))
+      break;
+  }
+}
+
+void zstd_fd_ostream::write_file(const char *Ptr, size_t Size) {
+  while (Size > 0) {
+    ssize_t ret = ::write(FD, Ptr, Size);
+    if (ret < 0) {
+      if (errno == EINTR || errno == EAGAIN)
+        continue;
+      assert(0 && "Could not write to file");
+      break;
+    }
+    Ptr += ret;
+    Size -= ret;
+  }
+}
+#endif
+
+bool isCompressedData(llvm::StringRef Data) {
+  return Data.startswith("\x1f\x8b") || Data.startswith("\x28\xb5\x2f\xfd");
+}
+
+std::unique_ptr<llvm::MemoryBuffer>
+decompressData(llvm::StringRef Data, llvm::StringRef BufferName,
+               std::string &ErrorInfo) {
+  std::string result;
+  if (Data.startswith("\x28\xb5\x2f\xfd")) {
+#ifdef HAVE_ZSTD_H
+    std::unique_ptr<ZSTD_DCtx, size_t (*)(ZSTD_DCtx *)> ctx(ZSTD_createDCtx(),
+                                                            ZSTD_freeDCtx);
+    ZSTD_inBuffer in = {Data.data(), Data.size(), 0};
+    for (;;) {
+      size_t done = result.size();
+      result.resize(done + BUFSIZE);
+      ZSTD_outBuffer out = {&result[done], BUFSIZE, 0};
+      size_t ret = ZSTD_decompressStream(ctx.get(), &out, &in);
+      result.resize(done + out.pos);
+      if (ZSTD_isError(ret)) {
+        ErrorInfo = ZSTD_getErrorName(ret);
+        return nullptr;
+      }
+      // a full output buffer may leave decompressed data behind
+      if (in.pos == in.size && out.pos != BUFSIZE) {
+        if (ret != 0) {
+          ErrorInfo = "Truncated zstd data";
+          return nullptr;
+        }
+        break;
+      }
+    }
+#else
+    ErrorInfo = "zstd support is not enabled";
+    return nullptr;
+#endif
+  } else {
+    z_stream strm = {};
+    // gzip, and several gzip members as written by concatenating files
+    if (inflateInit2(&strm, 15 + 16) != Z_OK) {
+      ErrorInfo = "Inflate initialisation failed";
+      return nullptr;
+    }
+    strm.next_in =
+        reinterpret_cast<Bytef *>(const_cast<char *>(Data.data()));
+    strm.avail_in = Data.size();
+    int ret = Z_OK;
+    while (strm.avail_in != 0 || ret != Z_STREAM_END) {
+      if (ret == Z_STREAM_END)
+        inflateReset(&strm);
+      size_t done = result.size();
+      result.resize(done + BUFSIZE);
+      strm.next_out = reinterpret_cast<Bytef *>(&result[done]);
+      strm.avail_out = BUFSIZE;
+      ret = inflate(&strm, Z_NO_FLUSH);
+      result.resize(done + BUFSIZE - strm.avail_out);
+      if (ret != Z_OK && ret != Z_STREAM_END) {
+        ErrorInfo = strm.msg ? strm.msg : "Corrupt gzip data";
+        inflateEnd(&strm);
+        return nullptr;
+      }
+      if (ret == Z_OK && strm.avail_in == 0 && strm.avail_out != 0) {
+        ErrorInfo = "Truncated gzip data";
+        inflateEnd(&strm);
+        return nullptr;
+      }
+    }
+    inflateEnd(&strm);
+  }
+  return llvm::MemoryBuffer::getMemBufferCopy(result, BufferName);
+}
 }
 #endif
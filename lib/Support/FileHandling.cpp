@@ -11,13 +11,36 @@
 #include "klee/Config/Version.h"
 #include "klee/Config/config.h"
 #include "klee/Support/ErrorHandling.h"
+#include "klee/Support/OptionCategories.h"
 
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/FileSystem.h"
 
 #ifdef HAVE_ZLIB_H
 #include "klee/Support/CompressionStream.h"
 #endif
 
+#ifdef HAVE_ZSTD_H
+namespace {
+enum class LogCompression { Gzip, Zstd };
+
+llvm::cl::opt<LogCompression> LogCompressionFormat(
+    "log-compression",
+    llvm::cl::desc("Format of the compressed log files (default=gzip)"),
+    llvm::cl::values(clEnumValN(LogCompression::Gzip, "gzip",
+                                "Compress with zlib on the writing thread"),
+                     clEnumValN(LogCompression::Zstd, "zstd",
+                                "Compress with zstd on separate threads")),
+    llvm::cl::init(LogCompression::Gzip), llvm::cl::cat(klee::MiscCat));
+
+llvm::cl::opt<unsigned> LogCompressionWorkers(
+    "log-compression-workers", llvm::cl::init(2),
+    llvm::cl::desc("Number of threads zstd compresses a log with, besides "
+                   "the thread queueing its data (default=2)"),
+    llvm::cl::cat(klee::MiscCat));
+} // namespace
+#endif
+
 namespace klee {
 
 std::unique_ptr<llvm::raw_fd_ostream>
@@ -36,10 +59,24 @@ klee_open_output_file(const std::string &path, std::string &error) {
 }
 
 #ifdef HAVE_ZLIB_H
+const char *klee_compressed_file_extension() {
+#ifdef HAVE_ZSTD_H
+  if (LogCompressionFormat == LogCompression::Zstd)
+    return ".zst";
+#endif
+  return ".gz";
+}
+
 std::unique_ptr<llvm::raw_ostream>
 klee_open_compressed_output_file(const std::string &path, std::string &error) {
   error.clear();
-  auto f = std::make_unique<compressed_fd_ostream>(path, error);
+  std::unique_ptr<llvm::raw_ostream> f;
+#ifdef HAVE_ZSTD_H
+  if (LogCompressionFormat == LogCompression::Zstd)
+    f = std::make_unique<zstd_fd_ostream>(path, error, LogCompressionWorkers);
+  else
+#endif
+    f = std::make_unique<compressed_fd_ostream>(path, error);
   if (!error.empty()) {
     f.reset(nullptr);
   }
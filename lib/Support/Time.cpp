@@ -16,6 +16,7 @@
 #include <sstream>
 #include <tuple>
 #include <sys/resource.h>
+#include <time.h>
 
 
 using namespace klee;
@@ -26,7 +27,8 @@ using namespace klee;
  * - separation between time points and durations
  * - good performance on Linux and macOS (similar to gettimeofday)
  * and not:
- * - clock_gettime(CLOCK_MONOTONIC_COARSE): software clock, Linux-specific
+ * - clock_gettime(CLOCK_MONOTONIC_COARSE): software clock, Linux-specific,
+ *   only used for getCoarseWallTime where available
  * - clock_gettime(CLOCK_MONOTONIC): slowest on macOS, C-like API
  * - gettimeofday: C-like API, non-monotonic
  *
@@ -207,3 +209,18 @@ time::Point time::getWallTime() {
   return time::Point(std::chrono::steady_clock::now());
 }
 
+
+/// Returns point in time using a monotonic steady clock of coarse resolution
+time::Point time::getCoarseWallTime() {
+#if defined(__linux__) && defined(CLOCK_MONOTONIC_COARSE)
+  // libstdc++ and libc++ implement steady_clock with CLOCK_MONOTONIC, with
+  // which CLOCK_MONOTONIC_COARSE shares its epoch
+  timespec ts;
+  if (!::clock_gettime(CLOCK_MONOTONIC_COARSE, &ts))
+    return time::Point(Point::SteadyTimePoint(
+        std::chrono::duration_cast<Duration>(std::chrono::seconds(ts.tv_sec) +
+                                             std::chrono::nanoseconds(ts.tv_nsec))));
+#endif
+  return getWallTime();
+}
+
@@ -399,7 +399,8 @@ ssize_t read(int fd, void *buf, size_t count) {
       count = f->dfile->size - f->off;
     }
     
-    memcpy(buf, f->dfile->contents + f->off, count);
+    buf = __concretize_ptr(buf);
+    klee_copy_file_bytes(buf, f->dfile->contents + f->off, count);
     f->off += count;
     
     return count;
@@ -463,7 +464,8 @@ ssize_t write(int fd, const void *buf, size_t count) {
     }
     
     if (actual_count)
-      memcpy(f->dfile->contents + f->off, buf, actual_count);
+      klee_copy_file_bytes(f->dfile->contents + f->off,
+                           __concretize_ptr(buf), actual_count);
     
     if (count != actual_count)
       klee_warning("write() ignores bytes.\n");
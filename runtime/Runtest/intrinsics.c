@@ -95,7 +95,7 @@ void klee_make_symbolic(void *array, size_t nbytes, const char *name) {
       }
       tmp[strlen(tmp) - 1] = '\0'; /* kill newline */
     }
-    testData = kTest_fromFile(name);
+    testData = kTest_mapFile(name);
     if (!testData) {
       fprintf(stderr, "KLEE-RUNTIME: unable to open .ktest file\n");
       exit(1);
@@ -0,0 +1,65 @@
+; RUN: %llvmas %s -f -o %t1.bc
+; RUN: rm -rf %t.klee-out
+; RUN: %klee --output-dir=%t.klee-out --auto-merge --search=dfs %t1.bc 2>&1 | FileCheck %s
+; RUN: rm -rf %t.klee-out-nomerge
+; RUN: %klee --output-dir=%t.klee-out-nomerge --search=dfs %t1.bc 2>&1 | FileCheck --check-prefix=CHECK-NOMERGE %s
+
+; The two sides of each of the four branches on the bits of x join before
+; the next one, and no later query depends on the sum they update, so all
+; paths are merged into one.
+; CHECK: completed paths = 1
+; CHECK-NOMERGE: completed paths = 16
+target datalayout = "e-m:e-p270:32:32-p271:32:32-p272:64:64-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-pc-linux-gnu"
+
+declare void @klee_make_symbolic(i8*, i64, i8*)
+@.name = private constant [2 x i8] c"x\00"
+@sum = global i32 0
+
+define void @addOne() noinline {
+  %s = load i32, i32* @sum
+  %n = add i32 %s, 1
+  store i32 %n, i32* @sum
+  ret void
+}
+
+define void @addTwo() noinline {
+  %s = load i32, i32* @sum
+  %n = add i32 %s, 2
+  store i32 %n, i32* @sum
+  ret void
+}
+
+define i32 @main() {
+entry:
+  %x.addr = alloca i32, align 4
+  %p = bitcast i32* %x.addr to i8*
+  call void @klee_make_symbolic(i8* %p, i64 4, i8* getelementptr ([2 x i8], [2 x i8]* @.name, i64 0, i64 0))
+  %x = load i32, i32* %x.addr, align 4
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %join ]
+  %mask = phi i32 [ 1, %entry ], [ %mask.next, %join ]
+  %b = and i32 %x, %mask
+  %c = icmp ne i32 %b, 0
+  br i1 %c, label %one, label %two
+
+one:
+  call void @addOne()
+  br label %join
+
+two:
+  call void @addTwo()
+  br label %join
+
+join:
+  %i.next = add i32 %i, 1
+  %mask.next = mul i32 %mask, 2
+  %done = icmp eq i32 %i.next, 4
+  br i1 %done, label %exit, label %loop
+
+exit:
+  %r = load i32, i32* @sum
+  ret i32 %r
+}
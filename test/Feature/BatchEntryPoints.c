@@ -0,0 +1,41 @@
+// RUN: %clang %s -emit-llvm -g %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --batch-entry-points=harness_a,harness_b --batch-jobs=2 %t.bc 2> %t.log
+// RUN: FileCheck -input-file=%t.log %s
+// RUN: test -f %t.klee-out/harness_a/test000001.ktest
+// RUN: test -f %t.klee-out/harness_b/test000001.user.err
+// RUN: not test -f %t.klee-out/harness_a/test000001.user.err
+// RUN: FileCheck -check-prefix=CHECK-INFO -input-file=%t.klee-out/harness_b/info %s
+// RUN: rm -rf %t.klee-out
+// RUN: not %klee --output-dir=%t.klee-out --batch-entry-points=harness_a,harness_a %t.bc 2>&1 | FileCheck -check-prefix=CHECK-REPEATED %s
+
+#include "klee/klee.h"
+
+static int counter;
+
+__attribute__((constructor)) static void init(void) { counter = 42; }
+
+int harness_a(void) {
+  int x;
+  klee_make_symbolic(&x, sizeof(x), "x");
+  if (x > 10)
+    return 1;
+  return 0;
+}
+
+int harness_b(void) {
+  int x;
+  klee_make_symbolic(&x, sizeof(x), "x");
+  // the constructors run before every entry point
+  if (counter == 42 && x == 7)
+    klee_report_error(__FILE__, __LINE__, "seven", "user.err");
+  return 0;
+}
+
+// CHECK-DAG: batch run of 'harness_a' exited with status 0
+// CHECK-DAG: batch run of 'harness_b' exited with status 0
+
+// CHECK-INFO: Batch entry point: harness_b
+// CHECK-INFO: KLEE: done: generated tests = 2
+
+// CHECK-REPEATED: invalid --batch-entry-points: 'harness_a' is empty or repeated
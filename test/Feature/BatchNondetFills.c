@@ -0,0 +1,27 @@
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --batch-nondet-fills %t.bc 2>&1 | FileCheck %s
+// RUN: FileCheck --check-prefix=CHECK-INFO %s < %t.klee-out/info
+
+// The nondet values stored one after the other into a buffer are read from
+// one array, and the test still holds one object per value.
+#include "klee/klee.h"
+
+int __VERIFIER_nondet_int(void);
+char __VERIFIER_nondet_char(void);
+
+int main(void) {
+  int a[100];
+  char b[8];
+  for (int i = 0; i < 100; ++i)
+    a[i] = __VERIFIER_nondet_int();
+  for (int i = 0; i < 8; ++i)
+    b[i] = __VERIFIER_nondet_char();
+
+  if (a[0] == 1 && a[50] == 7 && a[99] == 3 && b[5] == 'A')
+    klee_warning("reached");
+  return 0;
+}
+
+// CHECK: reached
+// CHECK-INFO: batched nondet values = {{[1-9][0-9]*}}
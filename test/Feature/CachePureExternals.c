@@ -0,0 +1,19 @@
+// RUN: %clang %s -emit-llvm %O0opt -c -g -o %t1.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --cache-pure-externals --pure-external=labs %t1.bc 2>&1 | FileCheck %s
+// RUN: FileCheck --input-file=%t.klee-out/info -check-prefix=CHECK-INFO %s
+
+// only the first call for each of the two arguments goes to the external
+// CHECK-INFO: cached external calls = 8
+// CHECK-NOT: ASSERTION FAIL
+
+#include <assert.h>
+#include <stdlib.h>
+
+int main(int argc, char **argv) {
+  long sum = 0;
+  for (int i = 0; i < 10; ++i)
+    sum += labs(i % 2 ? -3 : -4);
+  assert(sum == 35);
+  return 0;
+}
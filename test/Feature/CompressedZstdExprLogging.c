@@ -0,0 +1,25 @@
+// REQUIRES: zstd
+// RUN: %clang %s -emit-llvm -g %O0opt -c -o %t1.bc
+// RUN: rm -rf %t.klee-out %t.klee-out2
+// RUN: %klee --output-dir=%t.klee-out --use-cex-cache=false --use-query-log=all:kquery %t1.bc
+// RUN: %klee --output-dir=%t.klee-out2 --use-cex-cache=false --compress-query-log --log-compression=zstd --use-query-log=all:kquery %t1.bc
+// RUN: %kleaver --print-ast %t.klee-out/all-queries.kquery > %t.ast
+// RUN: %kleaver --print-ast %t.klee-out2/all-queries.kquery.zst > %t.zst.ast
+// RUN: diff %t.ast %t.zst.ast
+
+#include <assert.h>
+
+int main() {
+  char buf[4];
+  klee_make_symbolic(buf, sizeof buf, "buf");
+
+  buf[klee_range(0, 4, "idx")] = 0;
+  klee_assume(buf[0] == 'h');
+
+  int x = *((int *)buf);
+  klee_assume(x > 2);
+
+  assert(0);
+
+  return 0;
+}
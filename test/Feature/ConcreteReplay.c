@@ -0,0 +1,34 @@
+// RUN: %clang %s -emit-llvm -g %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out %t.replay-out
+// RUN: %klee --output-dir=%t.klee-out %t.bc
+// RUN: test -f %t.klee-out/test000001.user.err
+// RUN: %klee --output-dir=%t.replay-out --replay-nondets=%t.klee-out/test000001.ktest --concrete-replay %t.bc 2>&1 | FileCheck %s
+// RUN: test -f %t.replay-out/test000001.user.err
+// RUN: %klee-stats --print-columns 'Path,Queries' --table-format=csv %t.replay-out | FileCheck --check-prefix=CHECK-STATS %s
+// RUN: rm -rf %t.klee-out
+// RUN: not %klee --output-dir=%t.klee-out --concrete-replay %t.bc 2>&1 | FileCheck --check-prefix=CHECK-USAGE %s
+
+#include "klee/klee.h"
+
+int __VERIFIER_nondet_int(void);
+
+int main(void) {
+  int x;
+  klee_make_symbolic(&x, sizeof(x), "x");
+  int y = __VERIFIER_nondet_int();
+  // the test has to carry values of both that agree
+  klee_assume(x > 40 & y < 10);
+  if (x + y == 49)
+    klee_report_error(__FILE__, __LINE__, "forty-nine", "user.err");
+  // only the error is written as a test
+  klee_silent_exit(0);
+  return 0;
+}
+
+// CHECK: Input vector: __VERIFIER_nondet_int
+// CHECK: KLEE: ERROR: {{.*}}forty-nine
+
+// the replay is concrete
+// CHECK-STATS: {{.*}}replay-out,0{{$}}
+
+// CHECK-USAGE: --concrete-replay used without --replay-nondets
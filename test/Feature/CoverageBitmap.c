@@ -0,0 +1,23 @@
+// RUN: %clang %s -emit-llvm -g %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out %t.klee-out2 %t.bitmap
+// RUN: %klee --output-dir=%t.klee-out --coverage-bitmap=%t.bitmap --only-output-states-covering-new %t.bc 2>&1 | FileCheck %s
+// RUN: %klee --output-dir=%t.klee-out2 --coverage-bitmap=%t.bitmap --only-output-states-covering-new %t.bc 2>&1 | FileCheck --check-prefix=CHECK-SECOND %s
+
+// The second run shares the coverage of the first through the bitmap, so
+// none of its states covers new code.
+#include "klee/klee.h"
+
+int main(void) {
+  int x;
+  klee_make_symbolic(&x, sizeof(x), "x");
+  if (x > 10)
+    return 1;
+  if (x < -10)
+    return 2;
+  return 0;
+}
+
+// CHECK-NOT: coverage bitmap
+// CHECK: KLEE: done: generated tests = 3
+// CHECK-SECOND-NOT: coverage bitmap
+// CHECK-SECOND: KLEE: done: generated tests = 0
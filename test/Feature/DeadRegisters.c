@@ -0,0 +1,35 @@
+// RUN: %clang %s -emit-llvm -g %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --optimize %t.bc 2>&1 | FileCheck %s
+
+// Registers are released once dead, while the values still read after a
+// loop, a call or a fork are kept.
+#include "klee/klee.h"
+
+#include <assert.h>
+
+static unsigned mix(unsigned a, unsigned b) { return a * 31 + b; }
+
+int main(void) {
+  unsigned x, n;
+  klee_make_symbolic(&x, sizeof(x), "x");
+  klee_make_symbolic(&n, sizeof(n), "n");
+  klee_assume(n < 4);
+
+  unsigned sum = 0, last = x;
+  for (unsigned i = 0; i < 64; ++i) {
+    unsigned t = mix(last, i);
+    sum += t & 1;
+    last = t;
+  }
+  unsigned kept = x ^ n;
+  if (n > 1)
+    sum += mix(kept, n);
+  assert(sum <= 64 || n > 1);
+  if ((kept ^ x) == n)
+    klee_warning("kept");
+  return last == 0;
+}
+
+// CHECK: kept
+// CHECK-NOT: ASSERTION FAIL
@@ -0,0 +1,70 @@
+; RUN: %llvmas %s -f -o %t1.bc
+; RUN: rm -rf %t.klee-out
+; RUN: %klee --output-dir=%t.klee-out --search=error-dist --exit-on-error-type=Assert %t1.bc 2>&1 | FileCheck %s
+; RUN: rm -rf %t.klee-out-bfs
+; RUN: %klee --output-dir=%t.klee-out-bfs --search=bfs --exit-on-error-type=Assert %t1.bc 2>&1 | FileCheck --check-prefix=CHECK-OTHER %s
+; RUN: rm -rf %t.klee-out-dfs
+; RUN: %klee --output-dir=%t.klee-out-dfs --search=dfs --exit-on-error-type=Assert %t1.bc 2>&1 | FileCheck --check-prefix=CHECK-OTHER %s
+; RUN: rm -rf %t.klee-out-random
+; RUN: %klee --output-dir=%t.klee-out-random --search=random-state --exit-on-error-type=Assert %t1.bc 2>&1 | FileCheck --check-prefix=CHECK-OTHER %s
+
+; Each iteration of the loop forks a state that leaves @main early. Only the
+; state that stays in the loop can reach the failing call in @check, so the
+; distance searcher follows it and finds the error before any path
+; completes. The other searchers complete early exits first.
+; CHECK: ASSERTION FAIL
+; CHECK: completed paths = 0
+; CHECK-OTHER: ASSERTION FAIL
+; CHECK-OTHER: completed paths = {{[1-9]}}
+target datalayout = "e-m:e-p270:32:32-p271:32:32-p272:64:64-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-pc-linux-gnu"
+
+declare void @klee_make_symbolic(i8*, i64, i8*)
+declare void @__assert_fail(i8*, i8*, i32, i8*) noreturn
+@.name = private constant [2 x i8] c"x\00"
+@.msg = private constant [6 x i8] c"error\00"
+@exits = global i32 0
+
+define void @check(i32 %x) {
+entry:
+  %c = icmp eq i32 %x, 256
+  br i1 %c, label %fail, label %done
+
+fail:
+  call void @__assert_fail(i8* getelementptr ([6 x i8], [6 x i8]* @.msg, i64 0, i64 0), i8* getelementptr ([6 x i8], [6 x i8]* @.msg, i64 0, i64 0), i32 0, i8* getelementptr ([6 x i8], [6 x i8]* @.msg, i64 0, i64 0))
+  unreachable
+
+done:
+  ret void
+}
+
+define i32 @main() {
+entry:
+  %xp = alloca i32
+  %xpc = bitcast i32* %xp to i8*
+  call void @klee_make_symbolic(i8* %xpc, i64 4, i8* getelementptr ([2 x i8], [2 x i8]* @.name, i64 0, i64 0))
+  %x = load i32, i32* %xp
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %next, %latch ]
+  %bits = phi i32 [ %x, %entry ], [ %rest, %latch ]
+  %set = and i32 %bits, 1
+  %clear = icmp eq i32 %set, 0
+  br i1 %clear, label %latch, label %early
+
+early:
+  ; the volatile store keeps the block from being folded into a select
+  store volatile i32 %i, i32* @exits
+  ret i32 1
+
+latch:
+  %next = add i32 %i, 1
+  %rest = lshr i32 %bits, 1
+  %end = icmp eq i32 %next, 8
+  br i1 %end, label %call, label %loop
+
+call:
+  call void @check(i32 %x)
+  ret i32 0
+}
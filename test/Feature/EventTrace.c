@@ -0,0 +1,29 @@
+// RUN: %clang %s -emit-llvm -g %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --event-trace %t.bc 2> %t.log
+// RUN: %klee-trace --format=text %t.klee-out > %t.events
+// RUN: FileCheck -input-file=%t.events %s
+// RUN: %klee-trace --format=chrome -o %t.json %t.klee-out
+// RUN: FileCheck -check-prefix=CHECK-CHROME -input-file=%t.json %s
+
+#include "klee/klee.h"
+
+int main(void) {
+  int x;
+  klee_make_symbolic(&x, sizeof(x), "x");
+  if (x > 10)
+    return 1;
+  if (x < -10)
+    klee_report_error(__FILE__, __LINE__, "too small", "user.err");
+  return 0;
+}
+
+// CHECK-DAG: QueryStart Branch
+// CHECK-DAG: QueryEnd Branch 1
+// CHECK-DAG: Fork
+// CHECK-DAG: Select
+// CHECK-DAG: Terminate Exit
+// CHECK-DAG: Terminate ReportError
+
+// CHECK-CHROME: "traceEvents"
+// CHECK-CHROME: "name": "query Branch"
@@ -0,0 +1,19 @@
+// RUN: %clang %s -emit-llvm %O0opt -c -g -o %t1.bc
+// RUN: rm -rf %t.klee-out %t.stubs
+// RUN: %klee --output-dir=%t.klee-out --external-stub-cache=%t.stubs %t1.bc 2>&1 | FileCheck %s
+// RUN: FileCheck --input-file=%t.klee-out/info -check-prefix=CHECK-FIRST %s
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --external-stub-cache=%t.stubs %t1.bc 2>&1 | FileCheck %s
+// RUN: FileCheck --input-file=%t.klee-out/info -check-prefix=CHECK-SECOND %s
+
+// CHECK: labs = 3
+// CHECK-FIRST: external call stubs loaded = 0
+// CHECK-SECOND: external call stubs loaded = {{[1-9]}}
+
+#include <stdio.h>
+#include <stdlib.h>
+
+int main(int argc, char **argv) {
+  printf("labs = %ld\n", labs(-3));
+  return 0;
+}
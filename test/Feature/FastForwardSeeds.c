@@ -0,0 +1,37 @@
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t.bc
+// RUN: rm -rf %t.seed %t.klee-out
+// RUN: %klee --output-dir=%t.seed %t.bc initial
+// RUN: %klee --output-dir=%t.klee-out --only-replay-seeds --fast-forward-seeds --seed-file=%t.seed/test000001.ktest %t.bc
+// RUN: FileCheck --input-file=%t.klee-out/info -check-prefix=CHECK-INFO %s
+// RUN: %ktest-tool %t.klee-out/test000001.ktest | FileCheck %s
+// RUN: not test -f %t.klee-out/test000002.ktest
+
+// CHECK-INFO: branches decided by seeds = {{[1-9][0-9]*}}
+
+// the test case is the seed itself
+// CHECK: data: b'seeded!\x00'
+
+#include "klee/klee.h"
+
+#include <stdio.h>
+#include <string.h>
+
+int main(int argc, char **argv) {
+  char buf[8];
+  klee_make_symbolic(buf, sizeof buf, "buf");
+
+  if (argc == 2 && strcmp(argv[1], "initial") == 0) {
+    const char *seed = "seeded!";
+    for (unsigned i = 0; i < sizeof buf; ++i)
+      klee_assume(buf[i] == seed[i]);
+  }
+
+  unsigned count = 0;
+  for (unsigned i = 0; i < sizeof buf; ++i) {
+    if (buf[i] > 'm') {
+      ++count;
+      printf("%u\n", i);
+    }
+  }
+  return count;
+}
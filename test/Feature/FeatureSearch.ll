@@ -0,0 +1,76 @@
+; RUN: %llvmas %s -f -o %t1.bc
+; RUN: echo "linear" > %t.linear
+; RUN: echo "error-distance -1" >> %t.linear
+; RUN: rm -rf %t.klee-out
+; RUN: %klee --output-dir=%t.klee-out --search=feature-score --feature-model=%t.linear --exit-on-error-type=Assert %t1.bc 2>&1 | FileCheck %s
+; RUN: echo "tree" > %t.tree
+; RUN: echo "split error-distance 1000000 1 2" >> %t.tree
+; RUN: echo "split depth 1 3 4" >> %t.tree
+; RUN: echo "leaf -1" >> %t.tree
+; RUN: echo "leaf 0" >> %t.tree
+; RUN: echo "leaf 1" >> %t.tree
+; RUN: rm -rf %t.klee-out
+; RUN: %klee --output-dir=%t.klee-out --search=feature-score --feature-model=%t.tree --exit-on-error-type=Assert %t1.bc 2>&1 | FileCheck %s
+; RUN: echo "linear" > %t.bad
+; RUN: echo "distance 1" >> %t.bad
+; RUN: rm -rf %t.klee-out
+; RUN: not %klee --output-dir=%t.klee-out --search=feature-score --feature-model=%t.bad %t1.bc 2>&1 | FileCheck --check-prefix=CHECK-BAD %s
+
+; A model preferring states close to an error call explores the state that
+; skips the loop first, as --search=error-dist does. The tree model prefers
+; the deeper states and leaves the ones that cannot reach an error last.
+; CHECK: ASSERTION FAIL
+; CHECK: completed paths = 0
+; CHECK-BAD: unable to load feature model {{.*}}: line 2: unknown feature 'distance'
+target datalayout = "e-m:e-p270:32:32-p271:32:32-p272:64:64-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-pc-linux-gnu"
+
+declare void @klee_make_symbolic(i8*, i64, i8*)
+declare void @__assert_fail(i8*, i8*, i32, i8*) noreturn
+@.name = private constant [2 x i8] c"x\00"
+@.msg = private constant [6 x i8] c"error\00"
+
+define void @check(i32 %x) {
+entry:
+  %c = icmp eq i32 %x, 42
+  br i1 %c, label %fail, label %done
+
+fail:
+  call void @__assert_fail(i8* getelementptr ([6 x i8], [6 x i8]* @.msg, i64 0, i64 0), i8* getelementptr ([6 x i8], [6 x i8]* @.msg, i64 0, i64 0), i32 0, i8* getelementptr ([6 x i8], [6 x i8]* @.msg, i64 0, i64 0))
+  unreachable
+
+done:
+  ret void
+}
+
+define i32 @main() {
+entry:
+  %xp = alloca i32
+  %xpc = bitcast i32* %xp to i8*
+  call void @klee_make_symbolic(i8* %xpc, i64 4, i8* getelementptr ([2 x i8], [2 x i8]* @.name, i64 0, i64 0))
+  %x = load i32, i32* %xp
+  %big = icmp ugt i32 %x, 1000
+  br i1 %big, label %loop, label %call
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %next, %latch ]
+  %bit = lshr i32 %x, %i
+  %set = and i32 %bit, 1
+  %b = icmp eq i32 %set, 0
+  br i1 %b, label %latch, label %odd
+
+odd:
+  br label %latch
+
+latch:
+  %next = add i32 %i, 1
+  %end = icmp eq i32 %next, 8
+  br i1 %end, label %exit, label %loop
+
+call:
+  call void @check(i32 %x)
+  br label %exit
+
+exit:
+  ret i32 0
+}
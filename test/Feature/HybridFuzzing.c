@@ -0,0 +1,27 @@
+// RUN: %clang %s -emit-llvm -g %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --fuzz-time=1s --fuzz-rounds=2 %t.bc 2>&1 | FileCheck %s
+// RUN: test -f %t.klee-out/test000001.ktest
+
+// The fuzzer finds the inputs of the easy branches, and the symbolic
+// exploration seeded with them solves for the sum.
+#include "klee/klee.h"
+
+int __VERIFIER_nondet_int(void);
+
+int main(void) {
+  int x;
+  klee_make_symbolic(&x, sizeof(x), "x");
+  int y = __VERIFIER_nondet_int();
+
+  if (x > 100 && y < -5) {
+    if (x + y == 1000)
+      klee_report_error(__FILE__, __LINE__, "deep", "user.err");
+  }
+  return 0;
+}
+
+// CHECK: fuzzing round 1: {{[0-9]+}} runs, kept {{[1-9][0-9]*}} inputs
+// CHECK: ERROR: {{.*}}HybridFuzzing.c:{{[0-9]+}}: deep
+// CHECK: fuzzing round 2:
+// CHECK: KLEE: done: completed paths
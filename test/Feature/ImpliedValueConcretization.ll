@@ -0,0 +1,42 @@
+; RUN: %llvmas %s -f -o %t1.bc
+; RUN: rm -rf %t.klee-out
+; RUN: %klee --output-dir=%t.klee-out --optimize=false --implied-value-concretization %t1.bc 2>&1 | FileCheck %s
+; RUN: rm -rf %t.klee-out
+; RUN: %klee --output-dir=%t.klee-out --optimize=false %t1.bc 2>&1 | FileCheck --check-prefix=CHECK-OFF %s
+target datalayout = "e-p:64:64:64-i1:8:8-i8:8:8-i16:16:16-i32:32:32-i64:64:64-f32:32:32-f64:64:64-v64:64:64-v128:128:128-a0:0:64-s0:64:64-f80:128:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+@.x = private unnamed_addr constant [2 x i8] c"x\00", align 1
+@.y = private unnamed_addr constant [2 x i8] c"y\00", align 1
+
+declare void @klee_make_symbolic(i8*, i64, i8*)
+declare void @klee_print_expr(i8*, ...)
+
+define i32 @main() {
+entry:
+  %x = alloca i32
+  %y = alloca i32
+  %xp = bitcast i32* %x to i8*
+  call void @klee_make_symbolic(i8* %xp, i64 4, i8* getelementptr inbounds ([2 x i8], [2 x i8]* @.x, i32 0, i32 0))
+  ; y holds reads of x as well
+  %v = load i32, i32* %x
+  %v1 = add i32 %v, 1
+  store i32 %v1, i32* %y
+  %c = icmp eq i32 %v, 42
+  br i1 %c, label %then, label %exit
+
+then:
+  ; the reads of x in both objects are replaced by the implied value
+  %xv = load i32, i32* %x
+  call void(i8*, ...) @klee_print_expr(i8* getelementptr inbounds ([2 x i8], [2 x i8]* @.x, i32 0, i32 0), i32 %xv)
+  ; CHECK: x:42
+  ; CHECK-OFF: x:(ReadLSB w32 0 x)
+  %yv = load i32, i32* %y
+  call void(i8*, ...) @klee_print_expr(i8* getelementptr inbounds ([2 x i8], [2 x i8]* @.y, i32 0, i32 0), i32 %yv)
+  ; CHECK: y:43
+  ; CHECK-OFF: y:(Add w32 1
+  br label %exit
+
+exit:
+  ret i32 0
+}
@@ -0,0 +1,38 @@
+// RUN: %clang %s -emit-llvm -g %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out %t.bc 2>&1 | FileCheck %s
+
+// The zero-initialized parts of globals are only stored once written, and
+// data arrays are written in bulk.
+#include "klee/klee.h"
+
+#include <assert.h>
+
+static int zeros[1 << 24];
+static int pair[2];
+static const short table[] = {1, -2, 300, -4000};
+static struct {
+  char tag;
+  long padding[4096];
+  double scale;
+} mixed = {'k', {0}, 0.5};
+
+int main(void) {
+  unsigned i;
+  klee_make_symbolic(&i, sizeof(i), "i");
+  klee_assume(i < 4);
+
+  assert(zeros[12345] == 0 && zeros[(1 << 24) - 1] == 0);
+  assert(pair[1] == 0);
+  zeros[12345] = table[i];
+  assert(zeros[12344] == 0 && zeros[12346] == 0);
+  assert(mixed.tag == 'k' && mixed.padding[4095] == 0 && mixed.scale == 0.5);
+
+  if (zeros[12345] == -4000)
+    klee_warning("read the last entry");
+  return zeros[12345] == 300;
+}
+
+// CHECK: read the last entry
+// CHECK-NOT: ASSERTION FAIL
+// CHECK: KLEE: done: completed paths = 2
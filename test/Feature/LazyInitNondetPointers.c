@@ -0,0 +1,25 @@
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --lazy-init-nondet-pointers %t.bc 2>&1 | FileCheck %s
+
+// the second pointer may alias the object of the first one
+// CHECK: KLEE: ERROR: {{.*}} ASSERTION FAIL
+// CHECK: KLEE: done: completed paths = 4
+// CHECK: KLEE: done: partially completed paths = 1
+
+#include <assert.h>
+
+void *__VERIFIER_nondet_pointer(void);
+
+int *get(void) { return __VERIFIER_nondet_pointer(); }
+
+int main(void) {
+  int *p = get();
+  int *q = get();
+  if (!p || !q)
+    return 0;
+  *p = 1;
+  *q = 2;
+  assert(*p == 1);
+  return 0;
+}
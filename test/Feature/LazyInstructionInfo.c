@@ -0,0 +1,21 @@
+// RUN: %clang %s -emit-llvm %O0opt -c -g -o %t1.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --lazy-instruction-info --output-istats=false %t1.bc 2>&1 | FileCheck %s
+
+#include "klee/klee.h"
+
+int unused(int x) { return x * 3; }
+
+int load(int *p) {
+  // CHECK: LazyInstructionInfo.c:[[@LINE+1]]: memory error
+  return *p;
+}
+
+int main(int argc, char **argv) {
+  int x;
+  klee_make_symbolic(&x, sizeof(x), "x");
+  if (x > 10)
+    return load(0);
+  return 0;
+}
+
@@ -0,0 +1,37 @@
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t1.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --check-leaks %t1.bc 2>&1 | FileCheck %s
+// RUN: ls %t.klee-out | grep -c "leak.err" | FileCheck -check-prefix=CHECK-COUNT %s
+
+#include "klee/klee.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+
+struct node {
+  uintptr_t next;
+};
+
+// pointers hidden in integers, of a global and of a heap object
+uintptr_t head;
+
+// the locals holding the pointers are gone once it returns
+static void build(void) {
+  struct node *first = malloc(sizeof(*first));
+  struct node *second = malloc(sizeof(*second));
+  second->next = 0;
+  first->next = (uintptr_t)second;
+  head = (uintptr_t)first;
+}
+
+int main() {
+  build();
+
+  int drop;
+  klee_make_symbolic(&drop, sizeof(drop), "drop");
+  if (drop)
+    head = 0;
+  // CHECK: memory error: memory leak detected
+  // CHECK-COUNT: 1
+  return 0;
+}
@@ -0,0 +1,22 @@
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out %t.klee-out-all
+// RUN: %klee --output-dir=%t.klee-out --max-sym-array-size=32 --max-sym-array-concretizations=4 %t.bc 2>&1 | FileCheck %s
+// RUN: %klee --output-dir=%t.klee-out-all --max-sym-array-size=32 --max-sym-array-concretizations=100 %t.bc 2>&1 | FileCheck -check-prefix=CHECK-ALL %s
+
+// four offsets, one state for the other offsets and one for i >= 64
+// CHECK: KLEE: done: completed paths = 6
+
+// all 64 offsets are feasible, so there is no state for other offsets
+// CHECK-ALL: KLEE: done: completed paths = 65
+
+#include "klee/klee.h"
+
+char big[64];
+
+int main(void) {
+  unsigned i;
+  klee_make_symbolic(&i, sizeof(i), "i");
+  if (i >= 64)
+    return 1;
+  return big[i];
+}
@@ -0,0 +1,42 @@
+// RUN: %clang %s -emit-llvm -g %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --memoize-calls %t.bc 2>&1 | FileCheck %s
+// RUN: FileCheck --check-prefix=CHECK-INFO %s < %t.klee-out/info
+
+// The repeated calls of the functions that only read their arguments and
+// globals are answered from the earlier ones, until a global they read
+// changes.
+#include "klee/klee.h"
+
+int table[4] = {1, 2, 3, 4};
+
+int sum(const int *a, int n) {
+  int s = 0;
+  for (int i = 0; i < n; ++i)
+    s += a[i] + table[i & 3];
+  return s;
+}
+
+int fib(int n) { return n < 2 ? n : fib(n - 1) + fib(n - 2); }
+
+int main(void) {
+  int a[3] = {1, 2, 3};
+  int acc = 0;
+  for (int i = 0; i < 10; ++i)
+    acc += sum(a, 3);
+
+  table[0] = 11;
+  int changed = sum(a, 3);
+
+  int x;
+  klee_make_symbolic(&x, sizeof(x), "x");
+  if (acc == 120 && changed == 22 && fib(20) == 6765)
+    klee_warning("memoized results match");
+  if (x > 0)
+    return fib(10);
+  return 0;
+}
+
+// CHECK: memoized results match
+// CHECK: KLEE: done: completed paths = 2
+// CHECK-INFO: memoized calls answered = {{[1-9][0-9]*}}
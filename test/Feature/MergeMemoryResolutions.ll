@@ -0,0 +1,47 @@
+; RUN: %llvmas %s -f -o %t1.bc
+; RUN: rm -rf %t.klee-out
+; RUN: %klee --output-dir=%t.klee-out --merge-memory-resolutions %t1.bc 2>&1 | FileCheck %s
+
+; The load through %q may hit any of @a, @b and @c, it is executed as one
+; read in a single state instead of a state per object.
+; CHECK-DAG: memory error: out of bound pointer
+; CHECK-DAG: abort failure
+; CHECK: KLEE: done: completed paths = 1
+; CHECK: KLEE: done: partially completed paths = 2
+target datalayout = "e-m:e-p270:32:32-p271:32:32-p272:64:64-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-pc-linux-gnu"
+
+declare void @klee_make_symbolic(i8*, i64, i8*)
+declare void @abort() noreturn
+@.name = private constant [2 x i8] c"x\00"
+@a = global [4 x i32] [i32 1, i32 2, i32 3, i32 4]
+@b = global [4 x i32] [i32 10, i32 20, i32 30, i32 40]
+@c = global [2 x i32] [i32 100, i32 200]
+
+define i32 @main() {
+entry:
+  %x = alloca i32
+  %xp = bitcast i32* %x to i8*
+  call void @klee_make_symbolic(i8* %xp, i64 4, i8* getelementptr ([2 x i8], [2 x i8]* @.name, i64 0, i64 0))
+  %v = load i32, i32* %x
+  %s = and i32 %v, 3
+  %c1 = icmp eq i32 %s, 0
+  %c2 = icmp eq i32 %s, 1
+  %pa = getelementptr [4 x i32], [4 x i32]* @a, i64 0, i64 0
+  %pb = getelementptr [4 x i32], [4 x i32]* @b, i64 0, i64 0
+  %pc = getelementptr [2 x i32], [2 x i32]* @c, i64 0, i64 0
+  %p1 = select i1 %c1, i32* %pa, i32* %pb
+  %p = select i1 %c2, i32* %pc, i32* %p1
+  %i = lshr i32 %v, 2
+  %i3 = and i32 %i, 3
+  %i64 = zext i32 %i3 to i64
+  %q = getelementptr i32, i32* %p, i64 %i64
+  %r = load i32, i32* %q
+  %ok = icmp eq i32 %r, 30
+  br i1 %ok, label %yes, label %no
+yes:
+  call void @abort()
+  unreachable
+no:
+  ret i32 0
+}
@@ -0,0 +1,61 @@
+; RUN: %llvmas %s -f -o %t1.bc
+; RUN: rm -rf %t.klee-out
+; RUN: %klee --output-dir=%t.klee-out --search=nurs:md2u %t1.bc 2>&1 | FileCheck --check-prefix=CHECK-RUN %s
+; RUN: FileCheck < %t.klee-out/run.istats %s
+
+; The %dead block is never executed, so it is the only uncovered code left
+; at the end. Instructions that lead to it count the steps there, calls
+; counting as two, and those that cannot reach it get 0. Each line starts
+; with the instruction and line positions; UCdist is the eighth event.
+; CHECK-RUN: completed paths = 2
+; CHECK: fn=main
+; %entry
+; CHECK-NEXT: {{^[0-9]+ [0-9]+( [0-9]+){7} }}11 {{.*$}}
+; CHECK-NEXT: {{^[0-9]+ [0-9]+( [0-9]+){7} }}10 {{.*$}}
+; CHECK-NEXT: {{^[0-9]+ [0-9]+( [0-9]+){7} }}9 {{.*$}}
+; CHECK-NEXT: {{^[0-9]+ [0-9]+( [0-9]+){7} }}7 {{.*$}}
+; CHECK-NEXT: {{^[0-9]+ [0-9]+( [0-9]+){7} }}6 {{.*$}}
+; CHECK-NEXT: {{^[0-9]+ [0-9]+( [0-9]+){7} }}5 {{.*$}}
+; %then
+; CHECK-NEXT: {{^[0-9]+ [0-9]+( [0-9]+){7} }}4 {{.*$}}
+; CHECK-NEXT: {{^[0-9]+ [0-9]+( [0-9]+){7} }}3 {{.*$}}
+; CHECK-NEXT: {{^[0-9]+ [0-9]+( [0-9]+){7} }}2 {{.*$}}
+; %dead
+; CHECK-NEXT: {{^[0-9]+ [0-9]+( [0-9]+){7} }}1 {{.*$}}
+; CHECK-NEXT: {{^[0-9]+ [0-9]+( [0-9]+){7} }}1 {{.*$}}
+; %else and %exit
+; CHECK-NEXT: {{^[0-9]+ [0-9]+( [0-9]+){7} }}0 {{.*$}}
+; CHECK-NEXT: {{^[0-9]+ [0-9]+( [0-9]+){7} }}0 {{.*$}}
+; CHECK-NEXT: {{^[0-9]+ [0-9]+( [0-9]+){7} }}0 {{.*$}}
+target datalayout = "e-m:e-p270:32:32-p271:32:32-p272:64:64-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-pc-linux-gnu"
+
+declare void @klee_make_symbolic(i8*, i64, i8*)
+@.name = private constant [2 x i8] c"x\00"
+@sink = global i32 0
+
+define i32 @main() {
+entry:
+  %xp = alloca i32
+  %xpc = bitcast i32* %xp to i8*
+  call void @klee_make_symbolic(i8* %xpc, i64 4, i8* getelementptr ([2 x i8], [2 x i8]* @.name, i64 0, i64 0))
+  %x = load i32, i32* %xp
+  %c = icmp eq i32 %x, 7
+  br i1 %c, label %then, label %else
+
+then:
+  %odd = and i32 %x, 1
+  %never = icmp eq i32 %odd, 2
+  br i1 %never, label %dead, label %exit
+
+dead:
+  store volatile i32 3, i32* @sink
+  br label %exit
+
+else:
+  store volatile i32 2, i32* @sink
+  br label %exit
+
+exit:
+  ret i32 0
+}
@@ -0,0 +1,24 @@
+// RUN: %clang %s -emit-llvm %O0opt -c -g -o %t1.bc
+// RUN: rm -rf %t.klee-out %t.cache
+// RUN: %klee --output-dir=%t.klee-out --module-cache=%t.cache %t1.bc 2>&1 | FileCheck -check-prefix=CHECK-FIRST %s
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --module-cache=%t.cache %t1.bc 2>&1 | FileCheck -check-prefix=CHECK-SECOND %s
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --module-cache=%t.cache --check-div-zero=false %t1.bc 2>&1 | FileCheck -check-prefix=CHECK-OPTIONS %s
+
+// CHECK-FIRST-NOT: Using cached module
+// CHECK-FIRST: completed paths = 2
+// CHECK-SECOND: Using cached module
+// CHECK-SECOND: completed paths = 2
+// CHECK-OPTIONS-NOT: Using cached module
+// CHECK-OPTIONS: completed paths = 2
+
+#include "klee/klee.h"
+
+int main(int argc, char **argv) {
+  int x;
+  klee_make_symbolic(&x, sizeof(x), "x");
+  if (x > 10)
+    return 1;
+  return 0;
+}
@@ -0,0 +1,33 @@
+// RUN: %clang -emit-llvm -c -g %O0opt %s -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --check-mode=native -check-div-zero -check-overshift %t.bc 2> %t.log
+// RUN: FileCheck --input-file=%t.log %s
+// RUN: FileCheck --input-file=%t.klee-out/assembly.ll %s -check-prefix=CHECK-IR
+
+/* The checks run in the executor, without calls to the runtime. */
+#include "klee/klee.h"
+
+int main() {
+  unsigned int a = 15;
+  volatile unsigned int d;
+  volatile unsigned int s;
+
+  klee_make_symbolic(&d, sizeof(d), "divisor");
+  klee_make_symbolic(&s, sizeof(s), "shift_amount");
+
+  // CHECK: NativeChecks.c:[[@LINE+1]]: divide by zero
+  unsigned int quotient = a / d;
+
+  // CHECK: NativeChecks.c:[[@LINE+1]]: overshift error
+  unsigned int shifted = a << s;
+
+  // constant operands are never checked
+  volatile unsigned int c = a / 5 + (a >> 2);
+
+  // CHECK-IR-NOT: call {{.*}}@klee_div_zero_check
+  // CHECK-IR-NOT: call {{.*}}@klee_overshift_check
+
+  // CHECK: completed paths = 1
+  // CHECK: partially completed paths = 2
+  return quotient + shifted;
+}
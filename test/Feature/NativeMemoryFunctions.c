@@ -0,0 +1,57 @@
+// RUN: %clang %s -emit-llvm %O0opt -c -g -o %t1.bc
+// RUN: rm -rf %t.klee-out %t.klee-out-off
+// RUN: %klee --output-dir=%t.klee-out --libc=klee %t1.bc 2>&1 | FileCheck %s
+// RUN: %klee --output-dir=%t.klee-out-off --libc=klee --native-memory-functions=false %t1.bc 2>&1 | FileCheck %s
+
+// CHECK-NOT: ASSERTION FAIL
+// CHECK: KLEE: done: completed paths = 2
+
+#include "klee/klee.h"
+
+#include <assert.h>
+#include <string.h>
+
+int g = 5;
+
+struct S {
+  int *p;
+  char c[12];
+  int *q;
+};
+
+int main(int argc, char **argv) {
+  char a[256], b[256], s[8];
+  for (int i = 0; i < 256; ++i)
+    a[i] = i;
+  klee_make_symbolic(s, sizeof(s), "s");
+
+  // symbolic bytes are copied along with the concrete ones
+  memcpy(a + 100, s, sizeof(s));
+  memcpy(b, a, sizeof(a));
+  assert(b[50] == 50 && b[103] == s[3]);
+
+  // overlapping moves in both directions
+  memmove(b + 1, b, 200);
+  assert(b[50] == 49 && b[104] == s[3]);
+  memmove(b, b + 1, 200);
+  assert(b[103] == s[3]);
+
+  memset(b, s[0], 16);
+  assert(b[7] == s[0]);
+  memset(b, 7, 16);
+  assert(b[7] == 7);
+
+  assert(memcmp(a, a + 1, 4) < 0);
+  assert(memcmp(a + 201, b + 201, 50) == 0);
+
+  // pointers keep their objects, also at unaligned offsets
+  struct S x = {&g, "hello", &g}, y;
+  char buf[sizeof(x) + 3];
+  memcpy(buf + 3, &x, sizeof(x));
+  memcpy(&y, buf + 3, sizeof(y));
+  assert(*y.p == 5 && *y.q == 5 && y.c[1] == 'e');
+
+  if (s[0] == 'x')
+    return 1;
+  return 0;
+}
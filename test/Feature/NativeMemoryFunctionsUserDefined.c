@@ -0,0 +1,17 @@
+// RUN: %clang %s -emit-llvm %O0opt -c -g -o %t1.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out %t1.bc 2>&1 | FileCheck %s
+
+// The program's own strlen runs instead of the fast path of the libc one,
+// so its read past the end of the array is found.
+// CHECK: memory error: out of bound pointer
+// CHECK: KLEE: done: completed paths = 0
+// CHECK: KLEE: done: partially completed paths = 1
+
+#include <stddef.h>
+
+char ab[3] = "ab";
+
+size_t strlen(const char *s) { return s[3] ? 4 : 3; }
+
+int main(void) { return strlen(ab) == 3; }
@@ -0,0 +1,36 @@
+// RUN: %clang %s -emit-llvm %O0opt -c -g -o %t1.bc
+// RUN: rm -rf %t.klee-out %t.klee-out-off
+// RUN: %klee --output-dir=%t.klee-out --libc=klee %t1.bc 2>&1 | FileCheck %s
+// RUN: %klee --output-dir=%t.klee-out-off --libc=klee --native-memory-functions=false %t1.bc 2>&1 | FileCheck %s
+
+// CHECK-NOT: ASSERTION FAIL
+// CHECK: KLEE: done: completed paths = 4
+
+#include "klee/klee.h"
+
+#include <assert.h>
+#include <string.h>
+
+int main(int argc, char **argv) {
+  const char *hello = "hello";
+  assert(strlen(hello) == 5);
+  assert(strcmp(hello, "help") < 0);
+  assert(strcmp(hello, "hello") == 0);
+  assert(strcmp("b", "a") > 0);
+  assert(strchr(hello, 'l') == hello + 2);
+  assert(strchr(hello, 'z') == 0);
+  assert(strchr(hello, '\0') == hello + 5);
+
+  char buf[8];
+  memset(buf, 1, sizeof(buf));
+  strncpy(buf, hello, sizeof(buf));
+  assert(buf[5] == 0 && buf[7] == 0 && strcmp(buf, hello) == 0);
+  strncpy(buf, "truncated", 4);
+  assert(buf[3] == 'n' && buf[4] == 'o');
+
+  // a symbolic byte before the end forks as in the definition
+  char s[4];
+  klee_make_symbolic(s, sizeof(s), "s");
+  s[3] = 0;
+  return strlen(s);
+}
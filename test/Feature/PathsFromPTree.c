@@ -0,0 +1,27 @@
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out %t.ptree-out
+// RUN: %klee --output-dir=%t.klee-out --search=dfs --write-paths --write-sym-paths %t.bc
+// RUN: %klee --output-dir=%t.ptree-out --search=dfs --write-paths --write-sym-paths --paths-from-ptree --compress-process-tree %t.bc
+// RUN: cat %t.klee-out/*.path > %t.streams
+// RUN: cat %t.ptree-out/*.path > %t.ptree
+// RUN: diff %t.streams %t.ptree
+// RUN: not test -s %t.ptree-out/paths.ts
+
+// The paths rebuilt from the process tree are those of the streams.
+#include "klee/klee.h"
+
+int main(void) {
+  int x, res = 1;
+  klee_make_symbolic(&x, sizeof x, "x");
+
+  if (x & 1)
+    res *= 2;
+  if (x & 2)
+    res *= 3;
+  // a decision that does not fork
+  if (x & 1)
+    res *= 5;
+  if (x & 4)
+    res *= 7;
+  return res;
+}
@@ -0,0 +1,23 @@
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out %t.bc 2>&1 | FileCheck %s
+
+// CHECK-NOT: ASSERTION FAIL
+// CHECK: KLEE: done: completed paths = 2
+
+#include "klee/klee.h"
+
+#include <assert.h>
+
+int main(void) {
+  int a[4], b[4];
+  // the objects do not overlap, so the order of their first elements
+  // decides the order of all their elements
+  for (unsigned i = 0; i < 4; ++i) {
+    if (&a[0] < &b[0])
+      assert(&a[i] < &b[0]);
+    else
+      assert(&a[i] > &b[3]);
+  }
+  return 0;
+}
@@ -0,0 +1,46 @@
+; RUN: %llvmas %s -f -o %t1.bc
+; RUN: rm -rf %t.klee-out %t.klee-out-workers
+; RUN: %klee --output-dir=%t.klee-out %t1.bc 2>&1 | FileCheck %s
+; RUN: %klee --output-dir=%t.klee-out-workers --prefix-workers=2 %t1.bc 2>&1 | FileCheck %s
+; RUN: ls %t.klee-out-workers | grep .ktest | wc -l | grep 64
+
+; The workers explore the subtrees below the prefixes of fork choices they
+; are handed, which cover the same 64 paths as a single process.
+; CHECK: completed paths = 64
+; CHECK: generated tests = 64
+target datalayout = "e-m:e-p270:32:32-p271:32:32-p272:64:64-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-pc-linux-gnu"
+
+declare void @klee_make_symbolic(i8*, i64, i8*)
+@.name = private constant [2 x i8] c"x\00"
+@count = global i32 0
+
+define i32 @main() {
+entry:
+  %x = alloca [6 x i32]
+  %p = bitcast [6 x i32]* %x to i8*
+  call void @klee_make_symbolic(i8* %p, i64 24, i8* getelementptr ([2 x i8], [2 x i8]* @.name, i64 0, i64 0))
+  br label %loop
+
+loop:
+  %i = phi i64 [0, %entry], [%in, %next]
+  %n = phi i32 [0, %entry], [%n2, %next]
+  %ep = getelementptr [6 x i32], [6 x i32]* %x, i64 0, i64 %i
+  %v = load i32, i32* %ep
+  %c = icmp sgt i32 %v, 10
+  br i1 %c, label %inc, label %next
+
+inc:
+  %n1 = add i32 %n, 1
+  store volatile i32 %n1, i32* @count
+  br label %next
+
+next:
+  %n2 = phi i32 [%n, %loop], [%n1, %inc]
+  %in = add i64 %i, 1
+  %e = icmp eq i64 %in, 6
+  br i1 %e, label %done, label %loop
+
+done:
+  ret i32 %n2
+}
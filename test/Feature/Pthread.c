@@ -0,0 +1,83 @@
+// RUN: %clang %s -emit-llvm -g %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out %t.bc 2>&1 | FileCheck --check-prefix=CHECK-RACE %s
+// RUN: %clang %s -DLOCKED -emit-llvm -g %O0opt -c -o %t.locked.bc
+// RUN: rm -rf %t.locked-out
+// RUN: %klee --output-dir=%t.locked-out %t.locked.bc 2>&1 | FileCheck --check-prefix=CHECK-LOCKED %s
+// RUN: %clang %s -DDEADLOCK -emit-llvm -g %O0opt -c -o %t.deadlock.bc
+// RUN: rm -rf %t.deadlock-out
+// RUN: %klee --output-dir=%t.deadlock-out %t.deadlock.bc 2>&1 | FileCheck --check-prefix=CHECK-DEADLOCK %s
+// RUN: test -f %t.deadlock-out/test000001.deadlock.err
+// RUN: %clang %s -DESCAPE -emit-llvm -g %O0opt -c -o %t.escape.bc
+// RUN: rm -rf %t.escape-out
+// RUN: %klee --output-dir=%t.escape-out %t.escape.bc 2>&1 | FileCheck --check-prefix=CHECK-ESCAPE %s
+
+// The threads are interleaved at their accesses to shared memory and at
+// their synchronization, so that the lost update is found, and locking
+// prevents it. A stack object whose address escapes through a global is
+// shared as well.
+#include <assert.h>
+#include <pthread.h>
+
+static int counter;
+static pthread_mutex_t first = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t second = PTHREAD_MUTEX_INITIALIZER;
+
+static void *increment(void *arg) {
+#ifdef LOCKED
+  pthread_mutex_lock(&first);
+#endif
+  counter = counter + 1;
+#ifdef LOCKED
+  pthread_mutex_unlock(&first);
+#endif
+  return arg;
+}
+
+static int *escaped;
+
+static void *incrementEscaped(void *arg) {
+  *escaped = *escaped + 1;
+  return arg;
+}
+
+static void *reversed(void *arg) {
+  pthread_mutex_lock(&second);
+  pthread_mutex_lock(&first);
+  pthread_mutex_unlock(&first);
+  pthread_mutex_unlock(&second);
+  return arg;
+}
+
+int main(void) {
+  pthread_t a, b;
+#ifdef DEADLOCK
+  pthread_create(&a, 0, reversed, 0);
+  pthread_mutex_lock(&first);
+  pthread_mutex_lock(&second);
+  pthread_mutex_unlock(&second);
+  pthread_mutex_unlock(&first);
+  pthread_join(a, 0);
+#elif defined(ESCAPE)
+  int local = 0;
+  escaped = &local;
+  pthread_create(&a, 0, incrementEscaped, 0);
+  pthread_create(&b, 0, incrementEscaped, 0);
+  pthread_join(a, 0);
+  pthread_join(b, 0);
+  assert(local == 2);
+#else
+  pthread_create(&a, 0, increment, 0);
+  pthread_create(&b, 0, increment, 0);
+  pthread_join(a, 0);
+  pthread_join(b, 0);
+  assert(counter == 2);
+#endif
+  return 0;
+}
+
+// CHECK-RACE: ASSERTION FAIL: counter == 2
+// CHECK-LOCKED-NOT: ASSERTION FAIL
+// CHECK-LOCKED: KLEE: done: completed paths
+// CHECK-DEADLOCK: deadlock: no thread can run
+// CHECK-ESCAPE: ASSERTION FAIL: local == 2
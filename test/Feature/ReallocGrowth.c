@@ -0,0 +1,39 @@
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t1.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --exit-on-error %t1.bc 2>&1 | FileCheck %s
+
+// A buffer grown past the paged object threshold keeps its contents, also
+// in the states forked while it grew, and its symbolic bytes.
+#include "klee/klee.h"
+
+#include <assert.h>
+#include <stdlib.h>
+
+int main(void) {
+  unsigned char x;
+  klee_make_symbolic(&x, sizeof(x), "x");
+
+  size_t capacity = 16;
+  unsigned char *buffer = malloc(capacity);
+  buffer[0] = x;
+  for (size_t n = 1; n < 300000; ++n) {
+    if (n == capacity) {
+      capacity *= 2;
+      buffer = realloc(buffer, capacity);
+      assert(buffer);
+    }
+    buffer[n] = n & 0xff;
+    if (n == 1000 && x == 7)
+      klee_warning("forked");
+  }
+
+  assert(buffer[999] == (999 & 0xff));
+  assert(buffer[299999] == (299999 & 0xff));
+  if (buffer[0] == 7)
+    assert(x == 7);
+  free(buffer);
+  return 0;
+}
+
+// CHECK: forked
+// CHECK: KLEE: done: completed paths = 2
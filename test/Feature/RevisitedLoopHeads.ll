@@ -0,0 +1,45 @@
+; RUN: %llvmas %s -f -o %t1.bc
+; RUN: rm -rf %t.klee-out
+; RUN: %klee --output-dir=%t.klee-out --revisited-loop-heads=prune %t1.bc 2>&1 | FileCheck %s
+; RUN: rm -rf %t.klee-out-report
+; RUN: %klee --output-dir=%t.klee-out-report --revisited-loop-heads=report %t1.bc 2>&1 | FileCheck --check-prefix=CHECK-REPORT %s
+; RUN: ls %t.klee-out-report | FileCheck --check-prefix=CHECK-FILES %s
+
+; For x in [1, 10] the loop counts x down to 0, for x > 10 it spins without
+; changing the state, which is noticed at the loop head.
+; CHECK: completed paths = 11
+; CHECK: partially completed paths = 1
+; CHECK-REPORT: ERROR: {{.*}} non-termination: a loop head is reached again in the same state
+; CHECK-REPORT: completed paths = 11
+; CHECK-FILES: .nontermination.err
+target datalayout = "e-m:e-p270:32:32-p271:32:32-p272:64:64-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-pc-linux-gnu"
+
+declare void @klee_make_symbolic(i8*, i64, i8*)
+declare void @__INSTR_check_nontermination_header()
+@.name = private constant [2 x i8] c"x\00"
+@x = global i32 0
+
+define i32 @main() {
+entry:
+  call void @klee_make_symbolic(i8* bitcast (i32* @x to i8*), i64 4, i8* getelementptr ([2 x i8], [2 x i8]* @.name, i64 0, i64 0))
+  br label %loop
+
+loop:
+  call void @__INSTR_check_nontermination_header()
+  %i = load i32, i32* @x
+  %c = icmp sgt i32 %i, 0
+  br i1 %c, label %body, label %exit
+
+body:
+  %big = icmp sgt i32 %i, 10
+  br i1 %big, label %loop, label %dec
+
+dec:
+  %d = sub i32 %i, 1
+  store i32 %d, i32* @x
+  br label %loop
+
+exit:
+  ret i32 0
+}
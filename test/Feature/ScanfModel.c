@@ -0,0 +1,37 @@
+// RUN: %clang %s -emit-llvm -g %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out %t.bc 2>&1 | FileCheck %s
+
+// The conversions of a format store nondet values of their width, the
+// arguments without one are left alone and the result counts the
+// conversions.
+#include "klee/klee.h"
+
+#include <assert.h>
+#include <stdio.h>
+
+int main(void) {
+  int x = 7, unused = 42;
+  signed char c;
+  long l;
+  char buf[8] = "abcdefg";
+  char other[4] = "xyz";
+
+  int ret = scanf("%d %hhd%*d %s", &x, &c, buf, &unused);
+  assert(ret >= EOF && ret <= 3);
+  assert(unused == 42 && other[0] == 'x');
+  if (ret == 3 && x == -5 && c == 100 && buf[0] == 'h')
+    klee_warning("parsed");
+
+  ret = sscanf(other, "%ld%n", &l, &x);
+  assert(ret >= EOF && ret <= 1);
+  if (l == 1L << 40)
+    klee_warning("long");
+  return 0;
+}
+
+// CHECK-NOT: ASSERTION FAIL
+// CHECK: parsed
+// CHECK-NOT: ASSERTION FAIL
+// CHECK: long
+// CHECK-NOT: ASSERTION FAIL
@@ -0,0 +1,38 @@
+// RUN: %clang %s -emit-llvm -g %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out %t.bc 2>&1 | FileCheck %s
+
+// States forked deep in a recursion share the frames of the callers and
+// each keeps its own locals once it writes them after returning.
+#include "klee/klee.h"
+
+#include <assert.h>
+
+static int descend(int x, int depth, int *trail) {
+  int local = depth * 10;
+  if (depth == 0) {
+    if (x & 4) {
+      klee_warning("forked at the bottom");
+      return 1;
+    }
+    return 2;
+  }
+  int r = descend(x, depth - 1, trail);
+  local += r;
+  trail[depth] = local;
+  return local;
+}
+
+int main(void) {
+  int x, trail[6] = {0};
+  klee_make_symbolic(&x, sizeof(x), "x");
+  int r = descend(x, 5, trail);
+  int bottom = (x & 4) ? 1 : 2;
+  assert(r == 150 + bottom);
+  assert(trail[1] == 10 + bottom && trail[5] == r);
+  return 0;
+}
+
+// CHECK: forked at the bottom
+// CHECK-NOT: ASSERTION FAIL
+// CHECK: KLEE: done: completed paths = 2
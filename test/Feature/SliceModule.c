@@ -0,0 +1,42 @@
+// RUN: %clang %s -emit-llvm -g %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --error-fn=reach_error %t.bc 2>&1 | FileCheck --check-prefix=CHECK-FULL %s
+// RUN: rm -rf %t.sliced-out
+// RUN: %klee --output-dir=%t.sliced-out --error-fn=reach_error --slice-module %t.bc 2>&1 | FileCheck --check-prefix=CHECK-SLICED %s
+
+// The branch on a, which cannot influence whether reach_error is called,
+// is removed with what depends on it, so the paths are not forked on it.
+#include "klee/klee.h"
+
+#include <stdio.h>
+
+void reach_error(void) {}
+
+static int sign(int v) {
+  if (v > 0)
+    return 1;
+  return -1;
+}
+
+int main(void) {
+  int a, b;
+  klee_make_symbolic(&a, sizeof(a), "a");
+  klee_make_symbolic(&b, sizeof(b), "b");
+
+  int counter = 0;
+  if (a > 0)
+    counter++;
+  else
+    counter--;
+  printf("%d\n", counter + sign(a));
+
+  if (b == 42)
+    reach_error();
+  return 0;
+}
+
+// CHECK-FULL: ASSERTION FAIL: reach_error called
+// CHECK-FULL: KLEE: done: completed paths = 2
+// CHECK-SLICED: Slicing removed {{[1-9][0-9]*}} of
+// CHECK-SLICED: ASSERTION FAIL: reach_error called
+// CHECK-SLICED: KLEE: done: completed paths = 1
@@ -0,0 +1,70 @@
+; RUN: %llvmas %s -f -o %t1.bc
+; RUN: rm -rf %t.klee-out %t.klee-out-swap %t.klee-out-kill
+; RUN: %klee --output-dir=%t.klee-out %t1.bc 2>&1 | FileCheck %s
+; RUN: %klee --output-dir=%t.klee-out-swap --max-memory=1 --max-memory-inhibit=false --state-swap %t1.bc 2>&1 | FileCheck --check-prefix=CHECK-SWAP %s
+; RUN: ls %t.klee-out-swap | grep .ktest | wc -l | grep 64
+; RUN: %klee --output-dir=%t.klee-out-kill --max-memory=1 --max-memory-inhibit=false %t1.bc 2>&1 | FileCheck --check-prefix=CHECK-KILL %s
+
+; Every state fills a buffer per level with a symbolic byte, which takes the
+; run far over the memory cap. The states swapped out are rebuilt later and
+; complete the same 64 paths as a run without a cap, where without
+; --state-swap they are killed.
+; CHECK: completed paths = 64
+; CHECK: generated tests = 64
+; CHECK-SWAP: swapping out
+; CHECK-SWAP: completed paths = 64
+; CHECK-SWAP: generated tests = 64
+; CHECK-KILL: killing
+; CHECK-KILL: completed paths = 0
+target datalayout = "e-m:e-p270:32:32-p271:32:32-p272:64:64-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-pc-linux-gnu"
+
+declare void @klee_make_symbolic(i8*, i64, i8*)
+declare i8* @malloc(i64)
+declare void @llvm.memset.p0i8.i64(i8*, i8, i64, i1)
+@.name = private constant [2 x i8] c"x\00"
+@count = global i32 0
+
+define i32 @main() {
+entry:
+  %x = alloca [6 x i32]
+  %p = bitcast [6 x i32]* %x to i8*
+  call void @klee_make_symbolic(i8* %p, i64 24, i8* getelementptr ([2 x i8], [2 x i8]* @.name, i64 0, i64 0))
+  br label %loop
+
+loop:
+  %i = phi i64 [0, %entry], [%in, %after]
+  %n = phi i32 [0, %entry], [%n2, %after]
+  %ep = getelementptr [6 x i32], [6 x i32]* %x, i64 0, i64 %i
+  %v = load i32, i32* %ep
+  %c = icmp sgt i32 %v, 10
+  br i1 %c, label %inc, label %next
+
+inc:
+  %n1 = add i32 %n, 1
+  store volatile i32 %n1, i32* @count
+  br label %next
+
+next:
+  %n2 = phi i32 [%n, %loop], [%n1, %inc]
+  %vb = trunc i32 %v to i8
+  %m = call i8* @malloc(i64 131072)
+  call void @llvm.memset.p0i8.i64(i8* %m, i8 %vb, i64 131072, i1 false)
+  br label %spin
+
+; enough instructions for the memory to be checked
+spin:
+  %j = phi i32 [0, %next], [%jn, %spin]
+  store volatile i32 %j, i32* @count
+  %jn = add i32 %j, 1
+  %je = icmp eq i32 %jn, 1000
+  br i1 %je, label %after, label %spin
+
+after:
+  %in = add i64 %i, 1
+  %e = icmp eq i64 %in, 6
+  br i1 %e, label %done, label %loop
+
+done:
+  ret i32 %n2
+}
@@ -0,0 +1,29 @@
+// RUN: %clang %s -emit-llvm -g %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out %t.bc 2>&1 | FileCheck %s
+// RUN: FileCheck --check-prefix=CHECK-INFO %s < %t.klee-out/info
+// RUN: rm -rf %t.off-out
+// RUN: %klee --output-dir=%t.off-out --static-bounds-checks=false %t.bc 2>&1 | FileCheck %s
+// RUN: FileCheck --check-prefix=CHECK-OFF %s < %t.off-out/info
+
+// The accesses at constant offsets into the array and the global skip
+// their bounds checks, the one past the end is still reported.
+#include "klee/klee.h"
+
+int g[4];
+
+int main(void) {
+  int a[4];
+  int x;
+  klee_make_symbolic(&x, sizeof(x), "x");
+  a[3] = x;
+  g[2] = a[3];
+  if (g[2] == 7)
+    a[x - 3] = 1;
+  return 0;
+}
+
+// CHECK: memory error: out of bound pointer
+// CHECK: KLEE: done: completed paths = 1
+// CHECK-INFO: bounds checks proven statically = {{[1-9][0-9]*}}
+// CHECK-OFF: bounds checks proven statically = 0
@@ -0,0 +1,125 @@
+; RUN: %llvmas %s -f -o %t1.bc
+; RUN: rm -rf %t.klee-out
+; RUN: %klee --output-dir=%t.klee-out --summarize-loops --entry-point=counting %t1.bc 2>&1 | FileCheck --check-prefix=CHECK-COUNTING %s
+; RUN: rm -rf %t.klee-out
+; RUN: %klee --output-dir=%t.klee-out --summarize-loops --entry-point=rotated %t1.bc 2>&1 | FileCheck --check-prefix=CHECK-ROTATED %s
+; RUN: rm -rf %t.klee-out
+; RUN: %klee --output-dir=%t.klee-out --summarize-loops --entry-point=countdown %t1.bc 2>&1 | FileCheck --check-prefix=CHECK-COUNTDOWN %s
+
+; Each loop runs up to a symbolic bound, which would fork on every
+; iteration. Summarized, the loops that are entered leave with the closed
+; form of their sums, which the checks after the loops compare with.
+target datalayout = "e-m:e-p270:32:32-p271:32:32-p272:64:64-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-pc-linux-gnu"
+
+declare void @klee_make_symbolic(i8*, i64, i8*)
+@.name = private constant [2 x i8] c"n\00"
+
+define i32 @symbolic() noinline {
+  %n.addr = alloca i32, align 4
+  %p = bitcast i32* %n.addr to i8*
+  call void @klee_make_symbolic(i8* %p, i64 4, i8* getelementptr ([2 x i8], [2 x i8]* @.name, i64 0, i64 0))
+  %n = load i32, i32* %n.addr, align 4
+  ret i32 %n
+}
+
+; for (i = 0, s = 0; i < n; i++) s += 3;
+; One path does not enter the loop, the other one is summarized.
+; CHECK-COUNTING-NOT: ERROR
+; CHECK-COUNTING: completed paths = 2
+define i32 @counting() {
+entry:
+  %n = call i32 @symbolic()
+  br label %header
+
+header:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %body ]
+  %s = phi i32 [ 0, %entry ], [ %s.next, %body ]
+  %c = icmp slt i32 %i, %n
+  br i1 %c, label %body, label %exit
+
+body:
+  %s.next = add i32 %s, 3
+  %i.next = add i32 %i, 1
+  br label %header
+
+exit:
+  %entered = icmp sgt i32 %n, 0
+  %n3 = mul i32 %n, 3
+  %expected = select i1 %entered, i32 %n3, i32 0
+  %ok = icmp eq i32 %s, %expected
+  br i1 %ok, label %done, label %error
+
+error:
+  %crash = load i32, i32* null
+  ret i32 %crash
+
+done:
+  ret i32 0
+}
+
+; if (n) { i = 0; s = 5; do { s -= 2; } while (++i < n); }
+; The loop tests the next value of the counter at its end. Besides the path
+; not entering it, one path runs the body once, the other one is summarized.
+; CHECK-ROTATED-NOT: ERROR
+; CHECK-ROTATED: completed paths = 3
+define i32 @rotated() {
+entry:
+  %n = call i32 @symbolic()
+  %guard = icmp ne i32 %n, 0
+  br i1 %guard, label %loop, label %done
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  %s = phi i64 [ 5, %entry ], [ %s.next, %loop ]
+  %s.next = sub i64 %s, 2
+  %i.next = add i32 %i, 1
+  %c = icmp ult i32 %i.next, %n
+  br i1 %c, label %loop, label %exit
+
+exit:
+  %s.exit = phi i64 [ %s.next, %loop ]
+  %n64 = zext i32 %n to i64
+  %n2 = mul i64 %n64, 2
+  %expected = sub i64 5, %n2
+  %ok = icmp eq i64 %s.exit, %expected
+  br i1 %ok, label %done, label %error
+
+error:
+  %crash = load i32, i32* null
+  ret i32 %crash
+
+done:
+  ret i32 0
+}
+
+; i = n; s = 7; do { s++; } while (--i != 0);
+; The loop runs n times (2^32 times for 0) and is summarized without a fork.
+; CHECK-COUNTDOWN-NOT: ERROR
+; CHECK-COUNTDOWN: completed paths = 1
+define i32 @countdown() {
+entry:
+  %n = call i32 @symbolic()
+  br label %loop
+
+loop:
+  %i = phi i32 [ %n, %entry ], [ %i.next, %loop ]
+  %s = phi i32 [ 7, %entry ], [ %s.next, %loop ]
+  %s.next = add i32 %s, 1
+  %i.next = add i32 %i, -1
+  %c = icmp ne i32 %i.next, 0
+  br i1 %c, label %loop, label %exit
+
+exit:
+  %s.exit = phi i32 [ %s.next, %loop ]
+  %expected = add i32 %n, 7
+  %ok = icmp eq i32 %s.exit, %expected
+  br i1 %ok, label %done, label %error
+
+error:
+  %crash = load i32, i32* null
+  ret i32 %crash
+
+done:
+  ret i32 0
+}
@@ -0,0 +1,33 @@
+// REQUIRES: z3
+// RUN: %clang %s -emit-llvm -g %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out -solver-backend=z3 --symbolic-floats %t.bc 2>&1 | FileCheck %s
+// RUN: rm -rf %t.concrete-out
+// RUN: %klee --output-dir=%t.concrete-out %t.bc 2>&1 | FileCheck --check-prefix=CHECK-CONCRETE %s
+
+// The branches on symbolic doubles and floats are explored rather than
+// concretizing the values they depend on.
+#include "klee/klee.h"
+
+#include <math.h>
+
+int main(void) {
+  double x;
+  float f;
+  klee_make_symbolic(&x, sizeof(x), "x");
+  klee_make_symbolic(&f, sizeof(f), "f");
+
+  if (x * 2.0 + 1.0 == 7.0)
+    klee_warning("x is three");
+  if (isnan(x))
+    klee_warning("x is not a number");
+  if ((int)f == -2 && fabsf(f) > 2.5f)
+    klee_warning("f rounds toward zero");
+  return 0;
+}
+
+// CHECK-DAG: x is three
+// CHECK-DAG: x is not a number
+// CHECK-DAG: f rounds toward zero
+// CHECK-CONCRETE-NOT: x is three
+// CHECK-CONCRETE: KLEE: done: completed paths = 1
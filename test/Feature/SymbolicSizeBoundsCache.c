@@ -0,0 +1,29 @@
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out %t.bc 2>&1 | FileCheck %s
+// RUN: FileCheck --input-file=%t.klee-out/info -check-prefix=CHECK-INFO %s
+
+// CHECK: KLEE: ERROR: {{.*}} memory error: out of bound pointer
+// CHECK: KLEE: done: completed paths = 2
+
+// accesses below the largest offset proven in bounds skip the solver
+// CHECK-INFO: bounds checks cached = {{[1-9][0-9]*}}
+
+#include "klee/klee.h"
+
+#include <stdlib.h>
+
+int main(void) {
+  size_t n;
+  klee_make_symbolic(&n, sizeof(n), "n");
+  if (n < 16 || n > 4096)
+    return 0;
+
+  char *p = malloc(n);
+  for (int round = 0; round < 10; ++round)
+    for (int i = 0; i < 16; ++i)
+      p[i] = round;
+  // may be out of bounds
+  p[20] = 1;
+  return 0;
+}
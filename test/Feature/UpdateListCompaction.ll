@@ -0,0 +1,51 @@
+; RUN: %llvmas %s -f -o %t1.bc
+; RUN: rm -rf %t.klee-out
+; RUN: %klee --output-dir=%t.klee-out --use-query-log=all:kquery --update-list-compaction-threshold=8 %t1.bc
+; RUN: FileCheck %s < %t.klee-out/all-queries.kquery
+
+; The loop writes every byte of %buf after a symbolic read created its
+; constant array, the branch after it reads a new array with the writes
+; folded in instead of an update list of 64 writes.
+; CHECK: array const_arr{{[0-9]+}}[64] : w32 -> w8 = [0 1 2 3 4 5 6 7
+; CHECK-NOT: 63=63
+target datalayout = "e-m:e-p270:32:32-p271:32:32-p272:64:64-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-pc-linux-gnu"
+
+declare void @klee_make_symbolic(i8*, i64, i8*)
+declare void @abort() noreturn
+@.name = private constant [2 x i8] c"i\00"
+
+define i32 @main() {
+entry:
+  %buf = alloca [64 x i8]
+  %ip = alloca i32
+  %ipc = bitcast i32* %ip to i8*
+  call void @klee_make_symbolic(i8* %ipc, i64 4, i8* getelementptr ([2 x i8], [2 x i8]* @.name, i64 0, i64 0))
+  %i = load i32, i32* %ip
+  %im = and i32 %i, 63
+  %ie = zext i32 %im to i64
+  %p = getelementptr [64 x i8], [64 x i8]* %buf, i64 0, i64 %ie
+  %before = load i8, i8* %p
+  br label %loop
+
+loop:
+  %k = phi i64 [ 0, %entry ], [ %k.next, %loop ]
+  %pk = getelementptr [64 x i8], [64 x i8]* %buf, i64 0, i64 %k
+  %kv = trunc i64 %k to i8
+  store i8 %kv, i8* %pk
+  %k.next = add i64 %k, 1
+  %more = icmp ult i64 %k.next, 64
+  br i1 %more, label %loop, label %done
+
+done:
+  %after = load i8, i8* %p
+  %hit = icmp eq i8 %after, 7
+  br i1 %hit, label %fail, label %exit
+
+fail:
+  call void @abort()
+  unreachable
+
+exit:
+  ret i32 0
+}
@@ -0,0 +1,41 @@
+// RUN: %clang -emit-llvm -g -c -o %t.bc %s
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --use-merge --debug-log-merge --search=dfs %t.bc 2>&1 | FileCheck %s
+
+// CHECK: open merge:
+// CHECK: close merge:
+// CHECK-NOT: ASSERTION FAIL
+
+// Memory that differs between the merged states holds the values of either
+// state, including the pointers, and memory that does not differ is kept.
+#include "klee/klee.h"
+
+#include <assert.h>
+
+static int values[5];
+static int targets[2];
+static int *pointer;
+static char untouched[4096] = {1};
+
+int main(void) {
+  int x;
+  klee_make_symbolic(&x, sizeof(x), "x");
+
+  klee_open_merge();
+  if (x == 1) {
+    values[1] = 5;
+    values[4] = x;
+    pointer = &targets[0];
+  } else {
+    values[1] = 6;
+    pointer = &targets[1];
+    targets[1] = 9;
+  }
+  klee_close_merge();
+
+  assert((values[1] == 5) == (x == 1));
+  assert(values[4] == (x == 1 ? 1 : 0));
+  assert(*pointer == (x == 1 ? 0 : 9));
+  assert(values[0] == 0 && untouched[0] == 1);
+  return 0;
+}
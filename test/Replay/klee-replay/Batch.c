@@ -0,0 +1,23 @@
+// REQUIRES: linux
+// RUN: rm -rf %t.out
+// RUN: mkdir -p %t.out
+// RUN: %ktest-gen --bout-file %t.out/normal.ktest normal
+// RUN: %ktest-gen --bout-file %t.out/crash.ktest crash
+// RUN: echo %t.out/normal.ktest > %t.out/list
+// RUN: echo %t.out/crash.ktest >> %t.out/list
+// RUN: %cc %s -O0 -o %t
+// RUN: %klee-replay --batch=%t.out/results %t %t.out/normal.ktest @%t.out/list 2> %t.out/out.txt
+// RUN: FileCheck --input-file=%t.out/results %s
+
+// CHECK: normal.ktest{{[[:space:]]}}NORMAL
+// CHECK-NEXT: normal.ktest{{[[:space:]]}}NORMAL
+// CHECK-NEXT: crash.ktest{{[[:space:]]}}CRASHED signal 6
+
+#include <stdlib.h>
+#include <string.h>
+
+int main(int argc, char **argv) {
+  if (argc == 2 && strcmp(argv[1], "crash") == 0)
+    abort();
+  return argc == 2 && strcmp(argv[1], "normal") == 0 ? 0 : 1;
+}
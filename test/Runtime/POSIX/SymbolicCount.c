@@ -0,0 +1,34 @@
+// REQUIRES: posix-runtime
+// RUN: %clang %s -emit-llvm %O0opt -c -g -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --posix-runtime --exit-on-error %t.bc --sym-files 1 4096 > %t.log
+
+// The bytes of symbolic files are copied natively, with a symbolic count
+// only up to the count.
+#include "klee/klee.h"
+
+#include <assert.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+int main(int argc, char **argv) {
+  char buf[16], back[16];
+  unsigned n = klee_range(1, sizeof(buf) + 1, "n");
+  int fd = open("A", O_RDWR);
+  assert(fd != -1);
+
+  memset(buf, 'x', sizeof(buf));
+  assert(read(fd, buf, n) == n);
+  if (n < sizeof(buf))
+    assert(buf[n] == 'x');
+
+  // written back to the start of the file
+  assert(lseek(fd, 0, SEEK_SET) == 0);
+  buf[0] = 'y';
+  assert(write(fd, buf, n) == n);
+  assert(lseek(fd, 0, SEEK_SET) == 0);
+  assert(read(fd, back, n) == n);
+  assert(back[0] == 'y' && back[n - 1] == buf[n - 1]);
+  return 0;
+}
@@ -8,6 +8,9 @@
 //===----------------------------------------------------------------------===//
 
 #include "klee/Config/Version.h"
+#include "klee/Config/config.h"
+#include "klee/Expr/ArrayCache.h"
+#include "klee/Expr/BinaryQueryLog.h"
 #include "klee/Expr/Constraints.h"
 #include "klee/Expr/Expr.h"
 #include "klee/Expr/ExprBuilder.h"
@@ -16,21 +19,39 @@
 #include "klee/Expr/ExprVisitor.h"
 #include "klee/Expr/Parser/Lexer.h"
 #include "klee/Expr/Parser/Parser.h"
+#include "klee/Expr/SMTLIBStreamPrinter.h"
 #include "klee/Solver/Common.h"
 #include "klee/Support/OptionCategories.h"
 #include "klee/Statistics/Statistics.h"
+#ifdef HAVE_ZLIB_H
+#include "klee/Support/CompressionStream.h"
+#endif
 #include "klee/Solver/Solver.h"
 #include "klee/Solver/SolverCmdLine.h"
 #include "klee/Solver/SolverImpl.h"
 #include "klee/Support/PrintVersion.h"
+#include "klee/System/Time.h"
 
 #include "llvm/ADT/StringExtras.h"
 #include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/JSON.h"
 #include "llvm/Support/ManagedStatic.h"
 #include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
 #include "llvm/Support/raw_ostream.h"
 
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <fcntl.h>
+#include <functional>
+#include <map>
+#include <memory>
 #include <sys/stat.h>
+#include <sys/wait.h>
 #include <unistd.h>
 
 
@@ -45,7 +66,14 @@ llvm::cl::opt<std::string> InputFile(llvm::cl::desc("<input query log>"),
                                      llvm::cl::Positional, llvm::cl::init("-"),
                                      llvm::cl::cat(klee::ExprCat));
 
-enum ToolActions { PrintTokens, PrintAST, PrintSMTLIBv2, Evaluate };
+enum ToolActions {
+  PrintTokens,
+  PrintAST,
+  PrintSMTLIBv2,
+  PrintBinary,
+  Evaluate,
+  Benchmark
+};
 
 static llvm::cl::opt<ToolActions> ToolAction(
     llvm::cl::desc("Tool actions:"), llvm::cl::init(Evaluate),
@@ -55,14 +83,21 @@ static llvm::cl::opt<ToolActions> ToolAction(
                                 "Print parsed input file as SMT-LIBv2 query."),
                      clEnumValN(PrintAST, "print-ast",
                                 "Print parsed AST nodes from the input file."),
+                     clEnumValN(PrintBinary, "print-binary",
+                                "Print the queries of the input file as a "
+                                "binary query log."),
                      clEnumValN(Evaluate, "evaluate",
-                                "Evaluate parsed AST nodes from the input file.")),
+                                "Evaluate parsed AST nodes from the input file."),
+                     clEnumValN(Benchmark, "benchmark",
+                                "Replay the queries of the input file through "
+                                "solver chains and profile their layers.")),
     llvm::cl::cat(klee::SolvingCat));
 
 enum BuilderKinds {
   DefaultBuilder,
   ConstantFoldingBuilder,
-  SimplifyingBuilder
+  SimplifyingBuilder,
+  RewritingBuilder
 };
 
 static llvm::cl::opt<BuilderKinds> BuilderKind(
@@ -73,7 +108,9 @@ static llvm::cl::opt<BuilderKinds> BuilderKind(
                      clEnumValN(ConstantFoldingBuilder, "constant-folding",
                                 "Fold constant expressions."),
                      clEnumValN(SimplifyingBuilder, "simplify",
-                                "Fold constants and simplify expressions.")),
+                                "Fold constants and simplify expressions."),
+                     clEnumValN(RewritingBuilder, "rewrite",
+                                "Fold constants and apply rewrite rules.")),
     llvm::cl::cat(klee::ExprCat));
 
 llvm::cl::opt<std::string> DirectoryToWriteQueryLogs(
@@ -87,8 +124,49 @@ llvm::cl::opt<bool> ClearArrayAfterQuery(
     llvm::cl::desc("Discard the previous array declarations after a query "
                    "is performed (default=false)"),
     llvm::cl::init(false), llvm::cl::cat(klee::ExprCat));
+
+llvm::cl::opt<unsigned> Jobs(
+    "j",
+    llvm::cl::desc("Evaluate the query logs of the input directory, or the "
+                   "input log, in up to this many processes with a solver "
+                   "chain each, and write the result of each query to "
+                   "--results. Each query times out after --max-solver-time "
+                   "(default=0, batch mode only for a directory, in one "
+                   "process)"),
+    llvm::cl::init(0), llvm::cl::Prefix, llvm::cl::cat(klee::SolvingCat));
+
+llvm::cl::opt<std::string> ResultsFile(
+    "results",
+    llvm::cl::desc("The file to write the results of batch mode to "
+                   "(default=stdout)"),
+    llvm::cl::init("-"), llvm::cl::cat(klee::SolvingCat));
+
+enum ResultsFormats { CSVResults, JSONResults };
+
+llvm::cl::opt<ResultsFormats> ResultsFormat(
+    "results-format",
+    llvm::cl::desc("The format of the results of batch mode:"),
+    llvm::cl::values(clEnumValN(CSVResults, "csv",
+                                "A line per query (default)"),
+                     clEnumValN(JSONResults, "json",
+                                "An array with an object per query")),
+    llvm::cl::init(CSVResults), llvm::cl::cat(klee::SolvingCat));
+
+llvm::cl::list<std::string> BenchmarkChains(
+    "benchmark-chain",
+    llvm::cl::desc("A solver chain for --benchmark to replay the queries "
+                   "through: the '+'-separated layers in front of the core "
+                   "solver out of fast-cex, cex-cache, branch-cache, "
+                   "canonicalize, independent, known-model and segment, "
+                   "stacked in the usual order, or none. Can be given more "
+                   "than once (default=the chain of the solver options)"),
+    llvm::cl::cat(klee::SolvingCat));
 } // namespace
 
+/// The prefix of the names of the query logs written, which keeps those of
+/// the workers of batch mode apart.
+static std::string QueryLogPrefix;
+
 static std::string getQueryLogPath(const char filename[])
 {
 	//check directoryToWriteLogs exists
@@ -115,6 +193,7 @@ static std::string getQueryLogPath(const char filename[])
 
 	std::string path = DirectoryToWriteQueryLogs;
 	path += "/";
+	path += QueryLogPrefix;
 	path += filename;
 	return path;
 }
@@ -137,6 +216,25 @@ static std::string escapedString(const char *start, unsigned length) {
   return s.str();
 }
 
+/// Replaces MB by its decompressed contents if it is a compressed query log,
+/// as written with -compress-query-log.
+static bool DecompressInput(const std::string &Name,
+                            std::unique_ptr<MemoryBuffer> &MB) {
+#ifdef HAVE_ZLIB_H
+  if (!isCompressedData(MB->getBuffer()))
+    return true;
+  std::string Error;
+  std::unique_ptr<MemoryBuffer> Data =
+      decompressData(MB->getBuffer(), MB->getBufferIdentifier(), Error);
+  if (!Data) {
+    llvm::errs() << Name << ": error: " << Error << "\n";
+    return false;
+  }
+  MB = std::move(Data);
+#endif
+  return true;
+}
+
 static void PrintInputTokens(const MemoryBuffer *MB) {
   Lexer L(MB);
   Token T;
@@ -148,9 +246,64 @@ static void PrintInputTokens(const MemoryBuffer *MB) {
   } while (T.kind != Token::EndOfFile);
 }
 
+/// Calls Process on each query of a binary query log, as a query command,
+/// with the comment logged with it. The arrays of the queries are owned by
+/// Arrays.
+static bool ForEachBinaryQuery(
+    const char *Filename, const MemoryBuffer *MB, ExprBuilder *Builder,
+    ArrayCache &Arrays,
+    const std::function<void(QueryCommand &, const std::string &)> &Process) {
+  BinaryQueryLogReader Reader(*MB, Arrays, Builder);
+  std::string Error;
+  if (!Reader.open(Error)) {
+    llvm::errs() << Filename << ": error: " << Error << "\n";
+    return false;
+  }
+
+  LoggedQuery Q;
+  for (uint64_t i = 0, e = Reader.getNumQueries(); i != e; ++i) {
+    if (!Reader.readQuery(i, Q, Error)) {
+      llvm::errs() << Filename << ": error: " << Error << "\n";
+      return false;
+    }
+    QueryCommand QC(Q.constraints, Q.expr, Q.values, Q.objects);
+    Process(QC, Q.comment);
+  }
+  return true;
+}
+
+/// Prints a query command as the KQuery logging solver does, with the
+/// declarations of the arrays it reads.
+static void PrintQueryCommand(const QueryCommand &QC) {
+  const ExprHandle *ValuesBegin = 0, *ValuesEnd = 0;
+  const Array * const* ObjectsBegin = 0, * const* ObjectsEnd = 0;
+  if (!QC.Values.empty()) {
+    ValuesBegin = &QC.Values[0];
+    ValuesEnd = ValuesBegin + QC.Values.size();
+  }
+  if (!QC.Objects.empty()) {
+    ObjectsBegin = &QC.Objects[0];
+    ObjectsEnd = ObjectsBegin + QC.Objects.size();
+  }
+  ExprPPrinter::printQuery(llvm::outs(), ConstraintSet(QC.Constraints),
+                           QC.Query, ValuesBegin, ValuesEnd, ObjectsBegin,
+                           ObjectsEnd);
+}
+
 static bool PrintInputAST(const char *Filename,
                           const MemoryBuffer *MB,
                           ExprBuilder *Builder) {
+  if (BinaryQueryLogReader::isBinaryQueryLog(MB->getBuffer())) {
+    ArrayCache Arrays;
+    unsigned NumQueries = 0;
+    return ForEachBinaryQuery(
+        Filename, MB, Builder, Arrays,
+        [&NumQueries](QueryCommand &QC, const std::string &Comment) {
+          llvm::outs() << "# Query " << ++NumQueries << "\n" << Comment;
+          PrintQueryCommand(QC);
+        });
+  }
+
   std::vector<Decl*> Decls;
   Parser *P = Parser::Create(Filename, MB, Builder, ClearArrayAfterQuery);
   P->SetMaxErrors(20);
@@ -181,9 +334,165 @@ static bool PrintInputAST(const char *Filename,
   return success;
 }
 
+/// \return the result of a query that failed, for the results of batch mode
+static const char *FailureResult(Solver *S) {
+  return S->impl->getOperationStatusCode() ==
+                 SolverImpl::SOLVER_RUN_STATUS_TIMEOUT
+             ? "TIMEOUT"
+             : "FAIL";
+}
+
+/// Evaluates a query and prints its result to OS. \return VALID, INVALID,
+/// TIMEOUT or FAIL
+static const char *EvaluateQuery(Solver *S, unsigned Index,
+                                 const QueryCommand &QC,
+                                 llvm::raw_ostream &OS = llvm::outs()) {
+  const char *Result;
+  OS << "Query " << Index << ":\t";
+
+  assert("FIXME: Support counterexample query commands!");
+  if (QC.Values.empty() && QC.Objects.empty()) {
+    bool result;
+    if (S->mustBeTrue(Query(ConstraintSet(QC.Constraints), QC.Query),
+                      result)) {
+      Result = result ? "VALID" : "INVALID";
+      OS << Result;
+    } else {
+      Result = FailureResult(S);
+      OS << "FAIL (reason: "
+                << SolverImpl::getOperationStatusString(S->impl->getOperationStatusCode())
+                << ")";
+    }
+  } else if (!QC.Values.empty()) {
+    assert(QC.Objects.empty() && 
+           "FIXME: Support counterexamples for values and objects!");
+    assert(QC.Values.size() == 1 &&
+           "FIXME: Support counterexamples for multiple values!");
+    assert(QC.Query->isFalse() &&
+           "FIXME: Support counterexamples with non-trivial query!");
+    ref<ConstantExpr> result;
+    if (S->getValue(Query(ConstraintSet(QC.Constraints), QC.Values[0]),
+                    result)) {
+      Result = "INVALID";
+      OS << "INVALID\n";
+      OS << "\tExpr 0:\t" << result;
+    } else {
+      Result = FailureResult(S);
+      OS << "FAIL (reason: "
+                << SolverImpl::getOperationStatusString(S->impl->getOperationStatusCode())
+                << ")";
+    }
+  } else {
+    std::shared_ptr<const Assignment> result;
+
+    if (S->getInitialValues(
+            Query(ConstraintSet(QC.Constraints),
+                                  QC.Query),
+
+            result)) {
+      Result = "INVALID";
+      OS << "INVALID\n";
+
+      for (unsigned i = 0, e = QC.Objects.size(); i != e; ++i) {
+        OS << "\tArray " << i << ":\t"
+                   << QC.Objects[i]->name
+                   << "[";
+        for (unsigned j = 0; j != QC.Objects[i]->size; ++j) {
+          OS << (unsigned) result->getValue(QC.Objects[i], j);
+          if (j + 1 != QC.Objects[i]->size)
+            OS << ", ";
+        }
+        OS << "]";
+        if (i + 1 != e)
+          OS << "\n";
+      }
+    } else {
+      SolverImpl::SolverRunStatus retCode = S->impl->getOperationStatusCode();
+      if (SolverImpl::SOLVER_RUN_STATUS_TIMEOUT == retCode) {
+        Result = "TIMEOUT";
+        OS << " FAIL (reason: "
+                  << SolverImpl::getOperationStatusString(retCode)
+                  << ")";
+      }           
+      else {
+        Result = "VALID";
+        OS << "VALID (counterexample request ignored)";
+      }
+    }
+  }
+
+  OS << "\n";
+  return Result;
+}
+
+/// \param Profiles - if not null, receives the profiles of the layers of
+/// the chain, from the core solver up
+static Solver *CreateSolverChain(
+    std::deque<SolverLayerProfile> *Profiles = nullptr) {
+  Solver *coreSolver = klee::createCoreSolver(CoreSolverToUse);
+
+  if (CoreSolverToUse != DUMMY_SOLVER) {
+    const time::Span maxCoreSolverTime(MaxCoreSolverTime);
+    if (maxCoreSolverTime) {
+      coreSolver->setCoreSolverTimeout(maxCoreSolverTime);
+    }
+  }
+
+  return constructSolverChain(coreSolver,
+                              getQueryLogPath(ALL_QUERIES_SMT2_FILE_NAME),
+                              getQueryLogPath(SOLVER_QUERIES_SMT2_FILE_NAME),
+                              getQueryLogPath(ALL_QUERIES_KQUERY_FILE_NAME),
+                              getQueryLogPath(SOLVER_QUERIES_KQUERY_FILE_NAME),
+                              getQueryLogPath(ALL_QUERIES_BINARY_FILE_NAME),
+                              getQueryLogPath(SOLVER_QUERIES_BINARY_FILE_NAME),
+                              Profiles);
+}
+
+static void PrintQueryStatistics() {
+  if (uint64_t queries = *theStatisticManager->getStatisticByName("Queries")) {
+    llvm::outs()
+      << "--\n"
+      << "total queries = " << queries << '\n'
+      << "total query constructs = "
+      << *theStatisticManager->getStatisticByName("QueryConstructs") << '\n'
+      << "valid queries = " 
+      << *theStatisticManager->getStatisticByName("QueriesValid") << '\n'
+      << "invalid queries = " 
+      << *theStatisticManager->getStatisticByName("QueriesInvalid") << '\n'
+      << "query cex = " 
+      << *theStatisticManager->getStatisticByName("QueriesCEX") << '\n';
+  }
+}
+
+/// Called with the index, result and evaluation time of each query.
+typedef std::function<void(unsigned, const char *, time::Span)> ResultCallback;
+
+static void EvaluateQuery(Solver *S, unsigned Index, const QueryCommand &QC,
+                          const ResultCallback &OnResult) {
+  time::Point Start = time::getWallTime();
+  const char *Result = EvaluateQuery(S, Index, QC);
+  if (OnResult)
+    OnResult(Index, Result, time::getWallTime() - Start);
+}
+
 static bool EvaluateInputAST(const char *Filename,
                              const MemoryBuffer *MB,
-                             ExprBuilder *Builder) {
+                             ExprBuilder *Builder,
+                             const ResultCallback &OnResult = nullptr) {
+  if (BinaryQueryLogReader::isBinaryQueryLog(MB->getBuffer())) {
+    ArrayCache Arrays;
+    Solver *S = CreateSolverChain();
+    unsigned Index = 0;
+    bool success = ForEachBinaryQuery(
+        Filename, MB, Builder, Arrays,
+        [S, &Index, &OnResult](QueryCommand &QC, const std::string &) {
+          EvaluateQuery(S, Index++, QC, OnResult);
+        });
+    delete S;
+    PrintQueryStatistics();
+    return success;
+  }
+
   std::vector<Decl*> Decls;
   Parser *P = Parser::Create(Filename, MB, Builder, ClearArrayAfterQuery);
   P->SetMaxErrors(20);
@@ -200,95 +509,14 @@ static bool EvaluateInputAST(const char *Filename,
   if (!success)
     return false;
 
-  Solver *coreSolver = klee::createCoreSolver(CoreSolverToUse);
-
-  if (CoreSolverToUse != DUMMY_SOLVER) {
-    const time::Span maxCoreSolverTime(MaxCoreSolverTime);
-    if (maxCoreSolverTime) {
-      coreSolver->setCoreSolverTimeout(maxCoreSolverTime);
-    }
-  }
-
-  Solver *S = constructSolverChain(coreSolver,
-                                   getQueryLogPath(ALL_QUERIES_SMT2_FILE_NAME),
-                                   getQueryLogPath(SOLVER_QUERIES_SMT2_FILE_NAME),
-                                   getQueryLogPath(ALL_QUERIES_KQUERY_FILE_NAME),
-                                   getQueryLogPath(SOLVER_QUERIES_KQUERY_FILE_NAME));
+  Solver *S = CreateSolverChain();
 
   unsigned Index = 0;
   for (std::vector<Decl*>::iterator it = Decls.begin(),
          ie = Decls.end(); it != ie; ++it) {
     Decl *D = *it;
-    if (QueryCommand *QC = dyn_cast<QueryCommand>(D)) {
-      llvm::outs() << "Query " << Index << ":\t";
-
-      assert("FIXME: Support counterexample query commands!");
-      if (QC->Values.empty() && QC->Objects.empty()) {
-        bool result;
-        if (S->mustBeTrue(Query(ConstraintSet(QC->Constraints), QC->Query),
-                          result)) {
-          llvm::outs() << (result ? "VALID" : "INVALID");
-        } else {
-          llvm::outs() << "FAIL (reason: "
-                    << SolverImpl::getOperationStatusString(S->impl->getOperationStatusCode())
-                    << ")";
-        }
-      } else if (!QC->Values.empty()) {
-        assert(QC->Objects.empty() && 
-               "FIXME: Support counterexamples for values and objects!");
-        assert(QC->Values.size() == 1 &&
-               "FIXME: Support counterexamples for multiple values!");
-        assert(QC->Query->isFalse() &&
-               "FIXME: Support counterexamples with non-trivial query!");
-        ref<ConstantExpr> result;
-        if (S->getValue(Query(ConstraintSet(QC->Constraints), QC->Values[0]),
-                        result)) {
-          llvm::outs() << "INVALID\n";
-          llvm::outs() << "\tExpr 0:\t" << result;
-        } else {
-          llvm::outs() << "FAIL (reason: "
-                    << SolverImpl::getOperationStatusString(S->impl->getOperationStatusCode())
-                    << ")";
-        }
-      } else {
-        std::shared_ptr<const Assignment> result;
-
-        if (S->getInitialValues(
-                Query(ConstraintSet(QC->Constraints),
-                                      QC->Query),
-
-                result)) {
-          llvm::outs() << "INVALID\n";
-
-          for (unsigned i = 0, e = QC->Objects.size(); i != e; ++i) {
-            llvm::outs() << "\tArray " << i << ":\t"
-                       << QC->Objects[i]->name
-                       << "[";
-            for (unsigned j = 0; j != QC->Objects[i]->size; ++j) {
-              llvm::outs() << (unsigned) result->getValue(QC->Objects[i], j);
-              if (j + 1 != QC->Objects[i]->size)
-                llvm::outs() << ", ";
-            }
-            llvm::outs() << "]";
-            if (i + 1 != e)
-              llvm::outs() << "\n";
-          }
-        } else {
-          SolverImpl::SolverRunStatus retCode = S->impl->getOperationStatusCode();
-          if (SolverImpl::SOLVER_RUN_STATUS_TIMEOUT == retCode) {
-            llvm::outs() << " FAIL (reason: "
-                      << SolverImpl::getOperationStatusString(retCode)
-                      << ")";
-          }           
-          else {
-            llvm::outs() << "VALID (counterexample request ignored)";
-          }
-        }
-      }
-
-      llvm::outs() << "\n";
-      ++Index;
-    }
+    if (QueryCommand *QC = dyn_cast<QueryCommand>(D))
+      EvaluateQuery(S, Index++, *QC, OnResult);
   }
 
   for (std::vector<Decl*>::iterator it = Decls.begin(),
@@ -298,27 +526,64 @@ static bool EvaluateInputAST(const char *Filename,
 
   delete S;
 
-  if (uint64_t queries = *theStatisticManager->getStatisticByName("Queries")) {
-    llvm::outs()
-      << "--\n"
-      << "total queries = " << queries << '\n'
-      << "total query constructs = "
-      << *theStatisticManager->getStatisticByName("QueryConstructs") << '\n'
-      << "valid queries = " 
-      << *theStatisticManager->getStatisticByName("QueriesValid") << '\n'
-      << "invalid queries = " 
-      << *theStatisticManager->getStatisticByName("QueriesInvalid") << '\n'
-      << "query cex = " 
-      << *theStatisticManager->getStatisticByName("QueriesCEX") << '\n';
-  }
+  PrintQueryStatistics();
 
   return success;
 }
 
+/// Prints a query command with the printer chosen by -smtlib-printer.
+static void PrintSMTLIBQuery(const QueryCommand &QC, ExprSMTLIBPrinter &Printer,
+                             SMTLIBStreamPrinter &StreamPrinter) {
+  /* Can't pass ConstraintManager constructor directly
+   * as argument to Query object. Like...
+   * query(ConstraintManager(QC->Constraints),QC->Query);
+   *
+   * For some reason if constructed this way the first
+   * constraint in the constraint set is set to NULL and
+   * will later cause a NULL pointer dereference.
+   */
+  ConstraintSet constraintM(QC.Constraints);
+  Query query(constraintM, QC.Query);
+  if (SMTLIBPrinterToUse == CLASSIC_SMTLIB_PRINTER) {
+    Printer.setQuery(query);
+    if (!QC.Objects.empty())
+      Printer.setArrayValuesToGet(QC.Objects);
+    Printer.generateOutput();
+    return;
+  }
+
+  StreamPrinter.printQuery(query, QC.Objects.empty() ? nullptr : &QC.Objects);
+  StreamPrinter.flush(llvm::outs());
+}
+
 static bool printInputAsSMTLIBv2(const char *Filename,
                              const MemoryBuffer *MB,
                              ExprBuilder *Builder)
 {
+  SMTLIBStreamPrinter streamPrinter(SMTLIBPrinterToUse ==
+                                    INCREMENTAL_SMTLIB_PRINTER);
+
+  if (BinaryQueryLogReader::isBinaryQueryLog(MB->getBuffer())) {
+    ArrayCache Arrays;
+    ExprSMTLIBPrinter printer;
+    printer.setOutput(llvm::outs());
+    unsigned queryNumber = 0;
+    bool success = ForEachBinaryQuery(
+        Filename, MB, Builder, Arrays,
+        [&printer, &streamPrinter, &queryNumber](QueryCommand &QC,
+                                                 const std::string &) {
+          if (queryNumber != 0)
+            llvm::outs() << "\n";
+          llvm::outs() << ";SMTLIBv2 Query " << queryNumber++ << "\n";
+          PrintSMTLIBQuery(QC, printer, streamPrinter);
+        });
+    if (SMTLIBPrinterToUse == INCREMENTAL_SMTLIB_PRINTER) {
+      streamPrinter.printExit();
+      streamPrinter.flush(llvm::outs());
+    }
+    return success;
+  }
+
 	//Parse the input file
 	std::vector<Decl*> Decls;
         Parser *P = Parser::Create(Filename, MB, Builder, ClearArrayAfterQuery);
@@ -355,28 +620,18 @@ static bool printInputAsSMTLIBv2(const char *Filename,
 			//Output header for this query as a SMT-LIBv2 comment
 			llvm::outs() << ";SMTLIBv2 Query " << queryNumber << "\n";
 
-			/* Can't pass ConstraintManager constructor directly
-			 * as argument to Query object. Like...
-			 * query(ConstraintManager(QC->Constraints),QC->Query);
-			 *
-			 * For some reason if constructed this way the first
-			 * constraint in the constraint set is set to NULL and
-			 * will later cause a NULL pointer dereference.
-			 */
-                        ConstraintSet constraintM(QC->Constraints);
-                        Query query(constraintM, QC->Query);
-                        printer.setQuery(query);
-
-			if(!QC->Objects.empty())
-				printer.setArrayValuesToGet(QC->Objects);
-
-			printer.generateOutput();
+			PrintSMTLIBQuery(*QC, printer, streamPrinter);
 
 
 			queryNumber++;
 		}
 	}
 
+	if (SMTLIBPrinterToUse == INCREMENTAL_SMTLIB_PRINTER) {
+		streamPrinter.printExit();
+		streamPrinter.flush(llvm::outs());
+	}
+
 	//Clean up
 	for (std::vector<Decl*>::iterator it = Decls.begin(),
 			ie = Decls.end(); it != ie; ++it)
@@ -386,6 +641,433 @@ static bool printInputAsSMTLIBv2(const char *Filename,
 	return true;
 }
 
+/// Writes the queries of the input file as a binary query log, which also
+/// compacts a binary query log that was not closed.
+static bool PrintInputAsBinary(const char *Filename, const MemoryBuffer *MB,
+                               ExprBuilder *Builder) {
+  ArrayCache Arrays;
+  BinaryQueryLogWriter Writer(llvm::outs());
+  auto Write = [&Writer](QueryCommand &QC, const std::string &Comment) {
+    LoggedQuery Q;
+    Q.constraints = QC.Constraints;
+    Q.expr = QC.Query;
+    Q.values = QC.Values;
+    Q.objects = QC.Objects;
+    Q.comment = Comment;
+    Writer.writeQuery(Q);
+  };
+
+  if (BinaryQueryLogReader::isBinaryQueryLog(MB->getBuffer()))
+    return ForEachBinaryQuery(Filename, MB, Builder, Arrays, Write);
+
+  std::vector<Decl*> Decls;
+  Parser *P = Parser::Create(Filename, MB, Builder, ClearArrayAfterQuery);
+  P->SetMaxErrors(20);
+  while (Decl *D = P->ParseTopLevelDecl())
+    Decls.push_back(D);
+
+  bool success = true;
+  if (unsigned N = P->GetNumErrors()) {
+    llvm::errs() << Filename << ": parse failure: " << N << " errors.\n";
+    success = false;
+  } else {
+    for (Decl *D : Decls)
+      if (QueryCommand *QC = dyn_cast<QueryCommand>(D))
+        Write(*QC, "");
+  }
+
+  for (Decl *D : Decls)
+    delete D;
+  delete P;
+
+  return success;
+}
+
+namespace {
+/// The result of a query evaluated in batch mode. A log that could not be
+/// evaluated has a result ERROR, and one whose worker crashed has a result
+/// CRASH, with a Query of -1.
+struct BatchResult {
+  std::string File;
+  int Query;
+  std::string Result;
+  double Seconds;
+};
+} // namespace
+
+/// The layers of the solver chain a benchmark chain is composed of, with
+/// the options that enable them.
+static const struct {
+  const char *Name;
+  llvm::cl::opt<bool> *Option;
+} ChainLayers[] = {
+    {"fast-cex", &UseFastCexSolver},   {"cex-cache", &UseCexCache},
+    {"branch-cache", &UseBranchCache}, {"canonicalize", &CanonicalizeQueries},
+    {"independent", &UseIndependentSolver}, {"known-model", &UseKnownModel},
+    {"segment", &UseSegmentSolver},
+};
+
+/// Enables the layers of Chain, a '+'-separated list of layer names or
+/// "none", and disables the others. \return false for an unknown layer
+static bool SetChainLayers(llvm::StringRef Chain) {
+  for (auto &Layer : ChainLayers)
+    *Layer.Option = false;
+  if (Chain == "none")
+    return true;
+
+  llvm::SmallVector<llvm::StringRef, 8> Names;
+  Chain.split(Names, '+', -1, false);
+  for (llvm::StringRef Name : Names) {
+    auto Layer = std::find_if(
+        std::begin(ChainLayers), std::end(ChainLayers),
+        [Name](const decltype(ChainLayers[0]) &L) { return Name == L.Name; });
+    if (Layer == std::end(ChainLayers)) {
+      llvm::errs() << "error: Unknown solver chain layer '" << Name << "'!\n";
+      return false;
+    }
+    *Layer->Option = true;
+  }
+  return true;
+}
+
+/// Replays the queries in order through the solver chain set up by the
+/// current options and prints the profile of each layer.
+static void BenchmarkChain(llvm::StringRef Chain,
+                           const std::vector<const QueryCommand *> &Queries) {
+  std::deque<SolverLayerProfile> Profiles;
+  Solver *S = CreateSolverChain(&Profiles);
+
+  std::map<std::string, unsigned> Results;
+  time::Point Start = time::getWallTime();
+  for (unsigned i = 0, e = Queries.size(); i != e; ++i)
+    ++Results[EvaluateQuery(S, i, *Queries[i], llvm::nulls())];
+  time::Span Total = time::getWallTime() - Start;
+  delete S;
+
+  llvm::outs() << "Chain: " << Chain << "\n"
+               << "  queries = " << Queries.size() << ", total time = "
+               << llvm::format("%.6f", Total.toSeconds()) << "s\n"
+               << "  results =";
+  for (auto &Result : Results)
+    llvm::outs() << " " << Result.first << ":" << Result.second;
+  llvm::outs() << "\n"
+               << "  layer              queries      hits  hit rate    time (s)"
+                  "    self (s)  p50 (us)  p90 (us)  p99 (us)\n";
+  // outermost first, with the time of the layer below subtracted
+  for (auto it = Profiles.rbegin(), ie = Profiles.rend(); it != ie; ++it) {
+    const SolverLayerProfile &P = *it;
+    time::Span Self = P.time;
+    if (std::next(it) != ie)
+      Self -= std::next(it)->time;
+    double HitRate = P.queries ? 100.0 * P.hits / P.queries : 0.0;
+    llvm::outs() << llvm::format(
+        "  %-16s %9llu %9llu %8.1f%% %11.6f %11.6f %9llu %9llu %9llu\n",
+        P.name.c_str(), (unsigned long long)P.queries,
+        (unsigned long long)P.hits, HitRate, P.time.toSeconds(),
+        Self.toSeconds(), (unsigned long long)P.getLatencyQuantile(0.5),
+        (unsigned long long)P.getLatencyQuantile(0.9),
+        (unsigned long long)P.getLatencyQuantile(0.99));
+  }
+  // the histograms, as the queries below each power of two microseconds
+  for (auto it = Profiles.rbegin(), ie = Profiles.rend(); it != ie; ++it) {
+    llvm::outs() << llvm::format("  %-16s", it->name.c_str());
+    for (unsigned i = 0; i != SolverLayerProfile::NumBuckets; ++i)
+      if (it->latency[i])
+        llvm::outs() << " <" << (UINT64_C(1) << i) << "us:" << it->latency[i];
+    llvm::outs() << "\n";
+  }
+}
+
+/// Loads the queries of the input file once and replays them through each
+/// of the --benchmark-chain compositions.
+static bool BenchmarkInput(const char *Filename, const MemoryBuffer *MB,
+                           ExprBuilder *Builder) {
+  ArrayCache Arrays;
+  std::vector<std::unique_ptr<QueryCommand>> BinaryQueries;
+  std::vector<Decl *> Decls;
+  Parser *P = nullptr;
+  std::vector<const QueryCommand *> Queries;
+  bool success = true;
+
+  if (BinaryQueryLogReader::isBinaryQueryLog(MB->getBuffer())) {
+    success = ForEachBinaryQuery(
+        Filename, MB, Builder, Arrays,
+        [&BinaryQueries, &Queries](QueryCommand &QC, const std::string &) {
+          BinaryQueries.emplace_back(new QueryCommand(QC));
+          Queries.push_back(BinaryQueries.back().get());
+        });
+  } else {
+    P = Parser::Create(Filename, MB, Builder, ClearArrayAfterQuery);
+    P->SetMaxErrors(20);
+    while (Decl *D = P->ParseTopLevelDecl()) {
+      Decls.push_back(D);
+      if (QueryCommand *QC = dyn_cast<QueryCommand>(D))
+        Queries.push_back(QC);
+    }
+    if (unsigned N = P->GetNumErrors()) {
+      llvm::errs() << Filename << ": parse failure: " << N << " errors.\n";
+      success = false;
+    }
+  }
+
+  std::vector<bool> Enabled;
+  for (auto &Layer : ChainLayers)
+    Enabled.push_back(*Layer.Option);
+  // reject unknown layers before replaying any query
+  for (const std::string &Chain : BenchmarkChains)
+    success = success && SetChainLayers(Chain);
+
+  if (success) {
+    if (BenchmarkChains.empty()) {
+      std::string Chain;
+      for (auto &Layer : ChainLayers)
+        if (*Layer.Option)
+          Chain += (Chain.empty() ? "" : "+") + std::string(Layer.Name);
+      BenchmarkChain(Chain.empty() ? "none" : Chain, Queries);
+    }
+    for (const std::string &Chain : BenchmarkChains) {
+      SetChainLayers(Chain);
+      BenchmarkChain(Chain, Queries);
+    }
+  }
+  for (unsigned i = 0; i != Enabled.size(); ++i)
+    *ChainLayers[i].Option = Enabled[i];
+
+  for (Decl *D : Decls)
+    delete D;
+  delete P;
+  return success;
+}
+
+static const char *getBackendName() {
+  switch (CoreSolverToUse) {
+  case STP_SOLVER:
+    return "stp";
+  case METASMT_SOLVER:
+    return "metasmt";
+  case DUMMY_SOLVER:
+    return "dummy";
+  case Z3_SOLVER:
+    return "z3";
+  case BITWUZLA_SOLVER:
+    return "bitwuzla";
+  case PORTFOLIO_SOLVER:
+    return "portfolio";
+  default:
+    return "none";
+  }
+}
+
+/// Evaluates a query log in a worker process. The result of each query is
+/// appended to ResultsPath when it is known, so that the results survive a
+/// crash. \return the exit code of the worker
+static int EvaluateBatchLog(const std::string &File,
+                            const std::string &ResultsPath,
+                            ExprBuilder *Builder) {
+  // the workers only report through their results and errors
+  int Null = open("/dev/null", O_WRONLY);
+  if (Null >= 0) {
+    dup2(Null, STDOUT_FILENO);
+    close(Null);
+  }
+  QueryLogPrefix = llvm::sys::path::filename(File).str() + ".";
+
+  std::error_code EC;
+  llvm::raw_fd_ostream Results(ResultsPath, EC, llvm::sys::fs::OF_Text);
+  if (EC) {
+    llvm::errs() << ResultsPath << ": error: " << EC.message() << "\n";
+    return 1;
+  }
+  auto MBResult = MemoryBuffer::getFile(File, /*IsText=*/false,
+                                        /*RequiresNullTerminator=*/false);
+  if (!MBResult) {
+    llvm::errs() << File << ": error: " << MBResult.getError().message()
+                 << "\n";
+    return 1;
+  }
+  if (!DecompressInput(File, *MBResult))
+    return 1;
+
+  bool Success = EvaluateInputAST(
+      File.c_str(), MBResult->get(), Builder,
+      [&Results](unsigned Index, const char *Result, time::Span Elapsed) {
+        Results << Index << '\t' << Result << '\t'
+                << llvm::format("%f", Elapsed.toSeconds()) << '\n';
+        Results.flush();
+      });
+  return Success ? 0 : 1;
+}
+
+/// Reads the results a worker wrote for the queries of File.
+static void ReadBatchResults(const std::string &File,
+                             const std::string &ResultsPath,
+                             std::vector<BatchResult> &Results) {
+  auto MBResult = MemoryBuffer::getFile(ResultsPath, /*IsText=*/true);
+  if (!MBResult)
+    return;
+  llvm::SmallVector<llvm::StringRef, 64> Lines;
+  (*MBResult)->getBuffer().split(Lines, '\n', -1, false);
+  for (llvm::StringRef Line : Lines) {
+    llvm::SmallVector<llvm::StringRef, 3> Fields;
+    Line.split(Fields, '\t');
+    int Query;
+    double Seconds;
+    if (Fields.size() != 3 || Fields[0].getAsInteger(10, Query) ||
+        Fields[2].getAsDouble(Seconds))
+      continue;
+    Results.push_back({File, Query, Fields[1].str(), Seconds});
+  }
+}
+
+static std::string CSVField(llvm::StringRef Field) {
+  if (Field.find_first_of(",\"\n") == llvm::StringRef::npos)
+    return Field.str();
+  std::string Quoted = "\"";
+  for (char C : Field) {
+    if (C == '"')
+      Quoted += '"';
+    Quoted += C;
+  }
+  return Quoted + "\"";
+}
+
+static void WriteBatchResults(llvm::raw_ostream &OS,
+                              const std::vector<BatchResult> &Results) {
+  const char *Backend = getBackendName();
+  if (ResultsFormat == CSVResults) {
+    OS << "file,query,result,time,backend\n";
+    for (const BatchResult &R : Results) {
+      OS << CSVField(R.File) << ',';
+      if (R.Query >= 0)
+        OS << R.Query;
+      OS << ',' << R.Result << ',' << llvm::format("%f", R.Seconds) << ','
+         << Backend << '\n';
+    }
+    return;
+  }
+
+  llvm::json::OStream J(OS, 2);
+  J.array([&] {
+    for (const BatchResult &R : Results) {
+      J.object([&] {
+        J.attribute("file", R.File);
+        if (R.Query >= 0)
+          J.attribute("query", R.Query);
+        else
+          J.attribute("query", nullptr);
+        J.attribute("result", R.Result);
+        J.attribute("time", R.Seconds);
+        J.attribute("backend", Backend);
+      });
+    }
+  });
+  OS << '\n';
+}
+
+/// Evaluates the query logs in Files in up to Jobs worker processes, each
+/// with its own solver chain, and writes the result of each query in the
+/// order of Files.
+static bool EvaluateBatch(const std::vector<std::string> &Files,
+                          ExprBuilder *Builder) {
+  const size_t MaxWorkers = std::max(1u, Jobs.getValue());
+  std::vector<std::string> ResultsPaths(Files.size());
+  std::vector<std::vector<BatchResult>> Results(Files.size());
+  std::map<pid_t, size_t> Running;
+  size_t Next = 0;
+  bool Success = true;
+
+  // so that the workers do not flush what was buffered before
+  llvm::outs().flush();
+  llvm::errs().flush();
+  while (Next != Files.size() || !Running.empty()) {
+    if (Next != Files.size() && Running.size() < MaxWorkers) {
+      llvm::SmallString<128> Path;
+      if (std::error_code EC =
+              llvm::sys::fs::createTemporaryFile("kleaver", "results", Path)) {
+        llvm::errs() << "error: " << EC.message() << "\n";
+        return false;
+      }
+      ResultsPaths[Next] = Path.str().str();
+
+      pid_t Pid = fork();
+      if (Pid == 0) {
+        int Code = EvaluateBatchLog(Files[Next], ResultsPaths[Next], Builder);
+        llvm::outs().flush();
+        llvm::errs().flush();
+        _exit(Code);
+      }
+      if (Pid < 0) {
+        llvm::errs() << "error: fork failed: " << strerror(errno) << "\n";
+        return false;
+      }
+      Running[Pid] = Next++;
+      continue;
+    }
+
+    int Status;
+    pid_t Pid = waitpid(-1, &Status, 0);
+    if (Pid < 0) {
+      if (errno == EINTR)
+        continue;
+      llvm::errs() << "error: waitpid failed: " << strerror(errno) << "\n";
+      return false;
+    }
+    auto It = Running.find(Pid);
+    if (It == Running.end())
+      continue;
+    size_t I = It->second;
+    Running.erase(It);
+
+    ReadBatchResults(Files[I], ResultsPaths[I], Results[I]);
+    llvm::sys::fs::remove(ResultsPaths[I]);
+    if (WIFSIGNALED(Status)) {
+      Results[I].push_back({Files[I], -1, "CRASH", 0});
+      Success = false;
+    } else if (WEXITSTATUS(Status)) {
+      Results[I].push_back({Files[I], -1, "ERROR", 0});
+      Success = false;
+    }
+  }
+
+  std::vector<BatchResult> All;
+  std::map<std::string, unsigned> Counts;
+  for (const std::vector<BatchResult> &R : Results) {
+    for (const BatchResult &Q : R)
+      ++Counts[Q.Result];
+    All.insert(All.end(), R.begin(), R.end());
+  }
+
+  std::error_code EC;
+  llvm::raw_fd_ostream OS(ResultsFile, EC, llvm::sys::fs::OF_Text);
+  if (EC) {
+    llvm::errs() << ResultsFile << ": error: " << EC.message() << "\n";
+    return false;
+  }
+  WriteBatchResults(OS, All);
+
+  llvm::errs() << "Evaluated " << Files.size() << " query logs:";
+  for (const auto &C : Counts)
+    llvm::errs() << " " << C.first << " = " << C.second;
+  llvm::errs() << "\n";
+  return Success;
+}
+
+/// Collects the regular files of Directory, sorted by name.
+static bool GetQueryLogs(const std::string &Directory,
+                         std::vector<std::string> &Files) {
+  std::error_code EC;
+  for (llvm::sys::fs::directory_iterator It(Directory, EC), End;
+       It != End && !EC; It.increment(EC))
+    if (llvm::sys::fs::is_regular_file(It->path()))
+      Files.push_back(It->path());
+  if (EC) {
+    llvm::errs() << Directory << ": error: " << EC.message() << "\n";
+    return false;
+  }
+  std::sort(Files.begin(), Files.end());
+  return true;
+}
+
 int main(int argc, char **argv) {
 #if LLVM_VERSION_CODE >= LLVM_VERSION(13, 0)
   KCommandLine::HideOptions(llvm::cl::getGeneralCategory());
@@ -400,15 +1082,7 @@ int main(int argc, char **argv) {
   llvm::cl::ParseCommandLineOptions(argc, argv);
 
   std::string ErrorStr;
-  
-  auto MBResult = MemoryBuffer::getFileOrSTDIN(InputFile.c_str());
-  if (!MBResult) {
-    llvm::errs() << argv[0] << ": error: " << MBResult.getError().message()
-                 << "\n";
-    return 1;
-  }
-  std::unique_ptr<MemoryBuffer> &MB = *MBResult;
-  
+
   ExprBuilder *Builder = 0;
   switch (BuilderKind) {
   case DefaultBuilder:
@@ -423,10 +1097,55 @@ int main(int argc, char **argv) {
     Builder = createConstantFoldingExprBuilder(Builder);
     Builder = createSimplifyingExprBuilder(Builder);
     break;
+  case RewritingBuilder:
+    Builder = createDefaultExprBuilder();
+    Builder = createConstantFoldingExprBuilder(Builder);
+    Builder = createRewritingExprBuilder(Builder);
+    break;
+  }
+
+  bool IsDirectory = llvm::sys::fs::is_directory(InputFile);
+  if (Jobs || IsDirectory) {
+    std::vector<std::string> Files;
+    if (ToolAction != Evaluate) {
+      llvm::errs() << argv[0]
+                   << ": error: Batch mode only evaluates query logs!\n";
+      success = false;
+    } else if (IsDirectory) {
+      success = GetQueryLogs(InputFile, Files);
+    } else {
+      Files.push_back(InputFile);
+    }
+    success = success && EvaluateBatch(Files, Builder);
+    delete Builder;
+    llvm::llvm_shutdown();
+    return success ? 0 : 1;
+  }
+
+  // binary query logs are read in place, so map the input if possible
+  auto MBResult = MemoryBuffer::getFileOrSTDIN(InputFile.c_str(),
+                                               /*IsText=*/false,
+                                               /*RequiresNullTerminator=*/false);
+  if (!MBResult) {
+    llvm::errs() << argv[0] << ": error: " << MBResult.getError().message()
+                 << "\n";
+    delete Builder;
+    return 1;
+  }
+  std::unique_ptr<MemoryBuffer> &MB = *MBResult;
+  if (!DecompressInput(InputFile, MB)) {
+    delete Builder;
+    return 1;
   }
 
   switch (ToolAction) {
   case PrintTokens:
+    if (BinaryQueryLogReader::isBinaryQueryLog(MB->getBuffer())) {
+      llvm::errs() << argv[0] << ": error: Cannot print the tokens of a "
+                   << "binary query log!\n";
+      success = false;
+      break;
+    }
     PrintInputTokens(MB.get());
     break;
   case PrintAST:
@@ -440,6 +1159,14 @@ int main(int argc, char **argv) {
   case PrintSMTLIBv2:
     success = printInputAsSMTLIBv2(InputFile=="-"? "<stdin>" : InputFile.c_str(), MB.get(),Builder);
     break;
+  case PrintBinary:
+    success = PrintInputAsBinary(InputFile == "-" ? "<stdin>" : InputFile.c_str(),
+                                 MB.get(), Builder);
+    break;
+  case Benchmark:
+    success = BenchmarkInput(InputFile == "-" ? "<stdin>" : InputFile.c_str(),
+                             MB.get(), Builder);
+    break;
   default:
     llvm::errs() << argv[0] << ": error: Unknown program action!\n";
   }
@@ -0,0 +1,159 @@
+//===-- fork-server.c -----------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Preloaded into an executable replayed by klee-replay --batch, see
+// fork-server.h. __libc_start_main is wrapped to get hold of main after the
+// dynamic loader and the constructors of the executable ran, so that the
+// forked children only pay for main itself.
+//
+//===----------------------------------------------------------------------===//
+
+#define _GNU_SOURCE
+
+#include "fork-server.h"
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char **environ;
+
+typedef int (*main_fn)(int, char **, char **);
+typedef int (*libc_start_main_fn)(main_fn, int, char **, void (*)(void),
+                                  void (*)(void), void (*)(void), void *);
+
+static main_fn real_main;
+
+static int read_all(int fd, void *buffer, size_t size) {
+  char *p = buffer;
+  while (size) {
+    ssize_t n = read(fd, p, size);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return 0;
+    p += n;
+    size -= n;
+  }
+  return 1;
+}
+
+static int write_int(int fd, int value) {
+  const char *p = (const char *)&value;
+  size_t size = sizeof(value);
+  while (size) {
+    ssize_t n = write(fd, p, size);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return 0;
+    p += n;
+    size -= n;
+  }
+  return 1;
+}
+
+/* Receive a request with its three file descriptors. \return 0 on EOF */
+static int receive_request(int fd, struct fork_server_request *request,
+                           int fds[3]) {
+  char control[CMSG_SPACE(3 * sizeof(int))];
+  struct iovec iov = {request, sizeof(*request)};
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+
+  ssize_t n;
+  do {
+    n = recvmsg(fd, &msg, MSG_CMSG_CLOEXEC);
+  } while (n < 0 && errno == EINTR);
+  struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+  if (n <= 0 || !cmsg || cmsg->cmsg_type != SCM_RIGHTS ||
+      cmsg->cmsg_len != CMSG_LEN(3 * sizeof(int)))
+    return 0;
+  memcpy(fds, CMSG_DATA(cmsg), 3 * sizeof(int));
+  return (size_t)n == sizeof(*request) ||
+         read_all(fd, (char *)request + n, sizeof(*request) - n);
+}
+
+static void serve(int fd) {
+  if (!write_int(fd, 0))
+    _exit(0);
+
+  for (;;) {
+    struct fork_server_request request;
+    int fds[3], i;
+    if (!receive_request(fd, &request, fds))
+      _exit(0);
+    char *payload = malloc(request.size + 1);
+    char **argv = malloc((request.argc + 1) * sizeof(char *));
+    if (!payload || !argv || !read_all(fd, payload, request.size))
+      _exit(0);
+    payload[request.size] = '\0';
+
+    char *p = payload + strlen(payload) + 1;
+    for (i = 0; i != (int)request.argc; ++i) {
+      argv[i] = p;
+      p += strlen(p) + 1;
+    }
+    argv[request.argc] = 0;
+
+    pid_t pid = fork();
+    if (pid == 0) {
+      close(fd);
+      for (i = 0; i != 3; ++i)
+        dup2(fds[i], i);
+      setpgid(0, 0);
+      if (chdir(payload) != 0)
+        _exit(66);
+      exit(real_main(request.argc, argv, environ));
+    }
+
+    for (i = 0; i != 3; ++i)
+      close(fds[i]);
+    free(payload);
+    free(argv);
+    if (!write_int(fd, pid))
+      _exit(0);
+    if (pid < 0)
+      continue;
+
+    int status;
+    while (waitpid(pid, &status, 0) < 0 && errno == EINTR)
+      ;
+    if (!write_int(fd, status))
+      _exit(0);
+  }
+}
+
+static int server_main(int argc, char **argv, char **envp) {
+  const char *fd = getenv(KLEE_REPLAY_FORK_SERVER_FD);
+  if (!fd)
+    return real_main(argc, argv, envp);
+  int server_fd = atoi(fd);
+  /* processes started by the replayed executable are not servers */
+  unsetenv(KLEE_REPLAY_FORK_SERVER_FD);
+  serve(server_fd);
+  return 0;
+}
+
+int __libc_start_main(main_fn main, int argc, char **argv, void (*init)(void),
+                      void (*fini)(void), void (*rtld_fini)(void),
+                      void *stack_end) {
+  libc_start_main_fn next =
+      (libc_start_main_fn)dlsym(RTLD_NEXT, "__libc_start_main");
+  real_main = main;
+  return next(server_main, argc, argv, init, fini, rtld_fini, stack_end);
+}
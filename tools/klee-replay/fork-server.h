@@ -0,0 +1,36 @@
+//===-- fork-server.h ------------------------------------------*- C++ -*--===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// The protocol between klee-replay --batch and the fork server of
+// libkleeReplayForkServer.so, preloaded into the replayed executable.
+//
+// The server stops the executable before main and sends an int 0 on the
+// socket named by KLEE_REPLAY_FORK_SERVER_FD. For each request it then forks
+// a child that runs main, and answers with the int pid of the child and the
+// int wait status once the child terminated. The server exits when the
+// socket is closed.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_FORK_SERVER_H
+#define KLEE_FORK_SERVER_H
+
+#include <stdint.h>
+
+#define KLEE_REPLAY_FORK_SERVER_FD "KLEE_REPLAY_FORK_SERVER_FD"
+
+/* A request carries the stdin, stdout and stderr of the child as SCM_RIGHTS
+   and is followed by size bytes: the working directory of the child and its
+   argc arguments, each terminated by a NUL. */
+struct fork_server_request {
+  uint32_t size;
+  uint32_t argc;
+};
+
+#endif
@@ -8,16 +8,20 @@
 //===----------------------------------------------------------------------===//
 
 #include "klee-replay.h"
+#include "fork-server.h"
 
 #include "klee/ADT/KTest.h"
 
 #include <assert.h>
 #include <errno.h>
 #include <getopt.h>
+#include <limits.h>
+#include <poll.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/socket.h>
 #include <sys/wait.h>
 #include <time.h>
 #include <unistd.h>
@@ -51,9 +55,13 @@ static unsigned monitored_pid = 0;
 static unsigned monitored_timeout;
 
 static char *rootdir = NULL;
+static const char *batch_results = NULL;
+static const char *fork_server_lib = NULL;
 static struct option long_options[] = {
+  {"batch", required_argument, 0, 'b'},
   {"create-files-only", required_argument, 0, 'f'},
   {"chroot-to-dir", required_argument, 0, 'r'},
+  {"fork-server-lib", required_argument, 0, 'l'},
   {"help", no_argument, 0, 'h'},
   {"keep-replay-dir", no_argument, 0, 'k'},
   {0, 0, 0, 0},
@@ -271,18 +279,369 @@ static void usage(void) {
     "Usage: %s [option]... <executable> <ktest-file>...\n"
     "   or: %s --create-files-only <ktest-file>\n"
     "\n"
+    "-b, --batch=FILE         run the executable once and fork it before main\n"
+    "                         for each test, writing the test, its exit status\n"
+    "                         and its time in seconds to the lines of FILE,\n"
+    "                         separated by tabs (dynamically linked Linux\n"
+    "                         executables only)\n"
+    "-l, --fork-server-lib=LIB\n"
+    "                         the library preloaded for --batch, by default\n"
+    "                         ../lib/libkleeReplayForkServer.so next to %s\n"
     "-r, --chroot-to-dir=DIR  use chroot jail, requires CAP_SYS_CHROOT\n"
     "-k, --keep-replay-dir    do not delete replay directory\n"
     "-h, --help               display this help and exit\n"
     "\n"
+    "A <ktest-file> may also be an archive of klee --write-ktest-archive, or\n"
+    "@FILE for the ktest files named on the lines of FILE.\n"
     "Use KLEE_REPLAY_TIMEOUT environment variable to set a timeout (in seconds).\n",
-    progname, progname);
+    progname, progname, progname);
   exit(1);
 }
 
 
 int keep_temps = 0;
 
+static unsigned num_replayed = 0;
+
+/* Set up the arguments and files of input, the test case named input_fname,
+   and free it. */
+static void prepare_input(const char *program, const char *input_fname,
+                          int *prg_argc, char ***prg_argv) {
+  unsigned i;
+
+  obj_index = 0;
+  *prg_argc = input->numArgs;
+  *prg_argv = input->args;
+  free((*prg_argv)[0]);
+  (*prg_argv)[0] = strdup(program);
+
+  klee_init_env(prg_argc, prg_argv);
+
+  if (num_replayed++)
+    fputc('\n', stderr);
+  fprintf(stderr, "KLEE-REPLAY: NOTE: Test file: %s\n"
+                  "KLEE-REPLAY: NOTE: Arguments: ", input_fname);
+  for (i=0; i != (unsigned) *prg_argc; ++i) {
+    char *s = (*prg_argv)[i];
+    if (s[0]=='A' && s[1] && !s[2]) s[1] = '\0';
+    fprintf(stderr, "\"%s\" ", (*prg_argv)[i]);
+  }
+  fputc('\n', stderr);
+
+  /* Create the input files, pipes, etc. */
+  replay_create_files(&__exe_fs);
+}
+
+/* Replay input, the test case named input_fname, and free it. */
+static void replay_input(char *executable, const char *program,
+                         const char *input_fname) {
+  int prg_argc;
+  char ** prg_argv;
+
+  prepare_input(program, input_fname, &prg_argc, &prg_argv);
+
+  /* Run the test case machinery in a subprocess, eventually this parent
+     process should be a script or something which shells out to the actual
+     execution tool. */
+
+  int pid = fork();
+  if (pid < 0) {
+    perror("fork");
+    _exit(66);
+  } else if (pid == 0) {
+    /* Run the executable */
+    run_monitored(executable, prg_argc, prg_argv);
+    _exit(0);
+  } else {
+    /* Wait for the executable to finish. */
+    int res, status;
+
+    do {
+      res = waitpid(pid, &status, 0);
+    } while (res < 0 && errno == EINTR);
+
+    // Delete all files in the replay directory
+    replay_delete_files();
+
+    if (res < 0) {
+      perror("waitpid");
+      _exit(66);
+    }
+
+    free(prg_argv);
+    kTest_free(input);
+  }
+}
+
+/*** Batch mode ***/
+
+/* The socket of the fork server and the stdin and stdout of klee-replay,
+   which replay_create_files may replace. */
+static int server_fd = -1;
+static int original_fds[2];
+static FILE *results;
+
+static int read_int(int *value) {
+  char *p = (char *)value;
+  size_t size = sizeof(*value);
+  while (size) {
+    ssize_t n = read(server_fd, p, size);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return 0;
+    p += n;
+    size -= n;
+  }
+  return 1;
+}
+
+/* Wait for the next int from the fork server. \return 0 on a timeout */
+static int wait_for_int(int timeout_ms) {
+  struct pollfd pfd = {server_fd, POLLIN, 0};
+  int res;
+  do {
+    res = poll(&pfd, 1, timeout_ms);
+  } while (res < 0 && errno == EINTR);
+  return res != 0;
+}
+
+static const char *default_fork_server_lib(void) {
+  static char path[PATH_MAX + 64];
+  char exe[PATH_MAX];
+  ssize_t n = readlink("/proc/self/exe", exe, sizeof(exe) - 1);
+  if (n <= 0)
+    return "libkleeReplayForkServer.so";
+  exe[n] = '\0';
+  char *slash = strrchr(exe, '/');
+  *slash = '\0';
+  snprintf(path, sizeof(path), "%s/../lib/libkleeReplayForkServer.so", exe);
+  return path;
+}
+
+static void start_fork_server(char *executable) {
+  int fds[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+    perror("socketpair");
+    exit(1);
+  }
+  if (!fork_server_lib)
+    fork_server_lib = default_fork_server_lib();
+  if (access(fork_server_lib, R_OK) != 0) {
+    fprintf(stderr, "KLEE-REPLAY: ERROR: fork server library %s:",
+            fork_server_lib);
+    perror("");
+    exit(1);
+  }
+
+  int pid = fork();
+  if (pid < 0) {
+    perror("fork");
+    exit(1);
+  } else if (pid == 0) {
+    char fd[16];
+    const char *preload = getenv("LD_PRELOAD");
+    char *libs = malloc(strlen(fork_server_lib) + (preload ? strlen(preload) : 0) + 2);
+    sprintf(libs, preload ? "%s:%s" : "%s", fork_server_lib, preload);
+    snprintf(fd, sizeof(fd), "%d", fds[1]);
+    close(fds[0]);
+    setenv("LD_PRELOAD", libs, 1);
+    setenv(KLEE_REPLAY_FORK_SERVER_FD, fd, 1);
+    char *argv[] = {executable, 0};
+    execv(executable, argv);
+    perror("execv");
+    _exit(66);
+  }
+
+  close(fds[1]);
+  server_fd = fds[0];
+  int hello;
+  if (!wait_for_int(10000) || !read_int(&hello)) {
+    fprintf(stderr, "KLEE-REPLAY: ERROR: the fork server of %s did not start, "
+                    "is it a dynamically linked executable?\n", executable);
+    kill(pid, SIGKILL);
+    exit(1);
+  }
+
+  original_fds[0] = dup(0);
+  original_fds[1] = dup(1);
+}
+
+static int send_request(int argc, char **argv) {
+  struct fork_server_request request;
+  int fds[3] = {0, 1, 2}, i;
+  size_t size = strlen(replay_dir) + 1;
+  for (i = 0; i != argc; ++i)
+    size += strlen(argv[i]) + 1;
+  request.size = size;
+  request.argc = argc;
+
+  char *payload = malloc(size), *p = payload;
+  strcpy(p, replay_dir);
+  p += strlen(p) + 1;
+  for (i = 0; i != argc; ++i) {
+    strcpy(p, argv[i]);
+    p += strlen(p) + 1;
+  }
+
+  char control[CMSG_SPACE(sizeof(fds))];
+  struct iovec iov[2] = {{&request, sizeof(request)}, {payload, size}};
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = iov;
+  msg.msg_iovlen = 2;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+  struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+  memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+  /* the fds are sent with the first byte, the rest may follow */
+  ssize_t n;
+  do {
+    n = sendmsg(server_fd, &msg, MSG_NOSIGNAL);
+  } while (n < 0 && errno == EINTR);
+  size_t sent = n < 0 ? 0 : n, total = sizeof(request) + size;
+  while (n >= 0 && sent < total) {
+    const char *rest = sent < sizeof(request)
+                           ? (const char *)&request + sent
+                           : payload + (sent - sizeof(request));
+    size_t left = sent < sizeof(request) ? sizeof(request) - sent
+                                         : total - sent;
+    n = send(server_fd, rest, left, MSG_NOSIGNAL);
+    if (n > 0)
+      sent += n;
+    else if (n < 0 && errno == EINTR)
+      n = 0;
+  }
+  free(payload);
+  return n >= 0;
+}
+
+/* Replay input, the test case named input_fname, in a child of the fork
+   server and free it. */
+static void replay_batch_input(const char *program, const char *input_fname) {
+  int prg_argc;
+  char ** prg_argv;
+
+  /* tests without a symbolic stdin or stdout get the original ones */
+  dup2(original_fds[0], 0);
+  dup2(original_fds[1], 1);
+  prepare_input(program, input_fname, &prg_argc, &prg_argv);
+
+  struct timespec start, end;
+  int pid, status = 0, timed_out = 0;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  if (!send_request(prg_argc, prg_argv) || !read_int(&pid)) {
+    fputs("KLEE-REPLAY: ERROR: lost the fork server\n", stderr);
+    exit(1);
+  }
+  if (pid < 0) {
+    fputs("KLEE-REPLAY: ERROR: fork failed in the fork server\n", stderr);
+    exit(1);
+  }
+
+  monitored_pid = pid;
+  if (!wait_for_int(monitored_timeout > INT_MAX / 1000
+                        ? -1 : (int)monitored_timeout * 1000)) {
+    timed_out = 1;
+    kill(-pid, SIGKILL);
+  }
+  if (!read_int(&status)) {
+    fputs("KLEE-REPLAY: ERROR: lost the fork server\n", stderr);
+    exit(1);
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  monitored_pid = 0;
+  /* Just in case, kill the process group of pid. */
+  kill(-pid, SIGKILL);
+  double elapsed =
+      (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+  char msg[64];
+  if (timed_out)
+    strcpy(msg, "TIMED OUT");
+  else if (WIFSIGNALED(status))
+    snprintf(msg, sizeof(msg), "CRASHED signal %d", WTERMSIG(status));
+  else if (WIFEXITED(status) && WEXITSTATUS(status) == 0)
+    strcpy(msg, "NORMAL");
+  else if (WIFEXITED(status))
+    snprintf(msg, sizeof(msg), "ABNORMAL %d", WEXITSTATUS(status));
+  else
+    strcpy(msg, "NONE");
+  fprintf(stderr, "KLEE-REPLAY: NOTE: EXIT STATUS: %s (%.6f seconds)\n", msg,
+          elapsed);
+  fprintf(results, "%s\t%s\t%.6f\n", input_fname, msg, elapsed);
+  fflush(results);
+
+  replay_delete_files();
+  free(prg_argv);
+  kTest_free(input);
+}
+
+static void replay(char *executable, const char *program,
+                   const char *input_fname) {
+  if (batch_results)
+    replay_batch_input(program, input_fname);
+  else
+    replay_input(executable, program, input_fname);
+}
+
+/* Replay the tests of a ktest file, an archive, or a @FILE list. */
+static void replay_file(char *executable, const char *program,
+                        const char *input_fname) {
+  if (input_fname[0] == '@') {
+    FILE *list = fopen(input_fname + 1, "r");
+    char line[PATH_MAX];
+    if (!list) {
+      fprintf(stderr, "KLEE-REPLAY: ERROR: unable to open %s.\n",
+              input_fname + 1);
+      exit(1);
+    }
+    while (fgets(line, sizeof(line), list)) {
+      line[strcspn(line, "\r\n")] = '\0';
+      if (line[0])
+        replay_file(executable, program, line);
+    }
+    fclose(list);
+    return;
+  }
+
+  if (kTestArchive_isArchive(input_fname)) {
+    KTestArchive *archive = kTestArchive_open(input_fname);
+    unsigned i, n;
+    if (!archive) {
+      fprintf(stderr, "KLEE-REPLAY: ERROR: input file %s not valid.\n",
+              input_fname);
+      exit(1);
+    }
+    for (i = 0, n = kTestArchive_numTests(archive); i != n; ++i) {
+      char test_name[PATH_MAX + 16];
+      snprintf(test_name, sizeof(test_name), "%s:%u", input_fname, i + 1);
+      input = kTestArchive_getTest(archive, i);
+      if (!input) {
+        fprintf(stderr, "KLEE-REPLAY: ERROR: input file %s not valid.\n",
+                test_name);
+        exit(1);
+      }
+      replay(executable, program, test_name);
+    }
+    kTestArchive_close(archive);
+    return;
+  }
+
+  input = kTest_mapFile(input_fname);
+  if (!input) {
+    fprintf(stderr, "KLEE-REPLAY: ERROR: input file %s not valid.\n",
+            input_fname);
+    exit(1);
+  }
+  replay(executable, program, input_fname);
+}
+
+
 int main(int argc, char** argv) {
   int prg_argc;
   char ** prg_argv;
@@ -293,8 +652,16 @@ int main(int argc, char** argv) {
     usage();
 
   int c, opt_index;
-  while ((c = getopt_long(argc, argv, "f:r:k", long_options, &opt_index)) != -1) {
+  while ((c = getopt_long(argc, argv, "b:f:r:kl:", long_options, &opt_index)) != -1) {
     switch (c) {
+    case 'b':
+      batch_results = optarg;
+      break;
+
+    case 'l':
+      fork_server_lib = optarg;
+      break;
+
     case 'f': {
       /* Special case hack for only creating files and not actually executing
        * the program. */
@@ -303,7 +670,7 @@ int main(int argc, char** argv) {
 
       char *input_fname = optarg;
 
-      input = kTest_fromFile(input_fname);
+      input = kTest_mapFile(input_fname);
       if (!input) {
         fprintf(stderr, "KLEE-REPLAY: ERROR: input file %s not valid.\n", input_fname);
         exit(1);
@@ -353,73 +720,32 @@ int main(int argc, char** argv) {
     exit(1);
   }
 
-  int idx = 0;
-  for (idx = optind + 1; idx != argc; ++idx) {
-    char* input_fname = argv[idx];
-    unsigned i;
-
-    input = kTest_fromFile(input_fname);
-    if (!input) {
-      fprintf(stderr, "KLEE-REPLAY: ERROR: input file %s not valid.\n",
-              input_fname);
+  if (batch_results) {
+    if (rootdir) {
+      fputs("KLEE-REPLAY: ERROR: --batch does not support --chroot-to-dir.\n", stderr);
       exit(1);
     }
-
-    obj_index = 0;
-    prg_argc = input->numArgs;
-    prg_argv = input->args;
-    free(prg_argv[0]);
-    prg_argv[0] = strdup(argv[optind]);
-
-    klee_init_env(&prg_argc, &prg_argv);
-
-    if (idx > 2)
-      fputc('\n', stderr);
-    fprintf(stderr, "KLEE-REPLAY: NOTE: Test file: %s\n"
-                    "KLEE-REPLAY: NOTE: Arguments: ", input_fname);
-    for (i=0; i != (unsigned) prg_argc; ++i) {
-      char *s = prg_argv[i];
-      if (s[0]=='A' && s[1] && !s[2]) s[1] = '\0';
-      fprintf(stderr, "\"%s\" ", prg_argv[i]);
+    results = fopen(batch_results, "w");
+    if (!results) {
+      fprintf(stderr, "KLEE-REPLAY: ERROR: unable to open %s:", batch_results);
+      perror("");
+      exit(1);
     }
-    fputc('\n', stderr);
-
-    /* Create the input files, pipes, etc. */
-    replay_create_files(&__exe_fs);
-
-    /* Run the test case machinery in a subprocess, eventually this parent
-       process should be a script or something which shells out to the actual
-       execution tool. */
-
-    int pid = fork();
-    if (pid < 0) {
-      perror("fork");
-      _exit(66);
-    } else if (pid == 0) {
-      /* Run the executable */
-      run_monitored(executable, prg_argc, prg_argv);
-      _exit(0);
-    } else {
-      /* Wait for the executable to finish. */
-      int res, status;
-
-      do {
-        res = waitpid(pid, &status, 0);
-      } while (res < 0 && errno == EINTR);
-
-      // Delete all files in the replay directory
-      replay_delete_files();
-
-      if (res < 0) {
-        perror("waitpid");
-        _exit(66);
-      }
-
-      free(prg_argv);
-      kTest_free(input);
+    const char *t = getenv("KLEE_REPLAY_TIMEOUT");
+    monitored_timeout = t ? atoi(t) : 10000000;
+    if (monitored_timeout == 0) {
+      fprintf(stderr, "KLEE-REPLAY: ERROR: invalid timeout (%s)\n", t);
+      exit(1);
     }
+    start_fork_server(executable);
   }
 
+  int idx = 0;
+  for (idx = optind + 1; idx != argc; ++idx)
+    replay_file(executable, argv[optind], argv[idx]);
+
+  if (results)
+    fclose(results);
   return 0;
 }
 
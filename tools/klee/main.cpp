@@ -14,6 +14,7 @@
 #include "klee/Core/Interpreter.h"
 #include "klee/Expr/Expr.h"
 #include "klee/ADT/KTest.h"
+#include "klee/ADT/RNG.h"
 #include "klee/Support/OptionCategories.h"
 #include "klee/Statistics/Statistics.h"
 #include "klee/Solver/SolverCmdLine.h"
@@ -56,11 +57,18 @@
 #include <sys/wait.h>
 
 #include <cerrno>
+#include <condition_variable>
 #include <ctime>
+#include <deque>
 #include <fstream>
+#include <functional>
 #include <iomanip>
 #include <iterator>
+#include <map>
+#include <mutex>
+#include <set>
 #include <sstream>
+#include <thread>
 
 
 using namespace llvm;
@@ -149,6 +157,34 @@ namespace {
                 cl::desc("Write .sym.path files for each test case (default=false)"),
                 cl::cat(TestCaseCat));
 
+  cl::opt<bool>
+  WriteKTestArchive("write-ktest-archive",
+                    cl::desc("Write the .ktest files of all test cases to a single archive, "
+                             "tests.ktests, instead of a file each. Worker processes write "
+                             "archives of their own (default=false)"),
+                    cl::cat(TestCaseCat));
+
+  cl::opt<bool>
+  KTestArchiveDedup("ktest-archive-dedup",
+                    cl::desc("Store identical object bytes in a --write-ktest-archive only "
+                             "once (default=true)"),
+                    cl::init(true),
+                    cl::cat(TestCaseCat));
+
+  cl::opt<unsigned>
+  TestWriterThreads("test-writer-threads",
+                    cl::desc("Write the files of the test cases with this many background threads. "
+                             "Their contents are still computed when the state terminates (default=0 (off))"),
+                    cl::init(0),
+                    cl::cat(TestCaseCat));
+
+  cl::opt<unsigned>
+  TestWriterQueue("test-writer-queue",
+                  cl::desc("Number of test cases that wait for the --test-writer-threads before "
+                           "a terminating state waits for them (default=64)"),
+                  cl::init(64),
+                  cl::cat(TestCaseCat));
+
 
   /*** Startup options ***/
 
@@ -161,6 +197,20 @@ namespace {
              cl::init("main"),
              cl::cat(StartCat));
 
+  cl::list<std::string> BatchEntryPoints(
+      "batch-entry-points", cl::CommaSeparated,
+      cl::desc("Prepare the module once and explore each of the given "
+               "functions in a run of its own, in a forked process writing "
+               "to the subdirectory of the output directory named after the "
+               "function. Replaces --entry-point (default=off)"),
+      cl::cat(StartCat));
+
+  cl::opt<unsigned> BatchJobs(
+      "batch-jobs",
+      cl::desc("Number of runs of --batch-entry-points explored at the same "
+               "time (default=1)"),
+      cl::init(1), cl::cat(StartCat));
+
   cl::opt<std::string>
   RunInDir("run-in-dir",
            cl::desc("Change to the given directory before starting execution (default=location of tested file)."),
@@ -247,6 +297,18 @@ namespace {
                  cl::init(true),
                  cl::cat(ChecksCat));
 
+  enum class CheckModeType { Runtime, Native };
+
+  cl::opt<CheckModeType> CheckMode(
+      "check-mode",
+      cl::desc("How to run the division-by-zero and overshift checks "
+               "(default=runtime)"),
+      cl::values(clEnumValN(CheckModeType::Runtime, "runtime",
+                            "Instrument the module with calls to the runtime"),
+                 clEnumValN(CheckModeType::Native, "native",
+                            "Check the instructions in the executor, forking "
+                            "only if the check can fail")),
+      cl::init(CheckModeType::Runtime), cl::cat(ChecksCat));
 
 
   cl::opt<bool>
@@ -272,6 +334,15 @@ namespace {
                     cl::desc("Specify a ktest file to use for replay of nondets"),
                     cl::value_desc("ktest file"));
 
+  cl::opt<bool>
+      ConcreteReplay("concrete-replay",
+                     cl::desc("Replay the objects of klee_make_symbolic from "
+                              "the --replay-nondets file too and make all "
+                              "other nondeterministic values zero, so that "
+                              "the replay runs without symbolic values or "
+                              "solver queries (default=false)"),
+                     cl::init(false), cl::cat(ReplayCat));
+
   cl::list<std::string>
   ReplayKTestDir("replay-ktest-dir",
                  cl::desc("Specify a directory to replay ktest files from"),
@@ -284,6 +355,13 @@ namespace {
                  cl::value_desc("path file"),
                  cl::cat(ReplayCat));
 
+  cl::opt<std::string>
+  ResumeFrom("resume-from",
+             cl::desc("Continue the exploration from a checkpoint written "
+                      "with --checkpoint-interval"),
+             cl::value_desc("checkpoint file"),
+             cl::cat(ReplayCat));
+
 
 
   cl::list<std::string>
@@ -296,6 +374,32 @@ namespace {
              cl::desc("Directory with .ktest files to be used as seeds"),
              cl::cat(SeedingCat));
 
+
+  /*** Fuzzing options ***/
+
+  cl::OptionCategory FuzzingCat("Fuzzing options",
+                                "These options control the concrete fuzzing "
+                                "that seeds the symbolic exploration.");
+
+  cl::opt<std::string>
+  FuzzTime("fuzz-time",
+           cl::desc("Mutate the inputs of klee_make_symbolic and the "
+                    "nondet values and run them concretely for the given "
+                    "time before the symbolic exploration, which is seeded "
+                    "with the inputs that covered new instructions "
+                    "(default=0s (off))"),
+           cl::cat(FuzzingCat));
+
+  cl::opt<unsigned>
+  FuzzRounds("fuzz-rounds",
+             cl::desc("Alternate the fuzzing of --fuzz-time and the symbolic "
+                      "exploration for the given number of rounds. The "
+                      "explorations of all but the last round also run for "
+                      "--fuzz-time and their test cases are mutated by the "
+                      "next round (default=1)"),
+             cl::init(1),
+             cl::cat(FuzzingCat));
+
   cl::opt<unsigned>
   MakeConcreteSymbolic("make-concrete-symbolic",
                        cl::desc("Probabilistic rate at which to make concrete reads symbolic, "
@@ -330,6 +434,128 @@ class ExecutionState;
 
 /***/
 
+/// The objects of a .ktest file, by name.
+using KTestObjects =
+    std::vector<std::pair<std::string, std::vector<unsigned char>>>;
+
+/// Writes the files of test cases with the threads of --test-writer-threads.
+/// The interpreter solves for the inputs and formats the files when a state
+/// terminates, as that needs the solver and the state, and only the writes
+/// are left to the threads. The threads are started on demand and stopped by
+/// wait, so that forked processes do not inherit a queue without threads.
+class TestCaseWriter {
+public:
+  struct TestCase {
+    /// Empty if no .ktest file is written.
+    std::string ktestPath;
+    KTestObjects objects;
+    /// The paths and contents of the other files.
+    std::deque<std::pair<std::string, std::string>> files;
+  };
+
+private:
+  const unsigned numThreads;
+  const size_t capacity;
+  /// Writes a .ktest file, may be called by several threads at once.
+  std::function<bool(const std::string &, const KTestObjects &)> writeKTest;
+
+  std::mutex mutex;
+  std::condition_variable queued, dequeued;
+  std::deque<std::unique_ptr<TestCase>> queue;
+  std::vector<std::thread> threads;
+  bool stopping = false;
+  /// The number of .ktest files that could not be written.
+  std::atomic<unsigned> lostKTests{0};
+
+  void run();
+
+public:
+  TestCaseWriter(
+      unsigned numThreads, size_t capacity,
+      std::function<bool(const std::string &, const KTestObjects &)> writeKTest)
+      : numThreads(numThreads), capacity(std::max<size_t>(capacity, 1)),
+        writeKTest(std::move(writeKTest)) {}
+  ~TestCaseWriter() { wait(); }
+
+  /// Queue a test case, waiting while the queue is full.
+  void add(std::unique_ptr<TestCase> testCase);
+
+  /// Write all queued test cases and stop the threads. \return the number
+  /// of .ktest files that were lost since the last call
+  unsigned wait();
+};
+
+/// Writes the automaton of a .graphml witness, a path of nodes starting at
+/// the entry node 0. The declaration of the current node is held back until
+/// the path moves on, so that an edge without data, which says nothing to a
+/// validator, is collapsed by moving the data of its target to its source.
+class WitnessWriter {
+  llvm::raw_ostream &out;
+  unsigned node = 0;
+  /// The data of the current node.
+  std::string nodeData = "  <data key=\"entry\">true</data>\n";
+
+  void writeNode() {
+    out << "<node id=\"" << node;
+    if (nodeData.empty())
+      out << "\"/>\n";
+    else
+      out << "\">\n" << nodeData << "</node>\n";
+  }
+
+public:
+  explicit WitnessWriter(llvm::raw_ostream &out) : out(out) {
+    out << "<?xml version=\"1.0\" encoding=\"UTF-8\" standalone=\"no\"?>\n"
+           "<graphml xmlns=\"http://graphml.graphdrawing.org/xmlns\" "
+           "xmlns:xsi=\"http://www.w3.org/2001/XMLSchema-instance\">\n"
+           "<graph edgedefault=\"directed\">\n";
+  }
+
+  /// Append data with the given key to a node or edge.
+  static void addData(std::string &data, llvm::StringRef key,
+                      const llvm::Twine &value) {
+    data += "  <data key=\"";
+    data += key;
+    data += "\">";
+    data += value.str();
+    data += "</data>\n";
+  }
+
+  unsigned getNode() const { return node; }
+
+  /// Move to a new node with the given data (e.g. "cyclehead") over an edge
+  /// with the given data.
+  void step(const std::string &edgeData, llvm::StringRef nodeKey = "") {
+    if (edgeData.empty() && node != 0) {
+      if (!nodeKey.empty())
+        addData(nodeData, nodeKey, "true");
+      return;
+    }
+    writeNode();
+    out << "<edge source=\"" << node << "\" target=\"" << node + 1;
+    if (edgeData.empty())
+      out << "\"/>\n";
+    else
+      out << "\">\n" << edgeData << "</edge>\n";
+    ++node;
+    nodeData.clear();
+    if (!nodeKey.empty())
+      addData(nodeData, nodeKey, "true");
+  }
+
+  /// Add an edge from the current node back to an earlier one.
+  void loop(unsigned target, const std::string &edgeData) {
+    out << "<edge source=\"" << node << "\" target=\"" << target << "\">\n"
+        << edgeData << "</edge>\n";
+  }
+
+  void finish() {
+    writeNode();
+    out << "</graph>\n"
+           "</graphml>\n";
+  }
+};
+
 class KleeHandler : public InterpreterHandler {
 private:
   Interpreter *m_interpreter;
@@ -343,6 +569,36 @@ private:
   unsigned m_pathsCompleted; // number of completed paths
   unsigned m_pathsExplored; // number of partially explored and completed paths
 
+  // the tests of a parallel run after the split are numbered round-robin
+  // among the workers, from m_workerBase on
+  unsigned m_workerIndex = 0;
+  unsigned m_workerCount = 1;
+  unsigned m_workerBase = 0;
+  std::atomic<std::uint32_t> *m_sharedTestCounter = nullptr;
+
+  // the files of the test case being processed go to m_pendingTestCase
+  // instead of the disk if there is a writer
+  std::unique_ptr<TestCaseWriter> m_testCaseWriter;
+  TestCaseWriter::TestCase *m_pendingTestCase = nullptr;
+
+  // the archive of --write-ktest-archive, which is closed by
+  // waitForTestCases and reopened for the next test case. A forked worker
+  // process starts an archive of its own.
+  KTestArchive *m_ktestArchive = nullptr;
+  std::string m_ktestArchivePath;
+  // the process m_ktestArchivePath belongs to, 0 before the first archive
+  pid_t m_ktestArchivePid = 0;
+  const pid_t m_mainPid = getpid();
+  std::mutex m_ktestArchiveMutex;
+
+  // the inputs of the test cases are also added here if set, for the
+  // fuzzer of --fuzz-time
+  std::vector<KTestObjects> *m_collectedTests = nullptr;
+
+  bool writeKTest(const std::string &path, const KTestObjects &out);
+  void closeKTestArchive();
+  void openPathWriters();
+
   // used for writing .ktest files
   int m_argc;
   char **m_argv;
@@ -365,8 +621,46 @@ public:
   void incPathsExplored(std::uint32_t num = 1) {
     m_pathsExplored += num; }
 
+  void setWorker(unsigned index, unsigned count) {
+    m_workerIndex = index;
+    m_workerCount = count;
+    m_workerBase = m_numTotalTests;
+  }
+  WorkerCounts getWorkerCounts() const {
+    WorkerCounts counts;
+    counts.pathsCompleted = m_pathsCompleted;
+    counts.pathsExplored = m_pathsExplored;
+    counts.testCases = m_numGeneratedTests;
+    counts.totalTests = m_numTotalTests;
+    return counts;
+  }
+  void setSharedTestCounter(std::atomic<std::uint32_t> *counter) {
+    m_sharedTestCounter = counter;
+  }
+  void addWorkerCounts(const WorkerCounts &counts) {
+    m_pathsCompleted += counts.pathsCompleted;
+    m_pathsExplored += counts.pathsExplored;
+    m_numGeneratedTests += counts.testCases;
+    m_numTotalTests += counts.totalTests;
+  }
+  void waitForTestCases() {
+    if (m_testCaseWriter)
+      m_numGeneratedTests -= m_testCaseWriter->wait();
+    closeKTestArchive();
+  }
+
   void setInterpreter(Interpreter *i);
 
+  /// Adds the inputs of the following test cases to tests, null to stop.
+  void collectTests(std::vector<KTestObjects> *tests) {
+    m_collectedTests = tests;
+  }
+
+  /// Moves the output to the given subdirectory of the output directory, in
+  /// the forked process of a run of --batch-entry-points. The files opened
+  /// so far are shared with the original process and left to it.
+  void useSubdirectory(const std::string &name);
+
   std::string dumpPath(const ExecutionState& state);
 
   void processTestCase(const ExecutionState  &state,
@@ -376,7 +670,7 @@ public:
   std::string getOutputFilename(const std::string &filename);
   std::unique_ptr<llvm::raw_fd_ostream> openOutputFile(const std::string &filename);
   std::string getTestFilename(const std::string &suffix, unsigned id);
-  std::unique_ptr<llvm::raw_fd_ostream> openTestFile(const std::string &suffix, unsigned id);
+  std::unique_ptr<llvm::raw_ostream> openTestFile(const std::string &suffix, unsigned id);
 
   // load a .path file
   static void loadPathFile(std::string name,
@@ -385,6 +679,9 @@ public:
   static void getKTestFilesInDir(std::string directoryPath,
                                  std::vector<std::string> &results);
 
+  // load a .ktest file or all tests of an archive, returns false on error
+  static bool loadKTests(const std::string &path, std::vector<KTest *> &results);
+
   static std::string getRunTimeLibraryPath(const char *argv0);
 };
 
@@ -392,6 +689,12 @@ KleeHandler::KleeHandler(int argc, char **argv)
     : m_interpreter(0), m_pathWriter(0), m_symPathWriter(0),
       m_outputDirectory(), m_numTotalTests(0), m_numGeneratedTests(0),
       m_pathsCompleted(0), m_pathsExplored(0), m_argc(argc), m_argv(argv) {
+  if (TestWriterThreads)
+    m_testCaseWriter = std::make_unique<TestCaseWriter>(
+        TestWriterThreads, TestWriterQueue,
+        [this](const std::string &path, const KTestObjects &out) {
+          return writeKTest(path, out);
+        });
 
   // create output directory (OutputDir or "klee-out-<i>")
   bool dir_given = OutputDir != "";
@@ -466,6 +769,7 @@ KleeHandler::KleeHandler(int argc, char **argv)
 }
 
 KleeHandler::~KleeHandler() {
+  waitForTestCases();
   delete m_pathWriter;
   delete m_symPathWriter;
   fclose(klee_warning_file);
@@ -474,7 +778,10 @@ KleeHandler::~KleeHandler() {
 
 void KleeHandler::setInterpreter(Interpreter *i) {
   m_interpreter = i;
+  openPathWriters();
+}
 
+void KleeHandler::openPathWriters() {
   if (WritePaths) {
     m_pathWriter = new TreeStreamWriter(getOutputFilename("paths.ts"));
     assert(m_pathWriter->good());
@@ -488,6 +795,34 @@ void KleeHandler::setInterpreter(Interpreter *i) {
   }
 }
 
+void KleeHandler::useSubdirectory(const std::string &name) {
+  SmallString<128> directory(m_outputDirectory);
+  sys::path::append(directory, name);
+  if (mkdir(directory.c_str(), 0775) < 0) {
+    if (errno == EEXIST)
+      klee_warning("cannot create \"%s\": %s", directory.c_str(),
+                   strerror(errno));
+    else
+      klee_error("cannot create \"%s\": %s", directory.c_str(),
+                 strerror(errno));
+  }
+  m_outputDirectory = directory;
+
+  std::string file_path = getOutputFilename("warnings.txt");
+  if ((klee_warning_file = fopen(file_path.c_str(), "w")) == NULL)
+    klee_error("cannot open file \"%s\": %s", file_path.c_str(), strerror(errno));
+  file_path = getOutputFilename("messages.txt");
+  if ((klee_message_file = fopen(file_path.c_str(), "w")) == NULL)
+    klee_error("cannot open file \"%s\": %s", file_path.c_str(), strerror(errno));
+  (void)m_infoFile.release();
+  m_infoFile = openOutputFile("info");
+
+  // the writers of the original process are not deleted, which would
+  // write their buffers once more
+  m_pathWriter = m_symPathWriter = nullptr;
+  openPathWriters();
+}
+
 std::string KleeHandler::getOutputFilename(const std::string &filename) {
   SmallString<128> path = m_outputDirectory;
   sys::path::append(path,filename);
@@ -521,11 +856,125 @@ std::string KleeHandler::getTestFilename(const std::string &suffix, unsigned id)
   return filename.str();
 }
 
-std::unique_ptr<llvm::raw_fd_ostream>
+std::unique_ptr<llvm::raw_ostream>
 KleeHandler::openTestFile(const std::string &suffix, unsigned id) {
+  if (m_pendingTestCase) {
+    // the deque keeps the contents in place while more files are added
+    auto &files = m_pendingTestCase->files;
+    files.emplace_back(getOutputFilename(getTestFilename(suffix, id)),
+                       std::string());
+    return std::make_unique<llvm::raw_string_ostream>(files.back().second);
+  }
   return openOutputFile(getTestFilename(suffix, id));
 }
 
+bool KleeHandler::writeKTest(const std::string &path, const KTestObjects &out) {
+  KTest b;
+  b.numArgs = m_argc;
+  b.args = m_argv;
+  b.symArgvs = 0;
+  b.symArgvLen = 0;
+  b.numObjects = out.size();
+  b.objects = new KTestObject[b.numObjects];
+  assert(b.objects);
+  for (unsigned i=0; i<b.numObjects; i++) {
+    KTestObject *o = &b.objects[i];
+    o->name = const_cast<char*>(out[i].first.c_str());
+    o->numBytes = out[i].second.size();
+    o->bytes = new unsigned char[o->numBytes];
+    assert(o->bytes);
+    std::copy(out[i].second.begin(), out[i].second.end(), o->bytes);
+  }
+
+  bool written;
+  if (WriteKTestArchive) {
+    std::lock_guard<std::mutex> lock(m_ktestArchiveMutex);
+    if (!m_ktestArchive) {
+      if (m_ktestArchivePid == getpid()) {
+        m_ktestArchive = kTestArchive_reopen(m_ktestArchivePath.c_str(),
+                                             KTestArchiveDedup);
+      } else {
+        // the first test case of this process
+        std::string name = "tests.ktests";
+        if (getpid() != m_mainPid)
+          name = "tests." + std::to_string(getpid()) + ".ktests";
+        m_ktestArchivePath = getOutputFilename(name);
+        m_ktestArchivePid = getpid();
+        m_ktestArchive = kTestArchive_create(m_ktestArchivePath.c_str(),
+                                             KTestArchiveDedup);
+      }
+      if (!m_ktestArchive)
+        klee_warning("unable to open test case archive %s",
+                     m_ktestArchivePath.c_str());
+    }
+    written = m_ktestArchive && kTestArchive_append(m_ktestArchive, &b);
+  } else {
+    written = kTest_toFile(&b, path.c_str());
+  }
+
+  for (unsigned i=0; i<b.numObjects; i++)
+    delete[] b.objects[i].bytes;
+  delete[] b.objects;
+  return written;
+}
+
+void KleeHandler::closeKTestArchive() {
+  std::lock_guard<std::mutex> lock(m_ktestArchiveMutex);
+  if (!m_ktestArchive)
+    return;
+  if (!kTestArchive_close(m_ktestArchive))
+    klee_warning("unable to write the index of test case archive %s",
+                 m_ktestArchivePath.c_str());
+  m_ktestArchive = nullptr;
+}
+
+void TestCaseWriter::add(std::unique_ptr<TestCase> testCase) {
+  std::unique_lock<std::mutex> lock(mutex);
+  if (threads.empty())
+    for (unsigned i = 0; i < numThreads; ++i)
+      threads.emplace_back([this] { run(); });
+  dequeued.wait(lock, [this] { return queue.size() < capacity; });
+  queue.push_back(std::move(testCase));
+  queued.notify_one();
+}
+
+unsigned TestCaseWriter::wait() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  queued.notify_all();
+  for (auto &thread : threads)
+    thread.join();
+  threads.clear();
+  stopping = false;
+  return lostKTests.exchange(0);
+}
+
+void TestCaseWriter::run() {
+  for (;;) {
+    std::unique_ptr<TestCase> testCase;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      queued.wait(lock, [this] { return !queue.empty() || stopping; });
+      if (queue.empty())
+        return;
+      testCase = std::move(queue.front());
+      queue.pop_front();
+    }
+    dequeued.notify_one();
+
+    if (!testCase->ktestPath.empty() &&
+        !writeKTest(testCase->ktestPath, testCase->objects)) {
+      klee_warning("unable to write output test case, losing it");
+      ++lostKTests;
+    }
+    for (const auto &file : testCase->files)
+      if (auto f = openFileForPath(file.first))
+        *f << file.second;
+  }
+}
+
 static std::string getCType(unsigned bitwidth, bool isSigned) {
     std::string rettype = "";
     if (!isSigned && bitwidth > 1)
@@ -597,8 +1046,7 @@ std::string KleeHandler::dumpPath(const ExecutionState& state) {
 
   static unsigned num = 0;
   std::vector<unsigned char> concreteBranches;
-  m_pathWriter->readStream(m_interpreter->getPathStreamID(state),
-                           concreteBranches);
+  m_interpreter->getPathBranches(state, false, concreteBranches);
 
   std::string path = getOutputFilename("path-1" + std::to_string(num) + ".path");
   auto f = openFileForPath(path);
@@ -619,6 +1067,17 @@ void KleeHandler::processTestCase(const ExecutionState &state,
   if (!WriteNone) {
     const auto start_time = time::getWallTime();
     unsigned id = ++m_numTotalTests;
+    if (m_sharedTestCounter)
+      id = ++*m_sharedTestCounter;
+    else if (m_workerCount > 1)
+      id = m_workerBase + (id - m_workerBase - 1) * m_workerCount +
+           m_workerIndex + 1;
+
+    std::unique_ptr<TestCaseWriter::TestCase> pending;
+    if (m_testCaseWriter) {
+      pending = std::make_unique<TestCaseWriter::TestCase>();
+      m_pendingTestCase = pending.get();
+    }
 
     if (WriteKTests) {
       std::vector< std::pair<std::string, std::vector<unsigned char> > > out;
@@ -628,32 +1087,19 @@ void KleeHandler::processTestCase(const ExecutionState &state,
         klee_warning("unable to get symbolic solution, losing test case");
 
       if (success) {
-        KTest b;
-        b.numArgs = m_argc;
-        b.args = m_argv;
-        b.symArgvs = 0;
-        b.symArgvLen = 0;
-        b.numObjects = out.size();
-        b.objects = new KTestObject[b.numObjects];
-        assert(b.objects);
-        for (unsigned i=0; i<b.numObjects; i++) {
-          KTestObject *o = &b.objects[i];
-          o->name = const_cast<char*>(out[i].first.c_str());
-          o->numBytes = out[i].second.size();
-          o->bytes = new unsigned char[o->numBytes];
-          assert(o->bytes);
-          std::copy(out[i].second.begin(), out[i].second.end(), o->bytes);
-        }
-
-        if (!kTest_toFile(&b, getOutputFilename(getTestFilename("ktest", id)).c_str())) {
+        if (m_collectedTests)
+          m_collectedTests->push_back(out);
+        std::string path = getOutputFilename(getTestFilename("ktest", id));
+        if (pending) {
+          // counted now, the writer reports the files it could not write
+          pending->ktestPath = path;
+          pending->objects = std::move(out);
+          ++m_numGeneratedTests;
+        } else if (!writeKTest(path, out)) {
           klee_warning("unable to write output test case, losing it");
         } else {
           ++m_numGeneratedTests;
         }
-
-        for (unsigned i=0; i<b.numObjects; i++)
-          delete[] b.objects[i].bytes;
-        delete[] b.objects;
       }
     }
 
@@ -694,114 +1140,62 @@ void KleeHandler::processTestCase(const ExecutionState &state,
 
     if (WriteWitness) {
       if (auto witness = openTestFile("graphml", id)) {
-
-        *witness << "<?xml version=\"1.0\" encoding=\"UTF-8\" standalone=\"no\"?>\n" ;
-        *witness << "<graphml xmlns=\"http://graphml.graphdrawing.org/xmlns\" "
-                             "xmlns:xsi=\"http://www.w3.org/2001/XMLSchema-instance\">\n"
-                    "<graph edgedefault=\"directed\">\n";
-
-        //entry node
-        *witness <<
-            "<node id=\"0\">\n"
-            "  <data key=\"entry\">true</data>\n"
-            "</node>\n";
+        WitnessWriter writer(*witness);
+        std::string edge;
+        auto enterLoopHead = [&](const llvm::Instruction *i) {
+          edge.clear();
+          WitnessWriter::addData(edge, "enterLoopHead", "true");
+          if (i)
+            if (const auto &D = i->getDebugLoc())
+              WitnessWriter::addData(edge, "startline", llvm::Twine(D.getLine()));
+        };
 
         auto testvec = m_interpreter->getTestVector(state);
 
-        int node = 0;
-        int cyclehead = 0; // id of cyclehead
-
-        //llvm::errs() << *state.lastLoopHead << "\n";
-        //llvm::errs() << *state.lastLoopCheck << "\n";
+        unsigned cyclehead = 0;
         for (auto& input : testvec) {
           const auto& name = input.getName();
           if (name.compare(0, 17 , "__VERIFIER_nondet") != 0)
               continue;
 
-          if (state.lastLoopHead && state.lastLoopHeadId == (size_t)node) {
-            cyclehead = node + 1;
-            *witness <<
-              "<node id=\""<< node + 1 << "\">\n"
-              "  <data key=\"cyclehead\">true</data>\n"
-              "</node>\n";
-            *witness << "<edge source=\"" << node <<"\" target=\"" << node + 1 << "\">\n"
-                        "  <data key=\"enterLoopHead\">true</data>\n";
-            if (const auto& D = state.lastLoopHead->getDebugLoc()) {
-              *witness << "  <data key=\"startline\">"<< D.getLine() << "</data>\n";
-            }
-            *witness << "</edge>\n";
-            ++node;
+          if (state.lastLoopHead && state.lastLoopHeadId == writer.getNode()) {
+            enterLoopHead(state.lastLoopHead);
+            writer.step(edge, "cyclehead");
+            cyclehead = writer.getNode();
           }
 
-          *witness <<
-            "<node id=\""<< node + 1 << "\"/>\n";
-          *witness <<
-            "<edge source=\"" << node <<"\" target=\"" << node + 1 << "\">\n"
-            "  <data key=\"assumption\">\\result==" << input.toString() << "</data>\n"
-            "  <data key=\"assumption.resultfunction\">" << input.getName() << "</data>\n";
-
-            if (input.line > 0) {
-              *witness << "  <data key=\"startline\">"<< input.line << "</data>\n";
-            }
-            *witness << "</edge>\n";
-          node++;
+          edge.clear();
+          WitnessWriter::addData(edge, "assumption",
+                                 "\\result==" + input.toString());
+          WitnessWriter::addData(edge, "assumption.resultfunction", name);
+          if (input.line > 0)
+            WitnessWriter::addData(edge, "startline", llvm::Twine(input.line));
+          writer.step(edge);
         }
 
         // was the loop head after all values?
-        if (state.lastLoopHead && state.lastLoopHeadId == (size_t)node) {
-          cyclehead = node + 1;
-          *witness <<
-            "<node id=\""<< node + 1 << "\">\n"
-            "  <data key=\"cyclehead\">true</data>\n"
-            "</node>\n";
-          *witness << "<edge source=\"" << node <<"\" target=\"" << node + 1 << "\">\n"
-                      "  <data key=\"enterLoopHead\">true</data>\n";
-          if (const auto& D = state.lastLoopHead->getDebugLoc()) {
-            *witness << "  <data key=\"startline\">"<< D.getLine() << "</data>\n";
-          }
-          *witness << "</edge>\n";
-          ++node;
+        if (state.lastLoopHead && state.lastLoopHeadId == writer.getNode()) {
+          enterLoopHead(state.lastLoopHead);
+          writer.step(edge, "cyclehead");
+          cyclehead = writer.getNode();
         }
 
         //error
         if (state.lastLoopHead) {
           // create cycle
-          *witness << "<edge source=\"" << node <<"\" target=\"" << cyclehead << "\">\n"
-                      "  <data key=\"enterLoopHead\">true</data>\n";
-          if (state.lastLoopCheck) {
-            if (const auto& D = state.lastLoopCheck->getDebugLoc()) {
-              *witness << "  <data key=\"startline\">"<< D.getLine() << "</data>\n";
-            }
-          }
-          *witness << "</edge>\n";
+          enterLoopHead(state.lastLoopCheck);
+          writer.loop(cyclehead, edge);
         } else if (!state.lastLoopCheck && state.lastLoopFail) {
           // FIXME: insert loop check (0) to avoid this special case
             // just generate infinite loop
-          *witness <<
-            "<node id=\""<< node + 1 << "\">\n"
-            "  <data key=\"cyclehead\">true</data>\n"
-            "</node>\n";
-          *witness << "<edge source=\"" << node <<"\" target=\"" << node + 1 << "\">\n"
-                      "  <data key=\"enterLoopHead\">true</data>\n";
-          if (const auto& D = state.lastLoopFail->getDebugLoc()) {
-            *witness << "  <data key=\"startline\">"<< D.getLine() << "</data>\n";
-          }
-          *witness << "</edge>\n";
-          *witness << "<edge source=\"" << node + 1 <<"\" target=\"" << node + 1 << "\">\n"
-                      "  <data key=\"enterLoopHead\">true</data>\n";
-          if (const auto& D = state.lastLoopFail->getDebugLoc()) {
-            *witness << "  <data key=\"startline\">"<< D.getLine() << "</data>\n";
-          }
-          *witness << "</edge>\n";
+          enterLoopHead(state.lastLoopFail);
+          writer.step(edge, "cyclehead");
+          writer.loop(writer.getNode(), edge);
         } else {
-          *witness << "<node id=\""<< node + 1 << "\">\n"
-                      "  <data key=\"violation\">true</data>\n"
-                      "</node>\n";
-          *witness << "<edge source=\"" << node <<"\" target=\"" << node + 1<< "\"/>\n";
+          writer.step("", "violation");
         }
 
-        *witness << "</graph>\n"
-                    "</graphml>\n";
+        writer.finish();
 
       } else {
         klee_warning("unable to write witness file, losing it");
@@ -873,8 +1267,7 @@ void KleeHandler::processTestCase(const ExecutionState &state,
 
     if (m_pathWriter) {
       std::vector<unsigned char> concreteBranches;
-      m_pathWriter->readStream(m_interpreter->getPathStreamID(state),
-                               concreteBranches);
+      m_interpreter->getPathBranches(state, false, concreteBranches);
       auto f = openTestFile("path", id);
       if (f) {
         for (const auto &branch : concreteBranches) {
@@ -911,8 +1304,7 @@ void KleeHandler::processTestCase(const ExecutionState &state,
 
     if (m_symPathWriter) {
       std::vector<unsigned char> symbolicBranches;
-      m_symPathWriter->readStream(m_interpreter->getSymbolicPathStreamID(state),
-                                  symbolicBranches);
+      m_interpreter->getPathBranches(state, true, symbolicBranches);
       auto f = openTestFile("sym.path", id);
       if (f) {
         for (const auto &branch : symbolicBranches) {
@@ -943,9 +1335,15 @@ void KleeHandler::processTestCase(const ExecutionState &state,
       if (f)
         *f << "Time to generate test case: " << elapsed_time << '\n';
     }
+
+    if (pending) {
+      m_pendingTestCase = nullptr;
+      m_testCaseWriter->add(std::move(pending));
+    }
   } // if (!WriteNone)
 
   if (errorMessage && OptExitOnError) {
+    waitForTestCases();
     m_interpreter->prepareForEarlyExit();
     klee_error("EXITING ON ERROR:\n%s\n", errorMessage);
   }
@@ -973,7 +1371,8 @@ void KleeHandler::getKTestFilesInDir(std::string directoryPath,
   llvm::sys::fs::directory_iterator i(directoryPath, ec), e;
   for (; i != e && !ec; i.increment(ec)) {
     auto f = i->path();
-    if (f.size() >= 6 && f.substr(f.size()-6,f.size()) == ".ktest") {
+    if ((f.size() >= 6 && f.substr(f.size()-6,f.size()) == ".ktest") ||
+        (f.size() >= 7 && f.substr(f.size()-7,f.size()) == ".ktests")) {
       results.push_back(f);
     }
   }
@@ -985,6 +1384,32 @@ void KleeHandler::getKTestFilesInDir(std::string directoryPath,
   }
 }
 
+bool KleeHandler::loadKTests(const std::string &path,
+                             std::vector<KTest *> &results) {
+  if (!kTestArchive_isArchive(path.c_str())) {
+    // the bytes of the objects are read once a state uses them
+    KTest *out = kTest_mapFile(path.c_str());
+    if (out)
+      results.push_back(out);
+    return out;
+  }
+
+  KTestArchive *archive = kTestArchive_open(path.c_str());
+  if (!archive)
+    return false;
+  bool success = true;
+  for (unsigned i = 0, e = kTestArchive_numTests(archive); i != e; ++i) {
+    KTest *out = kTestArchive_getTest(archive, i);
+    if (!out) {
+      success = false;
+      break;
+    }
+    results.push_back(out);
+  }
+  kTestArchive_close(archive);
+  return success;
+}
+
 std::string KleeHandler::getRunTimeLibraryPath(const char *argv0) {
   // allow specifying the path to the runtime library
   const char *env = getenv("KLEE_RUNTIME_LIBRARY_PATH");
@@ -1173,6 +1598,15 @@ static const char *modelledExternals[] = {
   "__VERIFIER_assume",
   "pthread_create",
   "pthread_join",
+  "pthread_exit",
+  "pthread_self",
+  "pthread_mutex_init",
+  "pthread_mutex_destroy",
+  "pthread_mutex_lock",
+  "pthread_mutex_trylock",
+  "pthread_mutex_unlock",
+  "__VERIFIER_atomic_begin",
+  "__VERIFIER_atomic_end",
   "pthread_key_create",
   "pthread_set_specific",
   "pthread_get_specific",
@@ -1371,6 +1805,227 @@ static void interrupt_handle() {
   interrupted = true;
 }
 
+/// Forks a process for each function of --batch-entry-points, running at
+/// most --batch-jobs of them at a time. \return the function to explore in a
+/// forked process, whose handler then writes to the subdirectory of the
+/// function, or an empty string in the original process once all runs are
+/// done. failed is set if a run did not exit successfully.
+static std::string forkBatchRuns(KleeHandler &handler, bool &failed) {
+  // the buffers would otherwise be written once more by every process
+  handler.getInfoStream().flush();
+  fflush(nullptr);
+
+  std::map<pid_t, std::string> running;
+  auto waitForRun = [&]() {
+    int status;
+    pid_t pid = waitpid(-1, &status, 0);
+    if (pid < 0) {
+      if (errno == EINTR)
+        return;
+      klee_error("unable to wait for batch runs: %s", strerror(errno));
+    }
+    auto it = running.find(pid);
+    if (it == running.end())
+      return;
+    std::string result;
+    if (WIFEXITED(status))
+      result = "exited with status " + std::to_string(WEXITSTATUS(status));
+    else
+      result = "was killed by signal " + std::to_string(WTERMSIG(status));
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+      failed = true;
+    klee_message("batch run of '%s' %s", it->second.c_str(), result.c_str());
+    handler.getInfoStream() << "Batch run of '" << it->second << "' " << result
+                            << '\n';
+    running.erase(it);
+  };
+
+  for (const auto &entryPoint : BatchEntryPoints) {
+    while (running.size() >= std::max(1u, unsigned(BatchJobs)))
+      waitForRun();
+    if (interrupted)
+      break;
+    pid_t pid = fork();
+    if (pid < 0)
+      klee_error("unable to fork a batch run: %s", strerror(errno));
+    if (pid == 0) {
+      handler.useSubdirectory(entryPoint);
+      handler.getInfoStream() << "Batch entry point: " << entryPoint << '\n'
+                              << "PID: " << getpid() << '\n';
+      return entryPoint;
+    }
+    running[pid] = entryPoint;
+  }
+  while (!running.empty())
+    waitForRun();
+  handler.getInfoStream().flush();
+  return "";
+}
+
+namespace {
+/// A KTest of objects owned elsewhere, which is replayed by a fuzzer or
+/// handed to the interpreter as a seed.
+struct KTestView {
+  KTest test;
+  std::vector<KTestObject> objects;
+
+  KTestView(KTestObjects &in, int argc, char **argv) {
+    objects.reserve(in.size());
+    for (auto &object : in)
+      objects.push_back({const_cast<char *>(object.first.c_str()),
+                         static_cast<unsigned>(object.second.size()),
+                         object.second.data()});
+    test.version = kTest_getCurrentVersion();
+    test.numArgs = argc;
+    test.args = argv;
+    test.symArgvs = 0;
+    test.symArgvLen = 0;
+    test.numObjects = objects.size();
+    test.objects = objects.data();
+  }
+};
+} // namespace
+
+/// Changes the bytes of an input as ktest-randgen would, and also in the
+/// ways fuzzers do: a flipped bit, a small difference or a boundary value.
+static void mutateInput(KTestObjects &input, RNG &rng) {
+  std::vector<std::vector<unsigned char> *> objects;
+  for (auto &object : input)
+    if (!object.second.empty())
+      objects.push_back(&object.second);
+  if (objects.empty())
+    return;
+
+  for (unsigned n = 1 + rng.getInt32() % 4; n; --n) {
+    std::vector<unsigned char> &bytes =
+        *objects[rng.getInt32() % objects.size()];
+    unsigned char &byte = bytes[rng.getInt32() % bytes.size()];
+    switch (rng.getInt32() % 4) {
+    case 0:
+      byte ^= 1u << (rng.getInt32() % 8);
+      break;
+    case 1:
+      byte = rng.getInt32();
+      break;
+    case 2: {
+      unsigned char delta = 1 + rng.getInt32() % 16;
+      if (rng.getBool())
+        byte += delta;
+      else
+        byte -= delta;
+      break;
+    }
+    default:
+      // zero, minus one and the limits of the signed value, whose bytes are
+      // in little-endian order as those of the nondet values
+      switch (rng.getInt32() % 4) {
+      case 0:
+        std::fill(bytes.begin(), bytes.end(), 0);
+        break;
+      case 1:
+        std::fill(bytes.begin(), bytes.end(), 0xff);
+        break;
+      case 2:
+        std::fill(bytes.begin(), bytes.end(), 0);
+        bytes.back() = 0x80;
+        break;
+      default:
+        std::fill(bytes.begin(), bytes.end(), 0xff);
+        bytes.back() = 0x7f;
+        break;
+      }
+      break;
+    }
+  }
+}
+
+/// The pipeline of --fuzz-time: rounds of concrete fuzzing, whose inputs
+/// that cover new instructions seed a symbolic exploration, whose test cases
+/// are mutated by the fuzzing of the next round. The given seeds start the
+/// corpus of inputs and seed the first exploration too.
+static void fuzzAndExplore(Interpreter &interpreter, KleeHandler &handler,
+                           Function *mainFn, int argc, char **argv,
+                           char **envp, const std::vector<KTest *> &seeds) {
+  const time::Span fuzzTime(FuzzTime);
+  std::vector<KTestObjects> corpus;
+  for (const KTest *seed : seeds) {
+    KTestObjects input;
+    for (unsigned i = 0; i < seed->numObjects; ++i) {
+      const KTestObject &object = seed->objects[i];
+      input.emplace_back(object.name,
+                         std::vector<unsigned char>(
+                             object.bytes, object.bytes + object.numBytes));
+    }
+    corpus.push_back(std::move(input));
+  }
+
+  RNG rng;
+  for (unsigned round = 0; round < FuzzRounds && !interrupted; ++round) {
+    std::vector<KTestObjects> kept;
+    std::uint64_t runs = 0;
+    interpreter.setFuzzing(true);
+    handler.collectTests(&kept);
+    const auto fuzzEnd = time::getWallTime() + fuzzTime;
+    while (!interrupted && time::getWallTime() < fuzzEnd) {
+      // all inputs are zero in the first run
+      KTestObjects input;
+      if (!corpus.empty()) {
+        input = corpus[rng.getInt32() % corpus.size()];
+        mutateInput(input, rng);
+      }
+      KTestView view(input, argc, argv);
+      auto keptBefore = kept.size();
+      auto instructionsBefore = interpreter.getRunStatistics().instructions;
+      interpreter.setReplayNondet(&view.test, true);
+      interpreter.runFunctionAsMain(mainFn, argc, argv, envp);
+      ++runs;
+      // nothing is executed once halted, e.g. by --max-time
+      if (interpreter.getRunStatistics().instructions == instructionsBefore)
+        break;
+      corpus.insert(corpus.end(), kept.begin() + keptBefore, kept.end());
+    }
+    handler.collectTests(nullptr);
+    interpreter.setReplayNondet(nullptr, false);
+    interpreter.setFuzzing(false);
+    klee_message("fuzzing round %u: %lu runs, kept %zu inputs", round + 1,
+                 (unsigned long)runs, kept.size());
+
+    // the symbolic exploration starts from the frontier of the fuzzer
+    std::vector<KTestObjects> &frontier = kept;
+    if (round == 0)
+      frontier.insert(frontier.begin(), corpus.begin(),
+                      corpus.begin() + seeds.size());
+    std::deque<KTestView> views;
+    std::vector<KTest *> seedTests;
+    for (auto &input : frontier) {
+      views.emplace_back(input, argc, argv);
+      seedTests.push_back(&views.back().test);
+    }
+    if (!seedTests.empty())
+      interpreter.useSeeds(&seedTests);
+
+    if (round + 1 == FuzzRounds) {
+      interpreter.runFunctionAsMain(mainFn, argc, argv, envp);
+    } else {
+      std::vector<KTestObjects> explored;
+      handler.collectTests(&explored);
+      interpreter.startFunctionAsMain(mainFn, argc, argv, envp);
+      const auto exploreEnd = time::getWallTime() + fuzzTime;
+      bool complete = false;
+      while (!complete && !interrupted && time::getWallTime() < exploreEnd)
+        complete = !interpreter.step(10000);
+      interpreter.finishRun();
+      // only this exploration was stopped, not the ones that follow
+      if (!complete && !interrupted)
+        interpreter.setHaltExecution(false);
+      handler.collectTests(nullptr);
+      corpus.insert(corpus.end(), std::make_move_iterator(explored.begin()),
+                    std::make_move_iterator(explored.end()));
+    }
+    interpreter.useSeeds(nullptr);
+  }
+}
+
 static void interrupt_handle_watchdog() {
   // just wait for the child to finish
 }
@@ -1522,6 +2177,36 @@ int main(int argc, char **argv, char **envp) {
     klee_error("entry-point cannot be empty");
   }
 
+  if (!BatchEntryPoints.empty()) {
+    // both wrap the one entry point in their start-up code
+    if (WithPOSIXRuntime || Libc == LibcType::UcLibc)
+      klee_error("--batch-entry-points cannot be used with --posix-runtime or "
+                 "--libc=uclibc");
+    if (!ReplayKTestDir.empty() || !ReplayKTestFile.empty())
+      klee_error("--batch-entry-points cannot be used when replaying tests");
+    std::set<std::string> entryPoints;
+    for (const auto &entryPoint : BatchEntryPoints)
+      if (entryPoint.empty() || !entryPoints.insert(entryPoint).second)
+        klee_error("invalid --batch-entry-points: '%s' is empty or repeated",
+                   entryPoint.c_str());
+  }
+
+  if (ConcreteReplay && ReplayNondets.empty())
+    klee_error("--concrete-replay used without --replay-nondets");
+
+  if (time::Span(FuzzTime)) {
+    if (!ReplayKTestDir.empty() || !ReplayKTestFile.empty() ||
+        !ReplayNondets.empty() || !ReplayPathFile.empty() ||
+        !ResumeFrom.empty())
+      klee_error("--fuzz-time cannot be used when replaying or resuming");
+    // the fuzzer mutates the inputs of the test cases
+    if (WriteNone || !WriteKTests)
+      klee_error("--fuzz-time needs the .ktest files, do not use "
+                 "--write-no-tests or --write-ktests=false");
+    if (FuzzRounds == 0)
+      klee_error("--fuzz-rounds must be at least 1");
+  }
+
   if (Watchdog) {
     if (MaxTime.empty()) {
       klee_error("--watchdog used without --max-time");
@@ -1638,7 +2323,14 @@ int main(int argc, char **argv, char **envp) {
   Interpreter::ModuleOptions Opts(LibraryDir.c_str(), EntryPoint, opt_suffix,
                                   /*Optimize=*/OptimizeModule,
                                   /*CheckDivZero=*/CheckDivZero,
-                                  /*CheckOvershift=*/CheckOvershift);
+                                  /*CheckOvershift=*/CheckOvershift,
+                                  /*NativeChecks=*/CheckMode ==
+                                      CheckModeType::Native);
+  if (!BatchEntryPoints.empty()) {
+    Opts.EntryPoint = BatchEntryPoints.front();
+    Opts.ExtraEntryPoints.assign(std::next(BatchEntryPoints.begin()),
+                                 BatchEntryPoints.end());
+  }
 
   if (WithPOSIXRuntime) {
     SmallString<128> Path(Opts.LibraryDir);
@@ -1783,15 +2475,35 @@ int main(int argc, char **argv, char **envp) {
   // locale and other data and then calls main.
 
   auto finalModule = interpreter->setModule(loadedModules, Opts);
-  Function *mainFn = finalModule->getFunction(EntryPoint);
+  Function *mainFn = finalModule->getFunction(Opts.EntryPoint);
   if (!mainFn) {
-    klee_error("Entry function '%s' not found in module.", EntryPoint.c_str());
+    klee_error("Entry function '%s' not found in module.",
+               Opts.EntryPoint.c_str());
   }
+  for (const auto &entryPoint : Opts.ExtraEntryPoints)
+    if (!finalModule->getFunction(entryPoint))
+      klee_error("Entry function '%s' not found in module.",
+                 entryPoint.c_str());
 
   handler->setModule(finalModule);
 
   externalsAndGlobalsCheck(finalModule);
 
+  if (!BatchEntryPoints.empty()) {
+    // the runs share the prepared module and the tables built from it
+    bool failed = false;
+    std::string entryPoint = forkBatchRuns(*handler, failed);
+    if (entryPoint.empty()) {
+      for (unsigned i = 0; i < InputArgv.size() + 1; i++)
+        delete[] pArgv[i];
+      delete[] pArgv;
+      delete interpreter;
+      delete handler;
+      return failed ? 1 : 0;
+    }
+    mainFn = finalModule->getFunction(entryPoint);
+  }
+
   if (ReplayPathFile != "") {
     interpreter->setReplayPath(&replayPath);
   }
@@ -1800,7 +2512,7 @@ int main(int argc, char **argv, char **envp) {
     klee_message("Replaying nondets from file '%s'", ReplayNondets.c_str());
     auto ktest = kTest_fromFile(ReplayNondets.c_str());
     assert(ktest && "Failed parsing ktest");
-    interpreter->setReplayNondet(ktest);
+    interpreter->setReplayNondet(ktest, ConcreteReplay);
     kTest_free(ktest);
   }
 
@@ -1827,12 +2539,8 @@ int main(int argc, char **argv, char **envp) {
     for (std::vector<std::string>::iterator
            it = kTestFiles.begin(), ie = kTestFiles.end();
          it != ie; ++it) {
-      KTest *out = kTest_fromFile(it->c_str());
-      if (out) {
-        kTests.push_back(out);
-      } else {
+      if (!KleeHandler::loadKTests(*it, kTests))
         klee_warning("unable to open: %s\n", (*it).c_str());
-      }
     }
 
     if (RunInDir != "") {
@@ -1851,7 +2559,7 @@ int main(int argc, char **argv, char **envp) {
       interpreter->setReplayKTest(out);
       llvm::errs() << "KLEE: replaying: " << *it << " (" << kTest_numBytes(out)
                    << " bytes)"
-                   << " (" << ++i << "/" << kTestFiles.size() << ")\n";
+                   << " (" << ++i << "/" << kTests.size() << ")\n";
       // XXX should put envp in .ktest ?
       interpreter->runFunctionAsMain(mainFn, out->numArgs, out->args, pEnvp);
       if (interrupted) break;
@@ -1866,11 +2574,9 @@ int main(int argc, char **argv, char **envp) {
     for (std::vector<std::string>::iterator
            it = SeedOutFile.begin(), ie = SeedOutFile.end();
          it != ie; ++it) {
-      KTest *out = kTest_fromFile(it->c_str());
-      if (!out) {
+      if (!KleeHandler::loadKTests(*it, seeds)) {
         klee_error("unable to open: %s\n", (*it).c_str());
       }
-      seeds.push_back(out);
     }
     for (std::vector<std::string>::iterator
            it = SeedOutDir.begin(), ie = SeedOutDir.end();
@@ -1880,21 +2586,27 @@ int main(int argc, char **argv, char **envp) {
       for (std::vector<std::string>::iterator
              it2 = kTestFiles.begin(), ie = kTestFiles.end();
            it2 != ie; ++it2) {
-        KTest *out = kTest_fromFile(it2->c_str());
-        if (!out) {
+        if (!KleeHandler::loadKTests(*it2, seeds)) {
           klee_error("unable to open: %s\n", (*it2).c_str());
         }
-        seeds.push_back(out);
       }
       if (kTestFiles.empty()) {
         klee_error("seeds directory is empty: %s\n", (*it).c_str());
       }
     }
 
-    if (!seeds.empty()) {
+    // the fuzzer's corpus starts with the seeds
+    const bool fuzzing = bool(time::Span(FuzzTime));
+    if (!seeds.empty() && !fuzzing) {
       klee_message("KLEE: using %lu seeds\n", seeds.size());
       interpreter->useSeeds(&seeds);
     }
+    if (!ResumeFrom.empty()) {
+      // read once the run starts, maybe in --run-in-dir
+      SmallString<128> path(ResumeFrom);
+      sys::fs::make_absolute(path);
+      interpreter->setResumeCheckpoint(path.str().str());
+    }
     if (RunInDir != "") {
       int res = chdir(RunInDir.c_str());
       if (res < 0) {
@@ -1902,7 +2614,11 @@ int main(int argc, char **argv, char **envp) {
                    sys::StrError(errno).c_str());
       }
     }
-    interpreter->runFunctionAsMain(mainFn, pArgc, pArgv, pEnvp);
+    if (fuzzing)
+      fuzzAndExplore(*interpreter, *handler, mainFn, pArgc, pArgv, pEnvp,
+                     seeds);
+    else
+      interpreter->runFunctionAsMain(mainFn, pArgc, pArgv, pEnvp);
 
     while (!seeds.empty()) {
       kTest_free(seeds.back());
@@ -1950,6 +2666,42 @@ int main(int argc, char **argv, char **envp) {
     *theStatisticManager->getStatisticByName("Instructions");
   uint64_t forks =
     *theStatisticManager->getStatisticByName("Forks");
+  uint64_t concreteInstructions =
+    *theStatisticManager->getStatisticByName("ConcreteInstructions");
+  uint64_t boundsChecksFolded =
+    *theStatisticManager->getStatisticByName("BoundsChecksFolded");
+  uint64_t boundsChecksQueried =
+    *theStatisticManager->getStatisticByName("BoundsChecksQueried");
+  uint64_t boundsChecksCached =
+    *theStatisticManager->getStatisticByName("BoundsChecksCached");
+  uint64_t boundsChecksStatic =
+    *theStatisticManager->getStatisticByName("BoundsChecksStatic");
+  uint64_t forkModelHits =
+    *theStatisticManager->getStatisticByName("ForkModelHits");
+  uint64_t forkModelMisses =
+    *theStatisticManager->getStatisticByName("ForkModelMisses");
+  uint64_t seededBranches =
+    *theStatisticManager->getStatisticByName("SeededBranches");
+  uint64_t cachedExternalCalls =
+    *theStatisticManager->getStatisticByName("CachedExternalCalls");
+  uint64_t externalStubTime =
+    *theStatisticManager->getStatisticByName("ExternalStubTime");
+  uint64_t loadedExternalStubs =
+    *theStatisticManager->getStatisticByName("LoadedExternalStubs");
+  uint64_t affinitySelections =
+    *theStatisticManager->getStatisticByName("AffinitySelections");
+  uint64_t z3IncrementalContextHits =
+    *theStatisticManager->getStatisticByName("Z3IncrementalContextHits");
+  uint64_t z3IncrementalContextMisses =
+    *theStatisticManager->getStatisticByName("Z3IncrementalContextMisses");
+  uint64_t memoizedCallHits =
+    *theStatisticManager->getStatisticByName("MemoizedCallHits");
+  uint64_t memoizedCallsRecorded =
+    *theStatisticManager->getStatisticByName("MemoizedCallsRecorded");
+  uint64_t releasedCacheBytes =
+    *theStatisticManager->getStatisticByName("ReleasedCacheBytes");
+  uint64_t batchedNondetValues =
+    *theStatisticManager->getStatisticByName("BatchedNondetValues");
 
   handler->getInfoStream()
     << "KLEE: done: explored paths = " << 1 + forks << "\n";
@@ -1964,7 +2716,33 @@ int main(int argc, char **argv, char **envp) {
     << "KLEE: done: total queries = " << queries << "\n"
     << "KLEE: done: valid queries = " << queriesValid << "\n"
     << "KLEE: done: invalid queries = " << queriesInvalid << "\n"
-    << "KLEE: done: query cex = " << queryCounterexamples << "\n";
+    << "KLEE: done: query cex = " << queryCounterexamples << "\n"
+    << "KLEE: done: concrete fast-path instructions = "
+    << concreteInstructions << "\n"
+    << "KLEE: done: bounds checks folded = " << boundsChecksFolded << "\n"
+    << "KLEE: done: bounds checks queried = " << boundsChecksQueried << "\n"
+    << "KLEE: done: bounds checks cached = " << boundsChecksCached << "\n"
+    << "KLEE: done: bounds checks proven statically = " << boundsChecksStatic
+    << "\n"
+    << "KLEE: done: forks decided with model = " << forkModelHits << "\n"
+    << "KLEE: done: forks decided without model = " << forkModelMisses
+    << "\n"
+    << "KLEE: done: branches decided by seeds = " << seededBranches << "\n"
+    << "KLEE: done: cached external calls = " << cachedExternalCalls << "\n"
+    << "KLEE: done: external call stub time (us) = " << externalStubTime
+    << "\n"
+    << "KLEE: done: external call stubs loaded = " << loadedExternalStubs
+    << "\n"
+    << "KLEE: done: memoized calls answered = " << memoizedCallHits << "\n"
+    << "KLEE: done: memoized calls recorded = " << memoizedCallsRecorded
+    << "\n"
+    << "KLEE: done: selections kept in lineage = " << affinitySelections
+    << "\n"
+    << "KLEE: done: solver context hits = " << z3IncrementalContextHits << "\n"
+    << "KLEE: done: solver context misses = " << z3IncrementalContextMisses
+    << "\n"
+    << "KLEE: done: cache bytes released = " << releasedCacheBytes << "\n"
+    << "KLEE: done: batched nondet values = " << batchedNondetValues << "\n";
 
   std::stringstream stats;
   stats << '\n'
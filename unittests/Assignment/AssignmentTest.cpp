@@ -2,6 +2,8 @@
 
 #include "klee/Expr/ArrayCache.h"
 #include "klee/Expr/Assignment.h"
+#include "klee/Expr/AssignmentBatch.h"
+#include "klee/Expr/ExprTape.h"
 
 #include <iostream>
 #include <vector>
@@ -87,3 +89,155 @@ TEST(AssignmentTest, CompactModelAsVector)
   ASSERT_EQ(vec[31], 0);
   ASSERT_EQ(vec[32], 32);
 }
+
+TEST(AssignmentTest, BindingsOfManyArrays)
+{
+  ArrayCache ac;
+  std::vector<const Array *> arrays;
+  for (unsigned i = 0; i != 20; ++i)
+    arrays.push_back(ac.CreateArray("array" + std::to_string(i), 4));
+  // the same symbolic array and distinct ones have the same and new IDs
+  ASSERT_EQ(ac.CreateArray("array3", 4), arrays[3]);
+  for (unsigned i = 1; i != arrays.size(); ++i)
+    ASSERT_LT(arrays[i - 1]->getID(), arrays[i]->getID());
+
+  // bound out of order, every other one
+  Assignment a;
+  for (unsigned i = 0; i != arrays.size(); i += 2) {
+    unsigned j = (i * 7) % arrays.size();
+    a.addBinding(arrays[j], {static_cast<unsigned char>(j), 1, 2, 3});
+  }
+  Assignment::map_bindings_ty models;
+  for (unsigned i = arrays.size(); i-- != 0;)
+    if (i % 2 == 0)
+      models[arrays[i]].add(0, i);
+  Assignment b(models);
+
+  for (unsigned i = 0; i != arrays.size(); ++i) {
+    ASSERT_EQ(a.hasBindings(arrays[i]), i % 2 == 0);
+    ASSERT_EQ(b.getBindingsOrNull(arrays[i]) != nullptr, i % 2 == 0);
+    ASSERT_EQ(a.getValue(arrays[i], 0), i % 2 == 0 ? i : 0);
+    ASSERT_EQ(b.getValue(arrays[i], 0), i % 2 == 0 ? i : 0);
+    ASSERT_EQ(a.getValue(arrays[i], 3), i % 2 == 0 ? 3 : 0);
+  }
+}
+
+namespace {
+
+/// Expressions with every kind of operation over array, whose outcome
+/// depends on the assignment. The last one is wider than 64 bits.
+std::vector<ref<Expr>> makeMixedExprs(const Array *array) {
+  auto read = [&](const UpdateList &ul, unsigned index) {
+    return ReadExpr::create(ul, ConstantExpr::alloc(index, Expr::Int32));
+  };
+  UpdateList ul(array, nullptr);
+  ref<Expr> x = ConcatExpr::createN(4, std::vector<ref<Expr>>{
+      read(ul, 3), read(ul, 2), read(ul, 1), read(ul, 0)}.data());
+  ref<Expr> y = ZExtExpr::create(read(ul, 4), Expr::Int32);
+  ref<Expr> z = SExtExpr::create(read(ul, 5), Expr::Int32);
+  ref<Expr> wide = SExtExpr::create(x, Expr::Int64);
+  // a write at a symbolic index
+  UpdateList written(array, nullptr);
+  written.extend(AndExpr::create(ZExtExpr::create(read(ul, 6), Expr::Int32),
+                                 ConstantExpr::alloc(3, Expr::Int32)),
+                 read(ul, 7));
+  ref<Expr> c = ConstantExpr::alloc(0x7fffffff, Expr::Int32);
+
+  return {
+      UltExpr::create(x, c),
+      SltExpr::create(z, y),
+      SleExpr::create(SubExpr::create(y, z), MulExpr::create(x, z)),
+      UltExpr::create(UDivExpr::create(x, y),
+                      ConstantExpr::alloc(0x1000000, Expr::Int32)),
+      NeExpr::create(URemExpr::create(x, z), y),
+      SltExpr::create(SDivExpr::create(x, z), y),
+      UleExpr::create(SRemExpr::create(z, y), x),
+      UltExpr::create(ShlExpr::create(x, y), c),
+      SleExpr::create(AShrExpr::create(z, y), LShrExpr::create(x, y)),
+      EqExpr::create(ExtractExpr::create(XorExpr::create(x, z), 8, Expr::Int8),
+                     read(ul, 2)),
+      SelectExpr::create(UltExpr::create(y, z), EqExpr::create(x, c),
+                         NeExpr::create(AndExpr::create(x, z),
+                                        OrExpr::create(y, c))),
+      EqExpr::create(read(written, 3), read(ul, 7)),
+      SltExpr::create(
+          MulExpr::create(wide, SExtExpr::create(z, Expr::Int64)),
+          ConstantExpr::alloc(0, Expr::Int64)),
+      UltExpr::create(ZExtExpr::create(x, 128),
+                      ConcatExpr::create(wide, wide)),
+  };
+}
+
+std::vector<Assignment> makeAssignments(const Array *array, unsigned n) {
+  std::vector<Assignment> assignments;
+  unsigned seed = 1;
+  for (unsigned i = 0; i != n; ++i) {
+    std::vector<unsigned char> values;
+    for (unsigned j = 0; j != array->size; ++j) {
+      seed = seed * 1103515245 + 12345;
+      // plenty of zeros and small indices
+      values.push_back((seed >> 16) % 3 ? (seed >> 8) & 0xff : j % 2);
+    }
+    assignments.emplace_back();
+    assignments.back().addBinding(array, values);
+  }
+  return assignments;
+}
+
+} // namespace
+
+TEST(AssignmentTest, BatchEvaluatesLikeAssignments)
+{
+  ArrayCache ac;
+  const Array *array = ac.CreateArray("batch_array", /*size=*/8);
+  std::vector<ref<Expr>> exprs = makeMixedExprs(array);
+  std::vector<Assignment> assignments =
+      makeAssignments(array, AssignmentBatch::MaxLanes);
+  std::vector<const Assignment *> lanes;
+  for (const Assignment &a : assignments)
+    lanes.push_back(&a);
+
+  AssignmentBatch batch(lanes);
+  for (const ref<Expr> &e : exprs) {
+    uint64_t satisfying = batch.satisfies(&e, &e + 1);
+    for (unsigned i = 0; i != lanes.size(); ++i)
+      EXPECT_EQ(assignments[i].satisfies(&e, &e + 1),
+                ((satisfying >> i) & 1) != 0);
+  }
+
+  uint64_t satisfyingAll = batch.satisfies(exprs.begin(), exprs.begin() + 3);
+  for (unsigned i = 0; i != lanes.size(); ++i)
+    EXPECT_EQ(assignments[i].satisfies(exprs.begin(), exprs.begin() + 3),
+              ((satisfyingAll >> i) & 1) != 0);
+}
+
+TEST(AssignmentTest, TapeEvaluatesLikeAssignments)
+{
+  ArrayCache ac;
+  const Array *array = ac.CreateArray("tape_array", /*size=*/8);
+  std::vector<ref<Expr>> exprs = makeMixedExprs(array);
+  std::vector<Assignment> assignments = makeAssignments(array, 64);
+
+  ExprTape tape;
+  ASSERT_FALSE(tape.compile(exprs.back()));
+  exprs.pop_back();
+  for (const ref<Expr> &e : exprs) {
+    ASSERT_TRUE(tape.compile(e));
+    for (const Assignment &a : assignments) {
+      uint64_t value;
+      bool evaluated = tape.evaluate(a, value);
+      EXPECT_EQ(a.satisfies(&e, &e + 1), evaluated && value);
+    }
+  }
+
+  // values of non-boolean expressions
+  ref<Expr> sum = AddExpr::create(
+      cast<BinaryExpr>(exprs[2])->right,
+      ZExtExpr::create(cast<BinaryExpr>(exprs[9])->left, Expr::Int32));
+  ASSERT_TRUE(tape.compile(sum));
+  for (const Assignment &a : assignments) {
+    uint64_t value;
+    ASSERT_TRUE(tape.evaluate(a, value));
+    EXPECT_EQ(cast<ConstantExpr>(a.evaluate(sum))->getZExtValue(), value);
+  }
+}
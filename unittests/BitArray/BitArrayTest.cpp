@@ -0,0 +1,42 @@
+#include "klee/ADT/BitArray.h"
+#include "gtest/gtest.h"
+
+using namespace klee;
+
+namespace {
+
+TEST(BitArrayTest, RangeQueries) {
+  BitArray bits(100);
+  for (unsigned i = 0; i < 100; ++i)
+    ASSERT_FALSE(bits.get(i));
+  ASSERT_EQ(100u, bits.findFirstSet(0, 100));
+  ASSERT_FALSE(bits.anySet(0, 100));
+  ASSERT_TRUE(bits.allSet(5, 5));
+
+  bits.setRange(3, 70);
+  for (unsigned i = 0; i < 100; ++i)
+    ASSERT_EQ(i >= 3 && i < 70, bits.get(i)) << i;
+  ASSERT_TRUE(bits.allSet(3, 70));
+  ASSERT_FALSE(bits.allSet(2, 70));
+  ASSERT_FALSE(bits.allSet(3, 71));
+  ASSERT_EQ(3u, bits.findFirstSet(0, 100));
+  ASSERT_EQ(40u, bits.findFirstSet(40, 100));
+  ASSERT_EQ(70u, bits.findFirstUnset(3, 100));
+  ASSERT_EQ(60u, bits.findFirstUnset(3, 60));
+  ASSERT_FALSE(bits.anySet(70, 100));
+
+  bits.unsetRange(31, 33);
+  ASSERT_EQ(31u, bits.findFirstUnset(3, 100));
+  ASSERT_EQ(33u, bits.findFirstSet(31, 100));
+  ASSERT_TRUE(bits.get(30) && !bits.get(31) && !bits.get(32) && bits.get(33));
+}
+
+TEST(BitArrayTest, ResizeToZero) {
+  BitArray bits(10, true);
+  bits.resize(0);
+  ASSERT_EQ(0u, bits.size());
+  bits.resize(40, true);
+  ASSERT_TRUE(bits.allSet(0, 40));
+}
+
+} // namespace
@@ -1,4 +1,5 @@
 #include "klee/ADT/DiscretePDF.h"
+#include "klee/ADT/FlatDiscretePDF.h"
 #include "gtest/gtest.h"
 #include <iostream>
 #include <vector>
@@ -56,3 +57,37 @@ TEST(DiscretePDFTest, Rotatation) {
   ASSERT_EQ(1, testTree.getWeight(1));
   ASSERT_EQ(2, testTree.getWeight(2));
 }
+
+TEST(DiscretePDFTest, Flat) {
+  FlatDiscretePDF<int> testTree;
+
+  ASSERT_TRUE(testTree.empty());
+
+  // enough items to grow the tree a few times
+  for (auto i = 0; i < 100; ++i)
+    testTree.insert(i, i % 2 ? 1. : 0.);
+  ASSERT_FALSE(testTree.empty());
+
+  // only odd items have a weight
+  for (auto i = 0; i < 100; ++i)
+    ASSERT_EQ(1, testTree.choose(i / 100.) % 2);
+  ASSERT_EQ(99, testTree.choose(0.9999999));
+
+  ASSERT_TRUE(testTree.inTree(51));
+  testTree.remove(51);
+  ASSERT_FALSE(testTree.inTree(51));
+  ASSERT_EQ(1., testTree.getWeight(99));
+
+  for (auto i = 0; i < 100; ++i)
+    if (i != 51)
+      testTree.update(i, i == 42 ? 1. : 0.);
+  ASSERT_EQ(42, testTree.choose(0));
+  ASSERT_EQ(42, testTree.choose(0.9999999));
+
+#ifndef NDEBUG
+  ASSERT_DEATH({ testTree.insert(42, 0); }, "already in tree");
+#endif
+
+  while (!testTree.empty())
+    testTree.remove(testTree.choose(0.5));
+}
@@ -13,6 +13,7 @@
 #include "klee/Expr/ArrayExprOptimizer.h"
 #include "klee/Expr/Assignment.h"
 #include "klee/Expr/Expr.h"
+#include "klee/Expr/ExprStats.h"
 
 #include <llvm/Support/CommandLine.h>
 
@@ -21,6 +22,7 @@
 using namespace klee;
 namespace klee {
 extern llvm::cl::opt<ArrayOptimizationType> OptimizeArray;
+extern llvm::cl::opt<unsigned> OptimizeArrayCacheSize;
 }
 
 namespace {
@@ -74,4 +76,39 @@ TEST(ArrayExprTest, HashCollisions) {
   EXPECT_EQ(a->evaluate(oUpdatedRead), getConstant(42, Expr::Int8));
   EXPECT_EQ(a->evaluate(oFirstRead), getConstant(5, Expr::Int8));
 }
+
+TEST(ArrayExprTest, BoundedResultCache) {
+  klee::OptimizeArray = ALL;
+  klee::OptimizeArrayCacheSize = 1;
+  std::vector<ref<ConstantExpr>> constVals;
+  for (unsigned i = 0; i < 16; ++i)
+    constVals.push_back(ConstantExpr::create(i % 3, Expr::Int8));
+  const Array *array = ac.CreateArray("arr1", 16, constVals.data(),
+                                      constVals.data() + constVals.size(),
+                                      Expr::Int32, Expr::Int8);
+  const Array *symArray = ac.CreateArray("symIdx1", 4);
+  ref<Expr> symIdx = Expr::createTempRead(symArray, Expr::Int32);
+  ref<Expr> read = ReadExpr::create(UpdateList(array, 0), symIdx);
+  ref<Expr> other =
+      ReadExpr::create(UpdateList(array, 0),
+                       AddExpr::create(symIdx, getConstant(1, Expr::Int32)));
+
+  ExprOptimizer opt;
+  uint64_t hits = stats::arrayOptimizerCacheHits;
+  uint64_t misses = stats::arrayOptimizerCacheMisses;
+  ref<Expr> optimized = opt.optimizeExpr(read, true);
+  EXPECT_NE(read, optimized);
+  // structurally equal expressions share the result
+  ref<Expr> copy = ReadExpr::create(UpdateList(array, 0), symIdx);
+  EXPECT_EQ(optimized, opt.optimizeExpr(copy, true));
+  EXPECT_EQ(hits + 1, stats::arrayOptimizerCacheHits);
+  EXPECT_EQ(misses + 1, stats::arrayOptimizerCacheMisses);
+
+  // evicts the result for read
+  opt.optimizeExpr(other, true);
+  EXPECT_EQ(optimized, opt.optimizeExpr(read, true));
+  EXPECT_EQ(hits + 1, stats::arrayOptimizerCacheHits);
+  EXPECT_EQ(misses + 3, stats::arrayOptimizerCacheMisses);
+  klee::OptimizeArrayCacheSize = 4096;
+}
 }
@@ -0,0 +1,176 @@
+//===-- BinaryQueryLogTest.cpp --------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+
+#include "klee/Expr/ArrayCache.h"
+#include "klee/Expr/BinaryQueryLog.h"
+#include "klee/Expr/Expr.h"
+#include "klee/Expr/ExprBuilder.h"
+
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <memory>
+#include <string>
+
+using namespace klee;
+
+namespace {
+
+std::string toString(const ref<Expr> &e) {
+  std::string s;
+  llvm::raw_string_ostream os(s);
+  os << e;
+  return os.str();
+}
+
+struct LoggedQueries {
+  ArrayCache arrays;
+  const Array *table, *input;
+  LoggedQuery first, second;
+
+  LoggedQueries() {
+    std::vector<ref<ConstantExpr>> values;
+    for (unsigned i = 0; i != 8; ++i)
+      values.push_back(ConstantExpr::create(3 * i, Expr::Int8));
+    table = arrays.CreateArray("table", 8, values.data(),
+                               values.data() + values.size());
+    input = arrays.CreateArray("input", 4);
+
+    ref<Expr> index = ZExtExpr::create(
+        ReadExpr::create(UpdateList(input, 0),
+                         ConstantExpr::create(0, Expr::Int32)),
+        Expr::Int32);
+    UpdateList updated(table, 0);
+    updated.extend(ConstantExpr::create(1, Expr::Int32), ExtractExpr::create(
+        index, 0, Expr::Int8));
+    ref<Expr> read = ReadExpr::create(updated, index);
+    ref<Expr> wide = ConcatExpr::create(Expr::createTempRead(input, 64),
+                                        ConstantExpr::create(7, Expr::Int64));
+
+    first.constraints = {UltExpr::create(index, ConstantExpr::create(
+                                                    8, Expr::Int32))};
+    first.expr = EqExpr::create(read, ConstantExpr::create(9, Expr::Int8));
+    first.objects = {input};
+    first.comment = "# Query 0 -- Type: InitialValues\n";
+
+    second.constraints = {first.constraints[0], first.expr};
+    second.expr = ConstantExpr::create(0, Expr::Bool);
+    second.values = {SExtExpr::create(read, Expr::Int32),
+                     AddExpr::create(wide, wide)};
+  }
+
+  std::string write(bool close) {
+    std::string log;
+    llvm::raw_string_ostream os(log);
+    BinaryQueryLogWriter writer(os);
+    writer.writeQuery(first);
+    writer.writeQuery(second);
+    if (close) {
+      writer.close();
+      return os.str();
+    }
+    os.flush();
+    // what is on disk when the writer does not close the log
+    return std::string(log);
+  }
+};
+
+void expectEqual(const LoggedQuery &expected, const LoggedQuery &actual) {
+  ASSERT_EQ(expected.constraints.size(), actual.constraints.size());
+  for (unsigned i = 0; i != expected.constraints.size(); ++i)
+    EXPECT_EQ(toString(expected.constraints[i]),
+              toString(actual.constraints[i]));
+  EXPECT_EQ(toString(expected.expr), toString(actual.expr));
+  ASSERT_EQ(expected.values.size(), actual.values.size());
+  for (unsigned i = 0; i != expected.values.size(); ++i)
+    EXPECT_EQ(toString(expected.values[i]), toString(actual.values[i]));
+  ASSERT_EQ(expected.objects.size(), actual.objects.size());
+  for (unsigned i = 0; i != expected.objects.size(); ++i)
+    EXPECT_EQ(expected.objects[i]->name, actual.objects[i]->name);
+  EXPECT_EQ(expected.comment, actual.comment);
+}
+
+TEST(BinaryQueryLogTest, RoundTrip) {
+  LoggedQueries queries;
+  std::string log = queries.write(true);
+  auto buffer = llvm::MemoryBuffer::getMemBuffer(log, "", false);
+  ASSERT_TRUE(BinaryQueryLogReader::isBinaryQueryLog(buffer->getBuffer()));
+
+  ArrayCache arrays;
+  std::unique_ptr<ExprBuilder> builder(createDefaultExprBuilder());
+  BinaryQueryLogReader reader(*buffer, arrays, builder.get());
+  std::string error;
+  ASSERT_TRUE(reader.open(error)) << error;
+  ASSERT_EQ(2u, reader.getNumQueries());
+
+  // out of order, sharing the nodes built for the second query
+  LoggedQuery second, first;
+  ASSERT_TRUE(reader.readQuery(1, second, error)) << error;
+  ASSERT_TRUE(reader.readQuery(0, first, error)) << error;
+  expectEqual(queries.second, second);
+  expectEqual(queries.first, first);
+  EXPECT_EQ(first.constraints[0].get(), second.constraints[0].get());
+
+  const Array *table =
+      cast<ReadExpr>(second.values[0]->getKid(0))->updates.root;
+  ASSERT_TRUE(table->isConstantArray());
+  EXPECT_EQ(queries.table->getConstantValues().size(),
+            table->getConstantValues().size());
+  for (unsigned i = 0; i != 8; ++i)
+    EXPECT_EQ(3 * i, table->getConstantValue(i)->getZExtValue());
+}
+
+TEST(BinaryQueryLogTest, SharedNodesAreWrittenOnce) {
+  LoggedQueries queries;
+  std::string once = queries.write(true);
+  queries.second.values.push_back(queries.second.values[0]);
+  std::string twice = queries.write(true);
+  // a repeated value is only referred to again
+  EXPECT_LE(twice.size(), once.size() + 1);
+}
+
+TEST(BinaryQueryLogTest, ScansUnclosedLog) {
+  LoggedQueries queries;
+  std::string log = queries.write(false);
+  // a record cut short by a crash
+  log += std::string("e\x02\x05", 3);
+  auto buffer = llvm::MemoryBuffer::getMemBuffer(log, "", false);
+
+  ArrayCache arrays;
+  std::unique_ptr<ExprBuilder> builder(createDefaultExprBuilder());
+  BinaryQueryLogReader reader(*buffer, arrays, builder.get());
+  std::string error;
+  ASSERT_TRUE(reader.open(error)) << error;
+  ASSERT_EQ(2u, reader.getNumQueries());
+  LoggedQuery second;
+  ASSERT_TRUE(reader.readQuery(1, second, error)) << error;
+  expectEqual(queries.second, second);
+}
+
+TEST(BinaryQueryLogTest, RejectsMalformedLog) {
+  auto text = llvm::MemoryBuffer::getMemBuffer("(query [] false)", "", false);
+  ArrayCache arrays;
+  std::unique_ptr<ExprBuilder> builder(createDefaultExprBuilder());
+  std::string error;
+  EXPECT_FALSE(BinaryQueryLogReader(*text, arrays, builder.get()).open(error));
+
+  LoggedQueries queries;
+  std::string log = queries.write(true);
+  // a query referring to a node although none was written
+  std::string corrupt =
+      log.substr(0, 8) + std::string("q\x01\x00\x01\x05\x00", 6);
+  auto buffer = llvm::MemoryBuffer::getMemBuffer(corrupt, "", false);
+  BinaryQueryLogReader reader(*buffer, arrays, builder.get());
+  ASSERT_TRUE(reader.open(error)) << error;
+  EXPECT_EQ(0u, reader.getNumQueries());
+}
+
+} // namespace
@@ -0,0 +1,90 @@
+//===-- ConstraintRangesTest.cpp ------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+
+#include "klee/Expr/ArrayCache.h"
+#include "klee/Expr/ConstraintRanges.h"
+#include "klee/Expr/Expr.h"
+
+using namespace klee;
+
+namespace {
+
+struct Ranges : public ::testing::Test {
+  ArrayCache arrays;
+  ref<Expr> x, y;
+
+  Ranges() {
+    const Array *array = arrays.CreateArray("arr", 8);
+    x = Expr::createTempRead(array, 32);
+    y = ReadExpr::create(UpdateList(array, 0),
+                         ConstantExpr::create(4, Expr::Int32));
+  }
+
+  static ref<Expr> constant(uint64_t value, Expr::Width width = Expr::Int32) {
+    return ConstantExpr::create(value, width);
+  }
+};
+
+TEST_F(Ranges, DecidesComparisonsAgainstBounds) {
+  ConstraintRanges ranges;
+  EXPECT_FALSE(ranges.decide(UltExpr::create(x, constant(10))));
+
+  ranges.learn(UltExpr::create(x, constant(10)));
+  EXPECT_EQ(true, ranges.decide(UltExpr::create(x, constant(20))));
+  EXPECT_EQ(false, ranges.decide(EqExpr::create(constant(15), x)));
+  EXPECT_FALSE(ranges.decide(UltExpr::create(x, constant(5))));
+
+  // x + 5 cannot wrap around
+  ref<Expr> sum = AddExpr::create(x, constant(5));
+  EXPECT_EQ(true, ranges.decide(UleExpr::create(sum, constant(14))));
+  EXPECT_FALSE(ranges.decide(UleExpr::create(sum, constant(13))));
+}
+
+TEST_F(Ranges, LearnsNegationsAndConjunctions) {
+  ConstraintRanges ranges;
+  // !(x <= 3) && 100 <= x is x in [100, 2^32)
+  ranges.learn(AndExpr::create(
+      Expr::createIsZero(UleExpr::create(x, constant(3))),
+      UleExpr::create(constant(100), x)));
+  EXPECT_EQ(false, ranges.decide(UltExpr::create(x, constant(100))));
+  EXPECT_EQ(true, ranges.decide(UltExpr::create(constant(99), x)));
+
+  // y != 0
+  ranges.learn(Expr::createIsZero(EqExpr::create(constant(0, Expr::Int8), y)));
+  EXPECT_EQ(false, ranges.decide(EqExpr::create(constant(0, Expr::Int8), y)));
+  EXPECT_FALSE(ranges.decide(EqExpr::create(constant(1, Expr::Int8), y)));
+}
+
+TEST_F(Ranges, CopiesAreIndependent) {
+  ConstraintRanges ranges;
+  ranges.learn(UltExpr::create(x, constant(10)));
+  ConstraintRanges copy = ranges;
+  copy.learn(UltExpr::create(constant(4), x));
+
+  ref<Expr> small = UleExpr::create(x, constant(4));
+  EXPECT_EQ(false, copy.decide(small));
+  EXPECT_FALSE(ranges.decide(small));
+}
+
+TEST_F(Ranges, IgnoresInfeasibleAndWideConstraints) {
+  ConstraintRanges ranges;
+  ranges.learn(UltExpr::create(x, constant(10)));
+  // contradicts the bounds, the solver will find the path infeasible
+  ranges.learn(UltExpr::create(constant(20), x));
+  EXPECT_EQ(true, ranges.decide(UltExpr::create(x, constant(10))));
+
+  ref<Expr> wide = ConcatExpr::create(x, ZExtExpr::create(x, Expr::Int64));
+  ranges.learn(UltExpr::create(wide, ConstantExpr::create(10, 96)));
+  EXPECT_FALSE(
+      ranges.decide(UltExpr::create(wide, ConstantExpr::create(20, 96))));
+}
+
+} // namespace
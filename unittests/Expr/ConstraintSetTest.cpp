@@ -0,0 +1,199 @@
+//===-- ConstraintSetTest.cpp ---------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+
+#include "klee/Expr/ArrayCache.h"
+#include "klee/Expr/Assignment.h"
+#include "klee/Expr/Constraints.h"
+#include "klee/Expr/Expr.h"
+#include "klee/Expr/ExprUtil.h"
+#include "klee/Expr/IndependentSet.h"
+
+#include <vector>
+
+using namespace klee;
+
+namespace {
+
+std::vector<ref<Expr>> toVector(const ConstraintSet &cs) {
+  return std::vector<ref<Expr>>(cs.begin(), cs.end());
+}
+
+TEST(ConstraintSetTest, ForkedSetsShareTheirPrefix) {
+  ArrayCache ac;
+  const Array *array = ac.CreateArray("arr", 4);
+  ref<Expr> x = Expr::createTempRead(array, 32);
+
+  std::vector<ref<Expr>> expected;
+  ConstraintSet parent;
+  for (unsigned i = 0; i < 100; ++i) {
+    ref<Expr> c = UltExpr::create(x, ConstantExpr::alloc(1000 + i, 32));
+    parent.push_back(c);
+    expected.push_back(c);
+  }
+
+  ConstraintSet left(parent), right(parent);
+  ref<Expr> l = EqExpr::create(x, ConstantExpr::alloc(1, 32));
+  ref<Expr> r = EqExpr::create(x, ConstantExpr::alloc(2, 32));
+  left.push_back(l);
+  right.push_back(r);
+
+  EXPECT_EQ(toVector(parent), expected);
+  expected.push_back(l);
+  EXPECT_EQ(toVector(left), expected);
+  expected.back() = r;
+  EXPECT_EQ(toVector(right), expected);
+
+  EXPECT_EQ(parent.size(), 100u);
+  EXPECT_EQ(left.size(), 101u);
+  EXPECT_FALSE(left == right);
+
+  ConstraintSet rebuilt(expected);
+  EXPECT_TRUE(rebuilt == right);
+  EXPECT_EQ(rebuilt.hash(), right.hash());
+}
+
+TEST(ConstraintSetTest, IndependentFactorsAreMergedAndShared) {
+  ArrayCache ac;
+  const Array *a = ac.CreateArray("a", 4);
+  const Array *b = ac.CreateArray("b", 4);
+  ref<Expr> a0 = ReadExpr::create(UpdateList(a, 0), ConstantExpr::alloc(0, 32));
+  ref<Expr> a1 = ReadExpr::create(UpdateList(a, 0), ConstantExpr::alloc(1, 32));
+  ref<Expr> b0 = ReadExpr::create(UpdateList(b, 0), ConstantExpr::alloc(0, 32));
+  ref<Expr> zero = ConstantExpr::alloc(0, Expr::Int8);
+
+  ConstraintSet parent;
+  parent.push_back(UltExpr::create(zero, a0));
+  parent.trackIndependence();
+  parent.push_back(UltExpr::create(zero, a1));
+  parent.push_back(UltExpr::create(zero, b0));
+  ASSERT_NE(parent.getIndependentPartition(), nullptr);
+  EXPECT_EQ(parent.getIndependentPartition()->getFactors().size(), 3u);
+
+  // joining a[0] and a[1] leaves the factor of b[0] alone
+  ConstraintSet child(parent);
+  child.push_back(EqExpr::create(a0, a1));
+  const auto &factors = child.getIndependentPartition()->getFactors();
+  ASSERT_EQ(factors.size(), 2u);
+  EXPECT_EQ(factors[0], parent.getIndependentPartition()->getFactors()[2]);
+  EXPECT_EQ(factors[1]->exprs.size(), 3u);
+  EXPECT_EQ(parent.getIndependentPartition()->getFactors().size(), 3u);
+}
+
+TEST(ConstraintSetTest, EqualitiesFollowForks) {
+  ArrayCache ac;
+  const Array *array = ac.CreateArray("arr", 4);
+  ref<Expr> x = Expr::createTempRead(array, 32);
+  ref<Expr> one = ConstantExpr::alloc(1, 32);
+  ref<Expr> two = ConstantExpr::alloc(2, 32);
+  ref<Expr> query = AddExpr::create(x, one);
+
+  ConstraintSet parent;
+  parent.push_back(UltExpr::create(x, ConstantExpr::alloc(10, 32)));
+  EXPECT_EQ(ConstraintManager::simplifyExpr(parent, query), query);
+
+  ConstraintSet left(parent), right(parent);
+  left.push_back(EqExpr::create(one, x));
+  right.push_back(EqExpr::create(two, x));
+  EXPECT_EQ(ConstraintManager::simplifyExpr(left, query),
+            ConstantExpr::alloc(2, 32));
+  EXPECT_EQ(ConstraintManager::simplifyExpr(right, query),
+            ConstantExpr::alloc(3, 32));
+  EXPECT_EQ(ConstraintManager::simplifyExpr(parent, query), query);
+  EXPECT_EQ(parent.getEqualities().size(), 1u);
+}
+
+TEST(ConstraintSetTest, OtherModelFollowsItsBranch) {
+  ArrayCache ac;
+  const Array *a = ac.CreateArray("a", 1);
+  ref<Expr> a0 = ReadExpr::create(UpdateList(a, 0), ConstantExpr::alloc(0, 32));
+  ref<Expr> isZero = EqExpr::create(ConstantExpr::alloc(0, Expr::Int8), a0);
+
+  ConstraintSet parent;
+  parent.push_back(UltExpr::create(a0, ConstantExpr::alloc(10, Expr::Int8)));
+  auto zero = std::make_shared<Assignment>();
+  auto seven = std::make_shared<Assignment>();
+  seven->addBinding(a, {7});
+  parent.setModel(zero);
+  parent.setOtherModel(seven);
+
+  ConstraintSet taken(parent), other(parent);
+  taken.push_back(isZero);
+  other.push_back(Expr::createIsZero(isZero));
+  EXPECT_EQ(taken.getModel(), zero);
+  EXPECT_EQ(other.getModel(), seven);
+  EXPECT_EQ(parent.getModel(), zero);
+}
+
+TEST(ConstraintSetTest, RewriteKeepsTheUnchangedPrefix) {
+  ArrayCache ac;
+  const Array *a = ac.CreateArray("a", 4);
+  const Array *b = ac.CreateArray("b", 4);
+  ref<Expr> x = Expr::createTempRead(a, 32);
+  ref<Expr> y = Expr::createTempRead(b, 32);
+
+  std::vector<ref<Expr>> expected;
+  ConstraintSet parent;
+  parent.trackIndependence();
+  for (unsigned i = 0; i < 100; ++i) {
+    ref<Expr> c = UltExpr::create(y, ConstantExpr::alloc(1000 + i, 32));
+    parent.push_back(c);
+    expected.push_back(c);
+  }
+  ref<Expr> onX = UltExpr::create(x, y);
+  ref<Expr> last = UltExpr::create(y, ConstantExpr::alloc(2000, 32));
+  parent.push_back(onX);
+  parent.push_back(last);
+
+  ConstraintSet child(parent);
+  ref<Expr> eq = EqExpr::create(ConstantExpr::alloc(5, 32), x);
+  ConstraintManager(child).addConstraint(eq);
+
+  // the rewritten constraint and the ones after it follow the prefix
+  expected.push_back(UltExpr::create(ConstantExpr::alloc(5, 32), y));
+  expected.push_back(last);
+  expected.push_back(eq);
+  EXPECT_EQ(toVector(child), expected);
+  EXPECT_EQ(parent.size(), 102u);
+  EXPECT_EQ(toVector(parent)[100], onX);
+
+  ConstraintSet rebuilt(expected);
+  EXPECT_TRUE(rebuilt == child);
+  EXPECT_EQ(rebuilt.hash(), child.hash());
+  ASSERT_NE(child.getIndependentPartition(), nullptr);
+  EXPECT_EQ(child.getIndependentPartition()->getFactors().size(), 2u);
+}
+
+TEST(ConstraintSetTest, SimplifiesDeepExpressions) {
+  // deeper than the call stack allows for a recursive visit
+  const unsigned depth = 20000;
+  ArrayCache ac;
+  const Array *array = ac.CreateArray("deep", depth);
+  UpdateList ul(array, nullptr);
+  auto readAt = [&](unsigned i) {
+    return ReadExpr::create(ul, ConstantExpr::alloc(i, Expr::Int32));
+  };
+  ref<Expr> e = readAt(0);
+  for (unsigned i = 1; i < depth; ++i)
+    e = XorExpr::create(readAt(i), e);
+
+  ConstraintSet constraints;
+  ConstraintManager cm(constraints);
+  cm.addConstraint(EqExpr::create(readAt(0), ConstantExpr::alloc(5, 8)));
+  ref<Expr> simplified = ConstraintManager::simplifyExpr(constraints, e);
+
+  std::vector<ref<ReadExpr>> reads;
+  findReads(simplified, false, reads);
+  EXPECT_EQ(depth - 1, reads.size());
+  for (const auto &re : reads)
+    EXPECT_NE(0u, cast<ConstantExpr>(re->index)->getZExtValue());
+}
+
+} // namespace
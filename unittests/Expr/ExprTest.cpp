@@ -7,11 +7,14 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <cmath>
 #include <iostream>
 #include "gtest/gtest.h"
 
 #include "klee/Expr/ArrayCache.h"
 #include "klee/Expr/Expr.h"
+#include "klee/Expr/ExprUtil.h"
+#include "klee/Module/Cell.h"
 
 using namespace klee;
 
@@ -264,4 +267,216 @@ TEST(ExprTest, ReadExprFoldingSymbolicIndexUpdate) {
     EXPECT_EQ(Expr::Read, read.get()->getKind());
   }
 }
+
+TEST(ExprTest, StableHashIgnoresArrayCounters) {
+  auto build = [](ArrayCache &ac, const std::string &name, uint64_t value) {
+    const Array *array = ac.CreateArray(name, 256);
+    UpdateList ul(array, 0);
+    ul.extend(ConstantExpr::create(3, Expr::Int32),
+              ReadExpr::createTempRead(array, Expr::Int8));
+    ref<Expr> read = ReadExpr::createTempRead(
+        ac.CreateArray(name + "_off", 8), Expr::Int32);
+    return AddExpr::create(
+        ZExtExpr::create(ReadExpr::create(ul, read), Expr::Int32),
+        ConstantExpr::create(value, Expr::Int32));
+  };
+
+  ArrayCache ac1, ac2;
+  ref<Expr> e1 = build(ac1, "arr", 5);
+  ref<Expr> e2 = build(ac2, "arr_12", 5);
+  EXPECT_EQ(e1->stableHash(), e2->stableHash());
+
+  EXPECT_NE(e1->stableHash(), build(ac1, "arr", 6)->stableHash());
+  EXPECT_NE(e1->stableHash(), build(ac1, "arr2", 5)->stableHash());
+  EXPECT_NE(e1->stableHash(), build(ac2, "arr_", 5)->stableHash());
+}
+
+TEST(ExprTest, HashConsingSharesEqualNodes) {
+  Expr::hashConsing = true;
+  ArrayCache ac;
+  const Array *array = ac.CreateArray("arr", 256);
+  auto build = [array](uint64_t value) {
+    return UltExpr::create(
+        AddExpr::create(ReadExpr::createTempRead(array, Expr::Int32),
+                        ConstantExpr::create(value, Expr::Int32)),
+        ConstantExpr::create(100, Expr::Int32));
+  };
+
+  ref<Expr> e1 = build(5000);
+  EXPECT_EQ(e1.get(), build(5000).get());
+  EXPECT_EQ(e1->getKid(0).get(), build(5000)->getKid(0).get());
+  EXPECT_NE(e1.get(), build(6000).get());
+
+  // nodes leave the table with their last reference
+  unsigned count = Expr::count;
+  build(7000);
+  EXPECT_EQ(count, Expr::count);
+  Expr::hashConsing = false;
+}
+
+TEST(ExprTest, FreedNodesAreReused) {
+  const Expr *freed = ConstantExpr::create(12345, Expr::Int32).get();
+  // the last freed node of a size class is the next one handed out
+  ref<Expr> e = ConstantExpr::create(56789, Expr::Int32);
+  EXPECT_EQ(freed, e.get());
+  EXPECT_NE(0u, ExprAllocator::getSlabBytes());
+
+  // a freed node is held for later ones, not counted as used
+  uint64_t freeBytes = ExprAllocator::getFreeBytes();
+  e = ref<Expr>();
+  EXPECT_LT(freeBytes, ExprAllocator::getFreeBytes());
+  EXPECT_LE(ExprAllocator::getFreeBytes(), ExprAllocator::getSlabBytes());
+}
+
+TEST(ExprTest, SmallConstantsArePreallocated) {
+  EXPECT_EQ(ConstantExpr::create(-128, Expr::Int16).get(),
+            ConstantExpr::create(0xff80, Expr::Int16).get());
+  EXPECT_EQ(ConstantExpr::create(1024, Expr::Int64).get(),
+            ConstantExpr::create(1024, Expr::Int64).get());
+  EXPECT_NE(ConstantExpr::create(1024, Expr::Int64).get(),
+            ConstantExpr::create(1024, Expr::Int32).get());
+  EXPECT_TRUE(ConstantExpr::getCached(llvm::APInt(32, 1025)).isNull());
+  EXPECT_TRUE(ConstantExpr::getCached(llvm::APInt(24, 1)).isNull());
+}
+
+TEST(ExprTest, ReadExprFoldingLongUpdateList) {
+  ArrayCache ac;
+  const Array *array = ac.CreateArray("arr", 256);
+  const Array *array2 = ac.CreateArray("arr2", 4);
+  UpdateList ul(array, 0);
+  for (unsigned i = 0; i < 100; ++i)
+    ul.extend(ConstantExpr::create(i, Expr::Int32),
+              ConstantExpr::create(i, Expr::Int8));
+  ref<Expr> symbolicIndex = ReadExpr::createTempRead(array2, Expr::Int32);
+  ul.extend(symbolicIndex, ConstantExpr::create(200, Expr::Int8));
+  const UpdateNode *symbolicWrite = ul.head.get();
+  for (unsigned i = 0; i < 100; ++i)
+    ul.extend(ConstantExpr::create(i % 50 + 100, Expr::Int32),
+              ConstantExpr::create(i, Expr::Int8));
+
+  // the latest writes above the symbolic one are found
+  for (unsigned i = 100; i < 150; ++i)
+    EXPECT_EQ(ref<Expr>(ConstantExpr::create(i - 50, Expr::Int8)),
+              ReadExpr::create(ul, ConstantExpr::create(i, Expr::Int32)));
+
+  // reads below stop at the write at a symbolic index
+  ref<Expr> read = ReadExpr::create(ul, ConstantExpr::create(7, Expr::Int32));
+  ASSERT_EQ(Expr::Read, read->getKind());
+  EXPECT_EQ(symbolicWrite, cast<ReadExpr>(read)->updates.head.get());
+
+  // so do reads from a shorter list sharing the nodes
+  UpdateList shorter(array, ul.head->next);
+  read = ReadExpr::create(shorter, ConstantExpr::create(149, Expr::Int32));
+  EXPECT_EQ(ref<Expr>(ConstantExpr::create(49, Expr::Int8)), read);
+}
+
+TEST(ExprTest, ConstantByteArraysArePacked) {
+  std::vector<ref<ConstantExpr> > Contents(64);
+  for (unsigned i = 0; i < Contents.size(); ++i)
+    Contents[i] = ConstantExpr::create((i * 7) & 0xFF, Expr::Int8);
+  ArrayCache ac;
+  const Array *array = ac.CreateArray("a", Contents.size(), &Contents[0],
+                                      &Contents[0] + Contents.size());
+  // arrays with the same values share them but stay distinct
+  const Array *array2 = ac.CreateArray("b", Contents.size(), &Contents[0],
+                                       &Contents[0] + Contents.size());
+  EXPECT_NE(array, array2);
+  EXPECT_EQ("b", array2->name);
+  for (unsigned i = 0; i < Contents.size(); ++i) {
+    EXPECT_EQ(Contents[i], array->getConstantValue(i));
+    EXPECT_EQ(Contents[i], array2->getConstantValue(i));
+  }
+  EXPECT_EQ(Contents, array->getConstantValues());
+}
+
+TEST(ExprTest, KValueMovesKeepReferenceCounts) {
+  ArrayCache ac;
+  const Array *array = ac.CreateArray("arr", 8);
+  const Array *segments = ac.CreateArray("segments", 8);
+  ref<Expr> offset = Expr::createTempRead(array, Expr::Int64);
+  ref<Expr> segment = Expr::createTempRead(segments, Expr::Int64);
+  EXPECT_EQ(1u, offset->_refCount.getCount());
+
+  // temporaries are adopted rather than copied
+  KValue value{ref<Expr>(segment), ref<Expr>(offset)};
+  EXPECT_EQ(2u, offset->_refCount.getCount());
+  EXPECT_EQ(2u, segment->_refCount.getCount());
+  EXPECT_EQ(offset.get(), value.getOffset().get());
+
+  KValue moved(std::move(value));
+  EXPECT_EQ(2u, offset->_refCount.getCount());
+  EXPECT_EQ(2u, segment->_refCount.getCount());
+
+  Cell cell;
+  cell = std::move(moved);
+  EXPECT_EQ(2u, offset->_refCount.getCount());
+  EXPECT_EQ(2u, segment->_refCount.getCount());
+  EXPECT_EQ(segment.get(), cell.getSegment().get());
+
+  cell = KValue(offset);
+  EXPECT_EQ(2u, offset->_refCount.getCount());
+  EXPECT_EQ(1u, segment->_refCount.getCount());
+
+  ref<Expr> other = Expr::createTempRead(array, Expr::Int32);
+  other.swap(offset);
+  EXPECT_EQ(2u, other->_refCount.getCount());
+  EXPECT_EQ(1u, offset->_refCount.getCount());
+  EXPECT_EQ(32u, offset->getWidth());
+}
+
+TEST(ExprTest, FloatFolding) {
+  auto dbl = [](double d) {
+    return ConstantExpr::alloc(llvm::APFloat(d).bitcastToAPInt());
+  };
+  auto flt = [](float f) {
+    return ConstantExpr::alloc(llvm::APFloat(f).bitcastToAPInt());
+  };
+  EXPECT_EQ(ref<Expr>(dbl(0.1 + 0.2)),
+            FAddExpr::create(dbl(0.1), dbl(0.2)));
+  EXPECT_EQ(ref<Expr>(flt(1.0f / 3.0f)),
+            FDivExpr::create(flt(1.0f), flt(3.0f)));
+  EXPECT_EQ(ref<Expr>(flt(0.1f)), FPTruncExpr::create(dbl(0.1), Expr::Int32));
+  EXPECT_EQ(ref<Expr>(dbl(-3.0)),
+            SIToFPExpr::create(ConstantExpr::alloc(-3, Expr::Int32),
+                               Expr::Int64));
+
+  // all NaNs are the positive quiet NaN
+  ref<Expr> nan = FSubExpr::create(dbl(INFINITY), dbl(INFINITY));
+  EXPECT_EQ(ref<Expr>(ConstantExpr::create(0x7FF8000000000000, Expr::Int64)),
+            nan);
+  EXPECT_TRUE(FUnoExpr::create(nan, dbl(1.0))->isTrue());
+  EXPECT_TRUE(FOEqExpr::create(nan, nan)->isFalse());
+  EXPECT_TRUE(FOLeExpr::create(dbl(-0.0), dbl(0.0))->isTrue());
+  EXPECT_TRUE(FOLtExpr::create(dbl(-0.0), dbl(0.0))->isFalse());
+
+  // conversions to integers round toward zero and saturate
+  EXPECT_EQ(ref<Expr>(ConstantExpr::alloc(-2, Expr::Int8)),
+            FPToSIExpr::create(dbl(-2.9), Expr::Int8));
+  EXPECT_EQ(ref<Expr>(ConstantExpr::alloc(127, Expr::Int8)),
+            FPToSIExpr::create(dbl(1e10), Expr::Int8));
+  EXPECT_EQ(ref<Expr>(ConstantExpr::alloc(255, Expr::Int8)),
+            FPToUIExpr::create(dbl(300.0), Expr::Int8));
+  EXPECT_EQ(ref<Expr>(ConstantExpr::alloc(0, Expr::Int8)),
+            FPToUIExpr::create(nan, Expr::Int8));
+}
+
+TEST(ExprTest, AddLinearTermsIsCanonical) {
+  ArrayCache ac;
+  ref<Expr> x = Expr::createTempRead(ac.CreateArray("x", 8), Expr::Int64);
+  ref<Expr> y = Expr::createTempRead(ac.CreateArray("y", 8), Expr::Int64);
+  auto c = [](uint64_t value) { return ConstantExpr::create(value, Expr::Int64); };
+
+  // (x + 4) + 4 * x + 8 and 12 + 5 * x come out as the same expression
+  ref<Expr> chained = addLinearTerms(AddExpr::create(x, c(4)), {{x, 4}}, 8);
+  EXPECT_EQ(addLinearTerms(c(0), {{x, 5}}, 12), chained);
+
+  // the order the terms are added in does not matter
+  ref<Expr> xy = addLinearTerms(addLinearTerms(c(0), {{x, 2}}, 0), {{y, 3}}, 1);
+  ref<Expr> yx = addLinearTerms(addLinearTerms(c(1), {{y, 3}}, 0), {{x, 2}}, 0);
+  EXPECT_EQ(xy, yx);
+
+  // terms cancelling out leave the constant
+  EXPECT_EQ(ref<Expr>(c(7)),
+            addLinearTerms(MulExpr::create(c(-2), x), {{x, 2}}, 7));
+}
 }
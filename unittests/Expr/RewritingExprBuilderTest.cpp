@@ -0,0 +1,97 @@
+//===-- RewritingExprBuilderTest.cpp --------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+
+#include "klee/Expr/ArrayCache.h"
+#include "klee/Expr/Expr.h"
+#include "klee/Expr/ExprBuilder.h"
+
+#include <memory>
+
+using namespace klee;
+
+namespace {
+
+struct Rewriting : public ::testing::Test {
+  ArrayCache arrays;
+  std::unique_ptr<ExprBuilder> builder;
+  ref<Expr> x, y;
+
+  Rewriting() {
+    builder.reset(createRewritingExprBuilder(
+        createConstantFoldingExprBuilder(createDefaultExprBuilder())));
+    const Array *array = arrays.CreateArray("arr", 8);
+    x = Expr::createTempRead(array, 32);
+    y = ReadExpr::create(UpdateList(array, 0),
+                         ConstantExpr::create(4, Expr::Int32));
+  }
+};
+
+TEST_F(Rewriting, AlgebraicIdentities) {
+  ref<Expr> zero = builder->Constant(0, Expr::Int32);
+  EXPECT_EQ(x, builder->Add(x, zero));
+  EXPECT_EQ(zero, builder->Sub(x, x));
+  EXPECT_EQ(x, builder->Mul(builder->Constant(1, Expr::Int32), x));
+  EXPECT_EQ(x, builder->And(x, x));
+  EXPECT_EQ(zero, builder->Xor(x, x));
+  EXPECT_EQ(x, builder->Not(builder->Not(x)));
+}
+
+TEST_F(Rewriting, ExtractsThroughConcat) {
+  ref<Expr> wide = builder->Concat(x, builder->ZExt(y, Expr::Int32));
+  // the low byte of the zero extended read
+  EXPECT_EQ(y, builder->Extract(wide, 0, Expr::Int8));
+  // above it, zeros
+  EXPECT_EQ(builder->Constant(0, Expr::Int16),
+            builder->Extract(wide, 16, Expr::Int16));
+  EXPECT_EQ(x, builder->Extract(wide, 32, Expr::Int32));
+  // adjacent ranges join again
+  EXPECT_EQ(builder->Extract(x, 8, Expr::Int16),
+            builder->Concat(builder->Extract(x, 16, Expr::Int8),
+                            builder->Extract(x, 8, Expr::Int8)));
+}
+
+TEST_F(Rewriting, CanonicalizesComparisons) {
+  ref<Expr> c = builder->Constant(3, Expr::Int32);
+  EXPECT_EQ(builder->Ult(y, x), builder->Ugt(x, y));
+  EXPECT_EQ(builder->Eq(c, x), builder->Eq(x, c));
+  EXPECT_TRUE(builder->Ule(x, x)->isTrue());
+  EXPECT_TRUE(builder->Slt(x, x)->isFalse());
+  // C == (ZExt X)
+  EXPECT_EQ(builder->Eq(builder->Constant(3, Expr::Int8), y),
+            builder->Eq(c, builder->ZExt(y, Expr::Int32)));
+  EXPECT_TRUE(builder->Eq(builder->Constant(300, Expr::Int32),
+                          builder->ZExt(y, Expr::Int32))
+                  ->isFalse());
+}
+
+TEST(ExprRebuilderTest, RewritesOnceAndKeepsUnchangedNodes) {
+  ArrayCache arrays;
+  const Array *array = arrays.CreateArray("arr", 8);
+  ref<Expr> x = Expr::createTempRead(array, 32);
+  ExprRebuilder rebuilder(createRewritingExprBuilder(
+      createConstantFoldingExprBuilder(createDefaultExprBuilder())));
+
+  ref<Expr> unchanged = UltExpr::create(x, ConstantExpr::create(8, Expr::Int32));
+  EXPECT_EQ(unchanged.get(), rebuilder.rebuild(unchanged).get());
+
+  // Expr::create does not remove X ^ X
+  ref<Expr> shared = XorExpr::create(x, x);
+  ref<Expr> e = ConcatExpr::create(UltExpr::create(shared, x),
+                                   UltExpr::create(shared, x));
+  ref<Expr> rebuilt = rebuilder.rebuild(e);
+  EXPECT_EQ(rebuilder.rebuild(UltExpr::create(shared, x)).get(),
+            rebuilt->getKid(0).get());
+  EXPECT_EQ(rebuilt->getKid(0).get(), rebuilt->getKid(1).get());
+  EXPECT_EQ(UltExpr::create(ConstantExpr::create(0, Expr::Int32), x),
+            rebuilt->getKid(0));
+}
+
+} // namespace
@@ -0,0 +1,103 @@
+//===-- SMTLIBStreamPrinterTest.cpp ---------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+
+#include "klee/Expr/ArrayCache.h"
+#include "klee/Expr/Constraints.h"
+#include "klee/Expr/Expr.h"
+#include "klee/Expr/SMTLIBStreamPrinter.h"
+#include "klee/Solver/Solver.h"
+
+#include <string>
+
+using namespace klee;
+
+namespace {
+
+unsigned count(const std::string &s, const std::string &what) {
+  unsigned n = 0;
+  for (size_t i = s.find(what); i != std::string::npos;
+       i = s.find(what, i + 1))
+    ++n;
+  return n;
+}
+
+struct Queries {
+  ArrayCache arrays;
+  const Array *array;
+  ref<Expr> sum, constraint;
+
+  Queries() {
+    array = arrays.CreateArray("arr", 4);
+    ref<Expr> read = Expr::createTempRead(array, 32);
+    sum = AddExpr::create(read, ConstantExpr::create(3, Expr::Int32));
+    constraint = UltExpr::create(sum, ConstantExpr::create(10, Expr::Int32));
+  }
+
+  ref<Expr> query(uint64_t bound) const {
+    return UleExpr::create(MulExpr::create(sum, sum),
+                           ConstantExpr::create(bound, Expr::Int32));
+  }
+};
+
+TEST(SMTLIBStreamPrinterTest, DefinesSharedExpressionsOnce) {
+  Queries q;
+  ConstraintSet constraints({q.constraint});
+  SMTLIBStreamPrinter printer;
+  printer.printQuery(Query(constraints, q.query(81)));
+  const std::string &out = printer.str();
+
+  EXPECT_EQ(1u, count(out, "(declare-fun arr "));
+  // the sum, used by the constraint and twice by the query
+  EXPECT_EQ(1u, count(out, "(define-fun "));
+  EXPECT_EQ(1u, count(out, "(bvadd "));
+  EXPECT_EQ(1u, count(out, "(check-sat)"));
+  EXPECT_EQ(1u, count(out, "(exit)"));
+}
+
+TEST(SMTLIBStreamPrinterTest, IncrementalSessionReusesDefinitions) {
+  Queries q;
+  ConstraintSet constraints({q.constraint});
+  std::vector<const Array *> objects = {q.array};
+  SMTLIBStreamPrinter printer(true);
+  printer.printQuery(Query(constraints, q.query(81)));
+  std::string first = printer.str();
+  std::string out;
+  llvm::raw_string_ostream os(out);
+  printer.flush(os);
+
+  printer.printQuery(Query(constraints, q.query(64)), &objects);
+  const std::string &second = printer.str();
+  EXPECT_EQ(1u, count(first, "(set-logic "));
+  EXPECT_EQ(1u, count(first, "(push 1)"));
+  EXPECT_EQ(1u, count(first, "(pop 1)"));
+  EXPECT_EQ(0u, count(second, "(set-logic "));
+  // the sum and the constraint were defined by the first query
+  EXPECT_EQ(0u, count(second, "(declare-fun "));
+  EXPECT_EQ(0u, count(second, "(define-fun "));
+  EXPECT_EQ(1u, count(second, "(get-value "));
+}
+
+TEST(SMTLIBStreamPrinterTest, DiscardedQueryIsForgotten) {
+  Queries q;
+  ConstraintSet constraints({q.constraint});
+  SMTLIBStreamPrinter printer(true);
+  printer.printQuery(Query(constraints, q.query(81)));
+  printer.discardQuery();
+  EXPECT_TRUE(printer.str().empty());
+
+  // the next query defines what the discarded one did
+  printer.printQuery(Query(constraints, q.query(64)));
+  EXPECT_EQ(1u, count(printer.str(), "(set-logic "));
+  EXPECT_EQ(1u, count(printer.str(), "(declare-fun arr "));
+  EXPECT_EQ(2u, count(printer.str(), "(define-fun "));
+}
+
+} // namespace
@@ -0,0 +1,119 @@
+#include "klee/ADT/ImmutableBTreeMap.h"
+#include "gtest/gtest.h"
+
+#include <map>
+#include <random>
+
+using namespace klee;
+
+namespace {
+
+typedef ImmutableBTreeMap<unsigned, unsigned, std::less<unsigned>, 8> Map;
+
+void expectEqual(const std::map<unsigned, unsigned> &expected,
+                 const Map &map) {
+  ASSERT_EQ(expected.size(), map.size());
+  ASSERT_EQ(expected.empty(), map.empty());
+  auto ei = expected.begin();
+  for (auto mi = map.begin(); mi != map.end(); ++mi, ++ei) {
+    ASSERT_EQ(ei->first, mi->first);
+    ASSERT_EQ(ei->second, mi->second);
+  }
+  ASSERT_TRUE(ei == expected.end());
+  // and backwards
+  auto mi = map.end();
+  for (auto ri = expected.rbegin(); ri != expected.rend(); ++ri) {
+    --mi;
+    ASSERT_EQ(ri->first, mi->first);
+  }
+  ASSERT_TRUE(mi == map.begin());
+}
+
+TEST(ImmutableBTreeMapTest, Empty) {
+  Map map;
+  ASSERT_TRUE(map.empty());
+  ASSERT_EQ(0u, map.size());
+  ASSERT_TRUE(map.begin() == map.end());
+  ASSERT_EQ(nullptr, map.lookup(1));
+  ASSERT_TRUE(map.find(1) == map.end());
+  ASSERT_TRUE(map.remove(1).empty());
+}
+
+TEST(ImmutableBTreeMapTest, InsertDoesNotReplace) {
+  Map map = Map().insert({1, 10});
+  map = map.insert({1, 11});
+  ASSERT_EQ(10u, map.lookup(1)->second);
+  map = map.replace({1, 12});
+  ASSERT_EQ(12u, map.lookup(1)->second);
+  ASSERT_EQ(1u, map.size());
+}
+
+TEST(ImmutableBTreeMapTest, RandomOperations) {
+  std::mt19937 rng(0);
+  std::map<unsigned, unsigned> expected;
+  Map map;
+  // earlier versions stay unchanged by later updates
+  std::vector<std::pair<std::map<unsigned, unsigned>, Map>> versions;
+  for (unsigned i = 0; i < 20000; ++i) {
+    unsigned key = rng() % 2000, value = rng();
+    switch (rng() % 3) {
+    case 0:
+      expected.insert({key, value});
+      map = map.insert({key, value});
+      break;
+    case 1:
+      expected[key] = value;
+      map = map.replace({key, value});
+      break;
+    default:
+      expected.erase(key);
+      map = map.remove(key);
+      break;
+    }
+    if (i % 1000 == 0)
+      versions.emplace_back(expected, map);
+  }
+  expectEqual(expected, map);
+  for (const auto &version : versions)
+    expectEqual(version.first, version.second);
+
+  for (unsigned key = 0; key < 2001; ++key) {
+    auto lower = expected.lower_bound(key);
+    auto upper = expected.upper_bound(key);
+    auto mlower = map.lower_bound(key);
+    auto mupper = map.upper_bound(key);
+    if (lower == expected.end()) {
+      ASSERT_TRUE(mlower == map.end());
+    } else {
+      ASSERT_EQ(lower->first, mlower->first);
+    }
+    if (upper == expected.end()) {
+      ASSERT_TRUE(mupper == map.end());
+    } else {
+      ASSERT_EQ(upper->first, mupper->first);
+    }
+
+    const auto *found = map.lookup(key);
+    ASSERT_EQ(expected.count(key), map.count(key));
+    if (found) {
+      ASSERT_EQ(expected[key], found->second);
+    }
+    ASSERT_EQ(found != nullptr, map.find(key) != map.end());
+
+    const auto *previous = map.lookup_previous(key);
+    if (upper == expected.begin()) {
+      ASSERT_EQ(nullptr, previous);
+    } else {
+      ASSERT_EQ(std::prev(upper)->first, previous->first);
+    }
+  }
+  ASSERT_EQ(expected.begin()->first, map.min().first);
+  ASSERT_EQ(expected.rbegin()->first, map.max().first);
+
+  // removing everything yields the empty map
+  for (const auto &entry : expected)
+    map = map.remove(entry.first);
+  ASSERT_TRUE(map.empty());
+}
+
+} // namespace
@@ -0,0 +1,132 @@
+#include "klee/ADT/KTest.h"
+
+#include "gtest/gtest.h"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+/* A test with a single argument and an object per string. */
+struct TestCase {
+  std::vector<std::string> names, values;
+  std::vector<KTestObject> objects;
+  char arg[8] = "prog.bc";
+  char *args[1] = {arg};
+  KTest test;
+
+  TestCase(std::vector<std::string> names, std::vector<std::string> values)
+      : names(names), values(values) {
+    for (size_t i = 0; i < names.size(); ++i)
+      objects.push_back(
+          {&this->names[i][0], static_cast<unsigned>(this->values[i].size()),
+           reinterpret_cast<unsigned char *>(&this->values[i][0])});
+    test.version = kTest_getCurrentVersion();
+    test.numArgs = 1;
+    test.args = args;
+    test.symArgvs = 0;
+    test.symArgvLen = 0;
+    test.numObjects = objects.size();
+    test.objects = objects.data();
+  }
+};
+
+void expectEqual(const TestCase &expected, KTest *test) {
+  ASSERT_TRUE(test);
+  ASSERT_EQ(1u, test->numArgs);
+  EXPECT_STREQ("prog.bc", test->args[0]);
+  ASSERT_EQ(expected.names.size(), test->numObjects);
+  for (unsigned i = 0; i < test->numObjects; ++i) {
+    EXPECT_EQ(expected.names[i], test->objects[i].name);
+    EXPECT_EQ(expected.values[i],
+              std::string(reinterpret_cast<char *>(test->objects[i].bytes),
+                          test->objects[i].numBytes));
+  }
+  kTest_free(test);
+}
+
+long fileSize(const char *path) {
+  FILE *f = fopen(path, "rb");
+  fseek(f, 0, SEEK_END);
+  long size = ftell(f);
+  fclose(f);
+  return size;
+}
+
+TEST(KTestArchiveTest, RoundTrip) {
+  TestCase a({"x", "y"}, {"abcd", ""}), b({"x"}, {"efgh"});
+  KTestArchive *archive = kTestArchive_create("archive1.ktests", 0);
+  ASSERT_TRUE(archive);
+  ASSERT_TRUE(kTestArchive_append(archive, &a.test));
+  ASSERT_TRUE(kTestArchive_append(archive, &b.test));
+  ASSERT_TRUE(kTestArchive_close(archive));
+
+  EXPECT_TRUE(kTestArchive_isArchive("archive1.ktests"));
+  EXPECT_FALSE(kTest_isKTestFile("archive1.ktests"));
+  archive = kTestArchive_open("archive1.ktests");
+  ASSERT_TRUE(archive);
+  ASSERT_EQ(2u, kTestArchive_numTests(archive));
+  expectEqual(a, kTestArchive_getTest(archive, 0));
+  expectEqual(b, kTestArchive_getTest(archive, 1));
+  EXPECT_FALSE(kTestArchive_getTest(archive, 2));
+  kTestArchive_close(archive);
+  remove("archive1.ktests");
+}
+
+TEST(KTestArchiveTest, Deduplication) {
+  std::string big(1000, 'z');
+  TestCase a({"x"}, {big}), b({"y"}, {big});
+  long sizes[2];
+  for (int deduplicate = 0; deduplicate < 2; ++deduplicate) {
+    KTestArchive *archive = kTestArchive_create("archive2.ktests", deduplicate);
+    ASSERT_TRUE(archive);
+    ASSERT_TRUE(kTestArchive_append(archive, &a.test));
+    ASSERT_TRUE(kTestArchive_append(archive, &b.test));
+    ASSERT_TRUE(kTestArchive_close(archive));
+    sizes[deduplicate] = fileSize("archive2.ktests");
+
+    archive = kTestArchive_open("archive2.ktests");
+    ASSERT_TRUE(archive);
+    ASSERT_EQ(2u, kTestArchive_numTests(archive));
+    expectEqual(a, kTestArchive_getTest(archive, 0));
+    expectEqual(b, kTestArchive_getTest(archive, 1));
+    kTestArchive_close(archive);
+  }
+  EXPECT_LT(sizes[1] + 900, sizes[0]);
+  remove("archive2.ktests");
+}
+
+/* The tests of an archive that was not closed are still found, and a
+   reopened archive keeps its tests. */
+TEST(KTestArchiveTest, WithoutIndex) {
+  TestCase a({"x"}, {"abcd"}), b({"y"}, {"efgh"});
+  KTestArchive *archive = kTestArchive_create("archive3.ktests", 1);
+  ASSERT_TRUE(archive);
+  ASSERT_TRUE(kTestArchive_append(archive, &a.test));
+  ASSERT_TRUE(kTestArchive_close(archive));
+
+  archive = kTestArchive_reopen("archive3.ktests", 1);
+  ASSERT_TRUE(archive);
+  ASSERT_TRUE(kTestArchive_append(archive, &b.test));
+  ASSERT_TRUE(kTestArchive_close(archive));
+
+  // drop the index and half of a record following the tests
+  long size = fileSize("archive3.ktests");
+  FILE *f = fopen("archive3.ktests", "r+b");
+  ASSERT_TRUE(f);
+  ASSERT_EQ(0, ftruncate(fileno(f), size - 5));
+  fclose(f);
+
+  archive = kTestArchive_open("archive3.ktests");
+  ASSERT_TRUE(archive);
+  ASSERT_EQ(2u, kTestArchive_numTests(archive));
+  expectEqual(a, kTestArchive_getTest(archive, 0));
+  expectEqual(b, kTestArchive_getTest(archive, 1));
+  kTestArchive_close(archive);
+  remove("archive3.ktests");
+}
+
+} // namespace
@@ -0,0 +1,105 @@
+#include "klee/ADT/KTest.h"
+
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+namespace {
+
+KTest *roundTrip(std::vector<unsigned char> &bytes, long *size,
+                 bool mapped = false) {
+  char name[] = "buf", arg[] = "prog.bc";
+  char *args[1] = {arg};
+  KTestObject object = {name, static_cast<unsigned>(bytes.size()),
+                        bytes.data()};
+  KTest test = {kTest_getCurrentVersion(), 1, args, 0, 0, 1, &object};
+  if (!kTest_toFile(&test, "file.ktest"))
+    return nullptr;
+
+  FILE *f = fopen("file.ktest", "rb");
+  fseek(f, 0, SEEK_END);
+  *size = ftell(f);
+  fclose(f);
+  KTest *res = mapped ? kTest_mapFile("file.ktest")
+                      : kTest_fromFile("file.ktest");
+  remove("file.ktest");
+  return res;
+}
+
+void expectBytes(const std::vector<unsigned char> &expected, KTest *test) {
+  ASSERT_TRUE(test);
+  ASSERT_EQ(1u, test->numObjects);
+  EXPECT_STREQ("buf", test->objects[0].name);
+  ASSERT_EQ(expected.size(), test->objects[0].numBytes);
+  EXPECT_TRUE(std::equal(expected.begin(), expected.end(),
+                         test->objects[0].bytes));
+}
+
+/* Objects without long runs of zeros are stored as they are. */
+TEST(KTestFileTest, Dense) {
+  std::vector<unsigned char> bytes(100, 'a');
+  bytes[50] = 0;
+  long size;
+  KTest *test = roundTrip(bytes, &size);
+  expectBytes(bytes, test);
+  EXPECT_EQ(3u, test->version);
+  kTest_free(test);
+}
+
+/* Only the non-zero parts of large objects mostly left zero are stored. */
+TEST(KTestFileTest, Sparse) {
+  std::vector<unsigned char> bytes(1 << 20, 0);
+  bytes[1000] = 'A';
+  bytes[1001] = 'B';
+  bytes[1010] = 'C';
+  bytes[500000] = 'D';
+  bytes.back() = 'E';
+  long size;
+  KTest *test = roundTrip(bytes, &size);
+  expectBytes(bytes, test);
+  EXPECT_EQ(kTest_getCurrentVersion(), test->version);
+  EXPECT_LT(size, 200);
+  kTest_free(test);
+
+  std::fill(bytes.begin(), bytes.end(), 0);
+  test = roundTrip(bytes, &size);
+  expectBytes(bytes, test);
+  kTest_free(test);
+}
+
+/* Mapped tests read the same, also once the file is gone. */
+TEST(KTestFileTest, Mapped) {
+  std::vector<unsigned char> bytes(100, 'a');
+  long size;
+  KTest *test = roundTrip(bytes, &size, true);
+  expectBytes(bytes, test);
+  kTest_free(test);
+
+  bytes.assign(1 << 20, 0);
+  bytes[4242] = 'X';
+  test = roundTrip(bytes, &size, true);
+  expectBytes(bytes, test);
+  EXPECT_EQ(kTest_getCurrentVersion(), test->version);
+  kTest_free(test);
+}
+
+/* A truncated file is not a test. */
+TEST(KTestFileTest, MappedTruncated) {
+  std::vector<unsigned char> bytes(100, 'a');
+  char name[] = "buf";
+  KTestObject object = {name, static_cast<unsigned>(bytes.size()),
+                        bytes.data()};
+  KTest test = {kTest_getCurrentVersion(), 0, nullptr, 0, 0, 1, &object};
+  ASSERT_TRUE(kTest_toFile(&test, "truncated.ktest"));
+  ASSERT_EQ(0, truncate("truncated.ktest", 50));
+  EXPECT_EQ(nullptr, kTest_mapFile("truncated.ktest"));
+  EXPECT_EQ(nullptr, kTest_fromFile("truncated.ktest"));
+  remove("truncated.ktest");
+}
+
+} // namespace
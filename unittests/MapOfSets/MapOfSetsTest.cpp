@@ -0,0 +1,40 @@
+#include "klee/ADT/MapOfSets.h"
+#include "gtest/gtest.h"
+
+#include <set>
+
+using namespace klee;
+
+namespace {
+
+struct IsPositive {
+  bool operator()(int v) const { return v > 0; }
+};
+
+TEST(MapOfSetsTest, Erase) {
+  MapOfSets<int, int> m;
+  m.insert({1, 2}, 12);
+  m.insert({1, 2, 3}, 123);
+  m.insert({4}, 4);
+
+  ASSERT_FALSE(m.erase({1}));
+  ASSERT_FALSE(m.erase({1, 3}));
+
+  ASSERT_TRUE(m.erase({1, 2}));
+  ASSERT_EQ(nullptr, m.lookup({1, 2}));
+  ASSERT_FALSE(m.erase({1, 2}));
+  // the longer set sharing the erased prefix is kept
+  ASSERT_NE(nullptr, m.lookup({1, 2, 3}));
+  ASSERT_EQ(123, *m.lookup({1, 2, 3}));
+
+  ASSERT_TRUE(m.erase({1, 2, 3}));
+  ASSERT_EQ(nullptr, m.findSuperset(std::set<int>{1}, IsPositive()));
+  ASSERT_EQ(4, *m.findSubset(std::set<int>{4, 5}, IsPositive()));
+
+  unsigned entries = 0;
+  for (auto it = m.begin(), ie = m.end(); it != ie; ++it)
+    ++entries;
+  ASSERT_EQ(1u, entries);
+}
+
+} // namespace
@@ -0,0 +1,67 @@
+#include "klee/ADT/FixedSizePool.h"
+#include "klee/Statistics/MemoryAccount.h"
+
+#include "gtest/gtest.h"
+
+using namespace klee;
+
+namespace {
+
+TEST(MemoryAccountTest, Find) {
+  EXPECT_EQ(&memory::cexCache, MemoryAccount::find("cex-cache"));
+  EXPECT_EQ(nullptr, MemoryAccount::find("nothing"));
+  for (MemoryAccount *account : MemoryAccount::getAccounts())
+    EXPECT_EQ(account, MemoryAccount::find(account->getName()));
+}
+
+TEST(MemoryAccountTest, Budget) {
+  MemoryAccount account("test", "TestMemory");
+  account.add(100);
+  EXPECT_FALSE(account.isOverBudget());
+  account.setBudget(64);
+  EXPECT_TRUE(account.isOverBudget());
+  account.remove(50);
+  EXPECT_EQ(50u, account.getBytes());
+  EXPECT_FALSE(account.isOverBudget());
+  account.remove(100);
+  EXPECT_EQ(0u, account.getBytes());
+}
+
+TEST(MemoryAccountTest, Release) {
+  MemoryAccount account("test", "TestMemory");
+  EXPECT_FALSE(account.isReleasable());
+  unsigned released = 0;
+  {
+    MemoryAccount::Releaser first(account, [&] {
+      ++released;
+      account.remove(10);
+    });
+    MemoryAccount::Releaser second(account, [&] {
+      ++released;
+      account.remove(20);
+    });
+    account.add(50);
+    EXPECT_TRUE(account.isReleasable());
+    EXPECT_EQ(30u, account.release());
+    EXPECT_EQ(2u, released);
+  }
+  // the releasers are gone with the caches
+  EXPECT_FALSE(account.isReleasable());
+  EXPECT_EQ(0u, account.release());
+  EXPECT_EQ(2u, released);
+}
+
+TEST(MemoryAccountTest, Pool) {
+  MemoryAccount account("test", "TestMemory");
+  {
+    FixedSizePool pool(32, 1024, &account);
+    EXPECT_EQ(0u, account.getBytes());
+    void *p = pool.allocate();
+    EXPECT_EQ(pool.getReservedSize(), account.getBytes());
+    pool.deallocate(p);
+    EXPECT_TRUE(pool.releaseIfUnused());
+    EXPECT_EQ(0u, account.getBytes());
+  }
+}
+
+} // namespace
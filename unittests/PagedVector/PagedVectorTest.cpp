@@ -0,0 +1,128 @@
+#include "klee/ADT/PagedVector.h"
+#include "gtest/gtest.h"
+
+#include <cstdint>
+#include <vector>
+
+using namespace klee;
+
+namespace {
+
+TEST(PagedVectorTest, Unpaged) {
+  PagedVector<uint8_t> v;
+  ASSERT_FALSE(v.isPaged());
+  v.resize(100, 7);
+  ASSERT_EQ(100u, v.size());
+  ASSERT_EQ(7, v[99]);
+  v.set(3, 1);
+
+  PagedVector<uint8_t> copy(v);
+  ASSERT_EQ(1u, copy.getSharedPageCount());
+  copy.set(3, 2);
+  ASSERT_EQ(1, v[3]);
+  ASSERT_EQ(2, copy[3]);
+  ASSERT_EQ(0u, v.getSharedPageCount());
+}
+
+TEST(PagedVectorTest, CopyOnWritePages) {
+  PagedVector<uint8_t> v(16);
+  ASSERT_TRUE(v.isPaged());
+  v.resize(100, 0xAB);
+  for (unsigned i = 0; i < 100; ++i)
+    ASSERT_EQ(0xAB, v[i]);
+
+  PagedVector<uint8_t> copy(v);
+  ASSERT_EQ(7u, copy.getSharedPageCount());
+  copy.set(40, 1);
+  // only the written page was copied
+  ASSERT_EQ(6u, copy.getSharedPageCount());
+  ASSERT_EQ(0xAB, v[40]);
+  ASSERT_EQ(1, copy[40]);
+}
+
+TEST(PagedVectorTest, GrownPagesAreSharedUntilWritten) {
+  PagedVector<uint8_t> v(16);
+  v.resize(1 << 20, 0);
+  ASSERT_EQ(65536u, v.getSharedPageCount());
+  // the pages of the fill value count as a single page
+  ASSERT_LT(v.getProportionalBytes(), 64u);
+
+  v.set(1000, 3);
+  v.set(1 << 19, 4);
+  ASSERT_EQ(65534u, v.getSharedPageCount());
+  ASSERT_EQ(3, v[1000]);
+  ASSERT_EQ(0, v[1001]);
+  ASSERT_EQ(4, v[1 << 19]);
+  ASSERT_EQ(0, v[(1 << 19) + 16]);
+}
+
+TEST(PagedVectorTest, ResizeRefillsStaleTail) {
+  PagedVector<uint8_t> v(16);
+  v.resize(20, 1);
+  v.set(19, 5);
+  v.resize(18);
+  v.resize(40, 2);
+  ASSERT_EQ(1, v[17]);
+  ASSERT_EQ(2, v[19]);
+  ASSERT_EQ(2, v[39]);
+  v.resize(0);
+  ASSERT_TRUE(v.empty());
+  v.resize(3, 9);
+  ASSERT_EQ(9, v[2]);
+}
+
+TEST(PagedVectorTest, BulkCopies) {
+  PagedVector<uint8_t> v(8);
+  v.resize(30, 0);
+  std::vector<uint8_t> buf(30);
+  for (unsigned i = 0; i < 30; ++i)
+    buf[i] = i;
+  ASSERT_FALSE(v.equals(buf.data()));
+
+  PagedVector<uint8_t> copy(v);
+  copy.copyFrom(buf.data());
+  ASSERT_TRUE(copy.equals(buf.data()));
+  ASSERT_EQ(0, v[29]);
+
+  std::vector<uint8_t> out(30);
+  copy.copyTo(out.data());
+  ASSERT_EQ(buf, out);
+
+  // writing unchanged contents keeps the pages shared
+  PagedVector<uint8_t> shared(copy);
+  shared.copyFrom(buf.data());
+  ASSERT_EQ(4u, shared.getSharedPageCount());
+}
+
+TEST(PagedVectorTest, RangeCopies) {
+  PagedVector<uint8_t> v(8);
+  v.resize(30, 0);
+  PagedVector<uint8_t> copy(v);
+
+  // a range across two pages only unshares those pages
+  std::vector<uint8_t> buf = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+  copy.copyFrom(5, buf.size(), buf.data());
+  ASSERT_EQ(0, copy[4]);
+  ASSERT_EQ(1, copy[5]);
+  ASSERT_EQ(10, copy[14]);
+  ASSERT_EQ(0, copy[15]);
+  ASSERT_EQ(0, v[5]);
+  ASSERT_EQ(2u, copy.getSharedPageCount());
+
+  std::vector<uint8_t> out(12);
+  copy.copyTo(4, out.size(), out.data());
+  ASSERT_EQ(0, out[0]);
+  ASSERT_TRUE(std::equal(buf.begin(), buf.end(), out.begin() + 1));
+  ASSERT_EQ(0, out[11]);
+
+  PagedVector<uint8_t> flat;
+  flat.resize(4, 7);
+  flat.copyFrom(1, 2, buf.data());
+  flat.copyTo(0, 4, out.data());
+  ASSERT_EQ(7, out[0]);
+  ASSERT_EQ(1, out[1]);
+  ASSERT_EQ(2, out[2]);
+  ASSERT_EQ(7, out[3]);
+}
+
+} // namespace
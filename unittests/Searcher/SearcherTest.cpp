@@ -14,9 +14,20 @@
 #include "Core/ExecutionState.h"
 #include "Core/PTree.h"
 #include "Core/Searcher.h"
+#include "Core/StateScoring.h"
+#include "klee/Module/Cell.h"
+#include "klee/Module/InstructionInfoTable.h"
+#include "klee/Module/KModule.h"
 
+#include "llvm/IR/DataLayout.h"
+#include "llvm/IR/Module.h"
 #include "llvm/Support/raw_ostream.h"
 
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
 using namespace klee;
 
 namespace {
@@ -61,6 +72,42 @@ TEST(SearcherTest, RandomPath) {
   EXPECT_TRUE(rp.empty());
 }
 
+TEST(SearcherTest, PTreeLog) {
+  std::string data;
+  std::uint32_t rootID, forkedID;
+  {
+    ExecutionState es;
+    rootID = es.getID();
+    PTree processTree(&es, std::make_unique<llvm::raw_string_ostream>(data));
+
+    ExecutionState es1(es);
+    forkedID = es1.getID();
+    processTree.attach(es.ptreeNode, &es1, &es, BranchType::Switch);
+    processTree.remove(es1.ptreeNode);
+    processTree.remove(es.ptreeNode);
+  }
+
+  std::vector<PTreeLogRecord> records;
+  EXPECT_TRUE(PTree::readLog(
+      data, [&](const PTreeLogRecord &r) { records.push_back(r); }));
+  ASSERT_EQ(records.size(), 5u);
+  EXPECT_EQ(records[0].kind, PTreeLogRecord::Root);
+  EXPECT_EQ(records[0].leftState, rootID);
+  EXPECT_EQ(records[1].kind, PTreeLogRecord::Attach);
+  EXPECT_EQ(records[1].node, records[0].node);
+  EXPECT_EQ(records[1].leftState, forkedID);
+  EXPECT_EQ(records[1].rightState, rootID);
+  EXPECT_EQ(records[1].reason, BranchType::Switch);
+  EXPECT_EQ(records[2].kind, PTreeLogRecord::Remove);
+  EXPECT_EQ(records[2].node, records[1].left);
+  EXPECT_EQ(records[3].node, records[1].right);
+  EXPECT_EQ(records[4].node, records[0].node);
+
+  // a truncated log is rejected
+  EXPECT_FALSE(PTree::readLog(
+      llvm::StringRef(data).drop_back(), [](const PTreeLogRecord &) {}));
+}
+
 TEST(SearcherTest, TwoRandomPath) {
   // Root state
   ExecutionState root;
@@ -201,6 +248,144 @@ TEST(SearcherTest, TwoRandomPathDot) {
   processTree.remove(es1.ptreeNode);
   processTree.remove(root.ptreeNode);
 }
+
+TEST(SearcherTest, RandomPathDeepTree) {
+  ExecutionState root;
+  PTree processTree(&root);
+  root.ptreeNode = processTree.root.getPointer();
+
+  RNG rng, rng1, choices;
+  RandomPathSearcher rp(processTree, rng);
+  RandomPathSearcher rp1(processTree, rng1);
+  rp.update(nullptr, {&root}, {});
+
+  // fork repeatedly, giving the new states to either searcher or dropping
+  // them, which leaves long chains of nodes with a single child of ours
+  std::vector<std::unique_ptr<ExecutionState>> states;
+  std::set<ExecutionState *> owned, owned1;
+  owned.insert(&root);
+  for (int i = 0; i < 2000; ++i) {
+    ExecutionState *current = &root;
+    if (!states.empty() && choices.getInt32() % 2)
+      current = states[choices.getInt32() % states.size()].get();
+    if (!owned.count(current) && !owned1.count(current))
+      continue;
+
+    states.push_back(std::make_unique<ExecutionState>(*current));
+    ExecutionState *es = states.back().get();
+    processTree.attach(current->ptreeNode, es, current, BranchType::NONE);
+    switch (choices.getInt32() % 8) {
+    case 0:
+      rp1.update(nullptr, {es}, {});
+      owned1.insert(es);
+      break;
+    case 1:
+    case 2:
+      rp.update(current, {es}, {});
+      owned.insert(es);
+      break;
+    default:
+      processTree.remove(es->ptreeNode);
+      break;
+    }
+
+    // terminate a state once in a while
+    if (choices.getInt32() % 4 == 0) {
+      ExecutionState *victim = states[choices.getInt32() % states.size()].get();
+      if (owned.erase(victim)) {
+        rp.update(nullptr, {}, {victim});
+        processTree.remove(victim->ptreeNode);
+      } else if (owned1.erase(victim)) {
+        rp1.update(nullptr, {}, {victim});
+        processTree.remove(victim->ptreeNode);
+      }
+    }
+  }
+
+  ASSERT_FALSE(owned.empty());
+  ASSERT_FALSE(owned1.empty());
+  for (int i = 0; i < 1000; ++i) {
+    EXPECT_TRUE(owned.count(&rp.selectState()));
+    EXPECT_TRUE(owned1.count(&rp1.selectState()));
+  }
+
+  for (ExecutionState *es : owned) {
+    rp.update(nullptr, {}, {es});
+    processTree.remove(es->ptreeNode);
+  }
+  for (ExecutionState *es : owned1) {
+    rp1.update(nullptr, {}, {es});
+    processTree.remove(es->ptreeNode);
+  }
+  EXPECT_TRUE(rp.empty());
+  EXPECT_TRUE(rp1.empty());
+}
+
+TEST(SearcherTest, ScoringModels) {
+  std::string error;
+  StateFeatures f;
+  f[StateFeatures::Depth] = 3;
+  f[StateFeatures::ErrorDistance] = 10;
+
+  auto linear = ScoringModel::parse("# comment\nlinear\nbias 1\n"
+                                    "depth 2\nerror-distance -0.5\n",
+                                    error);
+  ASSERT_TRUE(linear) << error;
+  EXPECT_DOUBLE_EQ(linear->score(f), 1 + 2 * 3 - 0.5 * 10);
+  EXPECT_TRUE(linear->uses(StateFeatures::Depth));
+  EXPECT_FALSE(linear->uses(StateFeatures::MinDistToUncovered));
+
+  auto tree = ScoringModel::parse("tree\n"
+                                  "split depth 5 1 2\n"
+                                  "split error-distance 20 3 4\n"
+                                  "leaf -1\n"
+                                  "leaf 7\n"
+                                  "leaf 2\n",
+                                  error);
+  ASSERT_TRUE(tree) << error;
+  EXPECT_EQ(tree->score(f), 7);
+  f[StateFeatures::ErrorDistance] = 20;
+  EXPECT_EQ(tree->score(f), 2);
+  f[StateFeatures::Depth] = 5;
+  EXPECT_EQ(tree->score(f), -1);
+  EXPECT_FALSE(tree->uses(StateFeatures::StackDepth));
+
+  EXPECT_FALSE(ScoringModel::parse("", error));
+  EXPECT_FALSE(ScoringModel::parse("linear\nfoo 1\n", error));
+  EXPECT_EQ(error, "line 2: unknown feature 'foo'");
+  // a child before its parent would allow cycles
+  EXPECT_FALSE(ScoringModel::parse("tree\nleaf 1\nsplit depth 1 0 0\n",
+                                   error));
+  EXPECT_FALSE(ScoringModel::parse("tree\nsplit depth 1 1 2\nleaf 1\n",
+                                   error));
+}
+
+TEST(SearcherTest, FeatureSearcher) {
+  KModule kmodule;
+  std::string error;
+  FeatureSearcher searcher(ScoringModel::parse("linear\ndepth 1\n", error),
+                           kmodule);
+  EXPECT_TRUE(searcher.empty());
+
+  ExecutionState es, es1, es2;
+  es.depth = 2;
+  es1.depth = 5;
+  es2.depth = 5;
+  searcher.update(nullptr, {&es, &es1, &es2}, {});
+  // the deepest state, ties broken by id
+  EXPECT_EQ(&searcher.selectState(), &es1);
+  EXPECT_EQ(searcher.getFeatures(es1)[StateFeatures::Depth], 5);
+
+  es.depth = 9;
+  searcher.update(&es, {}, {});
+  EXPECT_EQ(&searcher.selectState(), &es);
+
+  searcher.update(nullptr, {}, {&es, &es1});
+  EXPECT_EQ(&searcher.selectState(), &es2);
+  searcher.update(nullptr, {}, {&es2});
+  EXPECT_TRUE(searcher.empty());
+}
+
 TEST(SearcherDeathTest, TooManyRandomPaths) {
   // First state
   ExecutionState es;
@@ -209,9 +394,9 @@ TEST(SearcherDeathTest, TooManyRandomPaths) {
   processTree.remove(es.ptreeNode); // Need to remove to avoid leaks
 
   RNG rng;
-  RandomPathSearcher rp(processTree, rng);
-  RandomPathSearcher rp1(processTree, rng);
-  RandomPathSearcher rp2(processTree, rng);
-  ASSERT_DEATH({ RandomPathSearcher rp3(processTree, rng); }, "");
+  std::vector<std::unique_ptr<RandomPathSearcher>> searchers;
+  for (int i = 0; i < MaxRandomPathSearchers; ++i)
+    searchers.push_back(std::make_unique<RandomPathSearcher>(processTree, rng));
+  ASSERT_DEATH({ RandomPathSearcher rp(processTree, rng); }, "");
 }
 }
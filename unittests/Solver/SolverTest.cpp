@@ -14,6 +14,7 @@
 #include "klee/Expr/Expr.h"
 #include "klee/Solver/Solver.h"
 #include "klee/Solver/SolverCmdLine.h"
+#include "klee/Solver/SolverStats.h"
 
 #include "llvm/ADT/StringExtras.h"
 
@@ -130,6 +131,37 @@ void testOpcode(Solver &solver, bool tryBool = true, bool tryZero = true,
   }
 }
 
+void testAllOpcodes(Solver &solver) {
+  testOpcode<SelectExpr>(solver);
+  testOpcode<ZExtExpr>(solver);
+  testOpcode<SExtExpr>(solver);
+  
+  testOpcode<AddExpr>(solver);
+  testOpcode<SubExpr>(solver);
+  testOpcode<MulExpr>(solver, false, true, 8);
+  testOpcode<SDivExpr>(solver, false, false, 8);
+  testOpcode<UDivExpr>(solver, false, false, 8);
+  testOpcode<SRemExpr>(solver, false, false, 8);
+  testOpcode<URemExpr>(solver, false, false, 8);
+  testOpcode<ShlExpr>(solver, false);
+  testOpcode<LShrExpr>(solver, false);
+  testOpcode<AShrExpr>(solver, false);
+  testOpcode<AndExpr>(solver);
+  testOpcode<OrExpr>(solver);
+  testOpcode<XorExpr>(solver);
+
+  testOpcode<EqExpr>(solver);
+  testOpcode<NeExpr>(solver);
+  testOpcode<UltExpr>(solver);
+  testOpcode<UleExpr>(solver);
+  testOpcode<UgtExpr>(solver);
+  testOpcode<UgeExpr>(solver);
+  testOpcode<SltExpr>(solver);
+  testOpcode<SleExpr>(solver);
+  testOpcode<SgtExpr>(solver);
+  testOpcode<SgeExpr>(solver);
+}
+
 TEST(SolverTest, Evaluation) {
   Solver *solver = klee::createCoreSolver(CoreSolverToUse);
 
@@ -137,34 +169,136 @@ TEST(SolverTest, Evaluation) {
   solver = createCachingSolver(solver);
   solver = createIndependentSolver(solver);
 
-  testOpcode<SelectExpr>(*solver);
-  testOpcode<ZExtExpr>(*solver);
-  testOpcode<SExtExpr>(*solver);
-  
-  testOpcode<AddExpr>(*solver);
-  testOpcode<SubExpr>(*solver);
-  testOpcode<MulExpr>(*solver, false, true, 8);
-  testOpcode<SDivExpr>(*solver, false, false, 8);
-  testOpcode<UDivExpr>(*solver, false, false, 8);
-  testOpcode<SRemExpr>(*solver, false, false, 8);
-  testOpcode<URemExpr>(*solver, false, false, 8);
-  testOpcode<ShlExpr>(*solver, false);
-  testOpcode<LShrExpr>(*solver, false);
-  testOpcode<AShrExpr>(*solver, false);
-  testOpcode<AndExpr>(*solver);
-  testOpcode<OrExpr>(*solver);
-  testOpcode<XorExpr>(*solver);
-
-  testOpcode<EqExpr>(*solver);
-  testOpcode<NeExpr>(*solver);
-  testOpcode<UltExpr>(*solver);
-  testOpcode<UleExpr>(*solver);
-  testOpcode<UgtExpr>(*solver);
-  testOpcode<UgeExpr>(*solver);
-  testOpcode<SltExpr>(*solver);
-  testOpcode<SleExpr>(*solver);
-  testOpcode<SgtExpr>(*solver);
-  testOpcode<SgeExpr>(*solver);
+  testAllOpcodes(*solver);
+
+  delete solver;
+}
+
+TEST(SolverTest, FastCexEvaluation) {
+  Solver *solver = klee::createCoreSolver(CoreSolverToUse);
+
+  solver = createFastCexSolver(solver);
+
+  testAllOpcodes(*solver);
+
+  delete solver;
+}
+
+// The bounds checks of an index into an array of 4 byte elements, and a
+// lookup in a constant table, are decided without the (failing) solver
+// behind the fast counterexample solver.
+TEST(SolverTest, FastCexDecidesBounds) {
+  Solver *solver = createFastCexSolver(createDummySolver());
+
+  const Array *array = ac.CreateArray("fast_cex_index", 4);
+  ref<Expr> index = Expr::createTempRead(array, Expr::Int32);
+  ConstraintSet constraints;
+  ConstraintManager cm(constraints);
+  cm.addConstraint(UltExpr::create(index, getConstant(10, Expr::Int32)));
+
+  ref<Expr> offset =
+      AddExpr::create(getConstant(4, Expr::Int32),
+                      MulExpr::create(getConstant(4, Expr::Int32), index));
+  bool res;
+  ASSERT_TRUE(solver->mustBeTrue(
+      Query(constraints, UltExpr::create(offset, getConstant(44, Expr::Int32))),
+      res));
+  EXPECT_TRUE(res);
+
+  Solver::Validity validity;
+  ASSERT_TRUE(solver->evaluate(
+      Query(constraints, EqExpr::create(index, getConstant(20, Expr::Int32))),
+      validity));
+  EXPECT_EQ(Solver::False, validity);
+
+  // an element may be out of these bounds
+  EXPECT_FALSE(solver->evaluate(
+      Query(constraints, UltExpr::create(offset, getConstant(40, Expr::Int32))),
+      validity));
+
+  const uint8_t values[] = {3, 1, 4, 1, 5, 9, 2, 6, 5, 3, 0, 0};
+  std::vector<ref<ConstantExpr>> contents;
+  for (uint8_t value : values)
+    contents.push_back(ConstantExpr::create(value, Expr::Int8));
+  const Array *table = ac.CreateArray("fast_cex_table", contents.size(),
+                                      &contents.front(), &contents.back() + 1);
+  ref<Expr> element = ReadExpr::create(UpdateList(table, 0), index);
+  ASSERT_TRUE(solver->evaluate(
+      Query(constraints, EqExpr::create(getConstant(0, Expr::Int8), element)),
+      validity));
+  EXPECT_EQ(Solver::False, validity);
+
+  // 9 is only at index 5
+  cm.addConstraint(EqExpr::create(getConstant(9, Expr::Int8), element));
+  ref<ConstantExpr> value;
+  ASSERT_TRUE(solver->getValue(Query(constraints, index), value));
+  EXPECT_EQ(5u, value->getZExtValue());
+
+  delete solver;
+}
+
+// The bounds of a value follow the constraints, a value fixed by them takes
+// a query for a value and one per bound.
+TEST(SolverTest, GetRange) {
+  Solver *solver = klee::createCoreSolver(CoreSolverToUse);
+
+  const Array *array = ac.CreateArray("range_x", 4);
+  ref<Expr> x = Expr::createTempRead(array, Expr::Int32);
+  ConstraintSet constraints;
+  ConstraintManager cm(constraints);
+  cm.addConstraint(UltExpr::create(getConstant(10, Expr::Int32), x));
+  cm.addConstraint(UleExpr::create(x, getConstant(1000, Expr::Int32)));
+
+  auto range = solver->getRange(Query(constraints, x));
+  EXPECT_EQ(11u, range.first->getZExtValue());
+  EXPECT_EQ(1000u, range.second->getZExtValue());
+
+  range = solver->getRange(
+      Query(constraints, AndExpr::create(x, getConstant(0xF0, Expr::Int32))));
+  EXPECT_EQ(0u, range.first->getZExtValue());
+  EXPECT_EQ(0xF0u, range.second->getZExtValue());
+
+  cm.addConstraint(EqExpr::create(
+      MulExpr::create(x, getConstant(3, Expr::Int32)),
+      getConstant(999, Expr::Int32)));
+  uint64_t queries = stats::queries;
+  range = solver->getRange(Query(constraints, x));
+  EXPECT_EQ(333u, range.first->getZExtValue());
+  EXPECT_EQ(333u, range.second->getZExtValue());
+  EXPECT_EQ(3u, stats::queries - queries);
+
+  delete solver;
+}
+
+TEST(SolverTest, QueryShapeHistograms) {
+  Solver *solver = createQueryShapeSolver(createDummySolver(), "dummy");
+  const QueryShapeStats &stats = getQueryShapeStats().back();
+
+  // a read through an update list of length 2, at an index read from a
+  // second array
+  const Array *array = ac.CreateArray("shape_array", 4);
+  ref<Expr> index = ZExtExpr::create(
+      ReadExpr::create(UpdateList(ac.CreateArray("shape_index", 1), 0),
+                       getConstant(0, Expr::Int32)),
+      Expr::Int32);
+  UpdateList ul(array, 0);
+  ul.extend(getConstant(0, Expr::Int32), getConstant(1, Expr::Int8));
+  ul.extend(getConstant(1, Expr::Int32), getConstant(2, Expr::Int8));
+  ref<Expr> read = ReadExpr::create(ul, index);
+  ref<Expr> sum = AddExpr::create(read, read);
+  ConstraintSet constraints({UltExpr::create(sum, getConstant(9, Expr::Int8))});
+
+  bool res;
+  EXPECT_FALSE(solver->mustBeTrue(
+      Query(constraints, EqExpr::create(sum, getConstant(4, Expr::Int8))),
+      res));
+  EXPECT_EQ(1u, stats.queries);
+  // eq, ult, add, zext, the two reads and the constants
+  EXPECT_EQ(1u, stats.nodes[QueryShapeStats::getBucket(12)]);
+  EXPECT_EQ(1u, stats.arrays[QueryShapeStats::getBucket(2)]);
+  EXPECT_EQ(1u, stats.updateDepth[QueryShapeStats::getBucket(2)]);
+  EXPECT_EQ(2u, QueryShapeStats::getBucket(3));
+  EXPECT_EQ(0u, QueryShapeStats::getBucket(0));
 
   delete solver;
 }
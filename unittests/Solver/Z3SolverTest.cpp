@@ -69,3 +69,42 @@ TEST_F(Z3SolverTest, GetConstraintLog) {
   ASSERT_STRNE(Occurence, nullptr);
   free(ConstraintsString);
 }
+
+TEST_F(Z3SolverTest, FloatsAgreeWithFolding) {
+  ConstraintSet Constraints;
+  const Array *Arr = AC.CreateArray("x", 8);
+  ref<Expr> X = Expr::createTempRead(Arr, Expr::Int64);
+  auto Dbl = [](double d) {
+    return ConstantExpr::alloc(llvm::APFloat(d).bitcastToAPInt());
+  };
+
+  // x + 0.1 == 0.3 has solutions, which fold to the same sum
+  ref<Expr> Sum = FAddExpr::create(X, Dbl(0.1));
+  ConstraintSet Sums;
+  Sums.push_back(FOEqExpr::create(Sum, Dbl(0.3)));
+  ref<ConstantExpr> Value;
+  ASSERT_TRUE(Z3Solver_->getValue(Query(Sums, X), Value));
+  EXPECT_TRUE(FOEqExpr::create(FAddExpr::create(Value, Dbl(0.1)), Dbl(0.3))
+                  ->isTrue());
+
+  // NaNs are canonical and conversions saturate as when folding
+  bool Valid;
+  ref<Expr> Nan = FDivExpr::create(X, X);
+  ASSERT_TRUE(Z3Solver_->mustBeTrue(
+      Query(Constraints,
+            OrExpr::create(Expr::createIsZero(FUnoExpr::create(X, X)),
+                           EqExpr::create(
+                               ConstantExpr::alloc(0x7FF8000000000000,
+                                                   Expr::Int64),
+                               FMulExpr::create(X, Nan)))),
+      Valid));
+  EXPECT_TRUE(Valid);
+  ASSERT_TRUE(Z3Solver_->mustBeTrue(
+      Query(Constraints,
+            OrExpr::create(
+                Expr::createIsZero(FOLeExpr::create(Dbl(128.0), X)),
+                EqExpr::create(ConstantExpr::alloc(127, Expr::Int8),
+                               FPToSIExpr::create(X, Expr::Int8)))),
+      Valid));
+  EXPECT_TRUE(Valid);
+}
@@ -21,6 +21,12 @@ TEST(TimeTest, TimingFunctions) {
   ASSERT_GT(p1, time::Point());
   ASSERT_LE(p0, p1);
 
+  // the coarse clock lags by less than a tick of a few ms
+  auto c = time::getCoarseWallTime();
+  auto p2 = time::getWallTime();
+  ASSERT_LE(c, p2);
+  ASSERT_LT(p2 - c, time::milliseconds(100));
+
   time::getUserTime();
 }
 